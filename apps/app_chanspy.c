@@ -56,6 +56,8 @@
 #include "asterisk/stasis_channels.h"
 #include "asterisk/json.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/vector.h"
 
 #define AST_NAME_STRLEN 256
 #define NUM_SPYGROUPS 128
@@ -429,9 +431,288 @@ AST_APP_OPTIONS(spy_opts, {
 	AST_APP_OPTION('X', OPTION_EXIT),
 });
 
+/*! \brief Number of mixed frames a spy bus keeps for spies lagging behind */
+#define SPY_BUS_FRAMES 8
+
+/*! \brief Encoding of a spy bus's audio shared by the spies writing one format */
+struct spy_bus_encoder {
+	/*! The format encoded to */
+	struct ast_format *format;
+	/*! The translation path from signed linear */
+	struct ast_trans_pvt *trans;
+	/*! The tick encoded last */
+	unsigned int tick;
+	/*! The audio of that tick, encoded */
+	struct ast_frame *frame;
+};
+
+/*!
+ * \brief Mixed audio of a spied on channel shared by the spies listening to it
+ *
+ * However many spies listen to a channel in the same way, one audiohook
+ * collects its audio and each tick of it is mixed once.  The mixed frames
+ * are handed to the spies by reference, encoded once for every format the
+ * spies write.
+ */
+struct spy_bus {
+	/*! The one spy audiohook on the spied on channel */
+	struct ast_audiohook audiohook;
+	/*! The number of spies listening */
+	unsigned int listeners;
+	/*! The number of frames mixed so far */
+	unsigned int ticks;
+	/*! The frames mixed last, by tick */
+	struct ast_frame *frames[SPY_BUS_FRAMES];
+	/*! Encoders, one for every format the spies write */
+	AST_VECTOR(, struct spy_bus_encoder) encoders;
+	/*! TRUE if only the audio read from the channel is mixed */
+	unsigned int readonly:1;
+	/*! Spied on channel and how it is listened to */
+	char key[0];
+};
+
+/*! \brief Spy buses by key */
+static struct ao2_container *spy_buses;
+
+AO2_STRING_FIELD_HASH_FN(spy_bus, key);
+AO2_STRING_FIELD_CMP_FN(spy_bus, key);
+
+static void spy_bus_encoder_destroy(struct spy_bus_encoder encoder)
+{
+	if (encoder.frame) {
+		ast_frfree(encoder.frame);
+	}
+	ast_translator_free_path(encoder.trans);
+	ao2_ref(encoder.format, -1);
+}
+
+static void spy_bus_destroy(void *obj)
+{
+	struct spy_bus *bus = obj;
+	int i;
+
+	ast_audiohook_destroy(&bus->audiohook);
+	for (i = 0; i < SPY_BUS_FRAMES; i++) {
+		if (bus->frames[i]) {
+			ast_frfree(bus->frames[i]);
+		}
+	}
+	AST_VECTOR_RESET(&bus->encoders, spy_bus_encoder_destroy);
+	AST_VECTOR_FREE(&bus->encoders);
+}
+
+static int start_spying(struct ast_autochan *autochan, const char *spychan_name, struct ast_audiohook *audiohook, struct ast_flags *flags);
+
+/*!
+ * \internal
+ * \brief Start listening to a channel on its spy bus
+ *
+ * \param autochan The channel to listen to
+ * \param spychan_name The name of the spying channel
+ * \param flags The spy options
+ * \param tick Set to the next tick of the bus
+ *
+ * \return The bus with a reference, NULL on error
+ */
+static struct spy_bus *spy_bus_join(struct ast_autochan *autochan, const char *spychan_name,
+	struct ast_flags *flags, unsigned int *tick)
+{
+	char key[AST_MAX_UNIQUEID + 4];
+	const char *name;
+	struct spy_bus *bus;
+
+	ast_autochan_channel_lock(autochan);
+	name = ast_strdupa(ast_channel_name(autochan->chan));
+	snprintf(key, sizeof(key), "%s/%s%s", ast_channel_uniqueid(autochan->chan),
+		ast_test_flag(flags, OPTION_READONLY) ? "o" : "",
+		ast_test_flag(flags, OPTION_LONG_QUEUE) ? "l" : "");
+	ast_autochan_channel_unlock(autochan);
+
+	ao2_lock(spy_buses);
+	bus = ao2_find(spy_buses, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (bus && bus->audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING) {
+		/* The channel went away, its bus goes when its spies notice */
+		ao2_unlink_flags(spy_buses, bus, OBJ_NOLOCK);
+		ao2_ref(bus, -1);
+		bus = NULL;
+	}
+
+	if (!bus) {
+		bus = ao2_alloc(sizeof(*bus) + strlen(key) + 1, spy_bus_destroy);
+		if (!bus) {
+			ao2_unlock(spy_buses);
+			return NULL;
+		}
+		strcpy(bus->key, key); /* Safe */
+		bus->readonly = ast_test_flag(flags, OPTION_READONLY) ? 1 : 0;
+		ast_audiohook_init(&bus->audiohook, AST_AUDIOHOOK_TYPE_SPY, "ChanSpy", 0);
+
+		if (start_spying(autochan, spychan_name, &bus->audiohook, flags)) {
+			ao2_unlock(spy_buses);
+			ao2_ref(bus, -1);
+			return NULL;
+		}
+		ao2_link_flags(spy_buses, bus, OBJ_NOLOCK);
+	} else {
+		ast_verb(3, "Attaching spy channel %s to %s\n", spychan_name, name);
+	}
+	bus->listeners++;
+	ao2_unlock(spy_buses);
+
+	ao2_lock(bus);
+	*tick = bus->ticks;
+	ao2_unlock(bus);
+
+	return bus;
+}
+
+/*!
+ * \internal
+ * \brief Stop listening to a spy bus
+ *
+ * The last spy to leave detaches the bus from the channel.
+ */
+static void spy_bus_leave(struct spy_bus *bus)
+{
+	ao2_lock(spy_buses);
+	if (!--bus->listeners) {
+		ao2_unlink_flags(spy_buses, bus, OBJ_NOLOCK);
+		ast_audiohook_lock(&bus->audiohook);
+		ast_audiohook_detach(&bus->audiohook);
+		ast_audiohook_unlock(&bus->audiohook);
+	}
+	ao2_unlock(spy_buses);
+
+	ao2_ref(bus, -1);
+}
+
+/*!
+ * \internal
+ * \brief Get the next mixed frame of a spy bus for a spy
+ *
+ * A spy that caught up with the bus mixes the next tick for everyone.
+ *
+ * \param bus The bus, locked
+ * \param tick The next tick of the spy, advanced past the frame returned
+ * \param samples Number of samples to mix
+ * \param gone Set if the spied on channel went away
+ *
+ * \return The frame, valid while the bus is locked, NULL if there is none yet
+ */
+static struct ast_frame *spy_bus_next(struct spy_bus *bus, unsigned int *tick, int samples, int *gone)
+{
+	struct ast_frame *f;
+
+	if (bus->ticks - *tick >= SPY_BUS_FRAMES) {
+		/* Fell too far behind, skip to the latest audio */
+		*tick = bus->ticks - 1;
+	}
+
+	if (*tick == bus->ticks) {
+		struct ast_frame **slot = &bus->frames[bus->ticks % SPY_BUS_FRAMES];
+
+		ast_audiohook_lock(&bus->audiohook);
+		if (bus->audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING) {
+			/* Channel is already gone more than likely */
+			ast_audiohook_unlock(&bus->audiohook);
+			*gone = 1;
+			return NULL;
+		}
+		f = ast_audiohook_read_frame(&bus->audiohook, samples,
+			bus->readonly ? AST_AUDIOHOOK_DIRECTION_READ : AST_AUDIOHOOK_DIRECTION_BOTH,
+			ast_format_slin);
+		ast_audiohook_unlock(&bus->audiohook);
+
+		if (!f) {
+			return NULL;
+		}
+		if (*slot) {
+			ast_frfree(*slot);
+		}
+		*slot = ast_frshare(f);
+		ast_frfree(f);
+		if (!*slot) {
+			return NULL;
+		}
+		bus->ticks++;
+	}
+
+	return bus->frames[(*tick)++ % SPY_BUS_FRAMES];
+}
+
+/*!
+ * \internal
+ * \brief Get a mixed frame of a spy bus encoded for a spy
+ *
+ * \param bus The bus, locked
+ * \param tick The tick of the frame
+ * \param frame The mixed frame
+ * \param format The format the spy writes
+ *
+ * \return The encoded frame, valid while the bus is locked, NULL to write
+ * the mixed frame as it is
+ */
+static struct ast_frame *spy_bus_encode(struct spy_bus *bus, unsigned int tick,
+	struct ast_frame *frame, struct ast_format *format)
+{
+	struct spy_bus_encoder *encoder = NULL;
+	struct ast_frame *encoded;
+	int i;
+
+	if (ast_format_cmp(format, frame->subclass.format) == AST_FORMAT_CMP_EQUAL) {
+		return NULL;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&bus->encoders); i++) {
+		if (ast_format_cmp(AST_VECTOR_GET(&bus->encoders, i).format, format) == AST_FORMAT_CMP_EQUAL) {
+			encoder = AST_VECTOR_GET_ADDR(&bus->encoders, i);
+			break;
+		}
+	}
+
+	if (!encoder) {
+		struct spy_bus_encoder new_encoder = {
+			.format = ao2_bump(format),
+			.trans = ast_translator_build_path(format, frame->subclass.format),
+		};
+
+		if (!new_encoder.trans || AST_VECTOR_APPEND(&bus->encoders, new_encoder)) {
+			ast_translator_free_path(new_encoder.trans);
+			ao2_ref(new_encoder.format, -1);
+			return NULL;
+		}
+		encoder = AST_VECTOR_GET_ADDR(&bus->encoders, AST_VECTOR_SIZE(&bus->encoders) - 1);
+	}
+
+	if (encoder->frame && encoder->tick == tick) {
+		return encoder->frame;
+	}
+	if (encoder->frame && (int) (tick - encoder->tick) < 0) {
+		/* The encoder has moved on, a lagging spy translates for itself */
+		return NULL;
+	}
+
+	encoded = ast_translate(encoder->trans, frame, 0);
+	if (!encoded) {
+		return NULL;
+	}
+	if (encoder->frame) {
+		ast_frfree(encoder->frame);
+		encoder->frame = NULL;
+	}
+	if (!AST_LIST_NEXT(encoded, frame_list)) {
+		encoder->frame = ast_frshare(encoded);
+		encoder->tick = tick;
+	}
+	ast_frfree(encoded);
+
+	return encoder->frame;
+}
+
 struct chanspy_translation_helper {
 	/* spy data */
-	struct ast_audiohook spy_audiohook;
+	struct spy_bus *bus;
+	unsigned int tick;
 	struct ast_audiohook whisper_audiohook;
 	struct ast_audiohook bridge_whisper_audiohook;
 	int fd;
@@ -459,43 +740,64 @@ static void spy_release(struct ast_channel *chan, void *data)
 static int spy_generate(struct ast_channel *chan, void *data, int len, int samples)
 {
 	struct chanspy_translation_helper *csth = data;
-	struct ast_frame *f, *cur;
+	struct spy_bus *bus = csth->bus;
+	struct ast_format *format;
+	struct ast_frame *f, *out, *encoded, *slin = NULL;
+	int gone = 0;
+	int res = 0;
 
-	ast_audiohook_lock(&csth->spy_audiohook);
-	if (csth->spy_audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING) {
-		/* Channel is already gone more than likely */
-		ast_audiohook_unlock(&csth->spy_audiohook);
-		return -1;
+	ast_channel_lock(chan);
+	format = ao2_bump(ast_channel_rawwriteformat(chan));
+	ast_channel_unlock(chan);
+
+	ao2_lock(bus);
+	f = spy_bus_next(bus, &csth->tick, samples, &gone);
+	if (!f) {
+		ao2_unlock(bus);
+		ao2_ref(format, -1);
+		return gone ? -1 : 0;
 	}
 
-	if (ast_test_flag(&csth->flags, OPTION_READONLY)) {
-		/* Option 'o' was set, so don't mix channel audio */
-		f = ast_audiohook_read_frame(&csth->spy_audiohook, samples, AST_AUDIOHOOK_DIRECTION_READ, ast_format_slin);
+	if (csth->volfactor) {
+		/* The volume is the spy's own, so is the copy of the audio it changes */
+		out = ast_frshare(f);
+		if (out && !ast_frunshare(out)) {
+			ast_frame_adjust_volume(out, csth->volfactor);
+		}
 	} else {
-		f = ast_audiohook_read_frame(&csth->spy_audiohook, samples, AST_AUDIOHOOK_DIRECTION_BOTH, ast_format_slin);
+		encoded = spy_bus_encode(bus, csth->tick - 1, f, format);
+		out = ast_frshare(encoded ?: f);
 	}
+	if (csth->fd && !csth->volfactor) {
+		slin = ast_frshare(f);
+	}
+	ao2_unlock(bus);
+	ao2_ref(format, -1);
 
-	ast_audiohook_unlock(&csth->spy_audiohook);
-
-	if (!f)
+	if (!out) {
+		if (slin) {
+			ast_frfree(slin);
+		}
 		return 0;
+	}
 
-	for (cur = f; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
-		if (ast_write(chan, cur)) {
-			ast_frfree(f);
-			return -1;
-		}
+	if (ast_write(chan, out)) {
+		res = -1;
+	} else if (csth->fd) {
+		/* The recording gets the audio the spy hears */
+		struct ast_frame *rec = slin ?: out;
 
-		if (csth->fd) {
-			if (write(csth->fd, cur->data.ptr, cur->datalen) < 0) {
-				ast_log(LOG_WARNING, "write() failed: %s\n", strerror(errno));
-			}
+		if (write(csth->fd, rec->data.ptr, rec->datalen) < 0) {
+			ast_log(LOG_WARNING, "write() failed: %s\n", strerror(errno));
 		}
 	}
 
-	ast_frfree(f);
+	ast_frfree(out);
+	if (slin) {
+		ast_frfree(slin);
+	}
 
-	return 0;
+	return res;
 }
 
 static struct ast_generator spygen = {
@@ -673,13 +975,10 @@ static int channel_spy(struct ast_channel *chan, struct ast_autochan *spyee_auto
 	memset(&csth, 0, sizeof(csth));
 	ast_copy_flags(&csth.flags, flags, AST_FLAGS_ALL);
 
-	/* This is the audiohook which gives us the audio off the channel we are
-	   spying on.
+	/* This is the bus which gives us the audio off the channel we are
+	   spying on, shared with anyone else spying on it the same way.
 	*/
-	ast_audiohook_init(&csth.spy_audiohook, AST_AUDIOHOOK_TYPE_SPY, "ChanSpy", 0);
-
-	if (start_spying(spyee_autochan, spyer_name, &csth.spy_audiohook, flags)) {
-		ast_audiohook_destroy(&csth.spy_audiohook);
+	if (!(csth.bus = spy_bus_join(spyee_autochan, spyer_name, flags, &csth.tick))) {
 		return 0;
 	}
 
@@ -698,11 +997,6 @@ static int channel_spy(struct ast_channel *chan, struct ast_autochan *spyee_auto
 
 	csth.volfactor = *volfactor;
 
-	if (csth.volfactor) {
-		csth.spy_audiohook.options.read_volume = csth.volfactor;
-		csth.spy_audiohook.options.write_volume = csth.volfactor;
-	}
-
 	csth.fd = fd;
 
 	if (ast_test_flag(flags, OPTION_PRIVATE))
@@ -724,7 +1018,7 @@ static int channel_spy(struct ast_channel *chan, struct ast_autochan *spyee_auto
 	   has arrived, since the spied-on channel could have gone away while
 	   we were waiting
 	*/
-	while (ast_waitfor(chan, -1) > -1 && csth.spy_audiohook.status == AST_AUDIOHOOK_STATUS_RUNNING) {
+	while (ast_waitfor(chan, -1) > -1 && csth.bus->audiohook.status == AST_AUDIOHOOK_STATUS_RUNNING) {
 		if (!(f = ast_read(chan)) || ast_check_hangup(chan)) {
 			running = -1;
 			if (f) {
@@ -814,8 +1108,6 @@ static int channel_spy(struct ast_channel *chan, struct ast_autochan *spyee_auto
 			ast_verb(3, "Setting spy volume on %s to %d\n", ast_channel_name(chan), *volfactor);
 
 			csth.volfactor = *volfactor;
-			csth.spy_audiohook.options.read_volume = csth.volfactor;
-			csth.spy_audiohook.options.write_volume = csth.volfactor;
 		}
 	}
 
@@ -840,10 +1132,7 @@ static int channel_spy(struct ast_channel *chan, struct ast_autochan *spyee_auto
 		ast_audiohook_destroy(&csth.bridge_whisper_audiohook);
 	}
 
-	ast_audiohook_lock(&csth.spy_audiohook);
-	ast_audiohook_detach(&csth.spy_audiohook);
-	ast_audiohook_unlock(&csth.spy_audiohook);
-	ast_audiohook_destroy(&csth.spy_audiohook);
+	spy_bus_leave(csth.bus);
 
 	ast_verb(2, "Done Spying on channel %s\n", name);
 	publish_chanspy_message(chan, spyee_autochan->chan, 0);
@@ -1487,6 +1776,9 @@ static int unload_module(void)
 	res |= ast_unregister_application(app_ext);
 	res |= ast_unregister_application(app_dahdiscan);
 
+	ao2_cleanup(spy_buses);
+	spy_buses = NULL;
+
 	return res;
 }
 
@@ -1494,6 +1786,12 @@ static int load_module(void)
 {
 	int res = 0;
 
+	spy_buses = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, 37,
+		spy_bus_hash_fn, NULL, spy_bus_cmp_fn);
+	if (!spy_buses) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	res |= ast_register_application_xml(app_chan, chanspy_exec);
 	res |= ast_register_application_xml(app_ext, extenspy_exec);
 	res |= ast_register_application_xml(app_dahdiscan, dahdiscan_exec);
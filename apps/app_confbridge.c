@@ -465,9 +465,28 @@ static const char app2[] = "ConfKick";
 /*! Initial recording filename space. */
 #define RECORD_FILENAME_INITIAL_SPACE	128
 
+/*! Number of buckets of the decoded prompts container */
+#define CONF_PROMPT_BUCKETS 37
+
+/*! Most sounds kept decoded for playing into conferences */
+#define CONF_PROMPT_CACHE_MAX 256
+
 /*! \brief Container to hold all conference bridges in progress */
 struct ao2_container *conference_bridges;
 
+/*! \brief A sound decoded for playing into conferences without a channel */
+struct conf_prompt {
+	struct ast_bridge_prompt *prompt;
+	/*! Language and name of the sound */
+	char key[0];
+};
+
+/*! \brief Sounds decoded for playing into conferences, shared by all of them */
+static struct ao2_container *conf_prompts;
+
+AO2_STRING_FIELD_HASH_FN(conf_prompt, key);
+AO2_STRING_FIELD_CMP_FN(conf_prompt, key);
+
 static void leave_conference(struct confbridge_user *user);
 static int play_sound_number(struct confbridge_conference *conference, int say_number);
 static int execute_menu_entry(struct confbridge_conference *conference,
@@ -1135,10 +1154,13 @@ static int hangup_playback(void *data)
 {
 	struct hangup_data *hangup = data;
 
-	ast_autoservice_stop(hangup->conference->playback_chan);
+	/* The announcer channel is only there if something needed it */
+	if (hangup->conference->playback_chan) {
+		ast_autoservice_stop(hangup->conference->playback_chan);
 
-	ast_hangup(hangup->conference->playback_chan);
-	hangup->conference->playback_chan = NULL;
+		ast_hangup(hangup->conference->playback_chan);
+		hangup->conference->playback_chan = NULL;
+	}
 
 	ast_mutex_lock(&hangup->lock);
 	hangup->hungup = 1;
@@ -1176,25 +1198,20 @@ static void destroy_conference_bridge(void *obj)
 
 	ast_debug(1, "Destroying conference bridge '%s'\n", conference->name);
 
-	if (conference->playback_chan) {
-		if (conference->playback_queue) {
-			struct hangup_data hangup;
-			hangup_data_init(&hangup, conference);
+	/* Wait for any playback still queued even without an announcer channel */
+	if (conference->playback_queue) {
+		struct hangup_data hangup;
+		hangup_data_init(&hangup, conference);
 
-			if (!ast_taskprocessor_push(conference->playback_queue, hangup_playback, &hangup)) {
-				ast_mutex_lock(&hangup.lock);
-				while (!hangup.hungup) {
-					ast_cond_wait(&hangup.cond, &hangup.lock);
-				}
-				ast_mutex_unlock(&hangup.lock);
+		if (!ast_taskprocessor_push(conference->playback_queue, hangup_playback, &hangup)) {
+			ast_mutex_lock(&hangup.lock);
+			while (!hangup.hungup) {
+				ast_cond_wait(&hangup.cond, &hangup.lock);
 			}
-
-			hangup_data_destroy(&hangup);
-		} else {
-			/* Playback queue is not yet allocated. Just hang up the channel straight */
-			ast_hangup(conference->playback_chan);
-			conference->playback_chan = NULL;
+			ast_mutex_unlock(&hangup.lock);
 		}
+
+		hangup_data_destroy(&hangup);
 	}
 
 	/* Destroying a conference bridge is simple, all we have to do is destroy the bridging object */
@@ -1283,6 +1300,8 @@ void conf_update_user_mute(struct confbridge_user *user)
 
 	/* System level mute request. */
 	mute_system = user->playing_moh
+		/* Listen only users are never heard no matter what they request. */
+		|| ast_test_flag(&user->u_profile, USER_OPT_LISTEN_ONLY)
 		/*
 		 * Do not allow waitmarked users to talk to anyone unless there
 		 * is a marked user present.
@@ -1488,15 +1507,33 @@ void conf_ended(struct confbridge_conference *conference)
 	ao2_unlock(conference);
 }
 
+/*!
+ * \internal
+ * \brief Allocate the playback queue of a conference.
+ */
+static int alloc_playback_queue(struct confbridge_conference *conference)
+{
+	char taskprocessor_name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+	ast_taskprocessor_build_name(taskprocessor_name, sizeof(taskprocessor_name),
+		"Confbridge/%s", conference->name);
+	conference->playback_queue = ast_taskprocessor_get(taskprocessor_name, TPS_REF_DEFAULT);
+	if (!conference->playback_queue) {
+		return -1;
+	}
+	return 0;
+}
+
 /*!
  * \internal
  * \brief Allocate playback channel for a conference.
- * \pre expects conference to be locked before calling this function
+ *
+ * \note Runs in the playback queue taskprocessor, the channel is only
+ * needed for what cannot be played into the bridge directly.
  */
 static int alloc_playback_chan(struct confbridge_conference *conference)
 {
 	struct ast_format_cap *cap;
-	char taskprocessor_name[AST_TASKPROCESSOR_MAX_NAME + 1];
 
 	cap = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
 	if (!cap) {
@@ -1518,14 +1555,6 @@ static int alloc_playback_chan(struct confbridge_conference *conference)
 	ast_debug(1, "Created announcer channel '%s' to conference bridge '%s'\n",
 		ast_channel_name(conference->playback_chan), conference->name);
 
-	ast_taskprocessor_build_name(taskprocessor_name, sizeof(taskprocessor_name),
-		"Confbridge/%s", conference->name);
-	conference->playback_queue = ast_taskprocessor_get(taskprocessor_name, TPS_REF_DEFAULT);
-	if (!conference->playback_queue) {
-		ast_hangup(conference->playback_chan);
-		conference->playback_chan = NULL;
-		return -1;
-	}
 	return 0;
 }
 
@@ -1742,6 +1771,8 @@ static struct confbridge_conference *join_conference_bridge(const char *conferen
 		ast_bridge_set_maximum_sample_rate(conference->bridge, conference->b_profile.maximum_sample_rate);
 		/* Set the internal mixing interval on the bridge from the bridge profile */
 		ast_bridge_set_mixing_interval(conference->bridge, conference->b_profile.mix_interval);
+		/* Set the number of threads writing mixed audio from the bridge profile */
+		ast_bridge_set_mixing_threads(conference->bridge, conference->b_profile.mixing_threads);
 		ast_bridge_set_binaural_active(conference->bridge, ast_test_flag(&conference->b_profile, BRIDGE_OPT_BINAURAL_ACTIVE));
 
 		if (ast_test_flag(&conference->b_profile, BRIDGE_OPT_VIDEO_SRC_FOLLOW_TALKER)) {
@@ -1784,19 +1815,11 @@ static struct confbridge_conference *join_conference_bridge(const char *conferen
 		/* Set the initial state to EMPTY */
 		conference->state = CONF_STATE_EMPTY;
 
-		if (alloc_playback_chan(conference)) {
+		if (alloc_playback_queue(conference)) {
 			ao2_unlink(conference_bridges, conference);
 			ao2_ref(conference, -1);
 			ao2_unlock(conference_bridges);
-			ast_log(LOG_ERROR, "Could not allocate announcer channel for conference '%s'\n", conference_name);
-			return NULL;
-		}
-
-		if (push_announcer(conference)) {
-			ao2_unlink(conference_bridges, conference);
-			ao2_ref(conference, -1);
-			ao2_unlock(conference_bridges);
-			ast_log(LOG_ERROR, "Could not add announcer channel for conference '%s' bridge\n", conference_name);
+			ast_log(LOG_ERROR, "Could not allocate playback queue for conference '%s'\n", conference_name);
 			return NULL;
 		}
 
@@ -1920,13 +1943,114 @@ static void leave_conference(struct confbridge_user *user)
 	user->conference = NULL;
 }
 
+static void conf_prompt_destroy(void *obj)
+{
+	struct conf_prompt *entry = obj;
+
+	ao2_cleanup(entry->prompt);
+}
+
+/*!
+ * \internal
+ * \brief Get a sound decoded for playing into a conference
+ *
+ * Sounds are decoded once and shared by all conferences.  Files given by
+ * absolute path, like the recorded names of users, are decoded every time.
+ *
+ * \return A reference to the prompt
+ * \retval NULL if the sound cannot be decoded
+ */
+static struct ast_bridge_prompt *conf_prompt_get(const char *filename, const char *language)
+{
+	struct conf_prompt *entry;
+	struct ast_bridge_prompt *prompt;
+	size_t key_len = strlen(language) + strlen(filename) + 2;
+	char *key;
+
+	if (filename[0] == '/') {
+		return ast_bridge_prompt_alloc(filename, language);
+	}
+
+	key = ast_alloca(key_len);
+	snprintf(key, key_len, "%s:%s", language, filename);
+
+	entry = ao2_find(conf_prompts, key, OBJ_SEARCH_KEY);
+	if (entry) {
+		prompt = ao2_bump(entry->prompt);
+		ao2_ref(entry, -1);
+		return prompt;
+	}
+
+	prompt = ast_bridge_prompt_alloc(filename, language);
+	if (!prompt) {
+		return NULL;
+	}
+
+	ao2_lock(conf_prompts);
+	if (ao2_container_count(conf_prompts) < CONF_PROMPT_CACHE_MAX
+		&& !(entry = ao2_find(conf_prompts, key, OBJ_SEARCH_KEY | OBJ_NOLOCK))) {
+		entry = ao2_alloc_options(sizeof(*entry) + key_len, conf_prompt_destroy,
+			AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (entry) {
+			strcpy(entry->key, key); /* Safe */
+			entry->prompt = ao2_bump(prompt);
+			ao2_link_flags(conf_prompts, entry, OBJ_NOLOCK);
+		}
+	}
+	ao2_unlock(conf_prompts);
+	ao2_cleanup(entry);
+
+	return prompt;
+}
+
+/*!
+ * \internal
+ * \brief Play a sound file into the conference bridge without the announcer channel
+ *
+ * \retval 0 if the sound was played
+ * \retval -1 if it has to be played by the announcer channel
+ */
+static int playback_direct(struct confbridge_conference *conference, const char *filename)
+{
+	struct ast_bridge_prompt *prompt;
+	int res;
+
+	if (!conference->bridge) {
+		return -1;
+	}
+
+	prompt = conf_prompt_get(filename, conference->b_profile.language);
+	if (!prompt) {
+		return -1;
+	}
+
+	res = ast_bridge_play_prompt(conference->bridge, prompt);
+	ao2_ref(prompt, -1);
+
+	return res;
+}
+
 static void playback_common(struct confbridge_conference *conference, const char *filename, int say_number)
 {
-	/* Don't try to play if the playback channel has been hung up */
-	if (!conference->playback_chan) {
+	/* Sound files are mixed into the bridge directly if it can */
+	if (!ast_strlen_zero(filename) && !playback_direct(conference, filename)) {
 		return;
 	}
 
+	/* Everything else is played by the announcer channel, added when first needed */
+	if (!conference->playback_chan) {
+		if (alloc_playback_chan(conference)) {
+			ast_log(LOG_WARNING, "Could not allocate announcer channel for conference '%s'\n",
+				conference->name);
+			return;
+		}
+		if (push_announcer(conference)) {
+			ast_log(LOG_WARNING, "Could not add announcer channel for conference '%s' bridge\n",
+				conference->name);
+			return;
+		}
+	}
+
 	ast_autoservice_stop(conference->playback_chan);
 
 	/* The channel is all under our control, in goes the prompt */
@@ -4400,6 +4524,9 @@ static int unload_module(void)
 
 	ast_cli_unregister_multiple(cli_confbridge, ARRAY_LEN(cli_confbridge));
 
+	ao2_cleanup(conf_prompts);
+	conf_prompts = NULL;
+
 	ast_manager_unregister("ConfbridgeList");
 	ast_manager_unregister("ConfbridgeListRooms");
 	ast_manager_unregister("ConfbridgeMute");
@@ -4460,6 +4587,13 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	conf_prompts = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, CONF_PROMPT_BUCKETS,
+		conf_prompt_hash_fn, NULL, conf_prompt_cmp_fn);
+	if (!conf_prompts) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	/* Setup manager stasis subscriptions */
 	res |= manager_confbridge_init();
 
@@ -4491,6 +4625,9 @@ static int load_module(void)
 
 static int reload(void)
 {
+	/* Sound files may have changed as well */
+	ao2_callback(conf_prompts, OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK, NULL, NULL);
+
 	return conf_reload_config();
 }
 
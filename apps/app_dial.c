@@ -821,6 +821,9 @@ struct chanlist {
 
 AST_LIST_HEAD_NOLOCK(dial_head, chanlist);
 
+/*! \brief Peer channel requests of the destinations in a dial_head, in the same order */
+AST_VECTOR(dial_requests, struct ast_dial_request);
+
 static int detect_disconnect(struct ast_channel *chan, char code, struct ast_str **featurecode);
 
 static void chanlist_free(struct chanlist *outgoing)
@@ -831,6 +834,25 @@ static void chanlist_free(struct chanlist *outgoing)
 	ast_free(outgoing);
 }
 
+/*! \brief Free destinations whose peer channels were not set up yet */
+static void dial_requests_free(struct dial_head *pending, struct dial_requests *requests)
+{
+	struct chanlist *outgoing;
+	int idx;
+
+	while ((outgoing = AST_LIST_REMOVE_HEAD(pending, node))) {
+		chanlist_free(outgoing);
+	}
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(requests); idx++) {
+		struct ast_dial_request *request = AST_VECTOR_GET_ADDR(requests, idx);
+
+		ast_hangup(request->chan);
+		ast_stream_topology_free(request->topology);
+	}
+	AST_VECTOR_FREE(requests);
+}
+
 static void hanguptree(struct dial_head *out_chans, struct ast_channel *exception, int hangupcause)
 {
 	/* Hang up a tree of stuff */
@@ -2240,6 +2262,10 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 	int res = -1; /* default: error */
 	char *rest, *cur; /* scan the list of destinations */
 	struct dial_head out_chans = AST_LIST_HEAD_NOLOCK_INIT_VALUE; /* list of destinations */
+	struct dial_head pending = AST_LIST_HEAD_NOLOCK_INIT_VALUE; /* destinations whose peers are being requested */
+	struct dial_requests requests = { 0, };
+	struct chanlist *last_dest = NULL; /* destination given last in the dial string */
+	int idx;
 	struct chanlist *outgoing;
 	struct chanlist *tmp;
 	struct ast_channel *peer = NULL;
@@ -2524,12 +2550,11 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 	/* loop through the list of dial destinations */
 	rest = args.peers;
 	while ((cur = strsep(&rest, "&"))) {
-		struct ast_channel *tc; /* channel for this destination */
 		char *number;
 		char *tech;
 		size_t tech_len;
 		size_t number_len;
-		struct ast_stream_topology *topology;
+		struct ast_dial_request request = { 0, };
 
 		cur = ast_strip(cur);
 		if (ast_strlen_zero(cur)) {
@@ -2580,8 +2605,6 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 			ast_set2_flag64(tmp, args.url, DIAL_NOFORWARDHTML);
 		}
 
-		/* Request the peer */
-
 		ast_channel_lock(chan);
 		/*
 		 * Seed the chanlist's connected line information with previously
@@ -2591,20 +2614,48 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 		 */
 		ast_party_connected_line_copy(&tmp->connected, ast_channel_connected(chan));
 
-		topology = ast_stream_topology_clone(ast_channel_get_stream_topology(chan));
+		request.topology = ast_stream_topology_clone(ast_channel_get_stream_topology(chan));
 
 		ast_channel_unlock(chan);
 
-		tc = ast_request_with_stream_topology(tmp->tech, topology, NULL, chan, tmp->number, &cause);
+		request.tech = tmp->tech;
+		request.device = tmp->number;
+		if (AST_VECTOR_APPEND(&requests, request)) {
+			ast_stream_topology_free(request.topology);
+			chanlist_free(tmp);
+			goto out;
+		}
+		AST_LIST_INSERT_TAIL(&pending, tmp, node);
+		if (!rest) {
+			last_dest = tmp;
+		}
+	}
+
+	/*
+	 * Request the peers of all destinations at once, the slow part of which is
+	 * usually the channel driver looking up the endpoint.  The peers are then
+	 * set up one by one in the order they were given in.
+	 */
+	if (AST_VECTOR_SIZE(&requests)) {
+		ast_dial_request_parallel(AST_VECTOR_GET_ADDR(&requests, 0), AST_VECTOR_SIZE(&requests), chan);
+	}
+
+	for (idx = 0; (tmp = AST_LIST_REMOVE_HEAD(&pending, node)); idx++) {
+		struct ast_dial_request *request = AST_VECTOR_GET_ADDR(&requests, idx);
+		struct ast_channel *tc = request->chan; /* channel for this destination */
+		int is_last = (tmp == last_dest);
 
-		ast_stream_topology_free(topology);
+		request->chan = NULL;
+		ast_stream_topology_free(request->topology);
+		request->topology = NULL;
+		cause = request->cause;
 
 		if (!tc) {
 			/* If we can't, just go on to the next call */
 			ast_log(LOG_WARNING, "Unable to create channel of type '%s' (cause %d - %s)\n",
 				tmp->tech, cause, ast_cause2str(cause));
 			handle_cause(cause, &num);
-			if (!rest) {
+			if (is_last) {
 				/* we are on the last destination */
 				ast_channel_hangupcause_set(chan, cause);
 			}
@@ -2628,7 +2679,7 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 		pbx_builtin_setvar_helper(tc, "DIALEDPEERNUMBER", tmp->number);
 
 		/* Setup outgoing SDP to match incoming one */
-		if (!AST_LIST_FIRST(&out_chans) && !rest && CAN_EARLY_BRIDGE(peerflags, chan, tc)) {
+		if (!AST_LIST_FIRST(&out_chans) && is_last && CAN_EARLY_BRIDGE(peerflags, chan, tc)) {
 			/* We are on the only destination. */
 			ast_rtp_instance_early_bridge_make_compatible(tc, chan);
 		}
@@ -2738,6 +2789,7 @@ static int dial_exec_full(struct ast_channel *chan, const char *data, struct ast
 		tmp->chan = tc;
 		AST_LIST_INSERT_TAIL(&out_chans, tmp, node);
 	}
+	AST_VECTOR_FREE(&requests);
 
 	if (AST_LIST_EMPTY(&out_chans)) {
 		ast_verb(3, "No devices or endpoints to dial (technology/resource)\n");
@@ -3354,6 +3406,7 @@ out:
 	}
 
 	ast_channel_early_bridge(chan, NULL);
+	dial_requests_free(&pending, &requests);
 	 /* forward 'answered elsewhere' if we received it */
 	hanguptree(&out_chans, NULL,
 		ast_channel_hangupcause(chan) == AST_CAUSE_ANSWERED_ELSEWHERE
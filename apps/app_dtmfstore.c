@@ -192,6 +192,7 @@ static int dtmfstore_exec(struct ast_channel *chan, const char *appdata)
 	static struct ast_framehook_interface digit_framehook_interface = {
 		.version = AST_FRAMEHOOK_INTERFACE_VERSION,
 		.event_cb = dtmf_store_framehook,
+		.frame_types = AST_FRAMEHOOK_TYPE(AST_FRAME_DTMF_END),
 		.disable_inheritance = 1,
 	};
 	char *parse = ast_strdupa(appdata);
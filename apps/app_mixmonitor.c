@@ -60,6 +60,8 @@
 #include "asterisk/mixmonitor.h"
 #include "asterisk/format_cache.h"
 #include "asterisk/beep.h"
+#include "asterisk/timing.h"
+#include "asterisk/vector.h"
 
 /*** DOCUMENTATION
 	<application name="MixMonitor" language="en_US">
@@ -122,6 +124,13 @@
 						used, MixMonitor will insert silence into the specified files to maintain
 						synchronization between them. Use this option to disable that behavior.</para>
 					</option>
+					<option name="F">
+						<argument name="interval" required="true" />
+						<para>Sync the files being recorded to disk at most every
+						<replaceable>interval</replaceable> milliseconds, overriding
+						<literal>flush_interval</literal> in <filename>mixmonitor.conf</filename>.
+						An interval of 0 leaves writing the files to disk to the operating system.</para>
+					</option>
 					<option name="i">
 						<argument name="chanvar" required="true" />
 						<para>Stores the MixMonitor's ID on this channel variable.</para>
@@ -353,6 +362,15 @@ static const char * const stop_app = "StopMixMonitor";
 
 static const char * const mixmonitor_spy_type = "MixMonitor";
 
+static const char config[] = "mixmonitor.conf";
+
+/*! Number of writer threads recordings are handed to, 0 for a thread per recording */
+static unsigned int writer_threads;
+/*! Size of the write buffer of each recorded file, 0 for the stdio default */
+static unsigned int write_buffer_size;
+/*! Default milliseconds between syncing recorded files to disk, 0 to leave that to the OS */
+static unsigned int flush_interval;
+
 /*!
  * \internal
  * \brief This struct is a list item holds data needed to find a vm_recipient within voicemail
@@ -386,6 +404,20 @@ struct mixmonitor {
 	);
 	int call_priority;
 
+	/* the extensions of the recorded files, set when the files are opened */
+	char *fs_ext;
+	char *fs_read_ext;
+	char *fs_write_ext;
+	struct ast_format *format_slin;
+
+	/*! Size of the buffer given to each file stream, 0 for the stdio default */
+	unsigned int write_buffer_size;
+	/*! The buffers given to the file streams, freed once the streams are closed */
+	char *write_buffers[3];
+	/*! Milliseconds between syncing the files to disk, 0 to leave that to the OS */
+	unsigned int flush_interval;
+	struct timeval last_flush;
+
 	/* FUTURE DEVELOPMENT NOTICE
 	 * recipient_list will need locks if we make it editable after the monitor is started */
 	AST_LIST_HEAD_NOLOCK(, vm_recipient) recipient_list;
@@ -407,6 +439,7 @@ enum mixmonitor_flags {
 	MUXFLAG_BEEP_STOP = (1 << 13),
 	MUXFLAG_DEPRECATED_RWSYNC = (1 << 14),
 	MUXFLAG_NO_RWSYNC = (1 << 15),
+	MUXFLAG_FLUSH = (1 << 16),
 };
 
 enum mixmonitor_args {
@@ -420,6 +453,7 @@ enum mixmonitor_args {
 	OPT_ARG_BEEP_INTERVAL,
 	OPT_ARG_DEPRECATED_RWSYNC,
 	OPT_ARG_NO_RWSYNC,
+	OPT_ARG_FLUSH,
 	OPT_ARG_ARRAY_SIZE,	/* Always last element of the enum */
 };
 
@@ -438,6 +472,7 @@ AST_APP_OPTIONS(mixmonitor_opts, {
 	AST_APP_OPTION_ARG('m', MUXFLAG_VMRECIPIENTS, OPT_ARG_VMRECIPIENTS),
 	AST_APP_OPTION_ARG('S', MUXFLAG_DEPRECATED_RWSYNC, OPT_ARG_DEPRECATED_RWSYNC),
 	AST_APP_OPTION_ARG('n', MUXFLAG_NO_RWSYNC, OPT_ARG_NO_RWSYNC),
+	AST_APP_OPTION_ARG('F', MUXFLAG_FLUSH, OPT_ARG_FLUSH),
 });
 
 struct mixmonitor_ds {
@@ -615,6 +650,9 @@ static void mixmonitor_free(struct mixmonitor *mixmonitor)
 		ast_free(mixmonitor->filename);
 		ast_free(mixmonitor->filename_write);
 		ast_free(mixmonitor->filename_read);
+		ast_free(mixmonitor->write_buffers[0]);
+		ast_free(mixmonitor->write_buffers[1]);
+		ast_free(mixmonitor->write_buffers[2]);
 
 		/* Free everything in the recipient list */
 		clear_mixmonitor_recipient_list(mixmonitor);
@@ -706,112 +744,133 @@ static int mixmonitor_autochan_is_bridged(struct ast_autochan *autochan)
 	return is_bridged;
 }
 
-static void *mixmonitor_thread(void *obj)
+/*!
+ * \internal
+ * \brief Give a newly opened file stream a write buffer of the configured size
+ *
+ * \note The format has usually written its header by now, so the stream is
+ * flushed before its buffer is replaced.
+ */
+static void mixmonitor_set_write_buffer(struct mixmonitor *mixmonitor, struct ast_filestream *fs, char **buffer)
 {
-	struct mixmonitor *mixmonitor = obj;
-	char *fs_ext = "";
-	char *fs_read_ext = "";
-	char *fs_write_ext = "";
+	if (!fs || !fs->f || !mixmonitor->write_buffer_size || *buffer) {
+		return;
+	}
+
+	if (!(*buffer = ast_malloc(mixmonitor->write_buffer_size))) {
+		return;
+	}
 
-	struct ast_filestream **fs = NULL;
-	struct ast_filestream **fs_read = NULL;
-	struct ast_filestream **fs_write = NULL;
+	fflush(fs->f);
+	if (setvbuf(fs->f, *buffer, _IOFBF, mixmonitor->write_buffer_size)) {
+		ast_debug(1, "Unable to set a %u byte write buffer for MixMonitor %s\n",
+			mixmonitor->write_buffer_size, mixmonitor->name);
+	}
+}
 
+/*!
+ * \internal
+ * \brief Open the files the mixmonitor records to
+ */
+static void mixmonitor_open(struct mixmonitor *mixmonitor)
+{
 	unsigned int oflags;
 	int errflag = 0;
-	struct ast_format *format_slin;
-
-	/* Keep callid association before any log messages */
-	if (mixmonitor->callid) {
-		ast_callid_threadassoc_add(mixmonitor->callid);
-	}
 
 	ast_verb(2, "Begin MixMonitor Recording %s\n", mixmonitor->name);
 
-	fs = &mixmonitor->mixmonitor_ds->fs;
-	fs_read = &mixmonitor->mixmonitor_ds->fs_read;
-	fs_write = &mixmonitor->mixmonitor_ds->fs_write;
-
 	ast_mutex_lock(&mixmonitor->mixmonitor_ds->lock);
-	mixmonitor_save_prep(mixmonitor, mixmonitor->filename, fs, &oflags, &errflag, &fs_ext);
-	mixmonitor_save_prep(mixmonitor, mixmonitor->filename_read, fs_read, &oflags, &errflag, &fs_read_ext);
-	mixmonitor_save_prep(mixmonitor, mixmonitor->filename_write, fs_write, &oflags, &errflag, &fs_write_ext);
+	mixmonitor_save_prep(mixmonitor, mixmonitor->filename, &mixmonitor->mixmonitor_ds->fs, &oflags, &errflag, &mixmonitor->fs_ext);
+	mixmonitor_save_prep(mixmonitor, mixmonitor->filename_read, &mixmonitor->mixmonitor_ds->fs_read, &oflags, &errflag, &mixmonitor->fs_read_ext);
+	mixmonitor_save_prep(mixmonitor, mixmonitor->filename_write, &mixmonitor->mixmonitor_ds->fs_write, &oflags, &errflag, &mixmonitor->fs_write_ext);
 
-	format_slin = ast_format_cache_get_slin_by_rate(mixmonitor->mixmonitor_ds->samp_rate);
+	mixmonitor_set_write_buffer(mixmonitor, mixmonitor->mixmonitor_ds->fs, &mixmonitor->write_buffers[0]);
+	mixmonitor_set_write_buffer(mixmonitor, mixmonitor->mixmonitor_ds->fs_read, &mixmonitor->write_buffers[1]);
+	mixmonitor_set_write_buffer(mixmonitor, mixmonitor->mixmonitor_ds->fs_write, &mixmonitor->write_buffers[2]);
 
-	ast_mutex_unlock(&mixmonitor->mixmonitor_ds->lock);
+	mixmonitor->format_slin = ast_format_cache_get_slin_by_rate(mixmonitor->mixmonitor_ds->samp_rate);
+	mixmonitor->last_flush = ast_tvnow();
 
-	/* The audiohook must enter and exit the loop locked */
-	ast_audiohook_lock(&mixmonitor->audiohook);
-	while (mixmonitor->audiohook.status == AST_AUDIOHOOK_STATUS_RUNNING && !mixmonitor->mixmonitor_ds->fs_quit) {
-		struct ast_frame *fr = NULL;
-		struct ast_frame *fr_read = NULL;
-		struct ast_frame *fr_write = NULL;
-
-		if (!(fr = ast_audiohook_read_frame_all(&mixmonitor->audiohook, SAMPLES_PER_FRAME, format_slin,
-						&fr_read, &fr_write))) {
-			ast_audiohook_trigger_wait(&mixmonitor->audiohook);
+	ast_mutex_unlock(&mixmonitor->mixmonitor_ds->lock);
+}
 
-			if (mixmonitor->audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING) {
-				break;
-			}
-			continue;
-		}
+static void mixmonitor_sync_fs(struct ast_filestream *fs)
+{
+	if (fs && fs->f && !fflush(fs->f)) {
+		fsync(fileno(fs->f));
+	}
+}
 
-		/* audiohook lock is not required for the next block.
-		 * Unlock it, but remember to lock it before looping or exiting */
-		ast_audiohook_unlock(&mixmonitor->audiohook);
+/*!
+ * \internal
+ * \brief Write a mixed frame and the frames of each direction, then free them
+ *
+ * \note The audiohook must not be locked.
+ */
+static void mixmonitor_write_frames(struct mixmonitor *mixmonitor, struct ast_frame *fr,
+	struct ast_frame *fr_read, struct ast_frame *fr_write)
+{
+	struct mixmonitor_ds *mixmonitor_ds = mixmonitor->mixmonitor_ds;
 
-		if (!ast_test_flag(mixmonitor, MUXFLAG_BRIDGED)
-			|| mixmonitor_autochan_is_bridged(mixmonitor->autochan)) {
-			ast_mutex_lock(&mixmonitor->mixmonitor_ds->lock);
+	if (!ast_test_flag(mixmonitor, MUXFLAG_BRIDGED)
+		|| mixmonitor_autochan_is_bridged(mixmonitor->autochan)) {
+		ast_mutex_lock(&mixmonitor_ds->lock);
 
-			/* Write out the frame(s) */
-			if ((*fs_read) && (fr_read)) {
-				struct ast_frame *cur;
+		/* Write out the frame(s) */
+		if ((mixmonitor_ds->fs_read) && (fr_read)) {
+			struct ast_frame *cur;
 
-				for (cur = fr_read; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
-					ast_writestream(*fs_read, cur);
-				}
+			for (cur = fr_read; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
+				ast_writestream(mixmonitor_ds->fs_read, cur);
 			}
+		}
 
-			if ((*fs_write) && (fr_write)) {
-				struct ast_frame *cur;
+		if ((mixmonitor_ds->fs_write) && (fr_write)) {
+			struct ast_frame *cur;
 
-				for (cur = fr_write; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
-					ast_writestream(*fs_write, cur);
-				}
+			for (cur = fr_write; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
+				ast_writestream(mixmonitor_ds->fs_write, cur);
 			}
+		}
 
-			if ((*fs) && (fr)) {
-				struct ast_frame *cur;
+		if ((mixmonitor_ds->fs) && (fr)) {
+			struct ast_frame *cur;
 
-				for (cur = fr; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
-					ast_writestream(*fs, cur);
-				}
+			for (cur = fr; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
+				ast_writestream(mixmonitor_ds->fs, cur);
 			}
-			ast_mutex_unlock(&mixmonitor->mixmonitor_ds->lock);
 		}
-		/* All done! free it. */
-		if (fr) {
-			ast_frame_free(fr, 0);
-		}
-		if (fr_read) {
-			ast_frame_free(fr_read, 0);
-		}
-		if (fr_write) {
-			ast_frame_free(fr_write, 0);
-		}
-
-		fr = NULL;
-		fr_write = NULL;
-		fr_read = NULL;
 
-		ast_audiohook_lock(&mixmonitor->audiohook);
+		if (mixmonitor->flush_interval
+			&& ast_tvdiff_ms(ast_tvnow(), mixmonitor->last_flush) >= mixmonitor->flush_interval) {
+			mixmonitor_sync_fs(mixmonitor_ds->fs);
+			mixmonitor_sync_fs(mixmonitor_ds->fs_read);
+			mixmonitor_sync_fs(mixmonitor_ds->fs_write);
+			mixmonitor->last_flush = ast_tvnow();
+		}
+		ast_mutex_unlock(&mixmonitor_ds->lock);
 	}
+	/* All done! free it. */
+	if (fr) {
+		ast_frame_free(fr, 0);
+	}
+	if (fr_read) {
+		ast_frame_free(fr_read, 0);
+	}
+	if (fr_write) {
+		ast_frame_free(fr_write, 0);
+	}
+}
 
-	ast_audiohook_unlock(&mixmonitor->audiohook);
-
+/*!
+ * \internal
+ * \brief Finish a recording once its audiohook is done
+ *
+ * Closes the files, waits for the datastore to go away, runs the post
+ * process command and copies the recording to any voicemail recipients.
+ */
+static void mixmonitor_finish(struct mixmonitor *mixmonitor)
+{
 	if (ast_test_flag(mixmonitor, MUXFLAG_BEEP_STOP)) {
 		ast_autochan_channel_lock(mixmonitor->autochan);
 		ast_stream_and_wait(mixmonitor->autochan->chan, "beep", "");
@@ -840,20 +899,20 @@ static void *mixmonitor_thread(void *obj)
 	ast_test_suite_event_notify("MIXMONITOR_END", "File: %s\r\n", mixmonitor->filename);
 
 	if (!AST_LIST_EMPTY(&mixmonitor->recipient_list)) {
-		if (ast_strlen_zero(fs_ext)) {
+		if (ast_strlen_zero(mixmonitor->fs_ext)) {
 			ast_log(LOG_ERROR, "No file extension set for Mixmonitor %s. Skipping copy to voicemail.\n",
 				mixmonitor -> name);
 		} else {
 			ast_verb(3, "Copying recordings for Mixmonitor %s to voicemail recipients\n", mixmonitor->name);
-			copy_to_voicemail(mixmonitor, fs_ext, mixmonitor->filename);
+			copy_to_voicemail(mixmonitor, mixmonitor->fs_ext, mixmonitor->filename);
 		}
-		if (!ast_strlen_zero(fs_read_ext)) {
+		if (!ast_strlen_zero(mixmonitor->fs_read_ext)) {
 			ast_verb(3, "Copying read recording for Mixmonitor %s to voicemail recipients\n", mixmonitor->name);
-			copy_to_voicemail(mixmonitor, fs_read_ext, mixmonitor->filename_read);
+			copy_to_voicemail(mixmonitor, mixmonitor->fs_read_ext, mixmonitor->filename_read);
 		}
-		if (!ast_strlen_zero(fs_write_ext)) {
+		if (!ast_strlen_zero(mixmonitor->fs_write_ext)) {
 			ast_verb(3, "Copying write recording for Mixmonitor %s to voicemail recipients\n", mixmonitor->name);
-			copy_to_voicemail(mixmonitor, fs_write_ext, mixmonitor->filename_write);
+			copy_to_voicemail(mixmonitor, mixmonitor->fs_write_ext, mixmonitor->filename_write);
 		}
 	} else {
 		ast_debug(3, "No recipients to forward monitor to, moving on.\n");
@@ -862,9 +921,292 @@ static void *mixmonitor_thread(void *obj)
 	mixmonitor_free(mixmonitor);
 
 	ast_module_unref(ast_module_info->self);
+}
+
+static void *mixmonitor_thread(void *obj)
+{
+	struct mixmonitor *mixmonitor = obj;
+
+	/* Keep callid association before any log messages */
+	if (mixmonitor->callid) {
+		ast_callid_threadassoc_add(mixmonitor->callid);
+	}
+
+	mixmonitor_open(mixmonitor);
+
+	/* The audiohook must enter and exit the loop locked */
+	ast_audiohook_lock(&mixmonitor->audiohook);
+	while (mixmonitor->audiohook.status == AST_AUDIOHOOK_STATUS_RUNNING && !mixmonitor->mixmonitor_ds->fs_quit) {
+		struct ast_frame *fr = NULL;
+		struct ast_frame *fr_read = NULL;
+		struct ast_frame *fr_write = NULL;
+
+		if (!(fr = ast_audiohook_read_frame_all(&mixmonitor->audiohook, SAMPLES_PER_FRAME, mixmonitor->format_slin,
+						&fr_read, &fr_write))) {
+			ast_audiohook_trigger_wait(&mixmonitor->audiohook);
+
+			if (mixmonitor->audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING) {
+				break;
+			}
+			continue;
+		}
+
+		/* audiohook lock is not required for the next block.
+		 * Unlock it, but remember to lock it before looping or exiting */
+		ast_audiohook_unlock(&mixmonitor->audiohook);
+
+		mixmonitor_write_frames(mixmonitor, fr, fr_read, fr_write);
+
+		ast_audiohook_lock(&mixmonitor->audiohook);
+	}
+
+	ast_audiohook_unlock(&mixmonitor->audiohook);
+
+	mixmonitor_finish(mixmonitor);
+
 	return NULL;
 }
 
+static void *mixmonitor_finish_thread(void *obj)
+{
+	struct mixmonitor *mixmonitor = obj;
+
+	if (mixmonitor->callid) {
+		ast_callid_threadassoc_add(mixmonitor->callid);
+	}
+
+	mixmonitor_finish(mixmonitor);
+
+	return NULL;
+}
+
+/*!
+ * \brief A thread writing a share of the recordings.
+ *
+ * Instead of each recording having a thread of its own woken by its
+ * audiohook, the writer threads each wait on one timer and move whatever
+ * audio is ready for all of their recordings to disk on every tick.
+ */
+struct mixmonitor_writer {
+	/*! The thread itself */
+	pthread_t thread;
+	/*! Protects recordings */
+	ast_mutex_t lock;
+	/*! The recordings this thread writes */
+	AST_VECTOR(, struct mixmonitor *) recordings;
+	/*! Copy of recordings taken each tick, only used by the thread */
+	AST_VECTOR(, struct mixmonitor *) running;
+	/*! Ticks at the frame rate */
+	struct ast_timer *timer;
+	/*! Set to have the thread exit */
+	int stop;
+};
+
+/*! Protects starting and stopping the writer threads */
+AST_MUTEX_DEFINE_STATIC(writers_lock);
+/*! The writer threads, started when the first recording is pooled */
+static struct mixmonitor_writer *writers;
+/*! Number of writer threads running */
+static unsigned int writer_count;
+
+/*!
+ * \internal
+ * \brief Write out the audio ready for a recording
+ *
+ * \retval 1 if the recording is over
+ * \retval 0 otherwise
+ */
+static int mixmonitor_writer_service(struct mixmonitor *mixmonitor)
+{
+	int done;
+
+	ast_audiohook_lock(&mixmonitor->audiohook);
+	while (mixmonitor->audiohook.status == AST_AUDIOHOOK_STATUS_RUNNING && !mixmonitor->mixmonitor_ds->fs_quit) {
+		struct ast_frame *fr_read = NULL;
+		struct ast_frame *fr_write = NULL;
+		struct ast_frame *fr;
+
+		if (!(fr = ast_audiohook_read_frame_all(&mixmonitor->audiohook, SAMPLES_PER_FRAME, mixmonitor->format_slin,
+						&fr_read, &fr_write))) {
+			break;
+		}
+
+		ast_audiohook_unlock(&mixmonitor->audiohook);
+		mixmonitor_write_frames(mixmonitor, fr, fr_read, fr_write);
+		ast_audiohook_lock(&mixmonitor->audiohook);
+	}
+	done = mixmonitor->audiohook.status != AST_AUDIOHOOK_STATUS_RUNNING || mixmonitor->mixmonitor_ds->fs_quit;
+	ast_audiohook_unlock(&mixmonitor->audiohook);
+
+	return done;
+}
+
+#define MIXMONITOR_CMP(elem, value) ((elem) == (value))
+
+static void *mixmonitor_writer_run(void *data)
+{
+	struct mixmonitor_writer *writer = data;
+	struct pollfd pfd = { .fd = ast_timer_fd(writer->timer), .events = POLLIN, };
+	int i;
+
+	while (!writer->stop) {
+		if (ast_poll(&pfd, 1, 1000) <= 0) {
+			continue;
+		}
+		if (ast_timer_ack(writer->timer, 1) < 0) {
+			ast_log(LOG_ERROR, "Failed to acknowledge MixMonitor writer timer\n");
+			break;
+		}
+
+		ast_mutex_lock(&writer->lock);
+		for (i = 0; i < AST_VECTOR_SIZE(&writer->recordings); ++i) {
+			if (AST_VECTOR_APPEND(&writer->running, AST_VECTOR_GET(&writer->recordings, i))) {
+				break;
+			}
+		}
+		ast_mutex_unlock(&writer->lock);
+
+		for (i = 0; i < AST_VECTOR_SIZE(&writer->running); ++i) {
+			struct mixmonitor *mixmonitor = AST_VECTOR_GET(&writer->running, i);
+			pthread_t thread;
+
+			ast_callid_threadassoc_change(mixmonitor->callid);
+			/* The files are opened on the first tick, not by the channel */
+			if (!mixmonitor->format_slin) {
+				mixmonitor_open(mixmonitor);
+			}
+			if (!mixmonitor_writer_service(mixmonitor)) {
+				continue;
+			}
+
+			ast_mutex_lock(&writer->lock);
+			AST_VECTOR_REMOVE_CMP_UNORDERED(&writer->recordings, mixmonitor, MIXMONITOR_CMP,
+				AST_VECTOR_ELEM_CLEANUP_NOOP);
+			ast_mutex_unlock(&writer->lock);
+
+			/* Finishing waits on the channel and runs the post process
+			 * command, so it must not hold up the other recordings. */
+			if (ast_pthread_create_detached_background(&thread, NULL, mixmonitor_finish_thread, mixmonitor)) {
+				mixmonitor_finish(mixmonitor);
+			}
+		}
+		ast_callid_threadassoc_change(0);
+		AST_VECTOR_RESET(&writer->running, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	}
+
+	return NULL;
+}
+
+static void mixmonitor_writers_stop(void)
+{
+	unsigned int count;
+	unsigned int i;
+
+	ast_mutex_lock(&writers_lock);
+	count = writer_count;
+	writer_count = 0;
+	for (i = 0; i < count; ++i) {
+		writers[i].stop = 1;
+	}
+	for (i = 0; i < count; ++i) {
+		struct mixmonitor_writer *writer = &writers[i];
+
+		pthread_join(writer->thread, NULL);
+		AST_VECTOR_FREE(&writer->recordings);
+		AST_VECTOR_FREE(&writer->running);
+		ast_timer_close(writer->timer);
+		ast_mutex_destroy(&writer->lock);
+	}
+	ast_free(writers);
+	writers = NULL;
+	ast_mutex_unlock(&writers_lock);
+}
+
+/*!
+ * \internal
+ * \brief Start the writer threads if they are not yet running
+ *
+ * \pre writers_lock is locked
+ *
+ * \retval 0 if the writer threads are running
+ * \retval -1 if they could not be started
+ */
+static int mixmonitor_writers_start(unsigned int count)
+{
+	static int warned;
+	unsigned int started = 0;
+	int res = 0;
+
+	if (writer_count) {
+		return 0;
+	}
+	if (!(writers = ast_calloc(count, sizeof(*writers)))) {
+		return -1;
+	}
+	while (started < count) {
+		struct mixmonitor_writer *writer = &writers[started];
+
+		ast_mutex_init(&writer->lock);
+		if (AST_VECTOR_INIT(&writer->recordings, 64) || AST_VECTOR_INIT(&writer->running, 64)
+			|| !(writer->timer = ast_timer_open())) {
+			res = -1;
+		} else if (ast_timer_set_rate(writer->timer, 50)
+			|| ast_pthread_create_background(&writer->thread, NULL, mixmonitor_writer_run, writer)) {
+			ast_timer_close(writer->timer);
+			res = -1;
+		}
+		if (res) {
+			AST_VECTOR_FREE(&writer->recordings);
+			AST_VECTOR_FREE(&writer->running);
+			ast_mutex_destroy(&writer->lock);
+			if (!warned) {
+				ast_log(LOG_WARNING, "Unable to start MixMonitor writer thread %u of %u\n", started + 1, count);
+				warned = 1;
+			}
+			break;
+		}
+		++started;
+	}
+	if (!started) {
+		ast_free(writers);
+		writers = NULL;
+	}
+	writer_count = started;
+
+	return started ? 0 : -1;
+}
+
+/*!
+ * \internal
+ * \brief Hand a recording to the writer thread with the fewest recordings
+ *
+ * \retval 0 if a writer thread now owns the recording
+ * \retval -1 if the recording needs a thread of its own
+ */
+static int mixmonitor_writers_add(struct mixmonitor *mixmonitor, unsigned int count)
+{
+	struct mixmonitor_writer *writer = NULL;
+	unsigned int i;
+	int res;
+
+	ast_mutex_lock(&writers_lock);
+	if (mixmonitor_writers_start(count)) {
+		ast_mutex_unlock(&writers_lock);
+		return -1;
+	}
+	for (i = 0; i < writer_count; ++i) {
+		if (!writer || AST_VECTOR_SIZE(&writers[i].recordings) < AST_VECTOR_SIZE(&writer->recordings)) {
+			writer = &writers[i];
+		}
+	}
+	ast_mutex_lock(&writer->lock);
+	res = AST_VECTOR_APPEND(&writer->recordings, mixmonitor);
+	ast_mutex_unlock(&writer->lock);
+	ast_mutex_unlock(&writers_lock);
+
+	return res ? -1 : 0;
+}
+
 static int setup_mixmonitor_ds(struct mixmonitor *mixmonitor, struct ast_channel *chan, char **datastore_id, const char *beep_id)
 {
 	struct ast_datastore *datastore = NULL;
@@ -934,12 +1276,14 @@ static int launch_monitor_thread(struct ast_channel *chan, const char *filename,
 				  unsigned int flags, int readvol, int writevol,
 				  const char *post_process, const char *filename_write,
 				  char *filename_read, const char *uid_channel_var,
-				  const char *recipients, const char *beep_id)
+				  const char *recipients, const char *beep_id,
+				  int flush)
 {
 	pthread_t thread;
 	struct mixmonitor *mixmonitor;
 	char postprocess2[1024] = "";
 	char *datastore_id = NULL;
+	unsigned int count;
 
 	postprocess2[0] = 0;
 	/* If a post process system command is given attach it to the structure */
@@ -976,6 +1320,11 @@ static int launch_monitor_thread(struct ast_channel *chan, const char *filename,
 
 	/* Copy over flags and channel name */
 	mixmonitor->flags = flags;
+	mixmonitor->fs_ext = "";
+	mixmonitor->fs_read_ext = "";
+	mixmonitor->fs_write_ext = "";
+	mixmonitor->write_buffer_size = write_buffer_size;
+	mixmonitor->flush_interval = flush < 0 ? flush_interval : flush;
 	if (!(mixmonitor->autochan = ast_autochan_setup(chan))) {
 		mixmonitor_free(mixmonitor);
 		return -1;
@@ -1067,6 +1416,11 @@ static int launch_monitor_thread(struct ast_channel *chan, const char *filename,
 	/* reference be released at mixmonitor destruction */
 	mixmonitor->callid = ast_read_threadstorage_callid();
 
+	count = writer_threads;
+	if (count && !mixmonitor_writers_add(mixmonitor, count)) {
+		return 0;
+	}
+
 	return ast_pthread_create_detached_background(&thread, NULL, mixmonitor_thread, mixmonitor);
 }
 
@@ -1085,6 +1439,12 @@ static char *filename_parse(char *filename, char *buffer, size_t len)
 		return buffer;
 	}
 
+	/* A recording streamed to a sink has no path or directories */
+	if (ast_file_is_sink(filename)) {
+		ast_copy_string(buffer, filename, len);
+		return buffer;
+	}
+
 	/* If we don't have an absolute path, make one */
 	if (*filename != '/') {
 		char *build = ast_alloca(strlen(ast_config_AST_MONITOR_DIR) + strlen(filename) + 3);
@@ -1120,6 +1480,7 @@ static int mixmonitor_exec(struct ast_channel *chan, const char *data)
 	char filename_buffer[1024] = "";
 	char *uid_channel_var = NULL;
 	char beep_id[64] = "";
+	int flush = -1;
 
 	struct ast_flags flags = { 0 };
 	char *recipients = NULL;
@@ -1180,6 +1541,16 @@ static int mixmonitor_exec(struct ast_channel *chan, const char *data)
 			}
 		}
 
+		if (ast_test_flag(&flags, MUXFLAG_FLUSH)) {
+			if (ast_strlen_zero(opts[OPT_ARG_FLUSH])) {
+				ast_log(LOG_WARNING, "No interval was provided for the flush ('F') option.\n");
+			} else if ((sscanf(opts[OPT_ARG_FLUSH], "%30d", &x) != 1) || (x < 0)) {
+				ast_log(LOG_NOTICE, "Flush interval must be a number of milliseconds, not '%s'\n", opts[OPT_ARG_FLUSH]);
+			} else {
+				flush = x;
+			}
+		}
+
 		if (ast_test_flag(&flags, MUXFLAG_VMRECIPIENTS)) {
 			if (ast_strlen_zero(opts[OPT_ARG_VMRECIPIENTS])) {
 				ast_log(LOG_WARNING, "No voicemail recipients were specified for the vm copy ('m') option.\n");
@@ -1241,7 +1612,8 @@ static int mixmonitor_exec(struct ast_channel *chan, const char *data)
 			filename_read,
 			uid_channel_var,
 			recipients,
-			beep_id)) {
+			beep_id,
+			flush)) {
 		ast_module_unref(ast_module_info->self);
 	}
 
@@ -1663,6 +2035,55 @@ static int clear_mixmonitor_methods(void)
 	return ast_clear_mixmonitor_methods();
 }
 
+static int load_config(int reload)
+{
+	struct ast_flags config_flags = { reload ? CONFIG_FLAG_FILEUNCHANGED : 0 };
+	struct ast_config *cfg;
+	struct ast_variable *var;
+	unsigned int threads = 0;
+	unsigned int buffer_kb = 0;
+	unsigned int interval = 0;
+
+	cfg = ast_config_load(config, config_flags);
+	if (cfg == CONFIG_STATUS_FILEUNCHANGED) {
+		return 0;
+	} else if (cfg == CONFIG_STATUS_FILEINVALID) {
+		ast_log(LOG_ERROR, "Config file %s is in an invalid format.  Aborting.\n", config);
+		return -1;
+	}
+
+	for (var = cfg ? ast_variable_browse(cfg, "general") : NULL; var; var = var->next) {
+		if (!strcasecmp(var->name, "writer_threads")) {
+			if (sscanf(var->value, "%30u", &threads) != 1) {
+				ast_log(LOG_WARNING, "Invalid writer_threads '%s' at line %d of %s\n", var->value, var->lineno, config);
+				threads = 0;
+			}
+		} else if (!strcasecmp(var->name, "write_buffer")) {
+			if (sscanf(var->value, "%30u", &buffer_kb) != 1 || buffer_kb > 4096) {
+				ast_log(LOG_WARNING, "Invalid write_buffer '%s' at line %d of %s\n", var->value, var->lineno, config);
+				buffer_kb = 0;
+			}
+		} else if (!strcasecmp(var->name, "flush_interval")) {
+			if (sscanf(var->value, "%30u", &interval) != 1) {
+				ast_log(LOG_WARNING, "Invalid flush_interval '%s' at line %d of %s\n", var->value, var->lineno, config);
+				interval = 0;
+			}
+		} else {
+			ast_log(LOG_WARNING, "Unknown option %s at line %d of %s\n", var->name, var->lineno, config);
+		}
+	}
+
+	writer_threads = threads;
+	write_buffer_size = buffer_kb * 1024;
+	flush_interval = interval;
+
+	if (cfg) {
+		ast_config_destroy(cfg);
+	}
+
+	return 0;
+}
+
 static int unload_module(void)
 {
 	int res;
@@ -1676,6 +2097,8 @@ static int unload_module(void)
 	res |= ast_custom_function_unregister(&mixmonitor_function);
 	res |= clear_mixmonitor_methods();
 
+	mixmonitor_writers_stop();
+
 	return res;
 }
 
@@ -1683,6 +2106,10 @@ static int load_module(void)
 {
 	int res;
 
+	if (load_config(0)) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	ast_cli_register_multiple(cli_mixmonitor, ARRAY_LEN(cli_mixmonitor));
 	res = ast_register_application_xml(app, mixmonitor_exec);
 	res |= ast_register_application_xml(stop_app, stop_mixmonitor_exec);
@@ -1695,9 +2122,15 @@ static int load_module(void)
 	return res;
 }
 
+static int reload_module(void)
+{
+	return load_config(1);
+}
+
 AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_DEFAULT, "Mixed Audio Monitoring Application",
 	.support_level = AST_MODULE_SUPPORT_CORE,
 	.load = load_module,
 	.unload = unload_module,
+	.reload = reload_module,
 	.optional_modules = "func_periodic_hook",
 );
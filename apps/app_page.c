@@ -108,6 +108,16 @@
 					<option name="n">
 						<para>Do not play announcement to caller (alters <literal>A(x)</literal> behavior)</para>
 					</option>
+					<option name="o">
+						<para>One-way broadcast.  Instead of a conference the paged
+						devices join a holding bridge (<literal>BridgeWait</literal>) with the
+						caller as announcer.  There is no mixing, and the caller's audio
+						is encoded once for each codec in use and shared by all devices
+						using it.  Devices listening to a multicast group can be reached
+						by paging a <literal>MulticastRTP</literal> destination.  Ignored
+						together with the <literal>d</literal>, <literal>r</literal> or
+						<literal>A(x)</literal> options.</para>
+					</option>
 				</optionlist>
 			</parameter>
 			<parameter name="timeout">
@@ -139,6 +149,7 @@ enum page_opt_flags {
 	PAGE_NOCALLERANNOUNCE = (1 << 6),
 	PAGE_PREDIAL_CALLEE = (1 << 7),
 	PAGE_PREDIAL_CALLER = (1 << 8),
+	PAGE_BROADCAST = (1 << 9),
 };
 
 enum {
@@ -158,6 +169,7 @@ AST_APP_OPTIONS(page_opts, {
 	AST_APP_OPTION('i', PAGE_IGNORE_FORWARDS),
 	AST_APP_OPTION_ARG('A', PAGE_ANNOUNCE, OPT_ARG_ANNOUNCE),
 	AST_APP_OPTION('n', PAGE_NOCALLERANNOUNCE),
+	AST_APP_OPTION('o', PAGE_BROADCAST),
 });
 
 #define PAGE_BEEP "beep"
@@ -243,6 +255,11 @@ static void page_state_callback(struct ast_dial *dial)
 		return;
 	}
 
+	if (ast_test_flag(&options->flags, PAGE_BROADCAST)) {
+		/* There are no ConfBridge profiles in a holding bridge */
+		return;
+	}
+
 	setup_profile_bridge(chan, options);
 	setup_profile_paged(chan, options);
 }
@@ -272,11 +289,6 @@ static int page_exec(struct ast_channel *chan, const char *data)
 		AST_APP_ARG(timeout);
 	);
 
-	if (!(app = pbx_findapp("ConfBridge"))) {
-		ast_log(LOG_WARNING, "There is no ConfBridge application available!\n");
-		return -1;
-	};
-
 	parse = ast_strdupa(data ?: "");
 
 	AST_STANDARD_APP_ARGS(args, parse);
@@ -290,11 +302,32 @@ static int page_exec(struct ast_channel *chan, const char *data)
 		ast_app_parse_options(page_opts, &options.flags, options.opts, args.options);
 	}
 
+	if (ast_test_flag(&options.flags, PAGE_BROADCAST)
+		&& ast_test_flag(&options.flags, PAGE_DUPLEX | PAGE_RECORD | PAGE_ANNOUNCE)) {
+		ast_verb(3, "Broadcast page not possible with duplex audio, recording or announcements, using a conference\n");
+		ast_clear_flag(&options.flags, PAGE_BROADCAST);
+	}
+
+	if (ast_test_flag(&options.flags, PAGE_BROADCAST)) {
+		if (!(app = pbx_findapp("BridgeWait"))) {
+			ast_log(LOG_WARNING, "There is no BridgeWait application available!\n");
+			return -1;
+		}
+	} else if (!(app = pbx_findapp("ConfBridge"))) {
+		ast_log(LOG_WARNING, "There is no ConfBridge application available!\n");
+		return -1;
+	}
+
 	if (!ast_strlen_zero(args.timeout)) {
 		timeout = atoi(args.timeout);
 	}
 
-	snprintf(confbridgeopts, sizeof(confbridgeopts), "ConfBridge,%u", confid);
+	if (ast_test_flag(&options.flags, PAGE_BROADCAST)) {
+		/* The paged devices only listen, so they need no entertainment either */
+		snprintf(confbridgeopts, sizeof(confbridgeopts), "BridgeWait,page-%u,participant,e(n)", confid);
+	} else {
+		snprintf(confbridgeopts, sizeof(confbridgeopts), "ConfBridge,%u", confid);
+	}
 
 	/* Count number of extensions in list by number of ampersands + 1 */
 	num_dials = 1;
@@ -414,7 +447,10 @@ static int page_exec(struct ast_channel *chan, const char *data)
 		}
 	}
 
-	if (!res) {
+	if (!res && ast_test_flag(&options.flags, PAGE_BROADCAST)) {
+		snprintf(confbridgeopts, sizeof(confbridgeopts), "page-%u,announcer", confid);
+		pbx_exec(chan, app, confbridgeopts);
+	} else if (!res) {
 		setup_profile_bridge(chan, &options);
 		setup_profile_caller(chan, &options);
 
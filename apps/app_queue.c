@@ -1435,6 +1435,7 @@ static const struct autopause {
 #define DEFAULT_RETRY		5
 #define DEFAULT_TIMEOUT		15
 #define RECHECK			1		/*!< Recheck every second to see we we're at the top yet */
+#define AVAIL_RECOUNT		1000		/*!< Most milliseconds the count of available members is used before counting again */
 #define MAX_PERIODIC_ANNOUNCEMENTS 10           /*!< The maximum periodic announcements we can have */
 /*!
  * \brief The minimum number of seconds between position announcements.
@@ -1495,6 +1496,9 @@ static int negative_penalty_invalid;
 /*! \brief queues.conf [general] option */
 static int log_membername_as_agent;
 
+/*! \brief queues.conf [general] option */
+static int realtime_cache_time;
+
 /*! \brief name of the ringinuse field in the realtime database */
 static char *realtime_ringinuse_field;
 
@@ -1581,6 +1585,7 @@ struct queue_ent {
 	int opos;                              /*!< Where we started in the queue */
 	int handled;                           /*!< Whether our call was handled */
 	int pending;                           /*!< Non-zero if we are attempting to call a member */
+	int woken;                             /*!< Non-zero if queue_wake_callers() found it may be our turn */
 	int max_penalty;                       /*!< Limit the members that can take this call to this penalty or lower */
 	int min_penalty;                       /*!< Limit the members that can take this call to this penalty or higher */
 	int raise_penalty;                     /*!< Float lower penalty mambers to a minimum penalty */
@@ -1754,6 +1759,9 @@ struct call_queue {
 	int rrpos;                          /*!< Round Robin - position */
 	int memberdelay;                    /*!< Seconds to delay connecting member to caller */
 	int autofill;                       /*!< Ignore the head call status and ring an available agent */
+	int avail_count;                    /*!< Available members, as last counted by num_available_members() */
+	struct timeval avail_expire;        /*!< When avail_count has to be counted again */
+	struct timeval rt_expire;           /*!< When the realtime queue and members have to be loaded again */
 
 	struct ao2_container *members;      /*!< Head of the list of members */
 	struct queue_ent *head;             /*!< Head of the list of callers */
@@ -1775,6 +1783,7 @@ static void update_realtime_members(struct call_queue *q);
 static struct member *interface_exists(struct call_queue *q, const char *interface);
 static int set_member_paused(const char *queuename, const char *interface, const char *reason, int paused);
 static int update_queue(struct call_queue *q, struct member *member, int callcompletedinsl, time_t starttime);
+static void queue_wake_callers(struct call_queue *q);
 
 static struct member *find_member_by_queuename_and_interface(const char *queuename, const char *interface);
 /*! \brief sets the QUEUESTATUS channel variable */
@@ -1867,6 +1876,20 @@ static int get_wrapuptime(struct call_queue *q, struct member *member)
 	return q->wrapuptime;
 }
 
+/*!
+ * \internal
+ * \brief Have num_available_members() count the members of a queue again
+ *
+ * Called whenever something is changed that can make a member available
+ * or unavailable.
+ *
+ * \pre The q is locked on entry.
+ */
+static void queue_avail_changed(struct call_queue *q)
+{
+	q->avail_expire = ast_tv(0, 0);
+}
+
 /*! \internal
  * \brief ao2_callback, Decreases queuepos of all followers with a queuepos greater than arg.
  * \param obj the member being acted on
@@ -2435,6 +2458,123 @@ static void pending_members_remove(struct member *mem)
 	ao2_find(pending_members, mem, OBJ_POINTER | OBJ_NODATA | OBJ_UNLINK);
 }
 
+/*!
+ * \brief Members of all queues, by the device they read their state from
+ *
+ * A device state change only has to look at the members it affects
+ * instead of every member of every queue.  Each entry holds the name of
+ * the queue the member is in rather than a reference to it, as queues
+ * only let go of their members when they are destroyed.
+ */
+static struct ao2_container *member_devices;
+#define MAX_MEMBER_DEVICE_BUCKETS 353
+
+/*! \brief A member reading its state from a device, and the queue it is in */
+struct member_device_entry {
+	struct member *member;
+	char *queue;
+};
+
+/*! \brief The members reading their state from one device */
+struct member_device {
+	AST_VECTOR(, struct member_device_entry) entries;
+	char device[0];
+};
+
+AO2_STRING_FIELD_CASE_HASH_FN(member_device, device)
+AO2_STRING_FIELD_CASE_CMP_FN(member_device, device)
+
+static void member_device_entry_cleanup(struct member_device_entry entry)
+{
+	ao2_ref(entry.member, -1);
+	ast_free(entry.queue);
+}
+
+#define MEMBER_DEVICE_ENTRY_CMP(elem, value) ((elem).member == (value))
+
+static void member_device_destroy(void *obj)
+{
+	struct member_device *dev = obj;
+
+	AST_VECTOR_RESET(&dev->entries, member_device_entry_cleanup);
+	AST_VECTOR_FREE(&dev->entries);
+}
+
+/*! \brief The device a member reads its state from, as device state changes name it */
+static void member_device_name(const struct member *mem, char *device, size_t size)
+{
+	char *slash_pos;
+
+	ast_copy_string(device, mem->state_interface, size);
+	if ((slash_pos = strchr(device, '/'))) {
+		if (!strncasecmp(device, "Local/", 6) && (slash_pos = strchr(slash_pos + 1, '/'))) {
+			*slash_pos = '\0';
+		}
+	}
+}
+
+/*! \brief Add a member of a queue to member_devices, under its current state_interface */
+static void member_device_add(struct call_queue *q, struct member *mem)
+{
+	char device[sizeof(mem->state_interface)];
+	struct member_device_entry entry;
+	struct member_device *dev;
+
+	if (!member_devices) {
+		return;
+	}
+
+	member_device_name(mem, device, sizeof(device));
+
+	ao2_wrlock(member_devices);
+	dev = ao2_find(member_devices, device, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!dev) {
+		dev = ao2_alloc_options(sizeof(*dev) + strlen(device) + 1, member_device_destroy,
+			AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (dev) {
+			strcpy(dev->device, device); /* Safe */
+			if (AST_VECTOR_INIT(&dev->entries, 1) || !ao2_link_flags(member_devices, dev, OBJ_NOLOCK)) {
+				ao2_ref(dev, -1);
+				dev = NULL;
+			}
+		}
+	}
+	if (dev) {
+		entry.member = ao2_bump(mem);
+		entry.queue = ast_strdup(q->name);
+		if (!entry.queue || AST_VECTOR_APPEND(&dev->entries, entry)) {
+			member_device_entry_cleanup(entry);
+		}
+		ao2_ref(dev, -1);
+	}
+	ao2_unlock(member_devices);
+}
+
+/*! \brief Remove a member from member_devices, before its state_interface changes */
+static void member_device_remove(struct member *mem)
+{
+	char device[sizeof(mem->state_interface)];
+	struct member_device *dev;
+
+	if (!member_devices) {
+		return;
+	}
+
+	member_device_name(mem, device, sizeof(device));
+
+	ao2_wrlock(member_devices);
+	dev = ao2_find(member_devices, device, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (dev) {
+		AST_VECTOR_REMOVE_CMP_UNORDERED(&dev->entries, mem, MEMBER_DEVICE_ENTRY_CMP,
+			member_device_entry_cleanup);
+		if (!AST_VECTOR_SIZE(&dev->entries)) {
+			ao2_unlink_flags(member_devices, dev, OBJ_NOLOCK);
+		}
+		ao2_ref(dev, -1);
+	}
+	ao2_unlock(member_devices);
+}
+
 /*! \brief set a member's status based on device state of that member's state_interface.
  *
  * Lock interface list find sc, iterate through each queues queue_member list for member to
@@ -2452,6 +2592,8 @@ static void update_status(struct call_queue *q, struct member *m, const int stat
 		}
 
 		m->status = status;
+		queue_avail_changed(q);
+		queue_wake_callers(q);
 
 		/* Remove the member from the pending members pool only when the status changes.
 		 * This is not done unconditionally because we can occasionally see multiple
@@ -2505,17 +2647,32 @@ static int is_member_available(struct call_queue *q, struct member *mem)
 	return available;
 }
 
+/*! \brief Check if any member of a queue is available */
+static int queue_has_available_member(struct call_queue *q)
+{
+	struct ao2_iterator miter;
+	struct member *m;
+	int avail = 0;
+
+	miter = ao2_iterator_init(q->members, 0);
+	for (; !avail && (m = ao2_iterator_next(&miter)); ao2_ref(m, -1)) {
+		avail = is_member_available(q, m);
+	}
+	ao2_iterator_destroy(&miter);
+
+	return avail;
+}
+
 /*! \brief set a member's status based on device state of that member's interface*/
 static void device_state_cb(void *unused, struct stasis_subscription *sub, struct stasis_message *msg)
 {
-	struct ao2_iterator miter, qiter;
+	AST_VECTOR(, struct member_device_entry) entries;
 	struct ast_device_state_message *dev_state;
+	struct member_device *dev;
 	struct member *m;
 	struct call_queue *q;
-	char interface[80], *slash_pos;
 	int found = 0;			/* Found this member in any queue */
-	int found_member;		/* Found this member in this queue */
-	int avail = 0;			/* Found an available member in this queue */
+	int i;
 
 	if (ast_device_state_message_type() != stasis_message_type(msg)) {
 		return;
@@ -2527,55 +2684,51 @@ static void device_state_cb(void *unused, struct stasis_subscription *sub, struc
 		return;
 	}
 
-	qiter = ao2_iterator_init(queues, 0);
-	while ((q = ao2_t_iterator_next(&qiter, "Iterate over queues"))) {
-		ao2_lock(q);
-
-		avail = 0;
-		found_member = 0;
-		miter = ao2_iterator_init(q->members, 0);
-		for (; (m = ao2_iterator_next(&miter)); ao2_ref(m, -1)) {
-			if (!found_member) {
-				ast_copy_string(interface, m->state_interface, sizeof(interface));
+	/* Copy the members of the device out, queues are locked before member_devices */
+	AST_VECTOR_INIT(&entries, 0);
+	ao2_rdlock(member_devices);
+	dev = ao2_find(member_devices, dev_state->device, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	for (i = 0; dev && i < AST_VECTOR_SIZE(&dev->entries); ++i) {
+		struct member_device_entry entry = AST_VECTOR_GET(&dev->entries, i);
 
-				if ((slash_pos = strchr(interface, '/'))) {
-					if (!strncasecmp(interface, "Local/", 6) && (slash_pos = strchr(slash_pos + 1, '/'))) {
-						*slash_pos = '\0';
-					}
-				}
+		entry.member = ao2_bump(entry.member);
+		entry.queue = ast_strdup(entry.queue);
+		if (!entry.queue || AST_VECTOR_APPEND(&entries, entry)) {
+			member_device_entry_cleanup(entry);
+		}
+	}
+	ao2_unlock(member_devices);
+	ao2_cleanup(dev);
 
-				if (!strcasecmp(interface, dev_state->device)) {
-					found_member = 1;
-					update_status(q, m, dev_state->state);
-				}
-			}
+	for (i = 0; i < AST_VECTOR_SIZE(&entries); ++i) {
+		struct member_device_entry *entry = AST_VECTOR_GET_ADDR(&entries, i);
+		struct call_queue tmpq = {
+			.name = entry->queue,
+		};
 
-			/* check every member until we find one NOT_INUSE */
-			if (!avail) {
-				avail = is_member_available(q, m);
-			}
-			if (avail && found_member) {
-				/* early exit as we've found an available member and the member of interest */
-				ao2_ref(m, -1);
-				break;
-			}
+		if (!(q = ao2_t_find(queues, &tmpq, OBJ_POINTER, "Find queue of member"))) {
+			continue;
 		}
+		ao2_lock(q);
 
-		if (found_member) {
+		/* The member may have left the queue since it was copied */
+		m = ao2_find(q->members, entry->member, OBJ_POINTER);
+		if (m == entry->member) {
 			found = 1;
-			if (avail) {
+			update_status(q, m, dev_state->state);
+			if (queue_has_available_member(q)) {
 				ast_devstate_changed(AST_DEVICE_NOT_INUSE, AST_DEVSTATE_CACHABLE, "Queue:%s_avail", q->name);
 			} else {
 				ast_devstate_changed(AST_DEVICE_INUSE, AST_DEVSTATE_CACHABLE, "Queue:%s_avail", q->name);
 			}
 		}
-
-		ao2_iterator_destroy(&miter);
+		ao2_cleanup(m);
 
 		ao2_unlock(q);
-		queue_t_unref(q, "Done with iterator");
+		queue_t_unref(q, "Done with member queue");
 	}
-	ao2_iterator_destroy(&qiter);
+	AST_VECTOR_RESET(&entries, member_device_entry_cleanup);
+	AST_VECTOR_FREE(&entries);
 
 	if (found) {
 		ast_debug(1, "Device '%s' changed to state '%u' (%s)\n",
@@ -2886,6 +3039,7 @@ static void clear_queue(struct call_queue *q)
 			ao2_ref(mem, -1);
 		}
 		ao2_iterator_destroy(&mem_iter);
+		queue_avail_changed(q);
 	}
 }
 
@@ -3368,6 +3522,8 @@ static void member_add_to_queue(struct call_queue *queue, struct member *mem)
 	ao2_lock(queue->members);
 	mem->queuepos = ao2_container_count(queue->members);
 	ao2_link(queue->members, mem);
+	member_device_add(queue, mem);
+	queue_avail_changed(queue);
 	ast_devstate_changed(mem->paused ? QUEUE_PAUSED_DEVSTATE : QUEUE_UNPAUSED_DEVSTATE,
 		AST_DEVSTATE_CACHABLE, "Queue:%s_pause_%s", queue->name, mem->interface);
 	ao2_unlock(queue->members);
@@ -3386,6 +3542,8 @@ static void member_remove_from_queue(struct call_queue *queue, struct member *me
 	ast_devstate_changed(QUEUE_UNKNOWN_PAUSED_DEVSTATE, AST_DEVSTATE_CACHABLE, "Queue:%s_pause_%s", queue->name, mem->interface);
 	queue_member_follower_removal(queue, mem);
 	ao2_unlink(queue->members, mem);
+	member_device_remove(mem);
+	queue_avail_changed(queue);
 	ao2_unlock(queue->members);
 }
 
@@ -3474,11 +3632,15 @@ static void rt_handle_member_record(struct call_queue *q, char *category, struct
 					AST_DEVSTATE_CACHABLE, "Queue:%s_pause_%s", q->name, m->interface);
 			}
 			if (strcasecmp(state_interface, m->state_interface)) {
+				member_device_remove(m);
 				ast_copy_string(m->state_interface, state_interface, sizeof(m->state_interface));
+				member_device_add(q, m);
 			}
 			m->penalty = penalty;
 			m->ringinuse = ringinuse;
 			m->wrapuptime = wrapuptime;
+			queue_avail_changed(q);
+			queue_wake_callers(q);
 			found = 1;
 			ao2_ref(m, -1);
 			break;
@@ -3705,6 +3867,39 @@ static struct call_queue *find_queue_by_name_rt(const char *queuename, struct as
  * \retval the queue
  * \retval NULL if it doesn't exist
  */
+/*!
+ * \internal
+ * \brief Check if what was last loaded from realtime for a queue can still be used
+ *
+ * \retval 1 if the queue and its realtime members need not be loaded again yet
+ * \retval 0 if they have to be loaded
+ */
+static int realtime_cache_fresh(struct call_queue *q)
+{
+	int fresh;
+
+	ao2_lock(q);
+	fresh = ast_tvcmp(ast_tvnow(), q->rt_expire) < 0;
+	ao2_unlock(q);
+
+	return fresh;
+}
+
+/*!
+ * \internal
+ * \brief Record that a queue and its realtime members were just loaded from realtime
+ */
+static void realtime_cache_loaded(struct call_queue *q)
+{
+	if (!realtime_cache_time) {
+		return;
+	}
+
+	ao2_lock(q);
+	q->rt_expire = ast_tvadd(ast_tvnow(), ast_samp2tv(realtime_cache_time, 1));
+	ao2_unlock(q);
+}
+
 static struct call_queue *find_load_queue_rt_friendly(const char *queuename)
 {
 	struct ast_variable *queue_vars;
@@ -3717,6 +3912,10 @@ static struct call_queue *find_load_queue_rt_friendly(const char *queuename)
 	/* Find the queue in the in-core list first. */
 	q = ao2_t_find(queues, &tmpq, OBJ_POINTER, "Look for queue in memory first");
 
+	if (q && q->realtime && realtime_cache_fresh(q)) {
+		return q;
+	}
+
 	if (!q || q->realtime) {
 		/*! \note Load from realtime before taking the "queues" container lock, to avoid blocking all
 		   queue operations while waiting for the DB.
@@ -3746,6 +3945,7 @@ static struct call_queue *find_load_queue_rt_friendly(const char *queuename)
 
 		/* update the use_weight value if the queue's has gained or lost a weight */
 		if (q) {
+			realtime_cache_loaded(q);
 			if (!q->weight && prev_weight) {
 				ast_atomic_fetchadd_int(&use_weight, -1);
 			}
@@ -3783,6 +3983,11 @@ static void update_realtime_members(struct call_queue *q)
 	char *category = NULL;
 	struct ao2_iterator mem_iter;
 
+	if (realtime_cache_fresh(q)) {
+		return;
+	}
+	realtime_cache_loaded(q);
+
 	if (!(member_config = ast_load_realtime_multientry("queue_members", "interface LIKE", "%", "queue_name", q->name , SENTINEL))) {
 		/* This queue doesn't have realtime members. If the queue still has any realtime
 		 * members in memory, they need to be removed.
@@ -4189,6 +4394,8 @@ static void leave_queue(struct queue_ent *qe)
 			} else {
 				q->head = current->next;
 			}
+			/* Whoever was behind us may be close enough to the front now */
+			queue_wake_callers(q);
 			/* Free penalty rules */
 			while ((pr_iter = AST_LIST_REMOVE_HEAD(&qe->qe_rules, list))) {
 				ast_free(pr_iter);
@@ -4205,7 +4412,7 @@ static void leave_queue(struct queue_ent *qe)
 	ao2_unlock(q);
 
 	/*If the queue is a realtime queue, check to see if it's still defined in real time*/
-	if (q->realtime) {
+	if (q->realtime && !realtime_cache_fresh(q)) {
 		struct ast_variable *var;
 		if (!(var = ast_load_realtime("queues", "name", q->name, SENTINEL))) {
 			q->dead = 1;
@@ -4295,33 +4502,87 @@ static void hangupcalls(struct queue_ent *qe, struct callattempt *outgoing, stru
  */
 static int num_available_members(struct call_queue *q)
 {
-	struct member *mem;
-	int avl = 0;
-	struct ao2_iterator mem_iter;
+	struct timeval now = ast_tvnow();
 
-	mem_iter = ao2_iterator_init(q->members, 0);
-	while ((mem = ao2_iterator_next(&mem_iter))) {
+	/*
+	 * Every waiting caller asks this every RECHECK seconds, so the count is
+	 * kept until something changes, the wrapup time of a member ends or
+	 * AVAIL_RECOUNT passes, whichever is first.
+	 */
+	if (ast_tvcmp(now, q->avail_expire) >= 0) {
+		struct member *mem;
+		struct ao2_iterator mem_iter;
+		struct timeval expire = ast_tvadd(now, ast_samp2tv(AVAIL_RECOUNT, 1000));
+		int avl = 0;
 
-		avl += is_member_available(q, mem);
-		ao2_ref(mem, -1);
+		mem_iter = ao2_iterator_init(q->members, 0);
+		while ((mem = ao2_iterator_next(&mem_iter))) {
+			int wrapuptime = get_wrapuptime(q, mem);
 
-		/* If autofill is not enabled or if the queue's strategy is ringall, then
-		 * we really don't care about the number of available members so much as we
-		 * do that there is at least one available.
-		 *
-		 * In fact, we purposely will return from this function stating that only
-		 * one member is available if either of those conditions hold. That way,
-		 * functions which determine what action to take based on the number of available
-		 * members will operate properly. The reasoning is that even if multiple
-		 * members are available, only the head caller can actually be serviced.
-		 */
-		if ((!q->autofill || q->strategy == QUEUE_STRATEGY_RINGALL) && avl) {
-			break;
+			avl += is_member_available(q, mem);
+			if (mem->lastcall && wrapuptime && now.tv_sec - wrapuptime < mem->lastcall) {
+				struct timeval wrapup_end = ast_tv(mem->lastcall + wrapuptime, 0);
+
+				if (ast_tvcmp(wrapup_end, expire) < 0) {
+					expire = wrapup_end;
+				}
+			}
+			ao2_ref(mem, -1);
 		}
+		ao2_iterator_destroy(&mem_iter);
+
+		q->avail_count = avl;
+		q->avail_expire = expire;
 	}
-	ao2_iterator_destroy(&mem_iter);
 
-	return avl;
+	/* If autofill is not enabled or if the queue's strategy is ringall, then
+	 * we really don't care about the number of available members so much as we
+	 * do that there is at least one available.
+	 *
+	 * In fact, we purposely will return from this function stating that only
+	 * one member is available if either of those conditions hold. That way,
+	 * functions which determine what action to take based on the number of available
+	 * members will operate properly. The reasoning is that even if multiple
+	 * members are available, only the head caller can actually be serviced.
+	 */
+	if ((!q->autofill || q->strategy == QUEUE_STRATEGY_RINGALL) && q->avail_count) {
+		return 1;
+	}
+
+	return q->avail_count;
+}
+
+/*!
+ * \internal
+ * \brief Wake the waiting callers of a queue whose turn it may now be
+ *
+ * Callers in wait_our_turn() only check again every RECHECK seconds on
+ * their own, so whatever can make a member available wakes the callers
+ * that is_our_turn() would let through rather than leave them waiting.
+ *
+ * \pre The q is locked on entry.
+ */
+static void queue_wake_callers(struct call_queue *q)
+{
+	struct queue_ent *qe;
+	int avl;
+	int idx = 0;
+
+	if (!q->head) {
+		return;
+	}
+
+	avl = num_available_members(q);
+	for (qe = q->head; qe && idx < avl; qe = qe->next) {
+		if (qe->pending) {
+			continue;
+		}
+		++idx;
+		if (!qe->woken) {
+			qe->woken = 1;
+			ast_queue_frame(qe->chan, &ast_null_frame);
+		}
+	}
 }
 
 /* traverse all defined queues which have calls waiting and contain this member
@@ -5619,6 +5880,74 @@ static void update_qe_rule(struct queue_ent *qe)
 	qe->pr = AST_LIST_NEXT(qe->pr, list);
 }
 
+/*!
+ * \internal
+ * \brief How long a waiting caller sleeps before checking its turn again
+ *
+ * The count of available members is kept until the wrapup time of a member
+ * ends, which nothing wakes the callers for, so sleep no longer than that.
+ */
+static int wait_for_turn_ms(struct call_queue *q)
+{
+	int ms;
+
+	ao2_lock(q);
+	ms = ast_tvdiff_ms(q->avail_expire, ast_tvnow());
+	ao2_unlock(q);
+
+	return ms > 0 && ms < RECHECK * 1000 ? ms : RECHECK * 1000;
+}
+
+/*!
+ * \internal
+ * \brief Wait for a digit like ast_waitfordigit() or for queue_wake_callers()
+ *
+ * \retval 0 if the time ran out or the caller was woken
+ * \retval -1 on hangup
+ * \return the digit pressed otherwise
+ */
+static int wait_for_turn(struct queue_ent *qe, int timeout_ms)
+{
+	struct timeval start = ast_tvnow();
+	int res = 0;
+	int ms;
+
+	if (ast_check_hangup(qe->chan)) {
+		return -1;
+	}
+
+	ast_channel_set_flag(qe->chan, AST_FLAG_END_DTMF_ONLY);
+	while (!qe->woken && (ms = ast_remaining_ms(start, timeout_ms))) {
+		struct ast_frame *f;
+
+		if (ast_waitfor(qe->chan, ms) < 0) {
+			res = -1;
+			break;
+		}
+		if (!(f = ast_read(qe->chan))) {
+			res = -1;
+			break;
+		}
+		if (f->frametype == AST_FRAME_DTMF_END) {
+			res = f->subclass.integer;
+		} else if (f->frametype == AST_FRAME_CONTROL
+			&& f->subclass.integer == AST_CONTROL_HANGUP) {
+			res = -1;
+		}
+		ast_frfree(f);
+		if (res) {
+			break;
+		}
+	}
+	ast_channel_clear_flag(qe->chan, AST_FLAG_END_DTMF_ONLY);
+
+	ao2_lock(qe->parent);
+	qe->woken = 0;
+	ao2_unlock(qe->parent);
+
+	return res;
+}
+
 /*! \brief The waiting areas for callers who are not actively calling members
  *
  * This function is one large loop. This function will return if a caller
@@ -5687,8 +6016,8 @@ static int wait_our_turn(struct queue_ent *qe, int ringing, enum queue_result *r
 			break;
 		}
 
-		/* Wait a second before checking again */
-		if ((res = ast_waitfordigit(qe->chan, RECHECK * 1000))) {
+		/* Wait a second before checking again, unless a member becomes available first */
+		if ((res = wait_for_turn(qe, wait_for_turn_ms(qe->parent)))) {
 			if (res > 0 && !valid_exit(qe, res)) {
 				res = 0;
 			} else {
@@ -5736,6 +6065,7 @@ static int update_queue(struct call_queue *q, struct member *member, int callcom
 				mem->callcompletedinsl = 0;
 				mem->starttime = 0;
 				mem->lastqueue = q;
+				queue_avail_changed(qtmp);
 				ao2_ref(mem, -1);
 			}
 			ao2_unlock(qtmp);
@@ -5749,6 +6079,7 @@ static int update_queue(struct call_queue *q, struct member *member, int callcom
 		member->calls++;
 		member->starttime = 0;
 		member->lastqueue = q;
+		queue_avail_changed(q);
 		ao2_unlock(q);
 	}
 	/* Member might never experience any direct status change (local
@@ -7408,6 +7739,7 @@ static int add_to_queue(const char *queuename, const char *interface, const char
 
 			if (is_member_available(q, new_member)) {
 				ast_devstate_changed(AST_DEVICE_NOT_INUSE, AST_DEVSTATE_CACHABLE, "Queue:%s_avail", q->name);
+				queue_wake_callers(q);
 			}
 
 			ao2_ref(new_member, -1);
@@ -7505,6 +7837,10 @@ static void set_queue_member_pause(struct call_queue *q, struct member *mem, con
 	}
 
 	mem->paused = paused;
+	queue_avail_changed(q);
+	if (!paused) {
+		queue_wake_callers(q);
+	}
 	if (paused) {
 		time(&mem->lastpause); /* update last pause field */
 	}
@@ -7637,6 +7973,10 @@ static void set_queue_member_ringinuse(struct call_queue *q, struct member *mem,
 	}
 
 	mem->ringinuse = ringinuse;
+	queue_avail_changed(q);
+	if (ringinuse) {
+		queue_wake_callers(q);
+	}
 
 	ast_queue_log(q->name, "NONE", mem->interface, "RINGINUSE", "%d", ringinuse);
 	queue_publish_member_blob(queue_member_ringinuse_type(), queue_member_blob_create(q, mem));
@@ -9216,6 +9556,7 @@ static void queue_reset_global_params(void)
 	shared_lastcall = 0;
 	negative_penalty_invalid = 0;
 	log_membername_as_agent = 0;
+	realtime_cache_time = 0;
 }
 
 /*! Set the global queue parameters as defined in the "general" section of queues.conf */
@@ -9241,6 +9582,12 @@ static void queue_set_global_params(struct ast_config *cfg)
 	if ((general_val = ast_variable_retrieve(cfg, "general", "log_membername_as_agent"))) {
 		log_membername_as_agent = ast_true(general_val);
 	}
+	if ((general_val = ast_variable_retrieve(cfg, "general", "realtime_cache"))) {
+		if (sscanf(general_val, "%30d", &realtime_cache_time) != 1 || realtime_cache_time < 0) {
+			ast_log(LOG_WARNING, "Invalid realtime_cache value '%s', not caching realtime queues\n", general_val);
+			realtime_cache_time = 0;
+		}
+	}
 }
 
 /*! \brief reload information pertaining to a single member
@@ -9344,6 +9691,9 @@ static void reload_single_member(const char *memberdata, struct call_queue *q)
 			newm->queuepos = cur->queuepos;
 			ao2_link(q->members, newm);
 			ao2_unlink(q->members, cur);
+			member_device_add(q, newm);
+			member_device_remove(cur);
+			queue_avail_changed(q);
 			ao2_unlock(q->members);
 		} else {
 			/* Otherwise we need to add using the function that will apply a round robin queue position manually. */
@@ -9375,6 +9725,7 @@ static int kill_dead_members(void *obj, void *arg, int flags)
 		member->status = get_queue_member_status(member);
 		return 0;
 	} else {
+		member_device_remove(member);
 		return CMP_MATCH;
 	}
 }
@@ -9504,6 +9855,7 @@ static void reload_single_queue(struct ast_config *cfg, struct ast_flags *mask,
 		ao2_callback(q->members, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, kill_dead_members, q);
 		ao2_unlock(q->members);
 	}
+	queue_avail_changed(q);
 
 	if (new) {
 		queues_t_link(queues, q, "Add queue to container");
@@ -9634,6 +9986,20 @@ static int clear_stats(const char *queuename)
  * \retval 0 All reloads were successful
  * \retval non-zero There was a failure
  */
+/*! \brief Have a realtime queue, or a queue with realtime members, loaded again when next used */
+static int expire_realtime(void *obj, void *arg, int flags)
+{
+	struct call_queue *q = obj;
+	char *queuename = arg;
+
+	if (ast_strlen_zero(queuename) || !strcasecmp(queuename, q->name)) {
+		ao2_lock(q);
+		q->rt_expire = ast_tv(0, 0);
+		ao2_unlock(q);
+	}
+	return 0;
+}
+
 static int reload_handler(int reload, struct ast_flags *mask, const char *queuename)
 {
 	int res = 0;
@@ -9645,6 +10011,8 @@ static int reload_handler(int reload, struct ast_flags *mask, const char *queuen
 		res |= clear_stats(queuename);
 	}
 	if (ast_test_flag(mask, (QUEUE_RELOAD_PARAMETERS | QUEUE_RELOAD_MEMBER))) {
+		/* Even with queues.conf unchanged, the realtime side may have been */
+		ao2_callback(queues, OBJ_NODATA, expire_realtime, (char *) queuename);
 		res |= reload_queues(reload, mask, queuename);
 	}
 	return res;
@@ -11316,8 +11684,10 @@ static int unload_module(void)
 	ast_unload_realtime("queue_members");
 	ao2_cleanup(queues);
 	ao2_cleanup(pending_members);
+	ao2_cleanup(member_devices);
 
 	queues = NULL;
+	member_devices = NULL;
 	return 0;
 }
 
@@ -11352,6 +11722,13 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	member_devices = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+		MAX_MEMBER_DEVICE_BUCKETS, member_device_hash_fn, NULL, member_device_cmp_fn);
+	if (!member_devices) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	use_weight = 0;
 
 	if (reload_handler(0, &mask, NULL)) {
@@ -189,7 +189,7 @@ static int create_destination_directory(const char *path)
 	int res;
 	char directory[PATH_MAX], *file_sep;
 
-	if (!(file_sep = strrchr(path, '/'))) {
+	if (!(file_sep = strrchr(path, '/')) || ast_file_is_sink(path)) {
 		/* No directory to create */
 		return 0;
 	}
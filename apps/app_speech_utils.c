@@ -248,6 +248,10 @@
 					<enum name="results">
 						<para>Returns number of results that were recognized.</para>
 					</enum>
+					<enum name="partial">
+						<para>Returns the text of the best partial result reported
+						so far by an engine recognizing streamed audio.</para>
+					</enum>
 				</enumlist>
 			</parameter>
 		</syntax>
@@ -524,6 +528,15 @@ static int speech_read(struct ast_channel *chan, const char *cmd, char *data,
 			results++;
 		snprintf(tmp, sizeof(tmp), "%d", results);
 		ast_copy_string(buf, tmp, len);
+	} else if (!strcasecmp(data, "partial")) {
+		/* Best partial result of a recognition still in progress */
+		ast_mutex_lock(&speech->lock);
+		if (speech->partial_results && speech->partial_results->text) {
+			ast_copy_string(buf, speech->partial_results->text, len);
+		} else {
+			buf[0] = '\0';
+		}
+		ast_mutex_unlock(&speech->lock);
 	} else {
 		buf[0] = '\0';
 	}
@@ -700,7 +713,7 @@ END_OPTIONS );
 static int speech_background(struct ast_channel *chan, const char *data)
 {
 	unsigned int timeout = 0;
-	int res = 0, done = 0, started = 0, quieted = 0, max_dtmf_len = 0;
+	int res = 0, done = 0, started = 0, quieted = 0, max_dtmf_len = 0, streaming = 0;
 	struct ast_speech *speech = find_speech(chan);
 	struct ast_frame *f = NULL;
 	RAII_VAR(struct ast_format *, oldreadformat, NULL, ao2_cleanup);
@@ -773,6 +786,9 @@ static int speech_background(struct ast_channel *chan, const char *data)
 	/* Ensure no streams are currently running */
 	ast_stopstream(chan);
 
+	/* Let the engine take audio straight off the read path if it can */
+	streaming = !ast_speech_stream_start(speech, chan);
+
 	/* Okay it's streaming so go into a loop grabbing frames! */
 	while (done == 0) {
 		/* If the filename is null and stream is not running, start up a new sound file */
@@ -837,7 +853,7 @@ static int speech_background(struct ast_channel *chan, const char *data)
 				started = 1;
 			}
 			/* Write audio frame out to speech engine if no DTMF has been received */
-			if (!strlen(dtmf) && f != NULL && f->frametype == AST_FRAME_VOICE) {
+			if (!streaming && !strlen(dtmf) && f != NULL && f->frametype == AST_FRAME_VOICE) {
 				ast_speech_write(speech, f->data.ptr, f->datalen);
 			}
 			break;
@@ -896,6 +912,11 @@ static int speech_background(struct ast_channel *chan, const char *data)
 						timeout = (ast_channel_pbx(chan) && ast_channel_pbx(chan)->dtimeoutms) ? ast_channel_pbx(chan)->dtimeoutms : 5000;
 						started = 1;
 					}
+					if (streaming) {
+						/* No more audio goes to the engine once DTMF is entered */
+						ast_speech_stream_stop(speech);
+						streaming = 0;
+					}
 					start = ast_tvnow();
 					snprintf(tmp, sizeof(tmp), "%c", f->subclass.integer);
 					strncat(dtmf, tmp, sizeof(dtmf) - strlen(dtmf) - 1);
@@ -920,6 +941,8 @@ static int speech_background(struct ast_channel *chan, const char *data)
 		}
 	}
 
+	ast_speech_stream_stop(speech);
+
 	if (!ast_strlen_zero(dtmf)) {
 		/* We sort of make a results entry */
 		speech->results = ast_calloc(1, sizeof(*speech->results));
@@ -98,6 +98,7 @@
 #include "asterisk/smdi.h"
 #include "asterisk/astobj2.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/threadpool.h"
 #include "asterisk/test.h"
 #include "asterisk/format_cache.h"
 
@@ -853,6 +854,7 @@ static char odbc_table[80] = "voicemessages";
 #define COPY(a,b,c,d,e,f,g,h) (copy_file(a,b,c,d,e,f))
 #define DELETE(a,b,c,d) (delete_file(a,b))
 #define UPDATE_MSG_ID(a, b, c, d, e, f) (odbc_update_msg_id((a), (b), (c)))
+#define PREFETCH(a,b,c) (odbc_prefetch(a,b,c))
 #else
 #ifdef IMAP_STORAGE
 #define DISPOSE(a,b) (imap_remove_file(a,b))
@@ -863,6 +865,7 @@ static char odbc_table[80] = "voicemessages";
 #define COPY(a,b,c,d,e,f,g,h) (copy_file(g,h));
 #define DELETE(a,b,c,d) (vm_imap_delete(a,b,d))
 #define UPDATE_MSG_ID(a, b, c, d, e, f) (vm_imap_update_msg_id((a), (b), (c), (d), (e), (f)))
+#define PREFETCH(a,b,c)
 #else
 #define RETRIEVE(a,b,c,d)
 #define DISPOSE(a,b)
@@ -872,6 +875,7 @@ static char odbc_table[80] = "voicemessages";
 #define COPY(a,b,c,d,e,f,g,h) (copy_plain_file(g,h));
 #define DELETE(a,b,c,d) (vm_delete(c))
 #define UPDATE_MSG_ID(a, b, c, d, e, f)
+#define PREFETCH(a,b,c)
 #endif
 #endif
 
@@ -951,6 +955,97 @@ static unsigned char poll_thread_run;
 
 static struct ast_taskprocessor *mwi_subscription_tps;
 
+/*! Notifications of new messages that may wait for a worker thread.
+ *  Zero sends them from the thread of the channel that left the message. */
+static unsigned int notify_queue_size;
+/*! By default, send notifications from up to 4 threads */
+#define DEFAULT_NOTIFY_THREADS 4
+static unsigned int notify_threads = DEFAULT_NOTIFY_THREADS;
+/*! By default, try a failed e-mail or page 3 more times */
+#define DEFAULT_NOTIFY_RETRIES 3
+static unsigned int notify_retries = DEFAULT_NOTIFY_RETRIES;
+/*! By default, wait 30 seconds before trying again */
+#define DEFAULT_NOTIFY_RETRY_DELAY 30
+static unsigned int notify_retry_delay = DEFAULT_NOTIFY_RETRY_DELAY;
+
+static struct ast_threadpool *notify_pool;
+AST_MUTEX_DEFINE_STATIC(notify_lock);
+static ast_cond_t notify_cond = PTHREAD_COND_INITIALIZER;
+/*! Notifications queued, being sent or waiting to be tried again */
+static unsigned int notify_pending;
+/*! Notifications waiting to be tried again */
+static unsigned int notify_retrying;
+/*! Notifications sent from the channel thread because the queue was full */
+static unsigned int notify_overflows;
+/*! Notifications given up on after the last retry */
+static unsigned int notify_failures;
+static unsigned char notify_stopping;
+
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+/*! Keep an index of what is in each mailbox folder instead of reading
+ *  the folder every time its messages are counted. */
+static unsigned int mailbox_index = 1;
+
+/*!
+ * \brief What was found in a mailbox folder the last time it was read.
+ *
+ * An entry is used for as long as the modification time of the folder
+ * is the one it had when the entry was made.
+ */
+struct vm_folder_index {
+	/*! Modification time of the folder when it was read */
+	time_t mtime;
+	long mtime_nsec;
+	/*! Number of message information files in the folder */
+	int count;
+	/*! Highest message number in use, -1 if there are none */
+	int last;
+	char path[0];
+};
+
+#define FOLDER_INDEX_BUCKETS 2053
+static struct ao2_container *folder_index;
+AO2_STRING_FIELD_HASH_FN(vm_folder_index, path);
+AO2_STRING_FIELD_CMP_FN(vm_folder_index, path);
+#endif
+
+#ifdef ODBC_STORAGE
+/*! \brief A message copied from the database ahead of its playback */
+struct odbc_prefetch {
+	/*! The folder of the message, points into key */
+	char *dir;
+	/*! The number of the message */
+	int msgnum;
+	/*! What retrieving the message returned */
+	int res;
+	/*! When the copy was queued */
+	struct timeval queued;
+	/*! Set once the message is copied */
+	unsigned int done:1;
+	/*! Set if the message changed in the database since it was queued */
+	unsigned int stale:1;
+	/*! The base name of the copied files */
+	char fn[PATH_MAX];
+	/*! "msgnum:dir" */
+	char key[0];
+};
+
+#define PREFETCH_BUCKETS 61
+/*! Copies not played within this many seconds are thrown away */
+#define PREFETCH_MAX_AGE 120
+/*! Number of threads copying messages ahead of their playback */
+#define PREFETCH_THREADS 2
+
+/*! Messages being or already copied, protected by prefetch_lock */
+static struct ao2_container *odbc_prefetches;
+static struct ast_threadpool *prefetch_pool;
+AST_MUTEX_DEFINE_STATIC(prefetch_lock);
+static ast_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+static int prefetch_seq;
+AO2_STRING_FIELD_HASH_FN(odbc_prefetch, key);
+AO2_STRING_FIELD_CMP_FN(odbc_prefetch, key);
+#endif
+
 struct alias_mailbox_mapping {
 	char *alias;
 	char *mailbox;
@@ -3804,21 +3899,28 @@ static void odbc_update_msg_id(char *dir, int msg_num, char *msg_id)
 	return;
 }
 
+/*! \brief Gets the format messages are retrieved from the database in */
+static void retrieve_format(char *fmt, size_t size)
+{
+	char *c;
+
+	ast_copy_string(fmt, vmfmts, size);
+	c = strchr(fmt, '|');
+	if (c)
+		*c = '\0';
+	if (!strcasecmp(fmt, "wav49"))
+		ast_copy_string(fmt, "WAV", size);
+}
+
 /*!
- * \brief Retrieves a file from an ODBC data store.
+ * \brief Copies a message from an ODBC data store to the given files.
  * \param dir the path to the file to be retrieved.
  * \param msgnum the message number, such as within a mailbox folder.
- *
- * This method is used by the RETRIEVE macro when mailboxes are stored in an ODBC back end.
- * The purpose is to get the message from the database store to the local file system, so that the message may be played, or the information file may be read.
- *
- * The file is looked up by invoking a SQL on the odbc_table (default 'voicemessages') using the dir and msgnum input parameters.
- * The output is the message information file with the name msgnum and the extension .txt
- * and the message file with the extension of its format, in the directory with base file name of the msgnum.
+ * \param fn the base name of the files written.
  *
  * \return 0 on success, -1 on error.
  */
-static int retrieve_file(char *dir, int msgnum)
+static int retrieve_file_as(char *dir, int msgnum, const char *fn)
 {
 	int x = 0;
 	int res;
@@ -3829,7 +3931,6 @@ static int retrieve_file(char *dir, int msgnum)
 	SQLHSTMT stmt;
 	char sql[PATH_MAX];
 	char fmt[80] = "";
-	char *c;
 	char coltitle[256];
 	SQLSMALLINT collen;
 	SQLSMALLINT datatype;
@@ -3839,7 +3940,6 @@ static int retrieve_file(char *dir, int msgnum)
 	SQLLEN colsize2;
 	FILE *f = NULL;
 	char rowdata[80];
-	char fn[PATH_MAX];
 	char full_fn[PATH_MAX];
 	char msgnums[80];
 	char msg_id[MSG_ID_LEN] = "";
@@ -3853,18 +3953,9 @@ static int retrieve_file(char *dir, int msgnum)
 		return -1;
 	}
 
-	ast_copy_string(fmt, vmfmts, sizeof(fmt));
-	c = strchr(fmt, '|');
-	if (c)
-		*c = '\0';
-	if (!strcasecmp(fmt, "wav49"))
-		strcpy(fmt, "WAV");
+	retrieve_format(fmt, sizeof(fmt));
 
 	snprintf(msgnums, sizeof(msgnums), "%d", msgnum);
-	if (msgnum > -1)
-		make_file(fn, sizeof(fn), dir, msgnum);
-	else
-		ast_copy_string(fn, dir, sizeof(fn));
 
 	/* Create the information file */
 	snprintf(full_fn, sizeof(full_fn), "%s.txt", fn);
@@ -3986,6 +4077,218 @@ bail:
 	return x - 1;
 }
 
+static void odbc_prefetch_destroy(void *obj)
+{
+	struct odbc_prefetch *prefetch = obj;
+	char full_fn[PATH_MAX];
+
+	/* Whatever was not claimed */
+	ast_filedelete(prefetch->fn, NULL);
+	snprintf(full_fn, sizeof(full_fn), "%s.txt", prefetch->fn);
+	unlink(full_fn);
+}
+
+static int odbc_prefetch_expired(void *obj, void *arg, int flags)
+{
+	struct odbc_prefetch *prefetch = obj;
+	struct timeval *now = arg;
+
+	return prefetch->done && ast_tvdiff_sec(*now, prefetch->queued) > PREFETCH_MAX_AGE ? CMP_MATCH : 0;
+}
+
+static int odbc_prefetch_in_dir(void *obj, void *arg, int flags)
+{
+	struct odbc_prefetch *prefetch = obj;
+
+	return !strcmp(prefetch->dir, arg) ? CMP_MATCH : 0;
+}
+
+static int odbc_prefetch_task(void *data)
+{
+	struct odbc_prefetch *prefetch = data;
+	int res;
+
+	res = retrieve_file_as(prefetch->dir, prefetch->msgnum, prefetch->fn);
+
+	ast_mutex_lock(&prefetch_lock);
+	prefetch->res = res;
+	prefetch->done = 1;
+	ast_cond_broadcast(&prefetch_cond);
+	ast_mutex_unlock(&prefetch_lock);
+	ao2_ref(prefetch, -1);
+
+	return 0;
+}
+
+/*!
+ * \brief Starts copying a message from the database before it is played.
+ * \param dir the folder of the message.
+ * \param msgnum the message number.
+ * \param lastmsg the last message of the folder, nothing is copied past it.
+ *
+ * The message is copied to files of its own by a worker thread.  Retrieving
+ * the message then only needs to wait for the copy, if it is not done yet,
+ * and rename the files.
+ */
+static void odbc_prefetch(char *dir, int msgnum, int lastmsg)
+{
+	struct odbc_prefetch *prefetch;
+	struct timeval now = ast_tvnow();
+	char key[PATH_MAX + 20];
+
+	if (msgnum < 0 || msgnum > lastmsg) {
+		return;
+	}
+
+	snprintf(key, sizeof(key), "%d:%s", msgnum, dir);
+
+	ast_mutex_lock(&prefetch_lock);
+	if (!prefetch_pool || !odbc_prefetches) {
+		ast_mutex_unlock(&prefetch_lock);
+		return;
+	}
+
+	ao2_callback(odbc_prefetches, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK,
+		odbc_prefetch_expired, &now);
+
+	prefetch = ao2_find(odbc_prefetches, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (prefetch) {
+		ast_mutex_unlock(&prefetch_lock);
+		ao2_ref(prefetch, -1);
+		return;
+	}
+
+	prefetch = ao2_alloc_options(sizeof(*prefetch) + strlen(key) + 1, odbc_prefetch_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!prefetch) {
+		ast_mutex_unlock(&prefetch_lock);
+		return;
+	}
+	strcpy(prefetch->key, key); /* Safe */
+	prefetch->dir = strchr(prefetch->key, ':') + 1;
+	prefetch->msgnum = msgnum;
+	prefetch->queued = now;
+	/* Unique, as a claimed copy may still be renamed while the next one is made */
+	snprintf(prefetch->fn, sizeof(prefetch->fn), "%s/.prefetch%04d-%d", dir, msgnum,
+		ast_atomic_fetchadd_int(&prefetch_seq, +1));
+
+	ao2_link_flags(odbc_prefetches, prefetch, OBJ_NOLOCK);
+	if (ast_threadpool_push(prefetch_pool, odbc_prefetch_task, prefetch)) {
+		ao2_unlink_flags(odbc_prefetches, prefetch, OBJ_NOLOCK);
+		ao2_ref(prefetch, -1);
+	}
+	ast_mutex_unlock(&prefetch_lock);
+}
+
+/*!
+ * \brief Throws away the copies of the messages of a folder changed in the database.
+ */
+static void odbc_prefetch_invalidate(const char *dir)
+{
+	struct ao2_iterator *iter;
+	struct odbc_prefetch *prefetch;
+
+	ast_mutex_lock(&prefetch_lock);
+	if (!odbc_prefetches) {
+		ast_mutex_unlock(&prefetch_lock);
+		return;
+	}
+	iter = ao2_callback(odbc_prefetches, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_UNLINK,
+		odbc_prefetch_in_dir, (void *) dir);
+	while (iter && (prefetch = ao2_iterator_next(iter))) {
+		prefetch->stale = 1;
+		ao2_ref(prefetch, -1);
+	}
+	ast_mutex_unlock(&prefetch_lock);
+
+	if (iter) {
+		ao2_iterator_destroy(iter);
+	}
+}
+
+/*!
+ * \brief Moves a copied message to the files it is retrieved to.
+ *
+ * \retval 0 if it was copied, res is set to what retrieving it returned
+ * \retval -1 if it has to be retrieved
+ */
+static int odbc_prefetch_claim(const char *dir, int msgnum, const char *fn, int *res)
+{
+	struct odbc_prefetch *prefetch;
+	char key[PATH_MAX + 20];
+	char fmt[80];
+	char src[PATH_MAX + 84];
+	char dst[PATH_MAX + 84];
+	int claimed = -1;
+
+	if (msgnum < 0) {
+		return -1;
+	}
+
+	snprintf(key, sizeof(key), "%d:%s", msgnum, dir);
+
+	ast_mutex_lock(&prefetch_lock);
+	prefetch = odbc_prefetches
+		? ao2_find(odbc_prefetches, key, OBJ_SEARCH_KEY | OBJ_NOLOCK | OBJ_UNLINK) : NULL;
+	while (prefetch && !prefetch->done) {
+		ast_cond_wait(&prefetch_cond, &prefetch_lock);
+	}
+	ast_mutex_unlock(&prefetch_lock);
+
+	if (!prefetch) {
+		return -1;
+	}
+
+	if (!prefetch->stale && prefetch->res >= 0) {
+		retrieve_format(fmt, sizeof(fmt));
+		snprintf(src, sizeof(src), "%s.%s", prefetch->fn, fmt);
+		snprintf(dst, sizeof(dst), "%s.%s", fn, fmt);
+		if (!rename(src, dst)) {
+			snprintf(src, sizeof(src), "%s.txt", prefetch->fn);
+			snprintf(dst, sizeof(dst), "%s.txt", fn);
+			if (!rename(src, dst)) {
+				*res = prefetch->res;
+				claimed = 0;
+			}
+		}
+	}
+	ao2_ref(prefetch, -1);
+
+	return claimed;
+}
+
+/*!
+ * \brief Retrieves a file from an ODBC data store.
+ * \param dir the path to the file to be retrieved.
+ * \param msgnum the message number, such as within a mailbox folder.
+ *
+ * This method is used by the RETRIEVE macro when mailboxes are stored in an ODBC back end.
+ * The purpose is to get the message from the database store to the local file system, so that the message may be played, or the information file may be read.
+ *
+ * The file is looked up by invoking a SQL on the odbc_table (default 'voicemessages') using the dir and msgnum input parameters.
+ * The output is the message information file with the name msgnum and the extension .txt
+ * and the message file with the extension of its format, in the directory with base file name of the msgnum.
+ * A copy made ahead by odbc_prefetch() is used if there is one.
+ *
+ * \return 0 on success, -1 on error.
+ */
+static int retrieve_file(char *dir, int msgnum)
+{
+	char fn[PATH_MAX];
+	int res;
+
+	if (msgnum > -1)
+		make_file(fn, sizeof(fn), dir, msgnum);
+	else
+		ast_copy_string(fn, dir, sizeof(fn));
+
+	if (!odbc_prefetch_claim(dir, msgnum, fn, &res)) {
+		return res;
+	}
+
+	return retrieve_file_as(dir, msgnum, fn);
+}
+
 /*!
  * \brief Determines the highest message number in use for a given user and mailbox folder.
  * \param vmu
@@ -4203,6 +4506,7 @@ static void delete_file(const char *sdir, int smsg)
 		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
 	}
 	ast_odbc_release_obj(obj);
+	odbc_prefetch_invalidate(sdir);
 
 	return;
 }
@@ -4246,6 +4550,7 @@ static void copy_file(char *sdir, int smsg, char *ddir, int dmsg, char *dmailbox
 	else
 		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
 	ast_odbc_release_obj(obj);
+	odbc_prefetch_invalidate(ddir);
 
 	return;
 }
@@ -4430,6 +4735,7 @@ static int store_file(const char *dir, const char *mailboxuser, const char *mail
 	} while (0);
 
 	ast_odbc_release_obj(obj);
+	odbc_prefetch_invalidate(dir);
 
 	if (valid_config(cfg))
 		ast_config_destroy(cfg);
@@ -4480,6 +4786,8 @@ static void rename_file(char *sdir, int smsg, char *mailboxuser, char *mailboxco
 	else
 		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
 	ast_odbc_release_obj(obj);
+	odbc_prefetch_invalidate(sdir);
+	odbc_prefetch_invalidate(ddir);
 	return;
 }
 
@@ -4512,33 +4820,199 @@ static int remove_file(char *dir, int msgnum)
 }
 #else
 #ifndef IMAP_STORAGE
+static void folder_index_stat_nsec(const struct stat *st, long *nsec)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMENSEC)
+	*nsec = st->st_mtimensec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*nsec = st->st_mtimespec.tv_nsec;
+#else
+	*nsec = 0;
+#endif
+}
+
+/*!
+ * \brief Return what the index knows about a mailbox folder.
+ * \param dir The path to the mailbox folder.
+ * \param[out] count The number of messages in the folder.
+ * \param[out] last The highest message number in use, -1 if none.
+ *
+ * Only a stat(2) of the folder is done; the folder itself is not read.
+ *
+ * \retval 0 if the index entry of the folder is still valid.
+ * \retval -1 if the folder has to be read.
+ */
+static int folder_index_lookup(const char *dir, int *count, int *last)
+{
+	struct vm_folder_index *entry;
+	struct stat st;
+	long nsec;
+	int res = -1;
+
+	if (!mailbox_index || !folder_index) {
+		return -1;
+	}
+
+	if (!(entry = ao2_find(folder_index, dir, OBJ_SEARCH_KEY))) {
+		return -1;
+	}
+
+	if (!stat(dir, &st)) {
+		folder_index_stat_nsec(&st, &nsec);
+		if (entry->mtime == st.st_mtime && entry->mtime_nsec == nsec) {
+			*count = entry->count;
+			*last = entry->last;
+			res = 0;
+		}
+	}
+	ao2_ref(entry, -1);
+
+	return res;
+}
+
+/*!
+ * \brief Read a mailbox folder and update its index entry.
+ * \param dir The path to the mailbox folder.
+ * \param[out] count The number of messages in the folder.
+ * \param[out] last The highest message number in use, -1 if none.
+ *
+ * \retval 0 on success.
+ * \retval -1 if the folder could not be read.
+ */
+static int folder_index_read(const char *dir, int *count, int *last)
+{
+	struct vm_folder_index *entry;
+	struct stat st;
+	struct timeval now;
+	DIR *msgdir;
+	struct dirent *msgdirent;
+	int msgdirint;
+	char extension[4];
+	long nsec;
+	int have_stat;
+
+	*count = 0;
+	*last = -1;
+
+	/* The modification time is taken before the folder is read, so a
+	 * change made while reading it leaves an entry that is already stale. */
+	have_stat = mailbox_index && folder_index && !stat(dir, &st);
+	now = ast_tvnow();
+
+	if (!(msgdir = opendir(dir))) {
+		if (folder_index) {
+			ao2_find(folder_index, dir, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+		}
+		return -1;
+	}
+
+	while ((msgdirent = readdir(msgdir))) {
+		if (sscanf(msgdirent->d_name, "msg%30d.%3s", &msgdirint, extension) == 2 && !strcmp(extension, "txt") && msgdirint >= 0) {
+			(*count)++;
+			if (msgdirint < MAXMSGLIMIT && msgdirint > *last) {
+				*last = msgdirint;
+			}
+		}
+	}
+	closedir(msgdir);
+
+	if (!have_stat) {
+		return 0;
+	}
+
+	/* A folder changed within a second or so of being read may change again
+	 * without its modification time moving, given a coarse timestamp or a
+	 * file server whose clock is a little off ours.  Such a folder is read
+	 * again the next time instead. */
+	if (st.st_mtime + 1 >= now.tv_sec) {
+		ao2_find(folder_index, dir, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+		return 0;
+	}
+
+	entry = ao2_alloc_options(sizeof(*entry) + strlen(dir) + 1, NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		return 0;
+	}
+	folder_index_stat_nsec(&st, &nsec);
+	entry->mtime = st.st_mtime;
+	entry->mtime_nsec = nsec;
+	entry->count = *count;
+	entry->last = *last;
+	strcpy(entry->path, dir); /* SAFE */
+
+	ao2_lock(folder_index);
+	ao2_find(folder_index, dir, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+	ao2_link_flags(folder_index, entry, OBJ_NOLOCK);
+	ao2_unlock(folder_index);
+	ao2_ref(entry, -1);
+
+	return 0;
+}
+
+/*!
+ * \brief Get the number of messages and the highest message number of a mailbox folder.
+ *
+ * The folder is only read when its index entry is missing or stale.
+ *
+ * \retval 0 on success.
+ * \retval -1 if the folder could not be read.
+ */
+static int folder_index_get(const char *dir, int *count, int *last)
+{
+	if (!folder_index_lookup(dir, count, last)) {
+		return 0;
+	}
+	return folder_index_read(dir, count, last);
+}
+
+/*!
+ * \brief Drop the index entry of the folder holding a message.
+ * \param file The path to the message, without an extension.
+ *
+ * Called whenever a message is saved, moved or deleted so that the next
+ * count reads the folder again, whatever its modification time says.
+ */
+static void folder_index_forget(const char *file)
+{
+	char *dir;
+	char *slash;
+
+	if (!folder_index) {
+		return;
+	}
+
+	dir = ast_strdupa(file);
+	if ((slash = strrchr(dir, '/'))) {
+		*slash = '\0';
+	}
+	ao2_find(folder_index, dir, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+}
+
 /*!
  * \brief Find all .txt files - even if they are not in sequence from 0000.
  * \param vmu
  * \param dir
  *
  * This method is used when mailboxes are stored on the filesystem. (not ODBC and not IMAP).
+ * The folder is only read, with a lock on it, when its index entry is stale.
  *
  * \return the count of messages, zero or more.
  */
 static int count_messages(struct ast_vm_user *vmu, char *dir)
 {
-
 	int vmcount = 0;
-	DIR *vmdir = NULL;
-	struct dirent *vment = NULL;
+	int last;
+
+	if (!folder_index_lookup(dir, &vmcount, &last)) {
+		return vmcount;
+	}
 
 	if (vm_lock_path(dir))
 		return ERROR_LOCK_PATH;
 
-	if ((vmdir = opendir(dir))) {
-		while ((vment = readdir(vmdir))) {
-			if (strlen(vment->d_name) > 7 && !strncmp(vment->d_name + 7, ".txt", 4)) {
-				vmcount++;
-			}
-		}
-		closedir(vmdir);
-	}
+	folder_index_read(dir, &vmcount, &last);
 	ast_unlock_path(dir);
 
 	return vmcount;
@@ -4562,6 +5036,8 @@ static void rename_file(char *sfn, char *dfn)
 		ast_update_realtime("voicemail_data", "filename", sfn, "filename", dfn, SENTINEL);
 	}
 	rename(stxt, dtxt);
+	folder_index_forget(sfn);
+	folder_index_forget(dfn);
 }
 
 /*!
@@ -4577,40 +5053,15 @@ static void rename_file(char *sfn, char *dfn)
  */
 static int last_message_index(struct ast_vm_user *vmu, char *dir)
 {
-	int x;
-	unsigned char map[MAXMSGLIMIT] = "";
-	DIR *msgdir;
-	struct dirent *msgdirent;
-	int msgdirint;
-	char extension[4];
-	int stopcount = 0;
+	int count;
+	int last;
 
-	/* Reading the entire directory into a file map scales better than
-	 * doing a stat repeatedly on a predicted sequence.  I suspect this
-	 * is partially due to stat(2) internally doing a readdir(2) itself to
-	 * find each file. */
-	if (!(msgdir = opendir(dir))) {
+	if (folder_index_get(dir, &count, &last)) {
 		return -1;
 	}
 
-	while ((msgdirent = readdir(msgdir))) {
-		if (sscanf(msgdirent->d_name, "msg%30d.%3s", &msgdirint, extension) == 2 && !strcmp(extension, "txt") && msgdirint < MAXMSGLIMIT) {
-			map[msgdirint] = 1;
-			stopcount++;
-			ast_debug(4, "%s map[%d] = %d, count = %d\n", dir, msgdirint, map[msgdirint], stopcount);
-		}
-	}
-	closedir(msgdir);
-
-	for (x = 0; x < vmu->maxmsg; x++) {
-		if (map[x] == 1) {
-			stopcount--;
-		} else if (map[x] == 0 && !stopcount) {
-			break;
-		}
-	}
-
-	return x - 1;
+	/* Numbers past the mailbox limit are never handed out */
+	return MIN(last, vmu->maxmsg - 1);
 }
 
 #endif /* #ifndef IMAP_STORAGE */
@@ -4735,6 +5186,9 @@ static void copy_plain_file(char *frompath, char *topath)
 	}
 	copy(frompath2, topath2);
 	ast_variables_destroy(var);
+#ifndef ODBC_STORAGE
+	folder_index_forget(topath);
+#endif
 }
 #endif
 
@@ -4761,6 +5215,9 @@ static int vm_delete(char *file)
 	}
 	snprintf(txt, txtsize, "%s.txt", file);
 	unlink(txt);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	folder_index_forget(file);
+#endif
 	return ast_filedelete(file, NULL);
 }
 
@@ -5517,6 +5974,32 @@ static int add_email_attachment(FILE *p, struct ast_vm_user *vmu, char *format,
 	return 0;
 }
 
+/*!
+ * \brief Hands a message file over to the mail command.
+ * \param file The message file.  It is removed once the mail command is done with it.
+ * \param wait Wait for the mail command and report how it went, instead of
+ *             leaving it to run in the background.
+ *
+ * \return zero on success, -1 if the mail command failed while waiting for it.
+ */
+static int run_mailcmd(const char *file, int wait)
+{
+	char cmd[PATH_MAX];
+	int res;
+
+	if (!wait) {
+		snprintf(cmd, sizeof(cmd), "( %s < %s ; rm -f %s ) &", mailcmd, file, file);
+		ast_safe_system(cmd);
+		return 0;
+	}
+
+	snprintf(cmd, sizeof(cmd), "%s < %s", mailcmd, file);
+	res = ast_safe_system(cmd);
+	unlink(file);
+
+	return res ? -1 : 0;
+}
+
 static int sendmail(char *srcemail,
 		struct ast_vm_user *vmu,
 		int msgnum,
@@ -5533,12 +6016,13 @@ static int sendmail(char *srcemail,
 		struct ast_channel *chan,
 		const char *category,
 		const char *flag,
-		const char *msg_id)
+		const char *msg_id,
+		int wait)
 {
 	FILE *p = NULL;
 	char tmp[80] = "/tmp/astmail-XXXXXX";
-	char tmp2[256];
 	char *stringp;
+	int res;
 
 	if (vmu && ast_strlen_zero(vmu->email)) {
 		ast_log(AST_LOG_WARNING, "E-mail address missing for mailbox [%s].  E-mail will not be sent.\n", vmu->mailbox);
@@ -5561,14 +6045,16 @@ static int sendmail(char *srcemail,
 	} else {
 		make_email_file(p, srcemail, vmu, msgnum, context, mailbox, fromfolder, cidnum, cidname, attach, attach2, format, duration, attach_user_voicemail, chan, category, 0, flag, msg_id);
 		fclose(p);
-		snprintf(tmp2, sizeof(tmp2), "( %s < %s ; rm -f %s ) &", mailcmd, tmp, tmp);
-		ast_safe_system(tmp2);
+		if ((res = run_mailcmd(tmp, wait))) {
+			ast_log(AST_LOG_WARNING, "Unable to send mail to %s with command '%s'\n", vmu->email, mailcmd);
+			return res;
+		}
 		ast_debug(1, "Sent mail to %s with command '%s'\n", vmu->email, mailcmd);
 	}
 	return 0;
 }
 
-static int sendpage(char *srcemail, char *pager, int msgnum, char *context, char *mailbox, const char *fromfolder, char *cidnum, char *cidname, int duration, struct ast_vm_user *vmu, const char *category, const char *flag)
+static int sendpage(char *srcemail, char *pager, int msgnum, char *context, char *mailbox, const char *fromfolder, char *cidnum, char *cidname, int duration, struct ast_vm_user *vmu, const char *category, const char *flag, int wait)
 {
 	char enc_cidnum[256], enc_cidname[256];
 	char date[256];
@@ -5576,9 +6062,9 @@ static int sendpage(char *srcemail, char *pager, int msgnum, char *context, char
 	char who[256];
 	char dur[PATH_MAX];
 	char tmp[80] = "/tmp/astmail-XXXXXX";
-	char tmp2[PATH_MAX];
 	struct ast_tm tm;
 	FILE *p;
+	int res;
 	struct ast_str *str1 = ast_str_create(16), *str2 = ast_str_create(16);
 
 	if (!str1 || !str2) {
@@ -5706,11 +6192,13 @@ static int sendpage(char *srcemail, char *pager, int msgnum, char *context, char
 	}
 
 	fclose(p);
-	snprintf(tmp2, sizeof(tmp2), "( %s < %s ; rm -f %s ) &", mailcmd, tmp, tmp);
-	ast_safe_system(tmp2);
-	ast_debug(1, "Sent page to %s with command '%s'\n", pager, mailcmd);
 	ast_free(str1);
 	ast_free(str2);
+	if ((res = run_mailcmd(tmp, wait))) {
+		ast_log(AST_LOG_WARNING, "Unable to send page to %s with command '%s'\n", pager, mailcmd);
+		return res;
+	}
+	ast_debug(1, "Sent page to %s with command '%s'\n", pager, mailcmd);
 	return 0;
 }
 
@@ -6060,10 +6548,9 @@ static int messagecount(const char *mailbox_id, const char *folder)
 
 static int __has_voicemail(const char *context, const char *mailbox, const char *folder, int shortcircuit)
 {
-	DIR *dir;
-	struct dirent *de;
 	char fn[256];
-	int ret = 0;
+	int count;
+	int last;
 	struct alias_mailbox_mapping *mapping;
 	char *c;
 	char *m;
@@ -6093,23 +6580,10 @@ static int __has_voicemail(const char *context, const char *mailbox, const char
 
 	snprintf(fn, sizeof(fn), "%s%s/%s/%s", VM_SPOOL_DIR, c, m, folder);
 
-	if (!(dir = opendir(fn)))
+	if (folder_index_get(fn, &count, &last))
 		return 0;
 
-	while ((de = readdir(dir))) {
-		if (!strncasecmp(de->d_name, "msg", 3)) {
-			if (shortcircuit) {
-				ret = 1;
-				break;
-			} else if (!strncasecmp(de->d_name + 8, "txt", 3)) {
-				ret++;
-			}
-		}
-	}
-
-	closedir(dir);
-
-	return ret;
+	return shortcircuit ? (count > 0) : count;
 }
 
 /**
@@ -6548,6 +7022,9 @@ static int msg_create_from_file(struct ast_vm_recording_data *recdata)
 
 	snprintf(desttxtfile, sizeof(desttxtfile), "%s.txt", destination);
 	rename(tmptxtfile, desttxtfile);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	folder_index_forget(destination);
+#endif
 
 	if (chmod(desttxtfile, VOICEMAIL_FILE_MODE) < 0) {
 		ast_log(AST_LOG_ERROR, "Couldn't set permissions on voicemail text file %s: %s", desttxtfile, strerror(errno));
@@ -7078,6 +7555,9 @@ static int leave_voicemail(struct ast_channel *chan, char *ext, struct leave_vm_
 					snprintf(txtfile, sizeof(txtfile), "%s.txt", fn);
 					ast_filerename(tmptxtfile, fn, NULL);
 					rename(tmptxtfile, txtfile);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+					folder_index_forget(fn);
+#endif
 					inprocess_count(vmu->mailbox, vmu->context, -1);
 
 					/* Properly set permissions on voicemail text descriptor file.
@@ -8102,41 +8582,257 @@ static int vm_forwardoptions(struct ast_channel *chan, struct ast_vm_user *vmu,
 		rename(backup_textfile, textfile);
 	}
 
-	if (cmd == 't' || cmd == 'S') /* XXX entering this block with a value of 'S' is probably no longer possible. */
-		cmd = 0;
-	return cmd;
-}
+	if (cmd == 't' || cmd == 'S') /* XXX entering this block with a value of 'S' is probably no longer possible. */
+		cmd = 0;
+	return cmd;
+}
+
+static void queue_mwi_event(const char *channel_id, const char *box, int urgent, int new, int old)
+{
+	char *mailbox;
+	char *context;
+
+	if (separate_mailbox(ast_strdupa(box), &mailbox, &context)) {
+		return;
+	}
+
+	ast_debug(3, "Queueing event for mailbox %s  New: %d   Old: %d\n", box, new + urgent, old);
+	ast_publish_mwi_state_channel(mailbox, context, new + urgent, old, channel_id);
+
+	if (!ast_strlen_zero(aliasescontext)) {
+		struct ao2_iterator *aliases;
+		struct mailbox_alias_mapping *mapping;
+
+		aliases = ao2_find(mailbox_alias_mappings, box, OBJ_SEARCH_KEY | OBJ_MULTIPLE);
+		while ((mapping = ao2_iterator_next(aliases))) {
+			char alias[strlen(mapping->alias) + 1];
+			strcpy(alias, mapping->alias); /* safe */
+			mailbox = NULL;
+			context = NULL;
+			ast_debug(3, "Found alias mapping: %s -> %s\n", mapping->alias, box);
+			separate_mailbox(alias, &mailbox, &context);
+			ast_publish_mwi_state_channel(mailbox, context, new + urgent, old, channel_id);
+			ao2_ref(mapping, -1);
+		}
+		ao2_iterator_destroy(aliases);
+	}
+}
+
+/*!
+ * \brief Finishes the notification of a new message, once the e-mail and page are sent.
+ *
+ * Deletes the message if the mailbox says so, then updates the MWI state
+ * and runs the external notification command.
+ */
+static void notify_new_message_done(struct ast_vm_user *vmu, char *todir, int msgnum, char *fn, const char *channel_id, const char *flag)
+{
+	char ext_context[PATH_MAX];
+	int newmsgs = 0, oldmsgs = 0, urgentmsgs = 0;
+
+	snprintf(ext_context, sizeof(ext_context), "%s@%s", vmu->mailbox, vmu->context);
+
+	if (ast_test_flag(vmu, VM_DELETE))
+		DELETE(todir, msgnum, fn, vmu);
+
+	/* Leave voicemail for someone */
+	if (ast_app_has_voicemail(ext_context, NULL))
+		ast_app_inboxcount2(ext_context, &urgentmsgs, &newmsgs, &oldmsgs);
+
+	queue_mwi_event(channel_id, ext_context, urgentmsgs, newmsgs, oldmsgs);
+	run_externnotify(vmu->context, vmu->mailbox, flag);
+}
+
+#ifndef IMAP_STORAGE
+/*! \brief A notification of a new message, on its way to a worker thread */
+struct vm_notification {
+	char *fmt;
+	char *cidnum;
+	char *cidname;
+	char *flag;
+	char *category;
+	char *channel_id;
+	/*! A copy of the mailbox, so a reload cannot pull it away */
+	struct ast_vm_user vmu;
+	int msgnum;
+	long duration;
+	/*! Dialplan priority of the channel, for the e-mail headers */
+	int priority;
+	/*! Has the e-mail been sent */
+	unsigned int mailed:1;
+	/*! Has the page been sent */
+	unsigned int paged:1;
+};
+
+static void vm_notification_destroy(struct vm_notification *notification)
+{
+	free_user(&notification->vmu);
+	ast_free(notification->fmt);
+	ast_free(notification->cidnum);
+	ast_free(notification->cidname);
+	ast_free(notification->flag);
+	ast_free(notification->category);
+	ast_free(notification->channel_id);
+	ast_free(notification);
+}
+
+/*!
+ * \brief Sends a queued notification from a worker thread.
+ *
+ * The mail command is waited for, so an e-mail or page that could not be
+ * handed over is tried again after the retry delay, up to the number of
+ * retries configured.
+ */
+static int notify_new_message_task(void *data)
+{
+	struct vm_notification *n = data;
+	char todir[PATH_MAX], fn[PATH_MAX];
+	char *myserveremail = serveremail;
+	struct ast_channel *chan;
+	unsigned int attempt;
+
+	make_dir(todir, sizeof(todir), n->vmu.context, n->vmu.mailbox, !ast_strlen_zero(n->flag) && !strcmp(n->flag, "Urgent") ? "Urgent" : "INBOX");
+	make_file(fn, sizeof(fn), todir, n->msgnum);
+
+	if (!ast_strlen_zero(n->vmu.serveremail))
+		myserveremail = n->vmu.serveremail;
+
+	/* Stands in for the channel that left the message when building the e-mail */
+	if ((chan = ast_dummy_channel_alloc())) {
+		ast_channel_priority_set(chan, n->priority);
+	}
+
+	for (attempt = 0; ; attempt++) {
+		if (!n->mailed) {
+			int attach_user_voicemail = ast_test_flag(&n->vmu, VM_ATTACH);
+
+			if (ast_strlen_zero(n->vmu.email)) {
+				n->mailed = 1;
+			} else {
+				if (attach_user_voicemail)
+					RETRIEVE(todir, n->msgnum, n->vmu.mailbox, n->vmu.context);
+
+				n->mailed = !sendmail(myserveremail, &n->vmu, n->msgnum, n->vmu.context, n->vmu.mailbox, mbox(&n->vmu, 0),
+					n->cidnum, n->cidname, fn, NULL, n->fmt, n->duration,
+					attach_user_voicemail, chan, n->category, n->flag, NULL, 1);
+
+				if (attach_user_voicemail)
+					DISPOSE(todir, n->msgnum);
+			}
+		}
+
+		if (!n->paged) {
+			n->paged = ast_strlen_zero(n->vmu.pager)
+				|| !sendpage(myserveremail, n->vmu.pager, n->msgnum, n->vmu.context, n->vmu.mailbox, mbox(&n->vmu, 0),
+					n->cidnum, n->cidname, n->duration, &n->vmu, n->category, n->flag, 1);
+		}
+
+		if (n->mailed && n->paged) {
+			break;
+		}
+
+		ast_mutex_lock(&notify_lock);
+		if (attempt >= notify_retries || notify_stopping) {
+			notify_failures++;
+			ast_mutex_unlock(&notify_lock);
+			ast_log(AST_LOG_ERROR, "Giving up on notifying %s@%s of message %d after %u attempts\n",
+				n->vmu.mailbox, n->vmu.context, n->msgnum, attempt + 1);
+			break;
+		} else {
+			struct timespec ts = {
+				.tv_sec = time(NULL) + notify_retry_delay,
+			};
+
+			notify_retrying++;
+			while (!notify_stopping) {
+				if (ast_cond_timedwait(&notify_cond, &notify_lock, &ts) == ETIMEDOUT) {
+					break;
+				}
+			}
+			notify_retrying--;
+		}
+		ast_mutex_unlock(&notify_lock);
+	}
+
+	ast_channel_cleanup(chan);
+
+	notify_new_message_done(&n->vmu, todir, n->msgnum, fn, n->channel_id, n->flag);
+	vm_notification_destroy(n);
+
+	ast_mutex_lock(&notify_lock);
+	notify_pending--;
+	ast_cond_broadcast(&notify_cond);
+	ast_mutex_unlock(&notify_lock);
+
+	return 0;
+}
+
+/*!
+ * \brief Hands the notification of a new message over to the worker threads.
+ *
+ * \retval 0 if the notification was queued.
+ * \retval -1 if it has to be sent from the calling thread, because queueing
+ *         is disabled, the queue is full or the notification could not be copied.
+ */
+static int queue_new_message_notification(struct ast_channel *chan, struct ast_vm_user *vmu, int msgnum, long duration, const char *fmt, const char *cidnum, const char *cidname, const char *flag, const char *category)
+{
+	struct vm_notification *n;
+
+	ast_mutex_lock(&notify_lock);
+	if (!notify_queue_size || !notify_pool || notify_stopping) {
+		ast_mutex_unlock(&notify_lock);
+		return -1;
+	}
+	if (notify_pending >= notify_queue_size) {
+		if (!(notify_overflows++ % 100)) {
+			ast_log(AST_LOG_WARNING, "%u voicemail notifications are waiting to be sent, sending this one from the channel thread\n",
+				notify_pending);
+		}
+		ast_mutex_unlock(&notify_lock);
+		return -1;
+	}
+	notify_pending++;
+	ast_mutex_unlock(&notify_lock);
+
+	if (!(n = ast_calloc(1, sizeof(*n)))) {
+		goto failed;
+	}
 
-static void queue_mwi_event(const char *channel_id, const char *box, int urgent, int new, int old)
-{
-	char *mailbox;
-	char *context;
+	n->vmu = *vmu;
+	n->vmu.email = ast_strdup(vmu->email);
+	n->vmu.emailbody = ast_strdup(vmu->emailbody);
+	n->vmu.emailsubject = ast_strdup(vmu->emailsubject);
+	ast_clear_flag(&n->vmu, VM_ALLOCED);
+	AST_LIST_NEXT(&n->vmu, list) = NULL;
 
-	if (separate_mailbox(ast_strdupa(box), &mailbox, &context)) {
-		return;
+	n->fmt = ast_strdup(fmt);
+	n->cidnum = ast_strdup(cidnum);
+	n->cidname = ast_strdup(cidname);
+	n->flag = ast_strdup(flag);
+	n->category = ast_strdup(category);
+	n->channel_id = ast_strdup(ast_channel_uniqueid(chan));
+	if (!n->fmt || !n->channel_id) {
+		vm_notification_destroy(n);
+		goto failed;
 	}
+	n->msgnum = msgnum;
+	n->duration = duration;
+	n->priority = ast_channel_priority(chan);
 
-	ast_debug(3, "Queueing event for mailbox %s  New: %d   Old: %d\n", box, new + urgent, old);
-	ast_publish_mwi_state_channel(mailbox, context, new + urgent, old, channel_id);
+	if (ast_threadpool_push(notify_pool, notify_new_message_task, n)) {
+		vm_notification_destroy(n);
+		goto failed;
+	}
 
-	if (!ast_strlen_zero(aliasescontext)) {
-		struct ao2_iterator *aliases;
-		struct mailbox_alias_mapping *mapping;
+	return 0;
 
-		aliases = ao2_find(mailbox_alias_mappings, box, OBJ_SEARCH_KEY | OBJ_MULTIPLE);
-		while ((mapping = ao2_iterator_next(aliases))) {
-			char alias[strlen(mapping->alias) + 1];
-			strcpy(alias, mapping->alias); /* safe */
-			mailbox = NULL;
-			context = NULL;
-			ast_debug(3, "Found alias mapping: %s -> %s\n", mapping->alias, box);
-			separate_mailbox(alias, &mailbox, &context);
-			ast_publish_mwi_state_channel(mailbox, context, new + urgent, old, channel_id);
-			ao2_ref(mapping, -1);
-		}
-		ao2_iterator_destroy(aliases);
-	}
+failed:
+	ast_mutex_lock(&notify_lock);
+	notify_pending--;
+	ast_cond_broadcast(&notify_cond);
+	ast_mutex_unlock(&notify_lock);
+	return -1;
 }
+#endif
 
 /*!
  * \brief Sends email notification that a user has a new voicemail waiting for them.
@@ -8150,12 +8846,15 @@ static void queue_mwi_event(const char *channel_id, const char *box, int urgent,
  * \param cidname The Caller ID name value.
  * \param flag
  *
+ * When the notifyqueue option is set, the e-mail, page, MWI update and
+ * external notification are handed to a worker thread and this returns
+ * as soon as they are queued.
+ *
  * \return zero on success, -1 on error.
  */
 static int notify_new_message(struct ast_channel *chan, struct ast_vm_user *vmu, struct vm_state *vms, int msgnum, long duration, char *fmt, char *cidnum, char *cidname, const char *flag)
 {
-	char todir[PATH_MAX], fn[PATH_MAX], ext_context[PATH_MAX], *stringp;
-	int newmsgs = 0, oldmsgs = 0, urgentmsgs = 0;
+	char todir[PATH_MAX], fn[PATH_MAX], *stringp;
 	const char *category;
 	char *myserveremail = serveremail;
 
@@ -8171,7 +8870,6 @@ static int notify_new_message(struct ast_channel *chan, struct ast_vm_user *vmu,
 	snprintf(todir, sizeof(todir), "%simap", VM_SPOOL_DIR);
 #endif
 	make_file(fn, sizeof(fn), todir, msgnum);
-	snprintf(ext_context, sizeof(ext_context), "%s@%s", vmu->mailbox, vmu->context);
 
 	if (!ast_strlen_zero(vmu->attachfmt)) {
 		if (strstr(fmt, vmu->attachfmt))
@@ -8185,6 +8883,12 @@ static int notify_new_message(struct ast_channel *chan, struct ast_vm_user *vmu,
 	stringp = fmt;
 	strsep(&stringp, "|");
 
+#ifndef IMAP_STORAGE
+	if (!queue_new_message_notification(chan, vmu, msgnum, duration, fmt, cidnum, cidname, flag, category)) {
+		return 0;
+	}
+#endif
+
 	if (!ast_strlen_zero(vmu->serveremail))
 		myserveremail = vmu->serveremail;
 
@@ -8208,25 +8912,17 @@ static int notify_new_message(struct ast_channel *chan, struct ast_vm_user *vmu,
 			RETRIEVE(todir, msgnum, vmu->mailbox, vmu->context);
 
 		/* XXX possible imap issue, should category be NULL XXX */
-		sendmail(myserveremail, vmu, msgnum, vmu->context, vmu->mailbox, mbox(vmu, 0), cidnum, cidname, fn, NULL, fmt, duration, attach_user_voicemail, chan, category, flag, msg_id);
+		sendmail(myserveremail, vmu, msgnum, vmu->context, vmu->mailbox, mbox(vmu, 0), cidnum, cidname, fn, NULL, fmt, duration, attach_user_voicemail, chan, category, flag, msg_id, 0);
 
 		if (attach_user_voicemail)
 			DISPOSE(todir, msgnum);
 	}
 
 	if (!ast_strlen_zero(vmu->pager)) {
-		sendpage(myserveremail, vmu->pager, msgnum, vmu->context, vmu->mailbox, mbox(vmu, 0), cidnum, cidname, duration, vmu, category, flag);
+		sendpage(myserveremail, vmu->pager, msgnum, vmu->context, vmu->mailbox, mbox(vmu, 0), cidnum, cidname, duration, vmu, category, flag, 0);
 	}
 
-	if (ast_test_flag(vmu, VM_DELETE))
-		DELETE(todir, msgnum, fn, vmu);
-
-	/* Leave voicemail for someone */
-	if (ast_app_has_voicemail(ext_context, NULL))
-		ast_app_inboxcount2(ext_context, &urgentmsgs, &newmsgs, &oldmsgs);
-
-	queue_mwi_event(ast_channel_uniqueid(chan), ext_context, urgentmsgs, newmsgs, oldmsgs);
-	run_externnotify(vmu->context, vmu->mailbox, flag);
+	notify_new_message_done(vmu, todir, msgnum, fn, ast_channel_uniqueid(chan), flag);
 
 #ifdef IMAP_STORAGE
 	vm_delete(fn);  /* Delete the file, but not the IMAP message */
@@ -8543,7 +9239,7 @@ static int forward_message(struct ast_channel *chan, char *context, struct vm_st
 					S_COR(ast_channel_caller(chan)->id.number.valid, ast_channel_caller(chan)->id.number.str, NULL),
 					S_COR(ast_channel_caller(chan)->id.name.valid, ast_channel_caller(chan)->id.name.str, NULL),
 					vmstmp.fn, vmstmp.introfn, fmt, duration, attach_user_voicemail, chan,
-					NULL, urgent_str, msg_id);
+					NULL, urgent_str, msg_id, 0);
 #else
 				copy_msg_result = copy_message(chan, sender, 0, curmsg, duration, vmtmp, fmt, dir, urgent_str, NULL);
 #endif
@@ -8850,6 +9546,8 @@ static int play_message(struct ast_channel *chan, struct ast_vm_user *vmu, struc
 
 	vms->starting = 0;
 	make_file(vms->fn, sizeof(vms->fn), vms->curdir, vms->curmsg);
+	/* Fetch the message while the prompts play */
+	PREFETCH(vms->curdir, vms->curmsg, vms->lastmsg);
 	adsi_message(chan, vms);
 	if (!vms->curmsg) {
 		res = wait_file2(chan, vms, "vm-first");	/* "First" */
@@ -8859,6 +9557,8 @@ static int play_message(struct ast_channel *chan, struct ast_vm_user *vmu, struc
 
 	snprintf(filename, sizeof(filename), "%s.txt", vms->fn);
 	RETRIEVE(vms->curdir, vms->curmsg, vmu->mailbox, vmu->context);
+	/* Fetch the next message while this one plays */
+	PREFETCH(vms->curdir, vms->curmsg + 1, vms->lastmsg);
 	msg_cfg = ast_config_load(filename, config_flags);
 	if (!valid_config(msg_cfg)) {
 		ast_log(LOG_WARNING, "No message attribute file?!! (%s)\n", filename);
@@ -13016,6 +13716,44 @@ static char *handle_voicemail_show_aliases(struct ast_cli_entry *e, int cmd, str
 	return res;
 }
 
+/*! \brief Show the state of the new message notification queue in the CLI */
+static char *handle_voicemail_show_notifications(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	long queued = 0;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "voicemail show notifications";
+		e->usage =
+			"Usage: voicemail show notifications\n"
+			"       Shows how many new message notifications are waiting to be sent\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3)
+		return CLI_SHOWUSAGE;
+
+	ast_mutex_lock(&notify_lock);
+	if (notify_pool) {
+		queued = ast_threadpool_queue_size(notify_pool);
+	}
+	if (notify_queue_size && notify_pool) {
+		ast_cli(a->fd, "Notifications are sent by %u threads, up to %u may wait\n", notify_threads, notify_queue_size);
+	} else {
+		ast_cli(a->fd, "Notifications are sent from the channel thread\n");
+	}
+	ast_cli(a->fd, "%-40s %u\n", "Pending:", notify_pending);
+	ast_cli(a->fd, "%-40s %ld\n", "Waiting for a thread:", queued);
+	ast_cli(a->fd, "%-40s %u\n", "Waiting to be tried again:", notify_retrying);
+	ast_cli(a->fd, "%-40s %u\n", "Given up on:", notify_failures);
+	ast_cli(a->fd, "%-40s %u\n", "Sent from the channel thread (queue full):", notify_overflows);
+	ast_mutex_unlock(&notify_lock);
+
+	return CLI_SUCCESS;
+}
+
 /*! \brief Reload voicemail configuration from the CLI */
 static char *handle_voicemail_reload(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
@@ -13043,6 +13781,7 @@ static struct ast_cli_entry cli_voicemail[] = {
 	AST_CLI_DEFINE(handle_voicemail_show_users, "List defined voicemail boxes"),
 	AST_CLI_DEFINE(handle_voicemail_show_zones, "List zone message formats"),
 	AST_CLI_DEFINE(handle_voicemail_show_aliases, "List mailbox aliases"),
+	AST_CLI_DEFINE(handle_voicemail_show_notifications, "Show the new message notification queue"),
 	AST_CLI_DEFINE(handle_voicemail_reload, "Reload voicemail configuration"),
 };
 
@@ -13220,6 +13959,92 @@ static void stop_poll_thread(void)
 	ast_mwi_remove_observer(&mwi_observer);
 }
 
+#ifndef IMAP_STORAGE
+/*! \brief Creates the notification worker threads, or resizes them on a reload */
+static void start_notify_pool(void)
+{
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 0,
+		.auto_increment = 0,
+		.initial_size = notify_threads,
+		.max_size = 0,
+	};
+
+	ast_mutex_lock(&notify_lock);
+	if (notify_pool) {
+		ast_threadpool_set_size(notify_pool, notify_threads);
+	} else if (!(notify_pool = ast_threadpool_create("app_voicemail_notify", NULL, &options))) {
+		ast_log(LOG_ERROR, "Could not create the notification threads, notifications will be sent from the channel thread\n");
+	}
+	ast_mutex_unlock(&notify_lock);
+}
+
+/*! \brief Waits for the queued notifications to be sent, then stops the worker threads */
+static void stop_notify_pool(void)
+{
+	ast_mutex_lock(&notify_lock);
+	notify_stopping = 1;
+	ast_cond_broadcast(&notify_cond);
+	while (notify_pending) {
+		ast_cond_wait(&notify_cond, &notify_lock);
+	}
+	ast_mutex_unlock(&notify_lock);
+
+	ast_mutex_lock(&notify_lock);
+	if (notify_pool) {
+		ast_threadpool_shutdown(notify_pool);
+		notify_pool = NULL;
+	}
+	notify_stopping = 0;
+	ast_mutex_unlock(&notify_lock);
+}
+#endif
+
+#ifdef ODBC_STORAGE
+/*! \brief Creates the threads copying messages ahead of their playback */
+static void start_prefetch_pool(void)
+{
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 0,
+		.auto_increment = 0,
+		.initial_size = PREFETCH_THREADS,
+		.max_size = 0,
+	};
+
+	ast_mutex_lock(&prefetch_lock);
+	odbc_prefetches = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, PREFETCH_BUCKETS,
+		odbc_prefetch_hash_fn, NULL, odbc_prefetch_cmp_fn);
+	if (odbc_prefetches
+		&& !(prefetch_pool = ast_threadpool_create("app_voicemail_prefetch", NULL, &options))) {
+		ast_log(LOG_WARNING, "Could not create the prefetch threads, messages will be retrieved when played\n");
+	}
+	ast_mutex_unlock(&prefetch_lock);
+}
+
+/*! \brief Stops the prefetch threads and removes the copies nobody played */
+static void stop_prefetch_pool(void)
+{
+	struct ast_threadpool *pool;
+
+	ast_mutex_lock(&prefetch_lock);
+	pool = prefetch_pool;
+	prefetch_pool = NULL;
+	ast_mutex_unlock(&prefetch_lock);
+
+	/* Without the lock, as the copies being made finish by taking it */
+	if (pool) {
+		ast_threadpool_shutdown(pool);
+	}
+
+	ast_mutex_lock(&prefetch_lock);
+	ao2_cleanup(odbc_prefetches);
+	odbc_prefetches = NULL;
+	ast_mutex_unlock(&prefetch_lock);
+}
+#endif
+
 /*!
  * \brief Append vmu info string into given astman with event_name.
  * \return 0 failed. 1 otherwise.
@@ -14222,6 +15047,53 @@ static int actual_load_config(int reload, struct ast_config *cfg, struct ast_con
 		if ((val = ast_variable_retrieve(cfg, "general", "pollmailboxes")))
 			poll_mailboxes = ast_true(val);
 
+		notify_queue_size = 0;
+		if ((val = ast_variable_retrieve(cfg, "general", "notifyqueue"))) {
+			if (sscanf(val, "%30u", &notify_queue_size) != 1) {
+				notify_queue_size = 0;
+				ast_log(AST_LOG_ERROR, "'%s' is not a valid value for the notifyqueue option!\n", val);
+			}
+		}
+
+		notify_threads = DEFAULT_NOTIFY_THREADS;
+		if ((val = ast_variable_retrieve(cfg, "general", "notifythreads"))) {
+			if (sscanf(val, "%30u", &notify_threads) != 1 || !notify_threads) {
+				notify_threads = DEFAULT_NOTIFY_THREADS;
+				ast_log(AST_LOG_ERROR, "'%s' is not a valid value for the notifythreads option!\n", val);
+			}
+		}
+
+		notify_retries = DEFAULT_NOTIFY_RETRIES;
+		if ((val = ast_variable_retrieve(cfg, "general", "notifyretries"))) {
+			if (sscanf(val, "%30u", &notify_retries) != 1) {
+				notify_retries = DEFAULT_NOTIFY_RETRIES;
+				ast_log(AST_LOG_ERROR, "'%s' is not a valid value for the notifyretries option!\n", val);
+			}
+		}
+
+		notify_retry_delay = DEFAULT_NOTIFY_RETRY_DELAY;
+		if ((val = ast_variable_retrieve(cfg, "general", "notifyretrydelay"))) {
+			if (sscanf(val, "%30u", &notify_retry_delay) != 1) {
+				notify_retry_delay = DEFAULT_NOTIFY_RETRY_DELAY;
+				ast_log(AST_LOG_ERROR, "'%s' is not a valid value for the notifyretrydelay option!\n", val);
+			}
+		}
+
+#ifndef IMAP_STORAGE
+		if (notify_queue_size) {
+			start_notify_pool();
+		}
+#endif
+
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+		mailbox_index = 1;
+		if ((val = ast_variable_retrieve(cfg, "general", "mailboxindex")))
+			mailbox_index = ast_true(val);
+		if (!mailbox_index && folder_index) {
+			ao2_callback(folder_index, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
+		}
+#endif
+
 		memset(fromstring, 0, sizeof(fromstring));
 		memset(pagerfromstring, 0, sizeof(pagerfromstring));
 		strcpy(charset, "ISO-8859-1");
@@ -14745,6 +15617,227 @@ AST_TEST_DEFINE(test_voicemail_msgcount)
 	return res;
 }
 
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+/*! \brief Create an empty message information file and age its folder */
+static int folder_index_test_add(const char *dir, int msgnum, time_t mtime)
+{
+	char fn[PATH_MAX];
+	struct timeval times[2] = { { mtime, 0 }, { mtime, 0 } };
+	FILE *txt;
+
+	snprintf(fn, sizeof(fn), "%s/msg%04d.txt", dir, msgnum);
+	if (!(txt = fopen(fn, "w"))) {
+		return -1;
+	}
+	fclose(txt);
+
+	return utimes(dir, times);
+}
+
+AST_TEST_DEFINE(test_voicemail_folder_index)
+{
+	int res = AST_TEST_PASS;
+	const char testcontext[] = "test";
+	const char testmailbox[] = "00000000";
+	char syscmd[256];
+	char dir[PATH_MAX];
+	char file[PATH_MAX];
+	struct ast_vm_user vmu = { .maxmsg = 100 };
+	time_t then = time(NULL) - 60;
+	struct timeval times[2] = { { 0, 0 }, { 0, 0 } };
+	int count = 0;
+	int last = -1;
+	int syserr;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "test_voicemail_folder_index";
+		info->category = "/apps/app_voicemail/";
+		info->summary = "Test the mailbox folder index";
+		info->description =
+			"Verify that folders are only read again when they change";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	snprintf(syscmd, sizeof(syscmd), "rm -rf \"%s%s/%s\"", VM_SPOOL_DIR, testcontext, testmailbox);
+	if ((syserr = ast_safe_system(syscmd))) {
+		ast_test_status_update(test, "Unable to clear test directory: %s\n",
+			syserr > 0 ? strerror(syserr) : "unable to fork()");
+		return AST_TEST_FAIL;
+	}
+
+	if (!mailbox_index) {
+		ast_test_status_update(test, "mailboxindex is disabled, nothing to test\n");
+		return AST_TEST_NOT_RUN;
+	}
+
+	create_dirpath(dir, sizeof(dir), testcontext, testmailbox, "INBOX");
+	make_file(file, sizeof(file), dir, 3);
+	if (folder_index_test_add(dir, 0, then) || folder_index_test_add(dir, 1, then)) {
+		ast_test_status_update(test, "Unable to create test messages in %s\n", dir);
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (__has_voicemail(testcontext, testmailbox, "INBOX", 0) != 2 || last_message_index(&vmu, dir) != 1) {
+		ast_test_status_update(test, "Folder %s was not read correctly\n", dir);
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	/* A message added behind our back without the folder changing its
+	 * modification time is not seen, which proves the index was used. */
+	folder_index_test_add(dir, 2, then);
+	if (folder_index_lookup(dir, &count, &last) || count != 2 || last != 1) {
+		ast_test_status_update(test, "Folder %s was read again while unchanged\n", dir);
+		res = AST_TEST_FAIL;
+	}
+
+	/* Once the modification time moves the folder is read again */
+	folder_index_test_add(dir, 3, then + 1);
+	if (folder_index_lookup(dir, &count, &last) != -1
+		|| __has_voicemail(testcontext, testmailbox, "INBOX", 0) != 4 || last_message_index(&vmu, dir) != 3) {
+		ast_test_status_update(test, "Folder %s was not read again after changing\n", dir);
+		res = AST_TEST_FAIL;
+	}
+
+	/* Deleting a message drops the entry, whatever the modification time says */
+	vm_delete(file);
+	times[0].tv_sec = times[1].tv_sec = then + 1;
+	utimes(dir, times);
+	if (!folder_index_lookup(dir, &count, &last)
+		|| count_messages(&vmu, dir) != 3 || last_message_index(&vmu, dir) != 2) {
+		ast_test_status_update(test, "Folder %s was not read again after a delete\n", dir);
+		res = AST_TEST_FAIL;
+	}
+
+	if (__has_voicemail(testcontext, testmailbox, "Old", 0) != 0) {
+		ast_test_status_update(test, "Unexpected message count in Old for %s@%s\n", testmailbox, testcontext);
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	snprintf(syscmd, sizeof(syscmd), "rm -rf \"%s%s/%s\"", VM_SPOOL_DIR, testcontext, testmailbox);
+	if ((syserr = ast_safe_system(syscmd))) {
+		ast_test_status_update(test, "Unable to clear test directory: %s\n",
+			syserr > 0 ? strerror(syserr) : "unable to fork()");
+	}
+	folder_index_forget(file);
+
+	return res;
+}
+#endif
+
+#ifndef IMAP_STORAGE
+AST_TEST_DEFINE(test_voicemail_notify_queue)
+{
+	int res = AST_TEST_PASS;
+	char script[] = "/tmp/vmnotify-XXXXXX";
+	char flagfile[PATH_MAX];
+	char outfile[PATH_MAX];
+	char saved_mailcmd[sizeof(mailcmd)];
+	unsigned int saved_queue_size = notify_queue_size;
+	unsigned int saved_retries = notify_retries;
+	unsigned int saved_retry_delay = notify_retry_delay;
+	unsigned int failures;
+	int created_pool = 0;
+	struct ast_vm_user vmu = {
+		.context = "test",
+		.mailbox = "00000000",
+		.pager = "pager@example.net",
+		.maxmsg = 100,
+	};
+	struct ast_channel *chan;
+	struct timespec ts;
+	FILE *fp;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "test_voicemail_notify_queue";
+		info->category = "/apps/app_voicemail/";
+		info->summary = "Test queued new message notifications";
+		info->description =
+			"Verify that a queued notification is sent from a worker thread\n"
+			"and tried again when the mail command fails";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	/* The mail command fails the first time it runs and saves the page the second time */
+	if (!(fp = vm_mkftemp(script))) {
+		ast_test_status_update(test, "Unable to create the mail command script\n");
+		return AST_TEST_FAIL;
+	}
+	snprintf(flagfile, sizeof(flagfile), "%s.flag", script);
+	snprintf(outfile, sizeof(outfile), "%s.out", script);
+	fprintf(fp, "if [ -e %s ]; then cat > %s; else touch %s; exit 1; fi\n", flagfile, outfile, flagfile);
+	fclose(fp);
+
+	if (!(chan = ast_dummy_channel_alloc())) {
+		ast_test_status_update(test, "Unable to create dummy channel\n");
+		unlink(script);
+		return AST_TEST_FAIL;
+	}
+
+	ast_copy_string(saved_mailcmd, mailcmd, sizeof(saved_mailcmd));
+	snprintf(mailcmd, sizeof(mailcmd), "/bin/sh %s", script);
+	ast_mutex_lock(&notify_lock);
+	notify_queue_size = 10;
+	notify_retries = 1;
+	notify_retry_delay = 0;
+	failures = notify_failures;
+	created_pool = !notify_pool;
+	ast_mutex_unlock(&notify_lock);
+	if (created_pool) {
+		start_notify_pool();
+	}
+
+	notify_new_message(chan, &vmu, NULL, 0, 10, "gsm", "1234", "Test Caller", "");
+
+	ast_mutex_lock(&notify_lock);
+	ts.tv_sec = time(NULL) + 10;
+	ts.tv_nsec = 0;
+	while (notify_pending) {
+		if (ast_cond_timedwait(&notify_cond, &notify_lock, &ts) == ETIMEDOUT) {
+			break;
+		}
+	}
+	if (notify_pending) {
+		ast_test_status_update(test, "The notification was not sent in time\n");
+		res = AST_TEST_FAIL;
+	} else if (notify_failures != failures) {
+		ast_test_status_update(test, "The notification was given up on\n");
+		res = AST_TEST_FAIL;
+	}
+	ast_mutex_unlock(&notify_lock);
+
+	if (res == AST_TEST_PASS && access(outfile, F_OK)) {
+		ast_test_status_update(test, "The page was not handed to the mail command after a retry\n");
+		res = AST_TEST_FAIL;
+	}
+
+	if (created_pool) {
+		stop_notify_pool();
+	}
+	ast_mutex_lock(&notify_lock);
+	notify_queue_size = saved_queue_size;
+	notify_retries = saved_retries;
+	notify_retry_delay = saved_retry_delay;
+	ast_mutex_unlock(&notify_lock);
+	ast_copy_string(mailcmd, saved_mailcmd, sizeof(mailcmd));
+
+	ast_channel_unref(chan);
+	unlink(script);
+	unlink(flagfile);
+	unlink(outfile);
+
+	return res;
+}
+#endif
+
 AST_TEST_DEFINE(test_voicemail_notify_endl)
 {
 	int res = AST_TEST_PASS;
@@ -15063,18 +16156,34 @@ static int unload_module(void)
 #ifdef TEST_FRAMEWORK
 	res |= AST_TEST_UNREGISTER(test_voicemail_vmsayname);
 	res |= AST_TEST_UNREGISTER(test_voicemail_msgcount);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	res |= AST_TEST_UNREGISTER(test_voicemail_folder_index);
+#endif
 	res |= AST_TEST_UNREGISTER(test_voicemail_vmuser);
 	res |= AST_TEST_UNREGISTER(test_voicemail_notify_endl);
+#ifndef IMAP_STORAGE
+	res |= AST_TEST_UNREGISTER(test_voicemail_notify_queue);
+#endif
 	res |= AST_TEST_UNREGISTER(test_voicemail_load_config);
 	res |= AST_TEST_UNREGISTER(test_voicemail_vm_info);
 #endif
 	ast_cli_unregister_multiple(cli_voicemail, ARRAY_LEN(cli_voicemail));
+#ifndef IMAP_STORAGE
+	stop_notify_pool();
+#endif
+#ifdef ODBC_STORAGE
+	stop_prefetch_pool();
+#endif
 	ast_vm_unregister(vm_table.module_name);
 	ast_vm_greeter_unregister(vm_greeter_table.module_name);
 #ifdef TEST_FRAMEWORK
 	ast_uninstall_vm_test_functions();
 #endif
 	ao2_ref(inprocess_container, -1);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	ao2_cleanup(folder_index);
+	folder_index = NULL;
+#endif
 
 	ao2_container_unregister("voicemail_alias_mailbox_mappings");
 	ao2_cleanup(alias_mailbox_mappings);
@@ -15132,6 +16241,7 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+
 	alias_mailbox_mappings = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, MAPPING_BUCKETS,
 		alias_mailbox_mapping_hash_fn, NULL, alias_mailbox_mapping_cmp_fn);
 	if (!alias_mailbox_mappings) {
@@ -15166,6 +16276,23 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	folder_index = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, FOLDER_INDEX_BUCKETS,
+		vm_folder_index_hash_fn, NULL, vm_folder_index_cmp_fn);
+	if (!folder_index) {
+		ast_log(LOG_ERROR, "Unable to create folder_index container\n");
+		ao2_cleanup(inprocess_container);
+		ao2_container_unregister("voicemail_alias_mailbox_mappings");
+		ao2_cleanup(alias_mailbox_mappings);
+		ao2_container_unregister("voicemail_mailbox_alias_mappings");
+		ao2_cleanup(mailbox_alias_mappings);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+#endif
+#ifdef ODBC_STORAGE
+	start_prefetch_pool();
+#endif
+
 	/* compute the location of the voicemail spool directory */
 	snprintf(VM_SPOOL_DIR, sizeof(VM_SPOOL_DIR), "%s/voicemail/", ast_config_AST_SPOOL_DIR);
 
@@ -15190,8 +16317,14 @@ static int load_module(void)
 #ifdef TEST_FRAMEWORK
 	res |= AST_TEST_REGISTER(test_voicemail_vmsayname);
 	res |= AST_TEST_REGISTER(test_voicemail_msgcount);
+#if !(defined(ODBC_STORAGE) || defined(IMAP_STORAGE))
+	res |= AST_TEST_REGISTER(test_voicemail_folder_index);
+#endif
 	res |= AST_TEST_REGISTER(test_voicemail_vmuser);
 	res |= AST_TEST_REGISTER(test_voicemail_notify_endl);
+#ifndef IMAP_STORAGE
+	res |= AST_TEST_REGISTER(test_voicemail_notify_queue);
+#endif
 	res |= AST_TEST_REGISTER(test_voicemail_load_config);
 	res |= AST_TEST_REGISTER(test_voicemail_vm_info);
 #endif
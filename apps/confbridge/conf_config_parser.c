@@ -91,6 +91,17 @@
 				<configOption name="startmuted">
 					<synopsis>Sets if all users should start out muted</synopsis>
 				</configOption>
+				<configOption name="listen_only" default="no">
+					<synopsis>Sets if the user can only listen to the conference</synopsis>
+					<description><para>
+						A listen only user is muted for the whole time they are in the
+						conference and cannot be unmuted by themselves, by an admin, over
+						AMI or from the CLI.  Since their audio never reaches the mixer,
+						every listen only user with the same codec is sent a single shared
+						encoding of the conference audio, which makes very large conferences
+						that are mostly listeners much cheaper to mix.</para>
+					</description>
+				</configOption>
 				<configOption name="music_on_hold_when_empty">
 					<synopsis>Play MOH when user is alone or waiting on a marked user</synopsis>
 				</configOption>
@@ -313,6 +324,19 @@
 						or 80.
 					</para></description>
 				</configOption>
+				<configOption name="mixing_threads" default="1">
+					<synopsis>Sets the number of threads used to write mixed audio to participants</synopsis>
+					<description><para>
+						The mixed audio for the conference is computed once per mixing interval by
+						a single thread.  Removing each talker's own audio from the mix, encoding it
+						and queueing it to the participant is normally done by that same thread,
+						which limits very large conferences to a single processor core.  Setting this
+						to a value larger than 1 splits that work across the given number of threads.
+						The extra threads are only used while the conference has at least 8
+						participants per thread and are not used when binaural rendering is active.
+						Valid values are 1 to 32.
+					</para></description>
+				</configOption>
 				<configOption name="binaural_active">
 					<synopsis>If true binaural conferencing with stereo audio is active</synopsis>
 					<description><para>
@@ -1618,6 +1642,9 @@ static char *handle_cli_confbridge_show_user_profile(struct ast_cli_entry *e, in
 	ast_cli(a->fd,"Answer Channel:          %s\n",
 			u_profile.flags & USER_OPT_ANSWER_CHANNEL ?
 			"true" : "false");
+	ast_cli(a->fd,"Listen Only:             %s\n",
+			u_profile.flags & USER_OPT_LISTEN_ONLY ?
+			"yes" : "no");
 	ast_cli(a->fd, "\n");
 
 	return CLI_SUCCESS;
@@ -1734,6 +1761,8 @@ static char *handle_cli_confbridge_show_bridge_profile(struct ast_cli_entry *e,
 		ast_cli(a->fd,"Mixing Interval:      Default 20ms\n");
 	}
 
+	ast_cli(a->fd,"Mixing Threads:       %u\n", b_profile.mixing_threads);
+
 	ast_cli(a->fd,"Record Conference:    %s\n",
 		b_profile.flags & BRIDGE_OPT_RECORD_CONFERENCE ?
 		"yes" : "no");
@@ -2394,6 +2423,7 @@ int conf_load_config(void)
 	aco_option_register(&cfg_info, "echo_events", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_ECHO_EVENTS);
 	aco_option_register(&cfg_info, "marked", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_MARKEDUSER);
 	aco_option_register(&cfg_info, "startmuted", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_STARTMUTED);
+	aco_option_register(&cfg_info, "listen_only", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_LISTEN_ONLY);
 	aco_option_register(&cfg_info, "music_on_hold_when_empty", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_MUSICONHOLD);
 	aco_option_register(&cfg_info, "quiet", ACO_EXACT, user_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct user_profile, flags), USER_OPT_QUIET);
 	aco_option_register_custom(&cfg_info, "announce_user_count_all", ACO_EXACT, user_types, "no", announce_user_count_all_handler, 0);
@@ -2430,6 +2460,7 @@ int conf_load_config(void)
 	aco_option_register(&cfg_info, "binaural_active", ACO_EXACT, bridge_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct bridge_profile, flags), BRIDGE_OPT_BINAURAL_ACTIVE);
 	aco_option_register(&cfg_info, "maximum_sample_rate", ACO_EXACT, bridge_types, "0", OPT_UINT_T, PARSE_DEFAULT, FLDSET(struct bridge_profile, maximum_sample_rate), 0);
 	aco_option_register_custom(&cfg_info, "mixing_interval", ACO_EXACT, bridge_types, "20", mix_interval_handler, 0);
+	aco_option_register(&cfg_info, "mixing_threads", ACO_EXACT, bridge_types, "1", OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct bridge_profile, mixing_threads), 1, 32);
 	aco_option_register(&cfg_info, "record_conference", ACO_EXACT, bridge_types, "no", OPT_BOOLFLAG_T, 1, FLDSET(struct bridge_profile, flags), BRIDGE_OPT_RECORD_CONFERENCE);
 	aco_option_register_custom(&cfg_info, "video_mode", ACO_EXACT, bridge_types, NULL, video_mode_handler, 0);
 	aco_option_register(&cfg_info, "record_file_append", ACO_EXACT, bridge_types, "yes", OPT_BOOLFLAG_T, 1, FLDSET(struct bridge_profile, flags), BRIDGE_OPT_RECORD_FILE_APPEND);
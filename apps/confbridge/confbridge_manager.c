@@ -276,8 +276,16 @@ const char *confbridge_event_type_to_string(struct stasis_message_type *event_ty
 static struct ast_json *channel_to_json(struct ast_channel_snapshot *channel_snapshot,
 	struct ast_json *conf_blob, struct ast_json *labels_blob)
 {
-	struct ast_json *json_channel = ast_channel_snapshot_to_json(channel_snapshot, NULL);
+	struct ast_json *json_snapshot = ast_channel_snapshot_to_json(channel_snapshot, NULL);
+	struct ast_json *json_channel;
+
+	if (!json_snapshot) {
+		return NULL;
+	}
 
+	/* The snapshot JSON is shared by every consumer, so change a copy */
+	json_channel = ast_json_deep_copy(json_snapshot);
+	ast_json_unref(json_snapshot);
 	if (!json_channel) {
 		return NULL;
 	}
@@ -47,6 +47,8 @@
 #include "asterisk/frame.h"
 #include "asterisk/musiconhold.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/translate.h"
+#include "asterisk/vector.h"
 
 enum holding_roles {
 	HOLDING_ROLE_PARTICIPANT,
@@ -61,11 +63,23 @@ enum idle_modes {
 	IDLE_MODE_HOLD,
 };
 
+/*! \brief Encoding of the announcer's audio shared by participants using one format */
+struct holding_encoder {
+	/*! The format encoded to */
+	struct ast_format *format;
+	/*! The translation path from signed linear */
+	struct ast_trans_pvt *trans;
+	/*! The audio being written, encoded */
+	struct ast_frame *frame;
+};
+
 /*! \brief Structure which contains per-channel role information */
 struct holding_channel {
 	struct ast_silence_generator *silence_generator;
 	enum holding_roles role;
 	enum idle_modes idle_mode;
+	/*! Encoders of an announcer, one per format its participants use */
+	AST_VECTOR(, struct holding_encoder) encoders;
 	/*! TRUE if the entertainment is started. */
 	unsigned int entertainment_active:1;
 };
@@ -203,7 +217,8 @@ static void participant_entertainment_start(struct ast_bridge_channel *bridge_ch
 	switch(hc->idle_mode) {
 	case IDLE_MODE_MOH:
 		moh_class = ast_bridge_channel_get_role_option(bridge_channel, "holding_participant", "moh_class");
-		if (ast_moh_start(bridge_channel->chan, moh_class, NULL)) {
+		/* Everyone waiting on a class hears one shared timeline */
+		if (ast_moh_start_shared(bridge_channel->chan, moh_class, NULL)) {
 			ast_log(LOG_WARNING, "Failed to start moh, starting silence generator instead\n");
 			hc->idle_mode = IDLE_MODE_SILENCE;
 			hc->silence_generator = ast_channel_start_silence_generator(bridge_channel->chan);
@@ -300,6 +315,12 @@ static void participant_reaction_announcer_leave(struct ast_bridge_channel *brid
 	participant_entertainment_start(bridge_channel);
 }
 
+static void holding_encoder_destroy(struct holding_encoder encoder)
+{
+	ast_translator_free_path(encoder.trans);
+	ao2_ref(encoder.format, -1);
+}
+
 static void holding_bridge_leave(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel)
 {
 	struct ast_bridge_channel *other_channel;
@@ -325,9 +346,123 @@ static void holding_bridge_leave(struct ast_bridge *bridge, struct ast_bridge_ch
 		break;
 	}
 	bridge_channel->tech_pvt = NULL;
+	AST_VECTOR_RESET(&hc->encoders, holding_encoder_destroy);
+	AST_VECTOR_FREE(&hc->encoders);
 	ast_free(hc);
 }
 
+/*!
+ * \internal
+ * \brief Get the announcer's audio encoded for a participant
+ *
+ * The audio is encoded once for every format in use, however many
+ * participants use it.
+ *
+ * \return The encoded frame, to be shared, or NULL to write the audio as it is
+ */
+static struct ast_frame *holding_encoded_frame(struct holding_channel *hc,
+	struct ast_bridge_channel *bridge_channel, struct ast_frame *frame)
+{
+	struct ast_channel *chan = bridge_channel->chan;
+	struct ast_format *format;
+	struct holding_encoder *encoder = NULL;
+	struct holding_encoder new_encoder;
+	int i;
+
+	ast_channel_lock(chan);
+	if (ast_channel_audiohooks(chan)) {
+		/* Audiohooks only see signed linear, so let the channel encode */
+		ast_channel_unlock(chan);
+		return NULL;
+	}
+	format = ao2_bump(ast_channel_rawwriteformat(chan));
+	ast_channel_unlock(chan);
+
+	if (ast_format_cmp(format, frame->subclass.format) == AST_FORMAT_CMP_EQUAL) {
+		ao2_ref(format, -1);
+		return NULL;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&hc->encoders); i++) {
+		if (ast_format_cmp(AST_VECTOR_GET(&hc->encoders, i).format, format) == AST_FORMAT_CMP_EQUAL) {
+			encoder = AST_VECTOR_GET_ADDR(&hc->encoders, i);
+			break;
+		}
+	}
+
+	if (!encoder) {
+		new_encoder.format = format;
+		new_encoder.trans = ast_translator_build_path(format, frame->subclass.format);
+		new_encoder.frame = NULL;
+		if (!new_encoder.trans || AST_VECTOR_APPEND(&hc->encoders, new_encoder)) {
+			ast_translator_free_path(new_encoder.trans);
+			ao2_ref(format, -1);
+			return NULL;
+		}
+		encoder = AST_VECTOR_GET_ADDR(&hc->encoders, AST_VECTOR_SIZE(&hc->encoders) - 1);
+	} else {
+		ao2_ref(format, -1);
+	}
+
+	if (!encoder->frame) {
+		struct ast_frame *encoded = ast_translate(encoder->trans, frame, 0);
+
+		if (encoded) {
+			encoder->frame = ast_frshare(encoded);
+			ast_frfree(encoded);
+		}
+	}
+
+	return encoder->frame;
+}
+
+/*!
+ * \internal
+ * \brief Write the announcer's audio to every participant
+ *
+ * Rather than every participant translating the audio on its own write
+ * path, it is encoded here once for each format in use and the encoded
+ * payload is shared by the participants using that format.
+ */
+static void holding_announcer_write(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel,
+	struct holding_channel *hc, struct ast_frame *frame)
+{
+	struct ast_bridge_channel *cur;
+	struct ast_frame *shared = NULL;
+	int i;
+
+	if (frame->frametype != AST_FRAME_VOICE || !frame->datalen
+		|| bridge->num_channels < 3) {
+		ast_bridge_queue_everyone_else(bridge, bridge_channel, frame);
+		return;
+	}
+
+	AST_LIST_TRAVERSE(&bridge->channels, cur, entry) {
+		struct ast_frame *encoded;
+
+		if (cur == bridge_channel) {
+			continue;
+		}
+		encoded = holding_encoded_frame(hc, cur, frame);
+		if (!encoded && !shared) {
+			shared = ast_frshare(frame);
+		}
+		ast_bridge_channel_queue_frame(cur, encoded ?: shared ?: frame);
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&hc->encoders); i++) {
+		struct holding_encoder *encoder = AST_VECTOR_GET_ADDR(&hc->encoders, i);
+
+		if (encoder->frame) {
+			ast_frfree(encoder->frame);
+			encoder->frame = NULL;
+		}
+	}
+	if (shared) {
+		ast_frfree(shared);
+	}
+}
+
 static int holding_bridge_write(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel, struct ast_frame *frame)
 {
 	struct holding_channel *hc = bridge_channel ? bridge_channel->tech_pvt : NULL;
@@ -341,7 +476,7 @@ static int holding_bridge_write(struct ast_bridge *bridge, struct ast_bridge_cha
 	switch (hc->role) {
 	case HOLDING_ROLE_ANNOUNCER:
 		/* Write the frame to all other channels if any. */
-		ast_bridge_queue_everyone_else(bridge, bridge_channel, frame);
+		holding_announcer_write(bridge, bridge_channel, hc, frame);
 		break;
 	default:
 		/* "Accept" the frame and discard it. */
@@ -798,6 +798,7 @@ static int native_rtp_bridge_framehook_attach(struct ast_bridge_channel *bridge_
 		.event_cb = native_rtp_framehook,
 		.destroy_cb = __ao2_cleanup,
 		.consume_cb = native_rtp_framehook_consume,
+		.frame_types = AST_FRAMEHOOK_TYPE(AST_FRAME_CONTROL),
 		.disable_inheritance = 1,
 	};
 
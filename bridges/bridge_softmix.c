@@ -39,6 +39,7 @@
 #include "asterisk/test.h"
 #include "asterisk/vector.h"
 #include "asterisk/message.h"
+#include "asterisk/slinear_mix.h"
 #include "bridge_softmix/include/bridge_softmix_internal.h"
 
 /*! The minimum sample rate of the bridge. */
@@ -192,6 +193,41 @@ static int16_t *softmix_process_read_audio(struct softmix_channel *sc, unsigned
 	return NULL;
 }
 
+/*!
+ * \internal
+ * \brief Get the path a talker's own mix is encoded with by the mixing thread
+ *
+ * \details Only write formats whose translator can encode many channels in
+ * one call are encoded here.  Everything else is left to the channel's own
+ * write translation.  The path is kept with the channel and only rebuilt
+ * when its write format or the mixing rate changes.
+ *
+ * \retval NULL if the channel's write translation should encode the mix
+ * \return the path to encode the channel's mix with otherwise
+ */
+static struct ast_trans_pvt *softmix_talker_trans(struct softmix_translate_helper *trans_helper,
+	struct ast_format *raw_write_fmt, struct softmix_channel *sc)
+{
+	if (sc->talker_dst && sc->talker_src == trans_helper->slin_src
+		&& ast_format_cmp(sc->talker_dst, raw_write_fmt) == AST_FORMAT_CMP_EQUAL) {
+		return sc->talker_trans;
+	}
+
+	if (sc->talker_trans) {
+		ast_translator_free_path(sc->talker_trans);
+	}
+	ao2_replace(sc->talker_dst, raw_write_fmt);
+	ao2_replace(sc->talker_src, trans_helper->slin_src);
+
+	sc->talker_trans = ast_translator_build_path(raw_write_fmt, trans_helper->slin_src);
+	if (sc->talker_trans && !ast_translator_can_batch(sc->talker_trans)) {
+		ast_translator_free_path(sc->talker_trans);
+		sc->talker_trans = NULL;
+	}
+
+	return sc->talker_trans;
+}
+
 /*!
  * \internal
  * \brief Process a softmix channel's write audio
@@ -199,19 +235,19 @@ static int16_t *softmix_process_read_audio(struct softmix_channel *sc, unsigned
  * \details This function will remove the channel's talking from its own audio if present and
  * possibly even do the channel's write translation for it depending on how many other
  * channels use the same write format.
+ *
+ * \retval 1 if the channel's own mix should be encoded with softmix_talker_batch_add()
+ * \retval 0 if the write frame is ready to be queued
  */
-static void softmix_process_write_audio(struct softmix_translate_helper *trans_helper,
+static int softmix_process_write_audio(struct softmix_translate_helper *trans_helper,
 	struct ast_format *raw_write_fmt,
 	struct softmix_channel *sc, unsigned int default_sample_size)
 {
 	struct softmix_translate_helper_entry *entry = NULL;
-	int i;
 
 	/* If we provided any audio then take it out while in slinear format. */
 	if (sc->have_audio && !sc->binaural) {
-		for (i = 0; i < sc->write_frame.samples; i++) {
-			ast_slinear_saturated_subtract(&sc->final_buf[i], &sc->our_buf[i]);
-		}
+		ast_slinear_mix_subtract(sc->final_buf, sc->our_buf, sc->write_frame.samples);
 		/* check to see if any entries exist for the format. if not we'll want
 		   to remove it during cleanup */
 		AST_LIST_TRAVERSE(&trans_helper->entries, entry, entry) {
@@ -221,15 +257,16 @@ static void softmix_process_write_audio(struct softmix_translate_helper *trans_h
 			}
 		}
 		/* do not do any special write translate optimization if we had to make
-		 * a special mix for them to remove their own audio. */
-		return;
+		 * a special mix for them to remove their own audio, but the mixes of
+		 * all such talkers may still be encoded together. */
+		return softmix_talker_trans(trans_helper, raw_write_fmt, sc) ? 1 : 0;
 	} else if (sc->have_audio && sc->binaural > 0) {
 		/*
 		 * Binaural audio requires special saturated substract since we have two
 		 * audio signals per channel now.
 		 */
 		softmix_process_write_binaural_audio(sc, default_sample_size);
-		return;
+		return 0;
 	}
 
 	/* Attempt to optimize channels using the same translation path/codec. Build a list of entries
@@ -251,6 +288,13 @@ static void softmix_process_write_audio(struct softmix_translate_helper *trans_h
 		}
 		if (entry->trans_pvt && !entry->out_frame) {
 			entry->out_frame = ast_translate(entry->trans_pvt, &sc->write_frame, 0);
+			if (entry->out_frame && entry->out_frame->frametype == AST_FRAME_VOICE) {
+				/* Listeners are all queued this one frame, share its payload between them. */
+				struct ast_frame *shared = ast_frshare(entry->out_frame);
+
+				ast_frfree(entry->out_frame);
+				entry->out_frame = shared;
+			}
 		}
 		if (entry->out_frame && entry->out_frame->frametype == AST_FRAME_VOICE
 				&& entry->out_frame->datalen < MAX_DATALEN) {
@@ -266,6 +310,146 @@ static void softmix_process_write_audio(struct softmix_translate_helper *trans_h
 	if (!entry && (entry = softmix_translate_helper_entry_alloc(raw_write_fmt))) {
 		AST_LIST_INSERT_HEAD(&trans_helper->entries, entry, entry);
 	}
+
+	return 0;
+}
+
+/*! Most talkers whose mixes are encoded by one call to ast_translate_batch() */
+#define SOFTMIX_TALKER_BATCH_MAX 32
+
+/*!
+ * \brief Talkers waiting for their own mix to be encoded
+ *
+ * Every talker hears a mix of its own, so unlike listeners their frames
+ * cannot be shared.  They are still mostly encoded with the same few
+ * translators, so they are collected and encoded together before being
+ * queued.
+ */
+struct softmix_talker_batch {
+	/*! Number of talkers collected */
+	unsigned int count;
+	/*! The talkers, each with a talker_trans path */
+	struct ast_bridge_channel *channels[SOFTMIX_TALKER_BATCH_MAX];
+};
+
+/*!
+ * \internal
+ * \brief Encode the mixes of the collected talkers and queue them
+ */
+static void softmix_talker_batch_flush(struct softmix_talker_batch *batch)
+{
+	struct ast_trans_pvt *paths[SOFTMIX_TALKER_BATCH_MAX];
+	struct ast_frame *frames[SOFTMIX_TALKER_BATCH_MAX];
+	struct ast_frame *out[SOFTMIX_TALKER_BATCH_MAX];
+	unsigned int idx;
+
+	if (!batch->count) {
+		return;
+	}
+
+	/* Keep talkers sharing a translator next to each other so they are encoded in one run */
+	for (idx = 1; idx < batch->count; ++idx) {
+		struct ast_bridge_channel *bridge_channel = batch->channels[idx];
+		struct softmix_channel *sc = bridge_channel->tech_pvt;
+		unsigned int pos = idx;
+
+		while (pos > 0) {
+			struct softmix_channel *prev = batch->channels[pos - 1]->tech_pvt;
+
+			if ((uintptr_t) prev->talker_trans->t <= (uintptr_t) sc->talker_trans->t) {
+				break;
+			}
+			batch->channels[pos] = batch->channels[pos - 1];
+			--pos;
+		}
+		batch->channels[pos] = bridge_channel;
+	}
+
+	for (idx = 0; idx < batch->count; ++idx) {
+		struct softmix_channel *sc = batch->channels[idx]->tech_pvt;
+
+		ast_mutex_lock(&sc->lock);
+		paths[idx] = sc->talker_trans;
+		frames[idx] = &sc->write_frame;
+	}
+
+	ast_translate_batch(paths, frames, out, batch->count);
+
+	for (idx = 0; idx < batch->count; ++idx) {
+		struct ast_bridge_channel *bridge_channel = batch->channels[idx];
+		struct softmix_channel *sc = bridge_channel->tech_pvt;
+
+		/* Without an encoded frame the channel's write translation still gets the mix */
+		if (out[idx]) {
+			if (out[idx]->frametype == AST_FRAME_VOICE && out[idx]->datalen < MAX_DATALEN) {
+				ao2_replace(sc->write_frame.subclass.format, out[idx]->subclass.format);
+				memcpy(sc->final_buf, out[idx]->data.ptr, out[idx]->datalen);
+				sc->write_frame.datalen = out[idx]->datalen;
+				sc->write_frame.samples = out[idx]->samples;
+			}
+			ast_frfree(out[idx]);
+		}
+
+		ast_mutex_unlock(&sc->lock);
+
+		ast_bridge_channel_queue_frame(bridge_channel, &sc->write_frame);
+	}
+
+	batch->count = 0;
+}
+
+/*!
+ * \internal
+ * \brief Collect a talker whose own mix is ready and awaiting encoding
+ *
+ * \note The talker's frame is queued once the batch is flushed.
+ */
+static void softmix_talker_batch_add(struct softmix_talker_batch *batch,
+	struct ast_bridge_channel *bridge_channel)
+{
+	batch->channels[batch->count++] = bridge_channel;
+	if (batch->count == SOFTMIX_TALKER_BATCH_MAX) {
+		softmix_talker_batch_flush(batch);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Hand a listener the mix already encoded for its write format
+ *
+ * \details Every participant that did not contribute audio this mixing
+ * interval hears exactly the same mix.  Once the mix has been encoded for a
+ * format, every other such listener using that format can be queued the
+ * encoded frame as is.  Its payload is shared, so this skips copying the
+ * signed linear mix into the channel's buffer, copying the encoded result
+ * back out again and copying it once more when queueing, which for
+ * conferences made up mostly of listeners is most of the per-participant
+ * work left.
+ *
+ * \retval NULL if the caller needs to build the write frame itself
+ * \return the shared encoded frame to queue otherwise
+ */
+static struct ast_frame *softmix_write_broadcast_audio(struct softmix_translate_helper *trans_helper,
+	struct ast_format *raw_write_fmt, struct softmix_channel *sc)
+{
+	struct softmix_translate_helper_entry *entry;
+
+	if (sc->have_audio || sc->binaural) {
+		return NULL;
+	}
+
+	AST_LIST_TRAVERSE(&trans_helper->entries, entry, entry) {
+		if (ast_format_cmp(entry->dst_format, raw_write_fmt) == AST_FORMAT_CMP_EQUAL) {
+			break;
+		}
+	}
+	if (!entry || !entry->out_frame || !(entry->out_frame->mallocd & AST_MALLOCD_SHARED)) {
+		return NULL;
+	}
+
+	++entry->num_times_requested;
+
+	return entry->out_frame;
 }
 
 static void softmix_translate_helper_cleanup(struct softmix_translate_helper *trans_helper)
@@ -718,6 +902,7 @@ static int softmix_bridge_join(struct ast_bridge *bridge, struct ast_bridge_chan
 	if (!(sc = ast_calloc(1, sizeof(*sc)))) {
 		SCOPE_EXIT_RTN_VALUE(-1, "Couldn't alloc tech_pvt\n");
 	}
+	sc->cpu_group = -1;
 
 	samplerate_change = softmix_data->internal_rate;
 	pos_id = -1;
@@ -843,6 +1028,7 @@ static void softmix_bridge_leave(struct ast_bridge *bridge, struct ast_bridge_ch
 	ao2_cleanup(sc->remb_collector);
 
 	AST_VECTOR_FREE(&sc->video_sources);
+	AST_VECTOR_FREE(&sc->video_layers);
 
 	/* Drop mutex lock */
 	ast_mutex_destroy(&sc->lock);
@@ -853,6 +1039,13 @@ static void softmix_bridge_leave(struct ast_bridge *bridge, struct ast_bridge_ch
 	/* Drop any formats on the frames */
 	ao2_cleanup(sc->write_frame.subclass.format);
 
+	/* Drop the talker encoding path */
+	if (sc->talker_trans) {
+		ast_translator_free_path(sc->talker_trans);
+	}
+	ao2_cleanup(sc->talker_dst);
+	ao2_cleanup(sc->talker_src);
+
 	/* Drop the DSP */
 	ast_dsp_free(sc->dsp);
 
@@ -875,6 +1068,121 @@ static void softmix_pass_video_top_priority(struct ast_bridge *bridge, struct as
 	}
 }
 
+/*!
+ * \internal
+ * \brief Get the simulcast layers of a bridge video stream, adding the stream if needed
+ *
+ * \retval NULL if the stream can not be tracked
+ */
+static struct softmix_simulcast_stream *softmix_simulcast_stream_get(struct softmix_bridge_data *softmix_data,
+	int stream_num)
+{
+	struct softmix_simulcast_stream empty = { { 0, }, };
+
+	if (stream_num < 0) {
+		return NULL;
+	}
+
+	while (AST_VECTOR_SIZE(&softmix_data->simulcast_streams) <= stream_num) {
+		if (AST_VECTOR_APPEND(&softmix_data->simulcast_streams, empty)) {
+			return NULL;
+		}
+	}
+
+	return AST_VECTOR_GET_ADDR(&softmix_data->simulcast_streams, stream_num);
+}
+
+/*!
+ * \internal
+ * \brief Determine if a participant is to be given a frame of a simulcast video stream
+ *
+ * \param sc The participant
+ * \param stream The simulcast layers of the bridge stream the frame is on
+ * \param frame The video frame
+ *
+ * \retval non-zero if the frame is on the layer the participant is being forwarded
+ */
+static int softmix_simulcast_forward(struct softmix_channel *sc, struct softmix_simulcast_stream *stream,
+	struct ast_frame *frame)
+{
+	struct softmix_video_layer *video_layer = NULL;
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&sc->video_sources); ++i) {
+		if (AST_VECTOR_GET(&sc->video_sources, i) == frame->stream_num) {
+			video_layer = AST_VECTOR_GET_ADDR(&sc->video_layers, i);
+			break;
+		}
+	}
+
+	if (!video_layer) {
+		/* Not a receiver of this source */
+		return 0;
+	}
+
+	/* Switch where the new layer starts a video frame so the decoder is never fed part of one */
+	if (video_layer->target != video_layer->current && frame->subclass.layer == video_layer->target
+		&& stream->frame_start[video_layer->target]) {
+		video_layer->current = video_layer->target;
+	}
+
+	return frame->subclass.layer == video_layer->current;
+}
+
+/*!
+ * \internal
+ * \brief Forward a video frame in SFU mode
+ *
+ * \param bridge Which bridge is getting the frame
+ * \param bridge_channel Which channel is writing the frame.
+ * \param frame What is being written.
+ *
+ * Video from a source sending several simulcast layers only goes to the
+ * participants that have been given the layer it is on.
+ */
+static void softmix_bridge_write_sfu_video(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel,
+	struct ast_frame *frame)
+{
+	struct softmix_bridge_data *softmix_data = bridge->tech_pvt;
+	struct softmix_simulcast_stream *stream;
+	struct ast_bridge_channel *cur;
+	struct ast_frame *shared;
+	unsigned int layer = frame->subclass.layer;
+
+	stream = softmix_simulcast_stream_get(softmix_data, frame->stream_num);
+	if (stream && layer < AST_RTP_MAX_SIMULCAST_LAYERS) {
+		stream->bytes[layer] += frame->datalen;
+		if (layer) {
+			stream->simulcast = 1;
+		}
+	}
+
+	if (!stream || !stream->simulcast || layer >= AST_RTP_MAX_SIMULCAST_LAYERS) {
+		/* Nothing special to do here, the bridge channel stream map will ensure the
+		 * video goes everywhere it needs to
+		 */
+		ast_bridge_queue_everyone_else(bridge, bridge_channel, frame);
+		return;
+	}
+
+	/* Whoever is given this layer shares the one copy of it */
+	shared = ast_frshare(frame);
+	AST_LIST_TRAVERSE(&bridge->channels, cur, entry) {
+		if (cur == bridge_channel || !cur->tech_pvt) {
+			continue;
+		}
+		if (softmix_simulcast_forward(cur->tech_pvt, stream, frame)) {
+			ast_bridge_channel_queue_frame(cur, shared ?: frame);
+		}
+	}
+	if (shared) {
+		ast_frfree(shared);
+	}
+
+	/* The next frame on this layer starts a new video frame if this one ended one */
+	stream->frame_start[layer] = frame->subclass.frame_ending;
+}
+
 /*!
  * \internal
  * \brief Determine what to do with a video frame.
@@ -920,10 +1228,7 @@ static void softmix_bridge_write_video(struct ast_bridge *bridge, struct ast_bri
 		}
 		break;
 	case AST_BRIDGE_VIDEO_MODE_SFU:
-		/* Nothing special to do here, the bridge channel stream map will ensure the
-		 * video goes everywhere it needs to
-		 */
-		ast_bridge_queue_everyone_else(bridge, bridge_channel, frame);
+		softmix_bridge_write_sfu_video(bridge, bridge_channel, frame);
 		break;
 	}
 }
@@ -1319,13 +1624,23 @@ static void softmix_bridge_write_rtcp(struct ast_bridge *bridge, struct ast_brid
  */
 static int softmix_bridge_write(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel, struct ast_frame *frame)
 {
+	struct softmix_bridge_data *softmix_data = bridge->tech_pvt;
+	struct softmix_channel *sc;
 	int res = 0;
 
-	if (!bridge->tech_pvt || !bridge_channel || !bridge_channel->tech_pvt) {
+	if (!softmix_data || !bridge_channel || !bridge_channel->tech_pvt) {
 		/* "Accept" the frame and discard it. */
 		return 0;
 	}
 
+	/* Move the thread of the channel next to the threads mixing for it */
+	sc = bridge_channel->tech_pvt;
+	if (sc->cpu_group != softmix_data->cpu_group
+		&& pthread_equal(bridge_channel->thread, pthread_self())) {
+		sc->cpu_group = softmix_data->cpu_group;
+		ast_thread_cpu_group_set(sc->cpu_group);
+	}
+
 	/*
 	 * XXX Softmix needs to use channel roles to determine who gets
 	 * what frame.  Possible roles: announcer, recorder, agent,
@@ -1371,6 +1686,102 @@ static int softmix_bridge_write(struct ast_bridge *bridge, struct ast_bridge_cha
 	return res;
 }
 
+/*!
+ * \internal
+ * \brief Estimate the bitrate of every simulcast layer from what was received since the last estimate
+ *
+ * \param softmix_data The bridge
+ * \param elapsed Milliseconds since the last estimate
+ */
+static void softmix_simulcast_estimate(struct softmix_bridge_data *softmix_data, int64_t elapsed)
+{
+	int i;
+	unsigned int layer;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&softmix_data->simulcast_streams); ++i) {
+		struct softmix_simulcast_stream *stream = AST_VECTOR_GET_ADDR(&softmix_data->simulcast_streams, i);
+
+		for (layer = 0; layer < AST_RTP_MAX_SIMULCAST_LAYERS; layer++) {
+			stream->bitrate[layer] = stream->bytes[layer] * 8000.0 / MAX(elapsed, 1);
+			stream->bytes[layer] = 0;
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Ask the source of a bridge video stream for a key frame
+ */
+static void softmix_simulcast_request_keyframe(struct ast_bridge *bridge, int stream_num)
+{
+	struct ast_bridge_channel *source;
+	int i;
+
+	AST_LIST_TRAVERSE(&bridge->channels, source, entry) {
+		for (i = 0; i < AST_VECTOR_SIZE(&source->stream_map.to_bridge); ++i) {
+			if (AST_VECTOR_GET(&source->stream_map.to_bridge, i) == stream_num) {
+				ast_bridge_channel_queue_control_data(source, AST_CONTROL_VIDUPDATE, NULL, 0);
+				return;
+			}
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Choose the simulcast layer to forward a participant from each of its video sources
+ *
+ * The bandwidth the participant last reported through REMB is split evenly
+ * between its sources, as it is when REMB is collected, and each gets the
+ * best layer that fits in its share.  Without a report the layers are left
+ * as they are.
+ */
+static void softmix_simulcast_select(struct ast_bridge *bridge, struct softmix_bridge_data *softmix_data,
+	struct softmix_channel *sc)
+{
+	float available;
+	int i;
+
+	ast_mutex_lock(&sc->lock);
+	available = sc->remb.br_mantissa << sc->remb.br_exp;
+	ast_mutex_unlock(&sc->lock);
+
+	if (!available || !AST_VECTOR_SIZE(&sc->video_sources)) {
+		return;
+	}
+	available /= AST_VECTOR_SIZE(&sc->video_sources);
+
+	for (i = 0; i < AST_VECTOR_SIZE(&sc->video_layers); ++i) {
+		int stream_num = AST_VECTOR_GET(&sc->video_sources, i);
+		struct softmix_video_layer *video_layer = AST_VECTOR_GET_ADDR(&sc->video_layers, i);
+		struct softmix_simulcast_stream *stream;
+		unsigned int target = 0;
+		unsigned int layer;
+
+		if (stream_num >= AST_VECTOR_SIZE(&softmix_data->simulcast_streams)) {
+			continue;
+		}
+		stream = AST_VECTOR_GET_ADDR(&softmix_data->simulcast_streams, stream_num);
+		if (!stream->simulcast) {
+			continue;
+		}
+
+		/* The lowest layer is always a fallback, even if it does not fit */
+		for (layer = 1; layer < AST_RTP_MAX_SIMULCAST_LAYERS; layer++) {
+			if (stream->bitrate[layer] && stream->bitrate[layer] <= available) {
+				target = layer;
+			}
+		}
+
+		if (target != video_layer->target) {
+			ast_debug(3, "Bridge %s: Switching a participant to simulcast layer %u of stream %d\n",
+				bridge->uniqueid, target, stream_num);
+			video_layer->target = target;
+			softmix_simulcast_request_keyframe(bridge, stream_num);
+		}
+	}
+}
+
 static void remb_collect_report_all(struct ast_bridge *bridge, struct softmix_bridge_data *softmix_data,
 	float bitrate)
 {
@@ -1710,6 +2121,11 @@ static int softmix_mixing_array_init(struct softmix_mixing_array *mixing_array,
 		ast_log(LOG_NOTICE, "Failed to allocate softmix mixing structure.\n");
 		return -1;
 	}
+	if (!(mixing_array->writers = ast_calloc(mixing_array->max_num_entries,
+			sizeof(struct ast_bridge_channel *)))) {
+		ast_log(LOG_NOTICE, "Failed to allocate softmix mixing structure.\n");
+		return -1;
+	}
 	if (binaural_active) {
 		if (!(mixing_array->chan_pairs = ast_calloc(mixing_array->max_num_entries,
 				sizeof(struct convolve_channel_pair *)))) {
@@ -1724,6 +2140,7 @@ static void softmix_mixing_array_destroy(struct softmix_mixing_array *mixing_arr
 		unsigned int binaural_active)
 {
 	ast_free(mixing_array->buffers);
+	ast_free(mixing_array->writers);
 	if (binaural_active) {
 		ast_free(mixing_array->chan_pairs);
 	}
@@ -1733,6 +2150,7 @@ static int softmix_mixing_array_grow(struct softmix_mixing_array *mixing_array,
 		unsigned int num_entries, unsigned int binaural_active)
 {
 	int16_t **tmp;
+	struct ast_bridge_channel **writers;
 
 	/* give it some room to grow since memory is cheap but allocations can be expensive */
 	mixing_array->max_num_entries = num_entries;
@@ -1742,6 +2160,13 @@ static int softmix_mixing_array_grow(struct softmix_mixing_array *mixing_array,
 	}
 	mixing_array->buffers = tmp;
 
+	if (!(writers = ast_realloc(mixing_array->writers,
+			(mixing_array->max_num_entries * sizeof(struct ast_bridge_channel *))))) {
+		ast_log(LOG_NOTICE, "Failed to re-allocate softmix mixing structure.\n");
+		return -1;
+	}
+	mixing_array->writers = writers;
+
 	if (binaural_active) {
 		struct convolve_channel_pair **tmp2;
 		if (!(tmp2 = ast_realloc(mixing_array->chan_pairs,
@@ -1754,12 +2179,363 @@ static int softmix_mixing_array_grow(struct softmix_mixing_array *mixing_array,
 	return 0;
 }
 
+/*! \brief The least number of participants each mixing thread must have to write to */
+#define SOFTMIX_MIN_CHANNELS_PER_THREAD 8
+
+/*! \brief Maximum number of threads a single bridge may use for mixing */
+#define SOFTMIX_MAX_MIXING_THREADS 32
+
+/*! \brief The write work for one mixing interval */
+struct softmix_mixing_job {
+	/*! The participants to write mixed audio to */
+	struct ast_bridge_channel **channels;
+	/*! Number of participants in channels */
+	unsigned int num_channels;
+	/*! The signed linear format of the mixed audio */
+	struct ast_format *cur_slin;
+	/*! The mixed audio of all participants */
+	int16_t *buf;
+	/*! Number of samples in buf */
+	unsigned int samples;
+	/*! Length in bytes of the audio in buf */
+	unsigned int datalen;
+	/*! Passed through to softmix_process_write_audio */
+	unsigned int default_sample_size;
+};
+
+struct softmix_mixing_pool;
+
+/*! \brief A helper thread writing a slice of the participants each interval */
+struct softmix_mixing_worker {
+	/*! The worker thread */
+	pthread_t thread;
+	/*! The pool this worker belongs to */
+	struct softmix_mixing_pool *pool;
+	/*! Which slice of the participants this worker writes to */
+	unsigned int slice;
+	/*! Translation helper private to this worker */
+	struct softmix_translate_helper trans_helper;
+};
+
+/*!
+ * \brief Worker threads that split the per-participant write work
+ *
+ * The mixing thread still computes the mixed audio once per interval.  The
+ * participants are then divided into slices, the mixing thread writes to the
+ * first slice itself and each worker takes one of the others.  Each worker
+ * has its own translation helper, so participants sharing a write format
+ * within a slice still share a single encoding.
+ */
+struct softmix_mixing_pool {
+	/*! Lock protecting the fields below */
+	ast_mutex_t lock;
+	/*! Signaled when a new job is available */
+	ast_cond_t work_cond;
+	/*! Signaled when the last worker finishes the current job */
+	ast_cond_t done_cond;
+	/*! Incremented for each new job */
+	unsigned int generation;
+	/*! Number of workers that have not finished the current job */
+	unsigned int pending;
+	/*! TRUE if the workers should exit */
+	unsigned int stop:1;
+	/*! Number of slices work is split into (workers plus the mixing thread) */
+	unsigned int num_slices;
+	/*! The callid the worker threads log with */
+	ast_callid callid;
+	/*! CPU group the worker threads run on, -1 if none */
+	int cpu_group;
+	/*! The current job */
+	struct softmix_mixing_job job;
+	/*! The worker threads */
+	AST_VECTOR(, struct softmix_mixing_worker *) workers;
+};
+
+/*!
+ * \internal
+ * \brief Write the mixed audio to one slice of a job's participants.
+ */
+static void softmix_mixing_job_run(struct softmix_mixing_job *job, unsigned int slice,
+	unsigned int num_slices, struct softmix_translate_helper *trans_helper)
+{
+	unsigned int start = (job->num_channels * slice) / num_slices;
+	unsigned int end = (job->num_channels * (slice + 1)) / num_slices;
+	struct softmix_talker_batch talkers = { 0, };
+	unsigned int idx;
+
+	for (idx = start; idx < end; ++idx) {
+		struct ast_bridge_channel *bridge_channel = job->channels[idx];
+		struct softmix_channel *sc = bridge_channel->tech_pvt;
+		struct ast_frame *broadcast;
+		int batched = 0;
+
+		ast_mutex_lock(&sc->lock);
+
+		broadcast = softmix_write_broadcast_audio(trans_helper,
+			ast_channel_rawwriteformat(bridge_channel->chan), sc);
+		if (!broadcast) {
+			ao2_t_replace(sc->write_frame.subclass.format, job->cur_slin,
+				"Replace softmix channel slin format");
+			sc->write_frame.datalen = job->datalen;
+			sc->write_frame.samples = job->samples;
+			memcpy(sc->final_buf, job->buf, job->datalen);
+
+			batched = softmix_process_write_audio(trans_helper,
+				ast_channel_rawwriteformat(bridge_channel->chan), sc,
+				job->default_sample_size);
+		}
+
+		ast_mutex_unlock(&sc->lock);
+
+		if (batched) {
+			softmix_talker_batch_add(&talkers, bridge_channel);
+		} else {
+			ast_bridge_channel_queue_frame(bridge_channel, broadcast ?: &sc->write_frame);
+		}
+	}
+	softmix_talker_batch_flush(&talkers);
+}
+
+static void *softmix_mixing_worker_thread(void *data)
+{
+	struct softmix_mixing_worker *worker = data;
+	struct softmix_mixing_pool *pool = worker->pool;
+	unsigned int generation = 0;
+
+	if (pool->callid) {
+		ast_callid_threadassoc_add(pool->callid);
+	}
+	ast_thread_cpu_group_set(pool->cpu_group);
+
+	ast_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && pool->generation == generation) {
+			ast_cond_wait(&pool->work_cond, &pool->lock);
+		}
+		if (pool->stop) {
+			break;
+		}
+		generation = pool->generation;
+		ast_mutex_unlock(&pool->lock);
+
+		softmix_mixing_job_run(&pool->job, worker->slice, pool->num_slices,
+			&worker->trans_helper);
+		/* The frames are queued by now, so the encoded output can go. */
+		softmix_translate_helper_cleanup(&worker->trans_helper);
+
+		ast_mutex_lock(&pool->lock);
+		if (!--pool->pending) {
+			ast_cond_signal(&pool->done_cond);
+		}
+	}
+	ast_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+static void softmix_mixing_pool_destroy(struct softmix_mixing_pool *pool)
+{
+	int idx;
+
+	if (!pool) {
+		return;
+	}
+
+	ast_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	ast_cond_broadcast(&pool->work_cond);
+	ast_mutex_unlock(&pool->lock);
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(&pool->workers); ++idx) {
+		struct softmix_mixing_worker *worker = AST_VECTOR_GET(&pool->workers, idx);
+
+		pthread_join(worker->thread, NULL);
+		softmix_translate_helper_destroy(&worker->trans_helper);
+		ast_free(worker);
+	}
+	AST_VECTOR_FREE(&pool->workers);
+	ast_mutex_destroy(&pool->lock);
+	ast_cond_destroy(&pool->work_cond);
+	ast_cond_destroy(&pool->done_cond);
+	ast_free(pool);
+}
+
+/*!
+ * \internal
+ * \brief Create a pool of mixing workers.
+ *
+ * \param bridge The bridge the pool mixes for
+ * \param num_threads Total number of threads including the mixing thread
+ * \param sample_rate The current internal sample rate
+ *
+ * \retval NULL if fewer than two threads were requested or on error.
+ */
+static struct softmix_mixing_pool *softmix_mixing_pool_alloc(struct ast_bridge *bridge,
+	unsigned int num_threads, unsigned int sample_rate)
+{
+	struct softmix_mixing_pool *pool;
+	unsigned int idx;
+
+	if (num_threads < 2) {
+		return NULL;
+	}
+	num_threads = MIN(num_threads, SOFTMIX_MAX_MIXING_THREADS);
+
+	pool = ast_calloc(1, sizeof(*pool));
+	if (!pool) {
+		return NULL;
+	}
+	ast_mutex_init(&pool->lock);
+	ast_cond_init(&pool->work_cond, NULL);
+	ast_cond_init(&pool->done_cond, NULL);
+	pool->callid = bridge->callid;
+	pool->cpu_group = ((struct softmix_bridge_data *) bridge->tech_pvt)->cpu_group;
+	if (AST_VECTOR_INIT(&pool->workers, num_threads - 1)) {
+		softmix_mixing_pool_destroy(pool);
+		return NULL;
+	}
+
+	for (idx = 1; idx < num_threads; ++idx) {
+		struct softmix_mixing_worker *worker = ast_calloc(1, sizeof(*worker));
+
+		if (!worker) {
+			break;
+		}
+		worker->pool = pool;
+		worker->slice = idx;
+		softmix_translate_helper_init(&worker->trans_helper, sample_rate);
+		if (ast_pthread_create(&worker->thread, NULL, softmix_mixing_worker_thread, worker)) {
+			ast_free(worker);
+			break;
+		}
+		/* Cannot fail, the vector was sized up front */
+		AST_VECTOR_APPEND(&pool->workers, worker);
+	}
+
+	if (!AST_VECTOR_SIZE(&pool->workers)) {
+		ast_log(LOG_WARNING, "Bridge %s: Unable to start mixing threads, mixing with one thread.\n",
+			bridge->uniqueid);
+		softmix_mixing_pool_destroy(pool);
+		return NULL;
+	}
+	pool->num_slices = AST_VECTOR_SIZE(&pool->workers) + 1;
+
+	ast_debug(1, "Bridge %s: mixing with %u threads\n", bridge->uniqueid, pool->num_slices);
+
+	return pool;
+}
+
+static void softmix_mixing_pool_change_rate(struct softmix_mixing_pool *pool, unsigned int sample_rate)
+{
+	int idx;
+
+	/* The workers only touch their helpers while running a job, and none is running now. */
+	for (idx = 0; idx < AST_VECTOR_SIZE(&pool->workers); ++idx) {
+		softmix_translate_helper_change_rate(&AST_VECTOR_GET(&pool->workers, idx)->trans_helper,
+			sample_rate);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Run a job across the pool and wait for it to complete.
+ *
+ * \param pool The pool to run the job on
+ * \param job The job to run
+ * \param trans_helper The mixing thread's own translation helper
+ */
+static void softmix_mixing_pool_run(struct softmix_mixing_pool *pool,
+	struct softmix_mixing_job *job, struct softmix_translate_helper *trans_helper)
+{
+	ast_mutex_lock(&pool->lock);
+	pool->job = *job;
+	pool->pending = AST_VECTOR_SIZE(&pool->workers);
+	pool->generation++;
+	ast_cond_broadcast(&pool->work_cond);
+	ast_mutex_unlock(&pool->lock);
+
+	softmix_mixing_job_run(job, 0, pool->num_slices, trans_helper);
+
+	ast_mutex_lock(&pool->lock);
+	while (pool->pending) {
+		ast_cond_wait(&pool->done_cond, &pool->lock);
+	}
+	ast_mutex_unlock(&pool->lock);
+}
+
 /*!
  * \brief Mixing loop.
  *
  * \retval 0 on success
  * \retval -1 on failure
  */
+/*!
+ * \internal
+ * \brief Finish every prompt played into the mix
+ *
+ * \note The bridge must be locked.
+ */
+static void softmix_prompts_done(struct softmix_bridge_data *softmix_data)
+{
+	struct ast_bridge_prompt_playback *playback;
+
+	while ((playback = AST_LIST_REMOVE_HEAD(&softmix_data->prompts, list))) {
+		ast_bridge_prompt_playback_done(playback);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Read the next mixing interval of the prompts played into the mix
+ *
+ * Prompts at another sample rate than the mix are resampled by linear
+ * interpolation, prompts played to the end are finished.
+ *
+ * \note The bridge must be locked.
+ *
+ * \retval 0 if no prompt is playing
+ * \retval 1 if buf holds the audio of the prompts
+ */
+static int softmix_prompts_read(struct softmix_bridge_data *softmix_data, int16_t *buf,
+	unsigned int samples)
+{
+	struct ast_bridge_prompt_playback *playback;
+
+	if (AST_LIST_EMPTY(&softmix_data->prompts)) {
+		return 0;
+	}
+
+	memset(buf, 0, samples * sizeof(*buf));
+	AST_LIST_TRAVERSE_SAFE_BEGIN(&softmix_data->prompts, playback, list) {
+		const struct ast_bridge_prompt *prompt = playback->prompt;
+		/* Positions are in 1/65536ths of a sample of the prompt */
+		uint64_t step = ((uint64_t) prompt->rate << 16) / softmix_data->internal_rate;
+		uint64_t end = (uint64_t) prompt->samples << 16;
+		unsigned int i;
+
+		for (i = 0; i < samples && playback->position < end; ++i) {
+			size_t pos = playback->position >> 16;
+			int sample = prompt->data[pos];
+			short value;
+
+			if (pos + 1 < prompt->samples) {
+				sample += ((prompt->data[pos + 1] - sample) * (int) (playback->position & 0xffff)) >> 16;
+			}
+			value = sample;
+			ast_slinear_saturated_add(&buf[i], &value);
+			playback->position += step;
+		}
+
+		if (playback->position >= end) {
+			AST_LIST_REMOVE_CURRENT(list);
+			ast_bridge_prompt_playback_done(playback);
+		}
+	}
+	AST_LIST_TRAVERSE_SAFE_END;
+
+	return 1;
+}
+
 static int softmix_mixing_loop(struct ast_bridge *bridge)
 {
 	struct softmix_stats stats = { { 0 }, };
@@ -1767,7 +2543,10 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 	struct softmix_bridge_data *softmix_data = bridge->tech_pvt;
 	struct ast_timer *timer;
 	struct softmix_translate_helper trans_helper;
+	struct softmix_mixing_pool *pool = NULL;
+	unsigned int pool_threads = 0;
 	int16_t buf[MAX_DATALEN];
+	int16_t prompt_buf[MAX_DATALEN];
 #ifdef BINAURAL_RENDERING
 	int16_t bin_buf[MAX_DATALEN];
 	int16_t ann_buf[MAX_DATALEN];
@@ -1776,7 +2555,6 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 	int timingfd;
 	int update_all_rates = 0; /* set this when the internal sample rate has changed */
 	unsigned int idx;
-	unsigned int x;
 	int res = -1;
 
 	timer = softmix_data->timer;
@@ -1813,8 +2591,8 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 			goto softmix_cleanup;
 		}
 
-		/* Grow the mixing array buffer as participants are added. */
-		if (mixing_array.max_num_entries < bridge->num_channels
+		/* Grow the mixing array buffer as participants are added, with room for the prompts. */
+		if (mixing_array.max_num_entries < bridge->num_channels + 1
 			&& softmix_mixing_array_grow(&mixing_array, bridge->num_channels + 5,
 					bridge->softmix.binaural_active)) {
 			goto softmix_cleanup;
@@ -1831,9 +2609,19 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 			stats.maximum_rate = bridge->softmix.maximum_sample_rate;
 		}
 
+		/* Start, resize or stop the mixing threads if the configuration changed */
+		if (bridge->softmix.mixing_threads != pool_threads) {
+			pool_threads = bridge->softmix.mixing_threads;
+			softmix_mixing_pool_destroy(pool);
+			pool = softmix_mixing_pool_alloc(bridge, pool_threads, softmix_data->internal_rate);
+		}
+
 		/* If the sample rate has changed, update the translator helper */
 		if (update_all_rates) {
 			softmix_translate_helper_change_rate(&trans_helper, softmix_data->internal_rate);
+			if (pool) {
+				softmix_mixing_pool_change_rate(pool, softmix_data->internal_rate);
+			}
 		}
 
 #ifdef BINAURAL_RENDERING
@@ -1845,6 +2633,7 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 			bridge->softmix.video_mode.mode_data.sfu_data.remb_send_interval &&
 			ast_tvdiff_ms(ast_tvnow(), softmix_data->last_remb_update) > bridge->softmix.video_mode.mode_data.sfu_data.remb_send_interval) {
 			remb_update = 1;
+			softmix_simulcast_estimate(softmix_data, ast_tvdiff_ms(ast_tvnow(), softmix_data->last_remb_update));
 			softmix_data->last_remb_update = ast_tvnow();
 		}
 
@@ -1873,6 +2662,11 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 				continue;
 			}
 
+			/* Layers are chosen before the REMB report they are chosen from is collected */
+			if (remb_update) {
+				softmix_simulcast_select(bridge, softmix_data, sc);
+			}
+
 			/* Try to get audio from the factory if available */
 			ast_mutex_lock(&sc->lock);
 			if ((mixing_array.buffers[mixing_array.used_entries] = softmix_process_read_audio(sc, softmix_samples))) {
@@ -1888,57 +2682,112 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 			ast_mutex_unlock(&sc->lock);
 		}
 
+		/* Prompts played into the bridge are mixed in like one more participant */
+		if (softmix_prompts_read(softmix_data, prompt_buf, softmix_samples)) {
+			mixing_array.buffers[mixing_array.used_entries] = prompt_buf;
+			if (mixing_array.chan_pairs) {
+				mixing_array.chan_pairs[mixing_array.used_entries] = NULL;
+			}
+			mixing_array.used_entries++;
+		}
+
 		/* mix it like crazy (non binaural channels)*/
 		memset(buf, 0, softmix_datalen);
 		for (idx = 0; idx < mixing_array.used_entries; ++idx) {
-			for (x = 0; x < softmix_samples; ++x) {
-				ast_slinear_saturated_add(buf + x, mixing_array.buffers[idx] + x);
-			}
+			ast_slinear_mix_add(buf, mixing_array.buffers[idx], softmix_samples);
 		}
 
 #ifdef BINAURAL_RENDERING
 		binaural_mixing(bridge, softmix_data, &mixing_array, bin_buf, ann_buf);
 #endif
 
-		/* Next step go through removing the channel's own audio and creating a good frame... */
-		AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
-			struct softmix_channel *sc = bridge_channel->tech_pvt;
+		/*
+		 * With mixing threads configured and enough participants to make it
+		 * worth waking them, split building and writing everyone's frame.
+		 * Binaural rendering keeps per-bridge state and is done serially.
+		 */
+		if (pool && !bridge->softmix.binaural_active
+			&& bridge->num_channels >= pool->num_slices * SOFTMIX_MIN_CHANNELS_PER_THREAD) {
+			struct softmix_mixing_job job = {
+				.cur_slin = cur_slin,
+				.buf = buf,
+				.samples = softmix_samples,
+				.datalen = softmix_datalen,
+				.default_sample_size = softmix_data->default_sample_size,
+			};
+
+			AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
+				if (bridge_channel->tech_pvt && !bridge_channel->suspended) {
+					mixing_array.writers[job.num_channels++] = bridge_channel;
+				}
+			}
+			job.channels = mixing_array.writers;
 
-			if (!sc || bridge_channel->suspended) {
-				/* This channel failed to join successfully or is suspended. */
-				continue;
+			softmix_mixing_pool_run(pool, &job, &trans_helper);
+
+			if (remb_update) {
+				AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
+					struct softmix_channel *sc = bridge_channel->tech_pvt;
+
+					if (sc && !bridge_channel->suspended) {
+						remb_send_report(bridge_channel, softmix_data, sc);
+					}
+				}
 			}
+		} else {
+			struct softmix_talker_batch talkers = { 0, };
 
-			ast_mutex_lock(&sc->lock);
+			/* Next step go through removing the channel's own audio and creating a good frame... */
+			AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
+				struct softmix_channel *sc = bridge_channel->tech_pvt;
+				struct ast_frame *broadcast;
+				int batched = 0;
 
-			/* Make SLINEAR write frame from local buffer */
-			ao2_t_replace(sc->write_frame.subclass.format, cur_slin,
-				"Replace softmix channel slin format");
+				if (!sc || bridge_channel->suspended) {
+					/* This channel failed to join successfully or is suspended. */
+					continue;
+				}
+
+				ast_mutex_lock(&sc->lock);
+
+				broadcast = softmix_write_broadcast_audio(&trans_helper,
+					ast_channel_rawwriteformat(bridge_channel->chan), sc);
+				if (!broadcast) {
+					/* Make SLINEAR write frame from local buffer */
+					ao2_t_replace(sc->write_frame.subclass.format, cur_slin,
+						"Replace softmix channel slin format");
 #ifdef BINAURAL_RENDERING
-			if (bridge->softmix.binaural_active && softmix_data->convolve.binaural_active
-					&& sc->binaural) {
-				create_binaural_frame(bridge_channel, sc, bin_buf, ann_buf, softmix_datalen,
-						softmix_samples, buf);
-			} else
+					if (bridge->softmix.binaural_active && softmix_data->convolve.binaural_active
+							&& sc->binaural) {
+						create_binaural_frame(bridge_channel, sc, bin_buf, ann_buf, softmix_datalen,
+								softmix_samples, buf);
+					} else
 #endif
-			{
-				sc->write_frame.datalen = softmix_datalen;
-				sc->write_frame.samples = softmix_samples;
-				memcpy(sc->final_buf, buf, softmix_datalen);
-			}
-			/* process the softmix channel's new write audio */
-			softmix_process_write_audio(&trans_helper,
-					ast_channel_rawwriteformat(bridge_channel->chan), sc,
-					softmix_data->default_sample_size);
+					{
+						sc->write_frame.datalen = softmix_datalen;
+						sc->write_frame.samples = softmix_samples;
+						memcpy(sc->final_buf, buf, softmix_datalen);
+					}
+					/* process the softmix channel's new write audio */
+					batched = softmix_process_write_audio(&trans_helper,
+							ast_channel_rawwriteformat(bridge_channel->chan), sc,
+							softmix_data->default_sample_size);
+				}
 
-			ast_mutex_unlock(&sc->lock);
+				ast_mutex_unlock(&sc->lock);
 
-			/* A frame is now ready for the channel. */
-			ast_bridge_channel_queue_frame(bridge_channel, &sc->write_frame);
+				/* A frame is now ready for the channel, or is once its mix is encoded. */
+				if (batched) {
+					softmix_talker_batch_add(&talkers, bridge_channel);
+				} else {
+					ast_bridge_channel_queue_frame(bridge_channel, broadcast ?: &sc->write_frame);
+				}
 
-			if (remb_update) {
-				remb_send_report(bridge_channel, softmix_data, sc);
+				if (remb_update) {
+					remb_send_report(bridge_channel, softmix_data, sc);
+				}
 			}
+			softmix_talker_batch_flush(&talkers);
 		}
 
 		if (remb_update) {
@@ -1979,6 +2828,7 @@ static int softmix_mixing_loop(struct ast_bridge *bridge)
 	res = 0;
 
 softmix_cleanup:
+	softmix_mixing_pool_destroy(pool);
 	softmix_translate_helper_destroy(&trans_helper);
 	softmix_mixing_array_destroy(&mixing_array, bridge->softmix.binaural_active);
 	return res;
@@ -2002,11 +2852,15 @@ static void *softmix_mixing_thread(void *data)
 	if (bridge->callid) {
 		ast_callid_threadassoc_add(bridge->callid);
 	}
+	ast_thread_cpu_group_set(softmix_data->cpu_group);
 
 	ast_debug(1, "Bridge %s: starting mixing thread\n", bridge->uniqueid);
 
 	while (!softmix_data->stop) {
 		if (!bridge->num_active) {
+			/* Nobody is left to hear the prompts */
+			softmix_prompts_done(softmix_data);
+
 			/* Wait for something to happen to the bridge. */
 			ast_bridge_unlock(bridge);
 			ast_mutex_lock(&softmix_data->lock);
@@ -2055,6 +2909,7 @@ static void *softmix_mixing_thread(void *data)
 		}
 	}
 
+	softmix_prompts_done(softmix_data);
 	ast_bridge_unlock(bridge);
 
 	ast_debug(1, "Bridge %s: stopping mixing thread\n", bridge->uniqueid);
@@ -2072,6 +2927,8 @@ static void softmix_bridge_data_destroy(struct softmix_bridge_data *softmix_data
 	ast_cond_destroy(&softmix_data->cond);
 	AST_VECTOR_RESET(&softmix_data->remb_collectors, ao2_cleanup);
 	AST_VECTOR_FREE(&softmix_data->remb_collectors);
+	AST_VECTOR_FREE(&softmix_data->simulcast_streams);
+	ast_cpu_group_release(softmix_data->cpu_group);
 	ast_free(softmix_data);
 }
 
@@ -2087,6 +2944,8 @@ static int softmix_bridge_create(struct ast_bridge *bridge)
 	softmix_data->bridge = bridge;
 	ast_mutex_init(&softmix_data->lock);
 	ast_cond_init(&softmix_data->cond, NULL);
+	/* Keep the mixing threads and the channels of the bridge on the same CPUs */
+	softmix_data->cpu_group = ast_cpu_group_acquire();
 	softmix_data->timer = ast_timer_open();
 	if (!softmix_data->timer) {
 		ast_log(AST_LOG_WARNING, "Failed to open timer for softmix bridge\n");
@@ -2103,6 +2962,7 @@ static int softmix_bridge_create(struct ast_bridge *bridge)
 #endif
 
 	AST_VECTOR_INIT(&softmix_data->remb_collectors, 0);
+	AST_VECTOR_INIT(&softmix_data->simulcast_streams, 0);
 
 	bridge->tech_pvt = softmix_data;
 
@@ -2166,10 +3026,33 @@ static void softmix_bridge_destroy(struct ast_bridge *bridge)
 #ifdef BINAURAL_RENDERING
 	free_convolve_data(&softmix_data->convolve);
 #endif
+	softmix_prompts_done(softmix_data);
 	softmix_bridge_data_destroy(softmix_data);
 	bridge->tech_pvt = NULL;
 }
 
+/*! \brief Function called to play a prompt into the bridge */
+static int softmix_bridge_play_prompt(struct ast_bridge *bridge,
+	struct ast_bridge_prompt_playback *playback)
+{
+	struct softmix_bridge_data *softmix_data = bridge->tech_pvt;
+
+	if (!softmix_data) {
+		return -1;
+	}
+
+	if (softmix_data->stop || !bridge->num_active) {
+		/* Nobody would hear it */
+		ast_bridge_prompt_playback_done(playback);
+		return 0;
+	}
+
+	playback->position = 0;
+	AST_LIST_INSERT_TAIL(&softmix_data->prompts, playback, list);
+
+	return 0;
+}
+
 /*!
  * \brief Map a source stream to all of its destination streams.
  *
@@ -2201,9 +3084,14 @@ static void map_source_to_destinations(const char *source_channel_name,
 			stream = ast_stream_topology_get_stream(topology, i);
 			if (is_video_dest(stream, source_channel_name, source_channel_stream_position)) {
 				struct softmix_channel *sc = participant->tech_pvt;
+				struct softmix_video_layer video_layer = { 0, };
 
 				AST_VECTOR_REPLACE(&participant->stream_map.to_channel, bridge_stream_position, i);
-				AST_VECTOR_APPEND(&sc->video_sources, bridge_stream_position);
+				if (!AST_VECTOR_APPEND(&sc->video_sources, bridge_stream_position)
+					&& AST_VECTOR_APPEND(&sc->video_layers, video_layer)) {
+					/* The two are kept in step, without a layer the source can't be forwarded */
+					AST_VECTOR_REMOVE(&sc->video_sources, AST_VECTOR_SIZE(&sc->video_sources) - 1, 0);
+				}
 				break;
 			}
 		}
@@ -2496,6 +3384,9 @@ static void softmix_bridge_stream_topology_changed(struct ast_bridge *bridge, st
 		AST_VECTOR_REPLACE(&softmix_data->remb_collectors, idx, NULL);
 	}
 
+	/* Simulcast layers are learned again for the new bridge streams */
+	AST_VECTOR_RESET(&softmix_data->simulcast_streams, AST_VECTOR_ELEM_CLEANUP_NOOP);
+
 	/* First traversal: re-initialize all of the participants' stream maps */
 	AST_LIST_TRAVERSE(&bridge->channels, participant, entry) {
 		ast_bridge_channel_lock(participant);
@@ -2505,6 +3396,7 @@ static void softmix_bridge_stream_topology_changed(struct ast_bridge *bridge, st
 
 		sc = participant->tech_pvt;
 		AST_VECTOR_RESET(&sc->video_sources, AST_VECTOR_ELEM_CLEANUP_NOOP);
+		AST_VECTOR_RESET(&sc->video_layers, AST_VECTOR_ELEM_CLEANUP_NOOP);
 
 		ast_bridge_channel_unlock(participant);
 	}
@@ -2601,6 +3493,7 @@ static struct ast_bridge_technology softmix_bridge = {
 	.unsuspend = softmix_bridge_unsuspend,
 	.write = softmix_bridge_write,
 	.stream_topology_changed = softmix_bridge_stream_topology_changed,
+	.play_prompt = softmix_bridge_play_prompt,
 };
 
 #ifdef TEST_FRAMEWORK
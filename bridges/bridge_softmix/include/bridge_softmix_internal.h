@@ -128,6 +128,26 @@ struct video_follow_talker_data {
 
 struct softmix_remb_collector;
 
+/*! \brief Simulcast layer forwarded to a participant from one of its video sources */
+struct softmix_video_layer {
+	/*! The layer being forwarded */
+	unsigned int current;
+	/*! The layer to switch to once it starts a new video frame */
+	unsigned int target;
+};
+
+/*! \brief Simulcast layers received on one bridge video stream */
+struct softmix_simulcast_stream {
+	/*! Bytes received on each layer since the bitrates were last estimated */
+	unsigned int bytes[AST_RTP_MAX_SIMULCAST_LAYERS];
+	/*! Estimated bitrate of each layer, 0 if it is not being received */
+	float bitrate[AST_RTP_MAX_SIMULCAST_LAYERS];
+	/*! TRUE for each layer whose next frame starts a new video frame */
+	unsigned int frame_start[AST_RTP_MAX_SIMULCAST_LAYERS];
+	/*! TRUE if more than one layer has been received */
+	unsigned int simulcast:1;
+};
+
 /*! \brief Structure which contains per-channel mixing information */
 struct softmix_channel {
 	/*! Lock to protect this structure */
@@ -169,6 +189,12 @@ struct softmix_channel {
 	short final_buf[MAX_DATALEN];
 	/*! Buffer containing only the audio from the channel */
 	short our_buf[MAX_DATALEN];
+	/*! Path encoding the channel's own mix while it talks, NULL if ast_write() does it */
+	struct ast_trans_pvt *talker_trans;
+	/*! Write format talker_trans was last built for */
+	struct ast_format *talker_dst;
+	/*! Signed linear format talker_trans was last built from */
+	struct ast_format *talker_src;
 	/*! Data pertaining to talker mode for video conferencing */
 	struct video_follow_talker_data video_talker;
 	/*! The ideal stream topology for the channel */
@@ -179,6 +205,10 @@ struct softmix_channel {
 	struct softmix_remb_collector *remb_collector;
 	/*! The bridge streams which are feeding us video sources */
 	AST_VECTOR(, int) video_sources;
+	/*! The simulcast layer forwarded from each of video_sources */
+	AST_VECTOR(, struct softmix_video_layer) video_layers;
+	/*! CPU group the thread of the channel was placed on, only used by that thread */
+	int cpu_group;
 };
 
 struct softmix_bridge_data {
@@ -218,12 +248,20 @@ struct softmix_bridge_data {
 	AST_VECTOR(, struct softmix_remb_collector *) remb_collectors;
 	/*! Per-bridge REMB bitrate */
 	float bitrate;
+	/*! Per-bridge stream simulcast layers */
+	AST_VECTOR(, struct softmix_simulcast_stream) simulcast_streams;
+	/*! Prompts played into the mix, protected by the bridge lock */
+	AST_LIST_HEAD_NOLOCK(, ast_bridge_prompt_playback) prompts;
+	/*! CPU group the mixing threads and the channel threads run on, -1 if none */
+	int cpu_group;
 };
 
 struct softmix_mixing_array {
 	unsigned int max_num_entries;
 	unsigned int used_entries;
 	int16_t **buffers;
+	/*! Participants being written to when the write work is split across threads */
+	struct ast_bridge_channel **writers;
 	/*! Stereo channel pairs used to store convolved binaural signals */
 	struct convolve_channel_pair **chan_pairs;
 };
@@ -365,7 +365,6 @@ static SQLHSTMT generic_prepare(struct odbc_obj *obj, void *data)
 						ast_log(LOG_ERROR, "Unable to allocate sufficient memory.  Insert CDR '%s:%s' failed.\n", tableptr->connection, tableptr->table); \
 						ast_free(sql);											\
 						ast_free(sql2);											\
-						AST_RWLIST_UNLOCK(&odbc_tables);						\
 						return -1;												\
 					}															\
 				}																\
@@ -376,11 +375,18 @@ static SQLHSTMT generic_prepare(struct odbc_obj *obj, void *data)
 #define LENGTHEN_BUF2(size)	\
 	LENGTHEN_BUF(size, sql2);
 
-static int odbc_log(struct ast_cdr *cdr)
+/*!
+ * \internal
+ * \brief Insert a record into one table
+ *
+ * \retval 0 if the record was inserted or filtered out
+ * \retval -1 on failure
+ *
+ * \pre odbc_tables is locked
+ */
+static int odbc_log_table(struct tables *tableptr, struct odbc_obj *obj, struct ast_cdr *cdr)
 {
-	struct tables *tableptr;
 	struct columns *entry;
-	struct odbc_obj *obj;
 	struct ast_str *sql = ast_str_create(maxsize), *sql2 = ast_str_create(maxsize2);
 	char *tmp;
 	char colbuf[1024], *colptr;
@@ -388,387 +394,370 @@ static int odbc_log(struct ast_cdr *cdr)
 	SQLLEN rows = 0;
 	char *separator;
 	int quoted = 0;
+	int res = 0;
 
 	if (!sql || !sql2) {
-		if (sql)
-			ast_free(sql);
-		if (sql2)
-			ast_free(sql2);
-		return -1;
-	}
-
-	if (AST_RWLIST_RDLOCK(&odbc_tables)) {
-		ast_log(LOG_ERROR, "Unable to lock table list.  Insert CDR(s) failed.\n");
 		ast_free(sql);
 		ast_free(sql2);
 		return -1;
 	}
 
-	AST_LIST_TRAVERSE(&odbc_tables, tableptr, list) {
-		separator = "";
+	separator = "";
 
-		quoted = 0;
-		if (tableptr->quoted_identifiers != '\0'){
-			quoted = 1;
-		}
+	quoted = 0;
+	if (tableptr->quoted_identifiers != '\0'){
+		quoted = 1;
+	}
 
-		if (ast_strlen_zero(tableptr->schema)) {
-			if (quoted) {
-				ast_str_set(&sql, 0, "INSERT INTO %c%s%c (",
-					tableptr->quoted_identifiers, tableptr->table, tableptr->quoted_identifiers );
-			}else{
-				ast_str_set(&sql, 0, "INSERT INTO %s (", tableptr->table);
-			}
-		} else {
-			if (quoted) {
-				ast_str_set(&sql, 0, "INSERT INTO %c%s%c.%c%s%c (",
-						tableptr->quoted_identifiers, tableptr->schema, tableptr->quoted_identifiers,
-						tableptr->quoted_identifiers, tableptr->table,  tableptr->quoted_identifiers);
-			}else{
-				ast_str_set(&sql, 0, "INSERT INTO %s.%s (", tableptr->schema, tableptr->table);
-			}
+	if (ast_strlen_zero(tableptr->schema)) {
+		if (quoted) {
+			ast_str_set(&sql, 0, "INSERT INTO %c%s%c (",
+				tableptr->quoted_identifiers, tableptr->table, tableptr->quoted_identifiers );
+		}else{
+			ast_str_set(&sql, 0, "INSERT INTO %s (", tableptr->table);
 		}
-		ast_str_set(&sql2, 0, " VALUES (");
-
-		/* No need to check the connection now; we'll handle any failure in prepare_and_execute */
-		if (!(obj = ast_odbc_request_obj(tableptr->connection, 0))) {
-			ast_log(LOG_WARNING, "cdr_adaptive_odbc: Unable to retrieve database handle for '%s:%s'.  CDR failed: %s\n", tableptr->connection, tableptr->table, ast_str_buffer(sql));
-			continue;
+	} else {
+		if (quoted) {
+			ast_str_set(&sql, 0, "INSERT INTO %c%s%c.%c%s%c (",
+					tableptr->quoted_identifiers, tableptr->schema, tableptr->quoted_identifiers,
+					tableptr->quoted_identifiers, tableptr->table,  tableptr->quoted_identifiers);
+		}else{
+			ast_str_set(&sql, 0, "INSERT INTO %s.%s (", tableptr->schema, tableptr->table);
+		}
+	}
+	ast_str_set(&sql2, 0, " VALUES (");
+
+	AST_LIST_TRAVERSE(&(tableptr->columns), entry, list) {
+		int datefield = 0;
+		if (strcasecmp(entry->cdrname, "start") == 0) {
+			datefield = 1;
+		} else if (strcasecmp(entry->cdrname, "answer") == 0) {
+			datefield = 2;
+		} else if (strcasecmp(entry->cdrname, "end") == 0) {
+			datefield = 3;
 		}
 
-		AST_LIST_TRAVERSE(&(tableptr->columns), entry, list) {
-			int datefield = 0;
-			if (strcasecmp(entry->cdrname, "start") == 0) {
-				datefield = 1;
-			} else if (strcasecmp(entry->cdrname, "answer") == 0) {
-				datefield = 2;
-			} else if (strcasecmp(entry->cdrname, "end") == 0) {
-				datefield = 3;
-			}
+		/* Check if we have a similarly named variable */
+		if (entry->staticvalue) {
+			colptr = ast_strdupa(entry->staticvalue);
+		} else if (datefield && tableptr->usegmtime) {
+			struct timeval date_tv = (datefield == 1) ? cdr->start : (datefield == 2) ? cdr->answer : cdr->end;
+			struct ast_tm tm = { 0, };
+			ast_localtime(&date_tv, &tm, "UTC");
+			ast_strftime(colbuf, sizeof(colbuf), "%Y-%m-%d %H:%M:%S", &tm);
+			colptr = colbuf;
+		} else {
+			ast_cdr_format_var(cdr, entry->cdrname, &colptr, colbuf, sizeof(colbuf), datefield ? 0 : 1);
+		}
 
-			/* Check if we have a similarly named variable */
-			if (entry->staticvalue) {
-				colptr = ast_strdupa(entry->staticvalue);
-			} else if (datefield && tableptr->usegmtime) {
-				struct timeval date_tv = (datefield == 1) ? cdr->start : (datefield == 2) ? cdr->answer : cdr->end;
-				struct ast_tm tm = { 0, };
-				ast_localtime(&date_tv, &tm, "UTC");
-				ast_strftime(colbuf, sizeof(colbuf), "%Y-%m-%d %H:%M:%S", &tm);
-				colptr = colbuf;
-			} else {
-				ast_cdr_format_var(cdr, entry->cdrname, &colptr, colbuf, sizeof(colbuf), datefield ? 0 : 1);
+		if (colptr) {
+			/* Check first if the column filters this entry.  Note that this
+			 * is very specifically NOT ast_strlen_zero(), because the filter
+			 * could legitimately specify that the field is blank, which is
+			 * different from the field being unspecified (NULL). */
+			if ((entry->filtervalue && !entry->negatefiltervalue && strcasecmp(colptr, entry->filtervalue) != 0) ||
+				(entry->filtervalue && entry->negatefiltervalue && strcasecmp(colptr, entry->filtervalue) == 0)) {
+				ast_verb(4, "CDR column '%s' with value '%s' does not match filter of"
+					" %s'%s'.  Cancelling this CDR.\n",
+					entry->cdrname, colptr, entry->negatefiltervalue ? "!" : "", entry->filtervalue);
+				goto cleanup;
 			}
 
-			if (colptr) {
-				/* Check first if the column filters this entry.  Note that this
-				 * is very specifically NOT ast_strlen_zero(), because the filter
-				 * could legitimately specify that the field is blank, which is
-				 * different from the field being unspecified (NULL). */
-				if ((entry->filtervalue && !entry->negatefiltervalue && strcasecmp(colptr, entry->filtervalue) != 0) ||
-					(entry->filtervalue && entry->negatefiltervalue && strcasecmp(colptr, entry->filtervalue) == 0)) {
-					ast_verb(4, "CDR column '%s' with value '%s' does not match filter of"
-						" %s'%s'.  Cancelling this CDR.\n",
-						entry->cdrname, colptr, entry->negatefiltervalue ? "!" : "", entry->filtervalue);
-					goto early_release;
-				}
-
-				/* Only a filter? */
-				if (ast_strlen_zero(entry->name))
-					continue;
+			/* Only a filter? */
+			if (ast_strlen_zero(entry->name))
+				continue;
 
-				LENGTHEN_BUF1(strlen(entry->name));
+			LENGTHEN_BUF1(strlen(entry->name));
 
-				switch (entry->type) {
-				case SQL_CHAR:
-				case SQL_VARCHAR:
-				case SQL_LONGVARCHAR:
+			switch (entry->type) {
+			case SQL_CHAR:
+			case SQL_VARCHAR:
+			case SQL_LONGVARCHAR:
 #ifdef HAVE_ODBC_WCHAR
-				case SQL_WCHAR:
-				case SQL_WVARCHAR:
-				case SQL_WLONGVARCHAR:
+			case SQL_WCHAR:
+			case SQL_WVARCHAR:
+			case SQL_WLONGVARCHAR:
 #endif
-				case SQL_BINARY:
-				case SQL_VARBINARY:
-				case SQL_LONGVARBINARY:
-				case SQL_GUID:
-					/* For these two field names, get the rendered form, instead of the raw
-					 * form (but only when we're dealing with a character-based field).
-					 */
-					if (strcasecmp(entry->name, "disposition") == 0) {
-						ast_cdr_format_var(cdr, entry->name, &colptr, colbuf, sizeof(colbuf), 0);
-					} else if (strcasecmp(entry->name, "amaflags") == 0) {
-						ast_cdr_format_var(cdr, entry->name, &colptr, colbuf, sizeof(colbuf), 0);
-					}
+			case SQL_BINARY:
+			case SQL_VARBINARY:
+			case SQL_LONGVARBINARY:
+			case SQL_GUID:
+				/* For these two field names, get the rendered form, instead of the raw
+				 * form (but only when we're dealing with a character-based field).
+				 */
+				if (strcasecmp(entry->name, "disposition") == 0) {
+					ast_cdr_format_var(cdr, entry->name, &colptr, colbuf, sizeof(colbuf), 0);
+				} else if (strcasecmp(entry->name, "amaflags") == 0) {
+					ast_cdr_format_var(cdr, entry->name, &colptr, colbuf, sizeof(colbuf), 0);
+				}
 
-					/* Truncate too-long fields */
-					if (entry->type != SQL_GUID) {
-						if (strlen(colptr) > entry->octetlen) {
-							colptr[entry->octetlen] = '\0';
-						}
+				/* Truncate too-long fields */
+				if (entry->type != SQL_GUID) {
+					if (strlen(colptr) > entry->octetlen) {
+						colptr[entry->octetlen] = '\0';
 					}
+				}
 
-					LENGTHEN_BUF2(strlen(colptr));
+				LENGTHEN_BUF2(strlen(colptr));
 
-					/* Encode value, with escaping */
-					ast_str_append(&sql2, 0, "%s'", separator);
-					for (tmp = colptr; *tmp; tmp++) {
-						if (*tmp == '\'') {
-							ast_str_append(&sql2, 0, "''");
-						} else if (*tmp == '\\' && ast_odbc_backslash_is_escape(obj)) {
-							ast_str_append(&sql2, 0, "\\\\");
-						} else {
-							ast_str_append(&sql2, 0, "%c", *tmp);
-						}
-					}
-					ast_str_append(&sql2, 0, "'");
-					break;
-				case SQL_TYPE_DATE:
-					if (ast_strlen_zero(colptr)) {
-						continue;
+				/* Encode value, with escaping */
+				ast_str_append(&sql2, 0, "%s'", separator);
+				for (tmp = colptr; *tmp; tmp++) {
+					if (*tmp == '\'') {
+						ast_str_append(&sql2, 0, "''");
+					} else if (*tmp == '\\' && ast_odbc_backslash_is_escape(obj)) {
+						ast_str_append(&sql2, 0, "\\\\");
 					} else {
-						int year = 0, month = 0, day = 0;
-						if (sscanf(colptr, "%4d-%2d-%2d", &year, &month, &day) != 3 || year <= 0 ||
-							month <= 0 || month > 12 || day < 0 || day > 31 ||
-							((month == 4 || month == 6 || month == 9 || month == 11) && day == 31) ||
-							(month == 2 && year % 400 == 0 && day > 29) ||
-							(month == 2 && year % 100 == 0 && day > 28) ||
-							(month == 2 && year % 4 == 0 && day > 29) ||
-							(month == 2 && year % 4 != 0 && day > 28)) {
-							ast_log(LOG_WARNING, "CDR variable %s is not a valid date ('%s').\n", entry->name, colptr);
-							continue;
-						}
-
-						if (year > 0 && year < 100) {
-							year += 2000;
-						}
-
-						LENGTHEN_BUF2(17);
-						ast_str_append(&sql2, 0, "%s{ d '%04d-%02d-%02d' }", separator, year, month, day);
+						ast_str_append(&sql2, 0, "%c", *tmp);
 					}
-					break;
-				case SQL_TYPE_TIME:
-					if (ast_strlen_zero(colptr)) {
+				}
+				ast_str_append(&sql2, 0, "'");
+				break;
+			case SQL_TYPE_DATE:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					int year = 0, month = 0, day = 0;
+					if (sscanf(colptr, "%4d-%2d-%2d", &year, &month, &day) != 3 || year <= 0 ||
+						month <= 0 || month > 12 || day < 0 || day > 31 ||
+						((month == 4 || month == 6 || month == 9 || month == 11) && day == 31) ||
+						(month == 2 && year % 400 == 0 && day > 29) ||
+						(month == 2 && year % 100 == 0 && day > 28) ||
+						(month == 2 && year % 4 == 0 && day > 29) ||
+						(month == 2 && year % 4 != 0 && day > 28)) {
+						ast_log(LOG_WARNING, "CDR variable %s is not a valid date ('%s').\n", entry->name, colptr);
 						continue;
-					} else {
-						int hour = 0, minute = 0, second = 0;
-						int count = sscanf(colptr, "%2d:%2d:%2d", &hour, &minute, &second);
-
-						if ((count != 2 && count != 3) || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) {
-							ast_log(LOG_WARNING, "CDR variable %s is not a valid time ('%s').\n", entry->name, colptr);
-							continue;
-						}
+					}
 
-						LENGTHEN_BUF2(15);
-						ast_str_append(&sql2, 0, "%s{ t '%02d:%02d:%02d' }", separator, hour, minute, second);
+					if (year > 0 && year < 100) {
+						year += 2000;
 					}
-					break;
-				case SQL_TYPE_TIMESTAMP:
-				case SQL_TIMESTAMP:
-					if (ast_strlen_zero(colptr)) {
-						continue;
-					} else {
-						int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
-						int count = sscanf(colptr, "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
-
-						if ((count != 3 && count != 5 && count != 6) || year <= 0 ||
-							month <= 0 || month > 12 || day < 0 || day > 31 ||
-							((month == 4 || month == 6 || month == 9 || month == 11) && day == 31) ||
-							(month == 2 && year % 400 == 0 && day > 29) ||
-							(month == 2 && year % 100 == 0 && day > 28) ||
-							(month == 2 && year % 4 == 0 && day > 29) ||
-							(month == 2 && year % 4 != 0 && day > 28) ||
-							hour > 23 || minute > 59 || second > 59 || hour < 0 || minute < 0 || second < 0) {
-							ast_log(LOG_WARNING, "CDR variable %s is not a valid timestamp ('%s').\n", entry->name, colptr);
-							continue;
-						}
 
-						if (year > 0 && year < 100) {
-							year += 2000;
-						}
+					LENGTHEN_BUF2(17);
+					ast_str_append(&sql2, 0, "%s{ d '%04d-%02d-%02d' }", separator, year, month, day);
+				}
+				break;
+			case SQL_TYPE_TIME:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					int hour = 0, minute = 0, second = 0;
+					int count = sscanf(colptr, "%2d:%2d:%2d", &hour, &minute, &second);
 
-						LENGTHEN_BUF2(26);
-						ast_str_append(&sql2, 0, "%s{ ts '%04d-%02d-%02d %02d:%02d:%02d' }", separator, year, month, day, hour, minute, second);
-					}
-					break;
-				case SQL_INTEGER:
-					if (ast_strlen_zero(colptr)) {
+					if ((count != 2 && count != 3) || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) {
+						ast_log(LOG_WARNING, "CDR variable %s is not a valid time ('%s').\n", entry->name, colptr);
 						continue;
-					} else {
-						int integer = 0;
-						if (sscanf(colptr, "%30d", &integer) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
-							continue;
-						}
-
-						LENGTHEN_BUF2(12);
-						ast_str_append(&sql2, 0, "%s%d", separator, integer);
 					}
-					break;
-				case SQL_BIGINT:
-					if (ast_strlen_zero(colptr)) {
-						continue;
-					} else {
-						long long integer = 0;
-						if (sscanf(colptr, "%30lld", &integer) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
-							continue;
-						}
 
-						LENGTHEN_BUF2(24);
-						ast_str_append(&sql2, 0, "%s%lld", separator, integer);
-					}
-					break;
-				case SQL_SMALLINT:
-					if (ast_strlen_zero(colptr)) {
+					LENGTHEN_BUF2(15);
+					ast_str_append(&sql2, 0, "%s{ t '%02d:%02d:%02d' }", separator, hour, minute, second);
+				}
+				break;
+			case SQL_TYPE_TIMESTAMP:
+			case SQL_TIMESTAMP:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+					int count = sscanf(colptr, "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
+
+					if ((count != 3 && count != 5 && count != 6) || year <= 0 ||
+						month <= 0 || month > 12 || day < 0 || day > 31 ||
+						((month == 4 || month == 6 || month == 9 || month == 11) && day == 31) ||
+						(month == 2 && year % 400 == 0 && day > 29) ||
+						(month == 2 && year % 100 == 0 && day > 28) ||
+						(month == 2 && year % 4 == 0 && day > 29) ||
+						(month == 2 && year % 4 != 0 && day > 28) ||
+						hour > 23 || minute > 59 || second > 59 || hour < 0 || minute < 0 || second < 0) {
+						ast_log(LOG_WARNING, "CDR variable %s is not a valid timestamp ('%s').\n", entry->name, colptr);
 						continue;
-					} else {
-						short integer = 0;
-						if (sscanf(colptr, "%30hd", &integer) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
-							continue;
-						}
+					}
 
-						LENGTHEN_BUF2(6);
-						ast_str_append(&sql2, 0, "%s%d", separator, integer);
+					if (year > 0 && year < 100) {
+						year += 2000;
 					}
-					break;
-				case SQL_TINYINT:
-					if (ast_strlen_zero(colptr)) {
+
+					LENGTHEN_BUF2(26);
+					ast_str_append(&sql2, 0, "%s{ ts '%04d-%02d-%02d %02d:%02d:%02d' }", separator, year, month, day, hour, minute, second);
+				}
+				break;
+			case SQL_INTEGER:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					int integer = 0;
+					if (sscanf(colptr, "%30d", &integer) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
 						continue;
-					} else {
-						signed char integer = 0;
-						if (sscanf(colptr, "%30hhd", &integer) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
-							continue;
-						}
+					}
 
-						LENGTHEN_BUF2(4);
-						ast_str_append(&sql2, 0, "%s%d", separator, integer);
+					LENGTHEN_BUF2(12);
+					ast_str_append(&sql2, 0, "%s%d", separator, integer);
+				}
+				break;
+			case SQL_BIGINT:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					long long integer = 0;
+					if (sscanf(colptr, "%30lld", &integer) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
+						continue;
 					}
-					break;
-				case SQL_BIT:
-					if (ast_strlen_zero(colptr)) {
+
+					LENGTHEN_BUF2(24);
+					ast_str_append(&sql2, 0, "%s%lld", separator, integer);
+				}
+				break;
+			case SQL_SMALLINT:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					short integer = 0;
+					if (sscanf(colptr, "%30hd", &integer) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
 						continue;
-					} else {
-						signed char integer = 0;
-						if (sscanf(colptr, "%30hhd", &integer) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
-							continue;
-						}
-						if (integer != 0)
-							integer = 1;
+					}
 
-						LENGTHEN_BUF2(2);
-						ast_str_append(&sql2, 0, "%s%d", separator, integer);
+					LENGTHEN_BUF2(6);
+					ast_str_append(&sql2, 0, "%s%d", separator, integer);
+				}
+				break;
+			case SQL_TINYINT:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					signed char integer = 0;
+					if (sscanf(colptr, "%30hhd", &integer) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
+						continue;
 					}
-					break;
-				case SQL_NUMERIC:
-				case SQL_DECIMAL:
-					if (ast_strlen_zero(colptr)) {
+
+					LENGTHEN_BUF2(4);
+					ast_str_append(&sql2, 0, "%s%d", separator, integer);
+				}
+				break;
+			case SQL_BIT:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					signed char integer = 0;
+					if (sscanf(colptr, "%30hhd", &integer) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an integer.\n", entry->name);
 						continue;
-					} else {
-						double number = 0.0;
-
-						if (!strcasecmp(entry->cdrname, "billsec")) {
-							if (!ast_tvzero(cdr->answer)) {
-								snprintf(colbuf, sizeof(colbuf), "%lf",
-											(double) (ast_tvdiff_us(cdr->end, cdr->answer) / 1000000.0));
-							} else {
-								ast_copy_string(colbuf, "0", sizeof(colbuf));
-							}
-						} else if (!strcasecmp(entry->cdrname, "duration")) {
-							snprintf(colbuf, sizeof(colbuf), "%lf",
-										(double) (ast_tvdiff_us(cdr->end, cdr->start) / 1000000.0));
+					}
+					if (integer != 0)
+						integer = 1;
 
-							if (!ast_strlen_zero(colbuf)) {
-								colptr = colbuf;
-							}
-						}
+					LENGTHEN_BUF2(2);
+					ast_str_append(&sql2, 0, "%s%d", separator, integer);
+				}
+				break;
+			case SQL_NUMERIC:
+			case SQL_DECIMAL:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					double number = 0.0;
 
-						if (sscanf(colptr, "%30lf", &number) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an numeric type.\n", entry->name);
-							continue;
+					if (!strcasecmp(entry->cdrname, "billsec")) {
+						if (!ast_tvzero(cdr->answer)) {
+							snprintf(colbuf, sizeof(colbuf), "%lf",
+										(double) (ast_tvdiff_us(cdr->end, cdr->answer) / 1000000.0));
+						} else {
+							ast_copy_string(colbuf, "0", sizeof(colbuf));
 						}
+					} else if (!strcasecmp(entry->cdrname, "duration")) {
+						snprintf(colbuf, sizeof(colbuf), "%lf",
+									(double) (ast_tvdiff_us(cdr->end, cdr->start) / 1000000.0));
 
-						LENGTHEN_BUF2(entry->decimals);
-						ast_str_append(&sql2, 0, "%s%*.*lf", separator, entry->decimals, entry->radix, number);
+						if (!ast_strlen_zero(colbuf)) {
+							colptr = colbuf;
+						}
 					}
-					break;
-				case SQL_FLOAT:
-				case SQL_REAL:
-				case SQL_DOUBLE:
-					if (ast_strlen_zero(colptr)) {
+
+					if (sscanf(colptr, "%30lf", &number) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an numeric type.\n", entry->name);
 						continue;
-					} else {
-						double number = 0.0;
-
-						if (!strcasecmp(entry->cdrname, "billsec")) {
-							if (!ast_tvzero(cdr->answer)) {
-								snprintf(colbuf, sizeof(colbuf), "%lf",
-											(double) (ast_tvdiff_us(cdr->end, cdr->answer) / 1000000.0));
-							} else {
-								ast_copy_string(colbuf, "0", sizeof(colbuf));
-							}
-						} else if (!strcasecmp(entry->cdrname, "duration")) {
-							snprintf(colbuf, sizeof(colbuf), "%lf",
-										(double) (ast_tvdiff_us(cdr->end, cdr->start) / 1000000.0));
+					}
+
+					LENGTHEN_BUF2(entry->decimals);
+					ast_str_append(&sql2, 0, "%s%*.*lf", separator, entry->decimals, entry->radix, number);
+				}
+				break;
+			case SQL_FLOAT:
+			case SQL_REAL:
+			case SQL_DOUBLE:
+				if (ast_strlen_zero(colptr)) {
+					continue;
+				} else {
+					double number = 0.0;
 
-							if (!ast_strlen_zero(colbuf)) {
-								colptr = colbuf;
-							}
+					if (!strcasecmp(entry->cdrname, "billsec")) {
+						if (!ast_tvzero(cdr->answer)) {
+							snprintf(colbuf, sizeof(colbuf), "%lf",
+										(double) (ast_tvdiff_us(cdr->end, cdr->answer) / 1000000.0));
+						} else {
+							ast_copy_string(colbuf, "0", sizeof(colbuf));
 						}
+					} else if (!strcasecmp(entry->cdrname, "duration")) {
+						snprintf(colbuf, sizeof(colbuf), "%lf",
+									(double) (ast_tvdiff_us(cdr->end, cdr->start) / 1000000.0));
 
-						if (sscanf(colptr, "%30lf", &number) != 1) {
-							ast_log(LOG_WARNING, "CDR variable %s is not an numeric type.\n", entry->name);
-							continue;
+						if (!ast_strlen_zero(colbuf)) {
+							colptr = colbuf;
 						}
+					}
 
-						LENGTHEN_BUF2(entry->decimals);
-						ast_str_append(&sql2, 0, "%s%lf", separator, number);
+					if (sscanf(colptr, "%30lf", &number) != 1) {
+						ast_log(LOG_WARNING, "CDR variable %s is not an numeric type.\n", entry->name);
+						continue;
 					}
-					break;
-				default:
-					ast_log(LOG_WARNING, "Column type %d (field '%s:%s:%s') is unsupported at this time.\n", entry->type, tableptr->connection, tableptr->table, entry->name);
-					continue;
-				}
-				if (quoted) {
-					ast_str_append(&sql, 0, "%s%c%s%c", separator, tableptr->quoted_identifiers, entry->name, tableptr->quoted_identifiers);
-				} else {
-					ast_str_append(&sql, 0, "%s%s", separator, entry->name);
+
+					LENGTHEN_BUF2(entry->decimals);
+					ast_str_append(&sql2, 0, "%s%lf", separator, number);
 				}
-				separator = ", ";
-			} else if (entry->filtervalue
-				&& ((!entry->negatefiltervalue && entry->filtervalue[0] != '\0')
-					|| (entry->negatefiltervalue && entry->filtervalue[0] == '\0'))) {
-				ast_verb(4, "CDR column '%s' was not set and does not match filter of"
-					" %s'%s'.  Cancelling this CDR.\n",
-					entry->cdrname, entry->negatefiltervalue ? "!" : "",
-					entry->filtervalue);
-				goto early_release;
+				break;
+			default:
+				ast_log(LOG_WARNING, "Column type %d (field '%s:%s:%s') is unsupported at this time.\n", entry->type, tableptr->connection, tableptr->table, entry->name);
+				continue;
+			}
+			if (quoted) {
+				ast_str_append(&sql, 0, "%s%c%s%c", separator, tableptr->quoted_identifiers, entry->name, tableptr->quoted_identifiers);
+			} else {
+				ast_str_append(&sql, 0, "%s%s", separator, entry->name);
 			}
+			separator = ", ";
+		} else if (entry->filtervalue
+			&& ((!entry->negatefiltervalue && entry->filtervalue[0] != '\0')
+				|| (entry->negatefiltervalue && entry->filtervalue[0] == '\0'))) {
+			ast_verb(4, "CDR column '%s' was not set and does not match filter of"
+				" %s'%s'.  Cancelling this CDR.\n",
+				entry->cdrname, entry->negatefiltervalue ? "!" : "",
+				entry->filtervalue);
+			goto cleanup;
 		}
+	}
 
-		/* Concatenate the two constructed buffers */
-		LENGTHEN_BUF1(ast_str_strlen(sql2));
-		ast_str_append(&sql, 0, ")");
-		ast_str_append(&sql2, 0, ")");
-		ast_str_append(&sql, 0, "%s", ast_str_buffer(sql2));
+	/* Concatenate the two constructed buffers */
+	LENGTHEN_BUF1(ast_str_strlen(sql2));
+	ast_str_append(&sql, 0, ")");
+	ast_str_append(&sql2, 0, ")");
+	ast_str_append(&sql, 0, "%s", ast_str_buffer(sql2));
 
-		ast_debug(3, "Executing [%s]\n", ast_str_buffer(sql));
+	ast_debug(3, "Executing [%s]\n", ast_str_buffer(sql));
 
-		stmt = ast_odbc_prepare_and_execute(obj, generic_prepare, ast_str_buffer(sql));
-		if (stmt) {
-			SQLRowCount(stmt, &rows);
-			SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-		}
-		if (rows == 0) {
-			ast_log(LOG_WARNING, "cdr_adaptive_odbc: Insert failed on '%s:%s'.  CDR failed: %s\n", tableptr->connection, tableptr->table, ast_str_buffer(sql));
-		}
-early_release:
-		ast_odbc_release_obj(obj);
+	stmt = ast_odbc_prepare_and_execute(obj, generic_prepare, ast_str_buffer(sql));
+	if (stmt) {
+		SQLRowCount(stmt, &rows);
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	}
+	if (rows == 0) {
+		ast_log(LOG_WARNING, "cdr_adaptive_odbc: Insert failed on '%s:%s'.  CDR failed: %s\n", tableptr->connection, tableptr->table, ast_str_buffer(sql));
+		res = -1;
 	}
-	AST_RWLIST_UNLOCK(&odbc_tables);
 
+cleanup:
 	/* Next time, just allocate buffers that are that big to start with. */
 	if (ast_str_strlen(sql) > maxsize) {
 		maxsize = ast_str_strlen(sql);
@@ -779,6 +768,95 @@ early_release:
 
 	ast_free(sql);
 	ast_free(sql2);
+	return res;
+}
+
+static int odbc_log(struct ast_cdr *cdr)
+{
+	struct tables *tableptr;
+	struct odbc_obj *obj;
+
+	if (AST_RWLIST_RDLOCK(&odbc_tables)) {
+		ast_log(LOG_ERROR, "Unable to lock table list.  Insert CDR(s) failed.\n");
+		return -1;
+	}
+
+	AST_LIST_TRAVERSE(&odbc_tables, tableptr, list) {
+		/* No need to check the connection now; we'll handle any failure in prepare_and_execute */
+		if (!(obj = ast_odbc_request_obj(tableptr->connection, 0))) {
+			ast_log(LOG_WARNING, "cdr_adaptive_odbc: Unable to retrieve database handle for '%s:%s'.  CDR failed.\n", tableptr->connection, tableptr->table);
+			continue;
+		}
+
+		odbc_log_table(tableptr, obj, cdr);
+		ast_odbc_release_obj(obj);
+	}
+	AST_RWLIST_UNLOCK(&odbc_tables);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Insert a batch of records, in one transaction for each table
+ *
+ * If the transaction can not be committed the records are inserted again
+ * one at a time, so a single bad record does not lose the rest.
+ */
+static int odbc_log_batch(struct ast_cdr **cdrs, size_t count)
+{
+	struct tables *tableptr;
+	struct odbc_obj *obj;
+	size_t i;
+	int res;
+
+	if (AST_RWLIST_RDLOCK(&odbc_tables)) {
+		ast_log(LOG_ERROR, "Unable to lock table list.  Insert CDR(s) failed.\n");
+		return -1;
+	}
+
+	AST_LIST_TRAVERSE(&odbc_tables, tableptr, list) {
+		/* The connection is ours until released, so autocommit is put back before then */
+		if (!(obj = ast_odbc_request_obj(tableptr->connection, 0))) {
+			ast_log(LOG_WARNING, "cdr_adaptive_odbc: Unable to retrieve database handle for '%s:%s'.  CDR failed.\n", tableptr->connection, tableptr->table);
+			continue;
+		}
+
+		res = SQLSetConnectAttr(obj->con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, 0);
+		if (!SQL_SUCCEEDED(res)) {
+			for (i = 0; i < count; ++i) {
+				odbc_log_table(tableptr, obj, cdrs[i]);
+			}
+			ast_odbc_release_obj(obj);
+			continue;
+		}
+
+		res = 0;
+		for (i = 0; i < count; ++i) {
+			if (odbc_log_table(tableptr, obj, cdrs[i])) {
+				res = -1;
+			}
+		}
+		if (!res) {
+			res = SQLEndTran(SQL_HANDLE_DBC, obj->con, SQL_COMMIT);
+			res = SQL_SUCCEEDED(res) ? 0 : -1;
+		}
+		if (res) {
+			ast_log(LOG_WARNING, "cdr_adaptive_odbc: Batch insert failed on '%s:%s'.  Inserting %zu CDRs one at a time.\n", tableptr->connection, tableptr->table, count);
+			SQLEndTran(SQL_HANDLE_DBC, obj->con, SQL_ROLLBACK);
+		}
+
+		SQLSetConnectAttr(obj->con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, 0);
+
+		if (res) {
+			for (i = 0; i < count; ++i) {
+				odbc_log_table(tableptr, obj, cdrs[i]);
+			}
+		}
+		ast_odbc_release_obj(obj);
+	}
+	AST_RWLIST_UNLOCK(&odbc_tables);
+
 	return 0;
 }
 
@@ -789,7 +867,7 @@ static int unload_module(void)
 	}
 
 	if (AST_RWLIST_WRLOCK(&odbc_tables)) {
-		ast_cdr_register(name, ast_module_info->description, odbc_log);
+		ast_cdr_register_batch(name, ast_module_info->description, odbc_log, odbc_log_batch);
 		ast_log(LOG_ERROR, "Unable to lock column list.  Unload failed.\n");
 		return -1;
 	}
@@ -808,7 +886,7 @@ static int load_module(void)
 
 	load_config();
 	AST_RWLIST_UNLOCK(&odbc_tables);
-	ast_cdr_register(name, ast_module_info->description, odbc_log);
+	ast_cdr_register_batch(name, ast_module_info->description, odbc_log, odbc_log_batch);
 	return 0;
 }
 
@@ -268,6 +268,8 @@ static int build_csv_record(char *buf, size_t bufsize, struct ast_cdr *cdr)
 static int writefile(char *s, char *file_path)
 {
 	FILE *f;
+	int res = 0;
+
 	/* because of the absolutely unconditional need for the
 	   highest reliability possible in writing billing records,
 	   we open write and close the log file each time */
@@ -275,11 +277,14 @@ static int writefile(char *s, char *file_path)
 		ast_log(LOG_ERROR, "Unable to open file %s : %s\n", file_path, strerror(errno));
 		return -1;
 	}
-	fputs(s, f);
-	fflush(f); /* be particularly anal here */
-	fclose(f);
+	if (fputs(s, f) == EOF || fflush(f)) { /* be particularly anal here */
+		res = -1;
+	}
+	if (fclose(f)) {
+		res = -1;
+	}
 
-	return 0;
+	return res;
 }
 
 
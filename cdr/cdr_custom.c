@@ -70,6 +70,8 @@ struct cdr_custom_config {
 		AST_STRING_FIELD(filename);
 		AST_STRING_FIELD(format);
 		);
+	/*! The format compiled, or NULL if it needs substituting on a dummy channel */
+	struct ast_cdr_template *template;
 	ast_mutex_t lock;
 	AST_RWLIST_ENTRY(cdr_custom_config) list;
 };
@@ -81,6 +83,7 @@ static void free_config(void)
 	struct cdr_custom_config *sink;
 
 	while ((sink = AST_RWLIST_REMOVE_HEAD(&sinks, list))) {
+		ast_cdr_template_free(sink->template);
 		ast_mutex_destroy(&sink->lock);
 		ast_string_field_free_memory(sink);
 		ast_free(sink);
@@ -113,6 +116,7 @@ static int load_config(void)
 
 			ast_string_field_build(sink, format, "%s\n", var->value);
 			ast_string_field_build(sink, filename, "%s/%s/%s", ast_config_AST_LOG_DIR, name, var->name);
+			sink->template = ast_cdr_template_compile(sink->format);
 			ast_mutex_init(&sink->lock);
 
 			AST_RWLIST_INSERT_TAIL(&sinks, sink, list);
@@ -128,32 +132,41 @@ static int load_config(void)
 
 static int custom_log(struct ast_cdr *cdr)
 {
-	struct ast_channel *dummy;
+	struct ast_channel *dummy = NULL;
 	struct ast_str *str;
 	struct cdr_custom_config *config;
+	int res = 0;
 
 	/* Batching saves memory management here.  Otherwise, it's the same as doing an allocation and free each time. */
 	if (!(str = ast_str_thread_get(&custom_buf, 16))) {
 		return -1;
 	}
 
-	dummy = ast_dummy_channel_alloc();
-	if (!dummy) {
-		ast_log(LOG_ERROR, "Unable to allocate channel for variable subsitution.\n");
-		return -1;
-	}
-
-	/* We need to dup here since the cdr actually belongs to the other channel,
-	   so when we release this channel we don't want the CDR getting cleaned
-	   up prematurely. */
-	ast_channel_cdr_set(dummy, ast_cdr_dup(cdr));
-
 	AST_RWLIST_RDLOCK(&sinks);
 
 	AST_LIST_TRAVERSE(&sinks, config, list) {
 		FILE *out;
 
-		ast_str_substitute_variables(&str, 0, dummy, config->format);
+		if (config->template) {
+			ast_cdr_template_apply(config->template, cdr, &str);
+		} else {
+			/* Only formats that could not be compiled need a channel to substitute on */
+			if (!dummy) {
+				dummy = ast_dummy_channel_alloc();
+				if (!dummy) {
+					ast_log(LOG_ERROR, "Unable to allocate channel for variable subsitution.\n");
+					res = -1;
+					break;
+				}
+
+				/* We need to dup here since the cdr actually belongs to the other channel,
+				   so when we release this channel we don't want the CDR getting cleaned
+				   up prematurely. */
+				ast_channel_cdr_set(dummy, ast_cdr_dup(cdr));
+			}
+
+			ast_str_substitute_variables(&str, 0, dummy, config->format);
+		}
 
 		/* Even though we have a lock on the list, we could be being chased by
 		   another thread and this lock ensures that we won't step on anyone's
@@ -177,9 +190,9 @@ static int custom_log(struct ast_cdr *cdr)
 
 	AST_RWLIST_UNLOCK(&sinks);
 
-	ast_channel_unref(dummy);
+	ast_channel_cleanup(dummy);
 
-	return 0;
+	return res;
 }
 
 static int unload_module(void)
@@ -101,26 +101,6 @@ struct columns {
 
 static AST_RWLIST_HEAD_STATIC(psql_columns, columns);
 
-#define LENGTHEN_BUF(size, var_sql) \
-			do { \
-				/* Lengthen buffer, if necessary */ \
-				if (ast_str_strlen(var_sql) + size + 1 > ast_str_size(var_sql)) { \
-					if (ast_str_make_space(&var_sql, ((ast_str_size(var_sql) + size + 3) / 512 + 1) * 512) != 0) { \
-						ast_log(LOG_ERROR, "Unable to allocate sufficient memory. Insert CDR '%s:%s' failed.\n", pghostname, table); \
-						ast_free(sql); \
-						ast_free(sql2); \
-						AST_RWLIST_UNLOCK(&psql_columns); \
-						ast_mutex_unlock(&pgsql_lock); \
-						return -1; \
-					} \
-				} \
-			} while (0)
-
-#define LENGTHEN_BUF1(size) \
-	LENGTHEN_BUF(size, sql);
-#define LENGTHEN_BUF2(size) \
-	LENGTHEN_BUF(size, sql2);
-
 /*! \brief Handle the CLI command cdr show pgsql status */
 static char *handle_cdr_pgsql_status(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
@@ -211,14 +191,15 @@ static void pgsql_reconnect(void)
 	ast_free(conn_info);
 }
 
-static int pgsql_log(struct ast_cdr *cdr)
+/*!
+ * \internal
+ * \brief Connect to the database, if not connected already
+ *
+ * \pre pgsql_lock is locked
+ */
+static void pgsql_connect(void)
 {
-	struct ast_tm tm;
 	char *pgerror;
-	PGresult *result;
-	int res = -1;
-
-	ast_mutex_lock(&pgsql_lock);
 
 	if ((!connected) && pghostname && pgdbuser && pgpassword && pgdbname) {
 		pgsql_reconnect();
@@ -242,12 +223,232 @@ static int pgsql_log(struct ast_cdr *cdr)
 			conn = NULL;
 		}
 	}
+}
+
+/*!
+ * \internal
+ * \brief Append the value a record has for a column to a list of values
+ *
+ * \param values The list of values to append to
+ * \param cur The column
+ * \param cdr The record
+ * \param separator What to put before the value
+ * \param escapebuf Buffer for escaping strings, grown as needed
+ * \param bufsize Size of the escape buffer
+ *
+ * \retval 1 if the value was appended
+ * \retval 0 if the record has no value for the column
+ * \retval -1 on failure
+ *
+ * \pre pgsql_lock is locked and we are connected
+ */
+static int pgsql_append_value(struct ast_str **values, struct columns *cur, struct ast_cdr *cdr,
+	const char *separator, char **escapebuf, size_t *bufsize)
+{
+	struct ast_tm tm;
+	char buf[257];
+	char *value;
+
+	/* For fields not set, simply skip them */
+	ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
+	if (strcmp(cur->name, "calldate") == 0 && !value) {
+		ast_cdr_format_var(cdr, "start", &value, buf, sizeof(buf), 0);
+	}
+	if (!value) {
+		return 0;
+	}
+
+	if (strcmp(cur->name, "start") == 0 || strcmp(cur->name, "calldate") == 0) {
+		if (strncmp(cur->type, "int", 3) == 0) {
+			ast_str_append(values, 0, "%s%ld", separator, (long) cdr->start.tv_sec);
+		} else if (strncmp(cur->type, "float", 5) == 0) {
+			ast_str_append(values, 0, "%s%f", separator, (double)cdr->start.tv_sec + (double)cdr->start.tv_usec / 1000000.0);
+		} else {
+			/* char, hopefully */
+			ast_localtime(&cdr->start, &tm, tz);
+			ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
+			ast_str_append(values, 0, "%s%s", separator, buf);
+		}
+	} else if (strcmp(cur->name, "answer") == 0) {
+		if (strncmp(cur->type, "int", 3) == 0) {
+			ast_str_append(values, 0, "%s%ld", separator, (long) cdr->answer.tv_sec);
+		} else if (strncmp(cur->type, "float", 5) == 0) {
+			ast_str_append(values, 0, "%s%f", separator, (double)cdr->answer.tv_sec + (double)cdr->answer.tv_usec / 1000000.0);
+		} else {
+			/* char, hopefully */
+			ast_localtime(&cdr->answer, &tm, tz);
+			ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
+			ast_str_append(values, 0, "%s%s", separator, buf);
+		}
+	} else if (strcmp(cur->name, "end") == 0) {
+		if (strncmp(cur->type, "int", 3) == 0) {
+			ast_str_append(values, 0, "%s%ld", separator, (long) cdr->end.tv_sec);
+		} else if (strncmp(cur->type, "float", 5) == 0) {
+			ast_str_append(values, 0, "%s%f", separator, (double)cdr->end.tv_sec + (double)cdr->end.tv_usec / 1000000.0);
+		} else {
+			/* char, hopefully */
+			ast_localtime(&cdr->end, &tm, tz);
+			ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
+			ast_str_append(values, 0, "%s%s", separator, buf);
+		}
+	} else if (strcmp(cur->name, "duration") == 0 || strcmp(cur->name, "billsec") == 0) {
+		if (cur->type[0] == 'i') {
+			/* Get integer, no need to escape anything */
+			ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
+			ast_str_append(values, 0, "%s%s", separator, value);
+		} else if (strncmp(cur->type, "float", 5) == 0) {
+			struct timeval *when = cur->name[0] == 'd' ? &cdr->start : ast_tvzero(cdr->answer) ? &cdr->end : &cdr->answer;
+			ast_str_append(values, 0, "%s%f", separator, (double) (ast_tvdiff_us(cdr->end, *when) / 1000000.0));
+		} else {
+			/* Char field, probably */
+			struct timeval *when = cur->name[0] == 'd' ? &cdr->start : ast_tvzero(cdr->answer) ? &cdr->end : &cdr->answer;
+			ast_str_append(values, 0, "%s'%f'", separator, (double) (ast_tvdiff_us(cdr->end, *when) / 1000000.0));
+		}
+	} else if (strcmp(cur->name, "disposition") == 0 || strcmp(cur->name, "amaflags") == 0) {
+		if (strncmp(cur->type, "int", 3) == 0) {
+			/* Integer, no need to escape anything */
+			ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 1);
+			ast_str_append(values, 0, "%s%s", separator, value);
+		} else {
+			/* Although this is a char field, there are no special characters in the values for these fields */
+			ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
+			ast_str_append(values, 0, "%s'%s'", separator, value);
+		}
+	} else {
+		/* Arbitrary field, could be anything */
+		ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
+		if (strncmp(cur->type, "int", 3) == 0) {
+			long long whatever;
+			if (value && sscanf(value, "%30lld", &whatever) == 1) {
+				ast_str_append(values, 0, "%s%lld", separator, whatever);
+			} else {
+				ast_str_append(values, 0, "%s0", separator);
+			}
+		} else if (strncmp(cur->type, "float", 5) == 0) {
+			long double whatever;
+			if (value && sscanf(value, "%30Lf", &whatever) == 1) {
+				ast_str_append(values, 0, "%s%30Lf", separator, whatever);
+			} else {
+				ast_str_append(values, 0, "%s0", separator);
+			}
+		/* XXX Might want to handle dates, times, and other misc fields here XXX */
+		} else {
+			if (value) {
+				size_t required_size = strlen(value) * 2 + 1;
+
+				/* If our argument size exceeds our buffer, grow it,
+				 * as PQescapeStringConn() expects the buffer to be
+				 * adequitely sized and does *NOT* do size checking.
+				 */
+				if (required_size > *bufsize) {
+					char *tmpbuf = ast_realloc(*escapebuf, required_size);
+
+					if (!tmpbuf) {
+						return -1;
+					}
+
+					*escapebuf = tmpbuf;
+					*bufsize = required_size;
+				}
+				PQescapeStringConn(conn, *escapebuf, value, strlen(value), NULL);
+			} else {
+				(*escapebuf)[0] = '\0';
+			}
+			ast_str_append(values, 0, "%s'%s'", separator, *escapebuf);
+		}
+	}
+
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Run an INSERT, reconnecting and trying once more if that fails
+ *
+ * \param sql The statement
+ * \param count How many records it inserts
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ *
+ * \pre pgsql_lock is locked and we are connected
+ */
+static int pgsql_insert(struct ast_str *sql, size_t count)
+{
+	PGresult *result;
+	char *pgerror;
+	int res = -1;
+
+	/* Test to be sure we're still connected... */
+	/* If we're connected, and connection is working, good. */
+	/* Otherwise, attempt reconnect.  If it fails... sorry... */
+	if (PQstatus(conn) == CONNECTION_OK) {
+		connected = 1;
+	} else {
+		ast_log(LOG_ERROR, "Connection was lost... attempting to reconnect.\n");
+		PQreset(conn);
+		if (PQstatus(conn) == CONNECTION_OK) {
+			ast_log(LOG_ERROR, "Connection reestablished.\n");
+			connected = 1;
+			connect_time = time(NULL);
+			records = 0;
+		} else {
+			pgerror = PQerrorMessage(conn);
+			ast_log(LOG_ERROR, "Unable to reconnect to database server %s. Calls will not be logged!\n", pghostname);
+			ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
+			PQfinish(conn);
+			conn = NULL;
+			connected = 0;
+			return -1;
+		}
+	}
+	result = PQexec(conn, ast_str_buffer(sql));
+	if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+		pgerror = PQresultErrorMessage(result);
+		ast_log(LOG_ERROR, "Failed to insert call detail record into database!\n");
+		ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
+		ast_log(LOG_ERROR, "Connection may have been lost... attempting to reconnect.\n");
+		PQreset(conn);
+		if (PQstatus(conn) == CONNECTION_OK) {
+			ast_log(LOG_ERROR, "Connection reestablished.\n");
+			connected = 1;
+			connect_time = time(NULL);
+			records = 0;
+			PQclear(result);
+			result = PQexec(conn, ast_str_buffer(sql));
+			if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+				pgerror = PQresultErrorMessage(result);
+				ast_log(LOG_ERROR, "HARD ERROR!  Attempted reconnection failed.  DROPPING CALL RECORD!\n");
+				ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
+			} else {
+				/* Second try worked out ok */
+				totalrecords += count;
+				records += count;
+				res = 0;
+			}
+		}
+	} else {
+		totalrecords += count;
+		records += count;
+		res = 0;
+	}
+	PQclear(result);
+
+	return res;
+}
+
+static int pgsql_log(struct ast_cdr *cdr)
+{
+	int res = -1;
+
+	ast_mutex_lock(&pgsql_lock);
+
+	pgsql_connect();
 
 	if (connected) {
 		struct columns *cur;
 		struct ast_str *sql = ast_str_create(maxsize), *sql2 = ast_str_create(maxsize2);
-		char buf[257];
-		char *escapebuf = NULL, *value;
+		char *escapebuf = NULL;
 		char *separator = "";
 		size_t bufsize = 513;
 
@@ -261,208 +462,28 @@ static int pgsql_log(struct ast_cdr *cdr)
 
 		AST_RWLIST_RDLOCK(&psql_columns);
 		AST_RWLIST_TRAVERSE(&psql_columns, cur, list) {
-			/* For fields not set, simply skip them */
-			ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
-			if (strcmp(cur->name, "calldate") == 0 && !value) {
-				ast_cdr_format_var(cdr, "start", &value, buf, sizeof(buf), 0);
+			int appended = pgsql_append_value(&sql2, cur, cdr, separator, &escapebuf, &bufsize);
+
+			if (appended < 0) {
+				AST_RWLIST_UNLOCK(&psql_columns);
+				goto ast_log_cleanup;
 			}
-			if (!value) {
-				if (cur->notnull && !cur->hasdefault) {
-					/* Field is NOT NULL (but no default), must include it anyway */
-					LENGTHEN_BUF1(strlen(cur->name) + 2);
-					ast_str_append(&sql, 0, "%s\"%s\"", separator, cur->name);
-					LENGTHEN_BUF2(3);
-					ast_str_append(&sql2, 0, "%s''", separator);
-					separator = ", ";
+			if (!appended) {
+				if (!cur->notnull || cur->hasdefault) {
+					continue;
 				}
-				continue;
+				/* Field is NOT NULL (but no default), must include it anyway */
+				ast_str_append(&sql2, 0, "%s''", separator);
 			}
-
-			LENGTHEN_BUF1(strlen(cur->name) + 2);
 			ast_str_append(&sql, 0, "%s\"%s\"", separator, cur->name);
-
-			if (strcmp(cur->name, "start") == 0 || strcmp(cur->name, "calldate") == 0) {
-				if (strncmp(cur->type, "int", 3) == 0) {
-					LENGTHEN_BUF2(13);
-					ast_str_append(&sql2, 0, "%s%ld", separator, (long) cdr->start.tv_sec);
-				} else if (strncmp(cur->type, "float", 5) == 0) {
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s%f", separator, (double)cdr->start.tv_sec + (double)cdr->start.tv_usec / 1000000.0);
-				} else {
-					/* char, hopefully */
-					LENGTHEN_BUF2(31);
-					ast_localtime(&cdr->start, &tm, tz);
-					ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
-					ast_str_append(&sql2, 0, "%s%s", separator, buf);
-				}
-			} else if (strcmp(cur->name, "answer") == 0) {
-				if (strncmp(cur->type, "int", 3) == 0) {
-					LENGTHEN_BUF2(13);
-					ast_str_append(&sql2, 0, "%s%ld", separator, (long) cdr->answer.tv_sec);
-				} else if (strncmp(cur->type, "float", 5) == 0) {
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s%f", separator, (double)cdr->answer.tv_sec + (double)cdr->answer.tv_usec / 1000000.0);
-				} else {
-					/* char, hopefully */
-					LENGTHEN_BUF2(31);
-					ast_localtime(&cdr->answer, &tm, tz);
-					ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
-					ast_str_append(&sql2, 0, "%s%s", separator, buf);
-				}
-			} else if (strcmp(cur->name, "end") == 0) {
-				if (strncmp(cur->type, "int", 3) == 0) {
-					LENGTHEN_BUF2(13);
-					ast_str_append(&sql2, 0, "%s%ld", separator, (long) cdr->end.tv_sec);
-				} else if (strncmp(cur->type, "float", 5) == 0) {
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s%f", separator, (double)cdr->end.tv_sec + (double)cdr->end.tv_usec / 1000000.0);
-				} else {
-					/* char, hopefully */
-					LENGTHEN_BUF2(31);
-					ast_localtime(&cdr->end, &tm, tz);
-					ast_strftime(buf, sizeof(buf), DATE_FORMAT, &tm);
-					ast_str_append(&sql2, 0, "%s%s", separator, buf);
-				}
-			} else if (strcmp(cur->name, "duration") == 0 || strcmp(cur->name, "billsec") == 0) {
-				if (cur->type[0] == 'i') {
-					/* Get integer, no need to escape anything */
-					ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
-					LENGTHEN_BUF2(13);
-					ast_str_append(&sql2, 0, "%s%s", separator, value);
-				} else if (strncmp(cur->type, "float", 5) == 0) {
-					struct timeval *when = cur->name[0] == 'd' ? &cdr->start : ast_tvzero(cdr->answer) ? &cdr->end : &cdr->answer;
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s%f", separator, (double) (ast_tvdiff_us(cdr->end, *when) / 1000000.0));
-				} else {
-					/* Char field, probably */
-					struct timeval *when = cur->name[0] == 'd' ? &cdr->start : ast_tvzero(cdr->answer) ? &cdr->end : &cdr->answer;
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s'%f'", separator, (double) (ast_tvdiff_us(cdr->end, *when) / 1000000.0));
-				}
-			} else if (strcmp(cur->name, "disposition") == 0 || strcmp(cur->name, "amaflags") == 0) {
-				if (strncmp(cur->type, "int", 3) == 0) {
-					/* Integer, no need to escape anything */
-					ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 1);
-					LENGTHEN_BUF2(13);
-					ast_str_append(&sql2, 0, "%s%s", separator, value);
-				} else {
-					/* Although this is a char field, there are no special characters in the values for these fields */
-					ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
-					LENGTHEN_BUF2(31);
-					ast_str_append(&sql2, 0, "%s'%s'", separator, value);
-				}
-			} else {
-				/* Arbitrary field, could be anything */
-				ast_cdr_format_var(cdr, cur->name, &value, buf, sizeof(buf), 0);
-				if (strncmp(cur->type, "int", 3) == 0) {
-					long long whatever;
-					if (value && sscanf(value, "%30lld", &whatever) == 1) {
-						LENGTHEN_BUF2(26);
-						ast_str_append(&sql2, 0, "%s%lld", separator, whatever);
-					} else {
-						LENGTHEN_BUF2(2);
-						ast_str_append(&sql2, 0, "%s0", separator);
-					}
-				} else if (strncmp(cur->type, "float", 5) == 0) {
-					long double whatever;
-					if (value && sscanf(value, "%30Lf", &whatever) == 1) {
-						LENGTHEN_BUF2(51);
-						ast_str_append(&sql2, 0, "%s%30Lf", separator, whatever);
-					} else {
-						LENGTHEN_BUF2(2);
-						ast_str_append(&sql2, 0, "%s0", separator);
-					}
-				/* XXX Might want to handle dates, times, and other misc fields here XXX */
-				} else {
-					if (value) {
-						size_t required_size = strlen(value) * 2 + 1;
-
-						/* If our argument size exceeds our buffer, grow it,
-						 * as PQescapeStringConn() expects the buffer to be
-						 * adequitely sized and does *NOT* do size checking.
-						 */
-						if (required_size > bufsize) {
-							char *tmpbuf = ast_realloc(escapebuf, required_size);
-
-							if (!tmpbuf) {
-								AST_RWLIST_UNLOCK(&psql_columns);
-								goto ast_log_cleanup;
-							}
-
-							escapebuf = tmpbuf;
-							bufsize = required_size;
-						}
-						PQescapeStringConn(conn, escapebuf, value, strlen(value), NULL);
-					} else {
-						escapebuf[0] = '\0';
-					}
-					LENGTHEN_BUF2(strlen(escapebuf) + 3);
-					ast_str_append(&sql2, 0, "%s'%s'", separator, escapebuf);
-				}
-			}
 			separator = ", ";
 		}
-
-		LENGTHEN_BUF1(ast_str_strlen(sql2) + 2);
 		AST_RWLIST_UNLOCK(&psql_columns);
 		ast_str_append(&sql, 0, ")%s)", ast_str_buffer(sql2));
 
 		ast_debug(3, "Inserting a CDR record: [%s]\n", ast_str_buffer(sql));
 
-		/* Test to be sure we're still connected... */
-		/* If we're connected, and connection is working, good. */
-		/* Otherwise, attempt reconnect.  If it fails... sorry... */
-		if (PQstatus(conn) == CONNECTION_OK) {
-			connected = 1;
-		} else {
-			ast_log(LOG_ERROR, "Connection was lost... attempting to reconnect.\n");
-			PQreset(conn);
-			if (PQstatus(conn) == CONNECTION_OK) {
-				ast_log(LOG_ERROR, "Connection reestablished.\n");
-				connected = 1;
-				connect_time = time(NULL);
-				records = 0;
-			} else {
-				pgerror = PQerrorMessage(conn);
-				ast_log(LOG_ERROR, "Unable to reconnect to database server %s. Calls will not be logged!\n", pghostname);
-				ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
-				PQfinish(conn);
-				conn = NULL;
-				connected = 0;
-				goto ast_log_cleanup;
-			}
-		}
-		result = PQexec(conn, ast_str_buffer(sql));
-		if (PQresultStatus(result) != PGRES_COMMAND_OK) {
-			pgerror = PQresultErrorMessage(result);
-			ast_log(LOG_ERROR, "Failed to insert call detail record into database!\n");
-			ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
-			ast_log(LOG_ERROR, "Connection may have been lost... attempting to reconnect.\n");
-			PQreset(conn);
-			if (PQstatus(conn) == CONNECTION_OK) {
-				ast_log(LOG_ERROR, "Connection reestablished.\n");
-				connected = 1;
-				connect_time = time(NULL);
-				records = 0;
-				PQclear(result);
-				result = PQexec(conn, ast_str_buffer(sql));
-				if (PQresultStatus(result) != PGRES_COMMAND_OK) {
-					pgerror = PQresultErrorMessage(result);
-					ast_log(LOG_ERROR, "HARD ERROR!  Attempted reconnection failed.  DROPPING CALL RECORD!\n");
-					ast_log(LOG_ERROR, "Reason: %s\n", pgerror);
-				} else {
-					/* Second try worked out ok */
-					totalrecords++;
-					records++;
-					res = 0;
-				}
-			}
-		} else {
-			totalrecords++;
-			records++;
-			res = 0;
-		}
-		PQclear(result);
+		res = pgsql_insert(sql, 1);
 
 		/* Next time, just allocate buffers that are that big to start with. */
 		if (ast_str_strlen(sql) > maxsize) {
@@ -482,6 +503,77 @@ ast_log_cleanup:
 	return res;
 }
 
+/*!
+ * \internal
+ * \brief Log a batch of records with one multi-row INSERT
+ *
+ * Every row of the INSERT has every column, with DEFAULT for the ones a
+ * single record would have left out.
+ */
+static int pgsql_log_batch(struct ast_cdr **cdrs, size_t count)
+{
+	int res = -1;
+
+	ast_mutex_lock(&pgsql_lock);
+
+	pgsql_connect();
+
+	if (connected) {
+		struct columns *cur;
+		struct ast_str *sql = ast_str_create(maxsize * count);
+		char *escapebuf = NULL;
+		char *separator = "";
+		size_t bufsize = 513;
+		size_t i;
+
+		escapebuf = ast_malloc(bufsize);
+		if (!escapebuf || !sql) {
+			goto batch_cleanup;
+		}
+
+		ast_str_set(&sql, 0, "INSERT INTO %s (", table);
+
+		AST_RWLIST_RDLOCK(&psql_columns);
+		AST_RWLIST_TRAVERSE(&psql_columns, cur, list) {
+			ast_str_append(&sql, 0, "%s\"%s\"", separator, cur->name);
+			separator = ", ";
+		}
+		ast_str_append(&sql, 0, ") VALUES ");
+
+		for (i = 0; i < count; ++i) {
+			ast_str_append(&sql, 0, "%s(", i ? ", " : "");
+			separator = "";
+			AST_RWLIST_TRAVERSE(&psql_columns, cur, list) {
+				int appended = pgsql_append_value(&sql, cur, cdrs[i], separator, &escapebuf, &bufsize);
+
+				if (appended < 0) {
+					AST_RWLIST_UNLOCK(&psql_columns);
+					goto batch_cleanup;
+				}
+				if (!appended) {
+					/* Field is NOT NULL (but no default), must have a value anyway */
+					ast_str_append(&sql, 0, "%s%s", separator,
+						cur->notnull && !cur->hasdefault ? "''" : "DEFAULT");
+				}
+				separator = ", ";
+			}
+			ast_str_append(&sql, 0, ")");
+		}
+		AST_RWLIST_UNLOCK(&psql_columns);
+
+		ast_debug(3, "Inserting %zu CDR records: [%s]\n", count, ast_str_buffer(sql));
+
+		res = pgsql_insert(sql, count);
+
+batch_cleanup:
+		ast_free(escapebuf);
+		ast_free(sql);
+	}
+
+	ast_mutex_unlock(&pgsql_lock);
+	return res;
+}
+
 /* This function should be called without holding the pgsql_columns lock */
 static void empty_columns(void)
 {
@@ -791,7 +883,7 @@ static int load_module(void)
 	if (config_module(0)) {
 		return AST_MODULE_LOAD_DECLINE;
 	}
-	return ast_cdr_register(name, ast_module_info->description, pgsql_log)
+	return ast_cdr_register_batch(name, ast_module_info->description, pgsql_log, pgsql_log_batch)
 		? AST_MODULE_LOAD_DECLINE : 0;
 }
 
@@ -65,6 +65,8 @@ static int busy_timeout;
 
 struct values {
 	AST_LIST_ENTRY(values) list;
+	/*! The expression compiled, or NULL if it needs substituting on a dummy channel */
+	struct ast_cdr_template *template;
 	char expression[1];
 };
 
@@ -144,6 +146,7 @@ static int load_values_config(const char *tmp)
 			return -1;
 		}
 		strcpy(value->expression, v); /* SAFE */
+		value->template = ast_cdr_template_compile(value->expression);
 		AST_LIST_INSERT_TAIL(&sql_values, value, list);
 	}
 	ast_free(save);
@@ -227,6 +230,7 @@ static void free_config(int reload)
 	}
 
 	while ((value = AST_LIST_REMOVE_HEAD(&sql_values, list))) {
+		ast_cdr_template_free(value->template);
 		ast_free(value);
 	}
 }
@@ -248,26 +252,46 @@ static int write_cdr(struct ast_cdr *cdr)
 		char *escaped;
 		char subst_buf[2048];
 		struct values *value;
-		struct ast_channel *dummy;
+		struct ast_channel *dummy = NULL;
 		struct ast_str *value_string = ast_str_create(1024);
+		struct ast_str *template_string = ast_str_create(256);
 
-		dummy = ast_dummy_channel_alloc();
-		if (!dummy) {
-			ast_log(LOG_ERROR, "Unable to allocate channel for variable subsitution.\n");
+		if (!value_string || !template_string) {
 			ast_free(value_string);
+			ast_free(template_string);
 			ast_mutex_unlock(&lock);
 			return 0;
 		}
-		ast_channel_cdr_set(dummy, ast_cdr_dup(cdr));
 		AST_LIST_TRAVERSE(&sql_values, value, list) {
-			pbx_substitute_variables_helper(dummy, value->expression, subst_buf, sizeof(subst_buf) - 1);
-			escaped = sqlite3_mprintf("%q", subst_buf);
+			if (value->template) {
+				ast_cdr_template_apply(value->template, cdr, &template_string);
+				escaped = sqlite3_mprintf("%q", ast_str_buffer(template_string));
+			} else {
+				/* Only expressions that could not be compiled need a channel to substitute on */
+				if (!dummy) {
+					dummy = ast_dummy_channel_alloc();
+					if (!dummy) {
+						ast_log(LOG_ERROR, "Unable to allocate channel for variable subsitution.\n");
+						break;
+					}
+					ast_channel_cdr_set(dummy, ast_cdr_dup(cdr));
+				}
+				pbx_substitute_variables_helper(dummy, value->expression, subst_buf, sizeof(subst_buf) - 1);
+				escaped = sqlite3_mprintf("%q", subst_buf);
+			}
 			ast_str_append(&value_string, 0, "%s'%s'", ast_str_strlen(value_string) ? "," : "", escaped);
 			sqlite3_free(escaped);
 		}
+		ast_channel_cleanup(dummy);
+		ast_free(template_string);
+		if (value) {
+			/* Left the loop early */
+			ast_free(value_string);
+			ast_mutex_unlock(&lock);
+			return 0;
+		}
 		sql = sqlite3_mprintf("INSERT INTO %q (%s) VALUES (%s)", table, columns, ast_str_buffer(value_string));
 		ast_debug(1, "About to log: %s\n", sql);
-		ast_channel_unref(dummy);
 		ast_free(value_string);
 	}
 
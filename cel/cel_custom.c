@@ -58,6 +58,8 @@ struct cel_config {
 		AST_STRING_FIELD(filename);
 		AST_STRING_FIELD(format);
 	);
+	/*! The format compiled, or NULL if it needs substituting on a fabricated channel */
+	struct ast_cel_template *template;
 	ast_mutex_t lock;
 	AST_RWLIST_ENTRY(cel_config) list;
 };
@@ -71,6 +73,7 @@ static void free_config(void)
 	struct cel_config *sink;
 
 	while ((sink = AST_RWLIST_REMOVE_HEAD(&sinks, list))) {
+		ast_cel_template_free(sink->template);
 		ast_mutex_destroy(&sink->lock);
 		ast_string_field_free_memory(sink);
 		ast_free(sink);
@@ -107,6 +110,7 @@ static int load_config(void)
 
 			ast_string_field_build(sink, format, "%s\n", var->value);
 			ast_string_field_build(sink, filename, "%s/%s/%s", ast_config_AST_LOG_DIR, name, var->name);
+			sink->template = ast_cel_template_compile(sink->format);
 			ast_mutex_init(&sink->lock);
 
 			ast_verb(3, "Added CEL CSV mapping for '%s'.\n", sink->filename);
@@ -126,7 +130,7 @@ static int load_config(void)
 
 static void custom_log(struct ast_event *event)
 {
-	struct ast_channel *dummy;
+	struct ast_channel *dummy = NULL;
 	struct ast_str *str;
 	struct cel_config *config;
 
@@ -135,18 +139,28 @@ static void custom_log(struct ast_event *event)
 		return;
 	}
 
-	dummy = ast_cel_fabricate_channel_from_event(event);
-	if (!dummy) {
-		ast_log(LOG_ERROR, "Unable to fabricate channel from CEL event.\n");
-		return;
-	}
-
 	AST_RWLIST_RDLOCK(&sinks);
 
 	AST_LIST_TRAVERSE(&sinks, config, list) {
 		FILE *out;
 
-		ast_str_substitute_variables(&str, 0, dummy, config->format);
+		if (config->template) {
+			if (ast_cel_template_apply(config->template, event, &str)) {
+				ast_log(LOG_ERROR, "Unable to format CEL event.\n");
+				continue;
+			}
+		} else {
+			/* Only formats that could not be compiled need a channel to substitute on */
+			if (!dummy) {
+				dummy = ast_cel_fabricate_channel_from_event(event);
+				if (!dummy) {
+					ast_log(LOG_ERROR, "Unable to fabricate channel from CEL event.\n");
+					break;
+				}
+			}
+
+			ast_str_substitute_variables(&str, 0, dummy, config->format);
+		}
 
 		/* Even though we have a lock on the list, we could be being chased by
 		   another thread and this lock ensures that we won't step on anyone's
@@ -158,9 +172,14 @@ static void custom_log(struct ast_event *event)
 		   highest reliability possible in writing billing records,
 		   we open write and close the log file each time */
 		if ((out = fopen(config->filename, "a"))) {
-			fputs(ast_str_buffer(str), out);
-			fflush(out); /* be particularly anal here */
-			fclose(out);
+			int res;
+
+			res = fputs(ast_str_buffer(str), out) == EOF;
+			res |= fflush(out); /* be particularly anal here */
+			res |= fclose(out);
+			if (res) {
+				ast_log(LOG_ERROR, "Unable to write to master file %s : %s\n", config->filename, strerror(errno));
+			}
 		} else {
 			ast_log(LOG_ERROR, "Unable to re-open master file %s : %s\n", config->filename, strerror(errno));
 		}
@@ -170,7 +189,7 @@ static void custom_log(struct ast_event *event)
 
 	AST_RWLIST_UNLOCK(&sinks);
 
-	ast_channel_unref(dummy);
+	ast_channel_cleanup(dummy);
 }
 
 static int unload_module(void)
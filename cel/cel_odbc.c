@@ -806,12 +806,14 @@ early_release:
 
 static int unload_module(void)
 {
+	/* Queued events still need the tables, so wait for them before taking the lock */
+	ast_cel_backend_unregister(ODBC_BACKEND_NAME);
+
 	if (AST_RWLIST_WRLOCK(&odbc_tables)) {
 		ast_log(LOG_ERROR, "Unable to lock column list.  Unload failed.\n");
 		return -1;
 	}
 
-	ast_cel_backend_unregister(ODBC_BACKEND_NAME);
 	free_config();
 	AST_RWLIST_UNLOCK(&odbc_tables);
 	AST_RWLIST_HEAD_DESTROY(&odbc_tables);
@@ -72,6 +72,8 @@ static int busy_timeout;
 
 struct values {
 	char *expression;
+	/*! The expression compiled, or NULL if it needs substituting on a fabricated channel */
+	struct ast_cel_template *template;
 	AST_LIST_ENTRY(values) list;
 };
 
@@ -148,6 +150,7 @@ static int load_values_config(const char *tmp)
 		}
 		value->expression = (char *) value + sizeof(*value);
 		ast_copy_string(value->expression, val, strlen(val) + 1);
+		value->template = ast_cel_template_compile(value->expression);
 		AST_LIST_INSERT_TAIL(&sql_values, value, list);
 	}
 	ast_free(save);
@@ -233,6 +236,7 @@ static void free_config(void)
 	}
 
 	while ((value = AST_LIST_REMOVE_HEAD(&sql_values, list))) {
+		ast_cel_template_free(value->template);
 		ast_free(value);
 	}
 }
@@ -253,25 +257,48 @@ static void write_cel(struct ast_event *event)
 		char *escaped;
 		char subst_buf[2048];
 		struct values *value;
-		struct ast_channel *dummy;
+		struct ast_channel *dummy = NULL;
 		struct ast_str *value_string = ast_str_create(1024);
+		struct ast_str *template_string = ast_str_create(256);
 
-		dummy = ast_cel_fabricate_channel_from_event(event);
-		if (!dummy) {
-			ast_log(LOG_ERROR, "Unable to fabricate channel from CEL event.\n");
+		if (!value_string || !template_string) {
 			ast_free(value_string);
+			ast_free(template_string);
 			ast_mutex_unlock(&lock);
 			return;
 		}
 		AST_LIST_TRAVERSE(&sql_values, value, list) {
-			pbx_substitute_variables_helper(dummy, value->expression, subst_buf, sizeof(subst_buf) - 1);
-			escaped = sqlite3_mprintf("%q", subst_buf);
+			if (value->template) {
+				if (ast_cel_template_apply(value->template, event, &template_string)) {
+					ast_log(LOG_ERROR, "Unable to format CEL event.\n");
+					break;
+				}
+				escaped = sqlite3_mprintf("%q", ast_str_buffer(template_string));
+			} else {
+				/* Only expressions that could not be compiled need a channel to substitute on */
+				if (!dummy) {
+					dummy = ast_cel_fabricate_channel_from_event(event);
+					if (!dummy) {
+						ast_log(LOG_ERROR, "Unable to fabricate channel from CEL event.\n");
+						break;
+					}
+				}
+				pbx_substitute_variables_helper(dummy, value->expression, subst_buf, sizeof(subst_buf) - 1);
+				escaped = sqlite3_mprintf("%q", subst_buf);
+			}
 			ast_str_append(&value_string, 0, "%s'%s'", ast_str_strlen(value_string) ? "," : "", escaped);
 			sqlite3_free(escaped);
 		}
+		ast_channel_cleanup(dummy);
+		ast_free(template_string);
+		if (value) {
+			/* Left the loop early */
+			ast_free(value_string);
+			ast_mutex_unlock(&lock);
+			return;
+		}
 		sql = sqlite3_mprintf("INSERT INTO %q (%s) VALUES (%s)", table, columns, ast_str_buffer(value_string));
 		ast_debug(1, "About to log: %s\n", sql);
-		dummy = ast_channel_unref(dummy);
 		ast_free(value_string);
 	}
 
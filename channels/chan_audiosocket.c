@@ -46,6 +46,7 @@
 
 struct audiosocket_instance {
 	int svc;	/* The file descriptor for the AudioSocket instance */
+	struct ast_audiosocket_stream *stream;	/* The stream, if multiplexed */
 	char id[38];	/* The UUID identifying this AudioSocket instance */
 } audiosocket_instance;
 
@@ -76,6 +77,9 @@ static struct ast_frame *audiosocket_read(struct ast_channel *ast)
 
 	/* The channel should always be present from the API */
 	instance = ast_channel_tech_pvt(ast);
+	if (instance != NULL && instance->stream) {
+		return ast_audiosocket_stream_receive_frame(instance->stream);
+	}
 	if (instance == NULL || instance->svc < FD_OUTPUT) {
 		return NULL;
 	}
@@ -89,6 +93,9 @@ static int audiosocket_write(struct ast_channel *ast, struct ast_frame *f)
 
 	/* The channel should always be present from the API */
 	instance = ast_channel_tech_pvt(ast);
+	if (instance != NULL && instance->stream) {
+		return ast_audiosocket_stream_send_frame(instance->stream, f);
+	}
 	if (instance == NULL || instance->svc < 1) {
 		return -1;
 	}
@@ -102,6 +109,9 @@ static int audiosocket_call(struct ast_channel *ast, const char *dest, int timeo
 
 	ast_queue_control(ast, AST_CONTROL_ANSWER);
 
+	if (instance->stream) {
+		return ast_audiosocket_stream_init(instance->stream, instance->id);
+	}
 	return ast_audiosocket_init(instance->svc, instance->id);
 }
 
@@ -115,6 +125,9 @@ static int audiosocket_hangup(struct ast_channel *ast)
 	if (instance != NULL && instance->svc > 0) {
 		close(instance->svc);
 	}
+	if (instance != NULL) {
+		ast_audiosocket_stream_close(instance->stream);
+	}
 
 	ast_channel_tech_pvt_set(ast, NULL);
 	ast_free(instance);
@@ -124,6 +137,7 @@ static int audiosocket_hangup(struct ast_channel *ast)
 
 enum {
 	OPT_AUDIOSOCKET_CODEC = (1 << 0),
+	OPT_AUDIOSOCKET_MULTIPLEX = (1 << 1),
 };
 
 enum {
@@ -133,6 +147,7 @@ enum {
 
 AST_APP_OPTIONS(audiosocket_options, BEGIN_OPTIONS
 	AST_APP_OPTION_ARG('c', OPT_AUDIOSOCKET_CODEC, OPT_ARG_AUDIOSOCKET_CODEC),
+	AST_APP_OPTION('m', OPT_AUDIOSOCKET_MULTIPLEX),
 END_OPTIONS );
 
 /*! \brief Function called when we should prepare to call the unicast destination */
@@ -219,10 +234,19 @@ static struct ast_channel *audiosocket_request(const char *type,
 	}
 	ast_copy_string(instance->id, args.idStr, sizeof(instance->id));
 
-	if ((fd = ast_audiosocket_connect(args.destination, NULL)) < 0) {
-		goto failure;
+	if (ast_test_flag(&opts, OPT_AUDIOSOCKET_MULTIPLEX)) {
+		/* Share the connection to the server with other channels */
+		instance->stream = ast_audiosocket_stream_open(args.destination, NULL);
+		if (!instance->stream) {
+			goto failure;
+		}
+		fd = ast_audiosocket_stream_fd(instance->stream);
+	} else {
+		if ((fd = ast_audiosocket_connect(args.destination, NULL)) < 0) {
+			goto failure;
+		}
+		instance->svc = fd;
 	}
-	instance->svc = fd;
 
 	chan = ast_channel_alloc(1, AST_STATE_DOWN, "", "", "", "", "", assignedids,
 		requestor, 0, "AudioSocket/%s-%s", args.destination, args.idStr);
@@ -256,10 +280,12 @@ failure:
 	ao2_cleanup(fmt);
 	ao2_cleanup(caps);
 	if (instance != NULL) {
-		ast_free(instance);
-		if (fd >= 0) {
+		if (instance->stream) {
+			ast_audiosocket_stream_close(instance->stream);
+		} else if (fd >= 0) {
 			close(fd);
 		}
+		ast_free(instance);
 	}
 
 	return NULL;
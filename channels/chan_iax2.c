@@ -115,6 +115,7 @@
 #include "asterisk/format_cache.h"
 #include "asterisk/format_compatibility.h"
 #include "asterisk/format_cap.h"
+#include "asterisk/vector.h"
 
 #include "iax2/include/iax2.h"
 #include "iax2/include/firmware.h"
@@ -605,6 +606,9 @@ struct iax2_trunk_peer {
 	unsigned char *trunkdata;
 	unsigned int trunkdatalen;
 	unsigned int trunkdataalloc;
+	/* Meta frame handed to the timer thread for transmission, swapped with trunkdata */
+	unsigned char *txdata;
+	unsigned int txdataalloc;
 	int trunkmaxmtu;
 	int trunkerror;
 	int calls;
@@ -613,6 +617,16 @@ struct iax2_trunk_peer {
 
 static AST_LIST_HEAD_STATIC(tpeers, iax2_trunk_peer);
 
+/*! A trunk meta frame waiting to be transmitted by the timer thread */
+struct iax2_trunk_tx {
+	struct iax2_trunk_peer *tpeer;
+	void *data;
+	size_t datalen;
+};
+
+/*! Trunk meta frames built during a timer tick, only touched by the timer thread */
+static AST_VECTOR(, struct iax2_trunk_tx) trunk_tx_queue;
+
 enum iax_reg_state {
 	REG_STATE_UNREGISTERED = 0,
 	REG_STATE_REGSENT,
@@ -664,6 +678,13 @@ static AST_LIST_HEAD_STATIC(registrations, iax2_registry);
 
 #define DEFAULT_TRUNKDATA	640 * 10	/*!< 40ms, uncompressed linear * 10 channels */
 
+#if defined(MSG_WAITFORONE)
+/*! sendmmsg() is available to transmit trunk meta frames together */
+#define HAVE_IAX2_TRUNK_BATCH
+#endif
+/*! Maximum number of trunk meta frames transmitted by one system call */
+#define TRUNK_TX_BATCH_MAX	64
+
 #define MAX_TIMESTAMP_SKEW	160		/*!< maximum difference between actual and predicted ts for sending */
 
 /* If consecutive voice frame timestamps jump by more than this many milliseconds, then jitter buffer will resync */
@@ -6259,6 +6280,18 @@ static struct iax2_trunk_peer *find_tpeer(struct ast_sockaddr *addr, int fd)
 
 	if (!tpeer) {
 		if ((tpeer = ast_calloc(1, sizeof(*tpeer)))) {
+			/* Both meta frame arenas are allocated up front so the common case never reallocates */
+			tpeer->trunkdata = ast_malloc(DEFAULT_TRUNKDATA + IAX2_TRUNK_PREFACE);
+			tpeer->txdata = ast_malloc(DEFAULT_TRUNKDATA + IAX2_TRUNK_PREFACE);
+			if (!tpeer->trunkdata || !tpeer->txdata) {
+				ast_free(tpeer->trunkdata);
+				ast_free(tpeer->txdata);
+				ast_free(tpeer);
+				AST_LIST_UNLOCK(&tpeers);
+				return NULL;
+			}
+			tpeer->trunkdataalloc = DEFAULT_TRUNKDATA;
+			tpeer->txdataalloc = DEFAULT_TRUNKDATA;
 			ast_mutex_init(&tpeer->lock);
 			tpeer->lastsent = 9999;
 			ast_sockaddr_copy(&tpeer->addr, addr);
@@ -9411,40 +9444,54 @@ static int iax2_poke_peer_s(const void *data)
 	return 0;
 }
 
-static int send_trunk(struct iax2_trunk_peer *tpeer, struct timeval *now)
+/*!
+ * \internal
+ * \brief Fill in the headers of the pending trunk meta frame
+ *
+ * \pre tpeer is locked and has trunk data pending
+ *
+ * \return The frame, ready to be transmitted
+ */
+static struct iax_frame *build_trunk_frame(struct iax2_trunk_peer *tpeer, struct timeval *now)
 {
-	int res = 0;
 	struct iax_frame *fr;
 	struct ast_iax2_meta_hdr *meta;
 	struct ast_iax2_meta_trunk_hdr *mth;
-	int calls = 0;
 
 	/* Point to frame */
 	fr = (struct iax_frame *)tpeer->trunkdata;
 	/* Point to meta data */
 	meta = (struct ast_iax2_meta_hdr *)fr->afdata;
 	mth = (struct ast_iax2_meta_trunk_hdr *)meta->data;
+	/* We're actually sending a frame, so fill the meta trunk header and meta header */
+	meta->zeros = 0;
+	meta->metacmd = IAX_META_TRUNK;
+	if (ast_test_flag64(&globalflags, IAX_TRUNKTIMESTAMPS))
+		meta->cmddata = IAX_META_TRUNK_MINI;
+	else
+		meta->cmddata = IAX_META_TRUNK_SUPERMINI;
+	mth->ts = htonl(calc_txpeerstamp(tpeer, trunkfreq, now));
+	/* And the rest of the ast_iax2 header */
+	fr->direction = DIRECTION_OUTGRESS;
+	fr->retrans = -1;
+	fr->transfer = 0;
+	/* Any appropriate call will do */
+	fr->data = fr->afdata;
+	fr->datalen = tpeer->trunkdatalen + sizeof(struct ast_iax2_meta_hdr) + sizeof(struct ast_iax2_meta_trunk_hdr);
+
+	return fr;
+}
+
+static int send_trunk(struct iax2_trunk_peer *tpeer, struct timeval *now)
+{
+	int res = 0;
+	struct iax_frame *fr;
+	int calls = 0;
+
 	if (tpeer->trunkdatalen) {
-		/* We're actually sending a frame, so fill the meta trunk header and meta header */
-		meta->zeros = 0;
-		meta->metacmd = IAX_META_TRUNK;
-		if (ast_test_flag64(&globalflags, IAX_TRUNKTIMESTAMPS))
-			meta->cmddata = IAX_META_TRUNK_MINI;
-		else
-			meta->cmddata = IAX_META_TRUNK_SUPERMINI;
-		mth->ts = htonl(calc_txpeerstamp(tpeer, trunkfreq, now));
-		/* And the rest of the ast_iax2 header */
-		fr->direction = DIRECTION_OUTGRESS;
-		fr->retrans = -1;
-		fr->transfer = 0;
-		/* Any appropriate call will do */
-		fr->data = fr->afdata;
-		fr->datalen = tpeer->trunkdatalen + sizeof(struct ast_iax2_meta_hdr) + sizeof(struct ast_iax2_meta_trunk_hdr);
+		fr = build_trunk_frame(tpeer, now);
 		res = transmit_trunk(fr, &tpeer->addr, tpeer->sockfd);
 		calls = tpeer->calls;
-#if 0
-		ast_debug(1, "Trunking %d call chunks in %d bytes to %s:%d, ts=%d\n", calls, fr->datalen, ast_inet_ntoa(tpeer->addr.sin_addr), ntohs(tpeer->addr.sin_port), ntohl(mth->ts));
-#endif
 		/* Reset transmit trunk side data */
 		tpeer->trunkdatalen = 0;
 		tpeer->calls = 0;
@@ -9454,6 +9501,121 @@ static int send_trunk(struct iax2_trunk_peer *tpeer, struct timeval *now)
 	return calls;
 }
 
+/*!
+ * \internal
+ * \brief Hand the pending trunk meta frame to the timer thread's transmit queue
+ *
+ * The arena holding the frame is swapped with the spare one so calls can keep
+ * queueing trunk data while the frame is sent without any locks held.
+ *
+ * \pre tpeer is locked
+ * \note Only the timer thread queues trunk frames and transmits them, and it
+ * sends everything it queued before the next swap, so the spare arena is never
+ * in use twice.
+ *
+ * \return Number of call chunks in the frame, or -1 on failure
+ */
+static int queue_trunk(struct iax2_trunk_peer *tpeer, struct timeval *now)
+{
+	struct iax_frame *fr;
+	struct iax2_trunk_tx tx;
+	unsigned char *data;
+	unsigned int dataalloc;
+	int calls;
+
+	if (!tpeer->trunkdatalen) {
+		return 0;
+	}
+
+	fr = build_trunk_frame(tpeer, now);
+	tx.tpeer = tpeer;
+	tx.data = fr->data;
+	tx.datalen = fr->datalen;
+	if (AST_VECTOR_APPEND(&trunk_tx_queue, tx)) {
+		/* No room to defer it, so send it right away */
+		if (transmit_trunk(fr, &tpeer->addr, tpeer->sockfd) < 0) {
+			tpeer->trunkdatalen = 0;
+			tpeer->calls = 0;
+			return -1;
+		}
+	} else {
+		data = tpeer->txdata;
+		dataalloc = tpeer->txdataalloc;
+		tpeer->txdata = tpeer->trunkdata;
+		tpeer->txdataalloc = tpeer->trunkdataalloc;
+		tpeer->trunkdata = data;
+		tpeer->trunkdataalloc = dataalloc;
+	}
+
+	calls = tpeer->calls;
+	/* Reset transmit trunk side data */
+	tpeer->trunkdatalen = 0;
+	tpeer->calls = 0;
+
+	return calls;
+}
+
+/*!
+ * \internal
+ * \brief Transmit the trunk meta frames queued during this timer tick
+ *
+ * Frames leaving through the same socket are sent with as few system calls
+ * as possible.
+ */
+static void transmit_trunk_queue(void)
+{
+	struct iax2_trunk_tx *tx;
+	size_t i = 0;
+#ifdef HAVE_IAX2_TRUNK_BATCH
+	struct mmsghdr msgs[TRUNK_TX_BATCH_MAX];
+	struct iovec iov[TRUNK_TX_BATCH_MAX];
+	int count;
+	int sent;
+	int res;
+	int sockfd;
+
+	while (i < AST_VECTOR_SIZE(&trunk_tx_queue)) {
+		sockfd = AST_VECTOR_GET_ADDR(&trunk_tx_queue, i)->tpeer->sockfd;
+
+		/* Gather the consecutive frames sharing this socket */
+		for (count = 0; count < TRUNK_TX_BATCH_MAX && i + count < AST_VECTOR_SIZE(&trunk_tx_queue); count++) {
+			tx = AST_VECTOR_GET_ADDR(&trunk_tx_queue, i + count);
+			if (tx->tpeer->sockfd != sockfd) {
+				break;
+			}
+			iov[count].iov_base = tx->data;
+			iov[count].iov_len = tx->datalen;
+			memset(&msgs[count], 0, sizeof(msgs[count]));
+			msgs[count].msg_hdr.msg_name = &tx->tpeer->addr.ss;
+			msgs[count].msg_hdr.msg_namelen = tx->tpeer->addr.len;
+			msgs[count].msg_hdr.msg_iov = &iov[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+		}
+
+		for (sent = 0; sent < count; sent += res) {
+			res = sendmmsg(sockfd, &msgs[sent], count - sent, 0);
+			if (res <= 0) {
+				ast_debug(1, "Received error: %s\n", strerror(errno));
+				handle_error();
+				/* Only the first frame failed, carry on with the ones after it */
+				res = 1;
+			}
+		}
+		i += count;
+	}
+#else
+	for (; i < AST_VECTOR_SIZE(&trunk_tx_queue); i++) {
+		tx = AST_VECTOR_GET_ADDR(&trunk_tx_queue, i);
+		if (ast_sendto(tx->tpeer->sockfd, tx->data, tx->datalen, 0, &tx->tpeer->addr) < 0) {
+			ast_debug(1, "Received error: %s\n", strerror(errno));
+			handle_error();
+		}
+	}
+#endif
+
+	AST_VECTOR_RESET(&trunk_tx_queue, AST_VECTOR_ELEM_CLEANUP_NOOP);
+}
+
 static inline int iax2_trunk_expired(struct iax2_trunk_peer *tpeer, struct timeval *now)
 {
 	/* Drop when trunk is about 5 seconds idle */
@@ -9493,7 +9655,7 @@ static int timing_read(int *id, int fd, short events, void *cbdata)
 			AST_LIST_REMOVE_CURRENT(list);
 			drop = tpeer;
 		} else {
-			res = send_trunk(tpeer, &now);
+			res = queue_trunk(tpeer, &now);
 			trunk_timed++;
 			if (iaxtrunkdebug) {
 				ast_verbose(" - Trunk peer (%s) has %d call chunk%s in transit, %u bytes backloged and has hit a high water mark of %u bytes\n",
@@ -9511,6 +9673,9 @@ static int timing_read(int *id, int fd, short events, void *cbdata)
 	AST_LIST_TRAVERSE_SAFE_END;
 	AST_LIST_UNLOCK(&tpeers);
 
+	/* The frames are sent with no locks held so calls can keep trunking meanwhile */
+	transmit_trunk_queue();
+
 	if (drop) {
 		ast_mutex_lock(&drop->lock);
 		/*  Once we have this lock, we're sure nobody else is using it or could use it once we release it,
@@ -9520,6 +9685,8 @@ static int timing_read(int *id, int fd, short events, void *cbdata)
 			ast_free(drop->trunkdata);
 			drop->trunkdata = NULL;
 		}
+		ast_free(drop->txdata);
+		drop->txdata = NULL;
 		ast_mutex_unlock(&drop->lock);
 		ast_mutex_destroy(&drop->lock);
 		ast_free(drop);
@@ -14685,6 +14852,7 @@ static int __unload_module(void)
 		ast_timer_close(timer);
 		timer = NULL;
 	}
+	AST_VECTOR_FREE(&trunk_tx_queue);
 	transmit_processor = ast_taskprocessor_unreference(transmit_processor);
 
 	ast_sched_clean_by_callback(sched, peercnt_remove_cb, peercnt_remove_cb);
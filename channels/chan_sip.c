@@ -34137,7 +34137,7 @@ static int sip_removeheader(struct ast_channel *chan, const char *data)
 						ast_var_value(newvariable),
 						ast_var_name(newvariable));
 				}
-				AST_LIST_REMOVE_CURRENT(entries);
+				AST_VAR_LIST_REMOVE_CURRENT(headp, newvariable);
 				ast_var_delete(newvariable);
 			}
 		}
@@ -400,6 +400,10 @@
 					<enum name="stdevrtt"><para>Standard deviation round trip time</para></enum>
 					<enum name="local_ssrc"><para>Our Synchronization Source identifier</para></enum>
 					<enum name="remote_ssrc"><para>Their Synchronization Source identifier</para></enum>
+					<enum name="rxbatches"><para>Batched receive calls that returned packets</para></enum>
+					<enum name="rxbatchcount"><para>Packets received by batched receive calls</para></enum>
+					<enum name="txbatches"><para>Batched send calls that sent packets</para></enum>
+					<enum name="txbatchcount"><para>Packets sent by batched send calls</para></enum>
 				</enumlist>
 			</parameter>
 			<parameter name="media_type" required="false">
@@ -708,6 +712,10 @@ static int channel_read_rtcp(struct ast_channel *chan, const char *type, const c
 			{ "stdevrtt",              DBL, { .d8 = &stats.stdevrtt, }, },
 			{ "local_ssrc",            INT, { .i4 = &stats.local_ssrc, }, },
 			{ "remote_ssrc",           INT, { .i4 = &stats.remote_ssrc, }, },
+			{ "rxbatches",             INT, { .i4 = &stats.rxbatches, }, },
+			{ "rxbatchcount",          INT, { .i4 = &stats.rxbatchcount, }, },
+			{ "txbatches",             INT, { .i4 = &stats.txbatches, }, },
+			{ "txbatchcount",          INT, { .i4 = &stats.txbatchcount, }, },
 			{ NULL, },
 		};
 
@@ -33,6 +33,7 @@
 #include "asterisk/config.h"
 #include "asterisk/translate.h"
 #include "asterisk/alaw.h"
+#include "asterisk/g711.h"
 #include "asterisk/utils.h"
 
 #define BUFFER_SAMPLES   8096	/* size for the translation buffers */
@@ -51,8 +52,19 @@ static int alawtolin_framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
 	pvt->samples += i;
 	pvt->datalen += i * 2;	/* 2 bytes/sample */
 
-	while (i--)
-		*dst++ = AST_ALAW(*src++);
+	ast_alaw_decode(dst, src, i);
+
+	return 0;
+}
+
+/*! \brief decode the frames of several instances at once */
+static int alawtolin_framein_batch(struct ast_trans_pvt **pvts, struct ast_frame **in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		alawtolin_framein(pvts[i], in[i]);
+	}
 
 	return 0;
 }
@@ -73,6 +85,18 @@ static int lintoalaw_framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
 	return 0;
 }
 
+/*! \brief encode the frames of several instances at once */
+static int lintoalaw_framein_batch(struct ast_trans_pvt **pvts, struct ast_frame **in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		lintoalaw_framein(pvts[i], in[i]);
+	}
+
+	return 0;
+}
+
 static struct ast_translator alawtolin = {
 	.name = "alawtolin",
 	.src_codec = {
@@ -87,6 +111,7 @@ static struct ast_translator alawtolin = {
 	},
 	.format = "slin",
 	.framein = alawtolin_framein,
+	.framein_batch = alawtolin_framein_batch,
 	.sample = alaw_sample,
 	.buffer_samples = BUFFER_SAMPLES,
 	.buf_size = BUFFER_SAMPLES * 2,
@@ -106,6 +131,7 @@ static struct ast_translator lintoalaw = {
 	},
 	.format = "alaw",
 	.framein = lintoalaw_framein,
+	.framein_batch = lintoalaw_framein_batch,
 	.sample = slin8_sample,
 	.buffer_samples = BUFFER_SAMPLES,
 	.buf_size = BUFFER_SAMPLES,
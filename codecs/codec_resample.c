@@ -102,6 +102,11 @@ static int resamp_new(struct ast_trans_pvt *pvt)
 	return 0;
 }
 
+static int resamp_reset(struct ast_trans_pvt *pvt)
+{
+	return speex_resampler_reset_mem(pvt->pvt) ? -1 : 0;
+}
+
 static void resamp_destroy(struct ast_trans_pvt *pvt)
 {
 	SpeexResamplerState *resamp_pvt = pvt->pvt;
@@ -163,6 +168,7 @@ static int load_module(void)
 			}
 			translators[idx].newpvt = resamp_new;
 			translators[idx].destroy = resamp_destroy;
+			translators[idx].reset = resamp_reset;
 			translators[idx].framein = resamp_framein;
 			translators[idx].desc_size = 0;
 			translators[idx].buffer_samples = OUTBUF_SAMPLES;
@@ -33,6 +33,7 @@
 #include "asterisk/config.h"
 #include "asterisk/translate.h"
 #include "asterisk/ulaw.h"
+#include "asterisk/g711.h"
 #include "asterisk/utils.h"
 
 #define BUFFER_SAMPLES   8096	/* size for the translation buffers */
@@ -52,8 +53,19 @@ static int ulawtolin_framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
 	pvt->datalen += i * 2;	/* 2 bytes/sample */
 
 	/* convert and copy in outbuf */
-	while (i--)
-		*dst++ = AST_MULAW(*src++);
+	ast_ulaw_decode(dst, src, i);
+
+	return 0;
+}
+
+/*! \brief decode the frames of several instances at once */
+static int ulawtolin_framein_batch(struct ast_trans_pvt **pvts, struct ast_frame **in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		ulawtolin_framein(pvts[i], in[i]);
+	}
 
 	return 0;
 }
@@ -74,6 +86,18 @@ static int lintoulaw_framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
 	return 0;
 }
 
+/*! \brief encode the frames of several instances at once */
+static int lintoulaw_framein_batch(struct ast_trans_pvt **pvts, struct ast_frame **in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		lintoulaw_framein(pvts[i], in[i]);
+	}
+
+	return 0;
+}
+
 /*!
  * \brief The complete translator for ulawToLin.
  */
@@ -92,6 +116,7 @@ static struct ast_translator ulawtolin = {
 	},
 	.format = "slin",
 	.framein = ulawtolin_framein,
+	.framein_batch = ulawtolin_framein_batch,
 	.sample = ulaw_sample,
 	.buffer_samples = BUFFER_SAMPLES,
 	.buf_size = BUFFER_SAMPLES * 2,
@@ -115,6 +140,7 @@ static struct ast_translator lintoulaw = {
 	},
 	.format = "ulaw",
 	.framein = lintoulaw_framein,
+	.framein_batch = lintoulaw_framein_batch,
 	.sample = slin8_sample,
 	.buf_size = BUFFER_SAMPLES,
 	.buffer_samples = BUFFER_SAMPLES,
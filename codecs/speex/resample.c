@@ -104,6 +104,10 @@ static void speex_free (void *ptr) {free(ptr);}
 #include "resample_neon.h"
 #endif
 
+#if defined(FIXED_POINT) && !defined(_USE_SSE) && !defined(_USE_NEON)
+#include "resample_fixed.h"
+#endif
+
 /* Numer of elements to allocate on the stack */
 #ifdef VAR_ARRAYS
 #define FIXED_STACK_ALLOC 8192
@@ -0,0 +1,86 @@
+/* Copyright (C) 2026, Sangoma Technologies Corporation */
+/**
+   @file resample_fixed.h
+   @brief Resampler inner product for fixed point builds using SSE2 or NEON
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of the Xiph.org Foundation nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* The products are summed in 32 bits exactly as the generic loop does,
+   so the output is bit for bit the same, just eight taps at a time. */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#define OVERRIDE_INNER_PRODUCT_SINGLE
+static inline spx_word32_t inner_product_single(const spx_word16_t *a, const spx_word16_t *b, unsigned int len)
+{
+   unsigned int i = 0;
+   spx_word32_t sum;
+   __m128i acc = _mm_setzero_si128();
+
+   for (; i + 8 <= len; i += 8)
+   {
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(a + i)),
+         _mm_loadu_si128((const __m128i *)(b + i))));
+   }
+   acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+   acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+   sum = _mm_cvtsi128_si32(acc);
+   for (; i < len; i++)
+      sum += MULT16_16(a[i], b[i]);
+
+   return SATURATE32PSHR(sum, 15, 32767);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define OVERRIDE_INNER_PRODUCT_SINGLE
+static inline spx_word32_t inner_product_single(const spx_word16_t *a, const spx_word16_t *b, unsigned int len)
+{
+   unsigned int i = 0;
+   spx_word32_t sum;
+   int32x4_t acc = vdupq_n_s32(0);
+
+   for (; i + 8 <= len; i += 8)
+   {
+      int16x8_t va = vld1q_s16(a + i);
+      int16x8_t vb = vld1q_s16(b + i);
+
+      acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+      acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+   }
+   sum = vaddvq_s32(acc);
+   for (; i < len; i++)
+      sum += MULT16_16(a[i], b[i]);
+
+   return SATURATE32PSHR(sum, 15, 32767);
+}
+#endif
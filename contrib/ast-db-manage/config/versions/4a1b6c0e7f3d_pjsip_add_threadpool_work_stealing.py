@@ -0,0 +1,39 @@
+"""pjsip add threadpool_work_stealing
+
+Revision ID: 4a1b6c0e7f3d
+Revises: c20d6e3992f4
+Create Date: 2026-10-14 09:12:44.318214
+
+"""
+
+# revision identifiers, used by Alembic.
+revision = '4a1b6c0e7f3d'
+down_revision = 'c20d6e3992f4'
+
+from alembic import op
+import sqlalchemy as sa
+from sqlalchemy.dialects.postgresql import ENUM
+
+AST_BOOL_NAME = 'ast_bool_values'
+# We'll just ignore the n/y and f/t abbreviations as Asterisk does not write
+# those aliases.
+AST_BOOL_VALUES = [ '0', '1',
+                    'off', 'on',
+                    'false', 'true',
+                    'no', 'yes' ]
+
+
+def upgrade():
+    ############################# Enums ##############################
+
+    # ast_bool_values has already been created, so use postgres enum object
+    # type to get around "already created" issue - works okay with mysql
+    ast_bool_values = ENUM(*AST_BOOL_VALUES, name=AST_BOOL_NAME, create_type=False)
+
+    op.add_column('ps_systems', sa.Column('threadpool_work_stealing', ast_bool_values))
+
+
+def downgrade():
+    if op.get_context().bind.dialect.name == 'mssql':
+        op.drop_constraint('ck_ps_systems_threadpool_work_stealing_ast_bool_values','ps_systems')
+    op.drop_column('ps_systems', 'threadpool_work_stealing')
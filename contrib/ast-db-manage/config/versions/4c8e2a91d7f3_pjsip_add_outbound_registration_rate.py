@@ -0,0 +1,22 @@
+"""pjsip add outbound_registration_rate
+
+Revision ID: 4c8e2a91d7f3
+Revises: b3d75f0e81c4
+Create Date: 2026-10-14 18:12:07.543129
+
+"""
+
+# revision identifiers, used by Alembic.
+revision = '4c8e2a91d7f3'
+down_revision = 'b3d75f0e81c4'
+
+from alembic import op
+import sqlalchemy as sa
+
+
+def upgrade():
+    op.add_column('ps_globals', sa.Column('outbound_registration_rate', sa.Integer))
+
+
+def downgrade():
+    op.drop_column('ps_globals', 'outbound_registration_rate')
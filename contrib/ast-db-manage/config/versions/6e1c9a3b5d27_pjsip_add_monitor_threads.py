@@ -0,0 +1,22 @@
+"""pjsip add monitor_threads
+
+Revision ID: 6e1c9a3b5d27
+Revises: 4a1b6c0e7f3d
+Create Date: 2026-10-14 14:27:09.551302
+
+"""
+
+# revision identifiers, used by Alembic.
+revision = '6e1c9a3b5d27'
+down_revision = '4a1b6c0e7f3d'
+
+from alembic import op
+import sqlalchemy as sa
+
+
+def upgrade():
+    op.add_column('ps_systems', sa.Column('monitor_threads', sa.Integer))
+
+
+def downgrade():
+    op.drop_column('ps_systems', 'monitor_threads')
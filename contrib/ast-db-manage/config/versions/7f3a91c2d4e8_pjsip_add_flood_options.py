@@ -0,0 +1,26 @@
+"""pjsip add flood protection options
+
+Revision ID: 7f3a91c2d4e8
+Revises: 4c8e2a91d7f3
+Create Date: 2026-10-15 09:41:23.118604
+
+"""
+
+# revision identifiers, used by Alembic.
+revision = '7f3a91c2d4e8'
+down_revision = '4c8e2a91d7f3'
+
+from alembic import op
+import sqlalchemy as sa
+
+
+def upgrade():
+    op.add_column('ps_globals', sa.Column('flood_request_rate', sa.Integer))
+    op.add_column('ps_globals', sa.Column('flood_request_burst', sa.Integer))
+    op.add_column('ps_globals', sa.Column('flood_ban_time', sa.Integer))
+
+
+def downgrade():
+    op.drop_column('ps_globals', 'flood_request_rate')
+    op.drop_column('ps_globals', 'flood_request_burst')
+    op.drop_column('ps_globals', 'flood_ban_time')
@@ -0,0 +1,22 @@
+"""pjsip add contact_refresh_write_delay
+
+Revision ID: b3d75f0e81c4
+Revises: 6e1c9a3b5d27
+Create Date: 2026-10-14 15:03:41.208716
+
+"""
+
+# revision identifiers, used by Alembic.
+revision = 'b3d75f0e81c4'
+down_revision = '6e1c9a3b5d27'
+
+from alembic import op
+import sqlalchemy as sa
+
+
+def upgrade():
+    op.add_column('ps_globals', sa.Column('contact_refresh_write_delay', sa.Integer))
+
+
+def downgrade():
+    op.drop_column('ps_globals', 'contact_refresh_write_delay')
@@ -136,6 +136,8 @@ static struct ast_format_def g729_f = {
 	.tell = g729_tell,
 	.read = g729_read,
 	.buf_size = BUF_SIZE + AST_FRIENDLY_OFFSET,
+	.frame_bytes = BUF_SIZE,
+	.frame_samples = G729A_SAMPLES,
 };
 
 static int load_module(void)
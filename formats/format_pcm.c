@@ -497,6 +497,9 @@ static struct ast_format_def alaw_f = {
 	.tell = pcm_tell,
 	.read = pcm_read,
 	.buf_size = BUF_SIZE + AST_FRIENDLY_OFFSET,
+	.frame_bytes = BUF_SIZE,
+	.frame_samples = BUF_SIZE,
+	.frame_unit_bytes = 1,
 #ifdef REALTIME_WRITE
 	.open = pcma_open,
 	.rewrite = pcma_rewrite,
@@ -514,6 +517,9 @@ static struct ast_format_def pcm_f = {
 	.tell = pcm_tell,
 	.read = pcm_read,
 	.buf_size = BUF_SIZE + AST_FRIENDLY_OFFSET,
+	.frame_bytes = BUF_SIZE,
+	.frame_samples = BUF_SIZE,
+	.frame_unit_bytes = 1,
 };
 
 static struct ast_format_def g722_f = {
@@ -525,6 +531,9 @@ static struct ast_format_def g722_f = {
 	.tell = g722_tell,
 	.read = g722_read,
 	.buf_size = (BUF_SIZE * 2) + AST_FRIENDLY_OFFSET,
+	.frame_bytes = BUF_SIZE,
+	.frame_samples = BUF_SIZE * 2,
+	.frame_unit_bytes = 1,
 };
 
 static struct ast_format_def au_f = {
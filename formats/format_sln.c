@@ -134,6 +134,9 @@ static struct ast_format_def slin_f = {
 	.tell = slinear_tell,
 	.read = slinear_read,
 	.buf_size = 320 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 320,
+	.frame_samples = 160,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear12_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 480);}
@@ -146,6 +149,9 @@ static struct ast_format_def slin12_f = {
 	.tell = slinear_tell,
 	.read = slinear12_read,
 	.buf_size = 480 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 480,
+	.frame_samples = 240,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear16_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 640);}
@@ -158,6 +164,9 @@ static struct ast_format_def slin16_f = {
 	.tell = slinear_tell,
 	.read = slinear16_read,
 	.buf_size = 640 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 640,
+	.frame_samples = 320,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear24_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 960);}
@@ -170,6 +179,9 @@ static struct ast_format_def slin24_f = {
 	.tell = slinear_tell,
 	.read = slinear24_read,
 	.buf_size = 960 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 960,
+	.frame_samples = 480,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear32_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 1280);}
@@ -182,6 +194,9 @@ static struct ast_format_def slin32_f = {
 	.tell = slinear_tell,
 	.read = slinear32_read,
 	.buf_size = 1280 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 1280,
+	.frame_samples = 640,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear44_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 1764);}
@@ -194,6 +209,9 @@ static struct ast_format_def slin44_f = {
 	.tell = slinear_tell,
 	.read = slinear44_read,
 	.buf_size = 1764 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 1764,
+	.frame_samples = 882,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear48_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 1920);}
@@ -206,6 +224,9 @@ static struct ast_format_def slin48_f = {
 	.tell = slinear_tell,
 	.read = slinear48_read,
 	.buf_size = 1920 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 1920,
+	.frame_samples = 960,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear96_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 3840);}
@@ -218,6 +239,9 @@ static struct ast_format_def slin96_f = {
 	.tell = slinear_tell,
 	.read = slinear96_read,
 	.buf_size = 3840 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 3840,
+	.frame_samples = 1920,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_frame *slinear192_read(struct ast_filestream *s, int *whennext){return generic_read(s, whennext, 7680);}
@@ -230,6 +254,9 @@ static struct ast_format_def slin192_f = {
 	.tell = slinear_tell,
 	.read = slinear192_read,
 	.buf_size = 7680 + AST_FRIENDLY_OFFSET,
+	.frame_bytes = 7680,
+	.frame_samples = 3840,
+	.frame_unit_bytes = 2,
 };
 
 static struct ast_format_def *slin_list[] = {
@@ -46,6 +46,7 @@
 #include "asterisk/pbx.h"
 #include "asterisk/cli.h"
 #include "asterisk/module.h"
+#include "asterisk/res_curl.h"
 #include "asterisk/app.h"
 #include "asterisk/utils.h"
 #include "asterisk/threadstorage.h"
@@ -190,6 +191,13 @@
 					<enum name="failurecodes">
 						<para>A comma separated list of HTTP response codes to be treated as errors</para>
 					</enum>
+					<enum name="cache">
+						<para>Number of seconds to keep the results of <literal>CURL</literal>
+						reads.  A read with the same URL, POST data and options as a
+						cached one returns the cached result instead of making a request,
+						and reads made while an identical one is in progress wait for its
+						result.  The default of <literal>0</literal> disables the cache.</para>
+					</enum>
 				</enumlist>
 			</parameter>
 		</syntax>
@@ -211,6 +219,14 @@
 
 #define CURLOPT_SPECIAL_FAILURE_CODE 999
 
+#define CURLOPT_SPECIAL_CACHE ((CURLoption) -501)
+
+/*! \brief Number of buckets in the container of cached results */
+#define CURL_CACHE_BUCKETS 127
+
+/*! \brief Maximum number of results kept in the cache */
+#define CURL_CACHE_MAX 10000
+
 static void curlds_free(void *data);
 
 static const struct ast_datastore_info curl_info = {
@@ -326,6 +342,9 @@ static int parse_curlopt_key(const char *name, CURLoption *key, enum optiontype
 	} else if (!strcasecmp(name, "failurecodes")) {
 		*key = CURLOPT_SPECIAL_FAILURE_CODE;
 		*ot = OT_STRING;
+	} else if (!strcasecmp(name, "cache")) {
+		*key = CURLOPT_SPECIAL_CACHE;
+		*ot = OT_INTEGER_MS;
 	} else {
 		return -1;
 	}
@@ -658,6 +677,8 @@ struct curl_args {
 	const char *url;
 	const char *postdata;
 	struct curl_write_callback_data cb_data;
+	/*! \brief Set if the transfer itself failed */
+	int failed;
 };
 
 static int acf_curl_helper(struct ast_channel *chan, struct curl_args *args)
@@ -706,6 +727,8 @@ static int acf_curl_helper(struct ast_channel *chan, struct curl_args *args)
 			while( (found = strsep(&failurecodestrings, ",")) != NULL) {
 				AST_VECTOR_APPEND(&hasfailurecode, atoi(found));
 			}
+		} else if (cur->key == CURLOPT_SPECIAL_CACHE) {
+			/* Only used by the result cache */
 		} else {
 			curl_easy_setopt(*curl, cur->key, cur->value);
 		}
@@ -729,6 +752,8 @@ static int acf_curl_helper(struct ast_channel *chan, struct curl_args *args)
 					while( (found = strsep(&failurecodestrings, ",")) != NULL) {
 						AST_VECTOR_APPEND(&hasfailurecode, atoi(found));
 					}
+				} else if (cur->key == CURLOPT_SPECIAL_CACHE) {
+					/* Only used by the result cache */
 				} else {
 					curl_easy_setopt(*curl, cur->key, cur->value);
 				}
@@ -753,8 +778,9 @@ static int acf_curl_helper(struct ast_channel *chan, struct curl_args *args)
 	curl_errbuf[0] = curl_errbuf[CURL_ERROR_SIZE] = '\0';
 	curl_easy_setopt(*curl, CURLOPT_ERRORBUFFER, curl_errbuf);
 
-	if (curl_easy_perform(*curl) != 0) {
+	if (ast_curl_perform(*curl) != CURLE_OK) {
 		ast_log(LOG_WARNING, "%s ('%s')\n", curl_errbuf, args->url);
+		args->failed = 1;
 	}
 
 	/* Reset buffer to NULL so curl doesn't try to write to it when the
@@ -821,9 +847,205 @@ static int acf_curl_helper(struct ast_channel *chan, struct curl_args *args)
 	return ret;
 }
 
+/*! \brief A cached result of a CURL() read */
+struct curl_cache_entry {
+	/*! Non-zero once the request is complete */
+	int done;
+	/*! The return value of the read */
+	int res;
+	/*! When the result stops being used */
+	struct timeval expires;
+	/*! The result */
+	char *value;
+	/*! The field names of a hashcompat result, if any */
+	char *fields;
+	/*! URL, POST data and the options the request was made with */
+	char key[0];
+};
+
+/*! Protects curl_cache and the state of the entries in it */
+AST_MUTEX_DEFINE_STATIC(curl_cache_lock);
+
+/*! Signalled when a request that others wait for completes */
+static ast_cond_t curl_cache_cond;
+
+/*! Cached results, and the requests in progress that fill them */
+static struct ao2_container *curl_cache;
+
+/*! When expired results were last removed */
+static struct timeval curl_cache_purged;
+
+AO2_STRING_FIELD_HASH_FN(curl_cache_entry, key);
+AO2_STRING_FIELD_CMP_FN(curl_cache_entry, key);
+
+static void curl_cache_entry_destroy(void *obj)
+{
+	struct curl_cache_entry *entry = obj;
+
+	ast_free(entry->value);
+	ast_free(entry->fields);
+}
+
+static int curl_cache_expired(void *obj, void *arg, int flags)
+{
+	struct curl_cache_entry *entry = obj;
+	struct timeval *now = arg;
+
+	return entry->done && ast_tvcmp(entry->expires, *now) <= 0 ? CMP_MATCH : 0;
+}
+
+static void curl_cache_settings_append(struct ast_str **key, struct curl_settings *cur,
+	long *cache_ms, int *hashcompat)
+{
+	if (cur->key == CURLOPT_SPECIAL_CACHE) {
+		*cache_ms = (long) cur->value;
+		return;
+	}
+	if (cur->key == CURLOPT_SPECIAL_HASHCOMPAT) {
+		*hashcompat = (long) cur->value;
+	}
+
+	/* String values are stored right behind the setting */
+	if (cur->value == (char *) cur + sizeof(*cur)) {
+		ast_str_append(key, 0, "%d:%s\n", (int) cur->key, (char *) cur->value);
+	} else {
+		ast_str_append(key, 0, "%d:%ld\n", (int) cur->key, (long) cur->value);
+	}
+}
+
+/*!
+ * \brief Build the cache key of a CURL() read
+ *
+ * The key is made of the URL, the POST data and every option the request
+ * would be made with, so reads only share results when they are identical.
+ *
+ * \return the number of milliseconds to cache the result, 0 if it is not cached
+ */
+static long curl_cache_key(struct ast_channel *chan, struct curl_args *args,
+	struct ast_str **key, int *hashcompat)
+{
+	struct ast_datastore *store = NULL;
+	struct curl_settings *cur;
+	long cache_ms = 0;
+
+	*hashcompat = 0;
+	ast_str_set(key, 0, "%s\n%s\n", args->url, S_OR(args->postdata, ""));
+
+	AST_LIST_LOCK(&global_curl_info);
+	AST_LIST_TRAVERSE(&global_curl_info, cur, list) {
+		curl_cache_settings_append(key, cur, &cache_ms, hashcompat);
+	}
+	AST_LIST_UNLOCK(&global_curl_info);
+
+	if (chan) {
+		ast_channel_lock(chan);
+		store = ast_channel_datastore_find(chan, &curl_info, NULL);
+		ast_channel_unlock(chan);
+	}
+	if (store) {
+		AST_LIST_HEAD(global_curl_info, curl_settings) *list = store->data;
+
+		AST_LIST_LOCK(list);
+		AST_LIST_TRAVERSE(list, cur, list) {
+			curl_cache_settings_append(key, cur, &cache_ms, hashcompat);
+		}
+		AST_LIST_UNLOCK(list);
+	}
+
+	return cache_ms;
+}
+
+/*!
+ * \brief Perform a CURL() read through the result cache
+ *
+ * Only one of a number of identical concurrent reads makes the request,
+ * the others wait for its result.  Failed transfers are handed to the
+ * readers waiting for them but are not kept.
+ */
+static int curl_cache_read(struct ast_channel *chan, struct curl_args *args,
+	const char *key, long cache_ms, int hashcompat)
+{
+	struct curl_cache_entry *entry;
+	struct timeval now = ast_tvnow();
+	int res;
+
+	ast_mutex_lock(&curl_cache_lock);
+	entry = ao2_find(curl_cache, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry && entry->done && ast_tvcmp(entry->expires, now) <= 0) {
+		ao2_unlink_flags(curl_cache, entry, OBJ_NOLOCK);
+		ao2_ref(entry, -1);
+		entry = NULL;
+	}
+
+	if (entry) {
+		if (!entry->done) {
+			ast_debug(3, "Waiting for CURL request in progress for '%s'\n", args->url);
+			if (chan) {
+				ast_autoservice_start(chan);
+			}
+			while (!entry->done) {
+				ast_cond_wait(&curl_cache_cond, &curl_cache_lock);
+			}
+			if (chan) {
+				ast_autoservice_stop(chan);
+			}
+		}
+		res = entry->res;
+		ast_str_set(&args->cb_data.str, 0, "%s", S_OR(entry->value, ""));
+		if (entry->fields) {
+			pbx_builtin_setvar_helper(chan, "~ODBCFIELDS~", entry->fields);
+		}
+		ast_mutex_unlock(&curl_cache_lock);
+		ao2_ref(entry, -1);
+		return res;
+	}
+
+	if (ast_tvdiff_ms(now, curl_cache_purged) >= 1000) {
+		ao2_callback(curl_cache, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK,
+			curl_cache_expired, &now);
+		curl_cache_purged = now;
+	}
+
+	if (ao2_container_count(curl_cache) < CURL_CACHE_MAX) {
+		entry = ao2_alloc_options(sizeof(*entry) + strlen(key) + 1,
+			curl_cache_entry_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (entry) {
+			strcpy(entry->key, key); /* Safe */
+			ao2_link_flags(curl_cache, entry, OBJ_NOLOCK);
+		}
+	}
+	ast_mutex_unlock(&curl_cache_lock);
+
+	res = acf_curl_helper(chan, args);
+
+	if (!entry) {
+		return res;
+	}
+
+	ast_mutex_lock(&curl_cache_lock);
+	entry->res = res;
+	entry->value = ast_strdup(ast_str_buffer(args->cb_data.str));
+	if (hashcompat && chan && ast_str_strlen(args->cb_data.str)) {
+		entry->fields = ast_strdup(pbx_builtin_getvar_helper(chan, "~ODBCFIELDS~"));
+	}
+	entry->expires = ast_tvadd(ast_tvnow(), ast_samp2tv(cache_ms, 1000));
+	entry->done = 1;
+	if (res || args->failed) {
+		ao2_unlink_flags(curl_cache, entry, OBJ_NOLOCK);
+	}
+	ast_cond_broadcast(&curl_cache_cond);
+	ast_mutex_unlock(&curl_cache_lock);
+	ao2_ref(entry, -1);
+
+	return res;
+}
+
 static int acf_curl_exec(struct ast_channel *chan, const char *cmd, char *info, struct ast_str **buf, ssize_t len)
 {
 	struct curl_args curl_params = { 0, };
+	struct ast_str *key;
+	long cache_ms;
+	int hashcompat;
 	int res;
 
 	AST_DECLARE_APP_ARGS(args,
@@ -845,7 +1067,20 @@ static int acf_curl_exec(struct ast_channel *chan, const char *cmd, char *info,
 		return -1;
 	}
 
-	res = acf_curl_helper(chan, &curl_params);
+	key = ast_str_create(128);
+	if (!key) {
+		ast_free(curl_params.cb_data.str);
+		return -1;
+	}
+
+	cache_ms = curl_cache_key(chan, &curl_params, &key, &hashcompat);
+	if (cache_ms > 0 && curl_cache) {
+		res = curl_cache_read(chan, &curl_params, ast_str_buffer(key), cache_ms, hashcompat);
+	} else {
+		res = acf_curl_helper(chan, &curl_params);
+	}
+	ast_free(key);
+
 	ast_str_set(buf, len, "%s", ast_str_buffer(curl_params.cb_data.str));
 	ast_free(curl_params.cb_data.str);
 
@@ -922,6 +1157,7 @@ static struct ast_custom_function acf_curlopt = {
 "  hashcompat     - Result data will be compatible for use with HASH()\n"
 "                 - if value is \"legacy\", will translate '+' to ' '\n"
 "  failurecodes   - A comma separated list of HTTP response codes to be treated as errors\n"
+"  cache          - Number of seconds to keep the results of reads [0]\n"
 "",
 	.read = acf_curlopt_read,
 	.read2 = acf_curlopt_read2,
@@ -987,6 +1223,10 @@ static int unload_module(void)
 
 	AST_TEST_UNREGISTER(vulnerable_url);
 
+	ao2_cleanup(curl_cache);
+	curl_cache = NULL;
+	ast_cond_destroy(&curl_cache_cond);
+
 	return res;
 }
 
@@ -994,6 +1234,14 @@ static int load_module(void)
 {
 	int res;
 
+	ast_cond_init(&curl_cache_cond, NULL);
+	curl_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, CURL_CACHE_BUCKETS,
+		curl_cache_entry_hash_fn, NULL, curl_cache_entry_cmp_fn);
+	if (!curl_cache) {
+		ast_cond_destroy(&curl_cache_cond);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	res = ast_custom_function_register_escalating(&acf_curl, AST_CFE_WRITE);
 	res |= ast_custom_function_register(&acf_curlopt);
 
@@ -149,6 +149,7 @@ static int set_hold_intercept(struct ast_channel *chan)
 		.version = AST_FRAMEHOOK_INTERFACE_VERSION,
 		.event_cb = hold_intercept_framehook,
 		.consume_cb = hold_intercept_framehook_consume,
+		.frame_types = AST_FRAMEHOOK_TYPE(AST_FRAME_CONTROL),
 		.disable_inheritance = 1,
 	};
 	SCOPED_CHANNELLOCK(chan_lock, chan);
@@ -121,6 +121,8 @@ struct acf_odbc_query {
 	unsigned int flags;
 	int rowlimit;
 	int minargs;
+	/*! Milliseconds to keep the results of reads, 0 to not cache them */
+	int cache_ms;
 	struct ast_custom_function *acf;
 };
 
@@ -158,6 +160,45 @@ struct dsn {
 
 struct ao2_container *dsns;
 
+/*! \brief Number of buckets in the container of cached results */
+#define ODBC_CACHE_BUCKETS 127
+
+/*! \brief Maximum number of results kept in the cache */
+#define ODBC_CACHE_MAX 10000
+
+/*! \brief A cached result of a read */
+struct odbc_cache_entry {
+	/*! Non-zero once the query is complete */
+	int done;
+	/*! Non-zero if the query failed and its result is not shared */
+	int failed;
+	/*! When the result stops being used */
+	struct timeval expires;
+	/*! The row read */
+	char *value;
+	/*! The values of ODBCROWS, ODBCSTATUS and ~ODBCFIELDS~ */
+	char *rows;
+	char *status;
+	char *fields;
+	/*! The function name and the SQL run */
+	char key[0];
+};
+
+/*! Protects odbc_cache and the state of the entries in it */
+AST_MUTEX_DEFINE_STATIC(odbc_cache_lock);
+
+/*! Signalled when a query that others wait for completes */
+static ast_cond_t odbc_cache_cond;
+
+/*! Cached results, and the queries in progress that fill them */
+static struct ao2_container *odbc_cache;
+
+/*! When expired results were last removed */
+static struct timeval odbc_cache_purged;
+
+AO2_STRING_FIELD_HASH_FN(odbc_cache_entry, key);
+AO2_STRING_FIELD_CMP_FN(odbc_cache_entry, key);
+
 static int dsn_hash(const void *obj, const int flags)
 {
 	const struct dsn *object;
@@ -722,125 +763,28 @@ static int acf_odbc_write(struct ast_channel *chan, const char *cmd, char *s, co
 	return 0;
 }
 
-static int acf_odbc_read(struct ast_channel *chan, const char *cmd, char *s, char *buf, size_t len)
+/*!
+ * \internal
+ * \brief Run the SQL of a read and return or store its rows
+ *
+ * \note The autoservice of chan, started by the caller, is stopped before
+ * returning.
+ */
+static int acf_odbc_read_sql(struct ast_channel *chan, const char *cmd, struct acf_odbc_query *query,
+	struct ast_str *sql, struct ast_str *colnames, struct odbc_datastore *resultset,
+	int rowlimit, int multirow, int escapecommas, int bogus_chan, char *buf, size_t len)
 {
 	struct odbc_obj *obj = NULL;
-	struct acf_odbc_query *query;
-	char varname[15], rowcount[12] = "-1";
-	struct ast_str *colnames = ast_str_thread_get(&colnames_buf, 16);
-	int res, x, y, buflen = 0, escapecommas, rowlimit = 1, multirow = 0, dsn_num, bogus_chan = 0;
-	AST_DECLARE_APP_ARGS(args,
-		AST_APP_ARG(field)[100];
-	);
+	char rowcount[12] = "-1";
+	int res, x, y, buflen = 0, dsn_num;
 	SQLHSTMT stmt = NULL;
 	SQLSMALLINT colcount=0;
 	SQLLEN indicator;
 	SQLSMALLINT collength;
-	struct odbc_datastore *resultset = NULL;
 	struct odbc_datastore_row *row = NULL;
-	struct ast_str *sql = ast_str_thread_get(&sql_buf, 16);
 	const char *status = "FAILURE";
 	struct dsn *dsn = NULL;
 
-	if (!sql || !colnames) {
-		if (chan) {
-			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
-		}
-		return -1;
-	}
-
-	ast_str_reset(colnames);
-
-	AST_RWLIST_RDLOCK(&queries);
-	AST_RWLIST_TRAVERSE(&queries, query, list) {
-		if (!strcmp(query->acf->name, cmd)) {
-			break;
-		}
-	}
-
-	if (!query) {
-		ast_log(LOG_ERROR, "No such function '%s'\n", cmd);
-		AST_RWLIST_UNLOCK(&queries);
-		if (chan) {
-			pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
-			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
-		}
-		return -1;
-	}
-
-	AST_STANDARD_APP_ARGS(args, s);
-	if (args.argc < query->minargs) {
-		ast_log(LOG_ERROR, "%d arguments supplied to '%s' requiring minimum %d\n",
-				args.argc, cmd, query->minargs);
-		AST_RWLIST_UNLOCK(&queries);
-		return -1;
-	}
-
-	if (!chan) {
-		if (!(chan = ast_dummy_channel_alloc())) {
-			AST_RWLIST_UNLOCK(&queries);
-			return -1;
-		}
-		bogus_chan = 1;
-	}
-
-	if (!bogus_chan) {
-		ast_autoservice_start(chan);
-	}
-
-	snprintf(varname, sizeof(varname), "%u", args.argc);
-	pbx_builtin_pushvar_helper(chan, "ARGC", varname);
-	for (x = 0; x < args.argc; x++) {
-		snprintf(varname, sizeof(varname), "ARG%d", x + 1);
-		pbx_builtin_pushvar_helper(chan, varname, args.field[x]);
-	}
-
-	ast_str_substitute_variables(&sql, 0, chan, query->sql_read);
-
-	if (bogus_chan) {
-		chan = ast_channel_unref(chan);
-	} else {
-		/* Restore prior values */
-		pbx_builtin_setvar_helper(chan, "ARGC", NULL);
-
-		for (x = 0; x < args.argc; x++) {
-			snprintf(varname, sizeof(varname), "ARG%d", x + 1);
-			pbx_builtin_setvar_helper(chan, varname, NULL);
-		}
-	}
-
-	/* Save these flags, so we can release the lock */
-	escapecommas = ast_test_flag(query, OPT_ESCAPECOMMAS);
-	if (!bogus_chan && ast_test_flag(query, OPT_MULTIROW)) {
-		if (!(resultset = ast_calloc(1, sizeof(*resultset)))) {
-			pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
-			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
-			AST_RWLIST_UNLOCK(&queries);
-			ast_autoservice_stop(chan);
-			return -1;
-		}
-		AST_LIST_HEAD_INIT(resultset);
-		if (query->rowlimit) {
-			rowlimit = query->rowlimit;
-		} else {
-			rowlimit = INT_MAX;
-		}
-		multirow = 1;
-	} else if (!bogus_chan) {
-		if (query->rowlimit > 1) {
-			rowlimit = query->rowlimit;
-			if (!(resultset = ast_calloc(1, sizeof(*resultset)))) {
-				pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
-				pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
-				AST_RWLIST_UNLOCK(&queries);
-				ast_autoservice_stop(chan);
-				return -1;
-			}
-			AST_LIST_HEAD_INIT(resultset);
-		}
-	}
-	AST_RWLIST_UNLOCK(&queries);
-
 	for (dsn_num = 0; dsn_num < 5; dsn_num++) {
 		if (!ast_strlen_zero(query->readhandle[dsn_num])) {
 			obj = get_odbc_obj(query->readhandle[dsn_num], &dsn);
@@ -1102,6 +1046,282 @@ end_acf_read:
 	return 0;
 }
 
+static void odbc_cache_entry_destroy(void *obj)
+{
+	struct odbc_cache_entry *entry = obj;
+
+	ast_free(entry->value);
+	ast_free(entry->rows);
+	ast_free(entry->status);
+	ast_free(entry->fields);
+}
+
+static int odbc_cache_expired(void *obj, void *arg, int flags)
+{
+	struct odbc_cache_entry *entry = obj;
+	struct timeval *now = arg;
+
+	return entry->done && ast_tvcmp(entry->expires, *now) <= 0 ? CMP_MATCH : 0;
+}
+
+/*!
+ * \internal
+ * \brief Keep the result of a read in its cache entry
+ *
+ * \retval 0 if the result can be shared
+ * \retval -1 if it cannot
+ */
+static int odbc_cache_store(struct ast_channel *chan, struct odbc_cache_entry *entry,
+	int res, const char *buf)
+{
+	const char *status;
+
+	if (res) {
+		return -1;
+	}
+
+	ast_channel_lock(chan);
+	status = pbx_builtin_getvar_helper(chan, "ODBCSTATUS");
+	if (!status || (strcmp(status, "SUCCESS") && strcmp(status, "NODATA"))) {
+		ast_channel_unlock(chan);
+		return -1;
+	}
+	entry->status = ast_strdup(status);
+	entry->rows = ast_strdup(pbx_builtin_getvar_helper(chan, "ODBCROWS"));
+	if (!strcmp(status, "SUCCESS")) {
+		entry->fields = ast_strdup(pbx_builtin_getvar_helper(chan, "~ODBCFIELDS~"));
+	}
+	ast_channel_unlock(chan);
+
+	entry->value = ast_strdup(buf);
+
+	return entry->status && entry->rows && entry->value ? 0 : -1;
+}
+
+/*!
+ * \internal
+ * \brief Read through the result cache of a function
+ *
+ * Reads of a function with the same SQL share one result for the cache time
+ * of the function.  Only one of a number of identical concurrent reads runs
+ * the query, the others wait for its result.  If the query fails the
+ * waiting reads run it themselves.
+ *
+ * \note Only used for reads returning a single row on a channel.  The
+ * autoservice of chan is started, and is stopped before returning.
+ */
+static int odbc_cache_read(struct ast_channel *chan, const char *cmd, struct acf_odbc_query *query,
+	struct ast_str *sql, struct ast_str *colnames, int escapecommas, int cache_ms,
+	char *buf, size_t len)
+{
+	struct odbc_cache_entry *entry;
+	struct timeval now = ast_tvnow();
+	size_t key_len = strlen(cmd) + 1 + ast_str_strlen(sql) + 1;
+	char *key = ast_alloca(key_len);
+	int res;
+
+	snprintf(key, key_len, "%s\n%s", cmd, ast_str_buffer(sql));
+
+	ast_mutex_lock(&odbc_cache_lock);
+	entry = ao2_find(odbc_cache, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry && entry->done && ast_tvcmp(entry->expires, now) <= 0) {
+		ao2_unlink_flags(odbc_cache, entry, OBJ_NOLOCK);
+		ao2_ref(entry, -1);
+		entry = NULL;
+	}
+
+	if (entry) {
+		while (!entry->done) {
+			ast_cond_wait(&odbc_cache_cond, &odbc_cache_lock);
+		}
+		if (!entry->failed) {
+			ast_copy_string(buf, entry->value, len);
+			pbx_builtin_setvar_helper(chan, "ODBCROWS", entry->rows);
+			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", entry->status);
+			if (entry->fields) {
+				pbx_builtin_setvar_helper(chan, "~ODBCFIELDS~", entry->fields);
+			}
+			ast_mutex_unlock(&odbc_cache_lock);
+			ao2_ref(entry, -1);
+			ast_autoservice_stop(chan);
+			return 0;
+		}
+		ast_mutex_unlock(&odbc_cache_lock);
+		ao2_ref(entry, -1);
+
+		return acf_odbc_read_sql(chan, cmd, query, sql, colnames, NULL, 1, 0,
+			escapecommas, 0, buf, len);
+	}
+
+	if (ast_tvdiff_ms(now, odbc_cache_purged) >= 1000) {
+		ao2_callback(odbc_cache, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK,
+			odbc_cache_expired, &now);
+		odbc_cache_purged = now;
+	}
+
+	if (ao2_container_count(odbc_cache) < ODBC_CACHE_MAX) {
+		entry = ao2_alloc_options(sizeof(*entry) + key_len, odbc_cache_entry_destroy,
+			AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (entry) {
+			strcpy(entry->key, key); /* Safe */
+			ao2_link_flags(odbc_cache, entry, OBJ_NOLOCK);
+		}
+	}
+	ast_mutex_unlock(&odbc_cache_lock);
+
+	res = acf_odbc_read_sql(chan, cmd, query, sql, colnames, NULL, 1, 0,
+		escapecommas, 0, buf, len);
+
+	if (!entry) {
+		return res;
+	}
+
+	ast_mutex_lock(&odbc_cache_lock);
+	if (odbc_cache_store(chan, entry, res, buf)) {
+		entry->failed = 1;
+		ao2_unlink_flags(odbc_cache, entry, OBJ_NOLOCK);
+	}
+	entry->expires = ast_tvadd(ast_tvnow(), ast_samp2tv(cache_ms, 1000));
+	entry->done = 1;
+	ast_cond_broadcast(&odbc_cache_cond);
+	ast_mutex_unlock(&odbc_cache_lock);
+	ao2_ref(entry, -1);
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Drop every cached result
+ */
+static void odbc_cache_flush(void)
+{
+	ast_mutex_lock(&odbc_cache_lock);
+	ao2_callback(odbc_cache, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK, NULL, NULL);
+	ast_mutex_unlock(&odbc_cache_lock);
+}
+
+static int acf_odbc_read(struct ast_channel *chan, const char *cmd, char *s, char *buf, size_t len)
+{
+	struct acf_odbc_query *query;
+	char varname[15], rowcount[12] = "-1";
+	struct ast_str *colnames = ast_str_thread_get(&colnames_buf, 16);
+	int x, escapecommas, rowlimit = 1, multirow = 0, bogus_chan = 0, cache_ms;
+	AST_DECLARE_APP_ARGS(args,
+		AST_APP_ARG(field)[100];
+	);
+	struct odbc_datastore *resultset = NULL;
+	struct ast_str *sql = ast_str_thread_get(&sql_buf, 16);
+	const char *status = "FAILURE";
+
+	if (!sql || !colnames) {
+		if (chan) {
+			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
+		}
+		return -1;
+	}
+
+	ast_str_reset(colnames);
+
+	AST_RWLIST_RDLOCK(&queries);
+	AST_RWLIST_TRAVERSE(&queries, query, list) {
+		if (!strcmp(query->acf->name, cmd)) {
+			break;
+		}
+	}
+
+	if (!query) {
+		ast_log(LOG_ERROR, "No such function '%s'\n", cmd);
+		AST_RWLIST_UNLOCK(&queries);
+		if (chan) {
+			pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
+			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
+		}
+		return -1;
+	}
+
+	AST_STANDARD_APP_ARGS(args, s);
+	if (args.argc < query->minargs) {
+		ast_log(LOG_ERROR, "%d arguments supplied to '%s' requiring minimum %d\n",
+				args.argc, cmd, query->minargs);
+		AST_RWLIST_UNLOCK(&queries);
+		return -1;
+	}
+
+	if (!chan) {
+		if (!(chan = ast_dummy_channel_alloc())) {
+			AST_RWLIST_UNLOCK(&queries);
+			return -1;
+		}
+		bogus_chan = 1;
+	}
+
+	if (!bogus_chan) {
+		ast_autoservice_start(chan);
+	}
+
+	snprintf(varname, sizeof(varname), "%u", args.argc);
+	pbx_builtin_pushvar_helper(chan, "ARGC", varname);
+	for (x = 0; x < args.argc; x++) {
+		snprintf(varname, sizeof(varname), "ARG%d", x + 1);
+		pbx_builtin_pushvar_helper(chan, varname, args.field[x]);
+	}
+
+	ast_str_substitute_variables(&sql, 0, chan, query->sql_read);
+
+	if (bogus_chan) {
+		chan = ast_channel_unref(chan);
+	} else {
+		/* Restore prior values */
+		pbx_builtin_setvar_helper(chan, "ARGC", NULL);
+
+		for (x = 0; x < args.argc; x++) {
+			snprintf(varname, sizeof(varname), "ARG%d", x + 1);
+			pbx_builtin_setvar_helper(chan, varname, NULL);
+		}
+	}
+
+	/* Save these flags, so we can release the lock */
+	escapecommas = ast_test_flag(query, OPT_ESCAPECOMMAS);
+	cache_ms = query->cache_ms;
+	if (!bogus_chan && ast_test_flag(query, OPT_MULTIROW)) {
+		if (!(resultset = ast_calloc(1, sizeof(*resultset)))) {
+			pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
+			pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
+			AST_RWLIST_UNLOCK(&queries);
+			ast_autoservice_stop(chan);
+			return -1;
+		}
+		AST_LIST_HEAD_INIT(resultset);
+		if (query->rowlimit) {
+			rowlimit = query->rowlimit;
+		} else {
+			rowlimit = INT_MAX;
+		}
+		multirow = 1;
+	} else if (!bogus_chan) {
+		if (query->rowlimit > 1) {
+			rowlimit = query->rowlimit;
+			if (!(resultset = ast_calloc(1, sizeof(*resultset)))) {
+				pbx_builtin_setvar_helper(chan, "ODBCROWS", rowcount);
+				pbx_builtin_setvar_helper(chan, "ODBCSTATUS", status);
+				AST_RWLIST_UNLOCK(&queries);
+				ast_autoservice_stop(chan);
+				return -1;
+			}
+			AST_LIST_HEAD_INIT(resultset);
+		}
+	}
+	AST_RWLIST_UNLOCK(&queries);
+
+	if (cache_ms && !resultset && !bogus_chan) {
+		return odbc_cache_read(chan, cmd, query, sql, colnames, escapecommas, cache_ms, buf, len);
+	}
+
+	return acf_odbc_read_sql(chan, cmd, query, sql, colnames, resultset, rowlimit, multirow,
+		escapecommas, bogus_chan, buf, len);
+}
+
 static int acf_escape(struct ast_channel *chan, const char *cmd, char *data, char *buf, size_t len)
 {
 	char *out = buf;
@@ -1317,6 +1537,18 @@ static int init_acf_query(struct ast_config *cfg, char *catg, struct acf_odbc_qu
 		sscanf(tmp, "%30d", &((*query)->minargs));
 	}
 
+	if ((tmp = ast_variable_retrieve(cfg, catg, "cache"))) {
+		double cache;
+
+		if (sscanf(tmp, "%30lf", &cache) != 1 || cache < 0) {
+			ast_log(LOG_WARNING, "Invalid cache time '%s' for category %s\n", tmp, catg);
+		} else if (ast_test_flag((*query), OPT_MULTIROW) || (*query)->rowlimit > 1) {
+			ast_log(LOG_WARNING, "Results of %s cannot be cached, they are more than one row\n", catg);
+		} else {
+			(*query)->cache_ms = cache * 1000;
+		}
+	}
+
 	(*query)->acf = ast_calloc(1, sizeof(struct ast_custom_function));
 	if (!(*query)->acf) {
 		free_acf_query(*query);
@@ -1803,6 +2035,14 @@ static int load_module(void)
 	const char *s;
 	struct ast_flags config_flags = { 0 };
 
+	ast_cond_init(&odbc_cache_cond, NULL);
+	odbc_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, ODBC_CACHE_BUCKETS,
+		odbc_cache_entry_hash_fn, NULL, odbc_cache_entry_cmp_fn);
+	if (!odbc_cache) {
+		ast_cond_destroy(&odbc_cache_cond);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	res |= ast_custom_function_register(&fetch_function);
 	res |= ast_register_application_xml(app_odbcfinish, exec_odbcfinish);
 
@@ -1891,6 +2131,11 @@ static int unload_module(void)
 	if (dsns) {
 		ao2_ref(dsns, -1);
 	}
+
+	ao2_cleanup(odbc_cache);
+	odbc_cache = NULL;
+	ast_cond_destroy(&odbc_cache_cond);
+
 	return res;
 }
 
@@ -1939,6 +2184,9 @@ static int reload(void)
 		free_acf_query(oldquery);
 	}
 
+	/* The functions or their connections may have changed */
+	odbc_cache_flush();
+
 	if (!cfg) {
 		ast_log(LOG_WARNING, "Unable to load config for func_odbc: %s\n", config);
 		goto reload_out;
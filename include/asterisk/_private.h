@@ -56,6 +56,12 @@ int ast_msg_init(void);             /*!< Provided by message.c */
 void ast_msg_shutdown(void);        /*!< Provided by message.c */
 int aco_init(void);             /*!< Provided by config_options.c */
 int dns_core_init(void);        /*!< Provided by dns_core.c */
+int ast_slinear_mix_init(void); /*!< Provided by slinear_mix.c */
+int ast_g711_init(void);        /*!< Provided by g711.c */
+int ast_trace_ring_init(void);  /*!< Provided by trace_ring.c */
+int ast_histogram_init(void);   /*!< Provided by histogram.c */
+int ast_overload_init(void);    /*!< Provided by overload.c */
+int ast_uring_init(void);       /*!< Provided by uring.c */
 
 /*!
  * \brief Initialize malloc debug phase 1.
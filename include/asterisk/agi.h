@@ -36,6 +36,7 @@ typedef struct agi_state {
 	int audio;	        /*!< FD for audio output */
 	int ctrl;		/*!< FD for input control */
 	unsigned int fast:1;    /*!< flag for fast agi or not */
+	unsigned int pooled:1;  /*!< flag for a fast agi connection kept open between sessions */
 	struct ast_speech *speech; /*!< Speech structure for speech recognition */
 } AGI;
 
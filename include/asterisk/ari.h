@@ -102,6 +102,8 @@ struct ast_ari_response {
 	const char *response_text; /* Shouldn't http.c handle this? */
 	/*! Flag to indicate that no further response is needed */
 	unsigned int no_response:1;
+	/*! Compact JSON encoding sent instead of \a message, if set */
+	struct ast_str *body;
 };
 
 /*!
@@ -124,10 +126,10 @@ int ast_ari_remove_handler(struct stasis_rest_handlers *handler);
  * \internal
  * \brief Stasis RESTful invocation handler.
  *
- * Only call from res_ari and test_ari. Only public to allow
- * for unit testing.
+ * Only call from res_ari, res_ari_bulk and test_ari. Only public to
+ * allow for unit testing and bulk operations.
  *
- * \param ser TCP/TLS connection.
+ * \param ser TCP/TLS connection, NULL for an operation of a bulk request.
  * \param uri HTTP URI, relative to the API path.
  * \param method HTTP method.
  * \param get_params HTTP \c GET parameters.
@@ -180,9 +182,29 @@ struct ast_ari_websocket_session *ast_ari_websocket_session_create(
 struct ast_json *ast_ari_websocket_session_read(
 	struct ast_ari_websocket_session *session);
 
+/*! \brief Encodings a message can be sent to an ARI WebSocket in. */
+enum ast_ari_websocket_encoding {
+	/*! JSON in a text frame */
+	AST_ARI_WEBSOCKET_ENCODING_JSON,
+	/*! MessagePack in a binary frame */
+	AST_ARI_WEBSOCKET_ENCODING_MSGPACK,
+};
+
+/*!
+ * \brief Set the encoding of messages written to an ARI WebSocket.
+ * \since 19.0.0
+ *
+ * \param session Session to update.
+ * \param encoding Encoding used by ast_ari_websocket_session_write().
+ */
+void ast_ari_websocket_session_set_encoding(struct ast_ari_websocket_session *session,
+	enum ast_ari_websocket_encoding encoding);
+
 /*!
  * \brief Send a message to an ARI WebSocket.
  *
+ * A JSON array is sent as a batch, several messages in one frame.
+ *
  * \param session Session to write to.
  * \param message Message to send.
  * \return 0 on success.
@@ -242,6 +264,20 @@ __attribute__((format(printf, 4, 5)));
 void ast_ari_response_ok(struct ast_ari_response *response,
 			     struct ast_json *message);
 
+/*!
+ * \brief Fill in an \c OK (200) \a ast_ari_response with an encoded body.
+ * \since 19.0.0
+ *
+ * The body, written with an \ref ast_json_writer, is sent as is unless
+ * pretty printing is configured. In developer mode it is also parsed into
+ * the response message, so it can be validated.
+ *
+ * \param response Response to fill in.
+ * \param body Compact JSON encoding of the response. This is stolen.
+ */
+void ast_ari_response_ok_body(struct ast_ari_response *response,
+	struct ast_str *body);
+
 /*!
  * \brief Fill in a <tt>No Content</tt> (204) \a ast_ari_response.
  */
@@ -268,4 +304,65 @@ void ast_ari_response_created(struct ast_ari_response *response,
  */
 void ast_ari_response_alloc_failed(struct ast_ari_response *response);
 
+/*!
+ * \brief One page of a listing, ordered by id.
+ *
+ * Objects are offered one at a time while iterating a container, and
+ * only those that belong on the page are kept, so a page never holds
+ * more than its limit of objects.
+ *
+ * \since 19.0.0
+ */
+struct ast_ari_page;
+
+/*!
+ * \brief Start selecting a page.
+ *
+ * \param after Only ids sorting after this one are kept, NULL for the first page.
+ * \param limit Most objects on the page, 0 for no limit.
+ * \return The page, to be freed with ast_ari_page_free().
+ * \retval NULL on allocation failure.
+ *
+ * \since 19.0.0
+ */
+struct ast_ari_page *ast_ari_page_alloc(const char *after, int limit);
+
+/*!
+ * \brief Offer an object to a page.
+ *
+ * \param page The page.
+ * \param id Id of the object, which must stay valid while the object does.
+ * \param obj The ao2 object, which the page holds a reference to if kept.
+ * \retval 0 on success, whether or not the object was kept.
+ * \retval -1 on allocation failure.
+ *
+ * \since 19.0.0
+ */
+int ast_ari_page_offer(struct ast_ari_page *page, const char *id, void *obj);
+
+/*!
+ * \brief Number of objects on a page.
+ *
+ * \since 19.0.0
+ */
+size_t ast_ari_page_count(const struct ast_ari_page *page);
+
+/*!
+ * \brief Get an object from a page, in id order.
+ *
+ * \param page The page.
+ * \param idx Index of the object, below ast_ari_page_count().
+ * \return The object, without a reference added.
+ *
+ * \since 19.0.0
+ */
+void *ast_ari_page_get(const struct ast_ari_page *page, size_t idx);
+
+/*!
+ * \brief Free a page, dropping its references to the objects on it.
+ *
+ * \since 19.0.0
+ */
+void ast_ari_page_free(struct ast_ari_page *page);
+
 #endif /* _ASTERISK_ARI_H */
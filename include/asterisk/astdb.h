@@ -96,6 +96,81 @@ struct ast_db_entry *ast_db_gettree_by_prefix(const char *family, const char *ke
 /*! \brief Free structure created by ast_db_gettree() */
 void ast_db_freetree(struct ast_db_entry *entry);
 
+struct stasis_topic;
+struct stasis_message_type;
+
+/*! \brief Kinds of changes to the database */
+enum ast_db_change_op {
+	/*! A key was set */
+	AST_DB_CHANGE_PUT,
+	/*! A key was deleted */
+	AST_DB_CHANGE_DEL,
+	/*! A key tree was deleted */
+	AST_DB_CHANGE_DELTREE,
+};
+
+/*!
+ * \brief A change to a published family, the data of ast_db_change_type() messages
+ * \since 19.0.0
+ */
+struct ast_db_change {
+	enum ast_db_change_op op;
+	/*! The family changed */
+	const char *family;
+	/*! The key or, for AST_DB_CHANGE_DELTREE, the key tree, may be empty */
+	const char *key;
+	/*! The value put, NULL unless AST_DB_CHANGE_PUT */
+	const char *value;
+	/*! Storage for the strings */
+	char data[0];
+};
+
+/*!
+ * \brief Topic the changes of published families are published to
+ * \since 19.0.0
+ */
+struct stasis_topic *ast_db_topic(void);
+
+/*!
+ * \brief Message type of the changes of published families
+ * \since 19.0.0
+ */
+struct stasis_message_type *ast_db_change_type(void);
+
+/*!
+ * \brief Publish the changes to a family and the families below it.
+ * \since 19.0.0
+ *
+ * \param family The family, e.g. "registrar" for every sorcery object
+ *        stored in the database by the PJSIP registrar
+ * \param publish Non-zero to start publishing, zero to stop
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int ast_db_family_publish(const char *family, int publish);
+
+/*!
+ * \brief Publish a put for every key of a family.
+ * \since 19.0.0
+ *
+ * Used to bring a peer that just joined up to date with a published family.
+ *
+ * \param family The family
+ */
+void ast_db_family_announce(const char *family);
+
+/*!
+ * \brief Apply a change made to the database of another server.
+ * \since 19.0.0
+ *
+ * The change is made without being published again.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int ast_db_change_apply(const struct ast_db_change *change);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
@@ -378,6 +378,13 @@ enum ao2_alloc_opts {
 	AO2_ALLOC_OPT_LOCK_OBJ = AO2_ALLOC_OPT_LOCK_MASK,
 	/*! The ao2 object will not record any REF_DEBUG entries */
 	AO2_ALLOC_OPT_NO_REF_DEBUG = (1 << 2),
+	/*!
+	 * The ao2 object is allocated from a pool of fixed size blocks.
+	 *
+	 * \note Intended for small objects allocated and released at high
+	 * rates.  Objects too large for the pools are allocated normally.
+	 */
+	AO2_ALLOC_OPT_POOL = (1 << 3),
 };
 
 /*!
@@ -927,6 +934,125 @@ int __ao2_global_obj_replace_unref(struct ao2_global_obj *holder, void *obj, con
 
 void *__ao2_global_obj_ref(struct ao2_global_obj *holder, const char *tag, const char *file, int line, const char *func, const char *name) attribute_warn_unused_result;
 
+/*!
+ * \brief Read-copy-update ao2 object holder structure.
+ * \since 19.0.0
+ *
+ * \details
+ * An RCU holder publishes a read-mostly ao2 object, usually a
+ * container, to readers that never lock.  A writer builds a new
+ * version of the object, typically by cloning and modifying the
+ * current one, and replaces the held object with it.  The
+ * replacement waits until every reader that could still see the
+ * old version is done with it before the holder's reference to the
+ * old version is given back.
+ *
+ * \note A published object must not be modified.  Containers
+ * published in an RCU holder should be allocated with
+ * AO2_ALLOC_OPT_LOCK_NOLOCK.
+ */
+struct ao2_rcu_obj {
+	/*! Serializes replacing the held ao2 object. */
+	ast_mutex_t lock;
+	/*! RCU protected ao2 object. */
+	void *obj;
+	/*! Number of readers active in each grace period phase. */
+	int readers[2];
+	/*! Grace period phase new readers register in. */
+	unsigned int phase;
+};
+
+/*!
+ * \brief Define an RCU object holder, statically initialized.
+ * \since 19.0.0
+ *
+ * \param name This will be the name of the object holder.
+ *
+ * \note A holder embedded in another structure must have its
+ * lock initialized with ast_mutex_init() instead.
+ */
+#define AO2_RCU_OBJ_STATIC(name)		\
+	struct ao2_rcu_obj name = {			\
+		.lock = AST_MUTEX_INIT_VALUE,	\
+	}
+
+/*!
+ * \brief Release the ao2 object held in the RCU holder.
+ * \since 19.0.0
+ *
+ * \param holder RCU ao2 object holder.
+ * \param tag used for debugging
+ *
+ * \return Nothing
+ */
+#define ao2_t_rcu_obj_release(holder, tag)	\
+	__ao2_rcu_obj_replace_unref(&holder, NULL, (tag), __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+#define ao2_rcu_obj_release(holder)	\
+	__ao2_rcu_obj_replace_unref(&holder, NULL, NULL, __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+
+/*!
+ * \brief Publish a new version of the ao2 object in the RCU holder.
+ * \since 19.0.0
+ *
+ * \param holder RCU ao2 object holder.
+ * \param obj Object to put into the holder.  Can be NULL.
+ * \param tag used for debugging
+ *
+ * \note This function automatically increases the reference
+ * count to account for the reference that the holder now holds
+ * to the object.
+ *
+ * \note Returns only once no reader can still be using the
+ * previous object without its own reference.  Must not be called
+ * by a thread reading from the same holder.
+ *
+ * \retval Reference to previous ao2 object stored.
+ * \retval NULL if no object available.
+ */
+#define ao2_t_rcu_obj_replace(holder, obj, tag)	\
+	__ao2_rcu_obj_replace(&holder, (obj), (tag), __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+#define ao2_rcu_obj_replace(holder, obj)	\
+	__ao2_rcu_obj_replace(&holder, (obj), NULL, __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+
+void *__ao2_rcu_obj_replace(struct ao2_rcu_obj *holder, void *obj, const char *tag, const char *file, int line, const char *func, const char *name) attribute_warn_unused_result;
+
+/*!
+ * \brief Publish a new version of the ao2 object in the RCU holder, throwing away any old object.
+ * \since 19.0.0
+ *
+ * \param holder RCU ao2 object holder.
+ * \param obj Object to put into the holder.  Can be NULL.
+ * \param tag used for debugging
+ *
+ * \retval 0 The holder was previously empty
+ * \retval 1 The holder was not previously empty
+ */
+#define ao2_t_rcu_obj_replace_unref(holder, obj, tag)	\
+	__ao2_rcu_obj_replace_unref(&holder, (obj), (tag), __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+#define ao2_rcu_obj_replace_unref(holder, obj)	\
+	__ao2_rcu_obj_replace_unref(&holder, (obj), NULL, __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+
+int __ao2_rcu_obj_replace_unref(struct ao2_rcu_obj *holder, void *obj, const char *tag, const char *file, int line, const char *func, const char *name);
+
+/*!
+ * \brief Get a reference to the object stored in the RCU holder.
+ * \since 19.0.0
+ *
+ * \param holder RCU ao2 object holder.
+ * \param tag used for debugging
+ *
+ * \note No lock is taken.
+ *
+ * \retval Reference to current ao2 object stored in the holder.
+ * \retval NULL if no object available.
+ */
+#define ao2_t_rcu_obj_ref(holder, tag)	\
+	__ao2_rcu_obj_ref(&holder, (tag), __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+#define ao2_rcu_obj_ref(holder)	\
+	__ao2_rcu_obj_ref(&holder, NULL, __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+
+void *__ao2_rcu_obj_ref(struct ao2_rcu_obj *holder, const char *tag, const char *file, int line, const char *func, const char *name) attribute_warn_unused_result;
+
 
 /*!
  \page AstObj2_Containers AstObj2 Containers
@@ -1213,6 +1339,30 @@ enum ao2_container_opts {
 	 * ao2_sort_fn.
 	 */
 	AO2_CONTAINER_ALLOC_OPT_DUPS_REPLACE = (3 << 1),
+	/*!
+	 * \brief Lock hash buckets in groups instead of the whole container.
+	 * \since 19.0.0
+	 *
+	 * \details Keyed operations (OBJ_SEARCH_OBJECT and OBJ_SEARCH_KEY
+	 * finds, links and unlinks) hold the container read lock and lock
+	 * only the stripe covering the object's hash bucket.  Operations
+	 * on different stripes proceed in parallel.  Callbacks that scan
+	 * the whole container lock every stripe and iterators take the
+	 * container write lock so they still see a consistent view.
+	 *
+	 * \note Only hash containers allocated with
+	 * AO2_ALLOC_OPT_LOCK_RWLOCK honor the option.  It is ignored
+	 * otherwise.
+	 *
+	 * \note An AO2_ITERATOR_DONTLOCK iterator of a striped container
+	 * must be used while holding the container write lock.
+	 *
+	 * \note A callback may link or unlink objects with OBJ_NOLOCK.
+	 * The stripes held by the traversal are released while the stripe
+	 * of the object is write locked, the same as a read locked
+	 * container is promoted to a write lock.
+	 */
+	AO2_CONTAINER_ALLOC_OPT_STRIPED = (1 << 3),
 };
 
 /*!
@@ -1770,6 +1920,29 @@ void *__ao2_find(struct ao2_container *c, const void *arg, enum search_flags fla
 void *__ao2_weakproxy_find(struct ao2_container *c, const void *arg, enum search_flags flags,
 	const char *tag, const char *file, int line, const char *func);
 
+/*!
+ * \brief Find an object in the container stored in the RCU holder.
+ * \since 19.0.0
+ *
+ * \param holder RCU ao2 object holder containing an ao2 container.
+ * \param arg Search argument passed to ao2_find().
+ * \param flags search_flags passed to ao2_find().  OBJ_UNLINK is not allowed.
+ * \param tag used for debugging
+ *
+ * \details
+ * The lookup neither locks nor takes a reference to the held
+ * container.  Only the found object is referenced.
+ *
+ * \retval Reference to the found object.
+ * \retval NULL if not found or the holder is empty.
+ */
+#define ao2_t_rcu_obj_find(holder, arg, flags, tag)	\
+	__ao2_rcu_obj_find(&holder, (arg), (flags), (tag), __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+#define ao2_rcu_obj_find(holder, arg, flags)	\
+	__ao2_rcu_obj_find(&holder, (arg), (flags), NULL, __FILE__, __LINE__, __PRETTY_FUNCTION__, #holder)
+
+void *__ao2_rcu_obj_find(struct ao2_rcu_obj *holder, const void *arg, enum search_flags flags, const char *tag, const char *file, int line, const char *func, const char *name) attribute_warn_unused_result;
+
 /*! \brief
  *
  *
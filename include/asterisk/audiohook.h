@@ -244,6 +244,19 @@ int ast_audiohook_remove(struct ast_channel *chan, struct ast_audiohook *audioho
  */
 int ast_audiohook_write_list_empty(struct ast_audiohook_list *audiohook_list);
 
+/*!
+ * \brief Determine if an audiohook_list only has spies on it.
+ * \since 19.0.0
+ *
+ * \param audiohook_list List to check.  (NULL also means spies only)
+ *
+ * Spies never modify the frames written to the list, so a frame with a
+ * payload shared by ast_frshare() can be written to such a list as is.
+ *
+ * retval 0 false, 1 true
+ */
+int ast_audiohook_write_list_spies_only(struct ast_audiohook_list *audiohook_list);
+
 /*! \brief Pass a frame off to be handled by the audiohook core
  * \param chan Channel that the list is coming off of
  * \param audiohook_list List of audiohooks
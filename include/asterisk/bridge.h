@@ -312,6 +312,13 @@ struct ast_bridge_softmix {
 	 * \note If this value is 0, there is no maximum sample rate.
 	 */
 	unsigned int maximum_sample_rate;
+	/*!
+	 * \brief The number of threads softmix may use to write mixed audio
+	 * out to participants.
+	 *
+	 * \note If this value is 0 or 1, the mixing thread does all the work.
+	 */
+	unsigned int mixing_threads;
 };
 
 AST_LIST_HEAD_NOLOCK(ast_bridge_channels_list, ast_bridge_channel);
@@ -345,12 +352,32 @@ struct ast_bridge_snapshot {
 	unsigned int num_channels;
 	/*! Number of active channels in the bridge. */
 	unsigned int num_active;
+	/*! Number of times the bridge has switched bridge technology */
+	unsigned int technology_swaps;
 	/*! The video mode of the bridge */
 	enum ast_bridge_video_mode_type video_mode;
 	/*! The time of bridge creation */
 	struct timeval creationtime;
 };
 
+/*!
+ * \brief What the technology of a smart bridge was last chosen with
+ *
+ * The technology is only chosen again when one of these changes.
+ */
+struct ast_bridge_technology_choice {
+	/*! Bridge technology capabilities that were wanted */
+	uint32_t capabilities;
+	/*! Technology version of the bridge */
+	unsigned int version;
+	/*! Sum of the unbridged generations of the channels in the bridge */
+	unsigned int media_generation;
+	/*! Generation of the registered bridge technologies */
+	unsigned int technologies_generation;
+	/*! TRUE if a technology was chosen with the above */
+	unsigned int valid:1;
+};
+
 /*!
  * \brief Structure that contains information about a bridge
  */
@@ -392,6 +419,17 @@ struct ast_bridge {
 	unsigned int inhibit_merge;
 	/*! Cause code of the dissolved bridge. */
 	int cause;
+	/*!
+	 * \brief Bumped when channels join, leave or answer.
+	 * \since 19.0.0
+	 *
+	 * \note Any of those can change the best technology of a smart bridge.
+	 */
+	unsigned int technology_version;
+	/*! What the current technology of a smart bridge was chosen with. */
+	struct ast_bridge_technology_choice technology_choice;
+	/*! Number of times the bridge has switched bridge technology. */
+	unsigned int technology_swaps;
 	/*! TRUE if the bridge was reconfigured. */
 	unsigned int reconfigured:1;
 	/*! TRUE if the bridge has been dissolved.  Any channel that now tries to join is immediately ejected. */
@@ -954,6 +992,50 @@ int ast_bridge_queue_action(struct ast_bridge *bridge, struct ast_frame *action)
  */
 int ast_bridge_queue_everyone_else(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel, struct ast_frame *frame);
 
+/*!
+ * \brief A prompt decoded to signed linear audio for playing into bridges
+ * \since 19.0.0
+ *
+ * \note An ao2 object never modified once allocated, so any number of
+ * bridges can play it at the same time.
+ */
+struct ast_bridge_prompt {
+	/*! Sample rate of the audio */
+	unsigned int rate;
+	/*! Number of samples */
+	size_t samples;
+	/*! The audio */
+	int16_t *data;
+};
+
+/*!
+ * \brief Decode a sound file into a prompt
+ * \since 19.0.0
+ *
+ * \param filename The name of the file, as given to ast_streamfile()
+ * \param language The preferred language of the file, may be NULL
+ *
+ * \return A prompt, to be released with ao2_ref()
+ * \retval NULL if the file cannot be decoded
+ */
+struct ast_bridge_prompt *ast_bridge_prompt_alloc(const char *filename, const char *language);
+
+/*!
+ * \brief Play a prompt into a bridge without a channel
+ * \since 19.0.0
+ *
+ * \param bridge The bridge to play the prompt into
+ * \param prompt The prompt to play
+ *
+ * Everyone in the bridge hears the prompt as if it was played by a channel
+ * in the bridge.  Returns once the prompt was played.
+ *
+ * \retval 0 on success
+ * \retval -1 if the bridge technology cannot play prompts, a channel has
+ *         to be used to play it
+ */
+int ast_bridge_play_prompt(struct ast_bridge *bridge, struct ast_bridge_prompt *prompt);
+
 /*!
  * \brief Adjust the internal mixing sample rate of a bridge
  * used during multimix mode.
@@ -991,6 +1073,17 @@ void ast_bridge_set_maximum_sample_rate(struct ast_bridge *bridge, unsigned int
  */
 void ast_bridge_set_mixing_interval(struct ast_bridge *bridge, unsigned int mixing_interval);
 
+/*!
+ * \brief Set the number of threads used to write mixed audio to
+ * participants during multimix mode.
+ * \since 19.0.0
+ *
+ * \param bridge Bridge to change the number of mixing threads on.
+ * \param mixing_threads The number of threads, including the mixing
+ *        thread itself.  0 or 1 disables the extra threads.
+ */
+void ast_bridge_set_mixing_threads(struct ast_bridge *bridge, unsigned int mixing_threads);
+
 /*!
  * \brief Activates the use of binaural signals in a conference bridge.
  *
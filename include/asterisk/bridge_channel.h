@@ -145,6 +145,8 @@ struct ast_bridge_channel {
 	AST_LIST_ENTRY(ast_bridge_channel) entry;
 	/*! Queue of outgoing frames to the channel. */
 	AST_LIST_HEAD_NOLOCK(, ast_frame) wr_queue;
+	/*! When each frame in the wr_queue was queued, in the same order. */
+	AST_VECTOR(, struct timeval) wr_queued;
 	/*! Queue of deferred frames, queued onto channel when other party joins. */
 	AST_LIST_HEAD_NOLOCK(, ast_frame) deferred_queue;
 	/*! Pipe to alert thread when frames are put into the wr_queue. */
@@ -191,6 +193,20 @@ struct ast_bridge_channel {
 		/*! An index mapping of where a bridge's media needs to be routed */
 		struct ast_vector_int to_channel;
 	} stream_map;
+	/*!
+	 * \brief Time voice frames written to the channel spent inside Asterisk
+	 *
+	 * \note Only updated by the bridge channel thread, readers take what
+	 * they find.
+	 */
+	struct {
+		/*! Frames timed */
+		unsigned int frames;
+		/*! Longest transit in microseconds */
+		unsigned int max;
+		/*! Total transit in microseconds */
+		uint64_t total;
+	} transit;
 };
 
 /*!
@@ -82,6 +82,16 @@ enum bridge_channel_action_type {
  */
 struct ast_bridge_channel *bridge_channel_internal_alloc(struct ast_bridge *bridge);
 
+/*!
+ * \internal
+ * \brief Initialize the bridge channel core
+ * \since 19.0.0
+ *
+ * \retval 0 on success
+ * \retval -1 on error
+ */
+int bridge_channel_internal_init(void);
+
 /*!
  * \internal
  * \brief Settle owed events by the channel to the original bridge.
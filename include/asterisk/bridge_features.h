@@ -257,12 +257,20 @@ struct ast_bridge_hook_timer {
 	struct ast_bridge_hook_timer_parms timer;
 };
 
+struct ast_bridge_dtmf_trie;
+
 /*!
  * \brief Structure that contains features information
  */
 struct ast_bridge_features {
-	/*! Attached DTMF feature hooks */
+	/*!
+	 * \brief Attached DTMF feature hooks
+	 *
+	 * \note Only change through the hook API, which keeps dtmf_trie in step.
+	 */
 	struct ao2_container *dtmf_hooks;
+	/*! DTMF feature hook codes compiled for lookup.  (Protected by the dtmf_hooks lock) */
+	struct ast_bridge_dtmf_trie *dtmf_trie;
 	/*! Attached miscellaneous other hooks. */
 	struct ao2_container *other_hooks;
 	/*! Attached interval hooks */
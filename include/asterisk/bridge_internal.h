@@ -216,4 +216,34 @@ void bridge_reconfigured(struct ast_bridge *bridge, unsigned int colp_update);
  */
 void bridge_dissolve(struct ast_bridge *bridge, int cause);
 
+/*!
+ * \internal
+ * \brief Find a DTMF feature hook matching collected digits.
+ * \since 19.0.0
+ *
+ * \param features Features to search the DTMF hooks of.
+ * \param dtmf Collected DTMF digits.
+ *
+ * \details
+ * Same as an OBJ_SEARCH_PARTIAL_KEY search of the dtmf_hooks container,
+ * using the compiled DTMF hook codes.  The hook with exactly the collected
+ * code is returned if there is one, otherwise the first hook whose code
+ * starts with the collected digits.
+ *
+ * \retval hook A reference to the matching hook.
+ * \retval NULL if no hook code starts with the collected digits.
+ */
+struct ast_bridge_hook_dtmf *bridge_dtmf_hook_find(struct ast_bridge_features *features, const char *dtmf);
+
+/*!
+ * \internal
+ * \brief Note that the DTMF hooks of the features changed.
+ * \since 19.0.0
+ *
+ * \param features Features whose dtmf_hooks container was changed.
+ *
+ * \return Nothing
+ */
+void bridge_dtmf_hooks_changed(struct ast_bridge_features *features);
+
 #endif /* _ASTERISK_PRIVATE_BRIDGING_H */
@@ -28,6 +28,36 @@
 extern "C" {
 #endif
 
+struct ast_bridge_prompt;
+
+/*!
+ * \brief A prompt being played into a bridge by its technology
+ * \since 19.0.0
+ *
+ * \see ast_bridge_play_prompt()
+ */
+struct ast_bridge_prompt_playback {
+	/*! The prompt played */
+	struct ast_bridge_prompt *prompt;
+	/*! Position in the prompt, for the technology to use as it likes */
+	uint64_t position;
+	/*! Linkage, for the technology to use as it likes */
+	AST_LIST_ENTRY(ast_bridge_prompt_playback) list;
+	/*! Lock and condition the player waits on for the playback to be done */
+	ast_mutex_t lock;
+	ast_cond_t cond;
+	/*! TRUE once the technology is done with the playback */
+	unsigned int done:1;
+};
+
+/*!
+ * \brief Tell the player of a prompt that its playback is done
+ * \since 19.0.0
+ *
+ * \param playback The playback, not to be touched again by the technology
+ */
+void ast_bridge_prompt_playback_done(struct ast_bridge_prompt_playback *playback);
+
 /*!
  * \brief Base preference values for choosing a bridge technology.
  *
@@ -190,6 +220,23 @@ struct ast_bridge_technology {
 	 * \note On entry, bridge is already locked.
 	 */
 	void (*stream_topology_changed)(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel);
+	/*!
+	 * \brief Play a prompt into the bridge without a channel
+	 * \since 19.0.0
+	 *
+	 * \details
+	 * The technology mixes the prompt into what the channels of the
+	 * bridge hear, and calls ast_bridge_prompt_playback_done() once
+	 * the whole prompt was played or the playback was abandoned.
+	 *
+	 * \retval 0 The technology took the playback.
+	 * \retval -1 The technology cannot play the prompt.
+	 *
+	 * \note On entry, bridge is already locked.
+	 *
+	 * \note Optional.
+	 */
+	int (*play_prompt)(struct ast_bridge *bridge, struct ast_bridge_prompt_playback *playback);
 	/*! TRUE if the bridge technology is currently suspended. */
 	unsigned int suspended:1;
 	/*! Module this bridge technology belongs to. It is used for reference counting bridges using the technology. */
@@ -113,6 +113,8 @@ struct ast_calendar_event {
 	AST_LIST_HEAD_NOLOCK(attendees, ast_calendar_attendee) attendees;
 };
 
+struct ast_calendar_event_index;
+
 /*! \brief Asterisk calendar structure */
 struct ast_calendar {
 	const struct ast_calendar_tech *tech;
@@ -136,6 +138,7 @@ struct ast_calendar {
 	unsigned int unloading:1;
 	unsigned int pending_deletion:1;
 	struct ao2_container *events;  /*!< The events that are known at this time */
+	struct ast_calendar_event_index *event_index; /*!< The events ordered by time, for lookups of a time range */
 };
 
 /*! \brief Register a new calendar technology
@@ -268,6 +268,7 @@ struct ast_cdr_config {
 		unsigned int size;				/*!< Size to trigger a batch */
 		struct ast_flags settings;		/*!< Settings for batches */
 	} batch_settings;
+	unsigned int shards;				/*!< Serializers channel messages are spread across */
 };
 
 /*!
@@ -358,6 +359,43 @@ void ast_cdr_set_config(struct ast_cdr_config *config);
  */
 void ast_cdr_format_var(struct ast_cdr *cdr, const char *name, char **ret, char *workspace, int workspacelen, int raw);
 
+/*! \brief A template for formatting posted CDRs, see \ref ast_cdr_template_compile */
+struct ast_cdr_template;
+
+/*!
+ * \since 19.0.0
+ * \brief Compile a template for formatting posted CDRs
+ *
+ * Templates written for substitution on a dummy channel that only use
+ * literal text, \c ${CDR(field[,options])} and \c ${CSV_QUOTE(${CDR(...)})}
+ * can be compiled into something that reads the fields of the CDR directly.
+ *
+ * \param format The template
+ *
+ * \retval NULL if the template uses anything else, or on error. The
+ *         template should then be substituted on a dummy channel as before.
+ * \retval The compiled template, to be freed with \ref ast_cdr_template_free
+ */
+struct ast_cdr_template *ast_cdr_template_compile(const char *format);
+
+/*!
+ * \since 19.0.0
+ * \brief Free a compiled CDR template
+ *
+ * \param tpl The template, may be NULL
+ */
+void ast_cdr_template_free(struct ast_cdr_template *tpl);
+
+/*!
+ * \since 19.0.0
+ * \brief Format a posted CDR with a compiled template
+ *
+ * \param tpl The template
+ * \param cdr The dispatched CDR
+ * \param buf Where to put the result, replacing what was there
+ */
+void ast_cdr_template_apply(const struct ast_cdr_template *tpl, struct ast_cdr *cdr, struct ast_str **buf);
+
 /*!
  * \since 12
  * \brief Retrieve a CDR variable from a channel's current CDR
@@ -457,6 +495,22 @@ int ast_cdr_serialize_variables(const char *channel_name, struct ast_str **buf,
  */
 typedef int (*ast_cdrbe)(struct ast_cdr *cdr);
 
+/*!
+ * \brief CDR backend callback for a batch of records
+ * \since 19.0.0
+ *
+ * \param cdrs The records to log, in the order they were finished
+ * \param count How many records there are
+ *
+ * \note A batch callback has to log all of the records or none of them.
+ * When it fails, each record is handed to the backend's \ref ast_cdrbe
+ * callback instead.
+ *
+ * \retval 0 if all of the records were logged
+ * \retval non-zero if none of them were
+ */
+typedef int (*ast_cdrbe_batch)(struct ast_cdr **cdrs, size_t count);
+
 /*! \brief Return TRUE if CDR subsystem is enabled */
 int ast_cdr_is_enabled(void);
 
@@ -509,6 +563,26 @@ void ast_cdr_free(struct ast_cdr *cdr);
  */
 int ast_cdr_register(const char *name, const char *desc, ast_cdrbe be);
 
+/*!
+ * \brief Register a CDR handling engine that can log records in batches
+ * \since 19.0.0
+ *
+ * \param name name associated with the particular CDR handler
+ * \param desc description of the CDR handler
+ * \param be function pointer to a CDR handler
+ * \param batch_be function pointer to a handler for a batch of records
+ *
+ * Like \ref ast_cdr_register, but when CDRs are posted in batch mode the
+ * records of a batch are handed to \p batch_be all at once, so they can be
+ * written with fewer round trips to a database. Outside of batch mode, or if
+ * \p batch_be fails, each record goes to \p be. The backend is unregistered
+ * with \ref ast_cdr_unregister.
+ *
+ * \retval 0 on success.
+ * \retval -1 on error
+ */
+int ast_cdr_register_batch(const char *name, const char *desc, ast_cdrbe be, ast_cdrbe_batch batch_be);
+
 /*!
  * \brief Unregister a CDR handling engine
  * \param name name of CDR handler to unregister
@@ -181,6 +181,49 @@ struct ast_cel_event_record {
  */
 int ast_cel_fill_record(const struct ast_event *event, struct ast_cel_event_record *r);
 
+/*! \brief A template for formatting CEL events, see \ref ast_cel_template_compile */
+struct ast_cel_template;
+
+/*!
+ * \brief Compile a template for formatting CEL events
+ * \since 19.0.0
+ *
+ * Templates written for substitution on a channel from
+ * \ref ast_cel_fabricate_channel_from_event that only use literal text,
+ * the variables that channel is given and the \c CALLERID() and
+ * \c CHANNEL() fields it is filled in with, each possibly within
+ * \c CSV_QUOTE(), can be compiled into something that reads the event
+ * directly.
+ *
+ * \param format The template
+ *
+ * \retval NULL if the template uses anything else, or on error. The
+ *         template should then be substituted on a fabricated channel as before.
+ * \retval The compiled template, to be freed with \ref ast_cel_template_free
+ */
+struct ast_cel_template *ast_cel_template_compile(const char *format);
+
+/*!
+ * \brief Free a compiled CEL template
+ * \since 19.0.0
+ *
+ * \param tpl The template, may be NULL
+ */
+void ast_cel_template_free(struct ast_cel_template *tpl);
+
+/*!
+ * \brief Format a CEL event with a compiled template
+ * \since 19.0.0
+ *
+ * \param tpl The template
+ * \param event The CEL event
+ * \param buf Where to put the result, replacing what was there
+ *
+ * \retval 0 success
+ * \retval non-zero failure
+ */
+int ast_cel_template_apply(const struct ast_cel_template *tpl, const struct ast_event *event, struct ast_str **buf);
+
 /*!
  * \brief Publish a CEL event
  * \since 12
@@ -201,6 +244,17 @@ void ast_cel_publish_event(struct ast_channel *chan,
  */
 struct stasis_topic *ast_cel_topic(void);
 
+/*!
+ * \brief What happens to an event for a backend whose queue is full
+ * \since 19.0.0
+ */
+enum ast_cel_overflow_policy {
+	/*! Wait for the backend to make room for the event */
+	AST_CEL_OVERFLOW_BLOCK = 0,
+	/*! Discard the event */
+	AST_CEL_OVERFLOW_DROP,
+};
+
 /*! \brief A structure to hold CEL global configuration options */
 struct ast_cel_general_config {
 	AST_DECLARE_STRING_FIELDS(
@@ -212,6 +266,10 @@ struct ast_cel_general_config {
 	 * ast_str_container_alloc()ed and filled with ao2-allocated
 	 * char* which are all-lowercase application names. */
 	struct ao2_container *apps;
+	/*! How many events may wait for each backend, 0 to hand them over directly */
+	unsigned int queue_size;
+	/*! What to do with an event for a backend whose queue is full */
+	enum ast_cel_overflow_policy overflow;
 };
 
 /*!
@@ -314,6 +372,34 @@ int ast_cel_backend_register(const char *name, ast_cel_backend_cb backend_callba
  */
 int ast_cel_backend_unregister(const char *name);
 
+/*! \brief The state of the queue of events for a CEL backend */
+struct ast_cel_backend_stats {
+	/*! Name of the backend */
+	const char *name;
+	/*! Events waiting to be handed to the backend */
+	size_t queued;
+	/*! Events discarded because the queue was full */
+	unsigned int dropped;
+};
+
+/*!
+ * \brief Callback for \ref ast_cel_backend_stats_foreach
+ *
+ * \param stats The backend, only valid for the duration of the callback
+ * \param data Passed through from \ref ast_cel_backend_stats_foreach
+ */
+typedef void (*ast_cel_backend_stats_cb)(const struct ast_cel_backend_stats *stats, void *data);
+
+/*!
+ * \brief Get the state of the queue of every registered CEL backend
+ *
+ * \param callback Called once for each backend
+ * \param data Passed to the callback
+ *
+ * \since 19.0.0
+ */
+void ast_cel_backend_stats_foreach(ast_cel_backend_stats_cb callback, void *data);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
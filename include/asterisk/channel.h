@@ -230,13 +230,23 @@ struct ast_generator {
 	/*! This function gets called with the channel unlocked, but is called in
 	 *  the context of the channel thread so we know the channel is not going
 	 *  to disappear.  This callback is responsible for locking the channel as
-	 *  necessary. */
+	 *  necessary.  If shareable is set it may instead be called from a shared
+	 *  generator thread holding a reference to the channel. */
 	int (*generate)(struct ast_channel *chan, void *data, int len, int samples);
 	/*! This gets called when DTMF_END frames are read from the channel */
 	void (*digit)(struct ast_channel *chan, char digit);
 	/*! This gets called when the write format on a channel is changed while
 	 * generating. The channel is locked during this callback. */
 	void (*write_format_change)(struct ast_channel *chan, void *data);
+	/*!
+	 * \since 19.0.0
+	 * \brief Set if generate does not need to run in the channel thread
+	 *
+	 * When generator_threads is set in asterisk.conf such generators are
+	 * run at tick time by a pool of shared threads instead of off each
+	 * channel's own timer.
+	 */
+	unsigned int shareable:1;
 };
 
 /*! Party name character set enumeration values (values from Q.SIG) */
@@ -1057,6 +1067,10 @@ enum {
 	 * The channel is executing a subroutine or macro
 	 */
 	AST_FLAG_SUBROUTINE_EXEC = (1 << 27),
+	/*!
+	 * The generator on the channel is run by a shared generator thread.
+	 */
+	AST_FLAG_GENERATOR_SHARED = (1 << 28),
 };
 
 /*! \brief ast_bridge_config flags */
@@ -1703,6 +1717,18 @@ void ast_channel_set_unbridged(struct ast_channel *chan, int value);
  */
 void ast_channel_set_unbridged_nolock(struct ast_channel *chan, int value);
 
+/*!
+ * \brief Get how many times the unbridged flag of the channel was raised
+ * \since 19.0.0
+ *
+ * \param chan Channel to get the count of
+ *
+ * \note The channel should be locked before calling.
+ *
+ * \return The count, which only ever grows and may wrap
+ */
+unsigned int ast_channel_unbridged_generation(struct ast_channel *chan);
+
 /*!
  * \brief This function will check if T.38 is active on the channel.
  *
@@ -4508,6 +4534,23 @@ int ast_channel_fd_count(const struct ast_channel *chan);
  */
 int ast_channel_fd_add(struct ast_channel *chan, int value);
 
+/*!
+ * \since 19
+ * \brief Retrieve the generation of the file descriptors of the channel
+ *
+ * \param chan The channel
+ *
+ * The generation changes whenever a file descriptor of the channel is set,
+ * cleared or added, to a value no other channel has had.  Waiters that keep
+ * the descriptors registered between waits compare it to see whether they
+ * must register them again.
+ *
+ * \pre chan is locked
+ *
+ * \return The generation
+ */
+unsigned int ast_channel_fd_generation(const struct ast_channel *chan);
+
 pthread_t ast_channel_blocker(const struct ast_channel *chan);
 void ast_channel_blocker_set(struct ast_channel *chan, pthread_t value);
 
@@ -4691,16 +4734,39 @@ struct varshead *ast_channel_get_vars(struct ast_channel *chan);
 
 /*!
  * \since 12
+ * \brief A topic to publish the events for a particular channel to.
+ *
+ * If the given \a chan is \c NULL, ast_channel_topic_all() is returned.
+ *
+ * A channel only gets a topic of its own once ast_channel_own_topic() is
+ * called for it.  Until then its events are published straight to
+ * ast_channel_topic_all(), so this must not be used to subscribe to the
+ * events of one channel.
+ *
+ * \param chan Channel, or \c NULL.
+ *
+ * \retval Topic for channel's events.
+ * \retval ast_channel_topic_all() if \a chan is \c NULL or has no topic of its own.
+ */
+struct stasis_topic *ast_channel_topic(struct ast_channel *chan);
+
+/*!
+ * \since 19
  * \brief A topic which publishes the events for a particular channel.
  *
+ * Creates the topic of the channel if it does not have one yet, after
+ * which ast_channel_topic() returns it as well.  Use this to subscribe to,
+ * or forward, the events of one channel.
+ *
  * If the given \a chan is \c NULL, ast_channel_topic_all() is returned.
  *
  * \param chan Channel, or \c NULL.
  *
  * \retval Topic for channel's events.
  * \retval ast_channel_topic_all() if \a chan is \c NULL.
+ * \retval NULL if the topic could not be created.
  */
-struct stasis_topic *ast_channel_topic(struct ast_channel *chan);
+struct stasis_topic *ast_channel_own_topic(struct ast_channel *chan);
 
 /*!
  * \brief Get the bridge associated with a channel
@@ -27,11 +27,31 @@
 
 struct ast_var_t {
 	AST_LIST_ENTRY(ast_var_t) entries;
+	/*! Next variable in the same bucket of the list name index */
+	struct ast_var_t *index_next;
 	char *value;
 	char name[0];
 };
 
-AST_LIST_HEAD_NOLOCK(varshead, ast_var_t);
+struct ast_var_index;
+
+/*!
+ * \brief A list of variables.
+ *
+ * \details
+ * The list is an AST_LIST_HEAD_NOLOCK() list with an optional name index
+ * attached.  The index is only created by ast_var_list_index_enable().
+ *
+ * \note Once the index is enabled variables must only be added to and
+ * removed from the list through the AST_VAR_LIST_* helpers.  Only
+ * changes at the ends of the list are detected otherwise.
+ */
+struct varshead {
+	struct ast_var_t *first;
+	struct ast_var_t *last;
+	/*! Name index, NULL unless enabled by ast_var_list_index_enable() */
+	struct ast_var_index *index;
+};
 
 struct varshead *ast_var_list_create(void);
 void ast_var_list_destroy(struct varshead *head);
@@ -46,18 +66,110 @@ const char *ast_var_value(const struct ast_var_t *var);
 char *ast_var_find(const struct varshead *head, const char *name);
 struct varshead *ast_var_list_clone(struct varshead *head);
 
+/*!
+ * \brief Maintain a name index on a variable list.
+ * \since 19.0.0
+ *
+ * \details
+ * Lists with an index resolve ast_var_list_search() with a hash
+ * lookup instead of a linear scan once they hold enough variables.
+ * The list order is unchanged.
+ *
+ * \param head List to index.  The list may already hold variables.
+ *
+ * \retval 0 on success.
+ * \retval -1 on failure.  The list keeps working without an index.
+ */
+int ast_var_list_index_enable(struct varshead *head);
+
+/*!
+ * \brief Release the name index of a variable list.
+ * \since 19.0.0
+ *
+ * \param head List to stop indexing.  The variables are not touched.
+ */
+void ast_var_list_index_disable(struct varshead *head);
+
+/*!
+ * \brief Find the first variable in a list with the given name.
+ * \since 19.0.0
+ *
+ * \param head List to search.
+ * \param name Variable name without any inheritance underscores.
+ *
+ * \note Names are compared against ast_var_name() so a name of "FOO"
+ * matches variables set as "FOO", "_FOO" and "__FOO".
+ *
+ * \note The list is not modified, so a read lock on it is sufficient.
+ *
+ * \return The variable or NULL if no variable has the name.
+ */
+struct ast_var_t *ast_var_list_search(struct varshead *head, const char *name);
+
+/*!
+ * \brief Add a variable just linked into a list to the list index.
+ * \since 19.0.0
+ *
+ * \note Use the AST_VAR_LIST_INSERT_* helpers rather than calling this.
+ */
+void ast_var_list_index_insert(struct varshead *head, struct ast_var_t *var, int at_head);
+
+/*!
+ * \brief Remove a variable just unlinked from a list from the list index.
+ * \since 19.0.0
+ *
+ * \note Use the AST_VAR_LIST_REMOVE* helpers rather than calling this.
+ */
+void ast_var_list_index_remove(struct varshead *head, struct ast_var_t *var);
+
 #define AST_VAR_LIST_TRAVERSE(head, var) AST_LIST_TRAVERSE(head, var, entries)
 
 static inline void AST_VAR_LIST_INSERT_TAIL(struct varshead *head, struct ast_var_t *var) {
 	if (var) {
 		AST_LIST_INSERT_TAIL(head, var, entries);
+		if (head->index) {
+			ast_var_list_index_insert(head, var, 0);
+		}
 	}
 }
 
 static inline void AST_VAR_LIST_INSERT_HEAD(struct varshead *head, struct ast_var_t *var) {
 	if (var) {
 		AST_LIST_INSERT_HEAD(head, var, entries);
+		if (head->index) {
+			ast_var_list_index_insert(head, var, 1);
+		}
 	}
 }
 
+static inline struct ast_var_t *AST_VAR_LIST_REMOVE(struct varshead *head, struct ast_var_t *var) {
+	var = AST_LIST_REMOVE(head, var, entries);
+	if (var && head->index) {
+		ast_var_list_index_remove(head, var);
+	}
+	return var;
+}
+
+static inline struct ast_var_t *AST_VAR_LIST_REMOVE_HEAD(struct varshead *head) {
+	struct ast_var_t *var = AST_LIST_REMOVE_HEAD(head, entries);
+
+	if (var && head->index) {
+		ast_var_list_index_remove(head, var);
+	}
+	return var;
+}
+
+/*!
+ * \brief Remove the current variable inside an AST_LIST_TRAVERSE_SAFE_BEGIN() loop.
+ *
+ * \param head List being traversed.
+ * \param var The loop variable.
+ */
+#define AST_VAR_LIST_REMOVE_CURRENT(head, var) do {			\
+		AST_LIST_REMOVE_CURRENT(entries);				\
+		if ((head)->index) {						\
+			ast_var_list_index_remove(head, var);			\
+		}								\
+	} while (0)
+
 #endif /* _ASTERISK_CHANVARS_H */
@@ -477,6 +477,44 @@ struct ast_variable *ast_load_realtime_all(const char *family, ...) attribute_se
  */
 int ast_unload_realtime(const char *family);
 
+/*!
+ * \brief Discard cached realtime lookup results
+ * \since 19
+ *
+ * \param family Family to discard results for, NULL for every family
+ *
+ * \details
+ * Results of ast_load_realtime() and ast_load_realtime_multientry() are
+ * cached for families given a cache time in the [cache] section of
+ * extconfig.conf. Writes made through the realtime API discard the results
+ * of the family written to; this is for changes made to the backend
+ * directly.
+ *
+ * \return Number of cached results discarded
+ */
+int ast_realtime_cache_flush(const char *family);
+
+/*!
+ * \brief Get how long lookup results of a realtime family are cached
+ * \since 19
+ *
+ * \param family Family to check
+ *
+ * \return Cache time in seconds, 0 if results are not cached
+ */
+int ast_realtime_cache_ttl(const char *family);
+
+/*!
+ * \brief Get the realtime cache generation
+ * \since 19
+ *
+ * \details
+ * The generation changes every time cached realtime results are discarded,
+ * so modules keeping their own copies of realtime data can tell when those
+ * copies should be discarded as well.
+ */
+unsigned int ast_realtime_cache_generation(void);
+
 /*!
  * \brief Inform realtime what fields that may be stored
  * \since 1.6.1
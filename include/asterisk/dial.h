@@ -226,6 +226,37 @@ void ast_dial_set_timeout(struct ast_dial *dial, int num, int timeout);
  */
 const char *ast_hangup_cause_to_dial_status(int hangup_cause);
 
+/*! \brief Forward declaration for stream topologies, used in parallel requests */
+struct ast_stream_topology;
+
+/*! \since 19
+ * \brief A channel to request with ast_dial_request_parallel()
+ */
+struct ast_dial_request {
+	const char *tech;                          /*!< Technology being requested */
+	const char *device;                        /*!< Device being requested */
+	struct ast_stream_topology *topology;      /*!< Stream topology to request, or NULL to use cap */
+	struct ast_format_cap *cap;                /*!< Format capabilities to request if no topology */
+	const struct ast_assigned_ids *assignedids; /*!< UniqueIDs to assign, may be NULL */
+	struct ast_channel *chan;                  /*!< Requested channel, NULL on failure */
+	int cause;                                 /*!< Cause code in case of failure */
+};
+
+/*! \since 19
+ * \brief Request several channels at once
+ * \param requests Channels to request
+ * \param count Number of channels to request
+ * \param requestor Channel asking for the channels, may be NULL
+ *
+ * \note The channel technology requests run concurrently on a shared pool of
+ * threads and this returns once all of them have completed.  Only the
+ * requests run in parallel, each resulting channel is left for the caller to
+ * set up and call in order.
+ *
+ * \note The requestor must not be locked.
+ */
+void ast_dial_request_parallel(struct ast_dial_request *requests, size_t count, struct ast_channel *requestor);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
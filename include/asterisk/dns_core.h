@@ -271,6 +271,55 @@ int ast_dns_resolve_cancel(struct ast_dns_query_active *active);
  */
 int ast_dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_result **result);
 
+/*!
+ * \brief Asynchronously resolve a DNS query through the DNS result cache
+ * \since 19
+ *
+ * \param name The name of what to resolve
+ * \param rr_type Resource record type
+ * \param rr_class Resource record class
+ * \param callback The callback to invoke upon completion
+ * \param data User data to make available on the query
+ *
+ * \retval non-NULL success - query has been sent for resolution
+ * \retval NULL failure
+ *
+ * This behaves as ast_dns_resolve_async() but answers are kept for the lowest TTL of
+ * their records, name errors and empty answers for a short fixed time. Queries for a
+ * name that is already being resolved wait on the outstanding lookup instead of
+ * issuing their own, and entries that are used shortly before they expire are
+ * refreshed in the background. The callback is always invoked asynchronously.
+ *
+ * \note The TTL of records in a cached result is the time they have left to live
+ *
+ * \note The same notes as ast_dns_resolve_async() apply
+ */
+struct ast_dns_query_active *ast_dns_resolve_async_cached(const char *name, int rr_type, int rr_class, ast_dns_resolve_callback callback, void *data);
+
+/*!
+ * \brief Synchronously resolve a DNS query through the DNS result cache
+ * \since 19
+ *
+ * \param name The name of what to resolve
+ * \param rr_type Resource record type
+ * \param rr_class Resource record class
+ * \param result A pointer to hold the DNS result
+ *
+ * \retval 0 success - query was completed and result is available
+ * \retval -1 failure
+ *
+ * \see ast_dns_resolve_async_cached
+ */
+int ast_dns_resolve_cached(const char *name, int rr_type, int rr_class, struct ast_dns_result **result);
+
+/*!
+ * \brief Remove all entries from the DNS result cache
+ * \since 19
+ *
+ * \note Lookups in progress still complete their waiting queries
+ */
+void ast_dns_cache_flush(void);
+
 /*!
  * \brief Synchronously resolves host to  an AAAA or A record
  * \since 16.6.0
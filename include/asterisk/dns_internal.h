@@ -323,4 +323,11 @@ int dns_parse_string(char *cur, uint8_t *size, char **val);
  */
 struct ast_dns_query *dns_query_alloc(const char *name, int rr_type, int rr_class, ast_dns_resolve_callback callback, void *data);
 
+/*!
+ * \brief Have a DNS query answered through the DNS result cache
+ *
+ * \param query The DNS query, which must not have been started yet
+ */
+void dns_query_use_cache(struct ast_dns_query *query);
+
 #endif /* _ASTERISK_DNS_INTERNAL_H */
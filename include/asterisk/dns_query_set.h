@@ -61,6 +61,22 @@ struct ast_dns_query_set *ast_dns_query_set_create(void);
  */
 int ast_dns_query_set_add(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class);
 
+/*!
+ * \brief Add a query to a query set which is answered through the DNS result cache
+ * \since 19
+ *
+ * \param query_set A DNS query set
+ * \param name The name of what to resolve
+ * \param rr_type Resource record type
+ * \param rr_class Resource record class
+ *
+ * \retval 0 success
+ * \retval -1 failure
+ *
+ * \see ast_dns_resolve_async_cached
+ */
+int ast_dns_query_set_add_cached(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class);
+
 /*!
  * \brief Retrieve the number of queries in a query set
  *
@@ -60,8 +60,10 @@ enum ast_event_type {
 	AST_EVENT_PING                = 0x0c,
 	/*! A cluster discovery message */
 	AST_EVENT_CLUSTER_DISCOVERY   = 0x0d,
+	/*! A change to a published family of the Asterisk database */
+	AST_EVENT_DB_CHANGE           = 0x0e,
 	/*! Number of event types.  This should be the last event type + 1 */
-	AST_EVENT_TOTAL               = 0x0e,
+	AST_EVENT_TOTAL               = 0x0f,
 };
 
 /*! \brief Event Information Element types */
@@ -311,8 +313,20 @@ enum ast_event_ie_type {
 	 * Payload type: UINT
 	 */
 	AST_EVENT_IE_NODE_ID             = 0x003e,
+	AST_EVENT_IE_SUPPRESSED_EVENT    = 0x003f,
+	AST_EVENT_IE_SUPPRESSED_COUNT    = 0x0040,
+
+	/*!
+	 * \brief Asterisk database change, an ast_db_change_op
+	 * Used by: AST_EVENT_DB_CHANGE
+	 * Payload type: UINT
+	 */
+	AST_EVENT_IE_DB_OP               = 0x0041,
+	AST_EVENT_IE_DB_FAMILY           = 0x0042,
+	AST_EVENT_IE_DB_KEY              = 0x0043,
+	AST_EVENT_IE_DB_VALUE            = 0x0044,
 	/*! \brief Must be the last IE value +1 */
-	AST_EVENT_IE_TOTAL               = 0x003f,
+	AST_EVENT_IE_TOTAL               = 0x0045,
 };
 
 /*!
@@ -257,6 +257,26 @@ int ast_waitstream_full(struct ast_channel *c, const char *breakon, int audiofd,
  */
 struct ast_filestream *ast_readfile(const char *filename, const char *type, const char *comment, int flags, int check, mode_t mode);
 
+/*!
+ * \brief Decode a sound file to signed linear audio
+ * \since 19.0.0
+ *
+ * \param filename The name of the file, without extension, as given to
+ *        ast_streamfile()
+ * \param preflang The preferred language of the file, may be NULL
+ * \param[out] rate The sample rate of the decoded audio
+ * \param[out] samples The number of decoded samples
+ *
+ * The file is looked up the way ast_streamfile() looks it up, and the
+ * format with the highest sample rate it exists in is decoded, so it can
+ * be played without a channel.
+ *
+ * \return The samples, to be freed with ast_free()
+ * \retval NULL if the file does not exist, cannot be decoded, or is too long
+ */
+int16_t *ast_file_decode_slin(const char *filename, const char *preflang,
+	unsigned int *rate, size_t *samples);
+
 /*!
  * \brief Starts writing a file
  * \param filename the name of the file to write to
@@ -274,6 +294,20 @@ struct ast_filestream *ast_readfile(const char *filename, const char *type, cons
  */
 struct ast_filestream *ast_writefile(const char *filename, const char *type, const char *comment, int flags, int check, mode_t mode);
 
+/*!
+ * \brief Determine if a file name refers to a sink rather than the file system
+ * \since 19.0.0
+ *
+ * \param filename The file name to check
+ *
+ * ast_writefile() streams files with such a name to the sink registered for
+ * their URI scheme, so no directories need to be made for them.
+ *
+ * \retval 1 if a registered sink writes the file
+ * \retval 0 otherwise
+ */
+int ast_file_is_sink(const char *filename);
+
 /*!
  * \brief Writes a frame to a stream
  * \param fs filestream to write to
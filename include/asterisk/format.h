@@ -192,6 +192,30 @@ struct ast_format *ast_format_clone(const struct ast_format *format);
  */
 enum ast_format_cmp_res ast_format_cmp(const struct ast_format *format1, const struct ast_format *format2);
 
+/*!
+ * \brief Mark a format as interned
+ * \since 19.0.0
+ *
+ * \param format The format to mark
+ *
+ * \details
+ * An interned format is shared through the format cache and is never
+ * modified again, so anything derived only from interned formats can be
+ * cached too.  This is only meant for the format cache.
+ */
+void ast_format_set_interned(struct ast_format *format);
+
+/*!
+ * \brief Determine if a format is interned
+ * \since 19.0.0
+ *
+ * \param format The format to check
+ *
+ * \retval 1 if the format is interned
+ * \retval 0 if it is not
+ */
+int ast_format_is_interned(const struct ast_format *format);
+
 /*!
  * \brief Get a common joint capability between two formats
  *
@@ -236,6 +260,9 @@ const void *ast_format_attribute_get(const struct ast_format *format, const char
  *
  * \retval non-NULL success, attribute values were valid
  * \retval NULL failure, values were not acceptable
+ *
+ * \note The result of parsing a line on an interned format is itself interned,
+ * so the same line on the same format is parsed only once.
  */
 struct ast_format *ast_format_parse_sdp_fmtp(const struct ast_format *format, const char *attributes);
 
@@ -322,4 +322,77 @@ int ast_format_cache_is_slinear(struct ast_format *format);
  */
 struct ast_format *ast_format_cache_get_by_codec(const struct ast_codec *codec);
 
+/*!
+ * \brief Retrieve the format an SDP fmtp line parsed to on an interned format
+ * \since 19.0.0
+ *
+ * \param format The interned format the line is parsed on
+ * \param attributes The fmtp line
+ *
+ * \retval non-NULL the interned result of parsing the line
+ * \retval NULL if the line has not been parsed on the format yet
+ *
+ * \note The returned format has its reference count incremented. It must be
+ * dropped using ao2_ref or ao2_cleanup.
+ */
+struct ast_format *ast_format_cache_get_fmtp(const struct ast_format *format, const char *attributes);
+
+/*!
+ * \brief Intern the format an SDP fmtp line parsed to on an interned format
+ * \since 19.0.0
+ *
+ * \param format The interned format the line was parsed on
+ * \param attributes The fmtp line
+ * \param parsed The result of parsing the line, its reference is stolen
+ *
+ * \return the interned result, which is not parsed if another thread
+ * interned the same line first
+ *
+ * \note The returned format has its reference count incremented. It must be
+ * dropped using ao2_ref or ao2_cleanup.
+ */
+struct ast_format *ast_format_cache_set_fmtp(const struct ast_format *format, const char *attributes,
+	struct ast_format *parsed);
+
+/*!
+ * \brief Retrieve the joint format of two interned formats
+ * \since 19.0.0
+ *
+ * \param format1 The first interned format
+ * \param format2 The second interned format
+ * \param[out] joint The interned joint format, NULL if they have none
+ *
+ * \retval 0 if the pair is cached, in which case any joint format has its
+ * reference count incremented
+ * \retval -1 if it is not
+ */
+int ast_format_cache_get_joint(const struct ast_format *format1, const struct ast_format *format2,
+	struct ast_format **joint);
+
+/*!
+ * \brief Intern the joint format of two interned formats
+ * \since 19.0.0
+ *
+ * \param format1 The first interned format
+ * \param format2 The second interned format
+ * \param joint Their joint format, NULL if they have none, its reference is stolen
+ *
+ * \return the interned joint format, NULL if they have none
+ *
+ * \note The returned format has its reference count incremented. It must be
+ * dropped using ao2_ref or ao2_cleanup.
+ */
+struct ast_format *ast_format_cache_set_joint(const struct ast_format *format1,
+	const struct ast_format *format2, struct ast_format *joint);
+
+/*!
+ * \brief Forget every cached fmtp line and joint format
+ * \since 19.0.0
+ *
+ * \details
+ * Called when a format interface is registered, since parsing and joint
+ * computation were done without it until then.
+ */
+void ast_format_cache_attributes_flush(void);
+
 #endif /* _AST_FORMAT_CACHE_H */
@@ -158,6 +158,8 @@ struct ast_frame_subclass {
 	};
 	/*! For video formats, an indication that a frame ended */
 	unsigned int frame_ending;
+	/*! For video formats, the simulcast layer the frame belongs to, 0 being the lowest */
+	unsigned int layer;
 };
 
 /*! \brief Data structure associated with a single frame of data
@@ -183,6 +185,15 @@ struct ast_frame {
 	union { void *ptr; uint32_t uint32; char pad[8]; } data;
 	/*! Global delivery time */
 	struct timeval delivery;
+	/*!
+	 * \brief When the media in the frame entered Asterisk, zero if unknown
+	 * \since 19.0.0
+	 *
+	 * Set by channel drivers as media is received and carried through
+	 * duplication and translation, so the time a frame spends inside
+	 * Asterisk can be measured when it is written out.
+	 */
+	struct timeval ingress;
 	/*! For placing in a linked list */
 	AST_LIST_ENTRY(ast_frame) frame_list;
 	/*! Misc. frame flags */
@@ -235,6 +246,12 @@ extern struct ast_frame ast_null_frame;
 #define AST_MALLOCD_DATA	(1 << 1)
 /*! Need the source be free'd? (haha!) */
 #define AST_MALLOCD_SRC		(1 << 2)
+/*! The header came from the frame slab allocator (internal to frame.c) */
+#define AST_MALLOCD_SLAB_HDR	(1 << 3)
+/*! The data came from the frame slab allocator (internal to frame.c) */
+#define AST_MALLOCD_SLAB_DATA	(1 << 4)
+/*! The data and source live in a reference counted payload shared with other frames */
+#define AST_MALLOCD_SHARED	(1 << 5)
 
 /* MODEM subclasses */
 /*! T.38 Fax-over-IP */
@@ -585,6 +602,47 @@ struct ast_frame *__ast_frisolate(struct ast_frame *fr, const char *file, int li
 #define ast_frdup(fr) __ast_frdup(fr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
 struct ast_frame *__ast_frdup(const struct ast_frame *fr, const char *file, int line, const char *func);
 
+/*!
+ * \brief Copies a frame header, sharing its payload
+ * \since 19.0.0
+ *
+ * \param fr frame to share
+ *
+ * Gives a frame that refers to the same reference counted data and source
+ * as the original, so one payload can be handed to any number of consumers
+ * without copying it for each.  If the original does not already have a
+ * shared payload its data and source are copied into one first, so a frame
+ * that is to be handed out several times should be shared once and that
+ * copy passed to this function for each consumer.
+ *
+ * Shared payloads are read only.  The returned frame has no headroom
+ * (its offset is zero) so code that prepends to the data in place, such
+ * as RTP, will copy it as it would any other frame without headroom.
+ * Anything else wanting to modify the data must call ast_frunshare() first.
+ *
+ * Frames without data are simply duplicated.
+ *
+ * \return Returns a frame on success, NULL on error
+ */
+#define ast_frshare(fr) __ast_frshare(fr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+struct ast_frame *__ast_frshare(struct ast_frame *fr, const char *file, int line, const char *func);
+
+/*!
+ * \brief Give a frame a private copy of a shared payload
+ * \since 19.0.0
+ *
+ * \param fr frame to make writable
+ *
+ * If the frame refers to a payload shared by ast_frshare() the data and
+ * source are copied into buffers owned by the frame alone, with the usual
+ * headroom in front of the data.  Frames that do not share their payload
+ * are left untouched.
+ *
+ * \retval 0 on success
+ * \retval -1 on allocation failure, in which case the frame is unchanged
+ */
+int ast_frunshare(struct ast_frame *fr);
+
 void ast_swapcopy_samples(void *dst, const void *src, int samples);
 
 /* Helpers for byteswapping native samples to/from
@@ -224,7 +224,13 @@ typedef int (*ast_framehook_consume_callback)(void *data, enum ast_frame_type ty
 typedef void (*ast_framehook_chan_fixup_callback)(void *data, int framehook_id,
 	struct ast_channel *old_chan, struct ast_channel *new_chan);
 
-#define AST_FRAMEHOOK_INTERFACE_VERSION 4
+/*!
+ * \brief The bit of a frame type in the frame_types of a framehook interface
+ * \since 19
+ */
+#define AST_FRAMEHOOK_TYPE(type) (1U << (type))
+
+#define AST_FRAMEHOOK_INTERFACE_VERSION 5
 /*! This interface is required for attaching a framehook to a channel. */
 struct ast_framehook_interface {
 	/*! framehook interface version number */
@@ -249,6 +255,11 @@ struct ast_framehook_interface {
 	/*! disable_inheritance is optional. If set to non-zero, when a channel using this framehook is
 	 * masqueraded, detach and destroy the framehook instead of moving it to the new channel. */
 	int disable_inheritance;
+	/*! frame_types is optional. If set, the read and write events are only raised for frames whose
+	 * type has its AST_FRAMEHOOK_TYPE() bit set here, which lets the channel skip the framehook list
+	 * entirely for frames no framehook wants. Read and write events without a frame, and the
+	 * attached and detached events, are always raised. If zero, frames of all types are passed. */
+	unsigned int frame_types;
 	 /*! This pointer can represent any custom data to be stored on the !framehook. This
 	 * data pointer will be provided during each event callback which allows the framehook
 	 * to store any stateful data associated with the application using the hook. */
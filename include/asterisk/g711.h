@@ -0,0 +1,99 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief G.711 buffer decoding kernels
+ *
+ * Buffer-at-a-time versions of the AST_MULAW() and AST_ALAW() lookups.
+ * At startup the fastest implementation supported by the running CPU is
+ * selected (SSSE3, AVX2 or NEON, falling back to plain C).  A vector
+ * implementation is only selected if it decodes every code exactly as
+ * the lookup tables do.
+ */
+
+#ifndef _ASTERISK_G711_H
+#define _ASTERISK_G711_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/*! \brief Available decoding kernel implementations */
+enum ast_g711_impl {
+	/*! Table lookups, always available */
+	AST_G711_SCALAR = 0,
+	/*! x86 SSSE3 */
+	AST_G711_SSSE3,
+	/*! x86 AVX2 */
+	AST_G711_AVX2,
+	/*! ARM NEON */
+	AST_G711_NEON,
+	/*! Must remain last */
+	AST_G711_IMPL_MAX,
+};
+
+/*! \brief A set of decoding kernels */
+struct ast_g711_ops {
+	/*! Name of the implementation */
+	const char *name;
+	/*! dst[i] = AST_MULAW(src[i]) */
+	void (*ulaw_decode)(short *dst, const unsigned char *src, unsigned int samples);
+	/*! dst[i] = AST_ALAW(src[i]) */
+	void (*alaw_decode)(short *dst, const unsigned char *src, unsigned int samples);
+};
+
+/*!
+ * \brief Get the kernels for a specific implementation
+ * \since 19.0.0
+ *
+ * \param impl The implementation to retrieve
+ *
+ * \retval NULL if the implementation is not supported by this build or CPU
+ * \return the kernels otherwise
+ */
+const struct ast_g711_ops *ast_g711_get_ops(enum ast_g711_impl impl);
+
+/*!
+ * \brief Get the kernels selected for use at startup
+ * \since 19.0.0
+ */
+const struct ast_g711_ops *ast_g711_active_ops(void);
+
+/*!
+ * \brief Decode a buffer of mu-law samples to signed linear
+ * \since 19.0.0
+ *
+ * \param dst Buffer of at least samples signed linear samples
+ * \param src mu-law samples
+ * \param samples Number of samples to decode
+ */
+void ast_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples);
+
+/*!
+ * \brief Decode a buffer of A-law samples to signed linear
+ * \since 19.0.0
+ *
+ * \param dst Buffer of at least samples signed linear samples
+ * \param src A-law samples
+ * \param samples Number of samples to decode
+ */
+void ast_alaw_decode(short *dst, const unsigned char *src, unsigned int samples);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_G711_H */
@@ -0,0 +1,145 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief Latency histograms
+ *
+ * Named histograms of durations, kept in microseconds.  The bucket bounds
+ * step through 1, 1.5, 2, 3, 4, 6, 8, 12 and so on, doubling every two
+ * buckets, so the relative error of any sample is bounded the way an HDR
+ * histogram bounds it.  Recording a sample is two atomic additions and
+ * never takes a lock.
+ *
+ * A histogram belongs to a family identified by its name.  Every histogram
+ * of a family carries a value for the family's single label, such as the
+ * name of a dialplan application.  Exporters like res_prometheus read them
+ * back with ast_histogram_foreach().
+ */
+
+#ifndef _ASTERISK_HISTOGRAM_H
+#define _ASTERISK_HISTOGRAM_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+#include "asterisk/time.h"
+
+/*! \brief Number of finite buckets, the last is bounded by 2^25 microseconds */
+#define AST_HISTOGRAM_BUCKETS 50
+
+struct ast_histogram;
+
+/*!
+ * \brief The contents of a histogram at one point in time
+ */
+struct ast_histogram_snapshot {
+	/*! Name of the histogram family */
+	const char *name;
+	/*! Description of the histogram family */
+	const char *help;
+	/*! Name of the label, or NULL if the family has none */
+	const char *label;
+	/*! Value of the label */
+	const char *value;
+	/*! Samples in each bucket, the last is for samples above every bound */
+	unsigned long long buckets[AST_HISTOGRAM_BUCKETS + 1];
+	/*! Number of samples */
+	unsigned long long count;
+	/*! Sum of all samples in microseconds */
+	unsigned long long sum;
+};
+
+/*!
+ * \brief Find or create a histogram
+ *
+ * \param name Name of the histogram family
+ * \param help Description of the family, used when it is created
+ * \param label Name of the family's label, or NULL for none
+ * \param value Value of the label, ignored if \a label is NULL
+ *
+ * Looking up a histogram takes locks, so callers on a hot path should look
+ * it up once and keep the reference.
+ *
+ * \return The histogram with a reference the caller must ao2_cleanup(),
+ *         or NULL on failure
+ *
+ * \since 19.0.0
+ */
+struct ast_histogram *ast_histogram_get(const char *name, const char *help,
+	const char *label, const char *value);
+
+/*!
+ * \brief Add a sample to a histogram
+ *
+ * \param histogram The histogram, may be NULL
+ * \param usec The sample in microseconds, negative samples count as 0
+ *
+ * \since 19.0.0
+ */
+void ast_histogram_record(struct ast_histogram *histogram, int64_t usec);
+
+/*!
+ * \brief Add the time elapsed since \a start to a histogram
+ *
+ * \param histogram The histogram, may be NULL
+ * \param start When the measured interval began
+ *
+ * \since 19.0.0
+ */
+static inline void ast_histogram_record_since(struct ast_histogram *histogram, struct timeval start)
+{
+	if (histogram) {
+		ast_histogram_record(histogram, ast_tvdiff_us(ast_tvnow(), start));
+	}
+}
+
+/*!
+ * \brief Get the upper bound of a bucket
+ *
+ * \param bucket Index of the bucket, below AST_HISTOGRAM_BUCKETS
+ *
+ * \return The largest sample in microseconds the bucket holds
+ *
+ * \since 19.0.0
+ */
+unsigned long long ast_histogram_bucket_bound(int bucket);
+
+/*!
+ * \brief Callback for ast_histogram_foreach()
+ *
+ * \param snapshot The histogram, valid only for the duration of the call
+ * \param first Non-zero for the first histogram of a family
+ * \param data The data passed to ast_histogram_foreach()
+ */
+typedef void (*ast_histogram_cb)(const struct ast_histogram_snapshot *snapshot,
+	int first, void *data);
+
+/*!
+ * \brief Visit every histogram
+ *
+ * \param callback Called for each histogram, grouped by family
+ * \param data Passed to the callback
+ *
+ * \since 19.0.0
+ */
+void ast_histogram_foreach(ast_histogram_cb callback, void *data);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_HISTOGRAM_H */
@@ -116,13 +116,50 @@ struct ast_websocket_protocol {
  * \brief Protocol version. This prevents dynamically loadable modules from registering
  * if this struct is changed.
  */
-#define AST_WEBSOCKET_PROTOCOL_VERSION 1
+#define AST_WEBSOCKET_PROTOCOL_VERSION 2
 	/*! \brief Protocol version. Should be set to /ref AST_WEBSOCKET_PROTOCOL_VERSION */
 	unsigned int version;
 	/*! \brief Callback called when a new session is attempted. Optional. */
 	ast_websocket_pre_callback session_attempted;
 	/* \brief Callback called when a new session is established. Mandatory. */
 	ast_websocket_callback session_established;
+	/*!
+	 * \brief Accept the permessage-deflate extension (RFC 7692) when the client offers it.
+	 * \since 19.0.0
+	 */
+	unsigned int deflate:1;
+	/*!
+	 * \brief Send frames written while another write is in progress together.
+	 * \since 19.0.0
+	 *
+	 * The writer already on the socket sends the frames queued behind it
+	 * in one system call.  A frame that got queued is reported as sent
+	 * before it reaches the socket.
+	 */
+	unsigned int coalesce:1;
+};
+
+/*!
+ * \brief Counters of a WebSocket session
+ * \since 19.0.0
+ */
+struct ast_websocket_stats {
+	/*! Data frames sent */
+	uint64_t frames_sent;
+	/*! System calls the data frames were written with */
+	uint64_t writes;
+	/*! Payload bytes of the messages that were compressed */
+	uint64_t deflate_in;
+	/*! The same payloads once compressed */
+	uint64_t deflate_out;
+	/*! Compressed payload bytes received */
+	uint64_t inflate_in;
+	/*! The same payloads once decompressed */
+	uint64_t inflate_out;
+	/*! Whether permessage-deflate was negotiated */
+	unsigned int deflate:1;
+	/*! Whether frames are coalesced */
+	unsigned int coalesce:1;
 };
 
 /*!
@@ -390,6 +427,21 @@ AST_OPTIONAL_API(int, ast_websocket_set_nonblock, (struct ast_websocket *session
  */
 AST_OPTIONAL_API(const char *, ast_websocket_session_id, (struct ast_websocket *session), { errno = ENOSYS; return NULL;});
 
+/*!
+ * \brief Get the counters of a WebSocket session.
+ * \since 19.0.0
+ *
+ * Bytes saved by compression are \c deflate_in - \c deflate_out and the system
+ * calls saved by coalescing are \c frames_sent - \c writes.
+ *
+ * \param session The WebSocket session
+ * \param[out] stats Filled in with the counters
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+AST_OPTIONAL_API(int, ast_websocket_get_stats, (struct ast_websocket *session, struct ast_websocket_stats *stats), { errno = ENOSYS; return -1;});
+
 /*!
  * \brief Result code for a websocket client.
  */
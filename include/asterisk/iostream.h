@@ -140,6 +140,21 @@ int ast_iostream_get_fd(struct ast_iostream *stream);
  */
 int ast_iostream_wait_for_input(struct ast_iostream *stream, int timeout);
 
+/*!
+ * \brief Check if an iostream already holds input that was read from its fd
+ * \since 19.0.0
+ *
+ * \details Input buffered by ast_iostream_gets() or inside the TLS layer will
+ * not make the file descriptor readable again, so polling the fd alone is not
+ * enough to know whether more input is ready.
+ *
+ * \param stream A pointer to an iostream
+ *
+ * \retval 0 if nothing is buffered
+ * \retval non-zero if input can be read without waiting on the fd
+ */
+int ast_iostream_has_buffered_input(struct ast_iostream *stream);
+
 /*!
  * \brief Make an iostream non-blocking.
  *
@@ -791,6 +791,210 @@ char *ast_json_dump_string_format(struct ast_json *root, enum ast_json_encoding_
  */
 int ast_json_dump_str_format(struct ast_json *root, struct ast_str **dst, enum ast_json_encoding_format format);
 
+/*!
+ * \brief Encode a JSON value as MessagePack.
+ * \since 19.0.0
+ *
+ * Objects become maps, arrays become arrays and strings become str
+ * values, each in the smallest form that holds it. Integers use the
+ * smallest int or uint form and reals are always float 64.
+ *
+ * Returned buffer must be freed by calling ast_json_free().
+ *
+ * \param root JSON value.
+ * \param[out] len Length of the encoding.
+ * \return Buffer holding the encoding of \a root, which is not terminated.
+ * \return \c NULL on error.
+ */
+char *ast_json_dump_msgpack(struct ast_json *root, size_t *len);
+
+/*! \brief Deepest nesting of objects and arrays an \ref ast_json_writer supports */
+#define AST_JSON_WRITER_MAX_DEPTH 63
+
+/*!
+ * \brief Writer encoding JSON straight into an \ref ast_str.
+ * \since 19.0.0
+ *
+ * Values are appended as they are written, in compact format, without
+ * building a tree of \ref ast_json values first. The first error is
+ * remembered and every write after it is ignored, so a sequence of
+ * writes only needs to be checked once with ast_json_writer_finish().
+ *
+ * \code
+ * struct ast_json_writer writer;
+ *
+ * ast_json_writer_init(&writer, &str);
+ * ast_json_writer_object_start(&writer);
+ * ast_json_writer_key(&writer, "name");
+ * ast_json_writer_string(&writer, name);
+ * ast_json_writer_object_end(&writer);
+ * if (ast_json_writer_finish(&writer)) {
+ *     ...
+ * }
+ * \endcode
+ */
+struct ast_json_writer {
+	/*! String the encoding is appended to */
+	struct ast_str **dst;
+	/*! Bit per open object or array, set once it holds a member */
+	uint64_t has_member;
+	/*! Bit per open object or array, set if it is an object */
+	uint64_t is_object;
+	/*! Number of open objects and arrays */
+	unsigned int depth;
+	/*! Set between a key and its value */
+	unsigned int after_key:1;
+	/*! Set once a write has failed */
+	unsigned int error:1;
+};
+
+/*!
+ * \brief Start writing JSON to the end of an \ref ast_str.
+ * \since 19.0.0
+ *
+ * \param writer Writer to initialize.
+ * \param dst \ref ast_str to append to. It is grown as needed.
+ */
+void ast_json_writer_init(struct ast_json_writer *writer, struct ast_str **dst);
+
+/*!
+ * \brief Check that a written value is complete.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 if every write succeeded and all objects and arrays were closed.
+ * \return -1 on error. The contents of the \ref ast_str are undefined.
+ */
+int ast_json_writer_finish(struct ast_json_writer *writer);
+
+/*!
+ * \brief Open an object.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_object_start(struct ast_json_writer *writer);
+
+/*!
+ * \brief Close the innermost open object.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_object_end(struct ast_json_writer *writer);
+
+/*!
+ * \brief Open an array.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_array_start(struct ast_json_writer *writer);
+
+/*!
+ * \brief Close the innermost open array.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_array_end(struct ast_json_writer *writer);
+
+/*!
+ * \brief Write the key of the next member of an object.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param key Key, which must be valid UTF-8.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_key(struct ast_json_writer *writer, const char *key);
+
+/*!
+ * \brief Write a string value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param value String, which must be valid UTF-8. \c NULL writes \c null.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_string(struct ast_json_writer *writer, const char *value);
+
+/*!
+ * \brief Write an integer value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param value Integer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_integer(struct ast_json_writer *writer, ast_json_int_t value);
+
+/*!
+ * \brief Write a real value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param value Real number, which must be finite.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_real(struct ast_json_writer *writer, double value);
+
+/*!
+ * \brief Write a boolean value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param value Zero for \c false, non-zero for \c true.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_boolean(struct ast_json_writer *writer, int value);
+
+/*!
+ * \brief Write a \c null value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_null(struct ast_json_writer *writer);
+
+/*!
+ * \brief Write a timeval as an ISO 8601 string, as ast_json_timeval() does.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param tv \c timeval to write.
+ * \param zone Text string of a standard system zoneinfo file. If NULL, the system localtime will be used.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_timeval(struct ast_json_writer *writer, const struct timeval tv, const char *zone);
+
+/*!
+ * \brief Write an existing JSON value.
+ * \since 19.0.0
+ *
+ * \param writer Writer.
+ * \param value JSON value to encode in place.
+ * \return 0 on success.
+ * \return -1 on error.
+ */
+int ast_json_writer_json(struct ast_json_writer *writer, struct ast_json *value);
+
 #define ast_json_dump_file(root, output) ast_json_dump_file_format(root, output, AST_JSON_COMPACT)
 
 /*!
@@ -766,4 +766,70 @@ AST_INLINE_API(int ast_atomic_dec_and_test(volatile int *p),
 
 /*! @} */
 
+/*!
+ * \brief Waits for a lock at one acquisition site, as seen by the contention profiler
+ * \since 19.0.0
+ */
+struct ast_lock_contention {
+	/*! File of the acquisition site */
+	const char *file;
+	/*! Line of the acquisition site */
+	int line;
+	/*! Function of the acquisition site */
+	const char *func;
+	/*! The expression naming the lock at the site */
+	const char *lock_name;
+	/*! "mutex", "rdlock" or "wrlock" */
+	const char *type;
+	/*! Sampled waits for the lock */
+	unsigned long waits;
+	/*! Sum of the sampled waits in microseconds */
+	unsigned long long total;
+	/*! Longest sampled wait in microseconds */
+	unsigned long long max;
+};
+
+/*!
+ * \brief Turn the lock contention profiler on or off
+ * \since 19.0.0
+ *
+ * While the profiler is on, acquiring an ast_mutex_t, an ast_rwlock_t or the
+ * lock of an ao2 object first tries the lock.  If it is busy, one in every
+ * \a rate waits is timed and added to its acquisition site.  Uncontended
+ * acquisitions cost one extra check of the rate.  The profiler is not
+ * available when Asterisk is built with DETECT_DEADLOCKS.
+ *
+ * \param rate One in how many waits to time, 0 to turn the profiler off.
+ *        Turning it on throws away the waits recorded before.
+ */
+void ast_lock_contention_set(unsigned int rate);
+
+/*!
+ * \brief Get the sampling rate of the lock contention profiler
+ * \since 19.0.0
+ *
+ * \return One in how many waits is timed, 0 if the profiler is off
+ */
+unsigned int ast_lock_contention_get(void);
+
+/*!
+ * \brief Callback for ast_lock_contention_foreach()
+ *
+ * \param contention The site, valid only for the duration of the call
+ * \param data The data passed to ast_lock_contention_foreach()
+ */
+typedef void (*ast_lock_contention_cb)(const struct ast_lock_contention *contention, void *data);
+
+/*!
+ * \brief Visit every acquisition site the contention profiler recorded waits for
+ * \since 19.0.0
+ *
+ * \param callback Called for each site
+ * \param data Passed to the callback
+ *
+ * \return Number of sampled waits that were not recorded because the table
+ *         of acquisition sites was full
+ */
+unsigned long ast_lock_contention_foreach(ast_lock_contention_cb callback, void *data);
+
 #endif /* _ASTERISK_LOCK_H */
@@ -57,6 +57,7 @@
 #define AMI_VERSION                     "9.0.0"
 #define DEFAULT_MANAGER_PORT 5038	/* Default port for Asterisk management via TCP */
 #define DEFAULT_MANAGER_TLS_PORT 5039	/* Default port for Asterisk management via TCP */
+#define DEFAULT_MANAGER_MUX_PORT 5040	/* Default port for multiplexed Asterisk management via TCP */
 
 /*! \name Constant return values
  *\note Currently, returning anything other than zero causes the session to terminate.
@@ -430,6 +431,21 @@ struct ast_str *ast_manager_build_channel_state_string_prefix(
 struct ast_str *ast_manager_build_channel_state_string(
 		const struct ast_channel_snapshot *snapshot);
 
+/*!
+ * \brief Get the AMI message body of a channel snapshot without copying it
+ * \since 19.0.0
+ *
+ * The body is formatted the first time it is requested and kept on the
+ * snapshot, so it is only valid while a reference to the snapshot is held.
+ *
+ * \param snapshot the channel snapshot for which to get the AMI message body
+ *
+ * \retval NULL on error or for internal channels
+ * \retval The AMI message body on success (must not be freed by caller)
+ */
+const char *ast_manager_channel_state_str(
+		const struct ast_channel_snapshot *snapshot);
+
 /*! \brief Struct representing a snapshot of bridge state */
 struct ast_bridge_snapshot;
 
@@ -74,6 +74,9 @@ int ast_media_cache_exists(const char *uri);
  * it will be used as the destination file for the retrieval. When retrieval
  * of the media from the backend is complete, \c file_path is then populated
  * as before.
+ *
+ * Concurrent retrievals of the same \c uri share a single request to the
+ * backend.
  */
 int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
 	char *file_path, size_t len);
@@ -158,6 +161,22 @@ int ast_media_cache_create_or_update(const char *uri, const char *file_path,
  */
 int ast_media_cache_delete(const char *uri);
 
+/*!
+ * \brief Retrieve an item into the media cache in the background
+ * \since 19
+ *
+ * \param uri The unique URI for the media
+ *
+ * \details
+ * The item is retrieved as by \ref ast_media_cache_retrieve by a pool of
+ * threads, and the \c MediaCachePrefetch AMI event is raised when it is
+ * complete.
+ *
+ * \retval 0 the retrieval was queued
+ * \retval -1 error
+ */
+int ast_media_cache_prefetch(const char *uri);
+
 /*!
  * \brief Initialize the media cache
  *
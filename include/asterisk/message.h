@@ -337,6 +337,30 @@ const char *ast_msg_get_tech(const struct ast_msg *msg);
  */
 const char *ast_msg_get_endpoint(const struct ast_msg *msg);
 
+/*!
+ * \brief Retrieve the dialplan context a message is routed to
+ *
+ * \since 19.0.0
+ *
+ * \param msg The message to get the context from
+ *
+ * \retval The context of the message
+ * \retval NULL or empty string if the message has no context
+ */
+const char *ast_msg_get_context(const struct ast_msg *msg);
+
+/*!
+ * \brief Retrieve the dialplan extension a message is routed to
+ *
+ * \since 19.0.0
+ *
+ * \param msg The message to get the extension from
+ *
+ * \retval The extension of the message
+ * \retval NULL or empty string if the message has no extension
+ */
+const char *ast_msg_get_exten(const struct ast_msg *msg);
+
 /*!
  * \brief Determine if a particular message has a destination via some handler
  *
@@ -90,6 +90,20 @@ struct ast_format_def {
 	int buf_size;			/*!< size of frame buffer, if any, aligned to 8 bytes. */
 	int desc_size;			/*!< size of private descriptor, if any */
 
+	/*!
+	 * For headerless formats made of fixed size frames, the bytes and
+	 * samples of the frames read.  When set, and map_sound_files is enabled
+	 * in asterisk.conf, files are played from a memory mapping of the file
+	 * without calling read, seek and tell.
+	 */
+	int frame_bytes;
+	int frame_samples;
+	/*!
+	 * Bytes the last frame of a file can be cut to when the file does not
+	 * end on a whole frame, 0 if only whole frames can be played.
+	 */
+	int frame_unit_bytes;
+
 	struct ast_module *module;
 };
 
@@ -124,6 +138,16 @@ struct ast_filestream {
 	void *_private;	/*!< pointer to private buffer */
 	const char *orig_chan_name;
 	char *write_buffer;
+	/*! Cached file the stream plays from instead of reading f, if any */
+	struct ast_filestream_cache *cache;
+	/*! Index of the next cached frame to play */
+	size_t cache_pos;
+	/*! Memory mapping of the file the stream plays from instead of reading f, if any */
+	unsigned char *map;
+	/*! Size of the mapped file */
+	size_t map_size;
+	/*! Offset of the next frame to play in the mapped file */
+	size_t map_pos;
 };
 
 /*!
@@ -144,6 +168,51 @@ int __ast_format_def_register(const struct ast_format_def *f, struct ast_module
  */
 int ast_format_def_unregister(const char *name);
 
+/*!
+ * \brief A place other than the file system that recordings can be streamed to.
+ * \since 19.0.0
+ *
+ * A file name starting with the scheme of a registered sink followed by
+ * \c :// is written by ast_writefile() to the FILE the sink opens for it
+ * instead of to the file system.  The encoded audio is written once in
+ * order, so seeking is not possible and formats that update their header
+ * when closed do not get to.  Closing the FILE ends the recording.
+ */
+struct ast_file_sink {
+	/*! URI scheme handled by the sink */
+	char scheme[32];
+	/*!
+	 * \brief Open a stream to write a recording to
+	 * \param uri The URI of the recording, extension included
+	 * \param mime_type The MIME type of the format written, or NULL if unknown
+	 * \return A FILE opened for writing, or NULL on failure
+	 */
+	FILE *(*open)(const char *uri, const char *mime_type);
+	struct ast_module *module;
+	AST_RWLIST_ENTRY(ast_file_sink) list;
+};
+
+/*!
+ * \brief Register a sink for recordings
+ * \since 19.0.0
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int __ast_file_sink_register(const struct ast_file_sink *sink, struct ast_module *mod);
+#define ast_file_sink_register(sink) __ast_file_sink_register(sink, AST_MODULE_SELF)
+
+/*!
+ * \brief Unregister the sink for a URI scheme
+ * \since 19.0.0
+ *
+ * \param scheme The scheme the sink was registered for
+ *
+ * \retval 0 on success
+ * \retval -1 if no sink is registered for the scheme
+ */
+int ast_file_sink_unregister(const char *scheme);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
@@ -248,6 +248,17 @@ int ast_update_module_list_condition(int (*modentry)(const char *module, const c
  */
 int ast_module_check(const char *name);
 
+/*!
+ * \brief Get how long the load function of a module took to run
+ * \since 19.0.0
+ *
+ * \param name Module name, like "chan_sip.so"
+ *
+ * \return Time spent starting the module in microseconds
+ * \retval -1 if the module is not running
+ */
+int64_t ast_module_load_time(const char *name);
+
 /*!
  * \brief Add a procedure to be run when modules have been updated.
  * \param updater The function to run when modules have been updated.
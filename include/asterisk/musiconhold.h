@@ -42,10 +42,32 @@ extern "C" {
  */
 int ast_moh_start(struct ast_channel *chan, const char *mclass, const char *interpclass);
 
+/*!
+ * \brief Turn on music on hold on a given channel, sharing the class with other channels
+ * \since 21
+ *
+ * Like ast_moh_start(), but a 'files' or 'playlist' class is played as if
+ * its 'broadcast' option was set.  All channels started this way on a class
+ * hear the same point of one timeline, read and encoded once per codec,
+ * instead of a file stream and translator each.
+ *
+ * \param chan The channel structure that will get music on hold
+ * \param mclass The class to use if the musicclass is not currently set on
+ *               the channel structure.  NULL and the empty string are equivalent.
+ * \param interpclass The class to use if the musicclass is not currently set on
+ *                    the channel structure or in the mclass argument.
+ *                    NULL and the empty string are equivalent.
+ *
+ * \retval Zero on success
+ * \retval non-zero on failure
+ */
+int ast_moh_start_shared(struct ast_channel *chan, const char *mclass, const char *interpclass);
+
 /*! \brief Turn off music on hold on a given channel */
 void ast_moh_stop(struct ast_channel *chan);
 
 void ast_install_music_functions(int (*start_ptr)(struct ast_channel *, const char *, const char *),
+				 int (*start_shared_ptr)(struct ast_channel *, const char *, const char *),
 				 void (*stop_ptr)(struct ast_channel *),
 				 void (*cleanup_ptr)(struct ast_channel *));
 
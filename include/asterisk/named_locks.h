@@ -47,8 +47,13 @@
  *
  * To use a named lock:
  * 	Call ast_named_lock_get with the appropriate keyspace and key.
- * 	Use the standard ao2 lock/unlock functions as needed.
+ * 	Use ast_named_lock_lock/ast_named_lock_unlock, or the standard ao2
+ * 	lock/unlock functions, as needed.
  * 	Call ao2_cleanup when you're finished with it.
+ *
+ * The locks are spread over several independently locked tables by key,
+ * and the most recently used locks of each table are kept alive so a key
+ * that is locked over and over does not allocate a new lock every time.
  */
 
 /*!
@@ -84,6 +89,33 @@ struct ast_named_lock *__ast_named_lock_get(const char *filename, int lineno, co
 	__ast_named_lock_get(__FILE__, __LINE__, __PRETTY_FUNCTION__, lock_type, \
 		keyspace, key)
 
+int __ast_named_lock_lock(struct ast_named_lock *lock, const char *filename, int lineno,
+	const char *func);
+
+/*!
+ * \brief Lock a named lock, counting contention
+ * \since 19.0.0
+ *
+ * \param lock The pointer to the ast_named_lock structure returned by ast_named_lock_get
+ *
+ * Takes the lock exclusively like ao2_lock().  When the lock is already
+ * held the wait is added to the lock's contention counters, shown by
+ * "core show named locks".
+ *
+ * \retval 0 on success
+ * \retval non-zero on error
+ */
+#define ast_named_lock_lock(lock) \
+	__ast_named_lock_lock(lock, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+/*!
+ * \brief Unlock a named lock
+ * \since 19.0.0
+ *
+ * \param lock The pointer to the ast_named_lock structure returned by ast_named_lock_get
+ */
+#define ast_named_lock_unlock(lock) ao2_unlock(lock)
+
 /*!
  * \brief Put a named lock handle away
  * \since 13.9.0
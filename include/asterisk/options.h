@@ -186,6 +186,14 @@ extern struct ast_flags ast_options;
 
 extern int option_verbose;
 extern int ast_option_maxfiles;		/*!< Max number of open file handles (files, sockets) */
+extern unsigned int ast_option_file_cache_size;	/*!< Size in MB of the played sound file cache */
+extern unsigned int ast_option_generator_threads;	/*!< Number of threads running shareable generators, 0 to run them on channel timers */
+extern unsigned int ast_option_astdb_cache;	/*!< Serve astdb reads from an in-memory copy */
+extern unsigned int ast_option_astdb_write_behind;	/*!< Milliseconds astdb writes are batched before going to disk, 0 to write at once */
+extern unsigned int ast_option_sounds_index;	/*!< Look up sound files in an index of the sounds directory */
+extern unsigned int ast_option_map_sound_files;	/*!< Play headerless sound files from a memory mapping */
+extern unsigned int ast_option_security_event_limit;	/*!< Security events of each type reported per remote address and interval, 0 for no limit */
+extern unsigned int ast_option_security_event_interval;	/*!< Seconds in a security event rate limiting interval */
 extern int option_debug;		/*!< Debugging */
 extern int option_trace;		/*!< Debugging */
 extern int ast_option_maxcalls;		/*!< Maximum number of simultaneous channels */
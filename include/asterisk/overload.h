@@ -0,0 +1,68 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief System overload level
+ *
+ * Combines the signals of an overloaded system into one level subsystems
+ * can shed optional work on: the taskprocessor alerts, the load average
+ * against the maxload option of asterisk.conf and the free memory against
+ * its minmemfree option.  The level is sampled at most once a second, so
+ * getting it is cheap enough for every request.
+ */
+
+#ifndef _ASTERISK_OVERLOAD_H
+#define _ASTERISK_OVERLOAD_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/*! \brief How overloaded the system is */
+enum ast_overload_level {
+	/*! Not overloaded */
+	AST_OVERLOAD_NONE = 0,
+	/*!
+	 * \brief Taskprocessors are backed up, or the load or the free memory
+	 * are nearing their limits.  New work should be deferred.
+	 */
+	AST_OVERLOAD_HIGH,
+	/*!
+	 * \brief The load or the free memory are past their limits.  Optional
+	 * work should be refused.
+	 */
+	AST_OVERLOAD_CRITICAL,
+};
+
+/*!
+ * \brief Get the overload level of the system.
+ * \since 19.0.0
+ *
+ * \return The overload level, at most a second old.
+ */
+enum ast_overload_level ast_overload_level_get(void);
+
+/*!
+ * \brief Get the name of an overload level.
+ * \since 19.0.0
+ */
+const char *ast_overload_level_str(enum ast_overload_level level);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_OVERLOAD_H */
@@ -308,6 +308,25 @@ void ast_context_set_autohints(struct ast_context *con, int enabled);
  */
 void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable, const char *registrar);
 
+/*!
+ * \brief Merge the temporary contexts into the global contexts list, replacing
+ *        only the named contexts of a registrar
+ *
+ * \param extcontexts pointer to the ast_context structure
+ * \param exttable pointer to the ast_hashtab structure that contains all the elements in extcontexts
+ * \param registrar of the contexts being replaced
+ * \param changed string container, see ast_str_container_alloc(), of the names of
+ *        the contexts to replace
+ *
+ * Works like ast_merge_contexts_and_delete() for the contexts named in \a changed,
+ * which should be the contexts in \a extcontexts plus any that were removed.  All
+ * other contexts are kept exactly as they are, along with their hints and watchers.
+ *
+ * \since 19.0.0
+ */
+void ast_merge_changed_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable,
+	const char *registrar, struct ao2_container *changed);
+
 /*!
  * \brief Destroy a context by name
  *
@@ -1152,6 +1171,7 @@ enum ast_pbx_outgoing_sync {
 	AST_OUTGOING_NO_WAIT = 0,       /*!< Don't wait for originated call to answer */
 	AST_OUTGOING_WAIT = 1,          /*!< Wait for originated call to answer */
 	AST_OUTGOING_WAIT_COMPLETE = 2, /*!< Wait for originated call to answer and hangup */
+	AST_OUTGOING_WAIT_INLINE = 3,   /*!< Wait for originated call to answer, dialing from the calling thread */
 };
 
 /*!
@@ -1173,6 +1193,8 @@ enum ast_pbx_outgoing_sync {
  *        the call fails.
  *        If \c AST_OUTGOING_WAIT_COMPLETE then wait for the call to complete or
  *        fail.
+ *        If \c AST_OUTGOING_WAIT_INLINE then block like \c AST_OUTGOING_WAIT, but
+ *        dial from the calling thread and only start a thread once answered.
  *        If \c AST_OUTGOING_WAIT or \c AST_OUTGOING_WAIT_COMPLETE is specified,
  *        the call doesn't answer, and \c failed@context exists then run a channel
  *        named \c OutgoingSpoolFailed at \c failed@context.
@@ -1221,6 +1243,8 @@ int ast_pbx_outgoing_exten_predial(const char *type, struct ast_format_cap *cap,
  *        the call fails.
  *        If \c AST_OUTGOING_WAIT_COMPLETE then wait for the call to complete or
  *        fail.
+ *        If \c AST_OUTGOING_WAIT_INLINE then block like \c AST_OUTGOING_WAIT, but
+ *        dial from the calling thread and only start a thread once answered.
  * \param cid_num The caller ID number to set on the outbound channel
  * \param cid_name The caller ID name to set on the outbound channel
  * \param vars Variables to set on the outbound channel
@@ -1245,6 +1269,139 @@ int ast_pbx_outgoing_app_predial(const char *type, struct ast_format_cap *cap, c
 	const char *account, struct ast_channel **locked_channel,
 	const struct ast_assigned_ids *assignedids, const char *predial_callee);
 
+/*! \brief A batch of outbound calls placed from a shared pool of threads */
+struct ast_pbx_outgoing_batch;
+
+/*!
+ * \brief Outcome of one call of an outgoing batch
+ * \since 19
+ */
+struct ast_pbx_outgoing_batch_result {
+	/*! Position of the target in the batch, starting at 0 */
+	int index;
+	/*! Channel technology that was dialed */
+	const char *type;
+	/*! Address that was dialed */
+	const char *addr;
+	/*! Name of the outbound channel, NULL if the call failed */
+	const char *channel;
+	/*! Uniqueid of the outbound channel, NULL if the call failed and no id was assigned */
+	const char *uniqueid;
+	/*! 0 if the call was answered, -1 otherwise */
+	int res;
+	/*! Dialed status of the call as returned by ast_pbx_outgoing_exten() */
+	int reason;
+};
+
+/*!
+ * \brief Callback raised as each call of an outgoing batch is answered or fails
+ * \since 19
+ *
+ * \note This is called from the threads placing the calls, possibly from several
+ * of them at the same time.
+ */
+typedef void (*ast_pbx_outgoing_batch_result_cb)(const struct ast_pbx_outgoing_batch_result *result, void *data);
+
+/*!
+ * \brief Callback raised once the last call of an outgoing batch is answered or fails
+ * \since 19
+ *
+ * \note This is called after every result callback has returned and is the last
+ * use of the callback data, which it may free.
+ */
+typedef void (*ast_pbx_outgoing_batch_complete_cb)(void *data);
+
+/*!
+ * \brief What every call of an outgoing batch does
+ * \since 19
+ */
+struct ast_pbx_outgoing_batch_options {
+	/*! The destination context, extension and priority of answered calls */
+	const char *context;
+	const char *exten;
+	int priority;
+	/*! The application to execute on answered calls instead of an extension */
+	const char *app;
+	const char *appdata;
+	/*! How long to dial each call in milliseconds */
+	int timeout;
+	/*! The caller ID number and name to set on the outbound channels */
+	const char *cid_num;
+	const char *cid_name;
+	/*! The accountcode for the outbound channels */
+	const char *account;
+	/*! Variables to set on the outbound channels, copied by the batch */
+	struct ast_variable *vars;
+	/*! The format capabilities for the outbound channels */
+	struct ast_format_cap *cap;
+	/*! If non-zero the channels "answer" when progress is indicated, extensions only */
+	int early_media;
+	/*! Maximum number of calls started per second, 0 for no limit */
+	unsigned int cps;
+	/*! Maximum number of calls dialing at once, 0 for no limit */
+	unsigned int max_concurrent;
+	/*! Called with the outcome of each call, optional */
+	ast_pbx_outgoing_batch_result_cb result_cb;
+	/*! Called once all calls are done, optional */
+	ast_pbx_outgoing_batch_complete_cb complete_cb;
+	/*! Passed to the callbacks */
+	void *data;
+};
+
+/*!
+ * \brief Create a batch of outbound calls
+ * \since 19
+ *
+ * \param options What every call of the batch does
+ *
+ * \note Targets are added with ast_pbx_outgoing_batch_add() and the batch is
+ * then placed with ast_pbx_outgoing_batch_start().  Each call is placed as if
+ * by ast_pbx_outgoing_exten() or ast_pbx_outgoing_app() with
+ * \c AST_OUTGOING_WAIT_INLINE from a pool of threads shared by all batches, so
+ * a thread is only started for a call once it is answered.  Calls are started in the order
+ * the targets were added, no faster than \a cps allows.
+ *
+ * \return The batch, an ao2 object, or NULL on failure
+ */
+struct ast_pbx_outgoing_batch *ast_pbx_outgoing_batch_create(const struct ast_pbx_outgoing_batch_options *options);
+
+/*!
+ * \brief Add a call to an outgoing batch that has not been started
+ * \since 19
+ *
+ * \param batch The batch
+ * \param type The channel technology to create
+ * \param addr Address data to pass to the channel technology driver
+ * \param channelid Optional. The uniqueid to assign the channel.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int ast_pbx_outgoing_batch_add(struct ast_pbx_outgoing_batch *batch, const char *type,
+	const char *addr, const char *channelid);
+
+/*!
+ * \brief Start placing the calls of an outgoing batch
+ * \since 19
+ *
+ * \note Once this succeeds the complete callback is guaranteed to be called.
+ * The caller may drop its reference to the batch, which lives until the last
+ * call is done.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int ast_pbx_outgoing_batch_start(struct ast_pbx_outgoing_batch *batch);
+
+/*!
+ * \brief Stop starting new calls of an outgoing batch
+ * \since 19
+ *
+ * \note Calls already dialing are left to finish.  Calls not yet started are
+ * dropped without a result.
+ */
+void ast_pbx_outgoing_batch_cancel(struct ast_pbx_outgoing_batch *batch);
+
 /*!
  * \brief Evaluate a condition
  *
@@ -1400,6 +1557,38 @@ int pbx_builtin_raise_exception(struct ast_channel *chan, const char *data);
 void pbx_substitute_variables_helper(struct ast_channel *c, const char *cp1, char *cp2, int count);
 void pbx_substitute_variables_varshead(struct varshead *headp, const char *cp1, char *cp2, int count);
 void pbx_substitute_variables_helper_full(struct ast_channel *c, struct varshead *headp, const char *cp1, char *cp2, int cp2_size, size_t *used);
+
+/*!
+ * \brief A variable substitution template parsed ahead of time
+ * \since 19.0.0
+ */
+struct pbx_substitute_template;
+
+/*!
+ * \brief Parse a template for repeated substitution.
+ * \since 19.0.0
+ *
+ * \param cp1 Variable template to parse.
+ *
+ * \details
+ * The literal text, variable references, function calls and expressions
+ * of the template are located once so that expanding it with
+ * pbx_substitute_template_helper_full() does not need to scan it again.
+ *
+ * \return ao2 template object or NULL on allocation failure.
+ */
+struct pbx_substitute_template *pbx_substitute_template_compile(const char *cp1);
+
+/*!
+ * \brief Expand a template parsed by pbx_substitute_template_compile().
+ * \since 19.0.0
+ *
+ * \details
+ * Gives the same result as pbx_substitute_variables_helper_full() for
+ * the original template text.
+ */
+void pbx_substitute_template_helper_full(struct ast_channel *c, struct varshead *headp,
+	const struct pbx_substitute_template *templ, char *cp2, int count, size_t *used);
 /*! @} */
 /*! @} */
 
@@ -1453,6 +1642,32 @@ int pbx_set_autofallthrough(int newval);
   the old linear-search algorithm.  Returns previous value. */
 int pbx_set_extenpatternmatchnew(int newval);
 
+/*!
+ * \brief Set the "extenmatchcache" flag.
+ *
+ * \param newval Non-zero to memoize the pattern trie lookups of each context.
+ *
+ * \note Enabling the cache implies the Trie-based pattern matcher.
+ *
+ * \return Previous value.
+ *
+ * \since 19.0.0
+ */
+int pbx_set_extenmatchcache(int newval);
+
+/*!
+ * \brief Set the "hintnotifywindow" value.
+ *
+ * \param newval Milliseconds device state notifications of a hint are
+ * held for, so changes within the window result in one. 0 notifies
+ * immediately.
+ *
+ * \return Previous value.
+ *
+ * \since 19.0.0
+ */
+int pbx_set_hintnotifywindow(int newval);
+
 /*! Set "overrideswitch" field.  If set and of nonzero length, all contexts
  * will be tried directly through the named switch prior to any other
  * matching within that context.
@@ -48,6 +48,32 @@ int ast_can_pickup(struct ast_channel *chan);
  */
 struct ast_channel *ast_pickup_find_by_group(struct ast_channel *chan);
 
+/*!
+ * \brief Update the entry of a channel in the pickup index
+ * \since 19.0.0
+ *
+ * \param chan Channel whose state or call groups changed.
+ *
+ * \details
+ * Channels in a state allowing pickup are indexed by their call groups
+ * and named call groups so a pickup only looks at the channels in its
+ * pickup groups.
+ *
+ * \note Only the channel core calls this, whenever the state or the call
+ * groups of a channel are set.
+ */
+void ast_pickup_index_update(struct ast_channel *chan);
+
+/*!
+ * \brief Remove a channel from the pickup index
+ * \since 19.0.0
+ *
+ * \param chan Channel going away.
+ *
+ * \note Only the channel core calls this, when it unlinks a channel.
+ */
+void ast_pickup_index_remove(struct ast_channel *chan);
+
 /*!
  * \brief Pickup a call
  *
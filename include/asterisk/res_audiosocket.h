@@ -84,4 +84,103 @@ const int ast_audiosocket_send_frame(const int svc, const struct ast_frame *f);
  */
 struct ast_frame *ast_audiosocket_receive_frame(const int svc);
 
+/*!
+ * \brief A stream on a multiplexed AudioSocket connection
+ *
+ * Streams to the same server share one TCP connection.  The connection
+ * starts with a message of kind 0x02 and no payload, after which every
+ * message in both directions carries the stream id between the kind and
+ * the length: kind (1 byte), stream id (2 bytes), length (2 bytes),
+ * payload.  The kinds are those of a plain AudioSocket connection.  The
+ * connection is read by a shared pool of threads, and frames written by
+ * many streams at once are sent in one write.
+ *
+ * \since 19.0.0
+ */
+struct ast_audiosocket_stream;
+
+/*!
+ * \brief Open a stream to an AudioSocket server
+ *
+ * Uses the multiplexed connection to the server, connecting if there is none.
+ *
+ * \param server The server address, including port.
+ * \param chan An optional channel which will be put into autoservice if a
+ * connection has to be made.  If there is no channel to be autoserviced,
+ * pass NULL instead.
+ *
+ * \return The stream on success, to be closed with ast_audiosocket_stream_close()
+ * \retval NULL on error
+ *
+ * \since 19.0.0
+ */
+struct ast_audiosocket_stream *ast_audiosocket_stream_open(const char *server,
+	struct ast_channel *chan);
+
+/*!
+ * \brief Send the initial message of a stream to its AudioSocket server
+ *
+ * \param stream The stream.
+ * \param id The UUID to send to the AudioSocket server to uniquely identify this stream.
+ *
+ * \retval 0 on success
+ * \retval -1 on error
+ *
+ * \since 19.0.0
+ */
+const int ast_audiosocket_stream_init(struct ast_audiosocket_stream *stream, const char *id);
+
+/*!
+ * \brief Send an Asterisk audio frame on a stream
+ *
+ * The frame is dropped rather than blocking if the connection is backed up.
+ *
+ * \param stream The stream.
+ * \param f The Asterisk audio frame to send.
+ *
+ * \retval 0 on success
+ * \retval -1 on error
+ *
+ * \since 19.0.0
+ */
+const int ast_audiosocket_stream_send_frame(struct ast_audiosocket_stream *stream,
+	const struct ast_frame *f);
+
+/*!
+ * \brief Receive an Asterisk frame from a stream
+ *
+ * This returned object is a pointer to an Asterisk frame which must be
+ * manually freed by the caller.
+ *
+ * \param stream The stream.
+ *
+ * \retval A \ref ast_frame on success, &ast_null_frame if none is waiting
+ * \retval NULL once the server or the connection ended the stream
+ *
+ * \since 19.0.0
+ */
+struct ast_frame *ast_audiosocket_stream_receive_frame(struct ast_audiosocket_stream *stream);
+
+/*!
+ * \brief Get the file descriptor signalling a stream can be read
+ *
+ * \param stream The stream.
+ *
+ * \return A file descriptor to wait on, for example as a channel fd
+ *
+ * \since 19.0.0
+ */
+int ast_audiosocket_stream_fd(struct ast_audiosocket_stream *stream);
+
+/*!
+ * \brief End a stream
+ *
+ * Tells the server the stream ended and releases it.
+ *
+ * \param stream The stream, may be NULL.
+ *
+ * \since 19.0.0
+ */
+void ast_audiosocket_stream_close(struct ast_audiosocket_stream *stream);
+
 #endif /* _ASTERISK_RES_AUDIOSOCKET_H */
@@ -0,0 +1,47 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief cURL resource engine
+ */
+
+#ifndef _ASTERISK_RES_CURL_H
+#define _ASTERISK_RES_CURL_H
+
+#include <curl/curl.h>
+
+/*!
+ * \brief Perform a transfer on the shared connection pool
+ *
+ * \param curl The easy handle of the transfer, set up as it would be for
+ * curl_easy_perform()
+ *
+ * The transfer is run by the res_curl transfer thread, which keeps
+ * connections to servers open and reuses them for transfers of every
+ * module, within the per host limits of res_curl.conf.  The calling
+ * thread waits for the transfer to complete, and the callbacks of the
+ * handle are called from the transfer thread while it does.
+ *
+ * \note The handle must not be used by another thread while the transfer
+ * is in progress.  It can be used for further transfers afterwards.
+ *
+ * \return the result of the transfer, as curl_easy_perform() would return
+ *
+ * \since 19.0.0
+ */
+CURLcode ast_curl_perform(CURL *curl);
+
+#endif /* _ASTERISK_RES_CURL_H */
@@ -42,6 +42,8 @@ enum {
 	RES_ODBC_CONNECTED = (1 << 2),
 };
 
+struct odbc_stmt;
+
 /*! \brief ODBC container */
 struct odbc_obj {
 	SQLHDBC  con;                   /*!< ODBC Connection Handle */
@@ -52,6 +54,8 @@ struct odbc_obj {
 	int lineno;
 #endif
 	char *sql_text;					/*!< The SQL text currently executing */
+	AST_LIST_HEAD_NOLOCK(, odbc_stmt) stmts;	/*!< Prepared statements kept for reuse, most recently used first */
+	unsigned int stmt_count;			/*!< The number of prepared statements kept */
 	AST_LIST_ENTRY(odbc_obj) list;
 };
 
@@ -170,6 +174,62 @@ SQLHSTMT ast_odbc_prepare_and_execute(struct odbc_obj *obj, SQLHSTMT (*prepare_c
  */
 int ast_odbc_prepare(struct odbc_obj *obj, SQLHSTMT *stmt, const char *sql);
 
+/*!
+ * \brief Returns a statement prepared with the given SQL, reusing one prepared earlier on the connection
+ * \since 19
+ *
+ * \param obj The ODBC object
+ * \param sql The SQL query
+ *
+ * \retval a statement handle
+ * \retval NULL on error
+ *
+ * Statements are kept per connection and looked up by their SQL text, up to
+ * the stmt_cache limit of the class. A reused statement has no parameters or
+ * columns bound and no open cursor.
+ *
+ * \note The statement must be released using ast_odbc_release_stmt() instead of SQLFreeHandle
+ */
+SQLHSTMT ast_odbc_prepare_cached(struct odbc_obj *obj, const char *sql);
+
+/*!
+ * \brief Releases a statement handle
+ * \since 19
+ *
+ * \param obj The ODBC object the statement was allocated on
+ * \param stmt The statement
+ *
+ * A statement from ast_odbc_prepare_cached() is kept on the connection for
+ * reuse, any other statement is freed.
+ */
+void ast_odbc_release_stmt(struct odbc_obj *obj, SQLHSTMT stmt);
+
+/*!
+ * \brief Callback invoked by ast_odbc_execute_async()
+ *
+ * \param obj A connection from the requested class, NULL if none could be obtained
+ * \param data The data passed to ast_odbc_execute_async()
+ *
+ * \note The connection is released once the callback returns
+ */
+typedef void (*ast_odbc_async_cb)(struct odbc_obj *obj, void *data);
+
+/*!
+ * \brief Runs a callback with a connection from a class on the res_odbc thread pool
+ * \since 19
+ *
+ * \param name The name of the res_odbc.conf section describing the database to connect to
+ * \param callback The callback to invoke
+ * \param data Data to pass to the callback, owned by the callback once this succeeds
+ *
+ * \retval 0 the callback will be invoked
+ * \retval -1 failure, the callback will not be invoked
+ *
+ * The calling thread does not wait for a connection or for the query, which
+ * makes this suited to statements whose outcome the caller does not need.
+ */
+int ast_odbc_execute_async(const char *name, ast_odbc_async_cb callback, void *data);
+
 /*! \brief Execute a nonprepared SQL query.
  * \param obj The ODBC object
  * \param sql The SQL query
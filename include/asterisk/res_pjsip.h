@@ -345,7 +345,10 @@ struct ast_sip_contact_status {
 		/*! The name of the aor this contact_status belongs to */
 		AST_STRING_FIELD(aor);
 	);
-	/*! The round trip time in microseconds */
+	/*!
+	 * The round trip time in microseconds
+	 * \note Updated in place by qualify results that do not change the status
+	 */
 	int64_t rtt;
 	/*! Current status for a contact (default - unavailable) */
 	enum ast_sip_contact_status_type status;
@@ -2361,6 +2364,59 @@ struct ast_sip_endpoint *ast_sip_identify_endpoint(pjsip_rx_data *rdata);
  */
 char *ast_sip_rdata_get_header_value(pjsip_rx_data *rdata, const pj_str_t str);
 
+/*!
+ * \brief Find a header in an incoming SIP message by name
+ * \since 19.0.0
+ *
+ * This is a replacement for pjsip_msg_find_hdr_by_name() on received
+ * messages.  The first call for a message indexes all of its headers
+ * by name, so every later lookup by any module handling the same
+ * message avoids scanning the header list again.  Names match the
+ * full or compact form case insensitively, as pjsip does.
+ *
+ * \param rdata The incoming message
+ * \param name The header name to find
+ * \param prev NULL to get the first header with this name, otherwise a
+ *        header previously returned to get the one following it
+ *
+ * \retval NULL No (further) header of that name
+ * \retval non-NULL The header
+ *
+ * \note Headers added to or removed from the message after its first
+ * lookup are not seen.  A cloned rdata must have its index cleared with
+ * ast_sip_rdata_header_cache_reset() before use.
+ */
+void *ast_sip_rdata_find_header(pjsip_rx_data *rdata, const pj_str_t *name, const void *prev);
+
+/*!
+ * \brief Get the first header of a name parsed as a name-addr
+ * \since 19.0.0
+ *
+ * Headers such as P-Asserted-Identity, Remote-Party-ID and Diversion
+ * are kept by pjsip as plain strings.  This parses the first header of
+ * the given name as if it were a From header.  The result is cached
+ * with the message so later callers share the same parsed header.
+ *
+ * \param rdata The incoming message
+ * \param name The header name to find
+ *
+ * \retval NULL No such header or it could not be parsed
+ * \retval non-NULL The parsed header, which must not be modified
+ */
+pjsip_fromto_hdr *ast_sip_rdata_get_fromto_header(pjsip_rx_data *rdata, const pj_str_t *name);
+
+/*!
+ * \brief Forget the header index of an incoming SIP message
+ * \since 19.0.0
+ *
+ * pjsip_rx_data_clone() copies the module data of the original
+ * message, which includes a pointer to its header index.  Call this on
+ * the clone so it indexes its own copy of the headers.
+ *
+ * \param rdata The incoming message
+ */
+void ast_sip_rdata_header_cache_reset(pjsip_rx_data *rdata);
+
 /*!
  * \brief Set the outbound proxy for an outbound SIP message
  *
@@ -3133,6 +3189,24 @@ unsigned int ast_sip_get_keep_alive_interval(void);
  */
 unsigned int ast_sip_get_contact_expiration_check_interval(void);
 
+/*!
+ * \brief Retrieve the system contact refresh write delay setting.
+ * \since 19.0.0
+ *
+ * \retval the number of seconds a contact refresh may wait before being stored.
+ * \retval 0 if contact refreshes are stored immediately.
+ */
+unsigned int ast_sip_get_contact_refresh_write_delay(void);
+
+/*!
+ * \brief Retrieve the global outbound registration rate setting.
+ * \since 19.0.0
+ *
+ * \retval the maximum number of outbound REGISTER requests scheduled per second.
+ * \retval 0 if outbound REGISTER requests are not paced.
+ */
+unsigned int ast_sip_get_outbound_registration_rate(void);
+
 /*!
  * \brief Retrieve the system setting 'disable multi domain'.
  * \since 13.9.0
@@ -3341,6 +3415,17 @@ void ast_sip_modify_id_header(pj_pool_t *pool, pjsip_fromto_hdr *id_hdr,
 void ast_sip_get_unidentified_request_thresholds(unsigned int *count, unsigned int *period,
 	unsigned int *prune_interval);
 
+/*!
+ * \brief Retrieve the per source address flood protection thresholds
+ * \since 19.0.0
+ *
+ * \param rate The sustained number of requests per second accepted from a source, 0 if not limited
+ * \param burst The number of requests a source may send at once
+ * \param ban_time The number of seconds a flooding source is banned for, 0 if not banned
+ */
+void ast_sip_get_flood_thresholds(unsigned int *rate, unsigned int *burst,
+	unsigned int *ban_time);
+
 /*!
  * \brief Get the transport name from an endpoint or request uri
  * \since 13.15.0
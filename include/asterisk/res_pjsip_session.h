@@ -239,6 +239,12 @@ struct ast_sip_session {
 	unsigned int authentication_challenge_count:4;
 	/*! The direction of the call respective to Asterisk */
 	enum ast_sip_session_call_direction call_direction;
+	/*! When the initial INVITE was sent or received, zero once it has a final response */
+	struct timeval invite_start;
+	/*! Which provisional and final responses to the initial INVITE have been timed */
+	unsigned int invite_responses_timed:3;
+	/*! The last offer received repeated the active remote SDP and was answered with the active local SDP */
+	unsigned int sdp_unchanged:1;
 };
 
 typedef int (*ast_sip_session_request_creation_cb)(struct ast_sip_session *session, pjsip_tx_data *tdata);
@@ -31,6 +31,26 @@ struct ast_srtp_cb {
 	int (*no_ctx)(struct ast_rtp_instance *rtp, unsigned long ssrc, void *data);
 };
 
+/*!
+ * \brief A packet processed by a batched protect or unprotect call
+ *
+ * Packets are processed in place, so for protect \a buf must have room for
+ * the authentication tag and MKI past \a len, up to \a size bytes.
+ * Consecutive packets may belong to the same or to different sessions.
+ */
+struct ast_srtp_packet {
+	/*! Session the packet belongs to */
+	struct ast_srtp *srtp;
+	/*! Packet data */
+	void *buf;
+	/*! Length of the packet, updated with the processed length */
+	int len;
+	/*! Space available at \a buf */
+	int size;
+	/*! 0 once processed, -1 if the packet failed and must be dropped */
+	int res;
+};
+
 struct ast_srtp_res {
 	/*! Create a new SRTP session for an RTP instance with a default policy */
 	int (*create)(struct ast_srtp **srtp, struct ast_rtp_instance *rtp, struct ast_srtp_policy *policy);
@@ -50,6 +70,10 @@ struct ast_srtp_res {
 	int (*protect)(struct ast_srtp *srtp, void **buf, int *size, int rtcp);
 	/* Obtain a random cryptographic key */
 	int (*get_random)(unsigned char *key, size_t len);
+	/*! Unprotect count SRTP packets in place, returns the number that succeeded */
+	int (*unprotect_batch)(struct ast_srtp_packet *packets, unsigned int count, int rtcp);
+	/*! Protect count RTP packets in place, returns the number that succeeded */
+	int (*protect_batch)(struct ast_srtp_packet *packets, unsigned int count, int rtcp);
 };
 
 /* Crypto suites */
@@ -250,6 +250,14 @@ enum ast_rtp_instance_stat {
 	AST_RTP_INSTANCE_STAT_TXOCTETCOUNT,
 	/*! Retrieve number of octets received */
 	AST_RTP_INSTANCE_STAT_RXOCTETCOUNT,
+	/*! Retrieve number of batched receive calls */
+	AST_RTP_INSTANCE_STAT_RXBATCHES,
+	/*! Retrieve number of packets received by batched receive calls */
+	AST_RTP_INSTANCE_STAT_RXBATCHCOUNT,
+	/*! Retrieve number of batched send calls */
+	AST_RTP_INSTANCE_STAT_TXBATCHES,
+	/*! Retrieve number of packets sent by batched send calls */
+	AST_RTP_INSTANCE_STAT_TXBATCHCOUNT,
 };
 
 enum ast_rtp_instance_rtcp {
@@ -428,6 +436,14 @@ struct ast_rtp_instance_stats {
 	unsigned int txoctetcount;
 	/*! Number of octets received */
 	unsigned int rxoctetcount;
+	/*! Number of batched receive calls that returned packets */
+	unsigned int rxbatches;
+	/*! Number of packets received by batched receive calls */
+	unsigned int rxbatchcount;
+	/*! Number of batched send calls that sent packets */
+	unsigned int txbatches;
+	/*! Number of packets sent by batched send calls */
+	unsigned int txbatchcount;
 };
 
 #define AST_RTP_STAT_SET(current_stat, combined, placement, value) \
@@ -697,6 +713,8 @@ struct ast_rtp_engine {
 #endif
 	/*! Callback to enable an RTP extension (returns non-zero if supported) */
 	int (*extension_enable)(struct ast_rtp_instance *instance, enum ast_rtp_extension extension);
+	/*! Callback to set the SSRCs of the simulcast layers the remote sends */
+	void (*set_simulcast_ssrcs)(struct ast_rtp_instance *instance, const unsigned int *ssrcs, unsigned int count);
 	/*! Linked list information */
 	AST_RWLIST_ENTRY(ast_rtp_engine) entry;
 };
@@ -2694,6 +2712,27 @@ int ast_rtp_instance_bundle(struct ast_rtp_instance *child, struct ast_rtp_insta
  */
 void ast_rtp_instance_set_remote_ssrc(struct ast_rtp_instance *rtp, unsigned int ssrc);
 
+/*!
+ * \brief Maximum number of simulcast layers received on an RTP instance
+ * \since 19
+ */
+#define AST_RTP_MAX_SIMULCAST_LAYERS 3
+
+/*!
+ * \brief Set the SSRCs of the simulcast layers the remote sends
+ * \since 19
+ *
+ * \param rtp The RTP instance
+ * \param ssrcs The SSRC of each layer, lowest quality first
+ * \param count The number of layers, at most AST_RTP_MAX_SIMULCAST_LAYERS
+ *
+ * Video received with any of these SSRCs is read from the instance with the
+ * index of its layer in the subclass of the frame, and the first SSRC
+ * becomes the remote SSRC.  A count below two turns simulcast off.
+ */
+void ast_rtp_instance_set_simulcast_ssrcs(struct ast_rtp_instance *rtp, const unsigned int *ssrcs,
+	unsigned int count);
+
 /*!
  * \brief Set the stream number for an RTP instance
  * \since 15.0.0
@@ -157,6 +157,22 @@ extern "C" {
  */
 struct ast_sched_context *ast_sched_context_create(void);
 
+/*!
+ * \brief Create a scheduler context that keeps its events in a timer wheel
+ *
+ * Events are added and deleted in constant time, and all events expiring
+ * in the same millisecond are taken off the wheel at once.  This suits
+ * contexts holding a lot of events that are often deleted before they run,
+ * like retransmission timers.  Expiry times are rounded up to the next
+ * millisecond, so events never run before they are due and may run up to
+ * about a millisecond late.  Events expiring in the same millisecond are
+ * run in the order they were added.
+ *
+ * \return Returns a malloc'd sched_context structure, NULL on failure
+ * \since 19.0.0
+ */
+struct ast_sched_context *ast_sched_context_create_wheel(void);
+
 /*!
  * \brief destroys a schedule context
  *
@@ -123,6 +123,14 @@ typedef int (*sdp_crypto_parse_offer_cb)(struct ast_rtp_instance *rtp, struct as
  */
 typedef const char *(*sdp_srtp_get_attr_cb)(struct ast_sdp_srtp *srtp, int dtls_enabled, int default_taglen_32);
 
+/*!
+ * \brief Determine if AEAD (AES-GCM) suites should be preferred when offered
+ *
+ * \retval non-zero if AES-GCM is available and accelerated by the CPU
+ * \retval 0 otherwise
+ */
+typedef int (*sdp_crypto_prefer_aead_cb)(void);
+
 struct ast_sdp_crypto_api {
 	/*! Destroy a crypto struct */
 	sdp_crypto_destroy_cb dtor;
@@ -134,6 +142,8 @@ struct ast_sdp_crypto_api {
 	sdp_crypto_parse_offer_cb parse_offer;
 	/*! Get the SDP a=crypto offer line parameter string */
 	sdp_srtp_get_attr_cb get_attr;
+	/*! Determine if AEAD suites should be preferred */
+	sdp_crypto_prefer_aead_cb prefer_aead;
 };
 
 /*!
@@ -212,6 +222,17 @@ int ast_sdp_crypto_build_offer(struct ast_sdp_crypto *p, int taglen);
  */
 const char *ast_sdp_srtp_get_attrib(struct ast_sdp_srtp *srtp, int dtls_enabled, int default_taglen_32);
 
+/*! \brief Determine if AEAD (AES-GCM) suites should be preferred when offered
+ *
+ * AES-GCM encrypts and authenticates in a single pass, which is
+ * considerably cheaper than AES-CM with HMAC-SHA1 when the CPU
+ * accelerates AES.
+ *
+ * \retval non-zero if an answer should pick an offered AEAD suite first
+ * \retval 0 otherwise
+ */
+int ast_sdp_crypto_prefer_aead(void);
+
 /*! \brief Get the RTP profile in use by a media session
  *
  * \param sdes_active Whether the media session is using SDES-SRTP
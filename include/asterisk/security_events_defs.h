@@ -115,6 +115,11 @@ enum ast_security_event_type {
 	 * \brief An attempt to contact a peer on an invalid transport.
 	 */
 	AST_SECURITY_EVENT_INVAL_TRANSPORT,
+	/*!
+	 * \brief Events from a remote address were suppressed by rate limiting
+	 * \since 19.0.0
+	 */
+	AST_SECURITY_EVENT_SUPPRESSED,
 	/*!
 	 * \brief This _must_ stay at the end.
 	 */
@@ -522,6 +527,33 @@ struct ast_security_event_inval_transport {
 	const char *transport;
 };
 
+/*!
+ * \brief Events from a remote address were suppressed by rate limiting
+ * \since 19.0.0
+ */
+struct ast_security_event_suppressed {
+	/*!
+	 * \brief Event descriptor version
+	 * \note This _must_ be changed if this event descriptor is changed.
+	 */
+	#define AST_SECURITY_EVENT_SUPPRESSED_VERSION 1
+	/*!
+	 * \brief Common security event descriptor elements
+	 * \note Only the service and remote address are required
+	 */
+	struct ast_security_event_common common;
+	/*!
+	 * \brief Name of the security event that was suppressed
+	 * \note required
+	 */
+	const char *suppressed_event;
+	/*!
+	 * \brief Number of events that were suppressed
+	 * \note required
+	 */
+	uint32_t count;
+};
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
@@ -0,0 +1,115 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief Signed linear buffer mixing kernels
+ *
+ * Buffer-at-a-time versions of the ast_slinear_saturated_* helpers found
+ * in utils.h.  At startup the fastest implementation supported by the
+ * running CPU is selected (SSE2, AVX2 or NEON, falling back to plain C).
+ * Every implementation produces output that is bit-for-bit identical to
+ * applying the scalar helpers one sample at a time.
+ */
+
+#ifndef _ASTERISK_SLINEAR_MIX_H
+#define _ASTERISK_SLINEAR_MIX_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/*! \brief Available mixing kernel implementations */
+enum ast_slinear_mix_impl {
+	/*! Portable C, always available */
+	AST_SLINEAR_MIX_SCALAR = 0,
+	/*! x86 SSE2 */
+	AST_SLINEAR_MIX_SSE2,
+	/*! x86 AVX2 */
+	AST_SLINEAR_MIX_AVX2,
+	/*! ARM NEON */
+	AST_SLINEAR_MIX_NEON,
+	/*! Must remain last */
+	AST_SLINEAR_MIX_IMPL_MAX,
+};
+
+/*! \brief A set of mixing kernels */
+struct ast_slinear_mix_ops {
+	/*! Name of the implementation */
+	const char *name;
+	/*! dst[i] = saturate(dst[i] + src[i]) */
+	void (*add)(short *dst, const short *src, unsigned int samples);
+	/*! dst[i] = saturate(dst[i] - src[i]) */
+	void (*subtract)(short *dst, const short *src, unsigned int samples);
+	/*! buf[i] = saturate(buf[i] * factor) */
+	void (*multiply)(short *buf, unsigned int samples, short factor);
+	/*! buf[i] = buf[i] / divisor, divisor must be positive */
+	void (*divide)(short *buf, unsigned int samples, short divisor);
+};
+
+/*!
+ * \brief Get the kernels for a specific implementation
+ * \since 19.0.0
+ *
+ * \param impl The implementation to retrieve
+ *
+ * \retval NULL if the implementation is not supported by this build or CPU
+ * \return the kernels otherwise
+ */
+const struct ast_slinear_mix_ops *ast_slinear_mix_get_ops(enum ast_slinear_mix_impl impl);
+
+/*!
+ * \brief Get the kernels selected for use at startup
+ * \since 19.0.0
+ */
+const struct ast_slinear_mix_ops *ast_slinear_mix_active_ops(void);
+
+/*!
+ * \brief Saturating add of one signed linear buffer into another
+ * \since 19.0.0
+ *
+ * \param dst Buffer to accumulate into
+ * \param src Buffer to add
+ * \param samples Number of samples in each buffer
+ */
+void ast_slinear_mix_add(short *dst, const short *src, unsigned int samples);
+
+/*!
+ * \brief Saturating subtract of one signed linear buffer from another
+ * \since 19.0.0
+ *
+ * \param dst Buffer to subtract from
+ * \param src Buffer to subtract
+ * \param samples Number of samples in each buffer
+ */
+void ast_slinear_mix_subtract(short *dst, const short *src, unsigned int samples);
+
+/*!
+ * \brief Adjust the volume of a signed linear buffer
+ * \since 19.0.0
+ *
+ * \param buf Buffer to adjust in place
+ * \param samples Number of samples in the buffer
+ * \param adjustment Same semantics as ast_frame_adjust_volume(): a
+ *        positive value multiplies each sample, a negative value divides
+ *        each sample by its absolute value and zero does nothing.
+ */
+void ast_slinear_mix_adjust_volume(short *buf, unsigned int samples, int adjustment);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_SLINEAR_MIX_H */
@@ -81,6 +81,10 @@ void ast_slinfactory_destroy(struct ast_slinfactory *sf);
  * \param sf The slinfactory to feed into
  * \param f Frame containing audio to feed in
  *
+ * \note A frame already in the output format whose payload is shared by
+ * ast_frshare() is queued as another reference to that payload, without
+ * copying the audio.
+ *
  * \return Number of frames currently in factory
  */
 int ast_slinfactory_feed(struct ast_slinfactory *sf, struct ast_frame *f);
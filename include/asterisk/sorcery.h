@@ -326,6 +326,14 @@ struct ast_sorcery_wizard {
 
 	/*! \brief Optional callback for forcing a reload to occur, even if wizard has determined no changes */
 	void (*force_reload)(void *data, const struct ast_sorcery *sorcery, const char *type);
+
+	/*!
+	 * \brief Optional callback for retrieving multiple objects using a set of ids
+	 *
+	 * \note Objects that do not exist are simply not added to the container. If not
+	 * provided retrieve_id is called for each id instead.
+	 */
+	void (*retrieve_ids)(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, struct ao2_container *ids);
 };
 
 /*! \brief Interface for a sorcery object type observer */
@@ -1381,6 +1389,23 @@ int ast_sorcery_create(const struct ast_sorcery *sorcery, void *object);
  */
 void *ast_sorcery_retrieve_by_id(const struct ast_sorcery *sorcery, const char *type, const char *id);
 
+/*!
+ * \brief Retrieve multiple objects using their unique identifiers
+ *
+ * \param sorcery Pointer to a sorcery structure
+ * \param type Type of object to retrieve
+ * \param ids A string container (see \ref ast_str_container_alloc) of unique object identifiers
+ *
+ * \retval non-NULL container of the objects that were found, searchable by id
+ * \retval NULL if an error occurs
+ *
+ * \note This behaves as calling \ref ast_sorcery_retrieve_by_id for each id, but
+ * wizards supporting it retrieve the objects in as few backend queries as possible.
+ *
+ * \since 19
+ */
+struct ao2_container *ast_sorcery_retrieve_by_ids(const struct ast_sorcery *sorcery, const char *type, struct ao2_container *ids);
+
 /*!
  * \brief Retrieve an object or multiple objects using specific fields
  * \since 13.9.0
@@ -67,6 +67,10 @@ struct ast_speech {
 	enum ast_speech_results_type results_type;
 	/*! Pointer to the engine used by this speech structure */
 	struct ast_speech_engine *engine;
+	/*! Audio tap feeding the engine, if streaming */
+	struct ast_speech_stream *stream;
+	/*! Latest partial results reported by the engine */
+	struct ast_speech_result *partial_results;
 };
 
 /* Speech recognition engine structure */
@@ -99,6 +103,14 @@ struct ast_speech_engine {
 	int (*change_results_type)(struct ast_speech *speech, enum ast_speech_results_type results_type);
 	/*! Try to get results */
 	struct ast_speech_result *(*get)(struct ast_speech *speech);
+	/*!
+	 * Write a batch of streamed audio to the speech engine (optional)
+	 *
+	 * Called from the streaming thread, never from the channel thread,
+	 * with audio pointing straight into the stream's ring buffer.  Must
+	 * not block.
+	 */
+	int (*stream_write)(struct ast_speech *speech, const void *data, int len);
 	/*! Accepted formats by the engine */
 	struct ast_format_cap *formats;
 	AST_LIST_ENTRY(ast_speech_engine) list;
@@ -148,6 +160,41 @@ int ast_speech_get_setting(struct ast_speech *speech, const char *name, char *bu
 int ast_speech_change_results_type(struct ast_speech *speech, enum ast_speech_results_type results_type);
 /*! \brief Change state of a speech structure */
 int ast_speech_change_state(struct ast_speech *speech, int state);
+/*!
+ * \brief Start streaming the audio read from a channel to the speech engine
+ * \since 19.0.0
+ *
+ * Taps the read path of the channel into a ring buffer which is handed to
+ * the engine's stream_write callback in batches by a shared thread, so the
+ * channel thread no longer has to write each frame to the engine.  Audio
+ * is only streamed while the speech structure is ready.
+ *
+ * \note The engine must support streaming and the speech structure use
+ * signed linear audio at 8kHz.
+ * \note The stream must be stopped before the channel goes away.
+ *
+ * \retval 0 on success
+ * \retval -1 if audio has to be written with ast_speech_write() instead
+ */
+int ast_speech_stream_start(struct ast_speech *speech, struct ast_channel *chan);
+/*!
+ * \brief Stop streaming audio to the speech engine
+ * \since 19.0.0
+ *
+ * Once this returns the engine's stream_write callback is no longer called.
+ */
+void ast_speech_stream_stop(struct ast_speech *speech);
+/*!
+ * \brief Report partial results of a recognition still in progress
+ * \since 19.0.0
+ *
+ * For use by engines, from any thread.  Replaces the partial results
+ * reported before.
+ *
+ * \param speech The speech structure
+ * \param results The partial results, the speech structure takes ownership of them
+ */
+void ast_speech_partial_results_set(struct ast_speech *speech, struct ast_speech_result *results);
 /*! \brief Register a speech recognition engine */
 int ast_speech_register(struct ast_speech_engine *engine);
 /*! \brief Unregister a speech recognition engine */
@@ -788,6 +788,29 @@ struct stasis_subscription *stasis_unsubscribe(
 int stasis_subscription_set_congestion_limits(struct stasis_subscription *subscription,
 	long low_water, long high_water);
 
+/*!
+ * \brief Deliver several queued messages to a subscription per mailbox task.
+ * \since 19.0.0
+ *
+ * By default every message published to a subscription with a mailbox is
+ * queued as its own taskprocessor task. With batching enabled, messages
+ * published while an earlier one is still waiting in the mailbox join the
+ * task queued for it, up to \a batch_size messages per task. Messages are
+ * still delivered one at a time and in order to the subscription callback.
+ *
+ * \note Since the mailbox holds batches instead of messages, the congestion
+ * limits of the subscription apply to the number of queued batches.
+ *
+ * \param subscription Pointer to a stasis subscription
+ * \param batch_size Maximum number of messages per task. 0 or 1 disables
+ * batching.
+ *
+ * \retval 0 on success.
+ * \retval -1 on error, or if the subscription does not have a mailbox.
+ */
+int stasis_subscription_set_batch_size(struct stasis_subscription *subscription,
+	unsigned int batch_size);
+
 /*!
  * \brief Block until the last message is processed on a subscription.
  *
@@ -993,6 +993,18 @@ struct ast_cli_args;
  */
 void stasis_app_to_cli(const struct stasis_app *app, struct ast_cli_args *a);
 
+/*!
+ * \brief Dump the latency histogram of control commands to the CLI
+ *
+ * The latency of a command is the time from it being queued on a
+ * channel's control to it being run by the channel's thread.
+ *
+ * \param a The CLI arguments
+ *
+ * \since 19.0.0
+ */
+void stasis_app_command_latency_to_cli(struct ast_cli_args *a);
+
 /*!
  * \brief Convert and add the app's event type filter(s) to the given json object.
  *
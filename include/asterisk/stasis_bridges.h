@@ -227,6 +227,25 @@ void ast_bridge_publish_leave(struct ast_bridge *bridge, struct ast_channel *cha
 struct ast_json *ast_bridge_snapshot_to_json(const struct ast_bridge_snapshot *snapshot,
 	const struct stasis_message_sanitizer *sanitize);
 
+struct ast_json_writer;
+
+/*!
+ * \brief Write the JSON object for a \ref ast_bridge_snapshot.
+ * \since 19.0.0
+ *
+ * Writes the same object ast_bridge_snapshot_to_json() builds, without
+ * building it.
+ *
+ * \param snapshot The bridge snapshot to write
+ * \param sanitize The message sanitizer to use on the bridge's channels
+ * \param writer The writer to write to
+ *
+ * \return 0 on success
+ * \return -1 on error
+ */
+int ast_bridge_snapshot_to_json_writer(const struct ast_bridge_snapshot *snapshot,
+	const struct stasis_message_sanitizer *sanitize, struct ast_json_writer *writer);
+
 /*!
  * \brief Pair showing a bridge snapshot and a specific channel snapshot belonging to the bridge
  */
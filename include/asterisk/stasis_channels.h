@@ -156,6 +156,8 @@ struct ast_channel_snapshot {
 	struct ast_flags softhangup_flags;                /*!< softhangup channel flags */
 	struct varshead *manager_vars;                    /*!< Variables to be appended to manager events */
 	struct varshead *ari_vars;                        /*!< Variables to be appended to ARI events */
+	struct ast_json *json;                            /*!< JSON rendering, created when first requested */
+	char *manager_state;                              /*!< AMI channel state fields, created when first requested */
 };
 
 /*!
@@ -710,6 +712,10 @@ void ast_channel_publish_dial_forward(struct ast_channel *caller,
 /*!
  * \brief Build a JSON object from a \ref ast_channel_snapshot.
  *
+ * The object is created once per snapshot and shared by every caller, so
+ * it must not be modified.  Callers needing a changed object must change
+ * an ast_json_deep_copy() of it.
+ *
  * \param snapshot The snapshot to convert to JSON
  * \param sanitize The message sanitizer to use on the snapshot
  *
@@ -719,6 +725,25 @@ void ast_channel_publish_dial_forward(struct ast_channel *caller,
 struct ast_json *ast_channel_snapshot_to_json(const struct ast_channel_snapshot *snapshot,
 	const struct stasis_message_sanitizer *sanitize);
 
+struct ast_json_writer;
+
+/*!
+ * \brief Write the JSON object for a \ref ast_channel_snapshot.
+ * \since 19.0.0
+ *
+ * Writes the same object ast_channel_snapshot_to_json() builds, without
+ * building it, unless the snapshot has already been rendered.
+ *
+ * \param snapshot The snapshot to write
+ * \param sanitize The message sanitizer to use on the snapshot
+ * \param writer The writer to write to
+ *
+ * \return 0 on success. Nothing is written if the snapshot is sanitized.
+ * \return -1 on error
+ */
+int ast_channel_snapshot_to_json_writer(const struct ast_channel_snapshot *snapshot,
+	const struct stasis_message_sanitizer *sanitize, struct ast_json_writer *writer);
+
 /*!
  * \brief Compares the context, exten and priority of two snapshots.
  * \since 12
@@ -70,4 +70,31 @@ struct stasis_subscription *internal_stasis_subscribe(
 	int lineno,
 	const char *func);
 
+/*!
+ * \brief Get a rendering cached on an immutable stasis object.
+ *
+ * Messages and snapshots never change once published, so their JSON and AMI
+ * renderings are created once by whichever consumer needs them first and
+ * shared with every other consumer.
+ *
+ * \param slot Location the rendering is cached in.
+ * \return The cached rendering, or \c NULL if there is none yet.
+ * \since 19.0.0
+ */
+void *stasis_cached_rendering_get(void **slot);
+
+/*!
+ * \brief Cache a rendering on an immutable stasis object.
+ *
+ * Only the first rendering stored in a slot is kept, the caller still owns
+ * \a rendering when another thread cached one first.
+ *
+ * \param slot Location to cache the rendering in.
+ * \param rendering The rendering to cache.
+ * \retval 0 if \a rendering is now owned by the cache.
+ * \retval -1 if a rendering was already cached.
+ * \since 19.0.0
+ */
+int stasis_cached_rendering_set(void **slot, void *rendering);
+
 #endif /* STASIS_INTERNAL_H_ */
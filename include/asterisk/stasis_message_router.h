@@ -142,6 +142,22 @@ void stasis_message_router_publish_sync(struct stasis_message_router *router,
 int stasis_message_router_set_congestion_limits(struct stasis_message_router *router,
 	long low_water, long high_water);
 
+/*!
+ * \brief Deliver several queued messages to the stasis message router per task.
+ * \since 19.0.0
+ *
+ * \param router Pointer to a stasis message router
+ * \param batch_size Maximum number of messages per task. 0 or 1 disables
+ * batching.
+ *
+ * \retval 0 on success.
+ * \retval -1 on error.
+ *
+ * \see stasis_subscription_set_batch_size
+ */
+int stasis_message_router_set_batch_size(struct stasis_message_router *router,
+	unsigned int batch_size);
+
 /*!
  * \brief Add a route to a message router.
  *
@@ -41,8 +41,11 @@
  * a unique stasis topic, and the last known published stasis message on that topic.
  * There is only ever one managed state object per topic. For each topic all messages
  * are forwarded to an "all" topic also maintained by the manager. This allows
- * subscriptions to all managed topics, and their state. Managed state is created in
- * one of several ways:
+ * subscriptions to all managed topics, and their state. A state's own topic is only
+ * created once something subscribes to it, or asks for it. Until then messages for
+ * the state are published directly to the "all" topic, so states that are only ever
+ * published to (e.g. mailboxes without any observers) cost little more than their
+ * last message. Managed state is created in one of several ways:
  *
  *   Adding an explicit subscriber
  *   Adding an explicit publisher
@@ -640,4 +640,38 @@ int __ast_string_fields_copy(struct ast_string_field_pool *copy_pool,
 	struct ast_string_field_mgr *copy_mgr, struct ast_string_field_mgr *orig_mgr,
 	const char *file, int lineno, const char *func);
 
+/*!
+  \brief Compact the string fields of a structure
+  \since 19.0.0
+  \param x Pointer to a structure containing fields
+
+  Setting a field to a value that does not fit its current allocation leaves
+  the old space unused until every field sharing its pool lets go, and may
+  add a new pool.  A structure whose fields are set repeatedly over a long
+  life can therefore hold far more memory than its fields need.  This
+  rewrites all the fields into a single pool sized to fit, reusing the
+  embedded pool when possible, and frees the others.
+
+  Nothing is done unless the pools hold more than twice the space the fields
+  need.
+
+  \warning This moves the fields, so pointers to field values obtained
+  before the call must not be used afterwards.
+
+  \retval 0 on success, including when no compaction was needed
+  \retval -1 on allocation failure, in which case the fields are unchanged
+*/
+#define ast_string_field_compact(x) \
+({ \
+	int __res__ = -1; \
+	if (((void *)(x)) != NULL) { \
+		__res__ = __ast_string_field_compact(&(x)->__field_mgr, &(x)->__field_mgr_pool, \
+			__FILE__, __LINE__, __PRETTY_FUNCTION__); \
+	} \
+	__res__; \
+})
+
+int __ast_string_field_compact(struct ast_string_field_mgr *mgr,
+	struct ast_string_field_pool **pool_head, const char *file, int lineno, const char *func);
+
 #endif /* _ASTERISK_STRINGFIELDS_H */
@@ -75,6 +75,16 @@ enum ast_tps_options {
 	TPS_REF_DEFAULT = 0,
 	/*! \brief return a reference to a taskprocessor ONLY if it already exists */
 	TPS_REF_IF_EXISTS = (1 << 0),
+	/*!
+	 * \brief When creating the taskprocessor, use a lock-free task queue
+	 * \since 19.0.0
+	 *
+	 * Producers push tasks without taking the taskprocessor lock which removes
+	 * contention between many pushing threads and the executing thread.  The
+	 * queue supports only a single consumer, which the default listener
+	 * guarantees.  Ignored if the taskprocessor already exists.
+	 */
+	TPS_QUEUE_LOCKFREE = (1 << 1),
 };
 
 struct ast_taskprocessor_listener;
@@ -158,7 +168,8 @@ struct ast_taskprocessor_listener *ast_taskprocessor_listener_alloc(const struct
  * disabled by specifying the TPS_REF_IF_EXISTS ast_tps_options as the second argument to ast_taskprocessor_get().
  * \param name The name of the taskprocessor
  * \param create Use 0 by default or specify TPS_REF_IF_EXISTS to return NULL if the taskprocessor does
- * not already exist
+ * not already exist.  TPS_QUEUE_LOCKFREE may be added to select the lock-free queue for a newly
+ * created taskprocessor.
  * return A pointer to a reference counted taskprocessor under normal conditions, or NULL if the
  * TPS_REF_IF_EXISTS reference type is specified and the taskprocessor does not exist
  * \since 1.6.1
@@ -376,4 +387,105 @@ unsigned int ast_taskprocessor_get_subsystem_alert(const char *subsystem);
  */
 int ast_taskprocessor_alert_set_levels(struct ast_taskprocessor *tps, long low_water, long high_water);
 
+/*! \brief Number of buckets in an ast_taskprocessor_time_stats distribution */
+#define AST_TASKPROCESSOR_TIME_BUCKETS 7
+
+/*!
+ * \brief How long tasks took, in microseconds
+ * \since 19.0.0
+ *
+ * The first bucket counts tasks that took under 10 microseconds and each
+ * bucket after it covers times ten times longer, so the last one counts
+ * the tasks that took a second or more.
+ */
+struct ast_taskprocessor_time_stats {
+	/*! Sum of the times of every task */
+	unsigned long long total;
+	/*! The longest time of any task */
+	unsigned long long max;
+	/*! Number of tasks in each bucket */
+	unsigned long buckets[AST_TASKPROCESSOR_TIME_BUCKETS];
+};
+
+/*!
+ * \brief Statistics of a taskprocessor
+ * \since 19.0.0
+ */
+struct ast_taskprocessor_stats {
+	/*! Name of the taskprocessor */
+	const char *name;
+	/*! Tasks executed */
+	unsigned long processed;
+	/*! Tasks currently queued */
+	long queued;
+	/*! Most tasks that were ever queued at once */
+	unsigned long max_depth;
+	/*! Time tasks waited in the queue before they were executed */
+	struct ast_taskprocessor_time_stats wait;
+	/*! Time tasks took to execute */
+	struct ast_taskprocessor_time_stats execution;
+};
+
+/*!
+ * \brief Callback for ast_taskprocessor_stats_foreach()
+ *
+ * \param stats The statistics, valid only for the duration of the call
+ * \param data The data passed to ast_taskprocessor_stats_foreach()
+ */
+typedef void (*ast_taskprocessor_stats_cb)(const struct ast_taskprocessor_stats *stats, void *data);
+
+/*!
+ * \brief Visit the statistics of every taskprocessor
+ * \since 19.0.0
+ *
+ * \param callback Called for each taskprocessor
+ * \param data Passed to the callback
+ */
+void ast_taskprocessor_stats_foreach(ast_taskprocessor_stats_cb callback, void *data);
+
+/*!
+ * \brief Statistics of a task function, over every taskprocessor
+ * \since 19.0.0
+ */
+struct ast_taskprocessor_callback_stats {
+	/*! Name of the function, as well as it can be resolved */
+	const char *name;
+	/*! Tasks executed */
+	unsigned long processed;
+	/*! Time tasks waited in the queue before they were executed */
+	struct ast_taskprocessor_time_stats wait;
+	/*! Time tasks took to execute */
+	struct ast_taskprocessor_time_stats execution;
+};
+
+/*!
+ * \brief Callback for ast_taskprocessor_callback_stats_foreach()
+ *
+ * \param stats The statistics, valid only for the duration of the call
+ * \param data The data passed to ast_taskprocessor_callback_stats_foreach()
+ */
+typedef void (*ast_taskprocessor_callback_stats_cb)(const struct ast_taskprocessor_callback_stats *stats,
+	void *data);
+
+/*!
+ * \brief Turn the collection of statistics for each task function on or off
+ * \since 19.0.0
+ *
+ * Collecting them costs a container lookup for every task executed, so it
+ * is off by default.  Turning it on throws away statistics collected before.
+ *
+ * \param enabled Non-zero to collect
+ */
+void ast_taskprocessor_callback_stats_enable(int enabled);
+
+/*!
+ * \brief Visit the statistics of every task function
+ * \since 19.0.0
+ *
+ * \param callback Called for each function tasks executed since the
+ *        statistics were turned on
+ * \param data Passed to the callback
+ */
+void ast_taskprocessor_callback_stats_foreach(ast_taskprocessor_callback_stats_cb callback, void *data);
+
 #endif /* __AST_TASKPROCESSOR_H__ */
@@ -82,6 +82,10 @@ enum ast_ssl_flags {
 	AST_SSL_DISABLE_TLSV11 = (1 << 8),
 	/*! Disable TLSv1.2 support */
 	AST_SSL_DISABLE_TLSV12 = (1 << 9),
+	/*! Do not issue session tickets when acting as server */
+	AST_SSL_DISABLE_SESSION_TICKETS = (1 << 10),
+	/*! Let the kernel do record encryption after the handshake if possible */
+	AST_SSL_ENABLE_KTLS = (1 << 11),
 };
 
 struct ast_tls_config {
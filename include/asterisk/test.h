@@ -112,6 +112,33 @@
    'test generate results xml' will generate a test report in xml format
    'test generate results txt' will generate a test report in txt format
 \endcode
+
+\subsection Benchmarks Benchmarks
+
+   Tests in the /bench/ category are benchmarks.  They are only executed when
+   the category is named explicitly, e.g. 'test execute category /bench/', so
+   they do not slow down 'test execute all'.
+
+   A benchmark times an operation with ast_test_bench().  The callback runs the
+   operation the number of times it is asked to; the framework sizes and warms
+   up the batches, then records the time per operation and its percentiles with
+   the test.  The figures are shown as the test runs and are included in the
+   xml and txt reports, and 'test generate results json' writes them out for
+   comparison between builds.
+
+\code
+   static int bench_cb(void *data, unsigned int iterations)
+   {
+      while (iterations--) {
+          \operation under test
+      }
+      return 0;
+   }
+   ...
+   if (ast_test_bench(test, "operation", 0, bench_cb, data)) {
+      return AST_TEST_FAIL;
+   }
+\endcode
 */
 
 /*! Macros used for defining and registering a test */
@@ -429,5 +456,39 @@ int __ast_test_status_update(const char *file, const char *func, int line, struc
 	} \
 })
 
+/*!
+ * \brief Benchmark callback
+ * \since 19.0.0
+ *
+ * \param data The data passed to \ref ast_test_bench
+ * \param iterations Number of times to perform the operation being measured
+ *
+ * \retval 0 success
+ * \retval non-zero the operation failed, the benchmark is aborted
+ */
+typedef int (ast_test_bench_cb_t)(void *data, unsigned int iterations);
+
+/*!
+ * \brief Measure the time an operation takes
+ * \since 19.0.0
+ *
+ * The callback is first run with doubling iteration counts until a batch
+ * takes long enough to time reliably, which also warms up caches.  It is
+ * then run \a samples more times with that count and the time per operation
+ * of each run is recorded.  The median, percentiles and operations per
+ * second are reported as a status update and kept with the test results.
+ *
+ * \param test Currently executing test
+ * \param name Name of the measurement, unique within the test
+ * \param samples Number of timed batches, 0 for the default of 20
+ * \param cb Callback performing the operation
+ * \param data Passed to the callback
+ *
+ * \retval 0 success
+ * \retval -1 the callback failed or memory could not be allocated
+ */
+int ast_test_bench(struct ast_test *test, const char *name, unsigned int samples,
+	ast_test_bench_cb_t *cb, void *data);
+
 #endif /* TEST_FRAMEWORK */
 #endif /* _AST_TEST_H */
@@ -68,7 +68,7 @@ struct ast_threadpool_listener_callbacks {
 };
 
 struct ast_threadpool_options {
-#define AST_THREADPOOL_OPTIONS_VERSION 1
+#define AST_THREADPOOL_OPTIONS_VERSION 2
 	/*! Version of threadpool options in use */
 	int version;
 	/*!
@@ -122,6 +122,22 @@ struct ast_threadpool_options {
 	 * a thread completes
 	 */
 	void (*thread_end)(void);
+	/*!
+	 * \brief Schedule tasks with per worker queues and work stealing
+	 * \since 19.0.0
+	 *
+	 * By default all tasks go through one shared queue that all workers
+	 * contend for.  When this is non-zero each worker has its own queue
+	 * instead.  Tasks pushed from one of the pool's workers are queued to
+	 * that worker and other tasks are spread across the workers in turn.
+	 * A worker that runs out of tasks steals them from the others before
+	 * going idle.
+	 *
+	 * Tasks are still run exactly once, but with more than one thread in
+	 * the pool there is no ordering between tasks, just as with the shared
+	 * queue.
+	 */
+	int work_stealing;
 };
 
 /*!
@@ -0,0 +1,116 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief Binary trace ring
+ *
+ * A low overhead trace facility meant to be left on in production.  Each
+ * thread that traces gets its own ring of fixed size records.  A record
+ * holds a nanosecond timestamp, the location, a pointer to the printf
+ * style format string and the raw arguments.  Nothing is formatted until
+ * the records are read back with the "trace ring show" CLI command or
+ * ast_trace_ring_get().  Once a ring is full the oldest records are
+ * overwritten.
+ *
+ * Unlike ast_trace(), this is available whether or not AST_DEVMODE is
+ * defined, and costs a single branch while the ring is turned off.
+ */
+
+#ifndef _ASTERISK_TRACE_RING_H
+#define _ASTERISK_TRACE_RING_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/*! \brief Records in each thread's ring, the newest one less than this can be read */
+#define AST_TRACE_RING_SIZE 512
+
+/*! \brief Arguments kept for a record, star widths and precisions included */
+#define AST_TRACE_RING_ARGS 8
+
+/*! \brief Space in a record for copies of its string arguments */
+#define AST_TRACE_RING_STRINGS 64
+
+/*! \brief Non-zero while trace records are being taken */
+extern int ast_trace_ring_enabled;
+
+/*!
+ * \brief Take a trace record
+ *
+ * \note Call ast_trace_ring() instead.
+ */
+void __attribute__((format(printf, 4, 5))) __ast_trace_ring(const char *file, int line,
+	const char *func, const char *fmt, ...);
+
+/*!
+ * \brief Take a trace record if the trace ring is on
+ *
+ * \param fmt A printf style format string.  It must be a string literal,
+ *            since only a pointer to it is kept.
+ * \param ... The arguments.  Strings are copied, up to
+ *            AST_TRACE_RING_STRINGS bytes for all of them together.
+ *            Arguments past AST_TRACE_RING_ARGS are dropped and the
+ *            rest of the format is shown as is.
+ *
+ * No newline is needed.
+ *
+ * \since 19.0.0
+ */
+#define ast_trace_ring(...) \
+	do { \
+		if (ast_trace_ring_enabled) { \
+			__ast_trace_ring(__FILE__, __LINE__, __PRETTY_FUNCTION__, __VA_ARGS__); \
+		} \
+	} while (0)
+
+/*!
+ * \brief Turn the trace ring on or off
+ *
+ * \param enabled Non-zero to take records
+ *
+ * \since 19.0.0
+ */
+void ast_trace_ring_enable(int enabled);
+
+/*!
+ * \brief Throw away every record taken so far
+ *
+ * \since 19.0.0
+ */
+void ast_trace_ring_clear(void);
+
+/*!
+ * \brief Decode trace records
+ *
+ * \param tid Only decode records from this thread, or 0 for every thread
+ * \param count Decode at most this many of the newest records, or 0 for all
+ *
+ * Records from every thread are merged in timestamp order.  Each one is
+ * decoded to a line of the form
+ * "[seconds.nanoseconds] [tid] file:line function: message".
+ *
+ * \return A string the caller must ast_free(), or NULL on failure
+ *
+ * \since 19.0.0
+ */
+struct ast_str *ast_trace_ring_get(int tid, unsigned int count);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_TRACE_RING_H */
@@ -155,6 +155,16 @@ struct ast_translator {
 	                                       /*!< Input frame callback. Store
 	                                        *   (and possibly convert) input frame. */
 
+	int (*framein_batch)(struct ast_trans_pvt **pvts, struct ast_frame **in, int count);
+	                                       /*!< Optional input callback for
+	                                        *   count independent instances at
+	                                        *   once, in[i] going to pvts[i].
+	                                        *   Each must end up as if framein
+	                                        *   had been called on it, so a
+	                                        *   codec can share its setup or
+	                                        *   vectorize across streams.
+	                                        *   \since 19.0.0 */
+
 	struct ast_frame * (*frameout)(struct ast_trans_pvt *pvt);
 	                                       /*!< Output frame callback. Generate a frame
 	                                        *   with outbuf content. */
@@ -167,6 +177,14 @@ struct ast_translator {
 	                                       /*!< cleanup private data, if needed
 	                                        *   (often unnecessary). */
 
+	int (*reset)(struct ast_trans_pvt *pvt);
+	                                       /*!< Return private data to the state
+	                                        *   newpvt left it in so the instance
+	                                        *   can be reused by another path.
+	                                        *   Translators with a destroy
+	                                        *   callback are only pooled if they
+	                                        *   supply this.  \since 19.0.0 */
+
 	struct ast_frame * (*sample)(void);    /*!< Generate an example frame */
 
 	/*!\brief size of outbuf, in samples. Leave it 0 if you want the framein
@@ -190,6 +208,10 @@ struct ast_translator {
 	int src_fmt_index;                     /*!< index of the source format in the matrix table */
 	int dst_fmt_index;                     /*!< index of the destination format in the matrix table */
 	AST_LIST_ENTRY(ast_translator) list;   /*!< link field */
+	struct ast_trans_pvt *pool;            /*!< Idle instances kept for reuse */
+	int pool_size;                         /*!< Number of idle instances */
+	unsigned int pool_hits;                /*!< Paths that reused an idle instance */
+	unsigned int pool_misses;              /*!< Paths that had to allocate an instance */
 };
 
 /*! \brief
@@ -314,6 +336,10 @@ struct ast_trans_pvt *ast_translator_build_path(struct ast_format *dest, struct
  * \brief Frees a translator path
  * Frees the given translator path structure
  * \param tr translator path to get rid of
+ *
+ * \note Steps whose translator can be reset are kept in a
+ * per translator pool and handed to the next path built with
+ * that translator instead of being freed.
  */
 void ast_translator_free_path(struct ast_trans_pvt *tr);
 
@@ -330,6 +356,37 @@ void ast_translator_free_path(struct ast_trans_pvt *tr);
  */
 struct ast_frame *ast_translate(struct ast_trans_pvt *tr, struct ast_frame *f, int consume);
 
+/*!
+ * \brief Translate one frame on each of several independent paths
+ * \since 19.0.0
+ *
+ * Gives the same result as calling ast_translate(paths[i], frames[i], 0)
+ * for every path.  Runs of single step paths using a translator with a
+ * framein_batch callback are handed to it together, anything else is
+ * translated one path at a time.  Ordering the paths so those sharing a
+ * translator are adjacent gets the most out of this.
+ *
+ * \param paths Translation paths, all distinct
+ * \param frames Frame to translate on each path, none are consumed
+ * \param[out] out Translated frame for each path, NULL where there is none
+ * \param count Number of paths
+ *
+ * \return the number of translated frames
+ */
+int ast_translate_batch(struct ast_trans_pvt **paths, struct ast_frame **frames,
+	struct ast_frame **out, int count);
+
+/*!
+ * \brief Check whether ast_translate_batch() can batch a translation path
+ * \since 19.0.0
+ *
+ * \param path Translation path
+ *
+ * \retval 1 if the path is a single translator with a framein_batch callback
+ * \retval 0 if it would be translated on its own
+ */
+int ast_translator_can_batch(const struct ast_trans_pvt *path);
+
 /*!
  * \brief Returns the number of steps required to convert from 'src' to 'dest'.
  * \param dest destination format
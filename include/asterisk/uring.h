@@ -0,0 +1,109 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ * \brief Asynchronous file appends through io_uring
+ *
+ * A writer appends to a file descriptor without the caller waiting for the
+ * write.  The data is copied and handed to the kernel through an io_uring
+ * shared by every writer, and data appended while a write is in progress is
+ * sent together with the next one.  The writes of one writer are made in
+ * the order they were appended.
+ *
+ * Where io_uring is not available, at build time or in the running kernel,
+ * writers write synchronously on the calling thread instead.
+ */
+
+#ifndef _ASTERISK_URING_H
+#define _ASTERISK_URING_H
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/*! \brief An appender to a file descriptor */
+struct ast_uring_writer;
+
+/*!
+ * \brief Create a writer appending to a file descriptor
+ * \since 19.0.0
+ *
+ * \param fd A file descriptor, usually opened with O_APPEND
+ * \param owns_fd Non-zero to close the descriptor when the writer is closed
+ *
+ * \return The writer, NULL on failure
+ */
+struct ast_uring_writer *ast_uring_writer_create(int fd, int owns_fd);
+
+/*!
+ * \brief Open a file to append to and create a writer owning it
+ * \since 19.0.0
+ *
+ * The file is created if needed, as fopen() in "a" mode does.
+ *
+ * \return The writer, NULL on failure with errno set
+ */
+struct ast_uring_writer *ast_uring_writer_open(const char *path);
+
+/*!
+ * \brief Append to the file of a writer
+ * \since 19.0.0
+ *
+ * \param writer The writer
+ * \param buf The data, copied before returning
+ * \param len The length of the data
+ *
+ * \retval 0 on success
+ * \retval -1 on failure with errno set, including an earlier write of the
+ *         writer having failed
+ */
+int ast_uring_write(struct ast_uring_writer *writer, const void *buf, size_t len);
+
+/*!
+ * \brief Wait for everything appended to a writer to be written
+ * \since 19.0.0
+ */
+void ast_uring_writer_flush(struct ast_uring_writer *writer);
+
+/*!
+ * \brief Get the error of the first failed write of a writer
+ * \since 19.0.0
+ *
+ * \return An errno value, 0 if no write failed
+ */
+int ast_uring_writer_error(struct ast_uring_writer *writer);
+
+/*!
+ * \brief Close a writer
+ * \since 19.0.0
+ *
+ * Whatever was appended is still written, after which the file descriptor
+ * is closed if the writer owns it.  The caller does not wait for that and
+ * must not use the writer again.
+ */
+void ast_uring_writer_close(struct ast_uring_writer *writer);
+
+/*!
+ * \brief Whether writes go through io_uring
+ * \since 19.0.0
+ */
+int ast_uring_available(void);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _ASTERISK_URING_H */
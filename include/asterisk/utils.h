@@ -1080,4 +1080,49 @@ int ast_thread_user_interface_set(int is_user_interface);
  */
 int ast_thread_is_user_interface(void);
 
+/*!
+ * \brief Add a group of CPUs threads working together can be placed on.
+ * \since 19.0.0
+ *
+ * Groups are typically the CPUs of one NUMA node, set by the cpu_group
+ * options of asterisk.conf at startup.
+ *
+ * \param cpus List of CPUs and CPU ranges separated by commas, e.g. "0-11,24-35"
+ *
+ * \retval 0 on success
+ * \retval -1 if the list is invalid, the platform cannot place threads
+ *         or too many groups were added
+ */
+int ast_cpu_group_add(const char *cpus);
+
+/*!
+ * \brief Pick the CPU group for a new set of threads working together.
+ * \since 19.0.0
+ *
+ * The group used by the fewest sets of threads is picked.  Release it
+ * with ast_cpu_group_release() once the threads are done.
+ *
+ * \return The group, or -1 if no CPU groups are configured.
+ */
+int ast_cpu_group_acquire(void);
+
+/*!
+ * \brief Release a CPU group picked by ast_cpu_group_acquire().
+ * \since 19.0.0
+ *
+ * \param group The group, -1 is ignored.
+ */
+void ast_cpu_group_release(int group);
+
+/*!
+ * \brief Restrict the current thread to the CPUs of a CPU group.
+ * \since 19.0.0
+ *
+ * \param group The group, -1 leaves the thread where it is.
+ *
+ * \retval 0 on success or if group is -1
+ * \retval -1 on failure
+ */
+int ast_thread_cpu_group_set(int group);
+
 #endif /* _ASTERISK_UTILS_H */
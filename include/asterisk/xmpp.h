@@ -48,6 +48,7 @@
 #include "asterisk/stringfields.h"
 #include "asterisk/pbx.h"
 #include "asterisk/stasis.h"
+#include "asterisk/vector.h"
 
 /*
  * As per RFC 3920 - section 3.1, the maximum length for a full Jabber ID
@@ -107,6 +108,11 @@ struct ast_xmpp_message {
 };
 
 struct ast_endpoint;
+struct ast_taskprocessor;
+struct ast_xmpp_buddy_devstate;
+
+/*! \brief Device states of buddies waiting to be published */
+AST_VECTOR(ast_xmpp_devstate_queue, struct ast_xmpp_buddy_devstate *);
 
 /*! \brief XMPP Buddy */
 struct ast_xmpp_buddy {
@@ -146,6 +152,12 @@ struct ast_xmpp_client {
 	struct stasis_subscription *device_state_sub;
 	/*! The endpoint associated with this client */
 	struct ast_endpoint *endpoint;
+	/*! Serializer publishing the device states of the buddies */
+	struct ast_taskprocessor *devstate_serializer;
+	/*! Device states of the buddies by JID, its lock also protects devstate_queue */
+	struct ao2_container *devstates;
+	/*! Device states changed since they were last published */
+	struct ast_xmpp_devstate_queue devstate_queue;
 };
 
 /*!
@@ -47,6 +47,7 @@
 #include "asterisk/abstract_jb.h"
 #include "fixedjitterbuf.h"
 #include "jitterbuf.h"
+#include "ringjitterbuf.h"
 
 /*! Internal jb flags */
 enum {
@@ -83,6 +84,17 @@ static void jb_force_resynch_adaptive(void *jb);
 static void jb_empty_and_reset_adaptive(void *jb);
 static int jb_is_late_adaptive(void *jb, long ts);
 
+static void *jb_create_ring(struct ast_jb_conf *general_config);
+static void jb_destroy_ring(void *jb);
+static int jb_put_first_ring(void *jb, struct ast_frame *fin, long now);
+static int jb_put_ring(void *jb, struct ast_frame *fin, long now);
+static int jb_get_ring(void *jb, struct ast_frame **fout, long now, long interpl);
+static long jb_next_ring(void *jb);
+static int jb_remove_ring(void *jb, struct ast_frame **fout);
+static void jb_force_resynch_ring(void *jb);
+static void jb_empty_and_reset_ring(void *jb);
+static int jb_is_late_ring(void *jb, long ts);
+
 /* Available jb implementations */
 static const struct ast_jb_impl avail_impl[] = {
 	{
@@ -112,6 +124,20 @@ static const struct ast_jb_impl avail_impl[] = {
 		.force_resync = jb_force_resynch_adaptive,
 		.empty_and_reset = jb_empty_and_reset_adaptive,
 		.is_late = jb_is_late_adaptive,
+	},
+	{
+		.name = "ring",
+		.type = AST_JB_RING,
+		.create = jb_create_ring,
+		.destroy = jb_destroy_ring,
+		.put_first = jb_put_first_ring,
+		.put = jb_put_ring,
+		.get = jb_get_ring,
+		.next = jb_next_ring,
+		.remove = jb_remove_ring,
+		.force_resync = jb_force_resynch_ring,
+		.empty_and_reset = jb_empty_and_reset_ring,
+		.is_late = jb_is_late_ring,
 	}
 };
 
@@ -122,6 +148,8 @@ static const int fixed_to_abstract_code[] =
 	{AST_JB_IMPL_OK, AST_JB_IMPL_DROP, AST_JB_IMPL_INTERP, AST_JB_IMPL_NOFRAME};
 static const int adaptive_to_abstract_code[] =
 	{AST_JB_IMPL_OK, AST_JB_IMPL_NOFRAME, AST_JB_IMPL_NOFRAME, AST_JB_IMPL_INTERP, AST_JB_IMPL_DROP, AST_JB_IMPL_OK};
+static const int ring_to_abstract_code[] =
+	{AST_JB_IMPL_OK, AST_JB_IMPL_DROP, AST_JB_IMPL_INTERP, AST_JB_IMPL_NOFRAME};
 
 /* JB_GET actions (used only for the frames log) */
 static const char * const jb_get_actions[] = {"Delivered", "Dropped", "Interpolated", "No"};
@@ -833,6 +861,85 @@ static int jb_is_late_adaptive(void *jb, long ts)
 	return jb_is_late(jb, ts);
 }
 
+/* ring */
+
+static void *jb_create_ring(struct ast_jb_conf *general_config)
+{
+	struct ring_jb_conf conf;
+
+	conf.max_size = general_config->max_size;
+	conf.resync_threshold = general_config->resync_threshold;
+	conf.target_extra = general_config->target_extra;
+	conf.max_contig_interp = 10;
+
+	return ring_jb_new(&conf);
+}
+
+static void jb_destroy_ring(void *jb)
+{
+	/* Ensure the ring jb is empty - otherwise it will raise an ASSERT */
+	jb_empty_and_reset_ring(jb);
+
+	ring_jb_destroy(jb);
+}
+
+static int jb_put_first_ring(void *jb, struct ast_frame *fin, long now)
+{
+	return ring_to_abstract_code[ring_jb_put_first(jb, fin, fin->len, fin->ts, now)];
+}
+
+static int jb_put_ring(void *jb, struct ast_frame *fin, long now)
+{
+	return ring_to_abstract_code[ring_jb_put(jb, fin, fin->len, fin->ts, now)];
+}
+
+static int jb_get_ring(void *jb, struct ast_frame **fout, long now, long interpl)
+{
+	struct ring_jb_frame frame = { .data = &ast_null_frame };
+	int res;
+
+	res = ring_jb_get(jb, &frame, now, interpl);
+	*fout = frame.data;
+
+	return ring_to_abstract_code[res];
+}
+
+static long jb_next_ring(void *jb)
+{
+	return ring_jb_next(jb);
+}
+
+static int jb_remove_ring(void *jb, struct ast_frame **fout)
+{
+	struct ring_jb_frame frame;
+	int res;
+
+	res = ring_jb_remove(jb, &frame);
+	*fout = frame.data;
+
+	return ring_to_abstract_code[res];
+}
+
+static void jb_force_resynch_ring(void *jb)
+{
+}
+
+static void jb_empty_and_reset_ring(void *jb)
+{
+	struct ring_jb_frame f;
+
+	while (ring_jb_remove(jb, &f) == RING_JB_OK) {
+		ast_frfree(f.data);
+	}
+
+	ring_jb_reset(jb);
+}
+
+static int jb_is_late_ring(void *jb, long ts)
+{
+	return ring_jb_is_late(jb, ts);
+}
+
 #define DEFAULT_TIMER_INTERVAL 20
 #define DEFAULT_SIZE  200
 #define DEFAULT_TARGET_EXTRA  40
@@ -1237,6 +1344,8 @@ static int jb_framedata_init(struct jb_framedata *framedata, struct ast_jb_conf
 			jb_impl_type = AST_JB_FIXED;
 		} else if (!strcasecmp(jb_conf->impl, "adaptive")) {
 			jb_impl_type = AST_JB_ADAPTIVE;
+		} else if (!strcasecmp(jb_conf->impl, "ring")) {
+			jb_impl_type = AST_JB_RING;
 		} else {
 			ast_log(LOG_WARNING, "Unknown Jitterbuffer type %s. Failed to create jitterbuffer.\n", jb_conf->impl);
 			return -1;
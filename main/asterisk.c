@@ -4046,6 +4046,7 @@ static void asterisk_daemon(int isroot, const char *runuser, const char *rungrou
 
 	check_init(astobj2_init(), "AO2");
 	check_init(ast_named_locks_init(), "Named Locks");
+	check_init(ast_histogram_init(), "Histograms");
 
 	if (ast_opt_console) {
 		if (el_hist == NULL || el == NULL)
@@ -4071,6 +4072,9 @@ static void asterisk_daemon(int isroot, const char *runuser, const char *rungrou
 	check_init(ast_json_init(), "libjansson");
 	ast_ulaw_init();
 	ast_alaw_init();
+	check_init(ast_slinear_mix_init(), "Signed Linear Mixing");
+	check_init(ast_g711_init(), "G.711 Decoding");
+	check_init(ast_trace_ring_init(), "Trace Ring");
 	ast_utf8_init();
 	tdd_init();
 	callerid_init();
@@ -4078,6 +4082,8 @@ static void asterisk_daemon(int isroot, const char *runuser, const char *rungrou
 
 	check_init(ast_utils_init(), "Utilities");
 	check_init(ast_tps_init(), "Task Processor Core");
+	check_init(ast_overload_init(), "Overload Level");
+	check_init(ast_uring_init(), "io_uring Writers");
 	check_init(ast_fd_init(), "File Descriptor Debugging");
 	check_init(ast_pbx_init(), "ast_pbx_init");
 	check_init(aco_init(), "Configuration Option Framework");
@@ -65,6 +65,8 @@
 
 #if defined(MALLOC_DEBUG) && !defined(STANDALONE) && !defined(STANDALONE2)
 #define __AST_DEBUG_MALLOC
+#elif !defined(STANDALONE) && !defined(STANDALONE2)
+#define __AST_SAMPLE_MALLOC
 #endif
 
 #define MALLOC_FAILURE_MSG \
@@ -1554,59 +1556,421 @@ void load_astmm_phase_2(void)
 
 #else	/* !defined(__AST_DEBUG_MALLOC) */
 
+#if defined(__AST_SAMPLE_MALLOC)
+
+/*
+ * Without MALLOC_DEBUG a sampling profiler can be enabled at run time.
+ * It records where one in every N allocations (on average) was made
+ * and forgets it again when the memory is freed, so what is left over
+ * is a statistical picture of the live heap by call site.  Nothing is
+ * added to the allocations themselves so it works with the normal
+ * allocator and costs next to nothing while disabled.
+ */
+
+#include <pthread.h>
+
+#include "asterisk/cli.h"
+#include "asterisk/config.h"
+#include "asterisk/lock.h"
+#include "asterisk/strings.h"
+#include "asterisk/utils.h"
+
+/*! Number of hash buckets for sampled allocations */
+#define SAMPLE_BUCKETS 1021
+
+#define SAMPLE_HASH(a)	(((unsigned long)(a)) % SAMPLE_BUCKETS)
+
+/*! \brief An allocation recorded by the sampling profiler */
+struct sampled_alloc {
+	struct sampled_alloc *next;
+	void *ptr;
+	size_t len;
+	/*! Sampling rate when recorded, the number of allocations this one stands for */
+	unsigned int weight;
+	int lineno;
+	/* The strings are copied as the module that allocated may be unloaded */
+	char func[40];
+	char file[64];
+};
+
+/*! Sample one in this many allocations on average, 0 when disabled */
+static unsigned int sample_rate;
+
+/*! Number of sampled allocations not yet freed */
+static int sample_count;
+
+static struct sampled_alloc *samples[SAMPLE_BUCKETS];
+
+/*! Tracking this mutex would recurse, as the mutex tracking code allocates memory */
+AST_MUTEX_DEFINE_STATIC_NOTRACKING(sample_lock);
+
+/*! Per thread number of allocations until the next sample */
+static pthread_key_t sample_countdown;
+
+/*!
+ * \internal
+ * \brief Decide whether the calling thread samples this allocation
+ *
+ * The gap between samples is randomized so allocations made in a
+ * fixed pattern are not consistently missed or hit.
+ */
+static int sample_this(unsigned int rate)
+{
+	uintptr_t countdown = (uintptr_t) pthread_getspecific(sample_countdown);
+
+	if (countdown > 1) {
+		pthread_setspecific(sample_countdown, (void *) (countdown - 1));
+		return 0;
+	}
+
+	/* Set first in case ast_random() allocates */
+	pthread_setspecific(sample_countdown, (void *) (uintptr_t) rate);
+	pthread_setspecific(sample_countdown, (void *) (uintptr_t) (1 + ast_random() % (2 * rate)));
+
+	/* A thread's first allocation only starts its countdown */
+	return countdown == 1;
+}
+
+static void sample_alloc(void *ptr, size_t len, const char *file, int lineno, const char *func)
+{
+	unsigned int rate = sample_rate;
+	struct sampled_alloc *sample;
+	unsigned int idx;
+
+	if (!rate || !ptr || !sample_this(rate)) {
+		return;
+	}
+
+	sample = malloc(sizeof(*sample));
+	if (!sample) {
+		return;
+	}
+	sample->ptr = ptr;
+	sample->len = len;
+	sample->weight = rate;
+	sample->lineno = lineno;
+	ast_copy_string(sample->func, S_OR(func, ""), sizeof(sample->func));
+	ast_copy_string(sample->file, S_OR(file, ""), sizeof(sample->file));
+
+	idx = SAMPLE_HASH(ptr);
+	ast_mutex_lock(&sample_lock);
+	sample->next = samples[idx];
+	samples[idx] = sample;
+	++sample_count;
+	ast_mutex_unlock(&sample_lock);
+}
+
+static void sample_free(void *ptr)
+{
+	struct sampled_alloc **prev;
+	struct sampled_alloc *sample;
+	unsigned int idx;
+
+	/* Unlocked peeks, a sampled allocation was recorded before its pointer was handed out */
+	if (!sample_count || !ptr) {
+		return;
+	}
+	idx = SAMPLE_HASH(ptr);
+	if (!samples[idx]) {
+		return;
+	}
+
+	ast_mutex_lock(&sample_lock);
+	for (prev = &samples[idx]; (sample = *prev); prev = &sample->next) {
+		if (sample->ptr == ptr) {
+			*prev = sample->next;
+			--sample_count;
+			break;
+		}
+	}
+	ast_mutex_unlock(&sample_lock);
+
+	free(sample);
+}
+
+static void samples_clear(void)
+{
+	unsigned int idx;
+
+	ast_mutex_lock(&sample_lock);
+	for (idx = 0; idx < SAMPLE_BUCKETS; ++idx) {
+		struct sampled_alloc *sample;
+
+		while ((sample = samples[idx])) {
+			samples[idx] = sample->next;
+			free(sample);
+		}
+	}
+	sample_count = 0;
+	ast_mutex_unlock(&sample_lock);
+}
+
+static int sample_site_cmp(const void *left, const void *right)
+{
+	const struct sampled_alloc *l = left;
+	const struct sampled_alloc *r = right;
+	int cmp;
+
+	cmp = strcmp(l->file, r->file);
+	if (!cmp) {
+		cmp = l->lineno - r->lineno;
+	}
+	if (!cmp) {
+		cmp = strcmp(l->func, r->func);
+	}
+
+	return cmp;
+}
+
+static int sample_site_len_cmp(const void *left, const void *right)
+{
+	const struct sampled_alloc *l = left;
+	const struct sampled_alloc *r = right;
+
+	/* Largest estimate first, the len of an aggregated site is its estimate */
+	return l->len < r->len ? 1 : l->len > r->len ? -1 : 0;
+}
+
+static char *handle_memory_show_sampled(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	const char *fn = NULL;
+	struct sampled_alloc *sites;
+	size_t count = 0;
+	size_t num_sites = 0;
+	size_t total_len = 0;
+	size_t idx;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "memory show allocations sampled";
+		e->usage =
+			"Usage: memory show allocations sampled [<file>]\n"
+			"       Shows the live memory recorded by the allocation sampler\n"
+			"       grouped by the location it was allocated from, largest\n"
+			"       first.  Sizes are estimates scaled by the sampling rate.\n"
+			"       <file> - Restricts output to memory allocated by the file.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc == 5) {
+		fn = a->argv[4];
+	} else if (a->argc != 4) {
+		return CLI_SHOWUSAGE;
+	}
+
+	if (sample_rate) {
+		ast_cli(a->fd, "Sampling one in %u allocations\n\n", sample_rate);
+	} else {
+		ast_cli(a->fd, "Allocation sampling is disabled, see 'memory sampling'\n\n");
+	}
+
+	ast_mutex_lock(&sample_lock);
+	sites = malloc(sizeof(*sites) * MAX(sample_count, 1));
+	if (!sites) {
+		ast_mutex_unlock(&sample_lock);
+		return CLI_FAILURE;
+	}
+	for (idx = 0; idx < SAMPLE_BUCKETS; ++idx) {
+		struct sampled_alloc *sample;
+
+		for (sample = samples[idx]; sample; sample = sample->next) {
+			if (fn && strcasecmp(fn, sample->file)) {
+				continue;
+			}
+			sites[count] = *sample;
+			/* From here on weight counts the samples and len is the estimate */
+			sites[count].len = sample->len * sample->weight;
+			sites[count].weight = 1;
+			++count;
+		}
+	}
+	ast_mutex_unlock(&sample_lock);
+
+	qsort(sites, count, sizeof(*sites), sample_site_cmp);
+	for (idx = 0; idx < count; ++idx) {
+		total_len += sites[idx].len;
+		if (num_sites && !sample_site_cmp(&sites[num_sites - 1], &sites[idx])) {
+			sites[num_sites - 1].len += sites[idx].len;
+			sites[num_sites - 1].weight += sites[idx].weight;
+			continue;
+		}
+		sites[num_sites++] = sites[idx];
+	}
+	qsort(sites, num_sites, sizeof(*sites), sample_site_len_cmp);
+
+	for (idx = 0; idx < num_sites; ++idx) {
+		ast_cli(a->fd, "%10zu bytes in %6u samples by %20s() line %5d of %s\n",
+			sites[idx].len, sites[idx].weight,
+			sites[idx].func, sites[idx].lineno, sites[idx].file);
+	}
+	free(sites);
+
+	ast_cli(a->fd, "\n%10zu bytes estimated in %zu sampled allocations from %zu locations\n",
+		total_len, count, num_sites);
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_memory_sampling(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	unsigned int rate;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "memory sampling";
+		e->usage =
+			"Usage: memory sampling {<rate>|off}\n"
+			"       Record the location of one in every <rate> memory\n"
+			"       allocations, on average, until they are freed.  Use\n"
+			"       'memory show allocations sampled' to view them.  Turning\n"
+			"       sampling off or changing the rate discards the samples.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	if (!strcasecmp(a->argv[2], "off")) {
+		rate = 0;
+	} else if (ast_parse_arg(a->argv[2], PARSE_UINT32 | PARSE_IN_RANGE, &rate, 1, 100000000)) {
+		return CLI_SHOWUSAGE;
+	}
+
+	/* Stop sampling before discarding, samples taken with a stale rate would be misleading */
+	sample_rate = 0;
+	samples_clear();
+	sample_rate = rate;
+
+	if (rate) {
+		ast_cli(a->fd, "Sampling one in %u memory allocations\n", rate);
+	} else {
+		ast_cli(a->fd, "Memory allocation sampling disabled\n");
+	}
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_memory_sampling[] = {
+	AST_CLI_DEFINE(handle_memory_sampling, "Enable or disable memory allocation sampling"),
+	AST_CLI_DEFINE(handle_memory_show_sampled, "Display live memory by sampled allocation site"),
+};
+
+static void mm_sampling_cleanup(void)
+{
+	ast_cli_unregister_multiple(cli_memory_sampling, ARRAY_LEN(cli_memory_sampling));
+	sample_rate = 0;
+	samples_clear();
+}
+
 void load_astmm_phase_1(void)
 {
+	pthread_key_create(&sample_countdown, NULL);
 }
 
 void load_astmm_phase_2(void)
 {
+	ast_cli_register_multiple(cli_memory_sampling, ARRAY_LEN(cli_memory_sampling));
+	ast_register_cleanup(mm_sampling_cleanup);
 }
 
+#else	/* !defined(__AST_SAMPLE_MALLOC) */
+
+#define sample_alloc(ptr, len, file, lineno, func)
+#define sample_free(ptr)
+
+void load_astmm_phase_1(void)
+{
+}
+
+void load_astmm_phase_2(void)
+{
+}
+
+#endif	/* defined(__AST_SAMPLE_MALLOC) */
+
 void *__ast_repl_calloc(size_t nmemb, size_t size, const char *file, int lineno, const char *func)
 {
+	void *p;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return calloc(nmemb, size);
+	p = calloc(nmemb, size);
+	sample_alloc(p, nmemb * size, file, lineno, func);
+
+	return p;
 }
 
 static void *__ast_repl_calloc_cache(size_t nmemb, size_t size, const char *file, int lineno, const char *func)
 {
+	void *p;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return calloc(nmemb, size);
+	p = calloc(nmemb, size);
+	sample_alloc(p, nmemb * size, file, lineno, func);
+
+	return p;
 }
 
 void *__ast_repl_malloc(size_t size, const char *file, int lineno, const char *func)
 {
+	void *p;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return malloc(size);
+	p = malloc(size);
+	sample_alloc(p, size, file, lineno, func);
+
+	return p;
 }
 
 void __ast_free(void *ptr, const char *file, int lineno, const char *func)
 {
+	sample_free(ptr);
 	free(ptr);
 }
 
 void *__ast_repl_realloc(void *ptr, size_t size, const char *file, int lineno, const char *func)
 {
+	void *newp;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return realloc(ptr, size);
+	/* The old pointer can not be looked up once realloc has freed it */
+	sample_free(ptr);
+	newp = realloc(ptr, size);
+	sample_alloc(newp, size, file, lineno, func);
+
+	return newp;
 }
 
 char *__ast_repl_strdup(const char *s, const char *file, int lineno, const char *func)
 {
+	char *newstr;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return strdup(s);
+	newstr = strdup(s);
+	sample_alloc(newstr, newstr ? strlen(newstr) + 1 : 0, file, lineno, func);
+
+	return newstr;
 }
 
 char *__ast_repl_strndup(const char *s, size_t n, const char *file, int lineno, const char *func)
 {
+	char *newstr;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, NULL);
 
-	return strndup(s, n);
+	newstr = strndup(s, n);
+	sample_alloc(newstr, newstr ? strlen(newstr) + 1 : 0, file, lineno, func);
+
+	return newstr;
 }
 
 int __ast_repl_asprintf(const char *file, int lineno, const char *func, char **strp, const char *format, ...)
@@ -1614,10 +1978,8 @@ int __ast_repl_asprintf(const char *file, int lineno, const char *func, char **s
 	int res;
 	va_list ap;
 
-	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, -1);
-
 	va_start(ap, format);
-	res = vasprintf(strp, format, ap);
+	res = __ast_repl_vasprintf(strp, format, ap, file, lineno, func);
 	va_end(ap);
 
 	return res;
@@ -1625,9 +1987,16 @@ int __ast_repl_asprintf(const char *file, int lineno, const char *func, char **s
 
 int __ast_repl_vasprintf(char **strp, const char *format, va_list ap, const char *file, int lineno, const char *func)
 {
+	int res;
+
 	DEBUG_CHAOS_RETURN(DEBUG_CHAOS_ALLOC_CHANCE, -1);
 
-	return vasprintf(strp, format, ap);
+	res = vasprintf(strp, format, ap);
+	if (res >= 0) {
+		sample_alloc(*strp, res + 1, file, lineno, func);
+	}
+
+	return res;
 }
 
 #endif	/* defined(__AST_DEBUG_MALLOC) */
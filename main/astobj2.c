@@ -67,7 +67,7 @@ struct __priv_data {
 	 * \note This field is constant after object creation.  It shares
 	 *       a uint32_t with \ref lockused and \ref magic.
 	 */
-	uint32_t options:3;
+	uint32_t options:4;
 	/*!
 	 * \brief Set to 1 when the lock is used if refdebug is enabled.
 	 *
@@ -90,11 +90,11 @@ struct __priv_data {
 	 *          all bitfields into a single 'uint32_t flags' field and use
 	 *          atomic operations from \file lock.h to perform writes.
 	 */
-	uint32_t magic:28;
+	uint32_t magic:27;
 };
 
-#define	AO2_MAGIC	0xa70b123
-#define	AO2_WEAK	0xa70b122
+#define	AO2_MAGIC	0x270b123
+#define	AO2_WEAK	0x270b122
 #define IS_AO2_MAGIC_BAD(p) (AO2_MAGIC != (p->priv_data.magic | 1))
 
 /*!
@@ -495,6 +495,42 @@ void *ao2_object_get_lockaddr(void *user_data)
 	return NULL;
 }
 
+/*!
+ * \internal
+ * \brief Allocate the zeroed memory of an ao2 object
+ *
+ * \note Clears AO2_ALLOC_OPT_POOL from options if the block did not come
+ * from the pools.
+ */
+static void *ao2_block_alloc(size_t size, unsigned int *options,
+	const char *file, int line, const char *func)
+{
+#if defined(AO2_POOLS)
+	if (*options & AO2_ALLOC_OPT_POOL) {
+		void *block = ao2_pool_alloc(size);
+
+		if (block) {
+			return block;
+		}
+	}
+#endif
+
+	*options &= ~AO2_ALLOC_OPT_POOL;
+	return __ast_calloc(1, size, file, line, func);
+}
+
+static void ao2_block_free(void *block, unsigned int options)
+{
+#if defined(AO2_POOLS)
+	if (options & AO2_ALLOC_OPT_POOL) {
+		ao2_pool_free(block);
+		return;
+	}
+#endif
+
+	ast_free(block);
+}
+
 int __ao2_ref(void *user_data, int delta,
 	const char *tag, const char *file, int line, const char *func)
 {
@@ -628,18 +664,18 @@ int __ao2_ref(void *user_data, int delta,
 		lock_state = obj->priv_data.lockused ? "used" : "unused";
 		ast_mutex_destroy(&obj_mutex->mutex.lock);
 
-		ast_free(obj_mutex);
+		ao2_block_free(obj_mutex, obj->priv_data.options);
 		break;
 	case AO2_ALLOC_OPT_LOCK_RWLOCK:
 		obj_rwlock = INTERNAL_OBJ_RWLOCK(user_data);
 		lock_state = obj->priv_data.lockused ? "used" : "unused";
 		ast_rwlock_destroy(&obj_rwlock->rwlock.lock);
 
-		ast_free(obj_rwlock);
+		ao2_block_free(obj_rwlock, obj->priv_data.options);
 		break;
 	case AO2_ALLOC_OPT_LOCK_NOLOCK:
 		lock_state = "none";
-		ast_free(obj);
+		ao2_block_free(obj, obj->priv_data.options);
 		break;
 	case AO2_ALLOC_OPT_LOCK_OBJ:
 		obj_lockobj = INTERNAL_OBJ_LOCKOBJ(user_data);
@@ -691,7 +727,7 @@ static void *internal_ao2_alloc(size_t data_size, ao2_destructor_fn destructor_f
 	switch (options & AO2_ALLOC_OPT_LOCK_MASK) {
 	case AO2_ALLOC_OPT_LOCK_MUTEX:
 		overhead = sizeof(*obj_mutex);
-		obj_mutex = __ast_calloc(1, overhead + data_size, file, line, func);
+		obj_mutex = ao2_block_alloc(overhead + data_size, &options, file, line, func);
 		if (obj_mutex == NULL) {
 			return NULL;
 		}
@@ -701,7 +737,7 @@ static void *internal_ao2_alloc(size_t data_size, ao2_destructor_fn destructor_f
 		break;
 	case AO2_ALLOC_OPT_LOCK_RWLOCK:
 		overhead = sizeof(*obj_rwlock);
-		obj_rwlock = __ast_calloc(1, overhead + data_size, file, line, func);
+		obj_rwlock = ao2_block_alloc(overhead + data_size, &options, file, line, func);
 		if (obj_rwlock == NULL) {
 			return NULL;
 		}
@@ -711,7 +747,7 @@ static void *internal_ao2_alloc(size_t data_size, ao2_destructor_fn destructor_f
 		break;
 	case AO2_ALLOC_OPT_LOCK_NOLOCK:
 		overhead = sizeof(*obj);
-		obj = __ast_calloc(1, overhead + data_size, file, line, func);
+		obj = ao2_block_alloc(overhead + data_size, &options, file, line, func);
 		if (obj == NULL) {
 			return NULL;
 		}
@@ -1183,6 +1219,10 @@ int astobj2_init(void)
 		return -1;
 	}
 
+	if (ao2_pool_init()) {
+		return -1;
+	}
+
 #if defined(AO2_DEBUG)
 	ast_cli_register_multiple(cli_astobj2, ARRAY_LEN(cli_astobj2));
 #endif	/* defined(AO2_DEBUG) */
@@ -36,6 +36,33 @@ int ao2_container_count(struct ao2_container *c)
 	return ast_atomic_fetchadd_int(&c->elements, 0);
 }
 
+/*!
+ * \internal
+ * \brief Determine if a search only needs the container read lock to modify it.
+ *
+ * \param self Container to operate upon.
+ * \param flags search_flags of the operation.
+ *
+ * \details
+ * Keyed operations on a striped container are protected by the
+ * stripe lock covering the key.
+ *
+ * \retval non-zero if the container read lock is sufficient.
+ */
+static int container_striped_keyed(struct ao2_container *self, enum search_flags flags)
+{
+	if (!self->striped) {
+		return 0;
+	}
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_OBJECT:
+	case OBJ_SEARCH_KEY:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 int __container_unlink_node_debug(struct ao2_container_node *node, uint32_t flags,
 	const char *tag, const char *file, int line, const char *func)
 {
@@ -109,10 +136,16 @@ int __ao2_link(struct ao2_container *self, void *obj_new, int flags,
 		return 0;
 	}
 
+	/* A striped container locks the stripe of the new node when inserting. */
 	if (flags & OBJ_NOLOCK) {
-		orig_lock = __adjust_lock(self, AO2_LOCK_REQ_WRLOCK, 1);
+		orig_lock = __adjust_lock(self,
+			self->striped ? AO2_LOCK_REQ_RDLOCK : AO2_LOCK_REQ_WRLOCK, 1);
 	} else {
-		ao2_wrlock(self);
+		if (self->striped) {
+			ao2_rdlock(self);
+		} else {
+			ao2_wrlock(self);
+		}
 		orig_lock = AO2_LOCK_REQ_MUTEX;
 	}
 
@@ -120,7 +153,7 @@ int __ao2_link(struct ao2_container *self, void *obj_new, int flags,
 	node = self->v_table->new_node(self, obj_new, tag, file, line, func);
 	if (node) {
 #if defined(AO2_DEBUG)
-		if (ao2_container_check(self, OBJ_NOLOCK)) {
+		if (!self->striped && ao2_container_check(self, OBJ_NOLOCK)) {
 			ast_log(LOG_ERROR, "Container integrity failed before insert.\n");
 		}
 #endif	/* defined(AO2_DEBUG) */
@@ -131,7 +164,7 @@ int __ao2_link(struct ao2_container *self, void *obj_new, int flags,
 			node->is_linked = 1;
 			ast_atomic_fetchadd_int(&self->elements, 1);
 #if defined(AO2_DEBUG)
-			AO2_DEVMODE_STAT(++self->nodes);
+			AO2_DEVMODE_STAT(ast_atomic_fetchadd_int(&self->nodes, 1));
 			if (self->v_table->link_stat) {
 				self->v_table->link_stat(self, node);
 			}
@@ -139,7 +172,7 @@ int __ao2_link(struct ao2_container *self, void *obj_new, int flags,
 			/* Fall through */
 		case AO2_CONTAINER_INSERT_NODE_OBJ_REPLACED:
 #if defined(AO2_DEBUG)
-			if (ao2_container_check(self, OBJ_NOLOCK)) {
+			if (!self->striped && ao2_container_check(self, OBJ_NOLOCK)) {
 				ast_log(LOG_ERROR, "Container integrity failed after insert or replace.\n");
 			}
 #endif	/* defined(AO2_DEBUG) */
@@ -297,14 +330,14 @@ static void *internal_ao2_traverse(struct ao2_container *self, enum search_flags
 
 	/* avoid modifications to the content */
 	if (flags & OBJ_NOLOCK) {
-		if (flags & OBJ_UNLINK) {
+		if ((flags & OBJ_UNLINK) && !container_striped_keyed(self, flags)) {
 			orig_lock = __adjust_lock(self, AO2_LOCK_REQ_WRLOCK, 1);
 		} else {
 			orig_lock = __adjust_lock(self, AO2_LOCK_REQ_RDLOCK, 1);
 		}
 	} else {
 		orig_lock = AO2_LOCK_REQ_MUTEX;
-		if (flags & OBJ_UNLINK) {
+		if ((flags & OBJ_UNLINK) && !container_striped_keyed(self, flags)) {
 			ao2_wrlock(self);
 		} else {
 			ao2_rdlock(self);
@@ -381,13 +414,18 @@ static void *internal_ao2_traverse(struct ao2_container *self, enum search_flags
 			break;
 		}
 	}
-	if (self->v_table->traverse_cleanup) {
-		self->v_table->traverse_cleanup(traversal_state);
-	}
 	if (node) {
-		/* Unref the node from self->v_table->traverse_first/traverse_next() */
+		/*
+		 * Unref the node from self->v_table->traverse_first/traverse_next()
+		 *
+		 * This must be done before the traversal cleanup so a striped
+		 * container still holds the stripe lock if the node is destroyed.
+		 */
 		ao2_ref(node, -1);
 	}
+	if (self->v_table->traverse_cleanup) {
+		self->v_table->traverse_cleanup(traversal_state);
+	}
 
 	if (flags & OBJ_NOLOCK) {
 		__adjust_lock(self, orig_lock, 0);
@@ -575,15 +613,19 @@ void *__ao2_iterator_next(struct ao2_iterator *iter,
 		return NULL;
 	}
 
+	/*
+	 * Iterating a striped container needs the write lock to keep
+	 * keyed operations from changing the buckets being walked.
+	 */
 	if (iter->flags & AO2_ITERATOR_DONTLOCK) {
-		if (iter->flags & AO2_ITERATOR_UNLINK) {
+		if ((iter->flags & AO2_ITERATOR_UNLINK) || iter->c->striped) {
 			orig_lock = __adjust_lock(iter->c, AO2_LOCK_REQ_WRLOCK, 1);
 		} else {
 			orig_lock = __adjust_lock(iter->c, AO2_LOCK_REQ_RDLOCK, 1);
 		}
 	} else {
 		orig_lock = AO2_LOCK_REQ_MUTEX;
-		if (iter->flags & AO2_ITERATOR_UNLINK) {
+		if ((iter->flags & AO2_ITERATOR_UNLINK) || iter->c->striped) {
 			ao2_wrlock(iter->c);
 		} else {
 			ao2_rdlock(iter->c);
@@ -798,7 +840,12 @@ void ao2_container_dump(struct ao2_container *self, enum search_flags flags, con
 	}
 
 	if (!(flags & OBJ_NOLOCK)) {
-		ao2_rdlock(self);
+		/* The container walk below does not lock the stripes. */
+		if (self->striped) {
+			ao2_wrlock(self);
+		} else {
+			ao2_rdlock(self);
+		}
 	}
 	if (name) {
 		prnt(where, "Container name: %s\n", name);
@@ -825,7 +872,11 @@ void ao2_container_stats(struct ao2_container *self, enum search_flags flags, co
 	}
 
 	if (!(flags & OBJ_NOLOCK)) {
-		ao2_rdlock(self);
+		if (self->striped) {
+			ao2_wrlock(self);
+		} else {
+			ao2_rdlock(self);
+		}
 	}
 	if (name) {
 		prnt(where, "Container name: %s\n", name);
@@ -869,7 +920,11 @@ int ao2_container_check(struct ao2_container *self, enum search_flags flags)
 	}
 
 	if (!(flags & OBJ_NOLOCK)) {
-		ao2_rdlock(self);
+		if (self->striped) {
+			ao2_wrlock(self);
+		} else {
+			ao2_rdlock(self);
+		}
 	}
 	res = self->v_table->integrity(self);
 	if (!(flags & OBJ_NOLOCK)) {
@@ -307,6 +307,14 @@ struct ao2_container {
 	 * issued about container node reference leaks.
 	 */
 	unsigned int destroying:1;
+	/*!
+	 * \brief TRUE if keyed operations are protected by container stripe locks.
+	 *
+	 * \note Set by the container type when it honors
+	 * AO2_CONTAINER_ALLOC_OPT_STRIPED.  Keyed links, finds and
+	 * unlinks then only need the container read lock.
+	 */
+	unsigned int striped:1;
 };
 
 /*!
@@ -29,6 +29,7 @@
 #include "astobj2_container_private.h"
 #include "asterisk/dlinkedlists.h"
 #include "asterisk/utils.h"
+#include "asterisk/threadstorage.h"
 
 /*!
  * A structure to create a linked list of entries,
@@ -57,6 +58,50 @@ struct hash_bucket {
 #endif	/* defined(AO2_DEBUG) */
 };
 
+/*! Maximum number of stripe locks in a striped hash container. */
+#define HASH_STRIPES_MAX	16
+
+/*! A lock covering a group of hash buckets. */
+struct hash_stripe {
+	/*! Lock protecting the buckets of the stripe. */
+	ast_rwlock_t lock;
+	/*!
+	 * \brief Thread holding the stripe write lock.
+	 *
+	 * \note Only ever compares equal to pthread_self() in the owning
+	 * thread so it is safe to check without holding the lock.
+	 */
+	pthread_t writer;
+};
+
+/*! Maximum number of stripe locks tracked for one thread. */
+#define HASH_STRIPES_HELD_MAX	64
+
+/*! A stripe lock taken by the current thread. */
+struct hash_stripe_held {
+	/*! Container of the stripe. */
+	struct ao2_container_hash *self;
+	/*! Stripe locked. */
+	int stripe;
+	/*! Number of nested read lockers.  Zero for the write lock. */
+	unsigned int readers;
+	/*! Id of the lock the stripe was released for.  Zero if held. */
+	unsigned int released_for;
+	/*! Id given to the stripes released to take this lock.  Zero if none. */
+	unsigned int id;
+};
+
+/*! Stripe locks taken by the current thread. */
+struct hash_stripes_held {
+	/*! Number of used entries in held. */
+	int used;
+	/*! Last id given to a lock that released other stripes. */
+	unsigned int last_id;
+	struct hash_stripe_held held[HASH_STRIPES_HELD_MAX];
+};
+
+AST_THREADSTORAGE(hash_stripes_held_buf);
+
 /*!
  * A hash container in addition to values common to all
  * container types, stores the hash callback function, the
@@ -71,12 +116,20 @@ struct ao2_container_hash {
 	ao2_hash_fn *hash_fn;
 	/*! Number of hash buckets in this container. */
 	int n_buckets;
+	/*! Number of stripe locks.  Zero if the container is not striped. */
+	int n_stripes;
+	/*! Stripe lock array of n_stripes located after the buckets. */
+	struct hash_stripe *stripes;
 	/*! Hash bucket array of n_buckets.  Variable size. */
 	struct hash_bucket buckets[0];
 };
 
 /*! Traversal state to restart a hash container traversal. */
 struct hash_traversal_state {
+	/*! Container being traversed. */
+	struct ao2_container_hash *self;
+	/*! Bitmask of the stripes locked by the traversal. */
+	uint32_t stripes_locked;
 	/*! Active sort function in the traversal if not NULL. */
 	ao2_sort_fn *sort_fn;
 	/*! Saved comparison callback arg pointer. */
@@ -99,6 +152,260 @@ struct hash_traversal_state_check {
 	char check[1 / (AO2_TRAVERSAL_STATE_SIZE / sizeof(struct hash_traversal_state))];
 };
 
+/*!
+ * \internal
+ * \brief Lock a container stripe without tracking it.
+ * \since 19.0.0
+ *
+ * \param self Container to operate upon.
+ * \param stripe Stripe to lock.
+ * \param write TRUE to write lock the stripe.
+ *
+ * \return Nothing
+ */
+static void hash_stripe_lock_raw(struct ao2_container_hash *self, int stripe, int write)
+{
+	struct hash_stripe *cur = &self->stripes[stripe];
+
+	if (write) {
+		ast_rwlock_wrlock(&cur->lock);
+		cur->writer = pthread_self();
+	} else {
+		ast_rwlock_rdlock(&cur->lock);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Unlock a container stripe locked by hash_stripe_lock_raw().
+ * \since 19.0.0
+ *
+ * \param self Container to operate upon.
+ * \param stripe Stripe to unlock.
+ *
+ * \return Nothing
+ */
+static void hash_stripe_unlock_raw(struct ao2_container_hash *self, int stripe)
+{
+	struct hash_stripe *cur = &self->stripes[stripe];
+
+	if (pthread_equal(cur->writer, pthread_self())) {
+		cur->writer = 0;
+	}
+	ast_rwlock_unlock(&cur->lock);
+}
+
+/*!
+ * \internal
+ * \brief Find a stripe lock held by the current thread.
+ * \since 19.0.0
+ *
+ * \param held Stripe locks taken by the current thread.
+ * \param self Container to operate upon.
+ * \param stripe Stripe to find.
+ *
+ * \retval entry of the held stripe lock.
+ * \retval NULL if the thread does not hold the stripe.
+ */
+static struct hash_stripe_held *hash_stripe_held_find(struct hash_stripes_held *held,
+	struct ao2_container_hash *self, int stripe)
+{
+	int idx;
+
+	for (idx = 0; idx < held->used; ++idx) {
+		if (held->held[idx].self == self
+			&& held->held[idx].stripe == stripe
+			&& !held->held[idx].released_for) {
+			return &held->held[idx];
+		}
+	}
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Lock a container stripe.
+ * \since 19.0.0
+ *
+ * \param self Container to operate upon.
+ * \param stripe Stripe to lock.
+ * \param write TRUE to write lock the stripe.
+ *
+ * \details
+ * A thread holding the stripe write lock never waits for another
+ * stripe of the container.  Before taking a write lock, or any
+ * lock while holding a write lock, the thread releases the stripes
+ * of the container it holds.  They are locked again in ascending
+ * order when the new lock is released.  This lets a callback
+ * unlink or link with OBJ_NOLOCK while its traversal holds the
+ * stripe read lock.  As when promoting the container lock, other
+ * threads can change the container while the stripes are released.
+ *
+ * \retval 1 if the stripe was locked.
+ * \retval 0 if this thread already holds the stripe write lock.
+ */
+static int hash_stripe_lock(struct ao2_container_hash *self, int stripe, int write)
+{
+	struct hash_stripes_held *held;
+	struct hash_stripe_held *entry;
+	unsigned int id = 0;
+	int release = 0;
+	int idx;
+
+	if (pthread_equal(self->stripes[stripe].writer, pthread_self())) {
+		return 0;
+	}
+
+	held = ast_threadstorage_get(&hash_stripes_held_buf, sizeof(*held));
+	if (!held || held->used == ARRAY_LEN(held->held)) {
+		/* Cannot track the lock.  It will not be released for a write lock. */
+		hash_stripe_lock_raw(self, stripe, write);
+		return 1;
+	}
+
+	if (!write) {
+		entry = hash_stripe_held_find(held, self, stripe);
+		if (entry) {
+			++entry->readers;
+			return 1;
+		}
+	}
+
+	for (idx = 0; idx < held->used; ++idx) {
+		entry = &held->held[idx];
+		if (entry->self == self && !entry->released_for
+			&& (write || !entry->readers)) {
+			release = 1;
+			break;
+		}
+	}
+	if (release) {
+		id = ++held->last_id ?: ++held->last_id;
+		for (idx = 0; idx < held->used; ++idx) {
+			entry = &held->held[idx];
+			if (entry->self == self && !entry->released_for) {
+				hash_stripe_unlock_raw(self, entry->stripe);
+				entry->released_for = id;
+			}
+		}
+	}
+
+	hash_stripe_lock_raw(self, stripe, write);
+	entry = &held->held[held->used++];
+	entry->self = self;
+	entry->stripe = stripe;
+	entry->readers = write ? 0 : 1;
+	entry->released_for = 0;
+	entry->id = id;
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Unlock a container stripe locked by hash_stripe_lock().
+ * \since 19.0.0
+ *
+ * \param self Container to operate upon.
+ * \param stripe Stripe to unlock.
+ *
+ * \return Nothing
+ */
+static void hash_stripe_unlock(struct ao2_container_hash *self, int stripe)
+{
+	struct hash_stripes_held *held;
+	struct hash_stripe_held *entry;
+	unsigned int id;
+	int idx;
+
+	held = ast_threadstorage_get(&hash_stripes_held_buf, sizeof(*held));
+	entry = held ? hash_stripe_held_find(held, self, stripe) : NULL;
+	if (!entry) {
+		hash_stripe_unlock_raw(self, stripe);
+		return;
+	}
+	if (1 < entry->readers) {
+		--entry->readers;
+		return;
+	}
+
+	hash_stripe_unlock_raw(self, stripe);
+	id = entry->id;
+	*entry = held->held[--held->used];
+	if (!id) {
+		return;
+	}
+
+	/* Lock again the stripes released to take this lock. */
+	for (stripe = 0; stripe < self->n_stripes; ++stripe) {
+		for (idx = 0; idx < held->used; ++idx) {
+			entry = &held->held[idx];
+			if (entry->released_for == id && entry->stripe == stripe) {
+				hash_stripe_lock_raw(self, stripe, !entry->readers);
+				entry->released_for = 0;
+			}
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Lock the stripes needed by a traversal.
+ * \since 19.0.0
+ *
+ * \param self Container to operate upon.
+ * \param state Traversal state recording the locked stripes.
+ * \param bucket Only bucket searched or -1 if searching all buckets.
+ *
+ * \note Stripes are always locked in ascending order.
+ *
+ * \return Nothing
+ */
+static void hash_stripes_lock_traversal(struct ao2_container_hash *self,
+	struct hash_traversal_state *state, int bucket)
+{
+	int write = (state->flags & OBJ_UNLINK) ? 1 : 0;
+	int stripe;
+
+	if (0 <= bucket) {
+		stripe = bucket % self->n_stripes;
+		if (hash_stripe_lock(self, stripe, write)) {
+			state->stripes_locked |= (1U << stripe);
+		}
+		return;
+	}
+	if (write) {
+		/* The container write lock already excludes every other thread. */
+		return;
+	}
+
+	for (stripe = 0; stripe < self->n_stripes; ++stripe) {
+		if (hash_stripe_lock(self, stripe, 0)) {
+			state->stripes_locked |= (1U << stripe);
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Release the stripes locked by a traversal.
+ * \since 19.0.0
+ *
+ * \param state Traversal state recording the locked stripes.
+ *
+ * \return Nothing
+ */
+static void hash_ao2_find_cleanup(struct hash_traversal_state *state)
+{
+	int stripe;
+
+	for (stripe = state->self->n_stripes; stripe--;) {
+		if (state->stripes_locked & (1U << stripe)) {
+			hash_stripe_unlock(state->self, stripe);
+		}
+	}
+	state->stripes_locked = 0;
+}
+
 /*!
  * \internal
  * \brief Create an empty copy of this container.
@@ -138,7 +445,8 @@ static struct ao2_container *hash_ao2_alloc_empty_clone(struct ao2_container_has
  * container is already locked.
  *
  * \note The container must be locked when the node is
- * unreferenced.
+ * unreferenced.  For a striped container holding the stripe
+ * write lock of the node's bucket is also sufficient.
  *
  * \return Nothing
  */
@@ -149,6 +457,8 @@ static void hash_ao2_node_destructor(void *v_doomed)
 	if (doomed->common.is_linked) {
 		struct ao2_container_hash *my_container;
 		struct hash_bucket *bucket;
+		int stripe = 0;
+		int stripe_locked = 0;
 
 		/*
 		 * Promote to write lock if not already there.  Since
@@ -168,17 +478,27 @@ static void hash_ao2_node_destructor(void *v_doomed)
 		is_ao2_object(my_container);
 #endif
 
-		__adjust_lock(my_container, AO2_LOCK_REQ_WRLOCK, 1);
+		if (!my_container->n_stripes) {
+			__adjust_lock(my_container, AO2_LOCK_REQ_WRLOCK, 1);
+		} else {
+			/* Promote the stripe of the node to write lock instead. */
+			stripe = doomed->my_bucket % my_container->n_stripes;
+			stripe_locked = hash_stripe_lock(my_container, stripe, 1);
+		}
 
 #if defined(AO2_DEBUG)
 		if (!my_container->common.destroying
+			&& !my_container->n_stripes
 			&& ao2_container_check(doomed->common.my_container, OBJ_NOLOCK)) {
 			ast_log(LOG_ERROR, "Container integrity failed before node deletion.\n");
 		}
 #endif	/* defined(AO2_DEBUG) */
 		bucket = &my_container->buckets[doomed->my_bucket];
 		AST_DLLIST_REMOVE(&bucket->list, doomed, links);
-		AO2_DEVMODE_STAT(--my_container->common.nodes);
+		AO2_DEVMODE_STAT(ast_atomic_fetchadd_int(&my_container->common.nodes, -1));
+		if (stripe_locked) {
+			hash_stripe_unlock(my_container, stripe);
+		}
 	}
 
 	/*
@@ -211,7 +531,7 @@ static struct hash_bucket_node *hash_ao2_new_node(struct ao2_container_hash *sel
 	int i;
 
 	node = ao2_alloc_options(sizeof(*node), hash_ao2_node_destructor,
-		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_NO_REF_DEBUG);
+		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_NO_REF_DEBUG | AO2_ALLOC_OPT_POOL);
 	if (!node) {
 		return NULL;
 	}
@@ -228,7 +548,7 @@ static struct hash_bucket_node *hash_ao2_new_node(struct ao2_container_hash *sel
 
 /*!
  * \internal
- * \brief Insert a node into this container.
+ * \brief Insert a node into its hash bucket.
  * \since 12.0.0
  *
  * \param self Container to operate upon.
@@ -236,7 +556,7 @@ static struct hash_bucket_node *hash_ao2_new_node(struct ao2_container_hash *sel
  *
  * \return enum ao2_container_insert value.
  */
-static enum ao2_container_insert hash_ao2_insert_node(struct ao2_container_hash *self,
+static enum ao2_container_insert hash_bucket_insert_node(struct ao2_container_hash *self,
 	struct hash_bucket_node *node)
 {
 	int cmp;
@@ -319,6 +639,43 @@ static enum ao2_container_insert hash_ao2_insert_node(struct ao2_container_hash
 	return AO2_CONTAINER_INSERT_NODE_INSERTED;
 }
 
+/*!
+ * \internal
+ * \brief Insert a node into this container.
+ * \since 12.0.0
+ *
+ * \param self Container to operate upon.
+ * \param node Container node to insert into the container.
+ *
+ * \return enum ao2_container_insert value.
+ */
+static enum ao2_container_insert hash_ao2_insert_node(struct ao2_container_hash *self,
+	struct hash_bucket_node *node)
+{
+	enum ao2_container_insert res;
+	int stripe;
+	int locked;
+
+	if (!self->n_stripes) {
+		return hash_bucket_insert_node(self, node);
+	}
+
+	stripe = node->my_bucket % self->n_stripes;
+	locked = hash_stripe_lock(self, stripe, 1);
+	res = hash_bucket_insert_node(self, node);
+	if (res == AO2_CONTAINER_INSERT_NODE_INSERTED) {
+		/*
+		 * The node must be marked linked before other threads can find
+		 * and unlink it through the stripe.
+		 */
+		node->common.is_linked = 1;
+	}
+	if (locked) {
+		hash_stripe_unlock(self, stripe);
+	}
+	return res;
+}
+
 /*!
  * \internal
  * \brief Find the first hash container node in a traversal.
@@ -339,6 +696,7 @@ static struct hash_bucket_node *hash_ao2_find_first(struct ao2_container_hash *s
 	int cmp;
 
 	memset(state, 0, sizeof(*state));
+	state->self = self;
 	state->arg = arg;
 	state->flags = flags;
 
@@ -378,6 +736,10 @@ static struct hash_bucket_node *hash_ao2_find_first(struct ao2_container_hash *s
 		break;
 	}
 
+	if (self->n_stripes) {
+		hash_stripes_lock_traversal(self, state, bucket_cur);
+	}
+
 	if (state->descending) {
 		/*
 		 * Determine the search boundaries of a descending traversal.
@@ -748,6 +1110,10 @@ static void hash_ao2_destroy(struct ao2_container_hash *self)
 			break;
 		}
 	}
+
+	for (idx = self->n_stripes; idx--;) {
+		ast_rwlock_destroy(&self->stripes[idx].lock);
+	}
 }
 
 #if defined(AO2_DEBUG)
@@ -1017,6 +1383,7 @@ static const struct ao2_container_methods v_table_hash = {
 	.insert = (ao2_container_insert_fn) hash_ao2_insert_node,
 	.traverse_first = (ao2_container_find_first_fn) hash_ao2_find_first,
 	.traverse_next = (ao2_container_find_next_fn) hash_ao2_find_next,
+	.traverse_cleanup = (ao2_container_find_cleanup_fn) hash_ao2_find_cleanup,
 	.iterator_next = (ao2_iterator_next_fn) hash_ao2_iterator_next,
 	.destroy = (ao2_container_destroy_fn) hash_ao2_destroy,
 #if defined(AO2_DEBUG)
@@ -1048,6 +1415,7 @@ static int hash_zero(const void *user_obj, const int flags)
  * \param self Container to initialize.
  * \param options Container behaviour options (See enum ao2_container_opts)
  * \param n_buckets Number of buckets for hash
+ * \param n_stripes Number of stripe locks.  Zero if not striped.
  * \param hash_fn Pointer to a function computing a hash value.
  * \param sort_fn Pointer to a sort function.
  * \param cmp_fn Pointer to a compare function used by ao2_find.
@@ -1056,8 +1424,11 @@ static int hash_zero(const void *user_obj, const int flags)
  */
 static struct ao2_container *hash_ao2_container_init(
 	struct ao2_container_hash *self, unsigned int options, unsigned int n_buckets,
-	ao2_hash_fn *hash_fn, ao2_sort_fn *sort_fn, ao2_callback_fn *cmp_fn)
+	unsigned int n_stripes, ao2_hash_fn *hash_fn, ao2_sort_fn *sort_fn,
+	ao2_callback_fn *cmp_fn)
 {
+	unsigned int idx;
+
 	if (!self) {
 		return NULL;
 	}
@@ -1069,6 +1440,15 @@ static struct ao2_container *hash_ao2_container_init(
 	self->hash_fn = hash_fn ? hash_fn : hash_zero;
 	self->n_buckets = n_buckets;
 
+	if (n_stripes) {
+		self->n_stripes = n_stripes;
+		self->stripes = (struct hash_stripe *) &self->buckets[n_buckets];
+		for (idx = 0; idx < n_stripes; ++idx) {
+			ast_rwlock_init(&self->stripes[idx].lock);
+		}
+		self->common.striped = 1;
+	}
+
 #ifdef AO2_DEBUG
 	ast_atomic_fetchadd_int(&ao2.total_containers, 1);
 #endif	/* defined(AO2_DEBUG) */
@@ -1082,16 +1462,29 @@ struct ao2_container *__ao2_container_alloc_hash(unsigned int ao2_options,
 	const char *tag, const char *file, int line, const char *func)
 {
 	unsigned int num_buckets;
+	unsigned int num_stripes = 0;
 	size_t container_size;
 	struct ao2_container_hash *self;
 
 	num_buckets = hash_fn ? n_buckets : 1;
-	container_size = sizeof(struct ao2_container_hash) + num_buckets * sizeof(struct hash_bucket);
+
+	/*
+	 * Striping only helps when readers can share the container lock
+	 * and there is more than one bucket to spread the keys over.
+	 */
+	if ((container_options & AO2_CONTAINER_ALLOC_OPT_STRIPED)
+		&& (ao2_options & AO2_ALLOC_OPT_LOCK_MASK) == AO2_ALLOC_OPT_LOCK_RWLOCK
+		&& 1 < num_buckets) {
+		num_stripes = MIN(num_buckets, HASH_STRIPES_MAX);
+	}
+
+	container_size = sizeof(struct ao2_container_hash) + num_buckets * sizeof(struct hash_bucket)
+		+ num_stripes * sizeof(struct hash_stripe);
 
 	self = __ao2_alloc(container_size, container_destruct, ao2_options,
 		tag ?: __PRETTY_FUNCTION__, file, line, func);
-	return hash_ao2_container_init(self, container_options, num_buckets, hash_fn,
-		sort_fn, cmp_fn);
+	return hash_ao2_container_init(self, container_options, num_buckets, num_stripes,
+		hash_fn, sort_fn, cmp_fn);
 }
 
 struct ao2_container *__ao2_container_alloc_list(unsigned int ao2_options,
@@ -0,0 +1,329 @@
+/*
+ * astobj2_pool - Size classed allocation pools for astobj2 objects.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Size classed allocation pools for astobj2 objects.
+ *
+ * \details
+ * Objects allocated with AO2_ALLOC_OPT_POOL are carved from fixed size
+ * classes.  Freed blocks are kept in per thread magazines so the common
+ * alloc and free are a few instructions with no lock.  When a thread's
+ * magazine fills it is handed to the depot of its size class, where a
+ * thread that runs out picks it up.  This suits the usual pattern of
+ * one thread allocating objects that another thread releases.
+ *
+ * Blocks are only returned to malloc when the depot is full, so a pool
+ * keeps at most POOL_DEPOT_MAX magazines per size class plus what is
+ * loaded in each thread.  Recycling blocks of a few fixed sizes keeps
+ * short lived objects from fragmenting the heap.
+ */
+
+#include "asterisk.h"
+
+#include "asterisk/_private.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/cli.h"
+#include "asterisk/lock.h"
+#include "asterisk/threadstorage.h"
+#include "asterisk/utils.h"
+#include "astobj2_private.h"
+
+#if defined(AO2_POOLS)
+
+/*! \brief Block sizes of the size classes, including the ao2 header */
+static const size_t pool_class_sizes[] = {
+	64, 96, 128, 192, 256, 384, 512, 768, 1024,
+};
+
+#define POOL_CLASSES ARRAY_LEN(pool_class_sizes)
+
+/*! \brief Number of blocks in a magazine */
+#define POOL_MAGAZINE_SIZE 32
+
+/*! \brief Maximum number of magazines kept in the depot of a size class */
+#define POOL_DEPOT_MAX 64
+
+/*!
+ * \brief Header preceding every pooled block
+ *
+ * \note Padded so the ao2 object that follows stays suitably aligned.
+ */
+union pool_header {
+	unsigned int size_class;
+	long double align;
+};
+
+struct pool_magazine {
+	struct pool_magazine *next;
+	unsigned int count;
+	void *blocks[POOL_MAGAZINE_SIZE];
+};
+
+struct pool_class {
+	ast_mutex_t lock;
+	/*! Magazines holding free blocks */
+	struct pool_magazine *depot;
+	/*! Number of magazines in the depot */
+	unsigned int depot_count;
+	/*! Blocks currently allocated from malloc */
+	int blocks;
+	/*! Blocks ever allocated from malloc */
+	int block_allocs;
+	/*! Magazines exchanged with the depot */
+	int exchanges;
+};
+
+/* Objects are allocated before astobj2_init(), so the locks are initialized statically. */
+static struct pool_class pool_classes[POOL_CLASSES] = {
+	[0 ... POOL_CLASSES - 1] = { .lock = AST_MUTEX_INIT_VALUE, },
+};
+
+/*! \brief The magazines loaded by a thread */
+struct pool_cache {
+	struct pool_magazine *loaded[POOL_CLASSES];
+};
+
+static void pool_cache_release(void *data);
+
+AST_THREADSTORAGE_CUSTOM(pool_cache_storage, NULL, pool_cache_release);
+
+static int pool_size_class(size_t size)
+{
+	int idx;
+
+	for (idx = 0; idx < POOL_CLASSES; ++idx) {
+		if (size <= pool_class_sizes[idx]) {
+			return idx;
+		}
+	}
+
+	return -1;
+}
+
+static void pool_block_free(struct pool_class *cls, void *block)
+{
+	ast_atomic_fetchadd_int(&cls->blocks, -1);
+	ast_std_free(block);
+}
+
+/*!
+ * \brief Hand a magazine to the depot
+ *
+ * \return NULL if the depot took it, else the magazine which the
+ * caller must empty.
+ */
+static struct pool_magazine *pool_depot_put(struct pool_class *cls, struct pool_magazine *mag)
+{
+	ast_mutex_lock(&cls->lock);
+	if (cls->depot_count < POOL_DEPOT_MAX) {
+		mag->next = cls->depot;
+		cls->depot = mag;
+		++cls->depot_count;
+		++cls->exchanges;
+		mag = NULL;
+	}
+	ast_mutex_unlock(&cls->lock);
+
+	return mag;
+}
+
+static struct pool_magazine *pool_depot_get(struct pool_class *cls)
+{
+	struct pool_magazine *mag;
+
+	ast_mutex_lock(&cls->lock);
+	mag = cls->depot;
+	if (mag) {
+		cls->depot = mag->next;
+		--cls->depot_count;
+		++cls->exchanges;
+	}
+	ast_mutex_unlock(&cls->lock);
+
+	return mag;
+}
+
+static void pool_magazine_empty(struct pool_class *cls, struct pool_magazine *mag)
+{
+	while (mag->count) {
+		pool_block_free(cls, mag->blocks[--mag->count]);
+	}
+}
+
+static void pool_cache_release(void *data)
+{
+	struct pool_cache *cache = data;
+	int idx;
+
+	for (idx = 0; idx < POOL_CLASSES; ++idx) {
+		struct pool_magazine *mag = cache->loaded[idx];
+
+		if (!mag) {
+			continue;
+		}
+		if (mag->count) {
+			mag = pool_depot_put(&pool_classes[idx], mag);
+		}
+		if (mag) {
+			pool_magazine_empty(&pool_classes[idx], mag);
+			ast_std_free(mag);
+		}
+	}
+
+	ast_free(cache);
+}
+
+void *ao2_pool_alloc(size_t size)
+{
+	struct pool_cache *cache;
+	struct pool_class *cls;
+	struct pool_magazine *mag;
+	union pool_header *block;
+	int idx;
+
+	idx = pool_size_class(size);
+	if (idx < 0) {
+		return NULL;
+	}
+	cls = &pool_classes[idx];
+
+	cache = ast_threadstorage_get(&pool_cache_storage, sizeof(*cache));
+	if (!cache) {
+		return NULL;
+	}
+
+	mag = cache->loaded[idx];
+	if (!mag || !mag->count) {
+		struct pool_magazine *full = pool_depot_get(cls);
+
+		if (full) {
+			ast_std_free(mag);
+			cache->loaded[idx] = mag = full;
+		}
+	}
+
+	if (mag && mag->count) {
+		block = mag->blocks[--mag->count];
+	} else {
+		block = ast_std_malloc(sizeof(*block) + pool_class_sizes[idx]);
+		if (!block) {
+			return NULL;
+		}
+		block->size_class = idx;
+		ast_atomic_fetchadd_int(&cls->blocks, +1);
+		ast_atomic_fetchadd_int(&cls->block_allocs, +1);
+	}
+
+	memset(block + 1, 0, size);
+	return block + 1;
+}
+
+void ao2_pool_free(void *ptr)
+{
+	union pool_header *block = (union pool_header *) ptr - 1;
+	struct pool_class *cls = &pool_classes[block->size_class];
+	struct pool_cache *cache;
+	struct pool_magazine *mag;
+
+	cache = ast_threadstorage_get(&pool_cache_storage, sizeof(*cache));
+	if (!cache) {
+		pool_block_free(cls, block);
+		return;
+	}
+
+	mag = cache->loaded[block->size_class];
+	if (mag && mag->count == POOL_MAGAZINE_SIZE) {
+		mag = pool_depot_put(cls, mag);
+		if (mag) {
+			/* The depot is full, give the blocks back to malloc. */
+			pool_magazine_empty(cls, mag);
+		}
+		cache->loaded[block->size_class] = mag;
+	}
+
+	if (!mag) {
+		mag = ast_std_calloc(1, sizeof(*mag));
+		if (!mag) {
+			pool_block_free(cls, block);
+			return;
+		}
+		cache->loaded[block->size_class] = mag;
+	}
+
+	mag->blocks[mag->count++] = block;
+}
+
+static char *handle_astobj2_pools(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	int idx;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "astobj2 show pools";
+		e->usage = "Usage: astobj2 show pools\n"
+			   "       Show the astobj2 allocation pool size classes\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+#define FORMAT "%10s %12s %12s %10s %12s\n"
+#define FORMAT2 "%10zu %12d %12d %10u %12d\n"
+	ast_cli(a->fd, FORMAT, "Block", "Blocks", "Allocated", "Depot", "Exchanges");
+	for (idx = 0; idx < POOL_CLASSES; ++idx) {
+		struct pool_class *cls = &pool_classes[idx];
+
+		ast_mutex_lock(&cls->lock);
+		ast_cli(a->fd, FORMAT2, pool_class_sizes[idx], cls->blocks, cls->block_allocs,
+			cls->depot_count, cls->exchanges);
+		ast_mutex_unlock(&cls->lock);
+	}
+#undef FORMAT
+#undef FORMAT2
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_astobj2_pool[] = {
+	AST_CLI_DEFINE(handle_astobj2_pools, "Show astobj2 allocation pools"),
+};
+
+static void ao2_pool_cleanup(void)
+{
+	ast_cli_unregister_multiple(cli_astobj2_pool, ARRAY_LEN(cli_astobj2_pool));
+}
+
+int ao2_pool_init(void)
+{
+	ast_cli_register_multiple(cli_astobj2_pool, ARRAY_LEN(cli_astobj2_pool));
+	ast_register_cleanup(ao2_pool_cleanup);
+
+	return 0;
+}
+
+#else /* !defined(AO2_POOLS) */
+
+int ao2_pool_init(void)
+{
+	return 0;
+}
+
+#endif /* defined(AO2_POOLS) */
@@ -63,4 +63,33 @@ int internal_is_ao2_object(void *user_data);
 
 enum ao2_lock_req __adjust_lock(void *user_data, enum ao2_lock_req lock_how, int keep_stronger);
 
+#if !defined(MALLOC_DEBUG)
+/*!
+ * \brief AO2_ALLOC_OPT_POOL allocates from the astobj2 pools
+ *
+ * \note MALLOC_DEBUG must see every allocation, so pools are not
+ * used with it.
+ */
+#define AO2_POOLS
+#endif
+
+/*!
+ * \internal
+ * \brief Allocate a zeroed block from the astobj2 pools
+ *
+ * \param size Size of the block
+ *
+ * \retval NULL if size is too large for the pools, or on failure
+ * \return The block, to be released with ao2_pool_free()
+ */
+void *ao2_pool_alloc(size_t size);
+
+/*!
+ * \internal
+ * \brief Release a block allocated by ao2_pool_alloc()
+ */
+void ao2_pool_free(void *ptr);
+
+int ao2_pool_init(void);
+
 #endif /* ASTOBJ2_PRIVATE_H_ */
@@ -906,7 +906,7 @@ static struct rbtree_node *rb_ao2_new_node(struct ao2_container_rbtree *self, vo
 	struct rbtree_node *node;
 
 	node = ao2_alloc_options(sizeof(*node), rb_ao2_node_destructor,
-		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_NO_REF_DEBUG);
+		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_NO_REF_DEBUG | AO2_ALLOC_OPT_POOL);
 	if (!node) {
 		return NULL;
 	}
@@ -0,0 +1,191 @@
+/*
+ * astobj2_rcu - read-copy-update holders for AO2 objects.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Functions implementing ao2_rcu_obj routines.
+ *
+ * \details
+ * Readers register in one of two grace period phases by bumping
+ * the phase's reader count.  A writer publishes the new object and
+ * then flips the phase twice, waiting each time for the readers of
+ * the phase it flipped away from to finish.  After the second wait
+ * no reader can still hold the old object without a reference of
+ * its own.
+ */
+
+/*** MODULEINFO
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include <sched.h>
+
+#include "asterisk/astobj2.h"
+#include "asterisk/utils.h"
+
+#if defined(HAVE_C_ATOMICS)
+#define rcu_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define rcu_atomic_store(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#else
+#define rcu_atomic_load(ptr) __sync_fetch_and_add((ptr), 0)
+#define rcu_atomic_store(ptr, val) \
+	do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+#endif
+
+/*!
+ * \internal
+ * \brief Enter an RCU read side section.
+ *
+ * \param holder RCU ao2 object holder.
+ *
+ * \return Phase to pass to rcu_read_end().
+ */
+static int rcu_read_begin(struct ao2_rcu_obj *holder)
+{
+	int phase = rcu_atomic_load(&holder->phase) & 1;
+
+	ast_atomic_fetch_add(&holder->readers[phase], 1, __ATOMIC_SEQ_CST);
+	return phase;
+}
+
+/*!
+ * \internal
+ * \brief Leave an RCU read side section.
+ *
+ * \param holder RCU ao2 object holder.
+ * \param phase Phase returned by rcu_read_begin().
+ *
+ * \return Nothing
+ */
+static void rcu_read_end(struct ao2_rcu_obj *holder, int phase)
+{
+	ast_atomic_fetch_sub(&holder->readers[phase], 1, __ATOMIC_SEQ_CST);
+}
+
+/*!
+ * \internal
+ * \brief Wait for all readers that could see the previous object.
+ *
+ * \param holder RCU ao2 object holder.
+ *
+ * \note The holder lock must be held.
+ *
+ * \return Nothing
+ */
+static void rcu_synchronize(struct ao2_rcu_obj *holder)
+{
+	int flip;
+
+	for (flip = 0; flip < 2; ++flip) {
+		unsigned int phase = holder->phase;
+
+		rcu_atomic_store(&holder->phase, phase + 1);
+		while (rcu_atomic_load(&holder->readers[phase & 1])) {
+			sched_yield();
+		}
+	}
+}
+
+void *__ao2_rcu_obj_replace(struct ao2_rcu_obj *holder, void *obj, const char *tag, const char *file, int line, const char *func, const char *name)
+{
+	void *obj_old;
+
+	if (!holder) {
+		/* For sanity */
+		ast_log(LOG_ERROR, "Must be called with an RCU object holder!\n");
+		ast_assert(0);
+		return NULL;
+	}
+	if (__ast_pthread_mutex_lock(file, line, func, name, &holder->lock)) {
+		/* Could not get the lock. */
+		ast_assert(0);
+		return NULL;
+	}
+
+	if (obj) {
+		__ao2_ref(obj, +1, tag, file, line, func);
+	}
+	obj_old = holder->obj;
+	rcu_atomic_store(&holder->obj, obj);
+
+	if (obj_old) {
+		rcu_synchronize(holder);
+	}
+
+	__ast_pthread_mutex_unlock(file, line, func, name, &holder->lock);
+
+	return obj_old;
+}
+
+int __ao2_rcu_obj_replace_unref(struct ao2_rcu_obj *holder, void *obj, const char *tag, const char *file, int line, const char *func, const char *name)
+{
+	void *obj_old;
+
+	obj_old = __ao2_rcu_obj_replace(holder, obj, tag, file, line, func, name);
+	if (obj_old) {
+		__ao2_ref(obj_old, -1, tag, file, line, func);
+		return 1;
+	}
+	return 0;
+}
+
+void *__ao2_rcu_obj_ref(struct ao2_rcu_obj *holder, const char *tag, const char *file, int line, const char *func, const char *name)
+{
+	void *obj;
+	int phase;
+
+	if (!holder) {
+		/* For sanity */
+		ast_log(LOG_ERROR, "Must be called with an RCU object holder!\n");
+		ast_assert(0);
+		return NULL;
+	}
+
+	phase = rcu_read_begin(holder);
+	obj = rcu_atomic_load(&holder->obj);
+	if (obj) {
+		__ao2_ref(obj, +1, tag, file, line, func);
+	}
+	rcu_read_end(holder, phase);
+
+	return obj;
+}
+
+void *__ao2_rcu_obj_find(struct ao2_rcu_obj *holder, const void *arg, enum search_flags flags, const char *tag, const char *file, int line, const char *func, const char *name)
+{
+	struct ao2_container *container;
+	void *obj = NULL;
+	int phase;
+
+	if (!holder || (flags & OBJ_UNLINK)) {
+		/* For sanity */
+		ast_log(LOG_ERROR, "Must be called with an RCU object holder and without OBJ_UNLINK!\n");
+		ast_assert(0);
+		return NULL;
+	}
+
+	phase = rcu_read_begin(holder);
+	container = rcu_atomic_load(&holder->obj);
+	if (container) {
+		/* Published containers are never modified so no locking is needed. */
+		obj = __ao2_find(container, arg, flags | OBJ_NOLOCK, tag, file, line, func);
+	}
+	rcu_read_end(holder, phase);
+
+	return obj;
+}
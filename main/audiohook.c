@@ -40,6 +40,7 @@
 #include "asterisk/frame.h"
 #include "asterisk/translate.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/slinear_mix.h"
 
 #define AST_AUDIOHOOK_SYNC_TOLERANCE 100 /*!< Tolerance in milliseconds for audiohooks synchronization */
 #define AST_AUDIOHOOK_SMALL_QUEUE_TOLERANCE 100 /*!< When small queue is enabled, this is the maximum amount of audio that can remain queued at a time. */
@@ -252,10 +253,8 @@ static struct ast_frame *audiohook_read_frame_single(struct ast_audiohook *audio
 
 static struct ast_frame *audiohook_read_frame_both(struct ast_audiohook *audiohook, size_t samples, struct ast_frame **read_reference, struct ast_frame **write_reference)
 {
-	int count;
 	int usable_read;
 	int usable_write;
-	short adjust_value;
 	short buf1[samples];
 	short buf2[samples];
 	short *read_buf = NULL;
@@ -298,14 +297,7 @@ static struct ast_frame *audiohook_read_frame_both(struct ast_audiohook *audioho
 				memset(buf1, 0, sizeof(buf1));
 			} else if (audiohook->options.read_volume) {
 				/* Adjust read volume if need be */
-				adjust_value = abs(audiohook->options.read_volume);
-				for (count = 0; count < samples; count++) {
-					if (audiohook->options.read_volume > 0) {
-						ast_slinear_saturated_multiply(&buf1[count], &adjust_value);
-					} else if (audiohook->options.read_volume < 0) {
-						ast_slinear_saturated_divide(&buf1[count], &adjust_value);
-					}
-				}
+				ast_slinear_mix_adjust_volume(buf1, samples, audiohook->options.read_volume);
 			}
 		}
 	} else {
@@ -322,14 +314,7 @@ static struct ast_frame *audiohook_read_frame_both(struct ast_audiohook *audioho
 				memset(buf2, 0, sizeof(buf2));
 			} else if (audiohook->options.write_volume) {
 				/* Adjust write volume if need be */
-				adjust_value = abs(audiohook->options.write_volume);
-				for (count = 0; count < samples; count++) {
-					if (audiohook->options.write_volume > 0) {
-						ast_slinear_saturated_multiply(&buf2[count], &adjust_value);
-					} else if (audiohook->options.write_volume < 0) {
-						ast_slinear_saturated_divide(&buf2[count], &adjust_value);
-					}
-				}
+				ast_slinear_mix_adjust_volume(buf2, samples, audiohook->options.write_volume);
 			}
 		}
 	} else {
@@ -363,9 +348,7 @@ static struct ast_frame *audiohook_read_frame_both(struct ast_audiohook *audioho
 	if (read_buf) {
 		frame.data.ptr = read_buf;
 		if (write_buf) {
-			for (count = 0; count < samples; count++) {
-				ast_slinear_saturated_add(read_buf++, write_buf++);
-			}
+			ast_slinear_mix_add(read_buf, write_buf, samples);
 		}
 	} else if (write_buf) {
 		frame.data.ptr = write_buf;
@@ -955,6 +938,7 @@ static void audiohook_list_set_hook_rate(struct ast_audiohook_list *audiohook_li
 static struct ast_frame *audio_audiohook_write_list(struct ast_channel *chan, struct ast_audiohook_list *audiohook_list, enum ast_audiohook_direction direction, struct ast_frame *frame)
 {
 	struct ast_frame *start_frame = frame, *middle_frame = frame, *end_frame = frame;
+	struct ast_frame *spy_frame;
 	struct ast_audiohook *audiohook = NULL;
 	int samples;
 	int middle_frame_manipulated = 0;
@@ -991,6 +975,27 @@ static struct ast_frame *audio_audiohook_write_list(struct ast_channel *chan, st
 	 */
 	internal_sample_rate = audiohook_list->list_internal_samp_rate;
 
+	/* Whispers and manipulators change the audio in place, which a shared payload does not allow */
+	if ((middle_frame->mallocd & AST_MALLOCD_SHARED)
+		&& !ast_audiohook_write_list_spies_only(audiohook_list)
+		&& ast_frunshare(middle_frame)) {
+		return start_frame;
+	}
+
+	/*
+	 * A single spy copies the frame into its factory.  With more than one,
+	 * the audio is copied once into a shared payload which each of their
+	 * factories then refers to.
+	 */
+	spy_frame = middle_frame;
+	if (!(middle_frame->mallocd & AST_MALLOCD_SHARED)
+		&& (audiohook = AST_LIST_FIRST(&audiohook_list->spy_list))
+		&& AST_LIST_NEXT(audiohook, list)) {
+		if (!(spy_frame = ast_frshare(middle_frame))) {
+			spy_frame = middle_frame;
+		}
+	}
+
 	/* ---Part_2: Send middle_frame to spy and manipulator lists.  middle_frame is guaranteed to be SLINEAR here.*/
 	/* Queue up signed linear frame to each spy */
 	AST_LIST_TRAVERSE_SAFE_BEGIN(&audiohook_list->spy_list, audiohook, list) {
@@ -1006,15 +1011,17 @@ static struct ast_frame *audio_audiohook_write_list(struct ast_channel *chan, st
 			continue;
 		}
 		audiohook_list_set_hook_rate(audiohook_list, audiohook, &internal_sample_rate);
-		ast_audiohook_write_frame(audiohook, direction, middle_frame);
+		ast_audiohook_write_frame(audiohook, direction, spy_frame);
 		ast_audiohook_unlock(audiohook);
 	}
 	AST_LIST_TRAVERSE_SAFE_END;
+	if (spy_frame != middle_frame) {
+		ast_frfree(spy_frame);
+	}
 
 	/* If this frame is being written out to the channel then we need to use whisper sources */
 	if (!AST_LIST_EMPTY(&audiohook_list->whisper_list)) {
-		int i = 0;
-		short read_buf[samples], combine_buf[samples], *data1 = NULL, *data2 = NULL;
+		short read_buf[samples], combine_buf[samples];
 		memset(&combine_buf, 0, sizeof(combine_buf));
 		AST_LIST_TRAVERSE_SAFE_BEGIN(&audiohook_list->whisper_list, audiohook, list) {
 			struct ast_slinfactory *factory = (direction == AST_AUDIOHOOK_DIRECTION_READ ? &audiohook->read_factory : &audiohook->write_factory);
@@ -1032,17 +1039,13 @@ static struct ast_frame *audio_audiohook_write_list(struct ast_channel *chan, st
 			audiohook_list_set_hook_rate(audiohook_list, audiohook, &internal_sample_rate);
 			if (ast_slinfactory_available(factory) >= samples && ast_slinfactory_read(factory, read_buf, samples)) {
 				/* Take audio from this whisper source and combine it into our main buffer */
-				for (i = 0, data1 = combine_buf, data2 = read_buf; i < samples; i++, data1++, data2++) {
-					ast_slinear_saturated_add(data1, data2);
-				}
+				ast_slinear_mix_add(combine_buf, read_buf, samples);
 			}
 			ast_audiohook_unlock(audiohook);
 		}
 		AST_LIST_TRAVERSE_SAFE_END;
 		/* We take all of the combined whisper sources and combine them into the audio being written out */
-		for (i = 0, data1 = middle_frame->data.ptr, data2 = combine_buf; i < samples; i++, data1++, data2++) {
-			ast_slinear_saturated_add(data1, data2);
-		}
+		ast_slinear_mix_add(middle_frame->data.ptr, combine_buf, samples);
 		middle_frame_manipulated = 1;
 	}
 
@@ -1117,6 +1120,13 @@ int ast_audiohook_write_list_empty(struct ast_audiohook_list *audiohook_list)
 			&& AST_LIST_EMPTY(&audiohook_list->manipulate_list));
 }
 
+int ast_audiohook_write_list_spies_only(struct ast_audiohook_list *audiohook_list)
+{
+	return !audiohook_list
+		|| (AST_LIST_EMPTY(&audiohook_list->whisper_list)
+			&& AST_LIST_EMPTY(&audiohook_list->manipulate_list));
+}
+
 /*! \brief Pass a frame off to be handled by the audiohook core
  * \param chan Channel that the list is coming off of
  * \param audiohook_list List of audiohooks
@@ -49,8 +49,15 @@
 #include "asterisk/lock.h"
 #include "asterisk/utils.h"
 
+/*! \brief Most channels one autoservice thread services */
 #define MAX_AUTOMONS 1500
 
+/*! \brief Number of threads the channels in autoservice are spread over */
+#define AUTOSERVICE_THREADS 8
+
+/*! \brief Number of hash buckets for the entries of each thread */
+#define AUTOSERVICE_BUCKETS 61
+
 struct asent {
 	struct ast_channel *chan;
 	/*! This gets incremented each time autoservice gets started on the same
@@ -67,53 +74,148 @@ struct asent {
 	AST_LIST_ENTRY(asent) list;
 };
 
-static AST_LIST_HEAD_STATIC(aslist, asent);
-static ast_cond_t as_cond;
+/*!
+ * \brief A thread servicing a share of the channels in autoservice
+ *
+ * A channel always goes to the thread, and the bucket of that thread, its
+ * address hashes to, so finding its entry never means walking the entries
+ * of every channel.  The thread copies its entries into an array only
+ * when they change, instead of on every pass.
+ */
+struct autoservice_thread {
+	/*! Protects the entries and the state below */
+	ast_mutex_t lock;
+	/*! Signalled when a channel is added to an idle thread */
+	ast_cond_t cond;
+	/*! Broadcast each time the thread copies its entries */
+	ast_cond_t rebuilt;
+	pthread_t thread;
+	AST_LIST_HEAD_NOLOCK(, asent) buckets[AUTOSERVICE_BUCKETS];
+	/*! Number of entries */
+	unsigned int count;
+	/*! Incremented each time the thread copies its entries.  After that
+	 *  the thread no longer uses entries that were removed before. */
+	unsigned int list_state;
+	/*! Set when the entries changed since the thread last copied them */
+	unsigned int dirty:1;
+};
+
+static struct autoservice_thread as_threads[AUTOSERVICE_THREADS];
 
-static pthread_t asthread = AST_PTHREADT_NULL;
 static volatile int asexit = 0;
 
-static int as_chan_list_state;
+/*! \internal \brief Find the thread and bucket of a channel */
+static struct autoservice_thread *autoservice_thread_get(struct ast_channel *chan, int *bucket)
+{
+	unsigned int hash = (unsigned int) ((uintptr_t) chan >> 4) * 2654435761U;
+
+	*bucket = (hash / AUTOSERVICE_THREADS) % AUTOSERVICE_BUCKETS;
+	return &as_threads[hash % AUTOSERVICE_THREADS];
+}
+
+/*! \internal \brief Find the entry of a channel, the thread must be locked */
+static struct asent *autoservice_find(struct autoservice_thread *t, int bucket,
+	struct ast_channel *chan)
+{
+	struct asent *as;
+
+	AST_LIST_TRAVERSE(&t->buckets[bucket], as, list) {
+		if (as->chan == chan) {
+			break;
+		}
+	}
+
+	return as;
+}
+
+/*!
+ * \internal
+ * \brief Copy the entries of a thread, the thread must be locked
+ *
+ * \return The number of entries copied
+ */
+static int autoservice_rebuild(struct autoservice_thread *t, struct asent **ents)
+{
+	struct asent *as;
+	int bucket;
+	int x = 0;
+
+	for (bucket = 0; bucket < AUTOSERVICE_BUCKETS; bucket++) {
+		AST_LIST_TRAVERSE(&t->buckets[bucket], as, list) {
+			if (x < MAX_AUTOMONS) {
+				ents[x++] = as;
+			} else {
+				ast_log(LOG_WARNING, "Exceeded maximum number of automatic monitoring events.  Fix autoservice.c\n");
+				break;
+			}
+		}
+	}
 
-static void *autoservice_run(void *ign)
+	t->dirty = 0;
+	t->list_state++;
+	ast_cond_broadcast(&t->rebuilt);
+
+	return x;
+}
+
+static void *autoservice_run(void *data)
 {
+	struct autoservice_thread *t = data;
 	ast_callid callid = 0;
 	struct ast_frame hangup_frame = {
 		.frametype = AST_FRAME_CONTROL,
 		.subclass.integer = AST_CONTROL_HANGUP,
 	};
+	struct asent **all_ents;
+	struct asent **ents;
+	struct ast_channel **mons;
+	int num_ents = 0;
+
+	all_ents = ast_malloc(sizeof(*all_ents) * MAX_AUTOMONS);
+	ents = ast_malloc(sizeof(*ents) * MAX_AUTOMONS);
+	mons = ast_malloc(sizeof(*mons) * MAX_AUTOMONS);
+	if (!all_ents || !ents || !mons) {
+		/* Keep still, so stopping autoservice never waits on a thread that is not there */
+		ast_mutex_lock(&t->lock);
+		t->thread = AST_PTHREADT_NULL;
+		ast_cond_broadcast(&t->rebuilt);
+		ast_mutex_unlock(&t->lock);
+		ast_free(all_ents);
+		ast_free(ents);
+		ast_free(mons);
+		return NULL;
+	}
 
 	while (!asexit) {
-		struct ast_channel *mons[MAX_AUTOMONS];
-		struct asent *ents[MAX_AUTOMONS];
 		struct ast_channel *chan;
-		struct asent *as;
 		int i, x = 0, ms = 50;
 		struct ast_frame *f = NULL;
 		struct ast_frame *defer_frame = NULL;
 
-		AST_LIST_LOCK(&aslist);
-
-		/* At this point, we know that no channels that have been removed are going
-		 * to get used again. */
-		as_chan_list_state++;
+		ast_mutex_lock(&t->lock);
 
-		if (AST_LIST_EMPTY(&aslist)) {
-			ast_cond_wait(&as_cond, &aslist.lock);
+		/* Once the entries are copied, we know that no channels that have been
+		 * removed are going to get used again. */
+		if (t->dirty) {
+			num_ents = autoservice_rebuild(t, all_ents);
 		}
 
-		AST_LIST_TRAVERSE(&aslist, as, list) {
-			if (!ast_check_hangup(as->chan)) {
-				if (x < MAX_AUTOMONS) {
-					ents[x] = as;
-					mons[x++] = as->chan;
-				} else {
-					ast_log(LOG_WARNING, "Exceeded maximum number of automatic monitoring events.  Fix autoservice.c\n");
-				}
+		if (!num_ents) {
+			if (!asexit) {
+				ast_cond_wait(&t->cond, &t->lock);
 			}
+			ast_mutex_unlock(&t->lock);
+			continue;
 		}
 
-		AST_LIST_UNLOCK(&aslist);
+		ast_mutex_unlock(&t->lock);
+
+		for (i = 0; i < num_ents; i++) {
+			if (!ast_check_hangup(all_ents[i]->chan)) {
+				ents[x] = all_ents[i];
+				mons[x++] = all_ents[i]->chan;
+			}
+		}
 
 		if (!x) {
 			/* If we don't sleep, this becomes a busy loop, which causes
@@ -192,7 +294,15 @@ static void *autoservice_run(void *ign)
 	}
 
 	ast_callid_threadassoc_change(0);
-	asthread = AST_PTHREADT_NULL;
+
+	ast_mutex_lock(&t->lock);
+	t->thread = AST_PTHREADT_NULL;
+	ast_cond_broadcast(&t->rebuilt);
+	ast_mutex_unlock(&t->lock);
+
+	ast_free(all_ents);
+	ast_free(ents);
+	ast_free(mons);
 
 	return NULL;
 }
@@ -201,6 +311,8 @@ int ast_autoservice_start(struct ast_channel *chan)
 {
 	int res = 0;
 	struct asent *as;
+	struct autoservice_thread *t;
+	int bucket;
 
 	if (ast_thread_is_user_interface()) {
 		/* User interface threads do not handle channel media. */
@@ -209,14 +321,14 @@ int ast_autoservice_start(struct ast_channel *chan)
 		return 0;
 	}
 
-	AST_LIST_LOCK(&aslist);
-	AST_LIST_TRAVERSE(&aslist, as, list) {
-		if (as->chan == chan) {
-			as->use_count++;
-			break;
-		}
+	t = autoservice_thread_get(chan, &bucket);
+
+	ast_mutex_lock(&t->lock);
+	as = autoservice_find(t, bucket, chan);
+	if (as) {
+		as->use_count++;
 	}
-	AST_LIST_UNLOCK(&aslist);
+	ast_mutex_unlock(&t->lock);
 
 	if (as) {
 		/* Entry exists, autoservice is already handling this channel */
@@ -236,29 +348,30 @@ int ast_autoservice_start(struct ast_channel *chan)
 		ast_set_flag(ast_channel_flags(chan), AST_FLAG_END_DTMF_ONLY);
 	ast_channel_unlock(chan);
 
-	AST_LIST_LOCK(&aslist);
+	ast_mutex_lock(&t->lock);
 
-	if (AST_LIST_EMPTY(&aslist) && asthread != AST_PTHREADT_NULL) {
-		ast_cond_signal(&as_cond);
+	if (!t->count && t->thread != AST_PTHREADT_NULL) {
+		ast_cond_signal(&t->cond);
 	}
 
-	AST_LIST_INSERT_HEAD(&aslist, as, list);
+	AST_LIST_INSERT_HEAD(&t->buckets[bucket], as, list);
+	t->count++;
+	t->dirty = 1;
 
-	if (asthread == AST_PTHREADT_NULL) { /* need start the thread */
-		if (ast_pthread_create_background(&asthread, NULL, autoservice_run, NULL)) {
+	if (t->thread == AST_PTHREADT_NULL) { /* need start the thread */
+		if (ast_pthread_create_background(&t->thread, NULL, autoservice_run, t)) {
 			ast_log(LOG_WARNING, "Unable to create autoservice thread :(\n");
-			/* There will only be a single member in the list at this point,
-			   the one we just added. */
-			AST_LIST_REMOVE(&aslist, as, list);
+			AST_LIST_REMOVE(&t->buckets[bucket], as, list);
+			t->count--;
 			ast_free(as);
-			asthread = AST_PTHREADT_NULL;
+			t->thread = AST_PTHREADT_NULL;
 			res = -1;
 		} else {
-			pthread_kill(asthread, SIGURG);
+			pthread_kill(t->thread, SIGURG);
 		}
 	}
 
-	AST_LIST_UNLOCK(&aslist);
+	ast_mutex_unlock(&t->lock);
 
 	return res;
 }
@@ -266,9 +379,11 @@ int ast_autoservice_start(struct ast_channel *chan)
 int ast_autoservice_stop(struct ast_channel *chan)
 {
 	int res = -1;
-	struct asent *as, *removed = NULL;
+	struct asent *as;
+	struct autoservice_thread *t;
 	struct ast_frame *f;
 	int chan_list_state;
+	int bucket;
 
 	if (ast_thread_is_user_interface()) {
 		/* User interface threads do not handle channel media. */
@@ -277,43 +392,39 @@ int ast_autoservice_stop(struct ast_channel *chan)
 		return 0;
 	}
 
-	AST_LIST_LOCK(&aslist);
+	t = autoservice_thread_get(chan, &bucket);
 
-	/* Save the autoservice channel list state.  We _must_ verify that the channel
-	 * list has been rebuilt before we return.  Because, after we return, the channel
-	 * could get destroyed and we don't want our poor autoservice thread to step on
-	 * it after its gone! */
-	chan_list_state = as_chan_list_state;
+	ast_mutex_lock(&t->lock);
 
 	/* Find the entry, but do not free it because it still can be in the
 	   autoservice thread array */
-	AST_LIST_TRAVERSE_SAFE_BEGIN(&aslist, as, list) {
-		if (as->chan == chan) {
-			as->use_count--;
-			if (as->use_count < 1) {
-				AST_LIST_REMOVE_CURRENT(list);
-				removed = as;
-			}
-			break;
-		}
+	as = autoservice_find(t, bucket, chan);
+	if (!as || --as->use_count > 0) {
+		ast_mutex_unlock(&t->lock);
+		return 0;
 	}
-	AST_LIST_TRAVERSE_SAFE_END;
 
-	if (removed && asthread != AST_PTHREADT_NULL) {
-		pthread_kill(asthread, SIGURG);
-	}
+	AST_LIST_REMOVE(&t->buckets[bucket], as, list);
+	t->count--;
+	t->dirty = 1;
 
-	AST_LIST_UNLOCK(&aslist);
+	/* Save the autoservice channel list state.  We _must_ verify that the channel
+	 * list has been rebuilt before we return.  Because, after we return, the channel
+	 * could get destroyed and we don't want our poor autoservice thread to step on
+	 * it after its gone! */
+	chan_list_state = t->list_state;
 
-	if (!removed) {
-		return 0;
+	if (t->thread != AST_PTHREADT_NULL) {
+		pthread_kill(t->thread, SIGURG);
 	}
 
 	/* Wait while autoservice thread rebuilds its list. */
-	while (chan_list_state == as_chan_list_state) {
-		usleep(1000);
+	while (chan_list_state == t->list_state && t->thread != AST_PTHREADT_NULL) {
+		ast_cond_wait(&t->rebuilt, &t->lock);
 	}
 
+	ast_mutex_unlock(&t->lock);
+
 	/* Now autoservice thread should have no references to our entry
 	   and we can safely destroy it */
 
@@ -352,33 +463,54 @@ void ast_autoservice_chan_hangup_peer(struct ast_channel *chan, struct ast_chann
 int ast_autoservice_ignore(struct ast_channel *chan, enum ast_frame_type ftype)
 {
 	struct asent *as;
+	struct autoservice_thread *t;
+	int bucket;
 	int res = -1;
 
-	AST_LIST_LOCK(&aslist);
-	AST_LIST_TRAVERSE(&aslist, as, list) {
-		if (as->chan == chan) {
-			res = 0;
-			as->ignore_frame_types |= (1 << ftype);
-			break;
-		}
+	t = autoservice_thread_get(chan, &bucket);
+
+	ast_mutex_lock(&t->lock);
+	as = autoservice_find(t, bucket, chan);
+	if (as) {
+		res = 0;
+		as->ignore_frame_types |= (1 << ftype);
 	}
-	AST_LIST_UNLOCK(&aslist);
+	ast_mutex_unlock(&t->lock);
 	return res;
 }
 
 static void autoservice_shutdown(void)
 {
-	pthread_t th = asthread;
+	int i;
+
 	asexit = 1;
-	if (th != AST_PTHREADT_NULL) {
-		ast_cond_signal(&as_cond);
-		pthread_kill(th, SIGURG);
-		pthread_join(th, NULL);
+	for (i = 0; i < AUTOSERVICE_THREADS; i++) {
+		struct autoservice_thread *t = &as_threads[i];
+		pthread_t th;
+
+		ast_mutex_lock(&t->lock);
+		th = t->thread;
+		if (th != AST_PTHREADT_NULL) {
+			ast_cond_signal(&t->cond);
+			pthread_kill(th, SIGURG);
+		}
+		ast_mutex_unlock(&t->lock);
+
+		if (th != AST_PTHREADT_NULL) {
+			pthread_join(th, NULL);
+		}
 	}
 }
 
 void ast_autoservice_init(void)
 {
+	int i;
+
+	for (i = 0; i < AUTOSERVICE_THREADS; i++) {
+		ast_mutex_init(&as_threads[i].lock);
+		ast_cond_init(&as_threads[i].cond, NULL);
+		ast_cond_init(&as_threads[i].rebuilt, NULL);
+		as_threads[i].thread = AST_PTHREADT_NULL;
+	}
 	ast_register_cleanup(autoservice_shutdown);
-	ast_cond_init(&as_cond, NULL);
 }
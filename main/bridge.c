@@ -124,6 +124,9 @@ static struct ao2_container *bridges;
 
 static AST_RWLIST_HEAD_STATIC(bridge_technologies, ast_bridge_technology);
 
+/*! Bumped whenever the usable bridge technologies change */
+static int bridge_technologies_generation;
+
 static unsigned int optimization_id;
 
 /* Initial starting point for the bridge array of channels */
@@ -255,6 +258,7 @@ int __ast_bridge_technology_register(struct ast_bridge_technology *technology, s
 		AST_RWLIST_INSERT_TAIL(&bridge_technologies, technology, entry);
 	}
 
+	ast_atomic_fetchadd_int(&bridge_technologies_generation, +1);
 	AST_RWLIST_UNLOCK(&bridge_technologies);
 
 	ast_verb(2, "Registered bridge technology %s\n", technology->name);
@@ -272,6 +276,7 @@ int ast_bridge_technology_unregister(struct ast_bridge_technology *technology)
 	AST_RWLIST_TRAVERSE_SAFE_BEGIN(&bridge_technologies, current, entry) {
 		if (current == technology) {
 			AST_RWLIST_REMOVE_CURRENT(entry);
+			ast_atomic_fetchadd_int(&bridge_technologies_generation, +1);
 			ast_verb(2, "Unregistered bridge technology %s\n", technology->name);
 			break;
 		}
@@ -995,8 +1000,55 @@ int ast_bridge_destroy(struct ast_bridge *bridge, int cause)
  * \retval 0 on success.
  * \retval -1 on error.
  */
+/*!
+ * \internal
+ * \brief Gather what the technology of a smart bridge is chosen with.
+ *
+ * \note On entry, bridge is already locked.
+ */
+static void bridge_technology_choice_init(struct ast_bridge *bridge, uint32_t capabilities,
+	struct ast_bridge_technology_choice *choice)
+{
+	struct ast_bridge_channel *bridge_channel;
+
+	choice->capabilities = capabilities;
+	choice->version = bridge->technology_version;
+	choice->technologies_generation = ast_atomic_fetchadd_int(&bridge_technologies_generation, 0);
+	choice->media_generation = 0;
+	AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
+		ast_channel_lock(bridge_channel->chan);
+		choice->media_generation += ast_channel_unbridged_generation(bridge_channel->chan);
+		ast_channel_unlock(bridge_channel->chan);
+	}
+	choice->valid = 1;
+}
+
+/*!
+ * \internal
+ * \brief Determine if the bridge technology was already chosen with the same inputs.
+ *
+ * \details
+ * Nothing that could change the choice has happened if the same channels
+ * are in the bridge, none of them raised the unbridged flag and the
+ * registered bridge technologies are the same.  Re-evaluating in that case
+ * would run the compatible callbacks, RTP glue queries and all, only to
+ * come to the same answer.
+ */
+static int bridge_technology_choice_unchanged(const struct ast_bridge *bridge,
+	const struct ast_bridge_technology_choice *choice)
+{
+	const struct ast_bridge_technology_choice *last = &bridge->technology_choice;
+
+	return last->valid
+		&& last->capabilities == choice->capabilities
+		&& last->version == choice->version
+		&& last->media_generation == choice->media_generation
+		&& last->technologies_generation == choice->technologies_generation;
+}
+
 static int smart_bridge_operation(struct ast_bridge *bridge)
 {
+	struct ast_bridge_technology_choice choice;
 	uint32_t new_capabilities;
 	struct ast_bridge_technology *new_technology;
 	struct ast_bridge_technology *old_technology = bridge->technology;
@@ -1030,6 +1082,14 @@ static int smart_bridge_operation(struct ast_bridge *bridge)
 		}
 	}
 
+	bridge_technology_choice_init(bridge, new_capabilities, &choice);
+	if (bridge_technology_choice_unchanged(bridge, &choice)) {
+		ast_debug(1, "Bridge %s is unchanged since choosing the %s technology.\n",
+			bridge->uniqueid, old_technology->name);
+		return 0;
+	}
+	bridge->technology_choice.valid = 0;
+
 	/* Find a bridge technology to satisfy the new capabilities. */
 	new_technology = find_best_technology(new_capabilities, bridge);
 	if (!new_technology) {
@@ -1047,6 +1107,7 @@ static int smart_bridge_operation(struct ast_bridge *bridge)
 		if (is_compatible) {
 			ast_debug(1, "Bridge %s could not get a new technology, staying with old technology.\n",
 				bridge->uniqueid);
+			bridge->technology_choice = choice;
 			return 0;
 		}
 		ast_log(LOG_WARNING, "Bridge %s has no technology available to support it.\n",
@@ -1057,6 +1118,7 @@ static int smart_bridge_operation(struct ast_bridge *bridge)
 		ast_debug(1, "Bridge %s is already using the new technology.\n",
 			bridge->uniqueid);
 		ast_module_unref(old_technology->mod);
+		bridge->technology_choice = choice;
 		return 0;
 	}
 
@@ -1113,6 +1175,7 @@ static int smart_bridge_operation(struct ast_bridge *bridge)
 		ast_module_unref(new_technology->mod);
 		return -1;
 	}
+	bridge->technology_swaps++;
 
 	/* To ensure that things are sane for the old technology move the channels it
 	 * expects to the dummy bridge
@@ -1188,6 +1251,7 @@ static int smart_bridge_operation(struct ast_bridge *bridge)
 		ast_module_unref(old_technology->mod);
 	}
 
+	bridge->technology_choice = choice;
 	return 0;
 }
 
@@ -3108,6 +3172,7 @@ int ast_bridge_unsuspend(struct ast_bridge *bridge, struct ast_channel *chan)
 void ast_bridge_technology_suspend(struct ast_bridge_technology *technology)
 {
 	technology->suspended = 1;
+	ast_atomic_fetchadd_int(&bridge_technologies_generation, +1);
 }
 
 void ast_bridge_technology_unsuspend(struct ast_bridge_technology *technology)
@@ -3118,6 +3183,7 @@ void ast_bridge_technology_unsuspend(struct ast_bridge_technology *technology)
 	 * using it.
 	 */
 	technology->suspended = 0;
+	ast_atomic_fetchadd_int(&bridge_technologies_generation, +1);
 }
 
 int ast_bridge_features_register(enum ast_bridge_builtin_feature feature, ast_bridge_hook_callback callback, const char *dtmf)
@@ -3242,6 +3308,176 @@ static struct ast_bridge_hook *bridge_hook_generic(size_t size,
 	return hook;
 }
 
+/*! \brief Number of distinct DTMF digits: 0-9, *, # and A-D */
+#define DTMF_TRIE_DIGITS 16
+
+/*! \brief A node of the compiled DTMF feature hook codes */
+struct bridge_dtmf_trie_node {
+	/*!
+	 * \brief The first hook, in container order, whose code starts with
+	 * the digits leading to this node.  (A reference)
+	 */
+	struct ast_bridge_hook_dtmf *hook;
+	/*! \brief Node following each digit, 0 if no code continues with it */
+	unsigned short next[DTMF_TRIE_DIGITS];
+};
+
+/*!
+ * \brief DTMF feature hook codes compiled into a trie
+ *
+ * \details
+ * Immutable once built.  It is rebuilt on the next lookup after the DTMF
+ * hooks change, so matching a digit is a single step through the trie
+ * instead of a scan of the hooks.
+ */
+struct ast_bridge_dtmf_trie {
+	/*! \brief Number of nodes, the first is the root */
+	unsigned int count;
+	/*! \brief TRUE if a code has digits the trie cannot hold, so the container is searched */
+	unsigned int fallback:1;
+	/*! \brief The nodes */
+	struct bridge_dtmf_trie_node nodes[0];
+};
+
+/*! \brief Index of a DTMF digit in the trie, -1 if it is not a DTMF digit */
+static int dtmf_trie_digit(char digit)
+{
+	switch (digit) {
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+		return digit - '0';
+	case '*':
+		return 10;
+	case '#':
+		return 11;
+	case 'A': case 'B': case 'C': case 'D':
+		return 12 + digit - 'A';
+	case 'a': case 'b': case 'c': case 'd':
+		return 12 + digit - 'a';
+	default:
+		return -1;
+	}
+}
+
+static void dtmf_trie_destroy(void *obj)
+{
+	struct ast_bridge_dtmf_trie *trie = obj;
+	unsigned int idx;
+
+	for (idx = 0; idx < trie->count; ++idx) {
+		ao2_cleanup(trie->nodes[idx].hook);
+	}
+}
+
+static int dtmf_trie_code_len(void *obj, void *arg, int flags)
+{
+	struct ast_bridge_hook_dtmf *hook = obj;
+	size_t *len = arg;
+
+	*len += strlen(hook->dtmf.code);
+	return 0;
+}
+
+static int dtmf_trie_insert(void *obj, void *arg, int flags)
+{
+	struct ast_bridge_hook_dtmf *hook = obj;
+	struct ast_bridge_dtmf_trie *trie = arg;
+	struct bridge_dtmf_trie_node *node = &trie->nodes[0];
+	const char *code;
+
+	for (code = hook->dtmf.code; *code; ++code) {
+		int digit = dtmf_trie_digit(*code);
+
+		if (digit < 0) {
+			trie->fallback = 1;
+			return CMP_STOP;
+		}
+		if (!node->next[digit]) {
+			node->next[digit] = trie->count++;
+		}
+		node = &trie->nodes[node->next[digit]];
+
+		/* Hooks are visited in code order so the first one to get here is the first match */
+		if (!node->hook) {
+			node->hook = ao2_bump(hook);
+		}
+	}
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Compile the DTMF hook codes into a trie.
+ *
+ * \note On entry, the dtmf_hooks container is already locked.
+ */
+static struct ast_bridge_dtmf_trie *dtmf_trie_build(struct ao2_container *dtmf_hooks)
+{
+	struct ast_bridge_dtmf_trie *trie;
+	size_t nodes = 1;
+
+	ao2_callback(dtmf_hooks, OBJ_NOLOCK | OBJ_NODATA, dtmf_trie_code_len, &nodes);
+	if (USHRT_MAX < nodes) {
+		return NULL;
+	}
+
+	trie = ao2_alloc_options(sizeof(*trie) + nodes * sizeof(trie->nodes[0]),
+		dtmf_trie_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!trie) {
+		return NULL;
+	}
+	memset(trie->nodes, 0, nodes * sizeof(trie->nodes[0]));
+	trie->count = 1;
+
+	ao2_callback(dtmf_hooks, OBJ_NOLOCK | OBJ_NODATA, dtmf_trie_insert, trie);
+
+	return trie;
+}
+
+struct ast_bridge_hook_dtmf *bridge_dtmf_hook_find(struct ast_bridge_features *features, const char *dtmf)
+{
+	struct ast_bridge_dtmf_trie *trie;
+	struct ast_bridge_hook_dtmf *hook = NULL;
+	unsigned int node = 0;
+
+	ao2_lock(features->dtmf_hooks);
+	if (!features->dtmf_trie) {
+		features->dtmf_trie = dtmf_trie_build(features->dtmf_hooks);
+	}
+	trie = ao2_bump(features->dtmf_trie);
+	ao2_unlock(features->dtmf_hooks);
+
+	if (!trie || trie->fallback) {
+		ao2_cleanup(trie);
+		return ao2_find(features->dtmf_hooks, dtmf, OBJ_SEARCH_PARTIAL_KEY);
+	}
+
+	for (; *dtmf; ++dtmf) {
+		int digit = dtmf_trie_digit(*dtmf);
+
+		if (digit < 0 || !trie->nodes[node].next[digit]) {
+			node = 0;
+			break;
+		}
+		node = trie->nodes[node].next[digit];
+	}
+	if (node) {
+		hook = ao2_bump(trie->nodes[node].hook);
+	}
+	ao2_ref(trie, -1);
+
+	return hook;
+}
+
+void bridge_dtmf_hooks_changed(struct ast_bridge_features *features)
+{
+	ao2_lock(features->dtmf_hooks);
+	ao2_cleanup(features->dtmf_trie);
+	features->dtmf_trie = NULL;
+	ao2_unlock(features->dtmf_hooks);
+}
+
 int ast_bridge_dtmf_hook(struct ast_bridge_features *features,
 	const char *dtmf,
 	ast_bridge_hook_callback callback,
@@ -3263,6 +3499,7 @@ int ast_bridge_dtmf_hook(struct ast_bridge_features *features,
 
 	/* Once done we put it in the container. */
 	res = ao2_link(features->dtmf_hooks, hook) ? 0 : -1;
+	bridge_dtmf_hooks_changed(features);
 	if (res) {
 		/*
 		 * Could not link the hook into the container.
@@ -3568,6 +3805,7 @@ static void hooks_remove_heap(struct ast_heap *hooks, enum ast_bridge_hook_remov
 void ast_bridge_features_remove(struct ast_bridge_features *features, enum ast_bridge_hook_remove_flags remove_flags)
 {
 	hooks_remove_container(features->dtmf_hooks, remove_flags);
+	bridge_dtmf_hooks_changed(features);
 	hooks_remove_container(features->other_hooks, remove_flags);
 	hooks_remove_heap(features->interval_hooks, remove_flags);
 }
@@ -3666,6 +3904,7 @@ void ast_bridge_features_merge(struct ast_bridge_features *into, const struct as
 
 	/* Merge hook containers */
 	ao2_callback(from->dtmf_hooks, 0, merge_container_cb, into->dtmf_hooks);
+	bridge_dtmf_hooks_changed(into);
 	ao2_callback(from->other_hooks, 0, merge_container_cb, into->other_hooks);
 
 	/* Merge hook heaps */
@@ -3734,6 +3973,8 @@ void ast_bridge_features_cleanup(struct ast_bridge_features *features)
 	features->other_hooks = NULL;
 
 	/* Destroy the DTMF hooks container. */
+	ao2_cleanup(features->dtmf_trie);
+	features->dtmf_trie = NULL;
 	ao2_cleanup(features->dtmf_hooks);
 	features->dtmf_hooks = NULL;
 }
@@ -3769,6 +4010,13 @@ void ast_bridge_set_mixing_interval(struct ast_bridge *bridge, unsigned int mixi
 	ast_bridge_unlock(bridge);
 }
 
+void ast_bridge_set_mixing_threads(struct ast_bridge *bridge, unsigned int mixing_threads)
+{
+	ast_bridge_lock(bridge);
+	bridge->softmix.mixing_threads = mixing_threads;
+	ast_bridge_unlock(bridge);
+}
+
 void ast_bridge_set_binaural_active(struct ast_bridge *bridge, unsigned int binaural_active)
 {
 	ast_bridge_lock(bridge);
@@ -3776,6 +4024,68 @@ void ast_bridge_set_binaural_active(struct ast_bridge *bridge, unsigned int bina
 	ast_bridge_unlock(bridge);
 }
 
+static void bridge_prompt_destroy(void *obj)
+{
+	struct ast_bridge_prompt *prompt = obj;
+
+	ast_free(prompt->data);
+}
+
+struct ast_bridge_prompt *ast_bridge_prompt_alloc(const char *filename, const char *language)
+{
+	struct ast_bridge_prompt *prompt;
+
+	prompt = ao2_alloc_options(sizeof(*prompt), bridge_prompt_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!prompt) {
+		return NULL;
+	}
+
+	prompt->data = ast_file_decode_slin(filename, language, &prompt->rate, &prompt->samples);
+	if (!prompt->data) {
+		ao2_ref(prompt, -1);
+		return NULL;
+	}
+
+	return prompt;
+}
+
+void ast_bridge_prompt_playback_done(struct ast_bridge_prompt_playback *playback)
+{
+	ast_mutex_lock(&playback->lock);
+	playback->done = 1;
+	ast_cond_signal(&playback->cond);
+	ast_mutex_unlock(&playback->lock);
+}
+
+int ast_bridge_play_prompt(struct ast_bridge *bridge, struct ast_bridge_prompt *prompt)
+{
+	struct ast_bridge_prompt_playback playback = { .prompt = prompt, };
+	int res = -1;
+
+	ast_mutex_init(&playback.lock);
+	ast_cond_init(&playback.cond, NULL);
+
+	ast_bridge_lock(bridge);
+	if (!bridge->dissolved && bridge->technology->play_prompt) {
+		res = bridge->technology->play_prompt(bridge, &playback);
+	}
+	ast_bridge_unlock(bridge);
+
+	if (!res) {
+		ast_mutex_lock(&playback.lock);
+		while (!playback.done) {
+			ast_cond_wait(&playback.cond, &playback.lock);
+		}
+		ast_mutex_unlock(&playback.lock);
+	}
+
+	ast_mutex_destroy(&playback.lock);
+	ast_cond_destroy(&playback.cond);
+
+	return res;
+}
+
 void ast_bridge_set_internal_sample_rate(struct ast_bridge *bridge, unsigned int sample_rate)
 {
 	ast_bridge_lock(bridge);
@@ -5154,6 +5464,32 @@ static int bridge_show_specific_print_channel(void *obj, void *arg, int flags)
 	return 0;
 }
 
+/*! \brief Show how long voice frames spent inside Asterisk before reaching each channel */
+static void bridge_show_specific_print_transit(struct ast_cli_args *a, const char *uniqueid)
+{
+	struct ast_bridge *bridge;
+	struct ast_bridge_channel *bridge_channel;
+
+	bridge = ast_bridge_find_by_id(uniqueid);
+	if (!bridge) {
+		return;
+	}
+
+	ast_bridge_lock(bridge);
+	AST_LIST_TRAVERSE(&bridge->channels, bridge_channel, entry) {
+		unsigned int frames = bridge_channel->transit.frames;
+
+		if (!frames) {
+			continue;
+		}
+		ast_cli(a->fd, "Media-Transit: %s frames=%u avg=%" PRIu64 "us max=%uus\n",
+			ast_channel_name(bridge_channel->chan), frames,
+			bridge_channel->transit.total / frames, bridge_channel->transit.max);
+	}
+	ast_bridge_unlock(bridge);
+	ao2_ref(bridge, -1);
+}
+
 static char *handle_bridge_show_specific(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
 	struct ast_bridge_snapshot *snapshot;
@@ -5195,8 +5531,10 @@ static char *handle_bridge_show_specific(struct ast_cli_entry *e, int cmd, struc
 	ast_cli(a->fd, "Video-Source-Id: %s\n", snapshot->video_source_id);
 	ast_cli(a->fd, "Num-Channels: %u\n", snapshot->num_channels);
 	ast_cli(a->fd, "Num-Active: %u\n", snapshot->num_active);
+	ast_cli(a->fd, "Technology-Swaps: %u\n", snapshot->technology_swaps);
 	ast_cli(a->fd, "Duration: %s\n", print_time);
 	ao2_callback(snapshot->channels, OBJ_NODATA, bridge_show_specific_print_channel, a);
+	bridge_show_specific_print_transit(a, snapshot->uniqueid);
 	ao2_ref(snapshot, -1);
 
 	return CLI_SUCCESS;
@@ -5622,6 +5960,10 @@ int ast_bridging_init(void)
 	}
 	ao2_container_register("bridges", bridges, bridge_prnt_obj);
 
+	if (bridge_channel_internal_init()) {
+		return -1;
+	}
+
 	ast_bridging_init_basic();
 
 	ast_cli_register_multiple(bridge_cli, ARRAY_LEN(bridge_cli));
@@ -449,19 +449,6 @@ static void dynamic_dtmf_hook_callback(struct ast_bridge_channel *bridge_channel
 		run_data->moh_offset ? &run_data->app_name[run_data->moh_offset] : NULL);
 }
 
-struct dynamic_dtmf_hook_data {
-	/*! Which side of bridge to run app (AST_FEATURE_FLAG_ONSELF/AST_FEATURE_FLAG_ONPEER) */
-	unsigned int flags;
-	/*! Offset into app_name[] where the dynamic feature name starts. */
-	int feature_offset;
-	/*! Offset into app_name[] where the MOH class name starts.  (zero if no MOH) */
-	int moh_offset;
-	/*! Offset into app_name[] where the application argument string starts. (zero if no arguments) */
-	int app_args_offset;
-	/*! Application name to run. */
-	char app_name[0];
-};
-
 /*!
  * \internal
  * \brief Activated dynamic DTMF feature hook.
@@ -475,7 +462,7 @@ struct dynamic_dtmf_hook_data {
  */
 static int dynamic_dtmf_hook_trip(struct ast_bridge_channel *bridge_channel, void *hook_pvt)
 {
-	struct dynamic_dtmf_hook_data *pvt = hook_pvt;
+	struct ast_applicationmap_item *item = hook_pvt;
 	struct dynamic_dtmf_hook_run *run_data;
 	const char *activated_name;
 	size_t len_name;
@@ -486,10 +473,10 @@ static int dynamic_dtmf_hook_trip(struct ast_bridge_channel *bridge_channel, voi
 	size_t len_data;
 
 	/* Determine lengths of things. */
-	len_name = strlen(pvt->app_name) + 1;
-	len_args = pvt->app_args_offset ? strlen(&pvt->app_name[pvt->app_args_offset]) + 1 : 0;
-	len_moh = pvt->moh_offset ? strlen(&pvt->app_name[pvt->moh_offset]) + 1 : 0;
-	len_feature = strlen(&pvt->app_name[pvt->feature_offset]) + 1;
+	len_name = strlen(item->app) + 1;
+	len_args = ast_strlen_zero(item->app_data) ? 0 : strlen(item->app_data) + 1;
+	len_moh = ast_strlen_zero(item->moh_class) ? 0 : strlen(item->moh_class) + 1;
+	len_feature = strlen(item->name) + 1;
 	ast_channel_lock(bridge_channel->chan);
 	activated_name = ast_strdupa(ast_channel_name(bridge_channel->chan));
 	ast_channel_unlock(bridge_channel->chan);
@@ -502,20 +489,17 @@ static int dynamic_dtmf_hook_trip(struct ast_bridge_channel *bridge_channel, voi
 	run_data->moh_offset = len_moh ? len_name + len_args : 0;
 	run_data->feature_offset = len_name + len_args + len_moh;
 	run_data->activated_offset = len_name + len_args + len_moh + len_feature;
-	strcpy(run_data->app_name, pvt->app_name);/* Safe */
+	strcpy(run_data->app_name, item->app);/* Safe */
 	if (len_args) {
-		strcpy(&run_data->app_name[run_data->app_args_offset],
-			&pvt->app_name[pvt->app_args_offset]);/* Safe */
+		strcpy(&run_data->app_name[run_data->app_args_offset], item->app_data);/* Safe */
 	}
 	if (len_moh) {
-		strcpy(&run_data->app_name[run_data->moh_offset],
-			&pvt->app_name[pvt->moh_offset]);/* Safe */
+		strcpy(&run_data->app_name[run_data->moh_offset], item->moh_class);/* Safe */
 	}
-	strcpy(&run_data->app_name[run_data->feature_offset],
-		&pvt->app_name[pvt->feature_offset]);/* Safe */
+	strcpy(&run_data->app_name[run_data->feature_offset], item->name);/* Safe */
 	strcpy(&run_data->app_name[run_data->activated_offset], activated_name);/* Safe */
 
-	if (ast_test_flag(pvt, AST_FEATURE_FLAG_ONPEER)) {
+	if (!item->activate_on_self) {
 		ast_bridge_channel_write_callback(bridge_channel,
 			AST_BRIDGE_CHANNEL_CB_OPTION_MEDIA,
 			dynamic_dtmf_hook_callback, run_data, len_data);
@@ -525,57 +509,10 @@ static int dynamic_dtmf_hook_trip(struct ast_bridge_channel *bridge_channel, voi
 	return 0;
 }
 
-/*!
- * \internal
- * \brief Add a dynamic DTMF feature hook to the bridge features.
- * \since 12.0.0
- *
- * \param features Bridge features to setup.
- * \param flags Which side of bridge to run app (AST_FEATURE_FLAG_ONSELF/AST_FEATURE_FLAG_ONPEER).
- * \param dtmf DTMF trigger sequence.
- * \param feature_name Name of the dynamic feature.
- * \param app_name Dialplan application name to run.
- * \param app_args Dialplan application arguments. (Empty or NULL if no arguments)
- * \param moh_class MOH class to play to peer. (Empty or NULL if no MOH played)
- *
- * \retval 0 on success.
- * \retval -1 on error.
- */
-static int dynamic_dtmf_hook_add(struct ast_bridge_features *features, unsigned int flags, const char *dtmf, const char *feature_name, const char *app_name, const char *app_args, const char *moh_class)
-{
-	struct dynamic_dtmf_hook_data *hook_data;
-	size_t len_name = strlen(app_name) + 1;
-	size_t len_args = ast_strlen_zero(app_args) ? 0 : strlen(app_args) + 1;
-	size_t len_moh = ast_strlen_zero(moh_class) ? 0 : strlen(moh_class) + 1;
-	size_t len_feature = strlen(feature_name) + 1;
-	size_t len_data = sizeof(*hook_data) + len_name + len_args + len_moh + len_feature;
-	int res;
-
-	/* Fill in application run hook data. */
-	hook_data = ast_malloc(len_data);
-	if (!hook_data) {
-		return -1;
-	}
-	hook_data->flags = flags;
-	hook_data->app_args_offset = len_args ? len_name : 0;
-	hook_data->moh_offset = len_moh ? len_name + len_args : 0;
-	hook_data->feature_offset = len_name + len_args + len_moh;
-	strcpy(hook_data->app_name, app_name);/* Safe */
-	if (len_args) {
-		strcpy(&hook_data->app_name[hook_data->app_args_offset], app_args);/* Safe */
-	}
-	if (len_moh) {
-		strcpy(&hook_data->app_name[hook_data->moh_offset], moh_class);/* Safe */
-	}
-	strcpy(&hook_data->app_name[hook_data->feature_offset], feature_name);/* Safe */
-
-	res = ast_bridge_dtmf_hook(features, dtmf, dynamic_dtmf_hook_trip, hook_data,
-		ast_free_ptr,
-		AST_BRIDGE_HOOK_REMOVE_ON_PULL | AST_BRIDGE_HOOK_REMOVE_ON_PERSONALITY_CHANGE);
-	if (res) {
-		ast_free(hook_data);
-	}
-	return res;
+/*! \brief Release the applicationmap item of a dynamic DTMF feature hook */
+static void dynamic_dtmf_hook_pvt_dtor(void *hook_pvt)
+{
+	ao2_ref(hook_pvt, -1);
 }
 
 static int setup_dynamic_feature(void *obj, void *arg, void *data, int flags)
@@ -584,9 +521,16 @@ static int setup_dynamic_feature(void *obj, void *arg, void *data, int flags)
 	struct ast_bridge_features *features = arg;
 	int *res = data;
 
-	*res |= dynamic_dtmf_hook_add(features,
-		item->activate_on_self ? AST_FEATURE_FLAG_ONSELF : AST_FEATURE_FLAG_ONPEER,
-		item->dtmf, item->name, item->app, item->app_data, item->moh_class);
+	/*
+	 * The applicationmap items are immutable, so every channel using a
+	 * feature shares the item rather than getting its own copy of it.
+	 */
+	if (ast_bridge_dtmf_hook(features, item->dtmf, dynamic_dtmf_hook_trip, ao2_bump(item),
+		dynamic_dtmf_hook_pvt_dtor,
+		AST_BRIDGE_HOOK_REMOVE_ON_PULL | AST_BRIDGE_HOOK_REMOVE_ON_PERSONALITY_CHANGE)) {
+		ao2_ref(item, -1);
+		*res = -1;
+	}
 
 	return 0;
 }
@@ -3102,6 +3046,7 @@ static int attach_framehook(struct attended_transfer_properties *props, struct a
 		.event_cb = transfer_target_framehook_cb,
 		.destroy_cb = transfer_target_framehook_destroy_cb,
 		.consume_cb = transfer_target_framehook_consume,
+		.frame_types = AST_FRAMEHOOK_TYPE(AST_FRAME_CONTROL),
 		.disable_inheritance = 1,
 	};
 
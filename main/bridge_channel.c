@@ -57,6 +57,8 @@
 #include "asterisk/sem.h"
 #include "asterisk/stream.h"
 #include "asterisk/message.h"
+#include "asterisk/trace_ring.h"
+#include "asterisk/histogram.h"
 
 /*!
  * \brief Used to queue an action frame onto a bridge channel and write an action frame into a bridge.
@@ -77,6 +79,12 @@ typedef int (*ast_bridge_channel_post_action_data)(struct ast_bridge_channel *br
  */
 static int sync_ids;
 
+/*!
+ * \brief Time from queueing a frame onto a bridge channel to writing it to the channel
+ */
+static struct ast_histogram *frame_delivery;
+static struct ast_histogram *media_transit;
+
 /*!
  * \brief Frame payload for synchronous bridge actions.
  *
@@ -298,6 +306,8 @@ void ast_bridge_channel_leave_bridge_nolock(struct ast_bridge_channel *bridge_ch
 	ast_debug(1, "Setting %p(%s) state from:%u to:%u\n",
 		bridge_channel, ast_channel_name(bridge_channel->chan), bridge_channel->state,
 		new_state);
+	ast_trace_ring("%s: state %u -> %u cause %d", ast_channel_name(bridge_channel->chan),
+		bridge_channel->state, new_state, cause);
 
 	channel_set_cause(bridge_channel->chan, cause);
 
@@ -1058,6 +1068,9 @@ int ast_bridge_channel_queue_frame(struct ast_bridge_channel *bridge_channel, st
 		return 0;
 	}
 
+	ast_trace_ring("%s: queue frame %d/%d stream %d", ast_channel_name(bridge_channel->chan),
+		fr->frametype, fr->subclass.integer, fr->stream_num);
+
 	if ((fr->frametype == AST_FRAME_VOICE || fr->frametype == AST_FRAME_VIDEO ||
 		fr->frametype == AST_FRAME_TEXT || fr->frametype == AST_FRAME_IMAGE ||
 		fr->frametype == AST_FRAME_RTCP) && fr->stream_num > -1) {
@@ -1075,7 +1088,8 @@ int ast_bridge_channel_queue_frame(struct ast_bridge_channel *bridge_channel, st
 		}
 	}
 
-	dup = ast_frdup(fr);
+	/* A shared payload can be handed over as is, everything else is copied. */
+	dup = (fr->mallocd & AST_MALLOCD_SHARED) ? ast_frshare(fr) : ast_frdup(fr);
 	if (!dup) {
 		return -1;
 	}
@@ -1110,11 +1124,21 @@ int ast_bridge_channel_queue_frame(struct ast_bridge_channel *bridge_channel, st
 		}
 	}
 
-	AST_LIST_INSERT_TAIL(&bridge_channel->wr_queue, dup, frame_list);
-	if (ast_alertpipe_write(bridge_channel->alert_pipe)) {
+	if (AST_VECTOR_APPEND(&bridge_channel->wr_queued, ast_tvnow())) {
+		ast_bridge_channel_unlock(bridge_channel);
+		bridge_frame_free(dup);
+		return -1;
+	}
+	/*
+	 * The alert pipe is only signaled while the wr_queue is not empty, so
+	 * only the first frame of a batch has to signal it.
+	 */
+	if (AST_LIST_EMPTY(&bridge_channel->wr_queue)
+		&& ast_alertpipe_write(bridge_channel->alert_pipe)) {
 		ast_log(LOG_ERROR, "We couldn't write alert pipe for %p(%s)... something is VERY wrong\n",
 			bridge_channel, ast_channel_name(bridge_channel->chan));
 	}
+	AST_LIST_INSERT_TAIL(&bridge_channel->wr_queue, dup, frame_list);
 	ast_bridge_channel_unlock(bridge_channel);
 	return 0;
 }
@@ -1122,6 +1146,7 @@ int ast_bridge_channel_queue_frame(struct ast_bridge_channel *bridge_channel, st
 int ast_bridge_queue_everyone_else(struct ast_bridge *bridge, struct ast_bridge_channel *bridge_channel, struct ast_frame *frame)
 {
 	struct ast_bridge_channel *cur;
+	struct ast_frame *shared = NULL;
 	int not_written = -1;
 
 	if (frame->frametype == AST_FRAME_NULL) {
@@ -1129,14 +1154,28 @@ int ast_bridge_queue_everyone_else(struct ast_bridge *bridge, struct ast_bridge_
 		return 0;
 	}
 
+	/*
+	 * Media going to more than one channel gets its payload copied once
+	 * and shared rather than copied for every channel.
+	 */
+	if ((frame->frametype == AST_FRAME_VOICE || frame->frametype == AST_FRAME_VIDEO)
+		&& frame->datalen
+		&& bridge->num_channels > (bridge_channel ? 2 : 1)) {
+		shared = ast_frshare(frame);
+	}
+
 	AST_LIST_TRAVERSE(&bridge->channels, cur, entry) {
 		if (cur == bridge_channel) {
 			continue;
 		}
-		if (!ast_bridge_channel_queue_frame(cur, frame)) {
+		if (!ast_bridge_channel_queue_frame(cur, shared ?: frame)) {
 			not_written = 0;
 		}
 	}
+
+	if (shared) {
+		ast_frfree(shared);
+	}
 	return not_written;
 }
 
@@ -1781,8 +1820,7 @@ void ast_bridge_channel_feature_digit(struct ast_bridge_channel *bridge_channel,
 
 	while (digit) {
 		/* See if a DTMF feature hook matches or can match */
-		hook = ao2_find(features->dtmf_hooks, bridge_channel->dtmf_hook_state.collected,
-			OBJ_SEARCH_PARTIAL_KEY);
+		hook = bridge_dtmf_hook_find(features, bridge_channel->dtmf_hook_state.collected);
 		if (!hook) {
 			ast_debug(1, "No DTMF feature hooks on %p(%s) match '%s'\n",
 				bridge_channel, ast_channel_name(bridge_channel->chan),
@@ -1824,6 +1862,7 @@ void ast_bridge_channel_feature_digit(struct ast_bridge_channel *bridge_channel,
 				ast_debug(1, "DTMF hook %p is being removed from %p(%s)\n",
 					hook, bridge_channel, ast_channel_name(bridge_channel->chan));
 				ao2_unlink(features->dtmf_hooks, hook);
+				bridge_dtmf_hooks_changed(features);
 			}
 			testsuite_notify_feature_success(bridge_channel->chan, hook->dtmf.code);
 			ao2_ref(hook, -1);
@@ -2186,6 +2225,7 @@ void bridge_channel_internal_pull(struct ast_bridge_channel *bridge_channel)
 
 	ast_debug(1, "Bridge %s: pulling %p(%s)\n",
 		bridge->uniqueid, bridge_channel, ast_channel_name(bridge_channel->chan));
+	ast_trace_ring("%s: pulled from %s", ast_channel_name(bridge_channel->chan), bridge->uniqueid);
 
 	ast_verb(3, "Channel %s left '%s' %s-bridge <%s>\n",
 		ast_channel_name(bridge_channel->chan),
@@ -2229,6 +2269,7 @@ void bridge_channel_internal_pull(struct ast_bridge_channel *bridge_channel)
 	}
 
 	bridge->reconfigured = 1;
+	bridge->technology_version++;
 	ast_bridge_publish_leave(bridge, bridge_channel->chan);
 }
 
@@ -2250,6 +2291,8 @@ int bridge_channel_internal_push_full(struct ast_bridge_channel *bridge_channel,
 		ast_debug(1, "Bridge %s: pushing %p(%s)\n",
 			bridge->uniqueid, bridge_channel, ast_channel_name(bridge_channel->chan));
 	}
+	ast_trace_ring("%s: pushing into %s swap %s", ast_channel_name(bridge_channel->chan),
+		bridge->uniqueid, swap ? ast_channel_name(swap->chan) : "none");
 
 	/* Add channel to the bridge */
 	if (bridge->dissolved
@@ -2309,6 +2352,7 @@ int bridge_channel_internal_push_full(struct ast_bridge_channel *bridge_channel,
 	ast_queue_frame(bridge_channel->chan, &ast_null_frame);
 
 	bridge->reconfigured = 1;
+	bridge->technology_version++;
 	return 0;
 }
 
@@ -2378,6 +2422,7 @@ static void bridge_channel_handle_control(struct ast_bridge_channel *bridge_chan
 			ast_answer(chan);
 			ast_bridge_channel_lock_bridge(bridge_channel);
 			bridge_channel->bridge->reconfigured = 1;
+			bridge_channel->bridge->technology_version++;
 			bridge_reconfigured(bridge_channel->bridge, 0);
 			ast_bridge_unlock(bridge_channel->bridge);
 		} else {
@@ -2434,62 +2479,43 @@ static void sendtext_safe(struct ast_channel *chan, const struct ast_frame *f)
 
 /*!
  * \internal
- * \brief Handle bridge channel write frame to channel.
- * \since 12.0.0
+ * \brief Account for the time a voice frame spent inside Asterisk.
+ *
+ * \param bridge_channel Channel the frame was written to.
+ * \param ingress When the frame's media entered Asterisk.
+ */
+static void bridge_channel_transit(struct ast_bridge_channel *bridge_channel, struct timeval ingress)
+{
+	int64_t transit = ast_tvdiff_us(ast_tvnow(), ingress);
+
+	if (transit < 0) {
+		transit = 0;
+	}
+	ast_histogram_record(media_transit, transit);
+	++bridge_channel->transit.frames;
+	bridge_channel->transit.total += transit;
+	if (transit > bridge_channel->transit.max) {
+		bridge_channel->transit.max = MIN(transit, UINT_MAX);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Deliver one frame taken off the wr_queue to the channel.
  *
  * \param bridge_channel Channel to write outgoing frame.
+ * \param fr The frame, which is freed.
+ * \param queued When the frame was queued.
  *
  * \return Nothing
  */
-static void bridge_channel_handle_write(struct ast_bridge_channel *bridge_channel)
+static void bridge_channel_deliver_frame(struct ast_bridge_channel *bridge_channel,
+	struct ast_frame *fr, struct timeval queued)
 {
-	struct ast_frame *fr;
 	struct sync_payload *sync_payload;
 	int num;
 	struct ast_msg_data *msg;
 
-	ast_bridge_channel_lock(bridge_channel);
-
-	/* It's not good to have unbalanced frames and alert_pipe alerts. */
-	ast_assert(!AST_LIST_EMPTY(&bridge_channel->wr_queue));
-	if (AST_LIST_EMPTY(&bridge_channel->wr_queue)) {
-		/* No frame, flush the alert pipe of excess alerts. */
-		ast_log(LOG_WARNING, "Weird.  No frame from bridge for %s to process?\n",
-			ast_channel_name(bridge_channel->chan));
-		ast_alertpipe_read(bridge_channel->alert_pipe);
-		ast_bridge_channel_unlock(bridge_channel);
-		return;
-	}
-
-	AST_LIST_TRAVERSE_SAFE_BEGIN(&bridge_channel->wr_queue, fr, frame_list) {
-		if (bridge_channel->dtmf_hook_state.collected[0]) {
-			switch (fr->frametype) {
-			case AST_FRAME_BRIDGE_ACTION:
-			case AST_FRAME_BRIDGE_ACTION_SYNC:
-				/* Defer processing these frames while DTMF is collected. */
-				continue;
-			default:
-				break;
-			}
-		}
-		ast_alertpipe_read(bridge_channel->alert_pipe);
-		AST_LIST_REMOVE_CURRENT(frame_list);
-		break;
-	}
-	AST_LIST_TRAVERSE_SAFE_END;
-
-	ast_bridge_channel_unlock(bridge_channel);
-
-	if (!fr) {
-		/*
-		 * Wait some to reduce CPU usage from a tight loop
-		 * without any wait because we only have deferred
-		 * frames in the wr_queue.
-		 */
-		usleep(1);
-		return;
-	}
-
 	switch (fr->frametype) {
 	case AST_FRAME_BRIDGE_ACTION:
 		bridge_channel_handle_action(bridge_channel, fr->subclass.integer, fr->data.ptr);
@@ -2539,11 +2565,108 @@ static void bridge_channel_handle_write(struct ast_bridge_channel *bridge_channe
 		/* Write the frame to the channel. */
 		bridge_channel->activity = BRIDGE_CHANNEL_THREAD_SIMPLE;
 		ast_write_stream(bridge_channel->chan, num, fr);
+		if (fr->frametype == AST_FRAME_VOICE && !ast_tvzero(fr->ingress)) {
+			bridge_channel_transit(bridge_channel, fr->ingress);
+		}
 		break;
 	}
+	if (fr->frametype != AST_FRAME_BRIDGE_ACTION && fr->frametype != AST_FRAME_BRIDGE_ACTION_SYNC) {
+		/* Actions run for as long as they like, they are not deliveries. */
+		ast_histogram_record_since(frame_delivery, queued);
+	}
 	bridge_frame_free(fr);
 }
 
+/*!
+ * \internal
+ * \brief Handle bridge channel write frame to channel.
+ * \since 12.0.0
+ *
+ * \param bridge_channel Channel to write outgoing frames.
+ *
+ * Writes the frames that were queued when called, stopping early if the
+ * channel leaves the wait state.  The alert pipe stays signaled for as
+ * long as frames are left in the wr_queue.
+ *
+ * \return Nothing
+ */
+static void bridge_channel_handle_write(struct ast_bridge_channel *bridge_channel)
+{
+	struct ast_frame *fr;
+	struct timeval queued = { 0, };
+	size_t pos;
+	size_t batch;
+	size_t handled;
+
+	ast_bridge_channel_lock(bridge_channel);
+
+	/* It's not good to have unbalanced frames and alert_pipe alerts. */
+	ast_assert(!AST_LIST_EMPTY(&bridge_channel->wr_queue));
+	if (AST_LIST_EMPTY(&bridge_channel->wr_queue)) {
+		/* No frame, flush the alert pipe of excess alerts. */
+		ast_log(LOG_WARNING, "Weird.  No frame from bridge for %s to process?\n",
+			ast_channel_name(bridge_channel->chan));
+		ast_alertpipe_read(bridge_channel->alert_pipe);
+		ast_bridge_channel_unlock(bridge_channel);
+		return;
+	}
+
+	batch = AST_VECTOR_SIZE(&bridge_channel->wr_queued);
+	for (handled = 0; handled < batch; ++handled) {
+		if (handled) {
+			ast_bridge_channel_lock(bridge_channel);
+		}
+
+		pos = 0;
+		AST_LIST_TRAVERSE_SAFE_BEGIN(&bridge_channel->wr_queue, fr, frame_list) {
+			if (bridge_channel->dtmf_hook_state.collected[0]) {
+				switch (fr->frametype) {
+				case AST_FRAME_BRIDGE_ACTION:
+				case AST_FRAME_BRIDGE_ACTION_SYNC:
+					/* Defer processing these frames while DTMF is collected. */
+					++pos;
+					continue;
+				default:
+					break;
+				}
+			}
+			AST_LIST_REMOVE_CURRENT(frame_list);
+			queued = AST_VECTOR_GET(&bridge_channel->wr_queued, pos);
+			AST_VECTOR_REMOVE_ORDERED(&bridge_channel->wr_queued, pos);
+			break;
+		}
+		AST_LIST_TRAVERSE_SAFE_END;
+
+		if (fr) {
+			if (AST_LIST_EMPTY(&bridge_channel->wr_queue)) {
+				ast_alertpipe_read(bridge_channel->alert_pipe);
+			}
+			bridge_channel->activity = BRIDGE_CHANNEL_THREAD_FRAME;
+		}
+
+		ast_bridge_channel_unlock(bridge_channel);
+
+		if (!fr) {
+			if (!handled) {
+				/*
+				 * Wait some to reduce CPU usage from a tight loop
+				 * without any wait because we only have deferred
+				 * frames in the wr_queue.
+				 */
+				usleep(1);
+			}
+			return;
+		}
+
+		bridge_channel_deliver_frame(bridge_channel, fr, queued);
+
+		if (bridge_channel->suspended
+			|| bridge_channel->state != BRIDGE_CHANNEL_STATE_WAIT) {
+			return;
+		}
+	}
+}
+
 /*! \brief Internal function to handle DTMF from a channel */
 static struct ast_frame *bridge_handle_dtmf(struct ast_bridge_channel *bridge_channel, struct ast_frame *frame)
 {
@@ -2558,7 +2681,7 @@ static struct ast_frame *bridge_handle_dtmf(struct ast_bridge_channel *bridge_ch
 	dtmf[0] = frame->subclass.integer;
 	dtmf[1] = '\0';
 	if (bridge_channel->dtmf_hook_state.collected[0]
-		|| (hook = ao2_find(features->dtmf_hooks, dtmf, OBJ_SEARCH_PARTIAL_KEY))) {
+		|| (hook = bridge_dtmf_hook_find(features, dtmf))) {
 		enum ast_frame_type frametype = frame->frametype;
 
 		bridge_frame_free(frame);
@@ -2637,6 +2760,9 @@ static void bridge_handle_trip(struct ast_bridge_channel *bridge_channel)
 		frame->stream_num = -1;
 	}
 
+	ast_trace_ring("%s: read frame %d/%d stream %d", ast_channel_name(bridge_channel->chan),
+		frame->frametype, frame->subclass.integer, frame->stream_num);
+
 	switch (frame->frametype) {
 	case AST_FRAME_CONTROL:
 		switch (frame->subclass.integer) {
@@ -3132,6 +3258,7 @@ static void bridge_channel_destroy(void *obj)
 	while ((fr = AST_LIST_REMOVE_HEAD(&bridge_channel->wr_queue, frame_list))) {
 		bridge_frame_free(fr);
 	}
+	AST_VECTOR_FREE(&bridge_channel->wr_queued);
 	ast_alertpipe_close(bridge_channel->alert_pipe);
 
 	/* Flush any unhandled deferred_queue frames. */
@@ -3157,6 +3284,7 @@ struct ast_bridge_channel *bridge_channel_internal_alloc(struct ast_bridge *brid
 		return NULL;
 	}
 	ast_cond_init(&bridge_channel->cond, NULL);
+	AST_VECTOR_INIT(&bridge_channel->wr_queued, 0);
 	if (ast_alertpipe_init(bridge_channel->alert_pipe)) {
 		ao2_ref(bridge_channel, -1);
 		return NULL;
@@ -3171,6 +3299,27 @@ struct ast_bridge_channel *bridge_channel_internal_alloc(struct ast_bridge *brid
 	return bridge_channel;
 }
 
+static void bridge_channel_internal_cleanup(void)
+{
+	ao2_cleanup(frame_delivery);
+	frame_delivery = NULL;
+	ao2_cleanup(media_transit);
+	media_transit = NULL;
+}
+
+int bridge_channel_internal_init(void)
+{
+	frame_delivery = ast_histogram_get("bridge_channel_frame_delivery",
+		"Time from queueing a frame onto a bridge channel to writing it to the channel.",
+		NULL, NULL);
+	media_transit = ast_histogram_get("bridge_channel_media_transit",
+		"Time from voice media entering Asterisk to it being written to a bridged channel.",
+		NULL, NULL);
+	ast_register_cleanup(bridge_channel_internal_cleanup);
+
+	return 0;
+}
+
 void ast_bridge_channel_stream_map(struct ast_bridge_channel *bridge_channel)
 {
 	ast_bridge_channel_lock(bridge_channel);
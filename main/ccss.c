@@ -119,10 +119,24 @@ static struct ast_sched_context *cc_sched_context;
  */
 static int core_id_counter;
 /*!
- * Taskprocessor from which all CC agent and monitor callbacks
- * are called.
+ * Number of taskprocessors the CC core instances are spread over.
  */
-static struct ast_taskprocessor *cc_core_taskprocessor;
+#define CC_CORE_TASKPROCESSORS 8
+/*!
+ * Taskprocessors from which all CC agent and monitor callbacks
+ * are called. All callbacks of a core instance are made from the
+ * same one, chosen by its core ID.
+ */
+static struct ast_taskprocessor *cc_core_taskprocessors[CC_CORE_TASKPROCESSORS];
+
+/*!
+ * \internal
+ * \brief Get the taskprocessor running the state machine of a core instance
+ */
+static struct ast_taskprocessor *cc_core_taskprocessor(int core_id)
+{
+	return cc_core_taskprocessors[(unsigned int) core_id % CC_CORE_TASKPROCESSORS];
+}
 /*!
  * Name printed on all CC log messages.
  */
@@ -323,7 +337,7 @@ struct cc_control_payload {
  */
 AST_LIST_HEAD(cc_monitor_tree, ast_cc_monitor);
 
-static const int CC_CORE_INSTANCES_BUCKETS = 17;
+static const int CC_CORE_INSTANCES_BUCKETS = 563;
 static struct ao2_container *cc_core_instances;
 
 struct cc_core_instance {
@@ -1359,6 +1373,11 @@ struct generic_monitor_instance_list {
 	 */
 	int fit_for_recall;
 	struct stasis_subscription *sub;
+	/* The instances of core instances on different taskprocessors
+	 * share the list, so it is protected by the lock of the list
+	 * object. It is only added to or emptied and unlinked with the
+	 * generic_monitors container locked first.
+	 */
 	AST_LIST_HEAD_NOLOCK(, generic_monitor_instance) list;
 };
 
@@ -1447,6 +1466,8 @@ static int generic_monitor_devstate_tp_cb(void *data)
 	enum ast_device_state previous_state;
 	struct generic_monitor_instance_list *generic_list;
 	struct generic_monitor_instance *generic_instance;
+	/* Signaled once the list is unlocked */
+	int available_core_id = -1;
 
 	if (!(generic_list = find_generic_monitor_instance_list(dev_state->device))) {
 		/* The most likely cause for this is that we destroyed the monitor in the
@@ -1456,8 +1477,10 @@ static int generic_monitor_devstate_tp_cb(void *data)
 		return 0;
 	}
 
+	ao2_lock(generic_list);
 	if (generic_list->current_state == new_state) {
 		/* The device state hasn't actually changed, so we don't really care */
+		ao2_unlock(generic_list);
 		cc_unref(generic_list, "Kill reference of generic list in devstate taskprocessor callback");
 		return 0;
 	}
@@ -1472,11 +1495,15 @@ static int generic_monitor_devstate_tp_cb(void *data)
 			if (!generic_instance->is_suspended && generic_instance->monitoring) {
 				generic_instance->monitoring = 0;
 				generic_list->fit_for_recall = 1;
-				ast_cc_monitor_callee_available(generic_instance->core_id, "Generic monitored party has become available");
+				available_core_id = generic_instance->core_id;
 				break;
 			}
 		}
 	}
+	ao2_unlock(generic_list);
+	if (available_core_id != -1) {
+		ast_cc_monitor_callee_available(available_core_id, "Generic monitored party has become available");
+	}
 	cc_unref(generic_list, "Kill reference of generic list in devstate taskprocessor callback");
 	return 0;
 }
@@ -1484,9 +1511,9 @@ static int generic_monitor_devstate_tp_cb(void *data)
 static void generic_monitor_devstate_cb(void *userdata, struct stasis_subscription *sub, struct stasis_message *msg)
 {
 	/* Wow, it's cool that we've picked up on a state change, but we really want
-	 * the actual work to be done in the core's taskprocessor execution thread
-	 * so that all monitor operations can be serialized. Locks?! We don't need
-	 * no steenkin' locks!
+	 * the actual work to be done in a core taskprocessor execution thread. The
+	 * state changes of a device always go to the same one, so they are handled
+	 * in order.
 	 */
 	struct ast_device_state_message *dev_state;
 	if (ast_device_state_message_type() != stasis_message_type(msg)) {
@@ -1500,7 +1527,8 @@ static void generic_monitor_devstate_cb(void *userdata, struct stasis_subscripti
 	}
 
 	ao2_t_ref(dev_state, +1, "Bumping dev_state ref for cc_core_taskprocessor");
-	if (ast_taskprocessor_push(cc_core_taskprocessor, generic_monitor_devstate_tp_cb, dev_state)) {
+	if (ast_taskprocessor_push(cc_core_taskprocessor(ast_str_case_hash(dev_state->device)),
+			generic_monitor_devstate_tp_cb, dev_state)) {
 		ao2_cleanup(dev_state);
 		return;
 	}
@@ -1541,8 +1569,11 @@ static int cc_generic_monitor_request_cc(struct ast_cc_monitor *monitor, int *av
 
 	monitor->private_data = gen_mon_pvt;
 
+	/* Keep the list from being emptied and unlinked until the instance is in */
+	ao2_lock(generic_monitors);
 	if (!(generic_list = find_generic_monitor_instance_list(monitor->interface->device_name))) {
 		if (!(generic_list = create_new_generic_list(monitor))) {
+			ao2_unlock(generic_monitors);
 			return -1;
 		}
 	}
@@ -1551,12 +1582,16 @@ static int cc_generic_monitor_request_cc(struct ast_cc_monitor *monitor, int *av
 		/* The generic monitor destructor will take care of the appropriate
 		 * deallocations
 		 */
+		ao2_unlock(generic_monitors);
 		cc_unref(generic_list, "Generic monitor instance failed to allocate");
 		return -1;
 	}
 	generic_instance->core_id = monitor->core_id;
 	generic_instance->monitoring = 1;
+	ao2_lock(generic_list);
 	AST_LIST_INSERT_TAIL(&generic_list->list, generic_instance, next);
+	ao2_unlock(generic_list);
+	ao2_unlock(generic_monitors);
 	when = service == AST_CC_CCBS ? ast_get_ccbs_available_timer(monitor->interface->config_params) :
 		ast_get_ccnr_available_timer(monitor->interface->config_params);
 
@@ -1571,7 +1606,9 @@ static int cc_generic_monitor_request_cc(struct ast_cc_monitor *monitor, int *av
 	 * fit for recall even if it previously was.
 	 */
 	if (service == AST_CC_CCNR || service == AST_CC_CCNL) {
+		ao2_lock(generic_list);
 		generic_list->fit_for_recall = 0;
+		ao2_unlock(generic_list);
 	}
 	ast_cc_monitor_request_acked(monitor->core_id, "Generic monitor for %s subscribed to device state.",
 			monitor->interface->device_name);
@@ -1584,11 +1621,14 @@ static int cc_generic_monitor_suspend(struct ast_cc_monitor *monitor)
 	struct generic_monitor_instance_list *generic_list;
 	struct generic_monitor_instance *generic_instance;
 	enum ast_device_state state = ast_device_state(monitor->interface->device_name);
+	int available_core_id = -1;
 
 	if (!(generic_list = find_generic_monitor_instance_list(monitor->interface->device_name))) {
 		return -1;
 	}
 
+	ao2_lock(generic_list);
+
 	/* First we need to mark this particular monitor as being suspended. */
 	AST_LIST_TRAVERSE(&generic_list->list, generic_instance, next) {
 		if (generic_instance->core_id == monitor->core_id) {
@@ -1601,6 +1641,7 @@ static int cc_generic_monitor_suspend(struct ast_cc_monitor *monitor)
 	 * take any further actions
 	 */
 	if (!cc_generic_is_device_available(state)) {
+		ao2_unlock(generic_list);
 		cc_unref(generic_list, "Device is in use. Nothing to do. Unref generic list.");
 		return 0;
 	}
@@ -1612,10 +1653,14 @@ static int cc_generic_monitor_suspend(struct ast_cc_monitor *monitor)
 
 	AST_LIST_TRAVERSE(&generic_list->list, generic_instance, next) {
 		if (!generic_instance->is_suspended) {
-			ast_cc_monitor_callee_available(generic_instance->core_id, "Generic monitored party has become available");
+			available_core_id = generic_instance->core_id;
 			break;
 		}
 	}
+	ao2_unlock(generic_list);
+	if (available_core_id != -1) {
+		ast_cc_monitor_callee_available(available_core_id, "Generic monitored party has become available");
+	}
 	cc_unref(generic_list, "Done with generic list in suspend callback");
 	return 0;
 }
@@ -1637,6 +1682,7 @@ static int cc_generic_monitor_unsuspend(struct ast_cc_monitor *monitor)
 	}
 
 	/* In addition, we need to mark this generic_monitor_instance as not being suspended anymore */
+	ao2_lock(generic_list);
 	AST_LIST_TRAVERSE(&generic_list->list, generic_instance, next) {
 		if (generic_instance->core_id == monitor->core_id) {
 			generic_instance->is_suspended = 0;
@@ -1644,6 +1690,7 @@ static int cc_generic_monitor_unsuspend(struct ast_cc_monitor *monitor)
 			break;
 		}
 	}
+	ao2_unlock(generic_list);
 	cc_unref(generic_list, "Done with generic list in cc_generic_monitor_unsuspend");
 	return 0;
 }
@@ -1670,6 +1717,7 @@ static void cc_generic_monitor_destructor(void *private_data)
 	struct generic_monitor_pvt *gen_mon_pvt = private_data;
 	struct generic_monitor_instance_list *generic_list;
 	struct generic_monitor_instance *generic_instance;
+	int available_core_id = -1;
 
 	if (!private_data) {
 		/* If the private data is NULL, that means that the monitor hasn't even
@@ -1683,16 +1731,19 @@ static void cc_generic_monitor_destructor(void *private_data)
 	ast_log_dynamic_level(cc_logger_level, "Core %d: Destroying generic monitor %s\n",
 			gen_mon_pvt->core_id, gen_mon_pvt->device_name);
 
+	ao2_lock(generic_monitors);
 	if (!(generic_list = find_generic_monitor_instance_list(gen_mon_pvt->device_name))) {
 		/* If there's no generic list, that means that the monitor is being destroyed
 		 * before we actually got to request CC. Not a biggie. Same in the situation
 		 * below if the list traversal should complete without finding an entry.
 		 */
+		ao2_unlock(generic_monitors);
 		ast_free((char *)gen_mon_pvt->device_name);
 		ast_free(gen_mon_pvt);
 		return;
 	}
 
+	ao2_lock(generic_list);
 	AST_LIST_TRAVERSE_SAFE_BEGIN(&generic_list->list, generic_instance, next) {
 		if (generic_instance->core_id == gen_mon_pvt->core_id) {
 			AST_LIST_REMOVE_CURRENT(next);
@@ -1722,13 +1773,18 @@ static void cc_generic_monitor_destructor(void *private_data)
 			&& cc_generic_is_device_available(generic_list->current_state)) {
 			AST_LIST_TRAVERSE(&generic_list->list, generic_instance, next) {
 				if (!generic_instance->is_suspended && generic_instance->monitoring) {
-					ast_cc_monitor_callee_available(generic_instance->core_id, "Signaling generic monitor "
-							"availability due to other instance's failure.");
+					available_core_id = generic_instance->core_id;
 					break;
 				}
 			}
 		}
 	}
+	ao2_unlock(generic_list);
+	ao2_unlock(generic_monitors);
+	if (available_core_id != -1) {
+		ast_cc_monitor_callee_available(available_core_id, "Signaling generic monitor "
+				"availability due to other instance's failure.");
+	}
 	cc_unref(generic_list, "Done with generic list in generic monitor destructor");
 	ast_free((char *)gen_mon_pvt->device_name);
 	ast_free(gen_mon_pvt);
@@ -3360,7 +3416,7 @@ static int cc_request_state_change(enum cc_state state, const int core_id, const
 	args->core_id = core_id;
 	vsnprintf(args->debug, debuglen, debug, ap);
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_do_state_change, args);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_do_state_change, args);
 	if (res) {
 		cc_unref(core_instance, "Unref core instance. ast_taskprocessor_push failed");
 		ast_free(args);
@@ -3964,7 +4020,7 @@ int ast_cc_monitor_failed(int core_id, const char *const monitor_name, const cha
 
 	failure_data->core_id = core_id;
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_monitor_failed, failure_data);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_monitor_failed, failure_data);
 	if (res) {
 		ast_free((char *)failure_data->device_name);
 		ast_free((char *)failure_data->debug);
@@ -3992,7 +4048,7 @@ int ast_cc_monitor_status_request(int core_id)
 		return -1;
 	}
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_status_request, core_instance);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_status_request, core_instance);
 	if (res) {
 		cc_unref(core_instance, "Unref core instance. ast_taskprocessor_push failed");
 	}
@@ -4029,7 +4085,7 @@ int ast_cc_monitor_stop_ringing(int core_id)
 		return -1;
 	}
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_stop_ringing, core_instance);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_stop_ringing, core_instance);
 	if (res) {
 		cc_unref(core_instance, "Unref core instance. ast_taskprocessor_push failed");
 	}
@@ -4057,7 +4113,7 @@ int ast_cc_monitor_party_b_free(int core_id)
 		return -1;
 	}
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_party_b_free, core_instance);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_party_b_free, core_instance);
 	if (res) {
 		cc_unref(core_instance, "Unref core instance. ast_taskprocessor_push failed");
 	}
@@ -4110,7 +4166,7 @@ int ast_cc_agent_status_response(int core_id, enum ast_device_state devstate)
 	args->core_instance = core_instance;
 	args->devstate = devstate;
 
-	res = ast_taskprocessor_push(cc_core_taskprocessor, cc_status_response, args);
+	res = ast_taskprocessor_push(cc_core_taskprocessor(core_id), cc_status_response, args);
 	if (res) {
 		cc_unref(core_instance, "Unref core instance. ast_taskprocessor_push failed");
 		ast_free(args);
@@ -4534,7 +4590,7 @@ static char *handle_cc_status(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 
 	*cli_fd = a->fd;
 
-	if (ast_taskprocessor_push(cc_core_taskprocessor, cc_cli_output_status, cli_fd)) {
+	if (ast_taskprocessor_push(cc_core_taskprocessor(0), cc_cli_output_status, cli_fd)) {
 		ast_free(cli_fd);
 		return CLI_FAILURE;
 	}
@@ -4622,6 +4678,8 @@ static struct ast_cli_entry cc_cli[] = {
 
 static int unload_module(void)
 {
+	int i;
+
 	ast_devstate_prov_del("ccss");
 	ast_cc_agent_unregister(&generic_agent_callbacks);
 	ast_cc_monitor_unregister(&generic_monitor_cbs);
@@ -4634,8 +4692,8 @@ static int unload_module(void)
 		ast_sched_context_destroy(cc_sched_context);
 		cc_sched_context = NULL;
 	}
-	if (cc_core_taskprocessor) {
-		cc_core_taskprocessor = ast_taskprocessor_unreference(cc_core_taskprocessor);
+	for (i = 0; i < CC_CORE_TASKPROCESSORS; i++) {
+		cc_core_taskprocessors[i] = ast_taskprocessor_unreference(cc_core_taskprocessors[i]);
 	}
 	/* Note that core instances must be destroyed prior to the generic_monitors */
 	if (cc_core_instances) {
@@ -4653,6 +4711,7 @@ static int unload_module(void)
 static int load_module(void)
 {
 	int res;
+	int i;
 
 	cc_core_instances = ao2_t_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
 		CC_CORE_INSTANCES_BUCKETS,
@@ -4669,8 +4728,13 @@ static int load_module(void)
 	if (!generic_monitors) {
 		return AST_MODULE_LOAD_FAILURE;
 	}
-	if (!(cc_core_taskprocessor = ast_taskprocessor_get("CCSS_core", TPS_REF_DEFAULT))) {
-		return AST_MODULE_LOAD_FAILURE;
+	for (i = 0; i < CC_CORE_TASKPROCESSORS; i++) {
+		char tps_name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+		snprintf(tps_name, sizeof(tps_name), "CCSS_core-%d", i);
+		if (!(cc_core_taskprocessors[i] = ast_taskprocessor_get(tps_name, TPS_REF_DEFAULT))) {
+			return AST_MODULE_LOAD_FAILURE;
+		}
 	}
 	if (!(cc_sched_context = ast_sched_context_create())) {
 		return AST_MODULE_LOAD_FAILURE;
@@ -70,6 +70,7 @@
 #include "asterisk/stasis_message_router.h"
 #include "asterisk/astobj2.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/vector.h"
 
 /*** DOCUMENTATION
 	<configInfo name="cdr" language="en_US">
@@ -149,6 +150,17 @@
 					</warning>
 					</description>
 				</configOption>
+				<configOption name="shards">
+					<synopsis>Spread the handling of channel messages across this many threads</synopsis>
+					<description><para>Normally one thread turns the channel, dial and bridge messages of every
+					channel into CDRs. Setting this to more than one spreads the channel and dial messages of
+					different calls across that many threads, while bridge and parking messages are still
+					handled one at a time with the other threads caught up. A channel that is bridged with or
+					dials a channel of a call on another thread has all of its messages handled that way from
+					then on. The default of <literal>0</literal> uses just the one thread.</para>
+					<note><para>This option only takes effect when Asterisk is started.</para></note>
+					</description>
+				</configOption>
 				<configOption name="size">
 					<synopsis>The maximum number of CDRs to accumulate before triggering a batch</synopsis>
 					<description><para>Define the maximum number of CDRs to accumulate in the buffer before posting
@@ -200,6 +212,9 @@
 #define DEFAULT_BATCH_SCHEDULER_ONLY "0"
 #define DEFAULT_BATCH_SAFE_SHUTDOWN "1"
 
+#define DEFAULT_SHARDS "0"
+#define MAX_SHARDS 64
+
 #define cdr_set_debug_mode(mod_cfg) \
 	do { \
 		cdr_debug_enabled = ast_test_flag(&(mod_cfg)->general->settings, CDR_DEBUG); \
@@ -322,6 +337,7 @@ struct cdr_beitem {
 	char name[20];
 	char desc[80];
 	ast_cdrbe be;
+	ast_cdrbe_batch batch_be;
 	AST_RWLIST_ENTRY(cdr_beitem) list;
 	int suspended:1;
 };
@@ -385,6 +401,19 @@ static struct stasis_topic *cdr_topic;
 /*! \brief A message type used to synchronize with the CDR topic */
 STASIS_MESSAGE_TYPE_DEFN_LOCAL(cdr_sync_message_type);
 
+/*! \brief The serializers channel and dial messages are spread across */
+static struct ast_taskprocessor **cdr_shards;
+
+/*! \brief How many serializers are in \ref cdr_shards, 0 if messages are not spread */
+static unsigned int cdr_shard_count;
+
+/*!
+ * \brief The shard the messages of each channel are handled on, indexed by uniqueid
+ *
+ * Only the message router uses it, so it has no lock.
+ */
+static struct ao2_container *cdr_shard_channels;
+
 struct cdr_object;
 
 /*! \brief Return types for \ref process_bridge_enter functions */
@@ -1595,6 +1624,9 @@ static int base_process_party_a(struct cdr_object *cdr, struct ast_channel_snaps
 	cdr_object_check_party_a_answer(cdr);
 	cdr_object_check_party_a_hangup(cdr);
 
+	/* Long running dialplan keeps replacing appl and data, don't let the old values pile up */
+	ast_string_field_compact(cdr);
+
 	return 0;
 }
 
@@ -2093,6 +2125,243 @@ static int dial_status_end(const char *dialstatus)
 			strcmp(dialstatus, "PROGRESS"));
 }
 
+/* SHARDED MESSAGE HANDLING */
+
+/*!
+ * \brief A channel in \ref cdr_shard_channels
+ *
+ * Handlers lock the CDRs of the channel a message is about, but update the
+ * Party B of other CDRs without locking them, so a channel can only be
+ * handled on a shard as long as it can't be the Party B of a channel on
+ * another one. Once it may be, it is entangled and its messages are handled
+ * by the router with every shard drained, like bridge messages are.
+ */
+struct cdr_shard_channel {
+	/*! The shard its messages are handled on */
+	unsigned int shard;
+	/*! Non-zero if it may be paired with a channel on another shard */
+	int entangled;
+	/*! The uniqueid of the channel */
+	char uniqueid[0];
+};
+
+AO2_STRING_FIELD_HASH_FN(cdr_shard_channel, uniqueid);
+AO2_STRING_FIELD_CMP_FN(cdr_shard_channel, uniqueid);
+
+/*!
+ * \internal
+ * \brief Pick the shard of a new channel
+ *
+ * Channels created for a call take its linkedid when they are created, so
+ * the channels of one call end up on one shard.
+ */
+static struct cdr_shard_channel *cdr_shard_channel_add(struct ast_channel_snapshot *snapshot)
+{
+	size_t len = strlen(snapshot->base->uniqueid) + 1;
+	struct cdr_shard_channel *channel;
+
+	channel = ao2_alloc_options(sizeof(*channel) + len, NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!channel) {
+		return NULL;
+	}
+	channel->shard = ast_str_hash(snapshot->peer->linkedid) % cdr_shard_count;
+	memcpy(channel->uniqueid, snapshot->base->uniqueid, len);
+	ao2_link(cdr_shard_channels, channel);
+
+	return channel;
+}
+
+/*!
+ * \internal
+ * \brief Entangle the channels in a bridge that are not all on one shard
+ */
+static void cdr_shards_entangle(struct ast_channel_snapshot *snapshot, struct ast_bridge_snapshot *bridge)
+{
+	struct cdr_shard_channel *channel;
+	struct ao2_iterator it_channels;
+	char *channel_id;
+
+	channel = ao2_find(cdr_shard_channels, snapshot->base->uniqueid, OBJ_SEARCH_KEY);
+
+	it_channels = ao2_iterator_init(bridge->channels, 0);
+	while ((channel_id = ao2_iterator_next(&it_channels))) {
+		struct cdr_shard_channel *other;
+
+		other = ao2_find(cdr_shard_channels, channel_id, OBJ_SEARCH_KEY);
+		if (other && other != channel && (!channel || channel->shard != other->shard)) {
+			other->entangled = 1;
+			if (channel) {
+				channel->entangled = 1;
+			}
+		}
+		ao2_cleanup(other);
+		ao2_ref(channel_id, -1);
+	}
+	ao2_iterator_destroy(&it_channels);
+
+	ao2_cleanup(channel);
+}
+
+/*! \brief Waits for every shard to get through the messages it was given */
+struct cdr_shards_drain {
+	ast_mutex_t lock;
+	ast_cond_t cond;
+	unsigned int pending;
+};
+
+static int cdr_shard_drained(void *data)
+{
+	struct cdr_shards_drain *drain = data;
+
+	ast_mutex_lock(&drain->lock);
+	if (!--drain->pending) {
+		ast_cond_signal(&drain->cond);
+	}
+	ast_mutex_unlock(&drain->lock);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Wait for the shards to handle every message they were given
+ *
+ * Messages the router handles itself can touch the CDRs of any channel, so
+ * they have to wait for the shards to have caught up with them.
+ */
+static void cdr_shards_drain(void)
+{
+	struct cdr_shards_drain drain = {
+		.pending = cdr_shard_count,
+	};
+	unsigned int i;
+
+	if (!cdr_shard_count) {
+		return;
+	}
+
+	ast_mutex_init(&drain.lock);
+	ast_cond_init(&drain.cond, NULL);
+
+	ast_mutex_lock(&drain.lock);
+	for (i = 0; i < cdr_shard_count; ++i) {
+		if (ast_taskprocessor_push(cdr_shards[i], cdr_shard_drained, &drain)) {
+			--drain.pending;
+		}
+	}
+	while (drain.pending) {
+		ast_cond_wait(&drain.cond, &drain.lock);
+	}
+	ast_mutex_unlock(&drain.lock);
+
+	ast_mutex_destroy(&drain.lock);
+	ast_cond_destroy(&drain.cond);
+}
+
+/*! \brief A message to be handled on a shard */
+struct cdr_shard_task {
+	stasis_subscription_cb handler;
+	struct stasis_message *message;
+};
+
+static int cdr_shard_task_run(void *data)
+{
+	struct cdr_shard_task *task = data;
+
+	task->handler(NULL, NULL, task->message);
+	ao2_ref(task->message, -1);
+	ast_free(task);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Have a message handled on a shard, or by the router if not possible
+ */
+static void cdr_shard_push(struct cdr_shard_channel *channel, stasis_subscription_cb handler,
+	struct stasis_message *message)
+{
+	struct cdr_shard_task *task;
+
+	if (channel && !channel->entangled) {
+		task = ast_malloc(sizeof(*task));
+		if (task) {
+			task->handler = handler;
+			task->message = ao2_bump(message);
+			if (!ast_taskprocessor_push(cdr_shards[channel->shard], cdr_shard_task_run, task)) {
+				return;
+			}
+			ao2_ref(message, -1);
+			ast_free(task);
+		}
+	}
+
+	cdr_shards_drain();
+	handler(NULL, NULL, message);
+}
+
+/*!
+ * \internal
+ * \brief Create the shards the CDR messages of channels are spread across
+ *
+ * \retval 0 on success
+ * \retval -1 on error
+ */
+static int cdr_shards_create(unsigned int count)
+{
+	unsigned int i;
+
+	if (!count) {
+		return 0;
+	}
+
+	cdr_shard_channels = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0,
+		AST_NUM_CHANNEL_BUCKETS, cdr_shard_channel_hash_fn, NULL, cdr_shard_channel_cmp_fn);
+	if (!cdr_shard_channels) {
+		return -1;
+	}
+
+	cdr_shards = ast_calloc(count, sizeof(*cdr_shards));
+	if (!cdr_shards) {
+		return -1;
+	}
+
+	for (i = 0; i < count; ++i) {
+		char name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+		snprintf(name, sizeof(name), "cdr:shard-%02u", i);
+		cdr_shards[i] = ast_taskprocessor_get(name, TPS_REF_DEFAULT);
+		if (!cdr_shards[i]) {
+			return -1;
+		}
+		++cdr_shard_count;
+	}
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Destroy the shards once the router stopped giving them messages
+ */
+static void cdr_shards_destroy(void)
+{
+	unsigned int i;
+
+	cdr_shards_drain();
+
+	for (i = 0; i < cdr_shard_count; ++i) {
+		ast_taskprocessor_unreference(cdr_shards[i]);
+	}
+	cdr_shard_count = 0;
+	ast_free(cdr_shards);
+	cdr_shards = NULL;
+
+	ao2_cleanup(cdr_shard_channels);
+	cdr_shard_channels = NULL;
+}
+
 /* TOPIC ROUTER CALLBACKS */
 
 /*!
@@ -2416,6 +2685,8 @@ static void handle_bridge_leave_message(void *data, struct stasis_subscription *
 	};
 	int left_bridge = 0;
 
+	cdr_shards_drain();
+
 	if (filter_bridge_messages(bridge)) {
 		return;
 	}
@@ -2713,6 +2984,11 @@ static void handle_bridge_enter_message(void *data, struct stasis_subscription *
 	struct ast_channel_snapshot *channel = update->channel;
 	struct cdr_object *cdr;
 
+	if (cdr_shard_count) {
+		cdr_shards_entangle(channel, bridge);
+		cdr_shards_drain();
+	}
+
 	if (filter_bridge_messages(bridge)) {
 		return;
 	}
@@ -2757,6 +3033,8 @@ static void handle_parked_call_message(void *data, struct stasis_subscription *s
 	int unhandled = 1;
 	struct cdr_object *it_cdr;
 
+	cdr_shards_drain();
+
 	/* Anything other than getting parked will be handled by other updates */
 	if (payload->event_type != PARKED_CALL) {
 		return;
@@ -2820,7 +3098,92 @@ static void handle_parked_call_message(void *data, struct stasis_subscription *s
 static void handle_cdr_sync_message(void *data, struct stasis_subscription *sub,
 		struct stasis_message *message)
 {
-	return;
+	/* Synchronizing with the router has to include the shards */
+	cdr_shards_drain();
+}
+
+/*!
+ * \internal
+ * \brief Router callback for channel snapshot update messages
+ *
+ * Hands the message to the shard of the channel when messages are spread
+ * across shards.
+ */
+static void route_channel_snapshot_update_message(void *data, struct stasis_subscription *sub,
+		struct stasis_message *message)
+{
+	struct ast_channel_snapshot_update *update = stasis_message_data(message);
+	struct cdr_shard_channel *channel;
+
+	if (!cdr_shard_count) {
+		handle_channel_snapshot_update_message(data, sub, message);
+		return;
+	}
+
+	if (!update->old_snapshot) {
+		channel = cdr_shard_channel_add(update->new_snapshot);
+	} else {
+		channel = ao2_find(cdr_shard_channels, update->new_snapshot->base->uniqueid, OBJ_SEARCH_KEY);
+	}
+
+	cdr_shard_push(channel, handle_channel_snapshot_update_message, message);
+
+	if (channel && ast_test_flag(&update->new_snapshot->flags, AST_FLAG_DEAD)) {
+		ao2_unlink(cdr_shard_channels, channel);
+	}
+	ao2_cleanup(channel);
+}
+
+/*!
+ * \internal
+ * \brief Router callback for dial messages
+ *
+ * A Dial makes the peer the Party B of the caller, so the two are entangled
+ * if they are not on the same shard.
+ */
+static void route_dial_message(void *data, struct stasis_subscription *sub,
+		struct stasis_message *message)
+{
+	struct ast_multi_channel_blob *payload = stasis_message_data(message);
+	struct ast_channel_snapshot *caller;
+	struct ast_channel_snapshot *peer;
+	struct cdr_shard_channel *caller_channel = NULL;
+	struct cdr_shard_channel *peer_channel = NULL;
+	struct cdr_shard_channel *channel;
+
+	if (!cdr_shard_count) {
+		handle_dial_message(data, sub, message);
+		return;
+	}
+
+	caller = ast_multi_channel_blob_get_channel(payload, "caller");
+	if (caller) {
+		caller_channel = ao2_find(cdr_shard_channels, caller->base->uniqueid, OBJ_SEARCH_KEY);
+	}
+	peer = ast_multi_channel_blob_get_channel(payload, "peer");
+	if (peer) {
+		peer_channel = ao2_find(cdr_shard_channels, peer->base->uniqueid, OBJ_SEARCH_KEY);
+	}
+
+	if ((caller && !caller_channel) || (peer && !peer_channel)
+		|| (caller_channel && peer_channel && caller_channel->shard != peer_channel->shard)) {
+		if (caller_channel) {
+			caller_channel->entangled = 1;
+		}
+		if (peer_channel) {
+			peer_channel->entangled = 1;
+		}
+	}
+	if ((caller_channel && caller_channel->entangled) || (peer_channel && peer_channel->entangled)) {
+		channel = NULL;
+	} else {
+		channel = caller_channel ?: peer_channel;
+	}
+
+	cdr_shard_push(channel, handle_dial_message, message);
+
+	ao2_cleanup(caller_channel);
+	ao2_cleanup(peer_channel);
 }
 
 struct ast_cdr_config *ast_cdr_get_config(void)
@@ -2899,7 +3262,8 @@ int ast_cdr_backend_unsuspend(const char *name)
 	return success;
 }
 
-static int cdr_generic_register(struct be_list *generic_list, const char *name, const char *desc, ast_cdrbe be)
+static int cdr_generic_register(struct be_list *generic_list, const char *name, const char *desc,
+	ast_cdrbe be, ast_cdrbe_batch batch_be)
 {
 	struct cdr_beitem *i;
 	struct cdr_beitem *cur;
@@ -2920,6 +3284,7 @@ static int cdr_generic_register(struct be_list *generic_list, const char *name,
 	}
 
 	i->be = be;
+	i->batch_be = batch_be;
 	ast_copy_string(i->name, name, sizeof(i->name));
 	ast_copy_string(i->desc, desc, sizeof(i->desc));
 
@@ -2942,12 +3307,17 @@ static int cdr_generic_register(struct be_list *generic_list, const char *name,
 
 int ast_cdr_register(const char *name, const char *desc, ast_cdrbe be)
 {
-	return cdr_generic_register(&be_list, name, desc, be);
+	return cdr_generic_register(&be_list, name, desc, be, NULL);
+}
+
+int ast_cdr_register_batch(const char *name, const char *desc, ast_cdrbe be, ast_cdrbe_batch batch_be)
+{
+	return cdr_generic_register(&be_list, name, desc, be, batch_be);
 }
 
 int ast_cdr_modifier_register(const char *name, const char *desc, ast_cdrbe be)
 {
-	return cdr_generic_register((struct be_list *)&mo_list, name, desc, be);
+	return cdr_generic_register((struct be_list *)&mo_list, name, desc, be, NULL);
 }
 
 static int ast_cdr_generic_unregister(struct be_list *generic_list, const char *name)
@@ -3119,6 +3489,244 @@ void ast_cdr_format_var(struct ast_cdr *cdr, const char *name, char **ret, char
 	}
 }
 
+/*! \brief One piece of a compiled CDR template */
+struct cdr_template_part {
+	/*! Non-zero if text names a CDR field rather than being literal text */
+	unsigned int field:1;
+	/*! Quote the value as CSV_QUOTE() would */
+	unsigned int csv_quote:1;
+	/*! The unparsed value, the 'u' option of CDR() */
+	unsigned int raw:1;
+	/*! Fractional seconds, the 'f' option of CDR() */
+	unsigned int fraction:1;
+	/*! Literal text or the name of the field */
+	char text[0];
+};
+
+struct ast_cdr_template {
+	AST_VECTOR(, struct cdr_template_part *) parts;
+};
+
+void ast_cdr_template_free(struct ast_cdr_template *tpl)
+{
+	if (!tpl) {
+		return;
+	}
+
+	AST_VECTOR_RESET(&tpl->parts, ast_free);
+	AST_VECTOR_FREE(&tpl->parts);
+	ast_free(tpl);
+}
+
+static struct cdr_template_part *cdr_template_part_add(struct ast_cdr_template *tpl,
+	const char *text, size_t len)
+{
+	struct cdr_template_part *part;
+
+	part = ast_calloc(1, sizeof(*part) + len + 1);
+	if (!part) {
+		return NULL;
+	}
+	memcpy(part->text, text, len);
+
+	if (AST_VECTOR_APPEND(&tpl->parts, part)) {
+		ast_free(part);
+		return NULL;
+	}
+
+	return part;
+}
+
+/*!
+ * \internal
+ * \brief Find the end of the ${ reference starting at ref
+ *
+ * \return The closing brace, or NULL if there is none
+ */
+static const char *cdr_template_reference_end(const char *ref)
+{
+	int depth = 0;
+
+	for (; *ref; ++ref) {
+		if (ref[0] == '$' && ref[1] == '{') {
+			++depth;
+			++ref;
+		} else if (*ref == '}' && !--depth) {
+			return ref;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Compile what is between the braces of a ${ reference
+ *
+ * \retval 0 if it is a CDR() lookup, possibly within CSV_QUOTE()
+ * \retval -1 otherwise
+ */
+static int cdr_template_add_reference(struct ast_cdr_template *tpl, char *ref)
+{
+	struct cdr_template_part *part;
+	int csv_quote = 0;
+	size_t len = strlen(ref);
+	char *options;
+
+	if (ast_begins_with(ref, "CSV_QUOTE(${") && len > 14 && !strcmp(ref + len - 2, "})")) {
+		ref += 12;
+		len -= 14;
+		ref[len] = '\0';
+		csv_quote = 1;
+	}
+
+	if (!ast_begins_with(ref, "CDR(") || len < 6 || ref[len - 1] != ')') {
+		return -1;
+	}
+	ref += 4;
+	len -= 5;
+	ref[len] = '\0';
+
+	/* Arguments built from other references, or with spaces to strip, are left to the dialplan */
+	if (strpbrk(ref, "${}()[] \t\\")) {
+		return -1;
+	}
+
+	options = strchr(ref, ',');
+	if (options) {
+		*options++ = '\0';
+		if (strspn(options, "fu") != strlen(options)) {
+			return -1;
+		}
+	}
+	if (ast_strlen_zero(ref)) {
+		return -1;
+	}
+
+	part = cdr_template_part_add(tpl, ref, strlen(ref));
+	if (!part) {
+		return -1;
+	}
+	part->field = 1;
+	part->csv_quote = csv_quote;
+	part->raw = options && strchr(options, 'u');
+	part->fraction = options && strchr(options, 'f');
+
+	return 0;
+}
+
+struct ast_cdr_template *ast_cdr_template_compile(const char *format)
+{
+	struct ast_cdr_template *tpl;
+
+	/* Expressions are left to the dialplan */
+	if (strstr(format, "$[")) {
+		return NULL;
+	}
+
+	tpl = ast_calloc(1, sizeof(*tpl));
+	if (!tpl || AST_VECTOR_INIT(&tpl->parts, 8)) {
+		ast_free(tpl);
+		return NULL;
+	}
+
+	while (*format) {
+		const char *ref = strstr(format, "${");
+		const char *end;
+		char *inner;
+
+		if (!ref) {
+			ref = format + strlen(format);
+		}
+		if (ref != format && !cdr_template_part_add(tpl, format, ref - format)) {
+			break;
+		}
+		if (!*ref) {
+			format = ref;
+			break;
+		}
+
+		end = cdr_template_reference_end(ref);
+		if (!end) {
+			break;
+		}
+		inner = ast_alloca(end - ref - 1);
+		ast_copy_string(inner, ref + 2, end - ref - 1);
+		if (cdr_template_add_reference(tpl, inner)) {
+			break;
+		}
+		format = end + 1;
+	}
+
+	if (*format) {
+		ast_cdr_template_free(tpl);
+		return NULL;
+	}
+
+	return tpl;
+}
+
+/*!
+ * \internal
+ * \brief Get the value of a field the same way CDR() does on a dummy channel
+ */
+static const char *cdr_template_value(const struct cdr_template_part *part, struct ast_cdr *cdr,
+	char *workspace, int workspacelen)
+{
+	char *value = NULL;
+
+	if (part->fraction
+		&& (!strcasecmp(part->text, "billsec") || !strcasecmp(part->text, "duration"))) {
+		struct timeval start = !strcasecmp(part->text, "billsec") ? cdr->answer : cdr->start;
+		struct timeval finish = ast_tvzero(cdr->end) ? ast_tvnow() : cdr->end;
+
+		snprintf(workspace, workspacelen, "%lf",
+			ast_tvzero(start) ? 0.0 : (double)(ast_tvdiff_us(finish, start) / 1000000.0));
+		return workspace;
+	}
+
+	ast_cdr_format_var(cdr, part->text, &value, workspace, workspacelen, part->raw);
+
+	return S_OR(value, "");
+}
+
+void ast_cdr_template_apply(const struct ast_cdr_template *tpl, struct ast_cdr *cdr, struct ast_str **buf)
+{
+	char workspace[512];
+	size_t i;
+
+	ast_str_reset(*buf);
+
+	for (i = 0; i < AST_VECTOR_SIZE(&tpl->parts); ++i) {
+		const struct cdr_template_part *part = AST_VECTOR_GET(&tpl->parts, i);
+		const char *value;
+
+		if (!part->field) {
+			ast_str_append(buf, 0, "%s", part->text);
+			continue;
+		}
+
+		value = cdr_template_value(part, cdr, workspace, sizeof(workspace));
+		if (!part->csv_quote) {
+			ast_str_append(buf, 0, "%s", value);
+			continue;
+		}
+
+		ast_str_append(buf, 0, "\"");
+		while (*value) {
+			size_t len = strcspn(value, "\"");
+
+			ast_str_append(buf, 0, "%.*s", (int) len, value);
+			value += len;
+			if (*value) {
+				ast_str_append(buf, 0, "\"\"");
+				++value;
+			}
+		}
+		ast_str_append(buf, 0, "\"");
+	}
+}
+
 /*!
  * \internal
  * \brief Callback that finds all CDRs that reference a particular channel by name
@@ -3505,10 +4113,52 @@ void ast_cdr_setuserfield(const char *channel_name, const char *userfield)
 	ao2_cleanup(cdr);
 }
 
+/*!
+ * \internal
+ * \brief Run the modifiers on a record about to be posted
+ *
+ * \retval 1 if the record is to be posted to the backends
+ * \retval 0 if it is to be skipped
+ */
+static int post_cdr_prepare(struct module_config *mod_cfg, struct ast_cdr *cdr)
+{
+	struct cdr_beitem *i;
+
+	/* For people, who don't want to see unanswered single-channel events */
+	if (!ast_test_flag(&mod_cfg->general->settings, CDR_UNANSWERED) &&
+			cdr->disposition < AST_CDR_ANSWERED &&
+			(ast_strlen_zero(cdr->channel) || ast_strlen_zero(cdr->dstchannel))) {
+		ast_debug(1, "Skipping CDR for %s since we weren't answered\n", cdr->channel);
+		return 0;
+	}
+
+	/* Modify CDR's */
+	AST_RWLIST_RDLOCK(&mo_list);
+	AST_RWLIST_TRAVERSE(&mo_list, i, list) {
+		i->be(cdr);
+	}
+	AST_RWLIST_UNLOCK(&mo_list);
+
+	return !ast_test_flag(cdr, AST_CDR_FLAG_DISABLE);
+}
+
+/*! \brief Hand one record to each of the backends */
+static void post_cdr_backends(struct ast_cdr *cdr)
+{
+	struct cdr_beitem *i;
+
+	AST_RWLIST_RDLOCK(&be_list);
+	AST_RWLIST_TRAVERSE(&be_list, i, list) {
+		if (!i->suspended) {
+			i->be(cdr);
+		}
+	}
+	AST_RWLIST_UNLOCK(&be_list);
+}
+
 static void post_cdr(struct ast_cdr *cdr)
 {
 	struct module_config *mod_cfg;
-	struct cdr_beitem *i;
 
 	mod_cfg = ao2_global_obj_ref(module_configs);
 	if (!mod_cfg) {
@@ -3516,31 +4166,9 @@ static void post_cdr(struct ast_cdr *cdr)
 	}
 
 	for (; cdr ; cdr = cdr->next) {
-		/* For people, who don't want to see unanswered single-channel events */
-		if (!ast_test_flag(&mod_cfg->general->settings, CDR_UNANSWERED) &&
-				cdr->disposition < AST_CDR_ANSWERED &&
-				(ast_strlen_zero(cdr->channel) || ast_strlen_zero(cdr->dstchannel))) {
-			ast_debug(1, "Skipping CDR for %s since we weren't answered\n", cdr->channel);
-			continue;
+		if (post_cdr_prepare(mod_cfg, cdr)) {
+			post_cdr_backends(cdr);
 		}
-
-		/* Modify CDR's */
-		AST_RWLIST_RDLOCK(&mo_list);
-		AST_RWLIST_TRAVERSE(&mo_list, i, list) {
-			i->be(cdr);
-		}
-		AST_RWLIST_UNLOCK(&mo_list);
-
-		if (ast_test_flag(cdr, AST_CDR_FLAG_DISABLE)) {
-			continue;
-		}
-		AST_RWLIST_RDLOCK(&be_list);
-		AST_RWLIST_TRAVERSE(&be_list, i, list) {
-			if (!i->suspended) {
-				i->be(cdr);
-			}
-		}
-		AST_RWLIST_UNLOCK(&be_list);
 	}
 	ao2_cleanup(mod_cfg);
 }
@@ -3746,14 +4374,73 @@ static int init_batch(void)
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Post all of the records of a batch
+ *
+ * Backends that log batches get all of the records at once, the others get
+ * them one at a time like post_cdr() gives them.
+ */
+static void post_cdr_batch(struct cdr_batch_item *batchitem)
+{
+	AST_VECTOR(, struct ast_cdr *) cdrs;
+	struct module_config *mod_cfg;
+	struct cdr_beitem *i;
+	struct ast_cdr *cdr;
+	size_t idx;
+
+	mod_cfg = ao2_global_obj_ref(module_configs);
+	if (!mod_cfg) {
+		return;
+	}
+
+	if (AST_VECTOR_INIT(&cdrs, mod_cfg->general->batch_settings.size)) {
+		ao2_cleanup(mod_cfg);
+		for (; batchitem; batchitem = batchitem->next) {
+			post_cdr(batchitem->cdr);
+		}
+		return;
+	}
+
+	for (; batchitem; batchitem = batchitem->next) {
+		for (cdr = batchitem->cdr; cdr; cdr = cdr->next) {
+			if (post_cdr_prepare(mod_cfg, cdr) && AST_VECTOR_APPEND(&cdrs, cdr)) {
+				/* Out of memory, so this one goes to the backends on its own */
+				post_cdr_backends(cdr);
+			}
+		}
+	}
+	ao2_cleanup(mod_cfg);
+
+	if (AST_VECTOR_SIZE(&cdrs)) {
+		AST_RWLIST_RDLOCK(&be_list);
+		AST_RWLIST_TRAVERSE(&be_list, i, list) {
+			if (i->suspended) {
+				continue;
+			}
+			if (i->batch_be && !i->batch_be(AST_VECTOR_GET_ADDR(&cdrs, 0), AST_VECTOR_SIZE(&cdrs))) {
+				continue;
+			}
+			for (idx = 0; idx < AST_VECTOR_SIZE(&cdrs); ++idx) {
+				i->be(AST_VECTOR_GET(&cdrs, idx));
+			}
+		}
+		AST_RWLIST_UNLOCK(&be_list);
+	}
+
+	AST_VECTOR_FREE(&cdrs);
+}
+
 static void *do_batch_backend_process(void *data)
 {
 	struct cdr_batch_item *processeditem;
 	struct cdr_batch_item *batchitem = data;
 
-	/* Push each CDR into storage mechanism(s) and free all the memory */
+	/* Push each CDR into storage mechanism(s) */
+	post_cdr_batch(batchitem);
+
+	/* Free all the memory */
 	while (batchitem) {
-		post_cdr(batchitem->cdr);
 		ast_cdr_free(batchitem->cdr);
 		processeditem = batchitem;
 		batchitem = batchitem->next;
@@ -4174,6 +4861,7 @@ static char *handle_cli_status(struct ast_cli_entry *e, int cmd, struct ast_cli_
 	ast_cli(a->fd, "----------------------------------\n");
 	ast_cli(a->fd, "  Logging:                    %s\n", ast_test_flag(&mod_cfg->general->settings, CDR_ENABLED) ? "Enabled" : "Disabled");
 	ast_cli(a->fd, "  Mode:                       %s\n", ast_test_flag(&mod_cfg->general->settings, CDR_BATCHMODE) ? "Batch" : "Simple");
+	ast_cli(a->fd, "  Shards:                     %u\n", cdr_shard_count);
 	if (ast_test_flag(&mod_cfg->general->settings, CDR_ENABLED)) {
 		ast_cli(a->fd, "  Log unanswered calls:       %s\n", ast_test_flag(&mod_cfg->general->settings, CDR_UNANSWERED) ? "Yes" : "No");
 		ast_cli(a->fd, "  Log congestion:             %s\n\n", ast_test_flag(&mod_cfg->general->settings, CDR_CONGESTION) ? "Yes" : "No");
@@ -4355,6 +5043,7 @@ static int process_config(int reload)
 		aco_option_register(&cfg_info, "safeshutdown", ACO_EXACT, general_options, DEFAULT_BATCH_SAFE_SHUTDOWN, OPT_BOOLFLAG_T, 1, FLDSET(struct ast_cdr_config, batch_settings.settings), BATCH_MODE_SAFE_SHUTDOWN);
 		aco_option_register(&cfg_info, "size", ACO_EXACT, general_options, DEFAULT_BATCH_SIZE, OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct ast_cdr_config, batch_settings.size), 0, MAX_BATCH_SIZE);
 		aco_option_register(&cfg_info, "time", ACO_EXACT, general_options, DEFAULT_BATCH_TIME, OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct ast_cdr_config, batch_settings.time), 1, MAX_BATCH_TIME);
+		aco_option_register(&cfg_info, "shards", ACO_EXACT, general_options, DEFAULT_SHARDS, OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct ast_cdr_config, shards), 0, MAX_SHARDS);
 	}
 
 	if (aco_process_config(&cfg_info, reload) == ACO_PROCESS_ERROR) {
@@ -4386,6 +5075,7 @@ static void cdr_engine_shutdown(void)
 {
 	stasis_message_router_unsubscribe_and_join(stasis_router);
 	stasis_router = NULL;
+	cdr_shards_destroy();
 
 	ao2_cleanup(cdr_topic);
 	cdr_topic = NULL;
@@ -4521,10 +5211,21 @@ static int unload_module(void)
 
 static int load_module(void)
 {
+	struct module_config *mod_cfg;
+	int res;
+
 	if (process_config(0)) {
 		return AST_MODULE_LOAD_FAILURE;
 	}
 
+	mod_cfg = ao2_global_obj_ref(module_configs);
+	res = !mod_cfg || cdr_shards_create(mod_cfg->general->shards);
+	ao2_cleanup(mod_cfg);
+	if (res) {
+		cdr_shards_destroy();
+		return AST_MODULE_LOAD_FAILURE;
+	}
+
 	cdr_topic = stasis_topic_create("cdr:aggregator");
 	if (!cdr_topic) {
 		return AST_MODULE_LOAD_FAILURE;
@@ -4536,13 +5237,14 @@ static int load_module(void)
 	}
 	stasis_message_router_set_congestion_limits(stasis_router, -1,
 		10 * AST_TASKPROCESSOR_HIGH_WATER_LEVEL);
+	stasis_message_router_set_batch_size(stasis_router, 32);
 
 	if (STASIS_MESSAGE_TYPE_INIT(cdr_sync_message_type)) {
 		return AST_MODULE_LOAD_FAILURE;
 	}
 
-	stasis_message_router_add(stasis_router, ast_channel_snapshot_type(), handle_channel_snapshot_update_message, NULL);
-	stasis_message_router_add(stasis_router, ast_channel_dial_type(), handle_dial_message, NULL);
+	stasis_message_router_add(stasis_router, ast_channel_snapshot_type(), route_channel_snapshot_update_message, NULL);
+	stasis_message_router_add(stasis_router, ast_channel_dial_type(), route_dial_message, NULL);
 	stasis_message_router_add(stasis_router, ast_channel_entered_bridge_type(), handle_bridge_enter_message, NULL);
 	stasis_message_router_add(stasis_router, ast_channel_left_bridge_type(), handle_bridge_leave_message, NULL);
 	stasis_message_router_add(stasis_router, ast_parked_call_type(), handle_parked_call_message, NULL);
@@ -4627,6 +5329,9 @@ static int reload_module(void)
 	}
 
 	mod_cfg = ao2_global_obj_ref(module_configs);
+	if (mod_cfg && mod_cfg->general->shards != cdr_shard_count) {
+		ast_log(LOG_NOTICE, "CDR shards stay at %u until Asterisk is restarted\n", cdr_shard_count);
+	}
 	if (!mod_cfg
 		|| !ast_test_flag(&mod_cfg->general->settings, CDR_ENABLED)
 		|| !ast_test_flag(&mod_cfg->general->settings, CDR_BATCHMODE)) {
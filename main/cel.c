@@ -58,6 +58,7 @@
 #include "asterisk/pickup.h"
 #include "asterisk/core_local.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/vector.h"
 
 /*** DOCUMENTATION
 	<configInfo name="cel" language="en_US">
@@ -105,6 +106,30 @@
 					</enumlist>
 					</description>
 				</configOption>
+				<configOption name="queue_size" default="0">
+					<synopsis>Number of events that may wait for each backend</synopsis>
+					<description><para>When set above zero, each backend is given its
+					events from a thread of its own, so a slow backend does not hold up
+					the handling of events, or the other backends. Up to this many events
+					may wait for a backend before <literal>overflow</literal> decides what
+					happens to the next one. When zero, events are handed to the backends
+					one after another as they happen.</para>
+					</description>
+				</configOption>
+				<configOption name="overflow" default="block">
+					<synopsis>What happens to an event for a backend whose queue is full</synopsis>
+					<description>
+					<enumlist>
+						<enum name="block">
+							<para>Wait for the backend to make room for the event.</para>
+						</enum>
+						<enum name="drop">
+							<para>Discard the event. Discarded events are counted in
+							<literal>cel show status</literal>.</para>
+						</enum>
+					</enumlist>
+					</description>
+				</configOption>
 			</configObject>
 		</configFile>
 	</configInfo>
@@ -323,9 +348,19 @@ static const char * const cel_event_types[CEL_MAX_EVENT_IDS] = {
 	[AST_CEL_LOCAL_OPTIMIZE]   = "LOCAL_OPTIMIZE",
 };
 
+AST_VECTOR(cel_events, struct ast_event *);
+
 struct cel_backend {
-	ast_cel_backend_cb callback; /*!< Callback for this backend */
-	char name[0];                /*!< Name of this backend */
+	ast_cel_backend_cb callback;     /*!< Callback for this backend */
+	struct ast_taskprocessor *tps;   /*!< Hands queued events to the backend, created when first needed */
+	struct cel_events queue;         /*!< Events waiting for the taskprocessor */
+	ast_cond_t cond;                 /*!< Signalled when events have been handed over */
+	size_t delivering;               /*!< Events taken off the queue but not yet handed over */
+	unsigned int dropped;            /*!< Events discarded because the queue was full */
+	unsigned int scheduled:1;        /*!< The taskprocessor has been given the queue */
+	unsigned int unregistered:1;     /*!< No more events are accepted */
+	unsigned int overflowing:1;      /*!< The queue was full when last checked */
+	char name[0];                    /*!< Name of this backend */
 };
 
 /*! \brief Hashing function for cel_backend */
@@ -400,12 +435,31 @@ static char *handle_cli_status(struct ast_cli_entry *e, int cmd, struct ast_cli_
 	}
 	ao2_iterator_destroy(&iter);
 
+	if (cfg->general->queue_size) {
+		ast_cli(a->fd, "CEL Backend Queue Size: %u\n", cfg->general->queue_size);
+		ast_cli(a->fd, "CEL Backend Queue Overflow: %s\n",
+			cfg->general->overflow == AST_CEL_OVERFLOW_DROP ? "drop" : "block");
+	}
+
 	if (backends) {
 		struct cel_backend *backend;
 
 		iter = ao2_iterator_init(backends, 0);
 		for (; (backend = ao2_iterator_next(&iter)); ao2_ref(backend, -1)) {
-			ast_cli(a->fd, "CEL Event Subscriber: %s\n", backend->name);
+			size_t queued;
+			unsigned int dropped;
+
+			ao2_lock(backend);
+			queued = AST_VECTOR_SIZE(&backend->queue) + backend->delivering;
+			dropped = backend->dropped;
+			ao2_unlock(backend);
+
+			if (cfg->general->queue_size || queued || dropped) {
+				ast_cli(a->fd, "CEL Event Subscriber: %s (queued: %zu, dropped: %u)\n",
+					backend->name, queued, dropped);
+			} else {
+				ast_cli(a->fd, "CEL Event Subscriber: %s\n", backend->name);
+			}
 		}
 		ao2_iterator_destroy(&iter);
 	}
@@ -493,6 +547,22 @@ const char *ast_cel_get_type_name(enum ast_cel_event_type type)
 	return S_OR(cel_event_types[type], "Unknown");
 }
 
+static int overflow_handler(const struct aco_option *opt, struct ast_variable *var, void *obj)
+{
+	struct ast_cel_general_config *cfg = obj;
+
+	if (!strcasecmp(var->value, "block")) {
+		cfg->overflow = AST_CEL_OVERFLOW_BLOCK;
+	} else if (!strcasecmp(var->value, "drop")) {
+		cfg->overflow = AST_CEL_OVERFLOW_DROP;
+	} else {
+		ast_log(LOG_ERROR, "Unknown CEL overflow policy '%s'\n", var->value);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int cel_track_app(const char *const_app)
 {
 	RAII_VAR(struct cel_config *, cfg, ao2_global_obj_ref(cel_configs), ao2_cleanup);
@@ -558,11 +628,167 @@ struct ast_event *ast_cel_create_event_with_time(struct ast_channel_snapshot *sn
 		AST_EVENT_IE_END);
 }
 
+/*! \brief An event on its way to the backends */
+struct cel_dispatch {
+	/*! The event */
+	struct ast_event *event;
+	/*! The configuration it was created under */
+	struct ast_cel_general_config *cfg;
+};
+
+/*!
+ * \internal
+ * \brief Hand the queued events of a backend over to it
+ *
+ * Runs on the taskprocessor of the backend, taking everything queued in
+ * one go so the router thread only has to push a task when the queue
+ * was empty.
+ */
+static int cel_backend_deliver(void *data)
+{
+	struct cel_backend *backend = data;
+	struct cel_events events;
+	size_t i;
+
+	ao2_lock(backend);
+	while (AST_VECTOR_SIZE(&backend->queue)) {
+		events = backend->queue;
+		AST_VECTOR_INIT(&backend->queue, 0);
+		backend->delivering = AST_VECTOR_SIZE(&events);
+		ao2_unlock(backend);
+
+		for (i = 0; i < AST_VECTOR_SIZE(&events); ++i) {
+			backend->callback(AST_VECTOR_GET(&events, i));
+
+			ao2_lock(backend);
+			--backend->delivering;
+			ast_cond_broadcast(&backend->cond);
+			ao2_unlock(backend);
+		}
+		AST_VECTOR_RESET(&events, ast_event_destroy);
+		AST_VECTOR_FREE(&events);
+
+		ao2_lock(backend);
+	}
+	backend->scheduled = 0;
+	ast_cond_broadcast(&backend->cond);
+	ao2_unlock(backend);
+
+	ao2_ref(backend, -1);
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Queue an event for a backend
+ *
+ * \pre backend is locked
+ */
+static void cel_backend_queue(struct cel_backend *backend, struct ast_cel_general_config *cfg,
+	const struct ast_event *event)
+{
+	struct ast_event *copy;
+	size_t size;
+
+	while (cfg->queue_size
+		&& AST_VECTOR_SIZE(&backend->queue) + backend->delivering >= cfg->queue_size) {
+		if (cfg->overflow == AST_CEL_OVERFLOW_DROP || backend->unregistered) {
+			if (!backend->overflowing) {
+				ast_log(LOG_WARNING, "CEL backend '%s' has %u events queued, discarding events until it catches up\n",
+					backend->name, cfg->queue_size);
+				backend->overflowing = 1;
+			}
+			++backend->dropped;
+			return;
+		}
+		ast_cond_wait(&backend->cond, ao2_object_get_lockaddr(backend));
+	}
+	backend->overflowing = 0;
+
+	if (backend->unregistered) {
+		return;
+	}
+
+	size = ast_event_get_size(event);
+	copy = ast_malloc(size);
+	if (!copy) {
+		++backend->dropped;
+		return;
+	}
+	memcpy(copy, event, size);
+
+	if (AST_VECTOR_APPEND(&backend->queue, copy)) {
+		ast_event_destroy(copy);
+		++backend->dropped;
+		return;
+	}
+
+	if (backend->scheduled) {
+		return;
+	}
+
+	if (!backend->tps) {
+		char tps_name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+		snprintf(tps_name, sizeof(tps_name), "cel:backend-%s", backend->name);
+		backend->tps = ast_taskprocessor_get(tps_name, TPS_REF_DEFAULT);
+		if (!backend->tps) {
+			ast_log(LOG_ERROR, "Unable to create a taskprocessor for CEL backend '%s'\n",
+				backend->name);
+			return;
+		}
+	}
+
+	if (ast_taskprocessor_push(backend->tps, cel_backend_deliver, ao2_bump(backend))) {
+		ao2_ref(backend, -1);
+		return;
+	}
+	backend->scheduled = 1;
+}
+
 static int cel_backend_send_cb(void *obj, void *arg, int flags)
 {
 	struct cel_backend *backend = obj;
+	struct cel_dispatch *dispatch = arg;
+
+	ao2_lock(backend);
+	/* Anything still queued has to go first, even if queueing has been turned off */
+	if (dispatch->cfg->queue_size || AST_VECTOR_SIZE(&backend->queue)
+		|| backend->delivering || backend->scheduled) {
+		cel_backend_queue(backend, dispatch->cfg, dispatch->event);
+		ao2_unlock(backend);
+		return 0;
+	}
+	ao2_unlock(backend);
+
+	backend->callback(dispatch->event);
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Stop taking events for a backend and wait for the queued ones to be handed over
+ */
+static void cel_backend_shutdown(struct cel_backend *backend)
+{
+	struct ast_taskprocessor *tps;
+
+	ao2_lock(backend);
+	backend->unregistered = 1;
+	ast_cond_broadcast(&backend->cond);
+	while (backend->scheduled) {
+		ast_cond_wait(&backend->cond, ao2_object_get_lockaddr(backend));
+	}
+	tps = backend->tps;
+	backend->tps = NULL;
+	ao2_unlock(backend);
 
-	backend->callback(arg);
+	ast_taskprocessor_unreference(tps);
+}
+
+static int cel_backend_shutdown_cb(void *obj, void *arg, int flags)
+{
+	cel_backend_shutdown(obj);
 	return 0;
 }
 
@@ -571,7 +797,7 @@ static int cel_report_event(struct ast_channel_snapshot *snapshot,
 		const char *userdefevname, struct ast_json *extra,
 		const char *peer_str)
 {
-	struct ast_event *ev;
+	struct cel_dispatch dispatch;
 	RAII_VAR(struct cel_config *, cfg, ao2_global_obj_ref(cel_configs), ao2_cleanup);
 	RAII_VAR(struct ao2_container *, backends, ao2_global_obj_ref(cel_backends), ao2_cleanup);
 
@@ -597,14 +823,15 @@ static int cel_report_event(struct ast_channel_snapshot *snapshot,
 		return 0;
 	}
 
-	ev = ast_cel_create_event_with_time(snapshot, event_type, event_time, userdefevname, extra, peer_str);
-	if (!ev) {
+	dispatch.event = ast_cel_create_event_with_time(snapshot, event_type, event_time, userdefevname, extra, peer_str);
+	if (!dispatch.event) {
 		return -1;
 	}
+	dispatch.cfg = cfg->general;
 
 	/* Distribute event to backends */
-	ao2_callback(backends, OBJ_MULTIPLE | OBJ_NODATA, cel_backend_send_cb, ev);
-	ast_event_destroy(ev);
+	ao2_callback(backends, OBJ_MULTIPLE | OBJ_NODATA, cel_backend_send_cb, &dispatch);
+	ast_event_destroy(dispatch.event);
 
 	return 0;
 }
@@ -778,6 +1005,336 @@ struct ast_channel *ast_cel_fabricate_channel_from_event(const struct ast_event
 	return tchan;
 }
 
+/*! \brief Where the value of a compiled CEL template field comes from */
+enum cel_template_source {
+	/*! Literal text */
+	CEL_TEMPLATE_LITERAL = 0,
+	/*! A string in the event record */
+	CEL_TEMPLATE_STRING,
+	/*! The eventtype variable */
+	CEL_TEMPLATE_EVENTTYPE,
+	/*! The eventtime variable */
+	CEL_TEMPLATE_EVENTTIME,
+	/*! CHANNEL(amaflags) */
+	CEL_TEMPLATE_AMAFLAGS,
+	/*! CHANNEL(linkedid) */
+	CEL_TEMPLATE_LINKEDID,
+};
+
+/*! \brief A reference a CEL template can be compiled with */
+static const struct cel_template_field {
+	/*! The dialplan function, or NULL for a variable */
+	const char *function;
+	/*! The argument of the function, or the name of the variable */
+	const char *name;
+	/*! Where the value comes from */
+	enum cel_template_source source;
+	/*! For CEL_TEMPLATE_STRING, where the string is in the record */
+	size_t offset;
+} cel_template_fields[] = {
+	/* The variables set by ast_cel_fabricate_channel_from_event() */
+	{ NULL, "eventtype", CEL_TEMPLATE_EVENTTYPE, },
+	{ NULL, "eventtime", CEL_TEMPLATE_EVENTTIME, },
+	{ NULL, "eventenum", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, event_name) },
+	{ NULL, "userdeftype", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, user_defined_name) },
+	{ NULL, "eventextra", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, extra) },
+	{ NULL, "BRIDGEPEER", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, peer) },
+	/* And the parts of the channel it fills in */
+	{ "CALLERID", "name", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_name) },
+	{ "CALLERID", "num", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_num) },
+	{ "CALLERID", "number", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_num) },
+	{ "CALLERID", "ani", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_ani) },
+	{ "CALLERID", "rdnis", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_rdnis) },
+	{ "CALLERID", "dnid", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, caller_id_dnid) },
+	{ "CHANNEL", "exten", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, extension) },
+	{ "CHANNEL", "context", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, context) },
+	{ "CHANNEL", "channame", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, channel_name) },
+	{ "CHANNEL", "appname", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, application_name) },
+	{ "CHANNEL", "appdata", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, application_data) },
+	{ "CHANNEL", "amaflags", CEL_TEMPLATE_AMAFLAGS, },
+	{ "CHANNEL", "accountcode", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, account_code) },
+	{ "CHANNEL", "peeraccount", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, peer_account) },
+	{ "CHANNEL", "uniqueid", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, unique_id) },
+	{ "CHANNEL", "linkedid", CEL_TEMPLATE_LINKEDID, },
+	{ "CHANNEL", "userfield", CEL_TEMPLATE_STRING, offsetof(struct ast_cel_event_record, user_field) },
+};
+
+/*! \brief One piece of a compiled CEL template */
+struct cel_template_part {
+	/*! The field, or NULL for literal text */
+	const struct cel_template_field *field;
+	/*! Quote the value as CSV_QUOTE() would */
+	int csv_quote;
+	/*! Literal text */
+	char text[0];
+};
+
+struct ast_cel_template {
+	AST_VECTOR(, struct cel_template_part *) parts;
+};
+
+void ast_cel_template_free(struct ast_cel_template *tpl)
+{
+	if (!tpl) {
+		return;
+	}
+
+	AST_VECTOR_RESET(&tpl->parts, ast_free);
+	AST_VECTOR_FREE(&tpl->parts);
+	ast_free(tpl);
+}
+
+static struct cel_template_part *cel_template_part_add(struct ast_cel_template *tpl,
+	const char *text, size_t len)
+{
+	struct cel_template_part *part;
+
+	part = ast_calloc(1, sizeof(*part) + len + 1);
+	if (!part) {
+		return NULL;
+	}
+	memcpy(part->text, text, len);
+
+	if (AST_VECTOR_APPEND(&tpl->parts, part)) {
+		ast_free(part);
+		return NULL;
+	}
+
+	return part;
+}
+
+/*!
+ * \internal
+ * \brief Find the end of the ${ reference starting at ref
+ *
+ * \return The closing brace, or NULL if there is none
+ */
+static const char *cel_template_reference_end(const char *ref)
+{
+	int depth = 0;
+
+	for (; *ref; ++ref) {
+		if (ref[0] == '$' && ref[1] == '{') {
+			++depth;
+			++ref;
+		} else if (*ref == '}' && !--depth) {
+			return ref;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Compile what is between the braces of a ${ reference
+ *
+ * \retval 0 if it is one of \ref cel_template_fields, possibly within CSV_QUOTE()
+ * \retval -1 otherwise
+ */
+static int cel_template_add_reference(struct ast_cel_template *tpl, char *ref)
+{
+	struct cel_template_part *part;
+	const char *function = NULL;
+	int csv_quote = 0;
+	size_t len = strlen(ref);
+	char *arg;
+	int i;
+
+	if (ast_begins_with(ref, "CSV_QUOTE(${") && len > 14 && !strcmp(ref + len - 2, "})")) {
+		ref += 12;
+		len -= 14;
+		ref[len] = '\0';
+		csv_quote = 1;
+	}
+
+	arg = strchr(ref, '(');
+	if (arg) {
+		if (ref[len - 1] != ')') {
+			return -1;
+		}
+		ref[len - 1] = '\0';
+		*arg++ = '\0';
+		function = ref;
+		ref = arg;
+	}
+
+	/* Arguments built from other references, or with spaces to strip, are left to the dialplan */
+	if (strpbrk(ref, "${}()[],: \t\\")) {
+		return -1;
+	}
+
+	for (i = 0; i < ARRAY_LEN(cel_template_fields); ++i) {
+		const struct cel_template_field *field = &cel_template_fields[i];
+
+		if (!function && !field->function && !strcmp(ref, field->name)) {
+			break;
+		}
+		if (function && field->function && !strcmp(function, field->function)
+			&& !strcasecmp(ref, field->name)) {
+			break;
+		}
+	}
+	if (i == ARRAY_LEN(cel_template_fields)) {
+		return -1;
+	}
+
+	part = cel_template_part_add(tpl, "", 0);
+	if (!part) {
+		return -1;
+	}
+	part->field = &cel_template_fields[i];
+	part->csv_quote = csv_quote;
+
+	return 0;
+}
+
+struct ast_cel_template *ast_cel_template_compile(const char *format)
+{
+	struct ast_cel_template *tpl;
+
+	/* Expressions are left to the dialplan */
+	if (strstr(format, "$[")) {
+		return NULL;
+	}
+
+	tpl = ast_calloc(1, sizeof(*tpl));
+	if (!tpl || AST_VECTOR_INIT(&tpl->parts, 8)) {
+		ast_free(tpl);
+		return NULL;
+	}
+
+	while (*format) {
+		const char *ref = strstr(format, "${");
+		const char *end;
+		char *inner;
+
+		if (!ref) {
+			ref = format + strlen(format);
+		}
+		if (ref != format && !cel_template_part_add(tpl, format, ref - format)) {
+			break;
+		}
+		if (!*ref) {
+			format = ref;
+			break;
+		}
+
+		end = cel_template_reference_end(ref);
+		if (!end) {
+			break;
+		}
+		inner = ast_alloca(end - ref - 1);
+		ast_copy_string(inner, ref + 2, end - ref - 1);
+		if (cel_template_add_reference(tpl, inner)) {
+			break;
+		}
+		format = end + 1;
+	}
+
+	if (*format) {
+		ast_cel_template_free(tpl);
+		return NULL;
+	}
+
+	return tpl;
+}
+
+/*!
+ * \internal
+ * \brief Get the value of a field as it would be read from a fabricated channel
+ */
+static const char *cel_template_value(const struct cel_template_field *field,
+	const struct ast_cel_event_record *record, const char *date_format,
+	char *workspace, size_t workspacelen)
+{
+	const char *value;
+
+	switch (field->source) {
+	case CEL_TEMPLATE_STRING:
+		value = *(const char * const *) ((const char *) record + field->offset);
+		break;
+	case CEL_TEMPLATE_EVENTTYPE:
+		value = (record->event_type == AST_CEL_USER_DEFINED)
+			? record->user_defined_name : record->event_name;
+		break;
+	case CEL_TEMPLATE_EVENTTIME:
+		if (ast_strlen_zero(date_format)) {
+			snprintf(workspace, workspacelen, "%ld.%06ld", (long) record->event_time.tv_sec,
+				(long) record->event_time.tv_usec);
+		} else {
+			struct ast_tm tm;
+
+			ast_localtime(&record->event_time, &tm, NULL);
+			ast_strftime(workspace, workspacelen, date_format, &tm);
+		}
+		value = workspace;
+		break;
+	case CEL_TEMPLATE_AMAFLAGS:
+		snprintf(workspace, workspacelen, "%u", record->amaflag);
+		value = workspace;
+		break;
+	case CEL_TEMPLATE_LINKEDID:
+		/* CHANNEL() falls back on the uniqueid if the linkedid is unset */
+		value = S_OR(record->linked_id, record->unique_id);
+		break;
+	default:
+		value = NULL;
+		break;
+	}
+
+	return S_OR(value, "");
+}
+
+int ast_cel_template_apply(const struct ast_cel_template *tpl, const struct ast_event *event, struct ast_str **buf)
+{
+	struct ast_cel_event_record record = {
+		.version = AST_CEL_EVENT_RECORD_VERSION,
+	};
+	RAII_VAR(struct cel_config *, cfg, ao2_global_obj_ref(cel_configs), ao2_cleanup);
+	/* Same size as the buffer ast_cel_fabricate_channel_from_event() formats times in */
+	char workspace[30];
+	size_t i;
+
+	if (!cfg || !cfg->general || ast_cel_fill_record(event, &record)) {
+		return -1;
+	}
+
+	ast_str_reset(*buf);
+
+	for (i = 0; i < AST_VECTOR_SIZE(&tpl->parts); ++i) {
+		const struct cel_template_part *part = AST_VECTOR_GET(&tpl->parts, i);
+		const char *value;
+
+		if (!part->field) {
+			ast_str_append(buf, 0, "%s", part->text);
+			continue;
+		}
+
+		value = cel_template_value(part->field, &record, cfg->general->date_format,
+			workspace, sizeof(workspace));
+		if (!part->csv_quote) {
+			ast_str_append(buf, 0, "%s", value);
+			continue;
+		}
+
+		ast_str_append(buf, 0, "\"");
+		while (*value) {
+			size_t len = strcspn(value, "\"");
+
+			ast_str_append(buf, 0, "%.*s", (int) len, value);
+			value += len;
+			if (*value) {
+				ast_str_append(buf, 0, "\"\"");
+				++value;
+			}
+		}
+		ast_str_append(buf, 0, "\"");
+	}
+
+	return 0;
+}
+
 static int cel_linkedid_ref(const char *linkedid)
 {
 	RAII_VAR(struct ao2_container *, linkedids, ao2_global_obj_ref(cel_linkedids), ao2_cleanup);
@@ -1434,6 +1991,8 @@ static void destroy_subscriptions(void)
 
 static int unload_module(void)
 {
+	struct ao2_container *backends;
+
 	destroy_routes();
 	destroy_subscriptions();
 	STASIS_MESSAGE_TYPE_CLEANUP(cel_generic_type);
@@ -1443,6 +2002,12 @@ static int unload_module(void)
 	ao2_global_obj_release(cel_configs);
 	ao2_global_obj_release(cel_dialstatus_store);
 	ao2_global_obj_release(cel_linkedids);
+
+	backends = ao2_global_obj_ref(cel_backends);
+	if (backends) {
+		ao2_callback(backends, OBJ_MULTIPLE | OBJ_NODATA, cel_backend_shutdown_cb, NULL);
+		ao2_ref(backends, -1);
+	}
 	ao2_global_obj_release(cel_backends);
 
 	return 0;
@@ -1507,6 +2072,7 @@ static int create_routes(void)
 	}
 	stasis_message_router_set_congestion_limits(cel_state_router, -1,
 		6 * AST_TASKPROCESSOR_HIGH_WATER_LEVEL);
+	stasis_message_router_set_batch_size(cel_state_router, 32);
 
 	ret |= stasis_message_router_add(cel_state_router,
 		ast_channel_snapshot_type(),
@@ -1612,6 +2178,8 @@ static int load_module(void)
 	aco_option_register(&cel_cfg_info, "dateformat", ACO_EXACT, general_options, "", OPT_STRINGFIELD_T, 0, STRFLDSET(struct ast_cel_general_config, date_format));
 	aco_option_register_custom(&cel_cfg_info, "apps", ACO_EXACT, general_options, "", apps_handler, 0);
 	aco_option_register_custom(&cel_cfg_info, "events", ACO_EXACT, general_options, "", events_handler, 0);
+	aco_option_register(&cel_cfg_info, "queue_size", ACO_EXACT, general_options, "0", OPT_UINT_T, 0, FLDSET(struct ast_cel_general_config, queue_size));
+	aco_option_register_custom(&cel_cfg_info, "overflow", ACO_EXACT, general_options, "block", overflow_handler, 0);
 
 	if (aco_process_config(&cel_cfg_info, 0)) {
 		struct cel_config *cel_cfg = cel_config_alloc();
@@ -1730,13 +2298,29 @@ int ast_cel_backend_unregister(const char *name)
 	struct ao2_container *backends = ao2_global_obj_ref(cel_backends);
 
 	if (backends) {
-		ao2_find(backends, name, OBJ_SEARCH_KEY | OBJ_NODATA | OBJ_UNLINK);
+		struct cel_backend *backend;
+
+		backend = ao2_find(backends, name, OBJ_SEARCH_KEY | OBJ_UNLINK);
+		if (backend) {
+			cel_backend_shutdown(backend);
+			ao2_ref(backend, -1);
+		}
 		ao2_ref(backends, -1);
 	}
 
 	return 0;
 }
 
+static void cel_backend_dtor(void *obj)
+{
+	struct cel_backend *backend = obj;
+
+	ast_taskprocessor_unreference(backend->tps);
+	AST_VECTOR_RESET(&backend->queue, ast_event_destroy);
+	AST_VECTOR_FREE(&backend->queue);
+	ast_cond_destroy(&backend->cond);
+}
+
 int ast_cel_backend_register(const char *name, ast_cel_backend_cb backend_callback)
 {
 	RAII_VAR(struct ao2_container *, backends, ao2_global_obj_ref(cel_backends), ao2_cleanup);
@@ -1746,20 +2330,49 @@ int ast_cel_backend_register(const char *name, ast_cel_backend_cb backend_callba
 		return -1;
 	}
 
-	/* The backend object is immutable so it doesn't need a lock of its own. */
-	backend = ao2_alloc_options(sizeof(*backend) + 1 + strlen(name), NULL,
-		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	backend = ao2_alloc(sizeof(*backend) + 1 + strlen(name), cel_backend_dtor);
 	if (!backend) {
 		return -1;
 	}
 	strcpy(backend->name, name);/* Safe */
 	backend->callback = backend_callback;
+	ast_cond_init(&backend->cond, NULL);
+	if (AST_VECTOR_INIT(&backend->queue, 0)) {
+		ao2_ref(backend, -1);
+		return -1;
+	}
 
 	ao2_link(backends, backend);
 	ao2_ref(backend, -1);
 	return 0;
 }
 
+void ast_cel_backend_stats_foreach(ast_cel_backend_stats_cb callback, void *data)
+{
+	RAII_VAR(struct ao2_container *, backends, ao2_global_obj_ref(cel_backends), ao2_cleanup);
+	struct ao2_iterator iter;
+	struct cel_backend *backend;
+
+	if (!backends) {
+		return;
+	}
+
+	iter = ao2_iterator_init(backends, 0);
+	for (; (backend = ao2_iterator_next(&iter)); ao2_ref(backend, -1)) {
+		struct ast_cel_backend_stats stats = {
+			.name = backend->name,
+		};
+
+		ao2_lock(backend);
+		stats.queued = AST_VECTOR_SIZE(&backend->queue) + backend->delivering;
+		stats.dropped = backend->dropped;
+		ao2_unlock(backend);
+
+		callback(&stats, data);
+	}
+	ao2_iterator_destroy(&iter);
+}
+
 AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_GLOBAL_SYMBOLS | AST_MODFLAG_LOAD_ORDER, "CEL Engine",
 	.support_level = AST_MODULE_SUPPORT_CORE,
 	.load = load_module,
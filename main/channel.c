@@ -34,10 +34,14 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <math.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include "asterisk/paths.h"	/* use ast_config_AST_SYSTEM_NAME */
 
 #include "asterisk/pbx.h"
+#include "asterisk/pickup.h"
 #include "asterisk/frame.h"
 #include "asterisk/mod_format.h"
 #include "asterisk/sched.h"
@@ -74,6 +78,8 @@
 #include "asterisk/max_forwards.h"
 #include "asterisk/stream.h"
 #include "asterisk/message.h"
+#include "asterisk/vector.h"
+#include "asterisk/threadpool.h"
 
 /*** DOCUMENTATION
  ***/
@@ -119,6 +125,18 @@ static AST_RWLIST_HEAD_STATIC(backends, chanlist);
 /*! \brief All active channels on the system */
 static struct ao2_container *channels;
 
+/*!
+ * \brief The active channels, hashed by uniqueid
+ *
+ * A channel is linked into the indexes whenever it is linked into
+ * channels, see channel_link() and channel_unlink().  Lookups through
+ * them compare keys without locking any channel.
+ */
+static struct ao2_container *channels_by_uniqueid;
+
+/*! \brief The active channels, sorted by name so prefixes can be found */
+static struct ao2_container *channels_by_name;
+
 /*! \brief map AST_CAUSE's to readable string representations
  *
  * \ref causes.h
@@ -708,18 +726,60 @@ static const struct ast_channel_tech null_tech = {
 
 static void ast_channel_destructor(void *obj);
 static void ast_dummy_channel_destructor(void *obj);
-static int ast_channel_by_uniqueid_cb(void *obj, void *arg, void *data, int flags);
+static void generator_shared_remove(struct ast_channel *chan);
+
+/*!
+ * \internal
+ * \brief Link a channel into channels and its indexes
+ *
+ * \note channels must be locked.
+ */
+static void channel_link(struct ast_channel *chan)
+{
+	ao2_link_flags(channels, chan, OBJ_NOLOCK);
+	ao2_link(channels_by_uniqueid, chan);
+	ao2_link(channels_by_name, chan);
+}
+
+/*! \internal \brief Unlink a channel from channels and its indexes, safe if already unlinked */
+static void channel_unlink(struct ast_channel *chan)
+{
+	ast_pickup_index_remove(chan);
+	ao2_unlink(channels, chan);
+	ao2_unlink(channels_by_uniqueid, chan);
+	ao2_unlink(channels_by_name, chan);
+}
+
+/*!
+ * \internal
+ * \brief Lock channels and its indexes while channels are renamed
+ *
+ * Lookups through the indexes wait while a channel is relinked, the way
+ * lookups through channels always have.
+ */
+static void channels_lock_all(void)
+{
+	ao2_lock(channels);
+	ao2_lock(channels_by_uniqueid);
+	ao2_lock(channels_by_name);
+}
+
+static void channels_unlock_all(void)
+{
+	ao2_unlock(channels_by_name);
+	ao2_unlock(channels_by_uniqueid);
+	ao2_unlock(channels);
+}
 
 static int does_id_conflict(const char *uniqueid)
 {
 	struct ast_channel *conflict;
-	size_t length = 0;
 
 	if (ast_strlen_zero(uniqueid)) {
 		return 0;
 	}
 
-	conflict = ast_channel_callback(ast_channel_by_uniqueid_cb, (char *) uniqueid, &length, OBJ_NOLOCK);
+	conflict = ao2_find(channels_by_uniqueid, uniqueid, OBJ_SEARCH_KEY);
 	if (conflict) {
 		ast_log(LOG_ERROR, "Channel Unique ID '%s' already in use by channel %s(%p)\n",
 			uniqueid, ast_channel_name(conflict), conflict);
@@ -856,8 +916,6 @@ __ast_channel_alloc_ap(int needqueue, int state, const char *cid_num, const char
 	now = ast_tvnow();
 	ast_channel_creationtime_set(tmp, &now);
 
-	ast_channel_internal_setup_topics(tmp);
-
 	if (!ast_strlen_zero(name_fmt)) {
 		char *slash, *slash2;
 		/* Almost every channel is calling this function, and setting the name via the ast_string_field_build() call.
@@ -901,6 +959,7 @@ __ast_channel_alloc_ap(int needqueue, int state, const char *cid_num, const char
 
 	headp = ast_channel_varshead(tmp);
 	AST_LIST_HEAD_INIT_NOLOCK(headp);
+	ast_var_list_index_enable(headp);
 
 	ast_pbx_hangup_handler_init(tmp);
 	AST_LIST_HEAD_INIT_NOLOCK(ast_channel_datastores(tmp));
@@ -934,7 +993,7 @@ __ast_channel_alloc_ap(int needqueue, int state, const char *cid_num, const char
 	/* Finalize and link into the channels container. */
 	ast_channel_internal_finalize(tmp);
 	ast_atomic_fetchadd_int(&chancount, +1);
-	ao2_link_flags(channels, tmp, OBJ_NOLOCK);
+	channel_link(tmp);
 
 	ao2_unlock(channels);
 
@@ -1000,8 +1059,6 @@ struct ast_channel *__ast_dummy_channel_alloc(const char *file, int line, const
 
 	ast_channel_hold_state_set(tmp, AST_CONTROL_UNHOLD);
 
-	ast_channel_internal_setup_topics(tmp);
-
 	headp = ast_channel_varshead(tmp);
 	AST_LIST_HEAD_INIT_NOLOCK(headp);
 
@@ -1277,28 +1334,6 @@ struct ast_channel *ast_channel_callback(ao2_callback_data_fn *cb_fn, void *arg,
 	return ao2_callback_data(channels, ao2_flags, cb_fn, arg, data);
 }
 
-static int ast_channel_by_name_cb(void *obj, void *arg, void *data, int flags)
-{
-	struct ast_channel *chan = obj;
-	const char *name = arg;
-	size_t name_len = *(size_t *) data;
-	int ret = CMP_MATCH;
-
-	if (ast_strlen_zero(name)) {
-		ast_log(LOG_ERROR, "BUG! Must supply a channel name or partial name to match!\n");
-		return CMP_STOP;
-	}
-
-	ast_channel_lock(chan);
-	if ((!name_len && strcasecmp(ast_channel_name(chan), name))
-		|| (name_len && strncasecmp(ast_channel_name(chan), name, name_len))) {
-		ret = 0; /* name match failed, keep looking */
-	}
-	ast_channel_unlock(chan);
-
-	return ret;
-}
-
 static int ast_channel_by_exten_cb(void *obj, void *arg, void *data, int flags)
 {
 	struct ast_channel *chan = obj;
@@ -1381,18 +1416,43 @@ struct ast_channel_iterator *ast_channel_iterator_by_exten_new(const char *exten
 	return i;
 }
 
+/*!
+ * \internal
+ * \brief Find channels in the name index
+ *
+ * \param name The name, or a prefix of it
+ * \param name_len The length of the prefix, 0 to match the full name
+ * \param flags OBJ_MULTIPLE to get an iterator instead of the first channel
+ *
+ * A prefix as long as \a name or longer matches only the full name.
+ */
+static void *channels_find_by_name(const char *name, size_t name_len, int flags)
+{
+	char *prefix;
+
+	if (ast_strlen_zero(name)) {
+		ast_log(LOG_ERROR, "BUG! Must supply a channel name or partial name to match!\n");
+		return NULL;
+	}
+
+	if (!name_len || name_len > strlen(name)) {
+		return ao2_find(channels_by_name, name, OBJ_SEARCH_KEY | flags);
+	}
+
+	prefix = ast_strdupa(name);
+	prefix[name_len] = '\0';
+	return ao2_find(channels_by_name, prefix, OBJ_SEARCH_PARTIAL_KEY | flags);
+}
+
 struct ast_channel_iterator *ast_channel_iterator_by_name_new(const char *name, size_t name_len)
 {
 	struct ast_channel_iterator *i;
-	char *l_name = (char *) name;
 
 	if (!(i = ast_calloc(1, sizeof(*i)))) {
 		return NULL;
 	}
 
-	i->active_iterator = (void *) ast_channel_callback(ast_channel_by_name_cb,
-		l_name, &name_len,
-		OBJ_MULTIPLE | (name_len == 0 /* match the whole word, so optimize */ ? OBJ_KEY : 0));
+	i->active_iterator = channels_find_by_name(name, name_len, OBJ_MULTIPLE);
 	if (!i->active_iterator) {
 		ast_free(i);
 		return NULL;
@@ -1432,8 +1492,7 @@ struct ast_channel *ast_channel_get_by_name_prefix(const char *name, size_t name
 	struct ast_channel *chan;
 	char *l_name = (char *) name;
 
-	chan = ast_channel_callback(ast_channel_by_name_cb, l_name, &name_len,
-		(name_len == 0) /* optimize if it is a complete name match */ ? OBJ_KEY : 0);
+	chan = channels_find_by_name(name, name_len, 0);
 	if (chan) {
 		return chan;
 	}
@@ -1444,6 +1503,11 @@ struct ast_channel *ast_channel_get_by_name_prefix(const char *name, size_t name
 	}
 
 	/* Now try a search for uniqueid. */
+	if (!name_len) {
+		return ao2_find(channels_by_uniqueid, l_name, OBJ_SEARCH_KEY);
+	}
+
+	/* The uniqueid index is hashed, so prefixes still need a scan. */
 	return ast_channel_callback(ast_channel_by_uniqueid_cb, l_name, &name_len, 0);
 }
 
@@ -1580,7 +1644,7 @@ int ast_safe_sleep_without_silence(struct ast_channel *chan, int ms)
 struct ast_channel *ast_channel_release(struct ast_channel *chan)
 {
 	/* Safe, even if already unlinked. */
-	ao2_unlink(channels, chan);
+	channel_unlink(chan);
 	return ast_channel_unref(chan);
 }
 
@@ -2292,8 +2356,9 @@ static void ast_channel_destructor(void *obj)
 	/* loop over the variables list, freeing all data and deleting list items */
 	/* no need to lock the list, as the channel is already locked */
 	headp = ast_channel_varshead(chan);
-	while ((vardata = AST_LIST_REMOVE_HEAD(headp, entries)))
+	while ((vardata = AST_VAR_LIST_REMOVE_HEAD(headp)))
 		ast_var_delete(vardata);
+	ast_var_list_index_disable(headp);
 
 	ast_app_group_discard(chan);
 
@@ -2324,9 +2389,6 @@ static void ast_channel_destructor(void *obj)
 
 	ast_channel_nativeformats_set(chan, NULL);
 
-	ast_channel_named_callgroups_set(chan, NULL);
-	ast_channel_named_pickupgroups_set(chan, NULL);
-
 	ast_atomic_fetchadd_int(&chancount, -1);
 }
 
@@ -2355,8 +2417,9 @@ static void ast_dummy_channel_destructor(void *obj)
 	/* loop over the variables list, freeing all data and deleting list items */
 	/* no need to lock the list, as the channel is already locked */
 	headp = ast_channel_varshead(chan);
-	while ((vardata = AST_LIST_REMOVE_HEAD(headp, entries)))
+	while ((vardata = AST_VAR_LIST_REMOVE_HEAD(headp)))
 		ast_var_delete(vardata);
+	ast_var_list_index_disable(headp);
 
 	if (ast_channel_cdr(chan)) {
 		ast_cdr_free(ast_channel_cdr(chan));
@@ -2540,6 +2603,60 @@ static void destroy_hooks(struct ast_channel *chan)
 	ast_framehook_list_destroy(chan);
 }
 
+/*! \brief Number of threads finishing the destruction of hung up channels */
+#define CHANNEL_DESTROY_THREADS 4
+
+/*! \brief Number of seconds an idle channel destruction thread lingers */
+#define CHANNEL_DESTROY_IDLE 60
+
+/*! \brief Threads dropping the last reference to hung up channels */
+static struct ast_threadpool *destroy_pool;
+
+/*! \brief Lock keeping destroy_pool alive while tasks are pushed to it */
+AST_RWLOCK_DEFINE_STATIC(destroy_pool_lock);
+
+static const struct ast_threadpool_options destroy_pool_options = {
+	.version = AST_THREADPOOL_OPTIONS_VERSION,
+	.idle_timeout = CHANNEL_DESTROY_IDLE,
+	.auto_increment = 1,
+	.initial_size = 0,
+	.max_size = CHANNEL_DESTROY_THREADS,
+};
+
+static int channel_destroy_task(void *data)
+{
+	struct ast_channel *chan = data;
+
+	ast_channel_unref(chan);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Drop the reference ast_hangup() holds on a channel
+ *
+ * When it is the last reference the channel destructor runs, which
+ * publishes the final snapshot for CDR and CEL, destroys the datastores
+ * and releases everything else the channel holds.  None of that is needed
+ * for the hangup itself, so it is handed to destroy_pool and the channel
+ * thread returns straight away.
+ */
+static void channel_hangup_unref(struct ast_channel *chan)
+{
+	int pushed = 0;
+
+	if (ao2_ref(chan, 0) == 1) {
+		ast_rwlock_rdlock(&destroy_pool_lock);
+		pushed = destroy_pool && !ast_threadpool_push(destroy_pool, channel_destroy_task, chan);
+		ast_rwlock_unlock(&destroy_pool_lock);
+	}
+
+	if (!pushed) {
+		ast_channel_unref(chan);
+	}
+}
+
 /*! \brief Hangup a channel */
 void ast_hangup(struct ast_channel *chan)
 {
@@ -2574,7 +2691,7 @@ void ast_hangup(struct ast_channel *chan)
 	 * longer be needed.
 	 */
 	ast_pbx_hangup_handler_run(chan);
-	ao2_unlink(channels, chan);
+	channel_unlink(chan);
 	ast_channel_lock(chan);
 
 	destroy_hooks(chan);
@@ -2602,6 +2719,7 @@ void ast_hangup(struct ast_channel *chan)
 	}
 	ast_channel_generatordata_set(chan, NULL);
 	ast_channel_generator_set(chan, NULL);
+	generator_shared_remove(chan);
 
 	if (ast_test_flag(ast_channel_flags(chan), AST_FLAG_BLOCKING)) {
 		ast_log(LOG_WARNING, "Hard hangup called by thread LWP %d on %s, while blocked by thread LWP %d in procedure %s!  Expect a failure\n",
@@ -2618,7 +2736,7 @@ void ast_hangup(struct ast_channel *chan)
 
 	ast_cc_offer(chan);
 
-	ast_channel_unref(chan);
+	channel_hangup_unref(chan);
 }
 
 /*!
@@ -2879,16 +2997,282 @@ static inline int should_trigger_dtmf_emulating(struct ast_channel *chan)
 	return 0;
 }
 
+/*!
+ * \brief A thread running the generators of a share of the channels.
+ *
+ * Instead of each channel's own timer waking its thread every 20ms to
+ * call its generator, the shared generator threads each wait on one
+ * timer and call the generators of all of their channels on every tick.
+ */
+struct generator_thread {
+	/*! The thread itself */
+	pthread_t thread;
+	/*! Protects channels */
+	ast_mutex_t lock;
+	/*! A reference to each channel whose generator this thread runs */
+	AST_VECTOR(, struct ast_channel *) channels;
+	/*! Copy of channels taken each tick, only used by the thread */
+	AST_VECTOR(, struct ast_channel *) running;
+	/*! Ticks at the generator frame rate */
+	struct ast_timer *timer;
+	/*! Set to have the thread exit */
+	int stop;
+};
+
+/*! Protects starting and stopping the shared generator threads */
+AST_MUTEX_DEFINE_STATIC(generator_threads_lock);
+/*! The shared generator threads, started when the first generator is shared */
+static struct generator_thread *generator_threads;
+/*! Number of shared generator threads running */
+static unsigned int generator_thread_count;
+
+static struct generator_thread *generator_thread_for(struct ast_channel *chan)
+{
+	return &generator_threads[(unsigned int) ast_str_hash(ast_channel_uniqueid(chan)) % generator_thread_count];
+}
+
+/*!
+ * \internal
+ * \brief Run one tick of the generator on a channel from a shared generator thread
+ *
+ * \note The generator data is taken from the channel while generating just
+ * like generator_force() does.  Since this runs outside the channel thread,
+ * the generator may be deactivated or replaced meanwhile, in which case the
+ * data we took is now ours to release.
+ */
+static void generator_shared_run(struct ast_channel *chan)
+{
+	struct ast_generator *generator;
+	void *gendata;
+	int samples;
+	int res;
+
+	ast_channel_lock(chan);
+	generator = ast_channel_generator(chan);
+	gendata = ast_channel_generatordata(chan);
+	if (!ast_test_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED)
+		|| !generator || !generator->generate || !gendata) {
+		ast_channel_unlock(chan);
+		return;
+	}
+	samples = ast_format_get_sample_rate(ast_channel_writeformat(chan)) / 50;
+	ast_channel_generatordata_set(chan, NULL);     /* reset, to let writes go through */
+	ast_channel_unlock(chan);
+
+	res = generator->generate(chan, gendata, 0, samples);
+
+	ast_channel_lock(chan);
+	if (generator == ast_channel_generator(chan) && !ast_channel_generatordata(chan)) {
+		ast_channel_generatordata_set(chan, gendata);
+		if (res) {
+			ast_debug(1, "Auto-deactivating generator\n");
+			ast_deactivate_generator(chan);
+		}
+	} else if (generator->release) {
+		generator->release(chan, gendata);
+	}
+	ast_channel_unlock(chan);
+}
+
+static void *generator_thread_run(void *data)
+{
+	struct generator_thread *gt = data;
+	struct pollfd pfd = { .fd = ast_timer_fd(gt->timer), .events = POLLIN, };
+	int i;
+
+	while (!gt->stop) {
+		if (ast_poll(&pfd, 1, 1000) <= 0) {
+			continue;
+		}
+		if (ast_timer_ack(gt->timer, 1) < 0) {
+			ast_log(LOG_ERROR, "Failed to acknowledge shared generator timer\n");
+			break;
+		}
+
+		ast_mutex_lock(&gt->lock);
+		for (i = 0; i < AST_VECTOR_SIZE(&gt->channels); ++i) {
+			if (AST_VECTOR_APPEND(&gt->running, ast_channel_ref(AST_VECTOR_GET(&gt->channels, i)))) {
+				ast_channel_unref(AST_VECTOR_GET(&gt->channels, i));
+			}
+		}
+		ast_mutex_unlock(&gt->lock);
+
+		for (i = 0; i < AST_VECTOR_SIZE(&gt->running); ++i) {
+			struct ast_channel *chan = AST_VECTOR_GET(&gt->running, i);
+
+			generator_shared_run(chan);
+			ast_channel_unref(chan);
+		}
+		AST_VECTOR_RESET(&gt->running, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	}
+
+	return NULL;
+}
+
+static void generator_threads_stop(void)
+{
+	unsigned int count;
+	unsigned int i;
+
+	ast_mutex_lock(&generator_threads_lock);
+	count = generator_thread_count;
+	generator_thread_count = 0;
+	for (i = 0; i < count; ++i) {
+		generator_threads[i].stop = 1;
+	}
+	for (i = 0; i < count; ++i) {
+		struct generator_thread *gt = &generator_threads[i];
+
+		pthread_join(gt->thread, NULL);
+		AST_VECTOR_CALLBACK_VOID(&gt->channels, ast_channel_unref);
+		AST_VECTOR_FREE(&gt->channels);
+		AST_VECTOR_FREE(&gt->running);
+		ast_timer_close(gt->timer);
+		ast_mutex_destroy(&gt->lock);
+	}
+	ast_free(generator_threads);
+	generator_threads = NULL;
+	ast_mutex_unlock(&generator_threads_lock);
+}
+
+/*!
+ * \internal
+ * \brief Start the shared generator threads if they are enabled and not yet running
+ *
+ * \retval 0 if the shared generator threads are running
+ * \retval -1 if they are disabled or could not be started
+ */
+static int generator_threads_start(void)
+{
+	static int warned;
+	unsigned int count = ast_option_generator_threads;
+	unsigned int started = 0;
+	int res = 0;
+
+	if (!count) {
+		return -1;
+	}
+
+	ast_mutex_lock(&generator_threads_lock);
+	if (generator_thread_count) {
+		ast_mutex_unlock(&generator_threads_lock);
+		return 0;
+	}
+	if (!(generator_threads = ast_calloc(count, sizeof(*generator_threads)))) {
+		ast_mutex_unlock(&generator_threads_lock);
+		return -1;
+	}
+	while (started < count) {
+		struct generator_thread *gt = &generator_threads[started];
+
+		ast_mutex_init(&gt->lock);
+		if (AST_VECTOR_INIT(&gt->channels, 64) || AST_VECTOR_INIT(&gt->running, 64)
+			|| !(gt->timer = ast_timer_open())) {
+			res = -1;
+		} else if (ast_timer_set_rate(gt->timer, 50)
+			|| ast_pthread_create_background(&gt->thread, NULL, generator_thread_run, gt)) {
+			ast_timer_close(gt->timer);
+			res = -1;
+		}
+		if (res) {
+			AST_VECTOR_FREE(&gt->channels);
+			AST_VECTOR_FREE(&gt->running);
+			ast_mutex_destroy(&gt->lock);
+			if (!warned) {
+				ast_log(LOG_WARNING, "Unable to start shared generator thread %u of %u\n", started + 1, count);
+				warned = 1;
+			}
+			break;
+		}
+		++started;
+	}
+	if (!started) {
+		ast_free(generator_threads);
+		generator_threads = NULL;
+	}
+	/* Only publish the count once, it picks the thread of each channel */
+	generator_thread_count = started;
+	ast_mutex_unlock(&generator_threads_lock);
+
+	return started ? 0 : -1;
+}
+
+/*!
+ * \internal
+ * \brief Have a shared generator thread run the generator on a channel
+ *
+ * \note The channel must be locked.
+ */
+static int generator_shared_add(struct ast_channel *chan)
+{
+	struct generator_thread *gt;
+	int res;
+
+	if (ast_test_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED)) {
+		return 0;
+	}
+	if (!generator_thread_count && generator_threads_start()) {
+		return -1;
+	}
+
+	gt = generator_thread_for(chan);
+	ast_mutex_lock(&gt->lock);
+	res = AST_VECTOR_APPEND(&gt->channels, ast_channel_ref(chan));
+	ast_mutex_unlock(&gt->lock);
+	if (res) {
+		ast_channel_unref(chan);
+		return -1;
+	}
+	ast_set_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED);
+
+	return 0;
+}
+
+#define GENERATOR_CHANNEL_CMP(elem, value) ((elem) == (value))
+
+/*!
+ * \internal
+ * \brief Stop a shared generator thread running the generator on a channel
+ *
+ * \note The channel must be locked.
+ */
+static void generator_shared_remove(struct ast_channel *chan)
+{
+	struct generator_thread *gt;
+	int res;
+
+	if (!ast_test_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED)) {
+		return;
+	}
+	ast_clear_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED);
+	if (!generator_thread_count) {
+		/* Already stopped at shutdown, along with the reference */
+		return;
+	}
+
+	gt = generator_thread_for(chan);
+	ast_mutex_lock(&gt->lock);
+	res = AST_VECTOR_REMOVE_CMP_UNORDERED(&gt->channels, chan, GENERATOR_CHANNEL_CMP, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	ast_mutex_unlock(&gt->lock);
+	if (!res) {
+		/* The caller holds the channel locked so this can not be the last reference */
+		ast_channel_unref(chan);
+	}
+}
+
 static void deactivate_generator_nolock(struct ast_channel *chan)
 {
-	if (ast_channel_generatordata(chan)) {
+	/* A shared generator thread may have taken the data while generating */
+	if (ast_channel_generatordata(chan)
+		|| ast_test_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED)) {
 		struct ast_generator *generator = ast_channel_generator(chan);
 
-		if (generator && generator->release) {
+		if (generator && generator->release && ast_channel_generatordata(chan)) {
 			generator->release(chan, ast_channel_generatordata(chan));
 		}
 		ast_channel_generatordata_set(chan, NULL);
 		ast_channel_generator_set(chan, NULL);
+		generator_shared_remove(chan);
 		ast_channel_set_fd(chan, AST_GENERATOR_FD, -1);
 		ast_clear_flag(ast_channel_flags(chan), AST_FLAG_WRITE_INT);
 		ast_settimeout(chan, 0, NULL, NULL);
@@ -2971,7 +3355,14 @@ int ast_activate_generator(struct ast_channel *chan, struct ast_generator *gen,
 	}
 	ast_channel_generatordata_set(chan, generatordata);
 	if (!res) {
-		ast_settimeout(chan, 50, generator_force, chan);
+		if (gen->shareable && !generator_shared_add(chan)) {
+			if (ast_channel_timingfunc(chan) == generator_force) {
+				ast_settimeout(chan, 0, NULL, NULL);
+			}
+		} else {
+			generator_shared_remove(chan);
+			ast_settimeout(chan, 50, generator_force, chan);
+		}
 		ast_channel_generator_set(chan, gen);
 	}
 	ast_channel_unlock(chan);
@@ -2981,6 +3372,183 @@ int ast_activate_generator(struct ast_channel *chan, struct ast_generator *gen,
 	return res;
 }
 
+#ifdef __linux__
+/*! \brief A channel whose file descriptors a thread has registered for waiting */
+struct waitfor_epoll_chan {
+	/*! The channel, only compared and never dereferenced */
+	const struct ast_channel *chan;
+	/*! The generation of the channel's file descriptors when they were registered */
+	unsigned int generation;
+};
+
+/*!
+ * \brief The epoll set a thread waits on channels with
+ *
+ * Callers such as app_dial and bridges wait on the same channels over and
+ * over, so the descriptors registered for the last wait are kept and only
+ * registered again once the channels or their descriptors change.
+ */
+struct waitfor_epoll {
+	/*! The epoll instance, -1 if there is none or the channels need poll() */
+	int epfd;
+	/*! Number of file descriptors registered */
+	int fds;
+	/*! The channels registered, in the order they were waited on */
+	AST_VECTOR(, struct waitfor_epoll_chan) chans;
+};
+
+static int waitfor_epoll_init(void *data)
+{
+	struct waitfor_epoll *waitfor = data;
+
+	waitfor->epfd = -1;
+	return AST_VECTOR_INIT(&waitfor->chans, 4);
+}
+
+static void waitfor_epoll_cleanup(void *data)
+{
+	struct waitfor_epoll *waitfor = data;
+
+	if (waitfor->epfd > -1) {
+		close(waitfor->epfd);
+	}
+	AST_VECTOR_FREE(&waitfor->chans);
+	ast_free(waitfor);
+}
+
+AST_THREADSTORAGE_CUSTOM(waitfor_epoll_buf, waitfor_epoll_init, waitfor_epoll_cleanup);
+
+/*!
+ * \internal
+ * \brief Get an epoll set holding the file descriptors of some channels
+ *
+ * \param c The channels
+ * \param n The number of channels
+ * \param generations The generation of each channel's file descriptors
+ * \param pfds The file descriptors of the channels, in channel order
+ * \param max The number of file descriptors
+ *
+ * The events of pfds[x] are reported with x as their data.
+ *
+ * \return The epoll set, or -1 if poll() has to be used instead
+ */
+static int waitfor_epoll_get(struct ast_channel **c, int n, const unsigned int *generations,
+	const struct pollfd *pfds, int max)
+{
+	struct waitfor_epoll *waitfor;
+	int x;
+
+	waitfor = ast_threadstorage_get(&waitfor_epoll_buf, sizeof(*waitfor));
+	if (!waitfor) {
+		return -1;
+	}
+
+	if (waitfor->fds == max && AST_VECTOR_SIZE(&waitfor->chans) == n) {
+		for (x = 0; x < n; x++) {
+			struct waitfor_epoll_chan *registered = AST_VECTOR_GET_ADDR(&waitfor->chans, x);
+
+			if (registered->chan != c[x] || registered->generation != generations[x]) {
+				break;
+			}
+		}
+		if (x == n) {
+			return waitfor->epfd;
+		}
+	}
+
+	/*
+	 * Start from a new set rather than removing the old descriptors, they
+	 * may have been closed and their numbers reused since.
+	 */
+	if (waitfor->epfd > -1) {
+		close(waitfor->epfd);
+	}
+	AST_VECTOR_RESET(&waitfor->chans, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	waitfor->fds = 0;
+	waitfor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (waitfor->epfd < 0) {
+		return -1;
+	}
+
+	for (x = 0; x < n; x++) {
+		struct waitfor_epoll_chan registered = {
+			.chan = c[x],
+			.generation = generations[x],
+		};
+
+		if (AST_VECTOR_APPEND(&waitfor->chans, registered)) {
+			close(waitfor->epfd);
+			waitfor->epfd = -1;
+			AST_VECTOR_RESET(&waitfor->chans, AST_VECTOR_ELEM_CLEANUP_NOOP);
+			return -1;
+		}
+	}
+	waitfor->fds = max;
+
+	for (x = 0; x < max; x++) {
+		struct epoll_event event = {
+			.events = EPOLLIN | EPOLLPRI,
+			.data.u32 = x,
+		};
+
+		/*
+		 * Descriptors epoll refuses, or given twice, are left to poll()
+		 * until the channels change.
+		 */
+		if (epoll_ctl(waitfor->epfd, EPOLL_CTL_ADD, pfds[x].fd, &event)) {
+			close(waitfor->epfd);
+			waitfor->epfd = -1;
+			break;
+		}
+	}
+
+	return waitfor->epfd;
+}
+
+/*!
+ * \internal
+ * \brief Wait on an epoll set, reporting the events like poll() does
+ *
+ * \return The number of ready file descriptors, 0 on timeout or -1 on error
+ */
+static int waitfor_epoll_wait(int epfd, struct pollfd *pfds, int max, int ms)
+{
+	struct epoll_event *events = ast_alloca(sizeof(*events) * max);
+	int res;
+	int x;
+
+	for (x = 0; x < max; x++) {
+		pfds[x].revents = 0;
+	}
+
+	res = epoll_wait(epfd, events, max, ms);
+	for (x = 0; x < res; x++) {
+		uint32_t ready = events[x].events;
+
+		if (events[x].data.u32 >= max) {
+			continue;
+		}
+		pfds[events[x].data.u32].revents = ((ready & EPOLLIN) ? POLLIN : 0)
+			| ((ready & EPOLLPRI) ? POLLPRI : 0)
+			| ((ready & EPOLLERR) ? POLLERR : 0)
+			| ((ready & EPOLLHUP) ? POLLHUP : 0);
+	}
+
+	return res;
+}
+#else
+static int waitfor_epoll_get(struct ast_channel **c, int n, const unsigned int *generations,
+	const struct pollfd *pfds, int max)
+{
+	return -1;
+}
+
+static int waitfor_epoll_wait(int epfd, struct pollfd *pfds, int max, int ms)
+{
+	return -1;
+}
+#endif
+
 /*! \brief Wait for x amount of time on a file descriptor to have input.  */
 int ast_waitfor_n_fd(int *fds, int n, int *ms, int *exception)
 {
@@ -2995,6 +3563,8 @@ struct ast_channel *ast_waitfor_nandfds(struct ast_channel **c, int n, int *fds,
 {
 	struct timeval start = { 0 , 0 };
 	struct pollfd *pfds = NULL;
+	unsigned int *generations;
+	int epfd = -1;
 	int res;
 	long rms;
 	int x, y, max;
@@ -3040,6 +3610,7 @@ struct ast_channel *ast_waitfor_nandfds(struct ast_channel **c, int n, int *fds,
 
 	pfds = ast_alloca(sizeof(*pfds) * sz);
 	fdmap = ast_alloca(sizeof(*fdmap) * sz);
+	generations = ast_alloca(sizeof(*generations) * (n ? n : 1));
 
 	/* Wait full interval */
 	rms = *ms;
@@ -3066,6 +3637,7 @@ struct ast_channel *ast_waitfor_nandfds(struct ast_channel **c, int n, int *fds,
 			fdmap[max].chan = x;  /* channel x is linked to this pfds */
 			max += ast_add_fd(&pfds[max], ast_channel_fd(c[x], y));
 		}
+		generations[x] = ast_channel_fd_generation(c[x]);
 		CHECK_BLOCKING(c[x]);
 		ast_channel_unlock(c[x]);
 	}
@@ -3075,6 +3647,15 @@ struct ast_channel *ast_waitfor_nandfds(struct ast_channel **c, int n, int *fds,
 		max += ast_add_fd(&pfds[max], fds[x]);
 	}
 
+	/*
+	 * Channels alone are waited on with the thread's epoll set, which
+	 * only changes when they do.  Individual fds keep using poll() as
+	 * they may be closed and reused between waits unnoticed.
+	 */
+	if (!nfds && max) {
+		epfd = waitfor_epoll_get(c, n, generations, pfds, max);
+	}
+
 	if (*ms > 0) {
 		start = ast_tvnow();
 	}
@@ -3085,13 +3666,13 @@ struct ast_channel *ast_waitfor_nandfds(struct ast_channel **c, int n, int *fds,
 			if (kbrms > 600000) {
 				kbrms = 600000;
 			}
-			res = ast_poll(pfds, max, kbrms);
+			res = epfd > -1 ? waitfor_epoll_wait(epfd, pfds, max, kbrms) : ast_poll(pfds, max, kbrms);
 			if (!res) {
 				rms -= kbrms;
 			}
 		} while (!res && (rms > 0));
 	} else {
-		res = ast_poll(pfds, max, rms);
+		res = epfd > -1 ? waitfor_epoll_wait(epfd, pfds, max, rms) : ast_poll(pfds, max, rms);
 	}
 	for (x = 0; x < n; x++) {
 		ast_channel_lock(c[x]);
@@ -3421,7 +4002,8 @@ static void ast_read_generator_actions(struct ast_channel *chan, struct ast_fram
 		|| !generator->generate
 		|| f->frametype != AST_FRAME_VOICE
 		|| !ast_channel_generatordata(chan)
-		|| ast_channel_timingfunc(chan)) {
+		|| ast_channel_timingfunc(chan)
+		|| ast_test_flag(ast_channel_flags(chan), AST_FLAG_GENERATOR_SHARED)) {
 		return;
 	}
 
@@ -3777,6 +4359,11 @@ static struct ast_frame *__ast_read(struct ast_channel *chan, int dropaudio, int
 			ast_log(LOG_WARNING, "No read routine on channel %s\n", ast_channel_name(chan));
 	}
 
+	if (f && f->frametype == AST_FRAME_VOICE && ast_tvzero(f->ingress)) {
+		/* Media from channel drivers that do not stamp it is timed from here. */
+		f->ingress = ast_tvnow();
+	}
+
 	if (stream == default_stream) {
 		/* Perform the framehook read event here. After the frame enters the framehook list
 		 * there is no telling what will happen, <insert mad scientist laugh here>!!! */
@@ -5155,6 +5742,16 @@ int ast_write_stream(struct ast_channel *chan, int stream_num, struct ast_frame
 		stream = default_stream = ast_channel_get_default_stream(chan, type);
 	}
 
+	/* Hooks are free to modify the frame in place, which a shared payload does not allow.
+	 * Spies only look at the frame, so a channel that is only being recorded keeps the
+	 * shared payload. */
+	if ((fr->mallocd & AST_MALLOCD_SHARED)
+		&& (ast_channel_framehooks(chan)
+			|| !ast_audiohook_write_list_spies_only(ast_channel_audiohooks(chan)))
+		&& ast_frunshare(fr)) {
+		goto done;
+	}
+
 	/* Perform the framehook write event here. After the frame enters the framehook list
 	 * there is no telling what will happen, how awesome is that!!! */
 	if ((stream == default_stream) && !(fr = ast_framehook_list_write_event(ast_channel_framehooks(chan), fr))) {
@@ -6771,13 +7368,13 @@ static void __ast_change_name_nolink(struct ast_channel *chan, const char *newna
 void ast_change_name(struct ast_channel *chan, const char *newname)
 {
 	/* We must re-link, as the hash value will change here. */
-	ao2_lock(channels);
+	channels_lock_all();
 	ast_channel_lock(chan);
-	ao2_unlink(channels, chan);
+	channel_unlink(chan);
 	__ast_change_name_nolink(chan, newname);
-	ao2_link(channels, chan);
+	channel_link(chan);
 	ast_channel_unlock(chan);
-	ao2_unlock(channels);
+	channels_unlock_all();
 }
 
 void ast_channel_inherit_variables(const struct ast_channel *parent, struct ast_channel *child)
@@ -6815,7 +7412,7 @@ void ast_channel_inherit_variables(const struct ast_channel *parent, struct ast_
 			ast_debug(1, "Inheriting variable %s from %s to %s.\n",
 				ast_var_full_name(newvar), ast_channel_name(parent),
 				ast_channel_name(child));
-			AST_LIST_INSERT_TAIL(ast_channel_varshead(child), newvar, entries);
+			AST_VAR_LIST_INSERT_TAIL(ast_channel_varshead(child), newvar);
 			ast_channel_publish_varset(child, ast_var_full_name(newvar),
 				ast_var_value(newvar));
 		}
@@ -6836,14 +7433,15 @@ static void clone_variables(struct ast_channel *original, struct ast_channel *cl
 	struct ast_var_t *current, *newvar;
 	/* Append variables from clone channel into original channel */
 	/* XXX Is this always correct?  We have to in order to keep MACROS working XXX */
-	AST_LIST_APPEND_LIST(ast_channel_varshead(original), ast_channel_varshead(clonechan), entries);
+	while ((current = AST_VAR_LIST_REMOVE_HEAD(ast_channel_varshead(clonechan)))) {
+		AST_VAR_LIST_INSERT_TAIL(ast_channel_varshead(original), current);
+	}
 
 	/* then, dup the varshead list into the clone */
 
 	AST_LIST_TRAVERSE(ast_channel_varshead(original), current, entries) {
 		newvar = ast_var_assign(current->name, current->value);
-		if (newvar)
-			AST_LIST_INSERT_TAIL(ast_channel_varshead(clonechan), newvar, entries);
+		AST_VAR_LIST_INSERT_TAIL(ast_channel_varshead(clonechan), newvar);
 	}
 }
 
@@ -6917,15 +7515,15 @@ static void channel_do_masquerade(struct ast_channel *original, struct ast_chann
 	 * has restabilized the channels to hold off ast_hangup() and until
 	 * AST_FLAG_ZOMBIE can be set on the clonechan.
 	 */
-	ao2_lock(channels);
+	channels_lock_all();
 
 	/* Bump the refs to ensure that they won't dissapear on us. */
 	ast_channel_ref(original);
 	ast_channel_ref(clonechan);
 
 	/* unlink from channels container as name (which is the hash value) will change */
-	ao2_unlink(channels, original);
-	ao2_unlink(channels, clonechan);
+	channel_unlink(original);
+	channel_unlink(clonechan);
 
 	moh_is_playing = ast_test_flag(ast_channel_flags(original), AST_FLAG_MOH);
 	if (moh_is_playing) {
@@ -7336,9 +7934,9 @@ static void channel_do_masquerade(struct ast_channel *original, struct ast_chann
 	ast_channel_unlock(original);
 	ast_channel_unlock(clonechan);
 
-	ao2_link(channels, clonechan);
-	ao2_link(channels, original);
-	ao2_unlock(channels);
+	channel_link(clonechan);
+	channel_link(original);
+	channels_unlock_all();
 
 	/* Release our held safety references. */
 	ast_channel_unref(original);
@@ -7761,14 +8359,17 @@ struct ast_namedgroups *ast_ref_namedgroups(struct ast_namedgroups *groups)
 }
 
 static int (*ast_moh_start_ptr)(struct ast_channel *, const char *, const char *) = NULL;
+static int (*ast_moh_start_shared_ptr)(struct ast_channel *, const char *, const char *) = NULL;
 static void (*ast_moh_stop_ptr)(struct ast_channel *) = NULL;
 static void (*ast_moh_cleanup_ptr)(struct ast_channel *) = NULL;
 
 void ast_install_music_functions(int (*start_ptr)(struct ast_channel *, const char *, const char *),
+				 int (*start_shared_ptr)(struct ast_channel *, const char *, const char *),
 				 void (*stop_ptr)(struct ast_channel *),
 				 void (*cleanup_ptr)(struct ast_channel *))
 {
 	ast_moh_start_ptr = start_ptr;
+	ast_moh_start_shared_ptr = start_shared_ptr;
 	ast_moh_stop_ptr = stop_ptr;
 	ast_moh_cleanup_ptr = cleanup_ptr;
 }
@@ -7776,6 +8377,7 @@ void ast_install_music_functions(int (*start_ptr)(struct ast_channel *, const ch
 void ast_uninstall_music_functions(void)
 {
 	ast_moh_start_ptr = NULL;
+	ast_moh_start_shared_ptr = NULL;
 	ast_moh_stop_ptr = NULL;
 	ast_moh_cleanup_ptr = NULL;
 }
@@ -7790,6 +8392,15 @@ int ast_moh_start(struct ast_channel *chan, const char *mclass, const char *inte
 	return -1;
 }
 
+int ast_moh_start_shared(struct ast_channel *chan, const char *mclass, const char *interpclass)
+{
+	if (ast_moh_start_shared_ptr) {
+		return ast_moh_start_shared_ptr(chan, mclass, interpclass);
+	}
+
+	return ast_moh_start(chan, mclass, interpclass);
+}
+
 void ast_moh_stop(struct ast_channel *chan)
 {
 	if (ast_moh_stop_ptr)
@@ -7815,6 +8426,40 @@ static int ast_channel_hash_cb(const void *obj, const int flags)
 	return ast_str_case_hash(name);
 }
 
+/*! \internal \brief Hash the channels index by uniqueid */
+static int channel_uniqueid_hash_cb(const void *obj, const int flags)
+{
+	const char *uniqueid = (flags & OBJ_SEARCH_KEY) ? obj : ast_channel_uniqueid(obj);
+
+	return ast_str_case_hash(uniqueid);
+}
+
+static int channel_uniqueid_cmp_cb(void *obj, void *arg, int flags)
+{
+	const char *uniqueid = (flags & OBJ_SEARCH_KEY) ? arg : ast_channel_uniqueid(arg);
+
+	return strcasecmp(ast_channel_uniqueid(obj), uniqueid) ? 0 : CMP_MATCH;
+}
+
+/*! \internal \brief Sort the channels index by name, prefixes match as partial keys */
+static int channel_name_sort_cb(const void *obj_left, const void *obj_right, int flags)
+{
+	const char *right_key = obj_right;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_OBJECT:
+		right_key = ast_channel_name(obj_right);
+		/* Fall through */
+	case OBJ_SEARCH_KEY:
+		return strcasecmp(ast_channel_name(obj_left), right_key);
+	case OBJ_SEARCH_PARTIAL_KEY:
+		return strncasecmp(ast_channel_name(obj_left), right_key, strlen(right_key));
+	default:
+		ast_assert(0);
+		return 0;
+	}
+}
+
 /*!
  * \internal
  * \brief Print channel object key (name).
@@ -8020,7 +8665,17 @@ static void channels_shutdown(void)
 		ao2_ref(channels, -1);
 		channels = NULL;
 	}
+	ao2_cleanup(channels_by_uniqueid);
+	channels_by_uniqueid = NULL;
+	ao2_cleanup(channels_by_name);
+	channels_by_name = NULL;
 	ast_channel_unregister(&surrogate_tech);
+	generator_threads_stop();
+
+	ast_rwlock_wrlock(&destroy_pool_lock);
+	ast_threadpool_shutdown(destroy_pool);
+	destroy_pool = NULL;
+	ast_rwlock_unlock(&destroy_pool_lock);
 }
 
 int ast_channels_init(void)
@@ -8032,10 +8687,21 @@ int ast_channels_init(void)
 	}
 	ao2_container_register("channels", channels, prnt_channel_key);
 
+	channels_by_uniqueid = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		AST_NUM_CHANNEL_BUCKETS, channel_uniqueid_hash_cb, NULL, channel_uniqueid_cmp_cb);
+	channels_by_name = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		channel_name_sort_cb, NULL);
+	if (!channels_by_uniqueid || !channels_by_name) {
+		return -1;
+	}
+
 	ast_channel_register(&surrogate_tech);
 
 	ast_stasis_channels_init();
 
+	/* Without the pool hung up channels are simply destroyed by their own thread */
+	destroy_pool = ast_threadpool_create("channel_destroy", NULL, &destroy_pool_options);
+
 	ast_cli_register_multiple(cli_channel, ARRAY_LEN(cli_channel));
 
 	ast_register_cleanup(channels_shutdown);
@@ -8174,6 +8840,7 @@ static struct ast_generator silence_generator = {
 	.alloc = silence_generator_alloc,
 	.release = silence_generator_release,
 	.generate = silence_generator_generate,
+	.shareable = 1,
 };
 
 struct ast_silence_generator {
@@ -10640,7 +11307,7 @@ int ast_channel_get_cc_agent_type(struct ast_channel *chan, char *agent_type, si
 
 void ast_channel_unlink(struct ast_channel *chan)
 {
-	ao2_unlink(channels, chan);
+	channel_unlink(chan);
 }
 
 struct ast_bridge *ast_channel_get_bridge(const struct ast_channel *chan)
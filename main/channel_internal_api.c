@@ -42,6 +42,7 @@
 #include "asterisk/channel_internal.h"
 #include "asterisk/endpoints.h"
 #include "asterisk/indications.h"
+#include "asterisk/pickup.h"
 #include "asterisk/stasis_channels.h"
 #include "asterisk/stasis_endpoints.h"
 #include "asterisk/stringfields.h"
@@ -168,6 +169,7 @@ struct ast_channel {
 	AST_VECTOR(, int) fds;				/*!< File descriptors for channel -- Drivers will poll on
 							 *   these file descriptors, so at least one must be non -1.
 							 *   See \arg \ref AstFileDesc */
+	unsigned int fd_generation;			/*!< Changed, to a value unique among channels, whenever fds changes */
 	int softhangup;				/*!< Whether or not we have been hung up...  Do not set this value
 							 *   directly, use ast_softhangup() */
 	int fdno;					/*!< Which fd had an event detected on */
@@ -210,6 +212,7 @@ struct ast_channel {
 	char macroexten[AST_MAX_EXTENSION];		/*!< Macro: Current non-macro extension. See app_macro.c */
 	char unbridged;							/*!< non-zero if the bridge core needs to re-evaluate the current
 											 bridging technology which is in use by this channel's bridge. */
+	unsigned int unbridged_generation;		/*!< Bumped every time the unbridged flag is raised */
 	char is_t38_active;						/*!< non-zero if T.38 is active on this channel. */
 	char dtmf_digit_to_emulate;			/*!< Digit being emulated */
 	char sending_dtmf_digit;			/*!< Digit this channel is currently sending out. (zero if not sending) */
@@ -226,6 +229,7 @@ struct ast_channel {
 
 /*! \brief The monotonically increasing integer counter for channel uniqueids */
 static int uniqueint;
+static int fd_generations;
 
 /* ACCESSORS */
 
@@ -820,6 +824,7 @@ void ast_channel_callid_set(struct ast_channel *chan, ast_callid callid)
 void ast_channel_state_set(struct ast_channel *chan, enum ast_channel_state value)
 {
 	chan->state = value;
+	ast_pickup_index_update(chan);
 }
 void ast_channel_set_oldwriteformat(struct ast_channel *chan, struct ast_format *format)
 {
@@ -1028,6 +1033,9 @@ int ast_channel_unbridged(struct ast_channel *chan)
 void ast_channel_set_unbridged_nolock(struct ast_channel *chan, int value)
 {
 	chan->unbridged = !!value;
+	if (value) {
+		chan->unbridged_generation++;
+	}
 	ast_queue_frame(chan, &ast_null_frame);
 }
 
@@ -1038,6 +1046,11 @@ void ast_channel_set_unbridged(struct ast_channel *chan, int value)
 	ast_channel_unlock(chan);
 }
 
+unsigned int ast_channel_unbridged_generation(struct ast_channel *chan)
+{
+	return chan->unbridged_generation;
+}
+
 int ast_channel_is_t38_active_nolock(struct ast_channel *chan)
 {
 	return chan->is_t38_active;
@@ -1078,6 +1091,7 @@ ast_group_t ast_channel_callgroup(const struct ast_channel *chan)
 void ast_channel_callgroup_set(struct ast_channel *chan, ast_group_t value)
 {
 	chan->callgroup = value;
+	ast_pickup_index_update(chan);
 }
 ast_group_t ast_channel_pickupgroup(const struct ast_channel *chan)
 {
@@ -1095,6 +1109,7 @@ void ast_channel_named_callgroups_set(struct ast_channel *chan, struct ast_named
 {
 	ast_unref_namedgroups(chan->named_callgroups);
 	chan->named_callgroups = ast_ref_namedgroups(value);
+	ast_pickup_index_update(chan);
 }
 struct ast_namedgroups *ast_channel_named_pickupgroups(const struct ast_channel *chan)
 {
@@ -1152,9 +1167,17 @@ int ast_channel_internal_alert_readfd(struct ast_channel *chan)
 	return ast_alertpipe_readfd(chan->alertpipe);
 }
 
+/*! \brief Note that the file descriptors of a channel changed */
+static void channel_fds_changed(struct ast_channel *chan)
+{
+	chan->fd_generation = ast_atomic_fetchadd_int(&fd_generations, 1) + 1;
+}
+
 void ast_channel_internal_alertpipe_swap(struct ast_channel *chan1, struct ast_channel *chan2)
 {
 	ast_alertpipe_swap(chan1->alertpipe, chan2->alertpipe);
+	channel_fds_changed(chan1);
+	channel_fds_changed(chan2);
 }
 
 /* file descriptor array accessors */
@@ -1162,6 +1185,8 @@ void ast_channel_internal_fd_set(struct ast_channel *chan, int which, int value)
 {
 	int pos;
 
+	channel_fds_changed(chan);
+
 	/* This ensures that if the vector has to grow with unused positions they will be
 	 * initialized to -1.
 	 */
@@ -1177,10 +1202,12 @@ void ast_channel_internal_fd_clear(struct ast_channel *chan, int which)
 		return;
 	}
 
+	channel_fds_changed(chan);
 	AST_VECTOR_REPLACE(&chan->fds, which, -1);
 }
 void ast_channel_internal_fd_clear_all(struct ast_channel *chan)
 {
+	channel_fds_changed(chan);
 	AST_VECTOR_RESET(&chan->fds, AST_VECTOR_ELEM_CLEANUP_NOOP);
 }
 int ast_channel_fd(const struct ast_channel *chan, int which)
@@ -1197,6 +1224,11 @@ int ast_channel_fd_count(const struct ast_channel *chan)
 	return AST_VECTOR_SIZE(&chan->fds);
 }
 
+unsigned int ast_channel_fd_generation(const struct ast_channel *chan)
+{
+	return chan->fd_generation;
+}
+
 int ast_channel_fd_add(struct ast_channel *chan, int value)
 {
 	int pos = AST_EXTENDED_FDS;
@@ -1205,6 +1237,7 @@ int ast_channel_fd_add(struct ast_channel *chan, int value)
 		pos += 1;
 	}
 
+	channel_fds_changed(chan);
 	AST_VECTOR_REPLACE(&chan->fds, pos, value);
 
 	return pos;
@@ -1375,6 +1408,7 @@ struct ast_channel *__ast_channel_internal_alloc(void (*destructor)(void *obj),
 	}
 
 	AST_VECTOR_INIT(&tmp->fds, AST_MAX_FDS);
+	channel_fds_changed(tmp);
 
 	/* Force all channel snapshot segments to be created on first use, so we don't have to check if
 	 * an old snapshot exists.
@@ -1486,6 +1520,10 @@ void ast_channel_internal_cleanup(struct ast_channel *chan)
 
 	ast_channel_internal_set_stream_topology(chan, NULL);
 
+	/* Dropped here rather than through the setters, which would update the pickup index */
+	chan->named_callgroups = ast_unref_namedgroups(chan->named_callgroups);
+	chan->named_pickupgroups = ast_unref_namedgroups(chan->named_pickupgroups);
+
 	AST_VECTOR_FREE(&chan->fds);
 }
 
@@ -1501,34 +1539,27 @@ int ast_channel_internal_is_finalized(struct ast_channel *chan)
 
 struct stasis_topic *ast_channel_topic(struct ast_channel *chan)
 {
-	if (!chan) {
+	if (!chan || !chan->topic) {
 		return ast_channel_topic_all();
 	}
 
 	return chan->topic;
 }
 
-int ast_channel_forward_endpoint(struct ast_channel *chan,
-	struct ast_endpoint *endpoint)
-{
-	ast_assert(chan != NULL);
-	ast_assert(endpoint != NULL);
-
-	chan->endpoint_forward =
-		stasis_forward_all(ast_channel_topic(chan),
-			ast_endpoint_topic(endpoint));
-	if (!chan->endpoint_forward) {
-		return -1;
-	}
-
-	return 0;
-}
-
-int ast_channel_internal_setup_topics(struct ast_channel *chan)
+/*!
+ * \internal
+ * \brief Create the topic of a channel and forward it to the all channels topic
+ *
+ * Publishers read the topic without the channel locked, so it is only
+ * stored once the forward is in place.
+ *
+ * \pre chan is locked
+ */
+static int channel_setup_topics(struct ast_channel *chan)
 {
+	struct stasis_topic *topic;
 	char *topic_name;
 	int ret;
-	ast_assert(chan->topic == NULL);
 
 	if (ast_strlen_zero(chan->uniqueid.unique_id)) {
 		static int dummy_id;
@@ -1541,17 +1572,56 @@ int ast_channel_internal_setup_topics(struct ast_channel *chan)
 		return -1;
 	}
 
-	chan->topic = stasis_topic_create(topic_name);
+	topic = stasis_topic_create(topic_name);
 	ast_free(topic_name);
-	if (!chan->topic) {
+	if (!topic) {
 		return -1;
 	}
 
-	chan->channel_forward = stasis_forward_all(ast_channel_topic(chan),
-		ast_channel_topic_all());
+	chan->channel_forward = stasis_forward_all(topic, ast_channel_topic_all());
 	if (!chan->channel_forward) {
-		ao2_ref(chan->topic, -1);
-		chan->topic = NULL;
+		ao2_ref(topic, -1);
+		return -1;
+	}
+	chan->topic = topic;
+
+	return 0;
+}
+
+struct stasis_topic *ast_channel_own_topic(struct ast_channel *chan)
+{
+	struct stasis_topic *topic;
+
+	if (!chan) {
+		return ast_channel_topic_all();
+	}
+
+	ast_channel_lock(chan);
+	if (!chan->topic) {
+		channel_setup_topics(chan);
+	}
+	topic = chan->topic;
+	ast_channel_unlock(chan);
+
+	return topic;
+}
+
+int ast_channel_forward_endpoint(struct ast_channel *chan,
+	struct ast_endpoint *endpoint)
+{
+	struct stasis_topic *topic;
+
+	ast_assert(chan != NULL);
+	ast_assert(endpoint != NULL);
+
+	topic = ast_channel_own_topic(chan);
+	if (!topic) {
+		return -1;
+	}
+
+	chan->endpoint_forward =
+		stasis_forward_all(topic, ast_endpoint_topic(endpoint));
+	if (!chan->endpoint_forward) {
 		return -1;
 	}
 
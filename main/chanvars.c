@@ -33,6 +33,36 @@
 #include "asterisk/strings.h"
 #include "asterisk/utils.h"
 
+/*! Variable count at which an indexed list starts using hash buckets */
+#define VAR_INDEX_MIN_VARS 8
+/*! Smallest bucket table size of an indexed list as a power of two */
+#define VAR_INDEX_MIN_BITS 5
+
+/*!
+ * \brief Name index of a variable list.
+ *
+ * \details
+ * Each bucket chains the variables of the list whose names hash to it
+ * in list order, so the first match in a chain is the first match in
+ * the list.  The list ends are remembered to catch code that added or
+ * removed a variable at an end of an indexed list without the
+ * AST_VAR_LIST_* helpers.  Searches then scan the list, and the next
+ * change through the helpers rebuilds the index.  Changes elsewhere in
+ * the list are not caught, so the helpers must be used.
+ */
+struct ast_var_index {
+	/*! Bucket table, NULL while the list is short enough to scan */
+	struct ast_var_t **buckets;
+	/*! Number of variables in the list */
+	unsigned int count;
+	/*! Bucket table size as a power of two */
+	unsigned int bits;
+	/*! List head the index was last synchronized with */
+	struct ast_var_t *first;
+	/*! List tail the index was last synchronized with */
+	struct ast_var_t *last;
+};
+
 struct ast_var_t *_ast_var_assign(const char *name, const char *value, const char *file, int lineno, const char *function)
 {
 	struct ast_var_t *var;
@@ -94,6 +124,185 @@ char *ast_var_find(const struct varshead *head, const char *name)
 	return NULL;
 }
 
+static unsigned int var_index_bucket(const struct ast_var_index *index, const char *name)
+{
+	/* Use the high bits of a multiplicative hash since the string hash mixes its low bits poorly. */
+	return ((unsigned int) ast_str_hash(name) * 2654435761U) >> (32 - index->bits);
+}
+
+/*!
+ * \internal
+ * \brief Rebuild the index of a list from the list contents.
+ *
+ * \note On allocation failure the buckets are dropped and lookups scan the list.
+ */
+static void var_index_rebuild(struct varshead *head)
+{
+	struct ast_var_index *index = head->index;
+	struct ast_var_t *var;
+	unsigned int count = 0;
+	unsigned int bits = VAR_INDEX_MIN_BITS;
+
+	AST_LIST_TRAVERSE(head, var, entries) {
+		++count;
+	}
+	index->count = count;
+	index->first = head->first;
+	index->last = head->last;
+
+	ast_free(index->buckets);
+	index->buckets = NULL;
+	if (count < VAR_INDEX_MIN_VARS) {
+		return;
+	}
+
+	while ((1U << bits) < count) {
+		++bits;
+	}
+	index->buckets = ast_calloc(1U << bits, sizeof(*index->buckets));
+	if (!index->buckets) {
+		return;
+	}
+	index->bits = bits;
+
+	AST_LIST_TRAVERSE(head, var, entries) {
+		struct ast_var_t **next = &index->buckets[var_index_bucket(index, ast_var_name(var))];
+
+		while (*next) {
+			next = &(*next)->index_next;
+		}
+		var->index_next = NULL;
+		*next = var;
+	}
+}
+
+int ast_var_list_index_enable(struct varshead *head)
+{
+	if (head->index) {
+		return 0;
+	}
+
+	head->index = ast_calloc(1, sizeof(*head->index));
+	if (!head->index) {
+		return -1;
+	}
+	var_index_rebuild(head);
+
+	return 0;
+}
+
+void ast_var_list_index_disable(struct varshead *head)
+{
+	if (!head->index) {
+		return;
+	}
+
+	ast_free(head->index->buckets);
+	ast_free(head->index);
+	head->index = NULL;
+}
+
+void ast_var_list_index_insert(struct varshead *head, struct ast_var_t *var, int at_head)
+{
+	struct ast_var_index *index = head->index;
+	struct ast_var_t **next;
+
+	if (!index) {
+		return;
+	}
+
+	if (at_head
+		? (var->entries.next != index->first || (index->last && head->last != index->last))
+		: (head->first != (index->first ? index->first : var)
+			|| (index->last && index->last->entries.next != var))) {
+		/* The list was modified behind our back. */
+		var_index_rebuild(head);
+		return;
+	}
+
+	++index->count;
+	index->first = head->first;
+	index->last = head->last;
+	if (!index->buckets || (1U << index->bits) < index->count) {
+		/* Create or grow the bucket table once the list outgrows it. */
+		if (index->count >= VAR_INDEX_MIN_VARS) {
+			var_index_rebuild(head);
+		}
+		return;
+	}
+
+	next = &index->buckets[var_index_bucket(index, ast_var_name(var))];
+	if (!at_head) {
+		while (*next) {
+			next = &(*next)->index_next;
+		}
+	}
+	var->index_next = *next;
+	*next = var;
+}
+
+void ast_var_list_index_remove(struct varshead *head, struct ast_var_t *var)
+{
+	struct ast_var_index *index = head->index;
+	struct ast_var_t **next;
+
+	if (!index) {
+		return;
+	}
+
+	if ((index->first != var && head->first != index->first)
+		|| (index->last != var && head->last != index->last)) {
+		/* The list was modified behind our back. */
+		var_index_rebuild(head);
+		return;
+	}
+
+	--index->count;
+	index->first = head->first;
+	index->last = head->last;
+	if (!index->buckets) {
+		return;
+	}
+
+	for (next = &index->buckets[var_index_bucket(index, ast_var_name(var))]; *next; next = &(*next)->index_next) {
+		if (*next == var) {
+			*next = var->index_next;
+			var->index_next = NULL;
+			return;
+		}
+	}
+
+	/* The variable was not indexed so the index is stale. */
+	var_index_rebuild(head);
+}
+
+struct ast_var_t *ast_var_list_search(struct varshead *head, const char *name)
+{
+	struct ast_var_index *index = head->index;
+	struct ast_var_t *var;
+
+	/*
+	 * Searches may run with the list only read locked so a stale index
+	 * is not rebuilt here.  The list is scanned instead.
+	 */
+	if (!index || !index->buckets
+		|| index->first != head->first || index->last != head->last) {
+		AST_LIST_TRAVERSE(head, var, entries) {
+			if (!strcmp(ast_var_name(var), name)) {
+				return var;
+			}
+		}
+		return NULL;
+	}
+
+	for (var = index->buckets[var_index_bucket(index, name)]; var; var = var->index_next) {
+		if (!strcmp(ast_var_name(var), name)) {
+			return var;
+		}
+	}
+	return NULL;
+}
+
 struct varshead *ast_var_list_create(void)
 {
 	struct varshead *head;
@@ -118,6 +327,7 @@ void ast_var_list_destroy(struct varshead *head)
 		ast_var_delete(var);
 	}
 
+	ast_var_list_index_disable(head);
 	ast_free(head);
 }
 
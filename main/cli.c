@@ -854,8 +854,8 @@ static char *handle_unload(struct ast_cli_entry *e, int cmd, struct ast_cli_args
 	return CLI_SUCCESS;
 }
 
-#define MODLIST_FORMAT  "%-30s %-40.40s %-10d %-11s %13s\n"
-#define MODLIST_FORMAT2 "%-30s %-40.40s %-10s %-11s %13s\n"
+#define MODLIST_FORMAT  "%-30s %-40.40s %-10d %-11s %13s %11s\n"
+#define MODLIST_FORMAT2 "%-30s %-40.40s %-10s %-11s %13s %11s\n"
 
 AST_MUTEX_DEFINE_STATIC(climodentrylock);
 static int climodentryfd = -1;
@@ -866,8 +866,15 @@ static int modlist_modentry(const char *module, const char *description,
 {
 	/* Comparing the like with the module */
 	if (strcasestr(module, like) ) {
+		int64_t load_time = ast_module_load_time(module);
+		char load_time_str[32] = "-";
+
+		if (load_time >= 0) {
+			snprintf(load_time_str, sizeof(load_time_str), "%" PRId64 ".%03" PRId64 "ms",
+				load_time / 1000, load_time % 1000);
+		}
 		ast_cli(climodentryfd, MODLIST_FORMAT, module, description, usecnt,
-				status, ast_module_support_level_to_string(support_level));
+				status, ast_module_support_level_to_string(support_level), load_time_str);
 		return 1;
 	}
 	return 0;
@@ -977,7 +984,8 @@ static char *handle_modlist(struct ast_cli_entry *e, int cmd, struct ast_cli_arg
 		e->command = "module show [like]";
 		e->usage =
 			"Usage: module show [like keyword]\n"
-			"       Shows Asterisk modules currently in use, and usage statistics.\n";
+			"       Shows Asterisk modules currently in use, and usage statistics.\n"
+			"       Load Time is how long the module took to start.\n";
 		return NULL;
 
 	case CLI_GENERATE:
@@ -999,7 +1007,7 @@ static char *handle_modlist(struct ast_cli_entry *e, int cmd, struct ast_cli_arg
 
 	ast_mutex_lock(&climodentrylock);
 	climodentryfd = a->fd; /* global, protected by climodentrylock */
-	ast_cli(a->fd, MODLIST_FORMAT2, "Module", "Description", "Use Count", "Status", "Support Level");
+	ast_cli(a->fd, MODLIST_FORMAT2, "Module", "Description", "Use Count", "Status", "Support Level", "Load Time");
 	ast_cli(a->fd,"%d modules loaded\n", ast_update_module_list(modlist_modentry, like));
 	climodentryfd = -1;
 	ast_mutex_unlock(&climodentrylock);
@@ -2300,6 +2308,166 @@ static char *is_prefix(const char *word, const char *token,
 	return NULL;
 }
 
+/*! Number of buckets of the index of the first words of the commands */
+#define CLI_WORD_BUCKETS 257
+
+/*! \brief The entries of the commands starting with a word, in list order */
+struct cli_word_entries {
+	AST_VECTOR(, struct ast_cli_entry *) entries;
+	char word[0];
+};
+
+/*!
+ * \brief The entries of the commands by their first word
+ *
+ * Only commands whose first word is a plain word are in the index.  While
+ * there is any other command, or if the index could not be kept up to
+ * date, lookups walk the whole list.  Protected by the helpers lock.
+ */
+static struct ao2_container *cli_words;
+
+/*! \brief Number of commands not in the index */
+static int cli_unindexed_entries;
+
+/*! \brief Whether the index failed to be updated */
+static int cli_words_broken;
+
+static int cli_word_entries_hash(const void *obj, const int flags)
+{
+	const struct cli_word_entries *entries = obj;
+
+	return ast_str_case_hash(flags & OBJ_SEARCH_KEY ? obj : entries->word);
+}
+
+static int cli_word_entries_cmp(void *obj, void *arg, int flags)
+{
+	const struct cli_word_entries *entries = obj;
+	const struct cli_word_entries *other = arg;
+
+	return strcasecmp(entries->word, flags & OBJ_SEARCH_KEY ? arg : other->word) ? 0 : CMP_MATCH;
+}
+
+static void cli_word_entries_destroy(void *obj)
+{
+	struct cli_word_entries *entries = obj;
+
+	AST_VECTOR_FREE(&entries->entries);
+}
+
+static int cli_entry_indexed(struct ast_cli_entry *e)
+{
+	return !ast_strlen_zero(e->cmda[0]) && !strchr(cli_rsvd, e->cmda[0][0]);
+}
+
+/*!
+ * \internal
+ * \brief Rebuild the index of the commands starting with a word
+ *
+ * \note The helpers list must be write locked.
+ */
+static void cli_index_word(const char *word)
+{
+	struct cli_word_entries *entries;
+	struct ast_cli_entry *e = NULL;
+
+	if (!cli_words) {
+		cli_words = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, CLI_WORD_BUCKETS,
+			cli_word_entries_hash, NULL, cli_word_entries_cmp);
+		if (!cli_words) {
+			cli_words_broken = 1;
+			return;
+		}
+	}
+
+	ao2_find(cli_words, word, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+
+	entries = ao2_alloc_options(sizeof(*entries) + strlen(word) + 1, cli_word_entries_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entries || AST_VECTOR_INIT(&entries->entries, 1)) {
+		ao2_cleanup(entries);
+		cli_words_broken = 1;
+		return;
+	}
+	strcpy(entries->word, word); /* Safe */
+
+	while ((e = cli_next(e))) {
+		if (cli_entry_indexed(e) && !strcasecmp(e->cmda[0], word)
+			&& AST_VECTOR_APPEND(&entries->entries, e)) {
+			cli_words_broken = 1;
+		}
+	}
+
+	if (AST_VECTOR_SIZE(&entries->entries)) {
+		ao2_link(cli_words, entries);
+	}
+	ao2_ref(entries, -1);
+}
+
+/*!
+ * \internal
+ * \brief Update the index for an entry added to or removed from the list
+ *
+ * \note The helpers list must be write locked.
+ */
+static void cli_index_entry(struct ast_cli_entry *e, int added)
+{
+	if (cli_entry_indexed(e)) {
+		cli_index_word(e->cmda[0]);
+	} else {
+		cli_unindexed_entries += added ? 1 : -1;
+	}
+}
+
+/*! \brief Walks the entries of the commands that can start with a word, in list order */
+struct cli_iterator {
+	/*! The indexed entries, NULL to walk the whole list */
+	struct cli_word_entries *entries;
+	/*! Position in the indexed entries */
+	int i;
+	/*! The last entry returned, when walking the whole list */
+	struct ast_cli_entry *e;
+	/*! Set if there are no such entries */
+	unsigned int none:1;
+};
+
+/*!
+ * \internal
+ * \brief Start walking the entries of the commands that can start with word
+ *
+ * \param word The first word, NULL to walk all entries
+ *
+ * \note The helpers list must be locked while walking.
+ */
+static void cli_iterator_init(struct cli_iterator *iter, const char *word)
+{
+	memset(iter, 0, sizeof(*iter));
+
+	if (ast_strlen_zero(word) || !cli_words || cli_words_broken || cli_unindexed_entries) {
+		return;
+	}
+
+	iter->entries = ao2_find(cli_words, word, OBJ_SEARCH_KEY);
+	iter->none = !iter->entries;
+}
+
+static struct ast_cli_entry *cli_iterator_next(struct cli_iterator *iter)
+{
+	if (iter->none) {
+		return NULL;
+	} else if (!iter->entries) {
+		return iter->e = cli_next(iter->e);
+	} else if (iter->i < AST_VECTOR_SIZE(&iter->entries->entries)) {
+		return AST_VECTOR_GET(&iter->entries->entries, iter->i++);
+	}
+
+	return NULL;
+}
+
+static void cli_iterator_destroy(struct cli_iterator *iter)
+{
+	ao2_cleanup(iter->entries);
+}
+
 /*!
  * \internal
  * \brief locate a cli command in the 'helpers' list (which must be locked).
@@ -2317,8 +2485,12 @@ static struct ast_cli_entry *find_cli(const char * const cmds[], int match_type)
 {
 	int matchlen = -1;	/* length of longest match so far */
 	struct ast_cli_entry *cand = NULL, *e=NULL;
+	struct cli_iterator iter;
 
-	while ( (e = cli_next(e)) ) {
+	/* Unless a mismatch on the last word is allowed, only entries
+	 * starting with the first word can match */
+	cli_iterator_init(&iter, match_type != -1 ? cmds[0] : NULL);
+	while ( (e = cli_iterator_next(&iter)) ) {
 		/* word-by word regexp comparison */
 		const char * const *src = cmds;
 		const char * const *dst = e->cmda;
@@ -2353,6 +2525,7 @@ static struct ast_cli_entry *find_cli(const char * const cmds[], int match_type)
 			cand = e;
 		}
 	}
+	cli_iterator_destroy(&iter);
 
 	return e ? e : cand;
 }
@@ -2400,7 +2573,9 @@ int ast_cli_unregister(struct ast_cli_entry *e)
 		ast_log(LOG_WARNING, "Can't remove command that is in use\n");
 	} else {
 		AST_RWLIST_WRLOCK(&helpers);
-		AST_RWLIST_REMOVE(&helpers, e, list);
+		if (AST_RWLIST_REMOVE(&helpers, e, list)) {
+			cli_index_entry(e, 0);
+		}
 		AST_RWLIST_UNLOCK(&helpers);
 		remove_shutdown_command(e);
 		ast_free(e->_full_cmd);
@@ -2479,6 +2654,7 @@ int __ast_cli_register(struct ast_cli_entry *e, struct ast_module *module)
 
 	if (!cur)
 		AST_RWLIST_INSERT_TAIL(&helpers, e, list);
+	cli_index_entry(e, 1);
 	ret = 0;	/* success */
 
 done:
@@ -2835,6 +3011,7 @@ static char *__ast_cli_generator(const char *text, const char *word, int state,
 	char *ret = NULL;
 	char matchstr[80] = "";
 	int tws = 0;
+	struct cli_iterator iter;
 	/* Split the argument into an array of words */
 	char *duplicate = parse_args(text, &x, argv, ARRAY_LEN(argv), &tws);
 
@@ -2854,7 +3031,9 @@ static char *__ast_cli_generator(const char *text, const char *word, int state,
 	}
 	if (lock)
 		AST_RWLIST_RDLOCK(&helpers);
-	while ( (e = cli_next(e)) ) {
+	/* Past the first word only the entries starting with it can match */
+	cli_iterator_init(&iter, argindex > 0 ? argv[0] : NULL);
+	while ( (e = cli_iterator_next(&iter)) ) {
 		/* XXX repeated code */
 		int src = 0, dst = 0, n = 0;
 
@@ -2908,6 +3087,7 @@ static char *__ast_cli_generator(const char *text, const char *word, int state,
 				break;
 		}
 	}
+	cli_iterator_destroy(&iter);
 	if (lock)
 		AST_RWLIST_UNLOCK(&helpers);
 	ast_free(duplicate);
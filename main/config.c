@@ -58,6 +58,7 @@
 #include "asterisk/strings.h"	/* for the ast_str_*() API */
 #include "asterisk/netsock2.h"
 #include "asterisk/module.h"
+#include "asterisk/vector.h"
 
 #define MAX_NESTED_COMMENTS 128
 #define COMMENT_START ";--"
@@ -114,6 +115,57 @@ struct cache_file_mtime {
 /*! Cached file mtime list. */
 static AST_LIST_HEAD_STATIC(cfmtime_head, cache_file_mtime);
 
+enum config_parse_source_type {
+	/*! Name passed to ast_config_internal_load() */
+	CONFIG_PARSE_SOURCE_LOAD,
+	/*! Filename or wildcard pattern expanded by glob() */
+	CONFIG_PARSE_SOURCE_GLOB,
+	/*! File found by glob() */
+	CONFIG_PARSE_SOURCE_FILE,
+};
+
+/*! \brief Something a cached parse result depends on */
+struct config_parse_source {
+	AST_LIST_ENTRY(config_parse_source) list;
+	enum config_parse_source_type type;
+	/*!
+	 * \brief stat() data and includes of a file.
+	 * \note NULL for a file that did not exist or was not a regular file.
+	 */
+	struct cache_file_mtime *cfmtime;
+	/*! Newline separated glob() matches of a pattern. */
+	char *matches;
+	/*! Load name, pattern or filename. */
+	char name[0];
+};
+
+/*!
+ * \brief Parsed configuration shared between everyone loading the same file.
+ *
+ * \details
+ * Many modules load the same file, e.g. every sorcery object type
+ * mapped to pjsip.conf.  The first load only records the files the
+ * result was built from.  If a second load finds them unchanged the
+ * result is kept and later loads get a copy of it instead of parsing
+ * the files again.
+ */
+struct config_parse_cache {
+	/*! Everything the parse result depends on, in parse order. */
+	AST_LIST_HEAD_NOLOCK(, config_parse_source) sources;
+	/*! Parse result to copy, never handed out itself. */
+	struct ast_config *cfg;
+	/*! Set if the parse result cannot be reused (#exec, realtime). */
+	unsigned int uncacheable:1;
+	/*! Name of the file as passed to ast_config_load2(). */
+	char filename[0];
+};
+
+/*! Number of buckets in the parse cache container. */
+#define CONFIG_PARSE_CACHE_BUCKETS 53
+
+/*! Cached parse results by filename. */
+static struct ao2_container *config_parse_caches;
+
 static int init_appendbuf(void *data)
 {
 	struct ast_str **str = data;
@@ -199,6 +251,8 @@ static int hashtab_compare_strings(void *a, void *b, int flags)
 static struct ast_config_map {
 	struct ast_config_map *next;
 	int priority;
+	/*! Seconds lookup results for the family are cached, 0 to not cache. */
+	int cache_ttl;
 	/*! Stored in stuff[] at struct end. */
 	const char *name;
 	/*! Stored in stuff[] at struct end. */
@@ -256,6 +310,7 @@ struct ast_config {
 	int include_level;
 	int max_include_level;
 	struct ast_config_include *includes;  /*!< a list of inclusions, which should describe the entire tree */
+	struct config_parse_cache *parse_cache; /*!< Records where the config is parsed from while loading */
 };
 
 struct ast_config_include {
@@ -1731,6 +1786,157 @@ static void config_cache_attribute(const char *configfile, enum config_cache_att
 	AST_LIST_UNLOCK(&cfmtime_head);
 }
 
+/*!
+ * \internal
+ * \brief Record something a parse result depends on.
+ *
+ * \param parse_cache Parse cache entry being built.
+ * \param type Type of source.
+ * \param name Load name, pattern or filename.
+ *
+ * \retval source on success.
+ * \retval NULL on error.  The parse result is then not cached.
+ */
+static struct config_parse_source *config_parse_source_add(struct config_parse_cache *parse_cache,
+	enum config_parse_source_type type, const char *name)
+{
+	struct config_parse_source *source;
+
+	source = ast_calloc(1, sizeof(*source) + strlen(name) + 1);
+	if (!source) {
+		parse_cache->uncacheable = 1;
+		return NULL;
+	}
+	source->type = type;
+	strcpy(source->name, name); /* Safe */
+	AST_LIST_INSERT_TAIL(&parse_cache->sources, source, list);
+
+	return source;
+}
+
+/*!
+ * \internal
+ * \brief Join the matches of a glob() into a newline separated string.
+ *
+ * \param globbuf Expanded glob.
+ *
+ * \retval matches on success.  Must be freed with ast_free().
+ * \retval NULL on error.
+ */
+static char *config_parse_glob_matches(const glob_t *globbuf)
+{
+	struct ast_str *matches;
+	char *joined;
+	int i;
+
+	matches = ast_str_create(128);
+	if (!matches) {
+		return NULL;
+	}
+	for (i = 0; i < globbuf->gl_pathc; i++) {
+		ast_str_append(&matches, 0, "%s\n", globbuf->gl_pathv[i]);
+	}
+	joined = ast_strdup(ast_str_buffer(matches));
+	ast_free(matches);
+
+	return joined;
+}
+
+/*!
+ * \internal
+ * \brief Record the expansion of a filename or wildcard pattern.
+ *
+ * \param parse_cache Parse cache entry being built.
+ * \param pattern Pattern passed to glob().
+ * \param globbuf Expanded glob.
+ *
+ * \return Nothing
+ */
+static void config_parse_record_glob(struct config_parse_cache *parse_cache,
+	const char *pattern, const glob_t *globbuf)
+{
+	struct config_parse_source *source;
+
+	source = config_parse_source_add(parse_cache, CONFIG_PARSE_SOURCE_GLOB, pattern);
+	if (!source) {
+		return;
+	}
+	source->matches = config_parse_glob_matches(globbuf);
+	if (!source->matches) {
+		parse_cache->uncacheable = 1;
+	}
+}
+
+/*!
+ * \internal
+ * \brief Record a file the parse result is read from.
+ *
+ * \param parse_cache Parse cache entry being built.
+ * \param filename Full path of the file.
+ * \param statbuf stat() data of the file or NULL if it is missing.
+ *
+ * \return Nothing
+ */
+static void config_parse_record_file(struct config_parse_cache *parse_cache,
+	const char *filename, struct stat *statbuf)
+{
+	struct config_parse_source *source;
+
+	source = config_parse_source_add(parse_cache, CONFIG_PARSE_SOURCE_FILE, filename);
+	if (!source || !statbuf) {
+		return;
+	}
+	source->cfmtime = cfmtime_new(filename, "");
+	if (!source->cfmtime) {
+		parse_cache->uncacheable = 1;
+		return;
+	}
+	cfmstat_save(source->cfmtime, statbuf);
+}
+
+/*!
+ * \internal
+ * \brief Record an include found while parsing a file.
+ *
+ * \param parse_cache Parse cache entry being built.
+ * \param configfile File containing the include.
+ * \param include Filename or wildcard pattern included.
+ *
+ * \return Nothing
+ */
+static void config_parse_record_include(struct config_parse_cache *parse_cache,
+	const char *configfile, const char *include)
+{
+	struct config_parse_source *source;
+	struct config_parse_source *found = NULL;
+	struct cache_file_include *cfinclude;
+
+	/* The file with the include is the last one of that name read. */
+	AST_LIST_TRAVERSE(&parse_cache->sources, source, list) {
+		if (source->type == CONFIG_PARSE_SOURCE_FILE && source->cfmtime
+			&& !strcmp(source->name, configfile)) {
+			found = source;
+		}
+	}
+	if (!found) {
+		parse_cache->uncacheable = 1;
+		return;
+	}
+
+	AST_LIST_TRAVERSE(&found->cfmtime->includes, cfinclude, list) {
+		if (!strcmp(cfinclude->include, include)) {
+			return;
+		}
+	}
+	cfinclude = ast_calloc(1, sizeof(*cfinclude) + strlen(include) + 1);
+	if (!cfinclude) {
+		parse_cache->uncacheable = 1;
+		return;
+	}
+	strcpy(cfinclude->include, include); /* Safe */
+	AST_LIST_INSERT_TAIL(&found->cfmtime->includes, cfinclude, list);
+}
+
 /*! \brief parse one line in the configuration.
  * \verbatim
  * We can have a category header	[foo](...)
@@ -1925,6 +2131,10 @@ static int process_text_line(struct ast_config *cfg, struct ast_category **cat,
 
 			if (!ast_test_flag(&flags, CONFIG_FLAG_NOCACHE))
 				config_cache_attribute(configfile, ATTRIBUTE_EXEC, NULL, who_asked);
+			if (cfg->parse_cache) {
+				/* The output of the command can change at any time. */
+				cfg->parse_cache->uncacheable = 1;
+			}
 			snprintf(exec_file, sizeof(exec_file), "/var/tmp/exec.%d%d.%ld", (int)now.tv_sec, (int)now.tv_usec, (long)pthread_self());
 			if (snprintf(cmd, sizeof(cmd), "%s > %s 2>&1", cur, exec_file) >= sizeof(cmd)) {
 				ast_log(LOG_ERROR, "Failed to construct command string to execute %s.\n", cur);
@@ -1936,6 +2146,9 @@ static int process_text_line(struct ast_config *cfg, struct ast_category **cat,
 		} else {
 			if (!ast_test_flag(&flags, CONFIG_FLAG_NOCACHE))
 				config_cache_attribute(configfile, ATTRIBUTE_INCLUDE, cur, who_asked);
+			if (cfg->parse_cache) {
+				config_parse_record_include(cfg->parse_cache, configfile, cur);
+			}
 			exec_file[0] = '\0';
 		}
 		/* A #include */
@@ -2088,6 +2301,9 @@ static struct ast_config *config_text_file_load(const char *database, const char
 
 	globbuf.gl_offs = 0;	/* initialize it to silence gcc */
 	glob_ret = glob(fn, MY_GLOB_FLAGS, NULL, &globbuf);
+	if (glob_ret && cfg && cfg->parse_cache) {
+		cfg->parse_cache->uncacheable = 1;
+	}
 	if (glob_ret == GLOB_NOSPACE) {
 		ast_log(LOG_WARNING,
 			"Glob Expansion of pattern '%s' failed: Not enough memory\n", fn);
@@ -2111,6 +2327,9 @@ static struct ast_config *config_text_file_load(const char *database, const char
 			ast_free(lline_buffer);
 			return NULL;
 		}
+		if (cfg && cfg->parse_cache) {
+			config_parse_record_glob(cfg->parse_cache, fn, &globbuf);
+		}
 		for (i=0; i<globbuf.gl_pathc; i++) {
 			ast_copy_string(fn, globbuf.gl_pathv[i], sizeof(fn));
 
@@ -2124,6 +2343,9 @@ static struct ast_config *config_text_file_load(const char *database, const char
 					if (!ast_test_flag(&flags, CONFIG_FLAG_NOCACHE)) {
 						config_cache_remove(fn, who_asked);
 					}
+					if (cfg && cfg->parse_cache) {
+						config_parse_record_file(cfg->parse_cache, fn, NULL);
+					}
 					continue;
 				}
 
@@ -2132,6 +2354,9 @@ static struct ast_config *config_text_file_load(const char *database, const char
 					if (!ast_test_flag(&flags, CONFIG_FLAG_NOCACHE)) {
 						config_cache_remove(fn, who_asked);
 					}
+					if (cfg && cfg->parse_cache) {
+						config_parse_record_file(cfg->parse_cache, fn, NULL);
+					}
 					continue;
 				}
 
@@ -2196,9 +2421,16 @@ static struct ast_config *config_text_file_load(const char *database, const char
 					AST_LIST_UNLOCK(&cfmtime_head);
 				}
 
+				if (cfg->parse_cache) {
+					config_parse_record_file(cfg->parse_cache, fn, &statbuf);
+				}
+
 				if (!(f = fopen(fn, "r"))) {
 					ast_debug(1, "No file to parse: %s\n", fn);
 					ast_verb(2, "Parsing '%s': Not found (%s)\n", fn, strerror(errno));
+					if (cfg->parse_cache) {
+						cfg->parse_cache->uncacheable = 1;
+					}
 					continue;
 				}
 				count++;
@@ -2983,7 +3215,33 @@ static int reload_module(void)
 			ast_realtime_append_mapping(v->name, driver, database, table, pri);
 	}
 
+	for (v = ast_variable_browse(config, "cache"); v; v = v->next) {
+		struct ast_config_map *map;
+		int ttl;
+		int found = 0;
+
+		if (sscanf(v->value, "%30d", &ttl) != 1 || ttl < 0) {
+			ast_log(LOG_WARNING, "extconfig.conf: cache time '%s' for '%s' ignored, it must be a number of seconds\n",
+				v->value, v->name);
+			continue;
+		}
+
+		for (map = config_maps; map; map = map->next) {
+			if (!strcasecmp(v->name, map->name)) {
+				map->cache_ttl = ttl;
+				found = 1;
+			}
+		}
+		if (!found) {
+			ast_log(LOG_WARNING, "extconfig.conf: cache time for '%s' ignored, it has no realtime mapping\n", v->name);
+		}
+	}
+
 	ast_config_destroy(config);
+
+	/* Mappings and cache times may have changed, so start over */
+	ast_realtime_cache_flush(NULL);
+
 	return 0;
 }
 
@@ -3109,11 +3367,47 @@ fail:
 }
 
 
+/*!
+ * \internal
+ * \brief Find the config engine a file is loaded with.
+ *
+ * \param filename Config filename.
+ * \param flags Config load flags.
+ * \param db Buffer for the realtime database name.
+ * \param dbsiz Size of db.
+ * \param table Buffer for the realtime table name.
+ * \param tabsiz Size of table.
+ *
+ * \return The engine to load the file with.
+ */
+static struct ast_config_engine *config_loader_find(const char *filename, struct ast_flags flags,
+	char *db, int dbsiz, char *table, int tabsiz)
+{
+	struct ast_config_engine *loader = &text_file_engine;
+
+	if (!ast_test_flag(&flags, CONFIG_FLAG_NOREALTIME) && config_engine_list) {
+		struct ast_config_engine *eng;
+
+		eng = find_engine(filename, 1, db, dbsiz, table, tabsiz);
+
+
+		if (eng && eng->load_func) {
+			loader = eng;
+		} else {
+			eng = find_engine("global", 1, db, dbsiz, table, tabsiz);
+			if (eng && eng->load_func)
+				loader = eng;
+		}
+	}
+
+	return loader;
+}
+
 struct ast_config *ast_config_internal_load(const char *filename, struct ast_config *cfg, struct ast_flags flags, const char *suggested_include_file, const char *who_asked)
 {
 	char db[256];
 	char table[256];
-	struct ast_config_engine *loader = &text_file_engine;
+	struct ast_config_engine *loader;
 	struct ast_config *result;
 
 	/* The config file itself bumps include_level by 1 */
@@ -3124,18 +3418,11 @@ struct ast_config *ast_config_internal_load(const char *filename, struct ast_con
 
 	cfg->include_level++;
 
-	if (!ast_test_flag(&flags, CONFIG_FLAG_NOREALTIME) && config_engine_list) {
-		struct ast_config_engine *eng;
-
-		eng = find_engine(filename, 1, db, sizeof(db), table, sizeof(table));
-
-
-		if (eng && eng->load_func) {
-			loader = eng;
-		} else {
-			eng = find_engine("global", 1, db, sizeof(db), table, sizeof(table));
-			if (eng && eng->load_func)
-				loader = eng;
+	loader = config_loader_find(filename, flags, db, sizeof(db), table, sizeof(table));
+	if (cfg->parse_cache) {
+		config_parse_source_add(cfg->parse_cache, CONFIG_PARSE_SOURCE_LOAD, filename);
+		if (loader != &text_file_engine) {
+			cfg->parse_cache->uncacheable = 1;
 		}
 	}
 
@@ -3151,18 +3438,412 @@ struct ast_config *ast_config_internal_load(const char *filename, struct ast_con
 	return result;
 }
 
+static void config_parse_cache_destructor(void *obj)
+{
+	struct config_parse_cache *parse_cache = obj;
+	struct config_parse_source *source;
+
+	while ((source = AST_LIST_REMOVE_HEAD(&parse_cache->sources, list))) {
+		if (source->cfmtime) {
+			config_cache_destroy_entry(source->cfmtime);
+		}
+		ast_free(source->matches);
+		ast_free(source);
+	}
+	ast_config_destroy(parse_cache->cfg);
+}
+
+static struct config_parse_cache *config_parse_cache_alloc(const char *filename)
+{
+	struct config_parse_cache *parse_cache;
+
+	parse_cache = ao2_alloc_options(sizeof(*parse_cache) + strlen(filename) + 1,
+		config_parse_cache_destructor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (parse_cache) {
+		strcpy(parse_cache->filename, filename); /* Safe */
+	}
+
+	return parse_cache;
+}
+
+AO2_STRING_FIELD_HASH_FN(config_parse_cache, filename);
+AO2_STRING_FIELD_CMP_FN(config_parse_cache, filename);
+
+/*!
+ * \internal
+ * \brief Check if loading the file now would give the cached parse result.
+ *
+ * \param parse_cache Parse cache entry to check.
+ * \param flags Config load flags.
+ *
+ * \retval non-zero if everything the parse result depends on is unchanged.
+ */
+static int config_parse_cache_is_current(struct config_parse_cache *parse_cache, struct ast_flags flags)
+{
+	struct config_parse_source *source;
+	struct stat statbuf;
+	glob_t globbuf;
+	char db[256];
+	char table[256];
+	char *matches;
+	int current;
+
+	AST_LIST_TRAVERSE(&parse_cache->sources, source, list) {
+		switch (source->type) {
+		case CONFIG_PARSE_SOURCE_LOAD:
+			if (config_loader_find(source->name, flags, db, sizeof(db), table, sizeof(table))
+				!= &text_file_engine) {
+				return 0;
+			}
+			break;
+		case CONFIG_PARSE_SOURCE_GLOB:
+			globbuf.gl_offs = 0;
+			if (glob(source->name, MY_GLOB_FLAGS, NULL, &globbuf)) {
+				return 0;
+			}
+			matches = config_parse_glob_matches(&globbuf);
+			globfree(&globbuf);
+			current = matches && !strcmp(matches, source->matches);
+			ast_free(matches);
+			if (!current) {
+				return 0;
+			}
+			break;
+		case CONFIG_PARSE_SOURCE_FILE:
+			if (stat(source->name, &statbuf) || !S_ISREG(statbuf.st_mode)) {
+				if (source->cfmtime) {
+					return 0;
+				}
+			} else if (!source->cfmtime || cfmstat_cmp(source->cfmtime, &statbuf)) {
+				return 0;
+			}
+			break;
+		}
+	}
+
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Update the file modtime cache as if who_asked read the cached files.
+ *
+ * \param parse_cache Parse cache entry handed out.
+ * \param who_asked Which module asked.
+ *
+ * \return Nothing
+ */
+static void config_parse_cache_note_files(struct config_parse_cache *parse_cache, const char *who_asked)
+{
+	struct config_parse_source *source;
+	struct cache_file_mtime *cfmtime;
+	struct cache_file_include *cfinclude;
+
+	AST_LIST_TRAVERSE(&parse_cache->sources, source, list) {
+		if (source->type != CONFIG_PARSE_SOURCE_FILE) {
+			continue;
+		}
+		if (!source->cfmtime) {
+			config_cache_remove(source->name, who_asked);
+			continue;
+		}
+
+		AST_LIST_LOCK(&cfmtime_head);
+		AST_LIST_TRAVERSE(&cfmtime_head, cfmtime, list) {
+			if (!strcmp(cfmtime->filename, source->name) && !strcmp(cfmtime->who_asked, who_asked)) {
+				break;
+			}
+		}
+		if (!cfmtime) {
+			cfmtime = cfmtime_new(source->name, who_asked);
+			if (!cfmtime) {
+				AST_LIST_UNLOCK(&cfmtime_head);
+				continue;
+			}
+			AST_LIST_INSERT_SORTALPHA(&cfmtime_head, cfmtime, list, filename);
+		}
+		cfmtime->has_exec = 0;
+		config_cache_flush_includes(cfmtime);
+		AST_LIST_TRAVERSE(&source->cfmtime->includes, cfinclude, list) {
+			struct cache_file_include *copy;
+
+			copy = ast_calloc(1, sizeof(*copy) + strlen(cfinclude->include) + 1);
+			if (!copy) {
+				break;
+			}
+			strcpy(copy->include, cfinclude->include); /* Safe */
+			AST_LIST_INSERT_TAIL(&cfmtime->includes, copy, list);
+		}
+		cfmtime->stat_size = source->cfmtime->stat_size;
+		cfmtime->stat_mtime_nsec = source->cfmtime->stat_mtime_nsec;
+		cfmtime->stat_mtime = source->cfmtime->stat_mtime;
+		AST_LIST_UNLOCK(&cfmtime_head);
+	}
+}
+
+/*! \brief Category of a config being cloned and its copy */
+struct config_clone_map {
+	const struct ast_category *old;
+	struct ast_category *new;
+};
+
+static int config_clone_map_cmp(const void *left, const void *right)
+{
+	const struct ast_category *left_old = ((const struct config_clone_map *) left)->old;
+	const struct ast_category *right_old = ((const struct config_clone_map *) right)->old;
+
+	return left_old < right_old ? -1 : left_old > right_old;
+}
+
+/*!
+ * \internal
+ * \brief Make a complete copy of a config without comments.
+ *
+ * \details
+ * Unlike ast_config_copy() this keeps templates, template instances
+ * and includes so the copy is the same as if the file was parsed
+ * again.
+ *
+ * \param old Config to copy.
+ *
+ * \retval copy on success.
+ * \retval NULL on error.
+ */
+static struct ast_config *config_clone(const struct ast_config *old)
+{
+	struct ast_config *new_config;
+	struct ast_category *cat_iter;
+	struct ast_config_include *incl;
+	struct ast_config_include **incl_tail;
+	AST_VECTOR(, struct config_clone_map) map;
+	size_t idx;
+
+	new_config = ast_config_new();
+	if (!new_config) {
+		return NULL;
+	}
+	new_config->max_include_level = old->max_include_level;
+	new_config->include_level = old->include_level;
+
+	if (AST_VECTOR_INIT(&map, 64)) {
+		ast_config_destroy(new_config);
+		return NULL;
+	}
+
+	for (cat_iter = old->root; cat_iter; cat_iter = cat_iter->next) {
+		struct config_clone_map pair = { .old = cat_iter, };
+		struct ast_variable *var;
+
+		pair.new = new_category(cat_iter->name, cat_iter->file, cat_iter->lineno, cat_iter->ignored);
+		if (!pair.new) {
+			goto fail;
+		}
+		ast_category_append(new_config, pair.new);
+		pair.new->include_level = cat_iter->include_level;
+		if (AST_VECTOR_APPEND(&map, pair)) {
+			goto fail;
+		}
+
+		for (var = cat_iter->root; var; var = var->next) {
+			struct ast_variable *cloned = variable_clone(var);
+
+			if (!cloned) {
+				goto fail;
+			}
+			cloned->inherited = var->inherited;
+			ast_variable_append(pair.new, cloned);
+		}
+	}
+
+	/* Point the template instances at the copied categories. */
+	AST_VECTOR_SORT(&map, config_clone_map_cmp);
+	for (idx = 0; idx < AST_VECTOR_SIZE(&map); ++idx) {
+		struct config_clone_map *pair = AST_VECTOR_GET_ADDR(&map, idx);
+		struct ast_category_template_instance *inst;
+
+		AST_LIST_TRAVERSE(&pair->old->template_instances, inst, next) {
+			struct config_clone_map key = { .old = inst->inst, };
+			struct config_clone_map *base;
+			struct ast_category_template_instance *x;
+
+			base = bsearch(&key, AST_VECTOR_GET_ADDR(&map, 0), AST_VECTOR_SIZE(&map),
+				sizeof(struct config_clone_map), config_clone_map_cmp);
+			x = ast_calloc(1, sizeof(*x));
+			if (!base || !x) {
+				ast_free(x);
+				goto fail;
+			}
+			strcpy(x->name, inst->name);
+			x->inst = base->new;
+			AST_LIST_INSERT_TAIL(&pair->new->template_instances, x, next);
+		}
+
+		if (pair->old == old->current) {
+			new_config->current = pair->new;
+		}
+	}
+	if (!old->current) {
+		new_config->current = NULL;
+	}
+
+	incl_tail = &new_config->includes;
+	for (incl = old->includes; incl; incl = incl->next) {
+		struct ast_config_include *copy;
+
+		copy = ast_calloc(1, sizeof(*copy));
+		if (!copy) {
+			goto fail;
+		}
+		*incl_tail = copy;
+		incl_tail = &copy->next;
+		copy->include_location_file = ast_strdup(incl->include_location_file);
+		copy->include_location_lineno = incl->include_location_lineno;
+		copy->exec = incl->exec;
+		copy->exec_file = ast_strdup(incl->exec_file);
+		copy->included_file = ast_strdup(incl->included_file);
+		copy->inclusion_count = incl->inclusion_count;
+		copy->output = incl->output;
+		if (!copy->include_location_file || !copy->included_file
+			|| (incl->exec_file && !copy->exec_file)) {
+			goto fail;
+		}
+	}
+
+	AST_VECTOR_FREE(&map);
+	return new_config;
+
+fail:
+	AST_VECTOR_FREE(&map);
+	ast_config_destroy(new_config);
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Check if a load can use the parse cache.
+ *
+ * \param flags Config load flags.
+ *
+ * \retval non-zero if the parse cache can be used.
+ */
+static int config_parse_cache_usable(struct ast_flags flags)
+{
+	if (!config_parse_caches
+		|| ast_test_flag(&flags, CONFIG_FLAG_WITHCOMMENTS | CONFIG_FLAG_NOCACHE)) {
+		return 0;
+	}
+
+	/* Hooks expect to see every file of the config being read. */
+	return !cfg_hooks || !ao2_container_count(cfg_hooks);
+}
+
+/*!
+ * \internal
+ * \brief Get a copy of the cached parse result of a file.
+ *
+ * \param filename Config filename.
+ * \param who_asked Which module asked.
+ * \param flags Config load flags.
+ *
+ * \retval copy of the parse result.
+ * \retval CONFIG_STATUS_FILEUNCHANGED if requested and who_asked has seen it.
+ * \retval NULL if the file has to be parsed.
+ */
+static struct ast_config *config_parse_cache_load(const char *filename, const char *who_asked, struct ast_flags flags)
+{
+	struct config_parse_cache *parse_cache;
+	struct ast_config *cfg = NULL;
+
+	parse_cache = ao2_find(config_parse_caches, filename, OBJ_SEARCH_KEY);
+	if (!parse_cache) {
+		return NULL;
+	}
+
+	if (parse_cache->cfg && config_parse_cache_is_current(parse_cache, flags)) {
+		if (ast_test_flag(&flags, CONFIG_FLAG_FILEUNCHANGED)
+			&& config_text_file_load(NULL, NULL, filename, NULL, flags, "", who_asked)
+				== CONFIG_STATUS_FILEUNCHANGED) {
+			cfg = CONFIG_STATUS_FILEUNCHANGED;
+		} else {
+			cfg = config_clone(parse_cache->cfg);
+			if (cfg) {
+				ast_debug(1, "Using cached parse of %s\n", filename);
+				config_parse_cache_note_files(parse_cache, who_asked);
+			}
+		}
+	}
+	ao2_ref(parse_cache, -1);
+
+	return cfg;
+}
+
+/*!
+ * \internal
+ * \brief Remember where a config was parsed from and maybe the result.
+ *
+ * \param parse_cache Sources recorded while parsing.
+ * \param cfg Parse result.
+ *
+ * \return Nothing
+ */
+static void config_parse_cache_store(struct config_parse_cache *parse_cache, const struct ast_config *cfg)
+{
+	struct config_parse_cache *previous;
+	struct ast_flags flags = { CONFIG_FLAG_NOREALTIME };
+
+	if (parse_cache->uncacheable) {
+		ao2_find(config_parse_caches, parse_cache->filename,
+			OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE);
+		return;
+	}
+
+	/*
+	 * Only keep a copy once the same files are read a second time so
+	 * files read only once do not take up memory twice.  The realtime
+	 * engines were already checked while parsing.
+	 */
+	previous = ao2_find(config_parse_caches, parse_cache->filename, OBJ_SEARCH_KEY);
+	if (previous && config_parse_cache_is_current(previous, flags)) {
+		parse_cache->cfg = config_clone(cfg);
+	}
+	ao2_cleanup(previous);
+
+	ao2_lock(config_parse_caches);
+	ao2_find(config_parse_caches, parse_cache->filename,
+		OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE | OBJ_NOLOCK);
+	ao2_link_flags(config_parse_caches, parse_cache, OBJ_NOLOCK);
+	ao2_unlock(config_parse_caches);
+}
+
 struct ast_config *ast_config_load2(const char *filename, const char *who_asked, struct ast_flags flags)
 {
 	struct ast_config *cfg;
 	struct ast_config *result;
+	struct config_parse_cache *parse_cache = NULL;
+
+	if (config_parse_cache_usable(flags)) {
+		result = config_parse_cache_load(filename, who_asked, flags);
+		if (result) {
+			return result;
+		}
+		parse_cache = config_parse_cache_alloc(filename);
+	}
 
 	cfg = ast_config_new();
-	if (!cfg)
+	if (!cfg) {
+		ao2_cleanup(parse_cache);
 		return NULL;
+	}
+	cfg->parse_cache = parse_cache;
 
 	result = ast_config_internal_load(filename, cfg, flags, "", who_asked);
-	if (!result || result == CONFIG_STATUS_FILEUNCHANGED || result == CONFIG_STATUS_FILEINVALID)
+	cfg->parse_cache = NULL;
+	if (!result || result == CONFIG_STATUS_FILEUNCHANGED || result == CONFIG_STATUS_FILEINVALID) {
 		ast_config_destroy(cfg);
+	} else if (parse_cache) {
+		config_parse_cache_store(parse_cache, result);
+	}
+	ao2_cleanup(parse_cache);
 
 	return result;
 }
@@ -3263,24 +3944,244 @@ static int realtime_arguments_to_fields2(va_list ap, int skip, struct ast_variab
 	return 0;
 }
 
+/*! \brief Number of buckets for the realtime result cache */
+#define REALTIME_CACHE_BUCKETS 127
+
+/*! \brief How often expired realtime results are purged, in milliseconds */
+#define REALTIME_CACHE_PURGE_INTERVAL 60000
+
+/*! \brief A cached realtime lookup result */
+struct realtime_cache_entry {
+	/*! When the result may no longer be used */
+	struct timeval expires;
+	/*! Result of a single entry lookup, NULL if nothing was found */
+	struct ast_variable *var;
+	/*! Result of a multientry lookup, NULL if nothing was found */
+	struct ast_config *cfg;
+	/*! Family the result was loaded from, stored in key[] after the key */
+	const char *family;
+	/*! Lookup type, family and fields the result was loaded with */
+	char key[0];
+};
+
+/*! \brief Cached realtime lookup results, keyed by lookup */
+static struct ao2_container *realtime_cache;
+
+/*! \brief When expired realtime results are next purged, protected by the realtime_cache lock */
+static struct timeval realtime_cache_next_purge;
+
+/*! \brief Bumped every time cached realtime results are invalidated */
+static volatile int realtime_cache_gen;
+
+AO2_STRING_FIELD_HASH_FN(realtime_cache_entry, key);
+AO2_STRING_FIELD_CMP_FN(realtime_cache_entry, key);
+
+static void realtime_cache_entry_destroy(void *obj)
+{
+	struct realtime_cache_entry *entry = obj;
+
+	ast_variables_destroy(entry->var);
+	ast_config_destroy(entry->cfg);
+}
+
+int ast_realtime_cache_ttl(const char *family)
+{
+	struct ast_config_map *map;
+
+	SCOPED_MUTEX(lock, &config_lock);
+
+	for (map = config_maps; map; map = map->next) {
+		if (!strcasecmp(family, map->name)) {
+			return map->cache_ttl;
+		}
+	}
+
+	return 0;
+}
+
+unsigned int ast_realtime_cache_generation(void)
+{
+	return ast_atomic_fetchadd_int(&realtime_cache_gen, 0);
+}
+
+static int realtime_cache_family_cmp(void *obj, void *arg, int flags)
+{
+	struct realtime_cache_entry *entry = obj;
+
+	return !arg || !strcasecmp(entry->family, arg) ? CMP_MATCH : 0;
+}
+
+int ast_realtime_cache_flush(const char *family)
+{
+	int count;
+
+	/* Bumped first so lookups already in flight do not store what they loaded */
+	ast_atomic_fetchadd_int(&realtime_cache_gen, 1);
+
+	if (!realtime_cache) {
+		return 0;
+	}
+
+	ao2_lock(realtime_cache);
+	count = ao2_container_count(realtime_cache);
+	ao2_callback(realtime_cache, OBJ_MULTIPLE | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK,
+		realtime_cache_family_cmp, (void *) family);
+	count -= ao2_container_count(realtime_cache);
+	ao2_unlock(realtime_cache);
+
+	return count;
+}
+
+/*!
+ * \internal
+ * \brief Flush a family after it was written to, if its results are cached
+ */
+static void realtime_cache_invalidate(const char *family)
+{
+	if (ast_realtime_cache_ttl(family)) {
+		ast_realtime_cache_flush(family);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Build the cache key for a lookup
+ *
+ * \note The caller is responsible for freeing the returned string.
+ */
+static struct ast_str *realtime_cache_key(const char *family, int multi, const struct ast_variable *fields)
+{
+	struct ast_str *key = ast_str_create(128);
+
+	if (!key) {
+		return NULL;
+	}
+
+	ast_str_set(&key, 0, "%c%s", multi ? 'M' : 'S', family);
+	for (; fields; fields = fields->next) {
+		ast_str_append(&key, 0, "\x1f%s\x1e%s", fields->name, fields->value);
+	}
+
+	return key;
+}
+
+/*!
+ * \internal
+ * \brief Find an unexpired cached result
+ *
+ * \note The returned entry has a reference bumped.
+ */
+static struct realtime_cache_entry *realtime_cache_find(const struct ast_str *key)
+{
+	struct realtime_cache_entry *entry;
+
+	entry = ao2_find(realtime_cache, ast_str_buffer(key), OBJ_SEARCH_KEY);
+	if (entry && ast_tvcmp(ast_tvnow(), entry->expires) >= 0) {
+		ao2_unlink(realtime_cache, entry);
+		ao2_ref(entry, -1);
+		entry = NULL;
+	}
+
+	return entry;
+}
+
+static int realtime_cache_expired(void *obj, void *arg, int flags)
+{
+	struct realtime_cache_entry *entry = obj;
+	struct timeval *now = arg;
+
+	return ast_tvcmp(*now, entry->expires) >= 0 ? CMP_MATCH : 0;
+}
+
+/*!
+ * \internal
+ * \brief Cache a lookup result
+ *
+ * \param family Family the result was loaded from
+ * \param key Cache key of the lookup
+ * \param ttl Seconds to keep the result
+ * \param generation Cache generation from before the lookup was made
+ * \param var Single entry result to store a copy of
+ * \param cfg Multientry result to store a copy of
+ *
+ * The result is dropped if the family was invalidated while it was being
+ * loaded, since it may predate the write that caused the invalidation.
+ */
+static void realtime_cache_store(const char *family, const struct ast_str *key, int ttl,
+	unsigned int generation, const struct ast_variable *var, const struct ast_config *cfg)
+{
+	struct realtime_cache_entry *entry;
+	struct timeval now = ast_tvnow();
+	size_t key_len = ast_str_strlen(key) + 1;
+
+	entry = ao2_alloc_options(sizeof(*entry) + key_len + strlen(family) + 1,
+		realtime_cache_entry_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		return;
+	}
+
+	strcpy(entry->key, ast_str_buffer(key)); /* SAFE */
+	entry->family = strcpy(entry->key + key_len, family); /* SAFE */
+	entry->expires = ast_tvadd(now, ast_samp2tv(ttl, 1));
+	if ((var && !(entry->var = ast_variables_dup((struct ast_variable *) var)))
+		|| (cfg && !(entry->cfg = ast_config_copy(cfg)))) {
+		ao2_ref(entry, -1);
+		return;
+	}
+
+	ao2_lock(realtime_cache);
+	if (generation == ast_realtime_cache_generation()) {
+		ao2_find(realtime_cache, entry->key, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+		ao2_link_flags(realtime_cache, entry, OBJ_NOLOCK);
+	}
+	if (ast_tvcmp(now, realtime_cache_next_purge) >= 0) {
+		ao2_callback(realtime_cache, OBJ_MULTIPLE | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK,
+			realtime_cache_expired, &now);
+		realtime_cache_next_purge = ast_tvadd(now, ast_samp2tv(REALTIME_CACHE_PURGE_INTERVAL, 1000));
+	}
+	ao2_unlock(realtime_cache);
+
+	ao2_ref(entry, -1);
+}
+
 struct ast_variable *ast_load_realtime_all_fields(const char *family, const struct ast_variable *fields)
 {
 	struct ast_config_engine *eng;
 	char db[256];
 	char table[256];
 	struct ast_variable *res=NULL;
+	struct realtime_cache_entry *entry;
+	struct ast_str *key = NULL;
+	unsigned int generation = 0;
+	int ttl;
 	int i;
 
+	ttl = ast_realtime_cache_ttl(family);
+	if (ttl > 0 && (key = realtime_cache_key(family, 0, fields))) {
+		if ((entry = realtime_cache_find(key))) {
+			res = ast_variables_dup(entry->var);
+			ao2_ref(entry, -1);
+			ast_free(key);
+			return res;
+		}
+		generation = ast_realtime_cache_generation();
+	}
+
 	for (i = 1; ; i++) {
 		if ((eng = find_engine(family, i, db, sizeof(db), table, sizeof(table)))) {
 			if (eng->realtime_func && (res = eng->realtime_func(db, table, fields))) {
-				return res;
+				break;
 			}
 		} else {
-			return NULL;
+			break;
 		}
 	}
 
+	if (key) {
+		realtime_cache_store(family, key, ttl, generation, res, NULL);
+		ast_free(key);
+	}
+
 	return res;
 }
 
@@ -3420,6 +4321,9 @@ int ast_unload_realtime(const char *family)
 			break;
 		}
 	}
+
+	realtime_cache_invalidate(family);
+
 	return res;
 }
 
@@ -3429,8 +4333,23 @@ struct ast_config *ast_load_realtime_multientry_fields(const char *family, const
 	char db[256];
 	char table[256];
 	struct ast_config *res = NULL;
+	struct realtime_cache_entry *entry;
+	struct ast_str *key = NULL;
+	unsigned int generation = 0;
+	int ttl;
 	int i;
 
+	ttl = ast_realtime_cache_ttl(family);
+	if (ttl > 0 && (key = realtime_cache_key(family, 1, fields))) {
+		if ((entry = realtime_cache_find(key))) {
+			res = entry->cfg ? ast_config_copy(entry->cfg) : NULL;
+			ao2_ref(entry, -1);
+			ast_free(key);
+			return res;
+		}
+		generation = ast_realtime_cache_generation();
+	}
+
 	for (i = 1; ; i++) {
 		if ((eng = find_engine(family, i, db, sizeof(db), table, sizeof(table)))) {
 			if (eng->realtime_multi_func && (res = eng->realtime_multi_func(db, table, fields))) {
@@ -3446,6 +4365,11 @@ struct ast_config *ast_load_realtime_multientry_fields(const char *family, const
 		}
 	}
 
+	if (key) {
+		realtime_cache_store(family, key, ttl, generation, NULL, res);
+		ast_free(key);
+	}
+
 	return res;
 }
 
@@ -3483,6 +4407,8 @@ int ast_update_realtime_fields(const char *family, const char *keyfield, const c
 		}
 	}
 
+	realtime_cache_invalidate(family);
+
 	return res;
 }
 
@@ -3519,6 +4445,8 @@ int ast_update2_realtime_fields(const char *family, const struct ast_variable *l
 		}
 	}
 
+	realtime_cache_invalidate(family);
+
 	return res;
 }
 
@@ -3564,6 +4492,8 @@ int ast_store_realtime_fields(const char *family, const struct ast_variable *fie
 		}
 	}
 
+	realtime_cache_invalidate(family);
+
 	return res;
 }
 
@@ -3600,6 +4530,8 @@ int ast_destroy_realtime_fields(const char *family, const char *keyfield, const
 		}
 	}
 
+	realtime_cache_invalidate(family);
+
 	return res;
 }
 
@@ -3941,8 +4873,12 @@ static char *handle_cli_core_show_config_mappings(struct ast_cli_entry *e, int c
 				ast_cli(a->fd, "Config Engine: %s\n", eng->name);
 				for (map = config_maps; map; map = map->next) {
 					if (!strcasecmp(map->driver, eng->name)) {
-						ast_cli(a->fd, "===> %s (db=%s, table=%s)\n", map->name, map->database,
+						ast_cli(a->fd, "===> %s (db=%s, table=%s", map->name, map->database,
 								map->table ? map->table : map->name);
+						if (map->cache_ttl) {
+							ast_cli(a->fd, ", cache=%ds", map->cache_ttl);
+						}
+						ast_cli(a->fd, ")\n");
 					}
 				}
 			}
@@ -4039,8 +4975,35 @@ static char *handle_cli_config_list(struct ast_cli_entry *e, int cmd, struct ast
 	return CLI_SUCCESS;
 }
 
+static char *handle_cli_realtime_cache_flush(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	int count;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "realtime cache flush";
+		e->usage =
+			"Usage: realtime cache flush [family]\n"
+			"	Discards cached realtime lookup results, either for the given\n"
+			"	family or for every family.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc > 4) {
+		return CLI_SHOWUSAGE;
+	}
+
+	count = ast_realtime_cache_flush(a->argc == 4 ? a->argv[3] : NULL);
+	ast_cli(a->fd, "Flushed %d cached realtime result%s.\n", count, ESS(count));
+
+	return CLI_SUCCESS;
+}
+
 static struct ast_cli_entry cli_config[] = {
 	AST_CLI_DEFINE(handle_cli_core_show_config_mappings, "Display config mappings (file names to config engines)"),
+	AST_CLI_DEFINE(handle_cli_realtime_cache_flush, "Discard cached realtime lookup results"),
 	AST_CLI_DEFINE(handle_cli_config_reload, "Force a reload on modules using a particular configuration file"),
 	AST_CLI_DEFINE(handle_cli_config_list, "Show all files that have loaded a configuration file"),
 };
@@ -4061,10 +5024,20 @@ static void config_shutdown(void)
 
 	ao2_cleanup(cfg_hooks);
 	cfg_hooks = NULL;
+
+	ao2_cleanup(config_parse_caches);
+	config_parse_caches = NULL;
+
+	ao2_cleanup(realtime_cache);
+	realtime_cache = NULL;
 }
 
 int register_config_cli(void)
 {
+	config_parse_caches = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		CONFIG_PARSE_CACHE_BUCKETS, config_parse_cache_hash_fn, NULL, config_parse_cache_cmp_fn);
+	realtime_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		REALTIME_CACHE_BUCKETS, realtime_cache_entry_hash_fn, NULL, realtime_cache_entry_cmp_fn);
 	ast_cli_register_multiple(cli_config, ARRAY_LEN(cli_config));
 	/* This is separate from the module load so cleanup can happen very late. */
 	ast_register_cleanup(config_shutdown);
@@ -229,6 +229,21 @@ static int unreal_queue_frame(struct ast_unreal_pvt *p, int isoutbound, struct a
 		return 0;
 	}
 
+	/*
+	 * If the other channel can be locked without waiting, queue the frame
+	 * while keeping our locks.  Trying the lock cannot deadlock, and it
+	 * saves dropping and retaking our channel and the pvt for the frames
+	 * that flow through the pair until it is optimized out.  Ringing also
+	 * changes the state of the other channel, which must not be done with
+	 * our locks held.
+	 */
+	if ((f->frametype != AST_FRAME_CONTROL || f->subclass.integer != AST_CONTROL_RINGING)
+		&& !ast_channel_trylock(other)) {
+		ast_queue_frame(other, f);
+		ast_channel_unlock(other);
+		return 0;
+	}
+
 	/* grab a ref on the channel before unlocking the pvt,
 	 * other can not go away from us now regardless of locking */
 	ast_channel_ref(other);
@@ -915,7 +930,7 @@ void ast_unreal_call_setup(struct ast_channel *semi1, struct ast_channel *semi2)
 	AST_LIST_TRAVERSE(ast_channel_varshead(semi1), varptr, entries) {
 		clone_var = ast_var_assign(varptr->name, varptr->value);
 		if (clone_var) {
-			AST_LIST_INSERT_TAIL(ast_channel_varshead(semi2), clone_var, entries);
+			AST_VAR_LIST_INSERT_TAIL(ast_channel_varshead(semi2), clone_var);
 			ast_channel_publish_varset(semi2, ast_var_full_name(clone_var),
 				ast_var_value(clone_var));
 		}
@@ -51,6 +51,10 @@
 #include "asterisk/cli.h"
 #include "asterisk/utils.h"
 #include "asterisk/manager.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/vector.h"
+#include "asterisk/event.h"
+#include "asterisk/stasis.h"
 
 /*** DOCUMENTATION
 	<manager name="DBGet" language="en_US">
@@ -111,6 +115,8 @@ static sqlite3 *astdb;
 static pthread_t syncthread;
 static int doexit;
 static int dosync;
+/*! Milliseconds writes wait in the journal, 0 when they go to the database at once */
+static unsigned int db_write_behind;
 
 static void db_sync(void);
 
@@ -279,13 +285,514 @@ static int db_open(void)
 	return 0;
 }
 
+/*! \brief An entry of the in-memory copy of astdb */
+struct db_cache_entry {
+	/*! The value, stored after the key */
+	char *value;
+	char key[0];
+};
+
+/*! \brief The entries whose keys start with the same component, matched without case */
+struct db_cache_family {
+	/*! Entries sorted by key */
+	struct ao2_container *entries;
+	char name[0];
+};
+
+enum db_journal_type {
+	DB_JOURNAL_PUT,
+	DB_JOURNAL_DEL,
+	DB_JOURNAL_DELTREE,
+};
+
+/*! \brief A write not yet made to the database */
+struct db_journal_op {
+	enum db_journal_type type;
+	/*! The value of a put, stored after the key */
+	char *value;
+	AST_LIST_ENTRY(db_journal_op) list;
+	/*! The full key, or the prefix of a deltree */
+	char key[0];
+};
+
+/*!
+ * Protects db_cache and db_journal.  When dblock is also needed it
+ * must be locked first.
+ */
+AST_RWLOCK_DEFINE_STATIC(cache_lock);
+/*! The families in the in-memory copy of astdb, NULL if no copy is kept */
+static struct ao2_container *db_cache;
+/*! Writes waiting to be made to the database, oldest first */
+static AST_LIST_HEAD_NOLOCK_STATIC(db_journal, db_journal_op);
+
+AO2_STRING_FIELD_CASE_HASH_FN(db_cache_family, name)
+AO2_STRING_FIELD_CASE_CMP_FN(db_cache_family, name)
+AO2_STRING_FIELD_SORT_FN(db_cache_entry, key)
+
+static void db_cache_family_destroy(void *obj)
+{
+	struct db_cache_family *family = obj;
+
+	ao2_cleanup(family->entries);
+}
+
+/*! \brief Find the first component of a key, which groups it in the cache */
+static const char *db_key_family(const char *key, size_t *len)
+{
+	const char *start = key + (*key == '/');
+	const char *end = strchr(start, '/');
+
+	*len = end ? end - start : strlen(start);
+	return start;
+}
+
+static struct db_cache_family *db_cache_family_find(const char *key, int create)
+{
+	struct db_cache_family *family;
+	size_t len;
+	const char *start = db_key_family(key, &len);
+	char *name = ast_alloca(len + 1);
+
+	memcpy(name, start, len);
+	name[len] = '\0';
+
+	if ((family = ao2_find(db_cache, name, OBJ_SEARCH_KEY)) || !create) {
+		return family;
+	}
+
+	family = ao2_alloc_options(sizeof(*family) + len + 1, db_cache_family_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!family) {
+		return NULL;
+	}
+	strcpy(family->name, name); /* Safe */
+
+	family->entries = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_NOLOCK,
+		AO2_CONTAINER_ALLOC_OPT_DUPS_REPLACE, db_cache_entry_sort_fn, NULL);
+	if (!family->entries || !ao2_link(db_cache, family)) {
+		ao2_ref(family, -1);
+		return NULL;
+	}
+
+	return family;
+}
+
+/*! \note cache_lock must be write locked */
+static int db_cache_put(const char *key, const char *value)
+{
+	struct db_cache_family *family;
+	struct db_cache_entry *entry;
+	size_t key_len = strlen(key);
+	int res = -1;
+
+	if (!(family = db_cache_family_find(key, 1))) {
+		return -1;
+	}
+
+	entry = ao2_alloc_options(sizeof(*entry) + key_len + strlen(value) + 2, NULL,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (entry) {
+		memcpy(entry->key, key, key_len + 1);
+		entry->value = entry->key + key_len + 1;
+		strcpy(entry->value, value); /* Safe */
+
+		/* Replaces the entry with the same key */
+		res = ao2_link(family->entries, entry) ? 0 : -1;
+		ao2_ref(entry, -1);
+	}
+	if (res) {
+		/* Rather nothing than a stale value */
+		ao2_find(family->entries, key, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+		ast_log(LOG_ERROR, "Unable to cache astdb key '%s'\n", key);
+	}
+	ao2_ref(family, -1);
+
+	return res;
+}
+
+/*! \note cache_lock must be write locked */
+static void db_cache_del(const char *key)
+{
+	struct db_cache_family *family;
+
+	if (!(family = db_cache_family_find(key, 0))) {
+		return;
+	}
+
+	ao2_find(family->entries, key, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+	if (!ao2_container_count(family->entries)) {
+		ao2_unlink(db_cache, family);
+	}
+	ao2_ref(family, -1);
+}
+
+static int db_ascii_lower(int c)
+{
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/*!
+ * \internal
+ * \brief Check a key is in a tree the way the gettree and deltree statements do
+ *
+ * This is "key || '/' LIKE prefix || '/' || '%'" in SQLite, so ASCII letters
+ * match either case, '_' matches any one character and '%' any run of them.
+ */
+static int db_key_in_tree(const char *key, const char *prefix)
+{
+	size_t key_len = strlen(key);
+	size_t prefix_len = strlen(prefix);
+	/* The key and pattern as compared, with their suffixes */
+#define SUBJECT(i) ((i) < key_len ? (unsigned char) key[(i)] : '/')
+#define PATTERN(i) ((i) < prefix_len ? (unsigned char) prefix[(i)] : ((i) == prefix_len ? '/' : ((i) == prefix_len + 1 ? '%' : '\0')))
+	size_t s = 0;
+	size_t p = 0;
+	size_t star_s = 0;
+	size_t star_p = 0;
+	int star = 0;
+
+	while (s <= key_len) {
+		int c = PATTERN(p);
+
+		if (c == '%') {
+			star = 1;
+			star_p = ++p;
+			star_s = s;
+		} else if (c == '_') {
+			/* One character, not one byte */
+			++s;
+			while (s < key_len && ((unsigned char) key[s] & 0xc0) == 0x80) {
+				++s;
+			}
+			++p;
+		} else if (c && db_ascii_lower(c) == db_ascii_lower(SUBJECT(s))) {
+			++s;
+			++p;
+		} else if (star) {
+			p = star_p;
+			s = ++star_s;
+		} else {
+			return 0;
+		}
+	}
+	while (PATTERN(p) == '%') {
+		++p;
+	}
+
+	return !PATTERN(p);
+#undef SUBJECT
+#undef PATTERN
+}
+
+/*! \brief What ast_db_gettree(), ast_db_gettree_by_prefix() or ast_db_deltree() is after */
+struct db_cache_search {
+	/*! The key prefix, NULL for every key */
+	const char *prefix;
+	size_t prefix_len;
+	/*! Match with the LIKE rules of gettree, or else by a plain prefix */
+	int like;
+	/*! Entries found */
+	AST_VECTOR(, struct db_cache_entry *) found;
+	/*! Number of entries deleted */
+	int deleted;
+};
+
+static int db_cache_search_match(struct db_cache_search *search, const char *key)
+{
+	if (!search->prefix) {
+		return 1;
+	} else if (search->like) {
+		return db_key_in_tree(key, search->prefix);
+	}
+
+	/* Same as "key > prefix AND key <= prefix || X'ffff'" */
+	return !strncmp(key, search->prefix, search->prefix_len) && key[search->prefix_len];
+}
+
+static int db_cache_entry_collect(void *obj, void *arg, int flags)
+{
+	struct db_cache_entry *entry = obj;
+	struct db_cache_search *search = arg;
+
+	if (db_cache_search_match(search, entry->key) && !AST_VECTOR_APPEND(&search->found, entry)) {
+		ao2_ref(entry, +1);
+	}
+
+	return 0;
+}
+
+static int db_cache_family_collect(void *obj, void *arg, int flags)
+{
+	struct db_cache_family *family = obj;
+
+	ao2_callback(family->entries, OBJ_NODATA | OBJ_MULTIPLE, db_cache_entry_collect, arg);
+
+	return 0;
+}
+
+static int db_cache_entry_delete(void *obj, void *arg, int flags)
+{
+	struct db_cache_entry *entry = obj;
+	struct db_cache_search *search = arg;
+
+	if (!db_cache_search_match(search, entry->key)) {
+		return 0;
+	}
+	++search->deleted;
+
+	return CMP_MATCH;
+}
+
+static int db_cache_family_delete(void *obj, void *arg, int flags)
+{
+	struct db_cache_family *family = obj;
+
+	ao2_callback(family->entries, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, db_cache_entry_delete, arg);
+
+	return 0;
+}
+
+static int db_cache_family_empty(void *obj, void *arg, int flags)
+{
+	struct db_cache_family *family = obj;
+
+	return ao2_container_count(family->entries) ? 0 : CMP_MATCH;
+}
+
+/*!
+ * \internal
+ * \brief Run a callback on each family that might hold keys of a search
+ *
+ * Only the family named by the prefix is looked at, unless wildcards of the
+ * LIKE rules in that name could match other families.
+ */
+static void db_cache_search_families(struct db_cache_search *search, ao2_callback_fn *cb)
+{
+	struct db_cache_family *family;
+	const char *start;
+	size_t len;
+
+	if (search->prefix) {
+		start = db_key_family(search->prefix, &len);
+		if (!search->like || (!memchr(start, '%', len) && !memchr(start, '_', len))) {
+			if ((family = db_cache_family_find(search->prefix, 0))) {
+				cb(family, search, 0);
+				ao2_ref(family, -1);
+			}
+			return;
+		}
+	}
+
+	ao2_callback(db_cache, OBJ_NODATA | OBJ_MULTIPLE, cb, search);
+}
+
+static int db_cache_entry_cmp(const void *a, const void *b)
+{
+	const struct db_cache_entry *left = *(const struct db_cache_entry **) a;
+	const struct db_cache_entry *right = *(const struct db_cache_entry **) b;
+
+	return strcmp(left->key, right->key);
+}
+
+static struct ast_db_entry *db_entry_alloc(const char *key, const char *value)
+{
+	struct ast_db_entry *entry;
+	size_t key_len = strlen(key);
+	size_t value_len = strlen(value);
+
+	entry = ast_malloc(sizeof(*entry) + key_len + value_len + 2);
+	if (!entry) {
+		return NULL;
+	}
+
+	entry->next = NULL;
+	entry->key = entry->data + value_len + 1;
+	memcpy(entry->data, value, value_len + 1);
+	memcpy(entry->key, key, key_len + 1);
+
+	return entry;
+}
+
+/*! \brief Get the entries of a search from the cache, in the order of their keys */
+static struct ast_db_entry *db_cache_gettree(const char *prefix, int like)
+{
+	struct db_cache_search search = {
+		.prefix = prefix,
+		.prefix_len = prefix ? strlen(prefix) : 0,
+		.like = like,
+	};
+	struct ast_db_entry *head = NULL, *prev = NULL, *cur;
+	int i;
+
+	if (AST_VECTOR_INIT(&search.found, 8)) {
+		return NULL;
+	}
+
+	ast_rwlock_rdlock(&cache_lock);
+	db_cache_search_families(&search, db_cache_family_collect);
+	ast_rwlock_unlock(&cache_lock);
+
+	AST_VECTOR_SORT(&search.found, db_cache_entry_cmp);
+	for (i = 0; i < AST_VECTOR_SIZE(&search.found); ++i) {
+		struct db_cache_entry *entry = AST_VECTOR_GET(&search.found, i);
+
+		if ((cur = db_entry_alloc(entry->key, entry->value))) {
+			if (prev) {
+				prev->next = cur;
+			} else {
+				head = cur;
+			}
+			prev = cur;
+		}
+		ao2_ref(entry, -1);
+	}
+	AST_VECTOR_FREE(&search.found);
+
+	return head;
+}
+
+/*! \note cache_lock must be write locked */
+static int db_cache_deltree(const char *prefix)
+{
+	struct db_cache_search search = {
+		.prefix = prefix,
+		.like = 1,
+	};
+
+	db_cache_search_families(&search, db_cache_family_delete);
+	ao2_callback(db_cache, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, db_cache_family_empty, NULL);
+
+	return search.deleted;
+}
+
+/*! \note cache_lock must be write locked */
+static int db_journal_add(enum db_journal_type type, const char *key, const char *value)
+{
+	struct db_journal_op *op;
+	size_t key_len = strlen(key);
+
+	if (!(op = ast_malloc(sizeof(*op) + key_len + (value ? strlen(value) : 0) + 2))) {
+		return -1;
+	}
+
+	op->type = type;
+	memcpy(op->key, key, key_len + 1);
+	op->value = op->key + key_len + 1;
+	strcpy(op->value, S_OR(value, "")); /* Safe */
+	AST_LIST_INSERT_TAIL(&db_journal, op, list);
+
+	return 0;
+}
+
+static int db_put_sql(const char *key, int key_len, const char *value);
+static int db_del_sql(const char *key, int key_len);
+static int db_deltree_sql(const char *prefix);
+
+/*!
+ * \internal
+ * \brief Make the writes waiting in the journal to the database
+ *
+ * \note dblock must be locked
+ *
+ * \return The number of writes made
+ */
+static int db_journal_apply(void)
+{
+	AST_LIST_HEAD_NOLOCK(, db_journal_op) ops;
+	struct db_journal_op *op;
+	int count = 0;
+
+	if (!db_write_behind) {
+		return 0;
+	}
+
+	ast_rwlock_wrlock(&cache_lock);
+	ops.first = AST_LIST_FIRST(&db_journal);
+	ops.last = AST_LIST_LAST(&db_journal);
+	AST_LIST_HEAD_INIT_NOLOCK(&db_journal);
+	ast_rwlock_unlock(&cache_lock);
+
+	while ((op = AST_LIST_REMOVE_HEAD(&ops, list))) {
+		switch (op->type) {
+		case DB_JOURNAL_PUT:
+			db_put_sql(op->key, -1, op->value);
+			break;
+		case DB_JOURNAL_DEL:
+			db_del_sql(op->key, -1);
+			break;
+		case DB_JOURNAL_DELTREE:
+			db_deltree_sql(op->key);
+			break;
+		}
+		++count;
+		ast_free(op);
+	}
+
+	return count;
+}
+
+/*!
+ * \internal
+ * \brief Fill the cache from the database
+ *
+ * \note dblock must be locked
+ */
+static int db_cache_load(void)
+{
+	int res = 0;
+
+	ast_rwlock_wrlock(&cache_lock);
+	ao2_callback(db_cache, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, NULL, NULL);
+	while (sqlite3_step(gettree_all_stmt) == SQLITE_ROW) {
+		const char *key = (const char *) sqlite3_column_text(gettree_all_stmt, 0);
+		const char *value = (const char *) sqlite3_column_text(gettree_all_stmt, 1);
+
+		if (key && value && db_cache_put(key, value)) {
+			res = -1;
+			break;
+		}
+	}
+	sqlite3_reset(gettree_all_stmt);
+	ast_rwlock_unlock(&cache_lock);
+
+	return res;
+}
+
+static int db_cache_init(void)
+{
+	int res;
+
+	if (!ast_option_astdb_cache && !ast_option_astdb_write_behind) {
+		return 0;
+	}
+
+	db_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, 61,
+		db_cache_family_hash_fn, NULL, db_cache_family_cmp_fn);
+	if (!db_cache) {
+		return -1;
+	}
+
+	ast_mutex_lock(&dblock);
+	res = db_cache_load();
+	ast_mutex_unlock(&dblock);
+	if (res) {
+		ao2_ref(db_cache, -1);
+		db_cache = NULL;
+		return -1;
+	}
+
+	db_write_behind = ast_option_astdb_write_behind;
+
+	return 0;
+}
+
 static int db_init(void)
 {
 	if (astdb) {
 		return 0;
 	}
 
-	if (db_open() || db_create_astdb() || init_statements()) {
+	if (db_open() || db_create_astdb() || init_statements() || db_cache_init()) {
 		return -1;
 	}
 
@@ -324,21 +831,12 @@ static int ast_db_rollback_transaction(void)
 	return db_execute_sql("ROLLBACK", NULL, NULL);
 }
 
-int ast_db_put(const char *family, const char *key, const char *value)
+/*! \note dblock must be locked */
+static int db_put_sql(const char *key, int key_len, const char *value)
 {
-	char fullkey[MAX_DB_FIELD];
-	size_t fullkey_len;
 	int res = 0;
 
-	if (strlen(family) + strlen(key) + 2 > sizeof(fullkey) - 1) {
-		ast_log(LOG_WARNING, "Family and key length must be less than %zu bytes\n", sizeof(fullkey) - 3);
-		return -1;
-	}
-
-	fullkey_len = snprintf(fullkey, sizeof(fullkey), "/%s/%s", family, key);
-
-	ast_mutex_lock(&dblock);
-	if (sqlite3_bind_text(put_stmt, 1, fullkey, fullkey_len, SQLITE_STATIC) != SQLITE_OK) {
+	if (sqlite3_bind_text(put_stmt, 1, key, key_len, SQLITE_STATIC) != SQLITE_OK) {
 		ast_log(LOG_WARNING, "Couldn't bind key to stmt: %s\n", sqlite3_errmsg(astdb));
 		res = -1;
 	} else if (sqlite3_bind_text(put_stmt, 2, value, -1, SQLITE_STATIC) != SQLITE_OK) {
@@ -350,6 +848,40 @@ int ast_db_put(const char *family, const char *key, const char *value)
 	}
 
 	sqlite3_reset(put_stmt);
+
+	return res;
+}
+
+static int db_put(const char *family, const char *key, const char *value)
+{
+	char fullkey[MAX_DB_FIELD];
+	size_t fullkey_len;
+	int res = 0;
+
+	if (strlen(family) + strlen(key) + 2 > sizeof(fullkey) - 1) {
+		ast_log(LOG_WARNING, "Family and key length must be less than %zu bytes\n", sizeof(fullkey) - 3);
+		return -1;
+	}
+
+	fullkey_len = snprintf(fullkey, sizeof(fullkey), "/%s/%s", family, key);
+
+	if (db_write_behind) {
+		/* The sync thread writes it to the database later */
+		ast_rwlock_wrlock(&cache_lock);
+		if (!(res = db_journal_add(DB_JOURNAL_PUT, fullkey, value))) {
+			res = db_cache_put(fullkey, value);
+		}
+		ast_rwlock_unlock(&cache_lock);
+		return res;
+	}
+
+	ast_mutex_lock(&dblock);
+	res = db_put_sql(fullkey, fullkey_len, value);
+	if (!res && db_cache) {
+		ast_rwlock_wrlock(&cache_lock);
+		db_cache_put(fullkey, value);
+		ast_rwlock_unlock(&cache_lock);
+	}
 	db_sync();
 	ast_mutex_unlock(&dblock);
 
@@ -384,6 +916,30 @@ static int db_get_common(const char *family, const char *key, char **buffer, int
 
 	fullkey_len = snprintf(fullkey, sizeof(fullkey), "/%s/%s", family, key);
 
+	if (db_cache) {
+		struct db_cache_family *cache_family;
+		struct db_cache_entry *entry = NULL;
+
+		ast_rwlock_rdlock(&cache_lock);
+		if ((cache_family = db_cache_family_find(fullkey, 0))) {
+			entry = ao2_find(cache_family->entries, fullkey, OBJ_SEARCH_KEY);
+			ao2_ref(cache_family, -1);
+		}
+		ast_rwlock_unlock(&cache_lock);
+
+		if (!entry) {
+			ast_debug(1, "Unable to find key '%s' in family '%s'\n", key, family);
+			return -1;
+		}
+		if (bufferlen == -1) {
+			*buffer = ast_strdup(entry->value);
+		} else {
+			ast_copy_string(*buffer, entry->value, bufferlen);
+		}
+		ao2_ref(entry, -1);
+		return 0;
+	}
+
 	ast_mutex_lock(&dblock);
 	if (sqlite3_bind_text(get_stmt, 1, fullkey, fullkey_len, SQLITE_STATIC) != SQLITE_OK) {
 		ast_log(LOG_WARNING, "Couldn't bind key to stmt: %s\n", sqlite3_errmsg(astdb));
@@ -426,7 +982,24 @@ int ast_db_get_allocated(const char *family, const char *key, char **out)
 	return db_get_common(family, key, out, -1);
 }
 
-int ast_db_del(const char *family, const char *key)
+/*! \note dblock must be locked */
+static int db_del_sql(const char *key, int key_len)
+{
+	int res = 0;
+
+	if (sqlite3_bind_text(del_stmt, 1, key, key_len, SQLITE_STATIC) != SQLITE_OK) {
+		ast_log(LOG_WARNING, "Couldn't bind key to stmt: %s\n", sqlite3_errmsg(astdb));
+		res = -1;
+	} else if (sqlite3_step(del_stmt) != SQLITE_DONE) {
+		ast_debug(1, "Unable to delete key '%s'\n", key);
+		res = -1;
+	}
+	sqlite3_reset(del_stmt);
+
+	return res;
+}
+
+static int db_del(const char *family, const char *key)
 {
 	char fullkey[MAX_DB_FIELD];
 	size_t fullkey_len;
@@ -439,24 +1012,53 @@ int ast_db_del(const char *family, const char *key)
 
 	fullkey_len = snprintf(fullkey, sizeof(fullkey), "/%s/%s", family, key);
 
+	if (db_write_behind) {
+		ast_rwlock_wrlock(&cache_lock);
+		if (!(res = db_journal_add(DB_JOURNAL_DEL, fullkey, NULL))) {
+			db_cache_del(fullkey);
+		}
+		ast_rwlock_unlock(&cache_lock);
+		return res;
+	}
+
 	ast_mutex_lock(&dblock);
-	if (sqlite3_bind_text(del_stmt, 1, fullkey, fullkey_len, SQLITE_STATIC) != SQLITE_OK) {
-		ast_log(LOG_WARNING, "Couldn't bind key to stmt: %s\n", sqlite3_errmsg(astdb));
-		res = -1;
-	} else if (sqlite3_step(del_stmt) != SQLITE_DONE) {
-		ast_debug(1, "Unable to find key '%s' in family '%s'\n", key, family);
-		res = -1;
+	res = db_del_sql(fullkey, fullkey_len);
+	if (!res && db_cache) {
+		ast_rwlock_wrlock(&cache_lock);
+		db_cache_del(fullkey);
+		ast_rwlock_unlock(&cache_lock);
 	}
-	sqlite3_reset(del_stmt);
 	db_sync();
 	ast_mutex_unlock(&dblock);
 
 	return res;
 }
 
-int ast_db_deltree(const char *family, const char *keytree)
+/*!
+ * \note dblock must be locked
+ *
+ * \param prefix The tree to delete, every key when empty
+ *
+ * \return The number of entries deleted
+ */
+static int db_deltree_sql(const char *prefix)
+{
+	sqlite3_stmt *stmt = ast_strlen_zero(prefix) ? deltree_all_stmt : deltree_stmt;
+	int res;
+
+	if (!ast_strlen_zero(prefix) && (sqlite3_bind_text(stmt, 1, prefix, -1, SQLITE_STATIC) != SQLITE_OK)) {
+		ast_log(LOG_WARNING, "Could bind %s to stmt: %s\n", prefix, sqlite3_errmsg(astdb));
+	} else if (sqlite3_step(stmt) != SQLITE_DONE) {
+		ast_log(LOG_WARNING, "Couldn't execute stmt: %s\n", sqlite3_errmsg(astdb));
+	}
+	res = sqlite3_changes(astdb);
+	sqlite3_reset(stmt);
+
+	return res;
+}
+
+static int db_deltree(const char *family, const char *keytree)
 {
-	sqlite3_stmt *stmt = deltree_stmt;
 	char prefix[MAX_DB_FIELD];
 	int res = 0;
 
@@ -470,32 +1072,271 @@ int ast_db_deltree(const char *family, const char *keytree)
 		}
 	} else {
 		prefix[0] = '\0';
-		stmt = deltree_all_stmt;
+	}
+
+	if (db_write_behind) {
+		ast_rwlock_wrlock(&cache_lock);
+		if (!db_journal_add(DB_JOURNAL_DELTREE, prefix, NULL)) {
+			res = db_cache_deltree(S_OR(prefix, NULL));
+		}
+		ast_rwlock_unlock(&cache_lock);
+		return res;
 	}
 
 	ast_mutex_lock(&dblock);
-	if (!ast_strlen_zero(prefix) && (sqlite3_bind_text(stmt, 1, prefix, -1, SQLITE_STATIC) != SQLITE_OK)) {
-		ast_log(LOG_WARNING, "Could bind %s to stmt: %s\n", prefix, sqlite3_errmsg(astdb));
-		res = -1;
-	} else if (sqlite3_step(stmt) != SQLITE_DONE) {
-		ast_log(LOG_WARNING, "Couldn't execute stmt: %s\n", sqlite3_errmsg(astdb));
-		res = -1;
+	res = db_deltree_sql(prefix);
+	if (db_cache) {
+		ast_rwlock_wrlock(&cache_lock);
+		db_cache_deltree(S_OR(prefix, NULL));
+		ast_rwlock_unlock(&cache_lock);
 	}
-	res = sqlite3_changes(astdb);
-	sqlite3_reset(stmt);
 	db_sync();
 	ast_mutex_unlock(&dblock);
 
 	return res;
 }
 
+/*! Families whose changes are published, protected by publish_lock */
+static AST_VECTOR(, char *) published_families;
+/*! Number of published families, read without the lock to skip the others quickly */
+static int published_count;
+static ast_rwlock_t publish_lock;
+
+static struct stasis_topic *db_topic;
+static struct stasis_message_type *db_change_message_type;
+AST_MUTEX_DEFINE_STATIC(db_topic_lock);
+
+static struct ast_event *db_change_to_event(struct stasis_message *message)
+{
+	struct ast_db_change *change = stasis_message_data(message);
+	const struct ast_eid *eid = stasis_message_eid(message);
+
+	if (!eid) {
+		return NULL;
+	}
+
+	return ast_event_new(AST_EVENT_DB_CHANGE,
+		AST_EVENT_IE_DB_OP, AST_EVENT_IE_PLTYPE_UINT, change->op,
+		AST_EVENT_IE_DB_FAMILY, AST_EVENT_IE_PLTYPE_STR, change->family,
+		AST_EVENT_IE_DB_KEY, AST_EVENT_IE_PLTYPE_STR, change->key,
+		AST_EVENT_IE_DB_VALUE, AST_EVENT_IE_PLTYPE_STR, S_OR(change->value, ""),
+		AST_EVENT_IE_EID, AST_EVENT_IE_PLTYPE_RAW, eid, sizeof(*eid),
+		AST_EVENT_IE_END);
+}
+
+static struct stasis_message_vtable db_change_vtable = {
+	.to_event = db_change_to_event,
+};
+
+static void db_topic_cleanup(void)
+{
+	ao2_cleanup(db_topic);
+	db_topic = NULL;
+	ao2_cleanup(db_change_message_type);
+	db_change_message_type = NULL;
+}
+
+/*!
+ * \internal
+ * \brief Create the topic and message type on first use
+ *
+ * The database is initialized before stasis is, so this cannot be done
+ * by astdb_init().
+ */
+static void db_topic_init(void)
+{
+	ast_mutex_lock(&db_topic_lock);
+	if (!db_change_message_type) {
+		if (stasis_message_type_create("ast_db_change_type", &db_change_vtable,
+				&db_change_message_type) == STASIS_MESSAGE_TYPE_SUCCESS) {
+			db_topic = stasis_topic_create("db:all");
+			ast_register_cleanup(db_topic_cleanup);
+		}
+	}
+	ast_mutex_unlock(&db_topic_lock);
+}
+
+struct stasis_topic *ast_db_topic(void)
+{
+	db_topic_init();
+	return db_topic;
+}
+
+struct stasis_message_type *ast_db_change_type(void)
+{
+	db_topic_init();
+	return db_change_message_type;
+}
+
+/*! \internal \brief Is a family, or a family above it, published */
+static int db_family_is_published(const char *family)
+{
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&published_families); ++i) {
+		const char *published = AST_VECTOR_GET(&published_families, i);
+		size_t len = strlen(published);
+
+		if (!strncmp(family, published, len) && (!family[len] || family[len] == '/')) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void db_change_publish(enum ast_db_change_op op, const char *family,
+	const char *key, const char *value)
+{
+	struct ast_db_change *change;
+	struct stasis_message *message;
+	size_t family_len;
+	size_t key_len;
+	size_t value_len;
+	int published;
+
+	if (!published_count || ast_strlen_zero(family)) {
+		return;
+	}
+
+	ast_rwlock_rdlock(&publish_lock);
+	published = db_family_is_published(family);
+	ast_rwlock_unlock(&publish_lock);
+	if (!published || !ast_db_change_type()) {
+		return;
+	}
+
+	key = S_OR(key, "");
+	family_len = strlen(family) + 1;
+	key_len = strlen(key) + 1;
+	value_len = value ? strlen(value) + 1 : 0;
+
+	change = ao2_alloc_options(sizeof(*change) + family_len + key_len + value_len, NULL,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!change) {
+		return;
+	}
+	change->op = op;
+	change->family = memcpy(change->data, family, family_len);
+	change->key = memcpy(change->data + family_len, key, key_len);
+	if (value) {
+		change->value = memcpy(change->data + family_len + key_len, value, value_len);
+	}
+
+	message = stasis_message_create(ast_db_change_type(), change);
+	ao2_ref(change, -1);
+	if (message) {
+		stasis_publish(ast_db_topic(), message);
+		ao2_ref(message, -1);
+	}
+}
+
+int ast_db_family_publish(const char *family, int publish)
+{
+	char *dup;
+	int res = 0;
+	int i;
+
+	ast_rwlock_wrlock(&publish_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&published_families); ++i) {
+		if (!strcmp(AST_VECTOR_GET(&published_families, i), family)) {
+			break;
+		}
+	}
+	if (publish && i == AST_VECTOR_SIZE(&published_families)) {
+		dup = ast_strdup(family);
+		if (!dup || AST_VECTOR_APPEND(&published_families, dup)) {
+			ast_free(dup);
+			res = -1;
+		}
+	} else if (!publish && i < AST_VECTOR_SIZE(&published_families)) {
+		ast_free(AST_VECTOR_REMOVE_UNORDERED(&published_families, i));
+	}
+	published_count = AST_VECTOR_SIZE(&published_families);
+	ast_rwlock_unlock(&publish_lock);
+
+	return res;
+}
+
+void ast_db_family_announce(const char *family)
+{
+	struct ast_db_entry *tree;
+	struct ast_db_entry *entry;
+
+	tree = ast_db_gettree(family, NULL);
+	for (entry = tree; entry; entry = entry->next) {
+		/* Entry keys are /family/key */
+		const char *key = entry->key + 1;
+		const char *split = strrchr(key, '/');
+		size_t family_len;
+
+		if (!split) {
+			continue;
+		}
+		family_len = split - key;
+		{
+			char entry_family[family_len + 1];
+
+			ast_copy_string(entry_family, key, sizeof(entry_family));
+			db_change_publish(AST_DB_CHANGE_PUT, entry_family, split + 1, entry->data);
+		}
+	}
+	ast_db_freetree(tree);
+}
+
+int ast_db_change_apply(const struct ast_db_change *change)
+{
+	switch (change->op) {
+	case AST_DB_CHANGE_PUT:
+		return db_put(change->family, change->key, S_OR(change->value, ""));
+	case AST_DB_CHANGE_DEL:
+		return db_del(change->family, change->key);
+	case AST_DB_CHANGE_DELTREE:
+		return db_deltree(change->family, change->key) < 0 ? -1 : 0;
+	}
+
+	return -1;
+}
+
+int ast_db_put(const char *family, const char *key, const char *value)
+{
+	int res = db_put(family, key, value);
+
+	if (!res) {
+		db_change_publish(AST_DB_CHANGE_PUT, family, key, value);
+	}
+
+	return res;
+}
+
+int ast_db_del(const char *family, const char *key)
+{
+	int res = db_del(family, key);
+
+	if (!res) {
+		db_change_publish(AST_DB_CHANGE_DEL, family, key, NULL);
+	}
+
+	return res;
+}
+
+int ast_db_deltree(const char *family, const char *keytree)
+{
+	int res = db_deltree(family, keytree);
+
+	if (res >= 0) {
+		db_change_publish(AST_DB_CHANGE_DELTREE, family, keytree, NULL);
+	}
+
+	return res;
+}
+
 static struct ast_db_entry *db_gettree_common(sqlite3_stmt *stmt)
 {
 	struct ast_db_entry *head = NULL, *prev = NULL, *cur;
 
 	while (sqlite3_step(stmt) == SQLITE_ROW) {
 		const char *key, *value;
-		size_t key_len, value_len;
 
 		key   = (const char *) sqlite3_column_text(stmt, 0);
 		value = (const char *) sqlite3_column_text(stmt, 1);
@@ -504,19 +1345,11 @@ static struct ast_db_entry *db_gettree_common(sqlite3_stmt *stmt)
 			break;
 		}
 
-		key_len = strlen(key);
-		value_len = strlen(value);
-
-		cur = ast_malloc(sizeof(*cur) + key_len + value_len + 2);
+		cur = db_entry_alloc(key, value);
 		if (!cur) {
 			break;
 		}
 
-		cur->next = NULL;
-		cur->key = cur->data + value_len + 1;
-		memcpy(cur->data, value, value_len + 1);
-		memcpy(cur->key, key, key_len + 1);
-
 		if (prev) {
 			prev->next = cur;
 		} else {
@@ -553,6 +1386,10 @@ struct ast_db_entry *ast_db_gettree(const char *family, const char *keytree)
 		stmt = gettree_all_stmt;
 	}
 
+	if (db_cache) {
+		return db_cache_gettree(res ? prefix : NULL, 1);
+	}
+
 	ast_mutex_lock(&dblock);
 	if (res && (sqlite3_bind_text(stmt, 1, prefix, res, SQLITE_STATIC) != SQLITE_OK)) {
 		ast_log(LOG_WARNING, "Could not bind %s to stmt: %s\n", prefix, sqlite3_errmsg(astdb));
@@ -580,6 +1417,10 @@ struct ast_db_entry *ast_db_gettree_by_prefix(const char *family, const char *ke
 		return NULL;
 	}
 
+	if (db_cache) {
+		return db_cache_gettree(prefix, 0);
+	}
+
 	ast_mutex_lock(&dblock);
 	if (sqlite3_bind_text(gettree_prefix_stmt, 1, prefix, res, SQLITE_STATIC) != SQLITE_OK) {
 		ast_log(LOG_WARNING, "Could not bind %s to stmt: %s\n", prefix, sqlite3_errmsg(astdb));
@@ -758,6 +1599,9 @@ static char *handle_cli_database_show(struct ast_cli_entry *e, int cmd, struct a
 	}
 
 	ast_mutex_lock(&dblock);
+	if (db_journal_apply()) {
+		db_sync();
+	}
 	if (!ast_strlen_zero(prefix) && (sqlite3_bind_text(stmt, 1, prefix, -1, SQLITE_STATIC) != SQLITE_OK)) {
 		ast_log(LOG_WARNING, "Could bind %s to stmt: %s\n", prefix, sqlite3_errmsg(astdb));
 		sqlite3_reset(stmt);
@@ -806,6 +1650,9 @@ static char *handle_cli_database_showkey(struct ast_cli_entry *e, int cmd, struc
 	}
 
 	ast_mutex_lock(&dblock);
+	if (db_journal_apply()) {
+		db_sync();
+	}
 	if (!ast_strlen_zero(a->argv[2]) && (sqlite3_bind_text(showkey_stmt, 1, a->argv[2], -1, SQLITE_STATIC) != SQLITE_OK)) {
 		ast_log(LOG_WARNING, "Could bind %s to stmt: %s\n", a->argv[2], sqlite3_errmsg(astdb));
 		sqlite3_reset(showkey_stmt);
@@ -863,7 +1710,12 @@ static char *handle_cli_database_query(struct ast_cli_entry *e, int cmd, struct
 	}
 
 	ast_mutex_lock(&dblock);
+	db_journal_apply();
 	db_execute_sql(a->argv[2], display_results, a);
+	if (db_cache) {
+		/* The query may have changed anything */
+		db_cache_load();
+	}
 	db_sync(); /* Go ahead and sync the db in case they write */
 	ast_mutex_unlock(&dblock);
 
@@ -1032,9 +1884,24 @@ static void *db_sync_thread(void *data)
 		 * Otherwise, block until db_sync() is called.
 		 */
 		while (!dosync) {
-			ast_cond_wait(&dbcond, &dblock);
+			if (db_write_behind) {
+				/* Writers do not signal, so look at the journal this often */
+				struct timeval tv = ast_tvadd(ast_tvnow(), ast_samp2tv(db_write_behind, 1000));
+				struct timespec ts = {
+					.tv_sec = tv.tv_sec,
+					.tv_nsec = tv.tv_usec * 1000,
+				};
+
+				ast_cond_timedwait(&dbcond, &dblock, &ts);
+				if (db_journal_apply()) {
+					dosync = 1;
+				}
+			} else {
+				ast_cond_wait(&dbcond, &dblock);
+			}
 		}
 		dosync = 0;
+		db_journal_apply();
 		if (ast_db_commit_transaction()) {
 			ast_db_rollback_transaction();
 		}
@@ -1044,7 +1911,9 @@ static void *db_sync_thread(void *data)
 		}
 		ast_db_begin_transaction();
 		ast_mutex_unlock(&dblock);
-		sleep(1);
+		if (!db_write_behind) {
+			sleep(1);
+		}
 		ast_mutex_lock(&dblock);
 	}
 
@@ -1072,6 +1941,8 @@ static void astdb_atexit(void)
 
 	pthread_join(syncthread, NULL);
 	ast_mutex_lock(&dblock);
+	ao2_cleanup(db_cache);
+	db_cache = NULL;
 	clean_statements();
 	if (sqlite3_close(astdb) == SQLITE_OK) {
 		astdb = NULL;
@@ -1082,6 +1953,8 @@ static void astdb_atexit(void)
 int astdb_init(void)
 {
 	ast_cond_init(&dbcond, NULL);
+	ast_rwlock_init(&publish_lock);
+	AST_VECTOR_INIT(&published_families, 0);
 
 	if (db_init()) {
 		return -1;
@@ -203,15 +203,36 @@ struct state_change {
 	char device[1];
 };
 
-/*! \brief The state change queue. State changes are queued
-	for processing by a separate thread */
-static AST_LIST_HEAD_STATIC(state_changes, state_change);
+/*! \brief Number of device state change worker threads */
+#define DEVSTATE_CHANGE_WORKERS 8
 
-/*! \brief The device state change notification thread */
-static pthread_t change_thread = AST_PTHREADT_NULL;
+/*! \brief Buckets for the pending changes of each worker */
+#define DEVSTATE_CHANGE_BUCKETS 53
+
+/*!
+ * \brief A device state change worker
+ *
+ * Devices are assigned to a worker by the hash of their name so all
+ * changes for one device are processed in order by the same thread.
+ */
+struct devstate_change_worker {
+	/*! The state change queue, locked by the list lock */
+	AST_LIST_HEAD(, state_change) changes;
+	/*! Queued changes by device name, to coalesce repeated changes */
+	struct ao2_container *pending;
+	/*! Signalled when a change is queued */
+	ast_cond_t change_pending;
+	/*! The worker thread */
+	pthread_t thread;
+};
+
+/*! \brief The device state change workers. State changes are queued
+	for processing by separate threads */
+static struct devstate_change_worker change_workers[DEVSTATE_CHANGE_WORKERS];
+
+/*! \brief Set once the change workers are running */
+static int change_workers_started;
 
-/*! \brief Flag for the queue */
-static ast_cond_t change_pending;
 static volatile int shuttingdown;
 
 struct stasis_subscription *devstate_message_sub;
@@ -468,16 +489,68 @@ static void do_state_change(const char *device, enum ast_devstate_cache cachable
 	ast_publish_device_state(device, state, cachable);
 }
 
-int ast_devstate_changed_literal(enum ast_device_state state, enum ast_devstate_cache cachable, const char *device)
+AO2_STRING_FIELD_HASH_FN(state_change, device);
+AO2_STRING_FIELD_CMP_FN(state_change, device);
+
+/*!
+ * \internal
+ * \brief Queue a state change for the worker owning the device
+ *
+ * A change for a device that is already queued is coalesced into the
+ * queued one, since the state is only determined when it is processed.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int queue_state_change(const char *device, enum ast_devstate_cache cachable)
 {
+	struct devstate_change_worker *worker;
 	struct state_change *change;
 
+	worker = &change_workers[ast_str_hash(device) % DEVSTATE_CHANGE_WORKERS];
+
+	AST_LIST_LOCK(&worker->changes);
+	change = ao2_find(worker->pending, device, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (change) {
+		if (cachable == AST_DEVSTATE_CACHABLE) {
+			change->cachable = cachable;
+		}
+		AST_LIST_UNLOCK(&worker->changes);
+		ao2_ref(change, -1);
+		return 0;
+	}
+
+	change = ao2_alloc_options(sizeof(*change) + strlen(device), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!change) {
+		AST_LIST_UNLOCK(&worker->changes);
+		return -1;
+	}
+	strcpy(change->device, device); /* Safe */
+	change->cachable = cachable;
+
+	if (!ao2_link_flags(worker->pending, change, OBJ_NOLOCK)) {
+		AST_LIST_UNLOCK(&worker->changes);
+		ao2_ref(change, -1);
+		return -1;
+	}
+
+	/* The list now owns our reference */
+	AST_LIST_INSERT_TAIL(&worker->changes, change, list);
+	ast_cond_signal(&worker->change_pending);
+	AST_LIST_UNLOCK(&worker->changes);
+
+	return 0;
+}
+
+int ast_devstate_changed_literal(enum ast_device_state state, enum ast_devstate_cache cachable, const char *device)
+{
 	/*
 	 * If we know the state change (how nice of the caller of this function!)
 	 * then we can just generate a device state event.
 	 *
 	 * Otherwise, we do the following:
-	 *   - Queue an event up to another thread that the state has changed
+	 *   - Queue an event up to the worker thread for the device that the
+	 *     state has changed, coalescing it with one already queued
 	 *   - In the processing thread, it calls the callback provided by the
 	 *     device state provider (which may or may not be a channel driver)
 	 *     to determine the state.
@@ -490,18 +563,10 @@ int ast_devstate_changed_literal(enum ast_device_state state, enum ast_devstate_
 
 	if (state != AST_DEVICE_UNKNOWN) {
 		ast_publish_device_state(device, state, cachable);
-	} else if (change_thread == AST_PTHREADT_NULL || !(change = ast_calloc(1, sizeof(*change) + strlen(device)))) {
-		/* we could not allocate a change struct, or */
-		/* there is no background thread, so process the change now */
+	} else if (!change_workers_started || queue_state_change(device, cachable)) {
+		/* we could not queue the change, or */
+		/* there are no background threads, so process the change now */
 		do_state_change(device, cachable);
-	} else {
-		/* queue the change */
-		strcpy(change->device, device);
-		change->cachable = cachable;
-		AST_LIST_LOCK(&state_changes);
-		AST_LIST_INSERT_TAIL(&state_changes, change, list);
-		ast_cond_signal(&change_pending);
-		AST_LIST_UNLOCK(&state_changes);
 	}
 
 	return 0;
@@ -519,25 +584,28 @@ int ast_devstate_changed(enum ast_device_state state, enum ast_devstate_cache ca
 	return ast_devstate_changed_literal(state, cachable, buf);
 }
 
-/*! \brief Go through the dev state change queue and update changes in the dev state thread */
+/*! \brief Go through the dev state change queue and update changes in a dev state worker thread */
 static void *do_devstate_changes(void *data)
 {
+	struct devstate_change_worker *worker = data;
 	struct state_change *next, *current;
 
 	while (!shuttingdown) {
 		/* This basically pops off any state change entries, resets the list back to NULL, unlocks, and processes each state change */
-		AST_LIST_LOCK(&state_changes);
-		if (AST_LIST_EMPTY(&state_changes))
-			ast_cond_wait(&change_pending, &state_changes.lock);
-		next = AST_LIST_FIRST(&state_changes);
-		AST_LIST_HEAD_INIT_NOLOCK(&state_changes);
-		AST_LIST_UNLOCK(&state_changes);
+		AST_LIST_LOCK(&worker->changes);
+		if (AST_LIST_EMPTY(&worker->changes))
+			ast_cond_wait(&worker->change_pending, &worker->changes.lock);
+		next = AST_LIST_FIRST(&worker->changes);
+		AST_LIST_HEAD_INIT_NOLOCK(&worker->changes);
+		/* Changes queued from here on are new, so stop coalescing into these */
+		ao2_callback(worker->pending, OBJ_NOLOCK | OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, NULL, NULL);
+		AST_LIST_UNLOCK(&worker->changes);
 
 		/* Process each state change */
 		while ((current = next)) {
 			next = AST_LIST_NEXT(current, list);
 			do_state_change(current->device, current->cachable);
-			ast_free(current);
+			ao2_ref(current, -1);
 		}
 	}
 
@@ -604,24 +672,63 @@ static void devstate_change_cb(void *data, struct stasis_subscription *sub, stru
 
 static void device_state_engine_cleanup(void)
 {
+	struct state_change *change;
+	int i;
+
+	change_workers_started = 0;
 	shuttingdown = 1;
-	AST_LIST_LOCK(&state_changes);
-	ast_cond_signal(&change_pending);
-	AST_LIST_UNLOCK(&state_changes);
+	for (i = 0; i < DEVSTATE_CHANGE_WORKERS; i++) {
+		AST_LIST_LOCK(&change_workers[i].changes);
+		ast_cond_signal(&change_workers[i].change_pending);
+		AST_LIST_UNLOCK(&change_workers[i].changes);
+	}
+
+	for (i = 0; i < DEVSTATE_CHANGE_WORKERS; i++) {
+		struct devstate_change_worker *worker = &change_workers[i];
 
-	if (change_thread != AST_PTHREADT_NULL) {
-		pthread_join(change_thread, NULL);
+		if (worker->thread != AST_PTHREADT_NULL) {
+			pthread_join(worker->thread, NULL);
+			worker->thread = AST_PTHREADT_NULL;
+		}
+
+		while ((change = AST_LIST_REMOVE_HEAD(&worker->changes, list))) {
+			ao2_ref(change, -1);
+		}
+		ao2_cleanup(worker->pending);
+		worker->pending = NULL;
 	}
 }
 
-/*! \brief Initialize the device state engine in separate thread */
+/*! \brief Initialize the device state engine in separate threads */
 int ast_device_state_engine_init(void)
 {
-	ast_cond_init(&change_pending, NULL);
-	if (ast_pthread_create_background(&change_thread, NULL, do_devstate_changes, NULL) < 0) {
-		ast_log(LOG_ERROR, "Unable to start device state change thread.\n");
-		return -1;
+	int i;
+
+	for (i = 0; i < DEVSTATE_CHANGE_WORKERS; i++) {
+		struct devstate_change_worker *worker = &change_workers[i];
+
+		AST_LIST_HEAD_INIT(&worker->changes);
+		ast_cond_init(&worker->change_pending, NULL);
+		worker->thread = AST_PTHREADT_NULL;
+		worker->pending = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0,
+			DEVSTATE_CHANGE_BUCKETS, state_change_hash_fn, NULL, state_change_cmp_fn);
+		if (!worker->pending) {
+			ast_log(LOG_ERROR, "Unable to allocate device state change queue.\n");
+			device_state_engine_cleanup();
+			return -1;
+		}
+	}
+
+	for (i = 0; i < DEVSTATE_CHANGE_WORKERS; i++) {
+		if (ast_pthread_create_background(&change_workers[i].thread, NULL,
+			do_devstate_changes, &change_workers[i]) < 0) {
+			ast_log(LOG_ERROR, "Unable to start device state change thread.\n");
+			change_workers[i].thread = AST_PTHREADT_NULL;
+			device_state_engine_cleanup();
+			return -1;
+		}
 	}
+	change_workers_started = 1;
 	ast_register_cleanup(device_state_engine_cleanup);
 
 	return 0;
@@ -43,6 +43,7 @@
 #include "asterisk/causes.h"
 #include "asterisk/stasis_channels.h"
 #include "asterisk/max_forwards.h"
+#include "asterisk/threadpool.h"
 
 /*! \brief Main dialing structure. Contains global options, channels being dialed, and more! */
 struct ast_dial {
@@ -68,6 +69,7 @@ struct ast_dial_channel {
 	void *options[AST_DIAL_OPTION_MAX];	/*!< Channel specific options */
 	int cause;				/*!< Cause code in case of failure */
 	unsigned int is_running_app:1;		/*!< Is this running an application? */
+	unsigned int request_failed:1;		/*!< Was the owner channel requested in parallel and failed? */
 	char *assignedid1;				/*!< UniqueID to assign channel */
 	char *assignedid2;				/*!< UniqueID to assign 2nd channel */
 	struct ast_channel *owner;		/*!< Asterisk channel */
@@ -328,12 +330,244 @@ int ast_dial_append_channel(struct ast_dial *dial, struct ast_channel *chan)
 	return dial_append_common(dial, channel, tech, device, NULL);
 }
 
+/*! \brief Maximum number of threads requesting channels in parallel */
+#define DIAL_REQUEST_POOL_MAX 16
+
+/*! \brief Number of seconds an idle channel request thread lingers */
+#define DIAL_REQUEST_POOL_IDLE 60
+
+/*! \brief Threads shared by all parallel channel requests, created on first use */
+static struct ast_threadpool *request_pool;
+
+/*! \brief Lock protecting the creation and destruction of request_pool */
+AST_MUTEX_DEFINE_STATIC(request_pool_lock);
+
+/*! \brief Channel requests made by one ast_dial_request_parallel() call */
+struct dial_request_batch {
+	ast_mutex_t lock;                  /*!< Lock protecting pending */
+	ast_cond_t cond;                   /*!< Signalled when pending drops to zero */
+	size_t pending;                    /*!< Number of requests still running in the pool */
+	struct ast_channel *requestor;     /*!< Channel asking for the channels */
+	ast_callid callid;                 /*!< callid of the thread asking for the channels */
+};
+
+/*! \brief A single channel request pushed to the request pool */
+struct dial_request_task {
+	struct dial_request_batch *batch;
+	struct ast_dial_request *request;
+};
+
+static void dial_request_pool_shutdown(void)
+{
+	ast_mutex_lock(&request_pool_lock);
+	ast_threadpool_shutdown(request_pool);
+	request_pool = NULL;
+	ast_mutex_unlock(&request_pool_lock);
+}
+
+/*! \brief Helper function that gets the request pool, creating it if needed */
+static struct ast_threadpool *dial_request_pool(void)
+{
+	struct ast_threadpool *pool;
+
+	ast_mutex_lock(&request_pool_lock);
+	if (!request_pool) {
+		struct ast_threadpool_options options = {
+			.version = AST_THREADPOOL_OPTIONS_VERSION,
+			.idle_timeout = DIAL_REQUEST_POOL_IDLE,
+			.auto_increment = 1,
+			.initial_size = 0,
+			.max_size = DIAL_REQUEST_POOL_MAX,
+		};
+
+		request_pool = ast_threadpool_create("dial_request", NULL, &options);
+		if (request_pool) {
+			ast_register_cleanup(dial_request_pool_shutdown);
+		}
+	}
+	pool = request_pool;
+	ast_mutex_unlock(&request_pool_lock);
+
+	return pool;
+}
+
+/*! \brief Helper function that makes a single channel request */
+static void dial_request_one(struct ast_dial_request *request, struct ast_channel *requestor)
+{
+	if (request->topology) {
+		request->chan = ast_request_with_stream_topology(request->tech, request->topology,
+			request->assignedids, requestor, request->device, &request->cause);
+	} else {
+		request->chan = ast_request(request->tech, request->cap,
+			request->assignedids, requestor, request->device, &request->cause);
+	}
+}
+
+static int dial_request_task(void *data)
+{
+	struct dial_request_task *task = data;
+	struct dial_request_batch *batch = task->batch;
+
+	if (batch->callid) {
+		ast_callid_threadassoc_add(batch->callid);
+	}
+
+	dial_request_one(task->request, batch->requestor);
+
+	if (batch->callid) {
+		ast_callid_threadassoc_remove();
+	}
+
+	ast_mutex_lock(&batch->lock);
+	if (!--batch->pending) {
+		ast_cond_signal(&batch->cond);
+	}
+	ast_mutex_unlock(&batch->lock);
+
+	return 0;
+}
+
+void ast_dial_request_parallel(struct ast_dial_request *requests, size_t count, struct ast_channel *requestor)
+{
+	struct dial_request_batch batch = {
+		.requestor = requestor,
+	};
+	struct dial_request_task *tasks;
+	struct ast_threadpool *pool;
+	size_t i;
+
+	if (count < 2 || !(pool = dial_request_pool())
+		|| !(tasks = ast_calloc(count, sizeof(*tasks)))) {
+		for (i = 0; i < count; i++) {
+			dial_request_one(&requests[i], requestor);
+		}
+		return;
+	}
+
+	ast_mutex_init(&batch.lock);
+	ast_cond_init(&batch.cond, NULL);
+	batch.callid = ast_read_threadstorage_callid();
+	batch.pending = count - 1;
+
+	/* The first channel is requested by this thread rather than leaving it idle */
+	for (i = 1; i < count; i++) {
+		tasks[i].batch = &batch;
+		tasks[i].request = &requests[i];
+		if (ast_threadpool_push(pool, dial_request_task, &tasks[i])) {
+			dial_request_one(&requests[i], requestor);
+			ast_mutex_lock(&batch.lock);
+			batch.pending--;
+			ast_mutex_unlock(&batch.lock);
+		}
+	}
+
+	dial_request_one(&requests[0], requestor);
+
+	ast_mutex_lock(&batch.lock);
+	while (batch.pending) {
+		ast_cond_wait(&batch.cond, &batch.lock);
+	}
+	ast_mutex_unlock(&batch.lock);
+
+	ast_cond_destroy(&batch.cond);
+	ast_mutex_destroy(&batch.lock);
+	ast_free(tasks);
+}
+
+/*! \brief Helper function that picks the capabilities to request channels with */
+static struct ast_format_cap *dial_request_cap(struct ast_channel *chan, struct ast_format_cap *cap)
+{
+	struct ast_format_cap *cap_request = NULL;
+
+	if (cap && ast_format_cap_count(cap)) {
+		return ao2_bump(cap);
+	}
+
+	if (chan) {
+		ast_channel_lock(chan);
+		cap_request = ao2_bump(ast_channel_nativeformats(chan));
+		ast_channel_unlock(chan);
+	}
+
+	if (!cap_request) {
+		cap_request = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+		if (cap_request) {
+			ast_format_cap_append_by_type(cap_request, AST_MEDIA_TYPE_AUDIO);
+		}
+	}
+
+	return cap_request;
+}
+
+/*!
+ * \brief Helper function that requests the owner channels of a dial in parallel
+ * \note The channels list of the dial must be locked.
+ */
+static void begin_dial_request(struct ast_dial *dial, struct ast_channel *chan, struct ast_format_cap *cap)
+{
+	struct ast_dial_channel *channel;
+	struct ast_dial_request *requests;
+	struct ast_assigned_ids *assignedids;
+	struct ast_format_cap *cap_request;
+	size_t count = 0;
+	size_t i = 0;
+
+	AST_LIST_TRAVERSE(&dial->channels, channel, list) {
+		if (!channel->owner) {
+			count++;
+		}
+	}
+
+	/* A lone channel is requested by begin_dial_prerun() itself */
+	if (count < 2) {
+		return;
+	}
+
+	requests = ast_calloc(count, sizeof(*requests));
+	assignedids = ast_calloc(count, sizeof(*assignedids));
+	if (!requests || !assignedids) {
+		ast_free(requests);
+		ast_free(assignedids);
+		return;
+	}
+
+	cap_request = dial_request_cap(chan, cap);
+
+	AST_LIST_TRAVERSE(&dial->channels, channel, list) {
+		if (channel->owner) {
+			continue;
+		}
+		assignedids[i].uniqueid = channel->assignedid1;
+		assignedids[i].uniqueid2 = channel->assignedid2;
+		requests[i].tech = channel->tech;
+		requests[i].device = channel->device;
+		requests[i].cap = cap_request;
+		requests[i].assignedids = &assignedids[i];
+		i++;
+	}
+
+	ast_dial_request_parallel(requests, count, chan);
+
+	i = 0;
+	AST_LIST_TRAVERSE(&dial->channels, channel, list) {
+		if (channel->owner) {
+			continue;
+		}
+		channel->owner = requests[i].chan;
+		channel->cause = requests[i].cause;
+		channel->request_failed = !channel->owner;
+		i++;
+	}
+
+	ao2_cleanup(cap_request);
+	ast_free(assignedids);
+	ast_free(requests);
+}
+
 /*! \brief Helper function that requests all channels */
 static int begin_dial_prerun(struct ast_dial_channel *channel, struct ast_channel *chan, struct ast_format_cap *cap, const char *predial_string)
 {
-	struct ast_format_cap *cap_all_audio = NULL;
 	struct ast_format_cap *cap_request;
-	struct ast_format_cap *requester_cap = NULL;
 	struct ast_assigned_ids assignedids = {
 		.uniqueid = channel->assignedid1,
 		.uniqueid2 = channel->assignedid2,
@@ -344,7 +578,6 @@ static int begin_dial_prerun(struct ast_dial_channel *channel, struct ast_channe
 
 		ast_channel_lock(chan);
 		max_forwards = ast_max_forwards_get(chan);
-		requester_cap = ao2_bump(ast_channel_nativeformats(chan));
 		ast_channel_unlock(chan);
 
 		if (max_forwards <= 0) {
@@ -353,25 +586,21 @@ static int begin_dial_prerun(struct ast_dial_channel *channel, struct ast_channe
 		}
 	}
 
+	/* The owner channel was already requested in parallel and could not be created */
+	if (channel->request_failed) {
+		channel->request_failed = 0;
+		return -1;
+	}
+
 	if (!channel->owner) {
-		if (cap && ast_format_cap_count(cap)) {
-			cap_request = cap;
-		} else if (requester_cap) {
-			cap_request = requester_cap;
-		} else {
-			cap_all_audio = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
-			ast_format_cap_append_by_type(cap_all_audio, AST_MEDIA_TYPE_AUDIO);
-			cap_request = cap_all_audio;
-		}
+		cap_request = dial_request_cap(chan, cap);
 
 		/* If we fail to create our owner channel bail out */
-		if (!(channel->owner = ast_request(channel->tech, cap_request, &assignedids, chan, channel->device, &channel->cause))) {
-			ao2_cleanup(cap_all_audio);
+		channel->owner = ast_request(channel->tech, cap_request, &assignedids, chan, channel->device, &channel->cause);
+		ao2_cleanup(cap_request);
+		if (!channel->owner) {
 			return -1;
 		}
-		cap_request = NULL;
-		ao2_cleanup(requester_cap);
-		ao2_cleanup(cap_all_audio);
 	}
 
 	if (chan) {
@@ -437,11 +666,18 @@ int ast_dial_prerun(struct ast_dial *dial, struct ast_channel *chan, struct ast_
 	char *predial_string = dial->options[AST_DIAL_OPTION_PREDIAL];
 
 	AST_LIST_LOCK(&dial->channels);
+	begin_dial_request(dial, chan, cap);
 	AST_LIST_TRAVERSE(&dial->channels, channel, list) {
 		if ((res = begin_dial_prerun(channel, chan, cap, predial_string))) {
 			break;
 		}
 	}
+	if (res) {
+		/* Later channels may also have failed in parallel, let a retry request them again */
+		AST_LIST_TRAVERSE(&dial->channels, channel, list) {
+			channel->request_failed = 0;
+		}
+	}
 	AST_LIST_UNLOCK(&dial->channels);
 
 	return res;
@@ -488,6 +724,7 @@ static int begin_dial(struct ast_dial *dial, struct ast_channel *chan, int async
 
 	/* Iterate through channel list, requesting and calling each one */
 	AST_LIST_LOCK(&dial->channels);
+	begin_dial_request(dial, chan, NULL);
 	AST_LIST_TRAVERSE(&dial->channels, channel, list) {
 		success += begin_dial_channel(channel, chan, async, predial_string, NULL);
 	}
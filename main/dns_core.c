@@ -49,6 +49,59 @@ AST_RWLIST_HEAD_STATIC(resolvers, ast_dns_resolver);
 
 static struct ast_sched_context *sched;
 
+/*! \brief Number of buckets for the DNS result cache */
+#define DNS_CACHE_BUCKETS 127
+
+/*! \brief The longest time, in seconds, a result is kept in the cache */
+#define DNS_CACHE_MAX_TTL 86400
+
+/*! \brief How long, in seconds, a name error or an empty answer is kept in the cache */
+#define DNS_CACHE_NEGATIVE_TTL 30
+
+/*! \brief Percentage of the TTL left below which using an entry refreshes it */
+#define DNS_CACHE_PREFETCH_PERCENT 10
+
+/*! \brief How often, in milliseconds, expired entries are removed from the cache */
+#define DNS_CACHE_SWEEP_INTERVAL 60000
+
+/*! \brief Queries waiting on a cache entry */
+AST_VECTOR(dns_cache_waiters, struct ast_dns_query *);
+
+/*! \brief A cached DNS result, and the queries waiting on it */
+struct dns_cache_entry {
+	/*! \brief The cached result, NULL if there is none */
+	struct ast_dns_result *result;
+	/*! \brief When the result was stored */
+	struct timeval stored;
+	/*! \brief How long, in seconds, the result is valid from when it was stored */
+	int ttl;
+	/*! \brief The lookup in progress for this entry, NULL if there is none */
+	struct ast_dns_query *lookup;
+	/*! \brief Queries waiting on the lookup or on delivery of the cached result */
+	struct dns_cache_waiters waiters;
+	/*! \brief Scheduled delivery of the cached result to waiting queries */
+	int delivery;
+	/*! \brief Resource record type */
+	int rr_type;
+	/*! \brief Resource record class */
+	int rr_class;
+	/*! \brief The name of what is being resolved */
+	char name[0];
+};
+
+/*! \brief Key used to find a cache entry */
+struct dns_cache_key {
+	/*! \brief The name of what is being resolved */
+	const char *name;
+	/*! \brief Resource record type */
+	int rr_type;
+	/*! \brief Resource record class */
+	int rr_class;
+};
+
+/*! \brief The DNS result cache */
+static struct ao2_container *dns_cache;
+
 struct ast_sched_context *ast_dns_get_sched(void)
 {
 	return sched;
@@ -244,7 +297,400 @@ struct ast_dns_query *dns_query_alloc(const char *name, int rr_type, int rr_clas
 	return query;
 }
 
-struct ast_dns_query_active *ast_dns_resolve_async(const char *name, int rr_type, int rr_class, ast_dns_resolve_callback callback, void *data)
+/*! \brief Hashing function for DNS cache entries */
+static int dns_cache_hash(const void *obj, const int flags)
+{
+	const struct dns_cache_entry *entry;
+	const struct dns_cache_key *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = obj;
+		return ast_str_case_hash(key->name) ^ key->rr_type;
+	case OBJ_SEARCH_OBJECT:
+		entry = obj;
+		return ast_str_case_hash(entry->name) ^ entry->rr_type;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+}
+
+/*! \brief Comparison function for DNS cache entries */
+static int dns_cache_cmp(void *obj, void *arg, int flags)
+{
+	const struct dns_cache_entry *entry = obj;
+	const struct dns_cache_entry *other;
+	const struct dns_cache_key *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = arg;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		other = arg;
+		return (entry->rr_type == other->rr_type && entry->rr_class == other->rr_class
+			&& !strcasecmp(entry->name, other->name)) ? CMP_MATCH : 0;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+
+	return (entry->rr_type == key->rr_type && entry->rr_class == key->rr_class
+		&& !strcasecmp(entry->name, key->name)) ? CMP_MATCH : 0;
+}
+
+/*! \brief Destructor for a DNS cache entry */
+static void dns_cache_entry_destroy(void *data)
+{
+	struct dns_cache_entry *entry = data;
+
+	ast_dns_result_free(entry->result);
+	ao2_cleanup(entry->lookup);
+	AST_VECTOR_CALLBACK_VOID(&entry->waiters, ao2_cleanup);
+	AST_VECTOR_FREE(&entry->waiters);
+}
+
+/*! \brief Find the cache entry for a query, creating it if needed */
+static struct dns_cache_entry *dns_cache_entry_get(const struct ast_dns_query *query)
+{
+	struct dns_cache_key key = {
+		.name = query->name,
+		.rr_type = query->rr_type,
+		.rr_class = query->rr_class,
+	};
+	struct dns_cache_entry *entry;
+
+	ao2_lock(dns_cache);
+	entry = ao2_find(dns_cache, &key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!entry) {
+		entry = ao2_alloc(sizeof(*entry) + strlen(query->name) + 1, dns_cache_entry_destroy);
+		if (entry) {
+			AST_VECTOR_INIT(&entry->waiters, 0);
+			entry->delivery = -1;
+			entry->rr_type = query->rr_type;
+			entry->rr_class = query->rr_class;
+			strcpy(entry->name, query->name); /* SAFE */
+			ao2_link_flags(dns_cache, entry, OBJ_NOLOCK);
+		}
+	}
+	ao2_unlock(dns_cache);
+
+	return entry;
+}
+
+/*! \brief How many seconds the cached result has been held for, -1 if it has expired */
+static int dns_cache_entry_age(const struct dns_cache_entry *entry, struct timeval now)
+{
+	int64_t age;
+
+	if (!entry->result) {
+		return -1;
+	}
+
+	age = ast_tvdiff_sec(now, entry->stored);
+
+	return age < entry->ttl ? age : -1;
+}
+
+/*! \brief How long, in seconds, a result may be cached for */
+static int dns_cache_result_ttl(const struct ast_dns_result *result)
+{
+	if (!result || result->bogus) {
+		return 0;
+	}
+
+	if (result->rcode == NXDOMAIN
+		|| (result->rcode == NOERROR && !ast_dns_result_get_records(result))) {
+		return DNS_CACHE_NEGATIVE_TTL;
+	}
+
+	if (result->rcode != NOERROR) {
+		return 0;
+	}
+
+	return MIN(ast_dns_result_get_lowest_ttl(result), DNS_CACHE_MAX_TTL);
+}
+
+/*! \brief Give a query its own copy of a result, aged by the given number of seconds */
+static void dns_cache_result_copy(struct ast_dns_query *query, const struct ast_dns_result *result, int age)
+{
+	const struct ast_dns_record *record;
+
+	/* Records are added back through the resolver API so type specific parsing is redone
+	 * against the copied answer.
+	 */
+	if (ast_dns_resolver_set_result(query, result->secure, result->bogus, result->rcode,
+		result->canonical, result->answer, result->answer_size)) {
+		return;
+	}
+
+	for (record = ast_dns_result_get_records(result); record; record = ast_dns_record_get_next(record)) {
+		ast_dns_resolver_add_record(query, record->rr_type, record->rr_class,
+			record->ttl ? MAX(record->ttl - age, 1) : 0, record->data_ptr, record->data_len);
+	}
+}
+
+/*!
+ * \brief Take the waiting queries off an entry, giving each a copy of the result
+ *
+ * \note The entry must be locked
+ */
+static void dns_cache_take_waiters(struct dns_cache_entry *entry, const struct ast_dns_result *result,
+	int age, struct dns_cache_waiters *waiters)
+{
+	int idx;
+
+	*waiters = entry->waiters;
+	AST_VECTOR_INIT(&entry->waiters, 0);
+
+	if (!result) {
+		return;
+	}
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(waiters); ++idx) {
+		dns_cache_result_copy(AST_VECTOR_GET(waiters, idx), result, age);
+	}
+}
+
+/*! \brief Invoke the callback of queries taken off an entry, releasing them */
+static void dns_cache_complete_waiters(struct dns_cache_waiters *waiters)
+{
+	int idx;
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(waiters); ++idx) {
+		struct ast_dns_query *query = AST_VECTOR_GET(waiters, idx);
+
+		if (query->result) {
+			ast_dns_resolver_completed(query);
+		} else {
+			query->callback(query);
+		}
+		ao2_ref(query, -1);
+	}
+	AST_VECTOR_FREE(waiters);
+}
+
+/*! \brief Scheduled delivery of a cached result to the queries waiting on it */
+static int dns_cache_delivery_callback(const void *data)
+{
+	struct dns_cache_entry *entry = (struct dns_cache_entry *)data;
+	struct dns_cache_waiters waiters;
+	int age;
+
+	ao2_lock(entry);
+	entry->delivery = -1;
+	/* A result which expired since the delivery was scheduled is still handed out */
+	age = entry->result ? MAX(ast_tvdiff_sec(ast_tvnow(), entry->stored), 0) : 0;
+	dns_cache_take_waiters(entry, entry->result, age, &waiters);
+	ao2_unlock(entry);
+
+	dns_cache_complete_waiters(&waiters);
+
+	ao2_ref(entry, -1);
+
+	return 0;
+}
+
+/*!
+ * \brief Schedule delivery of the cached result to the queries waiting on an entry
+ *
+ * \note The entry must be locked
+ */
+static int dns_cache_schedule_delivery(struct dns_cache_entry *entry)
+{
+	if (entry->delivery > -1) {
+		return 0;
+	}
+
+	entry->delivery = ast_sched_add(sched, 0, dns_cache_delivery_callback, ao2_bump(entry));
+	if (entry->delivery < 0) {
+		ao2_ref(entry, -1);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*! \brief Callback for the lookup of a cache entry, invoked upon completion */
+static void dns_cache_lookup_callback(const struct ast_dns_query *lookup)
+{
+	struct dns_cache_entry *entry = ao2_bump(ast_dns_query_get_data(lookup));
+	struct ast_dns_result *result = lookup->result;
+	struct dns_cache_waiters waiters;
+	int ttl = dns_cache_result_ttl(result);
+
+	/* The result is either kept by the entry or freed once handed out */
+	((struct ast_dns_query *)lookup)->result = NULL;
+
+	ao2_lock(entry);
+	dns_cache_take_waiters(entry, result, 0, &waiters);
+	if (ttl > 0) {
+		ast_dns_result_free(entry->result);
+		entry->result = result;
+		entry->stored = ast_tvnow();
+		entry->ttl = ttl;
+		result = NULL;
+	}
+	ao2_replace(entry->lookup, NULL);
+	ao2_unlock(entry);
+
+	dns_cache_complete_waiters(&waiters);
+	ast_dns_result_free(result);
+
+	ao2_ref(entry, -1);
+}
+
+/*!
+ * \brief Create the lookup for a cache entry
+ *
+ * \note The entry must be locked
+ *
+ * \return the lookup, with a reference for the caller, NULL on failure
+ */
+static struct ast_dns_query *dns_cache_lookup_alloc(struct dns_cache_entry *entry)
+{
+	entry->lookup = dns_query_alloc(entry->name, entry->rr_type, entry->rr_class,
+		dns_cache_lookup_callback, entry);
+
+	return ao2_bump(entry->lookup);
+}
+
+/*! \brief Resolve callback of the DNS result cache */
+static int dns_cache_resolve(struct ast_dns_query *query)
+{
+	struct dns_cache_entry *entry;
+	struct ast_dns_query *lookup = NULL;
+	struct timeval now = ast_tvnow();
+	int age;
+	int res = 0;
+
+	if (!dns_cache) {
+		return -1;
+	}
+
+	entry = dns_cache_entry_get(query);
+	if (!entry) {
+		return -1;
+	}
+
+	ast_dns_resolver_set_data(query, entry);
+
+	ao2_lock(entry);
+	if (AST_VECTOR_APPEND(&entry->waiters, ao2_bump(query))) {
+		ao2_ref(query, -1);
+		ao2_unlock(entry);
+		ao2_ref(entry, -1);
+		return -1;
+	}
+
+	age = dns_cache_entry_age(entry, now);
+	if (age > -1) {
+		res = dns_cache_schedule_delivery(entry);
+
+		/* Refresh entries still in use shortly before they expire so they never miss */
+		if (!res && !entry->lookup
+			&& (entry->ttl - age) * 100 < entry->ttl * DNS_CACHE_PREFETCH_PERCENT) {
+			ast_debug(3, "Refreshing cached result for '%s' of class '%d' and type '%d'\n",
+				entry->name, entry->rr_class, entry->rr_type);
+			lookup = dns_cache_lookup_alloc(entry);
+		}
+	} else if (!entry->lookup) {
+		lookup = dns_cache_lookup_alloc(entry);
+		res = lookup ? 0 : -1;
+	}
+
+	if (res) {
+		AST_VECTOR_REMOVE_CMP_UNORDERED(&entry->waiters, query, AST_VECTOR_ELEM_DEFAULT_CMP, ao2_cleanup);
+	}
+	ao2_unlock(entry);
+
+	/* The resolver is called without the entry locked as it may complete synchronously */
+	if (lookup && lookup->resolver->resolve(lookup)) {
+		ast_log(LOG_ERROR, "Resolver '%s' returned an error when resolving '%s' of class '%d' and type '%d'\n",
+			lookup->resolver->name, entry->name, entry->rr_class, entry->rr_type);
+
+		ao2_lock(entry);
+		ao2_replace(entry->lookup, NULL);
+		if (dns_cache_entry_age(entry, now) < 0) {
+			AST_VECTOR_REMOVE_CMP_UNORDERED(&entry->waiters, query, AST_VECTOR_ELEM_DEFAULT_CMP, ao2_cleanup);
+			res = -1;
+
+			/* Anything which joined in the meantime gets whatever the entry holds */
+			if (AST_VECTOR_SIZE(&entry->waiters)) {
+				dns_cache_schedule_delivery(entry);
+			}
+		}
+		ao2_unlock(entry);
+	}
+
+	ao2_cleanup(lookup);
+	ao2_ref(entry, -1);
+
+	return res;
+}
+
+/*! \brief Cancel callback of the DNS result cache */
+static int dns_cache_cancel(struct ast_dns_query *query)
+{
+	struct dns_cache_entry *entry = ast_dns_resolver_get_data(query);
+	int res;
+
+	ao2_lock(entry);
+	/* The lookup is left running so its result still ends up in the cache */
+	res = AST_VECTOR_REMOVE_CMP_UNORDERED(&entry->waiters, query, AST_VECTOR_ELEM_DEFAULT_CMP, ao2_cleanup);
+	ao2_unlock(entry);
+
+	return res;
+}
+
+/*! \brief The DNS result cache, which sits in front of the registered resolvers */
+static struct ast_dns_resolver dns_cache_resolver = {
+	.name = "cache",
+	.resolve = dns_cache_resolve,
+	.cancel = dns_cache_cancel,
+};
+
+void dns_query_use_cache(struct ast_dns_query *query)
+{
+	query->resolver = &dns_cache_resolver;
+}
+
+/*! \brief Callback used to find cache entries which can be removed */
+static int dns_cache_expired_cb(void *obj, void *arg, int flags)
+{
+	struct dns_cache_entry *entry = obj;
+	const struct timeval *now = arg;
+	int res;
+
+	ao2_lock(entry);
+	res = !entry->lookup && !AST_VECTOR_SIZE(&entry->waiters) && entry->delivery < 0
+		&& dns_cache_entry_age(entry, *now) < 0;
+	ao2_unlock(entry);
+
+	return res ? CMP_MATCH : 0;
+}
+
+/*! \brief Scheduled removal of expired cache entries */
+static int dns_cache_sweep(const void *data)
+{
+	struct timeval now = ast_tvnow();
+
+	ao2_callback(dns_cache, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, dns_cache_expired_cb, &now);
+
+	return DNS_CACHE_SWEEP_INTERVAL;
+}
+
+void ast_dns_cache_flush(void)
+{
+	if (dns_cache) {
+		ao2_callback(dns_cache, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
+	}
+}
+
+/*! \brief Start an asynchronous resolution, optionally through the DNS result cache */
+static struct ast_dns_query_active *dns_resolve_async(const char *name, int rr_type, int rr_class,
+	ast_dns_resolve_callback callback, void *data, int cached)
 {
 	struct ast_dns_query_active *active;
 
@@ -259,6 +705,10 @@ struct ast_dns_query_active *ast_dns_resolve_async(const char *name, int rr_type
 		return NULL;
 	}
 
+	if (cached) {
+		dns_query_use_cache(active->query);
+	}
+
 	if (active->query->resolver->resolve(active->query)) {
 		ast_log(LOG_ERROR, "Resolver '%s' returned an error when resolving '%s' of class '%d' and type '%d'\n",
 			active->query->resolver->name, name, rr_class, rr_type);
@@ -269,6 +719,16 @@ struct ast_dns_query_active *ast_dns_resolve_async(const char *name, int rr_type
 	return active;
 }
 
+struct ast_dns_query_active *ast_dns_resolve_async(const char *name, int rr_type, int rr_class, ast_dns_resolve_callback callback, void *data)
+{
+	return dns_resolve_async(name, rr_type, rr_class, callback, data, 0);
+}
+
+struct ast_dns_query_active *ast_dns_resolve_async_cached(const char *name, int rr_type, int rr_class, ast_dns_resolve_callback callback, void *data)
+{
+	return dns_resolve_async(name, rr_type, rr_class, callback, data, 1);
+}
+
 int ast_dns_resolve_cancel(struct ast_dns_query_active *active)
 {
 	return active->query->resolver->cancel(active->query);
@@ -311,7 +771,8 @@ static void dns_synchronous_resolve_callback(const struct ast_dns_query *query)
 	ast_mutex_unlock(&synchronous->lock);
 }
 
-int ast_dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_result **result)
+/*! \brief Synchronously resolve a DNS query, optionally through the DNS result cache */
+static int dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_result **result, int cached)
 {
 	struct dns_synchronous_resolve *synchronous;
 	struct ast_dns_query_active *active;
@@ -349,7 +810,7 @@ int ast_dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_
 	ast_mutex_init(&synchronous->lock);
 	ast_cond_init(&synchronous->cond, NULL);
 
-	active = ast_dns_resolve_async(name, rr_type, rr_class, dns_synchronous_resolve_callback, synchronous);
+	active = dns_resolve_async(name, rr_type, rr_class, dns_synchronous_resolve_callback, synchronous, cached);
 	if (active) {
 		/* Wait for resolution to complete */
 		ast_mutex_lock(&synchronous->lock);
@@ -366,6 +827,16 @@ int ast_dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_
 	return *result ? 0 : -1;
 }
 
+int ast_dns_resolve(const char *name, int rr_type, int rr_class, struct ast_dns_result **result)
+{
+	return dns_resolve(name, rr_type, rr_class, result, 0);
+}
+
+int ast_dns_resolve_cached(const char *name, int rr_type, int rr_class, struct ast_dns_result **result)
+{
+	return dns_resolve(name, rr_type, rr_class, result, 1);
+}
+
 int ast_dns_resolve_ipv6_and_ipv4(struct ast_sockaddr *address, const char *host, const char *port)
 {
 	RAII_VAR(struct ast_dns_query_set *, queries, ast_dns_query_set_create(), ao2_cleanup);
@@ -609,6 +1080,9 @@ static void dns_shutdown(void)
 		ast_sched_context_destroy(sched);
 		sched = NULL;
 	}
+
+	ao2_cleanup(dns_cache);
+	dns_cache = NULL;
 }
 
 int dns_core_init(void)
@@ -622,6 +1096,12 @@ int dns_core_init(void)
 		return -1;
 	}
 
+	dns_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, DNS_CACHE_BUCKETS,
+		dns_cache_hash, NULL, dns_cache_cmp);
+	if (!dns_cache || ast_sched_add(sched, DNS_CACHE_SWEEP_INTERVAL, dns_cache_sweep, NULL) < 0) {
+		return -1;
+	}
+
 	ast_register_cleanup(dns_shutdown);
 
 	return 0;
@@ -102,7 +102,8 @@ static void dns_query_set_callback(const struct ast_dns_query *query)
 	ao2_ref(query_set, -1);
 }
 
-int ast_dns_query_set_add(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class)
+/*! \brief Add a query to a query set, optionally answered through the DNS result cache */
+static int dns_query_set_add(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class, int cached)
 {
 	struct dns_query_set_query query = {
 		.started = 0,
@@ -128,6 +129,10 @@ int ast_dns_query_set_add(struct ast_dns_query_set *query_set, const char *name,
 		return -1;
 	}
 
+	if (cached) {
+		dns_query_use_cache(query.query);
+	}
+
 	if (AST_VECTOR_APPEND(&query_set->queries, query)) {
 		ao2_ref(query.query, -1);
 		return -1;
@@ -136,6 +141,16 @@ int ast_dns_query_set_add(struct ast_dns_query_set *query_set, const char *name,
 	return 0;
 }
 
+int ast_dns_query_set_add(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class)
+{
+	return dns_query_set_add(query_set, name, rr_type, rr_class, 0);
+}
+
+int ast_dns_query_set_add_cached(struct ast_dns_query_set *query_set, const char *name, int rr_type, int rr_class)
+{
+	return dns_query_set_add(query_set, name, rr_type, rr_class, 1);
+}
+
 size_t ast_dns_query_set_num_queries(const struct ast_dns_query_set *query_set)
 {
 	return AST_VECTOR_SIZE(&query_set->queries);
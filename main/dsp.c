@@ -53,6 +53,8 @@
 	<support_level>core</support_level>
  ***/
 
+/* Needed for the mm_malloc.h pulled in by immintrin.h */
+#define ASTMM_LIBC ASTMM_IGNORE
 #include "asterisk.h"
 
 #include <math.h>
@@ -69,6 +71,17 @@
 #include "asterisk/config.h"
 #include "asterisk/test.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DSP_GOERTZEL_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define DSP_GOERTZEL_NEON 1
+#include <arm_neon.h>
+#endif
+
 /*! Number of goertzels for progress detect */
 enum gsamp_size {
 	GSAMP_SIZE_NA = 183,			/*!< North America - 350, 440, 480, 620, 950, 1400, 1800 Hz */
@@ -384,6 +397,178 @@ static inline void goertzel_reset(goertzel_state_t *s)
 	s->v2 = s->v3 = s->chunky = 0;
 }
 
+/*! Most goertzels a bank feeds at once, enough for any of the detectors */
+#define GOERTZEL_BANK_MAX 8
+
+/*!
+ * \brief Feed a block of samples to several goertzels
+ *
+ * \param states The goertzels to feed, at most GOERTZEL_BANK_MAX
+ * \param count Number of goertzels in states
+ * \param amp The samples
+ * \param samples Number of samples
+ */
+typedef void (*goertzel_bank_fn)(goertzel_state_t * const *states, int count,
+	const short *amp, int samples);
+
+static void scalar_goertzel_bank(goertzel_state_t * const *states, int count,
+	const short *amp, int samples)
+{
+	int i;
+	int j;
+
+	for (j = 0; j < samples; j++) {
+		for (i = 0; i < count; i++) {
+			goertzel_sample(states[i], amp[j]);
+		}
+	}
+}
+
+#ifdef DSP_GOERTZEL_X86
+/*
+ * One goertzel per 32 bit lane.  Every step is the same integer operation
+ * goertzel_sample() does, including the per goertzel rescale, so the
+ * states come out bit for bit identical.  Unused lanes run with a zero
+ * coefficient and are discarded.
+ */
+__attribute__((target("avx2")))
+static void avx2_goertzel_bank(goertzel_state_t * const *states, int count,
+	const short *amp, int samples)
+{
+	int v2[GOERTZEL_BANK_MAX] = { 0, };
+	int v3[GOERTZEL_BANK_MAX] = { 0, };
+	int chunky[GOERTZEL_BANK_MAX] = { 0, };
+	int fac[GOERTZEL_BANK_MAX] = { 0, };
+	__m256i vv1;
+	__m256i vv2;
+	__m256i vv3;
+	__m256i vchunky;
+	__m256i vfac;
+	__m256i limit = _mm256_set1_epi32(1 << 15);
+	int i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		v2[i] = states[i]->v2;
+		v3[i] = states[i]->v3;
+		chunky[i] = states[i]->chunky;
+		fac[i] = states[i]->fac;
+	}
+
+	vv2 = _mm256_loadu_si256((const __m256i *) v2);
+	vv3 = _mm256_loadu_si256((const __m256i *) v3);
+	vchunky = _mm256_loadu_si256((const __m256i *) chunky);
+	vfac = _mm256_loadu_si256((const __m256i *) fac);
+
+	for (j = 0; j < samples; j++) {
+		__m256i over;
+
+		vv1 = vv2;
+		vv2 = vv3;
+		vv3 = _mm256_srai_epi32(_mm256_mullo_epi32(vfac, vv2), 15);
+		vv3 = _mm256_add_epi32(_mm256_sub_epi32(vv3, vv1),
+			_mm256_srav_epi32(_mm256_set1_epi32(amp[j]), vchunky));
+
+		over = _mm256_cmpgt_epi32(_mm256_abs_epi32(vv3), limit);
+		vchunky = _mm256_sub_epi32(vchunky, over);
+		vv3 = _mm256_blendv_epi8(vv3, _mm256_srai_epi32(vv3, 1), over);
+		vv2 = _mm256_blendv_epi8(vv2, _mm256_srai_epi32(vv2, 1), over);
+	}
+
+	_mm256_storeu_si256((__m256i *) v2, vv2);
+	_mm256_storeu_si256((__m256i *) v3, vv3);
+	_mm256_storeu_si256((__m256i *) chunky, vchunky);
+
+	for (i = 0; i < count; i++) {
+		states[i]->v2 = v2[i];
+		states[i]->v3 = v3[i];
+		states[i]->chunky = chunky[i];
+	}
+}
+#endif /* DSP_GOERTZEL_X86 */
+
+#ifdef DSP_GOERTZEL_NEON
+/* As the AVX2 version, with the bank split over two vectors of four */
+static void neon_goertzel_bank(goertzel_state_t * const *states, int count,
+	const short *amp, int samples)
+{
+	int v2[GOERTZEL_BANK_MAX] = { 0, };
+	int v3[GOERTZEL_BANK_MAX] = { 0, };
+	int chunky[GOERTZEL_BANK_MAX] = { 0, };
+	int fac[GOERTZEL_BANK_MAX] = { 0, };
+	int32x4_t vv1[2];
+	int32x4_t vv2[2];
+	int32x4_t vv3[2];
+	int32x4_t vchunky[2];
+	int32x4_t vfac[2];
+	int32x4_t limit = vdupq_n_s32(1 << 15);
+	int i;
+	int j;
+	int k;
+
+	for (i = 0; i < count; i++) {
+		v2[i] = states[i]->v2;
+		v3[i] = states[i]->v3;
+		chunky[i] = states[i]->chunky;
+		fac[i] = states[i]->fac;
+	}
+
+	for (k = 0; k < 2; k++) {
+		vv2[k] = vld1q_s32(v2 + k * 4);
+		vv3[k] = vld1q_s32(v3 + k * 4);
+		vchunky[k] = vld1q_s32(chunky + k * 4);
+		vfac[k] = vld1q_s32(fac + k * 4);
+	}
+
+	for (j = 0; j < samples; j++) {
+		int32x4_t sample = vdupq_n_s32(amp[j]);
+
+		for (k = 0; k < 2; k++) {
+			uint32x4_t over;
+
+			vv1[k] = vv2[k];
+			vv2[k] = vv3[k];
+			vv3[k] = vshrq_n_s32(vmulq_s32(vfac[k], vv2[k]), 15);
+			vv3[k] = vaddq_s32(vsubq_s32(vv3[k], vv1[k]),
+				vshlq_s32(sample, vnegq_s32(vchunky[k])));
+
+			over = vcgtq_s32(vabsq_s32(vv3[k]), limit);
+			vchunky[k] = vsubq_s32(vchunky[k], vreinterpretq_s32_u32(over));
+			vv3[k] = vbslq_s32(over, vshrq_n_s32(vv3[k], 1), vv3[k]);
+			vv2[k] = vbslq_s32(over, vshrq_n_s32(vv2[k], 1), vv2[k]);
+		}
+	}
+
+	for (k = 0; k < 2; k++) {
+		vst1q_s32(v2 + k * 4, vv2[k]);
+		vst1q_s32(v3 + k * 4, vv3[k]);
+		vst1q_s32(chunky + k * 4, vchunky[k]);
+	}
+
+	for (i = 0; i < count; i++) {
+		states[i]->v2 = v2[i];
+		states[i]->v3 = v3[i];
+		states[i]->chunky = chunky[i];
+	}
+}
+#endif /* DSP_GOERTZEL_NEON */
+
+/*! \brief The goertzel bank in use, plain C until picked at load */
+static goertzel_bank_fn goertzel_bank = scalar_goertzel_bank;
+
+/*! \brief Pick the fastest goertzel bank the CPU supports */
+static void goertzel_bank_select(void)
+{
+#if defined(DSP_GOERTZEL_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		goertzel_bank = avx2_goertzel_bank;
+	}
+#elif defined(DSP_GOERTZEL_NEON)
+	goertzel_bank = neon_goertzel_bank;
+#endif
+}
+
 typedef struct {
 	int start;
 	int end;
@@ -693,6 +878,10 @@ static int dtmf_detect(struct ast_dsp *dsp, digit_detect_state_t *s, int16_t amp
 	int hit;
 	int limit;
 	fragment_t mute = {0, 0};
+	goertzel_state_t * const bank[] = {
+		&s->td.dtmf.row_out[0], &s->td.dtmf.row_out[1], &s->td.dtmf.row_out[2], &s->td.dtmf.row_out[3],
+		&s->td.dtmf.col_out[0], &s->td.dtmf.col_out[1], &s->td.dtmf.col_out[2], &s->td.dtmf.col_out[3],
+	};
 
 	if (squelch && s->td.dtmf.mute_samples > 0) {
 		mute.end = (s->td.dtmf.mute_samples < samples) ? s->td.dtmf.mute_samples : samples;
@@ -707,22 +896,11 @@ static int dtmf_detect(struct ast_dsp *dsp, digit_detect_state_t *s, int16_t amp
 		} else {
 			limit = samples;
 		}
-		/* The following unrolled loop takes only 35% (rough estimate) of the
-		   time of a rolled loop on the machine on which it was developed */
 		for (j = sample; j < limit; j++) {
 			samp = amp[j];
 			s->td.dtmf.energy += (int32_t) samp * (int32_t) samp;
-			/* With GCC 2.95, the following unrolled code seems to take about 35%
-			   (rough estimate) as long as a neat little 0-3 loop */
-			goertzel_sample(s->td.dtmf.row_out, samp);
-			goertzel_sample(s->td.dtmf.col_out, samp);
-			goertzel_sample(s->td.dtmf.row_out + 1, samp);
-			goertzel_sample(s->td.dtmf.col_out + 1, samp);
-			goertzel_sample(s->td.dtmf.row_out + 2, samp);
-			goertzel_sample(s->td.dtmf.col_out + 2, samp);
-			goertzel_sample(s->td.dtmf.row_out + 3, samp);
-			goertzel_sample(s->td.dtmf.col_out + 3, samp);
 		}
+		goertzel_bank(bank, ARRAY_LEN(bank), amp + sample, limit - sample);
 		s->td.dtmf.current_sample += (limit - sample);
 		if (s->td.dtmf.current_sample < DTMF_GSIZE) {
 			continue;
@@ -894,12 +1072,14 @@ static int mf_detect(struct ast_dsp *dsp, digit_detect_state_t *s, int16_t amp[]
 	int best;
 	int second_best;
 	int i;
-	int j;
 	int sample;
-	short samp;
 	int hit;
 	int limit;
 	fragment_t mute = {0, 0};
+	goertzel_state_t * const bank[] = {
+		&s->td.mf.tone_out[0], &s->td.mf.tone_out[1], &s->td.mf.tone_out[2],
+		&s->td.mf.tone_out[3], &s->td.mf.tone_out[4], &s->td.mf.tone_out[5],
+	};
 
 	if (squelch && s->td.mf.mute_samples > 0) {
 		mute.end = (s->td.mf.mute_samples < samples) ? s->td.mf.mute_samples : samples;
@@ -915,19 +1095,7 @@ static int mf_detect(struct ast_dsp *dsp, digit_detect_state_t *s, int16_t amp[]
 		} else {
 			limit = samples;
 		}
-		/* The following unrolled loop takes only 35% (rough estimate) of the
-		   time of a rolled loop on the machine on which it was developed */
-		for (j = sample; j < limit; j++) {
-			/* With GCC 2.95, the following unrolled code seems to take about 35%
-			   (rough estimate) as long as a neat little 0-3 loop */
-			samp = amp[j];
-			goertzel_sample(s->td.mf.tone_out, samp);
-			goertzel_sample(s->td.mf.tone_out + 1, samp);
-			goertzel_sample(s->td.mf.tone_out + 2, samp);
-			goertzel_sample(s->td.mf.tone_out + 3, samp);
-			goertzel_sample(s->td.mf.tone_out + 4, samp);
-			goertzel_sample(s->td.mf.tone_out + 5, samp);
-		}
+		goertzel_bank(bank, ARRAY_LEN(bank), amp + sample, limit - sample);
 		s->td.mf.current_sample += (limit - sample);
 		if (s->td.mf.current_sample < MF_GSIZE) {
 			continue;
@@ -1070,6 +1238,11 @@ static int __ast_dsp_call_progress(struct ast_dsp *dsp, short *s, int len)
 	int newstate = DSP_TONE_STATE_SILENCE;
 	int res = 0;
 	int freqcount = dsp->freqcount > FREQ_ARRAY_SIZE ? FREQ_ARRAY_SIZE : dsp->freqcount;
+	goertzel_state_t *bank[FREQ_ARRAY_SIZE];
+
+	for (y = 0; y < freqcount; y++) {
+		bank[y] = &dsp->freqs[y];
+	}
 
 	while (len) {
 		/* Take the lesser of the number of samples we need and what we have */
@@ -1080,10 +1253,8 @@ static int __ast_dsp_call_progress(struct ast_dsp *dsp, short *s, int len)
 		for (x = 0; x < pass; x++) {
 			samp = s[x];
 			dsp->genergy += (int32_t) samp * (int32_t) samp;
-			for (y = 0; y < freqcount; y++) {
-				goertzel_sample(&dsp->freqs[y], samp);
-			}
 		}
+		goertzel_bank(bank, freqcount, s, pass);
 		s += pass;
 		dsp->gsamps += pass;
 		len -= pass;
@@ -2394,22 +2565,100 @@ AST_TEST_DEFINE(test_dsp_dtmf_detect)
 }
 #endif
 
+#ifdef TEST_FRAMEWORK
+AST_TEST_DEFINE(test_dsp_goertzel_bank)
+{
+	static const float freqs[] = {
+		697.0, 770.0, 852.0, 941.0, 1209.0, 1336.0, 1477.0, 1633.0,
+	};
+	goertzel_state_t expected[ARRAY_LEN(freqs)];
+	goertzel_state_t actual[ARRAY_LEN(freqs)];
+	goertzel_state_t *expected_bank[ARRAY_LEN(freqs)];
+	goertzel_state_t *actual_bank[ARRAY_LEN(freqs)];
+	short amp[DTMF_GSIZE];
+	int block;
+	int count;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "goertzel_bank";
+		info->category = "/main/dsp/";
+		info->summary = "DSP goertzel bank unit test";
+		info->description =
+			"Tests that the goertzel bank in use gives the same\n"
+			"results as feeding each goertzel on its own.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (goertzel_bank == scalar_goertzel_bank) {
+		ast_test_status_update(test, "No vector goertzel bank for this CPU, nothing to compare\n");
+		return AST_TEST_PASS;
+	}
+
+	for (count = 1; count <= ARRAY_LEN(freqs); count++) {
+		for (i = 0; i < count; i++) {
+			goertzel_init(&expected[i], freqs[i], DEFAULT_SAMPLE_RATE);
+			goertzel_init(&actual[i], freqs[i], DEFAULT_SAMPLE_RATE);
+			expected_bank[i] = &expected[i];
+			actual_bank[i] = &actual[i];
+		}
+
+		/* Full scale tones, noise and silence, in uneven pieces */
+		for (block = 0; block < 32; block++) {
+			int samples = 1 + ast_random() % ARRAY_LEN(amp);
+
+			if (block % 4 == 0) {
+				test_dual_sample_gen(amp, samples, DEFAULT_SAMPLE_RATE,
+					freqs[block % ARRAY_LEN(freqs)], 0x3fff, freqs[(block + 5) % ARRAY_LEN(freqs)], 0x3fff);
+			} else if (block % 4 == 3) {
+				memset(amp, 0, sizeof(amp));
+			} else {
+				for (i = 0; i < samples; i++) {
+					amp[i] = (short) ast_random();
+				}
+			}
+
+			scalar_goertzel_bank(expected_bank, count, amp, samples);
+			goertzel_bank(actual_bank, count, amp, samples);
+
+			for (i = 0; i < count; i++) {
+				if (expected[i].v2 != actual[i].v2 || expected[i].v3 != actual[i].v3
+					|| expected[i].chunky != actual[i].chunky) {
+					ast_test_status_update(test, "Goertzel %d of %d differs after block %d\n",
+						i, count, block);
+					return AST_TEST_FAIL;
+				}
+			}
+		}
+	}
+
+	return AST_TEST_PASS;
+}
+#endif
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(test_dsp_fax_detect);
 	AST_TEST_UNREGISTER(test_dsp_dtmf_detect);
+	AST_TEST_UNREGISTER(test_dsp_goertzel_bank);
 
 	return 0;
 }
 
 static int load_module(void)
 {
+	goertzel_bank_select();
+
 	if (_dsp_init(0)) {
 		return AST_MODULE_LOAD_FAILURE;
 	}
 
 	AST_TEST_REGISTER(test_dsp_fax_detect);
 	AST_TEST_REGISTER(test_dsp_dtmf_detect);
+	AST_TEST_REGISTER(test_dsp_goertzel_bank);
 
 	return AST_MODULE_LOAD_SUCCESS;
 }
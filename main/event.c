@@ -120,6 +120,7 @@ static const char * const event_names[AST_EVENT_TOTAL] = {
 	[AST_EVENT_PRESENCE_STATE]      = "PresenceState",
 	[AST_EVENT_ACL_CHANGE]          = "ACLChange",
 	[AST_EVENT_PING]                = "Ping",
+	[AST_EVENT_DB_CHANGE]           = "DBChange",
 };
 
 /*!
@@ -189,6 +190,12 @@ static const struct ie_map {
 	[AST_EVENT_IE_PRESENCE_STATE]      = { AST_EVENT_IE_PLTYPE_UINT, "PresenceState" },
 	[AST_EVENT_IE_PRESENCE_SUBTYPE]    = { AST_EVENT_IE_PLTYPE_STR,  "PresenceSubtype" },
 	[AST_EVENT_IE_PRESENCE_MESSAGE]    = { AST_EVENT_IE_PLTYPE_STR,  "PresenceMessage" },
+	[AST_EVENT_IE_SUPPRESSED_EVENT]    = { AST_EVENT_IE_PLTYPE_STR,  "SuppressedEvent" },
+	[AST_EVENT_IE_SUPPRESSED_COUNT]    = { AST_EVENT_IE_PLTYPE_UINT, "SuppressedCount" },
+	[AST_EVENT_IE_DB_OP]               = { AST_EVENT_IE_PLTYPE_UINT, "DBOp" },
+	[AST_EVENT_IE_DB_FAMILY]           = { AST_EVENT_IE_PLTYPE_STR,  "DBFamily" },
+	[AST_EVENT_IE_DB_KEY]              = { AST_EVENT_IE_PLTYPE_STR,  "DBKey" },
+	[AST_EVENT_IE_DB_VALUE]            = { AST_EVENT_IE_PLTYPE_STR,  "DBValue" },
 };
 
 const char *ast_event_get_type_name(const struct ast_event *event)
@@ -30,6 +30,7 @@
 #include "asterisk.h"
 
 #include <dirent.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <math.h>
@@ -68,6 +69,11 @@ int ast_language_is_prefix = 1;
 
 static AST_RWLIST_HEAD_STATIC(formats, ast_format_def);
 
+/*! \brief Sinks recordings can be streamed to instead of the file system */
+static AST_RWLIST_HEAD_STATIC(file_sinks, ast_file_sink);
+
+static void file_cache_flush(void);
+
 STASIS_MESSAGE_TYPE_DEFN(ast_format_register_type);
 STASIS_MESSAGE_TYPE_DEFN(ast_format_unregister_type);
 
@@ -159,6 +165,96 @@ int __ast_format_def_register(const struct ast_format_def *f, struct ast_module
 	return 0;
 }
 
+int __ast_file_sink_register(const struct ast_file_sink *sink, struct ast_module *mod)
+{
+	struct ast_file_sink *tmp;
+
+	AST_RWLIST_WRLOCK(&file_sinks);
+	AST_RWLIST_TRAVERSE(&file_sinks, tmp, list) {
+		if (!strcasecmp(sink->scheme, tmp->scheme)) {
+			AST_RWLIST_UNLOCK(&file_sinks);
+			ast_log(LOG_WARNING, "Tried to register a sink for '%s', already registered\n", sink->scheme);
+			return -1;
+		}
+	}
+	if (!(tmp = ast_calloc(1, sizeof(*tmp)))) {
+		AST_RWLIST_UNLOCK(&file_sinks);
+		return -1;
+	}
+	*tmp = *sink;
+	tmp->module = mod;
+	memset(&tmp->list, 0, sizeof(tmp->list));
+
+	AST_RWLIST_INSERT_HEAD(&file_sinks, tmp, list);
+	AST_RWLIST_UNLOCK(&file_sinks);
+	ast_verb(2, "Registered file sink for %s://\n", sink->scheme);
+
+	return 0;
+}
+
+int ast_file_sink_unregister(const char *scheme)
+{
+	struct ast_file_sink *tmp;
+
+	AST_RWLIST_WRLOCK(&file_sinks);
+	AST_RWLIST_TRAVERSE_SAFE_BEGIN(&file_sinks, tmp, list) {
+		if (!strcasecmp(scheme, tmp->scheme)) {
+			AST_RWLIST_REMOVE_CURRENT(list);
+			break;
+		}
+	}
+	AST_RWLIST_TRAVERSE_SAFE_END;
+	AST_RWLIST_UNLOCK(&file_sinks);
+
+	if (!tmp) {
+		return -1;
+	}
+	ast_verb(2, "Unregistered file sink for %s://\n", scheme);
+	ast_free(tmp);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Find the sink for a file name
+ *
+ * \pre file_sinks is locked
+ */
+static struct ast_file_sink *file_sink_find(const char *filename)
+{
+	const char *sep = strstr(filename, "://");
+	struct ast_file_sink *sink;
+
+	if (!sep) {
+		return NULL;
+	}
+
+	AST_RWLIST_TRAVERSE(&file_sinks, sink, list) {
+		if (strlen(sink->scheme) == sep - filename
+			&& !strncasecmp(filename, sink->scheme, sep - filename)) {
+			return sink;
+		}
+	}
+
+	return NULL;
+}
+
+int ast_file_is_sink(const char *filename)
+{
+	int res;
+
+	if (!strstr(filename, "://")) {
+		return 0;
+	}
+
+	AST_RWLIST_RDLOCK(&file_sinks);
+	res = file_sink_find(filename) ? 1 : 0;
+	AST_RWLIST_UNLOCK(&file_sinks);
+
+	return res;
+}
+
 int ast_format_def_unregister(const char *name)
 {
 	struct ast_format_def *tmp;
@@ -176,6 +272,11 @@ int ast_format_def_unregister(const char *name)
 	AST_RWLIST_TRAVERSE_SAFE_END;
 	AST_RWLIST_UNLOCK(&formats);
 
+	/* Cached frames were read by the format going away */
+	if (!res) {
+		file_cache_flush();
+	}
+
 	if (!res)
 		ast_verb(2, "Unregistered format %s\n", name);
 	else
@@ -393,7 +494,8 @@ static void filestream_destructor(void *arg)
 	if (f->trans)
 		ast_translator_free_path(f->trans);
 
-	if (f->fmt->close) {
+	/* A stream playing from the file cache or a mapping was never opened by its format */
+	if (f->fmt->close && !f->cache && !f->map) {
 		void (*closefn)(struct ast_filestream *) = f->fmt->close;
 		closefn(f);
 	}
@@ -422,6 +524,10 @@ static void filestream_destructor(void *arg)
 	ast_free((void *)f->orig_chan_name);
 	ao2_cleanup(f->lastwriteformat);
 	ao2_cleanup(f->fr.subclass.format);
+	ao2_cleanup(f->cache);
+	if (f->map) {
+		munmap(f->map, f->map_size);
+	}
 	ast_module_unref(f->fmt->module);
 }
 
@@ -465,31 +571,739 @@ static struct ast_filestream *get_filestream(struct ast_format_def *fmt, FILE *b
  */
 enum wrap_fn { WRAP_OPEN, WRAP_REWRITE };
 
-static int fn_wrapper(struct ast_filestream *s, const char *comment, enum wrap_fn mode)
+static int fn_wrapper(struct ast_filestream *s, const char *comment, enum wrap_fn mode)
+{
+	struct ast_format_def *f = s->fmt;
+	int ret = -1;
+	int (*openfn)(struct ast_filestream *s);
+
+	if (mode == WRAP_OPEN && (openfn = f->open) && openfn(s))
+		ast_log(LOG_WARNING, "Unable to open format %s\n", f->name);
+	else if (mode == WRAP_REWRITE && f->rewrite && f->rewrite(s, comment))
+		ast_log(LOG_WARNING, "Unable to rewrite format %s\n", f->name);
+	else {
+		/* preliminary checks succeed. */
+		ret = 0;
+	}
+	return ret;
+}
+
+static int rewrite_wrapper(struct ast_filestream *s, const char *comment)
+{
+	return fn_wrapper(s, comment, WRAP_REWRITE);
+}
+
+static int open_wrapper(struct ast_filestream *s)
+{
+	return fn_wrapper(s, NULL, WRAP_OPEN);
+}
+
+/*! \brief Number of buckets in the file cache */
+#define FILE_CACHE_BUCKETS 61
+
+/*! \brief The largest share of the file cache a single file may take */
+#define FILE_CACHE_ENTRY_SHARE 8
+
+/*! \brief One frame of a cached file */
+struct file_cache_frame {
+	/*! Frame with a shared payload, handed out through ast_frshare() */
+	struct ast_frame *fr;
+	/*! Samples until the next frame, as returned by the format's read */
+	int whennext;
+	/*! Sample offset of the start of the frame */
+	off_t start;
+};
+
+/*!
+ * \brief A played file kept as the frames its format read from it
+ *
+ * Entries are never modified once built, only the LRU linkage changes,
+ * so any number of streams can play from one without locking it.
+ */
+struct ast_filestream_cache {
+	/*! Linkage in the LRU list, protected by file_cache_lock */
+	AST_LIST_ENTRY(ast_filestream_cache) lru;
+	/*! stat() data of the file the frames were read from */
+	dev_t stat_dev;
+	ino_t stat_ino;
+	off_t stat_size;
+	time_t stat_mtime;
+	long stat_mtime_nsec;
+	/*! Number of bytes the entry accounts for in the cache */
+	size_t bytes;
+	/*! Total number of samples in the file */
+	off_t samples;
+	/*! Number of frames */
+	size_t count;
+	struct file_cache_frame *frames;
+	/*! Format name and file path, the cache key */
+	char name[0];
+};
+
+/*! \brief Cached files by name, protected by file_cache_lock */
+static struct ao2_container *file_cache;
+
+/*! \brief Cached files, most recently played first */
+static AST_LIST_HEAD_NOLOCK_STATIC(file_cache_lru, ast_filestream_cache);
+
+/*! \brief Bytes taken by all cached files */
+static size_t file_cache_bytes;
+
+AST_MUTEX_DEFINE_STATIC(file_cache_lock);
+
+AO2_STRING_FIELD_HASH_FN(ast_filestream_cache, name);
+AO2_STRING_FIELD_CMP_FN(ast_filestream_cache, name);
+
+static void file_cache_stat_nsec(const struct stat *st, long *nsec)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMENSEC)
+	*nsec = st->st_mtimensec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*nsec = st->st_mtimespec.tv_nsec;
+#else
+	*nsec = 0;
+#endif
+}
+
+/*! \retval non-zero if the file changed since the entry was built */
+static int file_cache_stat_cmp(const struct ast_filestream_cache *entry, const struct stat *st)
+{
+	long nsec;
+
+	file_cache_stat_nsec(st, &nsec);
+
+	return entry->stat_dev != st->st_dev || entry->stat_ino != st->st_ino
+		|| entry->stat_size != st->st_size || entry->stat_mtime != st->st_mtime
+		|| entry->stat_mtime_nsec != nsec;
+}
+
+static void file_cache_entry_destroy(void *obj)
+{
+	struct ast_filestream_cache *entry = obj;
+	size_t i;
+
+	for (i = 0; i < entry->count; i++) {
+		ast_frfree(entry->frames[i].fr);
+	}
+	ast_free(entry->frames);
+}
+
+/*! \note file_cache_lock must be held */
+static void file_cache_unlink(struct ast_filestream_cache *entry)
+{
+	AST_LIST_REMOVE(&file_cache_lru, entry, lru);
+	file_cache_bytes -= entry->bytes;
+	ao2_unlink_flags(file_cache, entry, OBJ_NOLOCK);
+}
+
+/*!
+ * \internal
+ * \brief Read every frame of a file into a new cache entry
+ *
+ * \retval NULL if the file could not be read or is too large to cache
+ */
+static struct ast_filestream_cache *file_cache_build(const char *fn, struct ast_format_def *f,
+	const struct stat *st, const char *key, size_t max_bytes)
+{
+	struct ast_filestream_cache *entry;
+	struct ast_filestream *s;
+	struct ast_frame *fr;
+	FILE *bfile;
+	size_t allocated = 0;
+	int whennext = 0;
+
+	entry = ao2_alloc_options(sizeof(*entry) + strlen(key) + 1, file_cache_entry_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		return NULL;
+	}
+	strcpy(entry->name, key); /* Safe */
+	entry->stat_dev = st->st_dev;
+	entry->stat_ino = st->st_ino;
+	entry->stat_size = st->st_size;
+	entry->stat_mtime = st->st_mtime;
+	file_cache_stat_nsec(st, &entry->stat_mtime_nsec);
+	entry->bytes = sizeof(*entry) + strlen(key) + 1;
+
+	if (!(bfile = fopen(fn, "r"))) {
+		ao2_ref(entry, -1);
+		return NULL;
+	}
+	if (!(s = get_filestream(f, bfile))) {
+		fclose(bfile);
+		ao2_ref(entry, -1);
+		return NULL;
+	}
+	if (open_wrapper(s)) {
+		ast_closestream(s);
+		ao2_ref(entry, -1);
+		return NULL;
+	}
+
+	while ((fr = f->read(s, &whennext))) {
+		struct file_cache_frame *cached;
+
+		if (entry->count == allocated) {
+			size_t grown = allocated ? allocated * 2 : 64;
+			struct file_cache_frame *frames = ast_realloc(entry->frames, grown * sizeof(*frames));
+
+			if (!frames) {
+				ast_frfree(fr);
+				break;
+			}
+			entry->frames = frames;
+			allocated = grown;
+		}
+
+		cached = &entry->frames[entry->count];
+		cached->fr = ast_frshare(fr);
+		ast_frfree(fr);
+		if (!cached->fr) {
+			break;
+		}
+		cached->whennext = whennext;
+		cached->start = entry->samples;
+		entry->samples += cached->fr->samples;
+		entry->bytes += sizeof(*cached) + sizeof(*cached->fr) + cached->fr->datalen;
+		entry->count++;
+
+		if (entry->bytes > max_bytes) {
+			break;
+		}
+	}
+
+	/* Only a file read to its end without error is worth keeping */
+	if (fr || entry->bytes > max_bytes || !entry->count) {
+		ast_closestream(s);
+		ao2_ref(entry, -1);
+		return NULL;
+	}
+
+	ast_closestream(s);
+
+	return entry;
+}
+
+/*!
+ * \internal
+ * \brief Get a stream playing a file from the file cache
+ *
+ * The file is read into the cache first if it is not already there or
+ * changed since it was.
+ *
+ * \retval NULL if the file cache is disabled or the file cannot be cached,
+ *         the file must then be opened as usual
+ */
+static struct ast_filestream *file_cache_open(const char *fn, struct ast_format_def *f,
+	const struct stat *st)
+{
+	size_t limit = (size_t) ast_option_file_cache_size * 1024 * 1024;
+	struct ast_filestream_cache *entry;
+	struct ast_filestream *s;
+	char key[strlen(f->name) + strlen(fn) + 2];
+
+	if (!limit || !file_cache || ast_format_get_type(f->format) != AST_MEDIA_TYPE_AUDIO
+		|| st->st_size > limit / FILE_CACHE_ENTRY_SHARE) {
+		return NULL;
+	}
+
+	snprintf(key, sizeof(key), "%s:%s", f->name, fn);
+
+	ast_mutex_lock(&file_cache_lock);
+	entry = ao2_find(file_cache, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry && file_cache_stat_cmp(entry, st)) {
+		file_cache_unlink(entry);
+		ao2_ref(entry, -1);
+		entry = NULL;
+	}
+	if (entry) {
+		AST_LIST_REMOVE(&file_cache_lru, entry, lru);
+		AST_LIST_INSERT_HEAD(&file_cache_lru, entry, lru);
+	}
+	ast_mutex_unlock(&file_cache_lock);
+
+	if (!entry) {
+		struct ast_filestream_cache *existing;
+
+		entry = file_cache_build(fn, f, st, key, limit / FILE_CACHE_ENTRY_SHARE);
+		if (!entry) {
+			return NULL;
+		}
+
+		ast_mutex_lock(&file_cache_lock);
+		/* Someone else may have read the same file meanwhile */
+		existing = ao2_find(file_cache, key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+		if (existing) {
+			file_cache_unlink(existing);
+			ao2_ref(existing, -1);
+		}
+		ao2_link_flags(file_cache, entry, OBJ_NOLOCK);
+		AST_LIST_INSERT_HEAD(&file_cache_lru, entry, lru);
+		file_cache_bytes += entry->bytes;
+		while (file_cache_bytes > limit) {
+			file_cache_unlink(AST_LIST_LAST(&file_cache_lru));
+		}
+		ast_mutex_unlock(&file_cache_lock);
+	}
+
+	s = get_filestream(f, NULL);
+	if (!s) {
+		ao2_ref(entry, -1);
+		return NULL;
+	}
+	s->cache = entry;
+	s->cache_pos = 0;
+
+	return s;
+}
+
+/*! \brief Drop every file from the file cache */
+static void file_cache_flush(void)
+{
+	struct ast_filestream_cache *entry;
+
+	ast_mutex_lock(&file_cache_lock);
+	while ((entry = AST_LIST_FIRST(&file_cache_lru))) {
+		file_cache_unlink(entry);
+	}
+	ast_mutex_unlock(&file_cache_lock);
+}
+
+static struct ast_frame *file_cache_read(struct ast_filestream *s, int *whennext)
+{
+	struct file_cache_frame *cached;
+
+	if (s->cache_pos >= s->cache->count) {
+		return NULL;
+	}
+
+	cached = &s->cache->frames[s->cache_pos++];
+	*whennext = cached->whennext;
+
+	return ast_frshare(cached->fr);
+}
+
+/*!
+ * Cached streams seek to the frame holding the sample asked for.
+ * Frames are the unit the formats read so this is as close as a
+ * stream can be positioned without reading the file again.
+ */
+static int file_cache_seek(struct ast_filestream *s, off_t sample_offset, int whence)
+{
+	off_t target;
+	size_t low = 0;
+	size_t high = s->cache->count;
+
+	switch (whence) {
+	case SEEK_SET:
+		target = sample_offset;
+		break;
+	case SEEK_END:
+		target = s->cache->samples + sample_offset;
+		break;
+	case SEEK_CUR:
+	case SEEK_FORCECUR:
+	default:
+		target = (s->cache_pos < s->cache->count ? s->cache->frames[s->cache_pos].start
+			: s->cache->samples) + sample_offset;
+		break;
+	}
+
+	if (target <= 0) {
+		s->cache_pos = 0;
+		return 0;
+	}
+	if (target >= s->cache->samples) {
+		s->cache_pos = s->cache->count;
+		return 0;
+	}
+
+	/* Find the last frame starting at or before the target */
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+
+		if (s->cache->frames[middle].start <= target) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+	s->cache_pos = low;
+
+	return 0;
+}
+
+static off_t file_cache_tell(struct ast_filestream *s)
+{
+	return s->cache_pos < s->cache->count ? s->cache->frames[s->cache_pos].start
+		: s->cache->samples;
+}
+
+/*! \brief Buckets of the sounds index */
+#define SOUNDS_INDEX_BUCKETS 4099
+
+/*! \brief File in the cache directory the sounds index is saved to */
+#define SOUNDS_INDEX_FILE "sounds.index"
+
+/*!
+ * \brief The files in the sounds directory by their path relative to it
+ *
+ * Only set when the sounds_index option is enabled.  Each file of a sound
+ * has its own entry, such as "en/digits/1.ulaw", so a lookup answers whether
+ * a sound exists for a language and format without going to the file system.
+ */
+static AO2_GLOBAL_OBJ_STATIC(sounds_index);
+
+/*! \brief The index being built to replace sounds_index */
+static AO2_GLOBAL_OBJ_STATIC(sounds_index_next);
+
+/*! \brief Serializes building the sounds index */
+AST_MUTEX_DEFINE_STATIC(sounds_index_build_lock);
+
+/*!
+ * \internal
+ * \brief Get the key of a file in the sounds index
+ *
+ * \param fn Full path of the file, as returned by build_filename()
+ *
+ * \return The path relative to the sounds directory, or NULL if the file is
+ * not covered by the index
+ */
+static const char *sounds_index_key(const char *fn)
+{
+	size_t len = strlen(ast_config_AST_DATA_DIR);
+
+	if (strncmp(fn, ast_config_AST_DATA_DIR, len) || strncmp(fn + len, "/sounds/", 8)) {
+		return NULL;
+	}
+	fn += len + 8;
+
+	/* Paths leaving the directory are left to the file system */
+	if (!strncmp(fn, "../", 3) || strstr(fn, "/../")) {
+		return NULL;
+	}
+
+	return fn;
+}
+
+/*!
+ * \internal
+ * \brief Look a file up in the sounds index
+ *
+ * \retval 1 the file exists
+ * \retval 0 the file does not exist
+ * \retval -1 the file is not covered by the index
+ */
+static int sounds_index_lookup(struct ao2_container *index, const char *fn)
+{
+	const char *key = sounds_index_key(fn);
+	char *found;
+
+	if (!key) {
+		return -1;
+	}
+
+	found = ao2_find(index, key, OBJ_SEARCH_KEY);
+	ao2_cleanup(found);
+
+	return found ? 1 : 0;
+}
+
+/*!
+ * \internal
+ * \brief Record a file created or removed by Asterisk in the sounds index
+ */
+static void sounds_index_update(const char *fn, int exists)
+{
+	const char *key;
+	struct ao2_container *index;
+	int i;
+
+	if (!ast_option_sounds_index || !(key = sounds_index_key(fn))) {
+		return;
+	}
+
+	/* The index being built may already have passed this file */
+	for (i = 0; i < 2; i++) {
+		index = i ? ao2_global_obj_ref(sounds_index_next) : ao2_global_obj_ref(sounds_index);
+		if (!index) {
+			continue;
+		}
+		if (exists) {
+			ast_str_container_add(index, key);
+		} else {
+			ast_str_container_remove(index, key);
+		}
+		ao2_ref(index, -1);
+	}
+}
+
+static int sounds_index_add_cb(const char *dir_name, const char *filename, void *obj)
+{
+	struct ao2_container *index = obj;
+	size_t base_len = strlen(ast_config_AST_DATA_DIR) + strlen("/sounds");
+	const char *subdir = dir_name + base_len;
+	char *key;
+
+	if (*subdir == '/') {
+		subdir++;
+	}
+
+	if (ast_strlen_zero(subdir)) {
+		return ast_str_container_add(index, filename) ? -1 : 0;
+	}
+
+	key = ast_alloca(strlen(subdir) + strlen(filename) + 2);
+	sprintf(key, "%s/%s", subdir, filename); /* Safe */
+
+	return ast_str_container_add(index, key) ? -1 : 0;
+}
+
+static int sounds_index_save_cb(void *obj, void *arg, int flags)
+{
+	fprintf(arg, "%s\n", (char *) obj);
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Save the sounds index to the cache directory for the next start
+ */
+static void sounds_index_save(struct ao2_container *index)
+{
+	char path[PATH_MAX];
+	char tmp[PATH_MAX + 4];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", ast_config_AST_CACHE_DIR, SOUNDS_INDEX_FILE);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	if (!(f = fopen(tmp, "w"))) {
+		ast_log(LOG_WARNING, "Unable to save the sounds index to '%s': %s\n", tmp, strerror(errno));
+		return;
+	}
+	ao2_callback(index, OBJ_NODATA | OBJ_MULTIPLE, sounds_index_save_cb, f);
+	if (fclose(f) || rename(tmp, path)) {
+		ast_log(LOG_WARNING, "Unable to save the sounds index to '%s': %s\n", path, strerror(errno));
+		unlink(tmp);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Use the sounds index saved by a previous run until it is rebuilt
+ */
+static void sounds_index_load(void)
+{
+	char path[PATH_MAX];
+	char line[PATH_MAX];
+	struct ao2_container *index;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", ast_config_AST_CACHE_DIR, SOUNDS_INDEX_FILE);
+	if (!(f = fopen(path, "r"))) {
+		return;
+	}
+
+	index = ast_str_container_alloc_options(AO2_ALLOC_OPT_LOCK_RWLOCK, SOUNDS_INDEX_BUCKETS);
+	if (!index) {
+		fclose(f);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		ast_trim_blanks(line);
+		if (!ast_strlen_zero(line) && ast_str_container_add(index, line)) {
+			ao2_ref(index, -1);
+			fclose(f);
+			return;
+		}
+	}
+	fclose(f);
+
+	ast_debug(1, "Loaded %d entries of the sounds index from '%s'\n",
+		ao2_container_count(index), path);
+	ao2_global_obj_replace_unref(sounds_index, index);
+	ao2_ref(index, -1);
+}
+
+/*!
+ * \internal
+ * \brief Walk the sounds directory and replace the sounds index
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int sounds_index_build(void)
+{
+	struct ao2_container *index;
+	char dir[PATH_MAX];
+	struct timeval start = ast_tvnow();
+	int res;
+
+	ast_mutex_lock(&sounds_index_build_lock);
+
+	index = ast_str_container_alloc_options(AO2_ALLOC_OPT_LOCK_RWLOCK, SOUNDS_INDEX_BUCKETS);
+	if (!index) {
+		ast_mutex_unlock(&sounds_index_build_lock);
+		return -1;
+	}
+	ao2_global_obj_replace_unref(sounds_index_next, index);
+
+	snprintf(dir, sizeof(dir), "%s/sounds", ast_config_AST_DATA_DIR);
+	res = ast_file_read_dirs(dir, sounds_index_add_cb, index, -1);
+	if (res) {
+		ast_log(LOG_WARNING, "Unable to index the sounds directory '%s'\n", dir);
+	} else {
+		ao2_global_obj_replace_unref(sounds_index, index);
+		ast_verb(2, "Indexed %d sound files in %" PRId64 " ms\n",
+			ao2_container_count(index), ast_tvdiff_ms(ast_tvnow(), start));
+	}
+	ao2_global_obj_release(sounds_index_next);
+
+	ast_mutex_unlock(&sounds_index_build_lock);
+
+	if (!res) {
+		sounds_index_save(index);
+	}
+	ao2_ref(index, -1);
+
+	return res ? -1 : 0;
+}
+
+static void *sounds_index_build_thread(void *data)
+{
+	sounds_index_build();
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Open a stream playing from a memory mapping of the file
+ *
+ * Only formats made of fixed size frames without a header are mapped, so
+ * the stream can find its frames without the format.  The file is shared
+ * with every other channel playing it through the page cache, and frames
+ * are copied out of the mapping instead of read from the file system.
+ *
+ * \return The stream, or NULL if the file is to be read by its format
+ */
+static struct ast_filestream *file_map_open(const char *fn, struct ast_format_def *f,
+	const struct stat *st)
+{
+	struct ast_filestream *s;
+	void *map;
+	int fd;
+
+	if (!ast_option_map_sound_files || !f->frame_bytes || !f->frame_samples
+		|| f->frame_bytes > f->buf_size - AST_FRIENDLY_OFFSET || st->st_size <= 0
+		|| st->st_size > SIZE_MAX) {
+		return NULL;
+	}
+
+	fd = open(fn, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	map = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		ast_debug(3, "Unable to map '%s', reading it instead: %s\n", fn, strerror(errno));
+		return NULL;
+	}
+	/* Prompts are played from start to end, so have the kernel read them in now */
+	madvise(map, st->st_size, MADV_WILLNEED);
+
+	s = get_filestream(f, NULL);
+	if (!s) {
+		munmap(map, st->st_size);
+		return NULL;
+	}
+	s->map = map;
+	s->map_size = st->st_size;
+	s->map_pos = 0;
+
+	return s;
+}
+
+static struct ast_frame *file_map_read(struct ast_filestream *s, int *whennext)
+{
+	const struct ast_format_def *f = s->fmt;
+	size_t bytes = MIN(s->map_size - s->map_pos, f->frame_bytes);
+	int samples = f->frame_samples;
+
+	if (bytes < f->frame_bytes) {
+		/* Play what is left of the file if the format can cut a frame short */
+		if (!f->frame_unit_bytes) {
+			return NULL;
+		}
+		bytes -= bytes % f->frame_unit_bytes;
+		samples = (int64_t) bytes * f->frame_samples / f->frame_bytes;
+	}
+	if (!bytes) {
+		return NULL;
+	}
+
+	AST_FRAME_SET_BUFFER(&s->fr, s->buf, AST_FRIENDLY_OFFSET, bytes);
+	memcpy(s->fr.data.ptr, s->map + s->map_pos, bytes);
+	s->map_pos += bytes;
+	*whennext = s->fr.samples = samples;
+
+	return &s->fr;
+}
+
+/*! \brief Byte offset in a mapped file of a sample offset */
+static off_t file_map_bytes(const struct ast_format_def *f, off_t samples)
 {
-	struct ast_format_def *f = s->fmt;
-	int ret = -1;
-	int (*openfn)(struct ast_filestream *s);
+	off_t bytes = (samples / f->frame_samples) * f->frame_bytes;
 
-	if (mode == WRAP_OPEN && (openfn = f->open) && openfn(s))
-		ast_log(LOG_WARNING, "Unable to open format %s\n", f->name);
-	else if (mode == WRAP_REWRITE && f->rewrite && f->rewrite(s, comment))
-		ast_log(LOG_WARNING, "Unable to rewrite format %s\n", f->name);
-	else {
-		/* preliminary checks succeed. */
-		ret = 0;
+	if (f->frame_unit_bytes) {
+		off_t part = (samples % f->frame_samples) * f->frame_bytes / f->frame_samples;
+
+		bytes += part - part % f->frame_unit_bytes;
 	}
-	return ret;
+
+	return bytes;
 }
 
-static int rewrite_wrapper(struct ast_filestream *s, const char *comment)
+static int file_map_seek(struct ast_filestream *s, off_t sample_offset, int whence)
 {
-	return fn_wrapper(s, comment, WRAP_REWRITE);
+	off_t bytes = file_map_bytes(s->fmt, sample_offset < 0 ? -sample_offset : sample_offset);
+	off_t offset;
+
+	if (sample_offset < 0) {
+		bytes = -bytes;
+	}
+
+	switch (whence) {
+	case SEEK_SET:
+		offset = bytes;
+		break;
+	case SEEK_CUR:
+	case SEEK_FORCECUR:
+		offset = s->map_pos + bytes;
+		break;
+	case SEEK_END:
+		offset = s->map_size - bytes;
+		break;
+	default:
+		return -1;
+	}
+
+	/* A mapped stream is never written, so it cannot be extended */
+	s->map_pos = MAX(0, MIN(offset, (off_t) s->map_size));
+
+	return 0;
 }
 
-static int open_wrapper(struct ast_filestream *s)
+static off_t file_map_tell(struct ast_filestream *s)
 {
-	return fn_wrapper(s, NULL, WRAP_OPEN);
+	const struct ast_format_def *f = s->fmt;
+
+	return (s->map_pos / f->frame_bytes) * f->frame_samples
+		+ (off_t) (s->map_pos % f->frame_bytes) * f->frame_samples / f->frame_bytes;
 }
 
 enum file_action {
@@ -515,6 +1329,11 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 {
 	struct ast_format_def *f;
 	int res = (action == ACTION_EXISTS) ? 0 : -1;
+	struct ao2_container *index = NULL;
+
+	if ((action == ACTION_EXISTS || action == ACTION_OPEN) && filename[0] != '/') {
+		index = ao2_global_obj_ref(sounds_index);
+	}
 
 	AST_RWLIST_RDLOCK(&formats);
 	/* Check for a specific format */
@@ -535,11 +1354,15 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 		while ( (ext = strsep(&stringp, "|")) ) {
 			struct stat st;
 			char *fn = build_filename(filename, ext);
+			int indexed = -1;
 
 			if (fn == NULL)
 				continue;
 
-			if ( stat(fn, &st) ) { /* file not existent */
+			if (index) {
+				indexed = sounds_index_lookup(index, fn);
+			}
+			if (!indexed || (indexed < 0 && stat(fn, &st))) { /* file not existent */
 				ast_free(fn);
 				continue;
 			}
@@ -557,20 +1380,30 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 					ast_free(fn);
 					continue;	/* not a supported format */
 				}
-				if ( (bfile = fopen(fn, "r")) == NULL) {
+				if (indexed > 0 && stat(fn, &st)) {
 					ast_free(fn);
-					continue;	/* cannot open file */
+					continue;	/* removed since it was indexed */
 				}
-				s = get_filestream(f, bfile);
+				s = file_cache_open(fn, f, &st);
 				if (!s) {
-					fclose(bfile);
-					ast_free(fn);	/* cannot allocate descriptor */
-					continue;
+					s = file_map_open(fn, f, &st);
 				}
-				if (open_wrapper(s)) {
-					ast_free(fn);
-					ast_closestream(s);
-					continue;	/* cannot run open on file */
+				if (!s) {
+					if ( (bfile = fopen(fn, "r")) == NULL) {
+						ast_free(fn);
+						continue;	/* cannot open file */
+					}
+					s = get_filestream(f, bfile);
+					if (!s) {
+						fclose(bfile);
+						ast_free(fn);	/* cannot allocate descriptor */
+						continue;
+					}
+					if (open_wrapper(s)) {
+						ast_free(fn);
+						ast_closestream(s);
+						continue;	/* cannot run open on file */
+					}
 				}
 				if (st.st_size == 0) {
 					ast_log(LOG_WARNING, "File %s detected to have zero size.\n", fn);
@@ -609,6 +1442,8 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 			case ACTION_DELETE:
 				if ( (res = unlink(fn)) )
 					ast_log(LOG_WARNING, "unlink(%s) failed: %s\n", fn, strerror(errno));
+				else
+					sounds_index_update(fn, 0);
 				break;
 
 			case ACTION_RENAME:
@@ -618,10 +1453,16 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 					ast_log(LOG_WARNING, "Out of memory\n");
 				else {
 					res = action == ACTION_COPY ? copy(fn, nfn) : rename(fn, nfn);
-					if (res)
+					if (res) {
 						ast_log(LOG_WARNING, "%s(%s,%s) failed: %s\n",
 							action == ACTION_COPY ? "copy" : "rename",
 							 fn, nfn, strerror(errno));
+					} else {
+						sounds_index_update(nfn, 1);
+						if (action == ACTION_RENAME) {
+							sounds_index_update(fn, 0);
+						}
+					}
 					ast_free(nfn);
 				}
 			    }
@@ -634,6 +1475,7 @@ static int filehelper(const char *filename, const void *arg2, const char *fmt, c
 		}
 	}
 	AST_RWLIST_UNLOCK(&formats);
+	ao2_cleanup(index);
 	return res;
 }
 
@@ -879,7 +1721,11 @@ static struct ast_frame *read_frame(struct ast_filestream *s, int *whennext)
 		return NULL;
 	}
 
-	if (!(fr = s->fmt->read(s, whennext))) {
+	if (s->cache) {
+		return file_cache_read(s, whennext);
+	}
+
+	if (!(fr = s->map ? file_map_read(s, whennext) : s->fmt->read(s, whennext))) {
 		return NULL;
 	}
 
@@ -1037,16 +1883,31 @@ int ast_playstream(struct ast_filestream *s)
 
 int ast_seekstream(struct ast_filestream *fs, off_t sample_offset, int whence)
 {
+	if (fs->cache) {
+		return file_cache_seek(fs, sample_offset, whence);
+	}
+	if (fs->map) {
+		return file_map_seek(fs, sample_offset, whence);
+	}
 	return fs->fmt->seek(fs, sample_offset, whence);
 }
 
 int ast_truncstream(struct ast_filestream *fs)
 {
+	if (fs->cache || fs->map) {
+		return -1;
+	}
 	return fs->fmt->trunc(fs);
 }
 
 off_t ast_tellstream(struct ast_filestream *fs)
 {
+	if (fs->cache) {
+		return file_cache_tell(fs);
+	}
+	if (fs->map) {
+		return file_map_tell(fs);
+	}
 	return fs->fmt->tell(fs);
 }
 
@@ -1267,18 +2128,21 @@ int ast_streamfile(struct ast_channel *chan, const char *filename, const char *p
 
 	/* check to see if there is any data present (not a zero length file),
 	 * done this way because there is no where for ast_openstream_full to
-	 * return the file had no data. */
-	pos = ftello(fs->f);
-	seekattempt = fseeko(fs->f, -1, SEEK_END);
-	if (seekattempt) {
-		if (errno == EINVAL) {
-			/* Zero-length file, as opposed to a pipe */
-			return 0;
+	 * return the file had no data.  Files played from the cache are never
+	 * empty and have no file to check. */
+	if (fs->f) {
+		pos = ftello(fs->f);
+		seekattempt = fseeko(fs->f, -1, SEEK_END);
+		if (seekattempt) {
+			if (errno == EINVAL) {
+				/* Zero-length file, as opposed to a pipe */
+				return 0;
+			} else {
+				ast_seekstream(fs, 0, SEEK_SET);
+			}
 		} else {
-			ast_seekstream(fs, 0, SEEK_SET);
+			fseeko(fs->f, pos, SEEK_SET);
 		}
-	} else {
-		fseeko(fs->f, pos, SEEK_SET);
 	}
 
 	vfs = ast_openvstream(chan, filename, preflang);
@@ -1358,6 +2222,288 @@ struct ast_filestream *ast_readfile(const char *filename, const char *type, cons
 	return fs;
 }
 
+/*! \brief The longest file ast_file_decode_slin() decodes, in seconds */
+#define FILE_DECODE_MAX_SECONDS 120
+
+/*!
+ * \internal
+ * \brief Open a file in a given format for reading without a channel
+ */
+static struct ast_filestream *file_open_format(const char *filename, struct ast_format *format)
+{
+	struct ast_format_def *f;
+	struct ast_filestream *s = NULL;
+
+	AST_RWLIST_RDLOCK(&formats);
+	AST_RWLIST_TRAVERSE(&formats, f, list) {
+		char storage[strlen(f->exts) + 1];
+		char *stringp = storage;
+		char *ext;
+
+		if (ast_format_cmp(f->format, format) == AST_FORMAT_CMP_NOT_EQUAL) {
+			continue;
+		}
+
+		strcpy(storage, f->exts); /* safe */
+		while (!s && (ext = strsep(&stringp, "|"))) {
+			char *fn = build_filename(filename, ext);
+			FILE *bfile;
+
+			if (!fn) {
+				continue;
+			}
+			bfile = fopen(fn, "r");
+			ast_free(fn);
+			if (!bfile) {
+				continue;
+			}
+			s = get_filestream(f, bfile);
+			if (!s) {
+				fclose(bfile);
+				continue;
+			}
+			if (open_wrapper(s)) {
+				ast_closestream(s);
+				s = NULL;
+				continue;
+			}
+			s->fmt = f;
+			s->trans = NULL;
+			s->filename = NULL;
+		}
+		if (s) {
+			break;
+		}
+	}
+	AST_RWLIST_UNLOCK(&formats);
+
+	return s;
+}
+
+/*!
+ * \internal
+ * \brief Append the audio of a list of signed linear frames to a buffer
+ *
+ * \retval 0 on success
+ * \retval -1 if the buffer cannot take the audio
+ */
+static int file_decode_append(struct ast_frame *fr, int16_t **data, size_t *count,
+	size_t *size, size_t max)
+{
+	for (; fr; fr = AST_LIST_NEXT(fr, frame_list)) {
+		size_t samples = fr->datalen / sizeof(int16_t);
+
+		if (fr->frametype != AST_FRAME_VOICE || !samples) {
+			continue;
+		}
+		if (*count + samples > max) {
+			return -1;
+		}
+		if (*count + samples > *size) {
+			size_t grown = MAX(*size * 2, *count + samples);
+			int16_t *tmp = ast_realloc(*data, MIN(grown, max) * sizeof(int16_t));
+
+			if (!tmp) {
+				return -1;
+			}
+			*data = tmp;
+			*size = MIN(grown, max);
+		}
+		memcpy(*data + *count, fr->data.ptr, samples * sizeof(int16_t));
+		*count += samples;
+	}
+
+	return 0;
+}
+
+int16_t *ast_file_decode_slin(const char *filename, const char *preflang,
+	unsigned int *rate, size_t *samples)
+{
+	struct ast_format_cap *file_fmt_cap;
+	struct ast_format *best = NULL;
+	struct ast_format *slin;
+	struct ast_filestream *fs;
+	struct ast_trans_pvt *trans = NULL;
+	struct ast_frame *fr;
+	int16_t *data = NULL;
+	size_t count = 0;
+	size_t size = 0;
+	size_t max;
+	int res = 0;
+	int buflen;
+	char *buf;
+	int i;
+
+	if (!preflang) {
+		preflang = "";
+	}
+	buflen = strlen(preflang) + strlen(filename) + 4;
+	buf = ast_alloca(buflen);
+
+	file_fmt_cap = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+	if (!file_fmt_cap) {
+		return NULL;
+	}
+	if (!fileexists_core(filename, NULL, preflang, buf, buflen, file_fmt_cap)) {
+		ao2_ref(file_fmt_cap, -1);
+		return NULL;
+	}
+
+	/* Prefer the format keeping the most of the audio */
+	for (i = 0; i < ast_format_cap_count(file_fmt_cap); ++i) {
+		struct ast_format *format = ast_format_cap_get_format(file_fmt_cap, i);
+
+		if (ast_format_get_type(format) == AST_MEDIA_TYPE_AUDIO
+			&& (!best || ast_format_get_sample_rate(format) > ast_format_get_sample_rate(best))) {
+			ao2_replace(best, format);
+		}
+		ao2_ref(format, -1);
+	}
+	ao2_ref(file_fmt_cap, -1);
+	if (!best) {
+		return NULL;
+	}
+
+	*rate = ast_format_get_sample_rate(best);
+	slin = ast_format_cache_get_slin_by_rate(*rate);
+	if (ast_format_cmp(best, slin) == AST_FORMAT_CMP_NOT_EQUAL) {
+		trans = ast_translator_build_path(slin, best);
+		if (!trans) {
+			ast_log(LOG_WARNING, "No translation from %s to %s for file %s\n",
+				ast_format_get_name(best), ast_format_get_name(slin), filename);
+			ao2_ref(best, -1);
+			return NULL;
+		}
+	}
+
+	fs = file_open_format(buf, best);
+	ao2_ref(best, -1);
+	if (!fs) {
+		ast_log(LOG_WARNING, "Unable to open %s\n", buf);
+		if (trans) {
+			ast_translator_free_path(trans);
+		}
+		return NULL;
+	}
+
+	max = (size_t) *rate * FILE_DECODE_MAX_SECONDS;
+	while (!res && (fr = ast_readframe(fs))) {
+		struct ast_frame *out = fr;
+
+		if (trans) {
+			out = ast_translate(trans, fr, 1);
+			if (!out) {
+				continue;
+			}
+		}
+		res = file_decode_append(out, &data, &count, &size, max);
+		ast_frfree(out);
+	}
+
+	ast_closestream(fs);
+	if (trans) {
+		ast_translator_free_path(trans);
+	}
+
+	if (res || !count) {
+		if (res) {
+			ast_debug(1, "File %s is too long to decode\n", buf);
+		}
+		ast_free(data);
+		return NULL;
+	}
+
+	*samples = count;
+
+	return data;
+}
+
+/*!
+ * \internal
+ * \brief Start streaming a recording to a sink
+ *
+ * \param found Set if a sink is registered for the file name
+ */
+static struct ast_filestream *sink_writefile(const char *filename, const char *type,
+	const char *comment, int flags, mode_t mode, int *found)
+{
+	struct ast_file_sink *sink;
+	struct ast_format_def *f;
+	struct ast_filestream *fs = NULL;
+	int format_found = 0;
+
+	AST_RWLIST_RDLOCK(&file_sinks);
+	if (!(sink = file_sink_find(filename))) {
+		AST_RWLIST_UNLOCK(&file_sinks);
+		*found = 0;
+		return NULL;
+	}
+	*found = 1;
+
+	if (flags & O_APPEND) {
+		ast_log(LOG_WARNING, "Cannot append to %s, it will be replaced\n", filename);
+	}
+
+	AST_RWLIST_RDLOCK(&formats);
+	AST_RWLIST_TRAVERSE(&formats, f, list) {
+		char *fn, *mime_type;
+		FILE *bfile;
+
+		if (!exts_compare(f->exts, type)) {
+			continue;
+		}
+		format_found = 1;
+
+		if (ast_asprintf(&fn, "%s.%s", filename, strcmp(type, "wav49") ? type : "WAV") < 0) {
+			continue;
+		}
+		mime_type = ast_strdupa(f->mime_types);
+		mime_type = strsep(&mime_type, "|");
+
+		if (!(bfile = sink->open(fn, S_OR(mime_type, NULL)))) {
+			ast_log(LOG_WARNING, "Unable to open %s for streaming\n", fn);
+			ast_free(fn);
+			continue;
+		}
+
+		fs = get_filestream(f, bfile);
+		if (fs) {
+			if ((fs->write_buffer = ast_malloc(32768))) {
+				setvbuf(fs->f, fs->write_buffer, _IOFBF, 32768);
+			}
+		}
+		if (!fs || rewrite_wrapper(fs, comment)) {
+			ast_log(LOG_WARNING, "Unable to rewrite %s\n", fn);
+			if (fs) {
+				ast_closestream(fs);
+				fs = NULL;
+			} else {
+				fclose(bfile);
+			}
+			ast_free(fn);
+			continue;
+		}
+		fs->trans = NULL;
+		fs->fmt = f;
+		fs->flags = flags;
+		fs->mode = mode;
+		/* There is no file to update the header of or to reopen for video */
+		fs->realfilename = NULL;
+		fs->filename = NULL;
+		fs->vfs = NULL;
+		ast_free(fn);
+		break;
+	}
+	AST_RWLIST_UNLOCK(&formats);
+	AST_RWLIST_UNLOCK(&file_sinks);
+
+	if (!format_found) {
+		ast_log(LOG_WARNING, "No such format '%s'\n", type);
+	}
+
+	return fs;
+}
+
 struct ast_filestream *ast_writefile(const char *filename, const char *type, const char *comment, int flags, int check, mode_t mode)
 {
 	int fd, myflags = 0;
@@ -1369,6 +2515,13 @@ struct ast_filestream *ast_writefile(const char *filename, const char *type, con
 	size_t size = 0;
 	int format_found = 0;
 
+	if (strstr(filename, "://")) {
+		fs = sink_writefile(filename, type, comment, flags, mode, &format_found);
+		if (format_found) {
+			return fs;
+		}
+	}
+
 	AST_RWLIST_RDLOCK(&formats);
 
 	/* set the O_TRUNC flag if and only if there is no O_APPEND specified */
@@ -1472,6 +2625,7 @@ struct ast_filestream *ast_writefile(const char *filename, const char *type, con
 			fs->fmt = f;
 			fs->flags = flags;
 			fs->mode = mode;
+			sounds_index_update(orig_fn ? orig_fn : fn, 1);
 			if (orig_fn) {
 				fs->realfilename = orig_fn;
 				fs->filename = fn;
@@ -1935,6 +3089,39 @@ static char *handle_cli_core_show_file_formats(struct ast_cli_entry *e, int cmd,
 #undef FORMAT2
 }
 
+static char *handle_cli_core_show_file_cache(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct ast_filestream_cache *entry;
+	size_t count = 0;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show file cache";
+		e->usage =
+			"Usage: core show file cache\n"
+			"       Displays the sound files kept in memory, most recently\n"
+			"       played first.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 4)
+		return CLI_SHOWUSAGE;
+
+	ast_cli(a->fd, "%-10s %-8s %s\n", "Bytes", "Frames", "Format:File");
+	ast_mutex_lock(&file_cache_lock);
+	AST_LIST_TRAVERSE(&file_cache_lru, entry, lru) {
+		ast_cli(a->fd, "%-10zu %-8zu %s\n", entry->bytes, entry->count, entry->name);
+		count++;
+	}
+	ast_cli(a->fd, "%zu cached files using %zu of %u MB.\n", count,
+		file_cache_bytes, ast_option_file_cache_size);
+	ast_mutex_unlock(&file_cache_lock);
+
+	return CLI_SUCCESS;
+}
+
 struct ast_format *ast_get_format_for_file_ext(const char *file_ext)
 {
 	struct ast_format_def *f;
@@ -1969,13 +3156,49 @@ int ast_get_extension_for_mime_type(const char *mime_type, char *buffer, size_t
 	return 0;
 }
 
+static char *handle_cli_core_refresh_sounds_index(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core refresh sounds index";
+		e->usage =
+			"Usage: core refresh sounds index\n"
+			"       Indexes the sounds directory again, picking up sound files\n"
+			"       added or removed other than by Asterisk.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 4)
+		return CLI_SHOWUSAGE;
+
+	if (!ast_option_sounds_index) {
+		ast_cli(a->fd, "The sounds index is not enabled in asterisk.conf.\n");
+		return CLI_SUCCESS;
+	}
+
+	if (sounds_index_build()) {
+		ast_cli(a->fd, "Unable to index the sounds directory.\n");
+		return CLI_FAILURE;
+	}
+
+	return CLI_SUCCESS;
+}
+
 static struct ast_cli_entry cli_file[] = {
-	AST_CLI_DEFINE(handle_cli_core_show_file_formats, "Displays file formats")
+	AST_CLI_DEFINE(handle_cli_core_show_file_formats, "Displays file formats"),
+	AST_CLI_DEFINE(handle_cli_core_show_file_cache, "Displays cached sound files"),
+	AST_CLI_DEFINE(handle_cli_core_refresh_sounds_index, "Indexes the sounds directory again"),
 };
 
 static void file_shutdown(void)
 {
 	ast_cli_unregister_multiple(cli_file, ARRAY_LEN(cli_file));
+	file_cache_flush();
+	ao2_cleanup(file_cache);
+	file_cache = NULL;
+	ao2_global_obj_release(sounds_index);
 	STASIS_MESSAGE_TYPE_CLEANUP(ast_format_register_type);
 	STASIS_MESSAGE_TYPE_CLEANUP(ast_format_unregister_type);
 }
@@ -1984,6 +3207,20 @@ int ast_file_init(void)
 {
 	STASIS_MESSAGE_TYPE_INIT(ast_format_register_type);
 	STASIS_MESSAGE_TYPE_INIT(ast_format_unregister_type);
+	file_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, FILE_CACHE_BUCKETS,
+		ast_filestream_cache_hash_fn, NULL, ast_filestream_cache_cmp_fn);
+	if (!file_cache) {
+		return -1;
+	}
+	if (ast_option_sounds_index) {
+		pthread_t thread;
+
+		/* Until the directory is walked use the index of the last run */
+		sounds_index_load();
+		if (ast_pthread_create_detached_background(&thread, NULL, sounds_index_build_thread, NULL)) {
+			sounds_index_build();
+		}
+	}
 	ast_cli_register_multiple(cli_file, ARRAY_LEN(cli_file));
 	ast_register_cleanup(file_shutdown);
 	return 0;
@@ -32,6 +32,7 @@
 #include "asterisk/logger.h"
 #include "asterisk/codec.h"
 #include "asterisk/format.h"
+#include "asterisk/format_cache.h"
 #include "asterisk/astobj2.h"
 #include "asterisk/strings.h"
 #include "asterisk/module.h"
@@ -51,6 +52,8 @@ struct ast_format {
 	const struct ast_format_interface *interface;
 	/*! \brief The number if audio channels used, if more than one an interleaved format is required */
 	unsigned int channel_count;
+	/*! \brief Set once the format is shared through the format cache */
+	unsigned int interned;
 };
 
 /*! \brief Structure used when registering a format interface */
@@ -119,6 +122,9 @@ int __ast_format_interface_register(const char *codec, const struct ast_format_i
 
 	ast_verb(2, "Registered format interface for codec '%s'\n", codec);
 
+	/* Anything parsed or joined for this codec so far was done without the interface */
+	ast_format_cache_attributes_flush();
+
 	return 0;
 }
 
@@ -142,6 +148,16 @@ void ast_format_set_channel_count(struct ast_format *format, unsigned int channe
 	format->channel_count = channel_count;
 }
 
+void ast_format_set_interned(struct ast_format *format)
+{
+	format->interned = 1;
+}
+
+int ast_format_is_interned(const struct ast_format *format)
+{
+	return format->interned;
+}
+
 /*! \brief Destructor for media formats */
 static void format_destroy(void *obj)
 {
@@ -239,9 +255,22 @@ struct ast_format *ast_format_joint(const struct ast_format *format1, const stru
 		return ao2_bump((struct ast_format*)format1);
 	}
 
+	/* Interned formats never change, so their joint format only has to be worked out once */
+	if (format1->interned && format2->interned) {
+		struct ast_format *joint;
+
+		if (!ast_format_cache_get_joint(format1, format2, &joint)) {
+			return joint;
+		}
+	}
+
 	interface = format1->interface ? format1->interface : format2->interface;
 
 	/* If there is attribute data on either there has to be an interface */
+	if (format1->interned && format2->interned) {
+		return ast_format_cache_set_joint(format1, format2,
+			interface->format_get_joint(format1, format2));
+	}
 	return interface->format_get_joint(format1, format2);
 }
 
@@ -299,6 +328,17 @@ struct ast_format *ast_format_parse_sdp_fmtp(const struct ast_format *format, co
 		return ao2_bump((struct ast_format*)format);
 	}
 
+	if (format->interned) {
+		struct ast_format *parsed = ast_format_cache_get_fmtp(format, attributes);
+
+		if (parsed) {
+			return parsed;
+		}
+
+		parsed = interface->format_parse_sdp_fmtp(format, attributes);
+		return parsed ? ast_format_cache_set_fmtp(format, attributes, parsed) : NULL;
+	}
+
 	return interface->format_parse_sdp_fmtp(format, attributes);
 }
 
@@ -307,9 +307,149 @@ static int format_cmp_cb(void *obj, void *arg, int flags)
 	return CMP_MATCH;
 }
 
+/*! \brief Number of buckets to use for the fmtp and joint caches (should be prime for performance reasons) */
+#define ATTRIBUTE_CACHE_BUCKETS 127
+
+/*!
+ * \brief Most entries kept by each of the fmtp and joint caches
+ *
+ * Interned formats stay alive as long as an entry refers to them, so this
+ * bounds the memory a stream of distinct fmtp lines can pin.
+ */
+#define ATTRIBUTE_CACHE_MAX 2048
+
+/*! \brief The format an SDP fmtp line parsed to on an interned format */
+struct fmtp_cache_entry {
+	/*! \brief The format the line was parsed on */
+	struct ast_format *format;
+	/*! \brief The interned result of parsing the line */
+	struct ast_format *parsed;
+	/*! \brief The fmtp line */
+	char attributes[0];
+};
+
+/*! \brief Key used to look up an fmtp cache entry */
+struct fmtp_cache_key {
+	const struct ast_format *format;
+	const char *attributes;
+};
+
+/*! \brief The joint format of two interned formats */
+struct joint_cache_entry {
+	struct ast_format *format1;
+	struct ast_format *format2;
+	/*! \brief The interned joint format, NULL if there is none */
+	struct ast_format *joint;
+};
+
+/*! \brief Cached results of parsing fmtp lines */
+static struct ao2_container *fmtp_cache;
+
+/*! \brief Cached joint formats */
+static struct ao2_container *joint_cache;
+
+static unsigned int pointer_hash(const void *ptr)
+{
+	uintptr_t value = (uintptr_t) ptr;
+
+	/* Formats are allocated objects, so the low bits carry nothing */
+	return (value >> 4) ^ (value >> 20);
+}
+
+static int fmtp_cache_hash_cb(const void *obj, int flags)
+{
+	const struct fmtp_cache_entry *entry;
+	const struct fmtp_cache_key *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = obj;
+		return (int) (pointer_hash(key->format) + (unsigned int) ast_str_hash(key->attributes));
+	case OBJ_SEARCH_OBJECT:
+		entry = obj;
+		return (int) (pointer_hash(entry->format) + (unsigned int) ast_str_hash(entry->attributes));
+	default:
+		ast_assert(0);
+		return 0;
+	}
+}
+
+static int fmtp_cache_cmp_cb(void *obj, void *arg, int flags)
+{
+	const struct fmtp_cache_entry *left = obj;
+	struct fmtp_cache_key key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_OBJECT:
+		key.format = ((const struct fmtp_cache_entry *) arg)->format;
+		key.attributes = ((const struct fmtp_cache_entry *) arg)->attributes;
+		break;
+	case OBJ_SEARCH_KEY:
+		key = *(const struct fmtp_cache_key *) arg;
+		break;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+
+	return left->format == key.format && !strcmp(left->attributes, key.attributes) ? CMP_MATCH : 0;
+}
+
+static int joint_cache_hash_cb(const void *obj, int flags)
+{
+	const struct joint_cache_entry *entry = obj;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+	case OBJ_SEARCH_OBJECT:
+		/* The key is a joint_cache_entry without a joint format */
+		return (int) (pointer_hash(entry->format1) * 31 + pointer_hash(entry->format2));
+	default:
+		ast_assert(0);
+		return 0;
+	}
+}
+
+static int joint_cache_cmp_cb(void *obj, void *arg, int flags)
+{
+	const struct joint_cache_entry *left = obj;
+	const struct joint_cache_entry *right = arg;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+	case OBJ_SEARCH_OBJECT:
+		return left->format1 == right->format1 && left->format2 == right->format2 ? CMP_MATCH : 0;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+}
+
+static void fmtp_cache_entry_destroy(void *obj)
+{
+	struct fmtp_cache_entry *entry = obj;
+
+	ao2_cleanup(entry->format);
+	ao2_cleanup(entry->parsed);
+}
+
+static void joint_cache_entry_destroy(void *obj)
+{
+	struct joint_cache_entry *entry = obj;
+
+	ao2_cleanup(entry->format1);
+	ao2_cleanup(entry->format2);
+	ao2_cleanup(entry->joint);
+}
+
 /*! \brief Function called when the process is shutting down */
 static void format_cache_shutdown(void)
 {
+	ao2_cleanup(fmtp_cache);
+	fmtp_cache = NULL;
+	ao2_cleanup(joint_cache);
+	joint_cache = NULL;
+
 	ao2_cleanup(formats);
 	formats = NULL;
 
@@ -369,6 +509,20 @@ int ast_format_cache_init(void)
 		return -1;
 	}
 
+	fmtp_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0, ATTRIBUTE_CACHE_BUCKETS,
+		fmtp_cache_hash_cb, NULL, fmtp_cache_cmp_cb);
+	joint_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0, ATTRIBUTE_CACHE_BUCKETS,
+		joint_cache_hash_cb, NULL, joint_cache_cmp_cb);
+	if (!fmtp_cache || !joint_cache) {
+		ao2_cleanup(fmtp_cache);
+		fmtp_cache = NULL;
+		ao2_cleanup(joint_cache);
+		joint_cache = NULL;
+		ao2_ref(formats, -1);
+		formats = NULL;
+		return -1;
+	}
+
 	ast_register_cleanup(format_cache_shutdown);
 
 	return 0;
@@ -486,6 +640,7 @@ int ast_format_cache_set(struct ast_format *format)
 	if (old_format) {
 		ao2_unlink_flags(formats, old_format, OBJ_NOLOCK);
 	}
+	ast_format_set_interned(format);
 	ao2_link_flags(formats, format, OBJ_NOLOCK);
 
 	set_cached_format(ast_format_get_name(format), format);
@@ -568,3 +723,145 @@ struct ast_format *ast_format_cache_get_by_codec(const struct ast_codec *codec)
 	ao2_iterator_destroy(&it);
 	return NULL;
 }
+
+struct ast_format *ast_format_cache_get_fmtp(const struct ast_format *format, const char *attributes)
+{
+	struct fmtp_cache_key key = {
+		.format = format,
+		.attributes = attributes,
+	};
+	struct fmtp_cache_entry *entry;
+	struct ast_format *parsed;
+
+	if (!fmtp_cache) {
+		return NULL;
+	}
+
+	entry = ao2_find(fmtp_cache, &key, OBJ_SEARCH_KEY);
+	if (!entry) {
+		return NULL;
+	}
+	parsed = ao2_bump(entry->parsed);
+	ao2_ref(entry, -1);
+
+	return parsed;
+}
+
+struct ast_format *ast_format_cache_set_fmtp(const struct ast_format *format, const char *attributes,
+	struct ast_format *parsed)
+{
+	struct fmtp_cache_key key = {
+		.format = format,
+		.attributes = attributes,
+	};
+	struct fmtp_cache_entry *entry;
+
+	if (!fmtp_cache || !ast_format_is_interned(format)) {
+		return parsed;
+	}
+
+	ao2_wrlock(fmtp_cache);
+	entry = ao2_find(fmtp_cache, &key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry) {
+		/* Another thread parsed the same line first, use theirs */
+		ao2_unlock(fmtp_cache);
+		ao2_replace(parsed, entry->parsed);
+		ao2_ref(entry, -1);
+		return parsed;
+	}
+
+	if (ao2_container_count(fmtp_cache) >= ATTRIBUTE_CACHE_MAX) {
+		ao2_unlock(fmtp_cache);
+		return parsed;
+	}
+
+	entry = ao2_alloc_options(sizeof(*entry) + strlen(attributes) + 1,
+		fmtp_cache_entry_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (entry) {
+		entry->format = ao2_bump((struct ast_format *) format);
+		entry->parsed = ao2_bump(parsed);
+		strcpy(entry->attributes, attributes); /* Safe */
+		ast_format_set_interned(parsed);
+		ao2_link_flags(fmtp_cache, entry, OBJ_NOLOCK);
+		ao2_ref(entry, -1);
+	}
+	ao2_unlock(fmtp_cache);
+
+	return parsed;
+}
+
+int ast_format_cache_get_joint(const struct ast_format *format1, const struct ast_format *format2,
+	struct ast_format **joint)
+{
+	struct joint_cache_entry key = {
+		.format1 = (struct ast_format *) format1,
+		.format2 = (struct ast_format *) format2,
+	};
+	struct joint_cache_entry *entry;
+
+	if (!joint_cache) {
+		return -1;
+	}
+
+	entry = ao2_find(joint_cache, &key, OBJ_SEARCH_KEY);
+	if (!entry) {
+		return -1;
+	}
+	*joint = ao2_bump(entry->joint);
+	ao2_ref(entry, -1);
+
+	return 0;
+}
+
+struct ast_format *ast_format_cache_set_joint(const struct ast_format *format1,
+	const struct ast_format *format2, struct ast_format *joint)
+{
+	struct joint_cache_entry key = {
+		.format1 = (struct ast_format *) format1,
+		.format2 = (struct ast_format *) format2,
+	};
+	struct joint_cache_entry *entry;
+
+	if (!joint_cache || !ast_format_is_interned(format1) || !ast_format_is_interned(format2)) {
+		return joint;
+	}
+
+	ao2_wrlock(joint_cache);
+	entry = ao2_find(joint_cache, &key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry) {
+		ao2_unlock(joint_cache);
+		ao2_replace(joint, entry->joint);
+		ao2_ref(entry, -1);
+		return joint;
+	}
+
+	if (ao2_container_count(joint_cache) >= ATTRIBUTE_CACHE_MAX) {
+		ao2_unlock(joint_cache);
+		return joint;
+	}
+
+	entry = ao2_alloc_options(sizeof(*entry), joint_cache_entry_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (entry) {
+		entry->format1 = ao2_bump(key.format1);
+		entry->format2 = ao2_bump(key.format2);
+		entry->joint = ao2_bump(joint);
+		if (joint) {
+			ast_format_set_interned(joint);
+		}
+		ao2_link_flags(joint_cache, entry, OBJ_NOLOCK);
+		ao2_ref(entry, -1);
+	}
+	ao2_unlock(joint_cache);
+
+	return joint;
+}
+
+void ast_format_cache_attributes_flush(void)
+{
+	if (fmtp_cache) {
+		ao2_callback(fmtp_cache, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
+	}
+	if (joint_cache) {
+		ao2_callback(joint_cache, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
+	}
+}
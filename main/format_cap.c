@@ -58,6 +58,10 @@ struct ast_format_cap {
 	AST_VECTOR(, struct format_cap_framed *) preference_order;
 	/*! \brief Global framing size, applies to all formats if no framing present on format */
 	unsigned int framing;
+	/*! \brief Bitmask of the codec identifiers present, for quick comparisons */
+	AST_VECTOR(, uint64_t) codec_ids;
+	/*! \brief Number of formats of each media type */
+	unsigned int types[AST_MEDIA_TYPE_END];
 };
 
 /*! \brief Linked list for formats */
@@ -66,6 +70,76 @@ AST_LIST_HEAD_NOLOCK(format_cap_framed_list, format_cap_framed);
 /*! \brief Dummy empty list for when we are inserting a new list */
 static const struct format_cap_framed_list format_cap_framed_list_empty = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
 
+/*! \brief Number of codec identifiers in each word of the codec bitmask */
+#define CODEC_ID_WORD_BITS 64
+
+/*! \brief Mark a codec identifier as present in the capabilities */
+static int format_cap_codec_set(struct ast_format_cap *cap, unsigned int id)
+{
+	size_t word = id / CODEC_ID_WORD_BITS;
+
+	while (AST_VECTOR_SIZE(&cap->codec_ids) <= word) {
+		if (AST_VECTOR_APPEND(&cap->codec_ids, 0)) {
+			return -1;
+		}
+	}
+	*AST_VECTOR_GET_ADDR(&cap->codec_ids, word) |= 1ULL << (id % CODEC_ID_WORD_BITS);
+
+	return 0;
+}
+
+/*! \brief Mark a codec identifier as no longer present in the capabilities */
+static void format_cap_codec_clear(struct ast_format_cap *cap, unsigned int id)
+{
+	size_t word = id / CODEC_ID_WORD_BITS;
+
+	if (word < AST_VECTOR_SIZE(&cap->codec_ids)) {
+		*AST_VECTOR_GET_ADDR(&cap->codec_ids, word) &= ~(1ULL << (id % CODEC_ID_WORD_BITS));
+	}
+}
+
+/*! \brief Determine if a codec identifier is present in the capabilities */
+static int format_cap_codec_isset(const struct ast_format_cap *cap, unsigned int id)
+{
+	size_t word = id / CODEC_ID_WORD_BITS;
+
+	return word < AST_VECTOR_SIZE(&cap->codec_ids)
+		&& (AST_VECTOR_GET(&cap->codec_ids, word) & (1ULL << (id % CODEC_ID_WORD_BITS)));
+}
+
+/*! \brief Determine if two capabilities have any codec in common */
+static int format_cap_codecs_intersect(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2)
+{
+	size_t words = MIN(AST_VECTOR_SIZE(&cap1->codec_ids), AST_VECTOR_SIZE(&cap2->codec_ids));
+	size_t word;
+
+	for (word = 0; word < words; ++word) {
+		if (AST_VECTOR_GET(&cap1->codec_ids, word) & AST_VECTOR_GET(&cap2->codec_ids, word)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*! \brief Determine if two capabilities have exactly the same codecs */
+static int format_cap_codecs_equal(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2)
+{
+	size_t words = MAX(AST_VECTOR_SIZE(&cap1->codec_ids), AST_VECTOR_SIZE(&cap2->codec_ids));
+	size_t word;
+
+	for (word = 0; word < words; ++word) {
+		uint64_t bits1 = word < AST_VECTOR_SIZE(&cap1->codec_ids) ? AST_VECTOR_GET(&cap1->codec_ids, word) : 0;
+		uint64_t bits2 = word < AST_VECTOR_SIZE(&cap2->codec_ids) ? AST_VECTOR_GET(&cap2->codec_ids, word) : 0;
+
+		if (bits1 != bits2) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 /*! \brief Destructor for format capabilities structure */
 static void format_cap_destroy(void *obj)
 {
@@ -89,6 +163,7 @@ static void format_cap_destroy(void *obj)
 		ao2_ref(framed, -1);
 	}
 	AST_VECTOR_FREE(&cap->preference_order);
+	AST_VECTOR_FREE(&cap->codec_ids);
 }
 
 /*
@@ -110,6 +185,10 @@ static inline int format_cap_init(struct ast_format_cap *cap, enum ast_format_ca
 		return -1;
 	}
 
+	if (AST_VECTOR_INIT(&cap->codec_ids, 1)) {
+		return -1;
+	}
+
 	cap->framing = UINT_MAX;
 	return 0;
 }
@@ -160,8 +239,16 @@ static inline int format_cap_framed_init(struct format_cap_framed *framed, struc
 	}
 	list = AST_VECTOR_GET_ADDR(&cap->formats, ast_format_get_codec_id(format));
 
+	if (format_cap_codec_set(cap, ast_format_get_codec_id(format))) {
+		ao2_ref(framed, -1);
+		return -1;
+	}
+
 	/* This takes the allocation reference */
 	if (AST_VECTOR_APPEND(&cap->preference_order, framed)) {
+		if (AST_LIST_EMPTY(list)) {
+			format_cap_codec_clear(cap, ast_format_get_codec_id(format));
+		}
 		ao2_ref(framed, -1);
 		return -1;
 	}
@@ -169,6 +256,7 @@ static inline int format_cap_framed_init(struct format_cap_framed *framed, struc
 	/* Order doesn't matter for formats, so insert at the head for performance reasons */
 	ao2_ref(framed, +1);
 	AST_LIST_INSERT_HEAD(list, framed, entry);
+	cap->types[ast_format_get_type(format)]++;
 
 	cap->framing = MIN(cap->framing, framing ? framing : ast_format_get_default_ms(format));
 
@@ -178,18 +266,7 @@ static inline int format_cap_framed_init(struct format_cap_framed *framed, struc
 /*! \internal \brief Determine if \c format is in \c cap */
 static int format_in_format_cap(struct ast_format_cap *cap, struct ast_format *format)
 {
-	struct format_cap_framed *framed;
-	int i;
-
-	for (i = 0; i < AST_VECTOR_SIZE(&cap->preference_order); i++) {
-		framed = AST_VECTOR_GET(&cap->preference_order, i);
-
-		if (ast_format_get_codec_id(format) == ast_format_get_codec_id(framed->format)) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return format_cap_codec_isset(cap, ast_format_get_codec_id(format));
 }
 
 int __ast_format_cap_append(struct ast_format_cap *cap, struct ast_format *format, unsigned int framing, const char *tag, const char *file, int line, const char *func)
@@ -514,6 +591,10 @@ int ast_format_cap_remove(struct ast_format_cap *cap, struct ast_format *format)
 
 		AST_LIST_REMOVE_CURRENT(entry);
 		FORMAT_CAP_FRAMED_ELEM_CLEANUP(framed);
+		cap->types[ast_format_get_type(format)]--;
+		if (AST_LIST_EMPTY(list)) {
+			format_cap_codec_clear(cap, ast_format_get_codec_id(format));
+		}
 		break;
 	}
 	AST_LIST_TRAVERSE_SAFE_END;
@@ -539,9 +620,14 @@ void ast_format_cap_remove_by_type(struct ast_format_cap *cap, enum ast_media_ty
 			AST_LIST_REMOVE_CURRENT(entry);
 			AST_VECTOR_REMOVE_CMP_ORDERED(&cap->preference_order, framed->format,
 				FORMAT_CAP_FRAMED_ELEM_CMP, FORMAT_CAP_FRAMED_ELEM_CLEANUP);
+			cap->types[ast_format_get_type(framed->format)]--;
 			ao2_ref(framed, -1);
 		}
 		AST_LIST_TRAVERSE_SAFE_END;
+
+		if (AST_LIST_EMPTY(list)) {
+			format_cap_codec_clear(cap, idx);
+		}
 	}
 }
 
@@ -614,17 +700,7 @@ enum ast_format_cmp_res ast_format_cap_iscompatible_format(const struct ast_form
 
 int ast_format_cap_has_type(const struct ast_format_cap *cap, enum ast_media_type type)
 {
-	int idx;
-
-	for (idx = 0; idx < AST_VECTOR_SIZE(&cap->preference_order); ++idx) {
-		struct format_cap_framed *framed = AST_VECTOR_GET(&cap->preference_order, idx);
-
-		if (ast_format_get_type(framed->format) == type) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return type < AST_MEDIA_TYPE_END && cap->types[type];
 }
 
 int ast_format_cap_get_compatible(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2,
@@ -632,10 +708,18 @@ int ast_format_cap_get_compatible(const struct ast_format_cap *cap1, const struc
 {
 	int idx, res = 0;
 
+	if (!format_cap_codecs_intersect(cap1, cap2)) {
+		return 0;
+	}
+
 	for (idx = 0; idx < AST_VECTOR_SIZE(&cap1->preference_order); ++idx) {
 		struct format_cap_framed *framed = AST_VECTOR_GET(&cap1->preference_order, idx);
 		struct ast_format *format;
 
+		if (!format_cap_codec_isset(cap2, ast_format_get_codec_id(framed->format))) {
+			continue;
+		}
+
 		format = ast_format_cap_get_compatible_format(cap2, framed->format);
 		if (!format) {
 			continue;
@@ -656,9 +740,18 @@ int ast_format_cap_iscompatible(const struct ast_format_cap *cap1, const struct
 {
 	int idx;
 
+	if (!format_cap_codecs_intersect(cap1, cap2)) {
+		return 0;
+	}
+
+	/* Formats of a common codec are only incompatible if their attributes say so */
 	for (idx = 0; idx < AST_VECTOR_SIZE(&cap1->preference_order); ++idx) {
 		struct format_cap_framed *framed = AST_VECTOR_GET(&cap1->preference_order, idx);
 
+		if (!format_cap_codec_isset(cap2, ast_format_get_codec_id(framed->format))) {
+			continue;
+		}
+
 		if (ast_format_cap_iscompatible_format(cap2, framed->format) != AST_FORMAT_CMP_NOT_EQUAL) {
 			return 1;
 		}
@@ -667,36 +760,43 @@ int ast_format_cap_iscompatible(const struct ast_format_cap *cap1, const struct
 	return 0;
 }
 
-static int internal_format_cap_identical(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2)
+int ast_format_cap_identical(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2)
 {
 	int idx;
-	struct ast_format *tmp;
-
-	for (idx = 0; idx < AST_VECTOR_SIZE(&cap1->preference_order); ++idx) {
-		tmp = ast_format_cap_get_format(cap1, idx);
-
-		if (ast_format_cap_iscompatible_format(cap2, tmp) != AST_FORMAT_CMP_EQUAL) {
-			ao2_ref(tmp, -1);
-			return 0;
-		}
-
-		ao2_ref(tmp, -1);
-	}
 
-	return 1;
-}
-
-int ast_format_cap_identical(const struct ast_format_cap *cap1, const struct ast_format_cap *cap2)
-{
 	if (AST_VECTOR_SIZE(&cap1->preference_order) != AST_VECTOR_SIZE(&cap2->preference_order)) {
 		return 0; /* if they are not the same size, they are not identical */
 	}
 
-	if (!internal_format_cap_identical(cap1, cap2)) {
+	if (!format_cap_codecs_equal(cap1, cap2)) {
 		return 0;
 	}
 
-	return internal_format_cap_identical(cap2, cap1);
+	/*
+	 * A capabilities structure holds one format per codec, so with the same
+	 * codecs on both sides only the formats of each codec need comparing.
+	 * Shared formats are equal, others are compared both ways as their
+	 * attributes may not be symmetric.
+	 */
+	for (idx = 0; idx < AST_VECTOR_SIZE(&cap1->preference_order); ++idx) {
+		struct ast_format *format1 = AST_VECTOR_GET(&cap1->preference_order, idx)->format;
+		struct format_cap_framed_list *list;
+		struct ast_format *format2;
+
+		list = AST_VECTOR_GET_ADDR(&cap2->formats, ast_format_get_codec_id(format1));
+		format2 = AST_LIST_FIRST(list)->format;
+
+		if (format1 == format2) {
+			continue;
+		}
+
+		if (ast_format_cmp(format1, format2) != AST_FORMAT_CMP_EQUAL
+			|| ast_format_cmp(format2, format1) != AST_FORMAT_CMP_EQUAL) {
+			return 0;
+		}
+	}
+
+	return 1;
 }
 
 static const char *__ast_format_cap_get_names(const struct ast_format_cap *cap, struct ast_str **buf, int append)
@@ -42,6 +42,7 @@
 #include "asterisk/translate.h"
 #include "asterisk/dsp.h"
 #include "asterisk/file.h"
+#include "asterisk/slinear_mix.h"
 
 #include <math.h>
 
@@ -50,108 +51,320 @@
 #endif
 
 #if !defined(NO_FRAME_CACHE)
-static void frame_cache_cleanup(void *data);
+/*!
+ * \brief Payload sizes of the frame slab size classes
+ *
+ * Class 0 holds a bare frame header.  The others hold a frame header, the
+ * friendly offset and 20ms of ulaw, slin, slin16, slin32 or slin48 audio,
+ * which covers nearly every frame passing through a bridge.  Anything
+ * larger is allocated from the heap as before.
+ */
+static const size_t frame_slab_payload[] = { 0, 160, 320, 640, 1280, 1920 };
 
-/*! \brief A per-thread cache of frame headers */
-AST_THREADSTORAGE_CUSTOM(frame_cache, NULL, frame_cache_cleanup);
+#define FRAME_SLAB_CLASSES ARRAY_LEN(frame_slab_payload)
+
+/*! \brief Extra room in every slab block for a duplicated source string */
+#define FRAME_SLAB_SRC_SPACE 64
+
+/*! \brief Usable bytes in a block of the given size class */
+#define FRAME_SLAB_CAPACITY(size_class) \
+	(sizeof(struct ast_frame) + AST_FRIENDLY_OFFSET + FRAME_SLAB_SRC_SPACE + frame_slab_payload[(size_class)])
 
 /*!
- * \brief Maximum ast_frame cache size
+ * \brief Maximum bytes a thread keeps cached for each size class
  *
- * In most cases where the frame header cache will be useful, the size
- * of the cache will stay very small.  However, it is not always the case that
- * the same thread that allocates the frame will be the one freeing them, so
- * sometimes a thread will never have any frames in its cache, or the cache
- * will never be pulled from.  For the latter case, we limit the maximum size.
+ * This works out to a few dozen bare headers but only a handful of the
+ * largest blocks, so idle threads do not sit on much memory.
+ */
+#define FRAME_SLAB_CACHE_BYTES 16384
+
+/*
+ * lock.h has no compare and swap or exchange wrappers so provide the few
+ * needed here.
  */
-#define FRAME_CACHE_MAX_SIZE	10
+#if defined(HAVE_C_ATOMICS)
+#define frame_slab_atomic_load(ptr)          __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define frame_slab_atomic_exchange(ptr, val) __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+#define frame_slab_atomic_cas(ptr, oldval, newval) \
+	__atomic_compare_exchange_n((ptr), &(oldval), (newval), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#else
+#define frame_slab_atomic_load(ptr)          __sync_fetch_and_add((ptr), 0)
+#define frame_slab_atomic_exchange(ptr, val) \
+	({ __sync_synchronize(); __sync_lock_test_and_set((ptr), (val)); })
+#define frame_slab_atomic_cas(ptr, oldval, newval) \
+	__sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#endif
 
-/*! \brief This is just so ast_frames, a list head struct for holding a list of
- *  ast_frame structures, is defined. */
-AST_LIST_HEAD_NOLOCK(ast_frames, ast_frame);
+struct frame_slab_cache;
 
-struct ast_frame_cache {
-	struct ast_frames list;
-	size_t size;
+/*! \brief Prefix of every block handed out by the frame slab */
+struct frame_slab_block {
+	/*! The thread cache the block was allocated from and is returned to */
+	struct frame_slab_cache *owner;
+	/*! Free list or return stack linkage */
+	struct frame_slab_block *next;
+	/*! Index into frame_slab_payload */
+	unsigned int size_class;
+} __attribute__((aligned(16)));
+
+/*!
+ * \brief A thread's frame slab
+ *
+ * Frames are very often freed by a different thread than the one that
+ * allocated them, e.g. a frame read by a channel thread and written out
+ * by a bridge.  Such frees are pushed onto the owner's lock free return
+ * stack and the owner reclaims them the next time it runs dry.
+ *
+ * Caches are never freed.  When their thread exits they are put on the
+ * orphan list to be adopted by the next thread needing one, so blocks
+ * still in flight always have a valid owner to return to.
+ */
+struct frame_slab_cache {
+	/*! Blocks available to the owning thread, one list per size class */
+	struct frame_slab_block *free[FRAME_SLAB_CLASSES];
+	/*! Number of blocks on each free list */
+	unsigned int num_free[FRAME_SLAB_CLASSES];
+	/*! Blocks freed by other threads */
+	struct frame_slab_block *returned;
+	/*! Next cache on the orphan list */
+	struct frame_slab_cache *next_orphan;
 };
-#endif
 
-struct ast_frame ast_null_frame = { AST_FRAME_NULL, };
+/*! \brief Thread local pointer to the thread's frame slab */
+struct frame_slab_tls {
+	struct frame_slab_cache *cache;
+};
 
-static struct ast_frame *ast_frame_header_new(const char *file, int line, const char *func)
+static void frame_slab_tls_cleanup(void *data);
+
+AST_THREADSTORAGE_CUSTOM(frame_slab_tls, NULL, frame_slab_tls_cleanup);
+
+/*! \brief Caches whose thread has exited */
+static struct frame_slab_cache *frame_slab_orphans;
+AST_MUTEX_DEFINE_STATIC(frame_slab_orphans_lock);
+
+static struct frame_slab_cache *frame_slab_get(void)
 {
-	struct ast_frame *f;
+	struct frame_slab_tls *tls;
 
-#if !defined(NO_FRAME_CACHE)
-	struct ast_frame_cache *frames;
+	if (!(tls = ast_threadstorage_get(&frame_slab_tls, sizeof(*tls)))) {
+		return NULL;
+	}
+
+	if (tls->cache) {
+		return tls->cache;
+	}
+
+	ast_mutex_lock(&frame_slab_orphans_lock);
+	if ((tls->cache = frame_slab_orphans)) {
+		frame_slab_orphans = tls->cache->next_orphan;
+		tls->cache->next_orphan = NULL;
+	}
+	ast_mutex_unlock(&frame_slab_orphans_lock);
 
-	if ((frames = ast_threadstorage_get(&frame_cache, sizeof(*frames)))) {
-		if ((f = AST_LIST_REMOVE_HEAD(&frames->list, frame_list))) {
-			size_t mallocd_len = f->mallocd_hdr_len;
+	if (!tls->cache) {
+		tls->cache = ast_calloc(1, sizeof(*tls->cache));
+	}
+
+	return tls->cache;
+}
 
-			memset(f, 0, sizeof(*f));
-			f->mallocd_hdr_len = mallocd_len;
-			frames->size--;
-			return f;
+/*! \brief Put a block on one of the cache's free lists, or free it if the list is full */
+static void frame_slab_cache_put(struct frame_slab_cache *cache, struct frame_slab_block *block)
+{
+	unsigned int size_class = block->size_class;
+
+	if (cache->num_free[size_class] >= FRAME_SLAB_CACHE_BYTES / FRAME_SLAB_CAPACITY(size_class)) {
+		ast_free(block);
+		return;
+	}
+
+	block->next = cache->free[size_class];
+	cache->free[size_class] = block;
+	cache->num_free[size_class]++;
+}
+
+/*! \brief Move blocks freed by other threads onto the cache's free lists */
+static void frame_slab_reclaim(struct frame_slab_cache *cache)
+{
+	struct frame_slab_block *block;
+	struct frame_slab_block *next;
+
+	if (!frame_slab_atomic_load(&cache->returned)) {
+		return;
+	}
+
+	for (block = frame_slab_atomic_exchange(&cache->returned, NULL); block; block = next) {
+		next = block->next;
+		frame_slab_cache_put(cache, block);
+	}
+}
+
+static void frame_slab_tls_cleanup(void *data)
+{
+	struct frame_slab_tls *tls = data;
+	struct frame_slab_cache *cache = tls->cache;
+	struct frame_slab_block *block;
+	int size_class;
+
+	if (cache) {
+		frame_slab_reclaim(cache);
+		for (size_class = 0; size_class < FRAME_SLAB_CLASSES; size_class++) {
+			while ((block = cache->free[size_class])) {
+				cache->free[size_class] = block->next;
+				ast_free(block);
+			}
+			cache->num_free[size_class] = 0;
 		}
+
+		ast_mutex_lock(&frame_slab_orphans_lock);
+		cache->next_orphan = frame_slab_orphans;
+		frame_slab_orphans = cache;
+		ast_mutex_unlock(&frame_slab_orphans_lock);
 	}
-#endif
 
-	if (!(f = __ast_calloc(1, sizeof(*f), file, line, func))) {
+	ast_free(tls);
+}
+
+/*!
+ * \internal
+ * \brief Allocate a block from the calling thread's frame slab
+ *
+ * \param len Number of bytes needed
+ * \param[out] capacity Optional, set to the usable size of the block
+ *
+ * \retval NULL if the slab cannot satisfy the request, the caller should
+ *         fall back to the heap
+ * \return uninitialized memory of at least len bytes otherwise
+ */
+static void *frame_slab_alloc(size_t len, size_t *capacity)
+{
+	struct frame_slab_cache *cache;
+	struct frame_slab_block *block;
+	int size_class;
+
+	if (!ast_opt_cache_media_frames) {
 		return NULL;
 	}
 
-	f->mallocd_hdr_len = sizeof(*f);
+	for (size_class = 0; size_class < FRAME_SLAB_CLASSES; size_class++) {
+		if (len <= FRAME_SLAB_CAPACITY(size_class)) {
+			break;
+		}
+	}
+	if (size_class == FRAME_SLAB_CLASSES || !(cache = frame_slab_get())) {
+		return NULL;
+	}
 
-	return f;
+	if (!cache->free[size_class]) {
+		frame_slab_reclaim(cache);
+	}
+
+	if ((block = cache->free[size_class])) {
+		cache->free[size_class] = block->next;
+		cache->num_free[size_class]--;
+	} else {
+		if (!(block = ast_malloc(sizeof(*block) + FRAME_SLAB_CAPACITY(size_class)))) {
+			return NULL;
+		}
+		block->owner = cache;
+		block->size_class = size_class;
+	}
+
+	if (capacity) {
+		*capacity = FRAME_SLAB_CAPACITY(size_class);
+	}
+
+	return block + 1;
 }
 
-#if !defined(NO_FRAME_CACHE)
-static void frame_cache_cleanup(void *data)
+/*!
+ * \internal
+ * \brief Return a block to the frame slab it was allocated from
+ *
+ * \param ptr Pointer returned by frame_slab_alloc()
+ * \param cache Non-zero to keep the block for reuse, zero to free it to the heap
+ */
+static void frame_slab_free(void *ptr, int cache)
 {
-	struct ast_frame_cache *frames = data;
-	struct ast_frame *f;
+	struct frame_slab_block *block = (struct frame_slab_block *) ptr - 1;
+	struct frame_slab_cache *owner = block->owner;
+	struct frame_slab_block *head;
+
+	if (!cache) {
+		ast_free(block);
+		return;
+	}
 
-	while ((f = AST_LIST_REMOVE_HEAD(&frames->list, frame_list)))
-		ast_free(f);
+	if (frame_slab_get() == owner) {
+		frame_slab_cache_put(owner, block);
+		return;
+	}
 
-	ast_free(frames);
+	do {
+		head = frame_slab_atomic_load(&owner->returned);
+		block->next = head;
+	} while (!frame_slab_atomic_cas(&owner->returned, head, block));
+}
+#else
+static void *frame_slab_alloc(size_t len, size_t *capacity)
+{
+	return NULL;
 }
 #endif
 
-static void __frame_free(struct ast_frame *fr, int cache)
+struct ast_frame ast_null_frame = { AST_FRAME_NULL, };
+
+/*!
+ * \internal
+ * \brief Free a frame header or data buffer
+ *
+ * \param ptr The block to free
+ * \param slab Non-zero if the block came from frame_slab_alloc()
+ * \param cache Non-zero to allow the block to be cached for reuse
+ */
+static void frame_block_free(void *ptr, int slab, int cache)
 {
-	if (!fr->mallocd)
+#if !defined(NO_FRAME_CACHE)
+	if (slab) {
+		frame_slab_free(ptr, cache);
 		return;
+	}
+#endif
+	ast_free(ptr);
+}
 
-#if !defined(NO_FRAME_CACHE)
-	if (fr->mallocd == AST_MALLOCD_HDR
-		&& cache
-		&& ast_opt_cache_media_frames) {
-		/* Cool, only the header is malloc'd, let's just cache those for now
-		 * to keep things simple... */
-		struct ast_frame_cache *frames;
-
-		frames = ast_threadstorage_get(&frame_cache, sizeof(*frames));
-		if (frames && frames->size < FRAME_CACHE_MAX_SIZE) {
-			if (fr->frametype == AST_FRAME_VOICE
-				|| fr->frametype == AST_FRAME_VIDEO
-				|| fr->frametype == AST_FRAME_IMAGE) {
-				ao2_cleanup(fr->subclass.format);
-			} else if (fr->frametype == AST_FRAME_CONTROL && fr->subclass.integer == AST_CONTROL_ANSWER) {
-				ao2_cleanup(fr->subclass.topology);
-			}
+static struct ast_frame *ast_frame_header_new(const char *file, int line, const char *func)
+{
+	struct ast_frame *f;
+	size_t capacity;
 
-			AST_LIST_INSERT_HEAD(&frames->list, fr, frame_list);
-			frames->size++;
-			return;
-		}
+	if ((f = frame_slab_alloc(sizeof(*f), &capacity))) {
+		memset(f, 0, sizeof(*f));
+		f->mallocd = AST_MALLOCD_SLAB_HDR;
+		f->mallocd_hdr_len = capacity;
+		return f;
 	}
-#endif
 
-	if (fr->mallocd & AST_MALLOCD_DATA) {
+	if (!(f = __ast_calloc(1, sizeof(*f), file, line, func))) {
+		return NULL;
+	}
+
+	f->mallocd_hdr_len = sizeof(*f);
+
+	return f;
+}
+
+static void __frame_free(struct ast_frame *fr, int cache)
+{
+	if (!fr->mallocd)
+		return;
+
+	if (fr->mallocd & AST_MALLOCD_SHARED) {
+		ao2_ref(fr->data.ptr - AST_FRIENDLY_OFFSET, -1);
+	} else if (fr->mallocd & AST_MALLOCD_DATA) {
 		if (fr->data.ptr) {
-			ast_free(fr->data.ptr - fr->offset);
+			frame_block_free(fr->data.ptr - fr->offset, fr->mallocd & AST_MALLOCD_SLAB_DATA, cache);
 		}
 	}
 	if (fr->mallocd & AST_MALLOCD_SRC) {
@@ -166,7 +379,7 @@ static void __frame_free(struct ast_frame *fr, int cache)
 			ao2_cleanup(fr->subclass.topology);
 		}
 
-		ast_free(fr);
+		frame_block_free(fr, fr->mallocd & AST_MALLOCD_SLAB_HDR, cache);
 	} else {
 		fr->mallocd = 0;
 	}
@@ -227,8 +440,9 @@ struct ast_frame *__ast_frisolate(struct ast_frame *fr, const char *file, int li
 		}
 		out->datalen = fr->datalen;
 		out->samples = fr->samples;
-		out->mallocd = AST_MALLOCD_HDR;
+		out->mallocd |= AST_MALLOCD_HDR;
 		out->offset = fr->offset;
+		out->ingress = fr->ingress;
 		/* Copy the timing data */
 		ast_copy_flags(out, fr, AST_FLAGS_ALL);
 		if (ast_test_flag(fr, AST_FRFLAG_HAS_TIMING_INFO)) {
@@ -279,8 +493,9 @@ struct ast_frame *__ast_frisolate(struct ast_frame *fr, const char *file, int li
 		 * Duplicate the data buffer and put it into the isolated frame
 		 * which may also be the original frame.
 		 */
-		newdata = ast_malloc(fr->datalen + AST_FRIENDLY_OFFSET);
-		if (!newdata) {
+		if ((newdata = frame_slab_alloc(fr->datalen + AST_FRIENDLY_OFFSET, NULL))) {
+			out->mallocd |= AST_MALLOCD_SLAB_DATA;
+		} else if (!(newdata = ast_malloc(fr->datalen + AST_FRIENDLY_OFFSET))) {
 			if (out != fr) {
 				ast_frame_free(out, 0);
 			}
@@ -292,11 +507,11 @@ struct ast_frame *__ast_frisolate(struct ast_frame *fr, const char *file, int li
 		out->data.ptr = newdata;
 		out->mallocd |= AST_MALLOCD_DATA;
 	} else if (out != fr) {
-		/* Steal the data buffer from the original frame. */
+		/* Steal the data buffer, and how it was allocated, from the original frame. */
 		out->data = fr->data;
 		memset(&fr->data, 0, sizeof(fr->data));
-		fr->mallocd &= ~AST_MALLOCD_DATA;
-		out->mallocd |= AST_MALLOCD_DATA;
+		out->mallocd |= fr->mallocd & (AST_MALLOCD_DATA | AST_MALLOCD_SLAB_DATA);
+		fr->mallocd &= ~(AST_MALLOCD_DATA | AST_MALLOCD_SLAB_DATA);
 	}
 
 	return out;
@@ -307,10 +522,8 @@ struct ast_frame *__ast_frdup(const struct ast_frame *f, const char *file, int l
 	struct ast_frame *out = NULL;
 	int len, srclen = 0;
 	void *buf = NULL;
-
-#if !defined(NO_FRAME_CACHE)
-	struct ast_frame_cache *frames;
-#endif
+	size_t capacity;
+	int slab = 0;
 
 	/* Start with standard stuff */
 	len = sizeof(*out) + AST_FRIENDLY_OFFSET + f->datalen;
@@ -324,23 +537,12 @@ struct ast_frame *__ast_frdup(const struct ast_frame *f, const char *file, int l
 	if (srclen > 0)
 		len += srclen + 1;
 
-#if !defined(NO_FRAME_CACHE)
-	if ((frames = ast_threadstorage_get(&frame_cache, sizeof(*frames)))) {
-		AST_LIST_TRAVERSE_SAFE_BEGIN(&frames->list, out, frame_list) {
-			if (out->mallocd_hdr_len >= len) {
-				size_t mallocd_len = out->mallocd_hdr_len;
-
-				AST_LIST_REMOVE_CURRENT(frame_list);
-				memset(out, 0, sizeof(*out));
-				out->mallocd_hdr_len = mallocd_len;
-				buf = out;
-				frames->size--;
-				break;
-			}
-		}
-		AST_LIST_TRAVERSE_SAFE_END;
+	if ((buf = frame_slab_alloc(len, &capacity))) {
+		out = buf;
+		memset(out, 0, sizeof(*out));
+		out->mallocd_hdr_len = capacity;
+		slab = AST_MALLOCD_SLAB_HDR;
 	}
-#endif
 
 	if (!buf) {
 		if (!(buf = __ast_calloc(1, len, file, line, func)))
@@ -361,6 +563,7 @@ struct ast_frame *__ast_frdup(const struct ast_frame *f, const char *file, int l
 	out->datalen = f->datalen;
 	out->samples = f->samples;
 	out->delivery = f->delivery;
+	out->ingress = f->ingress;
 	/* Even though this new frame was allocated from the heap, we can't mark it
 	 * with AST_MALLOCD_HDR, AST_MALLOCD_DATA and AST_MALLOCD_SRC, because that
 	 * would cause ast_frfree() to attempt to individually free each of those
@@ -368,7 +571,7 @@ struct ast_frame *__ast_frdup(const struct ast_frame *f, const char *file, int l
 	 * was allocated in a single allocation, we'll only mark it as if the header
 	 * was heap-allocated; this will result in the entire frame being properly freed.
 	 */
-	out->mallocd = AST_MALLOCD_HDR;
+	out->mallocd = AST_MALLOCD_HDR | slab;
 	out->offset = AST_FRIENDLY_OFFSET;
 	/* Make sure that empty text frames have a valid data.ptr */
 	if (out->datalen || f->frametype == AST_FRAME_TEXT) {
@@ -393,6 +596,107 @@ struct ast_frame *__ast_frdup(const struct ast_frame *f, const char *file, int l
 	return out;
 }
 
+struct ast_frame *__ast_frshare(struct ast_frame *fr, const char *file, int line, const char *func)
+{
+	struct ast_frame *out;
+	char *payload;
+	int srclen = 0;
+
+	if (!(fr->mallocd & AST_MALLOCD_SHARED)) {
+		if (!fr->datalen) {
+			return __ast_frdup(fr, file, line, func);
+		}
+
+		/* The payload is laid out the same way ast_frdup() lays out its data */
+		if (fr->src) {
+			srclen = strlen(fr->src) + 1;
+		}
+		payload = __ao2_alloc(AST_FRIENDLY_OFFSET + fr->datalen + srclen, NULL,
+			AO2_ALLOC_OPT_LOCK_NOLOCK, "frame payload", file, line, func);
+		if (!payload) {
+			return NULL;
+		}
+		memcpy(payload + AST_FRIENDLY_OFFSET, fr->data.ptr, fr->datalen);
+		if (srclen) {
+			strcpy(payload + AST_FRIENDLY_OFFSET + fr->datalen, fr->src);
+		}
+	} else {
+		payload = ao2_bump(fr->data.ptr - AST_FRIENDLY_OFFSET);
+	}
+
+	if (!(out = ast_frame_header_new(file, line, func))) {
+		ao2_ref(payload, -1);
+		return NULL;
+	}
+
+	out->frametype = fr->frametype;
+	out->subclass = fr->subclass;
+	if ((fr->frametype == AST_FRAME_VOICE) || (fr->frametype == AST_FRAME_VIDEO) ||
+		(fr->frametype == AST_FRAME_IMAGE)) {
+		ao2_bump(out->subclass.format);
+	} else if (fr->frametype == AST_FRAME_CONTROL && fr->subclass.integer == AST_CONTROL_ANSWER) {
+		ao2_bump(out->subclass.topology);
+	}
+	out->datalen = fr->datalen;
+	out->samples = fr->samples;
+	out->delivery = fr->delivery;
+	out->ingress = fr->ingress;
+	out->mallocd |= AST_MALLOCD_HDR | AST_MALLOCD_DATA | AST_MALLOCD_SHARED;
+	/* No headroom, the bytes in front of the data belong to everyone */
+	out->offset = 0;
+	out->data.ptr = payload + AST_FRIENDLY_OFFSET;
+	if (fr->mallocd & AST_MALLOCD_SHARED) {
+		out->src = fr->src;
+	} else if (srclen) {
+		out->src = payload + AST_FRIENDLY_OFFSET + fr->datalen;
+	}
+	ast_copy_flags(out, fr, AST_FLAGS_ALL);
+	out->ts = fr->ts;
+	out->len = fr->len;
+	out->seqno = fr->seqno;
+	out->stream_num = fr->stream_num;
+
+	return out;
+}
+
+int ast_frunshare(struct ast_frame *fr)
+{
+	char *payload;
+	char *newdata;
+	char *newsrc = NULL;
+	int slab = 0;
+
+	if (!(fr->mallocd & AST_MALLOCD_SHARED)) {
+		return 0;
+	}
+
+	payload = fr->data.ptr - AST_FRIENDLY_OFFSET;
+
+	if (fr->src && !(newsrc = ast_strdup(fr->src))) {
+		return -1;
+	}
+
+	if ((newdata = frame_slab_alloc(fr->datalen + AST_FRIENDLY_OFFSET, NULL))) {
+		slab = AST_MALLOCD_SLAB_DATA;
+	} else if (!(newdata = ast_malloc(fr->datalen + AST_FRIENDLY_OFFSET))) {
+		ast_free(newsrc);
+		return -1;
+	}
+	memcpy(newdata + AST_FRIENDLY_OFFSET, fr->data.ptr, fr->datalen);
+
+	fr->data.ptr = newdata + AST_FRIENDLY_OFFSET;
+	fr->offset = AST_FRIENDLY_OFFSET;
+	fr->mallocd &= ~AST_MALLOCD_SHARED;
+	fr->mallocd |= slab;
+	if (newsrc) {
+		fr->src = newsrc;
+		fr->mallocd |= AST_MALLOCD_SRC;
+	}
+	ao2_ref(payload, -1);
+
+	return 0;
+}
+
 void ast_swapcopy_samples(void *dst, const void *src, int samples)
 {
 	int i;
@@ -786,25 +1090,11 @@ void ast_frame_dump(const char *name, struct ast_frame *f, char *prefix)
 
 int ast_frame_adjust_volume(struct ast_frame *f, int adjustment)
 {
-	int count;
-	short *fdata = f->data.ptr;
-	short adjust_value = abs(adjustment);
-
 	if ((f->frametype != AST_FRAME_VOICE) || !(ast_format_cache_is_slinear(f->subclass.format))) {
 		return -1;
 	}
 
-	if (!adjustment) {
-		return 0;
-	}
-
-	for (count = 0; count < f->samples; count++) {
-		if (adjustment > 0) {
-			ast_slinear_saturated_multiply(&fdata[count], &adjust_value);
-		} else if (adjustment < 0) {
-			ast_slinear_saturated_divide(&fdata[count], &adjust_value);
-		}
-	}
+	ast_slinear_mix_adjust_volume(f->data.ptr, f->samples, adjustment);
 
 	return 0;
 }
@@ -836,9 +1126,6 @@ int ast_frame_adjust_volume_float(struct ast_frame *f, float adjustment)
 
 int ast_frame_slinear_sum(struct ast_frame *f1, struct ast_frame *f2)
 {
-	int count;
-	short *data1, *data2;
-
 	if ((f1->frametype != AST_FRAME_VOICE) || (ast_format_cmp(f1->subclass.format, ast_format_slin) != AST_FORMAT_CMP_NOT_EQUAL))
 		return -1;
 
@@ -848,10 +1135,7 @@ int ast_frame_slinear_sum(struct ast_frame *f1, struct ast_frame *f2)
 	if (f1->samples != f2->samples)
 		return -1;
 
-	for (count = 0, data1 = f1->data.ptr, data2 = f2->data.ptr;
-	     count < f1->samples;
-	     count++, data1++, data2++)
-		ast_slinear_saturated_add(data1, data2);
+	ast_slinear_mix_add(f1->data.ptr, f2->data.ptr, f1->samples);
 
 	return 0;
 }
@@ -51,6 +51,8 @@ struct ast_framehook_list {
 	unsigned int count;
 	/*! id for next framehook added */
 	unsigned int id_count;
+	/*! frame types any of the framehooks wants, every bit is set if one wants all or is detaching */
+	unsigned int frame_types;
 	AST_LIST_HEAD_NOLOCK(, ast_framehook) list;
 };
 
@@ -80,14 +82,42 @@ static void framehook_detach(struct ast_framehook *framehook, enum framehook_det
 	ast_free(framehook);
 }
 
+/*!
+ * \internal
+ * \brief Recalculate the frame types the framehooks of a list want
+ *
+ * A framehook marked for detachment wants every type, so that the next
+ * frame walks the list and detaches it.
+ */
+static void framehook_list_update_types(struct ast_framehook_list *framehooks)
+{
+	struct ast_framehook *framehook;
+
+	framehooks->frame_types = 0;
+	AST_LIST_TRAVERSE(&framehooks->list, framehook, list) {
+		if (framehook->detach_and_destroy_me || !framehook->i.frame_types) {
+			framehooks->frame_types = ~0U;
+			break;
+		}
+		framehooks->frame_types |= framehook->i.frame_types;
+	}
+}
+
+/*! \internal \brief Determine if a framehook does not want a frame */
+static int framehook_skips_frame(unsigned int frame_types, struct ast_frame *frame)
+{
+	return frame && frame_types && !(frame_types & AST_FRAMEHOOK_TYPE(frame->frametype));
+}
+
 static struct ast_frame *framehook_list_push_event(struct ast_framehook_list *framehooks, struct ast_frame *frame, enum ast_framehook_event event)
 {
 	struct ast_framehook *framehook;
 	struct ast_frame *original_frame;
 	int *skip;
 	size_t skip_size;
+	int removed = 0;
 
-	if (!framehooks) {
+	if (!framehooks || framehook_skips_frame(framehooks->frame_types, frame)) {
 		return frame;
 	}
 
@@ -104,11 +134,12 @@ static struct ast_frame *framehook_list_push_event(struct ast_framehook_list *fr
 				/* this guy is signaled for destruction */
 				AST_LIST_REMOVE_CURRENT(list);
 				framehook_detach(framehook, FRAMEHOOK_DETACH_DESTROY);
+				removed = 1;
 				continue;
 			}
 
 			/* If this framehook has been marked as needing to be skipped, do so */
-			if (skip[num]) {
+			if (skip[num] || framehook_skips_frame(framehook->i.frame_types, frame)) {
 				num++;
 				continue;
 			}
@@ -126,6 +157,10 @@ static struct ast_frame *framehook_list_push_event(struct ast_framehook_list *fr
 		AST_LIST_TRAVERSE_SAFE_END;
 	} while (frame != original_frame);
 
+	if (removed) {
+		framehook_list_update_types(framehooks);
+	}
+
 	return frame;
 }
 
@@ -157,6 +192,7 @@ int ast_framehook_attach(struct ast_channel *chan, struct ast_framehook_interfac
 	ast_channel_framehooks(chan)->count++;
 	framehook->id = ++ast_channel_framehooks(chan)->id_count;
 	AST_LIST_INSERT_TAIL(&ast_channel_framehooks(chan)->list, framehook, list);
+	framehook_list_update_types(ast_channel_framehooks(chan));
 
 	/* Tell the event callback we're live and rocking */
 	frame = framehook->i.event_cb(framehook->chan, NULL, AST_FRAMEHOOK_EVENT_ATTACHED, framehook->i.data);
@@ -190,6 +226,7 @@ int ast_framehook_detach(struct ast_channel *chan, int id)
 			 * event callback.  If we allowed the hook to actually be destroyed
 			 * immediately here, the event callback would crash on exit. */
 			framehook->detach_and_destroy_me = 1;
+			ast_channel_framehooks(chan)->frame_types = ~0U;
 			res = 0;
 			break;
 		}
@@ -269,6 +306,7 @@ void ast_framehook_list_fixup(struct ast_channel *old_chan, struct ast_channel *
 			framehook_detach(framehook, FRAMEHOOK_DETACH_PRESERVE);
 		}
 	}
+	framehook_list_update_types(ast_channel_framehooks(old_chan));
 }
 
 int ast_framehook_list_is_empty(struct ast_framehook_list *framehooks)
@@ -0,0 +1,365 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief G.711 buffer decoding kernels
+ *
+ * The vector kernels compute the samples arithmetically instead of through
+ * the lookup tables.  Both laws decode to a 9 bit value shifted left by the
+ * segment number, so eight or sixteen samples at a time are widened to 16
+ * bits, the power of two for each segment is fetched with a byte shuffle
+ * and multiplied in, and the sign is applied with a mask.
+ */
+
+/* Needed for the mm_malloc.h pulled in by immintrin.h */
+#define ASTMM_LIBC ASTMM_IGNORE
+#include "asterisk.h"
+
+#include "asterisk/_private.h"
+#include "asterisk/utils.h"
+#include "asterisk/ulaw.h"
+#include "asterisk/alaw.h"
+#include "asterisk/g711.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define G711_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define G711_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void scalar_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		dst[i] = AST_MULAW(src[i]);
+	}
+}
+
+static void scalar_alaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		dst[i] = AST_ALAW(src[i]);
+	}
+}
+
+static const struct ast_g711_ops scalar_ops = {
+	.name = "scalar",
+	.ulaw_decode = scalar_ulaw_decode,
+	.alaw_decode = scalar_alaw_decode,
+};
+
+#ifdef G711_X86
+/*
+ * mu-law: x = ~code, y = ((mantissa << 3) + 0x84) << segment, minus 0x84.
+ * A-law:  x = code ^ 0x55, y = (mantissa << 4) + 8, plus 0x100 and shifted
+ *         left by segment - 1 when the segment is not zero.
+ *
+ * The shuffle index of each 16 bit lane is the segment in the low byte and
+ * 0x80 in the high byte, so the high byte of the power of two comes out
+ * zero.  The largest product of either law is 32256 so nothing overflows.
+ */
+
+#define ULAW_POW2 1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0
+#define ALAW_POW2 1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0
+
+__attribute__((target("ssse3")))
+static inline __m128i ssse3_ulaw8(__m128i x)
+{
+	const __m128i pow2 = _mm_setr_epi8(ULAW_POW2);
+	__m128i seg;
+	__m128i y;
+	__m128i sign;
+
+	x = _mm_xor_si128(x, _mm_set1_epi16(0xff));
+	seg = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi16(0x7));
+	y = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0xf)), 3), _mm_set1_epi16(0x84));
+	y = _mm_mullo_epi16(y, _mm_shuffle_epi8(pow2, _mm_or_si128(seg, _mm_set1_epi16((short) 0x8000))));
+	y = _mm_sub_epi16(y, _mm_set1_epi16(0x84));
+	sign = _mm_cmpeq_epi16(_mm_and_si128(x, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x80));
+
+	return _mm_sub_epi16(_mm_xor_si128(y, sign), sign);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i ssse3_alaw8(__m128i x)
+{
+	const __m128i pow2 = _mm_setr_epi8(ALAW_POW2);
+	__m128i seg;
+	__m128i y;
+	__m128i sign;
+
+	x = _mm_xor_si128(x, _mm_set1_epi16(AST_ALAW_AMI_MASK));
+	seg = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi16(0x7));
+	y = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0xf)), 4), _mm_set1_epi16(8));
+	y = _mm_add_epi16(y, _mm_and_si128(_mm_cmpgt_epi16(seg, _mm_setzero_si128()), _mm_set1_epi16(0x100)));
+	y = _mm_mullo_epi16(y, _mm_shuffle_epi8(pow2, _mm_or_si128(seg, _mm_set1_epi16((short) 0x8000))));
+	sign = _mm_cmpeq_epi16(_mm_and_si128(x, _mm_set1_epi16(0x80)), _mm_setzero_si128());
+
+	return _mm_sub_epi16(_mm_xor_si128(y, sign), sign);
+}
+
+__attribute__((target("ssse3")))
+static void ssse3_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (src + i)), _mm_setzero_si128());
+
+		_mm_storeu_si128((__m128i *) (dst + i), ssse3_ulaw8(x));
+	}
+	scalar_ulaw_decode(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("ssse3")))
+static void ssse3_alaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (src + i)), _mm_setzero_si128());
+
+		_mm_storeu_si128((__m128i *) (dst + i), ssse3_alaw8(x));
+	}
+	scalar_alaw_decode(dst + i, src + i, samples - i);
+}
+
+static const struct ast_g711_ops ssse3_ops = {
+	.name = "ssse3",
+	.ulaw_decode = ssse3_ulaw_decode,
+	.alaw_decode = ssse3_alaw_decode,
+};
+
+/* The 256 bit shuffle works within each 128 bit half so the table is repeated */
+
+__attribute__((target("avx2")))
+static void avx2_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	const __m256i pow2 = _mm256_setr_epi8(ULAW_POW2, ULAW_POW2);
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+		__m256i seg;
+		__m256i y;
+		__m256i sign;
+
+		x = _mm256_xor_si256(x, _mm256_set1_epi16(0xff));
+		seg = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi16(0x7));
+		y = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0xf)), 3),
+			_mm256_set1_epi16(0x84));
+		y = _mm256_mullo_epi16(y,
+			_mm256_shuffle_epi8(pow2, _mm256_or_si256(seg, _mm256_set1_epi16((short) 0x8000))));
+		y = _mm256_sub_epi16(y, _mm256_set1_epi16(0x84));
+		sign = _mm256_cmpeq_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0x80)), _mm256_set1_epi16(0x80));
+
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_sub_epi16(_mm256_xor_si256(y, sign), sign));
+	}
+	scalar_ulaw_decode(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_alaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	const __m256i pow2 = _mm256_setr_epi8(ALAW_POW2, ALAW_POW2);
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+		__m256i seg;
+		__m256i y;
+		__m256i sign;
+
+		x = _mm256_xor_si256(x, _mm256_set1_epi16(AST_ALAW_AMI_MASK));
+		seg = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi16(0x7));
+		y = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0xf)), 4),
+			_mm256_set1_epi16(8));
+		y = _mm256_add_epi16(y, _mm256_and_si256(_mm256_cmpgt_epi16(seg, _mm256_setzero_si256()),
+			_mm256_set1_epi16(0x100)));
+		y = _mm256_mullo_epi16(y,
+			_mm256_shuffle_epi8(pow2, _mm256_or_si256(seg, _mm256_set1_epi16((short) 0x8000))));
+		sign = _mm256_cmpeq_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0x80)), _mm256_setzero_si256());
+
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_sub_epi16(_mm256_xor_si256(y, sign), sign));
+	}
+	scalar_alaw_decode(dst + i, src + i, samples - i);
+}
+
+static const struct ast_g711_ops avx2_ops = {
+	.name = "avx2",
+	.ulaw_decode = avx2_ulaw_decode,
+	.alaw_decode = avx2_alaw_decode,
+};
+#endif /* G711_X86 */
+
+#ifdef G711_NEON
+/* NEON has per lane variable shifts so the segment is used directly */
+
+static void neon_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		uint16x8_t x = vmovl_u8(vmvn_u8(vld1_u8(src + i)));
+		uint16x8_t seg = vandq_u16(vshrq_n_u16(x, 4), vdupq_n_u16(0x7));
+		uint16x8_t y = vaddq_u16(vshlq_n_u16(vandq_u16(x, vdupq_n_u16(0xf)), 3), vdupq_n_u16(0x84));
+		int16x8_t r;
+		int16x8_t sign;
+
+		y = vsubq_u16(vshlq_u16(y, vreinterpretq_s16_u16(seg)), vdupq_n_u16(0x84));
+		r = vreinterpretq_s16_u16(y);
+		sign = vreinterpretq_s16_u16(vtstq_u16(x, vdupq_n_u16(0x80)));
+		vst1q_s16(dst + i, vbslq_s16(vreinterpretq_u16_s16(sign), vnegq_s16(r), r));
+	}
+	scalar_ulaw_decode(dst + i, src + i, samples - i);
+}
+
+static void neon_alaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		uint16x8_t x = vmovl_u8(veor_u8(vld1_u8(src + i), vdup_n_u8(AST_ALAW_AMI_MASK)));
+		uint16x8_t seg = vandq_u16(vshrq_n_u16(x, 4), vdupq_n_u16(0x7));
+		uint16x8_t y = vaddq_u16(vshlq_n_u16(vandq_u16(x, vdupq_n_u16(0xf)), 4), vdupq_n_u16(8));
+		uint16x8_t positive;
+		int16x8_t r;
+
+		y = vaddq_u16(y, vandq_u16(vtstq_u16(seg, seg), vdupq_n_u16(0x100)));
+		y = vshlq_u16(y, vreinterpretq_s16_u16(vqsubq_u16(seg, vdupq_n_u16(1))));
+		r = vreinterpretq_s16_u16(y);
+		positive = vtstq_u16(x, vdupq_n_u16(0x80));
+		vst1q_s16(dst + i, vbslq_s16(positive, r, vnegq_s16(r)));
+	}
+	scalar_alaw_decode(dst + i, src + i, samples - i);
+}
+
+static const struct ast_g711_ops neon_ops = {
+	.name = "neon",
+	.ulaw_decode = neon_ulaw_decode,
+	.alaw_decode = neon_alaw_decode,
+};
+#endif /* G711_NEON */
+
+/*! \brief The kernels in use, plain C until ast_g711_init() runs */
+static const struct ast_g711_ops *active_ops = &scalar_ops;
+
+const struct ast_g711_ops *ast_g711_get_ops(enum ast_g711_impl impl)
+{
+	switch (impl) {
+	case AST_G711_SCALAR:
+		return &scalar_ops;
+#ifdef G711_X86
+	case AST_G711_SSSE3:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("ssse3") ? &ssse3_ops : NULL;
+	case AST_G711_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &avx2_ops : NULL;
+#endif
+#ifdef G711_NEON
+	case AST_G711_NEON:
+		return &neon_ops;
+#endif
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+const struct ast_g711_ops *ast_g711_active_ops(void)
+{
+	return active_ops;
+}
+
+void ast_ulaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	active_ops->ulaw_decode(dst, src, samples);
+}
+
+void ast_alaw_decode(short *dst, const unsigned char *src, unsigned int samples)
+{
+	active_ops->alaw_decode(dst, src, samples);
+}
+
+/*!
+ * \internal
+ * \brief Check that a kernel set decodes every code as the tables do.
+ *
+ * The tables can be built by either of two algorithms, see
+ * G711_NEW_ALGORITHM, so the vector kernels are verified once against
+ * whichever one this build uses.
+ */
+static int g711_ops_verify(const struct ast_g711_ops *ops)
+{
+	unsigned char codes[256];
+	short ulaw[256];
+	short alaw[256];
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(codes); i++) {
+		codes[i] = i;
+	}
+
+	ops->ulaw_decode(ulaw, codes, ARRAY_LEN(codes));
+	ops->alaw_decode(alaw, codes, ARRAY_LEN(codes));
+
+	for (i = 0; i < ARRAY_LEN(codes); i++) {
+		if (ulaw[i] != AST_MULAW(i) || alaw[i] != AST_ALAW(i)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int ast_g711_init(void)
+{
+	/* Ordered from most to least preferred */
+	static const enum ast_g711_impl preferred[] = {
+		AST_G711_AVX2,
+		AST_G711_SSSE3,
+		AST_G711_NEON,
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(preferred); i++) {
+		const struct ast_g711_ops *ops = ast_g711_get_ops(preferred[i]);
+
+		if (!ops) {
+			continue;
+		}
+		if (g711_ops_verify(ops)) {
+			ast_log(LOG_WARNING, "G.711 '%s' decoding kernels do not match the lookup tables, not using them\n",
+				ops->name);
+			continue;
+		}
+		active_ops = ops;
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Latency histograms
+ *
+ * Histograms are never removed once created, so the values given to a
+ * family's label must come from a bounded set.  Application names and
+ * source locations are fine, channel names are not.
+ */
+
+#include "asterisk.h"
+
+#include "asterisk/_private.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/lock.h"
+#include "asterisk/strings.h"
+#include "asterisk/utils.h"
+#include "asterisk/histogram.h"
+
+struct ast_histogram {
+	/*! Samples in each bucket */
+	unsigned long long buckets[AST_HISTOGRAM_BUCKETS + 1];
+	/*! Sum of all samples in microseconds */
+	unsigned long long sum;
+	/*! Value of the family's label */
+	char value[0];
+};
+
+struct histogram_family {
+	/*! Histograms of the family, sorted by label value */
+	struct ao2_container *histograms;
+	/*! Description of the family */
+	const char *help;
+	/*! Name of the label, NULL if there is none */
+	const char *label;
+	/*! Name of the family, followed by its help and label */
+	char name[0];
+};
+
+/*! \brief Every histogram family, sorted by name */
+static struct ao2_container *families;
+
+AO2_STRING_FIELD_SORT_FN(ast_histogram, value);
+AO2_STRING_FIELD_SORT_FN(histogram_family, name);
+
+/*!
+ * \internal
+ * \brief Find the bucket that holds a sample
+ *
+ * Bucket 0 holds samples up to 1, and each bucket after that holds the
+ * samples up to ast_histogram_bucket_bound() of it.  Two buckets cover
+ * every power of two, so the index comes from the position of the most
+ * significant bit of (sample - 1) and the bit below it.
+ */
+static int histogram_bucket(unsigned long long usec)
+{
+	unsigned long long x;
+	int msb;
+	int bucket;
+
+	if (usec <= 1) {
+		return 0;
+	}
+	x = usec - 1;
+	if (x == 1) {
+		return 1;
+	}
+
+	msb = 63 - __builtin_clzll(x);
+	bucket = 2 * msb + ((x >> (msb - 1)) & 1);
+
+	return MIN(bucket, AST_HISTOGRAM_BUCKETS);
+}
+
+unsigned long long ast_histogram_bucket_bound(int bucket)
+{
+	if (bucket <= 0) {
+		return 1;
+	}
+	if (bucket & 1) {
+		return 1ULL << ((bucket + 1) / 2);
+	}
+	return 3ULL << (bucket / 2 - 1);
+}
+
+void ast_histogram_record(struct ast_histogram *histogram, int64_t usec)
+{
+	unsigned long long sample = usec > 0 ? usec : 0;
+
+	if (!histogram) {
+		return;
+	}
+
+	ast_atomic_fetch_add(&histogram->buckets[histogram_bucket(sample)], 1, __ATOMIC_RELAXED);
+	ast_atomic_fetch_add(&histogram->sum, sample, __ATOMIC_RELAXED);
+}
+
+static void histogram_family_dtor(void *obj)
+{
+	struct histogram_family *family = obj;
+
+	ao2_cleanup(family->histograms);
+}
+
+/*! \internal \brief Find or create a family, families must be locked */
+static struct histogram_family *histogram_family_get(const char *name, const char *help,
+	const char *label)
+{
+	struct histogram_family *family;
+	size_t name_len = strlen(name) + 1;
+	size_t help_len = strlen(S_OR(help, "")) + 1;
+	char *pos;
+
+	family = ao2_find(families, name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (family) {
+		return family;
+	}
+
+	family = ao2_alloc_options(sizeof(*family) + name_len + help_len
+		+ (label ? strlen(label) + 1 : 0), histogram_family_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!family) {
+		return NULL;
+	}
+
+	pos = family->name;
+	strcpy(pos, name); /* Safe */
+	pos += name_len;
+	family->help = pos;
+	strcpy(pos, S_OR(help, "")); /* Safe */
+	pos += help_len;
+	if (label) {
+		family->label = pos;
+		strcpy(pos, label); /* Safe */
+	}
+
+	family->histograms = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_NOLOCK, 0,
+		ast_histogram_sort_fn, NULL);
+	if (!family->histograms || !ao2_link_flags(families, family, OBJ_NOLOCK)) {
+		ao2_ref(family, -1);
+		return NULL;
+	}
+
+	return family;
+}
+
+struct ast_histogram *ast_histogram_get(const char *name, const char *help,
+	const char *label, const char *value)
+{
+	struct histogram_family *family;
+	struct ast_histogram *histogram = NULL;
+
+	if (!families || ast_strlen_zero(name)) {
+		return NULL;
+	}
+	value = label ? S_OR(value, "") : "";
+
+	ao2_lock(families);
+	family = histogram_family_get(name, help, label);
+	if (family) {
+		histogram = ao2_find(family->histograms, value, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+		if (!histogram) {
+			histogram = ao2_alloc_options(sizeof(*histogram) + strlen(value) + 1, NULL,
+				AO2_ALLOC_OPT_LOCK_NOLOCK);
+			if (histogram) {
+				strcpy(histogram->value, value); /* Safe */
+				if (!ao2_link_flags(family->histograms, histogram, OBJ_NOLOCK)) {
+					ao2_ref(histogram, -1);
+					histogram = NULL;
+				}
+			}
+		}
+		ao2_ref(family, -1);
+	}
+	ao2_unlock(families);
+
+	return histogram;
+}
+
+void ast_histogram_foreach(ast_histogram_cb callback, void *data)
+{
+	struct ao2_iterator families_iter;
+	struct histogram_family *family;
+	struct ast_histogram_snapshot snapshot;
+
+	if (!families) {
+		return;
+	}
+
+	/* Families and their histograms are only ever added, with families locked */
+	ao2_lock(families);
+	families_iter = ao2_iterator_init(families, AO2_ITERATOR_DONTLOCK);
+	while ((family = ao2_iterator_next(&families_iter))) {
+		struct ao2_iterator iter;
+		struct ast_histogram *histogram;
+		int first = 1;
+
+		snapshot.name = family->name;
+		snapshot.help = family->help;
+		snapshot.label = family->label;
+
+		iter = ao2_iterator_init(family->histograms, AO2_ITERATOR_DONTLOCK);
+		while ((histogram = ao2_iterator_next(&iter))) {
+			int i;
+
+			snapshot.value = histogram->value;
+			snapshot.count = 0;
+			snapshot.sum = ast_atomic_fetch_add(&histogram->sum, 0, __ATOMIC_RELAXED);
+			for (i = 0; i <= AST_HISTOGRAM_BUCKETS; i++) {
+				snapshot.buckets[i] = ast_atomic_fetch_add(&histogram->buckets[i], 0, __ATOMIC_RELAXED);
+				snapshot.count += snapshot.buckets[i];
+			}
+
+			callback(&snapshot, first, data);
+			first = 0;
+			ao2_ref(histogram, -1);
+		}
+		ao2_iterator_destroy(&iter);
+		ao2_ref(family, -1);
+	}
+	ao2_iterator_destroy(&families_iter);
+	ao2_unlock(families);
+}
+
+static void histogram_shutdown(void)
+{
+	ao2_cleanup(families);
+	families = NULL;
+}
+
+int ast_histogram_init(void)
+{
+	families = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		histogram_family_sort_fn, NULL);
+	if (!families) {
+		return -1;
+	}
+
+	ast_register_cleanup(histogram_shutdown);
+
+	return 0;
+}
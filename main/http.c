@@ -49,6 +49,9 @@
 #include <sys/stat.h>
 #include <signal.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include "asterisk/paths.h"	/* use ast_config_AST_DATA_DIR */
 #include "asterisk/cli.h"
@@ -64,6 +67,8 @@
 #include "asterisk/astobj2.h"
 #include "asterisk/netsock2.h"
 #include "asterisk/json.h"
+#include "asterisk/threadpool.h"
+#include "asterisk/lock.h"
 
 #define MAX_PREFIX 80
 #define DEFAULT_PORT 8088
@@ -75,6 +80,10 @@
 #define MIN_INITIAL_REQUEST_TIMEOUT	10000
 /*! (ms) Idle time between HTTP requests */
 #define DEFAULT_SESSION_KEEP_ALIVE 15000
+/*! Default number of threads serving requests on idle persistent connections */
+#define DEFAULT_REQUEST_THREADS 8
+/*! (s) Idle time before a request thread above the initial pool size exits */
+#define REQUEST_THREAD_IDLE_TIMEOUT 60
 /*! Max size for the http server name */
 #define	MAX_SERVER_NAME_LENGTH 128
 /*! Max size for the http response header */
@@ -107,6 +116,7 @@ static int session_limit = DEFAULT_SESSION_LIMIT;
 static int session_inactivity = DEFAULT_SESSION_INACTIVITY;
 static int session_keep_alive = DEFAULT_SESSION_KEEP_ALIVE;
 static int session_count = 0;
+static int request_threads = DEFAULT_REQUEST_THREADS;
 
 static struct ast_tls_config http_tls_cfg;
 
@@ -445,6 +455,42 @@ enum http_private_flags {
 	HTTP_FLAG_CLOSE_ON_COMPLETION = (1 << 2),
 };
 
+/*!
+ * \brief A persistent connection waiting for its next request
+ *
+ * Between requests a keep-alive connection holds no thread.  Its fd is
+ * watched by the poller and the next request is served by a thread from
+ * the request pool.
+ */
+struct http_parked_session {
+	/*! The connection, this holds the reference the serving thread had */
+	struct ast_tcptls_session_instance *ser;
+	/*! When the keep-alive timeout expires and the connection gets closed */
+	struct timeval expires;
+	AST_LIST_ENTRY(http_parked_session) list;
+};
+
+/*! \brief Watches parked keep-alive connections and hands them to the request pool */
+static struct {
+	/*! Protects everything below */
+	ast_mutex_t lock;
+	/*! Connections waiting for their next request */
+	AST_LIST_HEAD_NOLOCK(, http_parked_session) parked;
+	/*! Number of connections parked */
+	int count;
+	/*! Threads serving the requests */
+	struct ast_threadpool *pool;
+	/*! epoll instance with the parked fds, -1 if not running */
+	int epfd;
+	/*! Set to make the poller thread exit */
+	int stop;
+	pthread_t thread;
+} http_poller = {
+	.lock = AST_MUTEX_INIT_VALUE,
+	.epfd = -1,
+	.thread = AST_PTHREADT_NULL,
+};
+
 /*! HTTP tcptls worker_fn private data. */
 struct http_worker_private_data {
 	/*! Body length or -1 if chunked.  Valid if HTTP_FLAG_HAS_BODY is TRUE. */
@@ -1934,6 +1980,267 @@ static int httpd_process_request(struct ast_tcptls_session_instance *ser)
 	return res;
 }
 
+/*!
+ * \internal
+ * \brief Close a connection and give up the serving thread's reference to it
+ */
+static void httpd_session_done(struct ast_tcptls_session_instance *ser)
+{
+	ast_atomic_fetchadd_int(&session_count, -1);
+
+	ast_debug(1, "HTTP closing session.  Top level\n");
+	ast_tcptls_close_session_file(ser);
+
+	ao2_ref(ser, -1);
+}
+
+#ifdef __linux__
+/*!
+ * \internal
+ * \brief Hand an idle persistent connection to the poller
+ *
+ * \retval 0 the poller owns the connection and the reference to it
+ * \retval -1 the connection could not be parked, the caller keeps it
+ */
+static int httpd_session_park(struct ast_tcptls_session_instance *ser)
+{
+	struct http_parked_session *parked;
+	struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, };
+	int res = -1;
+
+	parked = ast_calloc(1, sizeof(*parked));
+	if (!parked) {
+		return -1;
+	}
+	parked->ser = ser;
+	parked->expires = ast_tvadd(ast_tvnow(), ast_samp2tv(session_keep_alive, 1000));
+	event.data.ptr = parked;
+
+	ast_mutex_lock(&http_poller.lock);
+	if (http_poller.epfd >= 0 && !http_poller.stop
+		&& !epoll_ctl(http_poller.epfd, EPOLL_CTL_ADD, ast_iostream_get_fd(ser->stream), &event)) {
+		AST_LIST_INSERT_TAIL(&http_poller.parked, parked, list);
+		++http_poller.count;
+		res = 0;
+	}
+	ast_mutex_unlock(&http_poller.lock);
+
+	if (res) {
+		ast_free(parked);
+	} else {
+		ast_debug(3, "HTTP session %p parked until its next request\n", ser);
+	}
+	return res;
+}
+#else
+static int httpd_session_park(struct ast_tcptls_session_instance *ser)
+{
+	return -1;
+}
+#endif
+
+/*!
+ * \internal
+ * \brief Serve requests on a connection until it closes, is taken over or idles
+ *
+ * \param ser The connection, the caller's reference is consumed
+ * \param timeout (ms) How long to wait for the first request
+ */
+static void httpd_serve_session(struct ast_tcptls_session_instance *ser, int timeout)
+{
+	for (;;) {
+		/* Wait for next potential HTTP request message. */
+		ast_iostream_set_timeout_idle_inactivity(ser->stream, timeout, session_inactivity);
+		if (httpd_process_request(ser)) {
+			/* Break the connection or the connection closed */
+			break;
+		}
+		if (!ser->stream) {
+			/* Web-socket or similar that took the connection */
+			break;
+		}
+
+		timeout = session_keep_alive;
+		if (timeout <= 0) {
+			/* Persistent connections not enabled. */
+			break;
+		}
+
+		/*
+		 * Pipelined requests already read are served right away, otherwise
+		 * the thread is released until the client sends something.
+		 */
+		if (request_threads > 0 && !ast_iostream_has_buffered_input(ser->stream)
+			&& !httpd_session_park(ser)) {
+			return;
+		}
+	}
+
+	httpd_session_done(ser);
+}
+
+/*!
+ * \internal
+ * \brief Request pool task serving a parked connection that became readable
+ */
+static int httpd_parked_session_task(void *data)
+{
+	httpd_serve_session(data, session_keep_alive);
+	return 0;
+}
+
+#ifdef __linux__
+static void *http_poller_thread(void *data)
+{
+	struct epoll_event events[64];
+	AST_LIST_HEAD_NOLOCK(, http_parked_session) ready;
+	AST_LIST_HEAD_NOLOCK(, http_parked_session) expired;
+	struct http_parked_session *parked;
+	struct timeval now;
+	int count;
+	int i;
+
+	for (;;) {
+		count = epoll_wait(http_poller.epfd, events, ARRAY_LEN(events), 1000);
+		if (count < 0 && errno != EINTR) {
+			ast_log(LOG_ERROR, "HTTP poller epoll_wait failed: %s\n", strerror(errno));
+			break;
+		}
+
+		AST_LIST_HEAD_INIT_NOLOCK(&ready);
+		AST_LIST_HEAD_INIT_NOLOCK(&expired);
+		now = ast_tvnow();
+
+		ast_mutex_lock(&http_poller.lock);
+		if (http_poller.stop) {
+			ast_mutex_unlock(&http_poller.lock);
+			break;
+		}
+		for (i = 0; i < count; ++i) {
+			parked = events[i].data.ptr;
+			epoll_ctl(http_poller.epfd, EPOLL_CTL_DEL, ast_iostream_get_fd(parked->ser->stream), NULL);
+			AST_LIST_REMOVE(&http_poller.parked, parked, list);
+			--http_poller.count;
+			AST_LIST_INSERT_TAIL(&ready, parked, list);
+		}
+		/* Parked in order, so expired connections are at the head of the list */
+		while ((parked = AST_LIST_FIRST(&http_poller.parked))
+			&& ast_tvcmp(parked->expires, now) <= 0) {
+			epoll_ctl(http_poller.epfd, EPOLL_CTL_DEL, ast_iostream_get_fd(parked->ser->stream), NULL);
+			AST_LIST_REMOVE_HEAD(&http_poller.parked, list);
+			--http_poller.count;
+			AST_LIST_INSERT_TAIL(&expired, parked, list);
+		}
+		ast_mutex_unlock(&http_poller.lock);
+
+		while ((parked = AST_LIST_REMOVE_HEAD(&ready, list))) {
+			if (ast_threadpool_push(http_poller.pool, httpd_parked_session_task, parked->ser)) {
+				httpd_session_done(parked->ser);
+			}
+			ast_free(parked);
+		}
+		while ((parked = AST_LIST_REMOVE_HEAD(&expired, list))) {
+			ast_debug(3, "HTTP session %p keep-alive timeout expired\n", parked->ser);
+			httpd_session_done(parked->ser);
+			ast_free(parked);
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Start the poller and its request pool or resize a running pool
+ */
+static int http_poller_start(int size)
+{
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = REQUEST_THREAD_IDLE_TIMEOUT,
+		.auto_increment = 1,
+		.initial_size = size,
+		/* Web-sockets keep their thread, so the pool must be able to grow */
+		.max_size = 0,
+	};
+
+	if (http_poller.pool) {
+		ast_threadpool_set_size(http_poller.pool, size);
+		return 0;
+	}
+
+	http_poller.pool = ast_threadpool_create("http", NULL, &options);
+	if (!http_poller.pool) {
+		return -1;
+	}
+
+	http_poller.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (http_poller.epfd < 0) {
+		ast_log(LOG_ERROR, "Unable to create HTTP poller: %s\n", strerror(errno));
+		goto failure;
+	}
+
+	http_poller.stop = 0;
+	if (ast_pthread_create_background(&http_poller.thread, NULL, http_poller_thread, NULL)) {
+		ast_log(LOG_ERROR, "Unable to start HTTP poller thread\n");
+		goto failure;
+	}
+
+	return 0;
+
+failure:
+	if (http_poller.epfd >= 0) {
+		close(http_poller.epfd);
+		http_poller.epfd = -1;
+	}
+	ast_threadpool_shutdown(http_poller.pool);
+	http_poller.pool = NULL;
+	return -1;
+}
+
+/*!
+ * \internal
+ * \brief Stop the poller, closing all parked connections
+ */
+static void http_poller_stop(void)
+{
+	struct http_parked_session *parked;
+
+	if (http_poller.thread == AST_PTHREADT_NULL) {
+		return;
+	}
+
+	ast_mutex_lock(&http_poller.lock);
+	http_poller.stop = 1;
+	ast_mutex_unlock(&http_poller.lock);
+	pthread_join(http_poller.thread, NULL);
+	http_poller.thread = AST_PTHREADT_NULL;
+
+	ast_mutex_lock(&http_poller.lock);
+	while ((parked = AST_LIST_REMOVE_HEAD(&http_poller.parked, list))) {
+		httpd_session_done(parked->ser);
+		ast_free(parked);
+	}
+	http_poller.count = 0;
+	close(http_poller.epfd);
+	http_poller.epfd = -1;
+	ast_mutex_unlock(&http_poller.lock);
+
+	ast_threadpool_shutdown(http_poller.pool);
+	http_poller.pool = NULL;
+}
+#else
+/* Without epoll connections are never parked and keep their own thread */
+static int http_poller_start(int size)
+{
+	return 0;
+}
+
+static void http_poller_stop(void)
+{
+}
+#endif
+
 static void *httpd_helper_thread(void *data)
 {
 	struct ast_tcptls_session_instance *ser = data;
@@ -1985,32 +2292,11 @@ static void *httpd_helper_thread(void *data)
 	/* We can let the stream wait for data to arrive. */
 	ast_iostream_set_exclusive_input(ser->stream, 1);
 
-	for (;;) {
-		/* Wait for next potential HTTP request message. */
-		ast_iostream_set_timeout_idle_inactivity(ser->stream, timeout, session_inactivity);
-		if (httpd_process_request(ser)) {
-			/* Break the connection or the connection closed */
-			break;
-		}
-		if (!ser->stream) {
-			/* Web-socket or similar that took the connection */
-			break;
-		}
-
-		timeout = session_keep_alive;
-		if (timeout <= 0) {
-			/* Persistent connections not enabled. */
-			break;
-		}
-	}
+	httpd_serve_session(ser, timeout);
+	return NULL;
 
 done:
-	ast_atomic_fetchadd_int(&session_count, -1);
-
-	ast_debug(1, "HTTP closing session.  Top level\n");
-	ast_tcptls_close_session_file(ser);
-
-	ao2_ref(ser, -1);
+	httpd_session_done(ser);
 	return NULL;
 }
 
@@ -2089,6 +2375,7 @@ static int __ast_http_load(int reload)
 	RAII_VAR(struct ast_sockaddr *, addrs, NULL, ast_free);
 	int num_addrs = 0;
 	int http_tls_was_enabled = 0;
+	int new_request_threads = DEFAULT_REQUEST_THREADS;
 
 	cfg = ast_config_load2("http.conf", "http", config_flags);
 	if (!cfg || cfg == CONFIG_STATUS_FILEINVALID) {
@@ -2200,6 +2487,12 @@ static int __ast_http_load(int reload)
 				ast_log(LOG_WARNING, "Invalid %s '%s' at line %d of http.conf\n",
 					v->name, v->value, v->lineno);
 			}
+		} else if (!strcasecmp(v->name, "request_threads")) {
+			if (ast_parse_arg(v->value, PARSE_INT32 | PARSE_DEFAULT | PARSE_IN_RANGE,
+				&new_request_threads, DEFAULT_REQUEST_THREADS, 0, 1024)) {
+				ast_log(LOG_WARNING, "Invalid %s '%s' at line %d of http.conf\n",
+					v->name, v->value, v->lineno);
+			}
 		} else {
 			ast_log(LOG_WARNING, "Ignoring unknown option '%s' in http.conf\n", v->name);
 		}
@@ -2213,6 +2506,17 @@ static int __ast_http_load(int reload)
 
 	ast_copy_string(http_server_name, server_name, sizeof(http_server_name));
 
+	/*
+	 * A poller already running is kept when parking gets disabled so the
+	 * connections it holds are still served.
+	 */
+	if (new_request_threads > 0 && http_poller_start(new_request_threads)) {
+		ast_log(LOG_WARNING, "Unable to start the HTTP request threads, "
+			"persistent connections will each keep a thread\n");
+		new_request_threads = 0;
+	}
+	request_threads = new_request_threads;
+
 	if (num_addrs && enabled) {
 		int i;
 		for (i = 0; i < num_addrs; ++i) {
@@ -2298,6 +2602,14 @@ static char *handle_show_http(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 	ast_cli(a->fd, "HTTP Server Status:\n");
 	ast_cli(a->fd, "Prefix: %s\n", prefix);
 	ast_cli(a->fd, "Server: %s\n", http_server_name);
+	if (request_threads > 0) {
+		ast_mutex_lock(&http_poller.lock);
+		ast_cli(a->fd, "Request Threads: %d (%d idle connections parked)\n",
+			request_threads, http_poller.count);
+		ast_mutex_unlock(&http_poller.lock);
+	} else {
+		ast_cli(a->fd, "Request Threads: Disabled\n");
+	}
 	if (ast_sockaddr_isnull(&http_desc.old_address)) {
 		ast_cli(a->fd, "Server Disabled\n\n");
 	} else {
@@ -2349,6 +2661,7 @@ static int unload_module(void)
 	if (http_tls_cfg.enabled) {
 		ast_tcptls_server_stop(&https_desc);
 	}
+	http_poller_stop();
 	ast_free(http_tls_cfg.certfile);
 	ast_free(http_tls_cfg.capath);
 	ast_free(http_tls_cfg.pvtfile);
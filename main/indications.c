@@ -240,6 +240,7 @@ static struct ast_generator playtones = {
 	.alloc     = playtones_alloc,
 	.release   = playtones_release,
 	.generate  = playtones_generator,
+	.shareable = 1,
 };
 
 int ast_tone_zone_part_parse(const char *s, struct ast_tone_zone_part *tone_data)
@@ -100,6 +100,19 @@ int ast_iostream_wait_for_input(struct ast_iostream *stream, int timeout)
 	return ast_wait_for_input(stream->fd, timeout);
 }
 
+int ast_iostream_has_buffered_input(struct ast_iostream *stream)
+{
+	if (stream->rbuflen) {
+		return 1;
+	}
+#if defined(DO_SSL)
+	if (stream->ssl && SSL_pending(stream->ssl)) {
+		return 1;
+	}
+#endif
+	return 0;
+}
+
 void ast_iostream_nonblock(struct ast_iostream *stream)
 {
 	ast_fd_set_flags(stream->fd, O_NONBLOCK);
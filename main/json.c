@@ -42,6 +42,7 @@
 #include "asterisk/callerid.h"
 
 #include <jansson.h>
+#include <math.h>
 #include <time.h>
 
 void *ast_json_malloc(size_t size)
@@ -501,6 +502,484 @@ int ast_json_dump_str_format(struct ast_json *root, struct ast_str **dst, enum a
 	return json_dump_callback((json_t *)root, write_to_ast_str, dst, dump_flags(format));
 }
 
+/*! \brief Growable buffer a MessagePack encoding is written to */
+struct msgpack_buf {
+	unsigned char *data;
+	size_t len;
+	size_t size;
+};
+
+static int msgpack_reserve(struct msgpack_buf *buf, size_t count)
+{
+	size_t size = buf->size ? buf->size : 256;
+	unsigned char *data;
+
+	if (buf->len + count <= buf->size) {
+		return 0;
+	}
+	while (size < buf->len + count) {
+		size *= 2;
+	}
+	data = ast_json_malloc(size);
+	if (!data) {
+		return -1;
+	}
+	if (buf->len) {
+		memcpy(data, buf->data, buf->len);
+	}
+	ast_json_free(buf->data);
+	buf->data = data;
+	buf->size = size;
+	return 0;
+}
+
+static void msgpack_put_be(struct msgpack_buf *buf, uint64_t value, int bytes)
+{
+	while (bytes--) {
+		buf->data[buf->len++] = value >> (8 * bytes);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Write a MessagePack string, array or map header in its smallest form
+ *
+ * \param fix Type byte of the fixed form, holding lengths below \a fix_max
+ * \param type8 Type byte of the 8 bit form, 0 if there is none
+ * \param type16 Type byte of the 16 bit form, the 32 bit form follows it
+ * \param length The length to write
+ */
+static int msgpack_put_header(struct msgpack_buf *buf, unsigned char fix, size_t fix_max,
+	unsigned char type8, unsigned char type16, size_t length)
+{
+	if (msgpack_reserve(buf, 5)) {
+		return -1;
+	}
+	if (length < fix_max) {
+		buf->data[buf->len++] = fix | length;
+	} else if (type8 && length <= UINT8_MAX) {
+		buf->data[buf->len++] = type8;
+		msgpack_put_be(buf, length, 1);
+	} else if (length <= UINT16_MAX) {
+		buf->data[buf->len++] = type16;
+		msgpack_put_be(buf, length, 2);
+	} else if (length <= UINT32_MAX) {
+		buf->data[buf->len++] = type16 + 1;
+		msgpack_put_be(buf, length, 4);
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+static int msgpack_put_string(struct msgpack_buf *buf, const char *str, size_t len)
+{
+	if (msgpack_put_header(buf, 0xa0, 32, 0xd9, 0xda, len)
+		|| msgpack_reserve(buf, len)) {
+		return -1;
+	}
+	memcpy(buf->data + buf->len, str, len);
+	buf->len += len;
+	return 0;
+}
+
+static int msgpack_put_integer(struct msgpack_buf *buf, json_int_t value)
+{
+	if (msgpack_reserve(buf, 9)) {
+		return -1;
+	}
+	if (value >= 0 && value < 128) {
+		/* positive fixint */
+		buf->data[buf->len++] = value;
+	} else if (value < 0 && value >= -32) {
+		/* negative fixint */
+		buf->data[buf->len++] = value & 0xff;
+	} else if (value > 0) {
+		if (value <= UINT8_MAX) {
+			buf->data[buf->len++] = 0xcc;
+			msgpack_put_be(buf, value, 1);
+		} else if (value <= UINT16_MAX) {
+			buf->data[buf->len++] = 0xcd;
+			msgpack_put_be(buf, value, 2);
+		} else if (value <= UINT32_MAX) {
+			buf->data[buf->len++] = 0xce;
+			msgpack_put_be(buf, value, 4);
+		} else {
+			buf->data[buf->len++] = 0xcf;
+			msgpack_put_be(buf, value, 8);
+		}
+	} else if (value >= INT8_MIN) {
+		buf->data[buf->len++] = 0xd0;
+		msgpack_put_be(buf, (uint64_t) value, 1);
+	} else if (value >= INT16_MIN) {
+		buf->data[buf->len++] = 0xd1;
+		msgpack_put_be(buf, (uint64_t) value, 2);
+	} else if (value >= INT32_MIN) {
+		buf->data[buf->len++] = 0xd2;
+		msgpack_put_be(buf, (uint64_t) value, 4);
+	} else {
+		buf->data[buf->len++] = 0xd3;
+		msgpack_put_be(buf, (uint64_t) value, 8);
+	}
+	return 0;
+}
+
+static int msgpack_put_value(struct msgpack_buf *buf, json_t *value)
+{
+	const char *key;
+	json_t *member;
+	size_t i;
+	union {
+		double real;
+		uint64_t bits;
+	} real;
+
+	switch (json_typeof(value)) {
+	case JSON_OBJECT:
+		if (msgpack_put_header(buf, 0x80, 16, 0, 0xde, json_object_size(value))) {
+			return -1;
+		}
+		json_object_foreach(value, key, member) {
+			if (msgpack_put_string(buf, key, strlen(key))
+				|| msgpack_put_value(buf, member)) {
+				return -1;
+			}
+		}
+		return 0;
+	case JSON_ARRAY:
+		if (msgpack_put_header(buf, 0x90, 16, 0, 0xdc, json_array_size(value))) {
+			return -1;
+		}
+		for (i = 0; i < json_array_size(value); ++i) {
+			if (msgpack_put_value(buf, json_array_get(value, i))) {
+				return -1;
+			}
+		}
+		return 0;
+	case JSON_STRING:
+		return msgpack_put_string(buf, json_string_value(value), json_string_length(value));
+	case JSON_INTEGER:
+		return msgpack_put_integer(buf, json_integer_value(value));
+	case JSON_REAL:
+		if (msgpack_reserve(buf, 9)) {
+			return -1;
+		}
+		real.real = json_real_value(value);
+		buf->data[buf->len++] = 0xcb;
+		msgpack_put_be(buf, real.bits, 8);
+		return 0;
+	case JSON_TRUE:
+	case JSON_FALSE:
+	case JSON_NULL:
+		if (msgpack_reserve(buf, 1)) {
+			return -1;
+		}
+		buf->data[buf->len++] = json_is_true(value) ? 0xc3 :
+			json_is_false(value) ? 0xc2 : 0xc0;
+		return 0;
+	}
+
+	return -1;
+}
+
+char *ast_json_dump_msgpack(struct ast_json *root, size_t *len)
+{
+	struct msgpack_buf buf = { NULL, };
+
+	if (!root || msgpack_put_value(&buf, (json_t *)root)) {
+		ast_json_free(buf.data);
+		return NULL;
+	}
+
+	*len = buf.len;
+	return (char *)buf.data;
+}
+
+void ast_json_writer_init(struct ast_json_writer *writer, struct ast_str **dst)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->dst = dst;
+}
+
+int ast_json_writer_finish(struct ast_json_writer *writer)
+{
+	/* Bit 0 is set once the top level value has been written */
+	if (writer->error || writer->depth || writer->after_key || !(writer->has_member & 1)) {
+		return -1;
+	}
+	return 0;
+}
+
+static int writer_fail(struct ast_json_writer *writer)
+{
+	writer->error = 1;
+	return -1;
+}
+
+static int writer_append(struct ast_json_writer *writer, const char *buffer, size_t size)
+{
+	if (!writer->error && write_to_ast_str(buffer, size, writer->dst)) {
+		writer->error = 1;
+	}
+	return writer->error ? -1 : 0;
+}
+
+/*!
+ * \internal
+ * \brief Account for the value about to be written, writing the comma before it
+ *
+ * Bit \c depth of the member masks describes the innermost open object or
+ * array, bit 0 describes the top level which holds a single value.
+ */
+static int writer_value_start(struct ast_json_writer *writer)
+{
+	uint64_t bit = 1ULL << writer->depth;
+
+	if (writer->error) {
+		return -1;
+	}
+	if (writer->after_key) {
+		writer->after_key = 0;
+		return 0;
+	}
+	if (writer->is_object & bit) {
+		/* Object members need a key */
+		return writer_fail(writer);
+	}
+	if (writer->has_member & bit) {
+		if (!writer->depth) {
+			return writer_fail(writer);
+		}
+		if (writer_append(writer, ",", 1)) {
+			return -1;
+		}
+	}
+	writer->has_member |= bit;
+	return 0;
+}
+
+static int writer_put_string(struct ast_json_writer *writer, const char *value)
+{
+	const char *run = value;
+	const char *pos;
+	char escape[7];
+
+	if (!ast_json_utf8_check(value)) {
+		return writer_fail(writer);
+	}
+
+	writer_append(writer, "\"", 1);
+	for (pos = value; *pos; ++pos) {
+		unsigned char c = *pos;
+
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+
+		writer_append(writer, run, pos - run);
+		switch (c) {
+		case '"':
+		case '\\':
+			snprintf(escape, sizeof(escape), "\\%c", c);
+			break;
+		case '\b':
+			strcpy(escape, "\\b");
+			break;
+		case '\f':
+			strcpy(escape, "\\f");
+			break;
+		case '\n':
+			strcpy(escape, "\\n");
+			break;
+		case '\r':
+			strcpy(escape, "\\r");
+			break;
+		case '\t':
+			strcpy(escape, "\\t");
+			break;
+		default:
+			snprintf(escape, sizeof(escape), "\\u%04X", c);
+			break;
+		}
+		writer_append(writer, escape, strlen(escape));
+		run = pos + 1;
+	}
+	writer_append(writer, run, pos - run);
+
+	return writer_append(writer, "\"", 1);
+}
+
+static int writer_container_start(struct ast_json_writer *writer, int is_object)
+{
+	uint64_t bit;
+
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	if (writer->depth >= AST_JSON_WRITER_MAX_DEPTH) {
+		return writer_fail(writer);
+	}
+	if (writer_append(writer, is_object ? "{" : "[", 1)) {
+		return -1;
+	}
+
+	bit = 1ULL << ++writer->depth;
+	writer->has_member &= ~bit;
+	if (is_object) {
+		writer->is_object |= bit;
+	} else {
+		writer->is_object &= ~bit;
+	}
+	return 0;
+}
+
+static int writer_container_end(struct ast_json_writer *writer, int is_object)
+{
+	uint64_t bit = 1ULL << writer->depth;
+
+	if (writer->error) {
+		return -1;
+	}
+	if (!writer->depth || writer->after_key || !(writer->is_object & bit) != !is_object) {
+		return writer_fail(writer);
+	}
+
+	--writer->depth;
+	return writer_append(writer, is_object ? "}" : "]", 1);
+}
+
+int ast_json_writer_object_start(struct ast_json_writer *writer)
+{
+	return writer_container_start(writer, 1);
+}
+
+int ast_json_writer_object_end(struct ast_json_writer *writer)
+{
+	return writer_container_end(writer, 1);
+}
+
+int ast_json_writer_array_start(struct ast_json_writer *writer)
+{
+	return writer_container_start(writer, 0);
+}
+
+int ast_json_writer_array_end(struct ast_json_writer *writer)
+{
+	return writer_container_end(writer, 0);
+}
+
+int ast_json_writer_key(struct ast_json_writer *writer, const char *key)
+{
+	uint64_t bit = 1ULL << writer->depth;
+
+	if (writer->error) {
+		return -1;
+	}
+	if (!key || writer->after_key || !(writer->is_object & bit)) {
+		return writer_fail(writer);
+	}
+	if (writer->has_member & bit) {
+		writer_append(writer, ",", 1);
+	}
+	writer->has_member |= bit;
+
+	writer_put_string(writer, key);
+	writer->after_key = 1;
+	return writer_append(writer, ":", 1);
+}
+
+int ast_json_writer_string(struct ast_json_writer *writer, const char *value)
+{
+	if (!value) {
+		return ast_json_writer_null(writer);
+	}
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	return writer_put_string(writer, value);
+}
+
+int ast_json_writer_integer(struct ast_json_writer *writer, ast_json_int_t value)
+{
+	char buf[32];
+	int len;
+
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	len = snprintf(buf, sizeof(buf), "%" JSON_INTEGER_FORMAT, (json_int_t) value);
+	return writer_append(writer, buf, len);
+}
+
+int ast_json_writer_real(struct ast_json_writer *writer, double value)
+{
+	char buf[64];
+	char *pos;
+	int len;
+
+	if (!isfinite(value)) {
+		return writer_fail(writer);
+	}
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+
+	/* Same as jansson, including the ".0" that keeps the value a real */
+	len = snprintf(buf, sizeof(buf), "%.17g", value);
+	for (pos = buf; *pos; ++pos) {
+		if (*pos == ',') {
+			/* Locales using a decimal comma */
+			*pos = '.';
+		}
+	}
+	if (!strpbrk(buf, ".eE")) {
+		len += snprintf(buf + len, sizeof(buf) - len, ".0");
+	}
+	return writer_append(writer, buf, len);
+}
+
+int ast_json_writer_boolean(struct ast_json_writer *writer, int value)
+{
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	return value ? writer_append(writer, "true", 4) : writer_append(writer, "false", 5);
+}
+
+int ast_json_writer_null(struct ast_json_writer *writer)
+{
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	return writer_append(writer, "null", 4);
+}
+
+int ast_json_writer_timeval(struct ast_json_writer *writer, const struct timeval tv, const char *zone)
+{
+	char buf[AST_ISO8601_LEN];
+	struct ast_tm tm = {};
+
+	ast_localtime(&tv, &tm, zone);
+
+	ast_strftime(buf, sizeof(buf), AST_ISO8601_FORMAT, &tm);
+
+	return ast_json_writer_string(writer, buf);
+}
+
+int ast_json_writer_json(struct ast_json_writer *writer, struct ast_json *value)
+{
+	if (!value) {
+		return writer_fail(writer);
+	}
+	if (writer_value_start(writer)) {
+		return -1;
+	}
+	if (json_dump_callback((json_t *)value, write_to_ast_str, writer->dst,
+			JSON_COMPACT | JSON_ENCODE_ANY)) {
+		return writer_fail(writer);
+	}
+	return 0;
+}
 
 int ast_json_dump_file_format(struct ast_json *root, FILE *output, enum ast_json_encoding_format format)
 {
@@ -736,7 +1215,8 @@ struct ast_json_payload *ast_json_payload_create(struct ast_json *json)
 {
 	struct ast_json_payload *payload;
 
-	if (!(payload = ao2_alloc(sizeof(*payload), json_payload_destructor))) {
+	if (!(payload = ao2_alloc_options(sizeof(*payload), json_payload_destructor,
+		AO2_ALLOC_OPT_LOCK_NOLOCK))) {
 		return NULL;
 	}
 
@@ -49,6 +49,8 @@
 #include "asterisk/app.h"
 #include "asterisk/test.h"
 #include "asterisk/cli.h"
+#include "asterisk/threadpool.h"
+#include "asterisk/trace_ring.h"
 
 #include <dlfcn.h>
 
@@ -290,6 +292,16 @@ static __attribute__((format(printf, 1, 2))) void module_load_error(const char *
  */
 static int modules_loaded;
 
+/*!
+ * \brief Number of threads starting modules in parallel at startup.
+ *
+ * Zero starts every module from the loader thread one at a time.
+ */
+static int load_threads;
+
+/*! Modules configured to start from the loader thread when load_threads is set. */
+static struct ast_vector_string load_serial;
+
 struct ast_module {
 	const struct ast_module_info *info;
 	/*! Used to get module references into refs log */
@@ -315,6 +327,8 @@ struct ast_module {
 	 * to this list with a reference.
 	 */
 	struct module_vector reffed_deps;
+	/*! Time the load function took to run in microseconds. */
+	int64_t load_time;
 	struct {
 		/*! The module running and ready to accept requests. */
 		unsigned int running:1;
@@ -328,6 +342,10 @@ struct ast_module {
 		unsigned int required:1;
 		/*! This module is marked for preload. */
 		unsigned int preload:1;
+		/*! This module must be started by the loader thread. */
+		unsigned int serial:1;
+		/*! The serial flag already accounts for the dependencies of the module. */
+		unsigned int serialchecked:1;
 	} flags;
 	AST_DLLIST_ENTRY(ast_module) entry;
 	char resource[0];
@@ -978,6 +996,9 @@ static void logged_dlclose(const char *name, void *lib)
 		manual_mod_unreg(name);
 #endif
 	}
+
+	/* Trace records may point at strings that were in the module */
+	ast_trace_ring_clear();
 }
 
 #if defined(HAVE_RTLD_NOLOAD)
@@ -1675,19 +1696,30 @@ static unsigned int inspect_module(const struct ast_module *mod)
 	return 0;
 }
 
-static enum ast_module_load_result start_resource(struct ast_module *mod)
+/*!
+ * \internal
+ * \brief Check whether a module can be started.
+ *
+ * \param mod The module to start.
+ * \param res Result of starting the module when it must not be started.
+ *
+ * \retval 0 The load function of the module should be run.
+ * \retval -1 The module is not to be started, see \a res.
+ *
+ * \note module_list must be locked.
+ */
+static int start_resource_prepare(struct ast_module *mod, enum ast_module_load_result *res)
 {
-	char tmp[256];
-	enum ast_module_load_result res;
-
 	if (mod->flags.running) {
-		return AST_MODULE_LOAD_SUCCESS;
+		*res = AST_MODULE_LOAD_SUCCESS;
+		return -1;
 	}
 
 	if (!mod->info->load) {
 		mod->flags.declined = 1;
 
-		return mod->flags.required ? AST_MODULE_LOAD_FAILURE : AST_MODULE_LOAD_DECLINE;
+		*res = mod->flags.required ? AST_MODULE_LOAD_FAILURE : AST_MODULE_LOAD_DECLINE;
+		return -1;
 	}
 
 	if (module_deps_reference(mod, NULL)) {
@@ -1704,13 +1736,44 @@ static enum ast_module_load_result start_resource(struct ast_module *mod)
 		}
 		AST_VECTOR_FREE(&missing);
 
-		return AST_MODULE_LOAD_DECLINE;
+		*res = AST_MODULE_LOAD_DECLINE;
+		return -1;
 	}
 
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Run the load function of a module and time it.
+ *
+ * \note This is the only part of starting a module that may run
+ * without module_list locked.
+ */
+static enum ast_module_load_result start_resource_run(struct ast_module *mod)
+{
+	struct timeval start;
+	enum ast_module_load_result res;
+
 	if (!ast_fully_booted) {
 		ast_verb(1, "Loading %s.\n", mod->resource);
 	}
+	start = ast_tvnow();
 	res = mod->info->load();
+	mod->load_time = ast_tvdiff_us(ast_tvnow(), start);
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Record the result of running the load function of a module.
+ *
+ * \note module_list must be locked.
+ */
+static enum ast_module_load_result start_resource_finish(struct ast_module *mod, enum ast_module_load_result res)
+{
+	char tmp[256];
 
 	switch (res) {
 	case AST_MODULE_LOAD_SUCCESS:
@@ -1751,6 +1814,17 @@ static enum ast_module_load_result start_resource(struct ast_module *mod)
 	return res;
 }
 
+static enum ast_module_load_result start_resource(struct ast_module *mod)
+{
+	enum ast_module_load_result res;
+
+	if (start_resource_prepare(mod, &res)) {
+		return res;
+	}
+
+	return start_resource_finish(mod, start_resource_run(mod));
+}
+
 /*! loads a resource based upon resource_name. If global_symbols_only is set
  *  only modules with global symbols will be loaded.
  *
@@ -1966,14 +2040,29 @@ static int resource_list_recursive_decline(struct module_vector *resources, stru
 	return res;
 }
 
-static int start_resource_list(struct module_vector *resources, int *mod_count)
+/*!
+ * \internal
+ * \brief Start modules one at a time in priority order.
+ *
+ * \param resources Modules to start, sorted by module_vector_cmp().
+ * \param mod_count Incremented for each started module.
+ * \param tier If not NULL only start the leading modules that share the
+ *        load priority of this module.
+ *
+ * \retval 0 All modules started.
+ * \retval -1 Some modules declined to start.
+ * \retval -2 A required module failed to start.
+ */
+static int start_resource_list(struct module_vector *resources, int *mod_count,
+	struct ast_module *tier)
 {
 	struct module_vector missingdeps;
 	int res = 0;
 	struct ast_str *printmissing = NULL;
 
 	AST_VECTOR_INIT(&missingdeps, 0);
-	while (res != -2 && AST_VECTOR_SIZE(resources)) {
+	while (res != -2 && AST_VECTOR_SIZE(resources)
+		&& (!tier || !module_vector_cmp(AST_VECTOR_GET(resources, 0), tier))) {
 		struct ast_module *mod = AST_VECTOR_REMOVE(resources, 0, 1);
 		enum ast_module_load_result lres;
 
@@ -2095,6 +2184,259 @@ exitpoint:
 	return res;
 }
 
+/*! \brief State shared by the loader thread and the module start threads. */
+struct module_loader {
+	/*! Threads running the load functions. */
+	struct ast_threadpool *pool;
+	/*! Signalled with module_list locked when a load function returns. */
+	ast_cond_t cond;
+	/*! Modules whose load function returned. */
+	AST_LIST_HEAD_NOLOCK(, module_load_job) done;
+	/*! Number of load functions that have not returned yet. */
+	int inflight;
+};
+
+/*! \brief A module started by a module start thread. */
+struct module_load_job {
+	struct module_loader *loader;
+	struct ast_module *mod;
+	/*! Result of the module load function. */
+	enum ast_module_load_result res;
+	AST_LIST_ENTRY(module_load_job) entry;
+};
+
+static int start_resource_task(void *data)
+{
+	struct module_load_job *job = data;
+
+	job->res = start_resource_run(job->mod);
+
+	AST_DLLIST_LOCK(&module_list);
+	AST_LIST_INSERT_TAIL(&job->loader->done, job, entry);
+	ast_cond_signal(&job->loader->cond);
+	AST_DLLIST_UNLOCK(&module_list);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Check if a module has to be started from the loader thread.
+ *
+ * \details
+ * Modules configured with loadserial and every module that requires one
+ * of them, directly or not, are started by start_resource_list().
+ *
+ * \note module_list must be locked.
+ */
+static int module_load_serial(struct ast_module *mod, int depth)
+{
+	struct ast_vector_string *lists[] = { &mod->requires, &mod->optional_modules };
+	int i;
+	int idx;
+
+	if (mod->flags.serialchecked) {
+		return mod->flags.serial;
+	}
+
+	if (!mod->flags.serial) {
+		for (idx = 0; idx < AST_VECTOR_SIZE(&load_serial); idx++) {
+			const char *name = AST_VECTOR_GET(&load_serial, idx);
+
+			if (!resource_name_match(name, resource_name_baselen(name), mod->resource)) {
+				mod->flags.serial = 1;
+				break;
+			}
+		}
+	}
+
+	/* Dependency loops fail to start anyway, do not recurse forever on them. */
+	for (i = 0; !mod->flags.serial && depth < 16 && i < ARRAY_LEN(lists); i++) {
+		for (idx = 0; idx < AST_VECTOR_SIZE(lists[i]); idx++) {
+			struct ast_module *dep = find_resource(AST_VECTOR_GET(lists[i], idx), 0);
+
+			if (dep && module_load_serial(dep, depth + 1)) {
+				mod->flags.serial = 1;
+				break;
+			}
+		}
+	}
+	mod->flags.serialchecked = 1;
+
+	return mod->flags.serial;
+}
+
+/*!
+ * \internal
+ * \brief Account for a module started from start_resource_tier().
+ *
+ * \return The new result of the module list, see start_resource_list().
+ */
+static int start_resource_tier_result(struct module_vector *resources, struct ast_module *mod,
+	enum ast_module_load_result lres, int *mod_count, struct ast_str **printmissing, int res)
+{
+	ast_debug(3, "START: %-46s[%d] %d\n",
+		mod->resource,
+		ast_test_flag(mod->info, AST_MODFLAG_LOAD_ORDER) ? mod->info->load_pri : AST_MODPRI_DEFAULT,
+		lres);
+
+	switch (lres) {
+	case AST_MODULE_LOAD_SUCCESS:
+		(*mod_count)++;
+		return res;
+	case AST_MODULE_LOAD_FAILURE:
+		module_load_error("*** Failed to load %smodule %s\n",
+			mod->flags.required ? "required " : "",
+			mod->resource);
+		return -2;
+	case AST_MODULE_LOAD_DECLINE:
+		break;
+	case AST_MODULE_LOAD_SKIP:
+	case AST_MODULE_LOAD_PRIORITY:
+		module_load_error("%s load function returned an invalid result. "
+			"This is a bug in the module.\n", ast_module_name(mod));
+		break;
+	}
+
+	return resource_list_recursive_decline(resources, mod, printmissing);
+}
+
+/*!
+ * \internal
+ * \brief Start the modules of a load priority whose dependencies are running.
+ *
+ * \details
+ * Every module of the tier whose dependencies are running is handed to
+ * the module start threads.  Each time one of them finishes the tier is
+ * scanned again for modules it unblocked.  Modules still left in the tier
+ * once nothing is running are waiting on something outside of the tier
+ * and are left in \a resources for start_resource_list().
+ *
+ * \note module_list must be locked exactly once by the caller.  It is
+ * released while waiting for the load functions.
+ *
+ * \return The result of the module list, see start_resource_list().
+ */
+static int start_resource_tier(struct module_loader *loader, struct module_vector *resources,
+	struct ast_module *tier, int *mod_count, struct ast_str **printmissing)
+{
+	struct module_load_job *job;
+	enum ast_module_load_result lres;
+	int res = 0;
+	int i;
+
+	for (;;) {
+		i = 0;
+		while (res != -2 && i < AST_VECTOR_SIZE(resources)) {
+			struct ast_module *mod = AST_VECTOR_GET(resources, i);
+
+			if (module_vector_cmp(mod, tier)) {
+				break;
+			}
+
+			if (mod->flags.declined) {
+				ast_debug(1, "%s is already declined, skipping\n", ast_module_name(mod));
+				AST_VECTOR_REMOVE_ORDERED(resources, i);
+				continue;
+			}
+
+			if (mod->flags.builtin || mod->flags.preload || module_load_serial(mod, 0)
+				|| module_deps_reference(mod, NULL)) {
+				/* Started by start_resource_list() or once its dependencies are running. */
+				i++;
+				continue;
+			}
+
+			AST_VECTOR_REMOVE_ORDERED(resources, i);
+			if (start_resource_prepare(mod, &lres)) {
+				res = start_resource_tier_result(resources, mod, lres, mod_count, printmissing, res);
+				continue;
+			}
+
+			job = ast_calloc(1, sizeof(*job));
+			if (job) {
+				job->loader = loader;
+				job->mod = mod;
+			}
+			if (!job || ast_threadpool_push(loader->pool, start_resource_task, job)) {
+				ast_free(job);
+				lres = start_resource_finish(mod, start_resource_run(mod));
+				res = start_resource_tier_result(resources, mod, lres, mod_count, printmissing, res);
+				continue;
+			}
+			loader->inflight++;
+		}
+
+		if (!loader->inflight) {
+			break;
+		}
+
+		while (!(job = AST_LIST_REMOVE_HEAD(&loader->done, entry))) {
+			ast_cond_wait(&loader->cond, &module_list.lock);
+		}
+		loader->inflight--;
+
+		lres = start_resource_finish(job->mod, job->res);
+		res = start_resource_tier_result(resources, job->mod, lres, mod_count, printmissing, res);
+		ast_free(job);
+	}
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Start modules in priority order using the module start threads.
+ *
+ * \details
+ * Load priorities are still honored, a module is not started before all
+ * modules of an earlier priority finished starting.  Within a priority
+ * modules are started as soon as their dependencies are running.
+ *
+ * \return See start_resource_list().
+ */
+static int start_resource_list_parallel(struct module_vector *resources, int *mod_count)
+{
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 0,
+		.auto_increment = 0,
+		.initial_size = load_threads,
+		.max_size = load_threads,
+	};
+	struct module_loader loader = { .inflight = 0, };
+	struct ast_str *printmissing = NULL;
+	int res = 0;
+
+	loader.pool = ast_threadpool_create("module_loader", NULL, &options);
+	if (!loader.pool) {
+		ast_log(LOG_WARNING, "Unable to create module start threads, starting modules one at a time.\n");
+
+		return start_resource_list(resources, mod_count, NULL);
+	}
+	ast_cond_init(&loader.cond, NULL);
+
+	while (res != -2 && AST_VECTOR_SIZE(resources)) {
+		struct ast_module *tier = AST_VECTOR_GET(resources, 0);
+		int tier_res;
+
+		tier_res = start_resource_tier(&loader, resources, tier, mod_count, &printmissing);
+		if (tier_res != -2) {
+			/* Whatever is left of the tier is started one at a time. */
+			int list_res = start_resource_list(resources, mod_count, tier);
+
+			tier_res = MIN(tier_res, list_res);
+		}
+		res = MIN(res, tier_res);
+	}
+
+	ast_threadpool_shutdown(loader.pool);
+	ast_cond_destroy(&loader.cond);
+	ast_free(printmissing);
+
+	return res;
+}
+
 /*! loads modules in order by load_pri, updates mod_count
 	\return -1 on failure to load module, -2 on failure to load required module, otherwise 0
 */
@@ -2165,7 +2507,9 @@ static int load_resource_list(struct load_order *load_order, int *mod_count)
 	}
 
 	if (res != -2) {
-		res = start_resource_list(&module_priorities, &count);
+		res = load_threads
+			? start_resource_list_parallel(&module_priorities, &count)
+			: start_resource_list(&module_priorities, &count, NULL);
 	}
 
 	if (mod_count) {
@@ -2247,6 +2591,21 @@ static int loader_config_init(struct load_order *load_order)
 			required = 1;
 		} else if (!strcasecmp(v->name, "noload") || !strcasecmp(v->name, "autoload")) {
 			continue;
+		} else if (!strcasecmp(v->name, "loadthreads")) {
+			if (ast_parse_arg(v->value, PARSE_INT32 | PARSE_IN_RANGE, &load_threads, 0, 256)) {
+				ast_log(LOG_WARNING, "Invalid loadthreads value '%s', starting modules one at a time.\n",
+					v->value);
+				load_threads = 0;
+			}
+			continue;
+		} else if (!strcasecmp(v->name, "loadserial")) {
+			char *name = ast_strdup(v->value);
+
+			if (!name || AST_VECTOR_APPEND(&load_serial, name)) {
+				ast_free(name);
+				goto done;
+			}
+			continue;
 		} else {
 			ast_log(LOG_ERROR, "Unknown configuration option '%s'", v->name);
 			goto done;
@@ -2370,6 +2729,7 @@ int load_modules(void)
 
 	AST_VECTOR_INIT(&startup_errors, 0);
 	startup_error_builder = ast_str_create(64);
+	AST_VECTOR_INIT(&load_serial, 0);
 
 	res = loader_builtin_init(&load_order);
 	if (res) {
@@ -2510,6 +2870,9 @@ done:
 	}
 	AST_VECTOR_FREE(&startup_errors);
 
+	AST_VECTOR_RESET(&load_serial, ast_free);
+	AST_VECTOR_FREE(&load_serial);
+
 	ast_free(startup_error_builder);
 	startup_error_builder = NULL;
 
@@ -2649,6 +3012,25 @@ int ast_update_module_list_condition(int (*modentry)(const char *module, const c
 	return conditions_met;
 }
 
+int64_t ast_module_load_time(const char *name)
+{
+	struct ast_module *cur;
+	int64_t load_time = -1;
+
+	if (ast_strlen_zero(name)) {
+		return -1;
+	}
+
+	AST_DLLIST_LOCK(&module_list);
+	cur = find_resource(name, 0);
+	if (cur && cur->flags.running) {
+		load_time = cur->load_time;
+	}
+	AST_DLLIST_UNLOCK(&module_list);
+
+	return load_time;
+}
+
 /*! \brief Check if module exists */
 int ast_module_check(const char *name)
 {
@@ -53,6 +53,123 @@ static void __attribute__((constructor)) __mtx_init(void)
 #undef pthread_cond_wait
 #undef pthread_cond_timedwait
 
+/*! \brief Number of acquisition sites the contention profiler can tell apart */
+#define LOCK_CONTENTION_SITES 1024
+
+/*! \brief Slots probed for a site before its waits are dropped */
+#define LOCK_CONTENTION_PROBES 8
+
+enum lock_contention_kind {
+	LOCK_CONTENTION_MUTEX,
+	LOCK_CONTENTION_RDLOCK,
+	LOCK_CONTENTION_WRLOCK,
+};
+
+static const char *lock_contention_kinds[] = {
+	[LOCK_CONTENTION_MUTEX] = "mutex",
+	[LOCK_CONTENTION_RDLOCK] = "rdlock",
+	[LOCK_CONTENTION_WRLOCK] = "wrlock",
+};
+
+/*!
+ * \brief Waits for a lock at one acquisition site
+ *
+ * The file and function pointers identify the site.  They are copied for
+ * the report since they belong to a module that may be unloaded.
+ */
+struct lock_contention_site {
+	/*! Non-zero once the slot belongs to a site */
+	int used;
+	enum lock_contention_kind kind;
+	int lineno;
+	const char *file_key;
+	const char *func_key;
+	/*! Waits recorded */
+	unsigned long waits;
+	/*! Sum of the waits in microseconds */
+	unsigned long long total;
+	/*! Longest wait in microseconds */
+	unsigned long long max;
+	char file[64];
+	char func[64];
+	char name[64];
+};
+
+static struct lock_contention_site lock_contention_sites[LOCK_CONTENTION_SITES];
+
+/*! \brief Serializes claiming slots and clearing the table */
+static pthread_mutex_t lock_contention_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! \brief One in how many waits is recorded, 0 if the profiler is off */
+static unsigned int lock_contention_rate;
+
+/*! \brief Waits seen while the profiler is on, used for sampling */
+static unsigned int lock_contention_seen;
+
+/*! \brief Sampled waits not recorded because no slot was free */
+static unsigned long lock_contention_dropped;
+
+static void lock_contention_record(enum lock_contention_kind kind, const char *filename,
+	int lineno, const char *func, const char *name, int64_t wait)
+{
+	unsigned int hash = (unsigned int) (((uintptr_t) filename >> 3) ^ ((uintptr_t) func >> 3))
+		+ lineno * 31 + kind;
+	unsigned long long usec = wait > 0 ? wait : 0;
+	int probe;
+
+	for (probe = 0; probe < LOCK_CONTENTION_PROBES; probe++) {
+		struct lock_contention_site *site =
+			&lock_contention_sites[(hash + probe) % LOCK_CONTENTION_SITES];
+
+		if (!ast_atomic_fetch_add(&site->used, 0, __ATOMIC_ACQUIRE)) {
+			pthread_mutex_lock(&lock_contention_lock);
+			if (!site->used) {
+				site->kind = kind;
+				site->lineno = lineno;
+				site->file_key = filename;
+				site->func_key = func;
+				ast_copy_string(site->file, filename, sizeof(site->file));
+				ast_copy_string(site->func, func, sizeof(site->func));
+				ast_copy_string(site->name, name, sizeof(site->name));
+				ast_atomic_fetch_add(&site->used, 1, __ATOMIC_RELEASE);
+			}
+			pthread_mutex_unlock(&lock_contention_lock);
+		}
+
+		if (site->file_key == filename && site->func_key == func
+			&& site->lineno == lineno && site->kind == kind) {
+			ast_atomic_fetch_add(&site->waits, 1, __ATOMIC_RELAXED);
+			ast_atomic_fetch_add(&site->total, usec, __ATOMIC_RELAXED);
+			/* A racing update may lose a maximum, that is fine for a profile */
+			if (usec > site->max) {
+				site->max = usec;
+			}
+			return;
+		}
+	}
+
+	ast_atomic_fetch_add(&lock_contention_dropped, 1, __ATOMIC_RELAXED);
+}
+
+/*!
+ * \brief Wait for a lock that was found busy, timing the wait if it is sampled
+ *
+ * \note Evaluates to the result of \a lock_call.
+ */
+#define lock_contention_wait(kind, filename, lineno, func, name, lock_call) ({ \
+	int __res; \
+	if (ast_atomic_fetch_add(&lock_contention_seen, 1, __ATOMIC_RELAXED) % MAX(lock_contention_rate, 1) == 0) { \
+		struct timeval __start = ast_tvnow(); \
+		__res = (lock_call); \
+		if (!__res) { \
+			lock_contention_record(kind, filename, lineno, func, name, ast_tvdiff_us(ast_tvnow(), __start)); \
+		} \
+	} else { \
+		__res = (lock_call); \
+	} \
+	__res; \
+})
+
 #if defined(DEBUG_THREADS)
 #define log_mutex_error(canlog, ...) \
 	do { \
@@ -317,13 +434,21 @@ int __ast_pthread_mutex_lock(const char *filename, int lineno, const char *func,
 		} while (res == EBUSY);
 	}
 #else /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
+	if (lock_contention_rate) {
+		res = pthread_mutex_trylock(&t->mutex);
+		if (res == EBUSY) {
+			res = lock_contention_wait(LOCK_CONTENTION_MUTEX, filename, lineno, func, mutex_name,
+				pthread_mutex_lock(&t->mutex));
+		}
+	} else {
 #ifdef	HAVE_MTX_PROFILE
-	ast_mark(mtx_prof, 1);
-	res = pthread_mutex_trylock(&t->mutex);
-	ast_mark(mtx_prof, 0);
-	if (res)
+		ast_mark(mtx_prof, 1);
+		res = pthread_mutex_trylock(&t->mutex);
+		ast_mark(mtx_prof, 0);
+		if (res)
 #endif
-	res = pthread_mutex_lock(&t->mutex);
+		res = pthread_mutex_lock(&t->mutex);
+	}
 #endif /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
 
 #ifdef DEBUG_THREADS
@@ -876,7 +1001,15 @@ int __ast_rwlock_rdlock(const char *filename, int line, const char *func, ast_rw
 		} while (res == EBUSY);
 	}
 #else /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
-	res = pthread_rwlock_rdlock(&t->lock);
+	if (lock_contention_rate) {
+		res = pthread_rwlock_tryrdlock(&t->lock);
+		if (res == EBUSY) {
+			res = lock_contention_wait(LOCK_CONTENTION_RDLOCK, filename, line, func, name,
+				pthread_rwlock_rdlock(&t->lock));
+		}
+	} else {
+		res = pthread_rwlock_rdlock(&t->lock);
+	}
 #endif /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
 
 #ifdef DEBUG_THREADS
@@ -974,7 +1107,15 @@ int __ast_rwlock_wrlock(const char *filename, int line, const char *func, ast_rw
 		} while (res == EBUSY);
 	}
 #else /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
-	res = pthread_rwlock_wrlock(&t->lock);
+	if (lock_contention_rate) {
+		res = pthread_rwlock_trywrlock(&t->lock);
+		if (res == EBUSY) {
+			res = lock_contention_wait(LOCK_CONTENTION_WRLOCK, filename, line, func, name,
+				pthread_rwlock_wrlock(&t->lock));
+		}
+	} else {
+		res = pthread_rwlock_wrlock(&t->lock);
+	}
 #endif /* !DETECT_DEADLOCKS || !DEBUG_THREADS */
 
 #ifdef DEBUG_THREADS
@@ -1274,3 +1415,45 @@ int __ast_rwlock_trywrlock(const char *filename, int line, const char *func, ast
 
 	return res;
 }
+
+void ast_lock_contention_set(unsigned int rate)
+{
+	pthread_mutex_lock(&lock_contention_lock);
+	if (rate && !lock_contention_rate) {
+		memset(lock_contention_sites, 0, sizeof(lock_contention_sites));
+		lock_contention_dropped = 0;
+	}
+	lock_contention_rate = rate;
+	pthread_mutex_unlock(&lock_contention_lock);
+}
+
+unsigned int ast_lock_contention_get(void)
+{
+	return lock_contention_rate;
+}
+
+unsigned long ast_lock_contention_foreach(ast_lock_contention_cb callback, void *data)
+{
+	int i;
+
+	for (i = 0; i < LOCK_CONTENTION_SITES; i++) {
+		struct lock_contention_site *site = &lock_contention_sites[i];
+		struct ast_lock_contention contention;
+
+		if (!ast_atomic_fetch_add(&site->used, 0, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+
+		contention.file = site->file;
+		contention.line = site->lineno;
+		contention.func = site->func;
+		contention.lock_name = site->name;
+		contention.type = lock_contention_kinds[site->kind];
+		contention.waits = ast_atomic_fetch_add(&site->waits, 0, __ATOMIC_RELAXED);
+		contention.total = ast_atomic_fetch_add(&site->total, 0, __ATOMIC_RELAXED);
+		contention.max = site->max;
+		callback(&contention, data);
+	}
+
+	return ast_atomic_fetch_add(&lock_contention_dropped, 0, __ATOMIC_RELAXED);
+}
@@ -70,6 +70,7 @@
 #include "asterisk/ast_version.h"
 #include "asterisk/backtrace.h"
 #include "asterisk/json.h"
+#include "asterisk/uring.h"
 
 /*** DOCUMENTATION
  ***/
@@ -141,6 +142,8 @@ struct logchannel {
 	enum logtypes type;
 	/*! logfile logging file pointer */
 	FILE *fileptr;
+	/*! Appends the messages to fileptr */
+	struct ast_uring_writer *writer;
 	/*! Filename */
 	char filename[PATH_MAX];
 	/*! field for linking to list */
@@ -167,6 +170,8 @@ struct logmsg {
 	int line;
 	int lwp;
 	ast_callid callid;
+	/*! The callid as printed by every formatter, rendered once per message */
+	char call_identifier_str[13];
 	AST_DECLARE_STRING_FIELDS(
 		AST_STRING_FIELD(date);
 		AST_STRING_FIELD(file);
@@ -183,11 +188,28 @@ static void logmsg_free(struct logmsg *msg)
 	ast_free(msg);
 }
 
-static AST_LIST_HEAD_STATIC(logmsgs, logmsg);
+/*
+ * Messages waiting for the logger thread, newest first.  Logging threads
+ * push onto it without a lock and the logger thread takes the whole stack
+ * at once, so nothing but the logger thread ever removes an entry.
+ */
+static struct logmsg *logmsgs;
+/*! Protects sleeping on and signalling logcond */
+AST_MUTEX_DEFINE_STATIC(logmsgs_lock);
 static pthread_t logthread = AST_PTHREADT_NULL;
 static ast_cond_t logcond;
 static int close_logger_thread = 0;
 
+#if defined(HAVE_C_ATOMICS)
+#define logger_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define logger_atomic_cas(ptr, oldval, newval) \
+	__atomic_compare_exchange_n((ptr), &(oldval), (newval), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+#define logger_atomic_load(ptr) __sync_fetch_and_add((ptr), 0)
+#define logger_atomic_cas(ptr, oldval, newval) \
+	__sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#endif
+
 static FILE *qlog;
 
 /*! \brief Logging channels used in the Asterisk logging system
@@ -258,15 +280,8 @@ static int format_log_json(struct logchannel *channel, struct logmsg *msg, char
 {
 	struct ast_json *json;
 	char *str;
-	char call_identifier_str[13];
 	size_t json_str_len;
 
-	if (msg->callid) {
-		snprintf(call_identifier_str, sizeof(call_identifier_str), "[C-%08x]", msg->callid);
-	} else {
-		call_identifier_str[0] = '\0';
-	}
-
 	json = ast_json_pack("{s: s, s: s, "
 		"s: {s: i, s: s} "
 		"s: {s: {s: s, s: s, s: i}, "
@@ -275,7 +290,7 @@ static int format_log_json(struct logchannel *channel, struct logmsg *msg, char
 		"timestamp", msg->date,
 		"identifiers",
 		"lwp", msg->lwp,
-		"callid", S_OR(call_identifier_str, ""),
+		"callid", msg->call_identifier_str,
 		"logmsg",
 		"location",
 		"filename", msg->file,
@@ -362,24 +377,16 @@ static int logger_add_verbose_magic(struct logmsg *logmsg, char *buf, size_t siz
 
 static int format_log_default(struct logchannel *chan, struct logmsg *msg, char *buf, size_t size)
 {
-	char call_identifier_str[13];
-
-	if (msg->callid) {
-		snprintf(call_identifier_str, sizeof(call_identifier_str), "[C-%08x]", msg->callid);
-	} else {
-		call_identifier_str[0] = '\0';
-	}
-
 	switch (chan->type) {
 	case LOGTYPE_SYSLOG:
 		snprintf(buf, size, "%s[%d]%s: %s:%d in %s: %s",
-		     levels[msg->level], msg->lwp, call_identifier_str, msg->file,
+		     levels[msg->level], msg->lwp, msg->call_identifier_str, msg->file,
 		     msg->line, msg->function, msg->message);
 		term_strip(buf, buf, size);
 		break;
 	case LOGTYPE_FILE:
 		snprintf(buf, size, "[%s] %s[%d]%s %s: %s",
-		      msg->date, msg->level_name, msg->lwp, call_identifier_str,
+		      msg->date, msg->level_name, msg->lwp, msg->call_identifier_str,
 		      msg->file, msg->message);
 		term_strip(buf, buf, size);
 		break;
@@ -405,7 +412,7 @@ static int format_log_default(struct logchannel *chan, struct logmsg *msg, char
 				msg->date,
 				COLORIZE(colors[msg->level], 0, msg->level_name),
 				msg->lwp,
-				call_identifier_str,
+				msg->call_identifier_str,
 				COLORIZE(COLOR_BRWHITE, 0, has_file ? msg->file : ""),
 				has_file ? ":" : "",
 				COLORIZE(COLOR_BRWHITE, 0, has_line ? linestr : ""),
@@ -426,22 +433,15 @@ static struct logformatter logformatter_default = {
 
 static int format_log_plain(struct logchannel *chan, struct logmsg *msg, char *buf, size_t size)
 {
-	char call_identifier_str[13];
 	char linestr[32];
 	int has_file = !ast_strlen_zero(msg->file);
 	int has_line = (msg->line > 0);
 	int has_func = !ast_strlen_zero(msg->function);
 
-	if (msg->callid) {
-		snprintf(call_identifier_str, sizeof(call_identifier_str), "[C-%08x]", msg->callid);
-	} else {
-		call_identifier_str[0] = '\0';
-	}
-
 	switch (chan->type) {
 	case LOGTYPE_SYSLOG:
 		snprintf(buf, size, "%s[%d]%s: %s:%d in %s: %s",
-		     levels[msg->level], msg->lwp, call_identifier_str, msg->file,
+		     levels[msg->level], msg->lwp, msg->call_identifier_str, msg->file,
 		     msg->line, msg->function, msg->message);
 		term_strip(buf, buf, size);
 		break;
@@ -454,7 +454,7 @@ static int format_log_plain(struct logchannel *chan, struct logmsg *msg, char *b
 			msg->date,
 			msg->level_name,
 			msg->lwp,
-			call_identifier_str,
+			msg->call_identifier_str,
 			has_file ? msg->file : "",
 			has_file ? ":" : "",
 			has_line ? linestr : "",
@@ -671,6 +671,8 @@ static struct logchannel *make_logchannel(const char *channel, const char *compo
 				datestring, ast_get_version(), ast_build_user, ast_build_hostname,
 				ast_build_machine, ast_build_os, ast_build_date);
 			fflush(chan->fileptr);
+			/* Without a writer messages are written to fileptr directly */
+			chan->writer = ast_uring_writer_create(fileno(chan->fileptr), 0);
 		}
 		chan->type = LOGTYPE_FILE;
 	}
@@ -679,6 +681,21 @@ static struct logchannel *make_logchannel(const char *channel, const char *compo
 	return chan;
 }
 
+/*!
+ * \internal
+ * \brief Close the file of a log channel once its messages are written
+ */
+static void logchannel_file_close(struct logchannel *chan)
+{
+	if (chan->writer) {
+		ast_uring_writer_flush(chan->writer);
+		ast_uring_writer_close(chan->writer);
+		chan->writer = NULL;
+	}
+	fclose(chan->fileptr);
+	chan->fileptr = NULL;
+}
+
 void ast_init_logger_for_socket_console(void)
 {
 	struct ast_config *cfg;
@@ -696,6 +713,31 @@ void ast_init_logger_for_socket_console(void)
 	ast_config_destroy(cfg);
 }
 
+/*!
+ * \internal
+ * \brief Publish the levels the log channels take messages for
+ * \note Called with the logchannels list write locked
+ *
+ * Published in one go, since messages for levels missing from it are
+ * dropped before they are even formatted.  Without any log channel every
+ * message goes to stdout, so none is dropped then.
+ */
+static void logmask_update(void)
+{
+	struct logchannel *chan;
+	unsigned int logmask = 0;
+
+	if (AST_RWLIST_EMPTY(&logchannels)) {
+		global_logmask = ~0U;
+		return;
+	}
+
+	AST_RWLIST_TRAVERSE(&logchannels, chan, list) {
+		logmask |= chan->logmask;
+	}
+	global_logmask = logmask;
+}
+
 /*!
  * \brief Read config, setup channels.
  * \param altconf Alternate configuration file to read.
@@ -731,7 +773,6 @@ static int init_logger_chain(const char *altconf)
 	while ((chan = AST_RWLIST_REMOVE_HEAD(&logchannels, list))) {
 		ast_free(chan);
 	}
-	global_logmask = 0;
 
 	errno = 0;
 	/* close syslog */
@@ -746,7 +787,7 @@ static int init_logger_chain(const char *altconf)
 		}
 
 		AST_RWLIST_INSERT_HEAD(&logchannels, chan, list);
-		global_logmask |= chan->logmask;
+		global_logmask = chan->logmask;
 
 		return -1;
 	}
@@ -821,8 +862,8 @@ static int init_logger_chain(const char *altconf)
 			continue;
 		}
 		AST_RWLIST_INSERT_HEAD(&logchannels, chan, list);
-		global_logmask |= chan->logmask;
 	}
+	logmask_update();
 
 	if (qlog) {
 		fclose(qlog);
@@ -1169,12 +1210,14 @@ static int reload_logger(int rotate, const char *altconf)
 		}
 		if (f->fileptr && (f->fileptr != stdout) && (f->fileptr != stderr)) {
 			int rotate_this = 0;
+			if (f->writer) {
+				ast_uring_writer_flush(f->writer);
+			}
 			if (rotatestrategy != NONE && ftello(f->fileptr) > 0x40000000) { /* Arbitrarily, 1 GB */
 				/* Be more proactive about rotating massive log files */
 				rotate_this = 1;
 			}
-			fclose(f->fileptr);	/* Close file */
-			f->fileptr = NULL;
+			logchannel_file_close(f);	/* Close file */
 			if (rotate || rotate_this) {
 				rotate_file(f->filename);
 			}
@@ -1262,8 +1305,7 @@ int ast_logger_rotate_channel(const char *log_channel)
 				f->filename);
 		}
 		if (f->fileptr && (f->fileptr != stdout) && (f->fileptr != stderr)) {
-			fclose(f->fileptr);	/* Close file */
-			f->fileptr = NULL;
+			logchannel_file_close(f);	/* Close file */
 			if (strcmp(filename, f->filename) == 0) {
 				rotate_file(f->filename);
 				success = AST_LOGGER_SUCCESS;
@@ -1478,6 +1520,7 @@ int ast_logger_remove_channel(const char *log_channel)
 	chan = find_logchannel(log_channel);
 	if (chan && chan->dynamic) {
 		AST_RWLIST_REMOVE(&logchannels, chan, list);
+		logmask_update();
 	} else {
 		AST_RWLIST_UNLOCK(&logchannels);
 		return AST_LOGGER_FAILURE;
@@ -1485,8 +1528,7 @@ int ast_logger_remove_channel(const char *log_channel)
 	AST_RWLIST_UNLOCK(&logchannels);
 
 	if (chan->fileptr) {
-		fclose(chan->fileptr);
-		chan->fileptr = NULL;
+		logchannel_file_close(chan);
 	}
 	ast_free(chan);
 	chan = NULL;
@@ -1623,9 +1665,15 @@ static void logger_print_normal(struct logmsg *logmsg)
 					}
 
 					/* Print out to the file */
-					res = fprintf(chan->fileptr, "%s", buf);
+					if (chan->writer) {
+						res = ast_uring_write(chan->writer, buf, strlen(buf)) ? -1 : 1;
+					} else {
+						res = fprintf(chan->fileptr, "%s", buf);
+					}
 					if (res > 0) {
-						fflush(chan->fileptr);
+						if (!chan->writer) {
+							fflush(chan->fileptr);
+						}
 					} else if (res <= 0 && !ast_strlen_zero(logmsg->message)) {
 						fprintf(stderr, "**** Asterisk Logging Error: ***********\n");
 						if (errno == ENOMEM || errno == ENOSPC) {
@@ -1711,6 +1759,7 @@ static struct logmsg * __attribute__((format(printf, 7, 0))) format_log_message_
 
 	if (display_callids && callid) {
 		logmsg->callid = callid;
+		snprintf(logmsg->call_identifier_str, sizeof(logmsg->call_identifier_str), "[C-%08x]", callid);
 	}
 
 	/* Create our date/time */
@@ -1744,38 +1793,77 @@ static struct logmsg * __attribute__((format(printf, 7, 0))) format_log_message(
 	return logmsg;
 }
 
+/*!
+ * \internal
+ * \brief Hand a message to the logger thread.
+ *
+ * \note This never blocks on a lock unless the logger thread may be asleep.
+ */
+static void logmsg_queue(struct logmsg *msg)
+{
+	struct logmsg *first;
+
+	do {
+		first = logger_atomic_load(&logmsgs);
+		AST_LIST_NEXT(msg, list) = first;
+	} while (!logger_atomic_cas(&logmsgs, first, msg));
+
+	if (!first) {
+		/* The logger thread may have gone to sleep on an empty queue */
+		ast_mutex_lock(&logmsgs_lock);
+		ast_cond_signal(&logcond);
+		ast_mutex_unlock(&logmsgs_lock);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Take every queued message, oldest first.
+ */
+static struct logmsg *logmsg_take_all(int *count)
+{
+	struct logmsg *msg;
+	struct logmsg *next;
+	struct logmsg *oldest = NULL;
+	struct logmsg *null = NULL;
+
+	do {
+		msg = logger_atomic_load(&logmsgs);
+	} while (msg && !logger_atomic_cas(&logmsgs, msg, null));
+
+	/* Queued newest first, so reverse it */
+	*count = 0;
+	for (; msg; msg = next) {
+		next = AST_LIST_NEXT(msg, list);
+		AST_LIST_NEXT(msg, list) = oldest;
+		oldest = msg;
+		++*count;
+	}
+
+	return oldest;
+}
+
 /*! \brief Actual logging thread */
 static void *logger_thread(void *data)
 {
 	struct logmsg *next = NULL, *msg = NULL;
+	int count;
 
 	for (;;) {
 		/* We lock the message list, and see if any message exists... if not we wait on the condition to be signalled */
-		AST_LIST_LOCK(&logmsgs);
-		if (AST_LIST_EMPTY(&logmsgs)) {
+		ast_mutex_lock(&logmsgs_lock);
+		if (!logger_atomic_load(&logmsgs)) {
 			if (close_logger_thread) {
-				AST_LIST_UNLOCK(&logmsgs);
+				ast_mutex_unlock(&logmsgs_lock);
 				break;
 			} else {
-				ast_cond_wait(&logcond, &logmsgs.lock);
+				ast_cond_wait(&logcond, &logmsgs_lock);
 			}
 		}
+		ast_mutex_unlock(&logmsgs_lock);
 
-		if (high_water_alert) {
-			msg = format_log_message(__LOG_WARNING, 0, "logger", 0, "***", 0,
-				"Logging resumed.  %d message%s discarded.\n",
-				logger_messages_discarded, logger_messages_discarded == 1 ? "" : "s");
-			if (msg) {
-				AST_LIST_INSERT_TAIL(&logmsgs, msg, list);
-			}
-			high_water_alert = 0;
-			logger_messages_discarded = 0;
-		}
-
-		next = AST_LIST_FIRST(&logmsgs);
-		AST_LIST_HEAD_INIT_NOLOCK(&logmsgs);
-		logger_queue_size = 0;
-		AST_LIST_UNLOCK(&logmsgs);
+		next = logmsg_take_all(&count);
+		ast_atomic_fetchadd_int(&logger_queue_size, -count);
 
 		/* Otherwise go through and process each message in the order added */
 		while ((msg = next)) {
@@ -1788,6 +1876,20 @@ static void *logger_thread(void *data)
 			/* Free the data since we are done */
 			logmsg_free(msg);
 		}
+
+		if (high_water_alert) {
+			int discarded = logger_messages_discarded;
+
+			ast_atomic_fetchadd_int(&logger_messages_discarded, -discarded);
+			msg = format_log_message(__LOG_WARNING, 0, "logger", 0, "***", 0,
+				"Logging resumed.  %d message%s discarded.\n",
+				discarded, discarded == 1 ? "" : "s");
+			if (msg) {
+				logger_print_normal(msg);
+				logmsg_free(msg);
+			}
+			high_water_alert = 0;
+		}
 	}
 
 	return NULL;
@@ -1866,8 +1968,8 @@ int init_logger(void)
  	 * the thread that unlocks the mutex.  Since init_logger is called after the
  	 * fork, it is safe to initialize the mutex here for future accesses.
  	 */
-	ast_mutex_destroy(&logmsgs.lock);
-	ast_mutex_init(&logmsgs.lock);
+	ast_mutex_destroy(&logmsgs_lock);
+	ast_mutex_init(&logmsgs_lock);
 	ast_cond_init(&logcond, NULL);
 
 	/* start logger thread */
@@ -1899,6 +2001,8 @@ int init_logger(void)
 void close_logger(void)
 {
 	struct logchannel *f = NULL;
+	struct logmsg *msg;
+	int count;
 
 	ast_logger_category_unload();
 
@@ -1907,15 +2011,24 @@ void close_logger(void)
 	logger_initialized = 0;
 
 	/* Stop logger thread */
-	AST_LIST_LOCK(&logmsgs);
+	ast_mutex_lock(&logmsgs_lock);
 	close_logger_thread = 1;
 	ast_cond_signal(&logcond);
-	AST_LIST_UNLOCK(&logmsgs);
+	ast_mutex_unlock(&logmsgs_lock);
 
 	if (logthread != AST_PTHREADT_NULL) {
 		pthread_join(logthread, NULL);
 	}
 
+	/* Anything queued while the thread was exiting cannot be logged anymore */
+	msg = logmsg_take_all(&count);
+	while (msg) {
+		struct logmsg *next = AST_LIST_NEXT(msg, list);
+
+		logmsg_free(msg);
+		msg = next;
+	}
+
 	AST_RWLIST_WRLOCK(&logchannels);
 
 	if (qlog) {
@@ -1925,8 +2038,7 @@ void close_logger(void)
 
 	while ((f = AST_LIST_REMOVE_HEAD(&logchannels, list))) {
 		if (f->fileptr && (f->fileptr != stdout) && (f->fileptr != stderr)) {
-			fclose(f->fileptr);
-			f->fileptr = NULL;
+			logchannel_file_close(f);
 		}
 		ast_free(f);
 	}
@@ -2042,43 +2154,44 @@ static void __attribute__((format(printf, 7, 0))) ast_log_full(int level, int su
 	const char *fmt, va_list ap)
 {
 	struct logmsg *logmsg = NULL;
+	unsigned int unset = 0;
 
 	if (level == __LOG_VERBOSE && ast_opt_remote && ast_opt_exec) {
 		return;
 	}
 
-	AST_LIST_LOCK(&logmsgs);
+	/* Nothing would print it, so don't bother formatting it */
+	if (!(global_logmask & (1U << level))
+		|| (level == __LOG_VERBOSE && sublevel > 0 && !VERBOSITY_ATLEAST(sublevel))) {
+		return;
+	}
+
 	if (logger_queue_size >= logger_queue_limit && !close_logger_thread) {
-		logger_messages_discarded++;
-		if (!high_water_alert && !close_logger_thread) {
+		ast_atomic_fetchadd_int(&logger_messages_discarded, +1);
+		if (logger_atomic_cas(&high_water_alert, unset, 1)) {
 			logmsg = format_log_message(__LOG_WARNING, 0, "logger", 0, "***", 0,
 				"Log queue threshold (%d) exceeded.  Discarding new messages.\n", logger_queue_limit);
-			AST_LIST_INSERT_TAIL(&logmsgs, logmsg, list);
-			high_water_alert = 1;
-			ast_cond_signal(&logcond);
+			if (logmsg) {
+				logmsg_queue(logmsg);
+			}
 		}
-		AST_LIST_UNLOCK(&logmsgs);
 		return;
 	}
-	AST_LIST_UNLOCK(&logmsgs);
 
 	logmsg = format_log_message_ap(level, sublevel, file, line, function, callid, fmt, ap);
 	if (!logmsg) {
 		return;
 	}
 
-	/* If the logger thread is active, append it to the tail end of the list - otherwise skip that step */
+	/* If the logger thread is active, push it onto the queue - otherwise skip that step */
 	if (logthread != AST_PTHREADT_NULL) {
-		AST_LIST_LOCK(&logmsgs);
 		if (close_logger_thread) {
 			/* Logger is either closing or closed.  We cannot log this message. */
 			logmsg_free(logmsg);
 		} else {
-			AST_LIST_INSERT_TAIL(&logmsgs, logmsg, list);
-			logger_queue_size++;
-			ast_cond_signal(&logcond);
+			ast_atomic_fetchadd_int(&logger_queue_size, +1);
+			logmsg_queue(logmsg);
 		}
-		AST_LIST_UNLOCK(&logmsgs);
 	} else {
 		logger_print_normal(logmsg);
 		logmsg_free(logmsg);
@@ -2350,12 +2463,10 @@ static void update_logchannels(void)
 
 	AST_RWLIST_WRLOCK(&logchannels);
 
-	global_logmask = 0;
-
 	AST_RWLIST_TRAVERSE(&logchannels, cur, list) {
 		make_components(cur);
-		global_logmask |= cur->logmask;
 	}
+	logmask_update();
 
 	AST_RWLIST_UNLOCK(&logchannels);
 }
@@ -98,8 +98,10 @@
 #include "asterisk/features_config.h"
 #include "asterisk/rtp_engine.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/overload.h"
 #include "asterisk/translate.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/threadpool.h"
 #include "asterisk/message.h"
 
 /*** DOCUMENTATION
@@ -571,6 +573,23 @@
 			<ref type="manager">CreateConfig</ref>
 		</see-also>
 	</manager>
+	<manager name="RealtimeCacheFlush" language="en_US">
+		<synopsis>
+			Discard cached realtime lookup results.
+		</synopsis>
+		<syntax>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Login']/syntax/parameter[@name='ActionID'])" />
+			<parameter name="Family">
+				<para>Realtime family to discard results for. If not given
+				results for every family are discarded.</para>
+			</parameter>
+		</syntax>
+		<description>
+			<para>This action discards realtime lookup results cached for the
+			families given a cache time in <filename>extconfig.conf</filename>,
+			so that changes made to the backend directly are picked up.</para>
+		</description>
+	</manager>
 	<manager name="Redirect" language="en_US">
 		<synopsis>
 			Redirect (transfer) a call.
@@ -741,6 +760,95 @@
 			</see-also>
 		</managerEventInstance>
 	</managerEvent>
+	<manager name="OriginateBatch" language="en_US">
+		<synopsis>
+			Originate a batch of calls.
+		</synopsis>
+		<syntax>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Login']/syntax/parameter[@name='ActionID'])" />
+			<parameter name="Channel" required="true">
+				<para>Channel name to call, multiple Channel: headers are allowed.
+				Calls are started in the order given.</para>
+			</parameter>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Exten'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Context'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Priority'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Application'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Data'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Timeout'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='CallerID'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Variable'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Account'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='EarlyMedia'])" />
+			<xi:include xpointer="xpointer(/docs/manager[@name='Originate']/syntax/parameter[@name='Codecs'])" />
+			<parameter name="CPS" default="0">
+				<para>Maximum number of calls to start per second, <literal>0</literal>
+				for no limit.</para>
+			</parameter>
+			<parameter name="MaxConcurrent" default="0">
+				<para>Maximum number of calls dialing at once, <literal>0</literal>
+				for no limit.</para>
+			</parameter>
+		</syntax>
+		<description>
+			<para>Generates outgoing calls to a list of channels, each sent to the same
+			<replaceable>Extension</replaceable>/<replaceable>Context</replaceable>/<replaceable>Priority</replaceable>
+			or <replaceable>Application</replaceable>/<replaceable>Data</replaceable>.
+			The calls are dialed from a pool of threads shared by all batches, paced by
+			<replaceable>CPS</replaceable> and <replaceable>MaxConcurrent</replaceable>.
+			The response is sent as soon as the batch is queued. An
+			<literal>OriginateBatchResponse</literal> event follows as each call is answered
+			or fails, then an <literal>OriginateBatchComplete</literal> event.</para>
+		</description>
+		<see-also>
+			<ref type="manager">Originate</ref>
+			<ref type="managerEvent">OriginateBatchResponse</ref>
+			<ref type="managerEvent">OriginateBatchComplete</ref>
+		</see-also>
+	</manager>
+	<managerEvent language="en_US" name="OriginateBatchResponse">
+		<managerEventInstance class="EVENT_FLAG_CALL">
+			<synopsis>Raised as each call of an OriginateBatch command is answered or fails.</synopsis>
+			<syntax>
+				<parameter name="ActionID" required="false"/>
+				<parameter name="Index">
+					<para>Position of the call's Channel header in the action, starting at 0.</para>
+				</parameter>
+				<parameter name="Response">
+					<enumlist>
+						<enum name="Failure"/>
+						<enum name="Success"/>
+					</enumlist>
+				</parameter>
+				<parameter name="Channel"/>
+				<parameter name="Reason"/>
+				<parameter name="Uniqueid"/>
+			</syntax>
+			<see-also>
+				<ref type="manager">OriginateBatch</ref>
+			</see-also>
+		</managerEventInstance>
+	</managerEvent>
+	<managerEvent language="en_US" name="OriginateBatchComplete">
+		<managerEventInstance class="EVENT_FLAG_CALL">
+			<synopsis>Raised once every call of an OriginateBatch command is answered or has failed.</synopsis>
+			<syntax>
+				<parameter name="ActionID" required="false"/>
+				<parameter name="Calls">
+					<para>Number of calls in the batch.</para>
+				</parameter>
+				<parameter name="Answered">
+					<para>Number of calls that were answered.</para>
+				</parameter>
+				<parameter name="Failed">
+					<para>Number of calls that failed.</para>
+				</parameter>
+			</syntax>
+			<see-also>
+				<ref type="manager">OriginateBatch</ref>
+			</see-also>
+		</managerEventInstance>
+	</managerEvent>
 	<manager name="Command" language="en_US">
 		<synopsis>
 			Execute Asterisk CLI Command.
@@ -1254,6 +1362,31 @@
 					</enum>
 				</enumlist>
 			</parameter>
+			<parameter name="MatchCriteria">
+				<para>Makes the filter a structured one, matched against the value of one
+				header of an event instead of running a regular expression over the whole
+				event.  A comma separated list of:</para>
+				<enumlist>
+					<enum name="action(include|exclude)">
+						<para>Whether events matching the filter are included, the default,
+						or excluded.</para>
+					</enum>
+					<enum name="name(EventName)">
+						<para>Only match events with this name.</para>
+					</enum>
+					<enum name="header(HeaderName)">
+						<para>Match against the value of this header, the whole event if
+						not given.  Events without the header do not match.</para>
+					</enum>
+					<enum name="method(regex|exact|starts_with|ends_with|contains|none)">
+						<para>How the value of the filter is matched, regex if not given.
+						With none, only the event name and header presence are checked.</para>
+					</enum>
+				</enumlist>
+				<para>Example: "action(exclude),name(Newchannel),header(Channel),method(starts_with)"
+				with a Filter of "DAHDI/".  Filters other than regex ones compare literals and
+				do not need to run a regular expression on every event.</para>
+			</parameter>
 			<parameter name="Filter">
 				<para>Filters can be whitelist or blacklist</para>
 				<para>Example whitelist filter: "Event: Newchannel"</para>
@@ -1435,37 +1568,78 @@ enum add_filter_result {
 	FILTER_SUCCESS,
 	FILTER_ALLOC_FAILED,
 	FILTER_COMPILE_FAIL,
+	FILTER_FORMAT_ERROR,
+};
+
+/*! \brief How an event filter matches its value */
+enum event_filter_match_type {
+	/*! Run a regular expression, the only method of filters without criteria */
+	FILTER_MATCH_REGEX = 0,
+	FILTER_MATCH_EXACT,
+	FILTER_MATCH_STARTS_WITH,
+	FILTER_MATCH_ENDS_WITH,
+	FILTER_MATCH_CONTAINS,
+	/*! Only match the event name and header presence */
+	FILTER_MATCH_NONE,
 };
 
 /*!
- * Linked list of events.
- * Global events are appended to the list by append_event().
- * The usecount is the number of stored pointers to the element,
- * excluding the list pointers. So an element that is only in
- * the list has a usecount of 0, not 1.
+ * \brief An event filter, compiled when it is added
  *
- * Clients have a pointer to the last event processed, and for each
- * of these clients we track the usecount of the elements.
- * If we have a pointer to an entry in the list, it is safe to navigate
- * it forward because elements will not be deleted, but only appended.
- * The worst that can happen is seeing the pointer still NULL.
- *
- * When the usecount of an element drops to 0, and the element is the
- * first in the list, we can remove it. Removal is done within the
- * main thread, which is woken up for the purpose.
+ * A filter without criteria runs its regular expression over the whole
+ * event.  One with criteria first compares the hash and then the name of
+ * the event, then applies its method to the value of one header, or to
+ * the whole event when no header was given.
+ */
+struct event_filter_entry {
+	enum event_filter_match_type match_type;
+	/*! Compiled expression, for FILTER_MATCH_REGEX */
+	regex_t *regex_filter;
+	/*! Event the filter applies to, NULL for any */
+	char *event_name;
+	unsigned int event_name_hash;
+	/*! Header whose value is matched, NULL for the whole event */
+	char *header_name;
+	size_t header_name_len;
+	/*! Literal the value is matched against */
+	char *string_filter;
+	size_t string_filter_len;
+};
+
+/*!
+ * A formatted event, shared by the event queues of the sessions that want it.
  *
- * For simplicity of implementation, we make sure the list is never empty.
+ * append_event() checks the permissions, event mask and filters of each
+ * session once and queues a reference to the event on the sessions that
+ * accept it.  Each session has its own bounded ring of queued events, so
+ * a session that does not keep up only holds back its own events.  What
+ * happens when a ring is full is set by eventqueuefull in manager.conf.
  */
 struct eventqent {
-	int usecount;		/*!< # of clients who still need the event */
 	int category;
-	unsigned int seq;	/*!< sequence number */
-	struct timeval tv;  /*!< When event was allocated */
-	AST_RWLIST_ENTRY(eventqent) eq_next;
+	/*! Value of the Event header, stored after eventdata */
+	const char *event_name;
+	/*! ast_str_hash() of event_name, compared first by filters on the event name */
+	unsigned int event_name_hash;
 	char eventdata[1];	/*!< really variable size, allocated by append_event() */
 };
 
-static AST_RWLIST_HEAD_STATIC(all_events, eventqent);
+/*! \brief What to do with a new event when the event queue of a session is full */
+enum eventq_full_policy {
+	/*! Drop the oldest queued event to make room */
+	EVENTQ_FULL_DROP,
+	/*! Disconnect the session */
+	EVENTQ_FULL_DISCONNECT,
+	/*! Queue up to twice as many events for up to the write timeout of the session, then drop the oldest */
+	EVENTQ_FULL_GRACE,
+};
+
+#define DEFAULT_EVENTQ_SIZE 10000
+/*! Slots first allocated for the event queue of a session, it grows up to eventq_size */
+#define EVENTQ_INITIAL_SIZE 64
+
+static unsigned int eventq_size = DEFAULT_EVENTQ_SIZE;
+static enum eventq_full_policy eventq_full = EVENTQ_FULL_DROP;
 
 static int displayconnects = 1;
 static int allowmultiplelogin = 1;
@@ -1475,6 +1649,7 @@ static int broken_events_action = 0;
 static int manager_enabled = 0;
 static int subscribed = 0;
 static int webmanager_enabled = 0;
+static int mux_enabled = 0;
 static int manager_debug = 0;	/*!< enable some debugging code in the manager */
 static int authtimeout;
 static int authlimit;
@@ -1600,14 +1775,21 @@ struct mansession_session {
 	struct ao2_container *blackfilters;	/*!< Manager event filters - black list */
 	struct ast_variable *chanvars;  /*!< Channel variables to set for originate */
 	int send_events;	/*!<  XXX what ? */
-	struct eventqent *last_ev;	/*!< last event processed. */
 	int writetimeout;	/*!< Timeout for ast_carefulwrite() */
 	time_t authstart;
 	int pending_event;         /*!< Pending events indicator in case when waiting_thread is NULL */
 	time_t noncetime;	/*!< Timer for nonce value expiration */
 	unsigned long oldnonce;	/*!< Stale nonce value */
 	unsigned long nc;	/*!< incremental  nonce counter */
-	ast_mutex_t notify_lock; /*!< Lock for notifying this session of events */
+	ast_mutex_t notify_lock; /*!< Lock for notifying this session of events, also protects the event queue */
+	struct eventqent **eventq;	/*!< Ring of events waiting to be sent */
+	unsigned int eventq_alloc;	/*!< Slots allocated in eventq */
+	unsigned int eventq_max;	/*!< Most events eventq may hold */
+	unsigned int eventq_head;	/*!< Slot of the oldest queued event */
+	unsigned int eventq_count;	/*!< Number of queued events */
+	unsigned int eventq_dropped;	/*!< Events dropped because eventq was full */
+	int eventq_overflow;	/*!< Set once eventq filled up under the disconnect policy */
+	struct timeval eventq_full_since;	/*!< When eventq filled up under the grace policy, zero if not full */
 	AST_LIST_HEAD_NOLOCK(mansession_datastores, ast_datastore) datastores; /*!< Data stores on the session */
 	AST_LIST_ENTRY(mansession_session) list;
 };
@@ -1629,6 +1811,7 @@ struct mansession {
 	enum mansession_message_parsing parsing;
 	unsigned int write_error:1;
 	struct manager_custom_hook *hook;
+	struct ast_str *capture;	/*!< Output of a multiplexed action, sent in frames once it is done */
 	ast_mutex_t lock;
 };
 
@@ -1683,9 +1866,9 @@ static int __attribute__((format(printf, 9, 0))) __manager_event_sessions(
 	const char *func,
 	const char *fmt,
 	...);
-static enum add_filter_result manager_add_filter(const char *filter_pattern, struct ao2_container *whitefilters, struct ao2_container *blackfilters);
+static enum add_filter_result manager_add_filter(const char *criteria, const char *filter_pattern, struct ao2_container *whitefilters, struct ao2_container *blackfilters);
 
-static int match_filter(struct mansession *s, char *eventdata);
+static int match_filter(struct mansession_session *session, struct eventqent *eqe);
 
 /*!
  * @{ \brief Define AMI message types.
@@ -1956,56 +2139,162 @@ int ast_webmanager_check_enabled(void)
 	return (webmanager_enabled && manager_enabled);
 }
 
+static const char *eventq_full_policy_str(enum eventq_full_policy policy)
+{
+	switch (policy) {
+	case EVENTQ_FULL_DROP:
+		return "drop";
+	case EVENTQ_FULL_DISCONNECT:
+		return "disconnect";
+	case EVENTQ_FULL_GRACE:
+		return "grace";
+	}
+	return "";
+}
+
 /*!
- * Grab a reference to the last event, update usecount as needed.
- * Can handle a NULL pointer.
+ * \internal
+ * \brief Take the oldest event off the event queue of a session
+ *
+ * \return The event, whose reference the caller now owns, or NULL if none is queued
  */
-static struct eventqent *grab_last(void)
+static struct eventqent *session_eventq_pop(struct mansession_session *session)
 {
-	struct eventqent *ret;
+	struct eventqent *eqe = NULL;
 
-	AST_RWLIST_WRLOCK(&all_events);
-	ret = AST_RWLIST_LAST(&all_events);
-	/* the list is never empty now, but may become so when
-	 * we optimize it in the future, so be prepared.
-	 */
-	if (ret) {
-		ast_atomic_fetchadd_int(&ret->usecount, 1);
+	ast_mutex_lock(&session->notify_lock);
+	if (session->eventq_count) {
+		eqe = session->eventq[session->eventq_head];
+		session->eventq_head = (session->eventq_head + 1) % session->eventq_alloc;
+		--session->eventq_count;
+		if (session->eventq_count < session->eventq_max) {
+			session->eventq_full_since = ast_tv(0, 0);
+		}
 	}
-	AST_RWLIST_UNLOCK(&all_events);
-	return ret;
+	ast_mutex_unlock(&session->notify_lock);
+
+	return eqe;
 }
 
 /*!
- * Purge unused events. Remove elements from the head
- * as long as their usecount is 0 and there is a next element.
+ * \internal
+ * \brief Drop the oldest event queued for a session
+ *
+ * \note The session notify_lock must be held.
  */
-static void purge_events(void)
+static void session_eventq_drop_oldest(struct mansession_session *session)
 {
-	struct eventqent *ev;
-	struct timeval now = ast_tvnow();
+	ao2_ref(session->eventq[session->eventq_head], -1);
+	session->eventq_head = (session->eventq_head + 1) % session->eventq_alloc;
+	--session->eventq_count;
+	if (!session->eventq_dropped++) {
+		ast_log(LOG_WARNING, "AMI session '%s' from %s is not keeping up, dropping its oldest events "
+			"(see 'manager show eventq')\n",
+			session->username, ast_sockaddr_stringify_addr(&session->addr));
+	}
+}
+
+/*!
+ * \internal
+ * \brief Make room for one more event on the event queue of a session
+ *
+ * \note The session notify_lock must be held.
+ *
+ * \note This runs in the thread raising the event and must never wait
+ * for the session to catch up.
+ *
+ * \retval 0 if there is room
+ * \retval -1 if the event should not be queued
+ */
+static int session_eventq_reserve(struct mansession_session *session, int category)
+{
+	struct eventqent **eventq;
+	unsigned int limit = session->eventq_max;
+	unsigned int alloc;
+	unsigned int i;
 
-	AST_RWLIST_WRLOCK(&all_events);
-	while ( (ev = AST_RWLIST_FIRST(&all_events)) &&
-	    ev->usecount == 0 && AST_RWLIST_NEXT(ev, eq_next)) {
-		AST_RWLIST_REMOVE_HEAD(&all_events, eq_next);
-		ast_free(ev);
+	if (session->eventq_overflow) {
+		return -1;
 	}
 
-	AST_RWLIST_TRAVERSE_SAFE_BEGIN(&all_events, ev, eq_next) {
-		/* Never release the last event */
-		if (!AST_RWLIST_NEXT(ev, eq_next)) {
-			break;
+	if (session->eventq_count >= session->eventq_max && category != EVENT_FLAG_SHUTDOWN) {
+		if (eventq_full == EVENTQ_FULL_GRACE) {
+			/* Give the session its write timeout to catch up before dropping events */
+			if (ast_tvzero(session->eventq_full_since)) {
+				session->eventq_full_since = ast_tvnow();
+			}
+			if (ast_tvdiff_ms(ast_tvnow(), session->eventq_full_since) < session->writetimeout) {
+				limit = session->eventq_max * 2;
+			}
+		} else if (eventq_full == EVENTQ_FULL_DISCONNECT) {
+			ast_log(LOG_WARNING, "AMI session '%s' from %s is not keeping up, disconnecting it\n",
+				session->username, ast_sockaddr_stringify_addr(&session->addr));
+			session->eventq_overflow = 1;
+			return -1;
 		}
+	}
+	while (session->eventq_count >= limit) {
+		session_eventq_drop_oldest(session);
+	}
+
+	if (session->eventq_count < session->eventq_alloc) {
+		return 0;
+	}
 
-		/* 2.5 times whatever the HTTP timeout is (maximum 2.5 hours) is the maximum time that we will definitely cache an event */
-		if (ev->usecount == 0 && ast_tvdiff_sec(now, ev->tv) > (httptimeout > 3600 ? 3600 : httptimeout) * 2.5) {
-			AST_RWLIST_REMOVE_CURRENT(eq_next);
-			ast_free(ev);
+	/* Grow the ring, unwrapping the queued events to the start of it */
+	alloc = MIN(MAX(session->eventq_alloc * 2, EVENTQ_INITIAL_SIZE), limit);
+	if (alloc <= session->eventq_alloc || !(eventq = ast_malloc(alloc * sizeof(*eventq)))) {
+		if (!session->eventq_count) {
+			++session->eventq_dropped;
+			return -1;
 		}
+		session_eventq_drop_oldest(session);
+		return 0;
 	}
-	AST_RWLIST_TRAVERSE_SAFE_END;
-	AST_RWLIST_UNLOCK(&all_events);
+	for (i = 0; i < session->eventq_count; ++i) {
+		eventq[i] = session->eventq[(session->eventq_head + i) % session->eventq_alloc];
+	}
+	ast_free(session->eventq);
+	session->eventq = eventq;
+	session->eventq_alloc = alloc;
+	session->eventq_head = 0;
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Wake the thread of a session, or have it not wait the next time
+ *
+ * \note The session notify_lock must be held.
+ */
+static void session_wake(struct mansession_session *session)
+{
+	if (session->waiting_thread != AST_PTHREADT_NULL) {
+		pthread_kill(session->waiting_thread, SIGURG);
+	} else {
+		/* We have an event to process, but the mansession is
+		 * not waiting for it. We still need to indicate that there
+		 * is an event waiting so that get_input processes the pending
+		 * event instead of polling.
+		 */
+		session->pending_event = 1;
+	}
+}
+
+/*!
+ * \internal
+ * \brief Queue an event on a session and wake the session to send it
+ */
+static void session_eventq_push(struct mansession_session *session, struct eventqent *eqe)
+{
+	ast_mutex_lock(&session->notify_lock);
+	if (!session_eventq_reserve(session, eqe->category)) {
+		session->eventq[(session->eventq_head + session->eventq_count) % session->eventq_alloc] = ao2_bump(eqe);
+		++session->eventq_count;
+	}
+	session_wake(session);
+	ast_mutex_unlock(&session->notify_lock);
 }
 
 /*!
@@ -2191,14 +2480,21 @@ static struct mansession_session *unref_mansession(struct mansession_session *s)
 
 static void event_filter_destructor(void *obj)
 {
-	regex_t *regex_filter = obj;
-	regfree(regex_filter);
+	struct event_filter_entry *entry = obj;
+
+	if (entry->regex_filter) {
+		regfree(entry->regex_filter);
+		ast_free(entry->regex_filter);
+	}
+	ast_free(entry->event_name);
+	ast_free(entry->header_name);
+	ast_free(entry->string_filter);
 }
 
 static void session_destructor(void *obj)
 {
 	struct mansession_session *session = obj;
-	struct eventqent *eqe = session->last_ev;
+	struct eventqent *eqe;
 	struct ast_datastore *datastore;
 
 	/* Get rid of each of the data stores on the session */
@@ -2207,9 +2503,10 @@ static void session_destructor(void *obj)
 		ast_datastore_free(datastore);
 	}
 
-	if (eqe) {
-		ast_atomic_fetchadd_int(&eqe->usecount, -1);
+	while ((eqe = session_eventq_pop(session))) {
+		ao2_ref(eqe, -1);
 	}
+	ast_free(session->eventq);
 	if (session->chanvars) {
 		ast_variables_destroy(session->chanvars);
 	}
@@ -2249,6 +2546,7 @@ static struct mansession_session *build_mansession(const struct ast_sockaddr *ad
 	ast_sockaddr_copy(&newsession->addr, addr);
 
 	ast_mutex_init(&newsession->notify_lock);
+	newsession->eventq_max = eventq_size;
 
 	sessions = ao2_global_obj_ref(mgr_sessions);
 	if (sessions) {
@@ -2702,30 +3000,47 @@ static char *handle_showmanconn(struct ast_cli_entry *e, int cmd, struct ast_cli
 }
 
 /*! \brief CLI command manager list eventq */
-/* Should change to "manager show connected" */
 static char *handle_showmaneventq(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
-	struct eventqent *s;
+#define HSMEQ_FORMAT "%-20s %-40s %10s %10s %10s\n"
+#define HSMEQ_FORMAT_DATA "%-20s %-40s %10u %10u %10u\n"
+	struct ao2_container *sessions;
+	struct mansession_session *session;
+	struct ao2_iterator i;
+
 	switch (cmd) {
 	case CLI_INIT:
 		e->command = "manager show eventq";
 		e->usage =
 			"Usage: manager show eventq\n"
-			"	Prints a listing of all events pending in the Asterisk manger\n"
-			"event queue.\n";
+			"	Prints the events pending in the event queue of each\n"
+			"Asterisk manager session and how many of them were dropped.\n";
 		return NULL;
 	case CLI_GENERATE:
 		return NULL;
 	}
-	AST_RWLIST_RDLOCK(&all_events);
-	AST_RWLIST_TRAVERSE(&all_events, s, eq_next) {
-		ast_cli(a->fd, "Usecount: %d\n", s->usecount);
-		ast_cli(a->fd, "Category: %d\n", s->category);
-		ast_cli(a->fd, "Event:\n%s", s->eventdata);
+
+	ast_cli(a->fd, "Queue size: %u  When full: %s\n\n", eventq_size, eventq_full_policy_str(eventq_full));
+	ast_cli(a->fd, HSMEQ_FORMAT, "Username", "IP Address", "Queued", "Max", "Dropped");
+
+	sessions = ao2_global_obj_ref(mgr_sessions);
+	if (sessions) {
+		i = ao2_iterator_init(sessions, 0);
+		ao2_ref(sessions, -1);
+		while ((session = ao2_iterator_next(&i))) {
+			ast_mutex_lock(&session->notify_lock);
+			ast_cli(a->fd, HSMEQ_FORMAT_DATA,
+				session->username, ast_sockaddr_stringify_addr(&session->addr),
+				session->eventq_count, session->eventq_max, session->eventq_dropped);
+			ast_mutex_unlock(&session->notify_lock);
+			unref_mansession(session);
+		}
+		ao2_iterator_destroy(&i);
 	}
-	AST_RWLIST_UNLOCK(&all_events);
 
 	return CLI_SUCCESS;
+#undef HSMEQ_FORMAT
+#undef HSMEQ_FORMAT_DATA
 }
 
 static int reload_module(void);
@@ -2750,22 +3065,81 @@ static char *handle_manager_reload(struct ast_cli_entry *e, int cmd, struct ast_
 	return CLI_SUCCESS;
 }
 
-static struct eventqent *advance_event(struct eventqent *e)
+#define	GET_HEADER_FIRST_MATCH	0
+#define	GET_HEADER_LAST_MATCH	1
+#define	GET_HEADER_SKIP_EMPTY	2
+
+/*!
+ * \brief Index of the header names of the message being processed.
+ *
+ * Actions get several headers of their message, so process_message()
+ * hashes the header names once and lookups compare the hashes before
+ * comparing any text.
+ */
+struct message_index {
+	/*! The indexed message */
+	const struct message *m;
+	/*! Number of headers of the message when it was indexed */
+	unsigned int hdrcount;
+	/*! Case insensitive hash of the name of each header */
+	unsigned int hashes[AST_MAX_MANHEADERS];
+	/*! Length of the name of each header, or -1 if it has no ':' */
+	int name_lens[AST_MAX_MANHEADERS];
+};
+
+/*! The message_index of the message processed by the thread */
+AST_THREADSTORAGE(message_index_ptr);
+
+/*!
+ * \internal
+ * \brief Hash a header name case insensitively.
+ *
+ * \param name Header name, terminated by ':' or NUL.
+ * \param hash Set to the hash of the name.
+ *
+ * \return Length of the name.
+ */
+static int message_header_hash(const char *name, unsigned int *hash)
+{
+	const char *pos = name;
+
+	*hash = 5381;
+	while (*pos && *pos != ':') {
+		*hash = *hash * 33 ^ (unsigned char) tolower(*pos++);
+	}
+
+	return pos - name;
+}
+
+static void message_index_build(struct message_index *index, const struct message *m)
 {
-	struct eventqent *next;
+	unsigned int x;
+
+	index->m = m;
+	index->hdrcount = m->hdrcount;
+	for (x = 0; x < m->hdrcount; x++) {
+		const char *h = m->headers[x];
+		int len = message_header_hash(h, &index->hashes[x]);
 
-	AST_RWLIST_RDLOCK(&all_events);
-	if ((next = AST_RWLIST_NEXT(e, eq_next))) {
-		ast_atomic_fetchadd_int(&next->usecount, 1);
-		ast_atomic_fetchadd_int(&e->usecount, -1);
+		index->name_lens[x] = h[len] == ':' ? len : -1;
 	}
-	AST_RWLIST_UNLOCK(&all_events);
-	return next;
 }
 
-#define	GET_HEADER_FIRST_MATCH	0
-#define	GET_HEADER_LAST_MATCH	1
-#define	GET_HEADER_SKIP_EMPTY	2
+/*!
+ * \internal
+ * \brief Get the index of a message if it is the one processed by the thread.
+ */
+static const struct message_index *message_index_get(const struct message *m)
+{
+	const struct message_index **index;
+
+	index = ast_threadstorage_get(&message_index_ptr, sizeof(*index));
+	if (!index || !*index || (*index)->m != m || (*index)->hdrcount != m->hdrcount) {
+		return NULL;
+	}
+
+	return *index;
+}
 
 /*!
  * \brief Return a matching header value.
@@ -2782,15 +3156,27 @@ static struct eventqent *advance_event(struct eventqent *e)
  */
 static const char *__astman_get_header(const struct message *m, char *var, int mode)
 {
-	int x, l = strlen(var);
+	int x, l;
 	const char *result = "";
+	const struct message_index *index;
+	unsigned int hash;
 
 	if (!m) {
 		return result;
 	}
 
+	l = message_header_hash(var, &hash);
+	index = var[l] ? NULL : message_index_get(m);
+	if (!index) {
+		l = strlen(var);
+	}
+
 	for (x = 0; x < m->hdrcount; x++) {
 		const char *h = m->headers[x];
+
+		if (index && (index->name_lens[x] != l || index->hashes[x] != hash)) {
+			continue;
+		}
 		if (!strncasecmp(var, h, l) && h[l] == ':') {
 			const char *value = h + l + 1;
 			value = ast_skip_blanks(value); /* ignore leading spaces in the value */
@@ -3037,6 +3423,14 @@ static int send_string(struct mansession *s, char *string)
 		return 0;
 	}
 
+	if (s->capture) {
+		if (ast_str_append(&s->capture, 0, "%s", string) < 0) {
+			s->write_error = 1;
+			return -1;
+		}
+		return strlen(string);
+	}
+
 	stream = s->stream ? s->stream : s->session->stream;
 
 	len = strlen(string);
@@ -3508,7 +3902,7 @@ static int authenticate(struct mansession *s, const struct message *m)
 	const char *password = astman_get_header(m, "Secret");
 	int error = -1;
 	struct ast_manager_user *user = NULL;
-	regex_t *regex_filter;
+	struct event_filter_entry *filter;
 	struct ao2_iterator filter_iter;
 
 	if (ast_strlen_zero(username)) {	/* missing username */
@@ -3576,16 +3970,16 @@ static int authenticate(struct mansession *s, const struct message *m)
 	}
 
 	filter_iter = ao2_iterator_init(user->whitefilters, 0);
-	while ((regex_filter = ao2_iterator_next(&filter_iter))) {
-		ao2_t_link(s->session->whitefilters, regex_filter, "add white user filter to session");
-		ao2_t_ref(regex_filter, -1, "remove iterator ref");
+	while ((filter = ao2_iterator_next(&filter_iter))) {
+		ao2_t_link(s->session->whitefilters, filter, "add white user filter to session");
+		ao2_t_ref(filter, -1, "remove iterator ref");
 	}
 	ao2_iterator_destroy(&filter_iter);
 
 	filter_iter = ao2_iterator_init(user->blackfilters, 0);
-	while ((regex_filter = ao2_iterator_next(&filter_iter))) {
-		ao2_t_link(s->session->blackfilters, regex_filter, "add black user filter to session");
-		ao2_t_ref(regex_filter, -1, "remove iterator ref");
+	while ((filter = ao2_iterator_next(&filter_iter))) {
+		ao2_t_link(s->session->blackfilters, filter, "add black user filter to session");
+		ao2_t_ref(filter, -1, "remove iterator ref");
 	}
 	ao2_iterator_destroy(&filter_iter);
 
@@ -3717,6 +4111,19 @@ static int action_listcategories(struct mansession *s, const struct message *m)
 	return 0;
 }
 
+static int action_realtimecacheflush(struct mansession *s, const struct message *m)
+{
+	const char *family = astman_get_header(m, "Family");
+	int count;
+
+	count = ast_realtime_cache_flush(S_OR(family, NULL));
+
+	astman_start_ack(s, m);
+	astman_append(s, "Flushed: %d\r\n\r\n", count);
+
+	return 0;
+}
+
 /*! The amount of space in out must be at least ( 2 * strlen(in) + 1 ) */
 static void json_escape(char *out, const char *in)
 {
@@ -4262,7 +4669,7 @@ static int action_waitevent(struct mansession *s, const struct message *m)
 
 	for (x = 0; x < timeout || timeout < 0; x++) {
 		ao2_lock(s->session);
-		if (AST_RWLIST_NEXT(s->session->last_ev, eq_next)) {
+		if (s->session->eventq_count || s->session->eventq_overflow) {
 			needexit = 1;
 		}
 		if (s->session->needdestroy) {
@@ -4293,20 +4700,16 @@ static int action_waitevent(struct mansession *s, const struct message *m)
 
 	ast_mutex_lock(&s->session->notify_lock);
 	if (s->session->waiting_thread == pthread_self()) {
-		struct eventqent *eqe = s->session->last_ev;
+		struct eventqent *eqe;
 
 		s->session->waiting_thread = AST_PTHREADT_NULL;
 		ast_mutex_unlock(&s->session->notify_lock);
 
 		ao2_lock(s->session);
 		astman_send_response(s, m, "Success", "Waiting for Event completed.");
-		while ((eqe = advance_event(eqe))) {
-			if (((s->session->readperm & eqe->category) == eqe->category)
-				&& ((s->session->send_events & eqe->category) == eqe->category)
-				&& match_filter(s, eqe->eventdata)) {
-				astman_append(s, "%s", eqe->eventdata);
-			}
-			s->session->last_ev = eqe;
+		while ((eqe = session_eventq_pop(s->session))) {
+			astman_append(s, "%s", eqe->eventdata);
+			ao2_ref(eqe, -1);
 		}
 		astman_append(s,
 			"Event: WaitEventComplete\r\n"
@@ -5720,6 +6123,47 @@ aocmessage_cleanup:
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Check whether a session may originate calls to an application
+ *
+ * \retval 0 if allowed
+ * \retval 1 if forbidden, an error has been sent to the session
+ */
+static int originate_app_forbidden(struct mansession *s, const struct message *m,
+	const char *app, const char *appdata)
+{
+	int bad_appdata = 0;
+	char error_buf[64];
+
+	if (ast_strlen_zero(app) || !s->session) {
+		return 0;
+	}
+
+	/* To run the System application (or anything else that goes to
+	 * shell), you must have the additional System privilege */
+	if ((s->session->writeperm & EVENT_FLAG_SYSTEM)
+		|| !(
+			strcasestr(app, "system") ||      /* System(rm -rf /)
+			                                     TrySystem(rm -rf /)       */
+			strcasestr(app, "exec") ||        /* Exec(System(rm -rf /))
+			                                     TryExec(System(rm -rf /)) */
+			strcasestr(app, "agi") ||         /* AGI(/bin/rm,-rf /)
+			                                     EAGI(/bin/rm,-rf /)       */
+			strcasestr(app, "mixmonitor") ||  /* MixMonitor(blah,,rm -rf)  */
+			strcasestr(app, "externalivr") || /* ExternalIVR(rm -rf)       */
+			strcasestr(app, "originate") ||   /* Originate(Local/1234,app,System,rm -rf) */
+			(strstr(appdata, "SHELL") && (bad_appdata = 1)) ||       /* NoOp(${SHELL(rm -rf /)})  */
+			(strstr(appdata, "EVAL") && (bad_appdata = 1))           /* NoOp(${EVAL(${some_var_containing_SHELL})}) */
+			)) {
+		return 0;
+	}
+
+	snprintf(error_buf, sizeof(error_buf), "Originate Access Forbidden: %s", bad_appdata ? "Data" : "Application");
+	astman_send_error(s, m, error_buf);
+	return 1;
+}
+
 static int action_originate(struct mansession *s, const struct message *m)
 {
 	const char *name = astman_get_header(m, "Channel");
@@ -5810,30 +6254,9 @@ static int action_originate(struct mansession *s, const struct message *m)
 		ast_format_cap_update_by_allow_disallow(cap, codecs, 1);
 	}
 
-	if (!ast_strlen_zero(app) && s->session) {
-		int bad_appdata = 0;
-		/* To run the System application (or anything else that goes to
-		 * shell), you must have the additional System privilege */
-		if (!(s->session->writeperm & EVENT_FLAG_SYSTEM)
-			&& (
-				strcasestr(app, "system") ||      /* System(rm -rf /)
-				                                     TrySystem(rm -rf /)       */
-				strcasestr(app, "exec") ||        /* Exec(System(rm -rf /))
-				                                     TryExec(System(rm -rf /)) */
-				strcasestr(app, "agi") ||         /* AGI(/bin/rm,-rf /)
-				                                     EAGI(/bin/rm,-rf /)       */
-				strcasestr(app, "mixmonitor") ||  /* MixMonitor(blah,,rm -rf)  */
-				strcasestr(app, "externalivr") || /* ExternalIVR(rm -rf)       */
-				strcasestr(app, "originate") ||   /* Originate(Local/1234,app,System,rm -rf) */
-				(strstr(appdata, "SHELL") && (bad_appdata = 1)) ||       /* NoOp(${SHELL(rm -rf /)})  */
-				(strstr(appdata, "EVAL") && (bad_appdata = 1))           /* NoOp(${EVAL(${some_var_containing_SHELL})}) */
-				)) {
-			char error_buf[64];
-			snprintf(error_buf, sizeof(error_buf), "Originate Access Forbidden: %s", bad_appdata ? "Data" : "Application");
-			astman_send_error(s, m, error_buf);
-			res = 0;
-			goto fast_orig_cleanup;
-		}
+	if (originate_app_forbidden(s, m, app, appdata)) {
+		res = 0;
+		goto fast_orig_cleanup;
 	}
 
 	/* Check early if the extension exists. If not, we need to bail out here. */
@@ -5933,42 +6356,236 @@ fast_orig_cleanup:
 	return 0;
 }
 
-static int action_mailboxstatus(struct mansession *s, const struct message *m)
+/*! \brief Manager side of an OriginateBatch action */
+struct originate_batch_helper {
+	/*! Number of calls in the batch */
+	int calls;
+	/*! Number of calls answered so far */
+	int answered;
+	/*! Number of calls failed so far */
+	int failed;
+	/*! ActionID header of the action, empty if none */
+	char idtext[0];
+};
+
+static void originate_batch_result(const struct ast_pbx_outgoing_batch_result *result, void *data)
 {
-	const char *mailbox = astman_get_header(m, "Mailbox");
-	int ret;
+	struct originate_batch_helper *helper = data;
 
-	if (ast_strlen_zero(mailbox)) {
-		astman_send_error(s, m, "Mailbox not specified");
-		return 0;
-	}
-	ret = ast_app_has_voicemail(mailbox, NULL);
-	astman_start_ack(s, m);
-	astman_append(s, "Message: Mailbox Status\r\n"
-			 "Mailbox: %s\r\n"
-			 "Waiting: %d\r\n\r\n", mailbox, ret);
-	return 0;
+	ast_atomic_fetchadd_int(result->res ? &helper->failed : &helper->answered, 1);
+
+	manager_event(EVENT_FLAG_CALL, "OriginateBatchResponse",
+		"%s"
+		"Index: %d\r\n"
+		"Response: %s\r\n"
+		"Channel: %s%s%s\r\n"
+		"Reason: %d\r\n"
+		"Uniqueid: %s\r\n",
+		helper->idtext, result->index, result->res ? "Failure" : "Success",
+		result->channel ? result->channel : result->type,
+		result->channel ? "" : "/",
+		result->channel ? "" : result->addr,
+		result->reason, S_OR(result->uniqueid, "<unknown>"));
 }
 
-static int action_mailboxcount(struct mansession *s, const struct message *m)
+static void originate_batch_complete(void *data)
 {
-	const char *mailbox = astman_get_header(m, "Mailbox");
-	int newmsgs = 0, oldmsgs = 0, urgentmsgs = 0;;
+	struct originate_batch_helper *helper = data;
 
-	if (ast_strlen_zero(mailbox)) {
-		astman_send_error(s, m, "Mailbox not specified");
-		return 0;
-	}
-	ast_app_inboxcount2(mailbox, &urgentmsgs, &newmsgs, &oldmsgs);
-	astman_start_ack(s, m);
-	astman_append(s,   "Message: Mailbox Message Count\r\n"
-			   "Mailbox: %s\r\n"
-			   "UrgMessages: %d\r\n"
-			   "NewMessages: %d\r\n"
-			   "OldMessages: %d\r\n"
-			   "\r\n",
-			   mailbox, urgentmsgs, newmsgs, oldmsgs);
-	return 0;
+	manager_event(EVENT_FLAG_CALL, "OriginateBatchComplete",
+		"%s"
+		"Calls: %d\r\n"
+		"Answered: %d\r\n"
+		"Failed: %d\r\n",
+		helper->idtext, helper->calls, helper->answered, helper->failed);
+
+	ast_free(helper);
+}
+
+static int action_originatebatch(struct mansession *s, const struct message *m)
+{
+	const char *exten = astman_get_header(m, "Exten");
+	const char *context = astman_get_header(m, "Context");
+	const char *priority = astman_get_header(m, "Priority");
+	const char *timeout = astman_get_header(m, "Timeout");
+	const char *callerid = astman_get_header(m, "CallerID");
+	const char *app = astman_get_header(m, "Application");
+	const char *id = astman_get_header(m, "ActionID");
+	const char *codecs = astman_get_header(m, "Codecs");
+	const char *cps = astman_get_header(m, "CPS");
+	const char *max_concurrent = astman_get_header(m, "MaxConcurrent");
+	struct ast_pbx_outgoing_batch_options options = {
+		.app = app,
+		.appdata = astman_get_header(m, "Data"),
+		.account = astman_get_header(m, "Account"),
+		.early_media = ast_true(astman_get_header(m, "Earlymedia")),
+		.timeout = 30000,
+		.result_cb = originate_batch_result,
+		.complete_cb = originate_batch_complete,
+	};
+	struct ast_pbx_outgoing_batch *batch = NULL;
+	struct originate_batch_helper *helper = NULL;
+	static const char channel_hdr[] = "Channel:";
+	char *l = NULL, *n = NULL;
+	char tmp[256];
+	int calls = 0;
+	int x;
+
+	options.cap = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+	if (!options.cap) {
+		astman_send_error(s, m, "Internal Error. Memory allocation failure.");
+		return 0;
+	}
+	ast_format_cap_append(options.cap, ast_format_slin, 0);
+	if (!ast_strlen_zero(codecs)) {
+		ast_format_cap_remove_by_type(options.cap, AST_MEDIA_TYPE_UNKNOWN);
+		ast_format_cap_update_by_allow_disallow(options.cap, codecs, 1);
+	}
+
+	if (ast_strlen_zero(app)) {
+		if (ast_strlen_zero(exten) || ast_strlen_zero(context) || ast_strlen_zero(priority)) {
+			astman_send_error(s, m, "OriginateBatch requires 'Application' or 'Exten', 'Context' and 'Priority'");
+			goto batch_cleanup;
+		}
+		if (sscanf(priority, "%30d", &options.priority) != 1
+			&& (options.priority = ast_findlabel_extension(NULL, context, exten, priority, NULL)) < 1) {
+			astman_send_error(s, m, "Invalid priority");
+			goto batch_cleanup;
+		}
+		options.context = context;
+		options.exten = exten;
+	} else if (originate_app_forbidden(s, m, app, options.appdata)) {
+		goto batch_cleanup;
+	}
+
+	if ((!ast_strlen_zero(timeout) && sscanf(timeout, "%30d", &options.timeout) != 1)
+		|| (!ast_strlen_zero(cps) && sscanf(cps, "%30u", &options.cps) != 1)
+		|| (!ast_strlen_zero(max_concurrent) && sscanf(max_concurrent, "%30u", &options.max_concurrent) != 1)) {
+		astman_send_error(s, m, "Invalid Timeout, CPS or MaxConcurrent");
+		goto batch_cleanup;
+	}
+
+	ast_copy_string(tmp, callerid, sizeof(tmp));
+	ast_callerid_parse(tmp, &n, &l);
+	if (l) {
+		ast_shrink_phone_number(l);
+	}
+	options.cid_num = S_OR(l, NULL);
+	options.cid_name = S_OR(n, NULL);
+
+	options.vars = astman_get_variables(m);
+	if (s->session && s->session->chanvars) {
+		struct ast_variable *vars = options.vars;
+
+		/* The variables in the action are appended at the end of the list, to override any user variables that apply */
+		options.vars = ast_variables_dup(s->session->chanvars);
+		if (vars) {
+			ast_variable_list_append(&options.vars, vars);
+		}
+	}
+
+	helper = ast_calloc(1, sizeof(*helper) + (ast_strlen_zero(id) ? 1 : strlen(id) + sizeof("ActionID: \r\n")));
+	if (!helper) {
+		astman_send_error(s, m, "Internal Error. Memory allocation failure.");
+		goto batch_cleanup;
+	}
+	if (!ast_strlen_zero(id)) {
+		sprintf(helper->idtext, "ActionID: %s\r\n", id);
+	}
+	options.data = helper;
+
+	batch = ast_pbx_outgoing_batch_create(&options);
+	if (!batch) {
+		astman_send_error(s, m, "Internal Error. Memory allocation failure.");
+		goto batch_cleanup;
+	}
+
+	for (x = 0; x < m->hdrcount; x++) {
+		char *tech;
+		char *data;
+
+		if (strncasecmp(channel_hdr, m->headers[x], sizeof(channel_hdr) - 1)) {
+			continue;
+		}
+
+		ast_copy_string(tmp, ast_skip_blanks(m->headers[x] + sizeof(channel_hdr) - 1), sizeof(tmp));
+		tech = tmp;
+		data = strchr(tmp, '/');
+		if (!data) {
+			astman_send_error(s, m, "Invalid channel");
+			goto batch_cleanup;
+		}
+		*data++ = '\0';
+
+		if (ast_pbx_outgoing_batch_add(batch, tech, data, NULL)) {
+			astman_send_error(s, m, "Internal Error. Memory allocation failure.");
+			goto batch_cleanup;
+		}
+		calls++;
+	}
+
+	if (!calls) {
+		astman_send_error(s, m, "Channel not specified");
+		goto batch_cleanup;
+	}
+	helper->calls = calls;
+
+	if (ast_pbx_outgoing_batch_start(batch)) {
+		astman_send_error(s, m, "Originate batch failed");
+		goto batch_cleanup;
+	}
+	/* The batch is now responsible for the helper, freeing it once complete. */
+	helper = NULL;
+
+	astman_start_ack(s, m);
+	astman_append(s, "Message: Originate batch successfully queued\r\n"
+		"Calls: %d\r\n"
+		"\r\n", calls);
+
+batch_cleanup:
+	ao2_cleanup(batch);
+	ast_free(helper);
+	ast_variables_destroy(options.vars);
+	ao2_cleanup(options.cap);
+	return 0;
+}
+
+static int action_mailboxstatus(struct mansession *s, const struct message *m)
+{
+	const char *mailbox = astman_get_header(m, "Mailbox");
+	int ret;
+
+	if (ast_strlen_zero(mailbox)) {
+		astman_send_error(s, m, "Mailbox not specified");
+		return 0;
+	}
+	ret = ast_app_has_voicemail(mailbox, NULL);
+	astman_start_ack(s, m);
+	astman_append(s, "Message: Mailbox Status\r\n"
+			 "Mailbox: %s\r\n"
+			 "Waiting: %d\r\n\r\n", mailbox, ret);
+	return 0;
+}
+
+static int action_mailboxcount(struct mansession *s, const struct message *m)
+{
+	const char *mailbox = astman_get_header(m, "Mailbox");
+	int newmsgs = 0, oldmsgs = 0, urgentmsgs = 0;;
+
+	if (ast_strlen_zero(mailbox)) {
+		astman_send_error(s, m, "Mailbox not specified");
+		return 0;
+	}
+	ast_app_inboxcount2(mailbox, &urgentmsgs, &newmsgs, &oldmsgs);
+	astman_start_ack(s, m);
+	astman_append(s,   "Message: Mailbox Message Count\r\n"
+			   "Mailbox: %s\r\n"
+			   "UrgMessages: %d\r\n"
+			   "NewMessages: %d\r\n"
+			   "OldMessages: %d\r\n"
+			   "\r\n",
+			   mailbox, urgentmsgs, newmsgs, oldmsgs);
+	return 0;
 }
 
 static int action_extensionstate(struct mansession *s, const struct message *m)
@@ -6075,13 +6692,109 @@ static int action_timeout(struct mansession *s, const struct message *m)
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Find the value of a header in a formatted event
+ *
+ * \return The start of the value, which runs for value_len characters, or NULL
+ */
+static const char *event_header_value(const char *eventdata, const char *header,
+	size_t header_len, size_t *value_len)
+{
+	const char *line = eventdata;
+	const char *end;
+
+	while ((end = strstr(line, "\r\n")) && end != line) {
+		if (!strncasecmp(line, header, header_len) && line[header_len] == ':') {
+			line += header_len + 1;
+			while (*line == ' ') {
+				++line;
+			}
+			*value_len = end - line;
+			return line;
+		}
+		line = end + 2;
+	}
+
+	return NULL;
+}
+
+static int event_filter_regexec(const regex_t *regex_filter, const char *value, size_t value_len)
+{
+	char buf[256];
+	char *copy = value_len < sizeof(buf) ? buf : ast_malloc(value_len + 1);
+	int res;
+
+	if (!copy) {
+		return 0;
+	}
+	memcpy(copy, value, value_len);
+	copy[value_len] = '\0';
+	res = !regexec(regex_filter, copy, 0, NULL, 0);
+	if (copy != buf) {
+		ast_free(copy);
+	}
+
+	return res;
+}
+
+/*! \brief Check an event against one filter */
+static int event_filter_match(const struct event_filter_entry *filter, const struct eventqent *eqe)
+{
+	const char *value = eqe->eventdata;
+	size_t value_len;
+	size_t len = filter->string_filter_len;
+	size_t i;
+
+	if (filter->event_name && (filter->event_name_hash != eqe->event_name_hash
+		|| strcmp(filter->event_name, eqe->event_name))) {
+		return 0;
+	}
+
+	if (!filter->header_name) {
+		if (filter->match_type == FILTER_MATCH_REGEX) {
+			return !regexec(filter->regex_filter, eqe->eventdata, 0, NULL, 0);
+		}
+		/* Leave out the blank line ending the event */
+		value_len = strlen(value);
+		while (value_len && (value[value_len - 1] == '\r' || value[value_len - 1] == '\n')) {
+			--value_len;
+		}
+	} else if (!(value = event_header_value(eqe->eventdata, filter->header_name,
+		filter->header_name_len, &value_len))) {
+		return 0;
+	}
+
+	switch (filter->match_type) {
+	case FILTER_MATCH_REGEX:
+		return event_filter_regexec(filter->regex_filter, value, value_len);
+	case FILTER_MATCH_EXACT:
+		return value_len == len && !strncmp(value, filter->string_filter, len);
+	case FILTER_MATCH_STARTS_WITH:
+		return value_len >= len && !strncmp(value, filter->string_filter, len);
+	case FILTER_MATCH_ENDS_WITH:
+		return value_len >= len && !strncmp(value + value_len - len, filter->string_filter, len);
+	case FILTER_MATCH_CONTAINS:
+		for (i = 0; i + len <= value_len; ++i) {
+			if (!strncmp(value + i, filter->string_filter, len)) {
+				return 1;
+			}
+		}
+		return 0;
+	case FILTER_MATCH_NONE:
+		return 1;
+	}
+
+	return 0;
+}
+
 static int whitefilter_cmp_fn(void *obj, void *arg, void *data, int flags)
 {
-	regex_t *regex_filter = obj;
-	const char *eventdata = arg;
+	struct event_filter_entry *filter = obj;
+	struct eventqent *eqe = arg;
 	int *result = data;
 
-	if (!regexec(regex_filter, eventdata, 0, NULL, 0)) {
+	if (event_filter_match(filter, eqe)) {
 		*result = 1;
 		return (CMP_MATCH | CMP_STOP);
 	}
@@ -6091,11 +6804,11 @@ static int whitefilter_cmp_fn(void *obj, void *arg, void *data, int flags)
 
 static int blackfilter_cmp_fn(void *obj, void *arg, void *data, int flags)
 {
-	regex_t *regex_filter = obj;
-	const char *eventdata = arg;
+	struct event_filter_entry *filter = obj;
+	struct eventqent *eqe = arg;
 	int *result = data;
 
-	if (!regexec(regex_filter, eventdata, 0, NULL, 0)) {
+	if (event_filter_match(filter, eqe)) {
 		*result = 0;
 		return (CMP_MATCH | CMP_STOP);
 	}
@@ -6110,12 +6823,13 @@ static int blackfilter_cmp_fn(void *obj, void *arg, void *data, int flags)
  */
 static int action_filter(struct mansession *s, const struct message *m)
 {
+	const char *criteria = astman_get_header(m, "MatchCriteria");
 	const char *filter = astman_get_header(m, "Filter");
 	const char *operation = astman_get_header(m, "Operation");
 	int res;
 
 	if (!strcasecmp(operation, "Add")) {
-		res = manager_add_filter(filter, s->session->whitefilters, s->session->blackfilters);
+		res = manager_add_filter(S_OR(criteria, NULL), filter, s->session->whitefilters, s->session->blackfilters);
 
 	        if (res != FILTER_SUCCESS) {
 		        if (res == FILTER_ALLOC_FAILED) {
@@ -6124,6 +6838,9 @@ static int action_filter(struct mansession *s, const struct message *m)
 		        } else if (res == FILTER_COMPILE_FAIL) {
 				astman_send_error(s, m, "Filter did not compile.  Check the syntax of the filter given.");
 		                return 0;
+		        } else if (res == FILTER_FORMAT_ERROR) {
+				astman_send_error(s, m, "Invalid MatchCriteria.  Check the syntax of the criteria given.");
+		                return 0;
 		        } else {
 				astman_send_error(s, m, "Internal Error. Failed adding filter.");
 		                return 0;
@@ -6138,45 +6855,146 @@ static int action_filter(struct mansession *s, const struct message *m)
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Parse the criteria of a structured filter into a filter entry
+ *
+ * \param criteria Comma separated list of action(), name(), header() and method()
+ * \param entry Filter entry to fill in
+ * \param[out] is_blackfilter Set if the filter excludes the events it matches
+ *
+ * \retval 0 on success
+ * \retval -1 if the criteria are invalid
+ */
+static int event_filter_parse_criteria(const char *criteria, struct event_filter_entry *entry,
+	int *is_blackfilter)
+{
+	char *parse = ast_strdupa(criteria);
+	char *item;
+
+	entry->match_type = FILTER_MATCH_REGEX;
+	while ((item = ast_strsep(&parse, ',', AST_STRSEP_STRIP))) {
+		char *value = strchr(item, '(');
+		char *close;
+
+		if (!value || !(close = strrchr(value, ')')) || close[1]) {
+			return -1;
+		}
+		*value++ = '\0';
+		*close = '\0';
+		value = ast_strip(value);
+		item = ast_strip(item);
+
+		if (!strcasecmp(item, "action")) {
+			if (!strcasecmp(value, "include")) {
+				*is_blackfilter = 0;
+			} else if (!strcasecmp(value, "exclude")) {
+				*is_blackfilter = 1;
+			} else {
+				return -1;
+			}
+		} else if (!strcasecmp(item, "name") && !ast_strlen_zero(value) && !entry->event_name) {
+			if (!(entry->event_name = ast_strdup(value))) {
+				return -1;
+			}
+			entry->event_name_hash = ast_str_hash(value);
+		} else if (!strcasecmp(item, "header") && !ast_strlen_zero(value) && !entry->header_name) {
+			if (!(entry->header_name = ast_strdup(value))) {
+				return -1;
+			}
+			/* Allow the header to be given with its colon */
+			if (entry->header_name[strlen(entry->header_name) - 1] == ':') {
+				entry->header_name[strlen(entry->header_name) - 1] = '\0';
+			}
+			entry->header_name_len = strlen(entry->header_name);
+		} else if (!strcasecmp(item, "method")) {
+			if (!strcasecmp(value, "regex")) {
+				entry->match_type = FILTER_MATCH_REGEX;
+			} else if (!strcasecmp(value, "exact")) {
+				entry->match_type = FILTER_MATCH_EXACT;
+			} else if (!strcasecmp(value, "starts_with")) {
+				entry->match_type = FILTER_MATCH_STARTS_WITH;
+			} else if (!strcasecmp(value, "ends_with")) {
+				entry->match_type = FILTER_MATCH_ENDS_WITH;
+			} else if (!strcasecmp(value, "contains")) {
+				entry->match_type = FILTER_MATCH_CONTAINS;
+			} else if (!strcasecmp(value, "none")) {
+				entry->match_type = FILTER_MATCH_NONE;
+			} else {
+				return -1;
+			}
+		} else {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 /*!
  * \brief Add an event filter to a manager session
  *
+ * \param criteria Match criteria of a structured filter, NULL for a regex filter
  * \param filter_pattern  Filter syntax to add, see below for syntax
  *
  * \return FILTER_ALLOC_FAILED   Memory allocation failure
  * \return FILTER_COMPILE_FAIL   If the filter did not compile
+ * \return FILTER_FORMAT_ERROR   If the criteria are invalid
  * \return FILTER_SUCCESS        Success
  *
- * Filter will be used to match against each line of a manager event
+ * Without criteria, the filter will be used to match against each line of a manager event
  * Filter can be any valid regular expression
  * Filter can be a valid regular expression prefixed with !, which will add the filter as a black filter
  *
+ * With criteria, the filter is matched against the value of a header of
+ * the named event using the method given, see the Filter action.
+ *
  * Examples:
  * \code
  *   filter_pattern = "Event: Newchannel"
  *   filter_pattern = "Event: New.*"
  *   filter_pattern = "!Channel: DAHDI.*"
+ *   criteria = "action(exclude),name(Newchannel),header(Channel),method(starts_with)"
+ *   filter_pattern = "DAHDI/"
  * \endcode
  *
  */
-static enum add_filter_result manager_add_filter(const char *filter_pattern, struct ao2_container *whitefilters, struct ao2_container *blackfilters) {
-	regex_t *new_filter = ao2_t_alloc(sizeof(*new_filter), event_filter_destructor, "event_filter allocation");
-	int is_blackfilter;
+static enum add_filter_result manager_add_filter(const char *criteria, const char *filter_pattern, struct ao2_container *whitefilters, struct ao2_container *blackfilters) {
+	struct event_filter_entry *new_filter = ao2_t_alloc(sizeof(*new_filter), event_filter_destructor, "event_filter allocation");
+	int is_blackfilter = 0;
 
 	if (!new_filter) {
 		return FILTER_ALLOC_FAILED;
 	}
 
-	if (filter_pattern[0] == '!') {
+	if (criteria) {
+		if (event_filter_parse_criteria(criteria, new_filter, &is_blackfilter)) {
+			ao2_t_ref(new_filter, -1, "failed to parse criteria");
+			return FILTER_FORMAT_ERROR;
+		}
+	} else if (filter_pattern[0] == '!') {
 		is_blackfilter = 1;
 		filter_pattern++;
-	} else {
-		is_blackfilter = 0;
 	}
 
-	if (regcomp(new_filter, filter_pattern, REG_EXTENDED | REG_NOSUB)) {
-		ao2_t_ref(new_filter, -1, "failed to make regex");
-		return FILTER_COMPILE_FAIL;
+	if (new_filter->match_type == FILTER_MATCH_REGEX) {
+		new_filter->regex_filter = ast_calloc(1, sizeof(*new_filter->regex_filter));
+		if (!new_filter->regex_filter) {
+			ao2_t_ref(new_filter, -1, "failed to allocate regex");
+			return FILTER_ALLOC_FAILED;
+		}
+		if (regcomp(new_filter->regex_filter, filter_pattern, REG_EXTENDED | REG_NOSUB)) {
+			ast_free(new_filter->regex_filter);
+			new_filter->regex_filter = NULL;
+			ao2_t_ref(new_filter, -1, "failed to make regex");
+			return FILTER_COMPILE_FAIL;
+		}
+	} else if (new_filter->match_type != FILTER_MATCH_NONE) {
+		if (!(new_filter->string_filter = ast_strdup(filter_pattern))) {
+			ao2_t_ref(new_filter, -1, "failed to copy filter");
+			return FILTER_ALLOC_FAILED;
+		}
+		new_filter->string_filter_len = strlen(filter_pattern);
 	}
 
 	if (is_blackfilter) {
@@ -6190,29 +7008,29 @@ static enum add_filter_result manager_add_filter(const char *filter_pattern, str
 	return FILTER_SUCCESS;
 }
 
-static int match_filter(struct mansession *s, char *eventdata)
+static int match_filter(struct mansession_session *session, struct eventqent *eqe)
 {
 	int result = 0;
 
 	if (manager_debug) {
-		ast_verbose("<-- Examining AMI event: -->\n%s\n", eventdata);
+		ast_verbose("<-- Examining AMI event: -->\n%s\n", eqe->eventdata);
 	} else {
-		ast_debug(3, "Examining AMI event:\n%s\n", eventdata);
+		ast_debug(3, "Examining AMI event:\n%s\n", eqe->eventdata);
 	}
-	if (!ao2_container_count(s->session->whitefilters) && !ao2_container_count(s->session->blackfilters)) {
+	if (!ao2_container_count(session->whitefilters) && !ao2_container_count(session->blackfilters)) {
 		return 1; /* no filtering means match all */
-	} else if (ao2_container_count(s->session->whitefilters) && !ao2_container_count(s->session->blackfilters)) {
+	} else if (ao2_container_count(session->whitefilters) && !ao2_container_count(session->blackfilters)) {
 		/* white filters only: implied black all filter processed first, then white filters */
-		ao2_t_callback_data(s->session->whitefilters, OBJ_NODATA, whitefilter_cmp_fn, eventdata, &result, "find filter in session filter container");
-	} else if (!ao2_container_count(s->session->whitefilters) && ao2_container_count(s->session->blackfilters)) {
+		ao2_t_callback_data(session->whitefilters, OBJ_NODATA, whitefilter_cmp_fn, eqe, &result, "find filter in session filter container");
+	} else if (!ao2_container_count(session->whitefilters) && ao2_container_count(session->blackfilters)) {
 		/* black filters only: implied white all filter processed first, then black filters */
-		ao2_t_callback_data(s->session->blackfilters, OBJ_NODATA, blackfilter_cmp_fn, eventdata, &result, "find filter in session filter container");
+		ao2_t_callback_data(session->blackfilters, OBJ_NODATA, blackfilter_cmp_fn, eqe, &result, "find filter in session filter container");
 	} else {
 		/* white and black filters: implied black all filter processed first, then white filters, and lastly black filters */
-		ao2_t_callback_data(s->session->whitefilters, OBJ_NODATA, whitefilter_cmp_fn, eventdata, &result, "find filter in session filter container");
+		ao2_t_callback_data(session->whitefilters, OBJ_NODATA, whitefilter_cmp_fn, eqe, &result, "find filter in session filter container");
 		if (result) {
 			result = 0;
-			ao2_t_callback_data(s->session->blackfilters, OBJ_NODATA, blackfilter_cmp_fn, eventdata, &result, "find filter in session filter container");
+			ao2_t_callback_data(session->blackfilters, OBJ_NODATA, blackfilter_cmp_fn, eqe, &result, "find filter in session filter container");
 		}
 	}
 
@@ -6220,7 +7038,7 @@ static int match_filter(struct mansession *s, char *eventdata)
 }
 
 /*!
- * Send any applicable events to the client listening on this socket.
+ * Send the events queued for the client listening on this socket.
  * Wait only for a finite time on each event, and drop all events whether
  * they are successfully sent or not.
  */
@@ -6230,22 +7048,20 @@ static int process_events(struct mansession *s)
 
 	ao2_lock(s->session);
 	if (s->session->stream != NULL) {
-		struct eventqent *eqe = s->session->last_ev;
+		struct eventqent *eqe;
 
-		while ((eqe = advance_event(eqe))) {
+		while ((eqe = session_eventq_pop(s->session))) {
 			if (eqe->category == EVENT_FLAG_SHUTDOWN) {
 				ast_debug(3, "Received CloseSession event\n");
 				ret = -1;
 			}
-			if (!ret && s->session->authenticated &&
-			    (s->session->readperm & eqe->category) == eqe->category &&
-			    (s->session->send_events & eqe->category) == eqe->category) {
-					if (match_filter(s, eqe->eventdata)) {
-						if (send_string(s, eqe->eventdata) < 0)
-							ret = -1;	/* don't send more */
-					}
+			if (!ret && send_string(s, eqe->eventdata) < 0) {
+				ret = -1;	/* don't send more */
 			}
-			s->session->last_ev = eqe;
+			ao2_ref(eqe, -1);
+		}
+		if (s->session->eventq_overflow) {
+			ret = -1;
 		}
 	}
 	ao2_unlock(s->session);
@@ -6604,7 +7420,7 @@ static void log_action(const struct message *m, const char *action)
  * Process an AMI message, performing desired action.
  * Return 0 on success, -1 on error that require the session to be destroyed.
  */
-static int process_message(struct mansession *s, const struct message *m)
+static int process_message_indexed(struct mansession *s, const struct message *m)
 {
 	int ret = 0;
 	struct manager_action *act_found;
@@ -6666,6 +7482,16 @@ static int process_message(struct mansession *s, const struct message *m)
 	}
 
 	act_found = action_find(action);
+	if (act_found && (act_found->list_responses || act_found->final_response)
+		&& ast_overload_level_get() == AST_OVERLOAD_CRITICAL) {
+		/* Listing everything is optional work an overloaded system can skip */
+		ast_debug(1, "Refusing list action '%s' while overloaded\n", act_found->action);
+		ao2_t_ref(act_found, -1, "done with found action object");
+		mansession_lock(s);
+		astman_send_error(s, m, "System overloaded, try again later");
+		mansession_unlock(s);
+		return 0;
+	}
 	if (act_found) {
 		/* Found the requested AMI action. */
 		int acted = 0;
@@ -6715,14 +7541,42 @@ static int process_message(struct mansession *s, const struct message *m)
 	}
 	/* Once done with our message, deliver any pending events unless the
 	   requester doesn't want them as part of this response.
+	   Multiplexed sessions get events in frames of their own.
 	*/
-	if (ast_strlen_zero(astman_get_header(m, "SuppressEvents"))) {
+	if (ast_strlen_zero(astman_get_header(m, "SuppressEvents")) && !s->capture) {
 		return process_events(s);
 	} else {
 		return ret;
 	}
 }
 
+/*!
+ * \brief Index the headers of an AMI message and process it.
+ */
+static int process_message(struct mansession *s, const struct message *m)
+{
+	struct message_index index;
+	const struct message_index **current;
+	const struct message_index *previous = NULL;
+	int ret;
+
+	current = ast_threadstorage_get(&message_index_ptr, sizeof(*current));
+	if (current) {
+		/* Actions may process messages of their own */
+		previous = *current;
+		message_index_build(&index, m);
+		*current = &index;
+	}
+
+	ret = process_message_indexed(s, m);
+
+	if (current) {
+		*current = previous;
+	}
+
+	return ret;
+}
+
 /*!
  * Read one full line (including crlf) from the manager socket.
  * \note \verbatim
@@ -6825,188 +7679,799 @@ static int get_input(struct mansession *s, char *output)
 
 /*!
  * \internal
- * \brief Error handling for sending parse errors. This function handles locking, and clearing the
- * parse error flag.
+ * \brief Error handling for sending parse errors. This function handles locking, and clearing the
+ * parse error flag.
+ *
+ * \param s AMI session to process action request.
+ * \param m Message that's in error.
+ * \param error Error message to send.
+ */
+static void handle_parse_error(struct mansession *s, struct message *m, char *error)
+{
+	mansession_lock(s);
+	astman_send_error(s, m, error);
+	s->parsing = MESSAGE_OKAY;
+	mansession_unlock(s);
+}
+
+/*!
+ * \internal
+ * \brief Read and process an AMI action request.
+ *
+ * \param s AMI session to process action request.
+ *
+ * \retval 0 Retain AMI connection for next command.
+ * \retval -1 Drop AMI connection due to logoff or connection error.
+ */
+static int do_message(struct mansession *s)
+{
+	struct message m = { 0 };
+	char header_buf[sizeof(s->session->inbuf)] = { '\0' };
+	int res;
+	int hdr_loss;
+	time_t now;
+
+	hdr_loss = 0;
+	for (;;) {
+		/* Check if any events are pending and do them if needed */
+		if (process_events(s)) {
+			res = -1;
+			break;
+		}
+		res = get_input(s, header_buf);
+		if (res == 0) {
+			/* No input line received. */
+			if (!s->session->authenticated) {
+				if (time(&now) == -1) {
+					ast_log(LOG_ERROR, "error executing time(): %s\n", strerror(errno));
+					res = -1;
+					break;
+				}
+
+				if (now - s->session->authstart > authtimeout) {
+					if (displayconnects) {
+						ast_verb(2, "Client from %s, failed to authenticate in %d seconds\n", ast_sockaddr_stringify_addr(&s->session->addr), authtimeout);
+					}
+					res = -1;
+					break;
+				}
+			}
+			continue;
+		} else if (res > 0) {
+			/* Input line received. */
+			if (ast_strlen_zero(header_buf)) {
+				if (hdr_loss) {
+					mansession_lock(s);
+					astman_send_error(s, &m, "Too many lines in message or allocation failure");
+					mansession_unlock(s);
+					res = 0;
+				} else {
+					switch (s->parsing) {
+					case MESSAGE_OKAY:
+						res = process_message(s, &m) ? -1 : 0;
+						break;
+					case MESSAGE_LINE_TOO_LONG:
+						handle_parse_error(s, &m, "Failed to parse message: line too long");
+						res = 0;
+						break;
+					}
+				}
+				break;
+			} else if (m.hdrcount < ARRAY_LEN(m.headers)) {
+				m.headers[m.hdrcount] = ast_strdup(header_buf);
+				if (!m.headers[m.hdrcount]) {
+					/* Allocation failure. */
+					hdr_loss = 1;
+				} else {
+					++m.hdrcount;
+				}
+			} else {
+				/* Too many lines in message. */
+				hdr_loss = 1;
+			}
+		} else {
+			/* Input error. */
+			break;
+		}
+	}
+
+	astman_free_headers(&m);
+
+	return res;
+}
+
+/*! \brief The body of the individual manager session.
+ * Call get_input() to read one line at a time
+ * (or be woken up on new events), collect the lines in a
+ * message until found an empty line, and execute the request.
+ * In any case, deliver events asynchronously through process_events()
+ * (called from here if no line is available, or at the end of
+ * process_message(). )
+ */
+static void *session_do(void *data)
+{
+	struct ast_tcptls_session_instance *ser = data;
+	struct mansession_session *session;
+	struct mansession s = {
+		.tcptls_session = data,
+	};
+	int res;
+	int arg = 1;
+	struct ast_sockaddr ser_remote_address_tmp;
+
+	if (ast_atomic_fetchadd_int(&unauth_sessions, +1) >= authlimit) {
+		ast_atomic_fetchadd_int(&unauth_sessions, -1);
+		goto done;
+	}
+
+	ast_sockaddr_copy(&ser_remote_address_tmp, &ser->remote_address);
+	session = build_mansession(&ser_remote_address_tmp);
+
+	if (session == NULL) {
+		ast_atomic_fetchadd_int(&unauth_sessions, -1);
+		goto done;
+	}
+
+	/* here we set TCP_NODELAY on the socket to disable Nagle's algorithm.
+	 * This is necessary to prevent delays (caused by buffering) as we
+	 * write to the socket in bits and pieces. */
+	if (setsockopt(ast_iostream_get_fd(ser->stream), IPPROTO_TCP, TCP_NODELAY, (char *) &arg, sizeof(arg)) < 0) {
+		ast_log(LOG_WARNING, "Failed to set TCP_NODELAY on manager connection: %s\n", strerror(errno));
+	}
+	ast_iostream_nonblock(ser->stream);
+
+	ao2_lock(session);
+	ast_mutex_init(&s.lock);
+
+	/* these fields duplicate those in the 'ser' structure */
+	session->stream = s.stream = ser->stream;
+	ast_sockaddr_copy(&session->addr, &ser_remote_address_tmp);
+	s.session = session;
+
+	AST_LIST_HEAD_INIT_NOLOCK(&session->datastores);
+
+	if(time(&session->authstart) == -1) {
+		ast_log(LOG_ERROR, "error executing time(): %s; disconnecting client\n", strerror(errno));
+		ast_atomic_fetchadd_int(&unauth_sessions, -1);
+		ao2_unlock(session);
+		session_destroy(session);
+		goto done;
+	}
+	ao2_unlock(session);
+
+	/*
+	 * We cannot let the stream exclusively wait for data to arrive.
+	 * We have to wake up the task to send async events.
+	 */
+	ast_iostream_set_exclusive_input(ser->stream, 0);
+
+	ast_iostream_set_timeout_sequence(ser->stream,
+		ast_tvnow(), authtimeout * 1000);
+
+	astman_append(&s, "Asterisk Call Manager/%s\r\n", AMI_VERSION);	/* welcome prompt */
+	for (;;) {
+		if ((res = do_message(&s)) < 0 || s.write_error) {
+			break;
+		}
+		if (session->authenticated) {
+			ast_iostream_set_timeout_disable(ser->stream);
+		}
+	}
+	/* session is over, explain why and terminate */
+	if (session->authenticated) {
+		if (manager_displayconnects(session)) {
+			ast_verb(2, "Manager '%s' logged off from %s\n", session->username, ast_sockaddr_stringify_addr(&session->addr));
+		}
+	} else {
+		ast_atomic_fetchadd_int(&unauth_sessions, -1);
+		if (displayconnects) {
+			ast_verb(2, "Connect attempt from '%s' unable to authenticate\n", ast_sockaddr_stringify_addr(&session->addr));
+		}
+	}
+
+	session_destroy(session);
+
+	ast_mutex_destroy(&s.lock);
+done:
+	ao2_ref(ser, -1);
+	ser = NULL;
+	return NULL;
+}
+
+/*!
+ * \brief Frame types of the multiplexed AMI protocol
+ *
+ * Every frame is a 32 bit length of the rest of the frame, followed
+ * by a type, flags and a 32 bit request id.  The rest of the frame is
+ * a sequence of fields, each a 16 bit length and key followed by a
+ * 16 bit length and value.  All numbers are in network byte order.
+ */
+enum mux_frame_type {
+	/*! An action from the client, which picks its request id */
+	MUX_FRAME_ACTION = 1,
+	/*! One message of the response to the action with the request id */
+	MUX_FRAME_RESPONSE = 2,
+	/*! An event, with a request id of 0 */
+	MUX_FRAME_EVENT = 3,
+};
+
+/*! \brief Flag on the last response frame of an action */
+#define MUX_FLAG_LAST (1 << 0)
+/*! \brief Length of the type, flags and request id of a frame */
+#define MUX_HEADER_LEN 6
+/*! \brief Longest frame taken from a client */
+#define MUX_FRAME_MAX 65536
+/*! \brief Most actions of one multiplexed session running at once */
+#define MUX_INFLIGHT_MAX 32
+
+/*! \brief Threads running the actions of multiplexed sessions */
+static struct ast_threadpool *mux_pool;
+
+/*! \brief Growable buffer of frames */
+struct mux_buf {
+	unsigned char *data;
+	size_t used;
+	size_t alloc;
+	/*! Set when growing failed, after which nothing more is added */
+	int failed;
+};
+
+/*! \brief A multiplexed session, owned by the thread reading from it */
+struct manager_mux {
+	struct mansession_session *session;
+	struct ast_tcptls_session_instance *ser;
+	/*! Protects inflight and hangup */
+	ast_mutex_t lock;
+	/*! Signalled when an action is done */
+	ast_cond_t cond;
+	/*! Serializes writes of the actions and the reading thread */
+	ast_mutex_t write_lock;
+	unsigned int inflight;
+	unsigned int hangup:1;
+	unsigned int write_error:1;
+};
+
+/*! \brief An action of a multiplexed session */
+struct mux_request {
+	struct manager_mux *mux;
+	uint32_t id;
+	/*! Set if the action did not fit in a message */
+	int hdr_loss;
+	struct message m;
+};
+
+static int mux_buf_reserve(struct mux_buf *buf, size_t len)
+{
+	unsigned char *data;
+	size_t alloc;
+
+	if (buf->failed) {
+		return -1;
+	}
+	if (buf->alloc - buf->used >= len) {
+		return 0;
+	}
+
+	alloc = MAX(MAX(buf->alloc * 2, buf->used + len), 256);
+	data = ast_realloc(buf->data, alloc);
+	if (!data) {
+		buf->failed = 1;
+		return -1;
+	}
+	buf->data = data;
+	buf->alloc = alloc;
+
+	return 0;
+}
+
+static void mux_buf_put(struct mux_buf *buf, const void *data, size_t len)
+{
+	if (!mux_buf_reserve(buf, len)) {
+		memcpy(buf->data + buf->used, data, len);
+		buf->used += len;
+	}
+}
+
+static void mux_buf_put_field(struct mux_buf *buf, const char *key, size_t key_len,
+	const char *value, size_t value_len)
+{
+	uint16_t len;
+
+	key_len = MIN(key_len, UINT16_MAX);
+	value_len = MIN(value_len, UINT16_MAX);
+
+	len = htons(key_len);
+	mux_buf_put(buf, &len, sizeof(len));
+	mux_buf_put(buf, key, key_len);
+	len = htons(value_len);
+	mux_buf_put(buf, &len, sizeof(len));
+	mux_buf_put(buf, value, value_len);
+}
+
+/*!
+ * \internal
+ * \brief Start a frame, to be finished with mux_frame_finish()
+ *
+ * \return Offset of the frame in the buffer
+ */
+static size_t mux_frame_start(struct mux_buf *buf, enum mux_frame_type type, uint32_t id)
+{
+	size_t start = buf->used;
+	unsigned char header[4 + MUX_HEADER_LEN] = { 0, };
+
+	header[4] = type;
+	id = htonl(id);
+	memcpy(header + 6, &id, sizeof(id));
+	mux_buf_put(buf, header, sizeof(header));
+
+	return start;
+}
+
+static void mux_frame_finish(struct mux_buf *buf, size_t start, unsigned int flags)
+{
+	uint32_t len;
+
+	if (buf->failed) {
+		return;
+	}
+	len = htonl(buf->used - start - 4);
+	memcpy(buf->data + start, &len, sizeof(len));
+	buf->data[start + 5] = flags;
+}
+
+/*!
+ * \internal
+ * \brief Add the lines of one AMI message to a frame as fields
+ *
+ * Lines without a colon, like the output of a CLI command, become
+ * fields with an empty key.
+ *
+ * \return Where the message after this one starts
+ */
+static const char *mux_frame_put_message(struct mux_buf *buf, const char *text)
+{
+	while (*text) {
+		const char *eol = strchr(text, '\n');
+		const char *end = eol ? eol : text + strlen(text);
+		const char *next = eol ? eol + 1 : end;
+		const char *colon;
+
+		if (end > text && end[-1] == '\r') {
+			--end;
+		}
+		if (end == text) {
+			/* A blank line ends the message */
+			return next;
+		}
+
+		colon = memchr(text, ':', end - text);
+		if (colon) {
+			const char *value = colon + 1;
+
+			while (value < end && *value == ' ') {
+				++value;
+			}
+			mux_buf_put_field(buf, text, colon - text, value, end - value);
+		} else {
+			mux_buf_put_field(buf, "", 0, text, end - text);
+		}
+		text = next;
+	}
+
+	return text;
+}
+
+static const char *mux_skip_blank_lines(const char *text)
+{
+	while (*text == '\r' || *text == '\n') {
+		++text;
+	}
+	return text;
+}
+
+static int mux_write(struct manager_mux *mux, const struct mux_buf *buf)
+{
+	struct ast_iostream *stream = mux->ser->stream;
+	int res = -1;
+
+	ast_mutex_lock(&mux->write_lock);
+	if (!mux->write_error) {
+		ast_iostream_set_timeout_inactivity(stream, mux->session->writetimeout);
+		if (ast_iostream_write(stream, buf->data, buf->used) == buf->used) {
+			res = 0;
+		} else {
+			mux->write_error = 1;
+		}
+		ast_iostream_set_timeout_disable(stream);
+	}
+	ast_mutex_unlock(&mux->write_lock);
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Send the output of an action, one response frame for each message in it
+ */
+static int mux_send_response(struct manager_mux *mux, uint32_t id, const char *text)
+{
+	struct mux_buf buf = { 0, };
+	int res;
+
+	text = mux_skip_blank_lines(text);
+	do {
+		size_t start = mux_frame_start(&buf, MUX_FRAME_RESPONSE, id);
+
+		text = mux_skip_blank_lines(mux_frame_put_message(&buf, text));
+		mux_frame_finish(&buf, start, *text ? 0 : MUX_FLAG_LAST);
+	} while (*text);
+
+	res = buf.failed ? -1 : mux_write(mux, &buf);
+	ast_free(buf.data);
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Send the events queued for a multiplexed session in one write
+ *
+ * \retval 0 on success
+ * \retval -1 if the session is to be closed
+ */
+static int mux_send_events(struct manager_mux *mux)
+{
+	struct mux_buf buf = { 0, };
+	struct eventqent *eqe;
+	int res = 0;
+
+	while ((eqe = session_eventq_pop(mux->session))) {
+		if (eqe->category == EVENT_FLAG_SHUTDOWN) {
+			ast_debug(3, "Received CloseSession event\n");
+			res = -1;
+		} else if (!res) {
+			size_t start = mux_frame_start(&buf, MUX_FRAME_EVENT, 0);
+
+			mux_frame_put_message(&buf, eqe->eventdata);
+			mux_frame_finish(&buf, start, 0);
+		}
+		ao2_ref(eqe, -1);
+	}
+	if (mux->session->eventq_overflow || buf.failed) {
+		res = -1;
+	}
+
+	if (!res && buf.used) {
+		res = mux_write(mux, &buf);
+	}
+	ast_free(buf.data);
+
+	return res;
+}
+
+static void mux_wake(struct manager_mux *mux)
+{
+	ast_mutex_lock(&mux->session->notify_lock);
+	session_wake(mux->session);
+	ast_mutex_unlock(&mux->session->notify_lock);
+}
+
+/*!
+ * \internal
+ * \brief Run an action of a multiplexed session and send its response
+ */
+static int mux_request_run(void *data)
+{
+	struct mux_request *req = data;
+	struct manager_mux *mux = req->mux;
+	struct mansession s = {
+		.session = mux->session,
+		.stream = mux->ser->stream,
+		.tcptls_session = mux->ser,
+	};
+	int res = -1;
+
+	ast_mutex_init(&s.lock);
+	s.capture = ast_str_create(256);
+	if (s.capture) {
+		if (req->hdr_loss) {
+			astman_send_error(&s, &req->m, "Too many lines in message or allocation failure");
+			res = 0;
+		} else if (!strcasecmp(astman_get_header(&req->m, "Action"), "WaitEvent")) {
+			astman_send_error(&s, &req->m, "Events are sent as they happen on multiplexed sessions");
+			res = 0;
+		} else {
+			res = process_message(&s, &req->m);
+		}
+		if (mux_send_response(mux, req->id, ast_str_buffer(s.capture))) {
+			res = -1;
+		}
+	}
+	ast_free(s.capture);
+	ast_mutex_destroy(&s.lock);
+
+	ast_mutex_lock(&mux->lock);
+	if (res || s.write_error) {
+		mux->hangup = 1;
+		mux_wake(mux);
+	}
+	--mux->inflight;
+	ast_cond_signal(&mux->cond);
+	ast_mutex_unlock(&mux->lock);
+
+	astman_free_headers(&req->m);
+	ast_free(req);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Take an action frame off the wire and get it run
+ *
+ * \retval 0 on success
+ * \retval -1 if the frame is malformed or memory ran out
+ */
+static int mux_dispatch(struct manager_mux *mux, const unsigned char *frame, uint32_t len)
+{
+	const unsigned char *pos = frame + MUX_HEADER_LEN;
+	const unsigned char *end = frame + len;
+	struct mux_request *req;
+	uint32_t id;
+
+	if (frame[0] != MUX_FRAME_ACTION) {
+		ast_log(LOG_WARNING, "Unexpected frame type %u on multiplexed AMI session from %s\n",
+			frame[0], ast_sockaddr_stringify_addr(&mux->session->addr));
+		return -1;
+	}
+
+	req = ast_calloc(1, sizeof(*req));
+	if (!req) {
+		return -1;
+	}
+	memcpy(&id, frame + 2, sizeof(id));
+	req->id = ntohl(id);
+	req->mux = mux;
+
+	while (pos < end) {
+		uint16_t key_len;
+		uint16_t value_len;
+		const unsigned char *key;
+		char *header;
+
+		if (end - pos < 2) {
+			goto malformed;
+		}
+		memcpy(&key_len, pos, sizeof(key_len));
+		key_len = ntohs(key_len);
+		key = pos + 2;
+		pos = key + key_len;
+		if (end - pos < 2) {
+			goto malformed;
+		}
+		memcpy(&value_len, pos, sizeof(value_len));
+		value_len = ntohs(value_len);
+		pos += 2;
+		if (end - pos < value_len) {
+			goto malformed;
+		}
+
+		if (req->m.hdrcount == ARRAY_LEN(req->m.headers)) {
+			req->hdr_loss = 1;
+		} else if ((header = ast_malloc(key_len + value_len + 3))) {
+			memcpy(header, key, key_len);
+			memcpy(header + key_len, ": ", 2);
+			memcpy(header + key_len + 2, pos, value_len);
+			header[key_len + value_len + 2] = '\0';
+			req->m.headers[req->m.hdrcount++] = header;
+		} else {
+			req->hdr_loss = 1;
+		}
+		pos += value_len;
+	}
+
+	ast_mutex_lock(&mux->lock);
+	while (mux->inflight >= MUX_INFLIGHT_MAX && !mux->hangup) {
+		ast_cond_wait(&mux->cond, &mux->lock);
+	}
+	++mux->inflight;
+	ast_mutex_unlock(&mux->lock);
+
+	/*
+	 * Nothing may overtake a login, nor anything follow a logoff, so those
+	 * run here.  The rest may run alongside each other and finish in any
+	 * order, the request id tells the client which response is which.
+	 */
+	if (!mux->session->authenticated
+		|| !strcasecmp(astman_get_header(&req->m, "Action"), "Logoff")
+		|| ast_threadpool_push(mux_pool, mux_request_run, req)) {
+		mux_request_run(req);
+	}
+
+	return 0;
+
+malformed:
+	ast_log(LOG_WARNING, "Malformed frame on multiplexed AMI session from %s\n",
+		ast_sockaddr_stringify_addr(&mux->session->addr));
+	astman_free_headers(&req->m);
+	ast_free(req);
+	return -1;
+}
+
+/*!
+ * \internal
+ * \brief Dispatch the complete frames read so far
  *
- * \param s AMI session to process action request.
- * \param m Message that's in error.
- * \param error Error message to send.
+ * \retval 0 on success
+ * \retval -1 if the session is to be closed
  */
-static void handle_parse_error(struct mansession *s, struct message *m, char *error)
+static int mux_process_input(struct manager_mux *mux, struct mux_buf *in)
 {
-	mansession_lock(s);
-	astman_send_error(s, m, error);
-	s->parsing = MESSAGE_OKAY;
-	mansession_unlock(s);
+	size_t pos = 0;
+	int res = 0;
+
+	while (in->used - pos >= 4) {
+		uint32_t len;
+
+		memcpy(&len, in->data + pos, sizeof(len));
+		len = ntohl(len);
+		if (len < MUX_HEADER_LEN || len > MUX_FRAME_MAX) {
+			ast_log(LOG_WARNING, "Frame of %u bytes on multiplexed AMI session from %s\n",
+				len, ast_sockaddr_stringify_addr(&mux->session->addr));
+			res = -1;
+			break;
+		}
+		if (in->used - pos - 4 < len) {
+			break;
+		}
+		if (mux_dispatch(mux, in->data + pos + 4, len)) {
+			res = -1;
+			break;
+		}
+		pos += 4 + len;
+	}
+
+	in->used -= pos;
+	memmove(in->data, in->data + pos, in->used);
+
+	return res;
 }
 
 /*!
  * \internal
- * \brief Read and process an AMI action request.
- *
- * \param s AMI session to process action request.
+ * \brief Wait for input on a multiplexed session, or to be woken for events
  *
- * \retval 0 Retain AMI connection for next command.
- * \retval -1 Drop AMI connection due to logoff or connection error.
+ * \retval 1 if input can be read
+ * \retval 0 if woken or timed out
+ * \retval -1 on error
  */
-static int do_message(struct mansession *s)
+static int mux_wait_for_input(struct manager_mux *mux, int timeout)
 {
-	struct message m = { 0 };
-	char header_buf[sizeof(s->session->inbuf)] = { '\0' };
+	struct mansession_session *session = mux->session;
 	int res;
-	int hdr_loss;
-	time_t now;
-
-	hdr_loss = 0;
-	for (;;) {
-		/* Check if any events are pending and do them if needed */
-		if (process_events(s)) {
-			res = -1;
-			break;
-		}
-		res = get_input(s, header_buf);
-		if (res == 0) {
-			/* No input line received. */
-			if (!s->session->authenticated) {
-				if (time(&now) == -1) {
-					ast_log(LOG_ERROR, "error executing time(): %s\n", strerror(errno));
-					res = -1;
-					break;
-				}
 
-				if (now - s->session->authstart > authtimeout) {
-					if (displayconnects) {
-						ast_verb(2, "Client from %s, failed to authenticate in %d seconds\n", ast_sockaddr_stringify_addr(&s->session->addr), authtimeout);
-					}
-					res = -1;
-					break;
-				}
-			}
-			continue;
-		} else if (res > 0) {
-			/* Input line received. */
-			if (ast_strlen_zero(header_buf)) {
-				if (hdr_loss) {
-					mansession_lock(s);
-					astman_send_error(s, &m, "Too many lines in message or allocation failure");
-					mansession_unlock(s);
-					res = 0;
-				} else {
-					switch (s->parsing) {
-					case MESSAGE_OKAY:
-						res = process_message(s, &m) ? -1 : 0;
-						break;
-					case MESSAGE_LINE_TOO_LONG:
-						handle_parse_error(s, &m, "Failed to parse message: line too long");
-						res = 0;
-						break;
-					}
-				}
-				break;
-			} else if (m.hdrcount < ARRAY_LEN(m.headers)) {
-				m.headers[m.hdrcount] = ast_strdup(header_buf);
-				if (!m.headers[m.hdrcount]) {
-					/* Allocation failure. */
-					hdr_loss = 1;
-				} else {
-					++m.hdrcount;
-				}
-			} else {
-				/* Too many lines in message. */
-				hdr_loss = 1;
-			}
-		} else {
-			/* Input error. */
-			break;
-		}
+	ast_mutex_lock(&session->notify_lock);
+	if (session->pending_event) {
+		session->pending_event = 0;
+		ast_mutex_unlock(&session->notify_lock);
+		return 0;
 	}
+	session->waiting_thread = pthread_self();
+	ast_mutex_unlock(&session->notify_lock);
 
-	astman_free_headers(&m);
+	res = ast_wait_for_input(ast_iostream_get_fd(session->stream), timeout);
 
-	return res;
+	ast_mutex_lock(&session->notify_lock);
+	session->waiting_thread = AST_PTHREADT_NULL;
+	ast_mutex_unlock(&session->notify_lock);
+
+	if (res < 0 && (errno == EINTR || errno == EAGAIN)) {
+		return 0;
+	}
+	if (res < 0) {
+		ast_log(LOG_WARNING, "poll() returned error: %s\n", strerror(errno));
+	}
+	return res > 0 ? 1 : res;
 }
 
-/*! \brief The body of the individual manager session.
- * Call get_input() to read one line at a time
- * (or be woken up on new events), collect the lines in a
- * message until found an empty line, and execute the request.
- * In any case, deliver events asynchronously through process_events()
- * (called from here if no line is available, or at the end of
- * process_message(). )
+/*! \brief The body of a multiplexed manager session.
+ * Read frames and hand the actions in them to the mux_pool, sending
+ * the responses back tagged with the request id of each as they are
+ * done, and events in frames of their own in between.
  */
-static void *session_do(void *data)
+static void *mux_session_do(void *data)
 {
 	struct ast_tcptls_session_instance *ser = data;
 	struct mansession_session *session;
-	struct mansession s = {
-		.tcptls_session = data,
+	struct manager_mux mux = {
+		.ser = ser,
 	};
-	int res;
+	struct mux_buf in = { 0, };
 	int arg = 1;
-	struct ast_sockaddr ser_remote_address_tmp;
 
 	if (ast_atomic_fetchadd_int(&unauth_sessions, +1) >= authlimit) {
 		ast_atomic_fetchadd_int(&unauth_sessions, -1);
 		goto done;
 	}
 
-	ast_sockaddr_copy(&ser_remote_address_tmp, &ser->remote_address);
-	session = build_mansession(&ser_remote_address_tmp);
-
-	if (session == NULL) {
+	session = build_mansession(&ser->remote_address);
+	if (!session) {
 		ast_atomic_fetchadd_int(&unauth_sessions, -1);
 		goto done;
 	}
 
-	/* here we set TCP_NODELAY on the socket to disable Nagle's algorithm.
-	 * This is necessary to prevent delays (caused by buffering) as we
-	 * write to the socket in bits and pieces. */
 	if (setsockopt(ast_iostream_get_fd(ser->stream), IPPROTO_TCP, TCP_NODELAY, (char *) &arg, sizeof(arg)) < 0) {
 		ast_log(LOG_WARNING, "Failed to set TCP_NODELAY on manager connection: %s\n", strerror(errno));
 	}
 	ast_iostream_nonblock(ser->stream);
+	ast_iostream_set_exclusive_input(ser->stream, 0);
 
 	ao2_lock(session);
-	/* Hook to the tail of the event queue */
-	session->last_ev = grab_last();
+	session->stream = ser->stream;
+	AST_LIST_HEAD_INIT_NOLOCK(&session->datastores);
+	time(&session->authstart);
+	ao2_unlock(session);
 
-	ast_mutex_init(&s.lock);
+	mux.session = session;
+	ast_mutex_init(&mux.lock);
+	ast_cond_init(&mux.cond, NULL);
+	ast_mutex_init(&mux.write_lock);
 
-	/* these fields duplicate those in the 'ser' structure */
-	session->stream = s.stream = ser->stream;
-	ast_sockaddr_copy(&session->addr, &ser_remote_address_tmp);
-	s.session = session;
+	for (;;) {
+		int timeout = -1;
+		int res;
 
-	AST_LIST_HEAD_INIT_NOLOCK(&session->datastores);
+		if (mux_send_events(&mux)) {
+			break;
+		}
 
-	if(time(&session->authstart) == -1) {
-		ast_log(LOG_ERROR, "error executing time(): %s; disconnecting client\n", strerror(errno));
-		ast_atomic_fetchadd_int(&unauth_sessions, -1);
-		ao2_unlock(session);
-		session_destroy(session);
-		goto done;
-	}
-	ao2_unlock(session);
+		ast_mutex_lock(&mux.lock);
+		res = mux.hangup || mux.write_error;
+		ast_mutex_unlock(&mux.lock);
+		if (res) {
+			break;
+		}
 
-	/*
-	 * We cannot let the stream exclusively wait for data to arrive.
-	 * We have to wake up the task to send async events.
-	 */
-	ast_iostream_set_exclusive_input(ser->stream, 0);
+		if (!session->authenticated) {
+			timeout = (authtimeout - (time(NULL) - session->authstart)) * 1000;
+			if (timeout <= 0) {
+				if (displayconnects) {
+					ast_verb(2, "Client from %s, failed to authenticate in %d seconds\n",
+						ast_sockaddr_stringify_addr(&session->addr), authtimeout);
+				}
+				break;
+			}
+		}
 
-	ast_iostream_set_timeout_sequence(ser->stream,
-		ast_tvnow(), authtimeout * 1000);
+		res = mux_wait_for_input(&mux, timeout);
+		if (res < 0) {
+			break;
+		} else if (!res) {
+			continue;
+		}
 
-	astman_append(&s, "Asterisk Call Manager/%s\r\n", AMI_VERSION);	/* welcome prompt */
-	for (;;) {
-		if ((res = do_message(&s)) < 0 || s.write_error) {
+		if (mux_buf_reserve(&in, 4096)) {
 			break;
 		}
-		if (session->authenticated) {
-			ast_iostream_set_timeout_disable(ser->stream);
+		res = ast_iostream_read(ser->stream, in.data + in.used, in.alloc - in.used);
+		if (res < 1) {
+			break;
+		}
+		in.used += res;
+
+		if (mux_process_input(&mux, &in)) {
+			break;
 		}
 	}
-	/* session is over, explain why and terminate */
+
+	/* The actions still running use the session, let them finish first */
+	ast_mutex_lock(&mux.lock);
+	mux.hangup = 1;
+	while (mux.inflight) {
+		ast_cond_wait(&mux.cond, &mux.lock);
+	}
+	ast_mutex_unlock(&mux.lock);
+
 	if (session->authenticated) {
 		if (manager_displayconnects(session)) {
 			ast_verb(2, "Manager '%s' logged off from %s\n", session->username, ast_sockaddr_stringify_addr(&session->addr));
@@ -7020,10 +8485,12 @@ static void *session_do(void *data)
 
 	session_destroy(session);
 
-	ast_mutex_destroy(&s.lock);
+	ast_mutex_destroy(&mux.write_lock);
+	ast_cond_destroy(&mux.cond);
+	ast_mutex_destroy(&mux.lock);
+	ast_free(in.data);
 done:
 	ao2_ref(ser, -1);
-	ser = NULL;
 	return NULL;
 }
 
@@ -7043,7 +8510,8 @@ static void purge_sessions(int n_max)
 	ao2_ref(sessions, -1);
 	while ((session = ao2_iterator_next(&i)) && n_max > 0) {
 		ao2_lock(session);
-		if (session->sessiontimeout && (now > session->sessiontimeout) && !session->inuse) {
+		if (session->sessiontimeout && (now > session->sessiontimeout || session->eventq_overflow)
+			&& !session->inuse) {
 			if (session->authenticated
 				&& VERBOSITY_ATLEAST(2)
 				&& manager_displayconnects(session)) {
@@ -7061,30 +8529,81 @@ static void purge_sessions(int n_max)
 	ao2_iterator_destroy(&i);
 }
 
+/*!
+ * \internal
+ * \brief Check if a session may get events of a category, before any filter
+ */
+static int session_wants_category(struct mansession_session *session, int category)
+{
+	return category == EVENT_FLAG_SHUTDOWN
+		|| (session->authenticated
+			&& (session->readperm & category) == category
+			&& (session->send_events & category) == category);
+}
+
+static int session_wants_category_cb(void *obj, void *arg, int flags)
+{
+	return session_wants_category(obj, *(int *) arg) ? CMP_MATCH | CMP_STOP : 0;
+}
+
+/*! \brief Check if any session may get events of a category */
+static int any_session_wants_category(struct ao2_container *sessions, int category)
+{
+	struct mansession_session *session;
+
+	if (!sessions) {
+		return 0;
+	}
+	session = ao2_callback(sessions, 0, session_wants_category_cb, &category);
+	if (!session) {
+		return 0;
+	}
+	unref_mansession(session);
+	return 1;
+}
+
 /*! \brief
- * events are appended to a queue from where they
- * can be dispatched to clients.
+ * events are appended to the queue of each session
+ * that wants them, from where they are dispatched to clients.
  */
-static int append_event(const char *str, int category)
+static int append_event(struct ao2_container *sessions, const char *str, size_t len, int category)
 {
-	struct eventqent *tmp = ast_malloc(sizeof(*tmp) + strlen(str));
-	static int seq;	/* sequence number */
+	struct eventqent *tmp;
+	struct mansession_session *session;
+	struct ao2_iterator iter;
+	size_t name_len = 0;
+	char *name;
+
+	if (!sessions) {
+		return 0;
+	}
 
+	if (!strncmp(str, "Event: ", 7)) {
+		name_len = strcspn(str + 7, "\r\n");
+	}
+	tmp = ao2_alloc_options(sizeof(*tmp) + len + name_len + 1, NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!tmp) {
 		return -1;
 	}
-
-	/* need to init all fields, because ast_malloc() does not */
-	tmp->usecount = 0;
 	tmp->category = category;
-	tmp->seq = ast_atomic_fetchadd_int(&seq, 1);
-	tmp->tv = ast_tvnow();
-	AST_RWLIST_NEXT(tmp, eq_next) = NULL;
-	strcpy(tmp->eventdata, str);
-
-	AST_RWLIST_WRLOCK(&all_events);
-	AST_RWLIST_INSERT_TAIL(&all_events, tmp, eq_next);
-	AST_RWLIST_UNLOCK(&all_events);
+	memcpy(tmp->eventdata, str, len + 1);
+	/* The event name is kept after the event data for the filters */
+	name = tmp->eventdata + len + 1;
+	ast_copy_string(name, name_len ? str + 7 : "", name_len + 1);
+	tmp->event_name = name;
+	tmp->event_name_hash = ast_str_hash(name);
+
+	iter = ao2_iterator_init(sessions, 0);
+	while ((session = ao2_iterator_next(&iter))) {
+		/* Filter once here instead of on every read of the event */
+		if (session_wants_category(session, category)
+			&& (category == EVENT_FLAG_SHUTDOWN || match_filter(session, tmp))) {
+			session_eventq_push(session, tmp);
+		}
+		unref_mansession(session);
+	}
+	ao2_iterator_destroy(&iter);
+	ao2_ref(tmp, -1);
 
 	return 0;
 }
@@ -7127,6 +8646,11 @@ static int __attribute__((format(printf, 9, 0))) __manager_event_sessions_va(
 	struct ast_str *buf;
 	int i;
 
+	/* Skip formatting an event no session would get */
+	if (AST_RWLIST_EMPTY(&manager_hooks) && !any_session_wants_category(sessions, category)) {
+		return 0;
+	}
+
 	buf = ast_str_thread_get(&manager_event_buf, MANAGER_EVENT_BUF_INITSIZE);
 	if (!buf) {
 		return -1;
@@ -7169,31 +8693,11 @@ static int __attribute__((format(printf, 9, 0))) __manager_event_sessions_va(
 
 	ast_str_append(&buf, 0, "\r\n");
 
-	append_event(ast_str_buffer(buf), category);
-
-	/* Wake up any sleeping sessions */
-	if (sessions) {
-		struct ao2_iterator iter;
-		struct mansession_session *session;
-
-		iter = ao2_iterator_init(sessions, 0);
-		while ((session = ao2_iterator_next(&iter))) {
-			ast_mutex_lock(&session->notify_lock);
-			if (session->waiting_thread != AST_PTHREADT_NULL) {
-				pthread_kill(session->waiting_thread, SIGURG);
-			} else {
-				/* We have an event to process, but the mansession is
-				 * not waiting for it. We still need to indicate that there
-				 * is an event waiting so that get_input processes the pending
-				 * event instead of polling.
-				 */
-				session->pending_event = 1;
-			}
-			ast_mutex_unlock(&session->notify_lock);
-			unref_mansession(session);
-		}
-		ao2_iterator_destroy(&iter);
-	}
+	/*
+	 * The event was formatted in the buffer of the thread, so the event
+	 * queued on the sessions is the only allocation.
+	 */
+	append_event(sessions, ast_str_buffer(buf), ast_str_strlen(buf), category);
 
 	if (category != EVENT_FLAG_SHUTDOWN && !AST_RWLIST_EMPTY(&manager_hooks)) {
 		struct manager_custom_hook *hook;
@@ -7951,7 +9455,6 @@ static int generic_http_callback(struct ast_tcptls_session_instance *ser,
 		 */
 		while ((session->managerid = ast_random() ^ (unsigned long) session) == 0) {
 		}
-		session->last_ev = grab_last();
 		AST_LIST_HEAD_INIT_NOLOCK(&session->datastores);
 	}
 	ao2_unlock(session);
@@ -8260,7 +9763,6 @@ static int auth_http_callback(struct ast_tcptls_session_instance *ser,
 
 		ast_copy_string(session->username, u_username, sizeof(session->username));
 		session->managerid = nonce;
-		session->last_ev = grab_last();
 		AST_LIST_HEAD_INIT_NOLOCK(&session->datastores);
 
 		session->readperm = u_readperm;
@@ -8636,7 +10138,6 @@ static int webregged = 0;
 static void purge_old_stuff(void *data)
 {
 	purge_sessions(1);
-	purge_events();
 }
 
 static struct ast_tls_config ami_tls_cfg;
@@ -8661,6 +10162,16 @@ static struct ast_tcptls_session_args amis_desc = {
 	.worker_fn = session_do,	/* thread handling the session */
 };
 
+static struct ast_tcptls_session_args amim_desc = {
+	.accept_fd = -1,
+	.master = AST_PTHREADT_NULL,
+	.tls_cfg = NULL,
+	.poll_timeout = -1,	/* the other does the periodic cleanup */
+	.name = "AMI multiplexed server",
+	.accept_fn = ast_tcptls_server_root,	/* thread doing the accept() */
+	.worker_fn = mux_session_do,	/* thread handling the session */
+};
+
 /*! \brief CLI command manager show settings */
 static char *handle_manager_show_settings(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
@@ -8685,11 +10196,14 @@ static char *handle_manager_show_settings(struct ast_cli_entry *e, int cmd, stru
 	ast_cli(a->fd, FORMAT, "Web Manager (AMI/HTTP):", AST_CLI_YESNO(webmanager_enabled));
 	ast_cli(a->fd, FORMAT, "TCP Bindaddress:", manager_enabled != 0 ? ast_sockaddr_stringify(&ami_desc.local_address) : "Disabled");
 	ast_cli(a->fd, FORMAT2, "HTTP Timeout (seconds):", httptimeout);
+	ast_cli(a->fd, FORMAT2, "Event queue size:", eventq_size);
+	ast_cli(a->fd, FORMAT, "Event queue full:", eventq_full_policy_str(eventq_full));
 	ast_cli(a->fd, FORMAT, "TLS Enable:", AST_CLI_YESNO(ami_tls_cfg.enabled));
 	ast_cli(a->fd, FORMAT, "TLS Bindaddress:", ami_tls_cfg.enabled != 0 ? ast_sockaddr_stringify(&amis_desc.local_address) : "Disabled");
 	ast_cli(a->fd, FORMAT, "TLS Certfile:", ami_tls_cfg.certfile);
 	ast_cli(a->fd, FORMAT, "TLS Privatekey:", ami_tls_cfg.pvtfile);
 	ast_cli(a->fd, FORMAT, "TLS Cipher:", ami_tls_cfg.cipher);
+	ast_cli(a->fd, FORMAT, "Multiplexed Bindaddress:", mux_enabled && manager_enabled ? ast_sockaddr_stringify(&amim_desc.local_address) : "Disabled");
 	ast_cli(a->fd, FORMAT, "Allow multiple login:", AST_CLI_YESNO(allowmultiplelogin));
 	ast_cli(a->fd, FORMAT, "Display connects:", AST_CLI_YESNO(displayconnects));
 	ast_cli(a->fd, FORMAT, "Timestamp events:", AST_CLI_YESNO(timestampevents));
@@ -8975,10 +10489,12 @@ static void manager_shutdown(void)
 	ast_manager_unregister("UpdateConfig");
 	ast_manager_unregister("CreateConfig");
 	ast_manager_unregister("ListCategories");
+	ast_manager_unregister("RealtimeCacheFlush");
 	ast_manager_unregister("Redirect");
 	ast_manager_unregister("Atxfer");
 	ast_manager_unregister("CancelAtxfer");
 	ast_manager_unregister("Originate");
+	ast_manager_unregister("OriginateBatch");
 	ast_manager_unregister("Command");
 	ast_manager_unregister("ExtensionState");
 	ast_manager_unregister("PresenceState");
@@ -9025,6 +10541,9 @@ static void manager_shutdown(void)
 
 	ast_tcptls_server_stop(&ami_desc);
 	ast_tcptls_server_stop(&amis_desc);
+	ast_tcptls_server_stop(&amim_desc);
+	ast_threadpool_shutdown(mux_pool);
+	mux_pool = NULL;
 
 	ast_free(ami_tls_cfg.certfile);
 	ami_tls_cfg.certfile = NULL;
@@ -9071,6 +10590,7 @@ static int manager_subscriptions_init(void)
 	}
 	stasis_message_router_set_congestion_limits(stasis_router, -1,
 		6 * AST_TASKPROCESSOR_HIGH_WATER_LEVEL);
+	stasis_message_router_set_batch_size(stasis_router, 32);
 
 	stasis_message_router_set_formatters_default(stasis_router,
 		manager_default_msg_cb, NULL, STASIS_SUBSCRIPTION_FORMATTER_AMI);
@@ -9117,10 +10637,13 @@ static int subscribe_all(void)
 static void manager_set_defaults(void)
 {
 	manager_enabled = 0;
+	mux_enabled = 0;
 	displayconnects = 1;
 	broken_events_action = 0;
 	authtimeout = 30;
 	authlimit = 50;
+	eventq_size = DEFAULT_EVENTQ_SIZE;
+	eventq_full = EVENTQ_FULL_DROP;
 	manager_debug = 0;		/* Debug disabled by default */
 
 	/* default values */
@@ -9128,6 +10651,7 @@ static void manager_set_defaults(void)
 		sizeof(global_realm));
 	ast_sockaddr_setnull(&ami_desc.local_address);
 	ast_sockaddr_setnull(&amis_desc.local_address);
+	ast_sockaddr_setnull(&amim_desc.local_address);
 
 	ami_tls_cfg.enabled = 0;
 	ast_free(ami_tls_cfg.certfile);
@@ -9155,6 +10679,7 @@ static int __init_manager(int reload, int by_external_config)
 	char a1_hash[256];
 	struct ast_sockaddr ami_desc_local_address_tmp;
 	struct ast_sockaddr amis_desc_local_address_tmp;
+	struct ast_sockaddr amim_desc_local_address_tmp;
 	int tls_was_enabled = 0;
 	int acl_subscription_flag = 0;
 
@@ -9189,10 +10714,12 @@ static int __init_manager(int reload, int by_external_config)
 		ast_manager_register_xml_core("UpdateConfig", EVENT_FLAG_CONFIG, action_updateconfig);
 		ast_manager_register_xml_core("CreateConfig", EVENT_FLAG_CONFIG, action_createconfig);
 		ast_manager_register_xml_core("ListCategories", EVENT_FLAG_CONFIG, action_listcategories);
+		ast_manager_register_xml_core("RealtimeCacheFlush", EVENT_FLAG_CONFIG, action_realtimecacheflush);
 		ast_manager_register_xml_core("Redirect", EVENT_FLAG_CALL, action_redirect);
 		ast_manager_register_xml_core("Atxfer", EVENT_FLAG_CALL, action_atxfer);
 		ast_manager_register_xml_core("CancelAtxfer", EVENT_FLAG_CALL, action_cancel_atxfer);
 		ast_manager_register_xml_core("Originate", EVENT_FLAG_ORIGINATE, action_originate);
+		ast_manager_register_xml_core("OriginateBatch", EVENT_FLAG_ORIGINATE, action_originatebatch);
 		ast_manager_register_xml_core("Command", EVENT_FLAG_COMMAND, action_command);
 		ast_manager_register_xml_core("ExtensionState", EVENT_FLAG_CALL | EVENT_FLAG_REPORTING, action_extensionstate);
 		ast_manager_register_xml_core("PresenceState", EVENT_FLAG_CALL | EVENT_FLAG_REPORTING, action_presencestate);
@@ -9222,11 +10749,6 @@ static int __init_manager(int reload, int by_external_config)
 		__ast_custom_function_register(&managerclient_function, NULL);
 		ast_extension_state_add(NULL, NULL, manager_state_cb, NULL);
 
-		/* Append placeholder event so master_eventq never runs dry */
-		if (append_event("Event: Placeholder\r\n\r\n", 0)) {
-			return -1;
-		}
-
 #ifdef AST_XML_DOCS
 		temp_event_docs = ast_xmldoc_build_documentation("managerEvent");
 		if (temp_event_docs) {
@@ -9268,6 +10790,7 @@ static int __init_manager(int reload, int by_external_config)
 
 	ast_sockaddr_parse(&ami_desc_local_address_tmp, "[::]", 0);
 	ast_sockaddr_set_port(&ami_desc_local_address_tmp, DEFAULT_MANAGER_PORT);
+	ast_sockaddr_setnull(&amim_desc_local_address_tmp);
 
 	for (var = ast_variable_browse(cfg, "general"); var; var = var->next) {
 		val = var->value;
@@ -9309,6 +10832,13 @@ static int __init_manager(int reload, int by_external_config)
 				ast_sockaddr_set_port(&ami_desc_local_address_tmp, setport);
 			}
 
+		} else if (!strcasecmp(var->name, "muxenabled")) {
+			mux_enabled = ast_true(val);
+		} else if (!strcasecmp(var->name, "muxbindaddr")) {
+			if (ast_parse_arg(val, PARSE_ADDR, &amim_desc_local_address_tmp)) {
+				ast_log(LOG_WARNING, "Invalid address '%s' specified for muxbindaddr\n", val);
+				ast_sockaddr_setnull(&amim_desc_local_address_tmp);
+			}
 		} else if (!strcasecmp(var->name, "brokeneventsaction")) {
 			broken_events_action = ast_true(val);
 		} else if (!strcasecmp(var->name, "allowmultiplelogin")) {
@@ -9337,6 +10867,21 @@ static int __init_manager(int reload, int by_external_config)
 			} else {
 				authlimit = limit;
 			}
+		} else if (!strcasecmp(var->name, "eventqueuesize")) {
+			if (ast_parse_arg(val, PARSE_UINT32 | PARSE_IN_RANGE, &eventq_size, 1, 1000000)) {
+				ast_log(LOG_WARNING, "Invalid eventqueuesize value '%s', using default value\n", val);
+				eventq_size = DEFAULT_EVENTQ_SIZE;
+			}
+		} else if (!strcasecmp(var->name, "eventqueuefull")) {
+			if (!strcasecmp(val, "drop")) {
+				eventq_full = EVENTQ_FULL_DROP;
+			} else if (!strcasecmp(val, "disconnect")) {
+				eventq_full = EVENTQ_FULL_DISCONNECT;
+			} else if (!strcasecmp(val, "grace")) {
+				eventq_full = EVENTQ_FULL_GRACE;
+			} else {
+				ast_log(LOG_WARNING, "Invalid eventqueuefull value '%s', using default value\n", val);
+			}
 		} else if (!strcasecmp(var->name, "channelvars")) {
 			load_channelvars(var);
 		} else {
@@ -9368,9 +10913,21 @@ static int __init_manager(int reload, int by_external_config)
 		ast_sockaddr_set_port(&amis_desc_local_address_tmp, DEFAULT_MANAGER_TLS_PORT);
 	}
 
+	/* the multiplexed address defaults to the non secure ami one, on its own port */
+	if (ast_sockaddr_isnull(&amim_desc_local_address_tmp)) {
+		ast_sockaddr_copy(&amim_desc_local_address_tmp, &ami_desc_local_address_tmp);
+		ast_sockaddr_set_port(&amim_desc_local_address_tmp, 0);
+	}
+	if (ast_sockaddr_port(&amim_desc_local_address_tmp) == 0) {
+		ast_sockaddr_set_port(&amim_desc_local_address_tmp, DEFAULT_MANAGER_MUX_PORT);
+	}
+
 	if (manager_enabled) {
 		ast_sockaddr_copy(&ami_desc.local_address, &ami_desc_local_address_tmp);
 		ast_sockaddr_copy(&amis_desc.local_address, &amis_desc_local_address_tmp);
+		if (mux_enabled) {
+			ast_sockaddr_copy(&amim_desc.local_address, &amim_desc_local_address_tmp);
+		}
 	}
 
 	AST_RWLIST_WRLOCK(&users);
@@ -9561,7 +11118,22 @@ static int __init_manager(int reload, int by_external_config)
 				}
 			} else if (!strcasecmp(var->name, "eventfilter")) {
 				const char *value = var->value;
-				manager_add_filter(value, user->whitefilters, user->blackfilters);
+				manager_add_filter(NULL, value, user->whitefilters, user->blackfilters);
+			} else if (!strncasecmp(var->name, "eventfilter(", 12)) {
+				/* eventfilter(<criteria>) = <value> */
+				char criteria[256];
+				char *close;
+
+				ast_copy_string(criteria, var->name + 12, sizeof(criteria));
+				close = strrchr(criteria, ')');
+				if (close && !close[1]) {
+					*close = '\0';
+				}
+				if (!close || close[1]
+					|| manager_add_filter(criteria, var->value, user->whitefilters, user->blackfilters) != FILTER_SUCCESS) {
+					ast_log(LOG_WARNING, "Invalid event filter '%s = %s' for user '%s'\n",
+						var->name, var->value, user->username);
+				}
 			} else {
 				ast_debug(1, "%s is an unknown option.\n", var->name);
 			}
@@ -9626,6 +11198,22 @@ static int __init_manager(int reload, int by_external_config)
 	}
 
 	ast_tcptls_server_start(&ami_desc);
+	if (!ast_sockaddr_isnull(&amim_desc.local_address) && !mux_pool) {
+		struct ast_threadpool_options options = {
+			.version = AST_THREADPOOL_OPTIONS_VERSION,
+			.idle_timeout = 60,
+			.auto_increment = 1,
+			/* Bounded by MUX_INFLIGHT_MAX for each session */
+			.max_size = 0,
+		};
+
+		mux_pool = ast_threadpool_create("manager-mux", NULL, &options);
+		if (!mux_pool) {
+			ast_log(LOG_ERROR, "Unable to create threads for multiplexed AMI sessions\n");
+			ast_sockaddr_setnull(&amim_desc.local_address);
+		}
+	}
+	ast_tcptls_server_start(&amim_desc);
 	if (tls_was_enabled && !ami_tls_cfg.enabled) {
 		ast_tcptls_server_stop(&amis_desc);
 	} else if (ast_ssl_setup(amis_desc.tls_cfg)) {
@@ -9733,16 +11321,28 @@ ast_manager_event_blob_create(
 {
 	struct ast_manager_event_blob *ev;
 	va_list argp;
+	int len;
 
 	ast_assert(extra_fields_fmt != NULL);
 	ast_assert(manager_event != NULL);
 
+	/*
+	 * Size the pool for the fields up front so they are formatted straight
+	 * into it instead of outgrowing a small pool.
+	 */
+	va_start(argp, extra_fields_fmt);
+	len = vsnprintf(NULL, 0, extra_fields_fmt, argp);
+	va_end(argp);
+	if (len < 0) {
+		return NULL;
+	}
+
 	ev = ao2_alloc_options(sizeof(*ev), manager_event_blob_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!ev) {
 		return NULL;
 	}
 
-	if (ast_string_field_init(ev, 20)) {
+	if (ast_string_field_init(ev, len + 1 + sizeof(ast_string_field_allocation))) {
 		ao2_ref(ev, -1);
 		return NULL;
 	}
@@ -397,11 +397,11 @@ static void channel_enter_cb(void *data, struct stasis_subscription *sub,
 	static const char *swap_name = "SwapUniqueid: ";
 	struct ast_bridge_blob *blob = stasis_message_data(message);
 	RAII_VAR(struct ast_str *, bridge_text, NULL, ast_free);
-	RAII_VAR(struct ast_str *, channel_text, NULL, ast_free);
+	const char *channel_text;
 	const char *swap_id;
 
 	bridge_text = ast_manager_build_bridge_state_string(blob->bridge);
-	channel_text = ast_manager_build_channel_state_string(blob->channel);
+	channel_text = ast_manager_channel_state_str(blob->channel);
 	if (!bridge_text || !channel_text) {
 		return;
 	}
@@ -413,7 +413,7 @@ static void channel_enter_cb(void *data, struct stasis_subscription *sub,
 		"%s"
 		"%s%s%s",
 		ast_str_buffer(bridge_text),
-		ast_str_buffer(channel_text),
+		channel_text,
 		swap_id ? swap_name : "",
 		S_OR(swap_id, ""),
 		swap_id ? "\r\n" : "");
@@ -424,10 +424,10 @@ static void channel_leave_cb(void *data, struct stasis_subscription *sub,
 {
 	struct ast_bridge_blob *blob = stasis_message_data(message);
 	RAII_VAR(struct ast_str *, bridge_text, NULL, ast_free);
-	RAII_VAR(struct ast_str *, channel_text, NULL, ast_free);
+	const char *channel_text;
 
 	bridge_text = ast_manager_build_bridge_state_string(blob->bridge);
-	channel_text = ast_manager_build_channel_state_string(blob->channel);
+	channel_text = ast_manager_channel_state_str(blob->channel);
 	if (!bridge_text || !channel_text) {
 		return;
 	}
@@ -436,7 +436,7 @@ static void channel_leave_cb(void *data, struct stasis_subscription *sub,
 		"%s"
 		"%s",
 		ast_str_buffer(bridge_text),
-		ast_str_buffer(channel_text));
+		channel_text);
 }
 
 struct bridge_list_data {
@@ -34,6 +34,7 @@
 #include "asterisk/stasis_message_router.h"
 #include "asterisk/pbx.h"
 #include "asterisk/stasis_channels.h"
+#include "asterisk/stasis_internal.h"
 
 /*** DOCUMENTATION
 	<managerEvent language="en_US" name="Newchannel">
@@ -558,10 +559,51 @@ struct ast_str *ast_manager_build_channel_state_string_prefix(
 	return out;
 }
 
+const char *ast_manager_channel_state_str(
+		const struct ast_channel_snapshot *snapshot)
+{
+	struct ast_str *out;
+	char *state;
+
+	/* Snapshots are immutable, format them once and share the result */
+	state = stasis_cached_rendering_get((void **) &snapshot->manager_state);
+	if (state) {
+		return state;
+	}
+
+	out = ast_manager_build_channel_state_string_prefix(snapshot, "");
+	if (!out) {
+		return NULL;
+	}
+	state = ast_strdup(ast_str_buffer(out));
+	ast_free(out);
+	if (state && stasis_cached_rendering_set((void **) &snapshot->manager_state, state)) {
+		/* Another thread got there first */
+		ast_free(state);
+		state = stasis_cached_rendering_get((void **) &snapshot->manager_state);
+	}
+
+	return state;
+}
+
 struct ast_str *ast_manager_build_channel_state_string(
 		const struct ast_channel_snapshot *snapshot)
 {
-	return ast_manager_build_channel_state_string_prefix(snapshot, "");
+	struct ast_str *out;
+	const char *state;
+
+	state = ast_manager_channel_state_str(snapshot);
+	if (!state) {
+		return NULL;
+	}
+
+	out = ast_str_create(strlen(state) + 1);
+	if (!out) {
+		return NULL;
+	}
+	ast_str_set(&out, 0, "%s", state);
+
+	return out;
 }
 
 /*! \brief Typedef for callbacks that get called on channel snapshot updates */
@@ -713,7 +755,7 @@ channel_snapshot_monitor channel_monitors[] = {
 static void channel_snapshot_update(void *data, struct stasis_subscription *sub,
 				    struct stasis_message *message)
 {
-	RAII_VAR(struct ast_str *, channel_event_string, NULL, ast_free);
+	const char *channel_event_string = NULL;
 	struct ast_channel_snapshot_update *update;
 	size_t i;
 
@@ -727,33 +769,33 @@ static void channel_snapshot_update(void *data, struct stasis_subscription *sub,
 			continue;
 		}
 
-		/* If we haven't already, build the channel event string */
+		/* If we haven't already, get the channel event string */
 		if (!channel_event_string) {
 			channel_event_string =
-				ast_manager_build_channel_state_string(update->new_snapshot);
+				ast_manager_channel_state_str(update->new_snapshot);
 			if (!channel_event_string) {
 				return;
 			}
 		}
 
 		manager_event(ev->event_flags, ev->manager_event, "%s%s",
-			ast_str_buffer(channel_event_string),
+			channel_event_string,
 			ev->extra_fields);
 	}
 }
 
 static void publish_basic_channel_event(const char *event, int class, struct ast_channel_snapshot *snapshot)
 {
-	RAII_VAR(struct ast_str *, channel_event_string, NULL, ast_free);
+	const char *channel_event_string;
 
-	channel_event_string = ast_manager_build_channel_state_string(snapshot);
+	channel_event_string = ast_manager_channel_state_str(snapshot);
 	if (!channel_event_string) {
 		return;
 	}
 
 	manager_event(class, event,
 		"%s",
-		ast_str_buffer(channel_event_string));
+		channel_event_string);
 }
 
 static void channel_hangup_request_cb(void *data,
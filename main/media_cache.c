@@ -28,6 +28,52 @@
 	<support_level>core</support_level>
  ***/
 
+/*** DOCUMENTATION
+	<manager name="MediaCachePrefetch" language="en_US">
+		<synopsis>
+			Retrieve an item into the media cache in the background.
+		</synopsis>
+		<syntax>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Login']/syntax/parameter[@name='ActionID'])" />
+			<parameter name="URI" required="true">
+				<para>The URI of the media to retrieve.</para>
+			</parameter>
+		</syntax>
+		<description>
+			<para>Queues the retrieval of an item into the media cache and returns
+			straight away, so media can be fetched before the calls that play it.
+			The <literal>MediaCachePrefetch</literal> event is raised when the
+			retrieval is complete.</para>
+		</description>
+		<see-also>
+			<ref type="managerEvent">MediaCachePrefetch</ref>
+		</see-also>
+	</manager>
+	<managerEvent language="en_US" name="MediaCachePrefetch">
+		<managerEventInstance class="EVENT_FLAG_SYSTEM">
+			<synopsis>Raised when a prefetch into the media cache is complete.</synopsis>
+			<syntax>
+				<parameter name="URI">
+					<para>The URI of the media.</para>
+				</parameter>
+				<parameter name="Status">
+					<enumlist>
+						<enum name="Success"/>
+						<enum name="Failure"/>
+					</enumlist>
+				</parameter>
+				<parameter name="File">
+					<para>The local file holding the media, without its
+					extension, when the retrieval succeeded.</para>
+				</parameter>
+			</syntax>
+			<see-also>
+				<ref type="manager">MediaCachePrefetch</ref>
+			</see-also>
+		</managerEventInstance>
+	</managerEvent>
+ ***/
+
 #include "asterisk.h"
 
 #include <sys/stat.h>
@@ -36,7 +82,9 @@
 #include "asterisk/astdb.h"
 #include "asterisk/cli.h"
 #include "asterisk/file.h"
+#include "asterisk/manager.h"
 #include "asterisk/media_cache.h"
+#include "asterisk/threadpool.h"
 
 /*! The name of the AstDB family holding items in the cache. */
 #define AST_DB_FAMILY "MediaCache"
@@ -47,9 +95,39 @@
 /*! Number of buckets in the ao2 container holding our media items */
 #define AO2_BUCKETS 61
 
+/*! Number of buckets in the ao2 container holding retrievals in progress */
+#define FETCH_BUCKETS 17
+
+/*! Maximum number of prefetches run at the same time */
+#define PREFETCH_THREADS 8
+
 /*! Our one and only container holding media items */
 static struct ao2_container *media_cache;
 
+/*! \brief A retrieval of an item from its backend in progress */
+struct media_cache_fetch {
+	/*! Signalled when the retrieval is complete */
+	ast_cond_t cond;
+	/*! Non-zero once the retrieval is complete */
+	int done;
+	/*! The result of the retrieval */
+	int res;
+	/*! The URI being retrieved */
+	char uri[0];
+};
+
+/*! Protects media_fetches and the state of the retrievals in it */
+AST_MUTEX_DEFINE_STATIC(fetches_lock);
+
+/*! Retrievals in progress, so concurrent requests for one URI share one */
+static struct ao2_container *media_fetches;
+
+/*! Runs prefetches of items into the cache */
+static struct ast_threadpool *prefetch_pool;
+
+AO2_STRING_FIELD_HASH_FN(media_cache_fetch, uri);
+AO2_STRING_FIELD_CMP_FN(media_cache_fetch, uri);
+
 int ast_media_cache_exists(const char *uri)
 {
 	struct ast_bucket_file *bucket_file;
@@ -153,22 +231,32 @@ static void bucket_file_update_path(struct ast_bucket_file *bucket_file,
 	}
 }
 
-int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
+static void media_cache_fetch_destroy(void *obj)
+{
+	struct media_cache_fetch *fetch = obj;
+
+	ast_cond_destroy(&fetch->cond);
+}
+
+/*!
+ * \internal
+ * \brief Retrieve an item, checking with its backend whether it is stale
+ *
+ * \note Only one thread at a time retrieves a given URI, but the container
+ * is not held locked while the backend is queried, so retrievals of
+ * different URIs do not wait on each other.
+ */
+static int media_cache_fetch_item(const char *uri, const char *preferred_file_name,
 	char *file_path, size_t len)
 {
 	struct ast_bucket_file *bucket_file;
 	char *ext;
-	SCOPED_AO2LOCK(media_lock, media_cache);
-
-	if (ast_strlen_zero(uri)) {
-		return -1;
-	}
 
 	/* First, retrieve from the ao2 cache here. If we find a bucket_file
 	 * matching the requested URI, ask the appropriate backend if it is
 	 * stale. If not; return it.
 	 */
-	bucket_file = ao2_find(media_cache, uri, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	bucket_file = ao2_find(media_cache, uri, OBJ_SEARCH_KEY);
 	if (bucket_file) {
 		if (!ast_bucket_file_is_stale(bucket_file)
 			&& ast_file_is_readable(bucket_file->path)) {
@@ -183,7 +271,7 @@ int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
 		}
 
 		/* Stale! Remove the item completely, as we're going to replace it next */
-		ao2_unlink_flags(media_cache, bucket_file, OBJ_NOLOCK);
+		ao2_unlink(media_cache, bucket_file);
 		ast_bucket_file_delete(bucket_file);
 		ao2_ref(bucket_file, -1);
 	}
@@ -206,7 +294,7 @@ int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
 	if ((ext = strrchr(file_path, '.'))) {
 		*ext = '\0';
 	}
-	ao2_link_flags(media_cache, bucket_file, OBJ_NOLOCK);
+	ao2_link(media_cache, bucket_file);
 	ao2_ref(bucket_file, -1);
 
 	ast_debug(5, "Returning media at local file: %s\n", file_path);
@@ -214,6 +302,97 @@ int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
 	return 0;
 }
 
+int ast_media_cache_retrieve(const char *uri, const char *preferred_file_name,
+	char *file_path, size_t len)
+{
+	struct media_cache_fetch *fetch;
+	int res;
+
+	if (ast_strlen_zero(uri)) {
+		return -1;
+	}
+
+	/*
+	 * When the URI is already being retrieved wait for that to finish.
+	 * The item is then in the cache, so our own lookup will not need
+	 * to go to the backend again.
+	 */
+	ast_mutex_lock(&fetches_lock);
+	while ((fetch = ao2_find(media_fetches, uri, OBJ_SEARCH_KEY | OBJ_NOLOCK))) {
+		while (!fetch->done) {
+			ast_cond_wait(&fetch->cond, &fetches_lock);
+		}
+		res = fetch->res;
+		ao2_ref(fetch, -1);
+		if (res) {
+			ast_mutex_unlock(&fetches_lock);
+			ast_debug(2, "Failed to obtain media at '%s'\n", uri);
+			return -1;
+		}
+	}
+
+	fetch = ao2_alloc_options(sizeof(*fetch) + strlen(uri) + 1, media_cache_fetch_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!fetch) {
+		ast_mutex_unlock(&fetches_lock);
+		return -1;
+	}
+	ast_cond_init(&fetch->cond, NULL);
+	strcpy(fetch->uri, uri); /* Safe */
+	ao2_link_flags(media_fetches, fetch, OBJ_NOLOCK);
+	ast_mutex_unlock(&fetches_lock);
+
+	res = media_cache_fetch_item(uri, preferred_file_name, file_path, len);
+
+	ast_mutex_lock(&fetches_lock);
+	fetch->res = res;
+	fetch->done = 1;
+	ao2_unlink_flags(media_fetches, fetch, OBJ_NOLOCK);
+	ast_cond_broadcast(&fetch->cond);
+	ast_mutex_unlock(&fetches_lock);
+	ao2_ref(fetch, -1);
+
+	return res;
+}
+
+static int media_cache_prefetch_task(void *data)
+{
+	char *uri = data;
+	char file_path[PATH_MAX];
+
+	if (ast_media_cache_retrieve(uri, NULL, file_path, sizeof(file_path))) {
+		manager_event(EVENT_FLAG_SYSTEM, "MediaCachePrefetch",
+			"URI: %s\r\nStatus: Failure\r\n", uri);
+	} else {
+		manager_event(EVENT_FLAG_SYSTEM, "MediaCachePrefetch",
+			"URI: %s\r\nStatus: Success\r\nFile: %s\r\n", uri, file_path);
+	}
+	ast_free(uri);
+
+	return 0;
+}
+
+int ast_media_cache_prefetch(const char *uri)
+{
+	char *task_uri;
+
+	if (ast_strlen_zero(uri) || !prefetch_pool) {
+		return -1;
+	}
+
+	task_uri = ast_strdup(uri);
+	if (!task_uri) {
+		return -1;
+	}
+
+	if (ast_threadpool_push(prefetch_pool, media_cache_prefetch_task, task_uri)) {
+		ast_free(task_uri);
+		return -1;
+	}
+
+	return 0;
+}
+
 int ast_media_cache_retrieve_metadata(const char *uri, const char *key,
 	char *value, size_t len)
 {
@@ -624,12 +803,61 @@ static char *media_cache_handle_create_item(struct ast_cli_entry *e, int cmd, st
 	return CLI_SUCCESS;
 }
 
+static char *media_cache_handle_prefetch_item(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	int i;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "media cache prefetch";
+		e->usage =
+			"Usage: media cache prefetch <uri> [<uri> ...]\n"
+			"       Retrieve items into the media cache in the background.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc < 4) {
+		return CLI_SHOWUSAGE;
+	}
+
+	for (i = 3; i < a->argc; i++) {
+		if (ast_media_cache_prefetch(a->argv[i])) {
+			ast_cli(a->fd, "Unable to prefetch '%s'\n", a->argv[i]);
+		} else {
+			ast_cli(a->fd, "Prefetching '%s'\n", a->argv[i]);
+		}
+	}
+
+	return CLI_SUCCESS;
+}
+
+static int manager_media_cache_prefetch(struct mansession *s, const struct message *m)
+{
+	const char *uri = astman_get_header(m, "URI");
+
+	if (ast_strlen_zero(uri)) {
+		astman_send_error(s, m, "URI not specified");
+		return 0;
+	}
+
+	if (ast_media_cache_prefetch(uri)) {
+		astman_send_error(s, m, "Unable to queue prefetch");
+		return 0;
+	}
+
+	astman_send_ack(s, m, "Prefetch queued");
+	return 0;
+}
+
 static struct ast_cli_entry cli_media_cache[] = {
 	AST_CLI_DEFINE(media_cache_handle_show_all, "Show all items in the media cache"),
 	AST_CLI_DEFINE(media_cache_handle_show_item, "Show a single item in the media cache"),
 	AST_CLI_DEFINE(media_cache_handle_delete_item, "Remove an item from the media cache"),
 	AST_CLI_DEFINE(media_cache_handle_refresh_item, "Refresh an item in the media cache"),
 	AST_CLI_DEFINE(media_cache_handle_create_item, "Create an item in the media cache"),
+	AST_CLI_DEFINE(media_cache_handle_prefetch_item, "Retrieve items into the media cache in the background"),
 };
 
 /*!
@@ -638,12 +866,27 @@ static struct ast_cli_entry cli_media_cache[] = {
  */
 static void media_cache_shutdown(void)
 {
+	ast_manager_unregister("MediaCachePrefetch");
+	ast_cli_unregister_multiple(cli_media_cache, ARRAY_LEN(cli_media_cache));
+
+	ast_threadpool_shutdown(prefetch_pool);
+	prefetch_pool = NULL;
+
+	ao2_cleanup(media_fetches);
+	media_fetches = NULL;
+
 	ao2_cleanup(media_cache);
 	media_cache = NULL;
-
-	ast_cli_unregister_multiple(cli_media_cache, ARRAY_LEN(cli_media_cache));
 }
 
+static const struct ast_threadpool_options prefetch_pool_options = {
+	.version = AST_THREADPOOL_OPTIONS_VERSION,
+	.idle_timeout = 30,
+	.auto_increment = 1,
+	.initial_size = 0,
+	.max_size = PREFETCH_THREADS,
+};
+
 int ast_media_cache_init(void)
 {
 	ast_register_cleanup(media_cache_shutdown);
@@ -654,10 +897,26 @@ int ast_media_cache_init(void)
 		return -1;
 	}
 
+	media_fetches = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, FETCH_BUCKETS,
+		media_cache_fetch_hash_fn, NULL, media_cache_fetch_cmp_fn);
+	if (!media_fetches) {
+		return -1;
+	}
+
+	prefetch_pool = ast_threadpool_create("media_cache_prefetch", NULL, &prefetch_pool_options);
+	if (!prefetch_pool) {
+		return -1;
+	}
+
 	if (ast_cli_register_multiple(cli_media_cache, ARRAY_LEN(cli_media_cache))) {
 		return -1;
 	}
 
+	if (ast_manager_register_xml_core("MediaCachePrefetch", EVENT_FLAG_SYSTEM,
+		manager_media_cache_prefetch)) {
+		return -1;
+	}
+
 	media_cache_populate_from_astdb();
 
 	return 0;
@@ -263,7 +263,16 @@ static ast_rwlock_t msg_handlers_lock;
 /*! \brief Vector of received message handlers */
 AST_VECTOR(, const struct ast_msg_handler *) msg_handlers;
 
-static struct ast_taskprocessor *msg_q_tp;
+/*!
+ * \brief Number of queues routing messages
+ *
+ * Messages from the same sender always go through the same queue, so
+ * they are routed in the order they were received.  Each queue reuses
+ * the message channel of its own thread.
+ */
+#define MSG_QUEUES 8
+
+static struct ast_taskprocessor *msg_q_tp[MSG_QUEUES];
 
 static const char app_msg_send[] = "MessageSend";
 
@@ -548,6 +557,16 @@ const char *ast_msg_get_tech(const struct ast_msg *msg)
 	return msg->tech;
 }
 
+const char *ast_msg_get_context(const struct ast_msg *msg)
+{
+	return msg->context;
+}
+
+const char *ast_msg_get_exten(const struct ast_msg *msg)
+{
+	return msg->exten;
+}
+
 const char *ast_msg_get_endpoint(const struct ast_msg *msg)
 {
 	return msg->endpoint;
@@ -801,7 +820,7 @@ static void chan_cleanup(struct ast_channel *chan)
 	 * Destroy all channel variables.
 	 */
 	headp = ast_channel_varshead(chan);
-	while ((vardata = AST_LIST_REMOVE_HEAD(headp, entries))) {
+	while ((vardata = AST_VAR_LIST_REMOVE_HEAD(headp))) {
 		ast_var_delete(vardata);
 	}
 
@@ -958,7 +977,10 @@ int ast_msg_has_destination(const struct ast_msg *msg)
 int ast_msg_queue(struct ast_msg *msg)
 {
 	int res;
-	res = ast_taskprocessor_push(msg_q_tp, msg_q_cb, msg);
+	unsigned int queue;
+
+	queue = (unsigned int) ast_str_hash(S_OR(msg->from, "")) % MSG_QUEUES;
+	res = ast_taskprocessor_push(msg_q_tp[queue], msg_q_cb, msg);
 	if (res == -1) {
 		ao2_ref(msg, -1);
 	}
@@ -1688,8 +1710,12 @@ int ast_msg_handler_unregister(const struct ast_msg_handler *handler)
 
 void ast_msg_shutdown(void)
 {
-	if (msg_q_tp) {
-		msg_q_tp = ast_taskprocessor_unreference(msg_q_tp);
+	int i;
+
+	for (i = 0; i < MSG_QUEUES; i++) {
+		if (msg_q_tp[i]) {
+			msg_q_tp[i] = ast_taskprocessor_unreference(msg_q_tp[i]);
+		}
 	}
 }
 
@@ -1697,7 +1723,7 @@ void ast_msg_shutdown(void)
  * \internal
  * \brief Clean up other resources on Asterisk shutdown
  *
- * \note This does not include the msg_q_tp object, which must be disposed
+ * \note This does not include the msg_q_tp objects, which must be disposed
  * of prior to Asterisk checking for channel destruction in its shutdown
  * sequence.  The atexit handlers are executed after this occurs.
  */
@@ -1730,10 +1756,21 @@ static void message_shutdown(void)
 int ast_msg_init(void)
 {
 	int res;
+	int i;
 
-	msg_q_tp = ast_taskprocessor_get("ast_msg_queue", TPS_REF_DEFAULT);
-	if (!msg_q_tp) {
-		return -1;
+	for (i = 0; i < MSG_QUEUES; i++) {
+		char name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+		/* The first queue keeps the name of the single queue there used to be */
+		if (i) {
+			snprintf(name, sizeof(name), "ast_msg_queue-%d", i);
+		} else {
+			ast_copy_string(name, "ast_msg_queue", sizeof(name));
+		}
+		msg_q_tp[i] = ast_taskprocessor_get(name, TPS_REF_DEFAULT);
+		if (!msg_q_tp[i]) {
+			return -1;
+		}
 	}
 
 	ast_rwlock_init(&msg_techs_lock);
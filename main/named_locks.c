@@ -27,11 +27,37 @@
 
 #include "asterisk/_private.h"
 #include "asterisk/astobj2.h"
+#include "asterisk/cli.h"
 #include "asterisk/named_locks.h"
+#include "asterisk/strings.h"
+#include "asterisk/time.h"
 #include "asterisk/utils.h"
 
-struct ao2_container *named_locks;
-#define NAMED_LOCKS_BUCKETS 101
+/*! \brief Number of independently locked tables the named locks are spread over */
+#define NAMED_LOCKS_SHARDS 16
+#define NAMED_LOCKS_BUCKETS 31
+
+/*! \brief Number of recently used locks each shard keeps alive */
+#define NAMED_LOCKS_HOT 8
+
+struct named_lock_shard {
+	/*! Weak proxies of the live locks */
+	struct ao2_container *locks;
+	/*!
+	 * \brief Recently used locks, each holding a reference
+	 *
+	 * Keys that are locked over and over again, like the AOR of a busy
+	 * registrar, would otherwise be freed and allocated again every time
+	 * the last user puts the lock away.
+	 *
+	 * \note Protected by the lock of the locks container.
+	 */
+	struct ast_named_lock *hot[NAMED_LOCKS_HOT];
+	/*! Next slot of hot to replace */
+	unsigned int hot_next;
+};
+
+static struct named_lock_shard named_locks[NAMED_LOCKS_SHARDS];
 
 struct named_lock_proxy {
 	AO2_WEAKPROXY();
@@ -39,50 +65,94 @@ struct named_lock_proxy {
 };
 
 struct ast_named_lock {
+	/*! Times the lock was looked up */
+	int gets;
+	/*! Times ast_named_lock_lock() had to wait for the lock */
+	int contended;
+	/*! Total time spent waiting in ast_named_lock_lock(), in microseconds */
+	int64_t wait_us;
+	/*! Non-zero while the lock is in the hot list of its shard */
+	int hot;
+	char key[0];
 };
 
 AO2_STRING_FIELD_HASH_FN(named_lock_proxy, key)
 AO2_STRING_FIELD_CMP_FN(named_lock_proxy, key)
 
-static void named_locks_shutdown(void)
+static struct named_lock_shard *named_lock_shard_get(const char *key)
 {
-	ao2_cleanup(named_locks);
+	return &named_locks[ast_str_hash(key) % NAMED_LOCKS_SHARDS];
 }
 
-int ast_named_locks_init(void)
+/*!
+ * \brief Keep a lock in the hot list of its shard
+ * \note Call with the shard's container locked.
+ *
+ * \return The lock pushed out of the list, which the caller must release
+ *         once the container is unlocked, or NULL
+ */
+static struct ast_named_lock *named_lock_make_hot(struct named_lock_shard *shard,
+	struct ast_named_lock *lock)
 {
-	named_locks = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
-		NAMED_LOCKS_BUCKETS, named_lock_proxy_hash_fn, NULL, named_lock_proxy_cmp_fn);
-	if (!named_locks) {
-		return -1;
+	struct ast_named_lock *evicted;
+
+	if (lock->hot) {
+		return NULL;
 	}
 
-	ast_register_cleanup(named_locks_shutdown);
+	evicted = shard->hot[shard->hot_next];
+	if (evicted) {
+		evicted->hot = 0;
+	}
+	lock->hot = 1;
+	shard->hot[shard->hot_next] = ao2_bump(lock);
+	shard->hot_next = (shard->hot_next + 1) % NAMED_LOCKS_HOT;
 
-	return 0;
+	return evicted;
+}
+
+static void named_locks_shutdown(void)
+{
+	int i;
+	int j;
+
+	for (i = 0; i < NAMED_LOCKS_SHARDS; ++i) {
+		for (j = 0; j < NAMED_LOCKS_HOT; ++j) {
+			ao2_cleanup(named_locks[i].hot[j]);
+			named_locks[i].hot[j] = NULL;
+		}
+		ao2_cleanup(named_locks[i].locks);
+		named_locks[i].locks = NULL;
+	}
 }
 
 static void named_lock_proxy_cb(void *weakproxy, void *data)
 {
-	ao2_unlink(named_locks, weakproxy);
+	ao2_unlink(data, weakproxy);
 }
 
 struct ast_named_lock *__ast_named_lock_get(const char *filename, int lineno, const char *func,
 	enum ast_named_lock_type lock_type, const char *keyspace, const char *key)
 {
+	struct named_lock_shard *shard;
 	struct named_lock_proxy *proxy;
 	struct ast_named_lock *lock;
+	struct ast_named_lock *evicted;
 	int keylen = strlen(keyspace) + strlen(key) + 2;
 	char *concat_key = ast_alloca(keylen);
 
 	sprintf(concat_key, "%s-%s", keyspace, key); /* Safe */
+	shard = named_lock_shard_get(concat_key);
 
-	ao2_lock(named_locks);
-	lock = __ao2_weakproxy_find(named_locks, concat_key, OBJ_SEARCH_KEY | OBJ_NOLOCK,
+	ao2_lock(shard->locks);
+	lock = __ao2_weakproxy_find(shard->locks, concat_key, OBJ_SEARCH_KEY | OBJ_NOLOCK,
 		__PRETTY_FUNCTION__, filename, lineno, func);
 	if (lock) {
 		ast_assert((ao2_options_get(lock) & AO2_ALLOC_OPT_LOCK_MASK) == lock_type);
-		ao2_unlock(named_locks);
+		ast_atomic_fetchadd_int(&lock->gets, +1);
+		evicted = named_lock_make_hot(shard, lock);
+		ao2_unlock(shard->locks);
+		ao2_cleanup(evicted);
 
 		return lock;
 	}
@@ -102,22 +172,127 @@ struct ast_named_lock *__ast_named_lock_get(const char *filename, int lineno, co
 		goto failure_cleanup;
 	}
 
-	if (ao2_weakproxy_subscribe(proxy, named_lock_proxy_cb, NULL, OBJ_NOLOCK)) {
+	if (ao2_weakproxy_subscribe(proxy, named_lock_proxy_cb, shard->locks, OBJ_NOLOCK)) {
 		goto failure_cleanup;
 	}
 
 	strcpy(proxy->key, concat_key); /* Safe */
-	ao2_link_flags(named_locks, proxy, OBJ_NOLOCK);
-	ao2_unlock(named_locks);
+	strcpy(lock->key, concat_key); /* Safe */
+	lock->gets = 1;
+	ao2_link_flags(shard->locks, proxy, OBJ_NOLOCK);
+	evicted = named_lock_make_hot(shard, lock);
+	ao2_unlock(shard->locks);
 	ao2_t_ref(proxy, -1, "Release allocation reference");
+	ao2_cleanup(evicted);
 
 	return lock;
 
 failure_cleanup:
-	ao2_unlock(named_locks);
+	ao2_unlock(shard->locks);
 
 	ao2_cleanup(proxy);
 	ao2_cleanup(lock);
 
 	return NULL;
 }
+
+int __ast_named_lock_lock(struct ast_named_lock *lock, const char *filename, int lineno,
+	const char *func)
+{
+	struct timeval start;
+	int res;
+
+	if (!__ao2_trylock(lock, AO2_LOCK_REQ_MUTEX, filename, func, lineno, "lock")) {
+		return 0;
+	}
+
+	start = ast_tvnow();
+	res = __ao2_lock(lock, AO2_LOCK_REQ_MUTEX, filename, func, lineno, "lock");
+	ast_atomic_fetchadd_int(&lock->contended, +1);
+	ast_atomic_fetch_add(&lock->wait_us, ast_tvdiff_us(ast_tvnow(), start), __ATOMIC_RELAXED);
+
+	return res;
+}
+
+/*! \brief Print one live named lock to the CLI */
+static int named_lock_show_cb(void *obj, void *arg, int flags)
+{
+	struct ast_cli_args *a = arg;
+	struct ast_named_lock *lock;
+	int contended;
+
+	lock = ao2_weakproxy_get_object(obj, 0);
+	if (!lock) {
+		return 0;
+	}
+
+	contended = lock->contended;
+	ast_cli(a->fd, "%-50.50s %-6s %10d %10d %12" PRId64 "\n", lock->key,
+		(ao2_options_get(lock) & AO2_ALLOC_OPT_LOCK_MASK) == AO2_ALLOC_OPT_LOCK_RWLOCK
+			? "rwlock" : "mutex",
+		lock->gets, contended, contended ? lock->wait_us / contended : 0);
+	ao2_ref(lock, -1);
+
+	return 0;
+}
+
+static char *handle_named_locks_show(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	int total = 0;
+	int i;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show named locks";
+		e->usage =
+			"Usage: core show named locks\n"
+			"       Show the named locks currently in use or recently used, how\n"
+			"       often each was looked up and how often ast_named_lock_lock()\n"
+			"       had to wait for it, with the average wait in microseconds.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 4) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_cli(a->fd, "%-50.50s %-6s %10s %10s %12s\n", "Key", "Type", "Gets", "Contended", "Avg Wait");
+	for (i = 0; i < NAMED_LOCKS_SHARDS; ++i) {
+		ao2_callback(named_locks[i].locks, OBJ_NODATA, named_lock_show_cb, a);
+		total += ao2_container_count(named_locks[i].locks);
+	}
+	ast_cli(a->fd, "%d named locks in %d shards\n", total, NAMED_LOCKS_SHARDS);
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_named_locks[] = {
+	AST_CLI_DEFINE(handle_named_locks_show, "Show named locks and their contention"),
+};
+
+static void named_locks_cleanup(void)
+{
+	ast_cli_unregister_multiple(cli_named_locks, ARRAY_LEN(cli_named_locks));
+	named_locks_shutdown();
+}
+
+int ast_named_locks_init(void)
+{
+	int i;
+
+	for (i = 0; i < NAMED_LOCKS_SHARDS; ++i) {
+		named_locks[i].locks = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+			NAMED_LOCKS_BUCKETS, named_lock_proxy_hash_fn, NULL, named_lock_proxy_cmp_fn);
+		if (!named_locks[i].locks) {
+			named_locks_shutdown();
+			return -1;
+		}
+	}
+
+	ast_cli_register_multiple(cli_named_locks, ARRAY_LEN(cli_named_locks));
+	ast_register_cleanup(named_locks_cleanup);
+
+	return 0;
+}
@@ -79,6 +79,22 @@ double ast_option_maxload;
 int ast_option_maxcalls;
 /*! Max number of open file handles (files, sockets) */
 int ast_option_maxfiles;
+/*! Size in MB of the cache of played sound files, 0 to disable */
+unsigned int ast_option_file_cache_size;
+/*! Number of shared threads running generators */
+unsigned int ast_option_generator_threads;
+/*! Keep the contents of astdb in memory */
+unsigned int ast_option_astdb_cache;
+/*! Milliseconds astdb writes wait before going to disk, 0 to write them at once */
+unsigned int ast_option_astdb_write_behind;
+/*! Answer lookups of sound files from an index of the sounds directory */
+unsigned int ast_option_sounds_index;
+/*! Play sound files of fixed size frames from a memory mapping of the file */
+unsigned int ast_option_map_sound_files;
+/*! Security events of each type reported per remote address and interval, 0 for no limit */
+unsigned int ast_option_security_event_limit;
+/*! Seconds in a security event rate limiting interval */
+unsigned int ast_option_security_event_interval = 60;
 /*! Minimum duration of DTMF. */
 unsigned int option_dtmfminduration = AST_MIN_DTMF_DURATION;
 #if defined(HAVE_SYSINFO)
@@ -361,6 +377,47 @@ void load_asterisk_conf(void)
 		} else if (!strcasecmp(v->name, "cache_media_frames")) {
 			ast_set2_flag(&ast_options, ast_true(v->value), AST_OPT_FLAG_CACHE_MEDIA_FRAMES);
 #endif
+		/* Keep played sound files in memory */
+		} else if (!strcasecmp(v->name, "file_cache_size")) {
+			if (ast_parse_arg(v->value, PARSE_UINT32, &ast_option_file_cache_size)) {
+				ast_log(LOG_WARNING, "Invalid file_cache_size '%s', file cache disabled\n", v->value);
+				ast_option_file_cache_size = 0;
+			}
+		/* Run shareable generators from a pool of threads */
+		} else if (!strcasecmp(v->name, "generator_threads")) {
+			if (ast_parse_arg(v->value, PARSE_UINT32 | PARSE_IN_RANGE, &ast_option_generator_threads, 0, 64)) {
+				ast_log(LOG_WARNING, "Invalid generator_threads '%s', generators will run on channel timers\n", v->value);
+				ast_option_generator_threads = 0;
+			}
+		/* Place threads working together on the same group of CPUs */
+		} else if (!strcasecmp(v->name, "cpu_group")) {
+			ast_cpu_group_add(v->value);
+		/* Serve astdb reads from memory */
+		} else if (!strcasecmp(v->name, "astdb_cache")) {
+			ast_option_astdb_cache = ast_true(v->value);
+		/* Index the sounds directory instead of probing it for each file */
+		} else if (!strcasecmp(v->name, "sounds_index")) {
+			ast_option_sounds_index = ast_true(v->value);
+		/* Play headerless sound files from a memory mapping */
+		} else if (!strcasecmp(v->name, "map_sound_files")) {
+			ast_option_map_sound_files = ast_true(v->value);
+		/* Batch astdb writes to disk */
+		} else if (!strcasecmp(v->name, "astdb_write_behind")) {
+			if (ast_parse_arg(v->value, PARSE_UINT32 | PARSE_IN_RANGE, &ast_option_astdb_write_behind, 0, 60000)) {
+				ast_log(LOG_WARNING, "Invalid astdb_write_behind '%s', astdb writes go to disk at once\n", v->value);
+				ast_option_astdb_write_behind = 0;
+			}
+		/* Rate limit security events per remote address */
+		} else if (!strcasecmp(v->name, "security_event_limit")) {
+			if (ast_parse_arg(v->value, PARSE_UINT32 | PARSE_IN_RANGE, &ast_option_security_event_limit, 0, 100000)) {
+				ast_log(LOG_WARNING, "Invalid security_event_limit '%s', security events are not limited\n", v->value);
+				ast_option_security_event_limit = 0;
+			}
+		} else if (!strcasecmp(v->name, "security_event_interval")) {
+			if (ast_parse_arg(v->value, PARSE_UINT32 | PARSE_IN_RANGE, &ast_option_security_event_interval, 1, 86400)) {
+				ast_log(LOG_WARNING, "Invalid security_event_interval '%s', using 60 seconds\n", v->value);
+				ast_option_security_event_interval = 60;
+			}
 		/* Specify cache directory */
 		} else if (!strcasecmp(v->name, "record_cache_dir")) {
 			ast_copy_string(record_cache_dir, v->value, AST_CACHE_DIR_LEN);
@@ -0,0 +1,220 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief System overload level
+ *
+ * Whichever caller finds the level stale samples the signals again, the
+ * others keep using the previous level meanwhile instead of waiting.
+ */
+
+#include "asterisk.h"
+
+#if defined(HAVE_SYSINFO)
+#include <sys/sysinfo.h>
+#endif
+
+#include "asterisk/_private.h"
+#include "asterisk/cli.h"
+#include "asterisk/lock.h"
+#include "asterisk/options.h"
+#include "asterisk/overload.h"
+#include "asterisk/taskprocessor.h"
+#include "asterisk/time.h"
+#include "asterisk/utils.h"
+
+/*! Milliseconds an overload level sample is used for */
+#define OVERLOAD_SAMPLE_INTERVAL 1000
+
+/*! Percentage of maxload from which the load is high */
+#define OVERLOAD_HIGH_LOAD_PERCENT 80
+
+/*! The free memory is high while below this multiple of minmemfree */
+#define OVERLOAD_HIGH_MEMORY_FACTOR 2
+
+/*! \brief The signals of the last sample */
+struct overload_sample {
+	/*! Number of taskprocessors in alert */
+	unsigned int taskprocessor_alerts;
+	/*! One minute load average, if maxload is set */
+	double load;
+	/*! Free memory in MB, if minmemfree is set, -1 otherwise */
+	long free_memory;
+	/*! When the sample was taken */
+	struct timeval when;
+};
+
+AST_MUTEX_DEFINE_STATIC(overload_lock);
+
+/*! The current level, read without a lock */
+static int overload_level;
+
+/*! The last sample, protected by overload_lock */
+static struct overload_sample overload_last;
+
+/*! \internal \brief Sample the signals and work out the level from them */
+static enum ast_overload_level overload_sample_take(struct overload_sample *sample)
+{
+	enum ast_overload_level level = AST_OVERLOAD_NONE;
+#if defined(HAVE_SYSINFO)
+	struct sysinfo sys_info;
+#endif
+
+	sample->when = ast_tvnow();
+
+	sample->taskprocessor_alerts = ast_taskprocessor_alert_get();
+	if (sample->taskprocessor_alerts) {
+		level = AST_OVERLOAD_HIGH;
+	}
+
+	sample->load = 0.0;
+	if (ast_option_maxload && getloadavg(&sample->load, 1) == 1) {
+		if (sample->load >= ast_option_maxload) {
+			level = AST_OVERLOAD_CRITICAL;
+		} else if (sample->load * 100 >= ast_option_maxload * OVERLOAD_HIGH_LOAD_PERCENT) {
+			level = MAX(level, AST_OVERLOAD_HIGH);
+		}
+	}
+
+	sample->free_memory = -1;
+#if defined(HAVE_SYSINFO)
+	if (option_minmemfree && !sysinfo(&sys_info)) {
+		uint64_t free_memory = sys_info.freeram + sys_info.bufferram;
+
+		/* As pbx.c, scaled in steps to avoid an overflow */
+		free_memory *= sys_info.mem_unit;
+		free_memory /= 1024 * 1024;
+		sample->free_memory = free_memory;
+		if (sample->free_memory < option_minmemfree) {
+			level = AST_OVERLOAD_CRITICAL;
+		} else if (sample->free_memory < option_minmemfree * OVERLOAD_HIGH_MEMORY_FACTOR) {
+			level = MAX(level, AST_OVERLOAD_HIGH);
+		}
+	}
+#endif
+
+	return level;
+}
+
+enum ast_overload_level ast_overload_level_get(void)
+{
+	enum ast_overload_level level;
+	enum ast_overload_level old_level;
+
+	if (ast_mutex_trylock(&overload_lock)) {
+		/* Someone else is sampling */
+		return overload_level;
+	}
+
+	if (!ast_tvzero(overload_last.when)
+		&& ast_tvdiff_ms(ast_tvnow(), overload_last.when) < OVERLOAD_SAMPLE_INTERVAL) {
+		ast_mutex_unlock(&overload_lock);
+		return overload_level;
+	}
+
+	level = overload_sample_take(&overload_last);
+	old_level = overload_level;
+	overload_level = level;
+	ast_mutex_unlock(&overload_lock);
+
+	if (level > old_level) {
+		ast_log(LOG_WARNING, "System overload level raised from %s to %s\n",
+			ast_overload_level_str(old_level), ast_overload_level_str(level));
+	} else if (level < old_level) {
+		ast_log(LOG_NOTICE, "System overload level lowered from %s to %s\n",
+			ast_overload_level_str(old_level), ast_overload_level_str(level));
+	}
+
+	return level;
+}
+
+const char *ast_overload_level_str(enum ast_overload_level level)
+{
+	switch (level) {
+	case AST_OVERLOAD_NONE:
+		return "none";
+	case AST_OVERLOAD_HIGH:
+		return "high";
+	case AST_OVERLOAD_CRITICAL:
+		return "critical";
+	}
+
+	return "unknown";
+}
+
+static char *handle_show_overload(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct overload_sample sample;
+	enum ast_overload_level level;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show overload";
+		e->usage =
+			"Usage: core show overload\n"
+			"       Shows the overload level of the system and the signals\n"
+			"       it was worked out from.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	level = ast_overload_level_get();
+	ast_mutex_lock(&overload_lock);
+	sample = overload_last;
+	ast_mutex_unlock(&overload_lock);
+
+	ast_cli(a->fd, "Overload level:           %s\n", ast_overload_level_str(level));
+	ast_cli(a->fd, "Taskprocessors in alert:  %u\n", sample.taskprocessor_alerts);
+	if (ast_option_maxload) {
+		ast_cli(a->fd, "Load average:             %.2f (maxload %.2f)\n",
+			sample.load, ast_option_maxload);
+	} else {
+		ast_cli(a->fd, "Load average:             not checked, maxload is not set\n");
+	}
+#if defined(HAVE_SYSINFO)
+	if (sample.free_memory >= 0) {
+		ast_cli(a->fd, "Free memory:              %ld MB (minmemfree %ld MB)\n",
+			sample.free_memory, option_minmemfree);
+	} else {
+		ast_cli(a->fd, "Free memory:              not checked, minmemfree is not set\n");
+	}
+#endif
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_overload[] = {
+	AST_CLI_DEFINE(handle_show_overload, "Show the overload level of the system"),
+};
+
+static void overload_shutdown(void)
+{
+	ast_cli_unregister_multiple(cli_overload, ARRAY_LEN(cli_overload));
+}
+
+int ast_overload_init(void)
+{
+	ast_cli_register_multiple(cli_overload, ARRAY_LEN(cli_overload));
+	ast_register_cleanup(overload_shutdown);
+
+	return 0;
+}
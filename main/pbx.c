@@ -61,6 +61,7 @@
 #include "asterisk/musiconhold.h"
 #include "asterisk/app.h"
 #include "asterisk/devicestate.h"
+#include "asterisk/sched.h"
 #include "asterisk/presencestate.h"
 #include "asterisk/hashtab.h"
 #include "asterisk/module.h"
@@ -247,6 +248,7 @@ struct ast_exten {
 	struct ast_app *cached_app;     /*!< Cached location of application */
 	void *data;			/*!< Data to use (arguments) */
 	void (*datad)(void *);		/*!< Data destructor */
+	struct pbx_substitute_template *data_template; /*!< Data parsed for variable substitution */
 	struct ast_exten *peer;		/*!< Next higher priority with our extension */
 	struct ast_hashtab *peer_table;    /*!< Priorities list in hashtab form -- only on the head of the peer list */
 	struct ast_hashtab *peer_label_table; /*!< labeled priorities in the peers -- only on the head of the peer list */
@@ -293,6 +295,9 @@ struct ast_context {
 	char *registrar;			/*!< Registrar -- make sure you malloc this, as the registrar may have to survive module unloads */
 	int refcount;                   /*!< each module that would have created this context should inc/dec this as appropriate */
 	int autohints;                  /*!< Whether autohints support is enabled or not */
+	int cidmatch_used;              /*!< Set once any extension in this context matches on caller id */
+	int match_cache_version;        /*!< Bumped whenever the extensions of this context change */
+	struct match_cache *match_cache; /*!< Memoized trie lookups, see extenmatchcache */
 	ast_mutex_t macrolock;			/*!< A lock to implement "exclusive" macros - held whilst a call is executing in the macro */
 	char name[0];				/*!< Name of the context */
 };
@@ -313,6 +318,12 @@ struct ast_state_cb {
 	AST_LIST_ENTRY(ast_state_cb) entry;
 };
 
+/*! \brief Last known state of one device of a hint */
+struct hint_device_state {
+	enum ast_device_state state;
+	char device[1];
+};
+
 /*!
  * \brief Structure for dial plan hints
  *
@@ -343,6 +354,15 @@ struct ast_hint {
 	char exten_name[AST_MAX_EXTENSION];/*!< Extension of destroyed hint extension. */
 
 	AST_VECTOR(, char *) devices; /*!< Devices associated with the hint */
+
+	/*! Last known states of the hint devices, laststate is aggregated from these */
+	AST_VECTOR(, struct hint_device_state *) device_states;
+	/*! Number of hint devices in each device state */
+	unsigned int device_state_counts[AST_DEVICE_TOTAL];
+	/*! device_states reflects the current hint devices */
+	unsigned int device_states_valid:1;
+	/*! A coalesced device state notification is scheduled */
+	unsigned int notify_pending:1;
 };
 
 STASIS_MESSAGE_TYPE_DEFN_LOCAL(hint_change_message_type);
@@ -762,8 +782,13 @@ static unsigned int hashtab_hash_labels(const void *obj)
 
 static int autofallthrough = 1;
 static int extenpatternmatchnew = 0;
+static int extenmatchcache = 0;
+static int hintnotifywindow = 0;
 static char *overrideswitch = NULL;
 
+/*! \brief Scheduler for coalesced hint notifications, see hintnotifywindow */
+static struct ast_sched_context *hint_notify_sched;
+
 /*! \brief Subscription for device state change events */
 static struct stasis_subscription *device_state_sub;
 /*! \brief Subscription for presence state change events */
@@ -789,6 +814,14 @@ AST_MUTEX_DEFINE_STATIC(conlock);
  */
 AST_MUTEX_DEFINE_STATIC(context_merge_lock);
 
+/*!
+ * \brief Bumped whenever the dialplan is locked for writing.
+ *
+ * Lets ast_merge_contexts_and_delete() scan the live dialplan without
+ * holding conlock throughout and still notice if it changed meanwhile.
+ */
+static int contexts_version;
+
 static int stateid = 1;
 /*!
  * \note When holding this container's lock, do _not_ do
@@ -2436,6 +2469,9 @@ struct fake_context /* this struct is purely for matching in the hashtab */
 	const char *registrar;
 	int refcount;
 	int autohints;
+	int cidmatch_used;
+	int match_cache_version;
+	struct match_cache *match_cache;
 	ast_mutex_t macrolock;
 	char name[256];
 };
@@ -2482,6 +2518,194 @@ static int matchcid(const char *cidpattern, const char *callerid)
 	return ast_extension_match(cidpattern, callerid);
 }
 
+/*
+ * lock.h has no load, store or compare and swap wrappers so provide the
+ * few needed by the match cache and the extension data templates here.
+ */
+#if defined(HAVE_C_ATOMICS)
+#define pbx_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define pbx_atomic_store(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define pbx_atomic_cas(ptr, oldval, newval) \
+	__atomic_compare_exchange_n((ptr), &(oldval), (newval), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define pbx_atomic_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+#define pbx_atomic_load(ptr) __sync_fetch_and_add((ptr), 0)
+#define pbx_atomic_store(ptr, val) \
+	do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+#define pbx_atomic_cas(ptr, oldval, newval) \
+	__sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#define pbx_atomic_fence() __sync_synchronize()
+#endif
+
+/*! \brief log2 of the number of slots in a context extension match cache */
+#define MATCH_CACHE_BITS 10
+
+/*! \brief Number of slots in a context extension match cache */
+#define MATCH_CACHE_SLOTS (1 << MATCH_CACHE_BITS)
+
+/*! \brief Longest extension or caller id a match cache slot can hold, including the terminator */
+#define MATCH_CACHE_KEY_LEN 24
+
+/*!
+ * \brief A memoized result of searching a context's pattern trie
+ *
+ * \details
+ * Slots are guarded by a sequence count instead of a lock.  A writer
+ * makes the count odd while it fills the slot in and a reader only
+ * trusts what it read when the count was even and unchanged across
+ * the read.
+ */
+struct match_cache_slot {
+	/*! Sequence count, odd while the slot is being written */
+	unsigned int seq;
+	/*! match_cache_version of the context when the search started */
+	int version;
+	/*! Best matching extension, NULL if nothing in the context matched */
+	struct ast_exten *eroot;
+	/*! Extension searched for */
+	char exten[MATCH_CACHE_KEY_LEN];
+	/*! Caller id searched with, empty if the context has no caller id matches */
+	char callerid[MATCH_CACHE_KEY_LEN];
+};
+
+/*! \brief Direct mapped cache of the pattern trie searches of a context */
+struct match_cache {
+	struct match_cache_slot slots[MATCH_CACHE_SLOTS];
+};
+
+/*!
+ * \internal
+ * \brief Get the match cache of a context, creating it if needed.
+ *
+ * \param con Context to get the cache of.
+ *
+ * \note Lookups only hold the contexts read lock so the cache is
+ * installed with a compare and swap.
+ *
+ * \return The cache or NULL on allocation failure.
+ */
+static struct match_cache *match_cache_get(struct ast_context *con)
+{
+	struct match_cache *cache;
+	struct match_cache *expected = NULL;
+
+	cache = pbx_atomic_load(&con->match_cache);
+	if (cache) {
+		return cache;
+	}
+
+	cache = ast_calloc(1, sizeof(*cache));
+	if (!cache) {
+		return NULL;
+	}
+	if (!pbx_atomic_cas(&con->match_cache, expected, cache)) {
+		/* Another thread beat us to it. */
+		ast_free(cache);
+		cache = pbx_atomic_load(&con->match_cache);
+	}
+	return cache;
+}
+
+/*!
+ * \internal
+ * \brief Discard every memoized lookup of a context.
+ *
+ * \param con Context whose extensions changed.
+ *
+ * \note Must be called after the change is complete so a lookup that
+ * sees the new version also sees the new extensions.
+ */
+static void match_cache_invalidate(struct ast_context *con)
+{
+	ast_atomic_fetch_add(&con->match_cache_version, 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * \internal
+ * \brief Search the pattern trie of a context, consulting the match cache.
+ *
+ * \param con Context to search.
+ * \param score Scoreboard filled in by new_find_extension().
+ * \param exten Extension to find.
+ * \param callerid Caller id to match with.
+ * \param label Label to find.
+ * \param action Type of search.
+ *
+ * \note Only E_MATCH and E_SPAWN searches are memoized. Their result
+ * depends on nothing but the extension and caller id while the other
+ * searches use more of the scoreboard or the label.
+ *
+ * \return The best matching extension or NULL.
+ */
+static struct ast_exten *match_cache_find_extension(struct ast_context *con, struct scoreboard *score,
+	const char *exten, const char *callerid, const char *label, enum ext_match_t action)
+{
+	struct match_cache *cache;
+	struct match_cache_slot *slot;
+	struct ast_exten *eroot;
+	const char *key_cid;
+	unsigned int seq;
+	unsigned int hash;
+	int version;
+	int hit;
+
+	if (!extenmatchcache || (action != E_MATCH && action != E_SPAWN)) {
+		new_find_extension(exten, score, con->pattern_tree, 0, 0, callerid, label, action);
+		return score->exten;
+	}
+
+	key_cid = con->cidmatch_used ? S_OR(callerid, "") : "";
+	if (strlen(exten) >= MATCH_CACHE_KEY_LEN || strlen(key_cid) >= MATCH_CACHE_KEY_LEN
+		|| !(cache = match_cache_get(con))) {
+		new_find_extension(exten, score, con->pattern_tree, 0, 0, callerid, label, action);
+		return score->exten;
+	}
+
+	version = ast_atomic_fetch_add(&con->match_cache_version, 0, __ATOMIC_ACQUIRE);
+	/*
+	 * Dialed numbers tend to differ only in their last digits which
+	 * ast_str_hash() leaves in its low bits, so use the well mixed
+	 * high bits of a multiplicative hash to pick the slot.
+	 */
+	hash = ast_str_hash(exten);
+	if (*key_cid) {
+		hash = hash * 33 + ast_str_hash(key_cid);
+	}
+	slot = &cache->slots[(hash * 2654435761U) >> (32 - MATCH_CACHE_BITS)];
+
+	seq = pbx_atomic_load(&slot->seq);
+	if (!(seq & 1)) {
+		/*
+		 * The key buffers are always terminated so a racing writer
+		 * can only make the comparison fail, which is then caught
+		 * by the sequence check.
+		 */
+		hit = slot->version == version
+			&& !strcmp(slot->exten, exten)
+			&& !strcmp(slot->callerid, key_cid);
+		eroot = slot->eroot;
+		pbx_atomic_fence();
+		if (hit && pbx_atomic_load(&slot->seq) == seq) {
+			score->exten = eroot;
+			return eroot;
+		}
+	}
+
+	new_find_extension(exten, score, con->pattern_tree, 0, 0, callerid, label, action);
+
+	seq = pbx_atomic_load(&slot->seq);
+	if (!(seq & 1) && pbx_atomic_cas(&slot->seq, seq, seq + 1)) {
+		slot->version = version;
+		slot->eroot = score->exten;
+		ast_copy_string(slot->exten, exten, sizeof(slot->exten));
+		ast_copy_string(slot->callerid, key_cid, sizeof(slot->callerid));
+		pbx_atomic_store(&slot->seq, seq + 2);
+	}
+	/* else another thread is filling the slot in, let it have it. */
+
+	return score->exten;
+}
+
 struct ast_exten *pbx_find_extension(struct ast_channel *chan,
 	struct ast_context *bypass, struct pbx_find_info *q,
 	const char *context, const char *exten, int priority,
@@ -2607,9 +2831,8 @@ struct ast_exten *pbx_find_extension(struct ast_channel *chan,
 		}
 	} while (0);
 
-	if (extenpatternmatchnew) {
-		new_find_extension(exten, &score, tmp->pattern_tree, 0, 0, callerid, label, action);
-		eroot = score.exten;
+	if (extenpatternmatchnew || extenmatchcache) {
+		eroot = match_cache_find_extension(tmp, &score, exten, callerid, label, action);
 
 		if (score.last_char == '!' && action == E_MATCHMORE) {
 			/* We match an extension ending in '!'.
@@ -2872,6 +3095,39 @@ static struct ast_custom_function exception_function = {
  * auto-service code will queue up any important signalling frames to be processed
  * after this is done.
  */
+/*!
+ * \internal
+ * \brief Get the parsed data of an extension, parsing it if needed.
+ *
+ * \param e Extension to get the data template of.
+ *
+ * \note The contexts lock must be held.  Only the contexts read lock
+ * may be held so the template is installed with a compare and swap.
+ *
+ * \return Template with a reference added or NULL on allocation failure.
+ */
+static struct pbx_substitute_template *exten_data_template(struct ast_exten *e)
+{
+	struct pbx_substitute_template *data_template;
+	struct pbx_substitute_template *expected = NULL;
+
+	data_template = pbx_atomic_load(&e->data_template);
+	if (data_template) {
+		return ao2_bump(data_template);
+	}
+
+	data_template = pbx_substitute_template_compile(e->data);
+	if (!data_template) {
+		return NULL;
+	}
+	if (!pbx_atomic_cas(&e->data_template, expected, data_template)) {
+		/* Another thread beat us to it. */
+		ao2_ref(data_template, -1);
+		data_template = pbx_atomic_load(&e->data_template);
+	}
+	return ao2_bump(data_template);
+}
+
 static int pbx_extension_helper(struct ast_channel *c, struct ast_context *con,
   const char *context, const char *exten, int priority,
   const char *label, const char *callerid, enum ext_match_t action, int *found, int combined_find_spawn)
@@ -2879,6 +3135,7 @@ static int pbx_extension_helper(struct ast_channel *c, struct ast_context *con,
 	struct ast_exten *e;
 	struct ast_app *app;
 	char *substitute = NULL;
+	struct pbx_substitute_template *data_template = NULL;
 	struct pbx_find_info q = { .stacklen = 0 }; /* the rest is reset in pbx_find_extension */
 	char passdata[EXT_DATA_SIZE];
 	int matching_action = (action == E_MATCH || action == E_CANMATCH || action == E_MATCHMORE);
@@ -2918,13 +3175,17 @@ static int pbx_extension_helper(struct ast_channel *c, struct ast_context *con,
 					/* no variables to substitute, copy on through */
 					ast_copy_string(passdata, e->data, sizeof(passdata));
 				} else {
-					/* save e->data on stack for later processing after lock released */
-					substitute = ast_strdupa(e->data);
+					/* hold the parsed e->data for later processing after lock released */
+					data_template = exten_data_template(e);
+					if (!data_template) {
+						substitute = ast_strdupa(e->data);
+					}
 				}
 			}
 			ast_unlock_contexts();
 			if (!app) {
 				ast_log(LOG_WARNING, "No application '%s' for extension (%s, %s, %d)\n", e->app, context, exten, priority);
+				ao2_cleanup(data_template);
 				return -1;
 			}
 			if (ast_channel_context(c) != context)
@@ -2932,7 +3193,11 @@ static int pbx_extension_helper(struct ast_channel *c, struct ast_context *con,
 			if (ast_channel_exten(c) != exten)
 				ast_channel_exten_set(c, exten);
 			ast_channel_priority_set(c, priority);
-			if (substitute) {
+			if (data_template) {
+				pbx_substitute_template_helper_full(c, ast_channel_varshead(c), data_template,
+					passdata, sizeof(passdata) - 1, NULL);
+				ao2_ref(data_template, -1);
+			} else if (substitute) {
 				pbx_substitute_variables_helper(c, substitute, passdata, sizeof(passdata)-1);
 			}
 			ast_debug(1, "Launching '%s'\n", app_name(app));
@@ -3367,12 +3632,135 @@ static void get_device_state_causing_channels(struct ao2_container *c)
 	ao2_iterator_destroy(&iter);
 }
 
+/*!
+ * \internal
+ * \brief Forget the last known device states of a hint
+ *
+ * \note The hint must be locked.
+ */
+static void hint_device_states_clear(struct ast_hint *hint)
+{
+	AST_VECTOR_RESET(&hint->device_states, ast_free);
+	memset(hint->device_state_counts, 0, sizeof(hint->device_state_counts));
+	hint->device_states_valid = 0;
+}
+
+/*!
+ * \internal
+ * \brief Remember the device states found by a full evaluation of a hint
+ *
+ * \note The hint must be locked.
+ */
+static void hint_device_states_set(struct ast_hint *hint, struct ao2_container *device_state_info)
+{
+	struct ao2_iterator iter;
+	struct ast_device_state_info *info;
+
+	hint_device_states_clear(hint);
+
+	iter = ao2_iterator_init(device_state_info, 0);
+	for (; (info = ao2_iterator_next(&iter)); ao2_ref(info, -1)) {
+		struct hint_device_state *device_state;
+
+		if (info->device_state >= AST_DEVICE_TOTAL
+			|| !(device_state = ast_malloc(sizeof(*device_state) + strlen(info->device_name)))) {
+			break;
+		}
+		device_state->state = info->device_state;
+		strcpy(device_state->device, info->device_name); /* SAFE */
+		if (AST_VECTOR_APPEND(&hint->device_states, device_state)) {
+			ast_free(device_state);
+			break;
+		}
+		hint->device_state_counts[device_state->state]++;
+	}
+	ao2_iterator_destroy(&iter);
+
+	if (info) {
+		/* Could not remember every device, so evaluate in full next time too */
+		ao2_ref(info, -1);
+		hint_device_states_clear(hint);
+		return;
+	}
+
+	hint->device_states_valid = 1;
+}
+
+/*!
+ * \internal
+ * \brief Apply the new state of one device to the last known states of a hint
+ *
+ * \note The hint must be locked.
+ *
+ * \retval 0 on success
+ * \retval -1 if the hint has to be evaluated in full
+ */
+static int hint_device_states_update(struct ast_hint *hint, const char *device, enum ast_device_state state)
+{
+	int i;
+
+	if (!hint->device_states_valid || state >= AST_DEVICE_TOTAL) {
+		return -1;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&hint->device_states); i++) {
+		struct hint_device_state *device_state = AST_VECTOR_GET(&hint->device_states, i);
+
+		if (!strcasecmp(device_state->device, device)) {
+			hint->device_state_counts[device_state->state]--;
+			hint->device_state_counts[state]++;
+			device_state->state = state;
+		}
+	}
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Aggregate the last known device states of a hint
+ *
+ * Aggregation only depends on which states are present, so each one is
+ * added once no matter how many devices are in it.
+ *
+ * \note The hint must be locked.
+ */
+static int hint_device_states_aggregate(struct ast_hint *hint, struct ao2_container *device_state_info)
+{
+	struct ast_devstate_aggregate agg;
+	int i;
+
+	ast_devstate_aggregate_init(&agg);
+	for (i = 0; i < AST_DEVICE_TOTAL; i++) {
+		if (hint->device_state_counts[i]) {
+			ast_devstate_aggregate_add(&agg, i);
+		}
+	}
+
+	for (i = 0; device_state_info && i < AST_VECTOR_SIZE(&hint->device_states); i++) {
+		struct hint_device_state *device_state = AST_VECTOR_GET(&hint->device_states, i);
+		struct ast_device_state_info *obj;
+
+		obj = ao2_alloc_options(sizeof(*obj) + strlen(device_state->device),
+			device_state_info_dt, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (obj) {
+			obj->device_state = device_state->state;
+			strcpy(obj->device_name, device_state->device); /* SAFE */
+			ao2_link(device_state_info, obj);
+			ao2_ref(obj, -1);
+		}
+	}
+
+	return ast_devstate_to_extenstate(ast_devstate_aggregate_result(&agg));
+}
+
 static void device_state_notify_callbacks(struct ast_hint *hint, struct ast_str **hint_app)
 {
 	struct ao2_iterator cb_iter;
 	struct ast_state_cb *state_cb;
-	int state;
+	int state = 0;
 	int same_state;
+	int evaluated = 0;
 	struct ao2_container *device_state_info;
 	int first_extended_cb_call = 1;
 	char context_name[AST_MAX_CONTEXT];
@@ -3395,22 +3783,41 @@ static void device_state_notify_callbacks(struct ast_hint *hint, struct ast_str
 	ast_copy_string(exten_name, ast_get_extension_name(hint->exten),
 			sizeof(exten_name));
 	ast_str_set(hint_app, 0, "%s", ast_get_extension_app(hint->exten));
-	ao2_unlock(hint);
-
-	/*
-	 * Get device state for this hint.
-	 *
-	 * NOTE: We cannot hold any locks while determining the hint
-	 * device state or notifying the watchers without causing a
-	 * deadlock.  (conlock, hints, and hint)
-	 */
 
 	/* Make a container so state3 can fill it if we wish.
 	 * If that failed we simply do not provide the extended state info.
 	 */
 	device_state_info = alloc_device_state_info();
 
-	state = ast_extension_state3(*hint_app, device_state_info);
+	/* Device state changes are applied as they arrive, so usually the states are known */
+	if (hint->device_states_valid) {
+		state = hint_device_states_aggregate(hint, device_state_info);
+		evaluated = 1;
+	}
+	ao2_unlock(hint);
+
+	if (!evaluated) {
+		/* Evaluation leaves only the devices in hint_app */
+		char *app = ast_strdupa(ast_str_buffer(*hint_app));
+
+		/*
+		 * Get device state for this hint.
+		 *
+		 * NOTE: We cannot hold any locks while determining the hint
+		 * device state or notifying the watchers without causing a
+		 * deadlock.  (conlock, hints, and hint)
+		 */
+		state = ast_extension_state3(*hint_app, device_state_info);
+
+		if (device_state_info) {
+			ao2_lock(hint);
+			if (hint->exten && !strcmp(ast_get_extension_app(hint->exten), app)) {
+				hint_device_states_set(hint, device_state_info);
+			}
+			ao2_unlock(hint);
+		}
+	}
+
 	same_state = state == hint->laststate;
 	if (same_state && (~state & AST_EXTENSION_RINGING)) {
 		ao2_cleanup(device_state_info);
@@ -3461,6 +3868,71 @@ static void device_state_notify_callbacks(struct ast_hint *hint, struct ast_str
 	ao2_cleanup(device_state_info);
 }
 
+/*! \internal \brief Send a coalesced device state notification for a hint */
+static int hint_notify_deferred(const void *data)
+{
+	struct ast_hint *hint = (struct ast_hint *) data;
+	struct ast_str *hint_app;
+
+	ao2_lock(hint);
+	hint->notify_pending = 0;
+	ao2_unlock(hint);
+
+	hint_app = ast_str_create(1024);
+	if (hint_app) {
+		device_state_notify_callbacks(hint, &hint_app);
+		ast_free(hint_app);
+	}
+
+	ao2_ref(hint, -1);
+
+	return 0;
+}
+
+/*! \internal \brief Drop the hint reference of an unsent coalesced notification */
+static int hint_notify_cleanup(const void *data)
+{
+	struct ast_hint *hint = (struct ast_hint *) data;
+
+	ao2_ref(hint, -1);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Notify the watchers of a hint after a device state change
+ *
+ * With a hintnotifywindow the notification is held for the window, so
+ * every change made to the hint devices within it results in one.
+ */
+static void device_state_notify(struct ast_hint *hint, struct ast_str **hint_app)
+{
+	int window = hintnotifywindow;
+
+	if (window <= 0 || !hint_notify_sched) {
+		device_state_notify_callbacks(hint, hint_app);
+		return;
+	}
+
+	ao2_lock(hint);
+	if (hint->notify_pending) {
+		ao2_unlock(hint);
+		return;
+	}
+	hint->notify_pending = 1;
+	ao2_unlock(hint);
+
+	ao2_ref(hint, +1);
+	if (ast_sched_add(hint_notify_sched, window, hint_notify_deferred, hint) < 0) {
+		ao2_lock(hint);
+		hint->notify_pending = 0;
+		ao2_unlock(hint);
+		ao2_ref(hint, -1);
+		device_state_notify_callbacks(hint, hint_app);
+	}
+}
+
 static void presence_state_notify_callbacks(struct ast_hint *hint, struct ast_str **hint_app,
 					    struct ast_presence_state_message *presence_state)
 {
@@ -3655,9 +4127,17 @@ static void device_state_cb(void *unused, struct stasis_subscription *sub, struc
 		"find devices in container");
 	if (dev_iter) {
 		for (; (device = ao2_iterator_next(dev_iter)); ao2_t_ref(device, -1, "Next device")) {
-			if (device->hint) {
-				device_state_notify_callbacks(device->hint, &hint_app);
+			if (!device->hint) {
+				continue;
 			}
+
+			ao2_lock(device->hint);
+			if (hint_device_states_update(device->hint, dev_state->device, dev_state->state)) {
+				hint_device_states_clear(device->hint);
+			}
+			ao2_unlock(device->hint);
+
+			device_state_notify(device->hint, &hint_app);
 		}
 		ao2_iterator_destroy(dev_iter);
 	}
@@ -3916,6 +4396,8 @@ static void destroy_hint(void *obj)
 		ast_free(device);
 	}
 	AST_VECTOR_FREE(&hint->devices);
+	AST_VECTOR_CALLBACK_VOID(&hint->device_states, ast_free);
+	AST_VECTOR_FREE(&hint->device_states);
 	ast_free(hint->last_presence_subtype);
 	ast_free(hint->last_presence_message);
 }
@@ -4001,6 +4483,7 @@ static int ast_add_hint(struct ast_exten *e)
 		return -1;
 	}
 	AST_VECTOR_INIT(&hint_new->devices, 8);
+	AST_VECTOR_INIT(&hint_new->device_states, 0);
 
 	/* Initialize new hint. */
 	hint_new->callbacks = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_MUTEX, 0, NULL, hint_id_cmp);
@@ -4119,6 +4602,8 @@ static int ast_change_hint(struct ast_exten *oe, struct ast_exten *ne)
 	/* Update the hint and put it back in the hints container. */
 	ao2_lock(hint);
 	hint->exten = ne;
+	/* The devices may have changed, so evaluate in full on the next change */
+	hint_device_states_clear(hint);
 
 	ao2_unlock(hint);
 
@@ -4686,6 +5171,7 @@ static void destroy_exten(struct ast_exten *e)
 		ast_hashtab_destroy(e->peer_label_table, 0);
 	if (e->datad)
 		e->datad(e->data);
+	ao2_cleanup(e->data_template);
 	ast_free(e);
 }
 
@@ -4785,6 +5271,20 @@ int pbx_set_extenpatternmatchnew(int newval)
 	return oldval;
 }
 
+int pbx_set_extenmatchcache(int newval)
+{
+	int oldval = extenmatchcache;
+	extenmatchcache = newval;
+	return oldval;
+}
+
+int pbx_set_hintnotifywindow(int newval)
+{
+	int oldval = hintnotifywindow;
+	hintnotifywindow = MAX(newval, 0);
+	return oldval;
+}
+
 void pbx_set_overrideswitch(const char *newval)
 {
 	if (overrideswitch) {
@@ -5098,6 +5598,7 @@ int ast_context_remove_extension_callerid2(struct ast_context *con, const char *
 	}
 	if (!exten) {
 		/* we can't find right extension */
+		match_cache_invalidate(con);
 		if (!already_locked)
 			ast_unlock_context(con);
 		return -1;
@@ -5147,6 +5648,7 @@ int ast_context_remove_extension_callerid2(struct ast_context *con, const char *
 			previous_peer = peer;
 		}
 	}
+	match_cache_invalidate(con);
 	if (!already_locked)
 		ast_unlock_context(con);
 	return found ? 0 : -1;
@@ -6328,6 +6830,35 @@ static void context_merge_incls_swits_igps_other_registrars(struct ast_context *
 	}
 }
 
+/*!
+ * \internal
+ * \brief Build the pattern trie of every context in a table.
+ *
+ * \param table Table of contexts that are about to go live.
+ *
+ * \note Doing this before the contexts are published keeps the first
+ * calls after a reload from paying for the trie build, and from racing
+ * each other to build it.  The match caches are still only allocated
+ * for the contexts that are actually searched.
+ */
+static void context_table_compile(struct ast_hashtab *table)
+{
+	struct ast_context *con;
+	struct ast_hashtab_iter *iter;
+
+	if (!extenmatchcache) {
+		return;
+	}
+
+	iter = ast_hashtab_start_traversal(table);
+	while ((con = ast_hashtab_next(iter))) {
+		if (!con->pattern_tree && con->root_table) {
+			create_match_char_tree(con);
+		}
+	}
+	ast_hashtab_end_traversal(iter);
+}
+
 /*! Set up an autohint placeholder in the hints container */
 static void context_table_create_autohints(struct ast_hashtab *table)
 {
@@ -6464,8 +6995,178 @@ static void context_merge(struct ast_context **extcontexts, struct ast_hashtab *
 }
 
 
+/*! \brief Number of extensions scanned between letting go of conlock */
+#define CONTEXT_MERGE_SCAN_YIELD 4096
+
+AST_VECTOR(context_vector, struct ast_context *);
+
+/*!
+ * \internal
+ * \brief Determine if a merge replaces a context.
+ *
+ * \param changed Names of the contexts being replaced, NULL for all of them.
+ * \param name Name of the context.
+ */
+static int context_merge_in_scope(struct ao2_container *changed, const char *name)
+{
+	char *found;
+
+	if (!changed) {
+		return 1;
+	}
+
+	found = ao2_find(changed, name, OBJ_SEARCH_KEY);
+	ao2_cleanup(found);
+
+	return found != NULL;
+}
+
+/*!
+ * \internal
+ * \brief Determine if context_merge() may carry anything over from a context.
+ *
+ * \param con Context of the live dialplan.
+ * \param registrar Registrar whose dialplan is being replaced.
+ *
+ * \note Call with conlock held.
+ *
+ * \retval 0 if everything in the context belongs to \a registrar.
+ */
+static int context_merge_needed(struct ast_context *con, const char *registrar)
+{
+	struct ast_hashtab_iter *exten_iter;
+	struct ast_hashtab_iter *prio_iter;
+	struct ast_exten *exten_item;
+	struct ast_exten *prio_item;
+	int needed = 0;
+
+	if (!con->root_table || strcmp(con->registrar, registrar) || con->refcount > 1) {
+		return 1;
+	}
+
+	ast_rdlock_context(con);
+	exten_iter = ast_hashtab_start_traversal(con->root_table);
+	while (!needed && (exten_item = ast_hashtab_next(exten_iter))) {
+		prio_iter = ast_hashtab_start_traversal(exten_item->peer_table);
+		while ((prio_item = ast_hashtab_next(prio_iter))) {
+			if (strcmp(prio_item->registrar, registrar)) {
+				needed = 1;
+				break;
+			}
+		}
+		ast_hashtab_end_traversal(prio_iter);
+	}
+	ast_hashtab_end_traversal(exten_iter);
+	ast_unlock_context(con);
+
+	return needed;
+}
+
+/*!
+ * \internal
+ * \brief Find the contexts of the live dialplan that a merge has to look at.
+ *
+ * \param registrar Registrar whose dialplan is being replaced.
+ * \param changed Names of the contexts being replaced, NULL for all of them.
+ * \param needed Filled with the contexts context_merge() has to be run on.
+ * \param version Set to the dialplan version the scan saw.
+ *
+ * The scan lets go of conlock every so often so calls are not held up
+ * behind a large dialplan.  The contexts found are only valid for as long
+ * as the dialplan version stays the same.
+ *
+ * \note Call with context_merge_lock held and conlock not held.
+ *
+ * \retval 0 on success.
+ * \retval -1 if the dialplan changed during the scan or memory ran out.
+ */
+static int context_merge_scan(const char *registrar, struct ao2_container *changed,
+	struct context_vector *needed, int *version)
+{
+	struct ast_hashtab_iter *iter;
+	struct ast_context *con;
+	int scanned = 0;
+	int res = 0;
+
+	ast_rdlock_contexts();
+	*version = contexts_version;
+	if (!contexts_table) {
+		ast_unlock_contexts();
+		return 0;
+	}
+
+	iter = ast_hashtab_start_traversal(contexts_table);
+	while ((con = ast_hashtab_next(iter))) {
+		if (!context_merge_in_scope(changed, con->name)) {
+			continue;
+		}
+		if (context_merge_needed(con, registrar) && AST_VECTOR_APPEND(needed, con)) {
+			res = -1;
+			break;
+		}
+
+		scanned += con->root_table ? ast_hashtab_size(con->root_table) : 1;
+		if (scanned >= CONTEXT_MERGE_SCAN_YIELD) {
+			scanned = 0;
+			ast_unlock_contexts();
+			ast_rdlock_contexts();
+			if (contexts_version != *version) {
+				res = -1;
+				break;
+			}
+		}
+	}
+	ast_hashtab_end_traversal(iter);
+	ast_unlock_contexts();
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Move the contexts a merge leaves alone into the new dialplan.
+ *
+ * \param extcontexts List of the new dialplan.
+ * \param exttable Table of the new dialplan.
+ * \param registrar Registrar whose dialplan is being replaced.
+ * \param changed Names of the contexts being replaced.
+ *
+ * The contexts are moved as they are, so their extensions and the hints
+ * on them stay untouched.  What is left in the live list is deleted once
+ * the new dialplan is in.
+ *
+ * \note Call with conlock held.
+ */
+static void context_merge_keep_unchanged(struct ast_context **extcontexts, struct ast_hashtab *exttable,
+	const char *registrar, struct ao2_container *changed)
+{
+	struct ast_context **prev = &contexts;
+	struct ast_context *con;
+	struct ast_context *next;
+
+	for (con = contexts; con; con = next) {
+		next = con->next;
+		if (context_merge_in_scope(changed, con->name)) {
+			prev = &con->next;
+			continue;
+		}
+		if (ast_hashtab_lookup(exttable, con)) {
+			/* The new dialplan has it after all, merge it the usual way. */
+			context_merge(extcontexts, exttable, con, registrar);
+			prev = &con->next;
+			continue;
+		}
+
+		*prev = next;
+		con->next = *extcontexts;
+		*extcontexts = con;
+		ast_hashtab_insert_safe(exttable, con);
+	}
+}
+
 /* XXX this does not check that multiple contexts are merged */
-void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable, const char *registrar)
+static void merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable,
+	const char *registrar, struct ao2_container *changed)
 {
 	double ft;
 	struct ast_context *tmp;
@@ -6481,7 +7182,12 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 	struct ast_hashtab_iter *iter;
 	struct ao2_iterator i;
 	int ctx_count = 0;
+	struct context_vector needed;
+	int version;
+	int res;
+	int idx;
 	struct timeval begintime;
+	struct timeval locktime;
 	struct timeval writelocktime;
 	struct timeval endlocktime;
 	struct timeval enddeltime;
@@ -6500,7 +7206,22 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 
 	begintime = ast_tvnow();
 	ast_mutex_lock(&context_merge_lock);/* Serialize ast_merge_contexts_and_delete */
+
+	/*
+	 * The new dialplan is private until it is swapped in, so the bulk
+	 * of its pattern tries is built before anything is locked.
+	 */
+	context_table_compile(exttable);
+
+	/*
+	 * Most of the live dialplan usually belongs to the registrar being
+	 * reloaded and has nothing to carry over.  Find what does while
+	 * letting calls through, then only merge that with the lock held.
+	 */
+	AST_VECTOR_INIT(&needed, 0);
+	res = context_merge_scan(registrar, changed, &needed, &version);
 	ast_wrlock_contexts();
+	locktime = ast_tvnow();
 
 	if (!contexts_table) {
 		/* Create any autohint contexts */
@@ -6511,15 +7232,32 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 		contexts = *extcontexts;
 		ast_unlock_contexts();
 		ast_mutex_unlock(&context_merge_lock);
+		AST_VECTOR_FREE(&needed);
 		return;
 	}
 
-	iter = ast_hashtab_start_traversal(contexts_table);
-	while ((tmp = ast_hashtab_next(iter))) {
-		++ctx_count;
-		context_merge(extcontexts, exttable, tmp, registrar);
+	ctx_count = ast_hashtab_size(contexts_table);
+	/* Our own write lock moved the version on once. */
+	if (res || contexts_version != version + 1) {
+		ast_debug(1, "Dialplan changed while scanning it, merging all of it\n");
+		iter = ast_hashtab_start_traversal(contexts_table);
+		while ((tmp = ast_hashtab_next(iter))) {
+			if (context_merge_in_scope(changed, tmp->name)) {
+				context_merge(extcontexts, exttable, tmp, registrar);
+			}
+		}
+		ast_hashtab_end_traversal(iter);
+	} else {
+		for (idx = 0; idx < AST_VECTOR_SIZE(&needed); ++idx) {
+			context_merge(extcontexts, exttable, AST_VECTOR_GET(&needed, idx), registrar);
+		}
 	}
-	ast_hashtab_end_traversal(iter);
+	AST_VECTOR_FREE(&needed);
+	if (changed) {
+		context_merge_keep_unchanged(extcontexts, exttable, registrar, changed);
+	}
+	/* Only the contexts the merge created still need their tries built. */
+	context_table_compile(exttable);
 
 	ao2_lock(hints);
 	writelocktime = ast_tvnow();
@@ -6536,6 +7274,11 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 				ao2_unlock(hint);
 				continue;
 			}
+			if (!context_merge_in_scope(changed, hint->exten->parent->name)) {
+				/* The context is kept as it is, and so is the hint. */
+				ao2_unlock(hint);
+				continue;
+			}
 
 			exten_len = strlen(hint->exten->exten) + 1;
 			length = exten_len + strlen(hint->exten->parent->name) + 1
@@ -6680,9 +7423,13 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 	}
 	enddeltime = ast_tvnow();
 
-	ft = ast_tvdiff_us(writelocktime, begintime);
+	ft = ast_tvdiff_us(locktime, begintime);
 	ft /= 1000000.0;
-	ast_verb(3,"Time to scan old dialplan and merge leftovers back into the new: %8.6f sec\n", ft);
+	ast_verb(3,"Time to build the new dialplan and scan the old one: %8.6f sec\n", ft);
+
+	ft = ast_tvdiff_us(writelocktime, locktime);
+	ft /= 1000000.0;
+	ast_verb(3,"Time to merge leftovers back into the new: %8.6f sec\n", ft);
 
 	ft = ast_tvdiff_us(endlocktime, writelocktime);
 	ft /= 1000000.0;
@@ -6698,6 +7445,17 @@ void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_
 	ast_verb(3, "%s successfully loaded %d contexts (enable debug for details).\n", registrar, ctx_count);
 }
 
+void ast_merge_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable, const char *registrar)
+{
+	merge_contexts_and_delete(extcontexts, exttable, registrar, NULL);
+}
+
+void ast_merge_changed_contexts_and_delete(struct ast_context **extcontexts, struct ast_hashtab *exttable,
+	const char *registrar, struct ao2_container *changed)
+{
+	merge_contexts_and_delete(extcontexts, exttable, registrar, changed);
+}
+
 /*
  * errno values
  *  EBUSY  - can't lock
@@ -7469,6 +8227,10 @@ static int ast_add_extension2_lockopt(struct ast_context *con,
 		ast_wrlock_context(con);
 	}
 
+	if (tmp->matchcid == AST_EXT_MATCHCID_ON) {
+		con->cidmatch_used = 1;
+	}
+
 	if (con->pattern_tree) { /* usually, on initial load, the pattern_tree isn't formed until the first find_exten; so if we are adding
 								an extension, and the trie exists, then we need to incrementally add this pattern to it. */
 		ext_strncpy(dummy_name, tmp->exten, sizeof(dummy_name), 1);
@@ -7520,6 +8282,9 @@ static int ast_add_extension2_lockopt(struct ast_context *con,
 
 			ast_free(tmp);
 		}
+		if (res >= 0) {
+			match_cache_invalidate(con);
+		}
 		if (lock_context) {
 			ast_unlock_context(con);
 		}
@@ -7564,6 +8329,7 @@ static int ast_add_extension2_lockopt(struct ast_context *con,
 		}
 		ast_hashtab_insert_safe(tmp->peer_table, tmp);
 		ast_hashtab_insert_safe(con->root_table, tmp);
+		match_cache_invalidate(con);
 
 		if (lock_context) {
 			ast_unlock_context(con);
@@ -7607,6 +8373,10 @@ struct pbx_outgoing {
 	unsigned int dialed:1;
 	/*! \brief Set if we've spawned a thread to do our work */
 	unsigned int in_separate_thread:1;
+	/*! \brief Set if an answered leg is handed to a thread of its own */
+	unsigned int detach_answered:1;
+	/*! \brief Answered leg handed to the application thread */
+	struct ast_channel *answered;
 };
 
 /*! \brief Destructor for outgoing structure */
@@ -7623,6 +8393,71 @@ static void pbx_outgoing_destroy(void *obj)
 	ast_free(outgoing->appdata);
 }
 
+/*! \brief Internal function which sets the dialplan location an answered outgoing leg starts at */
+static void pbx_outgoing_set_location(struct pbx_outgoing *outgoing, struct ast_channel *chan)
+{
+	if (!ast_strlen_zero(outgoing->context)) {
+		ast_channel_context_set(chan, outgoing->context);
+	}
+
+	if (!ast_strlen_zero(outgoing->exten)) {
+		ast_channel_exten_set(chan, outgoing->exten);
+	}
+
+	if (outgoing->priority > 0) {
+		ast_channel_priority_set(chan, outgoing->priority);
+	}
+}
+
+/*! \brief Internal function which runs the application on an answered outgoing leg */
+static void pbx_outgoing_app_run(struct pbx_outgoing *outgoing, struct ast_channel *chan)
+{
+	struct ast_app *app = pbx_findapp(outgoing->app);
+
+	if (app) {
+		ast_verb(4, "Launching %s(%s) on %s\n", outgoing->app, S_OR(outgoing->appdata, ""),
+			ast_channel_name(chan));
+		pbx_exec(chan, app, outgoing->appdata);
+	} else {
+		ast_log(LOG_WARNING, "No such application '%s'\n", outgoing->app);
+	}
+
+	ast_hangup(chan);
+}
+
+/*! \brief Internal thread which runs the application on an answered outgoing leg dialed inline */
+static void *pbx_outgoing_app_exec(void *data)
+{
+	RAII_VAR(struct pbx_outgoing *, outgoing, data, ao2_cleanup);
+
+	pbx_outgoing_app_run(outgoing, outgoing->answered);
+
+	return NULL;
+}
+
+/*! \brief Internal function which hands an answered outgoing leg dialed inline to a thread of its own */
+static void pbx_outgoing_detach(struct pbx_outgoing *outgoing, struct ast_channel *chan)
+{
+	pthread_t thread;
+
+	if (ast_strlen_zero(outgoing->app)) {
+		pbx_outgoing_set_location(outgoing, chan);
+		if (ast_pbx_start(chan)) {
+			ast_log(LOG_ERROR, "Failed to start PBX on %s\n", ast_channel_name(chan));
+			ast_hangup(chan);
+		}
+		return;
+	}
+
+	outgoing->answered = chan;
+	ao2_ref(outgoing, +1);
+	if (ast_pthread_create_detached(&thread, NULL, pbx_outgoing_app_exec, outgoing)) {
+		ast_log(LOG_WARNING, "Unable to spawn application thread for '%s'\n", ast_channel_name(chan));
+		ao2_ref(outgoing, -1);
+		ast_hangup(chan);
+	}
+}
+
 /*! \brief Internal function which dials an outgoing leg and sends it to a provided extension or application */
 static void *pbx_outgoing_exec(void *data)
 {
@@ -7652,30 +8487,12 @@ static void *pbx_outgoing_exec(void *data)
 	/* We steal the channel so we get ownership of when it is hung up */
 	chan = ast_dial_answered_steal(outgoing->dial);
 
-	if (!ast_strlen_zero(outgoing->app)) {
-		struct ast_app *app = pbx_findapp(outgoing->app);
-
-		if (app) {
-			ast_verb(4, "Launching %s(%s) on %s\n", outgoing->app, S_OR(outgoing->appdata, ""),
-				ast_channel_name(chan));
-			pbx_exec(chan, app, outgoing->appdata);
-		} else {
-			ast_log(LOG_WARNING, "No such application '%s'\n", outgoing->app);
-		}
-
-		ast_hangup(chan);
+	if (outgoing->detach_answered) {
+		pbx_outgoing_detach(outgoing, chan);
+	} else if (!ast_strlen_zero(outgoing->app)) {
+		pbx_outgoing_app_run(outgoing, chan);
 	} else {
-		if (!ast_strlen_zero(outgoing->context)) {
-			ast_channel_context_set(chan, outgoing->context);
-		}
-
-		if (!ast_strlen_zero(outgoing->exten)) {
-			ast_channel_exten_set(chan, outgoing->exten);
-		}
-
-		if (outgoing->priority > 0) {
-			ast_channel_priority_set(chan, outgoing->priority);
-		}
+		pbx_outgoing_set_location(outgoing, chan);
 
 		if (ast_pbx_run(chan)) {
 			ast_log(LOG_ERROR, "Failed to start PBX on %s\n", ast_channel_name(chan));
@@ -7891,12 +8708,15 @@ static int pbx_outgoing_attempt(const char *type, struct ast_format_cap *cap,
 	/* This extra reference is dereferenced by pbx_outgoing_exec */
 	ao2_ref(outgoing, +1);
 
-	if (synchronous == AST_OUTGOING_WAIT_COMPLETE) {
+	if (synchronous == AST_OUTGOING_WAIT_COMPLETE || synchronous == AST_OUTGOING_WAIT_INLINE) {
 		/*
 		 * Because we are waiting until this is complete anyway, there is no
 		 * sense in creating another thread that we will just need to wait
-		 * for, so instead we commandeer the current thread.
+		 * for, so instead we commandeer the current thread.  When waiting
+		 * inline only the dialing is done here and an answered leg gets a
+		 * thread of its own.
 		 */
+		outgoing->detach_answered = (synchronous == AST_OUTGOING_WAIT_INLINE);
 		pbx_outgoing_exec(outgoing);
 	} else {
 		outgoing->in_separate_thread = 1;
@@ -8074,6 +8894,7 @@ static void __ast_internal_context_destroy( struct ast_context *con)
 	/* and destroy the pattern tree */
 	if (tmp->pattern_tree)
 		destroy_pattern_tree(tmp->pattern_tree);
+	ast_free(tmp->match_cache);
 
 	for (e = tmp->root; e;) {
 		for (en = e->peer; en;) {
@@ -8450,6 +9271,12 @@ static void unload_pbx(void)
 	presence_state_sub = stasis_unsubscribe_and_join(presence_state_sub);
 	device_state_sub = stasis_unsubscribe_and_join(device_state_sub);
 
+	if (hint_notify_sched) {
+		ast_sched_clean_by_callback(hint_notify_sched, hint_notify_deferred, hint_notify_cleanup);
+		ast_sched_context_destroy(hint_notify_sched);
+		hint_notify_sched = NULL;
+	}
+
 	ast_manager_unregister("ShowDialPlan");
 	ast_manager_unregister("ExtensionStateList");
 	ast_cli_unregister_multiple(pbx_cli, ARRAY_LEN(pbx_cli));
@@ -8479,6 +9306,11 @@ int load_pbx(void)
 		return -1;
 	}
 
+	if (!(hint_notify_sched = ast_sched_context_create())
+		|| ast_sched_start_thread(hint_notify_sched)) {
+		return -1;
+	}
+
 	if (!(device_state_sub = stasis_subscribe(ast_device_state_topic_all(), device_state_cb, NULL))) {
 		return -1;
 	}
@@ -8501,7 +9333,11 @@ int load_pbx(void)
  */
 int ast_wrlock_contexts(void)
 {
-	return ast_mutex_lock(&conlock);
+	int res = ast_mutex_lock(&conlock);
+
+	ast_atomic_fetchadd_int(&contexts_version, +1);
+
+	return res;
 }
 
 int ast_rdlock_contexts(void)
@@ -8519,7 +9355,12 @@ int ast_unlock_contexts(void)
  */
 int ast_wrlock_context(struct ast_context *con)
 {
-	return ast_rwlock_wrlock(&con->lock);
+	int res = ast_rwlock_wrlock(&con->lock);
+
+	/* Extensions can be changed without conlock, see context_merge_scan(). */
+	ast_atomic_fetchadd_int(&contexts_version, +1);
+
+	return res;
 }
 
 int ast_rdlock_context(struct ast_context *con)
@@ -31,6 +31,7 @@
 
 #include "asterisk/_private.h"
 #include "asterisk/cli.h"
+#include "asterisk/histogram.h"
 #include "asterisk/linkedlists.h"
 #include "asterisk/module.h"
 #include "asterisk/pbx.h"
@@ -53,9 +54,11 @@ struct ast_app {
 	);
 #ifdef AST_XML_DOCS
 	enum ast_doc_src docsrc;		/*!< Where the documentation come from. */
+	unsigned int xmldocs_pending:1;		/*!< XML documentation not built yet. */
 #endif
 	AST_RWLIST_ENTRY(ast_app) list;		/*!< Next app in list */
 	struct ast_module *module;		/*!< Module this app belongs to */
+	struct ast_histogram *exec_time;	/*!< How long executions take */
 	char name[0];				/*!< Name of the application */
 };
 
@@ -66,6 +69,11 @@ struct ast_app {
  */
 static AST_RWLIST_HEAD_STATIC(apps, ast_app);
 
+#ifdef AST_XML_DOCS
+/*! \brief Serializes building the XML documentation of applications on demand */
+AST_MUTEX_DEFINE_STATIC(app_xmldocs_lock);
+#endif
+
 static struct ast_app *pbx_findapp_nolock(const char *name)
 {
 	struct ast_app *cur;
@@ -105,9 +113,6 @@ int ast_register_application2(const char *app, int (*execute)(struct ast_channel
 	struct ast_app *tmp;
 	struct ast_app *cur;
 	int length;
-#ifdef AST_XML_DOCS
-	char *tmpxml;
-#endif
 
 	AST_RWLIST_WRLOCK(&apps);
 	cur = pbx_findapp_nolock(app);
@@ -133,34 +138,13 @@ int ast_register_application2(const char *app, int (*execute)(struct ast_channel
 	strcpy(tmp->name, app);
 	tmp->execute = execute;
 	tmp->module = mod;
+	tmp->exec_time = ast_histogram_get("app_execution",
+		"Time spent executing a dialplan application.", "app", tmp->name);
 
 #ifdef AST_XML_DOCS
-	/* Try to lookup the docs in our XML documentation database */
+	/* The docs are looked up in our XML documentation database when first needed */
 	if (ast_strlen_zero(synopsis) && ast_strlen_zero(description)) {
-		/* load synopsis */
-		tmpxml = ast_xmldoc_build_synopsis("application", app, ast_module_name(tmp->module));
-		ast_string_field_set(tmp, synopsis, tmpxml);
-		ast_free(tmpxml);
-
-		/* load description */
-		tmpxml = ast_xmldoc_build_description("application", app, ast_module_name(tmp->module));
-		ast_string_field_set(tmp, description, tmpxml);
-		ast_free(tmpxml);
-
-		/* load syntax */
-		tmpxml = ast_xmldoc_build_syntax("application", app, ast_module_name(tmp->module));
-		ast_string_field_set(tmp, syntax, tmpxml);
-		ast_free(tmpxml);
-
-		/* load arguments */
-		tmpxml = ast_xmldoc_build_arguments("application", app, ast_module_name(tmp->module));
-		ast_string_field_set(tmp, arguments, tmpxml);
-		ast_free(tmpxml);
-
-		/* load seealso */
-		tmpxml = ast_xmldoc_build_seealso("application", app, ast_module_name(tmp->module));
-		ast_string_field_set(tmp, seealso, tmpxml);
-		ast_free(tmpxml);
+		tmp->xmldocs_pending = 1;
 		tmp->docsrc = AST_XML_DOC;
 	} else {
 #endif
@@ -189,10 +173,67 @@ int ast_register_application2(const char *app, int (*execute)(struct ast_channel
 	return 0;
 }
 
+#ifdef AST_XML_DOCS
+/*!
+ * \internal
+ * \brief Build the XML documentation of an application if not done yet.
+ *
+ * \param aa Application to build the documentation of.
+ *
+ * \note The apps list must be locked.  Building the documentation
+ * is deferred from registration since most applications never have
+ * their documentation shown.
+ *
+ * \return Nothing
+ */
+static void app_load_xmldocs(struct ast_app *aa)
+{
+	char *tmpxml;
+	const char *module;
+
+	ast_mutex_lock(&app_xmldocs_lock);
+	if (!aa->xmldocs_pending) {
+		ast_mutex_unlock(&app_xmldocs_lock);
+		return;
+	}
+	module = ast_module_name(aa->module);
+
+	/* load synopsis */
+	tmpxml = ast_xmldoc_build_synopsis("application", aa->name, module);
+	ast_string_field_set(aa, synopsis, tmpxml);
+	ast_free(tmpxml);
+
+	/* load description */
+	tmpxml = ast_xmldoc_build_description("application", aa->name, module);
+	ast_string_field_set(aa, description, tmpxml);
+	ast_free(tmpxml);
+
+	/* load syntax */
+	tmpxml = ast_xmldoc_build_syntax("application", aa->name, module);
+	ast_string_field_set(aa, syntax, tmpxml);
+	ast_free(tmpxml);
+
+	/* load arguments */
+	tmpxml = ast_xmldoc_build_arguments("application", aa->name, module);
+	ast_string_field_set(aa, arguments, tmpxml);
+	ast_free(tmpxml);
+
+	/* load seealso */
+	tmpxml = ast_xmldoc_build_seealso("application", aa->name, module);
+	ast_string_field_set(aa, seealso, tmpxml);
+	ast_free(tmpxml);
+
+	aa->xmldocs_pending = 0;
+	ast_mutex_unlock(&app_xmldocs_lock);
+}
+#endif
+
 static void print_app_docs(struct ast_app *aa, int fd)
 {
 #ifdef AST_XML_DOCS
 	char *synopsis = NULL, *description = NULL, *arguments = NULL, *seealso = NULL;
+
+	app_load_xmldocs(aa);
 	if (aa->docsrc == AST_XML_DOC) {
 		synopsis = ast_xmldoc_printable(S_OR(aa->synopsis, "Not available"), 1);
 		description = ast_xmldoc_printable(S_OR(aa->description, "Not available"), 1);
@@ -352,6 +393,9 @@ static char *handle_show_applications(struct ast_cli_entry *e, int cmd, struct a
 	AST_RWLIST_TRAVERSE(&apps, aa, list) {
 		int printapp = 0;
 		total_apps++;
+#ifdef AST_XML_DOCS
+		app_load_xmldocs(aa);
+#endif
 		if (like) {
 			if (strcasestr(aa->name, a->argv[4])) {
 				printapp = 1;
@@ -410,6 +454,7 @@ int ast_unregister_application(const char *app)
 			unreference_cached_app(cur);
 			AST_RWLIST_REMOVE_CURRENT(list);
 			ast_verb(2, "Unregistered application '%s'\n", cur->name);
+			ao2_cleanup(cur->exec_time);
 			ast_string_field_free_memory(cur);
 			ast_free(cur);
 			break;
@@ -476,6 +521,7 @@ int pbx_exec(struct ast_channel *c,	/*!< Channel */
 	struct ast_module_user *u = NULL;
 	const char *saved_c_appl;
 	const char *saved_c_data;
+	struct timeval start;
 
 	/* save channel values */
 	saved_c_appl= ast_channel_appl(c);
@@ -489,7 +535,9 @@ int pbx_exec(struct ast_channel *c,	/*!< Channel */
 
 	if (app->module)
 		u = __ast_module_user_add(app->module, c);
+	start = ast_tvnow();
 	res = app->execute(c, S_OR(data, ""));
+	ast_histogram_record_since(app->exec_time, start);
 	if (app->module && u)
 		__ast_module_user_remove(app->module, u);
 	/* restore channel values */
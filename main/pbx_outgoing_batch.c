@@ -0,0 +1,481 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief PBX outgoing call batches
+ *
+ * Each call of a batch is dialed by a task on a threadpool shared by all
+ * batches.  The task waits for the call to be answered or to fail, reports
+ * the outcome and starts the next call of the batch if the limits allow it.
+ * Answered calls continue in a thread of their own, so the pool only ever
+ * holds calls that are dialing.
+ *
+ * Paced batches get a token from a scheduler shared by all batches every
+ * 1000 / cps milliseconds, and spend it on starting a call.  The token is
+ * kept while the batch is at its concurrency limit, so a batch never starts
+ * calls in a burst to catch up.
+ */
+
+/*** MODULEINFO
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/astobj2.h"
+#include "asterisk/channel.h"
+#include "asterisk/format_cap.h"
+#include "asterisk/lock.h"
+#include "asterisk/pbx.h"
+#include "asterisk/sched.h"
+#include "asterisk/stringfields.h"
+#include "asterisk/threadpool.h"
+#include "asterisk/utils.h"
+#include "asterisk/vector.h"
+
+/*! \brief Number of seconds an idle batch thread lingers */
+#define BATCH_POOL_IDLE 60
+
+/*! \brief Highest rate a batch can be paced at, one call per scheduler millisecond */
+#define BATCH_MAX_CPS 1000
+
+/*! \brief Threads placing the calls of all batches, created on first use */
+static struct ast_threadpool *batch_pool;
+
+/*! \brief Scheduler pacing all batches, created on first use */
+static struct ast_sched_context *batch_sched;
+
+/*! \brief Lock protecting the creation and destruction of batch_pool and batch_sched */
+AST_MUTEX_DEFINE_STATIC(batch_lock);
+
+/*! \brief A call of a batch */
+struct batch_target {
+	/*! Position of the target in the batch */
+	int index;
+	/*! Channel technology (Stored in stuff[]) */
+	const char *type;
+	/*! Address for the channel technology (Stored in stuff[]) */
+	const char *addr;
+	/*! Uniqueid to assign the channel, NULL if none (Stored in stuff[]) */
+	const char *channelid;
+	char stuff[0];
+};
+
+struct ast_pbx_outgoing_batch {
+	AST_DECLARE_STRING_FIELDS(
+		AST_STRING_FIELD(context);
+		AST_STRING_FIELD(exten);
+		AST_STRING_FIELD(app);
+		AST_STRING_FIELD(appdata);
+		AST_STRING_FIELD(cid_num);
+		AST_STRING_FIELD(cid_name);
+		AST_STRING_FIELD(account);
+	);
+	int priority;
+	int timeout;
+	int early_media;
+	struct ast_variable *vars;
+	struct ast_format_cap *cap;
+	/*! Milliseconds between two call starts, 0 if not paced */
+	int pacing;
+	unsigned int max_concurrent;
+	ast_pbx_outgoing_batch_result_cb result_cb;
+	ast_pbx_outgoing_batch_complete_cb complete_cb;
+	void *data;
+	/*! Calls of the batch, in the order they are started */
+	AST_VECTOR(, struct batch_target *) targets;
+	/*! Position of the next call to start */
+	size_t next;
+	/*! Number of calls dialing */
+	unsigned int active;
+	/*! Set when pacing allows starting a call */
+	unsigned int token:1;
+	unsigned int started:1;
+	unsigned int cancelled:1;
+	unsigned int completed:1;
+};
+
+/*! \brief A call of a batch handed to the pool */
+struct batch_call {
+	struct ast_pbx_outgoing_batch *batch;
+	struct batch_target *target;
+};
+
+static void batch_shutdown(void)
+{
+	ast_mutex_lock(&batch_lock);
+	ast_sched_context_destroy(batch_sched);
+	batch_sched = NULL;
+	ast_threadpool_shutdown(batch_pool);
+	batch_pool = NULL;
+	ast_mutex_unlock(&batch_lock);
+}
+
+/*!
+ * \internal
+ * \brief Create the pool, and the scheduler if it is wanted, if needed
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int batch_services_init(int paced)
+{
+	static int cleanup_registered;
+	int res = 0;
+
+	ast_mutex_lock(&batch_lock);
+	if (!cleanup_registered) {
+		ast_register_cleanup(batch_shutdown);
+		cleanup_registered = 1;
+	}
+
+	if (!batch_pool) {
+		struct ast_threadpool_options options = {
+			.version = AST_THREADPOOL_OPTIONS_VERSION,
+			.idle_timeout = BATCH_POOL_IDLE,
+			.auto_increment = 1,
+			.initial_size = 0,
+			.max_size = 0,
+		};
+
+		batch_pool = ast_threadpool_create("pbx_outgoing_batch", NULL, &options);
+		if (!batch_pool) {
+			res = -1;
+		}
+	}
+
+	if (!res && paced && !batch_sched) {
+		batch_sched = ast_sched_context_create();
+		if (!batch_sched) {
+			res = -1;
+		} else if (ast_sched_start_thread(batch_sched)) {
+			ast_sched_context_destroy(batch_sched);
+			batch_sched = NULL;
+			res = -1;
+		}
+	}
+	ast_mutex_unlock(&batch_lock);
+
+	return res;
+}
+
+static void batch_destroy(void *obj)
+{
+	struct ast_pbx_outgoing_batch *batch = obj;
+
+	AST_VECTOR_CALLBACK_VOID(&batch->targets, ast_free);
+	AST_VECTOR_FREE(&batch->targets);
+	ast_variables_destroy(batch->vars);
+	ao2_cleanup(batch->cap);
+	ast_string_field_free_memory(batch);
+}
+
+struct ast_pbx_outgoing_batch *ast_pbx_outgoing_batch_create(const struct ast_pbx_outgoing_batch_options *options)
+{
+	struct ast_pbx_outgoing_batch *batch;
+
+	if (ast_strlen_zero(options->app)
+		&& (ast_strlen_zero(options->context) || ast_strlen_zero(options->exten)
+			|| options->priority < 1)) {
+		return NULL;
+	}
+
+	batch = ao2_alloc(sizeof(*batch), batch_destroy);
+	if (!batch) {
+		return NULL;
+	}
+
+	if (ast_string_field_init(batch, 256) || AST_VECTOR_INIT(&batch->targets, 16)) {
+		ao2_ref(batch, -1);
+		return NULL;
+	}
+
+	if (!ast_strlen_zero(options->app)) {
+		ast_string_field_set(batch, app, options->app);
+		ast_string_field_set(batch, appdata, options->appdata);
+	} else {
+		ast_string_field_set(batch, context, options->context);
+		ast_string_field_set(batch, exten, options->exten);
+		batch->priority = options->priority;
+		batch->early_media = options->early_media;
+	}
+	ast_string_field_set(batch, cid_num, options->cid_num);
+	ast_string_field_set(batch, cid_name, options->cid_name);
+	ast_string_field_set(batch, account, options->account);
+	batch->timeout = options->timeout;
+	batch->cap = ao2_bump(options->cap);
+	if (options->vars && !(batch->vars = ast_variables_dup(options->vars))) {
+		ao2_ref(batch, -1);
+		return NULL;
+	}
+
+	if (options->cps) {
+		batch->pacing = 1000 / MIN(options->cps, BATCH_MAX_CPS);
+	}
+	batch->max_concurrent = options->max_concurrent;
+	batch->result_cb = options->result_cb;
+	batch->complete_cb = options->complete_cb;
+	batch->data = options->data;
+
+	return batch;
+}
+
+int ast_pbx_outgoing_batch_add(struct ast_pbx_outgoing_batch *batch, const char *type,
+	const char *addr, const char *channelid)
+{
+	struct batch_target *target;
+	size_t type_len;
+	size_t addr_len;
+	size_t channelid_len;
+	char *cur;
+	int res = -1;
+
+	if (ast_strlen_zero(type) || ast_strlen_zero(addr)) {
+		return -1;
+	}
+
+	type_len = strlen(type) + 1;
+	addr_len = strlen(addr) + 1;
+	channelid_len = ast_strlen_zero(channelid) ? 0 : strlen(channelid) + 1;
+
+	target = ast_calloc(1, sizeof(*target) + type_len + addr_len + channelid_len);
+	if (!target) {
+		return -1;
+	}
+
+	cur = target->stuff;
+	target->type = strcpy(cur, type);
+	cur += type_len;
+	target->addr = strcpy(cur, addr);
+	cur += addr_len;
+	if (channelid_len) {
+		target->channelid = strcpy(cur, channelid);
+	}
+
+	ao2_lock(batch);
+	if (!batch->started) {
+		target->index = AST_VECTOR_SIZE(&batch->targets);
+		res = AST_VECTOR_APPEND(&batch->targets, target);
+	}
+	ao2_unlock(batch);
+
+	if (res) {
+		ast_free(target);
+	}
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Check whether the last call of a batch is done, marking it completed
+ *
+ * \note The batch must be locked.
+ *
+ * \retval 1 if the complete callback must now be called
+ * \retval 0 otherwise
+ */
+static int batch_check_complete(struct ast_pbx_outgoing_batch *batch)
+{
+	if (!batch->started || batch->completed || batch->active
+		|| (!batch->cancelled && batch->next < AST_VECTOR_SIZE(&batch->targets))) {
+		return 0;
+	}
+
+	batch->completed = 1;
+	return 1;
+}
+
+static void batch_complete(struct ast_pbx_outgoing_batch *batch)
+{
+	if (batch->complete_cb) {
+		batch->complete_cb(batch->data);
+	}
+}
+
+static void batch_fill(struct ast_pbx_outgoing_batch *batch);
+
+static int batch_call_task(void *data)
+{
+	struct batch_call *call = data;
+	struct ast_pbx_outgoing_batch *batch = call->batch;
+	struct batch_target *target = call->target;
+	struct ast_assigned_ids assignedids = {
+		.uniqueid = target->channelid,
+	};
+	struct ast_pbx_outgoing_batch_result result = {
+		.index = target->index,
+		.type = target->type,
+		.addr = target->addr,
+		.uniqueid = target->channelid,
+	};
+	struct ast_channel *chan = NULL;
+	int complete;
+
+	if (!ast_strlen_zero(batch->app)) {
+		result.res = ast_pbx_outgoing_app(target->type, batch->cap, target->addr,
+			batch->timeout, batch->app, batch->appdata, &result.reason,
+			AST_OUTGOING_WAIT_INLINE, S_OR(batch->cid_num, NULL), S_OR(batch->cid_name, NULL),
+			batch->vars, batch->account, &chan,
+			target->channelid ? &assignedids : NULL);
+	} else {
+		result.res = ast_pbx_outgoing_exten(target->type, batch->cap, target->addr,
+			batch->timeout, batch->context, batch->exten, batch->priority, &result.reason,
+			AST_OUTGOING_WAIT_INLINE, S_OR(batch->cid_num, NULL), S_OR(batch->cid_name, NULL),
+			batch->vars, batch->account, &chan, batch->early_media,
+			target->channelid ? &assignedids : NULL);
+	}
+
+	if (chan) {
+		result.channel = ast_strdupa(ast_channel_name(chan));
+		result.uniqueid = ast_strdupa(ast_channel_uniqueid(chan));
+		ast_channel_unlock(chan);
+		ast_channel_unref(chan);
+	}
+
+	if (batch->result_cb) {
+		batch->result_cb(&result, batch->data);
+	}
+
+	ao2_lock(batch);
+	batch->active--;
+	batch_fill(batch);
+	complete = batch_check_complete(batch);
+	ao2_unlock(batch);
+
+	if (complete) {
+		batch_complete(batch);
+	}
+
+	ao2_ref(batch, -1);
+	ast_free(call);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Start as many calls of a batch as its limits allow
+ *
+ * \note The batch must be locked.
+ */
+static void batch_fill(struct ast_pbx_outgoing_batch *batch)
+{
+	while (!batch->cancelled && batch->next < AST_VECTOR_SIZE(&batch->targets)
+		&& (!batch->max_concurrent || batch->active < batch->max_concurrent)
+		&& (!batch->pacing || batch->token)) {
+		struct batch_call *call;
+
+		call = ast_malloc(sizeof(*call));
+		if (!call) {
+			batch->cancelled = 1;
+			break;
+		}
+		call->batch = ao2_bump(batch);
+		call->target = AST_VECTOR_GET(&batch->targets, batch->next);
+
+		if (ast_threadpool_push(batch_pool, batch_call_task, call)) {
+			ast_log(LOG_WARNING, "Unable to start outgoing call to '%s/%s', dropping the rest of its batch\n",
+				call->target->type, call->target->addr);
+			ao2_ref(batch, -1);
+			ast_free(call);
+			batch->cancelled = 1;
+			break;
+		}
+
+		batch->next++;
+		batch->active++;
+		batch->token = 0;
+	}
+}
+
+static int batch_pacing_cb(const void *data)
+{
+	struct ast_pbx_outgoing_batch *batch = (struct ast_pbx_outgoing_batch *) data;
+	int pending;
+	int complete;
+
+	ao2_lock(batch);
+	batch->token = 1;
+	batch_fill(batch);
+	pending = !batch->cancelled && batch->next < AST_VECTOR_SIZE(&batch->targets);
+	complete = batch_check_complete(batch);
+	ao2_unlock(batch);
+
+	if (complete) {
+		batch_complete(batch);
+	}
+
+	if (!pending) {
+		/* Drop the reference held by the scheduler */
+		ao2_ref(batch, -1);
+		return 0;
+	}
+
+	return batch->pacing;
+}
+
+int ast_pbx_outgoing_batch_start(struct ast_pbx_outgoing_batch *batch)
+{
+	int complete;
+
+	if (batch_services_init(batch->pacing)) {
+		return -1;
+	}
+
+	ao2_lock(batch);
+	if (batch->started) {
+		ao2_unlock(batch);
+		return -1;
+	}
+
+	if (batch->pacing && AST_VECTOR_SIZE(&batch->targets)) {
+		/* The scheduler holds a reference until the last call is started */
+		ao2_ref(batch, +1);
+		if (ast_sched_add(batch_sched, batch->pacing, batch_pacing_cb, batch) < 0) {
+			ao2_ref(batch, -1);
+			ao2_unlock(batch);
+			return -1;
+		}
+		batch->token = 1;
+	}
+
+	batch->started = 1;
+	batch_fill(batch);
+	complete = batch_check_complete(batch);
+	ao2_unlock(batch);
+
+	if (complete) {
+		batch_complete(batch);
+	}
+
+	return 0;
+}
+
+void ast_pbx_outgoing_batch_cancel(struct ast_pbx_outgoing_batch *batch)
+{
+	int complete;
+
+	ao2_lock(batch);
+	batch->cancelled = 1;
+	complete = batch_check_complete(batch);
+	ao2_unlock(batch);
+
+	if (complete) {
+		batch_complete(batch);
+	}
+}
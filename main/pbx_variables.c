@@ -32,6 +32,7 @@
 #include "asterisk/_private.h"
 #include "asterisk/app.h"
 #include "asterisk/ast_expr.h"
+#include "asterisk/astobj2.h"
 #include "asterisk/chanvars.h"
 #include "asterisk/cli.h"
 #include "asterisk/linkedlists.h"
@@ -40,6 +41,7 @@
 #include "asterisk/paths.h"
 #include "asterisk/pbx.h"
 #include "asterisk/stasis_channels.h"
+#include "asterisk/vector.h"
 #include "pbx_private.h"
 
 /*** DOCUMENTATION
@@ -361,11 +363,8 @@ const char *ast_str_retrieve_variable(struct ast_str **str, ssize_t maxlen, stru
 			continue;
 		if (places[i] == &globals)
 			ast_rwlock_rdlock(&globalslock);
-		AST_LIST_TRAVERSE(places[i], variables, entries) {
-			if (!strcmp(ast_var_name(variables), var)) {
-				s = ast_var_value(variables);
-				break;
-			}
+		if ((variables = ast_var_list_search(places[i], var))) {
+			s = ast_var_value(variables);
 		}
 		if (places[i] == &globals)
 			ast_rwlock_unlock(&globalslock);
@@ -391,6 +390,83 @@ const char *ast_str_retrieve_variable(struct ast_str **str, ssize_t maxlen, stru
 	return ret;
 }
 
+/*!
+ * \internal
+ * \brief Names ast_str_retrieve_variable() resolves without looking at any variable list.
+ *
+ * \note Must be kept in sync with ast_str_retrieve_variable().
+ */
+static const char * const builtin_variables[] = {
+	"CALLINGPRES", "CALLINGANI2", "CALLINGTON", "CALLINGTNS",
+	"HINT", "HINTNAME", "EXTEN", "CONTEXT", "PRIORITY", "CHANNEL",
+	"UNIQUEID", "HANGUPCAUSE", "EPOCH", "SYSTEMNAME", "ASTCACHEDIR",
+	"ASTETCDIR", "ASTMODDIR", "ASTVARLIBDIR", "ASTDBDIR", "ASTKEYDIR",
+	"ASTDATADIR", "ASTAGIDIR", "ASTSPOOLDIR", "ASTRUNDIR", "ASTLOGDIR",
+	"ENTITYID",
+};
+
+static int is_builtin_variable(const char *var)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(builtin_variables); i++) {
+		if (!strcmp(var, builtin_variables[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Look up a variable that is not a builtin in the variable lists.
+ *
+ * \details
+ * Same result as pbx_retrieve_variable() for a name that is_builtin_variable()
+ * rejected, without the temporary string buffer and builtin name checks.
+ *
+ * \return workspace with the value or NULL if the variable is not set.
+ */
+static char *retrieve_list_variable(struct ast_channel *c, struct varshead *headp,
+	const char *var, char *workspace, int workspacelen)
+{
+	struct varshead *places[2] = { headp, &globals };
+	char *ret = NULL;
+	int found = 0;
+	int i;
+
+	if (c) {
+		ast_channel_lock(c);
+		places[0] = ast_channel_varshead(c);
+	}
+	for (i = 0; !found && i < ARRAY_LEN(places); i++) {
+		struct ast_var_t *variables;
+
+		if (!places[i]) {
+			continue;
+		}
+		if (places[i] == &globals) {
+			ast_rwlock_rdlock(&globalslock);
+		}
+		if ((variables = ast_var_list_search(places[i], var))) {
+			const char *value = ast_var_value(variables);
+
+			if (value) {
+				ast_copy_string(workspace, value, workspacelen);
+				ret = workspace;
+			}
+			found = 1;
+		}
+		if (places[i] == &globals) {
+			ast_rwlock_unlock(&globalslock);
+		}
+	}
+	if (c) {
+		ast_channel_unlock(c);
+	}
+	return ret;
+}
+
 void ast_str_substitute_variables_full(struct ast_str **buf, ssize_t maxlen, struct ast_channel *c, struct varshead *headp, const char *templ, size_t *used)
 {
 	/* Substitutes variables into buf, based on string templ */
@@ -832,6 +908,307 @@ void pbx_substitute_variables_helper_full(struct ast_channel *c, struct varshead
 	}
 }
 
+/*! \brief The substitution that ends a template segment */
+enum subst_segment_type {
+	/*! Nothing, the segment is only literal text */
+	SUBST_SEGMENT_LITERAL,
+	/*! A ${...} variable or function */
+	SUBST_SEGMENT_VARIABLE,
+	/*! A $[...] expression */
+	SUBST_SEGMENT_EXPRESSION,
+};
+
+/*!
+ * \brief A parsed piece of a substitution template
+ *
+ * \details
+ * Each segment stands for one pass of the loop in
+ * pbx_substitute_variables_helper_full(): the literal text in front of
+ * the next '$' and the substitution that follows it, if any.  Keeping
+ * the same boundaries keeps output truncation, and with it which
+ * functions get evaluated, exactly the same.
+ */
+struct subst_segment {
+	/*! Text copied to the output in front of the substitution */
+	char *literal;
+	/*! Length of literal */
+	size_t literal_len;
+	/*! What follows the literal text */
+	enum subst_segment_type type;
+	/*! The closing bracket is missing */
+	unsigned int unterminated:1;
+	/*! Variable name or expression, NULL if it needs substituting first */
+	char *text;
+	/*! Length of text */
+	size_t text_len;
+	/*! Template to produce the variable name or expression */
+	struct pbx_substitute_template *inner;
+	/*! Parsed offset of a variable with a constant name */
+	int offset;
+	/*! Parsed length of a variable with a constant name */
+	int length;
+	/*! A variable with a constant name is a function call */
+	int isfunction;
+	/*! A variable with a constant name can only be found in the variable lists */
+	unsigned int list_only:1;
+};
+
+struct pbx_substitute_template {
+	AST_VECTOR(, struct subst_segment) segments;
+};
+
+static void subst_segment_free(struct subst_segment segment)
+{
+	ast_free(segment.literal);
+	ast_free(segment.text);
+	ao2_cleanup(segment.inner);
+}
+
+static void substitute_template_destroy(void *obj)
+{
+	struct pbx_substitute_template *templ = obj;
+
+	AST_VECTOR_CALLBACK_VOID(&templ->segments, subst_segment_free);
+	AST_VECTOR_FREE(&templ->segments);
+}
+
+struct pbx_substitute_template *pbx_substitute_template_compile(const char *cp1)
+{
+	struct pbx_substitute_template *templ;
+	const char *whereweare = cp1;
+
+	templ = ao2_alloc_options(sizeof(*templ), substitute_template_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!templ || AST_VECTOR_INIT(&templ->segments, 4)) {
+		ao2_cleanup(templ);
+		return NULL;
+	}
+
+	while (!ast_strlen_zero(whereweare)) {
+		struct subst_segment segment = { .type = SUBST_SEGMENT_LITERAL, };
+		const char *nextthing;
+		const char *vars;
+		const char *vare;
+		char open;
+		char close;
+		int brackets;
+		int needsub;
+		size_t pos;
+		size_t len;
+
+		/* Same scan as pbx_substitute_variables_helper_full() */
+		nextthing = strchr(whereweare, '$');
+		if (nextthing) {
+			pos = nextthing - whereweare;
+			switch (nextthing[1]) {
+			case '{':
+				segment.type = SUBST_SEGMENT_VARIABLE;
+				break;
+			case '[':
+				segment.type = SUBST_SEGMENT_EXPRESSION;
+				break;
+			default:
+				/* '$' is not part of a substitution so include it too. */
+				++pos;
+				break;
+			}
+		} else {
+			pos = strlen(whereweare);
+		}
+
+		if (pos) {
+			segment.literal = ast_strndup(whereweare, pos);
+			if (!segment.literal) {
+				ao2_ref(templ, -1);
+				return NULL;
+			}
+			segment.literal_len = pos;
+			whereweare += pos;
+		}
+
+		if (segment.type != SUBST_SEGMENT_LITERAL) {
+			open = segment.type == SUBST_SEGMENT_VARIABLE ? '{' : '[';
+			close = segment.type == SUBST_SEGMENT_VARIABLE ? '}' : ']';
+			vars = vare = whereweare + 2;
+			brackets = 1;
+			needsub = 0;
+
+			/* Find the end of it */
+			while (brackets && *vare) {
+				if ((vare[0] == '$') && (vare[1] == open)) {
+					needsub++;
+					brackets++;
+					vare++;
+				} else if (vare[0] == open) {
+					brackets++;
+				} else if (vare[0] == close) {
+					brackets--;
+				} else if ((vare[0] == '$') && (vare[1] == (open == '{' ? '[' : '{'))) {
+					needsub++;
+					vare++;
+				}
+				vare++;
+			}
+			len = vare - vars;
+			if (brackets) {
+				segment.unterminated = 1;
+			} else {
+				/* Don't count the closing bracket in the length. */
+				--len;
+			}
+			whereweare = vare;
+
+			/* Truncate the same way the var buffer does. */
+			len = MIN(len, VAR_BUF_SIZE - 1);
+			segment.text = ast_strndup(vars, len);
+			if (!segment.text) {
+				subst_segment_free(segment);
+				ao2_ref(templ, -1);
+				return NULL;
+			}
+			if (needsub) {
+				segment.inner = pbx_substitute_template_compile(segment.text);
+				ast_free(segment.text);
+				segment.text = NULL;
+				if (!segment.inner) {
+					subst_segment_free(segment);
+					ao2_ref(templ, -1);
+					return NULL;
+				}
+			} else if (segment.type == SUBST_SEGMENT_VARIABLE) {
+				parse_variable_name(segment.text, &segment.offset, &segment.length,
+					&segment.isfunction);
+				segment.text_len = strlen(segment.text);
+				segment.list_only = !segment.isfunction && !is_builtin_variable(segment.text);
+			} else {
+				segment.text_len = len;
+			}
+		}
+
+		if (AST_VECTOR_APPEND(&templ->segments, segment)) {
+			subst_segment_free(segment);
+			ao2_ref(templ, -1);
+			return NULL;
+		}
+	}
+
+	return templ;
+}
+
+void pbx_substitute_template_helper_full(struct ast_channel *c, struct varshead *headp,
+	const struct pbx_substitute_template *templ, char *cp2, int count, size_t *used)
+{
+	const char *orig_cp2 = cp2;
+	char ltmp[VAR_BUF_SIZE];
+	char var[VAR_BUF_SIZE];
+	size_t idx;
+
+	*cp2 = 0; /* just in case nothing ends up there */
+	for (idx = 0; idx < AST_VECTOR_SIZE(&templ->segments) && count; ++idx) {
+		const struct subst_segment *segment = AST_VECTOR_GET_ADDR(&templ->segments, idx);
+		char *vars;
+		int length;
+
+		if (segment->literal_len) {
+			length = MIN(segment->literal_len, count);
+			memcpy(cp2, segment->literal, length);
+			count -= length;
+			cp2 += length;
+			*cp2 = 0;
+		}
+
+		if (segment->type == SUBST_SEGMENT_VARIABLE) {
+			int offset;
+			int offset2;
+			int isfunction;
+			char *cp4;
+			char workspace[VAR_BUF_SIZE];
+
+			/* Only a terminated string is needed, not a cleared buffer */
+			workspace[0] = '\0';
+
+			if (segment->unterminated) {
+				ast_log(LOG_WARNING, "Error in extension logic (missing '}')\n");
+			}
+
+			if (segment->inner) {
+				pbx_substitute_template_helper_full(c, headp, segment->inner, ltmp, VAR_BUF_SIZE - 1, NULL);
+				vars = ltmp;
+				parse_variable_name(vars, &offset, &offset2, &isfunction);
+			} else {
+				/* Neither lookup below modifies the name */
+				vars = segment->text;
+				offset = segment->offset;
+				offset2 = segment->length;
+				isfunction = segment->isfunction;
+			}
+
+			if (isfunction) {
+				/* Evaluate function */
+				if (c || !headp)
+					cp4 = ast_func_read(c, vars, workspace, VAR_BUF_SIZE) ? NULL : workspace;
+				else {
+					struct varshead old;
+					struct ast_channel *bogus;
+
+					bogus = ast_dummy_channel_alloc();
+					if (bogus) {
+						old = *ast_channel_varshead(bogus);
+						*ast_channel_varshead(bogus) = *headp;
+						cp4 = ast_func_read(bogus, vars, workspace, VAR_BUF_SIZE) ? NULL : workspace;
+						/* Don't deallocate the varshead that was passed in */
+						*ast_channel_varshead(bogus) = old;
+						ast_channel_unref(bogus);
+					} else {
+						ast_log(LOG_ERROR, "Unable to allocate bogus channel for function value substitution.\n");
+						cp4 = NULL;
+					}
+				}
+				ast_debug(2, "Function %s result is '%s'\n", vars, cp4 ? cp4 : "(null)");
+			} else if (!segment->inner && segment->list_only) {
+				cp4 = retrieve_list_variable(c, headp, vars, workspace, VAR_BUF_SIZE);
+			} else {
+				/* Retrieve variable value */
+				pbx_retrieve_variable(c, vars, &cp4, workspace, VAR_BUF_SIZE, headp);
+			}
+			if (cp4) {
+				cp4 = substring(cp4, offset, offset2, workspace, VAR_BUF_SIZE);
+
+				length = strlen(cp4);
+				if (length > count)
+					length = count;
+				memcpy(cp2, cp4, length);
+				count -= length;
+				cp2 += length;
+				*cp2 = 0;
+			}
+		} else if (segment->type == SUBST_SEGMENT_EXPRESSION) {
+			if (segment->unterminated) {
+				ast_log(LOG_WARNING, "Error in extension logic (missing ']')\n");
+			}
+
+			if (segment->inner) {
+				pbx_substitute_template_helper_full(c, headp, segment->inner, ltmp, VAR_BUF_SIZE - 1, NULL);
+				vars = ltmp;
+			} else {
+				memcpy(var, segment->text, segment->text_len + 1);
+				vars = var;
+			}
+
+			length = ast_expr(vars, cp2, count, c);
+			if (length) {
+				ast_debug(1, "Expression result is '%s'\n", cp2);
+				count -= length;
+				cp2 += length;
+				*cp2 = 0;
+			}
+		}
+	}
+	if (used) {
+		*used = cp2 - orig_cp2;
+	}
+}
+
 void pbx_substitute_variables_helper(struct ast_channel *c, const char *cp1, char *cp2, int count)
 {
 	pbx_substitute_variables_helper_full(c, (c) ? ast_channel_varshead(c) : NULL, cp1, cp2, count, NULL);
@@ -1017,11 +1394,8 @@ const char *pbx_builtin_getvar_helper(struct ast_channel *chan, const char *name
 			continue;
 		if (places[i] == &globals)
 			ast_rwlock_rdlock(&globalslock);
-		AST_LIST_TRAVERSE(places[i], variables, entries) {
-			if (!strcmp(name, ast_var_name(variables))) {
-				ret = ast_var_value(variables);
-				break;
-			}
+		if ((variables = ast_var_list_search(places[i], name))) {
+			ret = ast_var_value(variables);
 		}
 		if (places[i] == &globals)
 			ast_rwlock_unlock(&globalslock);
@@ -1059,7 +1433,7 @@ void pbx_builtin_pushvar_helper(struct ast_channel *chan, const char *name, cons
 	if (value && (newvariable = ast_var_assign(name, value))) {
 		if (headp == &globals)
 			ast_verb(2, "Setting global variable '%s' to '%s'\n", name, value);
-		AST_LIST_INSERT_HEAD(headp, newvariable, entries);
+		AST_VAR_LIST_INSERT_HEAD(headp, newvariable);
 	}
 
 	if (chan)
@@ -1097,22 +1471,18 @@ int pbx_builtin_setvar_helper(struct ast_channel *chan, const char *name, const
 			nametail++;
 	}
 
-	AST_LIST_TRAVERSE_SAFE_BEGIN(headp, newvariable, entries) {
-		if (strcmp(ast_var_name(newvariable), nametail) == 0) {
-			/* there is already such a variable, delete it */
-			AST_LIST_REMOVE_CURRENT(entries);
-			old_value_existed = !ast_strlen_zero(ast_var_value(newvariable));
-			ast_var_delete(newvariable);
-			break;
-		}
+	if ((newvariable = ast_var_list_search(headp, nametail))) {
+		/* there is already such a variable, delete it */
+		AST_VAR_LIST_REMOVE(headp, newvariable);
+		old_value_existed = !ast_strlen_zero(ast_var_value(newvariable));
+		ast_var_delete(newvariable);
 	}
-	AST_LIST_TRAVERSE_SAFE_END;
 
 	if (value && (newvariable = ast_var_assign(name, value))) {
 		if (headp == &globals) {
 			ast_verb(2, "Setting global variable '%s' to '%s'\n", name, value);
 		}
-		AST_LIST_INSERT_HEAD(headp, newvariable, entries);
+		AST_VAR_LIST_INSERT_HEAD(headp, newvariable);
 		ast_channel_publish_varset(chan, name, value);
 	} else if (old_value_existed) {
 		/* We just deleted a non-empty dialplan variable. */
@@ -1193,7 +1563,7 @@ void pbx_builtin_clear_globals(void)
 	struct ast_var_t *vardata;
 
 	ast_rwlock_wrlock(&globalslock);
-	while ((vardata = AST_LIST_REMOVE_HEAD(&globals, entries)))
+	while ((vardata = AST_VAR_LIST_REMOVE_HEAD(&globals)))
 		ast_var_delete(vardata);
 	ast_rwlock_unlock(&globalslock);
 }
@@ -1211,12 +1581,14 @@ static void unload_pbx_variables(void)
 	ast_unregister_application("Set");
 	ast_unregister_application("MSet");
 	pbx_builtin_clear_globals();
+	ast_var_list_index_disable(&globals);
 }
 
 int load_pbx_variables(void)
 {
 	int res = 0;
 
+	ast_var_list_index_enable(&globals);
 	res |= ast_cli_register_multiple(vars_cli, ARRAY_LEN(vars_cli));
 	res |= ast_register_application2("Set", pbx_builtin_setvar, NULL, NULL, NULL);
 	res |= ast_register_application2("MSet", pbx_builtin_setvar_multiple, NULL, NULL, NULL);
@@ -49,6 +49,7 @@
 
 #include "asterisk/pickup.h"
 #include "asterisk/channel.h"
+#include "asterisk/channel_internal.h"
 #include "asterisk/pbx.h"
 #include "asterisk/app.h"
 #include "asterisk/callerid.h"
@@ -74,6 +75,279 @@ static const struct ast_datastore_info pickup_active = {
 	.type = "pickup-active",
 };
 
+/*! \brief Number of call groups usable in a callgroup mask */
+#define PICKUP_CALLGROUPS (sizeof(ast_group_t) * 8)
+
+/*! \brief A channel in the pickup index */
+struct pickup_entry {
+	/*! The indexed channel */
+	struct ast_channel *chan;
+	/*! Call groups the entry is indexed under */
+	ast_group_t callgroup;
+	/*! Named call groups the entry is indexed under */
+	struct ast_namedgroups *named_callgroups;
+};
+
+/*! \brief The indexed channels of a named call group */
+struct pickup_named_group {
+	/*! Entries of the channels in the group */
+	struct ao2_container *entries;
+	/*! Name of the group */
+	char name[0];
+};
+
+/*!
+ * \brief Channels that may be picked up, keyed by channel
+ *
+ * Only channels in a state allowing pickup and with a call group are
+ * indexed.  Whether a channel can really be picked up is checked when a
+ * pickup finds it.
+ */
+static struct ao2_container *pickup_entries;
+
+/*! \brief Indexed entries of each numbered call group */
+static struct ao2_container *pickup_callgroups[PICKUP_CALLGROUPS];
+
+/*! \brief Indexed entries of each named call group */
+static struct ao2_container *pickup_named_callgroups;
+
+/*! \brief Serializes changes to the pickup index and lookups in its groups */
+AST_MUTEX_DEFINE_STATIC(pickup_index_lock);
+
+static int pickup_entry_hash_fn(const void *obj, const int flags)
+{
+	const struct ast_channel *chan;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		chan = obj;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		chan = ((const struct pickup_entry *) obj)->chan;
+		break;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+
+	return (int) ((uintptr_t) chan >> 4);
+}
+
+static int pickup_entry_cmp_fn(void *obj, void *arg, int flags)
+{
+	const struct pickup_entry *entry = obj;
+	const struct ast_channel *chan;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		chan = arg;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		chan = ((const struct pickup_entry *) arg)->chan;
+		break;
+	default:
+		return 0;
+	}
+
+	return entry->chan == chan ? CMP_MATCH : 0;
+}
+
+AO2_STRING_FIELD_HASH_FN(pickup_named_group, name);
+AO2_STRING_FIELD_CMP_FN(pickup_named_group, name);
+
+static void pickup_entry_destroy(void *obj)
+{
+	struct pickup_entry *entry = obj;
+
+	ast_channel_cleanup(entry->chan);
+	ast_unref_namedgroups(entry->named_callgroups);
+}
+
+static void pickup_named_group_destroy(void *obj)
+{
+	struct pickup_named_group *group = obj;
+
+	ao2_cleanup(group->entries);
+}
+
+/*!
+ * \internal
+ * \brief Call a function for each name of a set of named groups
+ */
+static void pickup_named_groups_foreach(struct ast_namedgroups *groups,
+	void (*cb)(const char *name, void *arg), void *arg)
+{
+	struct ast_str *buf;
+	char *names;
+	char *name;
+
+	if (!groups) {
+		return;
+	}
+
+	buf = ast_str_create(64);
+	if (!buf) {
+		return;
+	}
+
+	names = ast_strdupa(ast_print_namedgroups(&buf, groups));
+	ast_free(buf);
+
+	while ((name = strsep(&names, ","))) {
+		name = ast_strip(name);
+		if (!ast_strlen_zero(name)) {
+			cb(name, arg);
+		}
+	}
+}
+
+static void pickup_named_group_link(const char *name, void *arg)
+{
+	struct pickup_entry *entry = arg;
+	struct pickup_named_group *group;
+
+	group = ao2_find(pickup_named_callgroups, name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!group) {
+		group = ao2_alloc_options(sizeof(*group) + strlen(name) + 1,
+			pickup_named_group_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!group) {
+			return;
+		}
+		strcpy(group->name, name); /* Safe */
+		group->entries = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, NULL, NULL);
+		if (!group->entries) {
+			ao2_ref(group, -1);
+			return;
+		}
+		ao2_link_flags(pickup_named_callgroups, group, OBJ_NOLOCK);
+	}
+
+	ao2_link(group->entries, entry);
+	ao2_ref(group, -1);
+}
+
+static void pickup_named_group_unlink(const char *name, void *arg)
+{
+	struct pickup_entry *entry = arg;
+	struct pickup_named_group *group;
+
+	group = ao2_find(pickup_named_callgroups, name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!group) {
+		return;
+	}
+
+	ao2_unlink(group->entries, entry);
+	if (!ao2_container_count(group->entries)) {
+		ao2_unlink_flags(pickup_named_callgroups, group, OBJ_NOLOCK);
+	}
+	ao2_ref(group, -1);
+}
+
+/*!
+ * \internal
+ * \brief Take an entry out of the pickup index
+ *
+ * \note pickup_index_lock must be held.
+ */
+static void pickup_entry_unindex(struct pickup_entry *entry)
+{
+	int bit;
+
+	for (bit = 0; bit < PICKUP_CALLGROUPS; ++bit) {
+		if (entry->callgroup & ((ast_group_t) 1 << bit)) {
+			ao2_unlink(pickup_callgroups[bit], entry);
+		}
+	}
+	pickup_named_groups_foreach(entry->named_callgroups, pickup_named_group_unlink, entry);
+	ao2_unlink(pickup_entries, entry);
+}
+
+/*!
+ * \internal
+ * \brief Whether a channel belongs in the pickup index
+ */
+static int pickup_indexable(struct ast_channel *chan)
+{
+	switch (ast_channel_state(chan)) {
+	case AST_STATE_DOWN:
+	case AST_STATE_RING:
+	case AST_STATE_RINGING:
+		break;
+	default:
+		return 0;
+	}
+
+	return ast_channel_internal_is_finalized(chan)
+		&& !ast_test_flag(ast_channel_flags(chan), AST_FLAG_ZOMBIE)
+		&& (ast_channel_callgroup(chan) || ast_channel_named_callgroups(chan));
+}
+
+void ast_pickup_index_update(struct ast_channel *chan)
+{
+	struct pickup_entry *entry;
+	int indexable;
+	int bit;
+
+	if (!pickup_entries) {
+		return;
+	}
+
+	indexable = pickup_indexable(chan);
+	entry = ao2_find(pickup_entries, chan, OBJ_SEARCH_KEY);
+	if (!entry && !indexable) {
+		/* Most channels never get near the index */
+		return;
+	}
+	ao2_cleanup(entry);
+
+	ast_mutex_lock(&pickup_index_lock);
+	if (!pickup_entries) {
+		ast_mutex_unlock(&pickup_index_lock);
+		return;
+	}
+	entry = ao2_find(pickup_entries, chan, OBJ_SEARCH_KEY);
+	if (entry && (!indexable
+		|| entry->callgroup != ast_channel_callgroup(chan)
+		|| entry->named_callgroups != ast_channel_named_callgroups(chan))) {
+		pickup_entry_unindex(entry);
+		ao2_ref(entry, -1);
+		entry = NULL;
+	}
+
+	if (!entry && indexable) {
+		entry = ao2_alloc_options(sizeof(*entry), pickup_entry_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (entry) {
+			entry->chan = ast_channel_ref(chan);
+			entry->callgroup = ast_channel_callgroup(chan);
+			entry->named_callgroups = ast_ref_namedgroups(ast_channel_named_callgroups(chan));
+
+			for (bit = 0; bit < PICKUP_CALLGROUPS; ++bit) {
+				if (entry->callgroup & ((ast_group_t) 1 << bit)) {
+					ao2_link(pickup_callgroups[bit], entry);
+				}
+			}
+			pickup_named_groups_foreach(entry->named_callgroups, pickup_named_group_link, entry);
+			ao2_link(pickup_entries, entry);
+		}
+	}
+	ast_mutex_unlock(&pickup_index_lock);
+
+	ao2_cleanup(entry);
+}
+
+void ast_pickup_index_remove(struct ast_channel *chan)
+{
+	struct pickup_entry *entry;
+
+	ast_mutex_lock(&pickup_index_lock);
+	entry = pickup_entries ? ao2_find(pickup_entries, chan, OBJ_SEARCH_KEY) : NULL;
+	if (entry) {
+		pickup_entry_unindex(entry);
+		ao2_ref(entry, -1);
+	}
+	ast_mutex_unlock(&pickup_index_lock);
+}
+
 int ast_can_pickup(struct ast_channel *chan)
 {
 	if (!ast_channel_pbx(chan) && !ast_channel_masq(chan) && !ast_test_flag(ast_channel_flags(chan), AST_FLAG_ZOMBIE)
@@ -92,98 +366,132 @@ int ast_can_pickup(struct ast_channel *chan)
 	return 0;
 }
 
-static int find_channel_by_group(void *obj, void *arg, void *data, int flags)
+/*!
+ * \internal
+ * \brief Check whether the call groups of a target match the pickup groups of a channel
+ *
+ * \note target must be locked.
+ */
+static int pickup_groups_match(struct ast_channel *chan, struct ast_channel *target)
 {
-	struct ast_channel *target = obj; /*!< Potential pickup target */
-	struct ast_channel *chan = arg;   /*!< Channel wanting to pickup call */
+	int match;
 
-	if (chan == target) {
-		return 0;
+	/* Lock both channels. */
+	while (ast_channel_trylock(chan)) {
+		ast_channel_unlock(target);
+		sched_yield();
+		ast_channel_lock(target);
 	}
 
-	ast_channel_lock(target);
-	if (ast_can_pickup(target)) {
-		/* Lock both channels. */
-		while (ast_channel_trylock(chan)) {
-			ast_channel_unlock(target);
-			sched_yield();
-			ast_channel_lock(target);
-		}
+	/*
+	 * Both callgroup and namedcallgroup pickup variants are
+	 * matched independently.  Checking for named group match is
+	 * done last since it's a more expensive operation.
+	 */
+	match = (ast_channel_pickupgroup(chan) & ast_channel_callgroup(target))
+		|| (ast_namedgroups_intersect(ast_channel_named_pickupgroups(chan),
+			ast_channel_named_callgroups(target)));
+	ast_channel_unlock(chan);
+
+	return match;
+}
+
+static int pickup_candidate_sort_fn(const void *obj_left, const void *obj_right, int flags)
+{
+	struct ast_channel *left = (struct ast_channel *) obj_left;
+	struct ast_channel *right = (struct ast_channel *) obj_right;
+
+	return ast_tvcmp(ast_channel_creationtime(left), ast_channel_creationtime(right));
+}
 
-		/*
-		 * Both callgroup and namedcallgroup pickup variants are
-		 * matched independently.  Checking for named group match is
-		 * done last since it's a more expensive operation.
-		 */
-		if ((ast_channel_pickupgroup(chan) & ast_channel_callgroup(target))
-			|| (ast_namedgroups_intersect(ast_channel_named_pickupgroups(chan),
-				ast_channel_named_callgroups(target)))) {
-			struct ao2_container *candidates = data;/*!< Candidate channels found. */
-
-			/* This is a candidate to pickup */
-			ao2_link(candidates, target);
+static int pickup_candidate_link(void *obj, void *arg, int flags)
+{
+	struct pickup_entry *entry = obj;
+	struct ao2_container *candidates = arg;
+
+	ao2_link(candidates, entry->chan);
+
+	return 0;
+}
+
+static void pickup_named_group_candidates(const char *name, void *arg)
+{
+	struct pickup_named_group *group;
+
+	group = ao2_find(pickup_named_callgroups, name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (group) {
+		ao2_callback(group->entries, OBJ_NODATA | OBJ_MULTIPLE, pickup_candidate_link, arg);
+		ao2_ref(group, -1);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Find the indexed channels in the pickup groups of a channel
+ */
+static void pickup_index_candidates(struct ast_channel *chan, struct ao2_container *candidates)
+{
+	ast_group_t pickupgroup;
+	struct ast_namedgroups *named_pickupgroups;
+	int bit;
+
+	ast_channel_lock(chan);
+	pickupgroup = ast_channel_pickupgroup(chan);
+	named_pickupgroups = ast_ref_namedgroups(ast_channel_named_pickupgroups(chan));
+	ast_channel_unlock(chan);
+
+	ast_mutex_lock(&pickup_index_lock);
+	if (!pickup_entries) {
+		/* Shutting down */
+		pickupgroup = 0;
+		named_pickupgroups = ast_unref_namedgroups(named_pickupgroups);
+	}
+	for (bit = 0; bit < PICKUP_CALLGROUPS; ++bit) {
+		if (pickupgroup & ((ast_group_t) 1 << bit)) {
+			ao2_callback(pickup_callgroups[bit], OBJ_NODATA | OBJ_MULTIPLE,
+				pickup_candidate_link, candidates);
 		}
-		ast_channel_unlock(chan);
 	}
-	ast_channel_unlock(target);
+	pickup_named_groups_foreach(named_pickupgroups, pickup_named_group_candidates, candidates);
+	ast_mutex_unlock(&pickup_index_lock);
 
-	return 0;
+	ast_unref_namedgroups(named_pickupgroups);
 }
 
 struct ast_channel *ast_pickup_find_by_group(struct ast_channel *chan)
 {
-	struct ao2_container *candidates;/*!< Candidate channels found to pickup. */
+	struct ao2_container *candidates;/*!< Candidate channels found to pickup, oldest first. */
 	struct ast_channel *target;/*!< Potential pickup target */
+	struct ao2_iterator iter;
 
-	candidates = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, NULL, NULL);
+	candidates = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_NOLOCK,
+		AO2_CONTAINER_ALLOC_OPT_DUPS_OBJ_REJECT, pickup_candidate_sort_fn, NULL);
 	if (!candidates) {
 		return NULL;
 	}
 
 	/* Find all candidate targets by group. */
-	ast_channel_callback(find_channel_by_group, chan, candidates, 0);
+	pickup_index_candidates(chan, candidates);
 
 	/* Find the oldest pickup target candidate */
-	target = NULL;
-	for (;;) {
-		struct ast_channel *candidate;/*!< Potential new older target */
-		struct ao2_iterator iter;
-
-		iter = ao2_iterator_init(candidates, 0);
-		while ((candidate = ao2_iterator_next(&iter))) {
-			if (!target) {
-				/* First target. */
-				target = candidate;
-				continue;
-			}
-			if (ast_tvcmp(ast_channel_creationtime(candidate), ast_channel_creationtime(target)) < 0) {
-				/* We have a new target. */
-				ast_channel_unref(target);
-				target = candidate;
-				continue;
-			}
-			ast_channel_unref(candidate);
-		}
-		ao2_iterator_destroy(&iter);
-		if (!target) {
-			/* No candidates found. */
-			break;
-		}
+	iter = ao2_iterator_init(candidates, 0);
+	while ((target = ao2_iterator_next(&iter))) {
+		if (target != chan) {
+			/* The found channel must be locked and ref'd. */
+			ast_channel_lock(target);
 
-		/* The found channel must be locked and ref'd. */
-		ast_channel_lock(target);
+			/* The index may be behind, so check everything again */
+			if (ast_can_pickup(target) && pickup_groups_match(chan, target)) {
+				/* This is the channel to pickup. */
+				break;
+			}
 
-		/* Recheck pickup ability */
-		if (ast_can_pickup(target)) {
-			/* This is the channel to pickup. */
-			break;
+			/* Someone else picked it up or the call went away. */
+			ast_channel_unlock(target);
 		}
-
-		/* Someone else picked it up or the call went away. */
-		ast_channel_unlock(target);
-		ao2_unlink(candidates, target);
-		target = ast_channel_unref(target);
+		ast_channel_unref(target);
 	}
+	ao2_iterator_destroy(&iter);
 	ao2_ref(candidates, -1);
 
 	return target;
@@ -395,13 +703,48 @@ pickup_failed:
  */
 static void pickup_shutdown(void)
 {
+	int bit;
+
 	STASIS_MESSAGE_TYPE_CLEANUP(ast_call_pickup_type);
+
+	ast_mutex_lock(&pickup_index_lock);
+	ao2_cleanup(pickup_entries);
+	pickup_entries = NULL;
+	ao2_cleanup(pickup_named_callgroups);
+	pickup_named_callgroups = NULL;
+	for (bit = 0; bit < PICKUP_CALLGROUPS; ++bit) {
+		ao2_cleanup(pickup_callgroups[bit]);
+		pickup_callgroups[bit] = NULL;
+	}
+	ast_mutex_unlock(&pickup_index_lock);
 }
 
 int ast_pickup_init(void)
 {
+	int bit;
+
 	STASIS_MESSAGE_TYPE_INIT(ast_call_pickup_type);
 	ast_register_cleanup(pickup_shutdown);
 
+	for (bit = 0; bit < PICKUP_CALLGROUPS; ++bit) {
+		pickup_callgroups[bit] = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, NULL, NULL);
+		if (!pickup_callgroups[bit]) {
+			return -1;
+		}
+	}
+
+	pickup_named_callgroups = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, 31,
+		pickup_named_group_hash_fn, NULL, pickup_named_group_cmp_fn);
+	if (!pickup_named_callgroups) {
+		return -1;
+	}
+
+	/* Allocated last since it switches the index on */
+	pickup_entries = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0, 257,
+		pickup_entry_hash_fn, NULL, pickup_entry_cmp_fn);
+	if (!pickup_entries) {
+		return -1;
+	}
+
 	return 0;
 }
@@ -276,7 +276,9 @@ static struct ast_presence_state_message *presence_state_alloc(const char *provi
 		const char *subtype,
 		const char *message)
 {
-	RAII_VAR(struct ast_presence_state_message *, presence_state, ao2_alloc(sizeof(*presence_state), presence_state_dtor), ao2_cleanup);
+	RAII_VAR(struct ast_presence_state_message *, presence_state,
+		ao2_alloc_options(sizeof(*presence_state), presence_state_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK),
+		ao2_cleanup);
 
 	if (!presence_state || ast_string_field_init(presence_state, 256)) {
 		return NULL;
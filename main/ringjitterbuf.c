@@ -0,0 +1,446 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Ring buffer adaptive jitterbuffering algorithm.
+ *
+ * \details
+ * Frames are kept in a power of two sized ring of slots allocated with
+ * the jitterbuffer, sorted by timestamp.  A frame arriving in order is
+ * stored at the tail in constant time, one arriving out of order moves
+ * the few newer frames up a slot.  Nothing is allocated per frame.
+ *
+ * Like the adaptive jitterbuffer the target delay is the lowest recent
+ * transit delay plus the recent jitter plus target_extra.  The delay
+ * history is kept as the minimum and maximum of each block of frames,
+ * so both are found by looking at a handful of blocks instead of
+ * sorting the history.  The highest block is left out of the jitter so
+ * a single burst does not hold the buffer open for the whole window.
+ *
+ * The buffer grows into gaps: when the next frame is due but missing
+ * and the target is above the current delay, the frame is interpolated
+ * and the delay grows by its length instead of the frame being given
+ * up as lost.  It shrinks by dropping at most one queued frame every
+ * RING_JB_SHRINK_INTERVAL ms while the delay is well above the target.
+ */
+
+/*** MODULEINFO
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include <limits.h>
+
+#include "asterisk/utils.h"
+#include "ringjitterbuf.h"
+
+/*! Shortest frame the slot count is sized for */
+#define RING_JB_MIN_FRAME_MS 10
+#define RING_JB_MIN_SLOTS 8
+#define RING_JB_MAX_SLOTS 1024
+
+/*! Delay history blocks and the frames summarized by each */
+#define RING_JB_HISTORY_BLOCKS 16
+#define RING_JB_BLOCK_FRAMES 32
+
+/*! Least time in ms between two shrinks of the delay */
+#define RING_JB_SHRINK_INTERVAL 500
+
+/*! Interpolated frames in a row before waiting for audio to resume */
+#define RING_JB_MAX_CONTIG_INTERP_DEFAULT 10
+
+/*! Consecutive delay discontinuities that cause a resync */
+#define RING_JB_RESYNC_DISCONT 3
+
+struct ring_jb_block
+{
+	long min;
+	long max;
+};
+
+/*! \brief private ring_jb structure */
+struct ring_jb
+{
+	struct ring_jb_conf conf;
+	/*! Slot count minus one */
+	unsigned int mask;
+	/*! Slot of the oldest queued frame */
+	unsigned int head;
+	/*! Number of queued frames */
+	unsigned int count;
+	/*! Set once the first frame has been put */
+	int started;
+	/*! Set while waiting for audio to resume after too much interpolation */
+	int silence;
+	/*! Playout delay, a frame with timestamp ts is delivered at ts + delay */
+	long delay;
+	/*! Timestamp of the next audio to deliver */
+	long next_ts;
+	/*! Length of the last frame delivered */
+	long last_ms;
+	/*! Time of the last change of the delay */
+	long last_adjustment;
+	/*! Transit delay of the last frame that was not a discontinuity */
+	long last_delay;
+	/*! Jitter found by the last ring_jb_get() */
+	long jitter;
+	int cnt_delay_discont;
+	int cnt_contig_interp;
+	struct ring_jb_block history[RING_JB_HISTORY_BLOCKS];
+	/*! Block currently being filled */
+	unsigned int hist_block;
+	/*! Frames in the block currently being filled */
+	unsigned int hist_frames;
+	/*! Completed blocks in the history */
+	unsigned int hist_blocks;
+	struct ring_jb_frame slots[0];
+};
+
+#define RING_SLOT(jb, i) (&(jb)->slots[((jb)->head + (i)) & (jb)->mask])
+
+static void history_reset(struct ring_jb *jb)
+{
+	jb->hist_block = 0;
+	jb->hist_frames = 0;
+	jb->hist_blocks = 0;
+}
+
+static void history_put(struct ring_jb *jb, long delay)
+{
+	struct ring_jb_block *block = &jb->history[jb->hist_block];
+
+	if (!jb->hist_frames) {
+		block->min = block->max = delay;
+	} else if (delay < block->min) {
+		block->min = delay;
+	} else if (delay > block->max) {
+		block->max = delay;
+	}
+
+	if (++jb->hist_frames == RING_JB_BLOCK_FRAMES) {
+		jb->hist_block = (jb->hist_block + 1) % RING_JB_HISTORY_BLOCKS;
+		jb->hist_frames = 0;
+		if (jb->hist_blocks < RING_JB_HISTORY_BLOCKS - 1) {
+			jb->hist_blocks++;
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Find the lowest delay and the jitter over the history.
+ *
+ * \retval 0 if there is no history
+ * \retval 1 otherwise
+ */
+static int history_get(struct ring_jb *jb, long *min, long *jitter)
+{
+	unsigned int blocks = jb->hist_blocks + (jb->hist_frames ? 1 : 0);
+	long lowest = LONG_MAX;
+	long highest = LONG_MIN;
+	long second = LONG_MIN;
+	unsigned int i;
+
+	if (!blocks) {
+		return 0;
+	}
+
+	for (i = 0; i < blocks; i++) {
+		/* Walk back from the block being filled, or the last completed one */
+		unsigned int idx = (jb->hist_block + RING_JB_HISTORY_BLOCKS - i
+			- (jb->hist_frames ? 0 : 1)) % RING_JB_HISTORY_BLOCKS;
+		const struct ring_jb_block *block = &jb->history[idx];
+
+		if (block->min < lowest) {
+			lowest = block->min;
+		}
+		if (block->max > highest) {
+			second = highest;
+			highest = block->max;
+		} else if (block->max > second) {
+			second = block->max;
+		}
+	}
+
+	*min = lowest;
+	*jitter = (blocks > 1 ? second : highest) - lowest;
+
+	return 1;
+}
+
+static long target_extra(struct ring_jb *jb)
+{
+	return jb->conf.target_extra;
+}
+
+/*! \brief Delay the buffer is steering towards */
+static long get_target(struct ring_jb *jb)
+{
+	long min;
+	long jitter;
+
+	if (!history_get(jb, &min, &jitter)) {
+		return jb->delay;
+	}
+	jb->jitter = jitter;
+
+	/* Hard clamp on how far above the fastest frames audio may be held */
+	if (jitter + target_extra(jb) > jb->conf.max_size) {
+		return min + jb->conf.max_size;
+	}
+
+	return min + jitter + target_extra(jb);
+}
+
+static void start_jb(struct ring_jb *jb, long ts, long now)
+{
+	jb->started = 1;
+	jb->silence = 0;
+	jb->delay = now - ts + target_extra(jb);
+	jb->next_ts = ts;
+	jb->last_adjustment = now;
+	jb->last_delay = now - ts;
+	jb->jitter = 0;
+	jb->cnt_delay_discont = 0;
+	jb->cnt_contig_interp = 0;
+	history_reset(jb);
+}
+
+/*!
+ * \internal
+ * \brief Store a frame in timestamp order.
+ *
+ * \note The caller has made sure there is a free slot.
+ */
+static void queue_put(struct ring_jb *jb, void *data, long ms, long ts)
+{
+	unsigned int pos = jb->count;
+
+	/* Out of order frames move the newer ones up a slot */
+	while (pos && RING_SLOT(jb, pos - 1)->ts > ts) {
+		*RING_SLOT(jb, pos) = *RING_SLOT(jb, pos - 1);
+		pos--;
+	}
+
+	RING_SLOT(jb, pos)->data = data;
+	RING_SLOT(jb, pos)->ts = ts;
+	RING_SLOT(jb, pos)->ms = ms;
+	jb->count++;
+}
+
+static void queue_get(struct ring_jb *jb, struct ring_jb_frame *frame)
+{
+	*frame = *RING_SLOT(jb, 0);
+	jb->head = (jb->head + 1) & jb->mask;
+	jb->count--;
+}
+
+struct ring_jb *ring_jb_new(struct ring_jb_conf *conf)
+{
+	struct ring_jb *jb;
+	unsigned int slots = RING_JB_MIN_SLOTS;
+	long max_size = conf->max_size < 1 ? RING_JB_SIZE_DEFAULT : conf->max_size;
+
+	/* Enough slots for max_size worth of the shortest frames */
+	while (slots < RING_JB_MAX_SLOTS && slots < max_size / RING_JB_MIN_FRAME_MS + 2) {
+		slots <<= 1;
+	}
+
+	if (!(jb = ast_calloc(1, sizeof(*jb) + slots * sizeof(jb->slots[0])))) {
+		return NULL;
+	}
+
+	/* First copy our config */
+	memcpy(&jb->conf, conf, sizeof(struct ring_jb_conf));
+
+	/* validate the configuration */
+	jb->conf.max_size = max_size;
+
+	if (!jb->conf.resync_threshold) {
+		jb->conf.resync_threshold = RING_JB_RESYNCH_THRESHOLD_DEFAULT;
+	}
+
+	if (jb->conf.target_extra < 0) {
+		jb->conf.target_extra = RING_JB_TARGET_EXTRA_DEFAULT;
+	}
+
+	if (jb->conf.max_contig_interp < 1) {
+		jb->conf.max_contig_interp = RING_JB_MAX_CONTIG_INTERP_DEFAULT;
+	}
+
+	jb->mask = slots - 1;
+
+	return jb;
+}
+
+void ring_jb_destroy(struct ring_jb *jb)
+{
+	/* jitterbuf MUST be empty before it can be destroyed */
+	ast_assert(jb->count == 0);
+
+	ast_free(jb);
+}
+
+void ring_jb_reset(struct ring_jb *jb)
+{
+	ast_assert(jb->count == 0);
+
+	jb->head = 0;
+	jb->started = 0;
+	jb->silence = 0;
+	history_reset(jb);
+}
+
+int ring_jb_put_first(struct ring_jb *jb, void *data, long ms, long ts, long now)
+{
+	start_jb(jb, ts, now);
+
+	return ring_jb_put(jb, data, ms, ts, now);
+}
+
+int ring_jb_put(struct ring_jb *jb, void *data, long ms, long ts, long now)
+{
+	long delay = now - ts;
+
+	if (!jb->started) {
+		return ring_jb_put_first(jb, data, ms, ts, now);
+	}
+
+	/* check for drastic change in delay */
+	if (jb->conf.resync_threshold != -1) {
+		if (labs(delay - jb->last_delay) > 2 * jb->jitter + jb->conf.resync_threshold) {
+			/*
+			 * Queued frames would be out of order against the new
+			 * timeline, so only start over once they have been played.
+			 */
+			if (++jb->cnt_delay_discont <= RING_JB_RESYNC_DISCONT || jb->count) {
+				return RING_JB_DROP;
+			}
+			start_jb(jb, ts, now);
+		} else {
+			jb->last_delay = delay;
+			jb->cnt_delay_discont = 0;
+		}
+	}
+
+	/* Late frames are still counted, they are what makes the buffer grow */
+	history_put(jb, delay);
+
+	if (ts < jb->next_ts && !jb->silence) {
+		return RING_JB_DROP;
+	}
+
+	/* Check for overfill of the buffer */
+	if (jb->count > jb->mask
+		|| (jb->count && RING_SLOT(jb, jb->count - 1)->ts - RING_SLOT(jb, 0)->ts >= jb->conf.max_size)) {
+		return RING_JB_DROP;
+	}
+
+	queue_put(jb, data, ms, ts);
+
+	return RING_JB_OK;
+}
+
+int ring_jb_get(struct ring_jb *jb, struct ring_jb_frame *frameout, long now, long interpl)
+{
+	struct ring_jb_frame *head = jb->count ? RING_SLOT(jb, 0) : NULL;
+	long target = get_target(jb);
+
+	if (interpl <= 0) {
+		interpl = jb->last_ms ? jb->last_ms : RING_JB_MIN_FRAME_MS;
+	}
+
+	if (jb->silence) {
+		if (!head || head->ts + jb->delay > now) {
+			return RING_JB_NOFRAME;
+		}
+		/* audio resumed */
+		jb->silence = 0;
+		jb->next_ts = head->ts;
+	}
+
+	/* Throw away frames that were interpolated over */
+	if (head && head->ts < jb->next_ts) {
+		queue_get(jb, frameout);
+		return RING_JB_DROP;
+	}
+
+	if (head && head->ts == jb->next_ts) {
+		queue_get(jb, frameout);
+		jb->next_ts = frameout->ts + frameout->ms;
+		jb->last_ms = frameout->ms;
+		jb->cnt_contig_interp = 0;
+
+		/* we want to shrink; shrink by the frame we're throwing out */
+		if (jb->delay - target > target_extra(jb)
+			&& jb->last_adjustment + RING_JB_SHRINK_INTERVAL < now) {
+			jb->delay -= frameout->ms;
+			jb->last_adjustment = now;
+			return RING_JB_DROP;
+		}
+
+		return RING_JB_OK;
+	}
+
+	/* The next frame is missing, or there is a gap before it */
+	if (target > jb->delay) {
+		/* grow, the frame may just be a bit late */
+		jb->delay += interpl;
+		jb->last_adjustment = now;
+	} else {
+		jb->next_ts += interpl;
+	}
+	jb->last_ms = interpl;
+	if (++jb->cnt_contig_interp >= jb->conf.max_contig_interp) {
+		jb->silence = 1;
+		jb->cnt_contig_interp = 0;
+	}
+	frameout->ts = jb->next_ts;
+	frameout->ms = interpl;
+
+	return RING_JB_INTERP;
+}
+
+long ring_jb_next(struct ring_jb *jb)
+{
+	if (!jb->started) {
+		return LONG_MAX;
+	}
+
+	if (jb->silence) {
+		return jb->count ? RING_SLOT(jb, 0)->ts + jb->delay : LONG_MAX;
+	}
+
+	return jb->next_ts + jb->delay;
+}
+
+int ring_jb_remove(struct ring_jb *jb, struct ring_jb_frame *frameout)
+{
+	if (!jb->count) {
+		return RING_JB_NOFRAME;
+	}
+
+	queue_get(jb, frameout);
+
+	return RING_JB_OK;
+}
+
+int ring_jb_is_late(struct ring_jb *jb, long ts)
+{
+	return jb->started && !jb->silence && ts < jb->next_ts;
+}
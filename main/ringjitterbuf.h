@@ -0,0 +1,97 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Ring buffer adaptive jitterbuffering algorithm.
+ *
+ */
+
+#ifndef _RINGJITTERBUF_H_
+#define _RINGJITTERBUF_H_
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+
+/* return codes */
+enum {
+	RING_JB_OK,
+	RING_JB_DROP,
+	RING_JB_INTERP,
+	RING_JB_NOFRAME
+};
+
+
+/* defaults */
+#define RING_JB_SIZE_DEFAULT 200
+#define RING_JB_RESYNCH_THRESHOLD_DEFAULT 1000
+#define RING_JB_TARGET_EXTRA_DEFAULT 40
+
+
+/* jb configuration properties */
+struct ring_jb_conf
+{
+	/*! Longest span of queued audio in ms, also the most the delay may exceed the minimum */
+	long max_size;
+	/*! Delay jump in ms that counts as a discontinuity, -1 to never resync */
+	long resync_threshold;
+	/*! Padding in ms added to the measured jitter, -1 for the default */
+	long target_extra;
+	/*! Interpolated frames in a row after which interpolation stops until audio resumes */
+	long max_contig_interp;
+};
+
+
+struct ring_jb_frame
+{
+	void *data;
+	long ts;
+	long ms;
+};
+
+
+struct ring_jb;
+
+
+/* jb interface */
+
+struct ring_jb *ring_jb_new(struct ring_jb_conf *conf);
+
+void ring_jb_destroy(struct ring_jb *jb);
+
+int ring_jb_put_first(struct ring_jb *jb, void *data, long ms, long ts, long now);
+
+int ring_jb_put(struct ring_jb *jb, void *data, long ms, long ts, long now);
+
+int ring_jb_get(struct ring_jb *jb, struct ring_jb_frame *frame, long now, long interpl);
+
+long ring_jb_next(struct ring_jb *jb);
+
+int ring_jb_remove(struct ring_jb *jb, struct ring_jb_frame *frameout);
+
+/*! \brief Start over as if no frame had been put, the jb must be empty */
+void ring_jb_reset(struct ring_jb *jb);
+
+/*! \brief Checks if the given time stamp is late */
+int ring_jb_is_late(struct ring_jb *jb, long ts);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* _RINGJITTERBUF_H_ */
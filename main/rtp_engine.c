@@ -3827,6 +3827,16 @@ void ast_rtp_instance_set_remote_ssrc(struct ast_rtp_instance *rtp, unsigned int
 	ao2_unlock(rtp);
 }
 
+void ast_rtp_instance_set_simulcast_ssrcs(struct ast_rtp_instance *rtp, const unsigned int *ssrcs,
+	unsigned int count)
+{
+	ao2_lock(rtp);
+	if (rtp->engine->set_simulcast_ssrcs) {
+		rtp->engine->set_simulcast_ssrcs(rtp, ssrcs, MIN(count, AST_RTP_MAX_SIMULCAST_LAYERS));
+	}
+	ao2_unlock(rtp);
+}
+
 void ast_rtp_instance_set_stream_num(struct ast_rtp_instance *rtp, int stream_num)
 {
 	ao2_lock(rtp);
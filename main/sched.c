@@ -44,6 +44,8 @@
 #include "asterisk/utils.h"
 #include "asterisk/heap.h"
 #include "asterisk/threadstorage.h"
+#include "asterisk/dlinkedlists.h"
+#include "asterisk/vector.h"
 
 /*!
  * \brief Max num of schedule structs
@@ -55,8 +57,26 @@
  */
 #define SCHED_MAX_CACHE 128
 
+/*! \brief Bits of a tick that select the slot of a timer wheel level */
+#define SCHED_WHEEL_BITS 6
+#define SCHED_WHEEL_SLOTS (1 << SCHED_WHEEL_BITS)
+#define SCHED_WHEEL_MASK (SCHED_WHEEL_SLOTS - 1)
+
+/*!
+ * \brief Number of timer wheel levels
+ *
+ * \note With a tick of 1ms the levels cover about 4.6 hours.  Tasks
+ * further out wait in the top level and are placed again when it
+ * gets to them.
+ */
+#define SCHED_WHEEL_LEVELS 4
+
 AST_THREADSTORAGE(last_del_id);
 
+struct sched;
+
+AST_DLLIST_HEAD_NOLOCK(sched_list, sched);
+
 /*!
  * \brief Scheduler ID holder
  *
@@ -70,6 +90,8 @@ AST_THREADSTORAGE(last_del_id);
 struct sched_id {
 	/*! Immutable ID number that is copied onto the scheduled task */
 	int id;
+	/*! The task holding this ID while it is queued to run */
+	struct sched *task;
 	AST_LIST_ENTRY(sched_id) list;
 };
 
@@ -91,6 +113,11 @@ struct sched {
 	const void *data;             /*!< Data */
 	ast_sched_cb callback;        /*!< Callback */
 	ssize_t __heap_index;
+	/*! Tick the task expires on when the context uses a timer wheel */
+	uint64_t tick;
+	/*! The timer wheel list the task is queued in */
+	struct sched_list *wheel_list;
+	AST_DLLIST_ENTRY(sched) wheel_entry;
 	/*!
 	 * Used to synchronize between thread running a task and thread
 	 * attempting to delete a task
@@ -100,6 +127,29 @@ struct sched {
 	unsigned int deleted:1;
 };
 
+/*!
+ * \brief Hierarchical timer wheel
+ *
+ * Time is counted in ticks of 1ms from when the wheel was created.  Each
+ * level has SCHED_WHEEL_SLOTS slots, and a slot of a level spans a full
+ * turn of the level below it.  Tasks are added to and removed from a slot
+ * in constant time.  When the lowest level turns over, the tasks in the
+ * next slot of the level above are spread out over the levels below.
+ */
+struct sched_wheel {
+	/*! The time of tick 0 */
+	struct timeval base;
+	/*! The next tick to run.  Every task still in a slot expires on it or later. */
+	uint64_t tick;
+	/*! Number of tasks in the wheel, expired ones included */
+	size_t count;
+	/*! A bit set for each slot of a level that holds tasks */
+	uint64_t occupied[SCHED_WHEEL_LEVELS];
+	struct sched_list slots[SCHED_WHEEL_LEVELS][SCHED_WHEEL_SLOTS];
+	/*! Tasks whose tick has been run, in the order they are to be executed */
+	struct sched_list expired;
+};
+
 struct sched_thread {
 	pthread_t thread;
 	ast_cond_t cond;
@@ -113,6 +163,8 @@ struct ast_sched_context {
 	/*! Next tie breaker in case events expire at the same time. */
 	unsigned int tie_breaker;
 	struct ast_heap *sched_heap;
+	/*! Used instead of sched_heap by contexts with a timer wheel */
+	struct sched_wheel *wheel;
 	struct sched_thread *sched_thread;
 	/*! The scheduled task that is currently executing */
 	struct sched *currently_executing;
@@ -127,6 +179,8 @@ struct ast_sched_context {
 	AST_LIST_HEAD_NOLOCK(, sched_id) id_queue;
 	/*! The number of IDs in the id_queue */
 	int id_queue_size;
+	/*! Every ID created, the ID number minus one is its index */
+	AST_VECTOR(, struct sched_id *) ids;
 };
 
 static void *sched_run(void *data)
@@ -233,7 +287,7 @@ static int sched_time_cmp(void *va, void *vb)
 	return cmp;
 }
 
-struct ast_sched_context *ast_sched_context_create(void)
+static struct ast_sched_context *sched_context_create(int wheel)
 {
 	struct ast_sched_context *tmp;
 
@@ -246,7 +300,19 @@ struct ast_sched_context *ast_sched_context_create(void)
 
 	AST_LIST_HEAD_INIT_NOLOCK(&tmp->id_queue);
 
-	if (!(tmp->sched_heap = ast_heap_create(8, sched_time_cmp,
+	if (AST_VECTOR_INIT(&tmp->ids, 16)) {
+		ast_sched_context_destroy(tmp);
+		return NULL;
+	}
+
+	if (wheel) {
+		/* The slot lists are all empty once zeroed */
+		if (!(tmp->wheel = ast_calloc(1, sizeof(*tmp->wheel)))) {
+			ast_sched_context_destroy(tmp);
+			return NULL;
+		}
+		tmp->wheel->base = ast_tvnow();
+	} else if (!(tmp->sched_heap = ast_heap_create(8, sched_time_cmp,
 			offsetof(struct sched, __heap_index)))) {
 		ast_sched_context_destroy(tmp);
 		return NULL;
@@ -255,13 +321,18 @@ struct ast_sched_context *ast_sched_context_create(void)
 	return tmp;
 }
 
+struct ast_sched_context *ast_sched_context_create(void)
+{
+	return sched_context_create(0);
+}
+
+struct ast_sched_context *ast_sched_context_create_wheel(void)
+{
+	return sched_context_create(1);
+}
+
 static void sched_free(struct sched *task)
 {
-	/* task->sched_id will be NULL most of the time, but when the
-	 * scheduler context shuts down, it will free all scheduled
-	 * tasks, and in that case, the task->sched_id will be non-NULL
-	 */
-	ast_free(task->sched_id);
 	ast_cond_destroy(&task->cond);
 	ast_free(task);
 }
@@ -269,7 +340,7 @@ static void sched_free(struct sched *task)
 void ast_sched_context_destroy(struct ast_sched_context *con)
 {
 	struct sched *s;
-	struct sched_id *sid;
+	int i;
 
 	sched_thread_destroy(con);
 	con->sched_thread = NULL;
@@ -282,17 +353,24 @@ void ast_sched_context_destroy(struct ast_sched_context *con)
 	}
 #endif
 
-	if (con->sched_heap) {
-		while ((s = ast_heap_pop(con->sched_heap))) {
-			sched_free(s);
+	/* Free the tasks still queued and all of the IDs */
+	for (i = 0; i < AST_VECTOR_SIZE(&con->ids); ++i) {
+		struct sched_id *sid = AST_VECTOR_GET(&con->ids, i);
+
+		if (sid->task) {
+			sched_free(sid->task);
 		}
-		ast_heap_destroy(con->sched_heap);
-		con->sched_heap = NULL;
+		ast_free(sid);
 	}
+	AST_VECTOR_FREE(&con->ids);
+	AST_LIST_HEAD_INIT_NOLOCK(&con->id_queue);
 
-	while ((sid = AST_LIST_REMOVE_HEAD(&con->id_queue, list))) {
-		ast_free(sid);
+	if (con->sched_heap) {
+		ast_heap_destroy(con->sched_heap);
+		con->sched_heap = NULL;
 	}
+	ast_free(con->wheel);
+	con->wheel = NULL;
 
 	ast_mutex_unlock(&con->lock);
 	ast_mutex_destroy(&con->lock);
@@ -337,7 +415,12 @@ static int add_ids(struct ast_sched_context *con)
 		 * several users incorrectly coded usage of the returned
 		 * sched ID assuming that 0 was invalid.
 		 */
-		new_id->id = ++con->id_queue_size;
+		new_id->id = con->id_queue_size + 1;
+		if (AST_VECTOR_APPEND(&con->ids, new_id)) {
+			ast_free(new_id);
+			break;
+		}
+		++con->id_queue_size;
 
 		AST_LIST_INSERT_TAIL(&con->id_queue, new_id, list);
 	}
@@ -404,19 +487,259 @@ static struct sched *sched_alloc(struct ast_sched_context *con)
 	return tmp;
 }
 
+/*!
+ * \brief Convert an expiry time to a tick of the timer wheel
+ *
+ * \note Rounds up so a task is never run before its time.
+ */
+static uint64_t sched_wheel_tick(struct sched_wheel *wheel, struct timeval tv)
+{
+	int64_t us = ast_tvdiff_us(tv, wheel->base);
+
+	return us > 0 ? (us + 999) / 1000 : 0;
+}
+
+/*! \brief The last tick of the timer wheel that has fully elapsed by \a tv */
+static uint64_t sched_wheel_elapsed(struct sched_wheel *wheel, struct timeval tv)
+{
+	int64_t us = ast_tvdiff_us(tv, wheel->base);
+
+	return us > 0 ? us / 1000 : 0;
+}
+
+static void sched_wheel_insert(struct sched_wheel *wheel, struct sched *s)
+{
+	struct sched_list *list;
+	struct sched *prev;
+
+	if (s->tick < wheel->tick) {
+		list = &wheel->expired;
+		prev = AST_DLLIST_LAST(list);
+	} else {
+		uint64_t delta = s->tick - wheel->tick;
+		uint64_t expires = s->tick;
+		unsigned int slot;
+		int level = 0;
+
+		while (level < SCHED_WHEEL_LEVELS - 1 && (delta >> ((level + 1) * SCHED_WHEEL_BITS))) {
+			++level;
+		}
+		if (delta >> (SCHED_WHEEL_LEVELS * SCHED_WHEEL_BITS)) {
+			/* Beyond the top level, wait in its furthest slot */
+			expires = wheel->tick + (1ULL << (SCHED_WHEEL_LEVELS * SCHED_WHEEL_BITS)) - 1;
+		}
+
+		slot = (expires >> (level * SCHED_WHEEL_BITS)) & SCHED_WHEEL_MASK;
+		list = &wheel->slots[level][slot];
+		wheel->occupied[level] |= 1ULL << slot;
+
+		prev = AST_DLLIST_LAST(list);
+		if (!level) {
+			/*
+			 * Every task of a lowest level slot expires on the same tick.
+			 * A task cascaded from a higher level goes before the tasks
+			 * added after it.
+			 */
+			while (prev && (int) (prev->tie_breaker - s->tie_breaker) > 0) {
+				prev = AST_DLLIST_PREV(prev, wheel_entry);
+			}
+		}
+	}
+
+	if (prev) {
+		AST_DLLIST_INSERT_AFTER(list, prev, s, wheel_entry);
+	} else {
+		AST_DLLIST_INSERT_HEAD(list, s, wheel_entry);
+	}
+	s->wheel_list = list;
+}
+
+static void sched_wheel_remove(struct sched_wheel *wheel, struct sched *s)
+{
+	struct sched_list *list = s->wheel_list;
+
+	AST_DLLIST_REMOVE(list, s, wheel_entry);
+	s->wheel_list = NULL;
+
+	if (list != &wheel->expired && !AST_DLLIST_FIRST(list)) {
+		size_t index = list - &wheel->slots[0][0];
+
+		wheel->occupied[index / SCHED_WHEEL_SLOTS] &= ~(1ULL << (index % SCHED_WHEEL_SLOTS));
+	}
+}
+
+/*! \brief Spread the tasks of a slot out over the levels below it */
+static void sched_wheel_cascade(struct sched_wheel *wheel, int level, unsigned int slot)
+{
+	struct sched_list list = wheel->slots[level][slot];
+	struct sched *s;
+
+	AST_DLLIST_HEAD_INIT_NOLOCK(&wheel->slots[level][slot]);
+	wheel->occupied[level] &= ~(1ULL << slot);
+
+	while ((s = AST_DLLIST_REMOVE_HEAD(&list, wheel_entry))) {
+		sched_wheel_insert(wheel, s);
+	}
+}
+
+/*! \brief Run the ticks of the timer wheel up to and including \a now */
+static void sched_wheel_advance(struct sched_wheel *wheel, uint64_t now)
+{
+	while (wheel->tick <= now) {
+		unsigned int slot = wheel->tick & SCHED_WHEEL_MASK;
+		struct sched *s;
+		int level;
+
+		for (level = 0; level < SCHED_WHEEL_LEVELS && !wheel->occupied[level]; ++level) {
+		}
+		if (level == SCHED_WHEEL_LEVELS) {
+			/* Nothing left in the slots */
+			wheel->tick = now + 1;
+			break;
+		}
+
+		if (!slot) {
+			for (level = 1; level < SCHED_WHEEL_LEVELS; ++level) {
+				unsigned int index = (wheel->tick >> (level * SCHED_WHEEL_BITS)) & SCHED_WHEEL_MASK;
+
+				sched_wheel_cascade(wheel, level, index);
+				if (index) {
+					break;
+				}
+			}
+		}
+
+		/* The whole slot expires at once */
+		while ((s = AST_DLLIST_REMOVE_HEAD(&wheel->slots[0][slot], wheel_entry))) {
+			AST_DLLIST_INSERT_TAIL(&wheel->expired, s, wheel_entry);
+			s->wheel_list = &wheel->expired;
+		}
+		wheel->occupied[0] &= ~(1ULL << slot);
+
+		++wheel->tick;
+		if (!wheel->occupied[0] && (wheel->tick & SCHED_WHEEL_MASK)) {
+			/* Nothing to run until the next cascade */
+			wheel->tick = MIN((wheel->tick | SCHED_WHEEL_MASK) + 1, now + 1);
+		}
+	}
+}
+
+/*! \brief Milliseconds until the timer wheel has something to do */
+static int sched_wheel_wait(struct sched_wheel *wheel)
+{
+	uint64_t next = UINT64_MAX;
+	int64_t ms;
+	int level;
+
+	if (AST_DLLIST_FIRST(&wheel->expired)) {
+		return 0;
+	}
+
+	for (level = 0; level < SCHED_WHEEL_LEVELS; ++level) {
+		unsigned int shift = level * SCHED_WHEEL_BITS;
+		uint64_t occupied = wheel->occupied[level];
+		uint64_t turn;
+		unsigned int index;
+
+		if (!occupied) {
+			continue;
+		}
+
+		/*
+		 * A slot of this level is reached every (1 << shift) ticks.  Find
+		 * the first occupied one from the next time that happens.
+		 */
+		turn = (wheel->tick + (1ULL << shift) - 1) >> shift;
+		index = turn & SCHED_WHEEL_MASK;
+		if (index) {
+			occupied = (occupied >> index) | (occupied << (SCHED_WHEEL_SLOTS - index));
+		}
+		next = MIN(next, (turn + ffsll(occupied) - 1) << shift);
+	}
+
+	if (next == UINT64_MAX) {
+		return -1;
+	}
+
+	/* Round up so the wait does not end just before the tick */
+	ms = (ast_tvdiff_us(ast_tvadd(wheel->base, ast_samp2tv(next, 1000)), ast_tvnow()) + 999) / 1000;
+	if (ms < 0) {
+		ms = 0;
+	} else if (ms > INT_MAX) {
+		ms = INT_MAX;
+	}
+
+	return ms;
+}
+
+/*! \brief Number of tasks queued to run */
+static size_t sched_count(struct ast_sched_context *con)
+{
+	return con->wheel ? con->wheel->count : ast_heap_size(con->sched_heap);
+}
+
+static void sched_queue(struct ast_sched_context *con, struct sched *s)
+{
+	if (con->wheel) {
+		s->tick = sched_wheel_tick(con->wheel, s->when);
+		sched_wheel_insert(con->wheel, s);
+		++con->wheel->count;
+	} else {
+		ast_heap_push(con->sched_heap, s);
+	}
+	s->sched_id->task = s;
+}
+
+static int sched_dequeue(struct ast_sched_context *con, struct sched *s)
+{
+	s->sched_id->task = NULL;
+	if (con->wheel) {
+		sched_wheel_remove(con->wheel, s);
+		--con->wheel->count;
+	} else if (!ast_heap_remove(con->sched_heap, s)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*! \brief Take the next task off the queue that is due by \a when */
+static struct sched *sched_pop_due(struct ast_sched_context *con, struct timeval when)
+{
+	struct sched *s;
+
+	if (con->wheel) {
+		s = AST_DLLIST_FIRST(&con->wheel->expired);
+	} else if ((s = ast_heap_peek(con->sched_heap, 1)) && ast_tvcmp(s->when, when) != -1) {
+		s = NULL;
+	}
+
+	if (s) {
+		sched_dequeue(con, s);
+	}
+
+	return s;
+}
+
+/*! \brief Get a queued task by its position in the ID table */
+static struct sched *sched_peek_index(struct ast_sched_context *con, int index)
+{
+	return AST_VECTOR_GET(&con->ids, index)->task;
+}
+
 void ast_sched_clean_by_callback(struct ast_sched_context *con, ast_sched_cb match, ast_sched_cb cleanup_cb)
 {
-	int i = 1;
+	int i;
 	struct sched *current;
 
 	ast_mutex_lock(&con->lock);
-	while ((current = ast_heap_peek(con->sched_heap, i))) {
-		if (current->callback != match) {
-			i++;
+	for (i = 0; i < AST_VECTOR_SIZE(&con->ids); ++i) {
+		current = sched_peek_index(con, i);
+		if (!current || current->callback != match) {
 			continue;
 		}
 
-		ast_heap_remove(con->sched_heap, current);
+		sched_dequeue(con, current);
 
 		cleanup_cb(current->data);
 		sched_release(con, current);
@@ -436,7 +759,9 @@ int ast_sched_wait(struct ast_sched_context *con)
 	DEBUG(ast_debug(1, "ast_sched_wait()\n"));
 
 	ast_mutex_lock(&con->lock);
-	if ((s = ast_heap_peek(con->sched_heap, 1))) {
+	if (con->wheel) {
+		ms = con->wheel->count ? sched_wheel_wait(con->wheel) : -1;
+	} else if ((s = ast_heap_peek(con->sched_heap, 1))) {
 		ms = ast_tvdiff_ms(s->when, ast_tvnow());
 		if (ms < 0) {
 			ms = 0;
@@ -459,7 +784,7 @@ static void schedule(struct ast_sched_context *con, struct sched *s)
 {
 	size_t size;
 
-	size = ast_heap_size(con->sched_heap);
+	size = sched_count(con);
 
 	/* Record the largest the scheduler heap became for reporting purposes. */
 	if (con->highwater <= size) {
@@ -478,7 +803,7 @@ static void schedule(struct ast_sched_context *con, struct sched *s)
 	}
 	s->tie_breaker = con->tie_breaker;
 
-	ast_heap_push(con->sched_heap, s);
+	sched_queue(con, s);
 }
 
 /*! \brief
@@ -569,19 +894,11 @@ int ast_sched_add(struct ast_sched_context *con, int when, ast_sched_cb callback
 
 static struct sched *sched_find(struct ast_sched_context *con, int id)
 {
-	int x;
-	size_t heap_size;
-
-	heap_size = ast_heap_size(con->sched_heap);
-	for (x = 1; x <= heap_size; x++) {
-		struct sched *cur = ast_heap_peek(con->sched_heap, x);
-
-		if (cur->sched_id->id == id) {
-			return cur;
-		}
+	if (id < 1 || id > AST_VECTOR_SIZE(&con->ids)) {
+		return NULL;
 	}
 
-	return NULL;
+	return sched_peek_index(con, id - 1);
 }
 
 const void *ast_sched_find_data(struct ast_sched_context *con, int id)
@@ -622,7 +939,7 @@ int ast_sched_del(struct ast_sched_context *con, int id)
 
 	s = sched_find(con, id);
 	if (s) {
-		if (!ast_heap_remove(con->sched_heap, s)) {
+		if (sched_dequeue(con, s)) {
 			ast_log(LOG_WARNING,"sched entry %d not in the sched heap?\n", s->sched_id->id);
 		}
 		sched_release(con, s);
@@ -676,16 +993,16 @@ void ast_sched_report(struct ast_sched_context *con, struct ast_str **buf, struc
 	int i, x;
 	struct sched *cur;
 	int countlist[cbnames->numassocs + 1];
-	size_t heap_size;
 
 	memset(countlist, 0, sizeof(countlist));
-	ast_str_set(buf, 0, " Highwater = %u\n schedcnt = %zu\n", con->highwater, ast_heap_size(con->sched_heap));
+	ast_str_set(buf, 0, " Highwater = %u\n schedcnt = %zu\n", con->highwater, sched_count(con));
 
 	ast_mutex_lock(&con->lock);
 
-	heap_size = ast_heap_size(con->sched_heap);
-	for (x = 1; x <= heap_size; x++) {
-		cur = ast_heap_peek(con->sched_heap, x);
+	for (x = 0; x < AST_VECTOR_SIZE(&con->ids); x++) {
+		if (!(cur = sched_peek_index(con, x))) {
+			continue;
+		}
 		/* match the callback to the cblist */
 		for (i = 0; i < cbnames->numassocs; i++) {
 			if (cur->callback == cbnames->cblist[i]) {
@@ -714,7 +1031,6 @@ void ast_sched_dump(struct ast_sched_context *con)
 	struct sched *q;
 	struct timeval when;
 	int x;
-	size_t heap_size;
 
 	if (!DEBUG_ATLEAST(1)) {
 		return;
@@ -723,20 +1039,21 @@ void ast_sched_dump(struct ast_sched_context *con)
 	when = ast_tvnow();
 #ifdef SCHED_MAX_CACHE
 	ast_log(LOG_DEBUG, "Asterisk Schedule Dump (%zu in Q, %u Total, %u Cache, %u high-water)\n",
-		ast_heap_size(con->sched_heap), con->eventcnt - 1, con->schedccnt, con->highwater);
+		sched_count(con), con->eventcnt - 1, con->schedccnt, con->highwater);
 #else
 	ast_log(LOG_DEBUG, "Asterisk Schedule Dump (%zu in Q, %u Total, %u high-water)\n",
-		ast_heap_size(con->sched_heap), con->eventcnt - 1, con->highwater);
+		sched_count(con), con->eventcnt - 1, con->highwater);
 #endif
 
 	ast_log(LOG_DEBUG, "=============================================================\n");
 	ast_log(LOG_DEBUG, "|ID    Callback          Data              Time  (sec:ms)   |\n");
 	ast_log(LOG_DEBUG, "+-----+-----------------+-----------------+-----------------+\n");
 	ast_mutex_lock(&con->lock);
-	heap_size = ast_heap_size(con->sched_heap);
-	for (x = 1; x <= heap_size; x++) {
+	for (x = 0; x < AST_VECTOR_SIZE(&con->ids); x++) {
 		struct timeval delta;
-		q = ast_heap_peek(con->sched_heap, x);
+		if (!(q = sched_peek_index(con, x))) {
+			continue;
+		}
 		delta = ast_tvsub(q->when, when);
 		ast_log(LOG_DEBUG, "|%.4d | %-15p | %-15p | %.6ld : %.6ld |\n",
 			q->sched_id->id,
@@ -764,17 +1081,19 @@ int ast_sched_runq(struct ast_sched_context *con)
 	ast_mutex_lock(&con->lock);
 
 	when = ast_tvadd(ast_tvnow(), ast_tv(0, 1000));
-	for (numevents = 0; (current = ast_heap_peek(con->sched_heap, 1)); numevents++) {
-		/* schedule all events which are going to expire within 1ms.
-		 * We only care about millisecond accuracy anyway, so this will
-		 * help us get more than one event at one time if they are very
-		 * close together.
+	if (con->wheel) {
+		/*
+		 * Everything expiring by now is moved to the expired list in one
+		 * go.  Expiry is rounded up to a tick so nothing runs early.
 		 */
-		if (ast_tvcmp(current->when, when) != -1) {
-			break;
-		}
-
-		current = ast_heap_pop(con->sched_heap);
+		sched_wheel_advance(con->wheel, sched_wheel_elapsed(con->wheel, ast_tvnow()));
+	}
+	/* schedule all events which are going to expire within 1ms.
+	 * We only care about millisecond accuracy anyway, so this will
+	 * help us get more than one event at one time if they are very
+	 * close together.
+	 */
+	for (numevents = 0; (current = sched_pop_due(con, when)); numevents++) {
 
 		/*
 		 * At this point, the schedule queue is still intact.  We
@@ -100,6 +100,14 @@ const char *ast_sdp_srtp_get_attrib(struct ast_sdp_srtp *srtp, int dtls_enabled,
 	return sdp_crypto_api->get_attr(srtp, dtls_enabled, default_taglen_32);
 }
 
+int ast_sdp_crypto_prefer_aead(void)
+{
+	if (!sdp_crypto_api || !sdp_crypto_api->prefer_aead) {
+		return 0;
+	}
+	return sdp_crypto_api->prefer_aead();
+}
+
 char *ast_sdp_get_rtp_profile(unsigned int sdes_active, struct ast_rtp_instance *instance, unsigned int using_avpf,
 	unsigned int force_avp)
 {
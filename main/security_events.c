@@ -358,6 +358,32 @@
 			</syntax>
 		</managerEventInstance>
 	</managerEvent>
+	<managerEvent language="en_US" name="SuppressedEvents">
+		<managerEventInstance class="EVENT_FLAG_SECURITY">
+			<synopsis>Raised when security events from a remote address were suppressed by rate limiting.</synopsis>
+			<syntax>
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='EventTV'])" />
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='Severity'])" />
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='Service'])" />
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='EventVersion'])" />
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='RemoteAddress'])" />
+				<parameter name="SuppressedEvent">
+					<para>The name of the security event that was suppressed.</para>
+				</parameter>
+				<parameter name="SuppressedCount">
+					<para>The number of events that were suppressed during the interval.</para>
+				</parameter>
+				<xi:include xpointer="xpointer(/docs/managerEvent[@name='FailedACL']/managerEventInstance/syntax/parameter[@name='Module'])" />
+			</syntax>
+			<description>
+				<para>Security events of each type from a single remote address are
+				limited by the <literal>security_event_limit</literal> and
+				<literal>security_event_interval</literal> options in
+				<filename>asterisk.conf</filename>. This event reports how many
+				were dropped once the interval ends.</para>
+			</description>
+		</managerEventInstance>
+	</managerEvent>
  ***/
 
 #include "asterisk.h"
@@ -371,6 +397,8 @@
 #include "asterisk/stasis.h"
 #include "asterisk/json.h"
 #include "asterisk/astobj2.h"
+#include "asterisk/options.h"
+#include "asterisk/sched.h"
 
 static const size_t SECURITY_EVENT_BUF_INIT_LEN = 256;
 
@@ -472,8 +500,189 @@ STASIS_MESSAGE_TYPE_DEFN(ast_security_event_type,
 	.to_ami = security_event_to_ami,
 	);
 
+/*! \brief Number of buckets in the security event limit container */
+#define SECURITY_EVENT_LIMIT_BUCKETS 563
+
+/*! \brief Security events of one type reported from one remote address */
+struct security_event_limit {
+	/*! Start of the current interval */
+	struct timeval start;
+	/*! Events reported during the current interval */
+	unsigned int reported;
+	/*! Events suppressed during the current interval */
+	unsigned int suppressed;
+	/*! Type of the limited events */
+	enum ast_security_event_type event_type;
+	/*! Remote address, without the port */
+	struct ast_sockaddr addr;
+	/*! Transport of the last limited event */
+	enum ast_transport transport;
+	/*! Service of the last limited event */
+	char service[32];
+};
+
+/*! \brief Per remote address security event limits, NULL if not limiting */
+static struct ao2_container *security_event_limits;
+
+/*! \brief Scheduler expiring idle security event limits */
+static struct ast_sched_context *security_event_sched;
+
+static int security_event_limit_hash(const void *obj, const int flags)
+{
+	const struct security_event_limit *limit = obj;
+
+	return ast_sockaddr_hash(&limit->addr) ^ limit->event_type;
+}
+
+static int security_event_limit_cmp(void *obj, void *arg, int flags)
+{
+	const struct security_event_limit *left = obj;
+	const struct security_event_limit *right = arg;
+
+	if (left->event_type != right->event_type
+		|| ast_sockaddr_cmp_addr(&left->addr, &right->addr)) {
+		return 0;
+	}
+
+	return CMP_MATCH;
+}
+
+static int handle_security_event(const struct ast_security_event_common *sec);
+
+/*! \brief Report the number of events a limit suppressed */
+static void security_event_report_suppressed(enum ast_security_event_type event_type,
+	const struct ast_sockaddr *addr, enum ast_transport transport,
+	const char *service, unsigned int count)
+{
+	struct ast_security_event_suppressed suppressed = {
+		.common.event_type = AST_SECURITY_EVENT_SUPPRESSED,
+		.common.version    = AST_SECURITY_EVENT_SUPPRESSED_VERSION,
+		.common.service    = service,
+		.common.remote_addr = {
+			.addr      = addr,
+			.transport = transport,
+		},
+		.suppressed_event = ast_security_event_get_name(event_type),
+		.count = count,
+	};
+
+	if (handle_security_event(&suppressed.common)) {
+		ast_log(LOG_ERROR, "Failed to issue security event of type %s.\n",
+			ast_security_event_get_name(AST_SECURITY_EVENT_SUPPRESSED));
+	}
+}
+
+/*!
+ * \brief Check a security event against the per remote address limit
+ *
+ * \retval 0 the event is to be reported
+ * \retval 1 the event is suppressed
+ */
+static int security_event_limited(const struct ast_security_event_common *sec)
+{
+	struct security_event_limit key = { .event_type = sec->event_type, };
+	struct security_event_limit *limit;
+	unsigned int max = ast_option_security_event_limit;
+	int64_t window = (int64_t) ast_option_security_event_interval * 1000;
+	struct timeval now;
+	unsigned int suppressed = 0;
+	int res = 0;
+
+	if (!security_event_limits || !max
+		|| sec->event_type == AST_SECURITY_EVENT_SUCCESSFUL_AUTH
+		|| sec->event_type == AST_SECURITY_EVENT_SUPPRESSED
+		|| !sec->remote_addr.addr) {
+		return 0;
+	}
+
+	ast_sockaddr_copy(&key.addr, sec->remote_addr.addr);
+	ast_sockaddr_set_port(&key.addr, 0);
+
+	now = ast_tvnow();
+
+	ao2_lock(security_event_limits);
+	limit = ao2_find(security_event_limits, &key, OBJ_SEARCH_OBJECT | OBJ_NOLOCK);
+	if (!limit) {
+		limit = ao2_alloc_options(sizeof(*limit), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!limit) {
+			ao2_unlock(security_event_limits);
+			return 0;
+		}
+		*limit = key;
+		limit->start = now;
+		ao2_link_flags(security_event_limits, limit, OBJ_NOLOCK);
+	}
+
+	if (ast_tvdiff_ms(now, limit->start) >= window) {
+		suppressed = limit->suppressed;
+		limit->start = now;
+		limit->reported = 0;
+		limit->suppressed = 0;
+	}
+
+	if (limit->reported < max) {
+		++limit->reported;
+	} else {
+		++limit->suppressed;
+		res = 1;
+	}
+
+	limit->transport = sec->remote_addr.transport;
+	ast_copy_string(limit->service, S_OR(sec->service, ""), sizeof(limit->service));
+	key = *limit;
+	ao2_unlock(security_event_limits);
+	ao2_ref(limit, -1);
+
+	if (suppressed) {
+		security_event_report_suppressed(key.event_type, &key.addr, key.transport,
+			key.service, suppressed);
+	}
+
+	return res;
+}
+
+static int security_event_limit_expired(void *obj, void *arg, void *data, int flags)
+{
+	struct security_event_limit *limit = obj;
+	const struct timeval *now = arg;
+
+	if (ast_tvdiff_ms(*now, limit->start) >= (int64_t) ast_option_security_event_interval * 1000) {
+		return CMP_MATCH;
+	}
+
+	return 0;
+}
+
+/*! \brief Drop limits whose interval ended, reporting what they suppressed */
+static int security_event_limit_sweep(const void *data)
+{
+	struct timeval now = ast_tvnow();
+	struct ao2_iterator *expired;
+	struct security_event_limit *limit;
+
+	expired = ao2_callback_data(security_event_limits, OBJ_MULTIPLE | OBJ_UNLINK,
+		security_event_limit_expired, &now, NULL);
+	if (expired) {
+		while ((limit = ao2_iterator_next(expired))) {
+			if (limit->suppressed) {
+				security_event_report_suppressed(limit->event_type, &limit->addr,
+					limit->transport, limit->service, limit->suppressed);
+			}
+			ao2_ref(limit, -1);
+		}
+		ao2_iterator_destroy(expired);
+	}
+
+	return ast_option_security_event_interval * 1000;
+}
+
 static void security_stasis_cleanup(void)
 {
+	ast_sched_context_destroy(security_event_sched);
+	security_event_sched = NULL;
+	ao2_cleanup(security_event_limits);
+	security_event_limits = NULL;
+
 	ao2_cleanup(security_topic);
 	security_topic = NULL;
 
@@ -493,6 +702,19 @@ int ast_security_stasis_init(void)
 		return -1;
 	}
 
+	if (ast_option_security_event_limit) {
+		security_event_limits = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+			SECURITY_EVENT_LIMIT_BUCKETS, security_event_limit_hash, NULL,
+			security_event_limit_cmp);
+		security_event_sched = ast_sched_context_create();
+		if (!security_event_limits || !security_event_sched
+			|| ast_sched_start_thread(security_event_sched)
+			|| ast_sched_add_variable(security_event_sched,
+				ast_option_security_event_interval * 1000,
+				security_event_limit_sweep, NULL, 1) < 0) {
+			return -1;
+		}
+	}
 
 	return 0;
 }
@@ -856,6 +1078,26 @@ static const struct {
 	},
 },
 
+[AST_SECURITY_EVENT_SUPPRESSED] = {
+	.name     = "SuppressedEvents",
+	.version  = AST_SECURITY_EVENT_SUPPRESSED_VERSION,
+	.severity = AST_SECURITY_EVENT_SEVERITY_ERROR,
+	.required_ies = {
+		{ AST_EVENT_IE_EVENT_TV, 0 },
+		{ AST_EVENT_IE_SEVERITY, 0 },
+		{ AST_EVENT_IE_SERVICE, SEC_EVT_FIELD(common, service) },
+		{ AST_EVENT_IE_EVENT_VERSION, SEC_EVT_FIELD(common, version) },
+		{ AST_EVENT_IE_REMOTE_ADDR, SEC_EVT_FIELD(common, remote_addr) },
+		{ AST_EVENT_IE_SUPPRESSED_EVENT, SEC_EVT_FIELD(suppressed, suppressed_event) },
+		{ AST_EVENT_IE_SUPPRESSED_COUNT, SEC_EVT_FIELD(suppressed, count) },
+		{ AST_EVENT_IE_END, 0 }
+	},
+	.optional_ies = {
+		{ AST_EVENT_IE_MODULE, SEC_EVT_FIELD(common, module) },
+		{ AST_EVENT_IE_END, 0 }
+	},
+},
+
 #undef SEC_EVT_FIELD
 
 };
@@ -959,6 +1201,7 @@ static int add_json_object(struct ast_json *json, const struct ast_security_even
 	case AST_EVENT_IE_RECEIVED_CHALLENGE:
 	case AST_EVENT_IE_RECEIVED_HASH:
 	case AST_EVENT_IE_ATTEMPTED_TRANSPORT:
+	case AST_EVENT_IE_SUPPRESSED_EVENT:
 	{
 		const char *str;
 		struct ast_json *json_string;
@@ -989,6 +1232,7 @@ static int add_json_object(struct ast_json *json, const struct ast_security_even
 	}
 	case AST_EVENT_IE_EVENT_VERSION:
 	case AST_EVENT_IE_USING_PASSWORD:
+	case AST_EVENT_IE_SUPPRESSED_COUNT:
 	{
 		struct ast_json *json_string;
 		uint32_t val;
@@ -1128,6 +1372,11 @@ static int handle_security_event(const struct ast_security_event_common *sec)
 		return -1;
 	}
 
+	/* Nobody would see the event, don't bother building it. */
+	if (!stasis_topic_subscribers(ast_security_topic())) {
+		return 0;
+	}
+
 	json_object = alloc_security_event_json_object(sec);
 	if (!json_object) {
 		return -1;
@@ -1187,6 +1436,10 @@ int ast_security_event_report(const struct ast_security_event_common *sec)
 		return -1;
 	}
 
+	if (security_event_limited(sec)) {
+		return 0;
+	}
+
 	if (handle_security_event(sec)) {
 		ast_log(LOG_ERROR, "Failed to issue security event of type %s.\n",
 				ast_security_event_get_name(sec->event_type));
@@ -0,0 +1,380 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Signed linear buffer mixing kernels
+ *
+ * The vector kernels are compiled with per-function target attributes so
+ * the binary as a whole does not need to be built for a newer CPU than the
+ * one it runs on.  The kernel set actually used is chosen once at startup.
+ */
+
+/* Needed for the mm_malloc.h pulled in by immintrin.h */
+#define ASTMM_LIBC ASTMM_IGNORE
+#include "asterisk.h"
+
+#include "asterisk/_private.h"
+#include "asterisk/utils.h"
+#include "asterisk/slinear_mix.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SLINEAR_MIX_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define SLINEAR_MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void scalar_add(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		ast_slinear_saturated_add(&dst[i], (short *) &src[i]);
+	}
+}
+
+static void scalar_subtract(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		ast_slinear_saturated_subtract(&dst[i], (short *) &src[i]);
+	}
+}
+
+static void scalar_multiply(short *buf, unsigned int samples, short factor)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		ast_slinear_saturated_multiply(&buf[i], &factor);
+	}
+}
+
+static void scalar_divide(short *buf, unsigned int samples, short divisor)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		ast_slinear_saturated_divide(&buf[i], &divisor);
+	}
+}
+
+static const struct ast_slinear_mix_ops scalar_ops = {
+	.name = "scalar",
+	.add = scalar_add,
+	.subtract = scalar_subtract,
+	.multiply = scalar_multiply,
+	.divide = scalar_divide,
+};
+
+#ifdef SLINEAR_MIX_X86
+/*
+ * For multiply the low and high halves of each 32 bit product are
+ * interleaved back together and then narrowed with signed saturation,
+ * which is exactly what the scalar helper does.
+ *
+ * For divide the samples are widened to single precision floats.  Both
+ * operands are at most 16 bits, so the correctly rounded quotient can never
+ * land on the other side of an integer from the exact one and truncating it
+ * gives the same answer as C integer division.
+ */
+
+__attribute__((target("sse2")))
+static void sse2_add(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i));
+
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_adds_epi16(a, b));
+	}
+	scalar_add(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2_subtract(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i));
+
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_subs_epi16(a, b));
+	}
+	scalar_subtract(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2_multiply(short *buf, unsigned int samples, short factor)
+{
+	__m128i f = _mm_set1_epi16(factor);
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (buf + i));
+		__m128i lo = _mm_mullo_epi16(a, f);
+		__m128i hi = _mm_mulhi_epi16(a, f);
+
+		_mm_storeu_si128((__m128i *) (buf + i),
+			_mm_packs_epi32(_mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi)));
+	}
+	scalar_multiply(buf + i, samples - i, factor);
+}
+
+__attribute__((target("sse2")))
+static void sse2_divide(short *buf, unsigned int samples, short divisor)
+{
+	__m128 d = _mm_set1_ps((float) divisor);
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (buf + i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16));
+
+		_mm_storeu_si128((__m128i *) (buf + i),
+			_mm_packs_epi32(_mm_cvttps_epi32(_mm_div_ps(lo, d)),
+				_mm_cvttps_epi32(_mm_div_ps(hi, d))));
+	}
+	scalar_divide(buf + i, samples - i, divisor);
+}
+
+static const struct ast_slinear_mix_ops sse2_ops = {
+	.name = "sse2",
+	.add = sse2_add,
+	.subtract = sse2_subtract,
+	.multiply = sse2_multiply,
+	.divide = sse2_divide,
+};
+
+/*
+ * The AVX2 unpack and pack instructions work within each 128 bit lane, so
+ * pairing them the same way as the SSE2 versions keeps samples in order.
+ */
+
+__attribute__((target("avx2")))
+static void avx2_add(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (src + i));
+
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_adds_epi16(a, b));
+	}
+	sse2_add(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_subtract(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (src + i));
+
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_subs_epi16(a, b));
+	}
+	sse2_subtract(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_multiply(short *buf, unsigned int samples, short factor)
+{
+	__m256i f = _mm256_set1_epi16(factor);
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (buf + i));
+		__m256i lo = _mm256_mullo_epi16(a, f);
+		__m256i hi = _mm256_mulhi_epi16(a, f);
+
+		_mm256_storeu_si256((__m256i *) (buf + i),
+			_mm256_packs_epi32(_mm256_unpacklo_epi16(lo, hi), _mm256_unpackhi_epi16(lo, hi)));
+	}
+	sse2_multiply(buf + i, samples - i, factor);
+}
+
+__attribute__((target("avx2")))
+static void avx2_divide(short *buf, unsigned int samples, short divisor)
+{
+	__m256 d = _mm256_set1_ps((float) divisor);
+	unsigned int i = 0;
+
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (buf + i));
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_unpacklo_epi16(a, a), 16));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_unpackhi_epi16(a, a), 16));
+
+		_mm256_storeu_si256((__m256i *) (buf + i),
+			_mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_div_ps(lo, d)),
+				_mm256_cvttps_epi32(_mm256_div_ps(hi, d))));
+	}
+	sse2_divide(buf + i, samples - i, divisor);
+}
+
+static const struct ast_slinear_mix_ops avx2_ops = {
+	.name = "avx2",
+	.add = avx2_add,
+	.subtract = avx2_subtract,
+	.multiply = avx2_multiply,
+	.divide = avx2_divide,
+};
+#endif /* SLINEAR_MIX_X86 */
+
+#ifdef SLINEAR_MIX_NEON
+static void neon_add(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+	}
+	scalar_add(dst + i, src + i, samples - i);
+}
+
+static void neon_subtract(short *dst, const short *src, unsigned int samples)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		vst1q_s16(dst + i, vqsubq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+	}
+	scalar_subtract(dst + i, src + i, samples - i);
+}
+
+static void neon_multiply(short *buf, unsigned int samples, short factor)
+{
+	int16x4_t f = vdup_n_s16(factor);
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		int16x8_t a = vld1q_s16(buf + i);
+
+		vst1q_s16(buf + i, vcombine_s16(vqmovn_s32(vmull_s16(vget_low_s16(a), f)),
+			vqmovn_s32(vmull_s16(vget_high_s16(a), f))));
+	}
+	scalar_multiply(buf + i, samples - i, factor);
+}
+
+static void neon_divide(short *buf, unsigned int samples, short divisor)
+{
+	float32x4_t d = vdupq_n_f32((float) divisor);
+	unsigned int i = 0;
+
+	for (; i + 8 <= samples; i += 8) {
+		int16x8_t a = vld1q_s16(buf + i);
+		float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(a)));
+		float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(a)));
+
+		vst1q_s16(buf + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vdivq_f32(lo, d))),
+			vqmovn_s32(vcvtq_s32_f32(vdivq_f32(hi, d)))));
+	}
+	scalar_divide(buf + i, samples - i, divisor);
+}
+
+static const struct ast_slinear_mix_ops neon_ops = {
+	.name = "neon",
+	.add = neon_add,
+	.subtract = neon_subtract,
+	.multiply = neon_multiply,
+	.divide = neon_divide,
+};
+#endif /* SLINEAR_MIX_NEON */
+
+/*! \brief The kernels in use, plain C until ast_slinear_mix_init() runs */
+static const struct ast_slinear_mix_ops *active_ops = &scalar_ops;
+
+const struct ast_slinear_mix_ops *ast_slinear_mix_get_ops(enum ast_slinear_mix_impl impl)
+{
+	switch (impl) {
+	case AST_SLINEAR_MIX_SCALAR:
+		return &scalar_ops;
+#ifdef SLINEAR_MIX_X86
+	case AST_SLINEAR_MIX_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2") ? &sse2_ops : NULL;
+	case AST_SLINEAR_MIX_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &avx2_ops : NULL;
+#endif
+#ifdef SLINEAR_MIX_NEON
+	case AST_SLINEAR_MIX_NEON:
+		return &neon_ops;
+#endif
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+const struct ast_slinear_mix_ops *ast_slinear_mix_active_ops(void)
+{
+	return active_ops;
+}
+
+void ast_slinear_mix_add(short *dst, const short *src, unsigned int samples)
+{
+	active_ops->add(dst, src, samples);
+}
+
+void ast_slinear_mix_subtract(short *dst, const short *src, unsigned int samples)
+{
+	active_ops->subtract(dst, src, samples);
+}
+
+void ast_slinear_mix_adjust_volume(short *buf, unsigned int samples, int adjustment)
+{
+	if (adjustment > 0) {
+		active_ops->multiply(buf, samples, adjustment);
+	} else if (adjustment < 0) {
+		active_ops->divide(buf, samples, abs(adjustment));
+	}
+}
+
+int ast_slinear_mix_init(void)
+{
+	/* Ordered from most to least preferred */
+	static const enum ast_slinear_mix_impl preferred[] = {
+		AST_SLINEAR_MIX_AVX2,
+		AST_SLINEAR_MIX_SSE2,
+		AST_SLINEAR_MIX_NEON,
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(preferred); i++) {
+		const struct ast_slinear_mix_ops *ops = ast_slinear_mix_get_ops(preferred[i]);
+
+		if (ops) {
+			active_ops = ops;
+			break;
+		}
+	}
+
+	return 0;
+}
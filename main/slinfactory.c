@@ -123,8 +123,15 @@ int ast_slinfactory_feed(struct ast_slinfactory *sf, struct ast_frame *f)
 			ast_translator_free_path(sf->trans);
 			sf->trans = NULL;
 		}
-		if (!(duped_frame = ast_frdup(f)))
+		/* A shared payload is never modified, so another reference will do */
+		if (f->mallocd & AST_MALLOCD_SHARED) {
+			duped_frame = ast_frshare(f);
+		} else {
+			duped_frame = ast_frdup(f);
+		}
+		if (!duped_frame) {
 			return 0;
+		}
 	}
 
 	AST_LIST_TRAVERSE(&sf->queue, frame_ptr, frame_list) {
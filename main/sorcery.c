@@ -215,6 +215,9 @@ struct ast_sorcery_object_field {
 	/*! \brief Callback function for translation of multiple values */
 	sorcery_fields_handler multiple_handler;
 
+	/*! \brief Configuration option type of the field */
+	enum aco_option_type type;
+
 	/*! \brief Position of the field */
 	intptr_t args[];
 };
@@ -1171,6 +1174,7 @@ int ast_sorcery_object_fields_register(struct ast_sorcery *sorcery, const char *
 
 	ast_copy_string(object_field->name, regex, sizeof(object_field->name));
 	object_field->multiple_handler = sorcery_handler;
+	object_field->type = OPT_CUSTOM_T;
 
 	if (!(object_field->name_regex = ast_calloc(1, sizeof(regex_t)))) {
 		return -1;
@@ -1212,6 +1216,7 @@ int __ast_sorcery_object_field_register(struct ast_sorcery *sorcery, const char
 	ast_copy_string(object_field->name, name, sizeof(object_field->name));
 	object_field->handler = sorcery_handler;
 	object_field->multiple_handler = multiple_handler;
+	object_field->type = opt_type;
 
 	va_start(args, argc);
 	for (pos = 0; pos < argc; pos++) {
@@ -1775,6 +1780,203 @@ void *ast_sorcery_alloc(const struct ast_sorcery *sorcery, const char *type, con
 	return details;
 }
 
+/*!
+ * \internal
+ * \brief Determine if a field's value can be copied and compared in place
+ *
+ * Fields using one of the default option types store their value directly in the
+ * object at a known position, so there is no need to convert them to a string and
+ * back. Custom fields, and fields that are not part of an objectset, are excluded.
+ */
+static int sorcery_field_is_native(const struct ast_sorcery_object_field *object_field)
+{
+	if (!object_field->handler || object_field->name_regex) {
+		return 0;
+	}
+
+	switch (object_field->type) {
+	case OPT_BOOL_T:
+	case OPT_YESNO_T:
+	case OPT_CHAR_ARRAY_T:
+	case OPT_DOUBLE_T:
+	case OPT_INT_T:
+	case OPT_SOCKADDR_T:
+	case OPT_STRINGFIELD_T:
+	case OPT_UINT_T:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*! \brief Internal function which copies a native field from one object to another */
+static int sorcery_field_native_copy(const struct ast_sorcery_object_field *object_field,
+	const void *original, void *copy)
+{
+	const void *src = original + object_field->args[0];
+	void *dst = copy + object_field->args[0];
+
+	switch (object_field->type) {
+	case OPT_BOOL_T:
+	case OPT_YESNO_T:
+	case OPT_UINT_T:
+		*(unsigned int *)dst = *(const unsigned int *)src;
+		return 0;
+	case OPT_INT_T:
+		*(int *)dst = *(const int *)src;
+		return 0;
+	case OPT_DOUBLE_T:
+		*(double *)dst = *(const double *)src;
+		return 0;
+	case OPT_SOCKADDR_T:
+		ast_sockaddr_copy(dst, src);
+		return 0;
+	case OPT_CHAR_ARRAY_T:
+		ast_copy_string(dst, src, object_field->args[1]);
+		return 0;
+	case OPT_STRINGFIELD_T:
+	{
+		struct ast_string_field_pool **pool = copy + object_field->args[1];
+		struct ast_string_field_mgr *mgr = copy + object_field->args[2];
+
+		return ast_string_field_ptr_set_by_fields(*pool, *mgr, dst, *(const char * const *)src);
+	}
+	default:
+		return -1;
+	}
+}
+
+/*! \brief Internal function which determines if a native field differs between two objects */
+static int sorcery_field_native_differs(const struct ast_sorcery_object_field *object_field,
+	const void *original, const void *modified)
+{
+	const void *a = original + object_field->args[0];
+	const void *b = modified + object_field->args[0];
+
+	switch (object_field->type) {
+	case OPT_BOOL_T:
+	case OPT_YESNO_T:
+	case OPT_UINT_T:
+		return *(const unsigned int *)a != *(const unsigned int *)b;
+	case OPT_INT_T:
+		return *(const int *)a != *(const int *)b;
+	case OPT_DOUBLE_T:
+		return *(const double *)a != *(const double *)b;
+	case OPT_SOCKADDR_T:
+		return ast_sockaddr_cmp(a, b) != 0;
+	case OPT_CHAR_ARRAY_T:
+		return strncmp(a, b, object_field->args[1]) != 0;
+	case OPT_STRINGFIELD_T:
+		return strcmp(*(const char * const *)a, *(const char * const *)b) != 0;
+	default:
+		return 1;
+	}
+}
+
+/*! \brief Internal function which retrieves a field as it would appear in an objectset */
+static struct ast_variable *get_field_as_var_list(const void *object, struct ast_sorcery_object_field *object_field)
+{
+	struct ast_variable *tmp;
+
+	if (!(tmp = get_single_field_as_var_list(object, object_field))) {
+		tmp = get_multiple_fields_as_var_list(object, object_field);
+	}
+
+	return tmp;
+}
+
+/*!
+ * \internal
+ * \brief Copy an object field by field
+ *
+ * Native fields are copied directly. Any others take the same path as an objectset,
+ * but only for that one field, and in field registration order so custom handlers
+ * see the same object state they would have when applying a full objectset.
+ */
+static int sorcery_native_copy(const struct ast_sorcery *sorcery, struct ast_sorcery_object_type *object_type,
+	const void *object, void *copy)
+{
+	const struct ast_sorcery_object_details *details = object;
+	struct ao2_iterator i;
+	struct ast_sorcery_object_field *object_field;
+	int res = 0;
+
+	i = ao2_iterator_init(object_type->fields, 0);
+
+	for (; !res && (object_field = ao2_iterator_next(&i)); ao2_ref(object_field, -1)) {
+		struct ast_variable *tmp;
+		struct ast_variable *field;
+
+		if (sorcery_field_is_native(object_field)) {
+			res = sorcery_field_native_copy(object_field, object, copy);
+			continue;
+		}
+
+		tmp = get_field_as_var_list(object, object_field);
+		for (field = tmp; !res && field; field = field->next) {
+			res = aco_process_var(&object_type->type, details->object->id, field, copy);
+		}
+		ast_variables_destroy(tmp);
+	}
+
+	ao2_iterator_destroy(&i);
+
+	if (!res && object_type->apply) {
+		res = object_type->apply(sorcery, copy);
+	}
+
+	return res;
+}
+
+/*!
+ * \internal
+ * \brief Diff two objects field by field
+ *
+ * Native fields are compared in place and only converted to a string when they differ.
+ * Any others are converted for both objects and compared as an objectset would be.
+ */
+static int sorcery_native_diff(struct ast_sorcery_object_type *object_type,
+	const void *original, const void *modified, struct ast_variable **changes)
+{
+	struct ao2_iterator i;
+	struct ast_sorcery_object_field *object_field;
+	struct ast_variable *tail = NULL;
+	int res = 0;
+
+	i = ao2_iterator_init(object_type->fields, 0);
+
+	for (; !res && (object_field = ao2_iterator_next(&i)); ao2_ref(object_field, -1)) {
+		struct ast_variable *tmp = NULL;
+
+		if (sorcery_field_is_native(object_field)) {
+			if (sorcery_field_native_differs(object_field, original, modified)) {
+				tmp = get_single_field_as_var_list(modified, object_field);
+			}
+		} else {
+			struct ast_variable *objectset1 = get_field_as_var_list(original, object_field);
+			struct ast_variable *objectset2 = get_field_as_var_list(modified, object_field);
+
+			res = ast_sorcery_changeset_create(objectset1, objectset2, &tmp);
+			ast_variables_destroy(objectset1);
+			ast_variables_destroy(objectset2);
+		}
+
+		if (tmp) {
+			tail = ast_variable_list_append_hint(changes, tail, tmp);
+		}
+	}
+
+	ao2_iterator_destroy(&i);
+
+	/* If an error occurred do not return a partial changeset */
+	if (res) {
+		ast_variables_destroy(*changes);
+		*changes = NULL;
+	}
+
+	return res;
+}
+
 void *ast_sorcery_copy(const struct ast_sorcery *sorcery, const void *object)
 {
 	const struct ast_sorcery_object_details *details = object;
@@ -1787,6 +1989,8 @@ void *ast_sorcery_copy(const struct ast_sorcery *sorcery, const void *object)
 		return NULL;
 	} else if (object_type->copy) {
 		res = object_type->copy(object, copy);
+	} else if (!object_type->transform) {
+		res = sorcery_native_copy(sorcery, object_type, object, copy);
 	} else if ((objectset = ast_sorcery_objectset_create(sorcery, object))) {
 		res = ast_sorcery_objectset_apply(sorcery, copy, objectset);
 	} else {
@@ -1815,13 +2019,7 @@ int ast_sorcery_diff(const struct ast_sorcery *sorcery, const void *original, co
 	if (original == modified) {
 		return 0;
 	} else if (!object_type->diff) {
-		RAII_VAR(struct ast_variable *, objectset1, NULL, ast_variables_destroy);
-		RAII_VAR(struct ast_variable *, objectset2, NULL, ast_variables_destroy);
-
-		objectset1 = ast_sorcery_objectset_create(sorcery, original);
-		objectset2 = ast_sorcery_objectset_create(sorcery, modified);
-
-		return ast_sorcery_changeset_create(objectset1, objectset2, changes);
+		return sorcery_native_diff(object_type, original, modified, changes);
 	} else {
 		return object_type->diff(original, modified, changes);
 	}
@@ -1894,6 +2092,126 @@ void *ast_sorcery_retrieve_by_id(const struct ast_sorcery *sorcery, const char *
 	return object;
 }
 
+/*! \brief Internal function which retrieves objects with the given ids from a single wizard */
+static void sorcery_wizard_retrieve_ids(const struct ast_sorcery *sorcery,
+	const struct ast_sorcery_object_wizard *wizard, const char *type,
+	struct ao2_container *objects, struct ao2_container *ids)
+{
+	struct ao2_iterator i;
+	const char *id;
+
+	if (wizard->wizard->callbacks.retrieve_ids) {
+		wizard->wizard->callbacks.retrieve_ids(sorcery, wizard->data, type, objects, ids);
+		return;
+	}
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref((void *) id, -1)) {
+		void *object = wizard->wizard->callbacks.retrieve_id(sorcery, wizard->data, type, id);
+
+		if (object) {
+			ao2_link(objects, object);
+			ao2_ref(object, -1);
+		}
+	}
+	ao2_iterator_destroy(&i);
+}
+
+struct ao2_container *ast_sorcery_retrieve_by_ids(const struct ast_sorcery *sorcery, const char *type, struct ao2_container *ids)
+{
+	RAII_VAR(struct ast_sorcery_object_type *, object_type, ao2_find(sorcery->types, type, OBJ_KEY), ao2_cleanup);
+	struct ao2_container *objects;
+	struct ao2_container *remaining;
+	int i;
+
+	if (!object_type) {
+		return NULL;
+	}
+
+	objects = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, 17,
+		ast_sorcery_object_id_hash, NULL, ast_sorcery_object_id_compare);
+	if (!objects) {
+		return NULL;
+	}
+
+	remaining = ao2_bump(ids);
+
+	AST_VECTOR_RW_RDLOCK(&object_type->wizards);
+	for (i = 0; i < AST_VECTOR_SIZE(&object_type->wizards) && ao2_container_count(remaining); i++) {
+		struct ast_sorcery_object_wizard *wizard =
+			AST_VECTOR_GET(&object_type->wizards, i);
+		struct ao2_container *found;
+		struct ao2_container *missing;
+		struct ao2_iterator iter;
+		void *object;
+		char *id;
+
+		if (!wizard->wizard->callbacks.retrieve_ids && !wizard->wizard->callbacks.retrieve_id) {
+			continue;
+		}
+
+		found = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, NULL, NULL);
+		if (!found) {
+			break;
+		}
+
+		sorcery_wizard_retrieve_ids(sorcery, wizard, object_type->name, found, remaining);
+		if (!ao2_container_count(found)) {
+			ao2_ref(found, -1);
+			continue;
+		}
+
+		/* The first wizard to return an object wins, exactly as when retrieving by id */
+		iter = ao2_iterator_init(found, 0);
+		for (; (object = ao2_iterator_next(&iter)); ao2_ref(object, -1)) {
+			char *requested = ao2_find(remaining, ast_sorcery_object_get_id(object), OBJ_SEARCH_KEY);
+
+			if (!requested) {
+				continue;
+			}
+			ao2_ref(requested, -1);
+
+			if (!wizard->caching) {
+				struct sorcery_details sdetails = {
+					.sorcery = sorcery,
+					.obj = object,
+				};
+
+				AST_VECTOR_CALLBACK(&object_type->wizards, sorcery_cache_create, NULL, &sdetails, 0);
+			}
+
+			ao2_link(objects, object);
+		}
+		ao2_iterator_destroy(&iter);
+		ao2_ref(found, -1);
+
+		/* Only the ids that have not been found yet are passed on to the next wizard */
+		missing = ast_str_container_alloc_options(AO2_ALLOC_OPT_LOCK_NOLOCK, 17);
+		if (!missing) {
+			break;
+		}
+
+		iter = ao2_iterator_init(remaining, 0);
+		for (; (id = ao2_iterator_next(&iter)); ao2_ref(id, -1)) {
+			void *existing = ao2_find(objects, id, OBJ_SEARCH_KEY);
+
+			if (!existing) {
+				ao2_link(missing, id);
+			}
+			ao2_cleanup(existing);
+		}
+		ao2_iterator_destroy(&iter);
+
+		ao2_ref(remaining, -1);
+		remaining = missing;
+	}
+	AST_VECTOR_RW_UNLOCK(&object_type->wizards);
+
+	ao2_ref(remaining, -1);
+
+	return objects;
+}
+
 void *ast_sorcery_retrieve_by_fields(const struct ast_sorcery *sorcery, const char *type, unsigned int flags, struct ast_variable *fields)
 {
 	RAII_VAR(struct ast_sorcery_object_type *, object_type, ao2_find(sorcery->types, type, OBJ_KEY), ao2_cleanup);
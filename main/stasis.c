@@ -30,6 +30,7 @@
 #include "asterisk.h"
 
 #include "asterisk/astobj2.h"
+#include "asterisk/histogram.h"
 #include "asterisk/stasis_internal.h"
 #include "asterisk/stasis.h"
 #include "asterisk/taskprocessor.h"
@@ -75,6 +76,15 @@
 				<configOption name="max_size" default="50">
 					<synopsis>Maximum number of threads in the threadpool.</synopsis>
 				</configOption>
+				<configOption name="work_stealing" default="no">
+					<synopsis>Give each thread its own task queue and let idle threads steal work.</synopsis>
+					<description>
+						<para>By default every thread in the threadpool takes tasks from a
+						single shared queue.  When enabled, each thread has its own queue and
+						threads that run out of tasks take them from other threads, which
+						reduces contention on systems with many CPU cores.</para>
+					</description>
+				</configOption>
 			</configObject>
 			<configObject name="declined_message_types">
 				<synopsis>Stasis message types for which to decline creation.</synopsis>
@@ -359,6 +369,12 @@ struct stasis_topic_statistics {
 	int messages_not_dispatched;
 	/*! \brief The number of messages that were dispatched to at least 1 subscriber */
 	int messages_dispatched;
+	/*! \brief The number of batches delivered to subscribers of this topic */
+	int batches_dispatched;
+	/*! \brief The number of messages delivered to subscribers of this topic in batches */
+	int messages_batched;
+	/*! \brief The largest batch delivered to a subscriber of this topic */
+	int highest_batch_size;
 	/*! \brief The ids of the subscribers to this topic */
 	struct ao2_container *subscribers;
 	/*! \brief Pointer to the topic (NOT refcounted, and must NOT be accessed) */
@@ -677,6 +693,17 @@ struct stasis_subscription_statistics {
 };
 #endif
 
+/*!
+ * \internal
+ * \brief Messages delivered to a subscription by a single mailbox task
+ */
+struct stasis_message_batch {
+	/*! The number of messages in the batch */
+	unsigned int count;
+	/*! The messages, each holding a reference */
+	struct stasis_message *messages[0];
+};
+
 /*! \internal */
 struct stasis_subscription {
 	/*! Unique ID for this subscription */
@@ -706,6 +733,16 @@ struct stasis_subscription {
 	/*! The message filter currently in use */
 	enum stasis_subscription_message_filter filter;
 
+	/*! Maximum number of messages delivered per mailbox task, batching is off below 2 */
+	unsigned int batch_size;
+	/*! Batch queued in the mailbox that still accepts messages.
+	 *  Be sure sub is locked before reading/setting. */
+	struct stasis_message_batch *batch;
+
+	/*! Time from the creation of a message to its dispatch, shared by
+	 *  every subscription made from the same function */
+	struct ast_histogram *dispatch_delay;
+
 #ifdef AST_DEVMODE
 	/*! Statistics information */
 	struct stasis_subscription_statistics *statistics;
@@ -734,6 +771,7 @@ static void subscription_dtor(void *obj)
 	ast_cond_destroy(&sub->join_cond);
 
 	AST_VECTOR_FREE(&sub->accepted_message_types);
+	ao2_cleanup(sub->dispatch_delay);
 
 #ifdef AST_DEVMODE
 	if (sub->statistics) {
@@ -765,6 +803,8 @@ static void subscription_invoke(struct stasis_subscription *sub,
 	start = ast_tvnow();
 #endif
 
+	ast_histogram_record_since(sub->dispatch_delay, *stasis_message_timestamp(message));
+
 	/* Notify that the final message has been received */
 	if (final) {
 		ao2_lock(sub);
@@ -909,7 +949,7 @@ struct stasis_subscription *internal_stasis_subscribe(
 		if (use_thread_pool) {
 			sub->mailbox = ast_threadpool_serializer(tps_name, threadpool);
 		} else {
-			sub->mailbox = ast_taskprocessor_get(tps_name, TPS_REF_DEFAULT);
+			sub->mailbox = ast_taskprocessor_get(tps_name, TPS_QUEUE_LOCKFREE);
 		}
 		if (!sub->mailbox) {
 			ao2_ref(sub, -1);
@@ -929,6 +969,9 @@ struct stasis_subscription *internal_stasis_subscribe(
 	sub->filter = STASIS_SUBSCRIPTION_FILTER_NONE;
 	AST_VECTOR_INIT(&sub->accepted_message_types, 0);
 	sub->accepted_formatters = STASIS_SUBSCRIPTION_FORMATTER_NONE;
+	sub->dispatch_delay = ast_histogram_get("stasis_dispatch_delay",
+		"Time from the creation of a stasis message to its dispatch to a subscription.",
+		"subscriber", func);
 
 	if (topic_add_subscription(topic, sub) != 0) {
 		ao2_ref(sub, -1);
@@ -1022,6 +1065,21 @@ int stasis_subscription_set_congestion_limits(struct stasis_subscription *subscr
 	return res;
 }
 
+int stasis_subscription_set_batch_size(struct stasis_subscription *subscription,
+	unsigned int batch_size)
+{
+	if (!subscription || !subscription->mailbox) {
+		return -1;
+	}
+
+	ao2_lock(subscription);
+	subscription->batch_size = batch_size;
+	subscription->batch = NULL;
+	ao2_unlock(subscription);
+
+	return 0;
+}
+
 int stasis_subscription_accept_message_type(struct stasis_subscription *subscription,
 	const struct stasis_message_type *type)
 {
@@ -1269,6 +1327,111 @@ static int dispatch_exec_async(struct ast_taskprocessor_local *local)
 	return 0;
 }
 
+/*!
+ * \internal \brief Dispatch a batch of messages to a subscriber asynchronously
+ * \param local \ref ast_taskprocessor_local object
+ * \return 0
+ */
+static int dispatch_exec_batch(struct ast_taskprocessor_local *local)
+{
+	struct stasis_subscription *sub = local->local_data;
+	struct stasis_message_batch *batch = local->data;
+	unsigned int i;
+
+	/* Close the batch, anything published from now on goes into a new one */
+	ao2_lock(sub);
+	if (sub->batch == batch) {
+		sub->batch = NULL;
+	}
+	ao2_unlock(sub);
+
+#ifdef AST_DEVMODE
+	ast_atomic_fetchadd_int(&sub->topic->statistics->batches_dispatched, +1);
+	ast_atomic_fetchadd_int(&sub->topic->statistics->messages_batched, batch->count);
+	if (batch->count > sub->topic->statistics->highest_batch_size) {
+		sub->topic->statistics->highest_batch_size = batch->count;
+	}
+#endif
+
+	for (i = 0; i < batch->count; ++i) {
+		subscription_invoke(sub, batch->messages[i]);
+		ao2_cleanup(batch->messages[i]);
+	}
+	ast_free(batch);
+
+	return 0;
+}
+
+/*!
+ * \internal \brief Take a reference to a message being dispatched
+ *
+ * \param message The message
+ * \param reserved Number of references the publisher already took on the
+ * subscribers' behalf, or NULL if none.
+ *
+ * A message fanned out to many subscribers would otherwise have its
+ * reference count bumped once per subscriber by the publishing thread.
+ * The publisher instead takes them in one go and hands them out here.
+ */
+static struct stasis_message *dispatch_message_ref(struct stasis_message *message,
+	unsigned int *reserved)
+{
+	if (reserved && *reserved) {
+		--*reserved;
+		return message;
+	}
+
+	return ao2_bump(message);
+}
+
+/*!
+ * \internal \brief Add a message to the open batch of a subscriber
+ *
+ * A new batch is queued to the mailbox when there is no open batch or it
+ * is full.
+ *
+ * \retval 0 if message was not dispatched
+ * \retval 1 if message was dispatched
+ */
+static unsigned int dispatch_batched(struct stasis_subscription *sub,
+	struct stasis_message *message, unsigned int *reserved)
+{
+	struct stasis_message_batch *batch;
+	unsigned int batch_size;
+
+	ao2_lock(sub);
+	batch_size = MAX(sub->batch_size, 1);
+	batch = sub->batch;
+	if (batch && batch->count < batch_size) {
+		batch->messages[batch->count++] = dispatch_message_ref(message, reserved);
+		ao2_unlock(sub);
+		return 1;
+	}
+
+	sub->batch = NULL;
+	batch = ast_malloc(sizeof(*batch) + batch_size * sizeof(batch->messages[0]));
+	if (!batch) {
+		ao2_unlock(sub);
+		return 0;
+	}
+	batch->count = 1;
+	batch->messages[0] = dispatch_message_ref(message, reserved);
+
+	/* The subscription stays locked so the batch can not be run before it is recorded */
+	if (ast_taskprocessor_push_local(sub->mailbox, dispatch_exec_batch, batch)) {
+		ao2_unlock(sub);
+		/* Push failed; ugh. */
+		ast_log(LOG_ERROR, "Dropping batched dispatch\n");
+		ao2_cleanup(message);
+		ast_free(batch);
+		return 0;
+	}
+	sub->batch = batch;
+	ao2_unlock(sub);
+
+	return 1;
+}
+
 /*!
  * \internal \brief Data passed to \ref dispatch_exec_sync to synchronize
  * a published message to a subscriber
@@ -1308,12 +1471,14 @@ static int dispatch_exec_sync(struct ast_taskprocessor_local *local)
  * \param message The message to send
  * \param synchronous If non-zero, synchronize on the subscriber receiving
  * the message
+ * \param reserved Message references reserved by the publisher, or NULL
  * \retval 0 if message was not dispatched
  * \retval 1 if message was dispatched
  */
 static unsigned int dispatch_message(struct stasis_subscription *sub,
 	struct stasis_message *message,
-	int synchronous)
+	int synchronous,
+	unsigned int *reserved)
 {
 	int is_final = stasis_subscription_final_message(sub, message);
 
@@ -1381,10 +1546,14 @@ static unsigned int dispatch_message(struct stasis_subscription *sub,
 		return 1;
 	}
 
+	if (!synchronous && sub->batch_size > 1) {
+		return dispatch_batched(sub, message, reserved);
+	}
+
 	/* Bump the message for the taskprocessor push. This will get de-ref'd
 	 * by the task processor callback.
 	 */
-	ao2_bump(message);
+	dispatch_message_ref(message, reserved);
 	if (!synchronous) {
 		if (ast_taskprocessor_push_local(sub->mailbox, dispatch_exec_async, message)) {
 			/* Push failed; ugh. */
@@ -1395,6 +1564,13 @@ static unsigned int dispatch_message(struct stasis_subscription *sub,
 	} else {
 		struct sync_task_data std;
 
+		if (sub->batch_size > 1) {
+			/* Messages published after this one must not join an earlier batch */
+			ao2_lock(sub);
+			sub->batch = NULL;
+			ao2_unlock(sub);
+		}
+
 		ast_mutex_init(&std.lock);
 		ast_cond_init(&std.cond, NULL);
 		std.complete = 0;
@@ -1434,6 +1610,7 @@ static void publish_msg(struct stasis_topic *topic,
 {
 	size_t i;
 	unsigned int dispatched = 0;
+	unsigned int reserved;
 #ifdef AST_DEVMODE
 	int message_type_id = stasis_message_type_id(stasis_message_type(message));
 	struct stasis_message_type_statistics *statistics;
@@ -1480,15 +1657,30 @@ static void publish_msg(struct stasis_topic *topic,
 	start = ast_tvnow();
 #endif
 	ao2_lock(topic);
+	/*
+	 * Take a reference for every subscriber at once rather than bouncing
+	 * the message's reference count once per subscriber.  Any left over
+	 * by filtered or directly dispatched subscribers are given back below.
+	 */
+	reserved = AST_VECTOR_SIZE(&topic->subscribers);
+	if (reserved > 1) {
+		ao2_ref(message, +reserved);
+	} else {
+		reserved = 0;
+	}
 	for (i = 0; i < AST_VECTOR_SIZE(&topic->subscribers); ++i) {
 		struct stasis_subscription *sub = AST_VECTOR_GET(&topic->subscribers, i);
 
 		ast_assert(sub != NULL);
 
-		dispatched += dispatch_message(sub, message, (sub == sync_sub));
+		dispatched += dispatch_message(sub, message, (sub == sync_sub), &reserved);
 	}
 	ao2_unlock(topic);
 
+	if (reserved) {
+		ao2_ref(message, -(int) reserved);
+	}
+
 #ifdef AST_DEVMODE
 	elapsed = ast_tvdiff_ms(ast_tvnow(), start);
 	if (elapsed > topic->statistics->highest_time_dispatched) {
@@ -1700,7 +1892,7 @@ static void send_subscription_unsubscribe(struct stasis_topic *topic,
 	stasis_publish(topic, msg);
 
 	/* Now we have to dispatch to the subscription itself */
-	dispatch_message(sub, msg, 0);
+	dispatch_message(sub, msg, 0, NULL);
 
 	ao2_cleanup(msg);
 	ao2_cleanup(change);
@@ -1979,7 +2171,8 @@ struct ast_multi_object_blob *ast_multi_object_blob_create(struct ast_json *blob
 
 	ast_assert(blob != NULL);
 
-	multi = ao2_alloc(sizeof(*multi), multi_object_blob_dtor);
+	multi = ao2_alloc_options(sizeof(*multi), multi_object_blob_dtor,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!multi) {
 		return NULL;
 	}
@@ -2190,6 +2383,8 @@ struct stasis_threadpool_conf {
 	int idle_timeout_sec;
 	/*! Maximum number of thread to allow */
 	int max_size;
+	/*! Use per thread task queues with work stealing */
+	int work_stealing;
 };
 
 struct stasis_config {
@@ -2843,6 +3038,10 @@ static char *statistics_show_topic(struct ast_cli_entry *e, int cmd, struct ast_
 	ast_cli(a->fd, "Number of messages that went to at least one subscriber: %d\n", statistics->messages_dispatched);
 	ast_cli(a->fd, "Lowest amount of time (in milliseconds) spent dispatching message: %ld\n", statistics->lowest_time_dispatched);
 	ast_cli(a->fd, "Highest amount of time (in milliseconds) spent dispatching messages: %ld\n", statistics->highest_time_dispatched);
+	ast_cli(a->fd, "Number of batches delivered to subscribers: %d\n", statistics->batches_dispatched);
+	ast_cli(a->fd, "Average number of messages per batch: %d\n",
+		statistics->batches_dispatched ? statistics->messages_batched / statistics->batches_dispatched : 0);
+	ast_cli(a->fd, "Largest batch delivered to a subscriber: %d\n", statistics->highest_batch_size);
 	ast_cli(a->fd, "Number of subscribers: %d\n", ao2_container_count(statistics->subscribers));
 
 	ast_cli(a->fd, "Subscribers:\n");
@@ -3089,6 +3288,9 @@ int stasis_init(void)
 		threadpool_options, "50", OPT_INT_T, PARSE_IN_RANGE,
 		FLDSET(struct stasis_threadpool_conf, max_size), 0,
 		INT_MAX);
+	aco_option_register(&cfg_info, "work_stealing", ACO_EXACT,
+		threadpool_options, "no", OPT_BOOL_T, 1,
+		FLDSET(struct stasis_threadpool_conf, work_stealing));
 
 	if (aco_process_config(&cfg_info, 0) == ACO_PROCESS_ERROR) {
 		struct stasis_config *default_cfg = stasis_config_alloc();
@@ -3128,6 +3330,7 @@ int stasis_init(void)
 	threadpool_opts.auto_increment = 1;
 	threadpool_opts.max_size = cfg->threadpool_options->max_size;
 	threadpool_opts.idle_timeout = cfg->threadpool_options->idle_timeout_sec;
+	threadpool_opts.work_stealing = cfg->threadpool_options->work_stealing;
 	threadpool = ast_threadpool_create("stasis", NULL, &threadpool_opts);
 	ao2_ref(cfg, -1);
 	if (!threadpool) {
@@ -37,14 +37,19 @@
 #include "asterisk/vector.h"
 
 #ifdef LOW_MEMORY
+#define NUM_CACHE_SHARDS 1
 #define NUM_CACHE_BUCKETS 17
 #else
-#define NUM_CACHE_BUCKETS 563
+/*! Number of separately locked containers the entries of a cache are spread over */
+#define NUM_CACHE_SHARDS 16
+/*! Number of buckets of each shard */
+#define NUM_CACHE_BUCKETS 37
 #endif
 
 /*! \internal */
 struct stasis_cache {
-	struct ao2_container *entries;
+	/*! The entries, by the hash of their key modulo NUM_CACHE_SHARDS */
+	struct ao2_container *entries[NUM_CACHE_SHARDS];
 	snapshot_get_id id_fn;
 	cache_aggregate_calc_fn aggregate_calc_fn;
 	cache_aggregate_publish_fn aggregate_publish_fn;
@@ -59,9 +64,26 @@ struct stasis_caching_topic {
 	struct stasis_subscription *sub;
 };
 
+/*!
+ * \internal
+ * \brief Name the shard of a cache registered for a caching topic.
+ */
+static void cache_shard_name(char *buf, size_t len, const char *topic_name, int shard)
+{
+	if (NUM_CACHE_SHARDS > 1) {
+		snprintf(buf, len, "%s/%d", topic_name, shard);
+	} else {
+		ast_copy_string(buf, topic_name, len);
+	}
+}
+
 static void stasis_caching_topic_dtor(void *obj)
 {
 	struct stasis_caching_topic *caching_topic = obj;
+	const char *topic_name = S_OR(stasis_topic_name(caching_topic->topic), "");
+	size_t shard_name_len = strlen(topic_name) + 16;
+	char *shard_name = ast_alloca(shard_name_len);
+	int i;
 
 	/* Caching topics contain subscriptions, and must be manually
 	 * unsubscribed. */
@@ -70,7 +92,10 @@ static void stasis_caching_topic_dtor(void *obj)
 	 * be bad. */
 	ast_assert(stasis_subscription_is_done(caching_topic->sub));
 
-	ao2_container_unregister(stasis_topic_name(caching_topic->topic));
+	for (i = 0; i < NUM_CACHE_SHARDS; ++i) {
+		cache_shard_name(shard_name, shard_name_len, topic_name, i);
+		ao2_container_unregister(shard_name);
+	}
 
 	ao2_cleanup(caching_topic->sub);
 	caching_topic->sub = NULL;
@@ -209,6 +234,25 @@ static void cache_entry_compute_hash(struct cache_entry_key *key)
 	key->hash += ast_hashtab_hash_string(key->id);
 }
 
+static void cache_entry_key_init(struct cache_entry_key *key, struct stasis_message_type *type, const char *id)
+{
+	key->type = type;
+	key->id = id;
+	cache_entry_compute_hash(key);
+}
+
+/*!
+ * \internal
+ * \brief Get the shard of the entries container holding an entry.
+ *
+ * Readers and writers of entries in different shards do not contend for
+ * a lock.
+ */
+static struct ao2_container *cache_shard(struct stasis_cache *cache, const struct cache_entry_key *key)
+{
+	return cache->entries[key->hash % NUM_CACHE_SHARDS];
+}
+
 static struct stasis_cache_entry *cache_entry_create(struct stasis_message_type *type, const char *id, struct stasis_message *snapshot)
 {
 	struct stasis_cache_entry *entry;
@@ -326,9 +370,12 @@ static int cache_entry_cmp(void *obj, void *arg, int flags)
 static void cache_dtor(void *obj)
 {
 	struct stasis_cache *cache = obj;
+	int i;
 
-	ao2_cleanup(cache->entries);
-	cache->entries = NULL;
+	for (i = 0; i < NUM_CACHE_SHARDS; ++i) {
+		ao2_cleanup(cache->entries[i]);
+		cache->entries[i] = NULL;
+	}
 }
 
 struct stasis_cache *stasis_cache_create_full(snapshot_get_id id_fn,
@@ -336,6 +383,7 @@ struct stasis_cache *stasis_cache_create_full(snapshot_get_id id_fn,
 	cache_aggregate_publish_fn aggregate_publish_fn)
 {
 	struct stasis_cache *cache;
+	int i;
 
 	cache = ao2_alloc_options(sizeof(*cache), cache_dtor,
 		AO2_ALLOC_OPT_LOCK_NOLOCK);
@@ -343,11 +391,13 @@ struct stasis_cache *stasis_cache_create_full(snapshot_get_id id_fn,
 		return NULL;
 	}
 
-	cache->entries = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
-		NUM_CACHE_BUCKETS, cache_entry_hash, NULL, cache_entry_cmp);
-	if (!cache->entries) {
-		ao2_cleanup(cache);
-		return NULL;
+	for (i = 0; i < NUM_CACHE_SHARDS; ++i) {
+		cache->entries[i] = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+			NUM_CACHE_BUCKETS, cache_entry_hash, NULL, cache_entry_cmp);
+		if (!cache->entries[i]) {
+			ao2_cleanup(cache);
+			return NULL;
+		}
 	}
 
 	cache->id_fn = id_fn;
@@ -384,29 +434,24 @@ struct stasis_message *stasis_cache_entry_get_remote(struct stasis_cache_entry *
  * \internal
  * \brief Find the cache entry in the cache entries container.
  *
- * \param entries Container of cached entries.
- * \param type Type of message to retrieve the cache entry.
- * \param id Identity of the snapshot to retrieve the cache entry.
+ * \param entries The shard of the cached entries for the key.
+ * \param search_key Type and identity of the snapshot to retrieve the cache entry.
  *
  * \note The entries container is already locked.
  *
  * \retval Cache-entry on success.
  * \retval NULL Not in cache.
  */
-static struct stasis_cache_entry *cache_find(struct ao2_container *entries, struct stasis_message_type *type, const char *id)
+static struct stasis_cache_entry *cache_find(struct ao2_container *entries, const struct cache_entry_key *search_key)
 {
-	struct cache_entry_key search_key;
 	struct stasis_cache_entry *entry;
 
-	search_key.type = type;
-	search_key.id = id;
-	cache_entry_compute_hash(&search_key);
-	entry = ao2_find(entries, &search_key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	entry = ao2_find(entries, search_key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
 
 	/* Ensure that what we looked for is what we found. */
 	ast_assert(!entry
 		|| (!strcmp(stasis_message_type_name(entry->key.type),
-			stasis_message_type_name(type)) && !strcmp(entry->key.id, id)));
+			stasis_message_type_name(search_key->type)) && !strcmp(entry->key.id, search_key->id)));
 	return entry;
 }
 
@@ -508,23 +553,28 @@ static struct cache_put_snapshots cache_put(struct stasis_cache *cache,
 {
 	struct stasis_cache_entry *cached_entry;
 	struct cache_put_snapshots snapshots;
+	struct cache_entry_key key;
+	struct ao2_container *entries;
 
-	ast_assert(cache->entries != NULL);
 	ast_assert(eid != NULL);/* Aggregate snapshots not allowed to be put directly. */
 	ast_assert(new_snapshot == NULL ||
 		type == stasis_message_type(new_snapshot));
 
 	memset(&snapshots, 0, sizeof(snapshots));
 
-	ao2_wrlock(cache->entries);
+	cache_entry_key_init(&key, type, id);
+	entries = cache_shard(cache, &key);
+	ast_assert(entries != NULL);
+
+	ao2_wrlock(entries);
 
-	cached_entry = cache_find(cache->entries, type, id);
+	cached_entry = cache_find(entries, &key);
 
 	/* Update the eid snapshot. */
 	if (!new_snapshot) {
 		/* Remove snapshot from cache */
 		if (cached_entry) {
-			snapshots.old = cache_remove(cache->entries, cached_entry, eid);
+			snapshots.old = cache_remove(entries, cached_entry, eid);
 		}
 	} else if (cached_entry) {
 		/* Update snapshot in cache */
@@ -533,7 +583,7 @@ static struct cache_put_snapshots cache_put(struct stasis_cache *cache,
 		/* Insert into the cache */
 		cached_entry = cache_entry_create(type, id, new_snapshot);
 		if (cached_entry) {
-			ao2_link_flags(cache->entries, cached_entry, OBJ_NOLOCK);
+			ao2_link_flags(entries, cached_entry, OBJ_NOLOCK);
 		}
 	}
 
@@ -544,7 +594,7 @@ static struct cache_put_snapshots cache_put(struct stasis_cache *cache,
 		cached_entry->aggregate = ao2_bump(snapshots.aggregate_new);
 	}
 
-	ao2_unlock(cache->entries);
+	ao2_unlock(entries);
 
 	ao2_cleanup(cached_entry);
 	return snapshots;
@@ -588,9 +638,10 @@ struct ao2_container *stasis_cache_get_all(struct stasis_cache *cache, struct st
 {
 	struct stasis_cache_entry *cached_entry;
 	struct ao2_container *found;
+	struct cache_entry_key key;
+	struct ao2_container *entries;
 
 	ast_assert(cache != NULL);
-	ast_assert(cache->entries != NULL);
 	ast_assert(id != NULL);
 
 	if (!type) {
@@ -602,15 +653,19 @@ struct ao2_container *stasis_cache_get_all(struct stasis_cache *cache, struct st
 		return NULL;
 	}
 
-	ao2_rdlock(cache->entries);
+	cache_entry_key_init(&key, type, id);
+	entries = cache_shard(cache, &key);
+	ast_assert(entries != NULL);
 
-	cached_entry = cache_find(cache->entries, type, id);
+	ao2_rdlock(entries);
+
+	cached_entry = cache_find(entries, &key);
 	if (cached_entry && cache_entry_dump(found, cached_entry)) {
 		ao2_cleanup(found);
 		found = NULL;
 	}
 
-	ao2_unlock(cache->entries);
+	ao2_unlock(entries);
 
 	ao2_cleanup(cached_entry);
 	return found;
@@ -660,24 +715,29 @@ struct stasis_message *stasis_cache_get_by_eid(struct stasis_cache *cache, struc
 {
 	struct stasis_cache_entry *cached_entry;
 	struct stasis_message *snapshot = NULL;
+	struct cache_entry_key key;
+	struct ao2_container *entries;
 
 	ast_assert(cache != NULL);
-	ast_assert(cache->entries != NULL);
 	ast_assert(id != NULL);
 
 	if (!type) {
 		return NULL;
 	}
 
-	ao2_rdlock(cache->entries);
+	cache_entry_key_init(&key, type, id);
+	entries = cache_shard(cache, &key);
+	ast_assert(entries != NULL);
 
-	cached_entry = cache_find(cache->entries, type, id);
+	ao2_rdlock(entries);
+
+	cached_entry = cache_find(entries, &key);
 	if (cached_entry) {
 		snapshot = cache_entry_by_eid(cached_entry, eid);
 		ao2_bump(snapshot);
 	}
 
-	ao2_unlock(cache->entries);
+	ao2_unlock(entries);
 
 	ao2_cleanup(cached_entry);
 	return snapshot;
@@ -718,9 +778,9 @@ static int cache_dump_by_eid_cb(void *obj, void *arg, int flags)
 struct ao2_container *stasis_cache_dump_by_eid(struct stasis_cache *cache, struct stasis_message_type *type, const struct ast_eid *eid)
 {
 	struct cache_dump_data cache_dump;
+	int i;
 
 	ast_assert(cache != NULL);
-	ast_assert(cache->entries != NULL);
 
 	cache_dump.eid = eid;
 	cache_dump.type = type;
@@ -729,7 +789,10 @@ struct ao2_container *stasis_cache_dump_by_eid(struct stasis_cache *cache, struc
 		return NULL;
 	}
 
-	ao2_callback(cache->entries, OBJ_MULTIPLE | OBJ_NODATA, cache_dump_by_eid_cb, &cache_dump);
+	/* One shard locked at a time */
+	for (i = 0; cache_dump.container && i < NUM_CACHE_SHARDS; ++i) {
+		ao2_callback(cache->entries[i], OBJ_MULTIPLE | OBJ_NODATA, cache_dump_by_eid_cb, &cache_dump);
+	}
 	return cache_dump.container;
 }
 
@@ -757,9 +820,9 @@ static int cache_dump_all_cb(void *obj, void *arg, int flags)
 struct ao2_container *stasis_cache_dump_all(struct stasis_cache *cache, struct stasis_message_type *type)
 {
 	struct cache_dump_data cache_dump;
+	int i;
 
 	ast_assert(cache != NULL);
-	ast_assert(cache->entries != NULL);
 
 	cache_dump.eid = NULL;
 	cache_dump.type = type;
@@ -768,7 +831,10 @@ struct ao2_container *stasis_cache_dump_all(struct stasis_cache *cache, struct s
 		return NULL;
 	}
 
-	ao2_callback(cache->entries, OBJ_MULTIPLE | OBJ_NODATA, cache_dump_all_cb, &cache_dump);
+	/* One shard locked at a time */
+	for (i = 0; cache_dump.container && i < NUM_CACHE_SHARDS; ++i) {
+		ao2_callback(cache->entries[i], OBJ_MULTIPLE | OBJ_NODATA, cache_dump_all_cb, &cache_dump);
+	}
 	return cache_dump.container;
 }
 
@@ -864,14 +930,19 @@ static void caching_topic_exec(void *data, struct stasis_subscription *sub,
 		 */
 		if (strcmp(change->description, "Unsubscribe") == 0) {
 			struct stasis_cache_entry *cached_sub;
+			struct cache_entry_key key;
+			struct ao2_container *entries;
+
+			cache_entry_key_init(&key, stasis_subscription_change_type(), change->uniqueid);
+			entries = cache_shard(caching_topic->cache, &key);
 
-			ao2_wrlock(caching_topic->cache->entries);
-			cached_sub = cache_find(caching_topic->cache->entries, stasis_subscription_change_type(), change->uniqueid);
+			ao2_wrlock(entries);
+			cached_sub = cache_find(entries, &key);
 			if (cached_sub) {
-				ao2_cleanup(cache_remove(caching_topic->cache->entries, cached_sub, stasis_message_eid(message)));
+				ao2_cleanup(cache_remove(entries, cached_sub, stasis_message_eid(message)));
 				ao2_cleanup(cached_sub);
 			}
-			ao2_unlock(caching_topic->cache->entries);
+			ao2_unlock(entries);
 			ao2_cleanup(caching_topic_needs_unref);
 			return;
 		}
@@ -976,11 +1047,18 @@ struct stasis_caching_topic *stasis_caching_topic_create(struct stasis_topic *or
 	ao2_ref(cache, +1);
 	caching_topic->cache = cache;
 	if (!cache->registered) {
-		if (ao2_container_register(new_name, cache->entries, print_cache_entry)) {
-			ast_log(LOG_ERROR, "Stasis cache container '%p' for '%s' did not register\n",
-				cache->entries, new_name);
-		} else {
-			cache->registered = 1;
+		size_t shard_name_len = strlen(new_name) + 16;
+		char *shard_name = ast_alloca(shard_name_len);
+		int i;
+
+		cache->registered = 1;
+		for (i = 0; i < NUM_CACHE_SHARDS; ++i) {
+			cache_shard_name(shard_name, shard_name_len, new_name, i);
+			if (ao2_container_register(shard_name, cache->entries[i], print_cache_entry)) {
+				ast_log(LOG_ERROR, "Stasis cache container '%p' for '%s' did not register\n",
+					cache->entries[i], shard_name);
+				cache->registered = 0;
+			}
 		}
 	}
 	ast_free(new_name);
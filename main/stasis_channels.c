@@ -37,6 +37,7 @@
 #include "asterisk/translate.h"
 #include "asterisk/stasis.h"
 #include "asterisk/stasis_channels.h"
+#include "asterisk/stasis_internal.h"
 #include "asterisk/dial.h"
 #include "asterisk/linkedlists.h"
 
@@ -254,6 +255,8 @@ static void channel_snapshot_dtor(void *obj)
 	ao2_cleanup(snapshot->hangup);
 	ao2_cleanup(snapshot->manager_vars);
 	ao2_cleanup(snapshot->ari_vars);
+	ast_json_unref(snapshot->json);
+	ast_free(snapshot->manager_state);
 }
 
 static void channel_snapshot_base_dtor(void *obj)
@@ -749,7 +752,7 @@ static struct stasis_message *create_channel_blob_message(struct ast_channel_sna
 	struct stasis_message *msg;
 	struct ast_channel_blob *obj;
 
-	obj = ao2_alloc(sizeof(*obj), channel_blob_dtor);
+	obj = ao2_alloc_options(sizeof(*obj), channel_blob_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!obj) {
 		return NULL;
 	}
@@ -884,7 +887,7 @@ struct ast_multi_channel_blob *ast_multi_channel_blob_create(struct ast_json *bl
 
 	ast_assert(blob != NULL);
 
-	obj = ao2_alloc(sizeof(*obj), multi_channel_blob_dtor);
+	obj = ao2_alloc_options(sizeof(*obj), multi_channel_blob_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!obj) {
 		return NULL;
 	}
@@ -1265,6 +1268,12 @@ struct ast_json *ast_channel_snapshot_to_json(
 		return NULL;
 	}
 
+	/* Snapshots are immutable, every event about this one shares its rendering */
+	json_chan = stasis_cached_rendering_get((void **) &snapshot->json);
+	if (json_chan) {
+		return ast_json_ref(json_chan);
+	}
+
 	json_chan = ast_json_pack(
 		/* Broken up into groups of three for readability */
 		"{ s: s, s: s, s: s,"
@@ -1291,9 +1300,101 @@ struct ast_json *ast_channel_snapshot_to_json(
 		ast_json_object_set(json_chan, "channelvars", ast_json_channel_vars(snapshot->ari_vars));
 	}
 
+	if (json_chan && !stasis_cached_rendering_set((void **) &snapshot->json, json_chan)) {
+		ast_json_ref(json_chan);
+	}
+
 	return json_chan;
 }
 
+/*!
+ * \internal
+ * \brief Write a name and number pair, as ast_json_name_number() builds it
+ */
+static void writer_name_number(struct ast_json_writer *writer, const char *name, const char *number)
+{
+	ast_json_writer_object_start(writer);
+	ast_json_writer_key(writer, "name");
+	ast_json_writer_string(writer, AST_JSON_UTF8_VALIDATE(name));
+	ast_json_writer_key(writer, "number");
+	ast_json_writer_string(writer, AST_JSON_UTF8_VALIDATE(number));
+	ast_json_writer_object_end(writer);
+}
+
+int ast_channel_snapshot_to_json_writer(
+	const struct ast_channel_snapshot *snapshot,
+	const struct stasis_message_sanitizer *sanitize,
+	struct ast_json_writer *writer)
+{
+	struct ast_json *json_chan;
+	struct ast_var_t *var;
+
+	if (snapshot == NULL) {
+		return -1;
+	}
+
+	if (sanitize
+		&& sanitize->channel_snapshot
+		&& sanitize->channel_snapshot(snapshot)) {
+		return 0;
+	}
+
+	/* Reuse the rendering of an earlier event rather than writing it again */
+	json_chan = stasis_cached_rendering_get((void **) &snapshot->json);
+	if (json_chan) {
+		return ast_json_writer_json(writer, json_chan);
+	}
+
+	ast_json_writer_object_start(writer);
+	ast_json_writer_key(writer, "id");
+	ast_json_writer_string(writer, snapshot->base->uniqueid);
+	ast_json_writer_key(writer, "name");
+	ast_json_writer_string(writer, snapshot->base->name);
+	ast_json_writer_key(writer, "state");
+	ast_json_writer_string(writer, ast_state2str(snapshot->state));
+	ast_json_writer_key(writer, "caller");
+	writer_name_number(writer, snapshot->caller->name, snapshot->caller->number);
+	ast_json_writer_key(writer, "connected");
+	writer_name_number(writer, snapshot->connected->name, snapshot->connected->number);
+	ast_json_writer_key(writer, "accountcode");
+	ast_json_writer_string(writer, snapshot->base->accountcode);
+
+	ast_json_writer_key(writer, "dialplan");
+	ast_json_writer_object_start(writer);
+	ast_json_writer_key(writer, "context");
+	ast_json_writer_string(writer, snapshot->dialplan->context);
+	ast_json_writer_key(writer, "exten");
+	ast_json_writer_string(writer, snapshot->dialplan->exten);
+	ast_json_writer_key(writer, "priority");
+	if (snapshot->dialplan->priority != -1) {
+		ast_json_writer_integer(writer, snapshot->dialplan->priority);
+	} else {
+		ast_json_writer_null(writer);
+	}
+	ast_json_writer_key(writer, "app_name");
+	ast_json_writer_string(writer, snapshot->dialplan->appl);
+	ast_json_writer_key(writer, "app_data");
+	ast_json_writer_string(writer, snapshot->dialplan->data);
+	ast_json_writer_object_end(writer);
+
+	ast_json_writer_key(writer, "creationtime");
+	ast_json_writer_timeval(writer, snapshot->base->creationtime, NULL);
+	ast_json_writer_key(writer, "language");
+	ast_json_writer_string(writer, snapshot->base->language);
+
+	if (snapshot->ari_vars && !AST_LIST_EMPTY(snapshot->ari_vars)) {
+		ast_json_writer_key(writer, "channelvars");
+		ast_json_writer_object_start(writer);
+		AST_LIST_TRAVERSE(snapshot->ari_vars, var, entries) {
+			ast_json_writer_key(writer, var->name);
+			ast_json_writer_string(writer, var->value);
+		}
+		ast_json_writer_object_end(writer);
+	}
+
+	return ast_json_writer_object_end(writer);
+}
+
 int ast_channel_snapshot_cep_equal(
 	const struct ast_channel_snapshot *old_snapshot,
 	const struct ast_channel_snapshot *new_snapshot)
@@ -303,7 +303,8 @@ struct stasis_message *ast_endpoint_blob_create(struct ast_endpoint *endpoint,
 		blob = ast_json_null();
 	}
 
-	if (!(obj = ao2_alloc(sizeof(*obj), endpoint_blob_dtor))) {
+	if (!(obj = ao2_alloc_options(sizeof(*obj), endpoint_blob_dtor,
+		AO2_ALLOC_OPT_LOCK_NOLOCK))) {
 		return NULL;
 	}
 
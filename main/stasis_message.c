@@ -31,8 +31,10 @@
 
 #include "asterisk/astobj2.h"
 #include "asterisk/stasis.h"
+#include "asterisk/stasis_internal.h"
 #include "asterisk/utils.h"
 #include "asterisk/hashtab.h"
+#include "asterisk/json.h"
 
 /*! \internal */
 struct stasis_message_type {
@@ -117,6 +119,17 @@ enum stasis_subscription_message_formatters stasis_message_type_available_format
 	return type->available_formatters;
 }
 
+/*! \brief Number of JSON renderings kept per message, one per distinct sanitizer */
+#define MESSAGE_JSON_RENDERINGS 2
+
+/*! \internal */
+struct stasis_message_json_rendering {
+	/*! The sanitizer used for the rendering (NOT refcounted, may be NULL) */
+	struct stasis_message_sanitizer *sanitize;
+	/*! The rendered message */
+	struct ast_json *json;
+};
+
 /*! \internal */
 struct stasis_message {
 	/*! Time the message was created */
@@ -129,12 +142,23 @@ struct stasis_message {
 	void *data;
 	/*! Where this message originated. */
 	struct ast_eid eid;
+	/*! AMI rendering, created the first time it is requested */
+	struct ast_manager_event_blob *ami;
+	/*! JSON renderings, created the first time each sanitizer requests one */
+	struct stasis_message_json_rendering *json[MESSAGE_JSON_RENDERINGS];
 };
 
 static void stasis_message_dtor(void *obj)
 {
 	struct stasis_message *message = obj;
+	int i;
+
 	ao2_cleanup(message->data);
+	ao2_cleanup(message->ami);
+	for (i = 0; i < MESSAGE_JSON_RENDERINGS && message->json[i]; ++i) {
+		ast_json_unref(message->json[i]->json);
+		ast_free(message->json[i]);
+	}
 }
 
 struct stasis_message *stasis_message_create_full(struct stasis_message_type *type, void *data, const struct ast_eid *eid)
@@ -146,7 +170,7 @@ struct stasis_message *stasis_message_create_full(struct stasis_message_type *ty
 	}
 
 	message = ao2_t_alloc_options(sizeof(*message), stasis_message_dtor,
-		AO2_ALLOC_OPT_LOCK_NOLOCK, type->name);
+		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_POOL, type->name);
 	if (message == NULL) {
 		return NULL;
 	}
@@ -221,16 +245,106 @@ const struct timeval *stasis_message_timestamp(const struct stasis_message *msg)
 		msg->type->vtable->fn(__VA_ARGS__);		\
 	})
 
+/*
+ * lock.h has no compare and swap wrappers so provide the ones needed for
+ * caching renderings here.
+ */
+#if defined(HAVE_C_ATOMICS)
+#define rendering_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define rendering_atomic_cas(ptr, oldval, newval) \
+	__atomic_compare_exchange_n((ptr), &(oldval), (newval), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+#define rendering_atomic_load(ptr) __sync_fetch_and_add((ptr), 0)
+#define rendering_atomic_cas(ptr, oldval, newval) \
+	__sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#endif
+
+void *stasis_cached_rendering_get(void **slot)
+{
+	return rendering_atomic_load(slot);
+}
+
+int stasis_cached_rendering_set(void **slot, void *rendering)
+{
+	void *expected = NULL;
+
+	return rendering_atomic_cas(slot, expected, rendering) ? 0 : -1;
+}
+
 struct ast_manager_event_blob *stasis_message_to_ami(struct stasis_message *msg)
 {
-	return INVOKE_VIRTUAL(to_ami, msg);
+	struct ast_manager_event_blob *blob;
+
+	if (!msg) {
+		return NULL;
+	}
+
+	blob = stasis_cached_rendering_get((void **) &msg->ami);
+	if (blob) {
+		return ao2_bump(blob);
+	}
+
+	/* Event blobs are immutable so every consumer shares the first rendering */
+	blob = INVOKE_VIRTUAL(to_ami, msg);
+	if (blob && !stasis_cached_rendering_set((void **) &msg->ami, blob)) {
+		ao2_ref(blob, +1);
+	}
+
+	return blob;
 }
 
 struct ast_json *stasis_message_to_json(
 	struct stasis_message *msg,
 	struct stasis_message_sanitizer *sanitize)
 {
-	return INVOKE_VIRTUAL(to_json, msg, sanitize);
+	struct stasis_message_json_rendering *rendering = NULL;
+	struct stasis_message_json_rendering *cached;
+	struct ast_json *json;
+	int i;
+
+	if (!msg) {
+		return NULL;
+	}
+
+	for (i = 0; i < MESSAGE_JSON_RENDERINGS; ++i) {
+		rendering = stasis_cached_rendering_get((void **) &msg->json[i]);
+		if (!rendering || rendering->sanitize == sanitize) {
+			break;
+		}
+	}
+	if (rendering && rendering->sanitize == sanitize) {
+		/*
+		 * Consumers commonly add fields to the top level object, so each
+		 * gets a copy of it. Nested values are shared.
+		 */
+		return ast_json_copy(rendering->json);
+	}
+
+	json = INVOKE_VIRTUAL(to_json, msg, sanitize);
+	if (!json || i == MESSAGE_JSON_RENDERINGS) {
+		return json;
+	}
+
+	rendering = ast_malloc(sizeof(*rendering));
+	if (!rendering) {
+		return json;
+	}
+	rendering->sanitize = sanitize;
+	rendering->json = json;
+
+	/* Another sanitizer may have claimed the free slot meanwhile */
+	for (; i < MESSAGE_JSON_RENDERINGS; ++i) {
+		if (!stasis_cached_rendering_set((void **) &msg->json[i], rendering)) {
+			return ast_json_copy(json);
+		}
+		cached = stasis_cached_rendering_get((void **) &msg->json[i]);
+		if (cached->sanitize == sanitize) {
+			break;
+		}
+	}
+	ast_free(rendering);
+
+	return json;
 }
 
 struct ast_event *stasis_message_to_event(struct stasis_message *msg)
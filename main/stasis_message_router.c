@@ -43,28 +43,77 @@ struct stasis_message_route {
 	void *data;
 };
 
-AST_VECTOR(route_table, struct stasis_message_route);
+/*! \internal */
+struct route_table {
+	/*! The routes */
+	AST_VECTOR(, struct stasis_message_route) routes;
+	/*! Position + 1 of the route of each message type, by type id, 0 if none */
+	AST_VECTOR(, int) by_type;
+};
+
+static int route_table_init(struct route_table *table)
+{
+	return AST_VECTOR_INIT(&table->routes, 0) || AST_VECTOR_INIT(&table->by_type, 0);
+}
 
 static struct stasis_message_route *route_table_find(struct route_table *table,
 	struct stasis_message_type *message_type)
 {
+	int id = stasis_message_type_id(message_type);
+	int pos;
 	size_t idx;
-	struct stasis_message_route *route;
 
-	/* While a linear search for routes may seem very inefficient, most
-	 * route tables have six routes or less. For such small data, it's
-	 * hard to beat a linear search. If we start having larger route
-	 * tables, then we can look into containers with more efficient
-	 * lookups.
-	 */
-	for (idx = 0; idx < AST_VECTOR_SIZE(table); ++idx) {
-		route = AST_VECTOR_GET_ADDR(table, idx);
-		if (route->message_type == message_type) {
-			return route;
+	if (!AST_VECTOR_SIZE(&table->by_type)) {
+		/* The index could not be built */
+		for (idx = 0; idx < AST_VECTOR_SIZE(&table->routes); ++idx) {
+			if (AST_VECTOR_GET(&table->routes, idx).message_type == message_type) {
+				return AST_VECTOR_GET_ADDR(&table->routes, idx);
+			}
 		}
+		return NULL;
+	}
+
+	/* Routers of the core register dozens of routes, so the route of
+	 * a message is looked up by the id of its type rather than
+	 * searched for.
+	 */
+	if (id < 0 || id >= AST_VECTOR_SIZE(&table->by_type)) {
+		return NULL;
 	}
 
-	return NULL;
+	pos = AST_VECTOR_GET(&table->by_type, id);
+	return pos ? AST_VECTOR_GET_ADDR(&table->routes, pos - 1) : NULL;
+}
+
+/*!
+ * \brief Rebuild the index of the routes by message type id
+ *
+ * \retval 0 on success
+ * \retval -1 on failure, the index is left empty
+ */
+static int route_table_reindex(struct route_table *table)
+{
+	size_t idx;
+	int id;
+	int max_id = -1;
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(&table->routes); ++idx) {
+		id = stasis_message_type_id(AST_VECTOR_GET(&table->routes, idx).message_type);
+		max_id = MAX(max_id, id);
+	}
+
+	AST_VECTOR_RESET(&table->by_type, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	if (AST_VECTOR_DEFAULT(&table->by_type, max_id + 1, 0)) {
+		AST_VECTOR_RESET(&table->by_type, AST_VECTOR_ELEM_CLEANUP_NOOP);
+		return -1;
+	}
+
+	for (idx = 0; idx < AST_VECTOR_SIZE(&table->routes); ++idx) {
+		id = stasis_message_type_id(AST_VECTOR_GET(&table->routes, idx).message_type);
+		AST_VECTOR_REPLACE(&table->by_type, id, idx + 1);
+	}
+
+	return 0;
 }
 
 /*!
@@ -90,8 +139,15 @@ static struct stasis_message_route *route_table_find(struct route_table *table,
 static int route_table_remove(struct route_table *table,
 	struct stasis_message_type *message_type)
 {
-	return AST_VECTOR_REMOVE_CMP_UNORDERED(table, message_type, ROUTE_TABLE_ELEM_CMP,
+	int res;
+
+	res = AST_VECTOR_REMOVE_CMP_UNORDERED(&table->routes, message_type, ROUTE_TABLE_ELEM_CMP,
 		ROUTE_TABLE_ELEM_CLEANUP);
+	if (!res) {
+		/* The last route took the place of the removed one */
+		route_table_reindex(table);
+	}
+	return res;
 }
 
 static int route_table_add(struct route_table *table,
@@ -108,9 +164,17 @@ static int route_table_add(struct route_table *table,
 	route.callback = callback;
 	route.data = data;
 
-	res = AST_VECTOR_APPEND(table, route);
+	res = AST_VECTOR_APPEND(&table->routes, route);
 	if (res) {
 		ROUTE_TABLE_ELEM_CLEANUP(route);
+		return res;
+	}
+
+	res = route_table_reindex(table);
+	if (res) {
+		AST_VECTOR_REMOVE(&table->routes, AST_VECTOR_SIZE(&table->routes) - 1, 0);
+		ROUTE_TABLE_ELEM_CLEANUP(route);
+		route_table_reindex(table);
 	}
 	return res;
 }
@@ -120,11 +184,12 @@ static void route_table_dtor(struct route_table *table)
 	size_t idx;
 	struct stasis_message_route *route;
 
-	for (idx = 0; idx < AST_VECTOR_SIZE(table); ++idx) {
-		route = AST_VECTOR_GET_ADDR(table, idx);
+	for (idx = 0; idx < AST_VECTOR_SIZE(&table->routes); ++idx) {
+		route = AST_VECTOR_GET_ADDR(&table->routes, idx);
 		ROUTE_TABLE_ELEM_CLEANUP(*route);
 	}
-	AST_VECTOR_FREE(table);
+	AST_VECTOR_FREE(&table->routes);
+	AST_VECTOR_FREE(&table->by_type);
 }
 
 /*! \internal */
@@ -159,10 +224,13 @@ static int find_route(
 {
 	struct stasis_message_route *route = NULL;
 	struct stasis_message_type *type = stasis_message_type(message);
-	SCOPED_AO2LOCK(lock, router);
+	int res = -1;
 
 	ast_assert(route_out != NULL);
 
+	/* Routes change rarely, so dispatching threads only read lock the router */
+	ao2_rdlock(router);
+
 	if (type == stasis_cache_update_type()) {
 		/* Find a cache route */
 		struct stasis_cache_update *update =
@@ -180,12 +248,13 @@ static int find_route(
 		route = &router->default_route;
 	}
 
-	if (!route) {
-		return -1;
+	if (route) {
+		*route_out = *route;
+		res = 0;
 	}
+	ao2_unlock(router);
 
-	*route_out = *route;
-	return 0;
+	return res;
 }
 
 static void router_dispatch(void *data,
@@ -211,14 +280,15 @@ static struct stasis_message_router *stasis_message_router_create_internal(
 	int res;
 	struct stasis_message_router *router;
 
-	router = ao2_t_alloc(sizeof(*router), router_dtor, stasis_topic_name(topic));
+	router = ao2_t_alloc_options(sizeof(*router), router_dtor, AO2_ALLOC_OPT_LOCK_RWLOCK,
+		stasis_topic_name(topic));
 	if (!router) {
 		return NULL;
 	}
 
 	res = 0;
-	res |= AST_VECTOR_INIT(&router->routes, 0);
-	res |= AST_VECTOR_INIT(&router->cache_routes, 0);
+	res |= route_table_init(&router->routes);
+	res |= route_table_init(&router->cache_routes);
 	if (res) {
 		ao2_ref(router, -1);
 
@@ -307,6 +377,17 @@ int stasis_message_router_set_congestion_limits(struct stasis_message_router *ro
 	return res;
 }
 
+int stasis_message_router_set_batch_size(struct stasis_message_router *router,
+	unsigned int batch_size)
+{
+	int res = -1;
+
+	if (router) {
+		res = stasis_subscription_set_batch_size(router->subscription, batch_size);
+	}
+	return res;
+}
+
 int stasis_message_router_add(struct stasis_message_router *router,
 	struct stasis_message_type *message_type,
 	stasis_subscription_cb callback, void *data)
@@ -57,7 +57,10 @@ struct stasis_state {
 	struct stasis_state_manager *manager;
 	/*! Forwarding information, i.e. this topic to manager's topic */
 	struct stasis_forward *forward;
-	/*! The managed topic */
+	/*!
+	 * The managed topic. Created on demand, so states that only ever have
+	 * messages published to them publish straight to the manager's topic.
+	 */
 	struct stasis_topic *topic;
 	/*! The actual state data */
 	struct stasis_message *msg;
@@ -74,7 +77,7 @@ AO2_STRING_FIELD_HASH_FN(stasis_state_proxy, id);
 AO2_STRING_FIELD_CMP_FN(stasis_state_proxy, id);
 
 /*! The number of buckets to use for managed states */
-#define STATE_BUCKETS 57
+#define STATE_BUCKETS 1567
 
 struct stasis_state_manager {
 	/*! Holds all state objects handled by this manager */
@@ -152,7 +155,7 @@ static void state_proxy_sub_cb(void *obj, void *data)
  *
  * Create and initialize a state structure. It's required that either a state
  * topic, or an id is specified. If a state topic is not given then one will be
- * created using the given id.
+ * created using the given id once something needs it, see \ref state_get_topic.
  *
  * \param manager The owning manager
  * \param state_topic A state topic to be managed
@@ -184,25 +187,7 @@ static struct stasis_state *state_alloc(struct stasis_state_manager *manager,
 		goto error_return;
 	}
 
-	if (!state_topic) {
-		char *name;
-
-		/*
-		 * To provide further detail and to ensure that the topic is unique within the
-		 * scope of the system we prefix it with the manager's topic name, which should
-		 * itself already be unique.
-		 */
-		if (ast_asprintf(&name, "%s/%s", stasis_topic_name(manager->all_topic), id) < 0) {
-			goto error_return;
-		}
-
-		state->topic = stasis_topic_create(name);
-
-		ast_free(name);
-		if (!state->topic) {
-			goto error_return;
-		}
-	} else {
+	if (state_topic) {
 		/*
 		 * Since the state topic was passed in, go ahead and bump its reference.
 		 * By doing this here first, it allows us to consistently decrease the reference on
@@ -223,9 +208,11 @@ static struct stasis_state *state_alloc(struct stasis_state_manager *manager,
 	proxy->manager = ao2_bump(manager);
 	state->manager = proxy->manager; /* state->manager is owned by the proxy */
 
-	state->forward = stasis_forward_all(state->topic, manager->all_topic);
-	if (!state->forward) {
-		goto error_return;
+	if (state->topic) {
+		state->forward = stasis_forward_all(state->topic, manager->all_topic);
+		if (!state->forward) {
+			goto error_return;
+		}
 	}
 
 	if (AST_VECTOR_INIT(&state->eids, 2)) {
@@ -256,6 +243,91 @@ error_return:
 	return NULL;
 }
 
+/*!
+ * \internal
+ * \brief Retrieve a state's topic, creating it if it does not exist yet.
+ *
+ * A state topic, and its forward to the manager's topic, are only needed once
+ * something subscribes to, or asks for the state's own topic. Until then messages
+ * for the state are published directly to the manager's topic, which is where
+ * they would have been forwarded to anyway. This keeps states that only hold a
+ * last published message, such as those of mailboxes nobody watches, small.
+ *
+ * \note The returned topic's reference is NOT incremented. Once created the topic
+ * lives as long as the state does.
+ *
+ * \param state The state object
+ *
+ * \return The state's topic
+ * \return NULL on error
+ */
+static struct stasis_topic *state_get_topic(struct stasis_state *state)
+{
+	struct stasis_topic *topic;
+	char *name;
+
+	ao2_lock(state);
+	if (state->topic) {
+		topic = state->topic;
+		ao2_unlock(state);
+		return topic;
+	}
+
+	/*
+	 * To provide further detail and to ensure that the topic is unique within the
+	 * scope of the system we prefix it with the manager's topic name, which should
+	 * itself already be unique.
+	 */
+	if (ast_asprintf(&name, "%s/%s", stasis_topic_name(state->manager->all_topic), state->id) < 0) {
+		ao2_unlock(state);
+		return NULL;
+	}
+
+	topic = stasis_topic_create(name);
+	ast_free(name);
+	if (!topic) {
+		ao2_unlock(state);
+		return NULL;
+	}
+
+	state->forward = stasis_forward_all(topic, state->manager->all_topic);
+	if (!state->forward) {
+		ast_log(LOG_ERROR, "Unable to forward state '%s' in manager '%s'\n",
+			state->id, stasis_topic_name(state->manager->all_topic));
+		ao2_ref(topic, -1);
+		ao2_unlock(state);
+		return NULL;
+	}
+
+	state->topic = topic;
+	ao2_unlock(state);
+
+	return topic;
+}
+
+/*!
+ * \internal
+ * \brief Publish a message for the given state.
+ *
+ * If the state has its own topic the message goes there, and from there gets
+ * forwarded to the manager's topic. Otherwise nobody can be subscribed to the
+ * state's topic, so it is published to the manager's topic directly.
+ *
+ * \param state The state object
+ * \param msg The message to publish
+ */
+static void state_publish(struct stasis_state *state, struct stasis_message *msg)
+{
+	struct stasis_topic *topic;
+
+	ao2_lock(state);
+	topic = ao2_bump(state->topic);
+	ao2_unlock(state);
+
+	stasis_publish(topic ?: state->manager->all_topic, msg);
+	ao2_cleanup(topic);
+}
+
 /*!
  * \internal
  * \brief Find a state by id, or create one if not found and add it to the manager.
@@ -317,7 +389,7 @@ static void state_prnt_obj(void *v_obj, void *where, ao2_prnt_fn *prnt)
 	if (!state) {
 		return;
 	}
-	prnt(where, "%s", stasis_topic_name(state->topic));
+	prnt(where, "%s/%s", stasis_topic_name(state->manager->all_topic), state->id);
 }
 #endif
 
@@ -376,7 +448,7 @@ struct stasis_topic *stasis_state_topic(struct stasis_state_manager *manager, co
 		return NULL;
 	}
 
-	topic = state->topic;
+	topic = state_get_topic(state);
 	ao2_ref(state, -1);
 	return topic;
 }
@@ -453,7 +525,12 @@ struct stasis_state_subscriber *stasis_state_subscribe_pool(struct stasis_state_
 		return NULL;
 	}
 
-	topic = sub->state->topic;
+	topic = state_get_topic(sub->state);
+	if (!topic) {
+		ao2_ref(sub, -1);
+		return NULL;
+	}
+
 	ast_debug(3, "Creating stasis state subscription to id '%s'. Topic: '%s':%p %d\n",
 		id, stasis_topic_name(topic), topic, (int)ao2_ref(topic, 0));
 
@@ -491,7 +568,7 @@ const char *stasis_state_subscriber_id(const struct stasis_state_subscriber *sub
 
 struct stasis_topic *stasis_state_subscriber_topic(struct stasis_state_subscriber *sub)
 {
-	return sub->state->topic;
+	return state_get_topic(sub->state);
 }
 
 void *stasis_state_subscriber_data(struct stasis_state_subscriber *sub)
@@ -556,7 +633,7 @@ const char *stasis_state_publisher_id(const struct stasis_state_publisher *pub)
 
 struct stasis_topic *stasis_state_publisher_topic(struct stasis_state_publisher *pub)
 {
-	return pub->state->topic;
+	return state_get_topic(pub->state);
 }
 
 void stasis_state_publish(struct stasis_state_publisher *pub, struct stasis_message *msg)
@@ -565,7 +642,7 @@ void stasis_state_publish(struct stasis_state_publisher *pub, struct stasis_mess
 	ao2_replace(pub->state->msg, msg);
 	ao2_unlock(pub->state);
 
-	stasis_publish(pub->state->topic, msg);
+	state_publish(pub->state, msg);
 }
 
 /*!
@@ -650,7 +727,7 @@ void stasis_state_publish_by_id(struct stasis_state_manager *manager, const char
 	ao2_replace(state->msg, msg);
 	ao2_unlock(state);
 
-	stasis_publish(state->topic, msg);
+	state_publish(state, msg);
 
 	ao2_ref(state, -1);
 }
@@ -675,7 +752,7 @@ void stasis_state_remove_publish_by_id(struct stasis_state_manager *manager,
 	}
 
 	if (msg) {
-		stasis_publish(state->topic, msg);
+		state_publish(state, msg);
 	}
 
 	ao2_lock(state);
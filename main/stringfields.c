@@ -462,3 +462,91 @@ int __ast_string_fields_copy(struct ast_string_field_pool *copy_pool,
 
 	return 0;
 }
+
+/*!
+ * \internal
+ * \brief Lay out the string fields one after another in a pool
+ *
+ * \note The pool must be empty and large enough to hold them all.
+ */
+static void string_fields_pack(struct ast_string_field_mgr *mgr, struct ast_string_field_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&mgr->string_fields); i++) {
+		const char **p = AST_VECTOR_GET(&mgr->string_fields, i);
+		size_t needed;
+		char *target;
+
+		if (*p == __ast_string_field_empty) {
+			continue;
+		}
+
+		needed = strlen(*p) + 1;
+		target = pool->base + pool->used + ast_alignof(ast_string_field_allocation);
+		memcpy(target, *p, needed);
+		AST_STRING_FIELD_ALLOCATION(target) = needed;
+		pool->used += ast_make_room_for(needed, ast_string_field_allocation);
+		pool->active += needed;
+		*p = target;
+	}
+}
+
+int __ast_string_field_compact(struct ast_string_field_mgr *mgr,
+	struct ast_string_field_pool **pool_head, const char *file, int lineno, const char *func)
+{
+	struct ast_string_field_pool *embedded = mgr->embedded_pool;
+	struct ast_string_field_pool *fresh = NULL;
+	struct ast_string_field_pool *cur;
+	size_t needed = 0;
+	size_t held = 0;
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&mgr->string_fields); i++) {
+		const char *field = *AST_VECTOR_GET(&mgr->string_fields, i);
+
+		if (field != __ast_string_field_empty) {
+			needed += ast_make_room_for(strlen(field) + 1, ast_string_field_allocation);
+		}
+	}
+
+	for (cur = *pool_head; cur; cur = cur->prev) {
+		held += cur->used;
+	}
+
+	if (held <= 2 * needed) {
+		return 0;
+	}
+
+	/* Copy out of the old pools first, they may include the embedded one. */
+	if (add_string_pool(mgr, &fresh, needed, file, lineno, func)) {
+		return -1;
+	}
+	string_fields_pack(mgr, fresh);
+
+	cur = *pool_head;
+	while (cur) {
+		struct ast_string_field_pool *prev = cur->prev;
+
+		if (cur != embedded) {
+			ast_free(cur);
+		}
+		cur = prev;
+	}
+
+	if (embedded) {
+		embedded->prev = NULL;
+		embedded->used = embedded->active = 0;
+		if (needed <= embedded->size) {
+			string_fields_pack(mgr, embedded);
+			ast_free(fresh);
+			*pool_head = embedded;
+			return 0;
+		}
+	}
+
+	fresh->prev = embedded;
+	*pool_head = fresh;
+
+	return 0;
+}
@@ -27,15 +27,64 @@
 	<support_level>core</support_level>
  ***/
 
+/*** DOCUMENTATION
+	<manager name="TaskprocessorList" language="en_US">
+		<synopsis>
+			List taskprocessors and their statistics.
+		</synopsis>
+		<syntax>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Login']/syntax/parameter[@name='ActionID'])" />
+			<parameter name="Like">
+				<para>Only list the taskprocessors whose names start with this.</para>
+			</parameter>
+		</syntax>
+		<description>
+			<para>Returns a <literal>TaskprocessorListItem</literal> event for each
+			taskprocessor, followed by a <literal>TaskprocessorListComplete</literal>
+			event.  Times are in microseconds.  The <literal>WaitBuckets</literal>
+			and <literal>ExecutionBuckets</literal> headers count the tasks that
+			took under 10 microseconds, under 100 and so on by factors of ten,
+			the last counting those that took a second or more.</para>
+		</description>
+		<see-also>
+			<ref type="manager">TaskprocessorCallbackList</ref>
+		</see-also>
+	</manager>
+	<manager name="TaskprocessorCallbackList" language="en_US">
+		<synopsis>
+			List the statistics of each task function.
+		</synopsis>
+		<syntax>
+			<xi:include xpointer="xpointer(/docs/manager[@name='Login']/syntax/parameter[@name='ActionID'])" />
+		</syntax>
+		<description>
+			<para>Returns a <literal>TaskprocessorCallbackListItem</literal> event
+			for each function tasks executed, over every taskprocessor, followed by
+			a <literal>TaskprocessorCallbackListComplete</literal> event.  The
+			headers are the same as in <literal>TaskprocessorListItem</literal>.
+			Nothing is listed unless the statistics have been turned on with
+			the <literal>core set taskprocessor callback stats on</literal> CLI
+			command.</para>
+		</description>
+		<see-also>
+			<ref type="manager">TaskprocessorList</ref>
+		</see-also>
+	</manager>
+ ***/
+
 #include "asterisk.h"
 
 #include "asterisk/_private.h"
 #include "asterisk/module.h"
 #include "asterisk/time.h"
 #include "asterisk/astobj2.h"
+#include "asterisk/backtrace.h"
 #include "asterisk/cli.h"
+#include "asterisk/histogram.h"
+#include "asterisk/manager.h"
 #include "asterisk/taskprocessor.h"
 #include "asterisk/sem.h"
+#include "asterisk/vector.h"
 
 /*!
  * \brief tps_task structure is queued to a taskprocessor
@@ -54,6 +103,8 @@ struct tps_task {
 	void *datap;
 	/*! \brief AST_LIST_ENTRY overhead */
 	AST_LIST_ENTRY(tps_task) list;
+	/*! \brief When the task was queued */
+	struct timeval queued;
 	unsigned int wants_local:1;
 };
 
@@ -63,6 +114,24 @@ struct tps_taskprocessor_stats {
 	unsigned long max_qsize;
 	/*! \brief This is the current number of tasks processed */
 	unsigned long _tasks_processed_count;
+	/*! \brief Time tasks waited in the queue */
+	struct ast_taskprocessor_time_stats wait;
+	/*! \brief Time tasks took to execute */
+	struct ast_taskprocessor_time_stats execution;
+};
+
+/*! \brief Statistics of one task function, kept while they are turned on */
+struct tps_callback_stats {
+	/*! \brief The task function */
+	uintptr_t callback;
+	/*! \brief Tasks executed */
+	unsigned long processed;
+	/*! \brief Time tasks waited in the queue */
+	struct ast_taskprocessor_time_stats wait;
+	/*! \brief Time tasks took to execute */
+	struct ast_taskprocessor_time_stats execution;
+	/*! \brief Name of the function, resolved when first asked for */
+	char *name;
 };
 
 /*! \brief A ast_taskprocessor structure is a singleton by name */
@@ -78,6 +147,16 @@ struct ast_taskprocessor {
 	long tps_queue_high;
 	/*! \brief Taskprocessor queue */
 	AST_LIST_HEAD_NOLOCK(tps_queue, tps_task) tps_queue;
+	/*! \brief Lock-free queue: last task pushed, swapped by producers */
+	struct tps_task *mpsc_tail;
+	/*! \brief Lock-free queue: next task to pop, only touched by the consumer */
+	struct tps_task *mpsc_head;
+	/*! \brief Lock-free queue: number of tasks queued plus the one executing */
+	long mpsc_pending;
+	/*! \brief Lock-free queue: placeholder node so the queue is never truly empty */
+	struct tps_task mpsc_stub;
+	/*! \brief Non-zero if the lock-free queue is used instead of tps_queue (never changes) */
+	int lockfree;
 	struct ast_taskprocessor_listener *listener;
 	/*! Current thread executing the tasks */
 	pthread_t thread;
@@ -126,6 +205,22 @@ struct subsystem_alert {
 };
 static AST_VECTOR_RW(subsystem_alert_vector, struct subsystem_alert *) overloaded_subsystems;
 
+/*
+ * Atomic accessors for the lock-free queue.  lock.h has no load, store or
+ * exchange wrappers so provide the few needed here.
+ */
+#if defined(HAVE_C_ATOMICS)
+#define tps_atomic_load(ptr)          __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define tps_atomic_store(ptr, val)    __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define tps_atomic_exchange(ptr, val) __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+#else
+#define tps_atomic_load(ptr)          __sync_fetch_and_add((ptr), 0)
+#define tps_atomic_store(ptr, val) \
+	do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+#define tps_atomic_exchange(ptr, val) \
+	({ __sync_synchronize(); __sync_lock_test_and_set((ptr), (val)); })
+#endif
+
 #ifdef LOW_MEMORY
 #define TPS_MAX_BUCKETS 61
 #else
@@ -136,6 +231,17 @@ static AST_VECTOR_RW(subsystem_alert_vector, struct subsystem_alert *) overloade
 /*! \brief tps_singletons is the astobj2 container for taskprocessor singletons */
 static struct ao2_container *tps_singletons;
 
+/*! \brief How long tasks wait in a queue before they are executed */
+static struct ast_histogram *tps_queue_wait;
+
+/*! \brief Non-zero while statistics are kept for each task function */
+static int tps_callback_stats_enabled;
+
+/*! \brief The tps_callback_stats of every task function, replaced when turned on */
+static AO2_GLOBAL_OBJ_STATIC(tps_callback_stats_container);
+
+#define TPS_CALLBACK_STATS_BUCKETS 61
+
 /*! \brief CLI <example>taskprocessor ping &lt;blah&gt;</example> operation requires a ping condition */
 static ast_cond_t cli_ping_cond;
 
@@ -155,6 +261,9 @@ static char *cli_tps_report(struct ast_cli_entry *e, int cmd, struct ast_cli_arg
 static char *cli_subsystem_alert_report(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
 static char *cli_tps_reset_stats(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
 static char *cli_tps_reset_stats_all(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
+static char *cli_tps_report_timing(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
+static char *cli_tps_report_callbacks(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
+static char *cli_tps_callback_stats(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a);
 
 static struct ast_cli_entry taskprocessor_clis[] = {
 	AST_CLI_DEFINE(cli_tps_ping, "Ping a named task processor"),
@@ -162,8 +271,14 @@ static struct ast_cli_entry taskprocessor_clis[] = {
 	AST_CLI_DEFINE(cli_subsystem_alert_report, "List task processor subsystems in alert"),
 	AST_CLI_DEFINE(cli_tps_reset_stats, "Reset a named task processor's stats"),
 	AST_CLI_DEFINE(cli_tps_reset_stats_all, "Reset all task processors' stats"),
+	AST_CLI_DEFINE(cli_tps_report_timing, "List task processor queue wait and execution times"),
+	AST_CLI_DEFINE(cli_tps_report_callbacks, "List queue wait and execution times of task functions"),
+	AST_CLI_DEFINE(cli_tps_callback_stats, "Turn statistics for each task function on or off"),
 };
 
+static int manager_tps_list(struct mansession *s, const struct message *m);
+static int manager_tps_callback_list(struct mansession *s, const struct message *m);
+
 struct default_taskprocessor_listener_pvt {
 	pthread_t poll_thread;
 	int dead;
@@ -295,6 +410,12 @@ static void tps_shutdown(void)
 	AST_VECTOR_RW_FREE(&overloaded_subsystems);
 	ao2_t_ref(tps_singletons, -1, "Unref tps_singletons in shutdown");
 	tps_singletons = NULL;
+	ao2_cleanup(tps_queue_wait);
+	tps_queue_wait = NULL;
+	ast_manager_unregister("TaskprocessorList");
+	ast_manager_unregister("TaskprocessorCallbackList");
+	tps_callback_stats_enabled = 0;
+	ao2_global_obj_release(tps_callback_stats_container);
 }
 
 /* initialize the taskprocessor container and register CLI operations */
@@ -315,7 +436,14 @@ int ast_tps_init(void)
 
 	ast_cond_init(&cli_ping_cond, NULL);
 
+	tps_queue_wait = ast_histogram_get("taskprocessor_queue_wait",
+		"Time tasks wait in a taskprocessor queue before they are executed.", NULL, NULL);
+
 	ast_cli_register_multiple(taskprocessor_clis, ARRAY_LEN(taskprocessor_clis));
+	ast_manager_register_xml_core("TaskprocessorList", EVENT_FLAG_SYSTEM | EVENT_FLAG_REPORTING,
+		manager_tps_list);
+	ast_manager_register_xml_core("TaskprocessorCallbackList", EVENT_FLAG_SYSTEM | EVENT_FLAG_REPORTING,
+		manager_tps_callback_list);
 
 	ast_register_cleanup(tps_shutdown);
 
@@ -862,14 +990,85 @@ int ast_taskprocessor_alert_set_levels(struct ast_taskprocessor *tps, long low_w
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Append a task to a lock-free queue
+ *
+ * Any number of threads may push at once.  The only shared write is a single
+ * atomic exchange of the tail, after which the previous tail is linked to the
+ * new task.
+ */
+static void tps_mpsc_push(struct ast_taskprocessor *tps, struct tps_task *task)
+{
+	struct tps_task *prev;
+
+	task->list.next = NULL;
+	prev = tps_atomic_exchange(&tps->mpsc_tail, task);
+	/*
+	 * Until this store lands the consumer cannot see the task (or anything
+	 * pushed after it) and tps_mpsc_pop() will report the queue as empty.
+	 */
+	tps_atomic_store(&prev->list.next, task);
+}
+
+/*!
+ * \internal
+ * \brief Remove the oldest task from a lock-free queue
+ *
+ * \note Only one thread may pop from the queue at a time.
+ *
+ * \retval NULL if the queue is empty or a producer has not yet finished
+ *         linking the next task.
+ */
+static struct tps_task *tps_mpsc_pop(struct ast_taskprocessor *tps)
+{
+	struct tps_task *head = tps->mpsc_head;
+	struct tps_task *next = tps_atomic_load(&head->list.next);
+
+	if (head == &tps->mpsc_stub) {
+		if (!next) {
+			return NULL;
+		}
+		tps->mpsc_head = next;
+		head = next;
+		next = tps_atomic_load(&next->list.next);
+	}
+
+	if (next) {
+		tps->mpsc_head = next;
+		return head;
+	}
+
+	if (head != tps_atomic_load(&tps->mpsc_tail)) {
+		/* A producer is part way through appending after head */
+		return NULL;
+	}
+
+	/* head is the last task, put the stub behind it so head can be handed out */
+	tps_mpsc_push(tps, &tps->mpsc_stub);
+	next = tps_atomic_load(&head->list.next);
+	if (next) {
+		tps->mpsc_head = next;
+		return head;
+	}
+
+	return NULL;
+}
+
 /* destroy the taskprocessor */
 static void tps_taskprocessor_dtor(void *tps)
 {
 	struct ast_taskprocessor *t = tps;
 	struct tps_task *task;
 
-	while ((task = AST_LIST_REMOVE_HEAD(&t->tps_queue, list))) {
-		tps_task_free(task);
+	if (t->lockfree) {
+		while ((task = tps_mpsc_pop(t))) {
+			tps_task_free(task);
+		}
+	} else {
+		while ((task = AST_LIST_REMOVE_HEAD(&t->tps_queue, list))) {
+			tps_task_free(task);
+		}
 	}
 	t->tps_queue_size = 0;
 
@@ -887,7 +1086,23 @@ static struct tps_task *tps_taskprocessor_pop(struct ast_taskprocessor *tps)
 {
 	struct tps_task *task;
 
-	if ((task = AST_LIST_REMOVE_HEAD(&tps->tps_queue, list))) {
+	if (tps->lockfree) {
+		/*
+		 * Producers count a task before linking it so once the count is
+		 * non-zero the task is guaranteed to become visible shortly.
+		 */
+		if (tps_atomic_load(&tps->tps_queue_size) <= 0) {
+			return NULL;
+		}
+		while (!(task = tps_mpsc_pop(tps))) {
+			sched_yield();
+		}
+		if (ast_atomic_sub_fetch(&tps->tps_queue_size, 1, __ATOMIC_SEQ_CST) <= tps->tps_queue_low
+			&& tps->high_water_alert) {
+			tps->high_water_alert = 0;
+			tps_alert_add(tps, -1);
+		}
+	} else if ((task = AST_LIST_REMOVE_HEAD(&tps->tps_queue, list))) {
 		--tps->tps_queue_size;
 		if (tps->high_water_alert && tps->tps_queue_size <= tps->tps_queue_low) {
 			tps->high_water_alert = 0;
@@ -975,12 +1190,14 @@ static void *default_listener_pvt_alloc(void)
  *
  * \param name Name of the task processor.
  * \param listener Listener to associate with the task processor.
+ * \param options Only TPS_QUEUE_LOCKFREE is relevant here.
  *
  * \return The newly allocated task processor.
  *
  * \pre tps_singletons must be locked by the caller.
  */
-static struct ast_taskprocessor *__allocate_taskprocessor(const char *name, struct ast_taskprocessor_listener *listener)
+static struct ast_taskprocessor *__allocate_taskprocessor(const char *name, struct ast_taskprocessor_listener *listener,
+	enum ast_tps_options options)
 {
 	struct ast_taskprocessor *p;
 	char *subsystem_separator;
@@ -1003,6 +1220,12 @@ static struct ast_taskprocessor *__allocate_taskprocessor(const char *name, stru
 	p->tps_queue_low = (AST_TASKPROCESSOR_HIGH_WATER_LEVEL * 9) / 10;
 	p->tps_queue_high = AST_TASKPROCESSOR_HIGH_WATER_LEVEL;
 
+	if (options & TPS_QUEUE_LOCKFREE) {
+		p->lockfree = 1;
+		p->mpsc_head = &p->mpsc_stub;
+		p->mpsc_tail = &p->mpsc_stub;
+	}
+
 	strcpy(p->name, name); /* Safe */
 	p->subsystem = p->name + name_length + 1;
 	ast_copy_string(p->subsystem, name, subsystem_length + 1);
@@ -1072,7 +1295,7 @@ struct ast_taskprocessor *ast_taskprocessor_get(const char *name, enum ast_tps_o
 		return NULL;
 	}
 
-	p = __allocate_taskprocessor(name, listener);
+	p = __allocate_taskprocessor(name, listener, create);
 	ao2_unlock(tps_singletons);
 	p = __start_taskprocessor(p);
 	ao2_ref(listener, -1);
@@ -1092,7 +1315,7 @@ struct ast_taskprocessor *ast_taskprocessor_create_with_listener(const char *nam
 		return NULL;
 	}
 
-	p = __allocate_taskprocessor(name, listener);
+	p = __allocate_taskprocessor(name, listener, TPS_REF_DEFAULT);
 	ao2_unlock(tps_singletons);
 
 	return __start_taskprocessor(p);
@@ -1135,6 +1358,44 @@ void *ast_taskprocessor_unreference(struct ast_taskprocessor *tps)
 	return NULL;
 }
 
+/*!
+ * \internal
+ * \brief Push a task onto a lock-free taskprocessor queue
+ *
+ * The taskprocessor lock is only taken when the queue is at or above its
+ * high water level so the alert state can be updated consistently with
+ * tps_taskprocessor_pop().
+ */
+static int taskprocessor_push_lockfree(struct ast_taskprocessor *tps, struct tps_task *t)
+{
+	long size;
+	int was_empty;
+
+	/* The currently executing task counts as still in queue */
+	was_empty = ast_atomic_fetch_add(&tps->mpsc_pending, 1, __ATOMIC_SEQ_CST) == 0;
+	size = ast_atomic_add_fetch(&tps->tps_queue_size, 1, __ATOMIC_SEQ_CST);
+	tps_mpsc_push(tps, t);
+
+	/*
+	 * This must come after the task is linked.  The consumer holds the lock
+	 * while it waits for counted tasks to become visible.
+	 */
+	if (tps->tps_queue_high <= size) {
+		ao2_lock(tps);
+		if (!tps->high_water_alert && tps->tps_queue_high <= tps->tps_queue_size) {
+			ast_log(LOG_WARNING, "The '%s' task processor queue reached %ld scheduled tasks%s.\n",
+				tps->name, tps->tps_queue_size, tps->high_water_warned ? " again" : "");
+			tps->high_water_warned = 1;
+			tps->high_water_alert = 1;
+			tps_alert_add(tps, +1);
+		}
+		ao2_unlock(tps);
+	}
+
+	tps->listener->callbacks->task_pushed(tps->listener, was_empty);
+	return 0;
+}
+
 /* push the task into the taskprocessor queue */
 static int taskprocessor_push(struct ast_taskprocessor *tps, struct tps_task *t)
 {
@@ -1151,6 +1412,11 @@ static int taskprocessor_push(struct ast_taskprocessor *tps, struct tps_task *t)
 		return -1;
 	}
 
+	t->queued = ast_tvnow();
+	if (tps->lockfree) {
+		return taskprocessor_push_lockfree(tps, t);
+	}
+
 	ao2_lock(tps);
 	AST_LIST_INSERT_TAIL(&tps->tps_queue, t, list);
 	previous_size = tps->tps_queue_size++;
@@ -1209,11 +1475,94 @@ int ast_taskprocessor_is_suspended(struct ast_taskprocessor *tps)
 	return tps ? tps->suspended : -1;
 }
 
+/*! \internal \brief Add the time of a task to a distribution */
+static void tps_time_stats_add(struct ast_taskprocessor_time_stats *stats, int64_t usec)
+{
+	unsigned long long sample = usec > 0 ? usec : 0;
+	unsigned long long bound = 10;
+	int bucket = 0;
+
+	while (bucket < AST_TASKPROCESSOR_TIME_BUCKETS - 1 && sample >= bound) {
+		bound *= 10;
+		++bucket;
+	}
+
+	++stats->buckets[bucket];
+	stats->total += sample;
+	if (sample > stats->max) {
+		stats->max = sample;
+	}
+}
+
+static int tps_callback_stats_hash(const void *obj, const int flags)
+{
+	const struct tps_callback_stats *stats = obj;
+	uintptr_t callback = flags & OBJ_SEARCH_KEY ? *(const uintptr_t *) obj : stats->callback;
+
+	return (int) (callback >> 4);
+}
+
+static int tps_callback_stats_cmp(void *obj, void *arg, int flags)
+{
+	struct tps_callback_stats *stats = obj;
+	uintptr_t callback = flags & OBJ_SEARCH_KEY ? *(uintptr_t *) arg
+		: ((struct tps_callback_stats *) arg)->callback;
+
+	return stats->callback == callback ? CMP_MATCH : 0;
+}
+
+static void tps_callback_stats_dtor(void *obj)
+{
+	struct tps_callback_stats *stats = obj;
+
+	ast_free(stats->name);
+}
+
+/*! \internal \brief Add the times of a task to the statistics of its function */
+static void tps_callback_stats_add(uintptr_t callback, int64_t wait, int64_t execution)
+{
+	struct ao2_container *container = ao2_global_obj_ref(tps_callback_stats_container);
+	struct tps_callback_stats *stats;
+
+	if (!container) {
+		return;
+	}
+
+	stats = ao2_find(container, &callback, OBJ_SEARCH_KEY);
+	if (!stats) {
+		ao2_lock(container);
+		stats = ao2_find(container, &callback, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+		if (!stats) {
+			stats = ao2_alloc(sizeof(*stats), tps_callback_stats_dtor);
+			if (stats) {
+				stats->callback = callback;
+				ao2_link_flags(container, stats, OBJ_NOLOCK);
+			}
+		}
+		ao2_unlock(container);
+	}
+	ao2_ref(container, -1);
+	if (!stats) {
+		return;
+	}
+
+	ao2_lock(stats);
+	++stats->processed;
+	tps_time_stats_add(&stats->wait, wait);
+	tps_time_stats_add(&stats->execution, execution);
+	ao2_unlock(stats);
+	ao2_ref(stats, -1);
+}
+
 int ast_taskprocessor_execute(struct ast_taskprocessor *tps)
 {
 	struct ast_taskprocessor_local local;
 	struct tps_task *t;
 	long size;
+	struct timeval start;
+	int64_t wait;
+	int64_t execution;
+	uintptr_t callback;
 
 	ao2_lock(tps);
 	t = tps_taskprocessor_pop(tps);
@@ -1231,12 +1580,22 @@ int ast_taskprocessor_execute(struct ast_taskprocessor *tps)
 	}
 	ao2_unlock(tps);
 
+	start = ast_tvnow();
+	wait = ast_tvdiff_us(start, t->queued);
+	ast_histogram_record(tps_queue_wait, wait);
 	if (t->wants_local) {
+		callback = (uintptr_t) t->callback.execute_local;
 		t->callback.execute_local(&local);
 	} else {
+		callback = (uintptr_t) t->callback.execute;
 		t->callback.execute(t->datap);
 	}
 	tps_task_free(t);
+	execution = ast_tvdiff_us(ast_tvnow(), start);
+
+	if (tps_callback_stats_enabled) {
+		tps_callback_stats_add(callback, wait, execution);
+	}
 
 	ao2_lock(tps);
 	tps->thread = AST_PTHREADT_NULL;
@@ -1245,10 +1604,21 @@ int ast_taskprocessor_execute(struct ast_taskprocessor *tps)
 	 * after we pop an empty stack.
 	 */
 	tps->executing = 0;
-	size = ast_taskprocessor_size(tps);
 
 	/* Update the stats */
 	++tps->stats._tasks_processed_count;
+	tps_time_stats_add(&tps->stats.wait, wait);
+	tps_time_stats_add(&tps->stats.execution, execution);
+
+	if (tps->lockfree) {
+		/*
+		 * Pushes that happen after this see an empty queue and may hand it
+		 * to a new consumer.  Nothing here may touch the queue afterwards.
+		 */
+		size = ast_atomic_sub_fetch(&tps->mpsc_pending, 1, __ATOMIC_SEQ_CST);
+	} else {
+		size = ast_taskprocessor_size(tps);
+	}
 
 	/* Include the task we just executed as part of the queue size. */
 	if (size >= tps->stats.max_qsize) {
@@ -1323,6 +1693,8 @@ static void tps_reset_stats(struct ast_taskprocessor *tps)
 	ao2_lock(tps);
 	tps->stats._tasks_processed_count = 0;
 	tps->stats.max_qsize = 0;
+	memset(&tps->stats.wait, 0, sizeof(tps->stats.wait));
+	memset(&tps->stats.execution, 0, sizeof(tps->stats.execution));
 	ao2_unlock(tps);
 }
 
@@ -1391,3 +1763,410 @@ static char *cli_tps_reset_stats_all(struct ast_cli_entry *e, int cmd, struct as
 
 	return CLI_SUCCESS;
 }
+
+void ast_taskprocessor_stats_foreach(ast_taskprocessor_stats_cb callback, void *data)
+{
+	struct ao2_container *sorted_tps;
+	struct ast_taskprocessor *tps;
+	struct ao2_iterator iter;
+
+	sorted_tps = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, tps_sort_cb,
+		NULL);
+	if (!sorted_tps
+		|| ao2_container_dup(sorted_tps, tps_singletons, 0)) {
+		ao2_cleanup(sorted_tps);
+		return;
+	}
+
+	iter = ao2_iterator_init(sorted_tps, AO2_ITERATOR_UNLINK);
+	while ((tps = ao2_iterator_next(&iter))) {
+		struct ast_taskprocessor_stats stats = {
+			.name = tps->name,
+		};
+
+		ao2_lock(tps);
+		stats.processed = tps->stats._tasks_processed_count;
+		stats.queued = tps->tps_queue_size;
+		stats.max_depth = tps->stats.max_qsize;
+		stats.wait = tps->stats.wait;
+		stats.execution = tps->stats.execution;
+		ao2_unlock(tps);
+
+		callback(&stats, data);
+		ast_taskprocessor_unreference(tps);
+	}
+	ao2_iterator_destroy(&iter);
+	ao2_ref(sorted_tps, -1);
+}
+
+void ast_taskprocessor_callback_stats_enable(int enabled)
+{
+	struct ao2_container *container = NULL;
+
+	if (enabled) {
+		container = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+			TPS_CALLBACK_STATS_BUCKETS, tps_callback_stats_hash, NULL, tps_callback_stats_cmp);
+		if (!container) {
+			return;
+		}
+	}
+
+	ao2_global_obj_replace_unref(tps_callback_stats_container, container);
+	ao2_cleanup(container);
+	tps_callback_stats_enabled = enabled;
+}
+
+/*!
+ * \internal
+ * \brief Get the name of a task function, stats must be locked
+ */
+static const char *tps_callback_stats_name(struct tps_callback_stats *stats)
+{
+	void *address = (void *) stats->callback;
+
+	if (stats->name) {
+		return stats->name;
+	}
+
+#ifdef HAVE_BKTR
+	{
+		struct ast_vector_string *symbols = ast_bt_get_symbols(&address, 1);
+
+		if (symbols && AST_VECTOR_SIZE(symbols)) {
+			const char *symbol = AST_VECTOR_GET(symbols, 0);
+
+			/* The address leads when it is known where the function is */
+			if (symbol[0] == '[' && strchr(symbol, ' ')) {
+				symbol = strchr(symbol, ' ') + 1;
+			}
+			stats->name = ast_strdup(symbol);
+		}
+		ast_bt_free_symbols(symbols);
+	}
+#endif
+	if (!stats->name && ast_asprintf(&stats->name, "%p", address) < 0) {
+		stats->name = NULL;
+		return "unknown";
+	}
+
+	return stats->name;
+}
+
+void ast_taskprocessor_callback_stats_foreach(ast_taskprocessor_callback_stats_cb callback, void *data)
+{
+	struct ao2_container *container = ao2_global_obj_ref(tps_callback_stats_container);
+	struct tps_callback_stats *entry;
+	struct ao2_iterator iter;
+
+	if (!container) {
+		return;
+	}
+
+	iter = ao2_iterator_init(container, 0);
+	while ((entry = ao2_iterator_next(&iter))) {
+		struct ast_taskprocessor_callback_stats stats;
+
+		ao2_lock(entry);
+		stats.name = tps_callback_stats_name(entry);
+		stats.processed = entry->processed;
+		stats.wait = entry->wait;
+		stats.execution = entry->execution;
+		ao2_unlock(entry);
+
+		/* The name is only set once, so it remains valid unlocked */
+		callback(&stats, data);
+		ao2_ref(entry, -1);
+	}
+	ao2_iterator_destroy(&iter);
+	ao2_ref(container, -1);
+}
+
+#define FMT_TIMING_FIELDS	"%-70s %10lu %10llu %10llu %10llu %10llu\n"
+
+/*! \internal \brief Average of a distribution, 0 if empty */
+static unsigned long long tps_time_stats_avg(const struct ast_taskprocessor_time_stats *stats,
+	unsigned long processed)
+{
+	return processed ? stats->total / processed : 0;
+}
+
+/*! \internal \brief State of "core show taskprocessors timing" */
+struct tps_report_timing {
+	int fd;
+	const char *like;
+	int count;
+};
+
+static void tps_report_timing_cb(const struct ast_taskprocessor_stats *stats, void *data)
+{
+	struct tps_report_timing *report = data;
+
+	if (strncasecmp(report->like, stats->name, strlen(report->like))) {
+		return;
+	}
+
+	ast_cli(report->fd, FMT_TIMING_FIELDS, stats->name, stats->processed,
+		tps_time_stats_avg(&stats->wait, stats->processed), stats->wait.max,
+		tps_time_stats_avg(&stats->execution, stats->processed), stats->execution.max);
+	report->count++;
+}
+
+static char *cli_tps_report_timing(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct tps_report_timing report = {
+		.fd = a->fd,
+	};
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show taskprocessors timing [like]";
+		e->usage =
+			"Usage: core show taskprocessors timing [like keyword]\n"
+			"	Shows how long tasks of each task processor waited in the queue\n"
+			"	and took to execute, in microseconds\n";
+		return NULL;
+	case CLI_GENERATE:
+		if (a->pos == e->args) {
+			return tps_taskprocessor_tab_complete(a);
+		} else {
+			return NULL;
+		}
+	}
+
+	if (a->argc == e->args - 1) {
+		report.like = "";
+	} else if (a->argc == e->args + 1 && !strcasecmp(a->argv[e->args-1], "like")) {
+		report.like = a->argv[e->args];
+	} else {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_cli(a->fd, "\n" FMT_HEADERS, "Processor", "Processed", "Avg wait", "Max wait", "Avg exec", "Max exec");
+	ast_taskprocessor_stats_foreach(tps_report_timing_cb, &report);
+	ast_cli(a->fd, "\n%d taskprocessors\n\n", report.count);
+
+	return CLI_SUCCESS;
+}
+
+/*! \internal \brief A copy of the statistics of a task function */
+struct tps_callback_report {
+	struct ast_taskprocessor_callback_stats stats;
+	char name[0];
+};
+
+AST_VECTOR(tps_callback_reports, struct tps_callback_report *);
+
+static void tps_callback_report_cb(const struct ast_taskprocessor_callback_stats *stats, void *data)
+{
+	struct tps_callback_reports *reports = data;
+	struct tps_callback_report *report;
+
+	report = ast_malloc(sizeof(*report) + strlen(stats->name) + 1);
+	if (!report) {
+		return;
+	}
+	report->stats = *stats;
+	strcpy(report->name, stats->name); /* Safe */
+	report->stats.name = report->name;
+
+	if (AST_VECTOR_APPEND(reports, report)) {
+		ast_free(report);
+	}
+}
+
+/*! \internal \brief Sort the functions that took the most time in total first */
+static int tps_callback_report_cmp(const void *a, const void *b)
+{
+	const struct tps_callback_report *left = *(const struct tps_callback_report **) a;
+	const struct tps_callback_report *right = *(const struct tps_callback_report **) b;
+
+	if (left->stats.execution.total != right->stats.execution.total) {
+		return left->stats.execution.total > right->stats.execution.total ? -1 : 1;
+	}
+	return strcmp(left->name, right->name);
+}
+
+static char *cli_tps_report_callbacks(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct tps_callback_reports reports;
+	int i;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show taskprocessor callbacks";
+		e->usage =
+			"Usage: core show taskprocessor callbacks\n"
+			"	Shows how long tasks of each task function waited in the queue\n"
+			"	and took to execute, over every task processor, in microseconds.\n"
+			"	The functions that took the most time in total are listed first.\n"
+			"	See 'core set taskprocessor callback stats'.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != e->args) {
+		return CLI_SHOWUSAGE;
+	}
+
+	if (!tps_callback_stats_enabled) {
+		ast_cli(a->fd, "Statistics for each task function are off\n");
+		return CLI_SUCCESS;
+	}
+
+	if (AST_VECTOR_INIT(&reports, 32)) {
+		return CLI_FAILURE;
+	}
+	ast_taskprocessor_callback_stats_foreach(tps_callback_report_cb, &reports);
+	AST_VECTOR_SORT(&reports, tps_callback_report_cmp);
+
+	ast_cli(a->fd, "\n" FMT_HEADERS, "Function", "Processed", "Avg wait", "Max wait", "Avg exec", "Max exec");
+	for (i = 0; i < AST_VECTOR_SIZE(&reports); i++) {
+		const struct ast_taskprocessor_callback_stats *stats = &AST_VECTOR_GET(&reports, i)->stats;
+
+		ast_cli(a->fd, FMT_TIMING_FIELDS, stats->name, stats->processed,
+			tps_time_stats_avg(&stats->wait, stats->processed), stats->wait.max,
+			tps_time_stats_avg(&stats->execution, stats->processed), stats->execution.max);
+	}
+	ast_cli(a->fd, "\n%zu functions\n\n", AST_VECTOR_SIZE(&reports));
+
+	AST_VECTOR_CALLBACK_VOID(&reports, ast_free);
+	AST_VECTOR_FREE(&reports);
+
+	return CLI_SUCCESS;
+}
+
+static char *cli_tps_callback_stats(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core set taskprocessor callback stats {on|off}";
+		e->usage =
+			"Usage: core set taskprocessor callback stats {on|off}\n"
+			"	Turns statistics for each task function on or off.  Keeping\n"
+			"	them costs a little for every task executed.  Turning them on\n"
+			"	throws away the statistics collected before.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != e->args) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_taskprocessor_callback_stats_enable(ast_true(a->argv[e->args - 1]));
+	ast_cli(a->fd, "Statistics for each task function are %s\n",
+		tps_callback_stats_enabled ? "on" : "off");
+
+	return CLI_SUCCESS;
+}
+
+/*! \internal \brief Append the AMI headers of a distribution */
+static void tps_time_stats_append(struct ast_str **buf, const char *prefix,
+	const struct ast_taskprocessor_time_stats *stats)
+{
+	int i;
+
+	ast_str_append(buf, 0, "%sTotal: %llu\r\n%sMax: %llu\r\n%sBuckets: ",
+		prefix, stats->total, prefix, stats->max, prefix);
+	for (i = 0; i < AST_TASKPROCESSOR_TIME_BUCKETS; i++) {
+		ast_str_append(buf, 0, "%s%lu", i ? "," : "", stats->buckets[i]);
+	}
+	ast_str_append(buf, 0, "\r\n");
+}
+
+/*! \internal \brief State of a TaskprocessorList or TaskprocessorCallbackList action */
+struct tps_manager_list {
+	struct mansession *s;
+	const char *like;
+	const char *id_text;
+	struct ast_str *buf;
+	int count;
+};
+
+static void manager_tps_list_cb(const struct ast_taskprocessor_stats *stats, void *data)
+{
+	struct tps_manager_list *list = data;
+
+	if (strncasecmp(list->like, stats->name, strlen(list->like))) {
+		return;
+	}
+
+	ast_str_set(&list->buf, 0,
+		"Event: TaskprocessorListItem\r\n"
+		"Name: %s\r\n"
+		"Processed: %lu\r\n"
+		"InQueue: %ld\r\n"
+		"MaxDepth: %lu\r\n",
+		stats->name, stats->processed, stats->queued, stats->max_depth);
+	tps_time_stats_append(&list->buf, "Wait", &stats->wait);
+	tps_time_stats_append(&list->buf, "Execution", &stats->execution);
+	astman_append(list->s, "%s%s\r\n", ast_str_buffer(list->buf), list->id_text);
+	list->count++;
+}
+
+static void manager_tps_callback_list_cb(const struct ast_taskprocessor_callback_stats *stats, void *data)
+{
+	struct tps_manager_list *list = data;
+
+	ast_str_set(&list->buf, 0,
+		"Event: TaskprocessorCallbackListItem\r\n"
+		"Name: %s\r\n"
+		"Processed: %lu\r\n",
+		stats->name, stats->processed);
+	tps_time_stats_append(&list->buf, "Wait", &stats->wait);
+	tps_time_stats_append(&list->buf, "Execution", &stats->execution);
+	astman_append(list->s, "%s%s\r\n", ast_str_buffer(list->buf), list->id_text);
+	list->count++;
+}
+
+/*!
+ * \internal
+ * \brief Run a TaskprocessorList or TaskprocessorCallbackList action
+ */
+static int manager_tps_list_common(struct mansession *s, const struct message *m, int callbacks)
+{
+	const char *id = astman_get_header(m, "ActionID");
+	char id_text[256] = "";
+	struct tps_manager_list list = {
+		.s = s,
+		.like = astman_get_header(m, "Like"),
+		.id_text = id_text,
+	};
+
+	list.buf = ast_str_create(256);
+	if (!list.buf) {
+		astman_send_error(s, m, "Internal error");
+		return -1;
+	}
+
+	if (!ast_strlen_zero(id)) {
+		snprintf(id_text, sizeof(id_text), "ActionID: %s\r\n", id);
+	}
+
+	astman_send_listack(s, m, callbacks ? "Task function statistics will follow"
+		: "Taskprocessor statistics will follow", "start");
+	if (callbacks) {
+		ast_taskprocessor_callback_stats_foreach(manager_tps_callback_list_cb, &list);
+	} else {
+		ast_taskprocessor_stats_foreach(manager_tps_list_cb, &list);
+	}
+	astman_send_list_complete_start(s, m, callbacks ? "TaskprocessorCallbackListComplete"
+		: "TaskprocessorListComplete", list.count);
+	astman_send_list_complete_end(s);
+
+	ast_free(list.buf);
+
+	return 0;
+}
+
+static int manager_tps_list(struct mansession *s, const struct message *m)
+{
+	return manager_tps_list_common(s, m, 0);
+}
+
+static int manager_tps_callback_list(struct mansession *s, const struct message *m)
+{
+	return manager_tps_list_common(s, m, 1);
+}
@@ -185,6 +185,14 @@ static void *handle_tcptls_connection(void *data)
 		}
 
 		ssl = ast_iostream_get_ssl(tcptls_session->stream);
+		ast_debug(3, "TLS connection with peer '%s' %s%s\n",
+			ast_sockaddr_stringify(&tcptls_session->remote_address),
+			SSL_session_reused(ssl) ? "resumed a session" : "did a full handshake",
+#ifdef BIO_get_ktls_send
+			BIO_get_ktls_send(SSL_get_wbio(ssl)) ? ", kernel TLS enabled" : "");
+#else
+			"");
+#endif
 		if ((tcptls_session->client && !ast_test_flag(&tcptls_session->parent->tls_cfg->flags, AST_SSL_DONT_VERIFY_SERVER))
 			|| (!tcptls_session->client && ast_test_flag(&tcptls_session->parent->tls_cfg->flags, AST_SSL_VERIFY_CLIENT))) {
 			X509 *peer;
@@ -452,6 +460,18 @@ static int __ssl_setup(struct ast_tls_config *cfg, int client)
 	if (ast_test_flag(&cfg->flags, AST_SSL_DISABLE_TLSV1)) {
 		ssl_opts |= SSL_OP_NO_TLSv1;
 	}
+
+	if (!client && ast_test_flag(&cfg->flags, AST_SSL_DISABLE_SESSION_TICKETS)) {
+		ssl_opts |= SSL_OP_NO_TICKET;
+	}
+
+	if (ast_test_flag(&cfg->flags, AST_SSL_ENABLE_KTLS)) {
+#ifdef SSL_OP_ENABLE_KTLS
+		ssl_opts |= SSL_OP_ENABLE_KTLS;
+#else
+		ast_log(LOG_WARNING, "Kernel TLS was requested but this version of OpenSSL does not support it\n");
+#endif
+	}
 #if defined(SSL_OP_NO_TLSv1_1) && defined(SSL_OP_NO_TLSv1_2)
 	if (ast_test_flag(&cfg->flags, AST_SSL_DISABLE_TLSV11)) {
 		ssl_opts |= SSL_OP_NO_TLSv1_1;
@@ -466,6 +486,18 @@ static int __ssl_setup(struct ast_tls_config *cfg, int client)
 
 	SSL_CTX_set_options(cfg->ssl_ctx, ssl_opts);
 
+	if (!client) {
+		/*
+		 * Let reconnecting clients resume their previous session instead
+		 * of doing a full handshake.  A session ID context is required
+		 * for resumption to work at all when client certificates are
+		 * verified.
+		 */
+		SSL_CTX_set_session_cache_mode(cfg->ssl_ctx, SSL_SESS_CACHE_SERVER);
+		SSL_CTX_set_session_id_context(cfg->ssl_ctx,
+			(const unsigned char *) "Asterisk", strlen("Asterisk"));
+	}
+
 	SSL_CTX_set_verify(cfg->ssl_ctx,
 		ast_test_flag(&cfg->flags, AST_SSL_VERIFY_CLIENT) ? SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT : SSL_VERIFY_NONE,
 		NULL);
@@ -920,6 +952,10 @@ int ast_tls_read_conf(struct ast_tls_config *tls_cfg, struct ast_tcptls_session_
 		ast_set2_flag(&tls_cfg->flags, ast_true(value), AST_SSL_DISABLE_TLSV11);
 	} else if (!strcasecmp(varname, "tlsdisablev12")) {
 		ast_set2_flag(&tls_cfg->flags, ast_true(value), AST_SSL_DISABLE_TLSV12);
+	} else if (!strcasecmp(varname, "tlssessiontickets")) {
+		ast_set2_flag(&tls_cfg->flags, ast_false(value), AST_SSL_DISABLE_SESSION_TICKETS);
+	} else if (!strcasecmp(varname, "tlsktls")) {
+		ast_set2_flag(&tls_cfg->flags, ast_true(value), AST_SSL_ENABLE_KTLS);
 	} else {
 		return -1;
 	}
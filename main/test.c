@@ -48,6 +48,16 @@
 #include "asterisk/astobj2.h"
 #include "asterisk/stasis.h"
 #include "asterisk/json.h"
+#include "asterisk/vector.h"
+
+/*! Tests in this category are only run when it is named explicitly */
+#define BENCH_CATEGORY "/bench/"
+
+/*! Timed batches in a benchmark when the test does not say */
+#define BENCH_DEFAULT_SAMPLES 20
+
+/*! Minimum duration of a timed batch, in nanoseconds */
+#define BENCH_BATCH_NS 5000000
 
 /*! \since 12
  * \brief The topic for test suite messages
@@ -61,6 +71,20 @@ static const char * const test_result2str[] = {
 	[AST_TEST_FAIL]    = "FAIL",
 };
 
+/*! \brief Result of a benchmark measurement, times are nanoseconds per operation */
+struct test_bench_result {
+	char *name;
+	unsigned int samples;     /*!< number of timed batches */
+	unsigned int iterations;  /*!< operations in each batch */
+	double min;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+AST_VECTOR(test_bench_results, struct test_bench_result);
+
 /*! holds all the information pertaining to a single defined test */
 struct ast_test {
 	struct ast_test_info info;        /*!< holds test callback information */
@@ -80,6 +104,7 @@ struct ast_test {
 	ast_test_cb_t *cb;                  /*!< test callback function */
 	ast_test_init_cb_t *init_cb;        /*!< test init function */
 	ast_test_cleanup_cb_t *cleanup_cb;  /*!< test cleanup function */
+	struct test_bench_results benches;  /*!< benchmarks measured during last execution */
 	AST_LIST_ENTRY(ast_test) entry;
 };
 
@@ -157,6 +182,127 @@ int __ast_test_status_update(const char *file, const char *func, int line, struc
 	return 0;
 }
 
+static void bench_result_free(struct test_bench_result result)
+{
+	ast_free(result.name);
+}
+
+static int bench_category(const char *category)
+{
+	return !strncmp(category, BENCH_CATEGORY, strlen(BENCH_CATEGORY));
+}
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int bench_batch(ast_test_bench_cb_t *cb, void *data, unsigned int iterations, uint64_t *elapsed)
+{
+	uint64_t start = bench_now();
+	int res;
+
+	res = cb(data, iterations);
+	*elapsed = bench_now() - start;
+
+	return res;
+}
+
+static int bench_time_cmp(const void *left, const void *right)
+{
+	double l = *(const double *) left;
+	double r = *(const double *) right;
+
+	return l < r ? -1 : l > r ? 1 : 0;
+}
+
+/*! \brief Nearest rank percentile of sorted samples */
+static double bench_percentile(const double *sorted, unsigned int count, unsigned int percent)
+{
+	unsigned int rank = (percent * count + 99) / 100;
+
+	return sorted[rank ? rank - 1 : 0];
+}
+
+static void bench_result_format(const struct test_bench_result *result, struct ast_str **buf)
+{
+	ast_str_append(buf, 0, "%s: %.1f ns/op, %.0f ops/sec "
+		"(min %.1f, p90 %.1f, p99 %.1f, max %.1f ns/op; %u x %u iterations)",
+		result->name, result->p50, result->p50 > 0 ? 1000000000.0 / result->p50 : 0.0,
+		result->min, result->p90, result->p99, result->max,
+		result->samples, result->iterations);
+}
+
+int ast_test_bench(struct ast_test *test, const char *name, unsigned int samples,
+	ast_test_bench_cb_t *cb, void *data)
+{
+	struct test_bench_result result = { 0, };
+	struct ast_str *buf;
+	unsigned int iterations = 1;
+	double *times;
+	uint64_t elapsed;
+	unsigned int i;
+
+	if (!samples) {
+		samples = BENCH_DEFAULT_SAMPLES;
+	}
+
+	/* Warm up while doubling the batch until it is long enough to time */
+	for (;;) {
+		if (bench_batch(cb, data, iterations, &elapsed)) {
+			ast_test_status_update(test, "%s: operation failed during warm up\n", name);
+			return -1;
+		}
+		if (elapsed >= BENCH_BATCH_NS || iterations >= (1U << 30)) {
+			break;
+		}
+		iterations *= 2;
+	}
+
+	times = ast_calloc(samples, sizeof(*times));
+	if (!times) {
+		return -1;
+	}
+
+	for (i = 0; i < samples; ++i) {
+		if (bench_batch(cb, data, iterations, &elapsed)) {
+			ast_test_status_update(test, "%s: operation failed\n", name);
+			ast_free(times);
+			return -1;
+		}
+		times[i] = (double) elapsed / iterations;
+	}
+
+	qsort(times, samples, sizeof(*times), bench_time_cmp);
+	result.samples = samples;
+	result.iterations = iterations;
+	result.min = times[0];
+	result.p50 = bench_percentile(times, samples, 50);
+	result.p90 = bench_percentile(times, samples, 90);
+	result.p99 = bench_percentile(times, samples, 99);
+	result.max = times[samples - 1];
+	ast_free(times);
+
+	result.name = ast_strdup(name);
+	if (!result.name || AST_VECTOR_APPEND(&test->benches, result)) {
+		ast_free(result.name);
+		return -1;
+	}
+
+	buf = ast_str_create(128);
+	if (buf) {
+		bench_result_format(&result, &buf);
+		ast_test_status_update(test, "%s\n", ast_str_buffer(buf));
+		ast_free(buf);
+	}
+
+	return 0;
+}
+
 int ast_test_register_init(const char *category, ast_test_init_cb_t *cb)
 {
 	struct ast_test *test;
@@ -241,6 +387,7 @@ static void test_execute(struct ast_test *test)
 	enum ast_test_result_state result;
 
 	ast_str_reset(test->status_str);
+	AST_VECTOR_RESET(&test->benches, bench_result_free);
 
 	begin = ast_tvnow();
 	if (test->init_cb && test->init_cb(&test->info, test)) {
@@ -333,16 +480,32 @@ static void test_xml_entry(struct ast_test *test, FILE *f)
 	fprintf(f, "\t\t<testcase time=\"%u.%u\" classname=\"%s\" name=\"%s\"%s>\n",
 			test->time / 1000, test->time % 1000,
 			test_cat, test_name,
-			test->state == AST_TEST_PASS ? "/" : "");
+			test->state == AST_TEST_PASS && !AST_VECTOR_SIZE(&test->benches) ? "/" : "");
 
 	ast_free(category);
 
 	if (test->state == AST_TEST_FAIL) {
 		fprintf(f, "\t\t\t<failure><![CDATA[\n%s\n\t\t]]></failure>\n",
 				S_OR(ast_str_buffer(test->status_str), "NA"));
-		fprintf(f, "\t\t</testcase>\n");
 	}
 
+	if (AST_VECTOR_SIZE(&test->benches)) {
+		struct ast_str *buf = ast_str_create(128);
+		int i;
+
+		fprintf(f, "\t\t\t<system-out><![CDATA[\n");
+		for (i = 0; buf && i < AST_VECTOR_SIZE(&test->benches); i++) {
+			ast_str_reset(buf);
+			bench_result_format(AST_VECTOR_GET_ADDR(&test->benches, i), &buf);
+			fprintf(f, "%s\n", ast_str_buffer(buf));
+		}
+		fprintf(f, "\t\t]]></system-out>\n");
+		ast_free(buf);
+	}
+
+	if (test->state == AST_TEST_FAIL || AST_VECTOR_SIZE(&test->benches)) {
+		fprintf(f, "\t\t</testcase>\n");
+	}
 }
 
 static void test_txt_entry(struct ast_test *test, FILE *f)
@@ -362,6 +525,44 @@ static void test_txt_entry(struct ast_test *test, FILE *f)
 	if (test->state == AST_TEST_FAIL) {
 		fprintf(f,   "Error Description: %s\n\n", S_OR(ast_str_buffer(test->status_str), "NA"));
 	}
+	if (AST_VECTOR_SIZE(&test->benches)) {
+		struct ast_str *buf = ast_str_create(128);
+		int i;
+
+		for (i = 0; buf && i < AST_VECTOR_SIZE(&test->benches); i++) {
+			ast_str_reset(buf);
+			bench_result_format(AST_VECTOR_GET_ADDR(&test->benches, i), &buf);
+			fprintf(f, "Benchmark:         %s\n", ast_str_buffer(buf));
+		}
+		ast_free(buf);
+	}
+}
+
+static void test_json_entry(struct ast_test *test, struct ast_json *benchmarks)
+{
+	int i;
+
+	if (!benchmarks) {
+		return;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&test->benches); i++) {
+		struct test_bench_result *result = AST_VECTOR_GET_ADDR(&test->benches, i);
+
+		ast_json_array_append(benchmarks, ast_json_pack(
+			"{s: s, s: s, s: s, s: i, s: i, s: f, s: f, s: f, s: f, s: f, s: f}",
+			"category", test->info.category,
+			"test", test->info.name,
+			"name", result->name,
+			"samples", result->samples,
+			"iterations", result->iterations,
+			"ops_per_sec", result->p50 > 0 ? 1000000000.0 / result->p50 : 0.0,
+			"min_ns", result->min,
+			"p50_ns", result->p50,
+			"p90_ns", result->p90,
+			"p99_ns", result->p99,
+			"max_ns", result->max));
+	}
 }
 
 /*!
@@ -403,7 +604,8 @@ static int test_execute_multiple(const char *name, const char *category, struct
 		execute = 0;
 		switch (mode) {
 		case TEST_CATEGORY:
-			if (!test_cat_cmp(test->info.category, category) && !test->info.explicit_only) {
+			if (!test_cat_cmp(test->info.category, category) && !test->info.explicit_only
+				&& (!bench_category(test->info.category) || bench_category(category))) {
 				execute = 1;
 			}
 			break;
@@ -413,7 +615,7 @@ static int test_execute_multiple(const char *name, const char *category, struct
 			}
 			break;
 		case TEST_ALL:
-			execute = !test->info.explicit_only;
+			execute = !test->info.explicit_only && !bench_category(test->info.category);
 		}
 
 		if (execute) {
@@ -478,6 +680,7 @@ static int test_execute_multiple(const char *name, const char *category, struct
  * \param test category to generate (optional)
  * \param path to xml file to generate. (optional)
  * \param path to txt file to generate, (optional)
+ * \param path to json file of benchmark results to generate, (optional)
  *
  * \retval 0 success
  * \retval -1 failure
@@ -487,17 +690,20 @@ static int test_execute_multiple(const char *name, const char *category, struct
  * -# When given only a category, results for every test within the category will be generated.
  * -# When given no name or category, results for every registered test will be generated.
  *
- * In order for the results to be generated, an xml and or txt file path must be provided.
+ * In order for the results to be generated, an xml, txt and or json file path must be provided.
  */
-static int test_generate_results(const char *name, const char *category, const char *xml_path, const char *txt_path)
+static int test_generate_results(const char *name, const char *category, const char *xml_path,
+	const char *txt_path, const char *json_path)
 {
 	enum test_mode mode = TEST_ALL;  /* 0 generate all, 1 generate by category only, 2 generate by name and category */
 	FILE *f_xml = NULL, *f_txt = NULL;
+	struct ast_json *json = NULL;
+	struct ast_json *benchmarks = NULL;
 	int res = 0;
 	struct ast_test *test = NULL;
 
 	/* verify at least one output file was given */
-	if (ast_strlen_zero(xml_path) && ast_strlen_zero(txt_path)) {
+	if (ast_strlen_zero(xml_path) && ast_strlen_zero(txt_path) && ast_strlen_zero(json_path)) {
 		return -1;
 	}
 
@@ -524,6 +730,14 @@ static int test_generate_results(const char *name, const char *category, const c
 			goto done;
 		}
 	}
+	if (!ast_strlen_zero(json_path)) {
+		json = ast_json_pack("{s: s, s: []}", "version", ast_get_version(), "benchmarks");
+		benchmarks = ast_json_object_get(json, "benchmarks");
+		if (!benchmarks) {
+			res = -1;
+			goto done;
+		}
+	}
 
 	AST_LIST_LOCK(&tests);
 	/* xml header information */
@@ -560,17 +774,20 @@ static int test_generate_results(const char *name, const char *category, const c
 			if (!test_cat_cmp(test->info.category, category)) {
 				test_xml_entry(test, f_xml);
 				test_txt_entry(test, f_txt);
+				test_json_entry(test, benchmarks);
 			}
 			break;
 		case TEST_NAME_CATEGORY:
 			if (!(strcmp(test->info.category, category)) && !(strcmp(test->info.name, name))) {
 				test_xml_entry(test, f_xml);
 				test_txt_entry(test, f_txt);
+				test_json_entry(test, benchmarks);
 			}
 			break;
 		case TEST_ALL:
 			test_xml_entry(test, f_xml);
 			test_txt_entry(test, f_txt);
+			test_json_entry(test, benchmarks);
 		}
 	}
 	AST_LIST_UNLOCK(&tests);
@@ -584,6 +801,11 @@ done:
 	if (f_txt) {
 		fclose(f_txt);
 	}
+	if (benchmarks && ast_json_dump_new_file_format(json, json_path, AST_JSON_PRETTY)) {
+		ast_log(LOG_WARNING, "Could not write file %s for json benchmark results\n", json_path);
+		res = -1;
+	}
+	ast_json_unref(json);
 
 	return res;
 }
@@ -668,6 +890,8 @@ static struct ast_test *test_free(struct ast_test *test)
 		return NULL;
 	}
 
+	AST_VECTOR_RESET(&test->benches, bench_result_free);
+	AST_VECTOR_FREE(&test->benches);
 	ast_free(test->status_str);
 	ast_free(test);
 
@@ -689,6 +913,10 @@ static struct ast_test *test_alloc(ast_test_cb_t *cb)
 	}
 
 	test->cb = cb;
+	if (AST_VECTOR_INIT(&test->benches, 0)) {
+		ast_free(test);
+		return NULL;
+	}
 
 	test->cb(&test->info, TEST_INIT, test);
 
@@ -989,10 +1217,9 @@ static char *test_cli_show_results(struct ast_cli_entry *e, int cmd, struct ast_
 
 static char *test_cli_generate_results(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
-	static const char * const option[] = { "xml", "txt", NULL };
+	static const char * const option[] = { "xml", "txt", "json", NULL };
 	const char *file = NULL;
 	const char *type = "";
-	int isxml = 0;
 	int res = 0;
 	struct ast_str *buf = NULL;
 	struct timeval time = ast_tvnow();
@@ -1002,9 +1229,9 @@ static char *test_cli_generate_results(struct ast_cli_entry *e, int cmd, struct
 		e->command = "test generate results";
 		e->usage =
 			"Usage: 'test generate results'\n"
-			"       Generates test results in either xml or txt format. An optional \n"
-			"       file path may be provided to specify the location of the xml or\n"
-			"       txt file\n"
+			"       Generates test results in either xml or txt format, or the\n"
+			"       results of benchmarks in json format. An optional file path\n"
+			"       may be provided to specify the location of the file\n"
 			"       \nExample usage:\n"
 			"       'test generate results xml' this writes to a default file\n"
 			"       'test generate results xml /path/to/file.xml' writes to specified file\n";
@@ -1021,9 +1248,10 @@ static char *test_cli_generate_results(struct ast_cli_entry *e, int cmd, struct
 			return CLI_SHOWUSAGE;
 		} else if (!strcasecmp(a->argv[3], "xml")) {
 			type = "xml";
-			isxml = 1;
 		} else if (!strcasecmp(a->argv[3], "txt")) {
 			type = "txt";
+		} else if (!strcasecmp(a->argv[3], "json")) {
+			type = "json";
 		} else {
 			return CLI_SHOWUSAGE;
 		}
@@ -1039,10 +1267,12 @@ static char *test_cli_generate_results(struct ast_cli_entry *e, int cmd, struct
 			file = ast_str_buffer(buf);
 		}
 
-		if (isxml) {
-			res = test_generate_results(NULL, NULL, file, NULL);
+		if (!strcmp(type, "xml")) {
+			res = test_generate_results(NULL, NULL, file, NULL, NULL);
+		} else if (!strcmp(type, "txt")) {
+			res = test_generate_results(NULL, NULL, NULL, file, NULL);
 		} else {
-			res = test_generate_results(NULL, NULL, NULL, file);
+			res = test_generate_results(NULL, NULL, NULL, NULL, file);
 		}
 
 		if (!res) {
@@ -23,10 +23,41 @@
 #include "asterisk/taskprocessor.h"
 #include "asterisk/astobj2.h"
 #include "asterisk/utils.h"
+#include "asterisk/dlinkedlists.h"
+#include "asterisk/vector.h"
 
 /* Needs to stay prime if increased */
 #define THREAD_BUCKETS 89
 
+struct worker_thread;
+
+/*!
+ * \brief A task pushed to a work stealing threadpool
+ */
+struct threadpool_task {
+	/*! The task callback */
+	int (*task)(void *data);
+	/*! Data passed to the task callback */
+	void *data;
+	AST_DLLIST_ENTRY(threadpool_task) next;
+};
+
+/*!
+ * \brief A task queue used by work stealing threadpools
+ *
+ * Each worker owns one.  Tasks are added at the tail and the owner takes
+ * them from the head, so a worker runs its own tasks in the order they were
+ * pushed.  Other workers steal from the tail.
+ */
+struct threadpool_deque {
+	/*! Protects the task list */
+	ast_mutex_t lock;
+	/*! The queued tasks */
+	AST_DLLIST_HEAD_NOLOCK(, threadpool_task) tasks;
+	/*! Number of queued tasks, read without the lock to skip empty queues */
+	int count;
+};
+
 /*!
  * \brief An opaque threadpool structure
  *
@@ -98,6 +129,21 @@ struct ast_threadpool {
 	int shutting_down;
 	/*! Threadpool-specific options */
 	struct ast_threadpool_options options;
+	/*!
+	 * \brief Running workers, each with its own task queue (work stealing only)
+	 *
+	 * Workers add themselves when their thread starts and remove themselves
+	 * before it exits.  The vector does not hold references.
+	 */
+	AST_VECTOR_RW(, struct worker_thread *) workers;
+	/*! Tasks pushed while no worker is running (work stealing only) */
+	struct threadpool_deque overflow;
+	/*! Round robin position for tasks pushed from outside the pool (work stealing only) */
+	unsigned int next_worker;
+	/*! Number of tasks waiting in all task queues (work stealing only) */
+	int tasks_queued;
+	/*! Non-zero while a task pushed notification is queued (work stealing only) */
+	int wake_pending;
 };
 
 /*!
@@ -157,8 +203,96 @@ struct worker_thread {
 	int wake_up;
 	/*! Options for this threadpool */
 	struct ast_threadpool_options options;
+	/*! Tasks queued to this worker (work stealing only) */
+	struct threadpool_deque deque;
+	/*! Index into the pool's workers to try stealing from first (work stealing only) */
+	unsigned int steal_from;
 };
 
+static void threadpool_deque_init(struct threadpool_deque *deque)
+{
+	ast_mutex_init(&deque->lock);
+	AST_DLLIST_HEAD_INIT_NOLOCK(&deque->tasks);
+	deque->count = 0;
+}
+
+/*!
+ * \brief Discard any tasks left in a deque and destroy it
+ *
+ * Like the tasks left in a taskprocessor when it is destroyed, the tasks are
+ * freed without being run.
+ */
+static void threadpool_deque_destroy(struct threadpool_deque *deque)
+{
+	struct threadpool_task *task;
+
+	while ((task = AST_DLLIST_REMOVE_HEAD(&deque->tasks, next))) {
+		ast_free(task);
+	}
+	ast_mutex_destroy(&deque->lock);
+}
+
+static void threadpool_deque_push(struct threadpool_deque *deque, struct threadpool_task *task)
+{
+	ast_mutex_lock(&deque->lock);
+	AST_DLLIST_INSERT_TAIL(&deque->tasks, task, next);
+	++deque->count;
+	ast_mutex_unlock(&deque->lock);
+}
+
+/*!
+ * \brief Take a task from a deque
+ *
+ * \param deque The deque to take a task from
+ * \param steal Take the newest task instead of the oldest
+ *
+ * \retval NULL if the deque is empty
+ */
+static struct threadpool_task *threadpool_deque_pop(struct threadpool_deque *deque, int steal)
+{
+	struct threadpool_task *task;
+
+	if (!deque->count) {
+		return NULL;
+	}
+
+	ast_mutex_lock(&deque->lock);
+	if (steal) {
+		task = AST_DLLIST_REMOVE_TAIL(&deque->tasks, next);
+	} else {
+		task = AST_DLLIST_REMOVE_HEAD(&deque->tasks, next);
+	}
+	if (task) {
+		--deque->count;
+	}
+	ast_mutex_unlock(&deque->lock);
+
+	return task;
+}
+
+/*!
+ * \brief Move all tasks from one deque to the end of another
+ *
+ * \return The number of tasks moved
+ */
+static int threadpool_deque_transfer(struct threadpool_deque *from, struct threadpool_deque *to)
+{
+	int moved;
+
+	ast_mutex_lock(&from->lock);
+	moved = from->count;
+	if (moved) {
+		ast_mutex_lock(&to->lock);
+		AST_DLLIST_APPEND_DLLIST(&to->tasks, &from->tasks, next);
+		to->count += moved;
+		ast_mutex_unlock(&to->lock);
+		from->count = 0;
+	}
+	ast_mutex_unlock(&from->lock);
+
+	return moved;
+}
+
 /* Worker thread forward declarations. See definitions for documentation */
 static int worker_thread_hash(const void *obj, int flags);
 static int worker_thread_cmp(void *obj, void *arg, int flags);
@@ -170,6 +304,10 @@ static int worker_thread_start(struct worker_thread *worker);
 static int worker_idle(struct worker_thread *worker);
 static int worker_set_state(struct worker_thread *worker, enum worker_state state);
 static void worker_shutdown(struct worker_thread *worker);
+static void worker_steal_register(struct worker_thread *worker);
+static void worker_steal_unregister(struct worker_thread *worker);
+static int worker_steal_execute(struct worker_thread *worker);
+static int activate_thread(void *obj, void *arg, int flags);
 
 /*!
  * \brief Notify the threadpool listener that the state has changed.
@@ -239,6 +377,16 @@ static int queued_active_thread_idle(void *data)
 	ao2_link(pair->pool->idle_threads, pair->worker);
 	ao2_unlink(pair->pool->active_threads, pair->worker);
 
+	/*
+	 * A task may have been pushed after the worker last looked for work but
+	 * before it was idle.  The task pushed notification will have found no
+	 * idle worker to wake, so wake one now.
+	 */
+	if (pair->pool->options.work_stealing && pair->pool->tasks_queued) {
+		ao2_callback(pair->pool->idle_threads, OBJ_UNLINK | OBJ_NOLOCK | OBJ_NODATA,
+			activate_thread, pair->pool);
+	}
+
 	threadpool_send_state_changed(pair->pool);
 
 	thread_worker_pair_free(pair);
@@ -387,6 +535,9 @@ static void threadpool_destructor(void *obj)
 {
 	struct ast_threadpool *pool = obj;
 	ao2_cleanup(pool->listener);
+
+	AST_VECTOR_RW_FREE(&pool->workers);
+	threadpool_deque_destroy(&pool->overflow);
 }
 
 /*
@@ -407,9 +558,16 @@ static struct ast_threadpool *threadpool_alloc(const char *name, const struct as
 	struct ast_str *control_tps_name;
 
 	pool = ao2_alloc(sizeof(*pool), threadpool_destructor);
+	if (!pool) {
+		return NULL;
+	}
+	threadpool_deque_init(&pool->overflow);
+	if (AST_VECTOR_RW_INIT(&pool->workers, options->work_stealing ? options->initial_size : 0)) {
+		return NULL;
+	}
+
 	control_tps_name = ast_str_create(64);
-	if (!pool || !control_tps_name) {
-		ast_free(control_tps_name);
+	if (!control_tps_name) {
 		return NULL;
 	}
 
@@ -514,6 +672,32 @@ static int activate_thread(void *obj, void *arg, int flags)
 	return CMP_MATCH;
 }
 
+/*!
+ * \brief Activate a set number of idle threads
+ *
+ * Called as an ao2_callback_data in the threadpool's control taskprocessor thread.
+ * \param obj The worker to activate
+ * \param arg The pool where the worker belongs
+ * \param data The number of threads left to activate
+ * \retval CMP_MATCH The worker was activated or is dead
+ * \retval CMP_STOP Enough workers have been activated
+ */
+static int activate_threads(void *obj, void *arg, void *data, int flags)
+{
+	int *num_to_activate = data;
+	int res;
+
+	if (*num_to_activate <= 0) {
+		return CMP_STOP;
+	}
+
+	res = activate_thread(obj, arg, flags);
+	if (res) {
+		--(*num_to_activate);
+	}
+	return res;
+}
+
 /*!
  * \brief Add threads to the threadpool
  *
@@ -570,18 +754,34 @@ static int queued_task_pushed(void *data)
 
 	ast_free(tpd);
 
+	if (pool->options.work_stealing) {
+		/* Pushes from here on need another notification to wake workers */
+		ast_atomic_flag_clear(&pool->wake_pending, 1, __ATOMIC_SEQ_CST);
+	}
+
 	if (pool->listener && pool->listener->callbacks->task_pushed) {
 		pool->listener->callbacks->task_pushed(pool, pool->listener, was_empty);
 	}
 
 	existing_active = ao2_container_count(pool->active_threads);
 
-	/* The first pass transitions any existing idle threads to be active, and
-	 * will also remove any worker threads that have recently entered the dead
-	 * state.
-	 */
-	ao2_callback(pool->idle_threads, OBJ_UNLINK | OBJ_NOLOCK | OBJ_NODATA,
-			activate_thread, pool);
+	if (pool->options.work_stealing) {
+		/*
+		 * Notifications are coalesced so wake one idle worker per waiting
+		 * task rather than just one.
+		 */
+		int num_to_wake = MAX(pool->tasks_queued, 1);
+
+		ao2_callback_data(pool->idle_threads, OBJ_UNLINK | OBJ_NOLOCK | OBJ_NODATA | OBJ_MULTIPLE,
+				activate_threads, pool, &num_to_wake);
+	} else {
+		/* The first pass transitions any existing idle threads to be active, and
+		 * will also remove any worker threads that have recently entered the dead
+		 * state.
+		 */
+		ao2_callback(pool->idle_threads, OBJ_UNLINK | OBJ_NOLOCK | OBJ_NODATA,
+				activate_thread, pool);
+	}
 
 	/* If no idle threads could be transitioned to active grow the pool as permitted. */
 	if (ao2_container_count(pool->active_threads) == existing_active) {
@@ -599,18 +799,13 @@ static int queued_task_pushed(void *data)
 }
 
 /*!
- * \brief Taskprocessor listener callback called when a task is added
+ * \brief Queue a task on the control taskprocessor to handle a pushed task
  *
- * The threadpool uses this opportunity to queue a task on its control taskprocessor
- * in order to activate idle threads and notify the threadpool listener that the
- * task has been pushed.
- * \param listener The taskprocessor listener. The threadpool is the listener's private data
- * \param was_empty True if the taskprocessor was empty prior to the task being pushed
+ * \param pool The threadpool a task was pushed to
+ * \param was_empty True if the threadpool had no tasks before this one was pushed
  */
-static void threadpool_tps_task_pushed(struct ast_taskprocessor_listener *listener,
-		int was_empty)
+static void threadpool_task_pushed(struct ast_threadpool *pool, int was_empty)
 {
-	struct ast_threadpool *pool = ast_taskprocessor_listener_get_user_data(listener);
 	struct task_pushed_data *tpd;
 	SCOPED_AO2LOCK(lock, pool);
 
@@ -620,14 +815,31 @@ static void threadpool_tps_task_pushed(struct ast_taskprocessor_listener *listen
 
 	tpd = task_pushed_data_alloc(pool, was_empty);
 	if (!tpd) {
+		ast_atomic_flag_clear(&pool->wake_pending, 1, __ATOMIC_SEQ_CST);
 		return;
 	}
 
 	if (ast_taskprocessor_push(pool->control_tps, queued_task_pushed, tpd)) {
+		ast_atomic_flag_clear(&pool->wake_pending, 1, __ATOMIC_SEQ_CST);
 		ast_free(tpd);
 	}
 }
 
+/*!
+ * \brief Taskprocessor listener callback called when a task is added
+ *
+ * The threadpool uses this opportunity to queue a task on its control taskprocessor
+ * in order to activate idle threads and notify the threadpool listener that the
+ * task has been pushed.
+ * \param listener The taskprocessor listener. The threadpool is the listener's private data
+ * \param was_empty True if the taskprocessor was empty prior to the task being pushed
+ */
+static void threadpool_tps_task_pushed(struct ast_taskprocessor_listener *listener,
+		int was_empty)
+{
+	threadpool_task_pushed(ast_taskprocessor_listener_get_user_data(listener), was_empty);
+}
+
 /*!
  * \brief Queued task that handles the case where the threadpool's taskprocessor is emptied
  *
@@ -645,15 +857,12 @@ static int queued_emptied(void *data)
 }
 
 /*!
- * \brief Taskprocessor listener emptied callback
+ * \brief Queue a task to let the threadpool listener know the pool has no tasks
  *
- * The threadpool queues a task to let the threadpool listener know that
- * the threadpool no longer contains any tasks.
- * \param listener The taskprocessor listener. The threadpool is the listener's private data.
+ * \param pool The threadpool that was emptied
  */
-static void threadpool_tps_emptied(struct ast_taskprocessor_listener *listener)
+static void threadpool_emptied(struct ast_threadpool *pool)
 {
-	struct ast_threadpool *pool = ast_taskprocessor_listener_get_user_data(listener);
 	SCOPED_AO2LOCK(lock, pool);
 
 	if (pool->shutting_down) {
@@ -667,6 +876,18 @@ static void threadpool_tps_emptied(struct ast_taskprocessor_listener *listener)
 	}
 }
 
+/*!
+ * \brief Taskprocessor listener emptied callback
+ *
+ * The threadpool queues a task to let the threadpool listener know that
+ * the threadpool no longer contains any tasks.
+ * \param listener The taskprocessor listener. The threadpool is the listener's private data.
+ */
+static void threadpool_tps_emptied(struct ast_taskprocessor_listener *listener)
+{
+	threadpool_emptied(ast_taskprocessor_listener_get_user_data(listener));
+}
+
 /*!
  * \brief Taskprocessor listener shutdown callback
  *
@@ -953,13 +1174,75 @@ struct ast_threadpool *ast_threadpool_create(const char *name,
 	return pool;
 }
 
+/*! The worker the current thread belongs to, if it is a work stealing pool worker */
+AST_THREADSTORAGE_RAW(current_worker);
+
+/*!
+ * \brief Push a task to a work stealing threadpool
+ *
+ * A task pushed from one of the pool's own workers is queued to that worker,
+ * otherwise the task is given to the running workers in turn.  Neither takes
+ * the pool lock and an idle worker is only woken through the control
+ * taskprocessor if a wake up is not already on its way.
+ */
+static int threadpool_steal_push(struct ast_threadpool *pool, int (*task)(void *data), void *data)
+{
+	struct worker_thread *worker = ast_threadstorage_get_ptr(&current_worker);
+	struct threadpool_task *t;
+	int was_empty;
+
+	/* A stale read is harmless, anything still queued is discarded with the pool */
+	if (pool->shutting_down) {
+		return -1;
+	}
+
+	t = ast_malloc(sizeof(*t));
+	if (!t) {
+		return -1;
+	}
+	t->task = task;
+	t->data = data;
+
+	was_empty = ast_atomic_fetch_add(&pool->tasks_queued, 1, __ATOMIC_SEQ_CST) == 0;
+
+	if (worker && worker->pool == pool) {
+		threadpool_deque_push(&worker->deque, t);
+	} else {
+		AST_VECTOR_RW_RDLOCK(&pool->workers);
+		if (AST_VECTOR_SIZE(&pool->workers)) {
+			unsigned int next = ast_atomic_fetch_add(&pool->next_worker, 1, __ATOMIC_RELAXED);
+
+			worker = AST_VECTOR_GET(&pool->workers, next % AST_VECTOR_SIZE(&pool->workers));
+			threadpool_deque_push(&worker->deque, t);
+		} else {
+			threadpool_deque_push(&pool->overflow, t);
+		}
+		AST_VECTOR_RW_UNLOCK(&pool->workers);
+	}
+
+	/* Listeners are told about every push, just as with the shared queue */
+	if ((pool->listener && pool->listener->callbacks->task_pushed)
+		|| !ast_atomic_fetch_or(&pool->wake_pending, 1, __ATOMIC_SEQ_CST)) {
+		threadpool_task_pushed(pool, was_empty);
+	}
+
+	return 0;
+}
+
 int ast_threadpool_push(struct ast_threadpool *pool, int (*task)(void *data), void *data)
 {
-	SCOPED_AO2LOCK(lock, pool);
+	int res = -1;
+
+	if (pool->options.work_stealing) {
+		return threadpool_steal_push(pool, task, data);
+	}
+
+	ao2_lock(pool);
 	if (!pool->shutting_down) {
-		return ast_taskprocessor_push(pool->tps, task, data);
+		res = ast_taskprocessor_push(pool->tps, task, data);
 	}
-	return -1;
+	ao2_unlock(pool);
+	return res;
 }
 
 void ast_threadpool_shutdown(struct ast_threadpool *pool)
@@ -1027,6 +1310,7 @@ static void worker_thread_destroy(void *obj)
 	struct worker_thread *worker = obj;
 	ast_debug(3, "Destroying worker thread %d\n", worker->id);
 	worker_shutdown(worker);
+	threadpool_deque_destroy(&worker->deque);
 	ast_mutex_destroy(&worker->lock);
 	ast_cond_destroy(&worker->cond);
 }
@@ -1050,6 +1334,10 @@ static void *worker_start(void *arg)
 		worker->options.thread_start();
 	}
 
+	if (worker->options.work_stealing) {
+		worker_steal_register(worker);
+	}
+
 	ast_mutex_lock(&worker->lock);
 	while (worker_idle(worker)) {
 		ast_mutex_unlock(&worker->lock);
@@ -1063,6 +1351,10 @@ static void *worker_start(void *arg)
 	saved_state = worker->state;
 	ast_mutex_unlock(&worker->lock);
 
+	if (worker->options.work_stealing) {
+		worker_steal_unregister(worker);
+	}
+
 	/* Reaching this portion means the thread is
 	 * on death's door. It may have been killed while
 	 * it was idle, in which case it can just die
@@ -1099,6 +1391,7 @@ static struct worker_thread *worker_thread_alloc(struct ast_threadpool *pool)
 	worker->id = ast_atomic_fetchadd_int(&worker_id_counter, 1);
 	ast_mutex_init(&worker->lock);
 	ast_cond_init(&worker->cond, NULL);
+	threadpool_deque_init(&worker->deque);
 	worker->pool = pool;
 	worker->thread = AST_PTHREADT_NULL;
 	worker->state = ALIVE;
@@ -1111,6 +1404,121 @@ static int worker_thread_start(struct worker_thread *worker)
 	return ast_pthread_create(&worker->thread, NULL, worker_start, worker);
 }
 
+/*!
+ * \brief Make a worker's task queue available to the rest of a work stealing pool
+ *
+ * Called from the worker's own thread when it starts.
+ */
+static void worker_steal_register(struct worker_thread *worker)
+{
+	struct ast_threadpool *pool = worker->pool;
+
+	ast_threadstorage_set_ptr(&current_worker, worker);
+
+	AST_VECTOR_RW_WRLOCK(&pool->workers);
+	if (AST_VECTOR_APPEND(&pool->workers, worker)) {
+		/* The worker can still run tasks, it just won't be handed any directly */
+		ast_log(LOG_WARNING, "Failed to add worker thread %d to threadpool %s\n",
+			worker->id, ast_taskprocessor_name(pool->tps));
+	}
+	AST_VECTOR_RW_UNLOCK(&pool->workers);
+}
+
+/*!
+ * \brief Remove a worker's task queue from a work stealing pool
+ *
+ * Called from the worker's own thread before it exits.  Any tasks still
+ * queued to the worker are handed back to the pool.
+ */
+static void worker_steal_unregister(struct worker_thread *worker)
+{
+	struct ast_threadpool *pool = worker->pool;
+
+	AST_VECTOR_RW_WRLOCK(&pool->workers);
+	AST_VECTOR_REMOVE_CMP_UNORDERED(&pool->workers, worker,
+		AST_VECTOR_ELEM_DEFAULT_CMP, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	AST_VECTOR_RW_UNLOCK(&pool->workers);
+
+	ast_threadstorage_set_ptr(&current_worker, NULL);
+
+	if (threadpool_deque_transfer(&worker->deque, &pool->overflow)
+		&& !ast_atomic_fetch_or(&pool->wake_pending, 1, __ATOMIC_SEQ_CST)) {
+		threadpool_task_pushed(pool, 0);
+	}
+}
+
+/*!
+ * \brief Take a task queued to another worker
+ *
+ * \param thief The worker looking for something to do
+ *
+ * \retval NULL if no other worker has a task queued
+ */
+static struct threadpool_task *worker_steal(struct worker_thread *thief)
+{
+	struct ast_threadpool *pool = thief->pool;
+	struct threadpool_task *task = NULL;
+	size_t num_workers;
+	size_t i;
+
+	AST_VECTOR_RW_RDLOCK(&pool->workers);
+	num_workers = AST_VECTOR_SIZE(&pool->workers);
+	for (i = 0; i < num_workers && !task; ++i) {
+		struct worker_thread *victim = AST_VECTOR_GET(&pool->workers,
+			(thief->steal_from + i) % num_workers);
+
+		if (victim != thief) {
+			task = threadpool_deque_pop(&victim->deque, 1);
+		}
+	}
+	/* Start with the next worker along next time to spread the steals out */
+	thief->steal_from += i;
+	AST_VECTOR_RW_UNLOCK(&pool->workers);
+
+	return task;
+}
+
+/*!
+ * \brief Execute one task in a work stealing threadpool
+ *
+ * The worker prefers its own tasks, then tasks pushed while no workers were
+ * running and finally tasks it can steal from other workers.
+ *
+ * \param worker The worker looking for a task to run
+ * \retval 0 Either the pool has been shut down or there are no tasks.
+ * \retval 1 A task was executed.
+ */
+static int worker_steal_execute(struct worker_thread *worker)
+{
+	struct ast_threadpool *pool = worker->pool;
+	struct threadpool_task *task;
+
+	if (pool->shutting_down) {
+		return 0;
+	}
+
+	task = threadpool_deque_pop(&worker->deque, 0);
+	if (!task) {
+		task = threadpool_deque_pop(&pool->overflow, 0);
+	}
+	if (!task) {
+		task = worker_steal(worker);
+	}
+	if (!task) {
+		return 0;
+	}
+
+	ast_atomic_fetch_sub(&pool->tasks_queued, 1, __ATOMIC_SEQ_CST);
+	task->task(task->data);
+	ast_free(task);
+
+	if (!pool->tasks_queued && pool->listener && pool->listener->callbacks->emptied) {
+		threadpool_emptied(pool);
+	}
+
+	return 1;
+}
+
 /*!
  * \brief Active loop for worker threads
  *
@@ -1134,7 +1542,8 @@ static void worker_active(struct worker_thread *worker)
 	 * optimize the code away.
 	 */
 	do {
-		alive = threadpool_execute(worker->pool);
+		alive = worker->options.work_stealing
+			? worker_steal_execute(worker) : threadpool_execute(worker->pool);
 	} while (alive);
 }
 
@@ -1436,5 +1845,8 @@ struct ast_taskprocessor *ast_threadpool_serializer(const char *name, struct ast
 
 long ast_threadpool_queue_size(struct ast_threadpool *pool)
 {
+	if (pool->options.work_stealing) {
+		return pool->tasks_queued;
+	}
 	return ast_taskprocessor_size(pool->tps);
 }
@@ -0,0 +1,763 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Binary trace ring
+ *
+ * Taking a record walks the format string just far enough to pull each
+ * argument off the va_list with the right type, and stores it in an
+ * 8 byte slot.  Decoding walks the format again and prints one conversion
+ * at a time from the stored values.
+ *
+ * Only the owning thread writes to a ring.  A reader copies the records it
+ * wants and then throws away any the writer may have lapped meanwhile, so
+ * neither side ever takes a lock.
+ */
+
+#include "asterisk.h"
+
+#include <time.h>
+
+#include "asterisk/_private.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/cli.h"
+#include "asterisk/lock.h"
+#include "asterisk/strings.h"
+#include "asterisk/threadstorage.h"
+#include "asterisk/utils.h"
+#include "asterisk/trace_ring.h"
+
+int ast_trace_ring_enabled;
+
+/*! \brief A stored argument */
+union trace_arg {
+	long long i;
+	double d;
+	const void *p;
+	/*! Offset of a copied string in the record, -1 for a NULL string */
+	int str;
+};
+
+struct trace_record {
+	const char *file;
+	const char *func;
+	const char *fmt;
+	int line;
+	/*! Number of args in use */
+	int nargs;
+	struct timespec ts;
+	union trace_arg args[AST_TRACE_RING_ARGS];
+	char strings[AST_TRACE_RING_STRINGS];
+};
+
+struct trace_ring {
+	/*! Thread the ring belongs to */
+	int tid;
+	/*! Records ever taken, the next goes in records[head % AST_TRACE_RING_SIZE] */
+	unsigned int head;
+	/*! Records taken before this were cleared */
+	unsigned int floor;
+	struct trace_record records[AST_TRACE_RING_SIZE];
+};
+
+/*! \brief Every thread's ring */
+static struct ao2_container *rings;
+
+struct trace_ring_holder {
+	struct trace_ring *ring;
+};
+
+static void trace_ring_holder_free(void *data)
+{
+	struct trace_ring_holder *holder = data;
+
+	if (holder->ring) {
+		if (rings) {
+			ao2_unlink(rings, holder->ring);
+		}
+		ao2_ref(holder->ring, -1);
+	}
+	ast_free(holder);
+}
+
+AST_THREADSTORAGE_CUSTOM(ring_holder, NULL, trace_ring_holder_free);
+
+/*! \brief Integer and floating argument sizes */
+enum trace_length {
+	TRACE_LENGTH_NONE,
+	TRACE_LENGTH_HH,
+	TRACE_LENGTH_H,
+	TRACE_LENGTH_L,
+	TRACE_LENGTH_LL,
+	TRACE_LENGTH_J,
+	TRACE_LENGTH_Z,
+	TRACE_LENGTH_T,
+	TRACE_LENGTH_LD,
+};
+
+/*! \brief A parsed conversion specification */
+struct trace_spec {
+	/*! Flags, width and precision, as written */
+	const char *flags;
+	size_t flags_len;
+	/*! Number of '*' widths and precisions */
+	int stars;
+	/*! Literal precision, -1 if none or given by a '*' */
+	int precision;
+	/*! Non-zero if the precision is given by a '*' */
+	int precision_star;
+	enum trace_length length;
+	char conv;
+};
+
+/*!
+ * \internal
+ * \brief Parse a conversion specification
+ *
+ * \param p Just past the '%'
+ * \param spec Filled in
+ *
+ * \return Just past the conversion, or NULL if it is not one we know
+ */
+static const char *trace_spec_parse(const char *p, struct trace_spec *spec)
+{
+	spec->flags = p;
+	spec->stars = 0;
+	spec->precision = -1;
+	spec->precision_star = 0;
+	spec->length = TRACE_LENGTH_NONE;
+
+	while (*p && strchr("-+ #0'", *p)) {
+		p++;
+	}
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	} else {
+		while (isdigit(*p)) {
+			p++;
+		}
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			spec->precision_star = 1;
+			p++;
+		} else {
+			spec->precision = 0;
+			while (isdigit(*p)) {
+				spec->precision = spec->precision * 10 + (*p - '0');
+				p++;
+			}
+		}
+	}
+	spec->flags_len = p - spec->flags;
+
+	switch (*p) {
+	case 'h':
+		spec->length = TRACE_LENGTH_H;
+		if (*++p == 'h') {
+			spec->length = TRACE_LENGTH_HH;
+			p++;
+		}
+		break;
+	case 'l':
+		spec->length = TRACE_LENGTH_L;
+		if (*++p == 'l') {
+			spec->length = TRACE_LENGTH_LL;
+			p++;
+		}
+		break;
+	case 'q':
+		spec->length = TRACE_LENGTH_LL;
+		p++;
+		break;
+	case 'j':
+		spec->length = TRACE_LENGTH_J;
+		p++;
+		break;
+	case 'z':
+		spec->length = TRACE_LENGTH_Z;
+		p++;
+		break;
+	case 't':
+		spec->length = TRACE_LENGTH_T;
+		p++;
+		break;
+	case 'L':
+		spec->length = TRACE_LENGTH_LD;
+		p++;
+		break;
+	}
+
+	spec->conv = *p;
+	if (!spec->conv || !strchr("diouxXcspneEfFgGaA%", spec->conv)) {
+		return NULL;
+	}
+
+	return p + 1;
+}
+
+/*! \brief Number of argument slots a conversion uses */
+static int trace_spec_args(const struct trace_spec *spec)
+{
+	switch (spec->conv) {
+	case '%':
+		return 0;
+	case 'n':
+		/* Not stored, the pointer is only skipped */
+		return spec->stars;
+	default:
+		return spec->stars + 1;
+	}
+}
+
+static void __attribute__((format(printf, 2, 0))) trace_record_args(struct trace_record *record,
+	const char *fmt, va_list ap)
+{
+	union trace_arg *arg = record->args;
+	size_t strings_used = 0;
+	struct trace_spec spec;
+	const char *p = fmt;
+
+	record->nargs = 0;
+
+	while ((p = strchr(p, '%'))) {
+		int precision;
+		int i;
+
+		if (!(p = trace_spec_parse(p + 1, &spec))
+			|| record->nargs + trace_spec_args(&spec) > AST_TRACE_RING_ARGS) {
+			/* Decoding shows the rest of the format as is */
+			break;
+		}
+
+		precision = spec.precision;
+		for (i = 0; i < spec.stars; i++) {
+			arg->i = va_arg(ap, int);
+			if (spec.precision_star && i == spec.stars - 1) {
+				precision = arg->i;
+			}
+			arg++;
+		}
+
+		switch (spec.conv) {
+		case '%':
+			continue;
+		case 'n':
+			(void) va_arg(ap, void *);
+			record->nargs = arg - record->args;
+			continue;
+		case 'd':
+		case 'i':
+			switch (spec.length) {
+			case TRACE_LENGTH_L:
+				arg->i = va_arg(ap, long);
+				break;
+			case TRACE_LENGTH_LL:
+				arg->i = va_arg(ap, long long);
+				break;
+			case TRACE_LENGTH_J:
+				arg->i = va_arg(ap, intmax_t);
+				break;
+			case TRACE_LENGTH_Z:
+				arg->i = va_arg(ap, ssize_t);
+				break;
+			case TRACE_LENGTH_T:
+				arg->i = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				arg->i = va_arg(ap, int);
+				break;
+			}
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			switch (spec.length) {
+			case TRACE_LENGTH_L:
+				arg->i = va_arg(ap, unsigned long);
+				break;
+			case TRACE_LENGTH_LL:
+				arg->i = va_arg(ap, unsigned long long);
+				break;
+			case TRACE_LENGTH_J:
+				arg->i = va_arg(ap, uintmax_t);
+				break;
+			case TRACE_LENGTH_Z:
+				arg->i = va_arg(ap, size_t);
+				break;
+			case TRACE_LENGTH_T:
+				arg->i = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				arg->i = va_arg(ap, unsigned int);
+				break;
+			}
+			break;
+		case 'c':
+			arg->i = va_arg(ap, int);
+			break;
+		case 'p':
+			arg->p = va_arg(ap, void *);
+			break;
+		case 's':
+			{
+				const char *str = va_arg(ap, const char *);
+				size_t len;
+
+				if (!str) {
+					arg->str = -1;
+					break;
+				}
+				len = precision >= 0 ? strnlen(str, precision) : strlen(str);
+				if (len > sizeof(record->strings) - strings_used - 1) {
+					len = sizeof(record->strings) - strings_used - 1;
+				}
+				arg->str = strings_used;
+				memcpy(record->strings + strings_used, str, len);
+				record->strings[strings_used + len] = '\0';
+				strings_used += len + 1;
+				if (strings_used > sizeof(record->strings) - 1) {
+					/* Full, later strings come out empty */
+					strings_used = sizeof(record->strings) - 1;
+				}
+			}
+			break;
+		default:
+			if (spec.length == TRACE_LENGTH_LD) {
+				arg->d = va_arg(ap, long double);
+			} else {
+				arg->d = va_arg(ap, double);
+			}
+			break;
+		}
+		arg++;
+		record->nargs = arg - record->args;
+	}
+}
+
+static struct trace_ring *trace_ring_get(void)
+{
+	struct trace_ring_holder *holder;
+
+	holder = ast_threadstorage_get(&ring_holder, sizeof(*holder));
+	if (!holder) {
+		return NULL;
+	}
+	if (holder->ring) {
+		return holder->ring;
+	}
+
+	holder->ring = ao2_alloc_options(sizeof(*holder->ring), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!holder->ring) {
+		return NULL;
+	}
+	holder->ring->tid = ast_get_tid();
+	if (rings) {
+		ao2_link(rings, holder->ring);
+	}
+
+	return holder->ring;
+}
+
+void __ast_trace_ring(const char *file, int line, const char *func, const char *fmt, ...)
+{
+	struct trace_ring *ring = trace_ring_get();
+	struct trace_record *record;
+	va_list ap;
+
+	if (!ring) {
+		return;
+	}
+
+	/* Only this thread ever moves head */
+	record = &ring->records[ring->head % AST_TRACE_RING_SIZE];
+	record->file = file;
+	record->line = line;
+	record->func = func;
+	record->fmt = fmt;
+	clock_gettime(CLOCK_REALTIME, &record->ts);
+
+	va_start(ap, fmt);
+	trace_record_args(record, fmt, ap);
+	va_end(ap);
+
+	ast_atomic_fetch_add(&ring->head, 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * \internal
+ * \brief Print a conversion with its width and precision
+ *
+ * \param buf Appended to
+ * \param fmt A format holding just the one conversion
+ * \param stars The '*' values, as many as the conversion has
+ */
+#define TRACE_APPEND(buf, fmt, stars, nstars, value) \
+	do { \
+		switch (nstars) { \
+		case 0: \
+			ast_str_append(buf, 0, fmt, value); \
+			break; \
+		case 1: \
+			ast_str_append(buf, 0, fmt, (int) (stars)[0].i, value); \
+			break; \
+		default: \
+			ast_str_append(buf, 0, fmt, (int) (stars)[0].i, (int) (stars)[1].i, value); \
+			break; \
+		} \
+	} while (0)
+
+/* The conversions are rebuilt from format strings checked when recorded */
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static void trace_record_decode(struct ast_str **buf, const struct trace_record *record)
+{
+	const union trace_arg *arg = record->args;
+	const union trace_arg *end = record->args + record->nargs;
+	const char *p = record->fmt;
+	const char *percent;
+	struct trace_spec spec;
+
+	while ((percent = strchr(p, '%'))) {
+		const union trace_arg *stars;
+		const char *next;
+		char conv_fmt[64];
+		char *length;
+
+		ast_str_append_substr(buf, 0, p, percent - p);
+
+		if (!(next = trace_spec_parse(percent + 1, &spec))
+			|| end - arg < trace_spec_args(&spec)
+			|| spec.flags_len > sizeof(conv_fmt) - 5) {
+			/* Past what was recorded */
+			p = percent;
+			break;
+		}
+		p = next;
+
+		if (spec.conv == '%') {
+			ast_str_append(buf, 0, "%%");
+			continue;
+		}
+
+		stars = arg;
+		arg += spec.stars;
+
+		/* Rebuild the conversion for the type it was stored as */
+		conv_fmt[0] = '%';
+		memcpy(conv_fmt + 1, spec.flags, spec.flags_len);
+		length = conv_fmt + 1 + spec.flags_len;
+		length[0] = '\0';
+
+		switch (spec.conv) {
+		case 'n':
+			break;
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			if (spec.length == TRACE_LENGTH_HH) {
+				strcpy(length, "hh");
+			} else if (spec.length == TRACE_LENGTH_H) {
+				strcpy(length, "h");
+			} else if (spec.length != TRACE_LENGTH_NONE) {
+				strcpy(length, "ll");
+			}
+			strncat(length, &spec.conv, 1);
+			if (spec.length == TRACE_LENGTH_NONE || spec.length == TRACE_LENGTH_HH
+				|| spec.length == TRACE_LENGTH_H) {
+				TRACE_APPEND(buf, conv_fmt, stars, spec.stars, (int) arg->i);
+			} else {
+				TRACE_APPEND(buf, conv_fmt, stars, spec.stars, arg->i);
+			}
+			arg++;
+			break;
+		case 'c':
+			strcpy(length, "c");
+			TRACE_APPEND(buf, conv_fmt, stars, spec.stars, (int) arg->i);
+			arg++;
+			break;
+		case 'p':
+			strcpy(length, "p");
+			TRACE_APPEND(buf, conv_fmt, stars, spec.stars, arg->p);
+			arg++;
+			break;
+		case 's':
+			strcpy(length, "s");
+			TRACE_APPEND(buf, conv_fmt, stars, spec.stars,
+				arg->str < 0 ? "(null)" : record->strings + arg->str);
+			arg++;
+			break;
+		default:
+			strncat(length, &spec.conv, 1);
+			TRACE_APPEND(buf, conv_fmt, stars, spec.stars, arg->d);
+			arg++;
+			break;
+		}
+	}
+
+	ast_str_append(buf, 0, "%s", p);
+}
+#pragma GCC diagnostic warning "-Wformat-nonliteral"
+
+/*! \brief A record copied out of a ring */
+struct trace_entry {
+	int tid;
+	struct trace_record record;
+};
+
+struct trace_collect {
+	/*! Thread to collect, 0 for all */
+	int tid;
+	struct trace_entry *entries;
+	size_t count;
+	size_t size;
+};
+
+static int trace_ring_collect(void *obj, void *arg, int flags)
+{
+	struct trace_ring *ring = obj;
+	struct trace_collect *collect = arg;
+	unsigned int head;
+	unsigned int first;
+	unsigned int seq;
+	size_t start = collect->count;
+	size_t i;
+
+	if (collect->tid && ring->tid != collect->tid) {
+		return 0;
+	}
+
+	head = ast_atomic_fetch_add(&ring->head, 0, __ATOMIC_ACQUIRE);
+	/* The slot after the newest may be mid write, so it is never read */
+	first = head - (AST_TRACE_RING_SIZE - 1);
+	if (first - ring->floor > head - ring->floor) {
+		/* Not that many taken since the ring was last cleared */
+		first = ring->floor;
+	}
+	if (head - first + collect->count > collect->size) {
+		size_t size = collect->size + AST_TRACE_RING_SIZE;
+		struct trace_entry *entries = ast_realloc(collect->entries, size * sizeof(*entries));
+
+		if (!entries) {
+			return CMP_STOP;
+		}
+		collect->entries = entries;
+		collect->size = size;
+	}
+
+	for (seq = first; seq != head; seq++) {
+		collect->entries[collect->count].tid = ring->tid;
+		collect->entries[collect->count].record = ring->records[seq % AST_TRACE_RING_SIZE];
+		collect->count++;
+	}
+
+	/* Drop whatever the writer may have overwritten while they were copied */
+	head = ast_atomic_fetch_add(&ring->head, 0, __ATOMIC_ACQUIRE);
+	if (head - first > AST_TRACE_RING_SIZE - 1) {
+		size_t lapped = head - first - (AST_TRACE_RING_SIZE - 1);
+
+		if (lapped > collect->count - start) {
+			lapped = collect->count - start;
+		}
+		for (i = start; i + lapped < collect->count; i++) {
+			collect->entries[i] = collect->entries[i + lapped];
+		}
+		collect->count -= lapped;
+	}
+
+	return 0;
+}
+
+static int trace_entry_cmp(const void *a, const void *b)
+{
+	const struct trace_entry *left = a;
+	const struct trace_entry *right = b;
+
+	if (left->record.ts.tv_sec != right->record.ts.tv_sec) {
+		return left->record.ts.tv_sec < right->record.ts.tv_sec ? -1 : 1;
+	}
+	if (left->record.ts.tv_nsec != right->record.ts.tv_nsec) {
+		return left->record.ts.tv_nsec < right->record.ts.tv_nsec ? -1 : 1;
+	}
+	return 0;
+}
+
+struct ast_str *ast_trace_ring_get(int tid, unsigned int count)
+{
+	struct trace_collect collect = { .tid = tid, };
+	struct ast_str *buf;
+	size_t i;
+
+	if (!rings || !(buf = ast_str_create(256))) {
+		return NULL;
+	}
+
+	ao2_callback(rings, OBJ_NODATA, trace_ring_collect, &collect);
+	qsort(collect.entries, collect.count, sizeof(*collect.entries), trace_entry_cmp);
+
+	for (i = count && count < collect.count ? collect.count - count : 0; i < collect.count; i++) {
+		const struct trace_entry *entry = &collect.entries[i];
+
+		ast_str_append(&buf, 0, "[%ld.%09ld] [%d] %s:%d %s: ",
+			(long) entry->record.ts.tv_sec, entry->record.ts.tv_nsec, entry->tid,
+			entry->record.file, entry->record.line, entry->record.func);
+		trace_record_decode(&buf, &entry->record);
+		if (!ast_ends_with(ast_str_buffer(buf), "\n")) {
+			ast_str_append(&buf, 0, "\n");
+		}
+	}
+	ast_free(collect.entries);
+
+	return buf;
+}
+
+void ast_trace_ring_enable(int enabled)
+{
+	ast_trace_ring_enabled = enabled ? 1 : 0;
+}
+
+static int trace_ring_clear_cb(void *obj, void *arg, int flags)
+{
+	struct trace_ring *ring = obj;
+
+	ring->floor = ast_atomic_fetch_add(&ring->head, 0, __ATOMIC_ACQUIRE);
+
+	return 0;
+}
+
+void ast_trace_ring_clear(void)
+{
+	if (rings) {
+		ao2_callback(rings, OBJ_NODATA, trace_ring_clear_cb, NULL);
+	}
+}
+
+static char *handle_trace_ring_set(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "trace ring {on|off}";
+		e->usage =
+			"Usage: trace ring {on|off}\n"
+			"       Start or stop taking records in the binary trace ring.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != e->args) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_trace_ring_enable(ast_true(a->argv[2]));
+	ast_cli(a->fd, "Trace ring is now %s.\n", ast_trace_ring_enabled ? "on" : "off");
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_trace_ring_show(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct ast_str *buf;
+	unsigned int count = 0;
+	int tid = 0;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "trace ring show";
+		e->usage =
+			"Usage: trace ring show [<count> [<thread id>]]\n"
+			"       Decode the newest <count> records in the binary trace ring,\n"
+			"       or all of them.  Only records taken by <thread id> are\n"
+			"       shown if it is given.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc > 5
+		|| (a->argc > 3 && sscanf(a->argv[3], "%30u", &count) != 1)
+		|| (a->argc > 4 && sscanf(a->argv[4], "%30d", &tid) != 1)) {
+		return CLI_SHOWUSAGE;
+	}
+
+	buf = ast_trace_ring_get(tid, count);
+	if (!buf) {
+		return CLI_FAILURE;
+	}
+	ast_cli(a->fd, "%s", ast_str_buffer(buf));
+	ast_cli(a->fd, "Trace ring is %s, %d thread%s with records.\n",
+		ast_trace_ring_enabled ? "on" : "off", ao2_container_count(rings),
+		ESS(ao2_container_count(rings)));
+	ast_free(buf);
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_trace_ring_clear(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "trace ring clear";
+		e->usage =
+			"Usage: trace ring clear\n"
+			"       Throw away every record in the binary trace ring.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != e->args) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_trace_ring_clear();
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_trace_ring[] = {
+	AST_CLI_DEFINE(handle_trace_ring_set, "Turn the binary trace ring on or off"),
+	AST_CLI_DEFINE(handle_trace_ring_show, "Decode the binary trace ring"),
+	AST_CLI_DEFINE(handle_trace_ring_clear, "Clear the binary trace ring"),
+};
+
+static void trace_ring_shutdown(void)
+{
+	ast_trace_ring_enabled = 0;
+	ast_cli_unregister_multiple(cli_trace_ring, ARRAY_LEN(cli_trace_ring));
+	ao2_cleanup(rings);
+	rings = NULL;
+}
+
+int ast_trace_ring_init(void)
+{
+	rings = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_MUTEX, 0, NULL, NULL);
+	if (!rings) {
+		return -1;
+	}
+
+	ast_cli_register_multiple(cli_trace_ring, ARRAY_LEN(cli_trace_ring));
+	ast_register_cleanup(trace_ring_shutdown);
+
+	return 0;
+}
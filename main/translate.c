@@ -43,6 +43,8 @@
 #include "asterisk/term.h"
 #include "asterisk/format.h"
 #include "asterisk/linkedlists.h"
+#include "asterisk/g711.h"
+#include "asterisk/trace_ring.h"
 
 /*! \todo
  * TODO: sample frames for each supported input format.
@@ -288,7 +290,29 @@ static struct translator_path *matrix_get(unsigned int x, unsigned int y)
  * wrappers around the translator routines.
  */
 
-static void destroy(struct ast_trans_pvt *pvt)
+/*! Most idle instances kept for reuse per translator */
+#define TRANSLATOR_POOL_MAX 32
+
+/*! Protects the idle instance pool and counters of every translator */
+AST_MUTEX_DEFINE_STATIC(pool_lock);
+
+/*! \brief Size of the single allocation holding a translator instance */
+static int pvt_size(struct ast_translator *t)
+{
+	int len = sizeof(struct ast_trans_pvt) + t->desc_size;
+
+	if (t->buf_size) {
+		len += AST_FRIENDLY_OFFSET + t->buf_size;
+	}
+
+	return len;
+}
+
+/*!
+ * \brief Release everything an instance holds except its memory
+ * and the module reference.
+ */
+static void pvt_release(struct ast_trans_pvt *pvt)
 {
 	struct ast_translator *t = pvt->t;
 
@@ -296,35 +320,31 @@ static void destroy(struct ast_trans_pvt *pvt)
 		t->destroy(pvt);
 	}
 	ao2_cleanup(pvt->f.subclass.format);
+	pvt->f.subclass.format = NULL;
 	if (pvt->explicit_dst) {
 		ao2_ref(pvt->explicit_dst, -1);
 		pvt->explicit_dst = NULL;
 	}
+}
+
+static void destroy(struct ast_trans_pvt *pvt)
+{
+	struct ast_translator *t = pvt->t;
+
+	pvt_release(pvt);
 	ast_free(pvt);
 	ast_module_unref(t->module);
 }
 
 /*!
- * \brief Allocate the descriptor, required outbuf space,
- * and possibly desc.
+ * \brief Set up a zeroed instance of a translator.
+ *
+ * \note The instance is freed on failure.
  */
-static struct ast_trans_pvt *newpvt(struct ast_translator *t, struct ast_format *explicit_dst)
+static int pvt_init(struct ast_trans_pvt *pvt, struct ast_translator *t, struct ast_format *explicit_dst)
 {
-	struct ast_trans_pvt *pvt;
-	int len;
 	char *ofs;
 
-	/*
-	 * compute the required size adding private descriptor,
-	 * buffer, AST_FRIENDLY_OFFSET.
-	 */
-	len = sizeof(*pvt) + t->desc_size;
-	if (t->buf_size)
-		len += AST_FRIENDLY_OFFSET + t->buf_size;
-	pvt = ast_calloc(1, len);
-	if (!pvt) {
-		return NULL;
-	}
 	pvt->t = t;
 	ofs = (char *)(pvt + 1);	/* pointer to data space */
 	if (t->desc_size) {		/* first comes the descriptor */
@@ -345,9 +365,10 @@ static struct ast_trans_pvt *newpvt(struct ast_translator *t, struct ast_format
 
 	/* call local init routine, if present */
 	if (t->newpvt && t->newpvt(pvt)) {
+		ao2_cleanup(pvt->explicit_dst);
 		ast_free(pvt);
 		ast_module_unref(t->module);
-		return NULL;
+		return -1;
 	}
 
 	/* Setup normal static translation frame. */
@@ -376,7 +397,7 @@ static struct ast_trans_pvt *newpvt(struct ast_translator *t, struct ast_format
 			if (!codec) {
 				ast_log(LOG_ERROR, "Unable to get destination codec\n");
 				destroy(pvt);
-				return NULL;
+				return -1;
 			}
 			pvt->f.subclass.format = ast_format_create(codec);
 			ao2_ref(codec, -1);
@@ -385,15 +406,183 @@ static struct ast_trans_pvt *newpvt(struct ast_translator *t, struct ast_format
 		if (!pvt->f.subclass.format) {
 			ast_log(LOG_ERROR, "Unable to create format\n");
 			destroy(pvt);
-			return NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*!
+ * \brief Allocate the descriptor, required outbuf space,
+ * and possibly desc.
+ */
+static struct ast_trans_pvt *newpvt(struct ast_translator *t, struct ast_format *explicit_dst)
+{
+	struct ast_trans_pvt *pvt;
+
+	/*
+	 * compute the required size adding private descriptor,
+	 * buffer, AST_FRIENDLY_OFFSET.
+	 */
+	pvt = ast_calloc(1, pvt_size(t));
+	if (!pvt) {
+		return NULL;
+	}
+
+	return pvt_init(pvt, t, explicit_dst) ? NULL : pvt;
+}
+
+/*!
+ * \brief Can instances of the translator be reused?
+ *
+ * Instances of translators without a destroy callback own nothing
+ * beyond their own memory, so they are simply set up again.  Other
+ * translators must be able to reset their state.
+ */
+static int pool_supported(struct ast_translator *t)
+{
+	return t->reset || !t->destroy;
+}
+
+static int pool_dst_match(struct ast_format *a, struct ast_format *b)
+{
+	return a == b || (a && b && ast_format_cmp(a, b) == AST_FORMAT_CMP_EQUAL);
+}
+
+/*! \brief Get an instance of a translator, from its pool if possible */
+static struct ast_trans_pvt *pool_get(struct ast_translator *t, struct ast_format *explicit_dst)
+{
+	struct ast_trans_pvt *pvt;
+	struct ast_trans_pvt *prev = NULL;
+
+	if (!pool_supported(t)) {
+		return newpvt(t, explicit_dst);
+	}
+
+	ast_mutex_lock(&pool_lock);
+	for (pvt = t->pool; pvt; prev = pvt, pvt = pvt->next) {
+		/* Reset instances keep the destination they were set up for */
+		if (!t->reset || pool_dst_match(pvt->explicit_dst, explicit_dst)) {
+			break;
 		}
 	}
+	if (pvt) {
+		if (prev) {
+			prev->next = pvt->next;
+		} else {
+			t->pool = pvt->next;
+		}
+		pvt->next = NULL;
+		t->pool_size--;
+		t->pool_hits++;
+	} else {
+		t->pool_misses++;
+	}
+	ast_mutex_unlock(&pool_lock);
 
-	return pvt;
+	if (!pvt) {
+		return newpvt(t, explicit_dst);
+	}
+
+	if (t->reset) {
+		ast_module_ref(t->module);
+		return pvt;
+	}
+
+	return pvt_init(pvt, t, explicit_dst) ? NULL : pvt;
+}
+
+/*! \brief Return an instance of a translator to its pool, or free it */
+static void pool_put(struct ast_trans_pvt *pvt)
+{
+	struct ast_translator *t = pvt->t;
+	int full;
+
+	if (!pool_supported(t)) {
+		destroy(pvt);
+		return;
+	}
+
+	/* Reserve the slot first so a full pool costs nothing but the free */
+	ast_mutex_lock(&pool_lock);
+	full = t->pool_size >= TRANSLATOR_POOL_MAX;
+	if (!full) {
+		t->pool_size++;
+	}
+	ast_mutex_unlock(&pool_lock);
+
+	if (full) {
+		destroy(pvt);
+		return;
+	}
+
+	if (t->reset) {
+		if (t->reset(pvt)) {
+			ast_mutex_lock(&pool_lock);
+			t->pool_size--;
+			ast_mutex_unlock(&pool_lock);
+			destroy(pvt);
+			return;
+		}
+		pvt->samples = 0;
+		pvt->datalen = 0;
+		pvt->interleaved_stereo = 0;
+		ast_clear_flag(&pvt->f, AST_FRFLAG_HAS_TIMING_INFO);
+		pvt->f.ts = 0;
+		pvt->f.len = 0;
+		pvt->f.seqno = 0;
+	} else {
+		pvt_release(pvt);
+		memset(pvt, 0, sizeof(*pvt) + t->desc_size);
+		pvt->t = t;
+	}
+
+	ast_mutex_lock(&pool_lock);
+	pvt->next = t->pool;
+	t->pool = pvt;
+	ast_mutex_unlock(&pool_lock);
+
+	/*
+	 * Only drop the module reference once the instance is in the pool
+	 * so unregistering the translator is sure to find it there.
+	 */
+	ast_module_unref(t->module);
+}
+
+/*! \brief Free every idle instance of a translator */
+static void pool_flush(struct ast_translator *t)
+{
+	struct ast_trans_pvt *pvt;
+
+	ast_mutex_lock(&pool_lock);
+	pvt = t->pool;
+	t->pool = NULL;
+	t->pool_size = 0;
+	ast_mutex_unlock(&pool_lock);
+
+	while (pvt) {
+		struct ast_trans_pvt *next = pvt->next;
+
+		if (t->reset) {
+			/* Idle instances do not hold a module reference */
+			pvt_release(pvt);
+		}
+		ast_free(pvt);
+		pvt = next;
+	}
 }
 
 /*! \brief framein wrapper, deals with bound checks.  */
-static int framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
+/*!
+ * \internal
+ * \brief Generic checks made before a frame is passed to a translator
+ *
+ * \retval 1 if the frame should be passed to the translator
+ * \retval 0 if it should be skipped
+ * \retval -1 if it does not fit in the translator's buffer
+ */
+static int framein_prepare(struct ast_trans_pvt *pvt, struct ast_frame *f)
 {
 	/* Copy the last in jb timing info to the pvt */
 	ast_copy_flags(&pvt->f, f, AST_FRFLAG_HAS_TIMING_INFO);
@@ -424,6 +613,16 @@ static int framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
 			return -1;
 		}
 	}
+	return 1;
+}
+
+static int framein(struct ast_trans_pvt *pvt, struct ast_frame *f)
+{
+	int res = framein_prepare(pvt, f);
+
+	if (res <= 0) {
+		return res;
+	}
 	/* we require a framein routine, wouldn't know how to do
 	 * it otherwise.
 	 */
@@ -477,7 +676,7 @@ void ast_translator_free_path(struct ast_trans_pvt *p)
 	struct ast_trans_pvt *pn = p;
 	while ( (p = pn) ) {
 		pn = p->next;
-		destroy(p);
+		pool_put(p);
 	}
 }
 
@@ -511,7 +710,7 @@ struct ast_trans_pvt *ast_translator_build_path(struct ast_format *dst, struct a
 		if ((t->dst_codec.sample_rate == ast_format_get_sample_rate(dst)) && (t->dst_codec.type == ast_format_get_type(dst))) {
 			explicit_dst = dst;
 		}
-		if (!(cur = newpvt(t, explicit_dst))) {
+		if (!(cur = pool_get(t, explicit_dst))) {
 			ast_log(LOG_WARNING, "Failed to build translator step from %s to %s\n",
 				ast_format_get_name(src), ast_format_get_name(dst));
 			ast_translator_free_path(head);
@@ -561,32 +760,27 @@ static struct ast_frame *generate_interpolated_slin(struct ast_trans_pvt *p, str
 	return ast_frdup(&res);
 }
 
-/*! \brief do the actual translation */
-struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f, int consume)
-{
-	struct ast_trans_pvt *p = path;
-	struct ast_frame *out;
+/*! \brief Timing of an input frame, restored on the translated output */
+struct translate_timing {
 	struct timeval delivery;
+	struct timeval ingress;
 	int has_timing_info;
 	long ts;
 	long len;
 	int seqno;
+};
 
-	if (f->frametype == AST_FRAME_RTCP) {
-		/* Just pass the feedback to the right callback, if it exists.
-		 * This "translation" does nothing so return a null frame. */
-		struct ast_trans_pvt *tp;
-		for (tp = p; tp; tp = tp->next) {
-			if (tp->t->feedback)
-				tp->t->feedback(tp, f);
-		}
-		return &ast_null_frame;
-	}
-
-	has_timing_info = ast_test_flag(f, AST_FRFLAG_HAS_TIMING_INFO);
-	ts = f->ts;
-	len = f->len;
-	seqno = f->seqno;
+/*!
+ * \internal
+ * \brief Note the timing of a frame entering a path and predict the next one
+ */
+static void translate_timing_in(struct ast_trans_pvt *path, struct ast_frame *f,
+	struct translate_timing *timing)
+{
+	timing->has_timing_info = ast_test_flag(f, AST_FRFLAG_HAS_TIMING_INFO);
+	timing->ts = f->ts;
+	timing->len = f->len;
+	timing->seqno = f->seqno;
 
 	if (!ast_tvzero(f->delivery)) {
 		if (!ast_tvzero(path->nextin)) {
@@ -610,28 +804,34 @@ struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f,
 		path->nextin = ast_tvadd(path->nextin, ast_samp2tv(
 			 f->samples, ast_format_get_sample_rate(f->subclass.format)));
 	}
-	delivery = f->delivery;
-	for (out = f; out && p ; p = p->next) {
-		struct ast_frame *current = out;
-
-		do {
-			framein(p, current);
-			current = AST_LIST_NEXT(current, frame_list);
-		} while (current);
-		if (out != f) {
-			ast_frfree(out);
-		}
-		out = p->t->frameout(p);
-	}
+	timing->delivery = f->delivery;
+	timing->ingress = f->ingress;
+}
 
+/*!
+ * \internal
+ * \brief Fill in the output of a path, interpolating it if needed, and time it
+ *
+ * \return the output frame, NULL if there is none
+ */
+static struct ast_frame *translate_timing_out(struct ast_trans_pvt *path, struct ast_frame *f,
+	struct ast_frame *out, const struct translate_timing *timing)
+{
 	if (!out) {
 		out = generate_interpolated_slin(path, f);
 	}
 
 	if (out) {
+		struct ast_frame *current;
+
+		/* The output carries the media that entered with the input */
+		for (current = out; current; current = AST_LIST_NEXT(current, frame_list)) {
+			current->ingress = timing->ingress;
+		}
+
 		/* we have a frame, play with times */
-		if (!ast_tvzero(delivery)) {
-			struct ast_frame *current = out;
+		if (!ast_tvzero(timing->delivery)) {
+			current = out;
 
 			do {
 				/* Regenerate prediction after a discontinuity */
@@ -660,11 +860,11 @@ struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f,
 			} while (current);
 		} else {
 			out->delivery = ast_tv(0, 0);
-			ast_set2_flag(out, has_timing_info, AST_FRFLAG_HAS_TIMING_INFO);
-			if (has_timing_info) {
-				out->ts = ts;
-				out->len = len;
-				out->seqno = seqno;
+			ast_set2_flag(out, timing->has_timing_info, AST_FRFLAG_HAS_TIMING_INFO);
+			if (timing->has_timing_info) {
+				out->ts = timing->ts;
+				out->len = timing->len;
+				out->seqno = timing->seqno;
 			}
 			/* Invalidate prediction if we're entering a silence period */
 			if (out->frametype == AST_FRAME_CNG) {
@@ -672,12 +872,170 @@ struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f,
 			}
 		}
 	}
+
+	return out;
+}
+
+/*! \brief do the actual translation */
+struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f, int consume)
+{
+	struct ast_trans_pvt *p = path;
+	struct ast_frame *out;
+	struct translate_timing timing;
+
+	if (f->frametype == AST_FRAME_RTCP) {
+		/* Just pass the feedback to the right callback, if it exists.
+		 * This "translation" does nothing so return a null frame. */
+		struct ast_trans_pvt *tp;
+		for (tp = p; tp; tp = tp->next) {
+			if (tp->t->feedback)
+				tp->t->feedback(tp, f);
+		}
+		return &ast_null_frame;
+	}
+
+	translate_timing_in(path, f, &timing);
+	for (out = f; out && p ; p = p->next) {
+		struct ast_frame *current = out;
+
+		do {
+			framein(p, current);
+			current = AST_LIST_NEXT(current, frame_list);
+		} while (current);
+		if (out != f) {
+			ast_frfree(out);
+		}
+		out = p->t->frameout(p);
+	}
+
+	out = translate_timing_out(path, f, out, &timing);
+	ast_trace_ring("%s -> %s: %d samples in, %d out", path->t->src_codec.name,
+		path->t->dst_codec.name, f->samples, out ? out->samples : 0);
 	if (consume) {
 		ast_frfree(f);
 	}
 	return out;
 }
 
+/*! Most paths handed to a framein_batch callback in one call */
+#define TRANSLATE_BATCH_MAX 32
+
+int ast_translator_can_batch(const struct ast_trans_pvt *path)
+{
+	return path && !path->next && path->t->framein_batch;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a frame on a path can go through the batch callback
+ */
+static int translate_batchable(struct ast_trans_pvt *path, struct ast_frame *f)
+{
+	return ast_translator_can_batch(path) && f->frametype == AST_FRAME_VOICE
+		&& !AST_LIST_NEXT(f, frame_list);
+}
+
+/*!
+ * \internal
+ * \brief Translate a run of frames on single step paths sharing a translator
+ */
+static void translate_batch_run(struct ast_translator *t, struct ast_trans_pvt **paths,
+	struct ast_frame **frames, struct ast_frame **out, int count)
+{
+	struct ast_trans_pvt *pvts[TRANSLATE_BATCH_MAX];
+	struct ast_frame *in[TRANSLATE_BATCH_MAX];
+	struct translate_timing timing[TRANSLATE_BATCH_MAX];
+	int ready = 0;
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		translate_timing_in(paths[i], frames[i], &timing[i]);
+		if (framein_prepare(paths[i], frames[i]) > 0) {
+			pvts[ready] = paths[i];
+			in[ready] = frames[i];
+			++ready;
+		}
+	}
+
+	if (ready) {
+		t->framein_batch(pvts, in, ready);
+	}
+
+	for (i = 0; i < count; ++i) {
+		out[i] = translate_timing_out(paths[i], frames[i], t->frameout(paths[i]), &timing[i]);
+	}
+}
+
+int ast_translate_batch(struct ast_trans_pvt **paths, struct ast_frame **frames,
+	struct ast_frame **out, int count)
+{
+	int translated = 0;
+	int i = 0;
+
+	while (i < count) {
+		struct ast_translator *t = paths[i]->t;
+		int run;
+
+		if (!translate_batchable(paths[i], frames[i])) {
+			out[i] = ast_translate(paths[i], frames[i], 0);
+			translated += out[i] ? 1 : 0;
+			++i;
+			continue;
+		}
+
+		for (run = 1; run < TRANSLATE_BATCH_MAX && i + run < count; ++run) {
+			if (paths[i + run]->t != t || !translate_batchable(paths[i + run], frames[i + run])) {
+				break;
+			}
+		}
+
+		ast_trace_ring("%s -> %s: batch of %d", t->src_codec.name, t->dst_codec.name, run);
+		translate_batch_run(t, paths + i, frames + i, out + i, run);
+		for (; run; --run, ++i) {
+			translated += out[i] ? 1 : 0;
+		}
+	}
+
+	return translated;
+}
+
+/*!
+ * \internal
+ * \brief Feed sample frames through a translator instance.
+ *
+ * \param pvt Translator instance
+ * \param samples Number of output samples to produce
+ * \param frames If not NULL, incremented for every output frame
+ *
+ * \retval 0 on success
+ * \retval -1 if the translator failed to produce a sample frame
+ */
+static int translate_sample_frames(struct ast_trans_pvt *pvt, int samples, int *frames)
+{
+	struct ast_translator *t = pvt->t;
+	int num_samples = 0;
+
+	/* Call the encoder until we've processed the required number of samples */
+	while (num_samples < samples) {
+		struct ast_frame *f = t->sample();
+		if (!f) {
+			ast_log(LOG_WARNING, "Translator '%s' failed to produce a sample frame.\n", t->name);
+			return -1;
+		}
+		framein(pvt, f);
+		ast_frfree(f);
+		while ((f = t->frameout(pvt))) {
+			num_samples += f->samples;
+			if (frames) {
+				++*frames;
+			}
+			ast_frfree(f);
+		}
+	}
+
+	return 0;
+}
+
 /*!
  * \internal
  * \brief Compute the computational cost of a single translation step.
@@ -689,7 +1047,6 @@ struct ast_frame *ast_translate(struct ast_trans_pvt *path, struct ast_frame *f,
  */
 static void generate_computational_cost(struct ast_translator *t, int seconds)
 {
-	int num_samples = 0;
 	struct ast_trans_pvt *pvt;
 	struct rusage start;
 	struct rusage end;
@@ -716,21 +1073,10 @@ static void generate_computational_cost(struct ast_translator *t, int seconds)
 
 	getrusage(RUSAGE_SELF, &start);
 
-	/* Call the encoder until we've processed the required number of samples */
-	while (num_samples < seconds * out_rate) {
-		struct ast_frame *f = t->sample();
-		if (!f) {
-			ast_log(LOG_WARNING, "Translator '%s' failed to produce a sample frame.\n", t->name);
-			destroy(pvt);
-			t->comp_cost = 999999;
-			return;
-		}
-		framein(pvt, f);
-		ast_frfree(f);
-		while ((f = t->frameout(pvt))) {
-			num_samples += f->samples;
-			ast_frfree(f);
-		}
+	if (translate_sample_frames(pvt, seconds * out_rate, NULL)) {
+		destroy(pvt);
+		t->comp_cost = 999999;
+		return;
 	}
 
 	getrusage(RUSAGE_SELF, &end);
@@ -1161,15 +1507,154 @@ static char *handle_show_translation_path(struct ast_cli_args *a, const char *co
 	return CLI_SUCCESS;
 }
 
+static char *handle_show_translation_pool(struct ast_cli_args *a)
+{
+	struct ast_translator *t;
+	int count = 0;
+
+	ast_cli(a->fd, "%-30s %6s %10s %10s %6s\n", "Translator", "Idle", "Hits", "Misses", "Hit%");
+
+	AST_RWLIST_RDLOCK(&translators);
+	AST_RWLIST_TRAVERSE(&translators, t, list) {
+		unsigned int hits;
+		unsigned int misses;
+		int idle;
+
+		if (!pool_supported(t)) {
+			continue;
+		}
+
+		ast_mutex_lock(&pool_lock);
+		hits = t->pool_hits;
+		misses = t->pool_misses;
+		idle = t->pool_size;
+		ast_mutex_unlock(&pool_lock);
+
+		/* Translators that were never part of a path are not interesting */
+		if (!hits && !misses) {
+			continue;
+		}
+
+		ast_cli(a->fd, "%-30s %6d %10u %10u %5.1f%%\n", t->name, idle, hits, misses,
+			100.0 * hits / (hits + misses));
+		++count;
+	}
+	AST_RWLIST_UNLOCK(&translators);
+
+	ast_cli(a->fd, "%d pooled translator%s used\n", count, ESS(count));
+
+	return CLI_SUCCESS;
+}
+
+/*! Samples in each frame given to the G.711 decoding kernels while benchmarking */
+#define BENCHMARK_G711_SAMPLES 160
+
+/*! Frames decoded by each G.711 kernel per benchmark second */
+#define BENCHMARK_G711_FRAMES 100000
+
+static void benchmark_g711(struct ast_cli_args *a, int seconds)
+{
+	unsigned char in[BENCHMARK_G711_SAMPLES];
+	short out[BENCHMARK_G711_SAMPLES];
+	int frames = seconds * BENCHMARK_G711_FRAMES;
+	int impl;
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(in); i++) {
+		in[i] = ast_random();
+	}
+
+	ast_cli(a->fd, "\n%-20s %16s %16s\n", "G.711 kernel", "ulaw ns/frame", "alaw ns/frame");
+	for (impl = 0; impl < AST_G711_IMPL_MAX; impl++) {
+		const struct ast_g711_ops *ops = ast_g711_get_ops(impl);
+		struct timeval start;
+		int64_t ulaw_us;
+		int64_t alaw_us;
+
+		if (!ops) {
+			continue;
+		}
+
+		start = ast_tvnow();
+		for (i = 0; i < frames; i++) {
+			ops->ulaw_decode(out, in, ARRAY_LEN(in));
+		}
+		ulaw_us = ast_tvdiff_us(ast_tvnow(), start);
+
+		start = ast_tvnow();
+		for (i = 0; i < frames; i++) {
+			ops->alaw_decode(out, in, ARRAY_LEN(in));
+		}
+		alaw_us = ast_tvdiff_us(ast_tvnow(), start);
+
+		ast_cli(a->fd, "%-20s %16.1f %16.1f%s\n", ops->name,
+			1000.0 * ulaw_us / frames, 1000.0 * alaw_us / frames,
+			ops == ast_g711_active_ops() ? " (active)" : "");
+	}
+}
+
+static char *handle_show_translation_benchmark(struct ast_cli_args *a)
+{
+	struct ast_translator *t;
+	int seconds = a->argc == 5 ? atoi(a->argv[4]) : 1;
+
+	if (seconds <= 0) {
+		ast_cli(a->fd, "Benchmark must be greater than 0.  Defaulting to 1.\n");
+		seconds = 1;
+	}
+	if (seconds > MAX_RECALC) {
+		ast_cli(a->fd, "Maximum limit of benchmark exceeded by %d, truncating value to %d\n",
+			seconds - MAX_RECALC, MAX_RECALC);
+		seconds = MAX_RECALC;
+	}
+
+	ast_cli(a->fd, "%-30s %10s %12s\n", "Translator", "Frames", "ns/frame");
+
+	AST_RWLIST_RDLOCK(&translators);
+	AST_RWLIST_TRAVERSE(&translators, t, list) {
+		struct ast_trans_pvt *pvt;
+		struct timeval start;
+		int64_t elapsed;
+		int frames = 0;
+		int res;
+
+		if (!t->sample) {
+			continue;
+		}
+
+		pvt = newpvt(t, NULL);
+		if (!pvt) {
+			continue;
+		}
+
+		start = ast_tvnow();
+		res = translate_sample_frames(pvt, seconds * t->dst_codec.sample_rate, &frames);
+		elapsed = ast_tvdiff_us(ast_tvnow(), start);
+		destroy(pvt);
+
+		if (res || !frames) {
+			ast_cli(a->fd, "%-30s %10s %12s\n", t->name, "-", "failed");
+			continue;
+		}
+
+		ast_cli(a->fd, "%-30s %10d %12.0f\n", t->name, frames, 1000.0 * elapsed / frames);
+	}
+	AST_RWLIST_UNLOCK(&translators);
+
+	benchmark_g711(a, seconds);
+
+	return CLI_SUCCESS;
+}
+
 static char *handle_cli_core_show_translation(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
-	static const char * const option[] = { "recalc", "paths", NULL };
+	static const char * const option[] = { "recalc", "paths", "pool", "benchmark", NULL };
 
 	switch (cmd) {
 	case CLI_INIT:
 		e->command = "core show translation";
 		e->usage =
-			"Usage: 'core show translation' can be used in two ways.\n"
+			"Usage: 'core show translation' can be used in four ways.\n"
 			"       1. 'core show translation [recalc [<recalc seconds>]]\n"
 			"          Displays known codec translators and the cost associated\n"
 			"          with each conversion.  If the argument 'recalc' is supplied along\n"
@@ -1178,7 +1663,14 @@ static char *handle_cli_core_show_translation(struct ast_cli_entry *e, int cmd,
 			"       2. 'core show translation paths [codec [sample_rate]]'\n"
 			"           This will display all the translation paths associated with a codec.\n"
 			"           If a codec has multiple sample rates, the sample rate must be\n"
-			"           provided as well.\n";
+			"           provided as well.\n"
+			"       3. 'core show translation pool'\n"
+			"           Displays how often building a translation path reused an\n"
+			"           idle translator instance instead of allocating one.\n"
+			"       4. 'core show translation benchmark [<seconds>]'\n"
+			"           Times each translator over the given number of seconds of\n"
+			"           sample audio and each G.711 decoding kernel supported by\n"
+			"           this CPU, and displays the time spent per frame.\n";
 		return NULL;
 	case CLI_GENERATE:
 		if (a->pos == 3) {
@@ -1203,6 +1695,10 @@ static char *handle_cli_core_show_translation(struct ast_cli_entry *e, int cmd,
 			return CLI_FAILURE;
 		}
 		return handle_show_translation_path(a, a->argv[4], sample_rate);
+	} else if (a->argv[3] && !strcasecmp(a->argv[3], option[2]) && a->argc == 4) {
+		return handle_show_translation_pool(a);
+	} else if (a->argv[3] && !strcasecmp(a->argv[3], option[3]) && a->argc <= 5) {
+		return handle_show_translation_benchmark(a);
 	} else if (a->argv[3] && !strcasecmp(a->argv[3], option[0])) { /* recalc and then fall through to show table */
 		handle_cli_recalc(a);
 	} else if (a->argc > 3) { /* wrong input */
@@ -1355,6 +1851,10 @@ int ast_unregister_translator(struct ast_translator *t)
 
 	AST_RWLIST_UNLOCK(&translators);
 
+	if (found) {
+		pool_flush(t);
+	}
+
 	return (u ? 0 : -1);
 }
 
@@ -378,6 +378,24 @@ static int encode_open_type(const struct ast_udptl *udptl, uint8_t *buf, unsigne
 }
 /*- End of function --------------------------------------------------------*/
 
+/*! \brief XOR len octets of src into dst, a machine word at a time where possible */
+static inline void udptl_xor(uint8_t *dst, const uint8_t *src, unsigned int len)
+{
+	unsigned int i = 0;
+	uint64_t d;
+	uint64_t v;
+
+	for (; i + sizeof(d) <= len; i += sizeof(d)) {
+		memcpy(&d, dst + i, sizeof(d));
+		memcpy(&v, src + i, sizeof(v));
+		d ^= v;
+		memcpy(dst + i, &d, sizeof(d));
+	}
+	for (; i < len; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
 static int udptl_rx_packet(struct ast_udptl *s, uint8_t *buf, unsigned int len)
 {
 	int stat1;
@@ -433,13 +451,14 @@ static int udptl_rx_packet(struct ast_udptl *s, uint8_t *buf, unsigned int len)
 		/* Secondary packet mode for error recovery */
 		if (seq_no > s->rx_seq_no) {
 			/* We received a later packet than we expected, so we need to check if we can fill in the gap from the
-			   secondary packets. */
+			   secondary packets.  They are ordered newest first, so only the ones covering the gap are decoded. */
 			int total_count = 0;
+			int needed = MIN(seq_no - s->rx_seq_no, ARRAY_LEN(bufs));
 			do {
 				unsigned int count;
 				if ((stat2 = decode_length(buf, len, &ptr, &count)) < 0)
 					return -1;
-				for (i = 0; i < count && total_count + i < ARRAY_LEN(bufs); i++) {
+				for (i = 0; i < count && total_count + i < needed; i++) {
 					if ((stat1 = decode_open_type(buf, len, &ptr, &bufs[total_count + i], &lengths[total_count + i])) != 0) {
 						return -1;
 					}
@@ -452,7 +471,7 @@ static int udptl_rx_packet(struct ast_udptl *s, uint8_t *buf, unsigned int len)
 				}
 				total_count += i;
 			}
-			while (stat2 > 0 && total_count < ARRAY_LEN(bufs));
+			while (stat2 > 0 && total_count < needed);
 			/* Step through in reverse order, so we go oldest to newest */
 			for (i = total_count; i > 0; i--) {
 				if (seq_no - i >= s->rx_seq_no) {
@@ -561,11 +580,12 @@ static int udptl_rx_packet(struct ast_udptl *s, uint8_t *buf, unsigned int len)
 						which = (which == -1) ? k : -2;
 				}
 				if (which >= 0) {
-					/* Repairable */
-					for (j = 0; j < s->rx[l].fec_len[m]; j++) {
-						s->rx[which].buf[j] = s->rx[l].fec[m][j];
-						for (k = (limit - s->rx[l].fec_span * s->rx[l].fec_entries) & UDPTL_BUF_MASK; k != limit; k = (k + s->rx[l].fec_entries) & UDPTL_BUF_MASK)
-							s->rx[which].buf[j] ^= (s->rx[k].buf_len > j) ? s->rx[k].buf[j] : 0;
+					/* Repairable, every other packet in the set is present */
+					memcpy(s->rx[which].buf, s->rx[l].fec[m], s->rx[l].fec_len[m]);
+					for (k = (limit - s->rx[l].fec_span * s->rx[l].fec_entries) & UDPTL_BUF_MASK; k != limit; k = (k + s->rx[l].fec_entries) & UDPTL_BUF_MASK) {
+						if (k != which) {
+							udptl_xor(s->rx[which].buf, s->rx[k].buf, MIN((unsigned int) s->rx[k].buf_len, s->rx[l].fec_len[m]));
+						}
 					}
 					s->rx[which].buf_len = s->rx[l].fec_len[m];
 					repaired[which] = TRUE;
@@ -620,7 +640,8 @@ static int udptl_rx_packet(struct ast_udptl *s, uint8_t *buf, unsigned int len)
 
 static int udptl_build_packet(struct ast_udptl *s, uint8_t *buf, unsigned int buflen, uint8_t *ifp, unsigned int ifp_len)
 {
-	uint8_t fec[LOCAL_FAX_MAX_DATAGRAM * 2] = { 0, };
+	/* Only the first high_tide octets are ever read, so this needs no clearing */
+	uint8_t fec[LOCAL_FAX_MAX_DATAGRAM * 2];
 	int i;
 	int j;
 	int seq;
@@ -707,14 +728,11 @@ static int udptl_build_packet(struct ast_udptl *s, uint8_t *buf, unsigned int bu
 			high_tide = 0;
 			for (i = (limit - span*entries) & UDPTL_BUF_MASK; i != limit; i = (i + entries) & UDPTL_BUF_MASK) {
 				if (high_tide < s->tx[i].buf_len) {
-					for (j = 0; j < high_tide; j++)
-						fec[j] ^= s->tx[i].buf[j];
-					for ( ; j < s->tx[i].buf_len; j++)
-						fec[j] = s->tx[i].buf[j];
+					udptl_xor(fec, s->tx[i].buf, high_tide);
+					memcpy(&fec[high_tide], &s->tx[i].buf[high_tide], s->tx[i].buf_len - high_tide);
 					high_tide = s->tx[i].buf_len;
-				} else {
-					for (j = 0; j < s->tx[i].buf_len; j++)
-						fec[j] ^= s->tx[i].buf[j];
+				} else if (s->tx[i].buf_len > 0) {
+					udptl_xor(fec, s->tx[i].buf, s->tx[i].buf_len);
 				}
 			}
 			if (encode_open_type(s, buf, buflen, &len, fec, high_tide) < 0)
@@ -1166,8 +1184,6 @@ int ast_udptl_write(struct ast_udptl *s, struct ast_frame *f)
 	const int bufsize = (s->far_max_datagram > 0) ? s->far_max_datagram : DEFAULT_FAX_MAX_DATAGRAM;
 	uint8_t buf[bufsize];
 
-	memset(buf, 0, sizeof(buf));
-
 	/* If we have no peer, return immediately */
 	if (ast_sockaddr_isnull(&s->them)) {
 		return 0;
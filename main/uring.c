@@ -0,0 +1,591 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Asynchronous file appends through io_uring
+ *
+ * The ring is driven through the system calls directly, so no library is
+ * needed.  Appenders fill the submission queue under uring_lock, and a
+ * single thread reaps the completions.  A writer has at most one write in
+ * the ring, which keeps its writes in order; whatever is appended meanwhile
+ * accumulates and is submitted as one write when the previous one
+ * completes.
+ */
+
+#include "asterisk.h"
+
+#include <fcntl.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_URING 1
+#endif
+#endif
+#endif
+
+#if defined(HAVE_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#endif
+
+#include "asterisk/_private.h"
+#include "asterisk/linkedlists.h"
+#include "asterisk/lock.h"
+#include "asterisk/logger.h"
+#include "asterisk/time.h"
+#include "asterisk/uring.h"
+#include "asterisk/utils.h"
+
+/*! Number of submission queue entries, and writes in the ring at once */
+#define URING_ENTRIES 256
+
+/*! Appended bytes of a writer waiting for its write, beyond which appending blocks */
+#define URING_WRITER_MAX_PENDING (1024 * 1024)
+
+/*! Seconds shutdown waits for the writes in progress */
+#define URING_SHUTDOWN_WAIT 5
+
+/*! \brief Data of a writer */
+struct uring_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct ast_uring_writer {
+	/*! The file descriptor appended to */
+	int fd;
+	/*! Error of the first failed write */
+	int error;
+	/*! Data appended since the write in progress was submitted */
+	struct uring_buf pending;
+	/*! Data of the write in progress */
+	struct uring_buf inflight;
+	/*! Bytes of inflight written so far */
+	size_t written;
+	/*! Close the file descriptor with the writer */
+	unsigned int owns_fd:1;
+	/*! A write is in progress, or waiting for room in the ring */
+	unsigned int busy:1;
+	/*! Closed by its user, destroyed once not busy */
+	unsigned int closing:1;
+	AST_LIST_ENTRY(ast_uring_writer) list;
+};
+
+/*! Protects the submission queue and the state of every writer */
+AST_MUTEX_DEFINE_STATIC(uring_lock);
+/*! Signalled whenever a writer stops being busy */
+static ast_cond_t uring_cond;
+
+static struct {
+	/*! Whether writes go through the ring */
+	int active;
+	/*! Number of busy writers */
+	unsigned int outstanding;
+#if defined(HAVE_URING)
+	int fd;
+	/*! Entries submitted and not yet completed */
+	unsigned int inflight;
+	unsigned int entries;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	pthread_t thread;
+	/*! Writers waiting for room in the ring */
+	AST_LIST_HEAD_NOLOCK(, ast_uring_writer) waiting;
+#endif
+} uring;
+
+static void writer_destroy(struct ast_uring_writer *writer)
+{
+	if (writer->owns_fd) {
+		close(writer->fd);
+	}
+	ast_free(writer->pending.data);
+	ast_free(writer->inflight.data);
+	ast_free(writer);
+}
+
+/*!
+ * \internal
+ * \brief Write on the calling thread, when the ring is not used
+ */
+static int writer_write_sync(struct ast_uring_writer *writer, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t res = write(writer->fd, buf, len);
+
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ast_mutex_lock(&uring_lock);
+			if (!writer->error) {
+				writer->error = errno;
+			}
+			ast_mutex_unlock(&uring_lock);
+			return -1;
+		}
+		buf += res;
+		len -= res;
+	}
+
+	return 0;
+}
+
+#if defined(HAVE_URING)
+
+static int uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/*!
+ * \internal
+ * \brief Hand the queued entries to the kernel
+ * \note Called with uring_lock held
+ */
+static void uring_submit_queued(void)
+{
+	unsigned int queued;
+
+	queued = *uring.sq_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+	/* Entries the kernel could not take now are taken on a later call */
+	while (queued && uring_enter(queued, 0, 0) < 0 && errno == EINTR) {
+	}
+}
+
+/*!
+ * \internal
+ * \brief Queue an entry, the writer or NULL for a no-op
+ * \note Called with uring_lock held and room in the ring
+ */
+static void uring_queue(struct ast_uring_writer *writer)
+{
+	unsigned int tail = *uring.sq_tail;
+	unsigned int index = tail & *uring.sq_mask;
+	struct io_uring_sqe *sqe = &uring.sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	if (writer) {
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = writer->fd;
+		/* Write at, and advance, the file position */
+		sqe->off = (__u64) -1;
+		sqe->addr = (uintptr_t) (writer->inflight.data + writer->written);
+		sqe->len = writer->inflight.len - writer->written;
+		sqe->user_data = (uintptr_t) writer;
+	} else {
+		sqe->opcode = IORING_OP_NOP;
+	}
+	uring.sq_array[index] = index;
+	__atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++uring.inflight;
+}
+
+/*!
+ * \internal
+ * \brief Submit the write of a busy writer, or make it wait for room
+ * \note Called with uring_lock held
+ */
+static void uring_submit(struct ast_uring_writer *writer)
+{
+	if (uring.inflight >= uring.entries) {
+		AST_LIST_INSERT_TAIL(&uring.waiting, writer, list);
+		return;
+	}
+
+	uring_queue(writer);
+	uring_submit_queued();
+}
+
+/*!
+ * \internal
+ * \brief Handle the completion of the write of a writer
+ * \note Called with uring_lock held
+ */
+static void uring_complete(struct ast_uring_writer *writer, int res)
+{
+	struct uring_buf swap;
+
+	if (res == -EINTR || res == -EAGAIN) {
+		uring_submit(writer);
+		return;
+	}
+
+	if (res <= 0) {
+		/* Nothing more of this writer is written after a failure */
+		if (!writer->error) {
+			writer->error = res ? -res : EIO;
+		}
+		writer->pending.len = 0;
+		writer->written = writer->inflight.len;
+	} else {
+		writer->written += res;
+	}
+
+	if (writer->written < writer->inflight.len) {
+		uring_submit(writer);
+		return;
+	}
+
+	writer->inflight.len = 0;
+	writer->written = 0;
+	if (writer->pending.len) {
+		swap = writer->inflight;
+		writer->inflight = writer->pending;
+		writer->pending = swap;
+		uring_submit(writer);
+		return;
+	}
+
+	writer->busy = 0;
+	--uring.outstanding;
+	ast_cond_broadcast(&uring_cond);
+	if (writer->closing) {
+		writer_destroy(writer);
+	}
+}
+
+static void *uring_completions(void *data)
+{
+	int stop = 0;
+
+	while (!stop) {
+		struct ast_uring_writer *writer;
+		unsigned int head;
+		unsigned int tail;
+
+		if (uring_enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+			ast_log(LOG_WARNING, "Failed to wait for io_uring completions: %s\n", strerror(errno));
+			usleep(1000);
+		}
+
+		ast_mutex_lock(&uring_lock);
+		head = *uring.cq_head;
+		tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+
+			--uring.inflight;
+			if (!cqe->user_data) {
+				stop = 1;
+				continue;
+			}
+			uring_complete((struct ast_uring_writer *) (uintptr_t) cqe->user_data, cqe->res);
+		}
+		__atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+
+		while (uring.inflight < uring.entries
+			&& (writer = AST_LIST_REMOVE_HEAD(&uring.waiting, list))) {
+			uring_queue(writer);
+		}
+		uring_submit_queued();
+		ast_mutex_unlock(&uring_lock);
+	}
+
+	return NULL;
+}
+
+static void uring_unmap(void)
+{
+	if (uring.sqes) {
+		munmap(uring.sqes, uring.sqes_size);
+		uring.sqes = NULL;
+	}
+	if (uring.cq_ring && uring.cq_ring != uring.sq_ring) {
+		munmap(uring.cq_ring, uring.cq_ring_size);
+	}
+	uring.cq_ring = NULL;
+	if (uring.sq_ring) {
+		munmap(uring.sq_ring, uring.sq_ring_size);
+		uring.sq_ring = NULL;
+	}
+	close(uring.fd);
+	uring.fd = -1;
+}
+
+/*!
+ * \internal
+ * \brief Set up the ring
+ *
+ * \retval 0 if writes can go through it
+ * \retval -1 if not, writers then write synchronously
+ */
+static int uring_setup(void)
+{
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	uring.fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (uring.fd < 0) {
+		ast_debug(1, "io_uring is not available: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* Writing at the file position came with IORING_OP_WRITE */
+	if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+		ast_debug(1, "io_uring does not support writes at the file position\n");
+		uring_unmap();
+		return -1;
+	}
+
+	uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		uring.sq_ring_size = MAX(uring.sq_ring_size, uring.cq_ring_size);
+	}
+
+	uring.sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQ_RING);
+	if (uring.sq_ring == MAP_FAILED) {
+		uring.sq_ring = NULL;
+		uring_unmap();
+		return -1;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		uring.cq_ring = uring.sq_ring;
+	} else {
+		uring.cq_ring = mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_CQ_RING);
+		if (uring.cq_ring == MAP_FAILED) {
+			uring.cq_ring = NULL;
+			uring_unmap();
+			return -1;
+		}
+	}
+
+	uring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring.sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQES);
+	if (uring.sqes == MAP_FAILED) {
+		uring.sqes = NULL;
+		uring_unmap();
+		return -1;
+	}
+
+	uring.sq_head = (unsigned int *) ((char *) uring.sq_ring + params.sq_off.head);
+	uring.sq_tail = (unsigned int *) ((char *) uring.sq_ring + params.sq_off.tail);
+	uring.sq_mask = (unsigned int *) ((char *) uring.sq_ring + params.sq_off.ring_mask);
+	uring.sq_array = (unsigned int *) ((char *) uring.sq_ring + params.sq_off.array);
+	uring.cq_head = (unsigned int *) ((char *) uring.cq_ring + params.cq_off.head);
+	uring.cq_tail = (unsigned int *) ((char *) uring.cq_ring + params.cq_off.tail);
+	uring.cq_mask = (unsigned int *) ((char *) uring.cq_ring + params.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *) ((char *) uring.cq_ring + params.cq_off.cqes);
+	/* The completion queue is at least as large, so it cannot overflow */
+	uring.entries = params.sq_entries;
+
+	if (ast_pthread_create(&uring.thread, NULL, uring_completions, NULL)) {
+		ast_log(LOG_WARNING, "Failed to start the io_uring completion thread\n");
+		uring_unmap();
+		return -1;
+	}
+
+	return 0;
+}
+
+static void uring_cleanup(void)
+{
+	struct timeval deadline = ast_tvadd(ast_tvnow(), ast_samp2tv(URING_SHUTDOWN_WAIT, 1));
+	struct timespec ts = { .tv_sec = deadline.tv_sec, .tv_nsec = deadline.tv_usec * 1000, };
+
+	ast_mutex_lock(&uring_lock);
+	if (!uring.active) {
+		ast_mutex_unlock(&uring_lock);
+		return;
+	}
+
+	while (uring.outstanding) {
+		if (ast_cond_timedwait(&uring_cond, &uring_lock, &ts) == ETIMEDOUT) {
+			break;
+		}
+	}
+	if (uring.outstanding) {
+		/* The kernel may still use the buffers, so leave the ring be */
+		ast_log(LOG_WARNING, "%u io_uring writers did not finish before shutdown\n",
+			uring.outstanding);
+		ast_mutex_unlock(&uring_lock);
+		return;
+	}
+
+	/* Writes from now on are synchronous */
+	uring.active = 0;
+	uring_queue(NULL);
+	uring_submit_queued();
+	ast_mutex_unlock(&uring_lock);
+
+	pthread_join(uring.thread, NULL);
+	uring_unmap();
+}
+
+#endif /* HAVE_URING */
+
+struct ast_uring_writer *ast_uring_writer_create(int fd, int owns_fd)
+{
+	struct ast_uring_writer *writer;
+
+	writer = ast_calloc(1, sizeof(*writer));
+	if (!writer) {
+		return NULL;
+	}
+	writer->fd = fd;
+	writer->owns_fd = owns_fd ? 1 : 0;
+
+	return writer;
+}
+
+struct ast_uring_writer *ast_uring_writer_open(const char *path)
+{
+	struct ast_uring_writer *writer;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_APPEND | O_CREAT, AST_FILE_MODE);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	writer = ast_uring_writer_create(fd, 1);
+	if (!writer) {
+		close(fd);
+		errno = ENOMEM;
+	}
+
+	return writer;
+}
+
+int ast_uring_write(struct ast_uring_writer *writer, const void *buf, size_t len)
+{
+	ast_mutex_lock(&uring_lock);
+	if (writer->error) {
+		errno = writer->error;
+		ast_mutex_unlock(&uring_lock);
+		return -1;
+	}
+
+	if (!uring.active) {
+		ast_mutex_unlock(&uring_lock);
+		return writer_write_sync(writer, buf, len);
+	}
+
+#if defined(HAVE_URING)
+	while (writer->busy && writer->pending.len + len > URING_WRITER_MAX_PENDING) {
+		ast_cond_wait(&uring_cond, &uring_lock);
+	}
+
+	if (writer->pending.len + len > writer->pending.size) {
+		size_t size = MAX(writer->pending.len + len, 2 * writer->pending.size);
+		char *data = ast_realloc(writer->pending.data, size);
+
+		if (!data) {
+			ast_mutex_unlock(&uring_lock);
+			errno = ENOMEM;
+			return -1;
+		}
+		writer->pending.data = data;
+		writer->pending.size = size;
+	}
+	memcpy(writer->pending.data + writer->pending.len, buf, len);
+	writer->pending.len += len;
+
+	if (!writer->busy) {
+		struct uring_buf swap = writer->inflight;
+
+		writer->inflight = writer->pending;
+		writer->pending = swap;
+		writer->written = 0;
+		writer->busy = 1;
+		++uring.outstanding;
+		uring_submit(writer);
+	}
+#endif
+	ast_mutex_unlock(&uring_lock);
+
+	return 0;
+}
+
+void ast_uring_writer_flush(struct ast_uring_writer *writer)
+{
+	ast_mutex_lock(&uring_lock);
+	while (writer->busy) {
+		ast_cond_wait(&uring_cond, &uring_lock);
+	}
+	ast_mutex_unlock(&uring_lock);
+}
+
+int ast_uring_writer_error(struct ast_uring_writer *writer)
+{
+	int error;
+
+	ast_mutex_lock(&uring_lock);
+	error = writer->error;
+	ast_mutex_unlock(&uring_lock);
+
+	return error;
+}
+
+void ast_uring_writer_close(struct ast_uring_writer *writer)
+{
+	if (!writer) {
+		return;
+	}
+
+	ast_mutex_lock(&uring_lock);
+	if (writer->busy) {
+		/* Destroyed when its last write completes */
+		writer->closing = 1;
+		writer = NULL;
+	}
+	ast_mutex_unlock(&uring_lock);
+
+	if (writer) {
+		writer_destroy(writer);
+	}
+}
+
+int ast_uring_available(void)
+{
+	return uring.active;
+}
+
+int ast_uring_init(void)
+{
+	ast_cond_init(&uring_cond, NULL);
+
+#if defined(HAVE_URING)
+	uring.fd = -1;
+	if (!uring_setup()) {
+		uring.active = 1;
+		ast_register_cleanup(uring_cleanup);
+	}
+#endif
+
+	return 0;
+}
@@ -34,6 +34,9 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #if defined(__APPLE__)
 #include <mach/mach.h>
 #elif defined(HAVE_SYS_THR_H)
@@ -51,6 +54,7 @@
 #include "asterisk/cli.h"
 #include "asterisk/linkedlists.h"
 #include "asterisk/astobj2.h"
+#include "asterisk/vector.h"
 
 #define AST_API_MODULE		/* ensure that inlinable API functions will be built in this module if required */
 #include "asterisk/strings.h"
@@ -636,18 +640,21 @@ char *ast_escape_quoted(const char *string, char *outbuf, int buflen)
 {
 	const char *ptr  = string;
 	char *out = outbuf;
-	char *allow = "\t\v !"; /* allow LWS (minus \r and \n) and "!" */
 
 	while (*ptr && out - outbuf < buflen - 1) {
-		if (!(strchr(allow, *ptr))
-			&& !(*ptr >= '#' && *ptr <= '[') /* %x23 - %x5b */
-			&& !(*ptr >= ']' && *ptr <= '~') /* %x5d - %x7e */
-			&& !((unsigned char) *ptr > 0x7f)) {             /* UTF8-nonascii */
+		unsigned char c = *ptr;
 
+		/*
+		 * Allowed are LWS (minus \r and \n), "!", %x23 - %x5b, %x5d - %x7e
+		 * and UTF8-nonascii, so only the other control characters, '"', '\'
+		 * and DEL are escaped.
+		 */
+		if (c < ' ' ? (c != '\t' && c != '\v') : (c == '"' || c == '\\' || c == 0x7f)) {
 			if (out - outbuf >= buflen - 2) {
 				break;
 			}
-			out += sprintf(out, "\\%c", (unsigned char) *ptr);
+			*out++ = '\\';
+			*out++ = c;
 		} else {
 			*out = *ptr;
 			out++;
@@ -1372,6 +1379,135 @@ static struct ast_cli_entry utils_cli[] = {
 #endif /* ! LOW_MEMORY */
 #endif /* DEBUG_THREADS */
 
+#if !defined(LOW_MEMORY)
+AST_VECTOR(lock_contention_report, struct ast_lock_contention);
+
+static void lock_contention_report_cb(const struct ast_lock_contention *contention, void *data)
+{
+	struct lock_contention_report *report = data;
+
+	AST_VECTOR_APPEND(report, *contention);
+}
+
+/*! \brief Sort the sites that waited the longest in total first */
+static int lock_contention_report_cmp(const void *a, const void *b)
+{
+	const struct ast_lock_contention *left = a;
+	const struct ast_lock_contention *right = b;
+
+	if (left->total != right->total) {
+		return left->total > right->total ? -1 : 1;
+	}
+	return right->waits > left->waits ? 1 : (right->waits < left->waits ? -1 : 0);
+}
+
+#define FMT_CONTENTION_HEADERS "%-50s %-32s %-6s %10s %12s %10s %10s\n"
+#define FMT_CONTENTION_FIELDS "%-50s %-32.32s %-6s %10lu %12llu %10llu %10llu\n"
+
+static char *handle_show_lock_contention(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct lock_contention_report report;
+	unsigned long dropped;
+	int limit = -1;
+	int i;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core show lock contention";
+		e->usage =
+			"Usage: core show lock contention [<limit>]\n"
+			"       Shows the lock acquisition sites that waited for a busy lock\n"
+			"       while the profiler was on, the ones that waited the longest\n"
+			"       in total first.  Times are in microseconds.  See\n"
+			"       'core set lock contention'.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc > e->args + 1) {
+		return CLI_SHOWUSAGE;
+	}
+	if (a->argc == e->args + 1 && (sscanf(a->argv[e->args], "%30d", &limit) != 1 || limit < 1)) {
+		return CLI_SHOWUSAGE;
+	}
+
+	if (AST_VECTOR_INIT(&report, 64)) {
+		return CLI_FAILURE;
+	}
+	dropped = ast_lock_contention_foreach(lock_contention_report_cb, &report);
+	AST_VECTOR_SORT(&report, lock_contention_report_cmp);
+
+	if (ast_lock_contention_get()) {
+		ast_cli(a->fd, "Timing one in %u waits\n", ast_lock_contention_get());
+	} else {
+		ast_cli(a->fd, "The lock contention profiler is off\n");
+	}
+	ast_cli(a->fd, "\n" FMT_CONTENTION_HEADERS, "Site", "Lock", "Type", "Waits", "Total", "Avg", "Max");
+	for (i = 0; i < AST_VECTOR_SIZE(&report) && (limit < 0 || i < limit); i++) {
+		const struct ast_lock_contention *contention = AST_VECTOR_GET_ADDR(&report, i);
+		char site[256];
+
+		snprintf(site, sizeof(site), "%s:%d %s", contention->file, contention->line, contention->func);
+		ast_cli(a->fd, FMT_CONTENTION_FIELDS, site, contention->lock_name, contention->type,
+			contention->waits, contention->total,
+			contention->waits ? contention->total / contention->waits : 0, contention->max);
+	}
+	ast_cli(a->fd, "\n%zu sites", AST_VECTOR_SIZE(&report));
+	if (dropped) {
+		ast_cli(a->fd, ", %lu waits not recorded because every slot was taken", dropped);
+	}
+	ast_cli(a->fd, "\n\n");
+
+	AST_VECTOR_FREE(&report);
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_set_lock_contention(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	unsigned int rate = 1;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "core set lock contention {on|off}";
+		e->usage =
+			"Usage: core set lock contention {on [<rate>]|off}\n"
+			"       Turns the lock contention profiler on or off.  While it is on,\n"
+			"       one in every <rate> waits for a busy lock is timed, every wait\n"
+			"       if no rate is given.  Turning it on throws away the waits\n"
+			"       recorded before.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (!strcasecmp(a->argv[e->args - 1], "off")) {
+		if (a->argc != e->args) {
+			return CLI_SHOWUSAGE;
+		}
+		ast_lock_contention_set(0);
+		ast_cli(a->fd, "The lock contention profiler is off\n");
+		return CLI_SUCCESS;
+	}
+
+	if (a->argc > e->args + 1
+		|| (a->argc == e->args + 1 && (sscanf(a->argv[e->args], "%30u", &rate) != 1 || !rate))) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_lock_contention_set(rate);
+	ast_cli(a->fd, "The lock contention profiler is timing one in %u waits\n", rate);
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry lock_contention_cli[] = {
+	AST_CLI_DEFINE(handle_show_lock_contention, "Show waits for busy locks by acquisition site"),
+	AST_CLI_DEFINE(handle_set_lock_contention, "Turn the lock contention profiler on or off"),
+};
+#endif /* ! LOW_MEMORY */
+
 #if !defined(LOW_MEMORY)
 /*
  * support for 'show threads'. The start routine is wrapped by
@@ -2364,6 +2500,9 @@ static void utils_shutdown(void)
 #if defined(DEBUG_THREADS) && !defined(LOW_MEMORY)
 	ast_cli_unregister_multiple(utils_cli, ARRAY_LEN(utils_cli));
 #endif
+#if !defined(LOW_MEMORY)
+	ast_cli_unregister_multiple(lock_contention_cli, ARRAY_LEN(lock_contention_cli));
+#endif
 }
 
 int ast_utils_init(void)
@@ -2374,6 +2513,9 @@ int ast_utils_init(void)
 #if !defined(LOW_MEMORY)
 	ast_cli_register_multiple(utils_cli, ARRAY_LEN(utils_cli));
 #endif
+#endif
+#if !defined(LOW_MEMORY)
+	ast_cli_register_multiple(lock_contention_cli, ARRAY_LEN(lock_contention_cli));
 #endif
 	ast_register_cleanup(utils_shutdown);
 	return 0;
@@ -3007,3 +3149,135 @@ int ast_thread_is_user_interface(void)
 
 	return *thread_user_interface;
 }
+
+/*! Most CPU groups that can be configured */
+#define MAX_CPU_GROUPS 16
+
+#if defined(__linux__)
+/*! \brief A group of CPUs threads working together are placed on */
+struct cpu_group {
+	/*! The CPUs of the group */
+	cpu_set_t cpus;
+	/*! Number of sets of threads using the group */
+	int users;
+};
+
+/*!
+ * \brief The configured CPU groups
+ *
+ * Only added to at startup, before any thread uses them.
+ */
+static struct cpu_group cpu_groups[MAX_CPU_GROUPS];
+static int cpu_group_count;
+
+int ast_cpu_group_add(const char *cpus)
+{
+	struct cpu_group *group;
+	char *parse = ast_strdupa(cpus);
+	char *range;
+
+	if (cpu_group_count == MAX_CPU_GROUPS) {
+		ast_log(LOG_WARNING, "Only %d CPU groups can be configured\n", MAX_CPU_GROUPS);
+		return -1;
+	}
+	group = &cpu_groups[cpu_group_count];
+	CPU_ZERO(&group->cpus);
+
+	while ((range = strsep(&parse, ","))) {
+		unsigned int first;
+		unsigned int last;
+
+		range = ast_strip(range);
+		if (ast_strlen_zero(range)) {
+			continue;
+		}
+		if (sscanf(range, "%30u-%30u", &first, &last) != 2) {
+			if (sscanf(range, "%30u", &first) != 1) {
+				ast_log(LOG_WARNING, "Invalid CPU '%s' in CPU group '%s'\n", range, cpus);
+				return -1;
+			}
+			last = first;
+		}
+		if (first > last || last >= CPU_SETSIZE) {
+			ast_log(LOG_WARNING, "Invalid CPU range '%s' in CPU group '%s'\n", range, cpus);
+			return -1;
+		}
+		for (; first <= last; ++first) {
+			CPU_SET(first, &group->cpus);
+		}
+	}
+
+	if (!CPU_COUNT(&group->cpus)) {
+		ast_log(LOG_WARNING, "CPU group '%s' has no CPUs\n", cpus);
+		return -1;
+	}
+	group->users = 0;
+	++cpu_group_count;
+
+	return 0;
+}
+
+int ast_cpu_group_acquire(void)
+{
+	int group = -1;
+	int users = INT_MAX;
+	int i;
+
+	/* Racing another caller only makes the spread a little uneven */
+	for (i = 0; i < cpu_group_count; ++i) {
+		if (cpu_groups[i].users < users) {
+			group = i;
+			users = cpu_groups[i].users;
+		}
+	}
+	if (group >= 0) {
+		ast_atomic_fetchadd_int(&cpu_groups[group].users, +1);
+	}
+
+	return group;
+}
+
+void ast_cpu_group_release(int group)
+{
+	if (group >= 0 && group < cpu_group_count) {
+		ast_atomic_fetchadd_int(&cpu_groups[group].users, -1);
+	}
+}
+
+int ast_thread_cpu_group_set(int group)
+{
+	int res;
+
+	if (group < 0 || group >= cpu_group_count) {
+		return group == -1 ? 0 : -1;
+	}
+
+	res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_groups[group].cpus), &cpu_groups[group].cpus);
+	if (res) {
+		ast_log(LOG_WARNING, "Unable to place thread on CPU group %d: %s\n", group, strerror(res));
+		return -1;
+	}
+
+	return 0;
+}
+#else
+int ast_cpu_group_add(const char *cpus)
+{
+	ast_log(LOG_WARNING, "CPU groups are not supported on this platform\n");
+	return -1;
+}
+
+int ast_cpu_group_acquire(void)
+{
+	return -1;
+}
+
+void ast_cpu_group_release(int group)
+{
+}
+
+int ast_thread_cpu_group_set(int group)
+{
+	return group == -1 ? 0 : -1;
+}
+#endif
@@ -37,6 +37,7 @@
 #include "asterisk/astobj2.h"
 #include "asterisk/xmldoc.h"
 #include "asterisk/cli.h"
+#include "asterisk/vector.h"
 
 #ifdef AST_XML_DOCS
 
@@ -74,6 +75,41 @@ static int xmldoc_parse_specialtags(struct ast_xml_node *fixnode, const char *ta
  */
 static AST_RWLIST_HEAD_STATIC(xmldoc_tree, documentation_tree);
 
+/*! \brief Number of buckets in the documentation node index */
+#define XMLDOC_INDEX_BUCKETS 1567
+
+/*! \brief A documentation node found in one of the loaded trees */
+struct xmldoc_index_node {
+	/*! Tree the node belongs to */
+	struct documentation_tree *doctree;
+	/*! Element with a matching type and name attribute */
+	struct ast_xml_node *node;
+};
+
+/*! \brief All nodes sharing a type and name, in documentation tree order */
+struct xmldoc_index_entry {
+	/*! Nodes in the order they would be found by walking xmldoc_tree */
+	AST_VECTOR(, struct xmldoc_index_node) nodes;
+	/*! Element type ('application', 'function', ...) */
+	char *type;
+	/*! Value of the element's name attribute */
+	char name[0];
+};
+
+/*! \brief Key used to search the documentation node index */
+struct xmldoc_index_key {
+	const char *type;
+	const char *name;
+};
+
+/*!
+ * \brief Index of top level documentation nodes by type and name.
+ *
+ * \note Only modified while xmldoc_tree is write locked and only
+ * searched while it is read locked.
+ */
+static struct ao2_container *xmldoc_index;
+
 static const struct strcolorized_tags {
 	const char *init;      /*!< Replace initial tag with this string. */
 	const char *end;       /*!< Replace end tag with this string. */
@@ -436,69 +472,61 @@ static struct ast_xml_node *xmldoc_get_node(const char *type, const char *name,
 	struct ast_xml_node *node = NULL;
 	struct ast_xml_node *first_match = NULL;
 	struct ast_xml_node *lang_match = NULL;
+	struct xmldoc_index_entry *entry;
+	struct xmldoc_index_key key = { .type = type, .name = name, };
 	struct documentation_tree *doctree;
+	size_t idx;
 
 	AST_RWLIST_RDLOCK(&xmldoc_tree);
-	AST_LIST_TRAVERSE(&xmldoc_tree, doctree, entry) {
-		/* the core xml documents have priority over thirdparty document. */
-		node = ast_xml_get_root(doctree->doc);
-		if (!node) {
+	entry = xmldoc_index ? ao2_find(xmldoc_index, &key, OBJ_SEARCH_KEY | OBJ_NOLOCK) : NULL;
+	if (!entry) {
+		AST_RWLIST_UNLOCK(&xmldoc_tree);
+		return NULL;
+	}
+
+	/* the core xml documents have priority over thirdparty document. */
+	doctree = AST_VECTOR_GET_ADDR(&entry->nodes, 0)->doctree;
+	for (idx = 0; idx < AST_VECTOR_SIZE(&entry->nodes); ++idx) {
+		struct xmldoc_index_node *candidate = AST_VECTOR_GET_ADDR(&entry->nodes, idx);
+
+		if (candidate->doctree != doctree) {
 			break;
 		}
 
-		node = ast_xml_node_get_children(node);
-		while ((node = ast_xml_find_element(node, type, "name", name))) {
-			if (!ast_xml_node_get_children(node)) {
-				/* ignore empty nodes */
-				node = ast_xml_node_get_next(node);
-				continue;
-			}
+		if (!first_match) {
+			first_match = candidate->node;
+		}
 
-			if (!first_match) {
-				first_match = node;
+		/* Check language */
+		if (xmldoc_attribute_match(candidate->node, "language", language)) {
+			if (!lang_match) {
+				lang_match = candidate->node;
 			}
 
-			/* Check language */
-			if (xmldoc_attribute_match(node, "language", language)) {
-				if (!lang_match) {
-					lang_match = node;
-				}
-
-				/* if module is empty we have a match */
-				if (ast_strlen_zero(module)) {
-					break;
-				}
-
-				/* Check module */
-				if (xmldoc_attribute_match(node, "module", module)) {
-					break;
-				}
+			/* if module is empty we have a match */
+			if (ast_strlen_zero(module)) {
+				node = candidate->node;
+				break;
 			}
 
-			node = ast_xml_node_get_next(node);
-		}
-
-		/* if we matched lang and module return this match */
-		if (node) {
-			break;
+			/* Check module */
+			if (xmldoc_attribute_match(candidate->node, "module", module)) {
+				node = candidate->node;
+				break;
+			}
 		}
+	}
 
+	if (!node) {
 		/* we didn't match lang and module, just return the first
-		 * result with a matching language if we have one */
-		if (lang_match) {
-			node = lang_match;
-			break;
-		}
-
-		/* we didn't match with only the language, just return the
-		 * first match */
-		if (first_match) {
-			node = first_match;
-			break;
-		}
+		 * result with a matching language if we have one, otherwise
+		 * just return the first match */
+		node = lang_match ? lang_match : first_match;
 	}
 	AST_RWLIST_UNLOCK(&xmldoc_tree);
 
+	ao2_ref(entry, -1);
+
 	return node;
 }
 
@@ -2859,6 +2887,113 @@ static char *handle_dump_docs(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 static struct ast_cli_entry cli_dump_xmldocs = AST_CLI_DEFINE(handle_dump_docs, "Dump the XML docs to the specified file");
 
 /*! \brief Close and unload XML documentation. */
+static int xmldoc_index_hash(const void *obj, const int flags)
+{
+	const struct xmldoc_index_entry *entry;
+	const struct xmldoc_index_key *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = obj;
+		return ast_str_hash(key->name) ^ ast_str_hash(key->type);
+	case OBJ_SEARCH_OBJECT:
+		entry = obj;
+		return ast_str_hash(entry->name) ^ ast_str_hash(entry->type);
+	default:
+		/* Hash can only work on something with a full key. */
+		ast_assert(0);
+		return 0;
+	}
+}
+
+static int xmldoc_index_cmp(void *obj, void *arg, int flags)
+{
+	const struct xmldoc_index_entry *left = obj;
+	const struct xmldoc_index_entry *object_right;
+	const struct xmldoc_index_key *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = arg;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		object_right = arg;
+		return strcmp(left->name, object_right->name) || strcmp(left->type, object_right->type)
+			? 0 : CMP_MATCH;
+	default:
+		return 0;
+	}
+
+	return strcmp(left->name, key->name) || strcmp(left->type, key->type) ? 0 : CMP_MATCH;
+}
+
+static void xmldoc_index_entry_destructor(void *obj)
+{
+	struct xmldoc_index_entry *entry = obj;
+
+	AST_VECTOR_FREE(&entry->nodes);
+}
+
+/*!
+ * \internal
+ * \brief Add the top level nodes of a documentation tree to the index.
+ *
+ * \param doctree Documentation tree to index.
+ *
+ * \note The xmldoc_tree must be write locked and doctree must be the
+ * last tree in it, so the index stays in xmldoc_tree order.
+ *
+ * \return Nothing
+ */
+static void xmldoc_index_add_tree(struct documentation_tree *doctree)
+{
+	struct ast_xml_node *node;
+
+	for (node = ast_xml_node_get_children(ast_xml_get_root(doctree->doc));
+		node; node = ast_xml_node_get_next(node)) {
+		struct xmldoc_index_node candidate = { .doctree = doctree, .node = node, };
+		struct xmldoc_index_key key;
+		struct xmldoc_index_entry *entry;
+		const char *name;
+		size_t name_len;
+
+		/* empty nodes are never returned by xmldoc_get_node() */
+		if (!ast_xml_node_get_children(node)) {
+			continue;
+		}
+
+		name = ast_xml_get_attribute(node, "name");
+		if (!name) {
+			continue;
+		}
+
+		key.type = ast_xml_node_get_name(node);
+		key.name = name;
+		entry = ao2_find(xmldoc_index, &key, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+		if (!entry) {
+			name_len = strlen(name) + 1;
+			entry = ao2_alloc_options(sizeof(*entry) + name_len + strlen(key.type) + 1,
+				xmldoc_index_entry_destructor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+			if (!entry || AST_VECTOR_INIT(&entry->nodes, 1)) {
+				ao2_cleanup(entry);
+				ast_xml_free_attr(name);
+				continue;
+			}
+			strcpy(entry->name, name); /* Safe */
+			entry->type = entry->name + name_len;
+			strcpy(entry->type, key.type); /* Safe */
+			ao2_link_flags(xmldoc_index, entry, OBJ_NOLOCK);
+		}
+		ast_xml_free_attr(name);
+
+		if (AST_VECTOR_APPEND(&entry->nodes, candidate)) {
+			ast_log(LOG_ERROR, "Unable to index documentation for %s '%s'\n",
+				entry->type, entry->name);
+		}
+		ao2_ref(entry, -1);
+	}
+}
+
 static void xmldoc_unload_documentation(void)
 {
 	struct documentation_tree *doctree;
@@ -2866,6 +3001,8 @@ static void xmldoc_unload_documentation(void)
 	ast_cli_unregister(&cli_dump_xmldocs);
 
 	AST_RWLIST_WRLOCK(&xmldoc_tree);
+	ao2_cleanup(xmldoc_index);
+	xmldoc_index = NULL;
 	while ((doctree = AST_RWLIST_REMOVE_HEAD(&xmldoc_tree, entry))) {
 		ast_free(doctree->filename);
 		ast_xml_close(doctree->doc);
@@ -2940,6 +3077,11 @@ int ast_xmldoc_load_documentation(void)
 	ast_free(xmlpattern);
 
 	AST_RWLIST_WRLOCK(&xmldoc_tree);
+	xmldoc_index = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0,
+		XMLDOC_INDEX_BUCKETS, xmldoc_index_hash, NULL, xmldoc_index_cmp);
+	if (!xmldoc_index) {
+		ast_log(LOG_WARNING, "Unable to allocate the XML documentation index\n");
+	}
 	/* loop over expanded files */
 	for (i = 0; i < globbuf.gl_pathc; i++) {
 		/* check for duplicates (if we already [try to] open the same file. */
@@ -2983,6 +3125,9 @@ int ast_xmldoc_load_documentation(void)
 		doc_tree->doc = tmpdoc;
 		doc_tree->filename = ast_strdup(globbuf.gl_pathv[i]);
 		AST_RWLIST_INSERT_TAIL(&xmldoc_tree, doc_tree, entry);
+		if (xmldoc_index) {
+			xmldoc_index_add_tree(doc_tree);
+		}
 	}
 	AST_RWLIST_UNLOCK(&xmldoc_tree);
 
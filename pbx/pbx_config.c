@@ -102,6 +102,9 @@ static int write_protect_config = 1;
 static int autofallthrough_config = 1;
 static int clearglobalvars_config = 0;
 static int extenpatternmatchnew_config = 0;
+static int extenmatchcache_config = 0;
+static int hintnotifywindow_config = 0;
+static int incrementalreload_config = 0;
 static char *overrideswitch_config = NULL;
 
 AST_MUTEX_DEFINE_STATIC(save_dialplan_lock);
@@ -110,6 +113,22 @@ AST_MUTEX_DEFINE_STATIC(reload_lock);
 
 static struct ast_context *local_contexts = NULL;
 static struct ast_hashtab *local_table = NULL;
+
+/*! \brief The contents of a context as last loaded, to tell if it changed */
+struct context_hash {
+	int hash;
+	char name[0];
+};
+
+AO2_STRING_FIELD_HASH_FN(context_hash, name)
+AO2_STRING_FIELD_CMP_FN(context_hash, name)
+
+#define CONTEXT_HASH_BUCKETS 563
+
+/*! \brief Hashes of the contexts of the dialplan in use, protected by reload_lock */
+static struct ao2_container *context_hashes;
+/*! \brief Hash of the general and globals sections of the dialplan in use */
+static int general_hash;
 /*
  * Prototypes for our completion functions
  */
@@ -893,13 +912,16 @@ static char *handle_cli_dialplan_save(struct ast_cli_entry *e, int cmd, struct a
 	if (overrideswitch_config) {
 		snprintf(overrideswitch, sizeof(overrideswitch), "overrideswitch=%s\n", overrideswitch_config);
 	}
-	fprintf(output, "[general]\nstatic=%s\nwriteprotect=%s\nautofallthrough=%s\nclearglobalvars=%s\n%sextenpatternmatchnew=%s\n\n",
+	fprintf(output, "[general]\nstatic=%s\nwriteprotect=%s\nautofallthrough=%s\nclearglobalvars=%s\n%sextenpatternmatchnew=%s\nextenmatchcache=%s\nhintnotifywindow=%d\nincrementalreload=%s\n\n",
 		static_config ? "yes" : "no",
 		write_protect_config ? "yes" : "no",
                 autofallthrough_config ? "yes" : "no",
 				clearglobalvars_config ? "yes" : "no",
 				overrideswitch_config ? overrideswitch : "",
-				extenpatternmatchnew_config ? "yes" : "no");
+				extenpatternmatchnew_config ? "yes" : "no",
+				extenmatchcache_config ? "yes" : "no",
+				hintnotifywindow_config,
+				incrementalreload_config ? "yes" : "no");
 
 	if ((v = ast_variable_browse(cfg, "globals"))) {
 		fprintf(output, "[globals]\n");
@@ -1632,6 +1654,8 @@ static int unload_module(void)
 	ast_manager_unregister(AMI_EXTENSION_ADD);
 	ast_manager_unregister(AMI_EXTENSION_REMOVE);
 	ast_context_destroy(NULL, registrar);
+	ao2_cleanup(context_hashes);
+	context_hashes = NULL;
 
 	return 0;
 }
@@ -1671,7 +1695,98 @@ static char *pbx_strsep(char **destructible, const char *delim)
 	return res;
 }
 
-static int pbx_load_config(const char *config_file)
+/*! \brief Hash everything a category holds, including where it was read from */
+static int category_hash(struct ast_config *cfg, const char *cxt, int hash)
+{
+	struct ast_variable *v;
+
+	hash = ast_str_hash_add(cxt, hash);
+	for (v = ast_variable_browse(cfg, cxt); v; v = v->next) {
+		hash = ast_str_hash_add(v->name, hash);
+		hash = ast_str_hash_add(v->value, hash);
+		hash = ast_str_hash_add(S_OR(v->file, ""), hash);
+		hash = ast_str_hash_restrict((unsigned int) hash * 33 + v->lineno);
+	}
+
+	return hash;
+}
+
+/*!
+ * \brief Work out which contexts an incremental reload has to replace
+ *
+ * \param hashes The hashes of the contexts just parsed
+ * \param gen_hash The hash of the general and globals sections just parsed
+ *
+ * \return String container of the names of the contexts that were added,
+ *         changed or removed since the last load, or NULL if everything
+ *         has to be reloaded
+ */
+static struct ao2_container *changed_contexts(struct ao2_container *hashes, int gen_hash)
+{
+	struct ao2_container *changed;
+	struct ao2_iterator iter;
+	struct context_hash *cur;
+
+	if (!incrementalreload_config || !context_hashes || gen_hash != general_hash) {
+		return NULL;
+	}
+
+	changed = ast_str_container_alloc_options(AO2_ALLOC_OPT_LOCK_NOLOCK, CONTEXT_HASH_BUCKETS);
+	if (!changed) {
+		return NULL;
+	}
+
+	/* The users.conf context is not tracked, always rebuild it. */
+	if (ast_str_container_add(changed, userscontext)) {
+		ao2_ref(changed, -1);
+		return NULL;
+	}
+
+	iter = ao2_iterator_init(hashes, 0);
+	for (; (cur = ao2_iterator_next(&iter)); ao2_ref(cur, -1)) {
+		struct context_hash *old = ao2_find(context_hashes, cur->name, OBJ_SEARCH_KEY);
+
+		if ((!old || old->hash != cur->hash) && ast_str_container_add(changed, cur->name)) {
+			ao2_cleanup(old);
+			ao2_ref(cur, -1);
+			ao2_iterator_destroy(&iter);
+			ao2_ref(changed, -1);
+			return NULL;
+		}
+		ao2_cleanup(old);
+	}
+	ao2_iterator_destroy(&iter);
+
+	iter = ao2_iterator_init(context_hashes, 0);
+	for (; (cur = ao2_iterator_next(&iter)); ao2_ref(cur, -1)) {
+		struct context_hash *now = ao2_find(hashes, cur->name, OBJ_SEARCH_KEY);
+
+		if (!now && ast_str_container_add(changed, cur->name)) {
+			ao2_ref(cur, -1);
+			ao2_iterator_destroy(&iter);
+			ao2_ref(changed, -1);
+			return NULL;
+		}
+		ao2_cleanup(now);
+	}
+	ao2_iterator_destroy(&iter);
+
+	return changed;
+}
+
+/*!
+ * \brief Load extensions.conf into local_contexts
+ *
+ * \param config_file The file to load
+ * \param changed Set to the contexts to replace, NULL if all of them
+ * \param hashes Set to the hashes of the contexts loaded
+ * \param gen_hash Set to the hash of the general and globals sections
+ *
+ * \retval 1 on success
+ * \retval 0 on failure
+ */
+static int pbx_load_config(const char *config_file, struct ao2_container **changed,
+	struct ao2_container **hashes, int *gen_hash)
 {
 	struct ast_config *cfg;
 	char *end;
@@ -1700,6 +1815,14 @@ static int pbx_load_config(const char *config_file)
 		autofallthrough_config = ast_true(aft);
 	if ((newpm = ast_variable_retrieve(cfg, "general", "extenpatternmatchnew")))
 		extenpatternmatchnew_config = ast_true(newpm);
+	if ((newpm = ast_variable_retrieve(cfg, "general", "extenmatchcache")))
+		extenmatchcache_config = ast_true(newpm);
+	hintnotifywindow_config = 0;
+	if ((newpm = ast_variable_retrieve(cfg, "general", "hintnotifywindow"))
+		&& (sscanf(newpm, "%30d", &hintnotifywindow_config) != 1 || hintnotifywindow_config < 0)) {
+		ast_log(LOG_WARNING, "Invalid hintnotifywindow '%s', hint changes will be sent immediately\n", newpm);
+		hintnotifywindow_config = 0;
+	}
 	clearglobalvars_config = ast_true(ast_variable_retrieve(cfg, "general", "clearglobalvars"));
 	if ((ovsw = ast_variable_retrieve(cfg, "general", "overrideswitch"))) {
 		if (overrideswitch_config) {
@@ -1714,6 +1837,49 @@ static int pbx_load_config(const char *config_file)
 
 	ast_copy_string(userscontext, ast_variable_retrieve(cfg, "general", "userscontext") ?: "default", sizeof(userscontext));
 
+	incrementalreload_config = ast_true(ast_variable_retrieve(cfg, "general", "incrementalreload"));
+
+	*hashes = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, CONTEXT_HASH_BUCKETS,
+		context_hash_hash_fn, NULL, context_hash_cmp_fn);
+	if (!*hashes) {
+		ast_config_destroy(cfg);
+		return 0;
+	}
+	*gen_hash = 0;
+	for (cxt = ast_category_browse(cfg, NULL);
+	     cxt;
+	     cxt = ast_category_browse(cfg, cxt)) {
+		struct context_hash *hash;
+		size_t len;
+
+		if (!strcasecmp(cxt, "general") || !strcasecmp(cxt, "globals")) {
+			/* Extension names may use globals, a change there reloads everything. */
+			*gen_hash = category_hash(cfg, cxt, *gen_hash);
+			continue;
+		}
+
+		hash = ao2_find(*hashes, cxt, OBJ_SEARCH_KEY);
+		if (hash) {
+			/* A repeated context, only its first section is loaded. */
+			ao2_ref(hash, -1);
+			continue;
+		}
+
+		len = strlen(cxt) + 1;
+		hash = ao2_alloc_options(sizeof(*hash) + len, NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!hash) {
+			ao2_ref(*hashes, -1);
+			*hashes = NULL;
+			ast_config_destroy(cfg);
+			return 0;
+		}
+		hash->hash = category_hash(cfg, cxt, 0);
+		memcpy(hash->name, cxt, len);
+		ao2_link(*hashes, hash);
+		ao2_ref(hash, -1);
+	}
+	*changed = changed_contexts(*hashes, *gen_hash);
+
 	/* ast_variable_browse does not merge multiple [globals] sections */
 	for (cxt = ast_category_browse(cfg, NULL);
 	     cxt;
@@ -1735,6 +1901,15 @@ static int pbx_load_config(const char *config_file)
 		if (!strcasecmp(cxt, "general") || !strcasecmp(cxt, "globals")) {
 			continue;
 		}
+		if (*changed) {
+			char *name = ao2_find(*changed, cxt, OBJ_SEARCH_KEY);
+
+			if (!name) {
+				/* Unchanged, the context in use is kept. */
+				continue;
+			}
+			ao2_ref(name, -1);
+		}
 		if (!(con = ast_context_find_or_create(&local_contexts, local_table, cxt, registrar))) {
 			continue;
 		}
@@ -2087,6 +2262,9 @@ static void pbx_load_users(void)
 static int pbx_load_module(void)
 {
 	struct ast_context *con;
+	struct ao2_container *changed = NULL;
+	struct ao2_container *hashes = NULL;
+	int gen_hash = 0;
 
 	ast_mutex_lock(&reload_lock);
 
@@ -2098,7 +2276,7 @@ static int pbx_load_module(void)
 		}
 	}
 
-	if (!pbx_load_config(config)) {
+	if (!pbx_load_config(config, &changed, &hashes, &gen_hash)) {
 		ast_hashtab_destroy(local_table, NULL);
 		local_table = NULL;
 		ast_mutex_unlock(&reload_lock);
@@ -2107,10 +2285,23 @@ static int pbx_load_module(void)
 
 	pbx_load_users();
 
-	ast_merge_contexts_and_delete(&local_contexts, local_table, registrar);
+	/* Must be set before the merge so the new contexts are compiled */
+	pbx_set_extenmatchcache(extenmatchcache_config);
+	if (changed) {
+		ast_verb(3, "Reloading %d changed contexts of the dialplan\n",
+			ao2_container_count(changed));
+		ast_merge_changed_contexts_and_delete(&local_contexts, local_table, registrar, changed);
+		ao2_ref(changed, -1);
+	} else {
+		ast_merge_contexts_and_delete(&local_contexts, local_table, registrar);
+	}
 	local_table = NULL; /* the local table has been moved into the global one. */
 	local_contexts = NULL;
 
+	ao2_replace(context_hashes, hashes);
+	ao2_ref(hashes, -1);
+	general_hash = gen_hash;
+
 	ast_mutex_unlock(&reload_lock);
 
 	for (con = NULL; (con = ast_walk_contexts(con));)
@@ -2119,6 +2310,7 @@ static int pbx_load_module(void)
 	pbx_set_overrideswitch(overrideswitch_config);
 	pbx_set_autofallthrough(autofallthrough_config);
 	pbx_set_extenpatternmatchnew(extenpatternmatchnew_config);
+	pbx_set_hintnotifywindow(hintnotifywindow_config);
 
 	return AST_MODULE_LOAD_SUCCESS;
 }
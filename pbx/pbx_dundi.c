@@ -71,6 +71,8 @@
 #include "asterisk/astdb.h"
 #include "asterisk/acl.h"
 #include "asterisk/app.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/vector.h"
 
 #include "dundi-parser.h"
 
@@ -212,6 +214,24 @@ static time_t rotatetime;
 static dundi_eid empty_eid = { { 0, 0, 0, 0, 0, 0 } };
 static int dundi_shutdown = 0;
 
+/*! Number of buckets of the response cache */
+#define DUNDI_CACHE_BUCKETS 1567
+
+/*! \brief A cached answer or hint, by its key in the dundi/cache astdb family */
+struct dundi_cache_entry {
+	/*! When the entry expires */
+	time_t expiry;
+	/*! The cached data, as kept in astdb */
+	char *data;
+	char key[0];
+};
+
+/*! \brief The response cache, looked up without going to astdb */
+static struct ao2_container *dundi_cache;
+
+/*! \brief Whether the response cache is also kept in astdb across restarts */
+static int dundi_cache_persist = 1;
+
 struct permission {
 	AST_LIST_ENTRY(permission) list;
 	int allow;
@@ -598,7 +618,7 @@ static int dundi_lookup_local(struct dundi_result *dr, struct dundi_mapping *map
 			ast_clear_flag(&flags, DUNDI_FLAG_MATCHMORE|DUNDI_FLAG_CANMATCH);
 		}
 		if (ast_test_flag(&flags, AST_FLAGS_ALL)) {
-			struct varshead headp;
+			struct varshead headp = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
 			struct ast_var_t *newvariable;
 			ast_set_flag(&flags, map->options & 0xffff);
 			ast_copy_flags(dr + anscnt, &flags, AST_FLAGS_ALL);
@@ -861,6 +881,193 @@ static int dundi_answer_entity(struct dundi_transaction *trans, struct dundi_ies
 	return 0;
 }
 
+AO2_STRING_FIELD_HASH_FN(dundi_cache_entry, key);
+AO2_STRING_FIELD_CMP_FN(dundi_cache_entry, key);
+
+static void dundi_cache_entry_destroy(void *obj)
+{
+	struct dundi_cache_entry *entry = obj;
+
+	ast_free(entry->data);
+}
+
+/*! \brief Put an entry in the response cache, replacing any with the same key */
+static void cache_link(const char *key, time_t expiry, const char *data)
+{
+	struct dundi_cache_entry *entry;
+
+	entry = ao2_alloc_options(sizeof(*entry) + strlen(key) + 1, dundi_cache_entry_destroy,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		return;
+	}
+	strcpy(entry->key, key); /* Safe */
+	entry->expiry = expiry;
+	if (!(entry->data = ast_strdup(data))) {
+		ao2_ref(entry, -1);
+		return;
+	}
+
+	ao2_wrlock(dundi_cache);
+	ao2_find(dundi_cache, key, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+	ao2_link_flags(dundi_cache, entry, OBJ_NOLOCK);
+	ao2_unlock(dundi_cache);
+	ao2_ref(entry, -1);
+}
+
+static void cache_put(const char *key, time_t expiry, const char *data)
+{
+	cache_link(key, expiry, data);
+	if (dundi_cache_persist) {
+		ast_db_put("dundi/cache", key, data);
+	}
+}
+
+/*!
+ * \brief Copy the data of a response cache entry
+ *
+ * \retval 0 on success
+ * \retval -1 if there is no such entry
+ */
+static int cache_get(const char *key, char *data, size_t len)
+{
+	struct dundi_cache_entry *entry;
+
+	entry = ao2_find(dundi_cache, key, OBJ_SEARCH_KEY);
+	if (!entry) {
+		return -1;
+	}
+	ast_copy_string(data, entry->data, len);
+	ao2_ref(entry, -1);
+
+	return 0;
+}
+
+static void cache_del(const char *key)
+{
+	ao2_find(dundi_cache, key, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+	if (dundi_cache_persist) {
+		ast_db_del("dundi/cache", key);
+	}
+}
+
+static int cache_expired_cb(void *obj, void *arg, int flags)
+{
+	struct dundi_cache_entry *entry = obj;
+	time_t *now = arg;
+
+	return entry->expiry < *now ? CMP_MATCH : 0;
+}
+
+/*! \brief Drop the expired entries of the response cache */
+static void cache_expire(void)
+{
+	struct ao2_iterator *expired;
+	struct dundi_cache_entry *entry;
+	time_t now;
+
+	time(&now);
+	expired = ao2_callback(dundi_cache, OBJ_MULTIPLE | OBJ_UNLINK, cache_expired_cb, &now);
+	if (!expired) {
+		return;
+	}
+
+	while ((entry = ao2_iterator_next(expired))) {
+		ast_debug(1, "clearing expired DUNDI cache entry: %s\n", entry->key);
+		if (dundi_cache_persist) {
+			ast_db_del("dundi/cache", entry->key);
+		}
+		ao2_ref(entry, -1);
+	}
+	ao2_iterator_destroy(expired);
+}
+
+/*! \brief Fill the response cache with the entries persisted in astdb */
+static void cache_load(void)
+{
+	struct ast_db_entry *db_entry, *db_tree;
+	int striplen = sizeof("/dundi/cache");
+	time_t now;
+	time_t expiry;
+	int count = 0;
+
+	time(&now);
+
+	db_tree = ast_db_gettree("dundi/cache", NULL);
+	for (db_entry = db_tree; db_entry; db_entry = db_entry->next) {
+		if (ast_get_time_t(db_entry->data, &expiry, 0, NULL) || expiry < now) {
+			ast_db_del("dundi/cache", db_entry->key + striplen);
+			continue;
+		}
+		cache_link(db_entry->key + striplen, expiry, db_entry->data);
+		++count;
+	}
+	ast_db_freetree(db_tree);
+
+	ast_debug(1, "Loaded %d DUNDi cache entries\n", count);
+}
+
+static int cache_entry_cmp(const void *a, const void *b)
+{
+	const struct dundi_cache_entry *entry_a = *(struct dundi_cache_entry * const *) a;
+	const struct dundi_cache_entry *entry_b = *(struct dundi_cache_entry * const *) b;
+
+	return strcmp(entry_a->key, entry_b->key);
+}
+
+/*!
+ * \brief Copy the response cache entries whose keys start with prefix
+ *
+ * \return A list of the entries ordered by key, laid out as ast_db_gettree()
+ * returns the dundi/cache family.  Free it with ast_db_freetree().
+ */
+static struct ast_db_entry *cache_gettree(const char *prefix)
+{
+	AST_VECTOR(, struct dundi_cache_entry *) found;
+	struct ao2_iterator i;
+	struct dundi_cache_entry *entry;
+	struct ast_db_entry *head = NULL;
+	struct ast_db_entry **next = &head;
+	size_t prefix_len = strlen(prefix);
+	int x;
+
+	if (AST_VECTOR_INIT(&found, ao2_container_count(dundi_cache))) {
+		return NULL;
+	}
+
+	i = ao2_iterator_init(dundi_cache, 0);
+	while ((entry = ao2_iterator_next(&i))) {
+		if (strncmp(entry->key, prefix, prefix_len) || AST_VECTOR_APPEND(&found, entry)) {
+			ao2_ref(entry, -1);
+		}
+	}
+	ao2_iterator_destroy(&i);
+
+	AST_VECTOR_SORT(&found, cache_entry_cmp);
+
+	for (x = 0; x < AST_VECTOR_SIZE(&found); x++) {
+		struct ast_db_entry *cur;
+		size_t data_len;
+
+		entry = AST_VECTOR_GET(&found, x);
+		data_len = strlen(entry->data);
+		cur = ast_malloc(sizeof(*cur) + data_len + 1 + sizeof("/dundi/cache/") + strlen(entry->key));
+		if (cur) {
+			strcpy(cur->data, entry->data); /* Safe */
+			cur->key = cur->data + data_len + 1;
+			sprintf(cur->key, "/dundi/cache/%s", entry->key); /* Safe */
+			cur->next = NULL;
+			*next = cur;
+			next = &cur->next;
+		}
+	}
+
+	AST_VECTOR_CALLBACK_VOID(&found, ao2_ref, -1);
+	AST_VECTOR_FREE(&found);
+
+	return head;
+}
+
 static int cache_save_hint(dundi_eid *eidpeer, struct dundi_request *req, struct dundi_hint *hint, int expiration)
 {
 	int unaffected;
@@ -889,9 +1096,9 @@ static int cache_save_hint(dundi_eid *eidpeer, struct dundi_request *req, struct
 	timeout += expiration;
 	snprintf(data, sizeof(data), "%ld|", (long)(timeout));
 
-	ast_db_put("dundi/cache", key1, data);
+	cache_put(key1, timeout, data);
 	ast_debug(1, "Caching hint at '%s'\n", key1);
-	ast_db_put("dundi/cache", key2, data);
+	cache_put(key2, timeout, data);
 	ast_debug(1, "Caching hint at '%s'\n", key2);
 	return 0;
 }
@@ -932,8 +1139,8 @@ static int cache_save(dundi_eid *eidpeer, struct dundi_request *req, int start,
 			req->dr[x].flags, req->dr[x].weight, req->dr[x].techint, req->dr[x].dest,
 			dundi_eid_to_str_short(eidpeer_str, sizeof(eidpeer_str), &req->dr[x].eid));
 	}
-	ast_db_put("dundi/cache", key1, data);
-	ast_db_put("dundi/cache", key2, data);
+	cache_put(key1, timeout, data);
+	cache_put(key2, timeout, data);
 	return 0;
 }
 
@@ -1179,7 +1386,7 @@ static int cache_lookup_internal(time_t now, struct dundi_request *req, char *ke
 	char fs[256];
 
 	/* Build request string */
-	if (!ast_db_get("dundi/cache", key, data, sizeof(data))) {
+	if (!cache_get(key, data, sizeof(data))) {
 		time_t timeout;
 		ptr = data;
 		if (!ast_get_time_t(ptr, &timeout, 0, &length)) {
@@ -1231,9 +1438,9 @@ static int cache_lookup_internal(time_t now, struct dundi_request *req, char *ke
 					*lowexpiration = expiration;
 				return 1;
 			} else
-				ast_db_del("dundi/cache", key);
+				cache_del(key);
 		} else
-			ast_db_del("dundi/cache", key);
+			cache_del(key);
 	}
 
 	return 0;
@@ -2227,27 +2434,10 @@ static void *network_thread(void *ignore)
 
 static void *process_clearcache(void *ignore)
 {
-	struct ast_db_entry *db_entry, *db_tree;
-	int striplen = sizeof("/dundi/cache");
-	time_t now;
-
 	while (!dundi_shutdown) {
 		pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
 
-		time(&now);
-
-		db_entry = db_tree = ast_db_gettree("dundi/cache", NULL);
-		for (; db_entry; db_entry = db_entry->next) {
-			time_t expiry;
-
-			if (!ast_get_time_t(db_entry->data, &expiry, 0, NULL)) {
-				if (expiry < now) {
-					ast_debug(1, "clearing expired DUNDI cache entry: %s\n", db_entry->key);
-					ast_db_del("dundi/cache", db_entry->key + striplen);
-				}
-			}
-		}
-		ast_db_freetree(db_tree);
+		cache_expire();
 
 		pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 		pthread_testcancel();
@@ -2394,6 +2584,7 @@ static char *dundi_flush(struct ast_cli_entry *e, int cmd, struct ast_cli_args *
 		}
 		AST_LIST_UNLOCK(&peers);
 	} else {
+		ao2_callback(dundi_cache, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
 		ast_db_deltree("dundi/cache", NULL);
 		ast_cli(a->fd, "DUNDi Cache Flushed\n");
 	}
@@ -2983,7 +3174,7 @@ static char *dundi_show_cache(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 	}
 
 	time(&now);
-	db_tree = ast_db_gettree("dundi/cache", NULL);
+	db_tree = cache_gettree("");
 	ast_cli(a->fd, FORMAT2, "Number", "Context", "Expiration", "From", "Weight", "Destination (Flags)");
 	for (db_entry = db_tree; db_entry; db_entry = db_entry->next) {
 		char *rest;
@@ -3076,7 +3267,7 @@ static char *dundi_show_hints(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 	}
 
 	time(&now);
-	db_tree = ast_db_gettree("dundi/cache/hint", NULL);
+	db_tree = cache_gettree("hint/");
 	ast_cli(a->fd, FORMAT2, "Prefix", "Context", "Expiration", "From");
 
 	for (db_entry = db_tree; db_entry; db_entry = db_entry->next) {
@@ -4944,6 +5135,7 @@ static int set_config(char *config_file, struct ast_sockaddr *sin, int reload, s
 	static int last_port = 0;
 	int port = 0;
 	int globalpcmodel = 0;
+	int cache_persist;
 	dundi_eid testeid;
 	char bind_addr[80]={0,};
 	char bind_addr2[80]={0,};
@@ -4955,6 +5147,7 @@ static int set_config(char *config_file, struct ast_sockaddr *sin, int reload, s
 
 	dundi_ttl = DUNDI_DEFAULT_TTL;
 	dundi_cache_time = DUNDI_DEFAULT_CACHE_TIME;
+	cache_persist = 1;
 	any_peer = NULL;
 
 	AST_LIST_LOCK(&peers);
@@ -5033,10 +5226,18 @@ static int set_config(char *config_file, struct ast_sockaddr *sin, int reload, s
 				ast_log(LOG_WARNING, "'%s' is not a valid cache time at line %d. Using default value '%d'.\n",
 					v->value, v->lineno, DUNDI_DEFAULT_CACHE_TIME);
 			}
+		} else if (!strcasecmp(v->name, "persistentcache")) {
+			cache_persist = ast_true(v->value);
 		}
 		v = v->next;
 	}
 
+	if (dundi_cache_persist && !cache_persist) {
+		/* The entries kept from before would only go stale */
+		ast_db_deltree("dundi/cache", NULL);
+	}
+	dundi_cache_persist = cache_persist;
+
 	if (port == 0) {
 		port = DUNDI_PORT;
 	}
@@ -5135,6 +5336,9 @@ static int unload_module(void)
 	mark_peers();
 	prune_peers();
 
+	ao2_cleanup(dundi_cache);
+	dundi_cache = NULL;
+
 	if (-1 < netsocket) {
 		close(netsocket);
 		netsocket = -1;
@@ -5178,7 +5382,10 @@ static int load_module(void)
 	io = io_context_create();
 	sched = ast_sched_context_create();
 
-	if (!io || !sched) {
+	dundi_cache = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0, DUNDI_CACHE_BUCKETS,
+		dundi_cache_entry_hash_fn, NULL, dundi_cache_entry_cmp_fn);
+
+	if (!io || !sched || !dundi_cache) {
 		goto declined;
 	}
 
@@ -5189,6 +5396,10 @@ static int load_module(void)
 		goto declined;
 	}
 
+	if (dundi_cache_persist) {
+		cache_load();
+	}
+
 	if (!ast_sockaddr_isnull(&sin2)) {
 		if ((ast_sockaddr_is_ipv4(&sin) == ast_sockaddr_is_ipv4(&sin2)) || (ast_sockaddr_is_ipv6(&sin) == ast_sockaddr_is_ipv6(&sin2))) {
 			ast_log(LOG_ERROR, "bindaddr & bindaddr2 should be different IP protocols.\n");
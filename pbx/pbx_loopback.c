@@ -84,7 +84,7 @@
 static char *loopback_subst(char *buf, int buflen, const char *exten, const char *context, int priority, const char *data)
 {
 	struct ast_var_t *newvariable;
-	struct varshead headp;
+	struct varshead headp = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
 	char tmp[80];
 
 	snprintf(tmp, sizeof(tmp), "%d", priority);
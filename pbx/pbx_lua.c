@@ -40,6 +40,7 @@
 #include "asterisk/term.h"
 #include "asterisk/paths.h"
 #include "asterisk/hashtab.h"
+#include "asterisk/lock.h"
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -60,6 +61,9 @@ static char *registrar = "pbx_lua";
  * applications might return */
 #define LUA_GOTO_DETECTED 5
 
+/*! \brief Number of loaded lua states kept ready for new channels */
+#define LUA_POOL_SIZE 8
+
 static char *lua_read_extensions_file(lua_State *L, long *size, int *file_not_openable);
 static int lua_load_extensions(lua_State *L, struct ast_channel *chan);
 static int lua_reload_extensions(lua_State *L);
@@ -96,6 +100,8 @@ static void lua_concat_args(lua_State *L, int start, int nargs);
 
 static void lua_state_destroy(void *data);
 static void lua_datastore_fixup(void *data, struct ast_channel *old_chan, struct ast_channel *new_chan);
+static lua_State *lua_new_state(void);
+static lua_State *lua_pool_take(struct ast_channel *chan);
 static lua_State *lua_get_state(struct ast_channel *chan);
 
 static int exists(struct ast_channel *chan, const char *context, const char *exten, int priority, const char *callerid, const char *data);
@@ -110,6 +116,32 @@ static long config_file_size = 0;
 static struct ast_context *local_contexts = NULL;
 static struct ast_hashtab *local_table = NULL;
 
+/*!
+ * \brief States with extensions.lua already loaded, handed to new channels
+ *
+ * A state is only ever used by one channel and is closed with it, since the
+ * extensions can leave anything behind in their globals.  The pool thread
+ * loads replacements in the background, so a new channel does not wait for
+ * extensions.lua to run.
+ */
+AST_MUTEX_DEFINE_STATIC(lua_pool_lock);
+static ast_cond_t lua_pool_cond;
+static lua_State *lua_pool[LUA_POOL_SIZE];
+static int lua_pool_count;
+/*! Bumped when extensions.lua is reloaded, states loaded before are stale */
+static unsigned int lua_pool_generation;
+static int lua_pool_stop;
+static pthread_t lua_pool_thread = AST_PTHREADT_NULL;
+
+/*!
+ * \brief Shared state for extension lookups without a channel
+ *
+ * Matching only reads the extensions tables, so one state serves every
+ * lookup, one at a time.
+ */
+AST_MUTEX_DEFINE_STATIC(lua_match_lock);
+static lua_State *lua_match_state;
+
 static const struct ast_datastore_info lua_datastore = {
 	.type = "lua",
 	.destroy = lua_state_destroy,
@@ -1257,13 +1289,177 @@ static void lua_free_extensions()
 	ast_mutex_unlock(&config_file_lock);
 }
 
+/*!
+ * \brief Allocate a lua_State and load extensions.lua into it
+ *
+ * \return a lua_State not associated with any channel, or NULL on error
+ */
+static lua_State *lua_new_state(void)
+{
+	lua_State *L = luaL_newstate();
+
+	if (!L) {
+		ast_log(LOG_ERROR, "Error allocating lua_State, no memory\n");
+		return NULL;
+	}
+
+	if (lua_load_extensions(L, NULL)) {
+		const char *error = lua_tostring(L, -1);
+		ast_log(LOG_ERROR, "Error loading extensions.lua: %s\n", error);
+		lua_close(L);
+		return NULL;
+	}
+
+	return L;
+}
+
+/*!
+ * \brief Keep the pool of loaded lua states filled
+ */
+static void *lua_pool_fill(void *data)
+{
+	ast_mutex_lock(&lua_pool_lock);
+	while (!lua_pool_stop) {
+		unsigned int generation;
+		lua_State *L;
+
+		if (lua_pool_count == LUA_POOL_SIZE) {
+			ast_cond_wait(&lua_pool_cond, &lua_pool_lock);
+			continue;
+		}
+
+		generation = lua_pool_generation;
+		ast_mutex_unlock(&lua_pool_lock);
+
+		L = lua_new_state();
+
+		ast_mutex_lock(&lua_pool_lock);
+		if (!L) {
+			/* Don't spin logging errors, try again in a bit. */
+			struct timeval wait = ast_tvadd(ast_tvnow(), ast_tv(1, 0));
+			struct timespec ts = { .tv_sec = wait.tv_sec, .tv_nsec = wait.tv_usec * 1000, };
+
+			ast_cond_timedwait(&lua_pool_cond, &lua_pool_lock, &ts);
+			continue;
+		}
+
+		if (lua_pool_stop || generation != lua_pool_generation
+			|| lua_pool_count == LUA_POOL_SIZE) {
+			/* Closing can take a while on large states. */
+			ast_mutex_unlock(&lua_pool_lock);
+			lua_close(L);
+			ast_mutex_lock(&lua_pool_lock);
+			continue;
+		}
+
+		lua_pool[lua_pool_count++] = L;
+	}
+	ast_mutex_unlock(&lua_pool_lock);
+
+	return NULL;
+}
+
+/*!
+ * \brief Take a loaded lua_State for a channel
+ *
+ * A state is taken from the pool when one is ready, otherwise a new one is
+ * loaded.
+ *
+ * \return a lua_State associated with chan, or NULL on error
+ */
+static lua_State *lua_pool_take(struct ast_channel *chan)
+{
+	lua_State *L = NULL;
+
+	ast_mutex_lock(&lua_pool_lock);
+	if (lua_pool_count) {
+		L = lua_pool[--lua_pool_count];
+		lua_pool[lua_pool_count] = NULL;
+	}
+	ast_cond_signal(&lua_pool_cond);
+	ast_mutex_unlock(&lua_pool_lock);
+
+	if (!L && !(L = lua_new_state())) {
+		return NULL;
+	}
+
+	/* store a pointer to this channel */
+	lua_pushlightuserdata(L, chan);
+	lua_setfield(L, LUA_REGISTRYINDEX, "channel");
+
+	return L;
+}
+
+/*!
+ * \brief Drop the pooled lua states and rebuild the shared match state
+ *
+ * Called once extensions.lua has been (re)loaded so that new channels and
+ * lookups see the new extensions.  Channels keep the state they have.
+ */
+static void lua_pool_flush(void)
+{
+	lua_State *stale[LUA_POOL_SIZE];
+	lua_State *L;
+	int count;
+
+	ast_mutex_lock(&lua_pool_lock);
+	++lua_pool_generation;
+	count = lua_pool_count;
+	memcpy(stale, lua_pool, sizeof(stale));
+	memset(lua_pool, 0, sizeof(lua_pool));
+	lua_pool_count = 0;
+	ast_cond_signal(&lua_pool_cond);
+	ast_mutex_unlock(&lua_pool_lock);
+
+	while (count) {
+		lua_close(stale[--count]);
+	}
+
+	/* If this fails lookups without a channel fall back to a state each. */
+	L = lua_new_state();
+
+	ast_mutex_lock(&lua_match_lock);
+	SWAP(L, lua_match_state);
+	ast_mutex_unlock(&lua_match_lock);
+
+	if (L) {
+		lua_close(L);
+	}
+}
+
+/*!
+ * \brief Stop the pool thread and free the pooled and shared states
+ */
+static void lua_pool_destroy(void)
+{
+	if (lua_pool_thread != AST_PTHREADT_NULL) {
+		ast_mutex_lock(&lua_pool_lock);
+		lua_pool_stop = 1;
+		ast_cond_signal(&lua_pool_cond);
+		ast_mutex_unlock(&lua_pool_lock);
+
+		pthread_join(lua_pool_thread, NULL);
+		lua_pool_thread = AST_PTHREADT_NULL;
+	}
+
+	while (lua_pool_count) {
+		lua_close(lua_pool[--lua_pool_count]);
+		lua_pool[lua_pool_count] = NULL;
+	}
+
+	if (lua_match_state) {
+		lua_close(lua_match_state);
+		lua_match_state = NULL;
+	}
+}
+
 /*!
  * \brief Get the lua_State for this channel
  *
  * If no channel is passed then a new state is allocated.  States with no
  * channel assocatied with them should only be used for matching extensions.
- * If the channel does not yet have a lua state associated with it, one will be
- * created.
+ * If the channel does not yet have a lua state associated with it, one is
+ * taken from the pool.
  *
  * \note If no channel was passed then the caller is expected to free the state
  * using lua_close().
@@ -1273,84 +1469,79 @@ static void lua_free_extensions()
 static lua_State *lua_get_state(struct ast_channel *chan)
 {
 	struct ast_datastore *datastore = NULL;
-	lua_State *L;
 
 	if (!chan) {
-		L = luaL_newstate();
-		if (!L) {
-			ast_log(LOG_ERROR, "Error allocating lua_State, no memory\n");
+		return lua_new_state();
+	}
+
+	ast_channel_lock(chan);
+	datastore = ast_channel_datastore_find(chan, &lua_datastore, NULL);
+	ast_channel_unlock(chan);
+
+	if (!datastore) {
+		/* nothing found, allocate a new lua state */
+		datastore = ast_datastore_alloc(&lua_datastore, NULL);
+		if (!datastore) {
+			ast_log(LOG_ERROR, "Error allocation channel datastore for lua_State\n");
 			return NULL;
 		}
 
-		if (lua_load_extensions(L, NULL)) {
-			const char *error = lua_tostring(L, -1);
-			ast_log(LOG_ERROR, "Error loading extensions.lua: %s\n", error);
-			lua_close(L);
+		datastore->data = lua_pool_take(chan);
+		if (!datastore->data) {
+			ast_datastore_free(datastore);
 			return NULL;
 		}
-		return L;
-	} else {
+
 		ast_channel_lock(chan);
-		datastore = ast_channel_datastore_find(chan, &lua_datastore, NULL);
+		ast_channel_datastore_add(chan, datastore);
 		ast_channel_unlock(chan);
+	}
 
-		if (!datastore) {
-			/* nothing found, allocate a new lua state */
-			datastore = ast_datastore_alloc(&lua_datastore, NULL);
-			if (!datastore) {
-				ast_log(LOG_ERROR, "Error allocation channel datastore for lua_State\n");
-				return NULL;
-			}
-
-			datastore->data = luaL_newstate();
-			if (!datastore->data) {
-				ast_datastore_free(datastore);
-				ast_log(LOG_ERROR, "Error allocating lua_State, no memory\n");
-				return NULL;
-			}
-
-			ast_channel_lock(chan);
-			ast_channel_datastore_add(chan, datastore);
-			ast_channel_unlock(chan);
-
-			L = datastore->data;
-
-			if (lua_load_extensions(L, chan)) {
-				const char *error = lua_tostring(L, -1);
-				ast_log(LOG_ERROR, "Error loading extensions.lua for %s: %s\n", ast_channel_name(chan), error);
+	return datastore->data;
+}
 
-				ast_channel_lock(chan);
-				ast_channel_datastore_remove(chan, datastore);
-				ast_channel_unlock(chan);
+/*!
+ * \brief Look for an extension without running it
+ *
+ * Lookups without a channel use the shared match state.
+ */
+static int lua_match_extension(struct ast_channel *chan, const char *context, const char *exten, int priority, ast_switch_f *func)
+{
+	int res;
+	lua_State *L;
 
-				ast_datastore_free(datastore);
-				return NULL;
-			}
+	if (!chan) {
+		ast_mutex_lock(&lua_match_lock);
+		if (lua_match_state) {
+			res = lua_find_extension(lua_match_state, context, exten, priority, func, 0);
+			ast_mutex_unlock(&lua_match_lock);
+			return res;
 		}
+		ast_mutex_unlock(&lua_match_lock);
+	}
 
-		return datastore->data;
+	L = lua_get_state(chan);
+	if (!L) {
+		return 0;
 	}
+
+	res = lua_find_extension(L, context, exten, priority, func, 0);
+
+	if (!chan) lua_close(L);
+	return res;
 }
 
 static int exists(struct ast_channel *chan, const char *context, const char *exten, int priority, const char *callerid, const char *data)
 {
 	int res;
-	lua_State *L;
 	struct ast_module_user *u = ast_module_user_add(chan);
 	if (!u) {
 		ast_log(LOG_ERROR, "Error adjusting use count, probably could not allocate memory\n");
 		return 0;
 	}
 
-	L = lua_get_state(chan);
-	if (!L) {
-		ast_module_user_remove(u);
-		return 0;
-	}
+	res = lua_match_extension(chan, context, exten, priority, &exists);
 
-	res = lua_find_extension(L, context, exten, priority, &exists, 0);
-
-	if (!chan) lua_close(L);
 	ast_module_user_remove(u);
 	return res;
 }
@@ -1358,22 +1549,14 @@ static int exists(struct ast_channel *chan, const char *context, const char *ext
 static int canmatch(struct ast_channel *chan, const char *context, const char *exten, int priority, const char *callerid, const char *data)
 {
 	int res;
-	lua_State *L;
 	struct ast_module_user *u = ast_module_user_add(chan);
 	if (!u) {
 		ast_log(LOG_ERROR, "Error adjusting use count, probably could not allocate memory\n");
 		return 0;
 	}
 
-	L = lua_get_state(chan);
-	if (!L) {
-		ast_module_user_remove(u);
-		return 0;
-	}
-
-	res = lua_find_extension(L, context, exten, priority, &canmatch, 0);
+	res = lua_match_extension(chan, context, exten, priority, &canmatch);
 
-	if (!chan) lua_close(L);
 	ast_module_user_remove(u);
 	return res;
 }
@@ -1381,22 +1564,14 @@ static int canmatch(struct ast_channel *chan, const char *context, const char *e
 static int matchmore(struct ast_channel *chan, const char *context, const char *exten, int priority, const char *callerid, const char *data)
 {
 	int res;
-	lua_State *L;
 	struct ast_module_user *u = ast_module_user_add(chan);
 	if (!u) {
 		ast_log(LOG_ERROR, "Error adjusting use count, probably could not allocate memory\n");
 		return 0;
 	}
 
-	L = lua_get_state(chan);
-	if (!L) {
-		ast_module_user_remove(u);
-		return 0;
-	}
+	res = lua_match_extension(chan, context, exten, priority, &matchmore);
 
-	res = lua_find_extension(L, context, exten, priority, &matchmore, 0);
-
-	if (!chan) lua_close(L);
 	ast_module_user_remove(u);
 	return res;
 }
@@ -1661,6 +1836,11 @@ static int load_or_reload_lua_stuff(void)
 	}
 
 	lua_close(L);
+
+	if (!loaded) {
+		lua_pool_flush();
+	}
+
 	return res;
 }
 
@@ -1668,6 +1848,8 @@ static int unload_module(void)
 {
 	ast_context_destroy(NULL, registrar);
 	ast_unregister_switch(&lua_switch);
+	lua_pool_destroy();
+	ast_cond_destroy(&lua_pool_cond);
 	lua_free_extensions();
 	return 0;
 }
@@ -1681,14 +1863,28 @@ static int load_module(void)
 {
 	int res;
 
-	if ((res = load_or_reload_lua_stuff()))
+	ast_cond_init(&lua_pool_cond, NULL);
+
+	if ((res = load_or_reload_lua_stuff())) {
+		lua_pool_destroy();
+		ast_cond_destroy(&lua_pool_cond);
 		return res;
+	}
 
 	if (ast_register_switch(&lua_switch)) {
 		ast_log(LOG_ERROR, "Unable to register LUA PBX switch\n");
+		lua_pool_destroy();
+		ast_cond_destroy(&lua_pool_cond);
 		return AST_MODULE_LOAD_FAILURE;
 	}
 
+	lua_pool_stop = 0;
+	if (ast_pthread_create(&lua_pool_thread, NULL, lua_pool_fill, NULL)) {
+		/* Not fatal, channels load their own states. */
+		ast_log(LOG_WARNING, "Unable to start the lua state pool thread\n");
+		lua_pool_thread = AST_PTHREADT_NULL;
+	}
+
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
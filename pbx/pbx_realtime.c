@@ -66,8 +66,14 @@ AST_APP_OPTIONS(switch_opts, {
 	AST_APP_OPTION('p', OPTION_PATTERNS_DISABLED),
 });
 
+/*! \brief How long matches are cached for tables without a realtime cache time, in milliseconds */
+#define DEFAULT_CACHE_TIME 1000
+
 struct cache_entry {
-	struct timeval when;
+	/*! When the match may no longer be used */
+	struct timeval expires;
+	/*! Realtime cache generation the match was looked up in */
+	unsigned int generation;
 	struct ast_variable *var;
 	int priority;
 	char *context;
@@ -118,7 +124,7 @@ static int purge_old_fn(void *obj, void *arg, int flags)
 {
 	struct cache_entry *e = obj;
 	struct timeval *now = arg;
-	return ast_tvdiff_ms(*now, e->when) >= 1000 ? CMP_MATCH : 0;
+	return ast_tvcmp(*now, e->expires) >= 0 ? CMP_MATCH : 0;
 }
 
 static void *cleanup(void *unused)
@@ -232,7 +238,7 @@ static struct ast_variable *realtime_common(const char *context, const char *ext
 	char *table;
 	struct ast_variable *var=NULL;
 	struct ast_flags flags = { 0, };
-	struct cache_entry *ce;
+	struct cache_entry *ce = NULL;
 	struct {
 		struct cache_entry ce;
 		char exten[AST_MAX_EXTENSION];
@@ -255,9 +261,21 @@ static struct ast_variable *realtime_common(const char *context, const char *ext
 	}
 	ast_copy_string(cache_search.exten, exten, sizeof(cache_search.exten));
 	if (mode == MODE_MATCH && (ce = ao2_find(cache, &cache_search, OBJ_POINTER))) {
+		/* Matches found before realtime results were invalidated are stale too */
+		if (ce->generation != ast_realtime_cache_generation()
+			|| ast_tvcmp(ast_tvnow(), ce->expires) >= 0) {
+			ao2_unlink(cache, ce);
+			ao2_ref(ce, -1);
+			ce = NULL;
+		}
+	}
+	if (ce) {
 		var = dup_vars(ce->var);
 		ao2_ref(ce, -1);
 	} else {
+		unsigned int generation = ast_realtime_cache_generation();
+		int ttl = ast_realtime_cache_ttl(table);
+
 		var = realtime_switch_common(table, ctx, exten, priority, mode, flags);
 		do {
 			struct ast_variable *new;
@@ -277,7 +295,8 @@ static struct ast_variable *realtime_common(const char *context, const char *ext
 			strcpy(ce->context, context); /* SAFE */
 			ce->priority = priority;
 			ce->var = new;
-			ce->when = ast_tvnow();
+			ce->generation = generation;
+			ce->expires = ast_tvadd(ast_tvnow(), ttl > 0 ? ast_samp2tv(ttl, 1) : ast_samp2tv(DEFAULT_CACHE_TIME, 1000));
 			ao2_link(cache, ce);
 			pthread_kill(cleanup_thread, SIGURG);
 			ao2_ref(ce, -1);
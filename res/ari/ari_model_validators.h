@@ -1419,6 +1419,42 @@ int ast_ari_validate_application(struct ast_json *json);
  */
 ari_validator ast_ari_validate_application_fn(void);
 
+/*!
+ * \brief Validator for BulkOperation.
+ *
+ * One operation of a bulk request.
+ *
+ * \param json JSON object to validate.
+ * \returns True (non-zero) if valid.
+ * \returns False (zero) if invalid.
+ */
+int ast_ari_validate_bulk_operation(struct ast_json *json);
+
+/*!
+ * \brief Function pointer to ast_ari_validate_bulk_operation().
+ *
+ * See \ref ast_ari_model_validators.h for more details.
+ */
+ari_validator ast_ari_validate_bulk_operation_fn(void);
+
+/*!
+ * \brief Validator for BulkResult.
+ *
+ * The result of one operation of a bulk request.
+ *
+ * \param json JSON object to validate.
+ * \returns True (non-zero) if valid.
+ * \returns False (zero) if invalid.
+ */
+int ast_ari_validate_bulk_result(struct ast_json *json);
+
+/*!
+ * \brief Function pointer to ast_ari_validate_bulk_result().
+ *
+ * See \ref ast_ari_model_validators.h for more details.
+ */
+ari_validator ast_ari_validate_bulk_result_fn(void);
+
 /*
  * JSON models
  *
@@ -1892,6 +1928,15 @@ ari_validator ast_ari_validate_application_fn(void);
  * - events_allowed: List[object] (required)
  * - events_disallowed: List[object] (required)
  * - name: string (required)
+ * BulkOperation
+ * - body: object
+ * - method: string (required)
+ * - query: object
+ * - uri: string (required)
+ * BulkResult
+ * - body: object
+ * - reason: string (required)
+ * - status_code: int (required)
  */
 
 #endif /* _ASTERISK_ARI_MODEL_H */
@@ -33,6 +33,7 @@
 struct ast_ari_websocket_session {
 	struct ast_websocket *ws_session;
 	int (*validator)(struct ast_json *);
+	enum ast_ari_websocket_encoding encoding;
 };
 
 static void websocket_session_dtor(void *obj)
@@ -155,26 +156,53 @@ struct ast_json *ast_ari_websocket_session_read(
 	"  \"message\": \"Message validation failed\""	\
 	"}"
 
+void ast_ari_websocket_session_set_encoding(struct ast_ari_websocket_session *session,
+	enum ast_ari_websocket_encoding encoding)
+{
+	session->encoding = encoding;
+}
+
 int ast_ari_websocket_session_write(struct ast_ari_websocket_session *session,
 	struct ast_json *message)
 {
 	RAII_VAR(char *, str, NULL, ast_json_free);
+	size_t len;
+	int res;
 
 #ifdef AST_DEVMODE
-	if (!session->validator(message)) {
+	if (ast_json_typeof(message) == AST_JSON_ARRAY) {
+		size_t i;
+
+		for (i = 0; i < ast_json_array_size(message); ++i) {
+			if (!session->validator(ast_json_array_get(message, i))) {
+				ast_log(LOG_ERROR, "Outgoing message failed validation\n");
+				return ast_websocket_write_string(session->ws_session, VALIDATION_FAILED);
+			}
+		}
+	} else if (!session->validator(message)) {
 		ast_log(LOG_ERROR, "Outgoing message failed validation\n");
 		return ast_websocket_write_string(session->ws_session, VALIDATION_FAILED);
 	}
 #endif
 
-	str = ast_json_dump_string_format(message, ast_ari_json_format());
+	if (session->encoding == AST_ARI_WEBSOCKET_ENCODING_MSGPACK) {
+		str = ast_json_dump_msgpack(message, &len);
+	} else {
+		str = ast_json_dump_string_format(message, ast_ari_json_format());
+	}
 
 	if (str == NULL) {
 		ast_log(LOG_ERROR, "Failed to encode JSON object\n");
 		return -1;
 	}
 
-	if (ast_websocket_write_string(session->ws_session, str)) {
+	if (session->encoding == AST_ARI_WEBSOCKET_ENCODING_MSGPACK) {
+		res = ast_websocket_write(session->ws_session, AST_WEBSOCKET_OPCODE_BINARY, str, len);
+	} else {
+		res = ast_websocket_write_string(session->ws_session, str);
+	}
+
+	if (res) {
 		ast_log(LOG_NOTICE, "Problem occurred during websocket write to %s, websocket closed\n",
 			ast_sockaddr_stringify(ast_ari_websocket_session_get_remote_addr(session)));
 		return -1;
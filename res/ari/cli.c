@@ -374,6 +374,31 @@ static char *ari_show_app(struct ast_cli_entry *e, int cmd, struct ast_cli_args
 	return CLI_SUCCESS;
 }
 
+static char *ari_show_command_latency(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "ari show command latency";
+		e->usage =
+			"Usage: ari show command latency\n"
+			"       Shows how long channel commands waited before being run.\n"
+			;
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	default:
+		break;
+	}
+
+	if (a->argc != 4) {
+		return CLI_SHOWUSAGE;
+	}
+
+	stasis_app_command_latency_to_cli(a);
+
+	return CLI_SUCCESS;
+}
+
 static char *ari_set_debug(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
 	void *app;
@@ -429,6 +454,7 @@ static struct ast_cli_entry cli_ari[] = {
 	AST_CLI_DEFINE(ari_show_apps, "List registered ARI applications"),
 	AST_CLI_DEFINE(ari_show_app, "Display details of a registered ARI application"),
 	AST_CLI_DEFINE(ari_set_debug, "Enable/disable debugging of an ARI application"),
+	AST_CLI_DEFINE(ari_show_command_latency, "Show latency of channel commands"),
 };
 
 int ast_ari_cli_register(void) {
@@ -432,7 +432,7 @@ static void ari_bridges_play_new(const char **args_media,
 	ast_debug(1, "Created announcer channel '%s'\n", ast_channel_name(play_channel));
 
 	bridge_topic = ast_bridge_topic(bridge);
-	channel_topic = ast_channel_topic(play_channel);
+	channel_topic = ast_channel_own_topic(play_channel);
 
 	/* Forward messages from the playback channel topic to the bridge topic so that anything listening for
 	 * messages on the bridge topic will receive the playback start/stop messages. Other messages that would
@@ -664,7 +664,7 @@ void ast_ari_bridges_record(struct ast_variable *headers,
 	}
 
 	bridge_topic = ast_bridge_topic(bridge);
-	channel_topic = ast_channel_topic(record_channel);
+	channel_topic = ast_channel_own_topic(record_channel);
 
 	/* Forward messages from the recording channel topic to the bridge topic so that anything listening for
 	 * messages on the bridge topic will receive the recording start/stop messages. Other messages that would
@@ -887,9 +887,19 @@ void ast_ari_bridges_list(struct ast_variable *headers,
 	struct ast_ari_response *response)
 {
 	RAII_VAR(struct ao2_container *, bridges, NULL, ao2_cleanup);
-	RAII_VAR(struct ast_json *, json, NULL, ast_json_unref);
+	struct ast_str *body;
+	struct ast_json_writer writer;
 	struct ao2_iterator i;
 	struct ast_bridge *bridge;
+	struct ast_ari_page *page = NULL;
+	size_t idx;
+	int res = 0;
+
+	if (args->limit < 0) {
+		ast_ari_response_error(response, 400, "Bad Request",
+			"Invalid limit");
+		return;
+	}
 
 	bridges = ast_bridges();
 	if (!bridges) {
@@ -897,29 +907,75 @@ void ast_ari_bridges_list(struct ast_variable *headers,
 		return;
 	}
 
-	json = ast_json_array_create();
-	if (!json) {
+	body = ast_str_create(1024);
+	if (!body) {
 		ast_ari_response_alloc_failed(response);
 		return;
 	}
 
+	if (args->limit || !ast_strlen_zero(args->after)) {
+		page = ast_ari_page_alloc(args->after, args->limit);
+		if (!page) {
+			ast_free(body);
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+	}
+
+	ast_json_writer_init(&writer, &body);
+	ast_json_writer_array_start(&writer);
+
 	i = ao2_iterator_init(bridges, 0);
 	while ((bridge = ao2_iterator_next(&i))) {
-		struct ast_bridge_snapshot *snapshot = ast_bridge_get_snapshot(bridge);
-		/* ast_bridge_snapshot_to_json will return NULL if snapshot is NULL */
-		struct ast_json *json_bridge = ast_bridge_snapshot_to_json(snapshot, stasis_app_get_sanitizer());
+		struct ast_bridge_snapshot *snapshot;
+
+		if (page) {
+			/* Snapshots are only taken of the bridges that make it onto the page */
+			res = ast_ari_page_offer(page, bridge->uniqueid, bridge);
+
+			ao2_ref(bridge, -1);
+			if (res) {
+				ao2_iterator_destroy(&i);
+				ast_ari_page_free(page);
+				ast_free(body);
+				ast_ari_response_alloc_failed(response);
+				return;
+			}
+			continue;
+		}
+
+		snapshot = ast_bridge_get_snapshot(bridge);
+		/* ast_bridge_snapshot_to_json_writer will fail if snapshot is NULL */
+		res = ast_bridge_snapshot_to_json_writer(snapshot, stasis_app_get_sanitizer(), &writer);
 
 		ao2_ref(bridge, -1);
 		ao2_cleanup(snapshot);
-		if (!json_bridge || ast_json_array_append(json, json_bridge)) {
-			ao2_iterator_destroy(&i);
-			ast_ari_response_alloc_failed(response);
-			return;
+		if (res) {
+			break;
 		}
 	}
 	ao2_iterator_destroy(&i);
 
-	ast_ari_response_ok(response, ast_json_ref(json));
+	for (idx = 0; !res && page && idx < ast_ari_page_count(page); ++idx) {
+		struct ast_bridge_snapshot *snapshot = ast_bridge_get_snapshot(ast_ari_page_get(page, idx));
+
+		if (!snapshot) {
+			/* Destroyed since it was offered */
+			continue;
+		}
+		res = ast_bridge_snapshot_to_json_writer(snapshot, stasis_app_get_sanitizer(), &writer);
+		ao2_ref(snapshot, -1);
+	}
+	ast_ari_page_free(page);
+
+	ast_json_writer_array_end(&writer);
+	if (res || ast_json_writer_finish(&writer)) {
+		ast_free(body);
+		ast_ari_response_alloc_failed(response);
+		return;
+	}
+
+	ast_ari_response_ok_body(response, body);
 }
 
 void ast_ari_bridges_create(struct ast_variable *headers,
@@ -41,7 +41,22 @@
 
 /*! Argument struct for ast_ari_bridges_list() */
 struct ast_ari_bridges_list_args {
+	/*! Return at most this many bridges, ordered by id. 0 returns all of them. */
+	int limit;
+	/*! Only return bridges whose id sorts after this one, ordered by id. To page through all of them, pass the id of the last one on the previous page. */
+	const char *after;
 };
+/*!
+ * \brief Body parsing function for /bridges.
+ * \param body The JSON body from which to parse parameters.
+ * \param[out] args The args structure to parse into.
+ * \retval zero on success
+ * \retval non-zero on failure
+ */
+int ast_ari_bridges_list_parse_body(
+	struct ast_json *body,
+	struct ast_ari_bridges_list_args *args);
+
 /*!
  * \brief List all active bridges in Asterisk.
  *
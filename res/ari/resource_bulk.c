@@ -0,0 +1,218 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief /api-docs/bulk.{format} implementation- Bulk operation resources
+ *
+ * \author Sangoma Technologies Corporation
+ */
+
+/*** MODULEINFO
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/http.h"
+#include "asterisk/strings.h"
+#include "resource_bulk.h"
+
+/*!
+ * \internal
+ * \brief Map the method of an operation to the HTTP method it stands for.
+ *
+ * \return The method, or AST_HTTP_UNKNOWN if it may not be used in a bulk request.
+ */
+static enum ast_http_method bulk_operation_method(struct ast_json *operation)
+{
+	static const enum ast_http_method allowed[] = {
+		AST_HTTP_GET, AST_HTTP_POST, AST_HTTP_PUT, AST_HTTP_DELETE,
+	};
+	const char *method = ast_json_string_get(ast_json_object_get(operation, "method"));
+	int i;
+
+	if (ast_strlen_zero(method)) {
+		return AST_HTTP_UNKNOWN;
+	}
+
+	for (i = 0; i < ARRAY_LEN(allowed); ++i) {
+		if (!strcasecmp(method, ast_get_http_method(allowed[i]))) {
+			return allowed[i];
+		}
+	}
+
+	return AST_HTTP_UNKNOWN;
+}
+
+/*!
+ * \internal
+ * \brief Check one operation before any of them is run.
+ *
+ * \return NULL if the operation may be run, otherwise why not.
+ */
+static const char *bulk_operation_check(struct ast_json *operation)
+{
+	struct ast_json *query;
+	const char *uri;
+
+	if (ast_json_typeof(operation) != AST_JSON_OBJECT) {
+		return "operation is not an object";
+	}
+
+	if (bulk_operation_method(operation) == AST_HTTP_UNKNOWN) {
+		return "method must be one of GET, POST, PUT or DELETE";
+	}
+
+	uri = ast_json_string_get(ast_json_object_get(operation, "uri"));
+	if (ast_strlen_zero(uri)) {
+		return "uri is required";
+	}
+	if (!strcmp(uri, "bulk") || ast_begins_with(uri, "bulk/")) {
+		return "bulk requests may not be nested";
+	}
+
+	query = ast_json_object_get(operation, "query");
+	if (query && ast_json_typeof(query) != AST_JSON_OBJECT) {
+		return "query must be an object";
+	}
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Run one operation through the REST handlers.
+ *
+ * \return The result of the operation, or NULL on allocation failure.
+ */
+static struct ast_json *bulk_operation_run(struct ast_variable *headers,
+	struct ast_json *operation)
+{
+	struct ast_ari_response response = { .fd = -1, 0 };
+	struct ast_variable *get_params = NULL;
+	struct ast_json *body = ast_json_object_get(operation, "body");
+	struct ast_json *query = ast_json_object_get(operation, "query");
+	struct ast_json *result;
+	const char *uri = ast_json_string_get(ast_json_object_get(operation, "uri"));
+
+	/* Handlers take the same URI the HTTP callback gives them, without a leading slash */
+	while (*uri == '/') {
+		++uri;
+	}
+
+	response.headers = ast_str_create(40);
+	if (!response.headers) {
+		return NULL;
+	}
+
+	if (query) {
+		switch (ast_json_to_ast_variables(query, &get_params)) {
+		case AST_JSON_TO_AST_VARS_CODE_SUCCESS:
+			break;
+		case AST_JSON_TO_AST_VARS_CODE_INVALID_TYPE:
+			ast_ari_response_error(&response, 400, "Bad Request",
+				"Only string values in the query object are accepted");
+			break;
+		case AST_JSON_TO_AST_VARS_CODE_OOM:
+			ast_ari_response_alloc_failed(&response);
+			break;
+		}
+	}
+
+	if (!response.response_code) {
+		ast_ari_invoke(NULL, uri, bulk_operation_method(operation), get_params,
+			headers, body ?: ast_json_null(), &response);
+	}
+
+	result = ast_json_pack("{s: i, s: s}",
+		"status_code", response.response_code,
+		"reason", S_OR(response.response_text, ""));
+	if (result && response.message && !ast_json_is_null(response.message)) {
+		/* BulkResult bodies are objects, so a list gets an object of its own */
+		if (ast_json_typeof(response.message) == AST_JSON_ARRAY) {
+			ast_json_object_set(result, "body",
+				ast_json_pack("{s: o}", "items", ast_json_ref(response.message)));
+		} else {
+			ast_json_object_set(result, "body", ast_json_ref(response.message));
+		}
+	}
+
+	ast_json_unref(response.message);
+	if (response.fd >= 0) {
+		close(response.fd);
+	}
+	ast_free(response.headers);
+	ast_variables_destroy(get_params);
+
+	return result;
+}
+
+void ast_ari_bulk_execute(struct ast_variable *headers,
+	struct ast_ari_bulk_execute_args *args,
+	struct ast_ari_response *response)
+{
+	RAII_VAR(struct ast_json *, results, NULL, ast_json_unref);
+	size_t count;
+	size_t i;
+
+	if (ast_json_typeof(args->operations) != AST_JSON_ARRAY) {
+		ast_ari_response_error(response, 400, "Bad Request",
+			"The body must be a list of operations");
+		return;
+	}
+
+	/* Refuse the whole batch up front rather than leave it half done */
+	count = ast_json_array_size(args->operations);
+	for (i = 0; i < count; ++i) {
+		const char *error = bulk_operation_check(ast_json_array_get(args->operations, i));
+
+		if (error) {
+			ast_ari_response_error(response, 400, "Bad Request",
+				"Operation %zu: %s", i, error);
+			return;
+		}
+	}
+
+	results = ast_json_array_create();
+	if (!results) {
+		ast_ari_response_alloc_failed(response);
+		return;
+	}
+
+	for (i = 0; i < count; ++i) {
+		struct ast_json *result;
+		int code;
+
+		result = bulk_operation_run(headers, ast_json_array_get(args->operations, i));
+		if (!result) {
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+		code = ast_json_integer_get(ast_json_object_get(result, "status_code"));
+
+		if (ast_json_array_append(results, result)) {
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+
+		if (args->stop_on_error && (code < 200 || code > 299)) {
+			break;
+		}
+	}
+
+	ast_ari_response_ok(response, ast_json_ref(results));
+}
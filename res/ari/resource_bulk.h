@@ -0,0 +1,71 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Generated file - declares stubs to be implemented in
+ * res/ari/resource_bulk.c
+ *
+ * Bulk operation resources
+ *
+ * \author Sangoma Technologies Corporation
+ */
+
+/*
+ * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+ * !!!!!                               DO NOT EDIT                        !!!!!
+ * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+ * This file is generated by a mustache template. Please see the original
+ * template in rest-api-templates/ari_resource.h.mustache
+ */
+
+#ifndef _ASTERISK_RESOURCE_BULK_H
+#define _ASTERISK_RESOURCE_BULK_H
+
+#include "asterisk/ari.h"
+
+/*! Argument struct for ast_ari_bulk_execute() */
+struct ast_ari_bulk_execute_args {
+	/*! The body object holds the list of operations to run. Ex. [ { "method": "POST", "uri": "channels/1234/answer" }, { "method": "POST", "uri": "channels/1234/play", "query": { "media": "sound:hello-world" } } ] */
+	struct ast_json *operations;
+	/*! Do not run the operations after the first one that fails. */
+	int stop_on_error;
+};
+/*!
+ * \brief Body parsing function for /bulk.
+ * \param body The JSON body from which to parse parameters.
+ * \param[out] args The args structure to parse into.
+ * \retval zero on success
+ * \retval non-zero on failure
+ */
+int ast_ari_bulk_execute_parse_body(
+	struct ast_json *body,
+	struct ast_ari_bulk_execute_args *args);
+
+/*!
+ * \brief Run a list of ARI operations in order.
+ *
+ * Each operation is dispatched exactly as if it had been sent as its own request, so operations on a channel are queued on that channel's control in the order given. Reads are not queued, so they may not yet see the effect of an earlier operation that was. The result of every operation is returned in the same order. Operations may not open a WebSocket or contain another bulk request.
+ *
+ * \param headers HTTP headers
+ * \param args Swagger parameters
+ * \param[out] response HTTP response
+ */
+void ast_ari_bulk_execute(struct ast_variable *headers, struct ast_ari_bulk_execute_args *args, struct ast_ari_response *response);
+
+#endif /* _ASTERISK_RESOURCE_BULK_H */
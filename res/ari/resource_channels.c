@@ -958,19 +958,42 @@ void ast_ari_channels_list(struct ast_variable *headers,
 	struct ast_ari_response *response)
 {
 	RAII_VAR(struct ao2_container *, snapshots, NULL, ao2_cleanup);
-	RAII_VAR(struct ast_json *, json, NULL, ast_json_unref);
+	struct ast_str *body;
+	struct ast_json_writer writer;
 	struct ao2_iterator i;
 	void *obj;
 	struct stasis_message_sanitizer *sanitize = stasis_app_get_sanitizer();
+	struct ast_ari_page *page = NULL;
+	size_t idx;
+	int res = 0;
+
+	if (args->limit < 0) {
+		ast_ari_response_error(response, 400, "Bad Request",
+			"Invalid limit");
+		return;
+	}
 
 	snapshots = ast_channel_cache_all();
 
-	json = ast_json_array_create();
-	if (!json) {
+	body = ast_str_create(1024);
+	if (!body) {
 		ast_ari_response_alloc_failed(response);
 		return;
 	}
 
+	if (args->limit || !ast_strlen_zero(args->after)) {
+		page = ast_ari_page_alloc(args->after, args->limit);
+		if (!page) {
+			ast_free(body);
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+	}
+
+	/* Snapshots are written straight into the body rather than built as a tree */
+	ast_json_writer_init(&writer, &body);
+	ast_json_writer_array_start(&writer);
+
 	i = ao2_iterator_init(snapshots, 0);
 	while ((obj = ao2_iterator_next(&i))) {
 		struct ast_channel_snapshot *snapshot = obj;
@@ -982,19 +1005,41 @@ void ast_ari_channels_list(struct ast_variable *headers,
 			continue;
 		}
 
-		r = ast_json_array_append(
-			json, ast_channel_snapshot_to_json(snapshot, NULL));
-		if (r != 0) {
-			ast_ari_response_alloc_failed(response);
-			ao2_iterator_destroy(&i);
+		if (page) {
+			/* Only the page is turned into JSON, once the whole cache has been seen */
+			r = ast_ari_page_offer(page, snapshot->base->uniqueid, snapshot);
 			ao2_ref(snapshot, -1);
-			return;
+			if (r != 0) {
+				ast_free(body);
+				ast_ari_response_alloc_failed(response);
+				ao2_iterator_destroy(&i);
+				ast_ari_page_free(page);
+				return;
+			}
+			continue;
 		}
+
+		res = ast_channel_snapshot_to_json_writer(snapshot, NULL, &writer);
 		ao2_ref(snapshot, -1);
+		if (res) {
+			break;
+		}
 	}
 	ao2_iterator_destroy(&i);
 
-	ast_ari_response_ok(response, ast_json_ref(json));
+	for (idx = 0; !res && page && idx < ast_ari_page_count(page); ++idx) {
+		res = ast_channel_snapshot_to_json_writer(ast_ari_page_get(page, idx), NULL, &writer);
+	}
+	ast_ari_page_free(page);
+
+	ast_json_writer_array_end(&writer);
+	if (res || ast_json_writer_finish(&writer)) {
+		ast_free(body);
+		ast_ari_response_alloc_failed(response);
+		return;
+	}
+
+	ast_ari_response_ok_body(response, body);
 }
 
 /*! \brief Structure used for origination */
@@ -2081,6 +2126,32 @@ void ast_ari_channels_rtpstatistics(struct ast_variable *headers,
 	return;
 }
 
+/*!
+ * \internal
+ * \brief Add the variables of an external media channel to its response
+ *
+ * The response holds the shared JSON of the channel snapshot, so it is
+ * copied before being changed.
+ */
+static void external_media_set_channelvars(struct ast_ari_response *response,
+	struct ast_channel *chan)
+{
+	struct varshead *vars;
+	struct ast_json *json_channel;
+
+	ast_channel_lock(chan);
+	vars = ast_channel_varshead(chan);
+	if (vars && !AST_LIST_EMPTY(vars) && response->message) {
+		json_channel = ast_json_deep_copy(response->message);
+		if (json_channel) {
+			ast_json_object_set(json_channel, "channelvars", ast_json_channel_vars(vars));
+			ast_json_unref(response->message);
+			response->message = json_channel;
+		}
+	}
+	ast_channel_unlock(chan);
+}
+
 static void external_media_rtp_udp(struct ast_ari_channels_external_media_args *args,
 	struct ast_variable *variables,
 	struct ast_ari_response *response)
@@ -2088,7 +2159,6 @@ static void external_media_rtp_udp(struct ast_ari_channels_external_media_args *
 	size_t endpoint_len;
 	char *endpoint;
 	struct ast_channel *chan;
-	struct varshead *vars;
 
 	endpoint_len = strlen("UnicastRTP/") + strlen(args->external_host) + 1;
 	endpoint = ast_alloca(endpoint_len);
@@ -2116,12 +2186,7 @@ static void external_media_rtp_udp(struct ast_ari_channels_external_media_args *
 		return;
 	}
 
-	ast_channel_lock(chan);
-	vars = ast_channel_varshead(chan);
-	if (vars && !AST_LIST_EMPTY(vars)) {
-		ast_json_object_set(response->message, "channelvars", ast_json_channel_vars(vars));
-	}
-	ast_channel_unlock(chan);
+	external_media_set_channelvars(response, chan);
 	ast_channel_unref(chan);
 }
 
@@ -2132,7 +2197,6 @@ static void external_media_audiosocket_tcp(struct ast_ari_channels_external_medi
 	size_t endpoint_len;
 	char *endpoint;
 	struct ast_channel *chan;
-	struct varshead *vars;
 
 	if (ast_strlen_zero(args->data)) {
 		ast_ari_response_error(response, 400, "Bad Request", "data can not be empty");
@@ -2166,12 +2230,7 @@ static void external_media_audiosocket_tcp(struct ast_ari_channels_external_medi
 		return;
 	}
 
-	ast_channel_lock(chan);
-	vars = ast_channel_varshead(chan);
-	if (vars && !AST_LIST_EMPTY(vars)) {
-		ast_json_object_set(response->message, "channelvars", ast_json_channel_vars(vars));
-	}
-	ast_channel_unlock(chan);
+	external_media_set_channelvars(response, chan);
 	ast_channel_unref(chan);
 }
 
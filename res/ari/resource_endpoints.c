@@ -43,6 +43,14 @@ void ast_ari_endpoints_list(struct ast_variable *headers,
 	RAII_VAR(struct ast_json *, json, NULL, ast_json_unref);
 	struct ao2_iterator i;
 	void *obj;
+	struct ast_ari_page *page = NULL;
+	size_t idx;
+
+	if (args->limit < 0) {
+		ast_ari_response_error(response, 400, "Bad Request",
+			"Invalid limit");
+		return;
+	}
 
 	cache = ast_endpoint_cache();
 	if (!cache) {
@@ -65,12 +73,31 @@ void ast_ari_endpoints_list(struct ast_variable *headers,
 		return;
 	}
 
+	if (args->limit || !ast_strlen_zero(args->after)) {
+		page = ast_ari_page_alloc(args->after, args->limit);
+		if (!page) {
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+	}
+
 	i = ao2_iterator_init(snapshots, 0);
 	while ((obj = ao2_iterator_next(&i))) {
 		RAII_VAR(struct stasis_message *, msg, obj, ao2_cleanup);
 		struct ast_endpoint_snapshot *snapshot = stasis_message_data(msg);
-		struct ast_json *json_endpoint = ast_endpoint_snapshot_to_json(snapshot, stasis_app_get_sanitizer());
+		struct ast_json *json_endpoint;
 
+		if (page) {
+			if (ast_ari_page_offer(page, snapshot->id, msg)) {
+				ao2_iterator_destroy(&i);
+				ast_ari_page_free(page);
+				ast_ari_response_alloc_failed(response);
+				return;
+			}
+			continue;
+		}
+
+		json_endpoint = ast_endpoint_snapshot_to_json(snapshot, stasis_app_get_sanitizer());
 		if (!json_endpoint || ast_json_array_append(json, json_endpoint)) {
 			ao2_iterator_destroy(&i);
 			ast_ari_response_alloc_failed(response);
@@ -79,6 +106,18 @@ void ast_ari_endpoints_list(struct ast_variable *headers,
 	}
 	ao2_iterator_destroy(&i);
 
+	for (idx = 0; page && idx < ast_ari_page_count(page); ++idx) {
+		struct ast_endpoint_snapshot *snapshot = stasis_message_data(ast_ari_page_get(page, idx));
+		struct ast_json *json_endpoint = ast_endpoint_snapshot_to_json(snapshot, stasis_app_get_sanitizer());
+
+		if (!json_endpoint || ast_json_array_append(json, json_endpoint)) {
+			ast_ari_page_free(page);
+			ast_ari_response_alloc_failed(response);
+			return;
+		}
+	}
+	ast_ari_page_free(page);
+
 	ast_ari_response_ok(response, ast_json_ref(json));
 }
 
@@ -41,7 +41,22 @@
 
 /*! Argument struct for ast_ari_endpoints_list() */
 struct ast_ari_endpoints_list_args {
+	/*! Return at most this many endpoints, ordered by technology/resource. 0 returns all of them. */
+	int limit;
+	/*! Only return endpoints whose technology/resource sorts after this one, ordered by technology/resource. To page through all of them, pass the technology/resource of the last one on the previous page. */
+	const char *after;
 };
+/*!
+ * \brief Body parsing function for /endpoints.
+ * \param body The JSON body from which to parse parameters.
+ * \param[out] args The args structure to parse into.
+ * \retval zero on success
+ * \retval non-zero on failure
+ */
+int ast_ari_endpoints_list_parse_body(
+	struct ast_json *body,
+	struct ast_ari_endpoints_list_args *args);
+
 /*!
  * \brief List all endpoints.
  *
@@ -34,6 +34,7 @@
 #include "asterisk/http_websocket.h"
 #include "asterisk/stasis_app.h"
 #include "asterisk/vector.h"
+#include "asterisk/sched.h"
 
 /*! Number of buckets for the event session registry. Remember to keep it a prime number! */
 #define EVENT_SESSION_NUM_BUCKETS 23
@@ -44,6 +45,12 @@
 /*! Initial size of a message queue. */
 #define MESSAGES_INIT_SIZE 23
 
+/*! Default time (ms) an event waits in a batch that is not full. */
+#define BATCH_DELAY_DEFAULT 10
+
+/*! Most events or milliseconds a batch may be configured to hold. */
+#define BATCH_MAX 1000
+
 
 /*! \brief A wrapper for the /ref ast_ari_websocket_session. */
 struct event_session {
@@ -51,6 +58,10 @@ struct event_session {
 	struct ao2_container *websocket_apps;           /*!< List of Stasis apps registered to
 	                                                     the websocket session. */
 	AST_VECTOR(, struct ast_json *) message_queue;  /*!< Container for holding delayed messages. */
+	struct ast_json *batch;                         /*!< Events waiting to be sent in one frame. */
+	int batch_size;                                 /*!< Events sent in one frame, 1 if not batching. */
+	int batch_delay;                                /*!< Time (ms) an event waits in a batch. */
+	unsigned int batch_scheduled:1;                 /*!< A batch flush is scheduled. */
 	char session_id[];                              /*!< The id for the websocket session. */
 };
 
@@ -62,11 +73,111 @@ enum event_session_error_type {
 	ERROR_TYPE_MISSING_APP_PARAM = 3,    /*!< HTTP request was missing an [app] parameter. */
 	ERROR_TYPE_INVALID_APP_PARAM = 4,    /*!< HTTP request contained an invalid [app]
 	                                          parameter. */
+	ERROR_TYPE_INVALID_ENCODING_PARAM = 5, /*!< HTTP request contained an invalid [encoding]
+	                                            parameter. */
+	ERROR_TYPE_INVALID_BATCH_PARAM = 6,  /*!< HTTP request contained an invalid [batchSize]
+	                                          or [batchDelay] parameter. */
 };
 
 /*! \brief Local registry for created \ref event_session objects. */
 static struct ao2_container *event_session_registry;
 
+/*! \brief Scheduler sending batches that did not fill up in time. */
+static struct ast_sched_context *batch_sched;
+
+/*!
+ * \brief Send the events batched on an \ref event_session.
+ *
+ * \internal
+ *
+ * \note The session must be locked.
+ *
+ * \param session  The event session object.
+ */
+static void event_session_batch_send(struct event_session *session)
+{
+	if (!session->batch) {
+		return;
+	}
+
+	if (session->ws_session) {
+		ast_ari_websocket_session_write(session->ws_session, session->batch);
+	}
+	ast_json_unref(session->batch);
+	session->batch = NULL;
+}
+
+/*!
+ * \brief Scheduler callback sending a batch that did not fill up in time.
+ *
+ * \internal
+ *
+ * \param data  Void pointer to the event session, whose reference is released.
+ */
+static int event_session_batch_expired(const void *data)
+{
+	struct event_session *session = (struct event_session *) data;
+
+	ao2_lock(session);
+	session->batch_scheduled = 0;
+	event_session_batch_send(session);
+	ao2_unlock(session);
+
+	ao2_ref(session, -1);
+	return 0;
+}
+
+static int event_session_batch_cleanup(const void *data)
+{
+	struct event_session *session = (struct event_session *) data;
+
+	ao2_ref(session, -1);
+	return 0;
+}
+
+/*!
+ * \brief Add an event to the batch of an \ref event_session.
+ *
+ * \details The batch is sent once it holds \c batch_size events, or
+ *          \c batch_delay after the first event it got.  A scheduled flush
+ *          left over from a batch that filled up just sends the next one early.
+ *
+ * \internal
+ *
+ * \note The session must be locked.
+ *
+ * \param session  The event session object.
+ * \param message  The event to send.
+ */
+static void event_session_batch_add(struct event_session *session, struct ast_json *message)
+{
+	if (!session->batch) {
+		session->batch = ast_json_array_create();
+		if (!session->batch) {
+			ast_ari_websocket_session_write(session->ws_session, message);
+			return;
+		}
+	}
+
+	if (ast_json_array_append(session->batch, ast_json_ref(message))) {
+		ast_ari_websocket_session_write(session->ws_session, message);
+		return;
+	}
+
+	if (ast_json_array_size(session->batch) >= session->batch_size) {
+		event_session_batch_send(session);
+	} else if (!session->batch_scheduled) {
+		ao2_ref(session, +1);
+		if (ast_sched_add(batch_sched, session->batch_delay,
+			event_session_batch_expired, session) < 0) {
+			ao2_ref(session, -1);
+			event_session_batch_send(session);
+		} else {
+			session->batch_scheduled = 1;
+		}
+	}
+}
+
 /*!
  * \brief Callback handler for Stasis application messages.
  *
@@ -132,7 +243,11 @@ static void stasis_app_message_handler(
 		}
 
 		/* We are ready to publish the message */
-		ast_ari_websocket_session_write(session->ws_session, message);
+		if (session->batch_size > 1) {
+			event_session_batch_add(session, message);
+		} else {
+			ast_ari_websocket_session_write(session->ws_session, message);
+		}
 	}
 
 	ao2_unlock(session);
@@ -246,6 +361,10 @@ static void event_session_shutdown(struct event_session *session)
 	}
 	AST_VECTOR_FREE(&session->message_queue);
 
+	/* Events still batched have nowhere to go */
+	ast_json_unref(session->batch);
+	session->batch = NULL;
+
 	/* Remove the handle to the underlying websocket session */
 	session->ws_session = NULL;
 }
@@ -323,6 +442,7 @@ static void event_session_dtor(void *obj)
 	ast_assert(session->ws_session == NULL);
 	ast_assert(session->websocket_apps == NULL);
 	ast_assert(AST_VECTOR_SIZE(&session->message_queue) == 0);
+	ast_assert(session->batch == NULL);
 }
 
 /*!
@@ -362,6 +482,16 @@ static int event_session_allocation_error_handler(
 			"Invalid application provided in param [app].");
 		break;
 
+	case ERROR_TYPE_INVALID_ENCODING_PARAM:
+		ast_http_error(ser, 400, "Bad Request",
+			"Invalid encoding provided in param [encoding].");
+		break;
+
+	case ERROR_TYPE_INVALID_BATCH_PARAM:
+		ast_http_error(ser, 400, "Bad Request",
+			"Invalid value provided in param [batchSize] or [batchDelay].");
+		break;
+
 	default:
 		break;
 	}
@@ -398,6 +528,18 @@ static int event_session_alloc(struct ast_tcptls_session_instance *ser,
 			session, ERROR_TYPE_MISSING_APP_PARAM, ser);
 	}
 
+	if (!ast_strlen_zero(args->encoding) && strcmp(args->encoding, "json")
+		&& strcmp(args->encoding, "msgpack")) {
+		return event_session_allocation_error_handler(
+			session, ERROR_TYPE_INVALID_ENCODING_PARAM, ser);
+	}
+
+	if (args->batch_size < 0 || args->batch_size > BATCH_MAX
+		|| args->batch_delay < 0 || args->batch_delay > BATCH_MAX) {
+		return event_session_allocation_error_handler(
+			session, ERROR_TYPE_INVALID_BATCH_PARAM, ser);
+	}
+
 	size = sizeof(*session) + strlen(session_id) + 1;
 
 	/* Instantiate the event session */
@@ -408,6 +550,9 @@ static int event_session_alloc(struct ast_tcptls_session_instance *ser,
 
 	strncpy(session->session_id, session_id, size - sizeof(*session));
 
+	session->batch_size = args->batch_size ? args->batch_size : 1;
+	session->batch_delay = args->batch_delay ? args->batch_delay : BATCH_DELAY_DEFAULT;
+
 	/* Instantiate the hash table for Stasis apps */
 	session->websocket_apps =
 		ast_str_container_alloc(APPS_NUM_BUCKETS);
@@ -468,6 +613,13 @@ void ast_ari_websocket_events_event_websocket_dtor(void)
 
 	ao2_cleanup(event_session_registry);
 	event_session_registry = NULL;
+
+	if (batch_sched) {
+		ast_sched_clean_by_callback(batch_sched, event_session_batch_expired,
+			event_session_batch_cleanup);
+		ast_sched_context_destroy(batch_sched);
+		batch_sched = NULL;
+	}
 }
 
 int ast_ari_websocket_events_event_websocket_init(void)
@@ -482,6 +634,16 @@ int ast_ari_websocket_events_event_websocket_init(void)
 		return -1;
 	}
 
+	batch_sched = ast_sched_context_create();
+	if (!batch_sched || ast_sched_start_thread(batch_sched)) {
+		ast_log(LOG_WARNING, "Failed to start the scheduler for batched events\n");
+		ast_sched_context_destroy(batch_sched);
+		batch_sched = NULL;
+		ao2_cleanup(event_session_registry);
+		event_session_registry = NULL;
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -511,6 +673,10 @@ void ast_ari_websocket_events_event_websocket_established(
 	session_id = ast_ari_websocket_session_id(ws_session);
 
 	/* Find the event_session and update its websocket  */
+	if (!ast_strlen_zero(args->encoding) && !strcmp(args->encoding, "msgpack")) {
+		ast_ari_websocket_session_set_encoding(ws_session, AST_ARI_WEBSOCKET_ENCODING_MSGPACK);
+	}
+
 	session = ao2_find(event_session_registry, session_id, OBJ_SEARCH_KEY);
 	if (session) {
 		ao2_unlink(event_session_registry, session);
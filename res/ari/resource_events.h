@@ -49,6 +49,12 @@ struct ast_ari_events_event_websocket_args {
 	char *app_parse;
 	/*! Subscribe to all Asterisk events. If provided, the applications listed will be subscribed to all events, effectively disabling the application specific subscriptions. Default is 'false'. */
 	int subscribe_all;
+	/*! Encoding of the events. 'json' sends each event as a JSON text frame, 'msgpack' as a MessagePack binary frame holding the same structure. */
+	const char *encoding;
+	/*! Most events sent in one frame. Above 1 the frame holds an array of events instead of a single event, sent once it is full or batchDelay after its first event. */
+	int batch_size;
+	/*! Most time (in milliseconds) an event waits in a batch that is not full. */
+	int batch_delay;
 };
 
 /*!
@@ -122,6 +122,7 @@ static struct parked_user *generate_parked_user(struct parking_lot *lot, struct
 	if (!new_parked_user) {
 		return NULL;
 	}
+	new_parked_user->timeout_id = -1;
 
 	if (use_random_space) {
 		preferred_space = ast_random() % (lot->cfg->parking_stop - lot->cfg->parking_start + 1);
@@ -182,6 +183,7 @@ static struct parked_user *generate_parked_user(struct parking_lot *lot, struct
 
 	/* Insert into the parking lot's parked user list. We can unlock the lot now. */
 	ao2_link(lot->parked_users, new_parked_user);
+	parking_lot_set_space(lot, parking_space, 1);
 	ao2_unlock(lot);
 
 	return new_parked_user;
@@ -248,7 +250,7 @@ static int bridge_parking_push(struct ast_bridge_parking *self, struct ast_bridg
 
 		ast_bridge_channel_unlock(swap);
 
-		parking_set_duration(bridge_channel->features, pu);
+		parking_set_duration(pu);
 
 		if (parking_channel_set_roles(bridge_channel->chan, self->lot, use_ringing)) {
 			ast_log(LOG_WARNING, "Failed to apply holding bridge roles to %s while joining the parking lot.\n",
@@ -312,7 +314,7 @@ static int bridge_parking_push(struct ast_bridge_parking *self, struct ast_bridg
 	}
 
 	/* Apply parking duration limits */
-	parking_set_duration(bridge_channel->features, pu);
+	parking_set_duration(pu);
 
 	/* Set this to the bridge pvt so that we don't have to refind the parked user associated with this bridge channel again. */
 	bridge_channel->bridge_pvt = pu;
@@ -354,6 +356,8 @@ static void bridge_parking_pull(struct ast_bridge_parking *self, struct ast_brid
 		return;
 	}
 
+	parking_cancel_duration(pu);
+
 	/* If we got here without the resolution being set, that's because the call was hung up for some reason without
 	 * timing out or being picked up. There may be some forcible park removals later, but the resolution should be
 	 * handled in those cases */
@@ -435,6 +439,19 @@ struct ast_bridge_methods ast_bridge_parking_v_table = {
 	.get_merge_priority = (ast_bridge_merge_priority_fn) bridge_parking_get_merge_priority,
 };
 
+struct parked_user *parking_bridge_channel_get_parked_user(struct ast_bridge_channel *bridge_channel)
+{
+	struct parked_user *pu = NULL;
+
+	ast_bridge_channel_lock_bridge(bridge_channel);
+	if (bridge_channel->bridge->v_table == &ast_bridge_parking_v_table) {
+		pu = ao2_bump(bridge_channel->bridge_pvt);
+	}
+	ast_bridge_unlock(bridge_channel->bridge);
+
+	return pu;
+}
+
 static struct ast_bridge *ast_bridge_parking_init(struct ast_bridge_parking *self, struct parking_lot *bridge_lot)
 {
 	if (!self) {
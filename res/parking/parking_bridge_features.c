@@ -43,6 +43,7 @@
 #include "asterisk/module.h"
 #include "asterisk/core_local.h"
 #include "asterisk/causes.h"
+#include "asterisk/sched.h"
 
 /*** DOCUMENTATION
 	<function name="PARK_GET_CHANNEL" language="en_US">
@@ -62,6 +63,9 @@
 	</function>
 ***/
 
+/*! \brief Timer wheel shared by the timeouts of every parked call */
+static struct ast_sched_context *parking_timeouts;
+
 struct parked_subscription_datastore {
 	struct stasis_subscription *parked_subscription;
 };
@@ -567,14 +571,13 @@ static void parking_timeout_set_caller_features(struct ast_channel *chan, struct
 }
 
 /*! \internal
- * \brief Interval hook. Pulls a parked call from the parking bridge after the timeout is passed and sets the resolution to timeout.
+ * \brief Pulls a parked call from the parking bridge after the timeout is passed and sets the resolution to timeout.
  *
- * \param bridge_channel bridge channel this interval hook is being executed on
- * \param hook_pvt A pointer to the parked_user struct associated with the channel is stuffed in here
+ * \param bridge_channel bridge channel of the parked call, this is called from its thread
+ * \param user The parked_user struct associated with the channel
  */
-static int parking_duration_callback(struct ast_bridge_channel *bridge_channel, void *hook_pvt)
+static void parking_duration_callback(struct ast_bridge_channel *bridge_channel, struct parked_user *user)
 {
-	struct parked_user *user = hook_pvt;
 	struct ast_channel *chan = user->chan;
 	struct ast_context *park_dial_context;
 	const char *dial_string;
@@ -593,7 +596,7 @@ static int parking_duration_callback(struct ast_bridge_channel *bridge_channel,
 	if (user->resolution != PARK_UNSET) {
 		/* Abandon timeout since something else has resolved the parked user before we got to it. */
 		ao2_unlock(user);
-		return -1;
+		return;
 	}
 	user->resolution = PARK_TIMEOUT;
 	ao2_unlock(user);
@@ -621,7 +624,7 @@ static int parking_duration_callback(struct ast_bridge_channel *bridge_channel,
 
 	if (ast_wrlock_contexts()) {
 		ast_log(LOG_ERROR, "Failed to lock the contexts list. Can't add the park-dial extension.\n");
-		return -1;
+		return;
 	}
 
 	if (!(park_dial_context = ast_context_find_or_create(NULL, NULL, PARK_DIAL_CONTEXT, BASE_REGISTRAR))) {
@@ -676,8 +679,63 @@ abandon_extension_creation:
 	} else {
 		comeback_goto(user, user->lot);
 	}
+}
+
+/*! \internal
+ * \brief Bridge channel callback running a parking timeout on the thread of the parked call
+ *
+ * \note The timeout is checked again since the channel may have been
+ *       parked anew since the timer fired.
+ */
+static void parking_timeout_expired(struct ast_bridge_channel *bridge_channel, const void *payload, size_t payload_size)
+{
+	struct parked_user *user;
+
+	user = parking_bridge_channel_get_parked_user(bridge_channel);
+	if (!user) {
+		return;
+	}
+
+	if (user->time_limit && ast_remaining_ms(user->start, user->time_limit * 1000) <= 0) {
+		parking_duration_callback(bridge_channel, user);
+	}
+	ao2_ref(user, -1);
+}
+
+/*! \internal
+ * \brief Timer wheel callback of a parking timeout
+ *
+ * Hands the timeout to the thread of the bridge channel currently holding
+ * the parked call.
+ */
+static int parking_timeout_cb(const void *data)
+{
+	struct parked_user *user = (struct parked_user *) data;
+	struct ast_channel *chan;
+	struct ast_bridge_channel *bridge_channel;
+
+	if (!ast_atomic_dec_and_test(&user->timeout_armed)) {
+		/* Cancelled while it was firing and the reference is already gone */
+		return 0;
+	}
+
+	ao2_lock(user);
+	chan = ast_channel_ref(user->chan);
+	ao2_unlock(user);
+
+	ast_channel_lock(chan);
+	bridge_channel = ast_channel_get_bridge_channel(chan);
+	ast_channel_unlock(chan);
+
+	if (bridge_channel) {
+		ast_bridge_channel_queue_callback(bridge_channel, 0, parking_timeout_expired, NULL, 0);
+		ao2_ref(bridge_channel, -1);
+	}
+
+	ast_channel_unref(chan);
+	ao2_ref(user, -1);
 
-	return -1;
+	return 0;
 }
 
 void say_parking_space(struct ast_bridge_channel *bridge_channel, const char *payload)
@@ -702,29 +760,50 @@ void say_parking_space(struct ast_bridge_channel *bridge_channel, const char *pa
 	}
 }
 
-void parking_set_duration(struct ast_bridge_features *features, struct parked_user *user)
+void parking_set_duration(struct parked_user *user)
 {
-	unsigned int time_limit;
-
-	time_limit = user->time_limit * 1000;
+	int time_limit;
 
-	if (!time_limit) {
+	if (!user->time_limit) {
 		/* There is no duration limit that we need to apply. */
 		return;
 	}
 
+	if (user->timeout_id != -1) {
+		/* The timeout follows the parked user through swaps. */
+		return;
+	}
+
 	/* If the time limit has already been passed, set a really low time limit so we can kick them out immediately. */
-	time_limit = ast_remaining_ms(user->start, time_limit);
+	time_limit = ast_remaining_ms(user->start, user->time_limit * 1000);
 	if (time_limit <= 0) {
 		time_limit = 1;
 	}
 
-	/* The interval hook is going to need a reference to the parked_user */
+	/* The timer wheel is going to need a reference to the parked_user */
 	ao2_ref(user, +1);
+	user->timeout_armed = 1;
 
-	if (ast_bridge_interval_hook(features, 0, time_limit,
-		parking_duration_callback, user, __ao2_cleanup, AST_BRIDGE_HOOK_REMOVE_ON_PULL)) {
+	user->timeout_id = ast_sched_add(parking_timeouts, time_limit, parking_timeout_cb, user);
+	if (user->timeout_id < 0) {
 		ast_log(LOG_ERROR, "Failed to apply duration limit to the parked call.\n");
+		user->timeout_armed = 0;
+		ao2_ref(user, -1);
+	}
+}
+
+void parking_cancel_duration(struct parked_user *user)
+{
+	if (user->timeout_id < 0) {
+		return;
+	}
+
+	/* This waits for the callback if it is running right now. */
+	if (ast_sched_del(parking_timeouts, user->timeout_id)) {
+		ast_debug(3, "Parking timeout for space %d already fired\n", user->parking_space);
+	}
+
+	if (ast_atomic_dec_and_test(&user->timeout_armed)) {
 		ao2_ref(user, -1);
 	}
 }
@@ -797,12 +876,22 @@ void unload_parking_bridge_features(void)
 	ast_bridge_features_unregister(AST_BRIDGE_BUILTIN_PARKCALL);
 	ast_parking_unregister_bridge_features(parking_provider.module_name);
 	ast_custom_function_unregister(&getparkingslotchannel_function);
+
+	if (parking_timeouts) {
+		ast_sched_context_destroy(parking_timeouts);
+		parking_timeouts = NULL;
+	}
 }
 
 int load_parking_bridge_features(void)
 {
 	parking_provider.module = AST_MODULE_SELF;
 
+	parking_timeouts = ast_sched_context_create_wheel();
+	if (!parking_timeouts || ast_sched_start_thread(parking_timeouts)) {
+		return -1;
+	}
+
 	ast_custom_function_register(&getparkingslotchannel_function);
 
 	if (ast_parking_register_bridge_features(&parking_provider)) {
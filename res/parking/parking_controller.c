@@ -82,10 +82,30 @@ struct parking_limits_pvt {
 	struct parked_user *user;
 };
 
+/*!
+ * \internal
+ * \brief Free the space of a parked user no longer in its lot
+ *
+ * \note The space stays taken if another parked user holds it.
+ */
+static void parking_lot_release_space(struct parking_lot *lot, int space)
+{
+	struct parked_user *other;
+
+	ao2_lock(lot);
+	other = ao2_find(lot->parked_users, &space, OBJ_SEARCH_KEY);
+	if (!other) {
+		parking_lot_set_space(lot, space, 0);
+	}
+	ao2_unlock(lot);
+	ao2_cleanup(other);
+}
+
 int unpark_parked_user(struct parked_user *pu)
 {
 	if (pu->lot) {
 		ao2_unlink(pu->lot->parked_users, pu);
+		parking_lot_release_space(pu->lot, pu->parking_space);
 		parking_lot_remove_if_unused(pu->lot);
 		return 0;
 	}
@@ -93,74 +113,126 @@ int unpark_parked_user(struct parked_user *pu)
 	return -1;
 }
 
-int parking_lot_get_space(struct parking_lot *lot, int target_override)
+void parking_lot_set_space(struct parking_lot *lot, int space, int taken)
 {
-	int original_target;
-	int current_target;
+	int bit = space - lot->occupied_start;
+
+	if (!lot->occupied || bit < 0 || bit >= lot->occupied_count) {
+		return;
+	}
+
+	if (taken) {
+		lot->occupied[bit / 64] |= 1ULL << (bit % 64);
+	} else {
+		lot->occupied[bit / 64] &= ~(1ULL << (bit % 64));
+	}
+}
+
+/*!
+ * \internal
+ * \brief Make the occupied bitmap of a lot cover the spaces it is configured with
+ *
+ * The bitmap is rebuilt from the parked users when the lot is first used
+ * and whenever a reload changes the range of the lot.
+ *
+ * \note lot should be locked before this is called.
+ */
+static int parking_lot_occupied_sync(struct parking_lot *lot)
+{
+	int start = lot->cfg->parking_start;
+	int count = lot->cfg->parking_stop - start + 1;
+	unsigned long long *occupied;
 	struct ao2_iterator i;
 	struct parked_user *user;
-	int wrap;
 
-	if (lot->cfg->parkfindnext) {
-		/* Use next_space if the lot already has next_space set; otherwise use lot start. */
-		original_target = lot->next_space ? lot->next_space : lot->cfg->parking_start;
-	} else {
-		original_target = lot->cfg->parking_start;
+	if (lot->occupied && lot->occupied_start == start && lot->occupied_count == count) {
+		return 0;
 	}
 
-	if (target_override >= lot->cfg->parking_start && target_override <= lot->cfg->parking_stop) {
-		original_target = target_override;
+	if (count <= 0) {
+		return -1;
 	}
 
-	current_target = original_target;
+	occupied = ast_calloc((count + 63) / 64, sizeof(*occupied));
+	if (!occupied) {
+		return -1;
+	}
 
-	wrap = lot->cfg->parking_start;
+	ast_free(lot->occupied);
+	lot->occupied = occupied;
+	lot->occupied_start = start;
+	lot->occupied_count = count;
 
 	i = ao2_iterator_init(lot->parked_users, 0);
 	while ((user = ao2_iterator_next(&i))) {
-		/* Increment the wrap on each pass until we find an empty space */
-		if (wrap == user->parking_space) {
-			wrap += 1;
-		}
+		parking_lot_set_space(lot, user->parking_space, 1);
+		ao2_ref(user, -1);
+	}
+	ao2_iterator_destroy(&i);
 
-		if (user->parking_space < current_target) {
-			/* It's lower than the anticipated target, so we haven't reached the target yet. */
-			ao2_ref(user, -1);
-			continue;
-		}
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Find the first free bit of the occupied bitmap at or after a bit
+ *
+ * \retval -1 if every bit from the given one on is taken
+ * \retval the free bit
+ */
+static int parking_lot_find_free(struct parking_lot *lot, int from)
+{
+	int words = (lot->occupied_count + 63) / 64;
+	int word = from / 64;
+	unsigned long long free_bits = ~lot->occupied[word] & (~0ULL << (from % 64));
+
+	for (;;) {
+		if (free_bits) {
+			int bit = word * 64 + ffsll((long long) free_bits) - 1;
 
-		if (user->parking_space > current_target) {
-			/* The current target is usable because all items below have been read and the next target is higher than the one we want. */
-			ao2_ref(user, -1);
-			break;
+			/* The unused bits past the end of the lot are never taken */
+			return bit < lot->occupied_count ? bit : -1;
 		}
+		if (++word == words) {
+			return -1;
+		}
+		free_bits = ~lot->occupied[word];
+	}
+}
 
-		/* We found one already parked here. */
-		current_target += 1;
-		ao2_ref(user, -1);
+int parking_lot_get_space(struct parking_lot *lot, int target_override)
+{
+	int original_target;
+	int space;
+
+	if (parking_lot_occupied_sync(lot)) {
+		ast_log(LOG_ERROR, "Unable to track the parking spaces of parking lot '%s'\n", lot->name);
+		return -1;
 	}
-	ao2_iterator_destroy(&i);
 
-	if (current_target <= lot->cfg->parking_stop) {
-		return current_target;
+	if (lot->cfg->parkfindnext) {
+		/* Use next_space if the lot already has next_space set; otherwise use lot start. */
+		original_target = lot->next_space ? lot->next_space : lot->cfg->parking_start;
+	} else {
+		original_target = lot->cfg->parking_start;
 	}
 
-	if (wrap <= lot->cfg->parking_stop) {
-		return wrap;
+	if (target_override >= lot->cfg->parking_start && target_override <= lot->cfg->parking_stop) {
+		original_target = target_override;
 	}
 
-	return -1;
-}
+	/* next_space may be left over from before a reload changed the range of the lot */
+	if (original_target < lot->cfg->parking_start || original_target > lot->cfg->parking_stop) {
+		original_target = lot->cfg->parking_start;
+	}
 
-static int retrieve_parked_user_targeted(void *obj, void *arg, int flags)
-{
-	int *target = arg;
-	struct parked_user *user = obj;
-	if (user->parking_space == *target) {
-		return CMP_MATCH;
+	space = parking_lot_find_free(lot, original_target - lot->occupied_start);
+	if (space < 0) {
+		/* Wrap around to the lowest free space of the lot */
+		space = parking_lot_find_free(lot, 0);
 	}
 
-	return 0;
+	return space < 0 ? -1 : space + lot->occupied_start;
 }
 
 struct parked_user *parking_lot_inspect_parked_user(struct parking_lot *lot, int target)
@@ -170,7 +242,7 @@ struct parked_user *parking_lot_inspect_parked_user(struct parking_lot *lot, int
 	if (target < 0) {
 		user = ao2_callback(lot->parked_users, 0, NULL, NULL);
 	} else {
-		user = ao2_callback(lot->parked_users, 0, retrieve_parked_user_targeted, &target);
+		user = ao2_find(lot->parked_users, &target, OBJ_SEARCH_KEY);
 	}
 
 	if (!user) {
@@ -187,7 +259,7 @@ struct parked_user *parking_lot_retrieve_parked_user(struct parking_lot *lot, in
 	if (target < 0) {
 		user = ao2_callback(lot->parked_users, 0, NULL, NULL);
 	} else {
-		user = ao2_callback(lot->parked_users, 0, retrieve_parked_user_targeted, &target);
+		user = ao2_find(lot->parked_users, &target, OBJ_SEARCH_KEY);
 	}
 
 	if (!user) {
@@ -205,6 +277,8 @@ struct parked_user *parking_lot_retrieve_parked_user(struct parking_lot *lot, in
 	user->resolution = PARK_ANSWERED;
 	ao2_unlock(user);
 
+	parking_lot_release_space(lot, user->parking_space);
+
 	parking_lot_remove_if_unused(user->lot);
 
 	/* Bump the ref count by 1 since the RAII_VAR will eat the reference otherwise */
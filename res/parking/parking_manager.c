@@ -189,14 +189,24 @@ static struct ast_parked_call_payload *parked_call_payload_from_failure(struct a
 	return ast_parked_call_payload_create(PARKED_CALL_FAILED, parkee_snapshot, NULL, NULL, NULL, 0, 0, 0);
 }
 
-static struct ast_parked_call_payload *parked_call_payload_from_parked_user(struct parked_user *pu, enum ast_parked_call_event_type event_type)
+static struct ast_parked_call_payload *parked_call_payload_from_snapshot(struct parked_user *pu,
+	enum ast_parked_call_event_type event_type, struct ast_channel_snapshot *parkee_snapshot)
 {
-	RAII_VAR(struct ast_channel_snapshot *, parkee_snapshot, NULL, ao2_cleanup);
 	long int timeout;
 	long int duration;
 	struct timeval now = ast_tvnow();
 	const char *lot_name = pu->lot->name;
 
+	timeout = pu->start.tv_sec + (long) pu->time_limit - now.tv_sec;
+	duration = now.tv_sec - pu->start.tv_sec;
+
+	return ast_parked_call_payload_create(event_type, parkee_snapshot, pu->parker_dial_string, pu->retriever, lot_name, pu->parking_space, timeout, duration);
+}
+
+static struct ast_parked_call_payload *parked_call_payload_from_parked_user(struct parked_user *pu, enum ast_parked_call_event_type event_type)
+{
+	RAII_VAR(struct ast_channel_snapshot *, parkee_snapshot, NULL, ao2_cleanup);
+
 	ast_channel_lock(pu->chan);
 	parkee_snapshot = ast_channel_snapshot_create(pu->chan);
 	ast_channel_unlock(pu->chan);
@@ -204,11 +214,26 @@ static struct ast_parked_call_payload *parked_call_payload_from_parked_user(stru
 		return NULL;
 	}
 
-	timeout = pu->start.tv_sec + (long) pu->time_limit - now.tv_sec;
-	duration = now.tv_sec - pu->start.tv_sec;
+	return parked_call_payload_from_snapshot(pu, event_type, parkee_snapshot);
+}
 
-	return ast_parked_call_payload_create(event_type, parkee_snapshot, pu->parker_dial_string, pu->retriever, lot_name, pu->parking_space, timeout, duration);
+/*!
+ * \internal
+ * \brief Build the payload of a parked call for a listing
+ *
+ * Listings use the last published snapshot of the parkee so that listing a
+ * large lot neither locks nor snapshots every parked channel again.
+ */
+static struct ast_parked_call_payload *parked_call_payload_for_listing(struct parked_user *pu)
+{
+	RAII_VAR(struct ast_channel_snapshot *, parkee_snapshot, NULL, ao2_cleanup);
+
+	parkee_snapshot = ast_channel_snapshot_get_latest(ast_channel_uniqueid(pu->chan));
+	if (!parkee_snapshot) {
+		return parked_call_payload_from_parked_user(pu, PARKED_CALL);
+	}
 
+	return parked_call_payload_from_snapshot(pu, PARKED_CALL, parkee_snapshot);
 }
 
 /*! \brief Builds a manager string based on the contents of a parked call payload */
@@ -276,7 +301,7 @@ static void manager_parking_status_single_lot(struct mansession *s, const struct
 		RAII_VAR(struct ast_parked_call_payload *, payload, NULL, ao2_cleanup);
 		RAII_VAR(struct ast_str *, parked_call_string, NULL, ast_free);
 
-		payload = parked_call_payload_from_parked_user(curuser, PARKED_CALL);
+		payload = parked_call_payload_for_listing(curuser);
 		if (!payload) {
 			ao2_ref(curuser, -1);
 			break;
@@ -331,7 +356,7 @@ static void manager_parking_status_all_lots(struct mansession *s, const struct m
 			RAII_VAR(struct ast_parked_call_payload *, payload, NULL, ao2_cleanup);
 			RAII_VAR(struct ast_str *, parked_call_string, NULL, ast_free);
 
-			payload = parked_call_payload_from_parked_user(curuser, PARKED_CALL);
+			payload = parked_call_payload_for_listing(curuser);
 			if (!payload) {
 				ao2_ref(curuser, -1);
 				ao2_iterator_destroy(&iter_users);
@@ -92,7 +92,10 @@ struct parking_lot_cfg {
 struct parking_lot {
 	int next_space;                           /*!< When using parkfindnext, which space we should start searching from next time we park */
 	struct ast_bridge *parking_bridge;        /*!< Bridged where parked calls will rest until they are answered or otherwise leave */
-	struct ao2_container *parked_users;       /*!< List of parked users rigidly ordered by their parking space */
+	struct ao2_container *parked_users;       /*!< Tree of parked users rigidly ordered by their parking space */
+	unsigned long long *occupied;             /*!< Bitmap of the taken spaces from occupied_start on. Protected by the lot lock */
+	int occupied_start;                       /*!< Parking space of the first bit in occupied */
+	int occupied_count;                       /*!< Number of parking spaces covered by occupied */
 	struct parking_lot_cfg *cfg;              /*!< Reference to configuration object for the parking lot */
 	enum parking_lot_modes mode;              /*!< Whether a parking lot is operational, being reconfigured, primed for deletion, or dynamically created. */
 	int disable_mark;                         /*!< On reload, disable this parking lot if it doesn't receive a new configuration. */
@@ -112,6 +115,8 @@ struct parked_user {
 	unsigned int time_limit;                  /*!< How long this specific channel may remain in the parking lot before timing out */
 	struct parking_lot *lot;                  /*!< Which parking lot the user is parked to */
 	enum park_call_resolution resolution;     /*!< How did the parking session end? If the call is in a bridge, lock parked_user before checking/setting */
+	int timeout_id;                           /*!< Scheduler id of the parking timeout, -1 if none was scheduled */
+	int timeout_armed;                        /*!< Whoever takes this from 1 to 0 releases the reference of the timeout */
 };
 
 #if defined(TEST_FRAMEWORK)
@@ -198,6 +203,18 @@ struct ast_bridge *parking_lot_get_bridge(struct parking_lot *lot);
  */
 int parking_lot_get_space(struct parking_lot *lot, int target_override);
 
+/*!
+ * \since 19.0.0
+ * \brief Mark a parking space of a parking lot as taken or free
+ *
+ * \param lot Which parking lot the space is in
+ * \param space The parking space
+ * \param taken Non-zero if a parked user now holds the space
+ *
+ * \note lot should be locked before this is called.
+ */
+void parking_lot_set_space(struct parking_lot *lot, int space, int taken);
+
 /*!
  * \brief Determine if there is a parked user in a parking space and return it if there is.
  *
@@ -260,12 +277,33 @@ void say_parking_space(struct ast_bridge_channel *bridge_channel, const char *pa
 
 /*!
  * \since 12.0.0
- * \brief Setup timeout interval feature on an ast_bridge_features for parking
+ * \brief Schedule the parking timeout of a parked user
  *
- * \param features The ast_bridge_features we are establishing the interval hook on
  * \param user The parked_user receiving the timeout duration limits
+ *
+ * \note The timeouts of all parked users share one timer wheel.  Scheduling
+ *       again after a swap keeps the timeout already scheduled.
+ */
+void parking_set_duration(struct parked_user *user);
+
+/*!
+ * \since 19.0.0
+ * \brief Cancel the parking timeout of a parked user
+ *
+ * \param user The parked_user leaving the parking bridge
+ */
+void parking_cancel_duration(struct parked_user *user);
+
+/*!
+ * \since 19.0.0
+ * \brief Get the parked user of a channel in a parking bridge
+ *
+ * \param bridge_channel The bridge channel, called from its own thread
+ *
+ * \retval NULL if the channel is not in a parking bridge
+ * \retval reference to the parked user
  */
-void parking_set_duration(struct ast_bridge_features *features, struct parked_user *user);
+struct parked_user *parking_bridge_channel_get_parked_user(struct ast_bridge_channel *bridge_channel);
 
 /*!
  * \since 12.0.0
@@ -0,0 +1,226 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Prometheus CEL Metrics
+ *
+ * \author Sangoma Technologies Corporation
+ *
+ */
+
+#include "asterisk.h"
+
+#include "asterisk/utils.h"
+#include "asterisk/stringfields.h"
+#include "asterisk/cel.h"
+#include "asterisk/vector.h"
+#include "asterisk/res_prometheus.h"
+#include "prometheus_internal.h"
+
+#define CEL_BACKEND_QUEUED_HELP "Number of events waiting to be handed to the CEL backend."
+
+#define CEL_BACKEND_DROPPED_HELP "Number of events discarded because the queue of the CEL backend was full."
+
+/*!
+ * \internal
+ * \brief The state of one backend, copied out of the CEL engine
+ */
+struct cel_backend_metrics {
+	/*! Events waiting to be handed to the backend */
+	size_t queued;
+	/*! Events discarded because the queue was full */
+	unsigned int dropped;
+	/*! Name of the backend */
+	char name[0];
+};
+
+AST_VECTOR(cel_backends_metrics, struct cel_backend_metrics *);
+
+/*!
+ * \internal
+ * \brief Callback function to get the number of events queued for a backend
+ *
+ * \param metric The metric to populate
+ * \param backend The backend
+ */
+static void get_cel_backend_queued(struct prometheus_metric *metric, struct cel_backend_metrics *backend)
+{
+	snprintf(metric->value, sizeof(metric->value), "%zu", backend->queued);
+}
+
+/*!
+ * \internal
+ * \brief Callback function to get the number of events dropped for a backend
+ *
+ * \param metric The metric to populate
+ * \param backend The backend
+ */
+static void get_cel_backend_dropped(struct prometheus_metric *metric, struct cel_backend_metrics *backend)
+{
+	snprintf(metric->value, sizeof(metric->value), "%u", backend->dropped);
+}
+
+/*!
+ * \internal
+ * \brief Helper struct for generating individual CEL backend stats
+ */
+struct cel_backend_metric_defs {
+	/*!
+	 * \brief The type of metric
+	 */
+	enum prometheus_metric_type type;
+	/*!
+	 * \brief Help text to display
+	 */
+	const char *help;
+	/*!
+	 * \brief Name of the metric
+	 */
+	const char *name;
+	/*!
+	 * \brief Callback function to generate a metric value for a given backend
+	 */
+	void (* const get_value)(struct prometheus_metric *metric, struct cel_backend_metrics *backend);
+} cel_backend_metric_defs[] = {
+	{
+		.type = PROMETHEUS_METRIC_GAUGE,
+		.help = CEL_BACKEND_QUEUED_HELP,
+		.name = "asterisk_cel_backend_queued",
+		.get_value = get_cel_backend_queued,
+	},
+	{
+		.type = PROMETHEUS_METRIC_COUNTER,
+		.help = CEL_BACKEND_DROPPED_HELP,
+		.name = "asterisk_cel_backend_dropped_total",
+		.get_value = get_cel_backend_dropped,
+	},
+};
+
+/*!
+ * \internal
+ * \brief Copy the state of a backend so it can be used once the engine lets go of it
+ */
+static void cel_backend_stats_cb(const struct ast_cel_backend_stats *stats, void *data)
+{
+	struct cel_backends_metrics *backends = data;
+	struct cel_backend_metrics *backend;
+
+	backend = ast_calloc(1, sizeof(*backend) + strlen(stats->name) + 1);
+	if (!backend) {
+		return;
+	}
+	backend->queued = stats->queued;
+	backend->dropped = stats->dropped;
+	strcpy(backend->name, stats->name); /* Safe */
+
+	if (AST_VECTOR_APPEND(backends, backend)) {
+		ast_free(backend);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Callback invoked when Prometheus scrapes the server
+ *
+ * \param response The response to populate with formatted metrics
+ */
+static void cel_scrape_cb(struct ast_str **response)
+{
+	struct cel_backends_metrics backends;
+	struct prometheus_metric *backend_metrics;
+	char eid_str[32];
+	int i, j, num_backends;
+
+	if (AST_VECTOR_INIT(&backends, 8)) {
+		return;
+	}
+
+	ast_cel_backend_stats_foreach(cel_backend_stats_cb, &backends);
+
+	num_backends = AST_VECTOR_SIZE(&backends);
+	if (num_backends == 0) {
+		AST_VECTOR_FREE(&backends);
+		return;
+	}
+
+	backend_metrics = ast_calloc(ARRAY_LEN(cel_backend_metric_defs) * num_backends, sizeof(*backend_metrics));
+	if (!backend_metrics) {
+		AST_VECTOR_RESET(&backends, ast_free);
+		AST_VECTOR_FREE(&backends);
+		return;
+	}
+
+	ast_eid_to_str(eid_str, sizeof(eid_str), &ast_eid_default);
+
+	for (i = 0; i < num_backends; i++) {
+		struct cel_backend_metrics *backend = AST_VECTOR_GET(&backends, i);
+
+		for (j = 0; j < ARRAY_LEN(cel_backend_metric_defs); j++) {
+			int index = i * ARRAY_LEN(cel_backend_metric_defs) + j;
+
+			backend_metrics[index].type = cel_backend_metric_defs[j].type;
+			ast_copy_string(backend_metrics[index].name, cel_backend_metric_defs[j].name, sizeof(backend_metrics[index].name));
+			backend_metrics[index].help = cel_backend_metric_defs[j].help;
+			PROMETHEUS_METRIC_SET_LABEL(&backend_metrics[index], 0, "eid", eid_str);
+			PROMETHEUS_METRIC_SET_LABEL(&backend_metrics[index], 1, "name", backend->name);
+			cel_backend_metric_defs[j].get_value(&backend_metrics[index], backend);
+
+			if (i > 0) {
+				AST_LIST_INSERT_TAIL(&backend_metrics[j].children, &backend_metrics[index], entry);
+			}
+		}
+	}
+
+	for (j = 0; j < ARRAY_LEN(cel_backend_metric_defs); j++) {
+		prometheus_metric_to_string(&backend_metrics[j], response);
+	}
+
+	ast_free(backend_metrics);
+	AST_VECTOR_RESET(&backends, ast_free);
+	AST_VECTOR_FREE(&backends);
+}
+
+struct prometheus_callback cel_callback = {
+	.name = "cel callback",
+	.callback_fn = cel_scrape_cb,
+};
+
+/*!
+ * \internal
+ * \brief Callback invoked when the core module is unloaded
+ */
+static void cel_metrics_unload_cb(void)
+{
+	prometheus_callback_unregister(&cel_callback);
+}
+
+/*!
+ * \internal
+ * \brief Metrics provider definition
+ */
+static struct prometheus_metrics_provider provider = {
+	.name = "cel",
+	.unload_cb = cel_metrics_unload_cb,
+};
+
+int cel_metrics_init(void)
+{
+	prometheus_metrics_provider_register(&provider);
+	prometheus_callback_register(&cel_callback);
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Prometheus Latency Metrics
+ *
+ * \author Sangoma Technologies Corporation
+ *
+ * Every latency histogram kept by the core is exported as a Prometheus
+ * histogram named asterisk_<name>_seconds.  Histograms without any
+ * samples are left out, so the dialplan applications that never ran do
+ * not add fifty lines each to every scrape.
+ */
+
+#include "asterisk.h"
+
+#include "asterisk/utils.h"
+#include "asterisk/histogram.h"
+#include "asterisk/res_prometheus.h"
+#include "prometheus_internal.h"
+
+/*!
+ * \internal
+ * \brief State kept while rendering the histograms
+ */
+struct latency_scrape {
+	/*! The response to populate */
+	struct ast_str **response;
+	/*! The family whose header was rendered last */
+	const char *family;
+	/*! Labels every histogram carries */
+	char eid_str[32];
+};
+
+/*!
+ * \internal
+ * \brief Render one histogram in the Prometheus text format
+ */
+static void latency_histogram_cb(const struct ast_histogram_snapshot *snapshot,
+	int first, void *data)
+{
+	struct latency_scrape *scrape = data;
+	struct ast_str **response = scrape->response;
+	char labels[256];
+	unsigned long long cumulative = 0;
+	int i;
+
+	if (!snapshot->count) {
+		return;
+	}
+
+	/* The first histogram of a family may have been left out */
+	if (scrape->family != snapshot->name) {
+		ast_str_append(response, 0, "# HELP asterisk_%s_seconds %s\n", snapshot->name, snapshot->help);
+		ast_str_append(response, 0, "# TYPE asterisk_%s_seconds histogram\n", snapshot->name);
+		scrape->family = snapshot->name;
+	}
+
+	if (snapshot->label) {
+		snprintf(labels, sizeof(labels), "eid=\"%s\",%s=\"%s\"", scrape->eid_str,
+			snapshot->label, snapshot->value);
+	} else {
+		snprintf(labels, sizeof(labels), "eid=\"%s\"", scrape->eid_str);
+	}
+
+	for (i = 0; i < AST_HISTOGRAM_BUCKETS; i++) {
+		cumulative += snapshot->buckets[i];
+		ast_str_append(response, 0, "asterisk_%s_seconds_bucket{%s,le=\"%.6f\"} %llu\n",
+			snapshot->name, labels, ast_histogram_bucket_bound(i) / 1000000.0, cumulative);
+	}
+	ast_str_append(response, 0, "asterisk_%s_seconds_bucket{%s,le=\"+Inf\"} %llu\n",
+		snapshot->name, labels, snapshot->count);
+	ast_str_append(response, 0, "asterisk_%s_seconds_sum{%s} %.6f\n",
+		snapshot->name, labels, snapshot->sum / 1000000.0);
+	ast_str_append(response, 0, "asterisk_%s_seconds_count{%s} %llu\n",
+		snapshot->name, labels, snapshot->count);
+}
+
+/*!
+ * \internal
+ * \brief Callback invoked when Prometheus scrapes the server
+ *
+ * \param response The response to populate with formatted metrics
+ */
+static void latency_scrape_cb(struct ast_str **response)
+{
+	struct latency_scrape scrape = {
+		.response = response,
+	};
+
+	ast_eid_to_str(scrape.eid_str, sizeof(scrape.eid_str), &ast_eid_default);
+	ast_histogram_foreach(latency_histogram_cb, &scrape);
+}
+
+struct prometheus_callback latency_callback = {
+	.name = "latency callback",
+	.callback_fn = latency_scrape_cb,
+};
+
+/*!
+ * \internal
+ * \brief Callback invoked when the core module is unloaded
+ */
+static void latency_metrics_unload_cb(void)
+{
+	prometheus_callback_unregister(&latency_callback);
+}
+
+/*!
+ * \internal
+ * \brief Metrics provider definition
+ */
+static struct prometheus_metrics_provider provider = {
+	.name = "latency",
+	.unload_cb = latency_metrics_unload_cb,
+};
+
+int latency_metrics_init(void)
+{
+	prometheus_metrics_provider_register(&provider);
+	prometheus_callback_register(&latency_callback);
+
+	return 0;
+}
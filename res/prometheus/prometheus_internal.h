@@ -91,6 +91,14 @@ int endpoint_metrics_init(void);
  */
 int bridge_metrics_init(void);
 
+/*!
+ * \brief Initialize CEL metrics
+ *
+ * \retval 0 success
+ * \retval -1 error
+ */
+int cel_metrics_init(void);
+
 /*!
  * \brief Initialize PJSIP outbound registration metrics
  *
@@ -99,4 +107,20 @@ int bridge_metrics_init(void);
  */
 int pjsip_outbound_registration_metrics_init(void);
 
+/*!
+ * \brief Initialize latency histogram metrics
+ *
+ * \retval 0 success
+ * \retval -1 error
+ */
+int latency_metrics_init(void);
+
+/*!
+ * \brief Initialize taskprocessor metrics
+ *
+ * \retval 0 success
+ * \retval -1 error
+ */
+int taskprocessor_metrics_init(void);
+
 #endif /* #define PROMETHEUS_INTERNAL_H__ */
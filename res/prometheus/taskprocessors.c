@@ -0,0 +1,256 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Prometheus Taskprocessor Metrics
+ *
+ * \author Sangoma Technologies Corporation
+ *
+ * Every taskprocessor is exported with a "name" label.  The statistics of
+ * each task function are only exported while they are turned on with
+ * "core set taskprocessor callback stats on", labelled by "callback".
+ */
+
+#include "asterisk.h"
+
+#include "asterisk/utils.h"
+#include "asterisk/vector.h"
+#include "asterisk/taskprocessor.h"
+#include "asterisk/res_prometheus.h"
+#include "prometheus_internal.h"
+
+/*!
+ * \internal
+ * \brief A copy of the statistics of a taskprocessor or task function
+ */
+struct taskprocessor_metrics {
+	unsigned long processed;
+	long queued;
+	unsigned long max_depth;
+	struct ast_taskprocessor_time_stats wait;
+	struct ast_taskprocessor_time_stats execution;
+	/*! Name of the taskprocessor or function */
+	char name[0];
+};
+
+AST_VECTOR(taskprocessors_metrics, struct taskprocessor_metrics *);
+
+/*!
+ * \internal
+ * \brief Copy statistics into the vector
+ *
+ * \return The copy, or NULL on failure
+ */
+static struct taskprocessor_metrics *taskprocessor_metrics_add(struct taskprocessors_metrics *metrics,
+	const char *name, unsigned long processed, const struct ast_taskprocessor_time_stats *wait,
+	const struct ast_taskprocessor_time_stats *execution)
+{
+	struct taskprocessor_metrics *entry;
+
+	entry = ast_calloc(1, sizeof(*entry) + strlen(name) + 1);
+	if (!entry) {
+		return NULL;
+	}
+	strcpy(entry->name, name); /* Safe */
+	entry->processed = processed;
+	entry->wait = *wait;
+	entry->execution = *execution;
+
+	if (AST_VECTOR_APPEND(metrics, entry)) {
+		ast_free(entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+static void taskprocessor_stats_cb(const struct ast_taskprocessor_stats *stats, void *data)
+{
+	struct taskprocessor_metrics *entry;
+
+	entry = taskprocessor_metrics_add(data, stats->name, stats->processed, &stats->wait,
+		&stats->execution);
+	if (entry) {
+		entry->queued = stats->queued;
+		entry->max_depth = stats->max_depth;
+	}
+}
+
+static void taskprocessor_callback_stats_cb(const struct ast_taskprocessor_callback_stats *stats, void *data)
+{
+	taskprocessor_metrics_add(data, stats->name, stats->processed, &stats->wait, &stats->execution);
+}
+
+/*! \internal \brief Which value of the statistics a metric renders */
+enum taskprocessor_metric_value {
+	TPS_METRIC_PROCESSED,
+	TPS_METRIC_QUEUED,
+	TPS_METRIC_MAX_DEPTH,
+	TPS_METRIC_WAIT_TOTAL,
+	TPS_METRIC_WAIT_MAX,
+	TPS_METRIC_EXECUTION_TOTAL,
+	TPS_METRIC_EXECUTION_MAX,
+};
+
+/*!
+ * \internal
+ * \brief The definition of a metric
+ */
+struct taskprocessor_metric_def {
+	const char *name;
+	const char *type;
+	const char *help;
+	enum taskprocessor_metric_value value;
+};
+
+static const struct taskprocessor_metric_def taskprocessor_defs[] = {
+	{ "asterisk_taskprocessor_tasks_processed_total", "counter",
+		"Number of tasks the taskprocessor executed.", TPS_METRIC_PROCESSED, },
+	{ "asterisk_taskprocessor_queue_size", "gauge",
+		"Number of tasks waiting in the taskprocessor queue.", TPS_METRIC_QUEUED, },
+	{ "asterisk_taskprocessor_max_depth", "gauge",
+		"Most tasks that were ever waiting in the taskprocessor queue.", TPS_METRIC_MAX_DEPTH, },
+	{ "asterisk_taskprocessor_wait_seconds_total", "counter",
+		"Total time tasks waited in the taskprocessor queue.", TPS_METRIC_WAIT_TOTAL, },
+	{ "asterisk_taskprocessor_wait_seconds_max", "gauge",
+		"Longest time a task waited in the taskprocessor queue.", TPS_METRIC_WAIT_MAX, },
+	{ "asterisk_taskprocessor_execution_seconds_total", "counter",
+		"Total time the taskprocessor spent executing tasks.", TPS_METRIC_EXECUTION_TOTAL, },
+	{ "asterisk_taskprocessor_execution_seconds_max", "gauge",
+		"Longest time a task of the taskprocessor took to execute.", TPS_METRIC_EXECUTION_MAX, },
+};
+
+static const struct taskprocessor_metric_def taskprocessor_callback_defs[] = {
+	{ "asterisk_taskprocessor_callback_tasks_processed_total", "counter",
+		"Number of tasks of the function executed.", TPS_METRIC_PROCESSED, },
+	{ "asterisk_taskprocessor_callback_wait_seconds_total", "counter",
+		"Total time tasks of the function waited in taskprocessor queues.", TPS_METRIC_WAIT_TOTAL, },
+	{ "asterisk_taskprocessor_callback_execution_seconds_total", "counter",
+		"Total time tasks of the function took to execute.", TPS_METRIC_EXECUTION_TOTAL, },
+};
+
+/*!
+ * \internal
+ * \brief Render metrics of every entry of a vector
+ */
+static void taskprocessor_metrics_render(struct ast_str **response, const char *eid_str,
+	const char *label, const struct taskprocessor_metric_def *defs, size_t num_defs,
+	struct taskprocessors_metrics *metrics)
+{
+	size_t i;
+	size_t j;
+
+	if (!AST_VECTOR_SIZE(metrics)) {
+		return;
+	}
+
+	for (i = 0; i < num_defs; i++) {
+		ast_str_append(response, 0, "# HELP %s %s\n", defs[i].name, defs[i].help);
+		ast_str_append(response, 0, "# TYPE %s %s\n", defs[i].name, defs[i].type);
+
+		for (j = 0; j < AST_VECTOR_SIZE(metrics); j++) {
+			const struct taskprocessor_metrics *entry = AST_VECTOR_GET(metrics, j);
+
+			ast_str_append(response, 0, "%s{eid=\"%s\",%s=\"%s\"} ", defs[i].name, eid_str,
+				label, entry->name);
+			switch (defs[i].value) {
+			case TPS_METRIC_PROCESSED:
+				ast_str_append(response, 0, "%lu\n", entry->processed);
+				break;
+			case TPS_METRIC_QUEUED:
+				ast_str_append(response, 0, "%ld\n", entry->queued);
+				break;
+			case TPS_METRIC_MAX_DEPTH:
+				ast_str_append(response, 0, "%lu\n", entry->max_depth);
+				break;
+			case TPS_METRIC_WAIT_TOTAL:
+				ast_str_append(response, 0, "%.6f\n", entry->wait.total / 1000000.0);
+				break;
+			case TPS_METRIC_WAIT_MAX:
+				ast_str_append(response, 0, "%.6f\n", entry->wait.max / 1000000.0);
+				break;
+			case TPS_METRIC_EXECUTION_TOTAL:
+				ast_str_append(response, 0, "%.6f\n", entry->execution.total / 1000000.0);
+				break;
+			case TPS_METRIC_EXECUTION_MAX:
+				ast_str_append(response, 0, "%.6f\n", entry->execution.max / 1000000.0);
+				break;
+			}
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Callback invoked when Prometheus scrapes the server
+ *
+ * \param response The response to populate with formatted metrics
+ */
+static void taskprocessors_scrape_cb(struct ast_str **response)
+{
+	struct taskprocessors_metrics metrics;
+	char eid_str[32];
+
+	if (AST_VECTOR_INIT(&metrics, 64)) {
+		return;
+	}
+
+	ast_eid_to_str(eid_str, sizeof(eid_str), &ast_eid_default);
+
+	ast_taskprocessor_stats_foreach(taskprocessor_stats_cb, &metrics);
+	taskprocessor_metrics_render(response, eid_str, "name", taskprocessor_defs,
+		ARRAY_LEN(taskprocessor_defs), &metrics);
+	AST_VECTOR_RESET(&metrics, ast_free);
+
+	ast_taskprocessor_callback_stats_foreach(taskprocessor_callback_stats_cb, &metrics);
+	taskprocessor_metrics_render(response, eid_str, "callback", taskprocessor_callback_defs,
+		ARRAY_LEN(taskprocessor_callback_defs), &metrics);
+	AST_VECTOR_RESET(&metrics, ast_free);
+
+	AST_VECTOR_FREE(&metrics);
+}
+
+struct prometheus_callback taskprocessors_callback = {
+	.name = "taskprocessors callback",
+	.callback_fn = taskprocessors_scrape_cb,
+};
+
+/*!
+ * \internal
+ * \brief Callback invoked when the core module is unloaded
+ */
+static void taskprocessor_metrics_unload_cb(void)
+{
+	prometheus_callback_unregister(&taskprocessors_callback);
+}
+
+/*!
+ * \internal
+ * \brief Metrics provider definition
+ */
+static struct prometheus_metrics_provider provider = {
+	.name = "taskprocessors",
+	.unload_cb = taskprocessor_metrics_unload_cb,
+};
+
+int taskprocessor_metrics_init(void)
+{
+	prometheus_metrics_provider_register(&provider);
+	prometheus_callback_register(&taskprocessors_callback);
+
+	return 0;
+}
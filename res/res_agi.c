@@ -26,6 +26,7 @@
 
 /*** MODULEINFO
 	<depend>res_speech</depend>
+	<use type="module">res_http_websocket</use>
 	<support_level>core</support_level>
  ***/
 
@@ -67,6 +68,7 @@
 #include "asterisk/stasis_channels.h"
 #include "asterisk/stasis_message_router.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/http_websocket.h"
 
 #define AST_API_MODULE
 #include "asterisk/agi.h"
@@ -1160,6 +1162,14 @@
 					example, if you specify the URI <literal>hagi://agi.example.com/foo.agi</literal>
 					the DNS query would be for <literal>_agi._tcp.agi.example.com</literal>. You
 					will need to make sure this resolves correctly.</para>
+					<para>If the <variable>AGIPOOL</variable> channel variable is set to
+					<literal>yes</literal>, the connection is kept open after the script
+					ends and reused by later AGI sessions to the same host. The server is
+					told with an <literal>agi_network_pool: yes</literal> header, and ends
+					a session by sending <literal>SESSION END</literal> instead of closing
+					the connection. Asterisk answers <literal>200 result=0</literal> and the
+					next session on the connection starts with a new set of headers. A
+					server that closes the connection as usual is unaffected.</para>
 				</enum>
 				<enum name="AsyncAGI">
 					<para>Use AMI to control the channel in AGI. AGI commands can be invoked
@@ -1167,6 +1177,17 @@
 					events passed back over the AMI connection. AsyncAGI should be invoked
 					by passing <literal>agi:async</literal> to the <replaceable>command</replaceable>
 					parameter.</para>
+					<para>AsyncAGI channels can also be controlled over a websocket using
+					the <literal>agi</literal> protocol of <literal>res_http_websocket</literal>.
+					Every message is binary and made of fields that each end with a NUL.
+					To queue commands, a client sends the channel name followed by a command
+					id and a command for each of up to 64 commands. Asterisk sends every
+					session a <literal>start</literal> message with the channel name and its
+					AGI environment, an <literal>exec</literal> message with the channel
+					name followed by the command id and result of each command run since the
+					last one, and an <literal>end</literal> message with the channel name.
+					Commands that cannot be queued are answered with an <literal>error</literal>
+					message holding the channel name and the reason.</para>
 				</enum>
 			</enumlist>
 			<note>
@@ -1185,6 +1206,9 @@
 			after a channel hangup is detected, set the <variable>AGIEXITONHANGUP</variable>
 			variable to <literal>yes</literal>.</para>
 			</note>
+			<para>Scripts may send several commands without waiting for the response
+			to each. The commands are run in the order they were sent, and a response
+			is sent for each of them in turn.</para>
 			<example title="AGI invocation examples">
 				; Start the AGI script /tmp/my-cool-script.sh, passing it the contents
 				; of the channel variable FOO
@@ -1743,6 +1767,183 @@ static int action_add_agi_cmd(struct mansession *s, const struct message *m)
 	return 0;
 }
 
+/*! \brief Largest AsyncAGI websocket message accepted */
+#define AGI_WS_MAX_MESSAGE 65536
+
+/*! \brief Websocket sessions controlling AsyncAGI channels */
+static struct ao2_container *agi_ws_sessions;
+
+/*!
+ * \brief A binary AsyncAGI websocket message
+ *
+ * Messages are a sequence of fields, each terminated by a NUL. The first
+ * field is the message type and the second the channel name.
+ */
+struct agi_ws_message {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static int agi_ws_message_add(struct agi_ws_message *message, const char *field)
+{
+	size_t len = strlen(field) + 1;
+
+	if (message->len + len > message->size) {
+		size_t size = MAX(message->size * 2, message->len + len + 256);
+		char *buf = ast_realloc(message->buf, size);
+
+		if (!buf) {
+			return -1;
+		}
+		message->buf = buf;
+		message->size = size;
+	}
+	memcpy(message->buf + message->len, field, len);
+	message->len += len;
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Start a message about a channel, if anyone is listening
+ *
+ * \retval 0 if the message was started
+ * \retval -1 if there is nobody to send it to or on error
+ */
+static int agi_ws_message_start(struct agi_ws_message *message, const char *type, struct ast_channel *chan)
+{
+	message->len = 0;
+	if (!agi_ws_sessions || !ao2_container_count(agi_ws_sessions)) {
+		return -1;
+	}
+	return agi_ws_message_add(message, type) || agi_ws_message_add(message, ast_channel_name(chan)) ? -1 : 0;
+}
+
+/*!
+ * \internal
+ * \brief Send a message to every AsyncAGI websocket session and empty it
+ */
+static void agi_ws_message_send(struct agi_ws_message *message)
+{
+	struct ao2_iterator it;
+	struct ast_websocket *session;
+
+	if (!message->len) {
+		return;
+	}
+
+	it = ao2_iterator_init(agi_ws_sessions, 0);
+	while ((session = ao2_iterator_next(&it))) {
+		ast_websocket_write(session, AST_WEBSOCKET_OPCODE_BINARY, message->buf, message->len);
+		ao2_ref(session, -1);
+	}
+	ao2_iterator_destroy(&it);
+
+	message->len = 0;
+}
+
+static void agi_ws_send_error(struct ast_websocket *session, const char *channel, const char *error)
+{
+	struct agi_ws_message message = { NULL, };
+
+	if (!agi_ws_message_add(&message, "error")
+		&& !agi_ws_message_add(&message, channel)
+		&& !agi_ws_message_add(&message, error)) {
+		ast_websocket_write(session, AST_WEBSOCKET_OPCODE_BINARY, message.buf, message.len);
+	}
+	ast_free(message.buf);
+}
+
+/*!
+ * \internal
+ * \brief Queue a batch of commands received over a websocket
+ *
+ * The message holds the channel name followed by a command id and a
+ * command for each command, every field terminated by a NUL.
+ */
+static void agi_ws_handle_message(struct ast_websocket *session, char *payload, size_t len)
+{
+	const char *fields[2 * 64 + 1];
+	char *pos = payload;
+	size_t count = 0;
+	size_t i;
+	struct ast_channel *chan;
+
+	while (pos < payload + len && count < ARRAY_LEN(fields)) {
+		fields[count++] = pos;
+		pos += strlen(pos) + 1;
+	}
+
+	if (count < 3 || !(count % 2) || pos < payload + len) {
+		agi_ws_send_error(session, count ? fields[0] : "",
+			"Expected a channel followed by up to 64 command ids and commands");
+		return;
+	}
+
+	chan = ast_channel_get_by_name(fields[0]);
+	if (!chan) {
+		agi_ws_send_error(session, fields[0], "Channel does not exist");
+		return;
+	}
+
+	/* The whole batch is queued before the channel gets to run any of it */
+	ast_channel_lock(chan);
+	for (i = 1; i < count; i += 2) {
+		if (add_agi_cmd(chan, fields[i + 1], fields[i])) {
+			agi_ws_send_error(session, fields[0], "Failed to add AGI command to queue");
+			break;
+		}
+	}
+	ast_channel_unlock(chan);
+	ast_channel_unref(chan);
+}
+
+static void agi_ws_callback(struct ast_websocket *session, struct ast_variable *parameters, struct ast_variable *headers)
+{
+	if (ast_websocket_set_nonblock(session)) {
+		goto end;
+	}
+	ast_websocket_reconstruct_enable(session, AGI_WS_MAX_MESSAGE);
+
+	if (!ao2_link(agi_ws_sessions, session)) {
+		goto end;
+	}
+
+	while (ast_websocket_wait_for_input(session, -1) > 0) {
+		char *payload;
+		uint64_t payload_len;
+		enum ast_websocket_opcode opcode;
+		int fragmented;
+		char *message;
+
+		if (ast_websocket_read(session, &payload, &payload_len, &opcode, &fragmented)) {
+			break;
+		}
+
+		if (opcode == AST_WEBSOCKET_OPCODE_CLOSE) {
+			break;
+		} else if (opcode != AST_WEBSOCKET_OPCODE_BINARY || fragmented) {
+			continue;
+		}
+
+		/* Terminate the last field, it is not required to be */
+		message = ast_malloc(payload_len + 1);
+		if (!message) {
+			continue;
+		}
+		memcpy(message, payload, payload_len);
+		message[payload_len] = '\0';
+		agi_ws_handle_message(session, message, payload_len);
+		ast_free(message);
+	}
+
+	ao2_unlink(agi_ws_sessions, session);
+
+end:
+	ast_websocket_unref(session);
+}
+
 static enum agi_result agi_handle_command(struct ast_channel *chan, AGI *agi, char *buf, int dead);
 static void setup_env(struct ast_channel *chan, char *request, int fd, int enhanced, int argc, char *argv[]);
 
@@ -1816,6 +2017,7 @@ static enum agi_result launch_asyncagi(struct ast_channel *chan, int argc, char
 	enum agi_result returnstatus = AGI_RESULT_SUCCESS;
 	AGI async_agi;
 	RAII_VAR(struct ast_json *, startblob, NULL, ast_json_unref);
+	struct agi_ws_message message = { NULL, };
 
 	if (efd) {
 		ast_log(LOG_WARNING, "Async AGI does not support Enhanced AGI yet\n");
@@ -1869,6 +2071,12 @@ static enum agi_result launch_asyncagi(struct ast_channel *chan, int argc, char
 
 	ast_channel_publish_cached_blob(chan, agi_async_start_type(), startblob);
 
+	/* Websocket messages are binary, so nothing needs encoding */
+	if (!agi_ws_message_start(&message, "start", chan)
+		&& !agi_ws_message_add(&message, agi_buffer)) {
+		agi_ws_message_send(&message);
+	}
+
 	hungup = ast_check_hangup_locked(chan);
 
 	for (;;) {
@@ -1916,6 +2124,13 @@ static enum agi_result launch_asyncagi(struct ast_channel *chan, int argc, char
 			}
 			ast_channel_publish_cached_blob(chan, agi_async_exec_type(), execblob);
 
+			/* The results of every command queued so far go in one message */
+			if ((message.len || !agi_ws_message_start(&message, "exec", chan))
+				&& (agi_ws_message_add(&message, S_OR(cmd->cmd_id, ""))
+					|| agi_ws_message_add(&message, agi_buffer))) {
+				message.len = 0;
+			}
+
 			free_agi_cmd(cmd);
 
 			/*
@@ -1939,6 +2154,7 @@ static enum agi_result launch_asyncagi(struct ast_channel *chan, int argc, char
 				break;
 			}
 		}
+		agi_ws_message_send(&message);
 
 		if (!hungup) {
 			/* Wait a bit for a frame to read or to poll for a new command. */
@@ -1976,7 +2192,14 @@ async_agi_done:
 	/* notify manager users this channel cannot be controlled anymore by Async AGI */
 	ast_channel_publish_cached_blob(chan, agi_async_end_type(), NULL);
 
+	agi_ws_message_send(&message);
+	if (!agi_ws_message_start(&message, "end", chan)) {
+		agi_ws_message_send(&message);
+	}
+
 async_agi_abort:
+	ast_free(message.buf);
+
 	/* close the pipe */
 	close(fds[0]);
 	close(fds[1]);
@@ -1998,6 +2221,181 @@ async_agi_abort:
 #undef AMI_BUF_SIZE
 }
 
+/*! \brief Most idle FastAGI connections kept open */
+#define AGI_POOL_MAX_IDLE 64
+
+/*! \brief Seconds an idle FastAGI connection is kept open */
+#define AGI_POOL_IDLE_TIMEOUT 60
+
+/*! \brief A FastAGI connection kept open between AGI sessions */
+struct agi_pool_conn {
+	/*! Socket connected to the FastAGI server */
+	int fd;
+	/*! Set while a session is running on the connection */
+	unsigned int in_use:1;
+	/*! When the last session on the connection ended */
+	struct timeval idle_since;
+	AST_LIST_ENTRY(agi_pool_conn) list;
+	/*! host[:port] the connection was made to */
+	char host[0];
+};
+
+static AST_LIST_HEAD_STATIC(agi_pool, agi_pool_conn);
+
+static void agi_pool_conn_destroy(struct agi_pool_conn *conn)
+{
+	close(conn->fd);
+	ast_free(conn);
+}
+
+/*!
+ * \internal
+ * \brief Check that an idle connection was not closed by the server
+ *
+ * An idle connection has nothing to read, anything else means the server
+ * closed it or is out of step with us.
+ */
+static int agi_pool_conn_alive(const struct agi_pool_conn *conn)
+{
+	struct pollfd pfd = { .fd = conn->fd, .events = POLLIN, };
+
+	return ast_poll(&pfd, 1, 0) == 0;
+}
+
+/*!
+ * \internal
+ * \brief Take an idle connection to a host out of the pool
+ *
+ * \return The connection's socket, or -1 if there is none.
+ */
+static int agi_pool_get(const char *host)
+{
+	struct agi_pool_conn *conn;
+	struct timeval now = ast_tvnow();
+	int fd = -1;
+
+	AST_LIST_LOCK(&agi_pool);
+	AST_LIST_TRAVERSE_SAFE_BEGIN(&agi_pool, conn, list) {
+		if (conn->in_use) {
+			continue;
+		}
+		if (ast_tvdiff_sec(now, conn->idle_since) >= AGI_POOL_IDLE_TIMEOUT
+			|| !agi_pool_conn_alive(conn)) {
+			AST_LIST_REMOVE_CURRENT(list);
+			agi_pool_conn_destroy(conn);
+			continue;
+		}
+		if (fd == -1 && !strcasecmp(conn->host, host)) {
+			conn->in_use = 1;
+			fd = conn->fd;
+		}
+	}
+	AST_LIST_TRAVERSE_SAFE_END;
+	AST_LIST_UNLOCK(&agi_pool);
+
+	return fd;
+}
+
+/*!
+ * \internal
+ * \brief Track a new connection so it can be returned to the pool
+ */
+static void agi_pool_add(const char *host, int fd)
+{
+	struct agi_pool_conn *conn;
+
+	conn = ast_calloc(1, sizeof(*conn) + strlen(host) + 1);
+	if (!conn) {
+		/* The connection will just be closed after the session */
+		return;
+	}
+	conn->fd = fd;
+	conn->in_use = 1;
+	strcpy(conn->host, host); /* Safe */
+
+	AST_LIST_LOCK(&agi_pool);
+	AST_LIST_INSERT_HEAD(&agi_pool, conn, list);
+	AST_LIST_UNLOCK(&agi_pool);
+}
+
+/*!
+ * \internal
+ * \brief Check if a socket belongs to a pooled connection
+ */
+static int agi_pool_owns(int fd)
+{
+	struct agi_pool_conn *conn;
+
+	AST_LIST_LOCK(&agi_pool);
+	AST_LIST_TRAVERSE(&agi_pool, conn, list) {
+		if (conn->in_use && conn->fd == fd) {
+			break;
+		}
+	}
+	AST_LIST_UNLOCK(&agi_pool);
+
+	return conn != NULL;
+}
+
+/*!
+ * \internal
+ * \brief Return a connection to the pool after a session, or close it
+ *
+ * \param fd The connection's socket
+ * \param reusable Whether the session ended cleanly with the connection open
+ */
+static void agi_pool_release(int fd, int reusable)
+{
+	struct agi_pool_conn *conn;
+	struct agi_pool_conn *found = NULL;
+	int idle = 0;
+
+	AST_LIST_LOCK(&agi_pool);
+	AST_LIST_TRAVERSE_SAFE_BEGIN(&agi_pool, conn, list) {
+		if (!conn->in_use) {
+			++idle;
+		} else if (conn->fd == fd) {
+			found = conn;
+			AST_LIST_REMOVE_CURRENT(list);
+		}
+	}
+	AST_LIST_TRAVERSE_SAFE_END;
+
+	if (found && reusable && idle < AGI_POOL_MAX_IDLE) {
+		found->in_use = 0;
+		found->idle_since = ast_tvnow();
+		AST_LIST_INSERT_HEAD(&agi_pool, found, list);
+		found = NULL;
+		fd = -1;
+	}
+	AST_LIST_UNLOCK(&agi_pool);
+
+	if (found) {
+		agi_pool_conn_destroy(found);
+	} else if (fd != -1) {
+		close(fd);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Close every idle connection
+ */
+static void agi_pool_cleanup(void)
+{
+	struct agi_pool_conn *conn;
+
+	AST_LIST_LOCK(&agi_pool);
+	AST_LIST_TRAVERSE_SAFE_BEGIN(&agi_pool, conn, list) {
+		if (!conn->in_use) {
+			AST_LIST_REMOVE_CURRENT(list);
+			agi_pool_conn_destroy(conn);
+		}
+	}
+	AST_LIST_TRAVERSE_SAFE_END;
+	AST_LIST_UNLOCK(&agi_pool);
+}
+
 /*!
  * \internal
  * \brief Handle the connection that was started by launch_netscript.
@@ -2050,9 +2448,9 @@ static int handle_connection(const char *agiurl, const struct ast_sockaddr addr,
 
 /* launch_netscript: The fastagi handler.
 	FastAGI defaults to port 4573 */
-static enum agi_result launch_netscript(char *agiurl, char *argv[], int *fds)
+static enum agi_result launch_netscript(char *agiurl, char *argv[], int *fds, int pool)
 {
-	int s = 0;
+	int s = -1;
 	char *host, *script;
 	int num_addrs = 0, i = 0;
 	struct ast_sockaddr *addrs;
@@ -2067,51 +2465,69 @@ static enum agi_result launch_netscript(char *agiurl, char *argv[], int *fds)
 		script = "";
 	}
 
-	if (!(num_addrs = ast_sockaddr_resolve(&addrs, host, 0, AST_AF_UNSPEC))) {
-		ast_log(LOG_WARNING, "Unable to locate host '%s'\n", host);
-		return AGI_RESULT_FAILURE;
-	}
-
-	for (i = 0; i < num_addrs; i++) {
-		if (!ast_sockaddr_port(&addrs[i])) {
-			ast_sockaddr_set_port(&addrs[i], AGI_PORT);
+	if (pool) {
+		s = agi_pool_get(host);
+		if (s != -1) {
+			ast_debug(4, "Reusing FastAGI connection to '%s'\n", host);
 		}
+	}
 
-		if ((s = ast_socket_nonblock(addrs[i].ss.ss_family, SOCK_STREAM, IPPROTO_TCP)) < 0) {
-			ast_log(LOG_WARNING, "Unable to create socket: %s\n", strerror(errno));
-			continue;
+	if (s == -1) {
+		if (!(num_addrs = ast_sockaddr_resolve(&addrs, host, 0, AST_AF_UNSPEC))) {
+			ast_log(LOG_WARNING, "Unable to locate host '%s'\n", host);
+			return AGI_RESULT_FAILURE;
 		}
 
-		if (ast_connect(s, &addrs[i]) && errno == EINPROGRESS) {
+		for (i = 0; i < num_addrs; i++) {
+			if (!ast_sockaddr_port(&addrs[i])) {
+				ast_sockaddr_set_port(&addrs[i], AGI_PORT);
+			}
 
-			if (handle_connection(agiurl, addrs[i], s)) {
-				close(s);
+			if ((s = ast_socket_nonblock(addrs[i].ss.ss_family, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+				ast_log(LOG_WARNING, "Unable to create socket: %s\n", strerror(errno));
 				continue;
 			}
 
-		} else {
-			ast_log(LOG_WARNING, "Connection to %s failed with unexpected error: %s\n",
-			ast_sockaddr_stringify(&addrs[i]), strerror(errno));
+			if (ast_connect(s, &addrs[i]) && errno == EINPROGRESS) {
+
+				if (handle_connection(agiurl, addrs[i], s)) {
+					close(s);
+					continue;
+				}
+
+			} else {
+				ast_log(LOG_WARNING, "Connection to %s failed with unexpected error: %s\n",
+				ast_sockaddr_stringify(&addrs[i]), strerror(errno));
+			}
+
+			break;
 		}
 
-		break;
-	}
+		ast_free(addrs);
 
-	ast_free(addrs);
+		if (i == num_addrs) {
+			ast_log(LOG_WARNING, "Couldn't connect to any host.  FastAGI failed.\n");
+			return AGI_RESULT_FAILURE;
+		}
 
-	if (i == num_addrs) {
-		ast_log(LOG_WARNING, "Couldn't connect to any host.  FastAGI failed.\n");
-		return AGI_RESULT_FAILURE;
+		if (pool) {
+			agi_pool_add(host, s);
+		}
 	}
 
 	if (ast_agi_send(s, NULL, "agi_network: yes\n") < 0) {
 		if (errno != EINTR) {
 			ast_log(LOG_WARNING, "Connect to '%s' failed: %s\n", agiurl, strerror(errno));
-			close(s);
+			agi_pool_release(s, 0);
 			return AGI_RESULT_FAILURE;
 		}
 	}
 
+	/* Tell the server it may end the session without closing the connection */
+	if (pool) {
+		ast_agi_send(s, NULL, "agi_network_pool: yes\n");
+	}
+
 	/* If we have a script parameter, relay it to the fastagi server */
 	/* Script parameters take the form of: AGI(agi://my.example.com/?extension=${EXTEN}) */
 	if (!ast_strlen_zero(script)) {
@@ -2130,6 +2546,7 @@ static enum agi_result launch_netscript(char *agiurl, char *argv[], int *fds)
  * \param agiurl The request URL as passed to Agi() in the dial plan
  * \param argv The parameters after the URL passed to Agi() in the dial plan
  * \param fds Input/output file descriptors
+ * \param pool Whether to use a pooled connection
  *
  * Uses SRV lookups to try to connect to a list of FastAGI servers. The hostname in
  * the URI is prefixed with _agi._tcp. prior to the DNS resolution. For
@@ -2143,7 +2560,7 @@ static enum agi_result launch_netscript(char *agiurl, char *argv[], int *fds)
  *
  * \return the result of the AGI operation.
  */
-static enum agi_result launch_ha_netscript(char *agiurl, char *argv[], int *fds)
+static enum agi_result launch_ha_netscript(char *agiurl, char *argv[], int *fds, int pool)
 {
 	char *host, *script;
 	enum agi_result result;
@@ -2170,14 +2587,14 @@ static enum agi_result launch_ha_netscript(char *agiurl, char *argv[], int *fds)
 
 	if (strchr(host, ':')) {
 		ast_log(LOG_WARNING, "Specifying a port number disables SRV lookups: %s\n", agiurl);
-		return launch_netscript(agiurl + 1, argv, fds); /* +1 to strip off leading h from hagi:// */
+		return launch_netscript(agiurl + 1, argv, fds, pool); /* +1 to strip off leading h from hagi:// */
 	}
 
 	snprintf(service, sizeof(service), "%s%s", SRV_PREFIX, host);
 
 	while (!(srv_ret = ast_srv_lookup(&context, service, &srvhost, &srvport))) {
 		snprintf(resolved_uri, sizeof(resolved_uri), "agi://%s:%d/%s", srvhost, srvport, script);
-		result = launch_netscript(resolved_uri, argv, fds);
+		result = launch_netscript(resolved_uri, argv, fds, pool);
 		if (result == AGI_RESULT_FAILURE || result == AGI_RESULT_NOTFOUND) {
 			ast_log(LOG_WARNING, "AGI request failed for host '%s' (%s:%d)\n", host, srvhost, srvport);
 		} else {
@@ -2197,6 +2614,21 @@ static enum agi_result launch_ha_netscript(char *agiurl, char *argv[], int *fds)
 	return AGI_RESULT_FAILURE;
 }
 
+/*!
+ * \internal
+ * \brief Check if the channel asked for a pooled FastAGI connection
+ */
+static int agi_use_pool(struct ast_channel *chan)
+{
+	int pool;
+
+	ast_channel_lock(chan);
+	pool = ast_true(pbx_builtin_getvar_helper(chan, "AGIPOOL"));
+	ast_channel_unlock(chan);
+
+	return pool;
+}
+
 static enum agi_result launch_script(struct ast_channel *chan, char *script, int argc, char *argv[], int *fds, int *efd, int *opid)
 {
 	char tmp[256];
@@ -2204,10 +2636,10 @@ static enum agi_result launch_script(struct ast_channel *chan, char *script, int
 	struct stat st;
 
 	if (!strncasecmp(script, "agi://", 6)) {
-		return (efd == NULL) ? launch_netscript(script, argv, fds) : AGI_RESULT_FAILURE;
+		return (efd == NULL) ? launch_netscript(script, argv, fds, agi_use_pool(chan)) : AGI_RESULT_FAILURE;
 	}
 	if (!strncasecmp(script, "hagi://", 7)) {
-		return (efd == NULL) ? launch_ha_netscript(script, argv, fds) : AGI_RESULT_FAILURE;
+		return (efd == NULL) ? launch_ha_netscript(script, argv, fds, agi_use_pool(chan)) : AGI_RESULT_FAILURE;
 	}
 	if (!strncasecmp(script, "agi:async", sizeof("agi:async") - 1)) {
 		return launch_asyncagi(chan, argc, argv, efd);
@@ -4109,7 +4541,57 @@ static enum agi_result agi_handle_command(struct ast_channel *chan, AGI *agi, ch
 	return AGI_RESULT_SUCCESS;
 }
 
-static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi, int pid, int *status, int dead, int argc, char *argv[])
+/*!
+ * \internal
+ * \brief Check if the script has sent a complete command we have not run yet
+ */
+static int agi_line_ready(const char *pending, size_t pending_len)
+{
+	return pending_len >= AGI_BUF_LEN - 1 || memchr(pending, '\n', pending_len);
+}
+
+/*!
+ * \internal
+ * \brief Move the next command the script sent out of the read ahead buffer
+ *
+ * Scripts may send several commands without waiting for each response, so
+ * everything that can be read is kept and the commands are run in turn.
+ * A command too long for \a buf is cut short.
+ *
+ * \param pending Read ahead buffer of \c AGI_BUF_LEN bytes
+ * \param pending_len Number of bytes in \a pending
+ * \param buf Buffer of \c AGI_BUF_LEN bytes for the command
+ * \param all Take what is left even if it does not end in a newline
+ *
+ * \retval 1 if a command was moved into \a buf
+ * \retval 0 if there is none
+ */
+static int agi_next_line(char *pending, size_t *pending_len, char *buf, int all)
+{
+	char *newline = memchr(pending, '\n', *pending_len);
+	size_t len;
+
+	if (newline) {
+		len = newline - pending + 1;
+	} else if (all || *pending_len >= AGI_BUF_LEN - 1) {
+		len = *pending_len;
+	} else {
+		return 0;
+	}
+	if (!len) {
+		return 0;
+	}
+	len = MIN(len, AGI_BUF_LEN - 1);
+
+	memcpy(buf, pending, len);
+	buf[len] = '\0';
+	*pending_len -= len;
+	memmove(pending, pending + len, *pending_len);
+
+	return 1;
+}
+
+static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi, int pid, int *status, int dead, int argc, char *argv[], int *reusable)
 {
 	struct ast_channel *c;
 	int outfd;
@@ -4118,8 +4600,11 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 	enum agi_result returnstatus = AGI_RESULT_SUCCESS;
 	struct ast_frame *f;
 	char buf[AGI_BUF_LEN];
-	char *res = NULL;
-	FILE *readf;
+	char pending[AGI_BUF_LEN];
+	size_t pending_len = 0;
+	int line_ready;
+	int closed = 0;
+	int session_ended = 0;
 	/* how many times we'll retry if ast_waitfor_nandfs will return without either
 	  channel or file descriptor in case select is interrupted by a system call (EINTR) */
 	int retry = AGI_NANDFS_RETRY;
@@ -4137,15 +4622,8 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 	exit_on_hangup = ast_true(exit_on_hangup_str);
 	ast_channel_unlock(chan);
 
-	if (!(readf = fdopen(agi->ctrl, "r"))) {
-		ast_log(LOG_WARNING, "Unable to fdopen file descriptor\n");
-		if (send_sighup && pid > -1)
-			kill(pid, SIGHUP);
-		close(agi->ctrl);
-		return AGI_RESULT_FAILURE;
-	}
+	*reusable = 0;
 
-	setlinebuf(readf);
 	setup_env(chan, request, agi->fd, (agi->audio > -1), argc, argv);
 	for (;;) {
 		if (needhup) {
@@ -4162,7 +4640,9 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 				break;
 			}
 		}
-		ms = -1;
+		/* Only check for what is waiting if the script already sent a command */
+		line_ready = agi_line_ready(pending, pending_len);
+		ms = line_ready ? 0 : -1;
 		if (dead || in_intercept) {
 			c = ast_waitfor_nandfds(&chan, 0, &agi->ctrl, 1, NULL, &outfd, &ms);
 		} else if (!ast_check_hangup(chan)) {
@@ -4193,31 +4673,28 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 				}
 				ast_frfree(f);
 			}
-		} else if (outfd > -1) {
-			size_t len = sizeof(buf);
-			size_t buflen = 0;
+		} else if (outfd > -1 || line_ready) {
+			size_t buflen;
 			enum agi_result cmd_status;
+			ssize_t len;
 
 			retry = AGI_NANDFS_RETRY;
-			buf[0] = '\0';
 
-			while (len > 1) {
-				res = fgets(buf + buflen, len, readf);
-				if (feof(readf))
-					break;
-				if (ferror(readf) && ((errno != EINTR) && (errno != EAGAIN)))
-					break;
-				if (res != NULL && !agi->fast)
-					break;
-				buflen = strlen(buf);
-				if (buflen && buf[buflen - 1] == '\n')
-					break;
-				len = sizeof(buf) - buflen;
-				if (agidebug)
-					ast_verbose("AGI Rx << temp buffer %s - errno %s\nNo \\n received, checking again.\n", buf, strerror(errno));
+			if (outfd > -1 && !closed && pending_len < sizeof(pending) - 1) {
+				len = read(agi->ctrl, pending + pending_len, sizeof(pending) - 1 - pending_len);
+				if (len > 0) {
+					pending_len += len;
+				} else if (!len || (errno != EINTR && errno != EAGAIN)) {
+					closed = 1;
+				}
 			}
 
-			if (!buf[0]) {
+			if (!agi_next_line(pending, &pending_len, buf, closed)) {
+				if (!closed) {
+					/* Wait for the rest of the command */
+					continue;
+				}
+
 				/* Program terminated */
 				ast_verb(3, "<%s>AGI Script %s completed, returning %d\n", ast_channel_name(chan), request, returnstatus);
 				if (pid > 0)
@@ -4241,6 +4718,17 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 
 			if (agidebug)
 				ast_verbose("<%s>AGI Rx << %s\n", ast_channel_name(chan), buf);
+
+			/* A pooled FastAGI server ends its session without closing the connection */
+			if (agi->pooled && !strcasecmp(buf, "SESSION END")) {
+				ast_agi_send(agi->fd, chan, "200 result=0\n");
+				ast_verb(3, "<%s>AGI Script %s completed, returning %d\n", ast_channel_name(chan), request, returnstatus);
+				session_ended = 1;
+				/* Anything sent after the end belongs to no session */
+				*reusable = !pending_len && !closed;
+				break;
+			}
+
 			cmd_status = agi_handle_command(chan, agi, buf, dead || in_intercept);
 			switch (cmd_status) {
 			case AGI_RESULT_FAILURE:
@@ -4265,7 +4753,7 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 		ast_speech_destroy(agi->speech);
 	}
 	/* Notify process */
-	if (send_sighup) {
+	if (send_sighup && !session_ended) {
 		if (pid > -1) {
 			if (kill(pid, SIGHUP)) {
 				ast_log(LOG_WARNING, "unable to send SIGHUP to AGI process %d: %s\n", pid, strerror(errno));
@@ -4277,7 +4765,6 @@ static enum agi_result run_agi(struct ast_channel *chan, char *request, AGI *agi
 			ast_agi_send(agi->fd, chan, "HANGUP\n");
 		}
 	}
-	fclose(readf);
 	return returnstatus;
 }
 
@@ -4523,14 +5010,21 @@ static int agi_exec_full(struct ast_channel *chan, const char *data, int enhance
 	   or Fast AGI are setup with success. */
 	if (res == AGI_RESULT_SUCCESS || res == AGI_RESULT_SUCCESS_FAST) {
 		int status = 0;
+		int reusable;
 		agi.fd = fds[1];
 		agi.ctrl = fds[0];
 		agi.audio = efd;
 		agi.fast = (res == AGI_RESULT_SUCCESS_FAST) ? 1 : 0;
-		res = run_agi(chan, args.arg[0], &agi, pid, &status, dead, args.argc, args.arg);
+		agi.pooled = agi.fast && agi_pool_owns(fds[0]);
+		res = run_agi(chan, args.arg[0], &agi, pid, &status, dead, args.argc, args.arg, &reusable);
 		/* If the fork'd process returns non-zero, set AGISTATUS to FAILURE */
 		if ((res == AGI_RESULT_SUCCESS || res == AGI_RESULT_SUCCESS_FAST) && status)
 			res = AGI_RESULT_FAILURE;
+		if (agi.pooled) {
+			agi_pool_release(fds[0], reusable);
+		} else {
+			close(fds[0]);
+		}
 		if (fds[1] != fds[0])
 			close(fds[1]);
 		if (efd > -1)
@@ -4676,6 +5170,10 @@ static int unload_module(void)
 	ast_manager_unregister("AGI");
 	ast_unregister_application(app);
 	AST_TEST_UNREGISTER(test_agi_null_docs);
+	agi_pool_cleanup();
+	ast_websocket_remove_protocol("agi", agi_ws_callback);
+	ao2_cleanup(agi_ws_sessions);
+	agi_ws_sessions = NULL;
 	return 0;
 }
 
@@ -4683,6 +5181,11 @@ static int load_module(void)
 {
 	int err = 0;
 
+	agi_ws_sessions = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_MUTEX, 0, NULL, NULL);
+	if (!agi_ws_sessions) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	err |= STASIS_MESSAGE_TYPE_INIT(agi_exec_start_type);
 	err |= STASIS_MESSAGE_TYPE_INIT(agi_exec_end_type);
 	err |= STASIS_MESSAGE_TYPE_INIT(agi_async_start_type);
@@ -4698,6 +5201,9 @@ static int load_module(void)
 
 	AST_TEST_REGISTER(test_agi_null_docs);
 
+	/* AsyncAGI over websockets is only available with res_http_websocket */
+	ast_websocket_add_protocol("agi", agi_ws_callback);
+
 	if (err) {
 		unload_module();
 		return AST_MODULE_LOAD_DECLINE;
@@ -4712,4 +5218,5 @@ AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_GLOBAL_SYMBOLS | AST_MODFLAG_LOAD_
 	.unload = unload_module,
 	.load_pri = AST_MODPRI_APP_DEPEND,
 	.requires = "res_speech",
+	.optional_modules = "res_http_websocket",
 );
@@ -150,6 +150,7 @@
 #include "asterisk/module.h"
 #include "asterisk/paths.h"
 #include "asterisk/stasis_app.h"
+#include "asterisk/vector.h"
 
 #include <string.h>
 #include <sys/stat.h>
@@ -267,6 +268,8 @@ void ast_ari_response_error(struct ast_ari_response *response,
 	va_start(ap, message_fmt);
 	message = ast_json_vstringf(message_fmt, ap);
 	va_end(ap);
+	ast_free(response->body);
+	response->body = NULL;
 	response->message = ast_json_pack("{s: o}",
 					  "message", ast_json_ref(message));
 	response->response_code = response_code;
@@ -281,6 +284,26 @@ void ast_ari_response_ok(struct ast_ari_response *response,
 	response->response_text = "OK";
 }
 
+void ast_ari_response_ok_body(struct ast_ari_response *response,
+	struct ast_str *body)
+{
+#ifdef AST_DEVMODE
+	/* The generated handlers validate the message */
+	response->message = ast_json_load_str(body, NULL);
+	if (!response->message) {
+		ast_free(body);
+		ast_ari_response_error(response, 500, "Internal Server Error",
+			"Invalid response body");
+		return;
+	}
+#else
+	response->message = ast_json_null();
+#endif
+	response->body = body;
+	response->response_code = 200;
+	response->response_text = "OK";
+}
+
 void ast_ari_response_no_content(struct ast_ari_response *response)
 {
 	response->message = ast_json_null();
@@ -297,6 +320,8 @@ void ast_ari_response_accepted(struct ast_ari_response *response)
 
 void ast_ari_response_alloc_failed(struct ast_ari_response *response)
 {
+	ast_free(response->body);
+	response->body = NULL;
 	response->message = ast_json_ref(oom_json);
 	response->response_code = 500;
 	response->response_text = "Internal Server Error";
@@ -312,6 +337,105 @@ void ast_ari_response_created(struct ast_ari_response *response,
 	ast_str_append(&response->headers, 0, "Location: /%s%s\r\n", root->path_segment, url);
 }
 
+/*! \brief An object kept on a page */
+struct ari_page_entry {
+	const char *id;
+	void *obj;
+};
+
+struct ast_ari_page {
+	/*! Objects must sort after this id, if set */
+	const char *after;
+	/*! Most objects kept, 0 for no limit */
+	int limit;
+	/*! Kept objects, sorted by id */
+	AST_VECTOR(, struct ari_page_entry) entries;
+};
+
+struct ast_ari_page *ast_ari_page_alloc(const char *after, int limit)
+{
+	struct ast_ari_page *page;
+
+	page = ast_calloc(1, sizeof(*page));
+	if (!page) {
+		return NULL;
+	}
+
+	if (AST_VECTOR_INIT(&page->entries, limit > 0 ? limit : 16)) {
+		ast_free(page);
+		return NULL;
+	}
+	page->after = S_OR(after, NULL);
+	page->limit = limit;
+
+	return page;
+}
+
+int ast_ari_page_offer(struct ast_ari_page *page, const char *id, void *obj)
+{
+	struct ari_page_entry entry = { .id = id, .obj = obj };
+	size_t size = AST_VECTOR_SIZE(&page->entries);
+	size_t low = 0;
+	size_t high = size;
+
+	if (page->after && strcmp(id, page->after) <= 0) {
+		return 0;
+	}
+
+	if (page->limit > 0 && size >= page->limit
+		&& strcmp(id, AST_VECTOR_GET(&page->entries, size - 1).id) >= 0) {
+		/* The page is full of ids sorting before this one */
+		return 0;
+	}
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (strcmp(AST_VECTOR_GET(&page->entries, mid).id, id) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (page->limit > 0 && size >= page->limit) {
+		ao2_ref(AST_VECTOR_GET(&page->entries, size - 1).obj, -1);
+		AST_VECTOR_REMOVE(&page->entries, size - 1, 1);
+	}
+
+	if (AST_VECTOR_INSERT_AT(&page->entries, low, entry)) {
+		return -1;
+	}
+	ao2_ref(obj, +1);
+
+	return 0;
+}
+
+size_t ast_ari_page_count(const struct ast_ari_page *page)
+{
+	return AST_VECTOR_SIZE(&page->entries);
+}
+
+void *ast_ari_page_get(const struct ast_ari_page *page, size_t idx)
+{
+	return AST_VECTOR_GET(&page->entries, idx).obj;
+}
+
+void ast_ari_page_free(struct ast_ari_page *page)
+{
+	size_t i;
+
+	if (!page) {
+		return;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&page->entries); ++i) {
+		ao2_ref(AST_VECTOR_GET(&page->entries, i).obj, -1);
+	}
+	AST_VECTOR_FREE(&page->entries);
+	ast_free(page);
+}
+
 static void add_allow_header(struct stasis_rest_handlers *handler,
 			     struct ast_ari_response *response)
 {
@@ -566,6 +690,14 @@ void ast_ari_invoke(struct ast_tcptls_session_instance *ser,
 	}
 
 	if (handler->ws_server && method == AST_HTTP_GET) {
+		if (!ser) {
+			/* Bulk operations have no connection to upgrade */
+			ast_ari_response_error(
+				response, 400, "Bad Request",
+				"WebSocket upgrade not possible here");
+			return;
+		}
+
 		/* WebSocket! */
 		ari_handle_websocket(handler->ws_server, ser, uri, method,
 			get_params, headers);
@@ -1063,6 +1195,7 @@ static int ast_ari_callback(struct ast_tcptls_session_instance *ser,
 		/* The handler indicates no further response is necessary.
 		 * Probably because it already handled it */
 		ast_free(response.headers);
+		ast_free(response.body);
 		return 0;
 	}
 
@@ -1074,10 +1207,31 @@ request_failed:
 	ast_assert(response.message != NULL);
 	ast_assert(response.response_code > 0);
 
-	/* response.message could be NULL, in which case the empty response_body
-	 * is correct
+	/* Encoded bodies are compact, so pretty printing needs the message */
+	if (response.body && conf->general->format != AST_JSON_COMPACT) {
+		if (ast_json_is_null(response.message)) {
+			ast_json_unref(response.message);
+			response.message = ast_json_load_str(response.body, NULL);
+			if (!response.message) {
+				response.message = ast_json_null();
+				response.response_code = 500;
+				response.response_text = "Internal Server Error";
+			}
+		}
+		ast_free(response.body);
+		response.body = NULL;
+	}
+
+	/* An encoded body is sent as is. Otherwise response.message could be
+	 * NULL, in which case the empty response_body is correct
 	 */
-	if (response.message && !ast_json_is_null(response.message)) {
+	if (response.body) {
+		ast_str_append(&response.headers, 0,
+			       "Content-type: application/json\r\n");
+		ast_free(response_body);
+		response_body = response.body;
+		response.body = NULL;
+	} else if (response.message && !ast_json_is_null(response.message)) {
 		ast_str_append(&response.headers, 0,
 			       "Content-type: application/json\r\n");
 		if (ast_json_dump_str_format(response.message, &response_body,
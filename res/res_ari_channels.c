@@ -54,6 +54,23 @@
 
 #define MAX_VALS 128
 
+int ast_ari_channels_list_parse_body(
+	struct ast_json *body,
+	struct ast_ari_channels_list_args *args)
+{
+	struct ast_json *field;
+	/* Parse query parameters out of it */
+	field = ast_json_object_get(body, "limit");
+	if (field) {
+		args->limit = ast_json_integer_get(field);
+	}
+	field = ast_json_object_get(body, "after");
+	if (field) {
+		args->after = ast_json_string_get(field);
+	}
+	return 0;
+}
+
 /*!
  * \brief Parameter parsing callback for /channels.
  * \param get_params GET parameters in the HTTP request.
@@ -67,11 +84,25 @@ static void ast_ari_channels_list_cb(
 	struct ast_variable *headers, struct ast_json *body, struct ast_ari_response *response)
 {
 	struct ast_ari_channels_list_args args = {};
+	struct ast_variable *i;
 #if defined(AST_DEVMODE)
 	int is_valid;
 	int code;
 #endif /* AST_DEVMODE */
 
+	for (i = get_params; i; i = i->next) {
+		if (strcmp(i->name, "limit") == 0) {
+			args.limit = atoi(i->value);
+		} else
+		if (strcmp(i->name, "after") == 0) {
+			args.after = (i->value);
+		} else
+		{}
+	}
+	if (ast_ari_channels_list_parse_body(body, &args)) {
+		ast_ari_response_alloc_failed(response);
+		goto fin;
+	}
 	ast_ari_channels_list(headers, &args, response);
 #if defined(AST_DEVMODE)
 	code = response->response_code;
@@ -82,6 +113,7 @@ static void ast_ari_channels_list_cb(
 		break;
 	case 500: /* Internal Server Error */
 	case 501: /* Not Implemented */
+	case 400: /* Invalid limit. */
 		is_valid = 1;
 		break;
 	default:
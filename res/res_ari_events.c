@@ -113,6 +113,15 @@ static int ast_ari_events_event_websocket_ws_attempted_cb(struct ast_tcptls_sess
 		if (strcmp(i->name, "subscribeAll") == 0) {
 			args.subscribe_all = ast_true(i->value);
 		} else
+		if (strcmp(i->name, "encoding") == 0) {
+			args.encoding = (i->value);
+		} else
+		if (strcmp(i->name, "batchSize") == 0) {
+			args.batch_size = atoi(i->value);
+		} else
+		if (strcmp(i->name, "batchDelay") == 0) {
+			args.batch_delay = atoi(i->value);
+		} else
 		{}
 	}
 
@@ -216,6 +225,15 @@ static void ast_ari_events_event_websocket_ws_established_cb(struct ast_websocke
 		if (strcmp(i->name, "subscribeAll") == 0) {
 			args.subscribe_all = ast_true(i->value);
 		} else
+		if (strcmp(i->name, "encoding") == 0) {
+			args.encoding = (i->value);
+		} else
+		if (strcmp(i->name, "batchSize") == 0) {
+			args.batch_size = atoi(i->value);
+		} else
+		if (strcmp(i->name, "batchDelay") == 0) {
+			args.batch_delay = atoi(i->value);
+		} else
 		{}
 	}
 
@@ -454,6 +472,8 @@ static int load_module(void)
 	}
 	protocol->session_attempted = ast_ari_events_event_websocket_ws_attempted_cb;
 	protocol->session_established = ast_ari_events_event_websocket_ws_established_cb;
+	protocol->deflate = 1;
+	protocol->coalesce = 1;
 	res |= ast_websocket_server_add_protocol2(events.ws_server, protocol);
 
 	res |= ast_ari_add_handler(&events);
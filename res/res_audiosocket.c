@@ -31,6 +31,9 @@
 #include "asterisk.h"
 #include "errno.h"
 #include <uuid/uuid.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include "asterisk/file.h"
 #include "asterisk/res_audiosocket.h"
@@ -38,6 +41,8 @@
 #include "asterisk/module.h"
 #include "asterisk/uuid.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/alertpipe.h"
+#include "asterisk/astobj2.h"
 
 #define	MODULE_DESCRIPTION	"AudioSocket support functions for Asterisk"
 
@@ -324,15 +329,813 @@ struct ast_frame *ast_audiosocket_receive_frame(const int svc)
 	return ast_frisolate(&f);
 }
 
-static int load_module(void)
+#ifdef __linux__
+
+/*! \brief Number of threads reading multiplexed connections */
+#define AUDIOSOCKET_READERS 4
+
+/*! \brief Most frames queued for a stream before the oldest are dropped */
+#define AUDIOSOCKET_STREAM_MAX_QUEUED 50
+
+/*! \brief Most bytes waiting to be written on a connection before audio is dropped */
+#define AUDIOSOCKET_MUX_MAX_PENDING (256 * 1024)
+
+/*! \brief Size of a multiplexed message header, kind + stream id + length */
+#define AUDIOSOCKET_MUX_HEADER 5
+
+/*! \brief A reader thread and the connections it waits on */
+struct audiosocket_reader {
+	/*! The epoll set of the connections */
+	int epfd;
+	/*! Wakes the thread up to stop */
+	int alert_pipe[2];
+	/*! The thread */
+	pthread_t thread;
+};
+
+/*! \brief A connection to a server carrying many streams */
+struct audiosocket_mux {
+	/*! The socket */
+	int fd;
+	/*! The reader thread waiting on the socket */
+	struct audiosocket_reader *reader;
+	/*! The streams on the connection, by stream id */
+	struct ao2_container *streams;
+	/*! The last stream id handed out */
+	uint16_t last_id;
+	/*! Set once the connection failed or is being closed */
+	unsigned int dead:1;
+	/*! Set while a thread writes the batch */
+	unsigned int flushing:1;
+	/*! Set while the socket cannot take more data */
+	unsigned int blocked:1;
+	/*! Set once the last stream left, the connection closes once written out */
+	unsigned int closing:1;
+	/*! Messages waiting for the next write */
+	unsigned char *out;
+	size_t out_len;
+	size_t out_size;
+	/*! Messages being written */
+	unsigned char *batch;
+	size_t batch_len;
+	size_t batch_pos;
+	size_t batch_size;
+	/*! Data read but not yet parsed, only used by the reader thread */
+	size_t in_len;
+	unsigned char in[2 * (AUDIOSOCKET_MUX_HEADER + 65535)];
+	/*! The server, host and port */
+	char server[0];
+};
+
+struct ast_audiosocket_stream {
+	/*! The connection carrying the stream */
+	struct audiosocket_mux *mux;
+	/*! Signals the stream has frames or was closed */
+	int alert_pipe[2];
+	/*! The frames received and not yet read */
+	AST_LIST_HEAD_NOLOCK(, ast_frame) frames;
+	/*! The number of frames queued */
+	unsigned int queued;
+	/*! The stream id on the connection */
+	uint16_t id;
+	/*! Set once the UUID was sent */
+	unsigned int started:1;
+	/*! Set once the server or the connection ended the stream */
+	unsigned int closed:1;
+	/*! Set while the alert pipe holds an alert */
+	unsigned int alerted:1;
+};
+
+static struct audiosocket_reader readers[AUDIOSOCKET_READERS];
+static unsigned int next_reader;
+static int readers_stop;
+
+/*! \brief Connections by server */
+static struct ao2_container *muxes;
+
+/*! \brief Serializes connecting to servers */
+AST_MUTEX_DEFINE_STATIC(mux_connect_lock);
+
+AO2_STRING_FIELD_HASH_FN(audiosocket_mux, server);
+AO2_STRING_FIELD_CMP_FN(audiosocket_mux, server);
+
+static int audiosocket_stream_hash_fn(const void *obj, const int flags)
 {
-	ast_verb(1, "Loading AudioSocket Support module\n");
-	return AST_MODULE_LOAD_SUCCESS;
+	const struct ast_audiosocket_stream *stream = obj;
+	const uint16_t *id = obj;
+
+	return (flags & OBJ_SEARCH_MASK) == OBJ_SEARCH_KEY ? *id : stream->id;
+}
+
+static int audiosocket_stream_cmp_fn(void *obj, void *arg, int flags)
+{
+	const struct ast_audiosocket_stream *stream = obj;
+	const struct ast_audiosocket_stream *right = arg;
+	const uint16_t *id = arg;
+
+	if ((flags & OBJ_SEARCH_MASK) == OBJ_SEARCH_KEY) {
+		return stream->id == *id ? CMP_MATCH : 0;
+	}
+
+	return stream->id == right->id ? CMP_MATCH : 0;
+}
+
+/*!
+ * \internal
+ * \brief Wake up the reader of a stream
+ *
+ * \note Called with the stream locked.
+ */
+static void audiosocket_stream_alert(struct ast_audiosocket_stream *stream)
+{
+	if (!stream->alerted && ast_alertpipe_write(stream->alert_pipe) == 1) {
+		stream->alerted = 1;
+	}
+}
+
+static void audiosocket_stream_destroy(void *obj)
+{
+	struct ast_audiosocket_stream *stream = obj;
+	struct ast_frame *f;
+
+	while ((f = AST_LIST_REMOVE_HEAD(&stream->frames, frame_list))) {
+		ast_frfree(f);
+	}
+	ast_alertpipe_close(stream->alert_pipe);
+	ao2_cleanup(stream->mux);
+}
+
+static void audiosocket_mux_destroy(void *obj)
+{
+	struct audiosocket_mux *mux = obj;
+
+	if (mux->fd >= 0) {
+		close(mux->fd);
+	}
+	ao2_cleanup(mux->streams);
+	ast_free(mux->out);
+	ast_free(mux->batch);
+}
+
+/*!
+ * \internal
+ * \brief Have a connection torn down by its reader
+ *
+ * \note Called with the connection locked.
+ */
+static void audiosocket_mux_shutdown(struct audiosocket_mux *mux)
+{
+	if (!mux->dead) {
+		mux->dead = 1;
+		shutdown(mux->fd, SHUT_RDWR);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Change the events the reader of a connection waits for
+ */
+static void audiosocket_mux_watch(struct audiosocket_mux *mux, uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.ptr = mux, };
+
+	epoll_ctl(mux->reader->epfd, EPOLL_CTL_MOD, mux->fd, &ev);
+}
+
+/*!
+ * \internal
+ * \brief Write the messages waiting on a connection
+ *
+ * Messages appended by other threads while a write is in progress are
+ * written together by the next write, so under load a connection sees one
+ * write for the frames of many streams.  If the socket is full the rest is
+ * written by the reader once it can take more.
+ *
+ * \note Called with the connection locked, the lock is released while
+ * writing.
+ */
+static void audiosocket_mux_flush(struct audiosocket_mux *mux)
+{
+	while (!mux->flushing && !mux->blocked && !mux->dead) {
+		ssize_t res;
+
+		if (mux->batch_pos == mux->batch_len) {
+			unsigned char *buf = mux->batch;
+			size_t size = mux->batch_size;
+
+			if (!mux->out_len) {
+				break;
+			}
+			mux->batch = mux->out;
+			mux->batch_size = mux->out_size;
+			mux->batch_len = mux->out_len;
+			mux->batch_pos = 0;
+			mux->out = buf;
+			mux->out_size = size;
+			mux->out_len = 0;
+		}
+
+		mux->flushing = 1;
+		ao2_unlock(mux);
+		res = write(mux->fd, mux->batch + mux->batch_pos, mux->batch_len - mux->batch_pos);
+		ao2_lock(mux);
+		mux->flushing = 0;
+
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				mux->blocked = 1;
+				audiosocket_mux_watch(mux, EPOLLIN | EPOLLOUT);
+				break;
+			}
+			ast_log(LOG_WARNING, "Failed to write data to AudioSocket '%s': %s\n",
+				mux->server, strerror(errno));
+			audiosocket_mux_shutdown(mux);
+			break;
+		}
+		mux->batch_pos += res;
+	}
+
+	if (mux->closing && !mux->flushing && !mux->out_len && mux->batch_pos == mux->batch_len) {
+		audiosocket_mux_shutdown(mux);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Queue a message on a connection
+ *
+ * \note Called with the connection locked.
+ *
+ * \retval 0 if queued or dropped because the connection is backed up
+ * \retval -1 if the connection is gone
+ */
+static int audiosocket_mux_queue(struct audiosocket_mux *mux, uint8_t kind, uint16_t id,
+	const void *data, uint16_t len)
+{
+	unsigned char *p;
+
+	if (mux->dead) {
+		return -1;
+	}
+
+	if (mux->out_len + AUDIOSOCKET_MUX_HEADER + len > mux->out_size) {
+		size_t size = MAX(mux->out_size * 2, mux->out_len + AUDIOSOCKET_MUX_HEADER + len);
+
+		if (mux->out_len + AUDIOSOCKET_MUX_HEADER + len > AUDIOSOCKET_MUX_MAX_PENDING) {
+			/* Losing audio beats stalling every stream on the connection */
+			ast_debug(3, "AudioSocket '%s' is backed up, dropping message for stream %u\n",
+				mux->server, id);
+			return kind == 0x10 ? 0 : -1;
+		}
+		p = ast_realloc(mux->out, size);
+		if (!p) {
+			return -1;
+		}
+		mux->out = p;
+		mux->out_size = size;
+	}
+
+	p = mux->out + mux->out_len;
+	*(p++) = kind;
+	*(p++) = id >> 8;
+	*(p++) = id & 0xff;
+	*(p++) = len >> 8;
+	*(p++) = len & 0xff;
+	if (len) {
+		memcpy(p, data, len);
+	}
+	mux->out_len += AUDIOSOCKET_MUX_HEADER + len;
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Hand a message read from a connection to its stream
+ *
+ * \note Called by the reader thread.
+ */
+static void audiosocket_mux_dispatch(struct audiosocket_mux *mux, uint8_t kind, uint16_t id,
+	const unsigned char *data, uint16_t len)
+{
+	struct ast_audiosocket_stream *stream;
+	struct ast_frame f = {
+		.frametype = AST_FRAME_VOICE,
+		.subclass.format = ast_format_slin,
+		.src = "AudioSocket",
+		.mallocd = AST_MALLOCD_DATA,
+	};
+	struct ast_frame *frame = NULL;
+
+	stream = ao2_find(mux->streams, &id, OBJ_SEARCH_KEY);
+	if (!stream) {
+		ast_debug(3, "Ignoring AudioSocket message for unknown stream %u on '%s'\n",
+			id, mux->server);
+		return;
+	}
+
+	if (kind == 0x10 && len) {
+		f.data.ptr = ast_malloc(len);
+		if (f.data.ptr) {
+			memcpy(f.data.ptr, data, len);
+			f.datalen = len;
+			f.samples = len / 2;
+			frame = ast_frisolate(&f);
+		}
+	} else if (kind != 0x00) {
+		ast_log(LOG_WARNING, "Received non-audio AudioSocket message on stream %u\n", id);
+	}
+
+	ao2_lock(stream);
+	if (kind == 0x00) {
+		stream->closed = 1;
+		audiosocket_stream_alert(stream);
+	} else if (frame) {
+		if (stream->queued >= AUDIOSOCKET_STREAM_MAX_QUEUED) {
+			ast_frfree(AST_LIST_REMOVE_HEAD(&stream->frames, frame_list));
+			stream->queued--;
+		}
+		AST_LIST_INSERT_TAIL(&stream->frames, frame, frame_list);
+		stream->queued++;
+		audiosocket_stream_alert(stream);
+	}
+	ao2_unlock(stream);
+	ao2_ref(stream, -1);
+}
+
+static int audiosocket_stream_end(void *obj, void *arg, int flags)
+{
+	struct ast_audiosocket_stream *stream = obj;
+
+	ao2_lock(stream);
+	stream->closed = 1;
+	audiosocket_stream_alert(stream);
+	ao2_unlock(stream);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Tear down a failed or closed connection
+ *
+ * Ends every stream on it, which hangs their channels up.
+ *
+ * \note Called by the reader thread.
+ */
+static void audiosocket_mux_fail(struct audiosocket_mux *mux)
+{
+	epoll_ctl(mux->reader->epfd, EPOLL_CTL_DEL, mux->fd, NULL);
+	ao2_unlink(muxes, mux);
+
+	ao2_lock(mux);
+	mux->dead = 1;
+	ao2_unlock(mux);
+	ao2_callback(mux->streams, OBJ_NODATA | OBJ_MULTIPLE, audiosocket_stream_end, NULL);
+
+	ast_debug(1, "AudioSocket connection to '%s' closed\n", mux->server);
+
+	/* Drop the reference held by the epoll set */
+	ao2_ref(mux, -1);
+}
+
+/*!
+ * \internal
+ * \brief Read and dispatch everything available on a connection
+ *
+ * \retval 0 on success
+ * \retval -1 if the connection is gone
+ */
+static int audiosocket_mux_read(struct audiosocket_mux *mux)
+{
+	for (;;) {
+		size_t pos = 0;
+		ssize_t res;
+
+		res = read(mux->fd, mux->in + mux->in_len, sizeof(mux->in) - mux->in_len);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			ast_log(LOG_WARNING, "Failed to read from AudioSocket '%s': %s\n",
+				mux->server, strerror(errno));
+			return -1;
+		}
+		if (!res) {
+			return -1;
+		}
+		mux->in_len += res;
+
+		while (mux->in_len - pos >= AUDIOSOCKET_MUX_HEADER) {
+			const unsigned char *p = mux->in + pos;
+			uint16_t id = (p[1] << 8) | p[2];
+			uint16_t len = (p[3] << 8) | p[4];
+
+			if (mux->in_len - pos < AUDIOSOCKET_MUX_HEADER + len) {
+				break;
+			}
+			audiosocket_mux_dispatch(mux, p[0], id, p + AUDIOSOCKET_MUX_HEADER, len);
+			pos += AUDIOSOCKET_MUX_HEADER + len;
+		}
+		if (pos) {
+			memmove(mux->in, mux->in + pos, mux->in_len - pos);
+			mux->in_len -= pos;
+		}
+	}
+}
+
+static void *audiosocket_reader_thread(void *data)
+{
+	struct audiosocket_reader *reader = data;
+	struct epoll_event events[64];
+
+	while (!readers_stop) {
+		int count;
+		int i;
+
+		count = epoll_wait(reader->epfd, events, ARRAY_LEN(events), -1);
+		for (i = 0; i < count; i++) {
+			struct audiosocket_mux *mux = events[i].data.ptr;
+
+			if (!mux) {
+				/* Woken up to stop */
+				continue;
+			}
+
+			if (events[i].events & EPOLLOUT) {
+				ao2_lock(mux);
+				mux->blocked = 0;
+				audiosocket_mux_watch(mux, EPOLLIN);
+				audiosocket_mux_flush(mux);
+				ao2_unlock(mux);
+			}
+
+			if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				&& audiosocket_mux_read(mux)) {
+				audiosocket_mux_fail(mux);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Find the connection to a server, connecting if there is none
+ *
+ * \return The connection with a reference, NULL on error
+ */
+static struct audiosocket_mux *audiosocket_mux_get(const char *server, struct ast_channel *chan)
+{
+	static const unsigned char hello[] = { 0x02, 0x00, 0x00 };
+	struct audiosocket_mux *mux;
+	struct epoll_event ev = { .events = EPOLLIN, };
+
+	ast_mutex_lock(&mux_connect_lock);
+	mux = ao2_find(muxes, server, OBJ_SEARCH_KEY);
+	if (mux) {
+		ast_mutex_unlock(&mux_connect_lock);
+		return mux;
+	}
+
+	mux = ao2_alloc(sizeof(*mux) + strlen(server) + 1, audiosocket_mux_destroy);
+	if (!mux) {
+		ast_mutex_unlock(&mux_connect_lock);
+		return NULL;
+	}
+	strcpy(mux->server, server); /* Safe */
+	mux->fd = -1;
+
+	mux->streams = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, 257,
+		audiosocket_stream_hash_fn, NULL, audiosocket_stream_cmp_fn);
+	if (!mux->streams) {
+		goto failure;
+	}
+
+	mux->fd = ast_audiosocket_connect(server, chan);
+	if (mux->fd < 0) {
+		goto failure;
+	}
+
+	/* Switch the connection to multiplexed framing */
+	if (write(mux->fd, hello, sizeof(hello)) != sizeof(hello)) {
+		ast_log(LOG_WARNING, "Failed to write data to AudioSocket\n");
+		goto failure;
+	}
+
+	mux->reader = &readers[next_reader++ % AUDIOSOCKET_READERS];
+	ev.data.ptr = ao2_bump(mux);
+	if (epoll_ctl(mux->reader->epfd, EPOLL_CTL_ADD, mux->fd, &ev)) {
+		ast_log(LOG_ERROR, "Failed to watch AudioSocket connection to '%s': %s\n",
+			server, strerror(errno));
+		ao2_ref(mux, -1);
+		goto failure;
+	}
+
+	ao2_link(muxes, mux);
+	ast_mutex_unlock(&mux_connect_lock);
+
+	ast_debug(1, "Opened multiplexed AudioSocket connection to '%s'\n", server);
+
+	return mux;
+
+failure:
+	ast_mutex_unlock(&mux_connect_lock);
+	ao2_ref(mux, -1);
+	return NULL;
+}
+
+struct ast_audiosocket_stream *ast_audiosocket_stream_open(const char *server,
+	struct ast_channel *chan)
+{
+	struct ast_audiosocket_stream *stream;
+	int attempts;
+
+	if (ast_strlen_zero(server)) {
+		ast_log(LOG_ERROR, "No AudioSocket server provided\n");
+		return NULL;
+	}
+
+	stream = ao2_alloc(sizeof(*stream), audiosocket_stream_destroy);
+	if (!stream) {
+		return NULL;
+	}
+	ast_alertpipe_clear(stream->alert_pipe);
+	if (ast_alertpipe_init(stream->alert_pipe)) {
+		ast_log(LOG_ERROR, "Failed to create alert pipe for AudioSocket stream\n");
+		ao2_ref(stream, -1);
+		return NULL;
+	}
+
+	/* A connection closing as its last stream leaves is replaced */
+	for (attempts = 0; attempts < 2 && !stream->mux; attempts++) {
+		struct audiosocket_mux *mux = audiosocket_mux_get(server, chan);
+
+		if (!mux) {
+			break;
+		}
+
+		ao2_lock(mux);
+		if (mux->dead || mux->closing) {
+			ao2_unlock(mux);
+			ao2_unlink(muxes, mux);
+			ao2_ref(mux, -1);
+			continue;
+		}
+		if (ao2_container_count(mux->streams) >= UINT16_MAX) {
+			ast_log(LOG_ERROR, "AudioSocket connection to '%s' has no free streams\n", server);
+			ao2_unlock(mux);
+			ao2_ref(mux, -1);
+			break;
+		}
+		for (;;) {
+			struct ast_audiosocket_stream *used;
+
+			stream->id = ++mux->last_id;
+			if (!stream->id) {
+				/* Stream id 0 is never used */
+				continue;
+			}
+			used = ao2_find(mux->streams, &stream->id, OBJ_SEARCH_KEY);
+			if (!used) {
+				break;
+			}
+			ao2_ref(used, -1);
+		}
+		ao2_link(mux->streams, stream);
+		ao2_unlock(mux);
+
+		/* The stream keeps the reference to the connection */
+		stream->mux = mux;
+	}
+
+	if (!stream->mux) {
+		ao2_ref(stream, -1);
+		return NULL;
+	}
+
+	return stream;
+}
+
+const int ast_audiosocket_stream_init(struct ast_audiosocket_stream *stream, const char *id)
+{
+	uuid_t uu;
+	int res;
+
+	if (ast_strlen_zero(id)) {
+		ast_log(LOG_ERROR, "No UUID for AudioSocket\n");
+		return -1;
+	}
+
+	if (uuid_parse(id, uu)) {
+		ast_log(LOG_ERROR, "Failed to parse UUID '%s'\n", id);
+		return -1;
+	}
+
+	ao2_lock(stream->mux);
+	res = audiosocket_mux_queue(stream->mux, 0x01, stream->id, uu, 16);
+	if (!res) {
+		stream->started = 1;
+		audiosocket_mux_flush(stream->mux);
+	}
+	ao2_unlock(stream->mux);
+
+	if (res) {
+		ast_log(LOG_WARNING, "Failed to write data to AudioSocket\n");
+	}
+
+	return res;
+}
+
+const int ast_audiosocket_stream_send_frame(struct ast_audiosocket_stream *stream,
+	const struct ast_frame *f)
+{
+	int res;
+
+	ao2_lock(stream->mux);
+	res = audiosocket_mux_queue(stream->mux, 0x10, stream->id, f->data.ptr, f->datalen);
+	if (!res) {
+		audiosocket_mux_flush(stream->mux);
+	}
+	ao2_unlock(stream->mux);
+
+	if (res) {
+		ast_log(LOG_WARNING, "Failed to write data to AudioSocket\n");
+	}
+
+	return res;
+}
+
+struct ast_frame *ast_audiosocket_stream_receive_frame(struct ast_audiosocket_stream *stream)
+{
+	struct ast_frame *f;
+
+	ao2_lock(stream);
+	f = AST_LIST_REMOVE_HEAD(&stream->frames, frame_list);
+	if (f) {
+		stream->queued--;
+	} else if (stream->closed) {
+		/* Leave the alert set so the channel keeps reading the hangup */
+		ao2_unlock(stream);
+		return NULL;
+	} else {
+		f = &ast_null_frame;
+	}
+	if (!stream->queued && !stream->closed && stream->alerted) {
+		ast_alertpipe_read(stream->alert_pipe);
+		stream->alerted = 0;
+	}
+	ao2_unlock(stream);
+
+	return f;
+}
+
+int ast_audiosocket_stream_fd(struct ast_audiosocket_stream *stream)
+{
+	return ast_alertpipe_readfd(stream->alert_pipe);
+}
+
+void ast_audiosocket_stream_close(struct ast_audiosocket_stream *stream)
+{
+	struct audiosocket_mux *mux;
+
+	if (!stream) {
+		return;
+	}
+
+	mux = stream->mux;
+	ao2_lock(mux);
+	ao2_unlink(mux->streams, stream);
+	if (stream->started && !stream->closed) {
+		audiosocket_mux_queue(mux, 0x00, stream->id, NULL, 0);
+		audiosocket_mux_flush(mux);
+	}
+	if (!ao2_container_count(mux->streams)) {
+		/* Don't hand the connection to new streams while it is closing */
+		ao2_unlink(muxes, mux);
+		mux->closing = 1;
+		audiosocket_mux_flush(mux);
+	}
+	ao2_unlock(mux);
+
+	ao2_ref(stream, -1);
+}
+
+static void audiosocket_readers_stop(void)
+{
+	int i;
+
+	readers_stop = 1;
+	for (i = 0; i < AUDIOSOCKET_READERS; i++) {
+		if (readers[i].thread != AST_PTHREADT_NULL) {
+			ast_alertpipe_write(readers[i].alert_pipe);
+			pthread_join(readers[i].thread, NULL);
+			readers[i].thread = AST_PTHREADT_NULL;
+		}
+		if (readers[i].epfd >= 0) {
+			close(readers[i].epfd);
+			readers[i].epfd = -1;
+		}
+		ast_alertpipe_close(readers[i].alert_pipe);
+	}
 }
 
+static int audiosocket_readers_start(void)
+{
+	int i;
+
+	for (i = 0; i < AUDIOSOCKET_READERS; i++) {
+		readers[i].epfd = -1;
+		readers[i].thread = AST_PTHREADT_NULL;
+		ast_alertpipe_clear(readers[i].alert_pipe);
+	}
+
+	readers_stop = 0;
+	for (i = 0; i < AUDIOSOCKET_READERS; i++) {
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL, };
+
+		readers[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (readers[i].epfd < 0 || ast_alertpipe_init(readers[i].alert_pipe)
+			|| epoll_ctl(readers[i].epfd, EPOLL_CTL_ADD,
+				ast_alertpipe_readfd(readers[i].alert_pipe), &ev)
+			|| ast_pthread_create_background(&readers[i].thread, NULL,
+				audiosocket_reader_thread, &readers[i])) {
+			ast_log(LOG_ERROR, "Failed to start AudioSocket reader thread\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+#else
+
+struct ast_audiosocket_stream *ast_audiosocket_stream_open(const char *server,
+	struct ast_channel *chan)
+{
+	ast_log(LOG_ERROR, "Multiplexed AudioSocket connections are not supported on this platform\n");
+	return NULL;
+}
+
+const int ast_audiosocket_stream_init(struct ast_audiosocket_stream *stream, const char *id)
+{
+	return -1;
+}
+
+const int ast_audiosocket_stream_send_frame(struct ast_audiosocket_stream *stream,
+	const struct ast_frame *f)
+{
+	return -1;
+}
+
+struct ast_frame *ast_audiosocket_stream_receive_frame(struct ast_audiosocket_stream *stream)
+{
+	return NULL;
+}
+
+int ast_audiosocket_stream_fd(struct ast_audiosocket_stream *stream)
+{
+	return -1;
+}
+
+void ast_audiosocket_stream_close(struct ast_audiosocket_stream *stream)
+{
+}
+
+#endif /* __linux__ */
+
 static int unload_module(void)
 {
 	ast_verb(1, "Unloading AudioSocket Support module\n");
+#ifdef __linux__
+	audiosocket_readers_stop();
+	ao2_cleanup(muxes);
+	muxes = NULL;
+#endif
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+static int load_module(void)
+{
+	ast_verb(1, "Loading AudioSocket Support module\n");
+#ifdef __linux__
+	muxes = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, 17,
+		audiosocket_mux_hash_fn, NULL, audiosocket_mux_cmp_fn);
+	if (!muxes) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+	if (audiosocket_readers_start()) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+#endif
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
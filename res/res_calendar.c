@@ -341,6 +341,7 @@ static void calendar_destructor(void *obj)
 	ast_string_field_free_memory(cal);
 	ast_variables_destroy(cal->vars);
 	ao2_ref(cal->events, -1);
+	ao2_cleanup(cal->event_index);
 	ao2_unlock(cal);
 }
 
@@ -355,27 +356,183 @@ static void eventlist_destructor(void *obj)
 	}
 }
 
-static int calendar_busy_callback(void *obj, void *arg, int flags)
+/*!
+ * \brief The events of a calendar ordered by start time
+ *
+ * The array is the in-order walk of a balanced binary search tree whose
+ * root is the middle element of each range.  Each node keeps the latest
+ * end of the events in its subtree, which makes it an interval tree:
+ * the events overlapping a time range are found in O(log n + k).  An index
+ * is never changed once built, a new one replaces it when the events of
+ * the calendar change.
+ */
+struct ast_calendar_event_index {
+	/*! Number of events in the index */
+	size_t count;
+	/*! Latest end of the events in the subtree of each position */
+	time_t *max_end;
+	/*! References to the events, ordered by start time */
+	struct ast_calendar_event *events[0];
+};
+
+/*! \brief Protects the event_index pointer of every calendar */
+AST_RWLOCK_DEFINE_STATIC(event_index_lock);
+
+/*! \brief Called for each event overlapping a time range, non-zero stops the lookup */
+typedef int (*event_index_cb)(struct ast_calendar_event *event, void *arg);
+
+static void event_index_destructor(void *obj)
 {
-	struct ast_calendar_event *event = obj;
-	int *is_busy = arg;
-	struct timeval tv = ast_tvnow();
+	struct ast_calendar_event_index *index = obj;
+	size_t i;
+
+	for (i = 0; i < index->count; i++) {
+		ast_calendar_unref_event(index->events[i]);
+	}
+	ast_free(index->max_end);
+}
 
-	if (tv.tv_sec >= event->start && tv.tv_sec <= event->end && event->busy_state > AST_CALENDAR_BS_FREE) {
-		*is_busy = 1;
-		return CMP_STOP;
+static int event_start_cmp(const void *a, const void *b)
+{
+	const struct ast_calendar_event *event_a = *(struct ast_calendar_event * const *) a;
+	const struct ast_calendar_event *event_b = *(struct ast_calendar_event * const *) b;
+
+	return event_a->start < event_b->start ? -1 : event_a->start > event_b->start;
+}
+
+/*! \brief Fill in the latest ends of the subtree of positions [lo, hi) */
+static time_t event_index_build(struct ast_calendar_event_index *index, size_t lo, size_t hi)
+{
+	size_t mid = lo + (hi - lo) / 2;
+	time_t max_end = index->events[mid]->end;
+
+	if (lo < mid) {
+		max_end = MAX(max_end, event_index_build(index, lo, mid));
+	}
+	if (mid + 1 < hi) {
+		max_end = MAX(max_end, event_index_build(index, mid + 1, hi));
+	}
+	index->max_end[mid] = max_end;
+
+	return max_end;
+}
+
+/*! \brief Call cb for the events of positions [lo, hi) overlapping [start, end], in start order */
+static int event_index_search(struct ast_calendar_event_index *index, size_t lo, size_t hi,
+	time_t start, time_t end, event_index_cb cb, void *arg)
+{
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct ast_calendar_event *event = index->events[mid];
+
+		/* Everything in this subtree is over before the range */
+		if (index->max_end[mid] < start) {
+			return 0;
+		}
+		if (lo < mid && event_index_search(index, lo, mid, start, end, cb, arg)) {
+			return -1;
+		}
+		/* This event and everything after it starts after the range */
+		if (event->start > end) {
+			return 0;
+		}
+		if (event->end >= start && cb(event, arg)) {
+			return -1;
+		}
+		lo = mid + 1;
 	}
 
 	return 0;
 }
 
-static int calendar_is_busy(struct ast_calendar *cal)
+/*!
+ * \brief Rebuild the time index of a calendar from its events
+ *
+ * On failure the calendar is left without an index and lookups fall back
+ * to going through all of its events.
+ */
+static void calendar_index_events(struct ast_calendar *cal)
+{
+	struct ast_calendar_event_index *index;
+	struct ast_calendar_event_index *old;
+	struct ao2_iterator i;
+	struct ast_calendar_event *event;
+	size_t count = ao2_container_count(cal->events);
+
+	index = ao2_alloc_options(sizeof(*index) + count * sizeof(index->events[0]),
+		event_index_destructor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (index && count && !(index->max_end = ast_malloc(count * sizeof(*index->max_end)))) {
+		ao2_ref(index, -1);
+		index = NULL;
+	}
+
+	if (index) {
+		i = ao2_iterator_init(cal->events, 0);
+		while (index->count < count && (event = ao2_iterator_next(&i))) {
+			index->events[index->count++] = event;
+		}
+		ao2_iterator_destroy(&i);
+
+		if (index->count) {
+			qsort(index->events, index->count, sizeof(index->events[0]), event_start_cmp);
+			event_index_build(index, 0, index->count);
+		}
+	}
+
+	ast_rwlock_wrlock(&event_index_lock);
+	old = cal->event_index;
+	cal->event_index = index;
+	ast_rwlock_unlock(&event_index_lock);
+
+	ao2_cleanup(old);
+}
+
+/*!
+ * \brief Call cb for each event of a calendar overlapping [start, end]
+ *
+ * \retval 0 all of the overlapping events were passed to cb
+ * \retval -1 cb stopped the lookup
+ */
+static int calendar_find_events(struct ast_calendar *cal, time_t start, time_t end,
+	event_index_cb cb, void *arg)
 {
-	int is_busy = 0;
+	struct ast_calendar_event_index *index;
+	struct ao2_iterator i;
+	struct ast_calendar_event *event;
+	int res = 0;
+
+	ast_rwlock_rdlock(&event_index_lock);
+	index = ao2_bump(cal->event_index);
+	ast_rwlock_unlock(&event_index_lock);
+
+	if (index) {
+		res = event_index_search(index, 0, index->count, start, end, cb, arg);
+		ao2_ref(index, -1);
+		return res;
+	}
 
-	ao2_callback(cal->events, OBJ_NODATA, calendar_busy_callback, &is_busy);
+	i = ao2_iterator_init(cal->events, 0);
+	while (!res && (event = ao2_iterator_next(&i))) {
+		if (!(start > event->end || end < event->start) && cb(event, arg)) {
+			res = -1;
+		}
+		ast_calendar_unref_event(event);
+	}
+	ao2_iterator_destroy(&i);
+
+	return res;
+}
 
-	return is_busy;
+static int calendar_busy_callback(struct ast_calendar_event *event, void *arg)
+{
+	return event->busy_state > AST_CALENDAR_BS_FREE;
+}
+
+static int calendar_is_busy(struct ast_calendar *cal)
+{
+	time_t now = ast_tvnow().tv_sec;
+
+	return calendar_find_events(cal, now, now, calendar_busy_callback, NULL) ? 1 : 0;
 }
 
 static enum ast_device_state calendarstate(const char *data)
@@ -662,6 +819,7 @@ void ast_calendar_clear_events(struct ast_calendar *cal)
 	ast_debug(3, "Clearing all events for calendar %s\n", cal->name);
 
 	ao2_callback(cal->events, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, clear_events_cb, NULL);
+	calendar_index_events(cal);
 }
 
 struct ast_calendar_event *ast_calendar_event_alloc(struct ast_calendar *cal)
@@ -1059,6 +1217,8 @@ void ast_calendar_merge_events(struct ast_calendar *cal, struct ao2_container *n
 
 	/* Now, we should only have completely new events in new_events.  Loop through and add them */
 	ao2_callback(new_events, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, add_new_event_cb, cal->events);
+
+	calendar_index_events(cal);
 }
 
 
@@ -1210,11 +1370,25 @@ static void *eventlist_duplicate(void *data)
 	return events;
 }
 
+struct query_data {
+	struct eventlist *events;
+	time_t start;
+	time_t end;
+};
+
+static int query_add_event(struct ast_calendar_event *event, void *arg)
+{
+	struct query_data *query = arg;
+
+	ast_debug(10, "%s (%ld - %ld) overlapped with (%ld - %ld)\n", event->summary, (long) event->start, (long) event->end, (long) query->start, (long) query->end);
+
+	return add_event_to_list(query->events, event, query->start, query->end) < 0 ? -1 : 0;
+}
+
 static int calendar_query_exec(struct ast_channel *chan, const char *cmd, char *data, char *buf, size_t len)
 {
 	struct ast_calendar *cal;
-	struct ao2_iterator i;
-	struct ast_calendar_event *event;
+	struct query_data query;
 	struct eventlist *events;
 	time_t start = INT_MIN, end = INT_MAX;
 	struct ast_datastore *eventlist_datastore;
@@ -1255,22 +1429,14 @@ static int calendar_query_exec(struct ast_channel *chan, const char *cmd, char *
 		end = atoi(args.end);
 	}
 
-	i = ao2_iterator_init(cal->events, 0);
-	while ((event = ao2_iterator_next(&i))) {
-		if (!(start > event->end || end < event->start)) {
-			ast_debug(10, "%s (%ld - %ld) overlapped with (%ld - %ld)\n", event->summary, (long) event->start, (long) event->end, (long) start, (long) end);
-			if (add_event_to_list(events, event, start, end) < 0) {
-				event = ast_calendar_unref_event(event);
-				cal = unref_calendar(cal);
-				ao2_ref(events, -1);
-				ao2_iterator_destroy(&i);
-				return -1;
-			}
-		}
-
-		event = ast_calendar_unref_event(event);
+	query.events = events;
+	query.start = start;
+	query.end = end;
+	if (calendar_find_events(cal, start, end, query_add_event, &query)) {
+		cal = unref_calendar(cal);
+		ao2_ref(events, -1);
+		return -1;
 	}
-	ao2_iterator_destroy(&i);
 
 	ast_channel_lock(chan);
 	do {
@@ -69,6 +69,8 @@ struct caldav_pvt {
 	ne_uri uri;
 	ne_session *session;
 	struct ao2_container *events;
+	char *ctag;           /*!< The ctag of the collection when the events were last fetched */
+	time_t fetched_until; /*!< The end of the time range of the events last fetched */
 };
 
 static void caldav_destructor(void *obj)
@@ -81,6 +83,7 @@ static void caldav_destructor(void *obj)
 	}
 	ne_uri_free(&pvt->uri);
 	ast_string_field_free_memory(pvt);
+	ast_free(pvt->ctag);
 
 	ao2_callback(pvt->events, OBJ_UNLINK | OBJ_NODATA | OBJ_MULTIPLE, NULL, NULL);
 
@@ -135,7 +138,7 @@ static int debug_response_handler(void *userdata, ne_request *req, const ne_stat
 	return 1;
 }
 
-static struct ast_str *caldav_request(struct caldav_pvt *pvt, const char *method, struct ast_str *req_body, struct ast_str *subdir, const char *content_type)
+static struct ast_str *caldav_request(struct caldav_pvt *pvt, const char *method, struct ast_str *req_body, struct ast_str *subdir, const char *content_type, const char *depth)
 {
 	struct ast_str *response;
 	ne_request *req;
@@ -158,7 +161,7 @@ static struct ast_str *caldav_request(struct caldav_pvt *pvt, const char *method
 	ne_add_response_body_reader(req, debug_response_handler, fetch_response_reader, &response);
 	ne_set_request_body_buffer(req, ast_str_buffer(req_body), ast_str_strlen(req_body));
 	ne_add_request_header(req, "Content-type", ast_strlen_zero(content_type) ? "text/xml" : content_type);
-	ne_add_request_header(req, "Depth", "1");
+	ne_add_request_header(req, "Depth", depth);
 
 	ret = ne_request_dispatch(req);
 	ne_request_destroy(req);
@@ -255,7 +258,7 @@ static int caldav_write_event(struct ast_calendar_event *event)
 	ast_str_append(&body, 0, "%s", icalcomponent_as_ical_string(calendar));
 	ast_str_set(&subdir, 0, "%s%s.ics", pvt->url[strlen(pvt->url) - 1] == '/' ? "" : "/", event->uid);
 
-	if ((response = caldav_request(pvt, "PUT", body, subdir, "text/calendar"))) {
+	if ((response = caldav_request(pvt, "PUT", body, subdir, "text/calendar", "1"))) {
 		ret = 0;
 	}
 
@@ -311,7 +314,7 @@ static struct ast_str *caldav_get_events_between(struct caldav_pvt *pvt, time_t
 		"  </C:filter>\n"
 		"</C:calendar-query>\n", start_str, end_str, start_str, end_str);
 
-	response = caldav_request(pvt, "REPORT", body, NULL, NULL);
+	response = caldav_request(pvt, "REPORT", body, NULL, NULL, "1");
 	ast_free(body);
 	if (response && !ast_str_strlen(response)) {
 		ast_free(response);
@@ -544,6 +547,109 @@ static void handle_characters(void *data, const xmlChar *ch, int len)
 	xmlFree(tmp);
 }
 
+struct ctagstate {
+	int in_ctag;
+	struct ast_str *ctag;
+};
+
+static const xmlChar *ctag_node_localname = BAD_CAST "getctag";
+static const xmlChar *ctag_node_nsuri     = BAD_CAST "http://calendarserver.org/ns/";
+
+static void handle_ctag_start_element(void *data,
+								 const xmlChar *localname, const xmlChar *prefix, const xmlChar *uri,
+								 int nb_namespaces, const xmlChar **namespaces,
+								 int nb_attributes, int nb_defaulted, const xmlChar **attributes)
+{
+	struct ctagstate *state = data;
+
+	if (xmlStrcmp(localname, ctag_node_localname) || xmlStrcmp(uri, ctag_node_nsuri)) {
+		return;
+	}
+
+	state->in_ctag = 1;
+	ast_str_reset(state->ctag);
+}
+
+static void handle_ctag_end_element(void *data,
+							   const xmlChar *localname, const xmlChar *prefix, const xmlChar *uri)
+{
+	struct ctagstate *state = data;
+
+	if (xmlStrcmp(localname, ctag_node_localname) || xmlStrcmp(uri, ctag_node_nsuri)) {
+		return;
+	}
+
+	state->in_ctag = 0;
+}
+
+static void handle_ctag_characters(void *data, const xmlChar *ch, int len)
+{
+	struct ctagstate *state = data;
+
+	if (!state->in_ctag) {
+		return;
+	}
+
+	ast_str_append_substr(&state->ctag, 0, (const char *) ch, len);
+}
+
+/*!
+ * \brief Get the ctag of the calendar collection
+ *
+ * The ctag changes whenever anything in the collection changes, so an
+ * unchanged ctag means the events fetched before are still current.
+ *
+ * \return The ctag, to be freed by the caller, or NULL if the server has none
+ */
+static char *caldav_get_ctag(struct caldav_pvt *pvt)
+{
+	struct ast_str *body, *response;
+	xmlSAXHandler saxHandler;
+	struct ctagstate state = { 0, };
+	char *ctag = NULL;
+
+	if (!(body = ast_str_create(256))) {
+		return NULL;
+	}
+
+	ast_str_set(&body, 0,
+		"<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+		"<D:propfind xmlns:D=\"DAV:\" xmlns:CS=\"http://calendarserver.org/ns/\">\n"
+		"  <D:prop>\n"
+		"    <CS:getctag/>\n"
+		"  </D:prop>\n"
+		"</D:propfind>\n");
+
+	response = caldav_request(pvt, "PROPFIND", body, NULL, NULL, "0");
+	ast_free(body);
+	if (!response) {
+		return NULL;
+	}
+
+	if (!(state.ctag = ast_str_create(64))) {
+		ast_free(response);
+		return NULL;
+	}
+
+	/* See update_caldav() for why the handler is set up by hand */
+	memset(&saxHandler, 0, sizeof(saxHandler));
+	saxHandler.initialized = XML_SAX2_MAGIC;
+	saxHandler.startElementNs = handle_ctag_start_element;
+	saxHandler.endElementNs = handle_ctag_end_element;
+	saxHandler.characters = handle_ctag_characters;
+
+	xmlSAXUserParseMemory(&saxHandler, &state, ast_str_buffer(response), ast_str_strlen(response));
+
+	if (ast_str_strlen(state.ctag)) {
+		ctag = ast_strdup(ast_str_buffer(state.ctag));
+	}
+
+	ast_free(response);
+	ast_free(state.ctag);
+
+	return ctag;
+}
+
 static int update_caldav(struct caldav_pvt *pvt)
 {
 	struct timeval now = ast_tvnow();
@@ -554,15 +660,34 @@ static int update_caldav(struct caldav_pvt *pvt)
 		.in_caldata = 0,
 		.pvt = pvt
 	};
+	char *ctag;
 
 	start = now.tv_sec;
 	end = now.tv_sec + 60 * pvt->owner->timeframe;
+
+	/* Nothing changed on the server and the events fetched last time still
+	 * cover the time frame, so there is nothing to fetch or merge. */
+	ctag = caldav_get_ctag(pvt);
+	if (ctag && pvt->ctag && !strcmp(ctag, pvt->ctag) && end <= pvt->fetched_until) {
+		ast_debug(3, "CalDAV calendar '%s' is unchanged, keeping its events\n", pvt->owner->name);
+		ast_free(ctag);
+		return 0;
+	}
+
+	/* With a ctag the following refreshes can be skipped, so fetch a second
+	 * time frame ahead for them to use. */
+	if (ctag) {
+		end += 60 * pvt->owner->timeframe;
+	}
+
 	if (!(response = caldav_get_events_between(pvt, start, end))) {
+		ast_free(ctag);
 		return -1;
 	}
 
 	if (!(state.cdata = ast_str_create(512))) {
 		ast_free(response);
+		ast_free(ctag);
 		return -1;
 	}
 
@@ -592,6 +717,10 @@ static int update_caldav(struct caldav_pvt *pvt)
 
 	ast_calendar_merge_events(pvt->owner, pvt->events);
 
+	ast_free(pvt->ctag);
+	pvt->ctag = ctag;
+	pvt->fetched_until = end;
+
 	ast_free(response);
 	ast_free(state.cdata);
 
@@ -64,6 +64,8 @@ struct icalendar_pvt {
 	ne_uri uri;
 	ne_session *session;
 	icalcomponent *data;
+	char *etag;          /*!< ETag of the response data was parsed from */
+	char *last_modified; /*!< Last-Modified of the response data was parsed from */
 	struct ao2_container *events;
 };
 
@@ -78,6 +80,8 @@ static void icalendar_destructor(void *obj)
 	if (pvt->data) {
 		icalcomponent_free(pvt->data);
 	}
+	ast_free(pvt->etag);
+	ast_free(pvt->last_modified);
 	ne_uri_free(&pvt->uri);
 	ast_string_field_free_memory(pvt);
 
@@ -125,40 +129,83 @@ static int auth_credentials(void *userdata, const char *realm, int attempts, cha
 	return 0;
 }
 
-static icalcomponent *fetch_icalendar(struct icalendar_pvt *pvt)
+/*!
+ * \brief Fetch the iCalendar into pvt->data
+ *
+ * The validators of the last response are sent along with the request, so
+ * a calendar that did not change is neither transferred nor parsed again.
+ *
+ * \retval 0 pvt->data holds the current calendar
+ * \retval -1 on failure, pvt->data is left as it was
+ */
+static int fetch_icalendar(struct icalendar_pvt *pvt)
 {
 	int ret;
 	struct ast_str *response;
 	ne_request *req;
-	icalcomponent *comp = NULL;
+	icalcomponent *comp;
+	char *etag = NULL;
+	char *last_modified = NULL;
 
 	if (!pvt) {
 		ast_log(LOG_ERROR, "There is no private!\n");
-		return NULL;
+		return -1;
 	}
 
 	if (!(response = ast_str_create(512))) {
 		ast_log(LOG_ERROR, "Could not allocate memory for response.\n");
-		return NULL;
+		return -1;
 	}
 
 	req = ne_request_create(pvt->session, "GET", pvt->uri.path);
+	if (pvt->data) {
+		if (pvt->etag) {
+			ne_add_request_header(req, "If-None-Match", pvt->etag);
+		}
+		if (pvt->last_modified) {
+			ne_add_request_header(req, "If-Modified-Since", pvt->last_modified);
+		}
+	}
 	ne_add_response_body_reader(req, ne_accept_2xx, fetch_response_reader, &response);
 
 	ret = ne_request_dispatch(req);
+	if (ret == NE_OK && pvt->data && ne_get_status(req)->code == 304) {
+		ast_debug(3, "iCalendar '%s' is unchanged\n", pvt->owner->name);
+		ne_request_destroy(req);
+		ast_free(response);
+		return 0;
+	}
+	if (ret == NE_OK) {
+		etag = ast_strdup(ne_get_response_header(req, "ETag"));
+		last_modified = ast_strdup(ne_get_response_header(req, "Last-Modified"));
+	}
 	ne_request_destroy(req);
 	if (ret != NE_OK || !ast_str_strlen(response)) {
 		ast_log(LOG_WARNING, "Unable to retrieve iCalendar '%s' from '%s': %s\n", pvt->owner->name, pvt->url, ne_get_error(pvt->session));
 		ast_free(response);
-		return NULL;
+		ast_free(etag);
+		ast_free(last_modified);
+		return -1;
 	}
 
-	if (!ast_strlen_zero(ast_str_buffer(response))) {
-		comp = icalparser_parse_string(ast_str_buffer(response));
-	}
+	comp = icalparser_parse_string(ast_str_buffer(response));
 	ast_free(response);
+	if (!comp) {
+		ast_free(etag);
+		ast_free(last_modified);
+		return -1;
+	}
 
-	return comp;
+	if (pvt->data) {
+		icalcomponent_free(pvt->data);
+	}
+	pvt->data = comp;
+	ast_free(pvt->etag);
+	pvt->etag = etag;
+	ast_free(pvt->last_modified);
+	pvt->last_modified = last_modified;
+
+	return 0;
 }
 
 static time_t icalfloat_to_timet(icaltimetype time)
@@ -474,7 +521,7 @@ static void *ical_load_calendar(void *void_data)
 	ast_mutex_init(&refreshlock);
 
 	/* Load it the first time */
-	if (!(pvt->data = fetch_icalendar(pvt))) {
+	if (fetch_icalendar(pvt)) {
 		ast_log(LOG_WARNING, "Unable to parse iCalendar '%s'\n", cal->name);
 	}
 
@@ -504,12 +551,9 @@ static void *ical_load_calendar(void *void_data)
 
 		ast_debug(10, "Refreshing after %d minute timeout\n", pvt->owner->refresh);
 
-		/* Free the old calendar data */
-		if (pvt->data) {
-			icalcomponent_free(pvt->data);
-			pvt->data = NULL;
-		}
-		if (!(pvt->data = fetch_icalendar(pvt))) {
+		/* An unchanged calendar is kept, its events still have to be
+		 * expanded again for the new time frame. */
+		if (fetch_icalendar(pvt)) {
 			ast_log(LOG_WARNING, "Unable to parse iCalendar '%s'\n", pvt->owner->name);
 			continue;
 		}
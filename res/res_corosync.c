@@ -37,6 +37,7 @@
 
 #include "asterisk/module.h"
 #include "asterisk/logger.h"
+#include "asterisk/astdb.h"
 #include "asterisk/poll-compat.h"
 #include "asterisk/config.h"
 #include "asterisk/event.h"
@@ -47,6 +48,9 @@
 #include "asterisk/stasis_message_router.h"
 #include "asterisk/stasis_system.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/sched.h"
+#include "asterisk/unaligned.h"
+#include "asterisk/vector.h"
 
 AST_RWLOCK_DEFINE_STATIC(event_types_lock);
 AST_RWLOCK_DEFINE_STATIC(init_cpg_lock);
@@ -57,10 +61,71 @@ AST_RWLOCK_DEFINE_STATIC(init_cpg_lock);
 static void publish_mwi_to_stasis(struct ast_event *event);
 static void publish_device_state_to_stasis(struct ast_event *event);
 static void publish_cluster_discovery_to_stasis(struct ast_event *event);
+static void publish_db_change_to_stasis(struct ast_event *event);
+static int encode_mwi(struct ast_event *event, unsigned char *buf, size_t size);
+static struct ast_event *decode_mwi(const unsigned char *buf, size_t len, const struct ast_eid *eid);
+static int batch_key_mwi(struct ast_event *event, struct ast_str **key);
+static int encode_device_state(struct ast_event *event, unsigned char *buf, size_t size);
+static struct ast_event *decode_device_state(const unsigned char *buf, size_t len, const struct ast_eid *eid);
+static int batch_key_device_state(struct ast_event *event, struct ast_str **key);
+
+/*! \brief Marks a CPG message as a batch of events rather than a single \ref ast_event */
+#define COROSYNC_BATCH_MAGIC 0xC5B7
+
+/*! \brief Largest batch sent in a single CPG message */
+#define COROSYNC_BATCH_MAX_SIZE (64 * 1024)
+
+/*! \brief Buckets for events waiting to be sent in a batch */
+#define COROSYNC_BATCH_BUCKETS 127
+
+/*!
+ * \brief Header of a batch of events
+ *
+ * Every event in a batch has the same type and originated from the same
+ * node. Each one follows the header as its length, in network byte order,
+ * and the compact encoding of its type. The magic is where the type of a
+ * single \ref ast_event would be, and is larger than any event type, so
+ * nodes that do not understand batches ignore them.
+ */
+struct corosync_batch_header {
+	/*! COROSYNC_BATCH_MAGIC, in network byte order */
+	uint16_t magic;
+	/*! Type of the events, in network byte order */
+	uint16_t event_type;
+	/*! Number of events, in network byte order */
+	uint16_t count;
+	/*! The node the events originated from */
+	struct ast_eid eid;
+	/*! The events */
+	unsigned char payload[0];
+} __attribute__((packed));
+
+/*! \brief An event waiting to be sent in the next batch */
+struct corosync_pending_event {
+	/*! The event, replaced when the same entity is updated again */
+	struct ast_event *event;
+	/*! Event type and entity the event is about */
+	char key[0];
+};
+
+/*! \brief Events waiting to be sent, one per entity */
+static struct ao2_container *pending_events;
+
+/*! \brief Scheduler for sending batches */
+static struct ast_sched_context *batch_sched;
+
+/*! \brief Scheduler id of the batch send */
+static int batch_sched_id = -1;
+
+/*! \brief Milliseconds events are batched for before being sent, 0 to send them immediately */
+static unsigned int batch_interval;
 
 /*! \brief Join to corosync */
 static int corosync_node_joined = 0;
 
+/*! \brief Database families whose changes are published, protected by event_types_lock */
+static AST_VECTOR(, char *) db_families;
+
 /*! \brief All the nodes that we're aware of */
 static struct ao2_container *nodes;
 
@@ -246,17 +311,29 @@ static struct {
 	struct stasis_cache *(* cache_fn)(void);
 	struct stasis_message_type *(* message_type_fn)(void);
 	void (* publish_to_stasis)(struct ast_event *);
+	/*! Write the compact encoding of an event, NULL if the type is never batched */
+	int (* encode)(struct ast_event *, unsigned char *, size_t);
+	/*! Rebuild an event from its compact encoding */
+	struct ast_event *(* decode)(const unsigned char *, size_t, const struct ast_eid *);
+	/*! Identify the entity an event is about, so only its latest update is sent */
+	int (* batch_key)(struct ast_event *, struct ast_str **);
 } event_types[] = {
 	[AST_EVENT_MWI] = { .name = "mwi",
 	                    .topic_fn = ast_mwi_topic_all,
 	                    .cache_fn = ast_mwi_state_cache,
 	                    .message_type_fn = ast_mwi_state_type,
-	                    .publish_to_stasis = publish_mwi_to_stasis, },
+	                    .publish_to_stasis = publish_mwi_to_stasis,
+	                    .encode = encode_mwi,
+	                    .decode = decode_mwi,
+	                    .batch_key = batch_key_mwi, },
 	[AST_EVENT_DEVICE_STATE_CHANGE] = { .name = "device_state",
 	                                    .topic_fn = ast_device_state_topic_all,
 	                                    .cache_fn = ast_device_state_cache,
 	                                    .message_type_fn = ast_device_state_message_type,
-	                                    .publish_to_stasis = publish_device_state_to_stasis, },
+	                                    .publish_to_stasis = publish_device_state_to_stasis,
+	                                    .encode = encode_device_state,
+	                                    .decode = decode_device_state,
+	                                    .batch_key = batch_key_device_state, },
 	[AST_EVENT_PING] = { .name = "ping",
 	                     .publish_default = 1,
 	                     .subscribe_default = 1,
@@ -269,6 +346,10 @@ static struct {
 	                                  .topic_fn = ast_system_topic,
 	                                  .message_type_fn = ast_cluster_discovery_type,
 	                                  .publish_to_stasis = publish_cluster_discovery_to_stasis, },
+	[AST_EVENT_DB_CHANGE] = { .name = "db",
+	                          .topic_fn = ast_db_topic,
+	                          .message_type_fn = ast_db_change_type,
+	                          .publish_to_stasis = publish_db_change_to_stasis, },
 };
 
 static struct {
@@ -455,6 +536,133 @@ static void publish_device_state_to_stasis(struct ast_event *event)
 	}
 }
 
+/*! \brief Apply a received database change \ref ast_event to the local database */
+static void publish_db_change_to_stasis(struct ast_event *event)
+{
+	struct ast_db_change change;
+
+	ast_assert(ast_event_get_type(event) == AST_EVENT_DB_CHANGE);
+
+	change.op = ast_event_get_ie_uint(event, AST_EVENT_IE_DB_OP);
+	change.family = ast_event_get_ie_str(event, AST_EVENT_IE_DB_FAMILY);
+	change.key = S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_DB_KEY), "");
+	change.value = S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_DB_VALUE), "");
+
+	if (ast_strlen_zero(change.family)) {
+		return;
+	}
+
+	if (ast_db_change_apply(&change)) {
+		ast_log(LOG_WARNING, "Failed to apply database change to %s/%s\n",
+			change.family, change.key);
+	}
+}
+
+/*!
+ * \brief Write the compact encoding of an MWI event
+ *
+ * New and old message counts as 32 bit integers in network byte order,
+ * followed by the mailbox and context as NUL terminated strings.
+ *
+ * \return Bytes written, -1 if they do not fit
+ */
+static int encode_mwi(struct ast_event *event, unsigned char *buf, size_t size)
+{
+	const char *mailbox = S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_MAILBOX), "");
+	const char *context = S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_CONTEXT), "");
+	size_t mailbox_len = strlen(mailbox) + 1;
+	size_t len = 8 + mailbox_len + strlen(context) + 1;
+
+	if (len > size) {
+		return -1;
+	}
+
+	put_unaligned_uint32(buf, htonl(ast_event_get_ie_uint(event, AST_EVENT_IE_NEWMSGS)));
+	put_unaligned_uint32(buf + 4, htonl(ast_event_get_ie_uint(event, AST_EVENT_IE_OLDMSGS)));
+	memcpy(buf + 8, mailbox, mailbox_len);
+	strcpy((char *) buf + 8 + mailbox_len, context); /* SAFE */
+
+	return len;
+}
+
+/*! \brief Rebuild an MWI event from its compact encoding */
+static struct ast_event *decode_mwi(const unsigned char *buf, size_t len, const struct ast_eid *eid)
+{
+	const char *mailbox = (const char *) buf + 8;
+	const char *context;
+	size_t mailbox_len;
+
+	if (len < 10 || buf[len - 1] != '\0') {
+		return NULL;
+	}
+
+	mailbox_len = strlen(mailbox) + 1;
+	if (8 + mailbox_len >= len) {
+		return NULL;
+	}
+	context = mailbox + mailbox_len;
+
+	return ast_event_new(AST_EVENT_MWI,
+		AST_EVENT_IE_MAILBOX, AST_EVENT_IE_PLTYPE_STR, mailbox,
+		AST_EVENT_IE_CONTEXT, AST_EVENT_IE_PLTYPE_STR, context,
+		AST_EVENT_IE_NEWMSGS, AST_EVENT_IE_PLTYPE_UINT, ntohl(get_unaligned_uint32(buf)),
+		AST_EVENT_IE_OLDMSGS, AST_EVENT_IE_PLTYPE_UINT, ntohl(get_unaligned_uint32(buf + 4)),
+		AST_EVENT_IE_EID, AST_EVENT_IE_PLTYPE_RAW, eid, sizeof(*eid),
+		AST_EVENT_IE_END);
+}
+
+static int batch_key_mwi(struct ast_event *event, struct ast_str **key)
+{
+	return ast_str_set(key, 0, "mwi:%s@%s",
+		S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_MAILBOX), ""),
+		S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_CONTEXT), "")) < 0 ? -1 : 0;
+}
+
+/*!
+ * \brief Write the compact encoding of a device state event
+ *
+ * The state and whether it is cachable as single bytes, followed by the
+ * device as a NUL terminated string.
+ *
+ * \return Bytes written, -1 if they do not fit
+ */
+static int encode_device_state(struct ast_event *event, unsigned char *buf, size_t size)
+{
+	const char *device = S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_DEVICE), "");
+	size_t len = 2 + strlen(device) + 1;
+
+	if (len > size) {
+		return -1;
+	}
+
+	buf[0] = ast_event_get_ie_uint(event, AST_EVENT_IE_STATE);
+	buf[1] = ast_event_get_ie_uint(event, AST_EVENT_IE_CACHABLE);
+	strcpy((char *) buf + 2, device); /* SAFE */
+
+	return len;
+}
+
+/*! \brief Rebuild a device state event from its compact encoding */
+static struct ast_event *decode_device_state(const unsigned char *buf, size_t len, const struct ast_eid *eid)
+{
+	if (len < 3 || buf[len - 1] != '\0') {
+		return NULL;
+	}
+
+	return ast_event_new(AST_EVENT_DEVICE_STATE_CHANGE,
+		AST_EVENT_IE_DEVICE, AST_EVENT_IE_PLTYPE_STR, (const char *) buf + 2,
+		AST_EVENT_IE_STATE, AST_EVENT_IE_PLTYPE_UINT, (unsigned int) buf[0],
+		AST_EVENT_IE_CACHABLE, AST_EVENT_IE_PLTYPE_UINT, (unsigned int) buf[1],
+		AST_EVENT_IE_EID, AST_EVENT_IE_PLTYPE_RAW, eid, sizeof(*eid),
+		AST_EVENT_IE_END);
+}
+
+static int batch_key_device_state(struct ast_event *event, struct ast_str **key)
+{
+	return ast_str_set(key, 0, "device_state:%s",
+		S_OR(ast_event_get_ie_str(event, AST_EVENT_IE_DEVICE), "")) < 0 ? -1 : 0;
+}
+
 static void cpg_deliver_cb(cpg_handle_t handle, const struct cpg_name *group_name,
 		uint32_t nodeid, uint32_t pid, void *msg, size_t msg_len);
 
@@ -481,6 +689,60 @@ static void cfg_shutdown_cb(corosync_cfg_handle_t cfg_handle,
 {
 }
 
+/*! \brief Publish the events of a received batch to \ref stasis */
+static void deliver_batch(const struct corosync_batch_header *batch, size_t len)
+{
+	void (*publish_handler)(struct ast_event *) = NULL;
+	struct ast_event *(* decode)(const unsigned char *, size_t, const struct ast_eid *) = NULL;
+	enum ast_event_type event_type = ntohs(batch->event_type);
+	unsigned int count = ntohs(batch->count);
+	const unsigned char *pos = batch->payload;
+	const unsigned char *end = (const unsigned char *) batch + len;
+
+	if (!ast_eid_cmp(&ast_eid_default, &batch->eid)) {
+		/* Don't feed events back in that originated locally. */
+		return;
+	}
+
+	if (event_type >= ARRAY_LEN(event_types)) {
+		return;
+	}
+
+	/* Each batch holds a single type, so unwanted ones are dropped whole */
+	ast_rwlock_rdlock(&event_types_lock);
+	if (event_types[event_type].subscribe) {
+		publish_handler = event_types[event_type].publish_to_stasis;
+		decode = event_types[event_type].decode;
+	}
+	ast_rwlock_unlock(&event_types_lock);
+
+	if (!publish_handler || !decode) {
+		return;
+	}
+
+	ast_debug(5, "Publishing batch of %u %s events to stasis\n",
+		count, event_types[event_type].name);
+
+	while (count-- && end - pos >= 2) {
+		size_t entry_len = ntohs(get_unaligned_uint16(pos));
+		struct ast_event *event;
+
+		pos += 2;
+		if (entry_len > end - pos) {
+			ast_debug(1, "Ignoring the rest of a truncated batch of %s events\n",
+				event_types[event_type].name);
+			break;
+		}
+
+		event = decode(pos, entry_len, &batch->eid);
+		if (event) {
+			publish_handler(event);
+			ast_event_destroy(event);
+		}
+		pos += entry_len;
+	}
+}
+
 static void cpg_deliver_cb(cpg_handle_t handle, const struct cpg_name *group_name,
 		uint32_t nodeid, uint32_t pid, void *msg, size_t msg_len)
 {
@@ -496,6 +758,12 @@ static void cpg_deliver_cb(cpg_handle_t handle, const struct cpg_name *group_nam
 		return;
 	}
 
+	if (msg_len >= sizeof(struct corosync_batch_header)
+		&& ntohs(((struct corosync_batch_header *) msg)->magic) == COROSYNC_BATCH_MAGIC) {
+		deliver_batch(msg, msg_len);
+		return;
+	}
+
 	event_eid = (struct ast_eid *)ast_event_get_ie_raw(msg, AST_EVENT_IE_EID);
 	if (!event_eid || !ast_eid_cmp(&ast_eid_default, event_eid)) {
 		/* Don't feed events back in that originated locally. */
@@ -568,6 +836,179 @@ static void publish_event_to_corosync(struct ast_event *event)
 	}
 }
 
+/*! \brief Send a batch of events to corosync */
+static void publish_batch_to_corosync(struct corosync_batch_header *batch, size_t len)
+{
+	cs_error_t cs_err;
+	struct iovec iov;
+	enum ast_event_type event_type = ntohs(batch->event_type);
+
+	iov.iov_base = (void *) batch;
+	iov.iov_len = len;
+
+	ast_debug(5, "Publishing batch of %u %s events to corosync\n",
+		ntohs(batch->count), event_types[event_type].name);
+
+	if (corosync_node_joined && !ast_rwlock_tryrdlock(&init_cpg_lock)) {
+		if ((cs_err = cpg_mcast_joined(cpg_handle, CPG_TYPE_FIFO, &iov, 1)) != CS_OK) {
+			ast_log(LOG_WARNING, "CPG mcast failed (%u) for batch of %u %s events\n",
+				cs_err, ntohs(batch->count), event_types[event_type].name);
+		}
+		ast_rwlock_unlock(&init_cpg_lock);
+	} else {
+		ast_log(LOG_WARNING, "CPG mcast not executed for batch of %u %s events: initializing CPG.\n",
+			ntohs(batch->count), event_types[event_type].name);
+	}
+}
+
+AO2_STRING_FIELD_HASH_FN(corosync_pending_event, key);
+AO2_STRING_FIELD_CMP_FN(corosync_pending_event, key);
+
+static void corosync_pending_event_dtor(void *obj)
+{
+	struct corosync_pending_event *pending = obj;
+
+	ast_event_destroy(pending->event);
+}
+
+/*!
+ * \brief Queue an event for the next batch
+ *
+ * An event still waiting for an earlier one about the same entity replaces it,
+ * since only the latest state of each entity needs to reach the cluster.
+ *
+ * \retval 0 The event was queued and is now owned by the batch
+ * \retval -1 The event could not be queued and should be sent on its own
+ */
+static int queue_event_for_batch(struct ast_event *event)
+{
+	enum ast_event_type event_type = ast_event_get_type(event);
+	struct corosync_pending_event *pending;
+	struct ast_str *key;
+
+	if (event_type >= ARRAY_LEN(event_types) || !event_types[event_type].batch_key) {
+		return -1;
+	}
+
+	key = ast_str_create(64);
+	if (!key || event_types[event_type].batch_key(event, &key)) {
+		ast_free(key);
+		return -1;
+	}
+
+	ao2_lock(pending_events);
+	pending = ao2_find(pending_events, ast_str_buffer(key), OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (pending) {
+		ast_event_destroy(pending->event);
+		pending->event = event;
+	} else {
+		pending = ao2_alloc_options(sizeof(*pending) + ast_str_strlen(key) + 1,
+			corosync_pending_event_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!pending) {
+			ao2_unlock(pending_events);
+			ast_free(key);
+			return -1;
+		}
+		strcpy(pending->key, ast_str_buffer(key)); /* SAFE */
+		pending->event = event;
+		ao2_link_flags(pending_events, pending, OBJ_NOLOCK);
+	}
+	ao2_unlock(pending_events);
+
+	ao2_ref(pending, -1);
+	ast_free(key);
+
+	return 0;
+}
+
+/*! \brief A batch being built for one event type */
+struct corosync_batch {
+	struct corosync_batch_header *header;
+	size_t len;
+	unsigned int count;
+};
+
+/*! \brief Send the events queued for batching */
+static void send_pending_events(void)
+{
+	struct corosync_batch batches[ARRAY_LEN(event_types)] = { { NULL, }, };
+	struct corosync_pending_event *pending;
+	struct ao2_iterator *it;
+	unsigned int i;
+
+	it = ao2_callback(pending_events, OBJ_MULTIPLE | OBJ_UNLINK, NULL, NULL);
+	if (!it) {
+		return;
+	}
+
+	while ((pending = ao2_iterator_next(it))) {
+		enum ast_event_type event_type = ast_event_get_type(pending->event);
+		struct corosync_batch *batch = &batches[event_type];
+		int len;
+
+		if (!batch->header) {
+			batch->header = ast_malloc(COROSYNC_BATCH_MAX_SIZE);
+			if (!batch->header) {
+				ao2_ref(pending, -1);
+				continue;
+			}
+			batch->header->magic = htons(COROSYNC_BATCH_MAGIC);
+			batch->header->event_type = htons(event_type);
+			batch->header->eid = ast_eid_default;
+			batch->len = sizeof(*batch->header);
+			batch->count = 0;
+		}
+
+		for (;;) {
+			len = event_types[event_type].encode(pending->event,
+				(unsigned char *) batch->header + batch->len + 2,
+				COROSYNC_BATCH_MAX_SIZE - batch->len - 2);
+			if (len >= 0 || !batch->count) {
+				break;
+			}
+
+			/* Full, send what we have and start over */
+			batch->header->count = htons(batch->count);
+			publish_batch_to_corosync(batch->header, batch->len);
+			batch->len = sizeof(*batch->header);
+			batch->count = 0;
+		}
+
+		if (len < 0 || len > UINT16_MAX) {
+			ast_log(LOG_WARNING, "Dropping %s event too large to send to corosync\n",
+				event_types[event_type].name);
+		} else {
+			put_unaligned_uint16((unsigned char *) batch->header + batch->len, htons(len));
+			batch->len += 2 + len;
+			batch->count++;
+			if (batch->count == UINT16_MAX) {
+				batch->header->count = htons(batch->count);
+				publish_batch_to_corosync(batch->header, batch->len);
+				batch->len = sizeof(*batch->header);
+				batch->count = 0;
+			}
+		}
+
+		ao2_ref(pending, -1);
+	}
+	ao2_iterator_destroy(it);
+
+	for (i = 0; i < ARRAY_LEN(batches); i++) {
+		if (batches[i].count) {
+			batches[i].header->count = htons(batches[i].count);
+			publish_batch_to_corosync(batches[i].header, batches[i].len);
+		}
+		ast_free(batches[i].header);
+	}
+}
+
+static int send_pending_events_cb(const void *data)
+{
+	send_pending_events();
+
+	return batch_interval;
+}
+
 static void publish_to_corosync(struct stasis_message *message)
 {
 	struct ast_event *event;
@@ -594,6 +1035,10 @@ static void publish_to_corosync(struct stasis_message *message)
 		ast_log(LOG_NOTICE, "Sending event PING from this server with EID: '%s'\n", buf);
 	}
 
+	if (batch_interval && !queue_event_for_batch(event)) {
+		return;
+	}
+
 	publish_event_to_corosync(event);
 	ast_event_destroy(event);
 }
@@ -731,6 +1176,17 @@ static void cpg_confchg_cb(cpg_handle_t handle, const struct cpg_name *group_nam
 
 		ao2_t_ref(messages, -1, "Dispose of dumped cache");
 	}
+
+	/* The database has no cache, so send every key of the published families */
+	ast_rwlock_rdlock(&event_types_lock);
+	if (event_types[AST_EVENT_DB_CHANGE].publish) {
+		for (i = 0; i < AST_VECTOR_SIZE(&db_families); i++) {
+			ast_log(LOG_NOTICE, "Sending database family %s to corosync.\n",
+				AST_VECTOR_GET(&db_families, i));
+			ast_db_family_announce(AST_VECTOR_GET(&db_families, i));
+		}
+	}
+	ast_rwlock_unlock(&event_types_lock);
 }
 
 /*! \brief Informs the cluster of our EID and our IP addresses */
@@ -1117,6 +1573,16 @@ static char *corosync_show_config(struct ast_cli_entry *e, int cmd, struct ast_c
 	            "=============================================================\n"
 	            "===\n");
 
+	if (batch_interval) {
+		ast_cli(a->fd, "=== ==> Batching events every %u ms\n", batch_interval);
+	}
+
+	ast_rwlock_rdlock(&event_types_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&db_families); i++) {
+		ast_cli(a->fd, "=== ==> Database Family: %s\n", AST_VECTOR_GET(&db_families, i));
+	}
+	ast_rwlock_unlock(&event_types_lock);
+
 	ast_rwlock_rdlock(&event_types_lock);
 	ast_debug(5, "corosync_show_config rdlock\n");
 	for (i = 0; i < ARRAY_LEN(event_types); i++) {
@@ -1174,6 +1640,21 @@ static int set_event(const char *event_type, int pubsub)
 	return (i == ARRAY_LEN(event_types)) ? -1 : 0;
 }
 
+/*!
+ * \brief Stop publishing the changes to the configured database families
+ * \note Called with event_types_lock write locked
+ */
+static void db_families_reset(void)
+{
+	char *family;
+
+	while (AST_VECTOR_SIZE(&db_families)) {
+		family = AST_VECTOR_REMOVE_UNORDERED(&db_families, 0);
+		ast_db_family_publish(family, 0);
+		ast_free(family);
+	}
+}
+
 static int load_general_config(struct ast_config *cfg)
 {
 	struct ast_variable *v;
@@ -1187,12 +1668,26 @@ static int load_general_config(struct ast_config *cfg)
 		event_types[i].publish = event_types[i].publish_default;
 		event_types[i].subscribe = event_types[i].subscribe_default;
 	}
+	batch_interval = 0;
+	db_families_reset();
 
 	for (v = ast_variable_browse(cfg, "general"); v && !res; v = v->next) {
 		if (!strcasecmp(v->name, "publish_event")) {
 			res = set_event(v->value, PUBLISH);
 		} else if (!strcasecmp(v->name, "subscribe_event")) {
 			res = set_event(v->value, SUBSCRIBE);
+		} else if (!strcasecmp(v->name, "batch_interval")) {
+			if (sscanf(v->value, "%30u", &batch_interval) != 1) {
+				ast_log(LOG_WARNING, "Invalid batch_interval '%s', events will not be batched\n", v->value);
+				batch_interval = 0;
+			}
+		} else if (!strcasecmp(v->name, "db_family")) {
+			char *family = ast_strdup(v->value);
+
+			if (!family || AST_VECTOR_APPEND(&db_families, family)) {
+				ast_free(family);
+				res = -1;
+			}
 		} else {
 			ast_log(LOG_WARNING, "Unknown option '%s'\n", v->name);
 		}
@@ -1213,9 +1708,22 @@ static int load_general_config(struct ast_config *cfg)
 		}
 	}
 
+	if (event_types[AST_EVENT_DB_CHANGE].publish) {
+		for (i = 0; i < AST_VECTOR_SIZE(&db_families); i++) {
+			ast_db_family_publish(AST_VECTOR_GET(&db_families, i), 1);
+		}
+	}
+
 	ast_rwlock_unlock(&event_types_lock);
 	ast_debug(5, "load_general_config unlock\n");
 
+	/* Restart batching at the new interval, sending what was held for the old one */
+	AST_SCHED_DEL(batch_sched, batch_sched_id);
+	send_pending_events();
+	if (batch_interval) {
+		batch_sched_id = ast_sched_add(batch_sched, batch_interval, send_pending_events_cb, NULL);
+	}
+
 	return res;
 }
 
@@ -1286,11 +1794,29 @@ static void cleanup_module(void)
 		stasis_router = NULL;
 	}
 
+	ast_rwlock_wrlock(&event_types_lock);
+	db_families_reset();
+	AST_VECTOR_FREE(&db_families);
+	ast_rwlock_unlock(&event_types_lock);
+
 	if (corosync_aggregate_topic) {
 		ao2_t_ref(corosync_aggregate_topic, -1, "Dispose of topic on cleanup");
 		corosync_aggregate_topic = NULL;
 	}
 
+	if (batch_sched) {
+		ast_sched_context_destroy(batch_sched);
+		batch_sched = NULL;
+		batch_sched_id = -1;
+	}
+
+	/* Whatever is still waiting goes out before we leave the group */
+	if (pending_events) {
+		send_pending_events();
+		ao2_ref(pending_events, -1);
+		pending_events = NULL;
+	}
+
 	STASIS_MESSAGE_TYPE_CLEANUP(corosync_ping_message_type);
 
 	if (dispatch_thread.id != AST_PTHREADT_NULL) {
@@ -1349,6 +1875,18 @@ static int load_module(void)
 		goto failed;
 	}
 
+	pending_events = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		COROSYNC_BATCH_BUCKETS, corosync_pending_event_hash_fn, NULL, corosync_pending_event_cmp_fn);
+	if (!pending_events) {
+		goto failed;
+	}
+
+	batch_sched = ast_sched_context_create();
+	if (!batch_sched || ast_sched_start_thread(batch_sched)) {
+		ast_log(AST_LOG_ERROR, "Failed to start the corosync batch scheduler\n");
+		goto failed;
+	}
+
 	corosync_aggregate_topic = stasis_topic_create("corosync:aggregator");
 	if (!corosync_aggregate_topic) {
 		ast_log(AST_LOG_ERROR, "Failed to create stasis topic for corosync\n");
@@ -44,10 +44,380 @@
 
 #include <curl/curl.h>
 
+#include "asterisk/astobj2.h"
+#include "asterisk/cli.h"
+#include "asterisk/config.h"
+#include "asterisk/linkedlists.h"
+#include "asterisk/lock.h"
 #include "asterisk/module.h"
+#include "asterisk/res_curl.h"
+#include "asterisk/utils.h"
+
+/*! \brief Number of buckets in the container of per host statistics */
+#define HOST_BUCKETS 53
+
+/*! \brief A transfer handed to the transfer thread */
+struct curl_transfer {
+	CURL *curl;
+	CURLcode result;
+	/*! Signalled when the transfer is complete */
+	ast_cond_t cond;
+	/*! The transfer is complete */
+	unsigned int done:1;
+	AST_LIST_ENTRY(curl_transfer) list;
+};
+
+/*! \brief Statistics of the transfers to a host */
+struct curl_host {
+	/*! Transfers completed */
+	unsigned int transfers;
+	/*! Transfers that failed */
+	unsigned int failures;
+	/*! New connections made, the other transfers reused one */
+	unsigned int connects;
+	/*! Total time of the transfers, in milliseconds */
+	double total_ms;
+	/*! Host and port */
+	char name[0];
+};
+
+/*! Protects transfers_pending, the pool settings and every transfer's completion */
+AST_MUTEX_DEFINE_STATIC(transfers_lock);
+/*! Transfers queued but not yet picked up by the transfer thread */
+static AST_LIST_HEAD_NOLOCK_STATIC(transfers_pending, curl_transfer);
+/*!
+ * Runs the transfers of every module, so connections to a server are
+ * kept open and reused by all of them
+ */
+static CURLM *transfers_multi;
+static pthread_t transfers_thread = AST_PTHREADT_NULL;
+static int transfers_stop;
+
+/*! Maximum number of connections to one host, 0 for no limit */
+static long max_host_connections;
+/*! Maximum number of connections, 0 for no limit */
+static long max_total_connections;
+/*! Maximum number of idle connections kept open, 0 for the libcurl default */
+static long max_idle_connections;
+/*! Set when the settings above changed and the multi handle must be updated */
+static int settings_changed;
+
+/*! Transfers in progress */
+static int transfers_active;
+/*! Most transfers in progress at once */
+static int transfers_peak;
+
+/*! Statistics per host */
+static struct ao2_container *curl_hosts;
+
+AO2_STRING_FIELD_CASE_HASH_FN(curl_host, name);
+AO2_STRING_FIELD_CASE_CMP_FN(curl_host, name);
+
+/*!
+ * \internal
+ * \brief Get the host and port part of a URL
+ */
+static void curl_url_host(const char *url, char *host, size_t len)
+{
+	const char *start = strstr(url, "://");
+	const char *end;
+	const char *at;
+
+	start = start ? start + 3 : url;
+	end = start + strcspn(start, "/?#");
+
+	/* Skip any user information */
+	at = memchr(start, '@', end - start);
+	if (at) {
+		start = at + 1;
+	}
+
+	ast_copy_string(host, start, MIN(len, end - start + 1));
+}
+
+static void curl_host_update(CURL *curl, CURLcode result)
+{
+	struct curl_host *host;
+	char name[256];
+	char *url = NULL;
+	long connects = 0;
+	double total = 0;
+
+	curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+	if (ast_strlen_zero(url)) {
+		return;
+	}
+	curl_url_host(url, name, sizeof(name));
+	curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
+
+	ao2_lock(curl_hosts);
+	host = ao2_find(curl_hosts, name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!host) {
+		host = ao2_alloc_options(sizeof(*host) + strlen(name) + 1, NULL,
+			AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!host) {
+			ao2_unlock(curl_hosts);
+			return;
+		}
+		strcpy(host->name, name); /* Safe */
+		ao2_link_flags(curl_hosts, host, OBJ_NOLOCK);
+	}
+	host->transfers++;
+	host->connects += connects;
+	host->total_ms += total * 1000.0;
+	if (result != CURLE_OK) {
+		host->failures++;
+	}
+	ao2_unlock(curl_hosts);
+	ao2_ref(host, -1);
+}
+
+static void transfer_complete(struct curl_transfer *transfer, CURLcode result)
+{
+	ast_mutex_lock(&transfers_lock);
+	transfer->result = result;
+	transfer->done = 1;
+	ast_cond_signal(&transfer->cond);
+	ast_mutex_unlock(&transfers_lock);
+}
+
+/*!
+ * \internal
+ * \brief Apply the pool settings to the multi handle
+ *
+ * \note Called with transfers_lock held, from the transfer thread, as the
+ * multi handle must only be used from one thread.
+ */
+static void transfers_apply_settings(void)
+{
+	curl_multi_setopt(transfers_multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections);
+	curl_multi_setopt(transfers_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, max_total_connections);
+	if (max_idle_connections) {
+		curl_multi_setopt(transfers_multi, CURLMOPT_MAXCONNECTS, max_idle_connections);
+	}
+	settings_changed = 0;
+}
+
+static void *transfers_thread_run(void *data)
+{
+	AST_LIST_HEAD_NOLOCK(, curl_transfer) active = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
+	struct curl_transfer *transfer;
+
+	while (!transfers_stop) {
+		struct CURLMsg *msg;
+		int running;
+		int left;
+
+		ast_mutex_lock(&transfers_lock);
+		if (settings_changed) {
+			transfers_apply_settings();
+		}
+		while ((transfer = AST_LIST_REMOVE_HEAD(&transfers_pending, list))) {
+			if (curl_multi_add_handle(transfers_multi, transfer->curl) != CURLM_OK) {
+				transfer->result = CURLE_FAILED_INIT;
+				transfer->done = 1;
+				ast_cond_signal(&transfer->cond);
+				continue;
+			}
+			AST_LIST_INSERT_TAIL(&active, transfer, list);
+			if (++transfers_active > transfers_peak) {
+				transfers_peak = transfers_active;
+			}
+		}
+		ast_mutex_unlock(&transfers_lock);
+
+		curl_multi_perform(transfers_multi, &running);
+
+		while ((msg = curl_multi_info_read(transfers_multi, &left))) {
+			CURLcode result;
+
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			result = msg->data.result;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &transfer);
+			curl_multi_remove_handle(transfers_multi, transfer->curl);
+			AST_LIST_REMOVE(&active, transfer, list);
+			ast_atomic_fetchadd_int(&transfers_active, -1);
+			curl_host_update(transfer->curl, result);
+			/* The transfer belongs to its waiting thread from here on */
+			transfer_complete(transfer, result);
+		}
+
+		curl_multi_poll(transfers_multi, NULL, 0, 1000, NULL);
+	}
+
+	/* Fail whatever is left so no thread keeps waiting */
+	while ((transfer = AST_LIST_REMOVE_HEAD(&active, list))) {
+		curl_multi_remove_handle(transfers_multi, transfer->curl);
+		ast_atomic_fetchadd_int(&transfers_active, -1);
+		transfer_complete(transfer, CURLE_ABORTED_BY_CALLBACK);
+	}
+	ast_mutex_lock(&transfers_lock);
+	while ((transfer = AST_LIST_REMOVE_HEAD(&transfers_pending, list))) {
+		transfer->result = CURLE_ABORTED_BY_CALLBACK;
+		transfer->done = 1;
+		ast_cond_signal(&transfer->cond);
+	}
+	ast_mutex_unlock(&transfers_lock);
+
+	return NULL;
+}
+
+CURLcode ast_curl_perform(CURL *curl)
+{
+	struct curl_transfer transfer = {
+		.curl = curl,
+	};
+
+	if (transfers_thread == AST_PTHREADT_NULL) {
+		return curl_easy_perform(curl);
+	}
+
+	ast_cond_init(&transfer.cond, NULL);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfer);
+
+	ast_mutex_lock(&transfers_lock);
+	AST_LIST_INSERT_TAIL(&transfers_pending, &transfer, list);
+	curl_multi_wakeup(transfers_multi);
+	while (!transfer.done) {
+		ast_cond_wait(&transfer.cond, &transfers_lock);
+	}
+	ast_mutex_unlock(&transfers_lock);
+
+	ast_cond_destroy(&transfer.cond);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, NULL);
+
+	return transfer.result;
+}
+
+static int curl_host_print(void *obj, void *arg, int flags)
+{
+	struct curl_host *host = obj;
+	int fd = *(int *) arg;
+
+	ast_cli(fd, "%-40.40s %10u %10u %10u %10.1f\n", host->name, host->transfers,
+		host->connects, host->failures,
+		host->transfers ? host->total_ms / host->transfers : 0.0);
+
+	return 0;
+}
+
+static char *handle_curl_show_pool(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	int fd = a->fd;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "curl show pool";
+		e->usage =
+			"Usage: curl show pool\n"
+			"       Show the shared cURL connection pool and the transfers made\n"
+			"       to each host.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_mutex_lock(&transfers_lock);
+	ast_cli(a->fd, "Max host connections:  %ld\n", max_host_connections);
+	ast_cli(a->fd, "Max total connections: %ld\n", max_total_connections);
+	ast_cli(a->fd, "Max idle connections:  %ld\n", max_idle_connections);
+	ast_mutex_unlock(&transfers_lock);
+	ast_cli(a->fd, "Active transfers:      %d (peak %d)\n\n", transfers_active, transfers_peak);
+
+	ast_cli(a->fd, "%-40.40s %10s %10s %10s %10s\n", "Host", "Transfers", "Connects",
+		"Failures", "Avg ms");
+	ao2_lock(curl_hosts);
+	ao2_callback(curl_hosts, OBJ_NODATA | OBJ_NOLOCK, curl_host_print, &fd);
+	ao2_unlock(curl_hosts);
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_curl[] = {
+	AST_CLI_DEFINE(handle_curl_show_pool, "Show the shared cURL connection pool"),
+};
+
+static void load_config(int reload)
+{
+	struct ast_flags flags = { reload ? CONFIG_FLAG_FILEUNCHANGED : 0 };
+	struct ast_config *cfg;
+	struct ast_variable *var;
+	long host = 0, total = 0, idle = 0;
+
+	cfg = ast_config_load("res_curl.conf", flags);
+	if (cfg == CONFIG_STATUS_FILEUNCHANGED) {
+		return;
+	} else if (cfg == CONFIG_STATUS_FILEINVALID) {
+		ast_log(LOG_WARNING, "res_curl.conf could not be parsed!\n");
+		return;
+	}
+
+	if (cfg) {
+		for (var = ast_variable_browse(cfg, "pool"); var; var = var->next) {
+			long *value;
+
+			if (!strcasecmp(var->name, "max_host_connections")) {
+				value = &host;
+			} else if (!strcasecmp(var->name, "max_total_connections")) {
+				value = &total;
+			} else if (!strcasecmp(var->name, "max_idle_connections")) {
+				value = &idle;
+			} else {
+				ast_log(LOG_WARNING, "Unknown option '%s' in [pool] of res_curl.conf\n", var->name);
+				continue;
+			}
+			if (sscanf(var->value, "%30ld", value) != 1 || *value < 0) {
+				ast_log(LOG_WARNING, "Invalid value '%s' for '%s' in res_curl.conf\n",
+					var->value, var->name);
+				*value = 0;
+			}
+		}
+		ast_config_destroy(cfg);
+	}
+
+	ast_mutex_lock(&transfers_lock);
+	max_host_connections = host;
+	max_total_connections = total;
+	max_idle_connections = idle;
+	settings_changed = 1;
+	if (transfers_multi) {
+		curl_multi_wakeup(transfers_multi);
+	}
+	ast_mutex_unlock(&transfers_lock);
+}
+
+static int reload_module(void)
+{
+	load_config(1);
+
+	return 0;
+}
 
 static int unload_module(void)
 {
+	ast_cli_unregister_multiple(cli_curl, ARRAY_LEN(cli_curl));
+
+	if (transfers_thread != AST_PTHREADT_NULL) {
+		transfers_stop = 1;
+		curl_multi_wakeup(transfers_multi);
+		pthread_join(transfers_thread, NULL);
+		transfers_thread = AST_PTHREADT_NULL;
+	}
+	if (transfers_multi) {
+		curl_multi_cleanup(transfers_multi);
+		transfers_multi = NULL;
+	}
+
+	ao2_cleanup(curl_hosts);
+	curl_hosts = NULL;
+
 	curl_global_cleanup();
 
 	return 0;
@@ -62,12 +432,40 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	curl_hosts = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, HOST_BUCKETS,
+		curl_host_hash_fn, NULL, curl_host_cmp_fn);
+	if (!curl_hosts) {
+		curl_global_cleanup();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	load_config(0);
+
+	transfers_stop = 0;
+	if (!(transfers_multi = curl_multi_init())) {
+		ast_log(LOG_ERROR, "Unable to create the cURL connection pool\n");
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+#ifdef CURLPIPE_MULTIPLEX
+	curl_multi_setopt(transfers_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+	if (ast_pthread_create_background(&transfers_thread, NULL, transfers_thread_run, NULL)) {
+		ast_log(LOG_ERROR, "Unable to start the cURL transfer thread\n");
+		transfers_thread = AST_PTHREADT_NULL;
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	ast_cli_register_multiple(cli_curl, ARRAY_LEN(cli_curl));
+
 	return res;
 }
 
-AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_LOAD_ORDER, "cURL Resource Module",
+AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_GLOBAL_SYMBOLS | AST_MODFLAG_LOAD_ORDER, "cURL Resource Module",
 	.support_level = AST_MODULE_SUPPORT_CORE,
 	.load = load_module,
 	.unload = unload_module,
+	.reload = reload_module,
 	.load_pri = AST_MODPRI_REALTIME_DEPEND,
 );
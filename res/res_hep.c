@@ -37,6 +37,7 @@
  */
 
 /*** MODULEINFO
+	<use type="external">zlib</use>
 	<support_level>extended</support_level>
  ***/
 
@@ -78,6 +79,35 @@
 				<configOption name="capture_id" default="0">
 					<synopsis>The ID for this capture agent.</synopsis>
 				</configOption>
+				<configOption name="capture_transport" default="udp">
+					<synopsis>The transport used to send packets to Homer.</synopsis>
+					<description>
+						<enumlist>
+							<enum name="udp"><para>Send every HEP packet as its own datagram.
+							Packets queued together are handed to the kernel with a single
+							system call where supported.</para></enum>
+							<enum name="tcp"><para>Send HEP packets back to back over a TCP
+							connection to the capture server, writing packets queued together
+							with a single system call. The connection is established when the
+							first packet is sent and re-established if it fails.</para></enum>
+						</enumlist>
+					</description>
+				</configOption>
+				<configOption name="capture_compress" default="no">
+					<synopsis>Compress captured payloads before sending them.</synopsis>
+					<description><para>If enabled, payloads are compressed with zlib and
+					sent in a compressed payload chunk when that makes them smaller. The
+					capture server must support compressed payloads. This option requires
+					Asterisk to be built with zlib.</para>
+					</description>
+				</configOption>
+				<configOption name="queue_limit" default="10000">
+					<synopsis>The maximum number of packets waiting to be sent.</synopsis>
+					<description><para>Packets captured while this many packets are already
+					waiting to be sent are dropped and counted. A value of 0 lets the
+					queue grow without bound.</para>
+					</description>
+				</configOption>
 			</configObject>
 		</configFile>
 	</configInfo>
@@ -89,6 +119,7 @@
 #include "asterisk/astobj2.h"
 #include "asterisk/config_options.h"
 #include "asterisk/taskprocessor.h"
+#include "asterisk/cli.h"
 #include "asterisk/res_hep.h"
 
 #include <netinet/ip.h>
@@ -96,6 +127,27 @@
 #include <netinet/udp.h>
 #include <netinet/ip6.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined(MSG_WAITFORONE)
+/*! sendmmsg() is available to send queued datagrams together */
+#define HAVE_HEP_BATCH
+#endif
+
+/*! Maximum number of packets sent together */
+#define HEP_BATCH_MAX 32
+
+/*! Number of queued octets after which the pending packets are sent */
+#define HEP_BATCH_BYTES 65536
+
+/*! Minimum number of seconds between attempts to connect to a TCP capture server */
+#define HEP_TCP_RETRY_INTERVAL 5
+
+/*! Default maximum number of packets waiting to be sent */
+#define DEFAULT_QUEUE_LIMIT 10000
+
 /*! Generic vendor ID. Used for HEPv3 standard packets */
 #define GENERIC_VENDOR_ID 0x0000
 
@@ -232,11 +284,20 @@ struct hep_generic {
 	struct hep_chunk_uint32 capt_id;
 } __attribute__((packed));
 
+/*! \brief Transports for sending packets to the capture server */
+enum hep_transport {
+	HEP_TRANSPORT_UDP,
+	HEP_TRANSPORT_TCP,
+};
+
 /*! \brief Global configuration for the module */
 struct hepv3_global_config {
 	unsigned int enabled;                    /*!< Whether or not sending is enabled */
 	unsigned int capture_id;                 /*!< Capture ID for this agent */
+	unsigned int capture_compress;           /*!< Whether or not payloads are compressed */
+	unsigned int queue_limit;                /*!< Maximum number of queued packets, 0 for no limit */
 	enum hep_uuid_type uuid_type;            /*!< The preferred type of the UUID */
+	enum hep_transport transport;            /*!< The transport to the capture server */
 	AST_DECLARE_STRING_FIELDS(
 		AST_STRING_FIELD(capture_address);   /*!< Address to send to */
 		AST_STRING_FIELD(capture_password);  /*!< Password for Homer server */
@@ -252,8 +313,38 @@ struct module_config {
 struct hepv3_runtime_data {
 	struct ast_sockaddr remote_addr;  /*!< The address to send to */
 	int sockfd;                       /*!< The socket file descriptor */
+	enum hep_transport transport;     /*!< The transport to the capture server */
+	time_t last_connect;              /*!< When we last tried to connect a TCP socket */
+};
+
+/*!
+ * \brief HEP packets built but not sent yet
+ *
+ * Only used from the \ref hep_queue_tp taskprocessor.
+ */
+struct hep_batch {
+	unsigned char *buf;               /*!< The packets, back to back */
+	size_t len;                       /*!< Number of octets used in buf */
+	size_t alloc;                     /*!< Size of buf */
+	size_t ends[HEP_BATCH_MAX];       /*!< Offset just past each packet in buf */
+	unsigned int count;               /*!< Number of packets in buf */
+#ifdef HAVE_ZLIB
+	unsigned char *zbuf;              /*!< Scratch space for compressed payloads */
+	uLongf zalloc;                    /*!< Size of zbuf */
+#endif
 };
 
+static struct hep_batch hep_batch;
+
+/*! \brief Number of packets handed to the kernel */
+static int hep_sent_packets;
+/*! \brief Number of packets dropped because the queue was full */
+static int hep_dropped_packets;
+/*! \brief Number of packets that could not be sent */
+static int hep_failed_packets;
+/*! \brief Whether we have warned about the queue being full since it last drained */
+static int hep_queue_full;
+
 static struct aco_type global_option = {
 	.type = ACO_GLOBAL,
 	.name = "general",
@@ -356,6 +447,25 @@ static int uuid_type_handler(const struct aco_option *opt, struct ast_variable *
 	return 0;
 }
 
+/*! \brief Handler for the capture_transport attribute */
+static int transport_handler(const struct aco_option *opt, struct ast_variable *var, void *obj)
+{
+	struct hepv3_global_config *global_config = obj;
+
+	if (strcasecmp(var->name, "capture_transport")) {
+		return -1;
+	}
+
+	if (!strcasecmp(var->value, "udp")) {
+		global_config->transport = HEP_TRANSPORT_UDP;
+	} else if (!strcasecmp(var->value, "tcp")) {
+		global_config->transport = HEP_TRANSPORT_TCP;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
 /*! \brief HEPv3 run-time data destructor */
 static void hepv3_data_dtor(void *obj)
 {
@@ -378,6 +488,7 @@ static struct hepv3_runtime_data *hepv3_data_alloc(struct hepv3_global_config *c
 	}
 
 	data->sockfd = -1;
+	data->transport = config->transport;
 
 	if (ast_sockaddr_resolve_first_af(&data->remote_addr, config->capture_address, PARSE_PORT_REQUIRE, AST_AF_UNSPEC)) {
 		ast_log(AST_LOG_WARNING, "Failed to create address from %s\n", config->capture_address);
@@ -386,6 +497,11 @@ static struct hepv3_runtime_data *hepv3_data_alloc(struct hepv3_global_config *c
 
 	}
 
+	if (data->transport == HEP_TRANSPORT_TCP) {
+		/* The connection is made from the taskprocessor when there is something to send */
+		return data;
+	}
+
 	data->sockfd = socket(ast_sockaddr_is_ipv6(&data->remote_addr) ? AF_INET6 : AF_INET, SOCK_DGRAM, 0);
 	if (data->sockfd < 0) {
 		ast_log(AST_LOG_WARNING, "Failed to create socket for address %s: %s\n",
@@ -448,6 +564,201 @@ struct hepv3_capture_info *hepv3_create_capture_info(const void *payload, size_t
 	return info;
 }
 
+/*!
+ * \brief Make room for another packet in the pending batch
+ *
+ * \retval A pointer to where the packet should be written
+ * \retval NULL on failure
+ */
+static unsigned char *hep_batch_reserve(size_t len)
+{
+	unsigned char *buf;
+	size_t alloc;
+
+	if (hep_batch.len + len > hep_batch.alloc) {
+		alloc = MAX(hep_batch.len + len, HEP_BATCH_BYTES);
+		buf = ast_realloc(hep_batch.buf, alloc);
+		if (!buf) {
+			return NULL;
+		}
+		hep_batch.buf = buf;
+		hep_batch.alloc = alloc;
+	}
+
+	return hep_batch.buf + hep_batch.len;
+}
+
+/*!
+ * \brief Connect the TCP socket to the capture server
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int hep_tcp_connect(struct hepv3_runtime_data *data)
+{
+	time_t now = time(NULL);
+
+	if (now - data->last_connect < HEP_TCP_RETRY_INTERVAL) {
+		return -1;
+	}
+	data->last_connect = now;
+
+	data->sockfd = socket(ast_sockaddr_is_ipv6(&data->remote_addr) ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+	if (data->sockfd < 0) {
+		ast_log(AST_LOG_WARNING, "Failed to create socket for HEPv3 server %s: %s\n",
+			ast_sockaddr_stringify(&data->remote_addr), strerror(errno));
+		return -1;
+	}
+
+	if (ast_connect(data->sockfd, &data->remote_addr)) {
+		ast_log(AST_LOG_WARNING, "Failed to connect to HEPv3 server %s: %s\n",
+			ast_sockaddr_stringify(&data->remote_addr), strerror(errno));
+		close(data->sockfd);
+		data->sockfd = -1;
+		return -1;
+	}
+
+	ast_debug(1, "Connected to HEPv3 server %s\n", ast_sockaddr_stringify(&data->remote_addr));
+	return 0;
+}
+
+/*!
+ * \brief Write the pending batch to the TCP capture server
+ *
+ * \retval Number of packets sent
+ */
+static unsigned int hep_batch_send_tcp(struct hepv3_runtime_data *data)
+{
+	size_t sent = 0;
+	ssize_t res;
+
+	if (data->sockfd < 0 && hep_tcp_connect(data)) {
+		return 0;
+	}
+
+	while (sent < hep_batch.len) {
+		res = send(data->sockfd, hep_batch.buf + sent, hep_batch.len - sent, MSG_NOSIGNAL);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ast_log(AST_LOG_ERROR, "Error [%d] while sending packets to HEPv3 server: %s\n",
+				errno, strerror(errno));
+			/* A partial packet cannot be recovered from, start over on a new connection */
+			close(data->sockfd);
+			data->sockfd = -1;
+			return 0;
+		}
+		sent += res;
+	}
+
+	return hep_batch.count;
+}
+
+/*!
+ * \brief Send the pending batch to the UDP capture server
+ *
+ * \retval Number of packets sent
+ */
+static unsigned int hep_batch_send_udp(struct hepv3_runtime_data *data)
+{
+	unsigned int sent = 0;
+	unsigned int i;
+	size_t start;
+#ifdef HAVE_HEP_BATCH
+	struct mmsghdr msgs[HEP_BATCH_MAX];
+	struct iovec iov[HEP_BATCH_MAX];
+	int res;
+
+	memset(msgs, 0, sizeof(msgs[0]) * hep_batch.count);
+	for (i = 0, start = 0; i < hep_batch.count; start = hep_batch.ends[i++]) {
+		iov[i].iov_base = hep_batch.buf + start;
+		iov[i].iov_len = hep_batch.ends[i] - start;
+		msgs[i].msg_hdr.msg_name = &data->remote_addr.ss;
+		msgs[i].msg_hdr.msg_namelen = data->remote_addr.len;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (i = 0; i < hep_batch.count; i += res) {
+		res = sendmmsg(data->sockfd, &msgs[i], hep_batch.count - i, 0);
+		if (res <= 0) {
+			ast_log(AST_LOG_ERROR, "Error [%d] while sending packet to HEPv3 server: %s\n",
+				errno, strerror(errno));
+			/* Only the first packet failed, carry on with the rest */
+			res = 1;
+		} else {
+			sent += res;
+		}
+	}
+#else
+	ssize_t res;
+
+	for (i = 0, start = 0; i < hep_batch.count; start = hep_batch.ends[i++]) {
+		res = ast_sendto(data->sockfd, hep_batch.buf + start, hep_batch.ends[i] - start, 0, &data->remote_addr);
+		if (res < 0) {
+			ast_log(AST_LOG_ERROR, "Error [%d] while sending packet to HEPv3 server: %s\n",
+				errno, strerror(errno));
+		} else {
+			sent++;
+		}
+	}
+#endif
+
+	return sent;
+}
+
+/*! \brief Send the packets built by the taskprocessor so far */
+static void hep_batch_flush(struct hepv3_runtime_data *data)
+{
+	unsigned int sent;
+
+	if (!hep_batch.count) {
+		return;
+	}
+
+	if (data->transport == HEP_TRANSPORT_TCP) {
+		sent = hep_batch_send_tcp(data);
+	} else {
+		sent = hep_batch_send_udp(data);
+	}
+
+	ast_atomic_fetchadd_int(&hep_sent_packets, sent);
+	ast_atomic_fetchadd_int(&hep_failed_packets, hep_batch.count - sent);
+
+	hep_batch.count = 0;
+	hep_batch.len = 0;
+}
+
+#ifdef HAVE_ZLIB
+/*!
+ * \brief Compress a payload into the batch scratch space
+ *
+ * \retval Size of the compressed payload
+ * \retval 0 if the payload could not be made smaller
+ */
+static size_t hep_compress_payload(const void *payload, size_t len)
+{
+	uLongf zlen = compressBound(len);
+	unsigned char *zbuf;
+
+	if (zlen > hep_batch.zalloc) {
+		zbuf = ast_realloc(hep_batch.zbuf, zlen);
+		if (!zbuf) {
+			return 0;
+		}
+		hep_batch.zbuf = zbuf;
+		hep_batch.zalloc = zlen;
+	}
+
+	if (compress(hep_batch.zbuf, &zlen, payload, len) != Z_OK || zlen >= len) {
+		return 0;
+	}
+
+	return zlen;
+}
+#endif
+
 /*! \brief Callback function for the \ref hep_queue_tp taskprocessor */
 static int hep_queue_cb(void *data)
 {
@@ -459,8 +770,15 @@ static int hep_queue_cb(void *data)
 	struct hep_chunk_ip4 ipv4_src, ipv4_dst;
 	struct hep_chunk_ip6 ipv6_src, ipv6_dst;
 	struct hep_chunk auth_key, payload, uuid;
-	void *sock_buffer;
-	int res;
+	const void *payload_data = capture_info ? capture_info->payload : NULL;
+	size_t payload_len = capture_info ? capture_info->len : 0;
+	int zipped = capture_info ? capture_info->zipped : 0;
+	unsigned char *sock_buffer;
+	int res = 0;
+
+	if (!ast_taskprocessor_size(hep_queue_tp)) {
+		hep_queue_full = 0;
+	}
 
 	if (!capture_info || !config || !hepv3_data) {
 		return 0;
@@ -468,9 +786,22 @@ static int hep_queue_cb(void *data)
 
 	if (ast_sockaddr_is_ipv4(&capture_info->src_addr) != ast_sockaddr_is_ipv4(&capture_info->dst_addr)) {
 		ast_log(AST_LOG_NOTICE, "Unable to send packet: Address Family mismatch between source/destination\n");
-		return -1;
+		res = -1;
+		goto flush;
 	}
 
+#ifdef HAVE_ZLIB
+	if (config->general->capture_compress && !zipped) {
+		size_t zlen = hep_compress_payload(payload_data, payload_len);
+
+		if (zlen) {
+			payload_data = hep_batch.zbuf;
+			payload_len = zlen;
+			zipped = 1;
+		}
+	}
+#endif
+
 	packet_len = sizeof(hg_pkt);
 
 	/* Build HEPv3 header, capture info, and calculate the total packet size */
@@ -515,14 +846,16 @@ static int hep_queue_cb(void *data)
 	INITIALIZE_GENERIC_HEP_IDS_VAR(&uuid, CHUNK_TYPE_UUID, strlen(capture_info->uuid));
 	packet_len += (sizeof(uuid) + strlen(capture_info->uuid));
 	INITIALIZE_GENERIC_HEP_IDS_VAR(&payload,
-		capture_info->zipped ? CHUNK_TYPE_PAYLOAD_ZIP : CHUNK_TYPE_PAYLOAD, capture_info->len);
-	packet_len += (sizeof(payload) + capture_info->len);
+		zipped ? CHUNK_TYPE_PAYLOAD_ZIP : CHUNK_TYPE_PAYLOAD, payload_len);
+	packet_len += (sizeof(payload) + payload_len);
 	hg_pkt.header.length = htons(packet_len);
 
-	/* Build the buffer to send */
-	sock_buffer = ast_malloc(packet_len);
+	/* Build the packet straight into the pending batch */
+	sock_buffer = hep_batch_reserve(packet_len);
 	if (!sock_buffer) {
-		return -1;
+		ast_atomic_fetchadd_int(&hep_failed_packets, +1);
+		res = -1;
+		goto flush;
 	}
 
 	/* Copy in the header */
@@ -559,22 +892,21 @@ static int hep_queue_cb(void *data)
 	/* Packet! */
 	memcpy(sock_buffer + sock_buffer_len, &payload, sizeof(payload));
 	sock_buffer_len += sizeof(payload);
-	memcpy(sock_buffer + sock_buffer_len, capture_info->payload, capture_info->len);
-	sock_buffer_len += capture_info->len;
+	memcpy(sock_buffer + sock_buffer_len, payload_data, payload_len);
+	sock_buffer_len += payload_len;
 
 	ast_assert(sock_buffer_len == packet_len);
 
-	res = ast_sendto(hepv3_data->sockfd, sock_buffer, sock_buffer_len, 0, &hepv3_data->remote_addr);
-	if (res < 0) {
-		ast_log(AST_LOG_ERROR, "Error [%d] while sending packet to HEPv3 server: %s\n",
-			errno, strerror(errno));
-	} else if (res != sock_buffer_len) {
-		ast_log(AST_LOG_WARNING, "Failed to send complete packet to HEPv3 server: %d of %u sent\n",
-			res, sock_buffer_len);
-		res = -1;
+	hep_batch.len += sock_buffer_len;
+	hep_batch.ends[hep_batch.count++] = hep_batch.len;
+
+flush:
+	/* Send what we have once nothing else is waiting to be built, or the batch is full */
+	if (hep_batch.count == HEP_BATCH_MAX || hep_batch.len >= HEP_BATCH_BYTES
+		|| !ast_taskprocessor_size(hep_queue_tp)) {
+		hep_batch_flush(hepv3_data);
 	}
 
-	ast_free(sock_buffer);
 	return res;
 }
 
@@ -588,6 +920,18 @@ int hepv3_send_packet(struct hepv3_capture_info *capture_info)
 		return 0;
 	}
 
+	if (config->general->queue_limit
+		&& ast_taskprocessor_size(hep_queue_tp) >= config->general->queue_limit) {
+		ast_atomic_fetchadd_int(&hep_dropped_packets, +1);
+		if (!hep_queue_full) {
+			hep_queue_full = 1;
+			ast_log(AST_LOG_WARNING, "HEPv3 send queue is full (%u packets), dropping captured packets\n",
+				config->general->queue_limit);
+		}
+		ao2_ref(capture_info, -1);
+		return -1;
+	}
+
 	res = ast_taskprocessor_push(hep_queue_tp, hep_queue_cb, capture_info);
 	if (res == -1) {
 		ao2_ref(capture_info, -1);
@@ -615,6 +959,12 @@ static int hepv3_config_pre_apply(void)
 		return -1;
 	}
 
+#ifndef HAVE_ZLIB
+	if (config->general->capture_compress) {
+		ast_log(AST_LOG_WARNING, "Asterisk was built without zlib, 'capture_compress' is ignored\n");
+	}
+#endif
+
 	return 0;
 }
 
@@ -638,6 +988,35 @@ static void hepv3_config_post_apply(void)
 	ao2_ref(data, -1);
 }
 
+static char *handle_hep_show_stats(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "hep show stats";
+		e->usage =
+			"Usage: hep show stats\n"
+			"       Show how many captured packets were sent to the HEPv3 server.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_cli(a->fd, "Packets sent:    %d\n", hep_sent_packets);
+	ast_cli(a->fd, "Packets dropped: %d\n", hep_dropped_packets);
+	ast_cli(a->fd, "Packets failed:  %d\n", hep_failed_packets);
+	ast_cli(a->fd, "Packets queued:  %ld\n", ast_taskprocessor_size(hep_queue_tp));
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_hep[] = {
+	AST_CLI_DEFINE(handle_hep_show_stats, "Show HEPv3 capture statistics"),
+};
+
 /*!
  * \brief Reload the module
  */
@@ -654,8 +1033,15 @@ static int reload_module(void)
  */
 static int unload_module(void)
 {
+	ast_cli_unregister_multiple(cli_hep, ARRAY_LEN(cli_hep));
 	hep_queue_tp = ast_taskprocessor_unreference(hep_queue_tp);
 
+	ast_free(hep_batch.buf);
+#ifdef HAVE_ZLIB
+	ast_free(hep_batch.zbuf);
+#endif
+	memset(&hep_batch, 0, sizeof(hep_batch));
+
 	ao2_global_obj_release(global_config);
 	ao2_global_obj_release(global_data);
 	aco_info_destroy(&cfg_info);
@@ -682,11 +1068,16 @@ static int load_module(void)
 	aco_option_register(&cfg_info, "capture_password", ACO_EXACT, global_options, "", OPT_STRINGFIELD_T, 0, STRFLDSET(struct hepv3_global_config, capture_password));
 	aco_option_register(&cfg_info, "capture_id", ACO_EXACT, global_options, "0", OPT_UINT_T, 0, STRFLDSET(struct hepv3_global_config, capture_id));
 	aco_option_register_custom(&cfg_info, "uuid_type", ACO_EXACT, global_options, "call-id", uuid_type_handler, 0);
+	aco_option_register_custom(&cfg_info, "capture_transport", ACO_EXACT, global_options, "udp", transport_handler, 0);
+	aco_option_register(&cfg_info, "capture_compress", ACO_EXACT, global_options, "no", OPT_BOOL_T, 1, FLDSET(struct hepv3_global_config, capture_compress));
+	aco_option_register(&cfg_info, "queue_limit", ACO_EXACT, global_options, __stringify(DEFAULT_QUEUE_LIMIT), OPT_UINT_T, 0, FLDSET(struct hepv3_global_config, queue_limit));
 
 	if (aco_process_config(&cfg_info, 0) == ACO_PROCESS_ERROR) {
 		goto error;
 	}
 
+	ast_cli_register_multiple(cli_hep, ARRAY_LEN(cli_hep));
+
 	return AST_MODULE_LOAD_SUCCESS;
 
 error:
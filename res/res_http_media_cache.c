@@ -22,7 +22,8 @@
  *
  * \author \verbatim Matt Jordan <mjordan@digium.com> \endverbatim
  *
- * HTTP backend for the core media cache
+ * HTTP backend for the core media cache, and a sink streaming recordings
+ * to HTTP servers
  */
 
 /*** MODULEINFO
@@ -36,7 +37,9 @@
 #include <curl/curl.h>
 
 #include "asterisk/file.h"
+#include "asterisk/mod_format.h"
 #include "asterisk/module.h"
+#include "asterisk/res_curl.h"
 #include "asterisk/bucket.h"
 #include "asterisk/sorcery.h"
 #include "asterisk/threadstorage.h"
@@ -317,6 +320,14 @@ static CURL *get_curl_instance(struct curl_bucket_file_data *cb_data)
 	curl_easy_setopt(curl, CURLOPT_USERAGENT, GLOBAL_USERAGENT);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
 	curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 8);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#ifdef CURL_HTTP_VERSION_2TLS
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+#endif
+#ifdef CURLPIPE_MULTIPLEX
+	/* Wait for a connection being set up to the server to share it */
+	curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
 	curl_easy_setopt(curl, CURLOPT_URL, ast_sorcery_object_get_id(cb_data->bucket_file));
 	curl_easy_setopt(curl, CURLOPT_HEADERDATA, cb_data);
 
@@ -329,13 +340,18 @@ static CURL *get_curl_instance(struct curl_bucket_file_data *cb_data)
 static long execute_curl_instance(CURL *curl)
 {
 	char curl_errbuf[CURL_ERROR_SIZE + 1];
+	CURLcode result;
 	long http_code;
 
+	curl_errbuf[0] = '\0';
 	curl_errbuf[CURL_ERROR_SIZE] = '\0';
 	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_errbuf);
 
-	if (curl_easy_perform(curl)) {
-		ast_log(LOG_WARNING, "%s\n", curl_errbuf);
+	result = ast_curl_perform(curl);
+	if (result != CURLE_OK) {
+		ast_log(LOG_WARNING, "%s\n", ast_strlen_zero(curl_errbuf)
+			? curl_easy_strerror(result) : curl_errbuf);
+		curl_easy_cleanup(curl);
 		return -1;
 	}
 
@@ -412,6 +428,10 @@ static int bucket_http_wizard_is_stale(const struct ast_sorcery *sorcery, void *
 	}
 
 	curl = get_curl_instance(&cb_data);
+	if (!curl) {
+		ao2_ref(metadata, -1);
+		return 1;
+	}
 
 	/* Set the ETag header on our outgoing request */
 	snprintf(etag_buf, sizeof(etag_buf), "If-None-Match: %s", metadata->value);
@@ -519,8 +539,314 @@ static struct ast_sorcery_wizard https_bucket_file_wizard = {
 	.is_stale = bucket_http_wizard_is_stale,
 };
 
+/*! Kernel buffer of the pipe each recording is streamed through */
+#define UPLOAD_PIPE_SIZE (64 * 1024)
+
+/*! \brief A recording being streamed to an HTTP server */
+struct http_upload {
+	CURL *curl;
+	struct curl_slist *headers;
+	/*! Read end of the pipe the recording is written to */
+	int fd;
+	/*! The transfer waits for the recording to be written */
+	unsigned int paused:1;
+	/*! The recording has been closed and all of it read */
+	unsigned int eof:1;
+	/*! The transfer is over, the rest of the recording is discarded */
+	unsigned int draining:1;
+	AST_LIST_ENTRY(http_upload) list;
+	char uri[0];
+};
+
+/*! Protects uploads_pending */
+AST_MUTEX_DEFINE_STATIC(uploads_lock);
+/*! Uploads opened but not yet picked up by the upload thread */
+static AST_LIST_HEAD_NOLOCK_STATIC(uploads_pending, http_upload);
+/*! Runs the transfers of all uploads */
+static CURLM *uploads_multi;
+static pthread_t uploads_thread = AST_PTHREADT_NULL;
+static int uploads_stop;
+
+static size_t upload_read_callback(char *buffer, size_t size, size_t nitems, void *data)
+{
+	struct http_upload *upload = data;
+	ssize_t res;
+
+	res = read(upload->fd, buffer, size * nitems);
+	if (res > 0) {
+		return res;
+	} else if (!res) {
+		upload->eof = 1;
+		return 0;
+	} else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+		upload->paused = 1;
+		return CURL_READFUNC_PAUSE;
+	}
+
+	ast_log(LOG_WARNING, "Failed to read recording for '%s': %s\n", upload->uri, strerror(errno));
+	return CURL_READFUNC_ABORT;
+}
+
+static size_t upload_discard_callback(char *ptr, size_t size, size_t nitems, void *data)
+{
+	return size * nitems;
+}
+
+static void upload_free(struct http_upload *upload)
+{
+	if (upload->curl) {
+		curl_easy_cleanup(upload->curl);
+	}
+	curl_slist_free_all(upload->headers);
+	if (upload->fd > -1) {
+		close(upload->fd);
+	}
+	ast_free(upload);
+	ast_module_unref(ast_module_info->self);
+}
+
+/*!
+ * \internal
+ * \brief Throw away what is written to an upload whose transfer is over
+ *
+ * \retval 1 once the recording has been closed
+ * \retval 0 otherwise
+ */
+static int upload_drain(struct http_upload *upload)
+{
+	char buf[4096];
+	ssize_t res;
+
+	while ((res = read(upload->fd, buf, sizeof(buf))) > 0) {
+	}
+
+	return !res || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+static void upload_done(struct http_upload *upload, CURLcode result)
+{
+	long http_code = 0;
+
+	curl_easy_getinfo(upload->curl, CURLINFO_RESPONSE_CODE, &http_code);
+	if (result != CURLE_OK) {
+		ast_log(LOG_WARNING, "Failed to stream recording to '%s': %s\n", upload->uri,
+			curl_easy_strerror(result));
+	} else if (http_code / 100 != 2) {
+		ast_log(LOG_WARNING, "Failed to stream recording to '%s': server returned %ld\n",
+			upload->uri, http_code);
+	} else {
+		ast_debug(3, "Streamed recording to '%s'\n", upload->uri);
+	}
+
+	curl_multi_remove_handle(uploads_multi, upload->curl);
+	curl_easy_cleanup(upload->curl);
+	upload->curl = NULL;
+	upload->draining = 1;
+}
+
+static void *upload_thread_run(void *data)
+{
+	AST_LIST_HEAD_NOLOCK(, http_upload) active = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
+	struct curl_waitfd *fds = NULL;
+	struct http_upload **waiting = NULL;
+	unsigned int max_fds = 0;
+	struct timeval last_sweep = ast_tvnow();
+
+	while (!uploads_stop) {
+		struct http_upload *upload;
+		struct CURLMsg *msg;
+		unsigned int count = 0;
+		unsigned int i;
+		int sweep;
+		int running;
+		int left;
+
+		ast_mutex_lock(&uploads_lock);
+		while ((upload = AST_LIST_REMOVE_HEAD(&uploads_pending, list))) {
+			if (curl_multi_add_handle(uploads_multi, upload->curl) != CURLM_OK) {
+				ast_log(LOG_WARNING, "Unable to start streaming recording to '%s'\n", upload->uri);
+				curl_easy_cleanup(upload->curl);
+				upload->curl = NULL;
+				upload->draining = 1;
+			}
+			AST_LIST_INSERT_TAIL(&active, upload, list);
+		}
+		ast_mutex_unlock(&uploads_lock);
+
+		/* Wait on the pipes of the uploads waiting for more of their recording */
+		AST_LIST_TRAVERSE(&active, upload, list) {
+			if (!upload->paused && !upload->draining) {
+				continue;
+			}
+			if (count == max_fds) {
+				unsigned int grown = max_fds ? max_fds * 2 : 64;
+				struct curl_waitfd *new_fds = ast_realloc(fds, grown * sizeof(*fds));
+				struct http_upload **new_waiting;
+
+				if (!new_fds) {
+					break;
+				}
+				fds = new_fds;
+				if (!(new_waiting = ast_realloc(waiting, grown * sizeof(*waiting)))) {
+					break;
+				}
+				waiting = new_waiting;
+				max_fds = grown;
+			}
+			fds[count].fd = upload->fd;
+			fds[count].events = CURL_WAIT_POLLIN;
+			fds[count].revents = 0;
+			waiting[count++] = upload;
+		}
+
+		curl_multi_poll(uploads_multi, fds, count, 1000, NULL);
+
+		/*
+		 * A closed pipe is not always reported as readable, so every second
+		 * all waiting uploads look at their pipe whether reported or not.
+		 */
+		sweep = ast_tvdiff_ms(ast_tvnow(), last_sweep) >= 1000;
+		if (sweep) {
+			last_sweep = ast_tvnow();
+		}
+		for (i = 0; i < count; ++i) {
+			upload = waiting[i];
+			if (!fds[i].revents && !sweep) {
+				continue;
+			}
+			if (upload->draining) {
+				if (upload_drain(upload)) {
+					upload->eof = 1;
+				}
+			} else {
+				upload->paused = 0;
+				curl_easy_pause(upload->curl, CURLPAUSE_CONT);
+			}
+		}
+
+		curl_multi_perform(uploads_multi, &running);
+
+		while ((msg = curl_multi_info_read(uploads_multi, &left))) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &upload);
+			upload_done(upload, msg->data.result);
+		}
+
+		AST_LIST_TRAVERSE_SAFE_BEGIN(&active, upload, list) {
+			if (upload->draining && (upload->eof || upload_drain(upload))) {
+				AST_LIST_REMOVE_CURRENT(list);
+				upload_free(upload);
+			}
+		}
+		AST_LIST_TRAVERSE_SAFE_END;
+	}
+
+	ast_free(fds);
+	ast_free(waiting);
+
+	return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Open a pipe a recording is written to while it is streamed to an HTTP server
+ *
+ * The pipe bounds how much of the recording is held in memory.  When the
+ * server cannot keep up, writing the recording blocks until it does.
+ */
+static FILE *http_sink_open(const char *uri, const char *mime_type)
+{
+	struct http_upload *upload;
+	char content_type[128];
+	int fds[2];
+	FILE *file;
+
+	if (!(upload = ast_calloc(1, sizeof(*upload) + strlen(uri) + 1))) {
+		return NULL;
+	}
+	strcpy(upload->uri, uri); /* Safe */
+	upload->fd = -1;
+	ast_module_ref(ast_module_info->self);
+
+	if (pipe(fds)) {
+		ast_log(LOG_WARNING, "Unable to create a pipe for '%s': %s\n", uri, strerror(errno));
+		upload_free(upload);
+		return NULL;
+	}
+	upload->fd = fds[0];
+	ast_fd_set_flags(upload->fd, O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+	fcntl(fds[1], F_SETPIPE_SZ, UPLOAD_PIPE_SIZE);
+#endif
+
+	if (!(file = fdopen(fds[1], "w"))) {
+		ast_log(LOG_WARNING, "Unable to open a stream for '%s': %s\n", uri, strerror(errno));
+		close(fds[1]);
+		upload_free(upload);
+		return NULL;
+	}
+
+	if (!(upload->curl = curl_easy_init())) {
+		fclose(file);
+		upload_free(upload);
+		return NULL;
+	}
+
+	/* The length of the recording is not known yet, so it is sent in chunks */
+	upload->headers = curl_slist_append(upload->headers, "Transfer-Encoding: chunked");
+	upload->headers = curl_slist_append(upload->headers, "Expect:");
+	if (!ast_strlen_zero(mime_type)) {
+		snprintf(content_type, sizeof(content_type), "Content-Type: %s", mime_type);
+		upload->headers = curl_slist_append(upload->headers, content_type);
+	}
+
+	curl_easy_setopt(upload->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(upload->curl, CURLOPT_CONNECTTIMEOUT, 10L);
+	curl_easy_setopt(upload->curl, CURLOPT_USERAGENT, GLOBAL_USERAGENT);
+	curl_easy_setopt(upload->curl, CURLOPT_URL, upload->uri);
+	curl_easy_setopt(upload->curl, CURLOPT_UPLOAD, 1L);
+	curl_easy_setopt(upload->curl, CURLOPT_HTTPHEADER, upload->headers);
+	curl_easy_setopt(upload->curl, CURLOPT_READFUNCTION, upload_read_callback);
+	curl_easy_setopt(upload->curl, CURLOPT_READDATA, upload);
+	curl_easy_setopt(upload->curl, CURLOPT_WRITEFUNCTION, upload_discard_callback);
+	curl_easy_setopt(upload->curl, CURLOPT_PRIVATE, upload);
+
+	ast_mutex_lock(&uploads_lock);
+	AST_LIST_INSERT_TAIL(&uploads_pending, upload, list);
+	ast_mutex_unlock(&uploads_lock);
+	curl_multi_wakeup(uploads_multi);
+
+	return file;
+}
+
+static struct ast_file_sink http_sink = {
+	.scheme = "http",
+	.open = http_sink_open,
+};
+
+static struct ast_file_sink https_sink = {
+	.scheme = "https",
+	.open = http_sink_open,
+};
+
 static int unload_module(void)
 {
+	ast_file_sink_unregister("http");
+	ast_file_sink_unregister("https");
+
+	if (uploads_thread != AST_PTHREADT_NULL) {
+		uploads_stop = 1;
+		curl_multi_wakeup(uploads_multi);
+		pthread_join(uploads_thread, NULL);
+		uploads_thread = AST_PTHREADT_NULL;
+	}
+	if (uploads_multi) {
+		curl_multi_cleanup(uploads_multi);
+		uploads_multi = NULL;
+	}
+
 	return 0;
 }
 
@@ -538,6 +864,20 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	uploads_stop = 0;
+	if (!(uploads_multi = curl_multi_init())
+		|| ast_pthread_create_background(&uploads_thread, NULL, upload_thread_run, NULL)) {
+		ast_log(LOG_ERROR, "Failed to start streaming recordings to HTTP servers\n");
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	if (ast_file_sink_register(&http_sink) || ast_file_sink_register(&https_sink)) {
+		ast_log(LOG_ERROR, "Failed to register HTTP recording sinks\n");
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
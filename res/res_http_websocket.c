@@ -24,11 +24,16 @@
  */
 
 /*** MODULEINFO
+	<use type="external">zlib</use>
 	<support_level>core</support_level>
  ***/
 
 #include "asterisk.h"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "asterisk/module.h"
 #include "asterisk/http.h"
 #include "asterisk/astobj2.h"
@@ -84,6 +89,22 @@
 #define MAX_WS_HDR_SZ 14
 #define MIN_WS_HDR_SZ 2
 
+/*! \brief Frame header bit marking a message compressed by permessage-deflate */
+#define WS_RSV1 0x40
+
+/*! \brief Smallest payload worth compressing */
+#define DEFLATE_MIN_SIZE 64
+
+/*! \brief Most bytes one compressed frame may inflate to */
+#define MAXIMUM_INFLATED_SIZE (MAXIMUM_FRAME_SIZE * 16)
+
+/*! \brief Growable buffer for frames and compressed payloads */
+struct websocket_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
 /*! \brief Structure definition for session */
 struct ast_websocket {
 	struct ast_iostream *stream;        /*!< iostream of the connection */
@@ -100,9 +121,44 @@ struct ast_websocket {
 	struct websocket_client *client;    /*!< Client object when connected as a client websocket */
 	char session_id[AST_UUID_STR_LEN];  /*!< The identifier for the websocket session */
 	uint16_t close_status_code;         /*!< Status code sent in a CLOSE frame upon shutdown */
+	ast_mutex_t write_lock;             /*!< Orders frames being built and queued for writing */
+	unsigned int coalesce:1;            /*!< Bit to indicate frames written during a write are queued behind it */
+	unsigned int flushing:1;            /*!< Bit to indicate a writer is sending the queued frames */
+	unsigned int deflate_no_context:1;  /*!< Bit to indicate each message is compressed on its own */
+	unsigned int inflating:1;           /*!< Bit to indicate the message being read is compressed */
+	struct websocket_buf out;           /*!< Frames waiting to be written */
+	struct websocket_buf spare;         /*!< Buffer taking the place of out while it is written */
+	struct websocket_buf deflated;      /*!< Scratch buffer for compressed payloads being sent */
+	struct websocket_buf inflated;      /*!< Scratch buffer for decompressed frames being read */
+#ifdef HAVE_ZLIB
+	z_stream *deflater;                 /*!< Compresses sent messages if permessage-deflate was negotiated */
+	z_stream *inflater;                 /*!< Decompresses received messages if permessage-deflate was negotiated */
+#endif
+	struct ast_websocket_stats stats;   /*!< Session counters, protected by write_lock */
 	char buf[MAXIMUM_FRAME_SIZE];	    /*!< Fixed buffer for reading data into */
 };
 
+/*! \brief Make room for \a count more bytes in a \ref websocket_buf */
+static int websocket_buf_reserve(struct websocket_buf *buf, size_t count)
+{
+	size_t size = buf->size ? buf->size : 256;
+	char *data;
+
+	if (buf->len + count <= buf->size) {
+		return 0;
+	}
+	while (size < buf->len + count) {
+		size *= 2;
+	}
+	data = ast_realloc(buf->data, size);
+	if (!data) {
+		return -1;
+	}
+	buf->data = data;
+	buf->size = size;
+	return 0;
+}
+
 /*! \brief Hashing function for protocols */
 static int protocol_hash_fn(const void *obj, const int flags)
 {
@@ -184,6 +240,30 @@ static void session_destroy_fn(void *obj)
 		}
 	}
 
+	if (session->stats.deflate || session->stats.coalesce) {
+		ast_debug(1, "WebSocket session %s sent %" PRIu64 " frames in %" PRIu64 " writes, "
+			"compressed %" PRIu64 " bytes to %" PRIu64 " and inflated %" PRIu64 " bytes to %" PRIu64 "\n",
+			session->session_id, session->stats.frames_sent, session->stats.writes,
+			session->stats.deflate_in, session->stats.deflate_out,
+			session->stats.inflate_in, session->stats.inflate_out);
+	}
+
+#ifdef HAVE_ZLIB
+	if (session->deflater) {
+		deflateEnd(session->deflater);
+		ast_free(session->deflater);
+	}
+	if (session->inflater) {
+		inflateEnd(session->inflater);
+		ast_free(session->inflater);
+	}
+#endif
+	ast_free(session->out.data);
+	ast_free(session->spare.data);
+	ast_free(session->deflated.data);
+	ast_free(session->inflated.data);
+	ast_mutex_destroy(&session->write_lock);
+
 	ao2_cleanup(session->client);
 	ast_free(session->payload);
 }
@@ -370,16 +450,123 @@ static const char *websocket_opcode2str(enum ast_websocket_opcode opcode)
 	}
 }
 
-/*! \brief Write function for websocket traffic */
-int AST_OPTIONAL_API_NAME(ast_websocket_write)(struct ast_websocket *session, enum ast_websocket_opcode opcode, char *payload, uint64_t payload_size)
+#ifdef HAVE_ZLIB
+/*!
+ * \brief Compress a message payload into the session's scratch buffer
+ *
+ * \note The session's write_lock must be held, compressed messages have to
+ *       be written in the order they were compressed in.
+ */
+static int websocket_deflate(struct ast_websocket *session, char *payload, uint64_t payload_size)
+{
+	z_stream *z = session->deflater;
+	int res;
+
+	session->deflated.len = 0;
+	z->next_in = (Bytef *) payload;
+	z->avail_in = payload_size;
+	do {
+		if (websocket_buf_reserve(&session->deflated, deflateBound(z, z->avail_in) + 16)) {
+			return -1;
+		}
+		z->next_out = (Bytef *) session->deflated.data + session->deflated.len;
+		z->avail_out = session->deflated.size - session->deflated.len;
+		res = deflate(z, Z_SYNC_FLUSH);
+		session->deflated.len = session->deflated.size - z->avail_out;
+		if (res != Z_OK && res != Z_BUF_ERROR) {
+			ast_log(LOG_WARNING, "WebSocket compression failed: %d\n", res);
+			return -1;
+		}
+	} while (z->avail_in || !z->avail_out);
+
+	/* RFC 7692 7.2.1 - the empty block ending the flush is not sent */
+	if (session->deflated.len >= 4) {
+		session->deflated.len -= 4;
+	}
+	if (session->deflate_no_context) {
+		deflateReset(z);
+	}
+
+	session->stats.deflate_in += payload_size;
+	session->stats.deflate_out += session->deflated.len;
+	return 0;
+}
+
+/*!
+ * \brief Decompress a frame of a compressed message into the session's scratch buffer
+ *
+ * \param fin Whether this is the last frame of the message
+ */
+static int websocket_inflate(struct ast_websocket *session, char *payload, uint64_t payload_len, int fin)
+{
+	/* RFC 7692 7.2.2 - put back the end of the flush removed by the sender */
+	static unsigned char tail[] = { 0x00, 0x00, 0xff, 0xff };
+	z_stream *z = session->inflater;
+	int res;
+	int pass;
+
+	session->inflated.len = 0;
+	for (pass = 0; pass < 2; ++pass) {
+		if (!pass) {
+			z->next_in = (Bytef *) payload;
+			z->avail_in = payload_len;
+		} else if (fin) {
+			z->next_in = tail;
+			z->avail_in = sizeof(tail);
+		} else {
+			break;
+		}
+		do {
+			if (session->inflated.len >= MAXIMUM_INFLATED_SIZE) {
+				ast_log(LOG_WARNING, "WebSocket frame inflates beyond %d bytes\n", MAXIMUM_INFLATED_SIZE);
+				return -1;
+			}
+			if (websocket_buf_reserve(&session->inflated, MIN(payload_len * 4 + 256, MAXIMUM_FRAME_SIZE))) {
+				return -1;
+			}
+			z->next_out = (Bytef *) session->inflated.data + session->inflated.len;
+			z->avail_out = session->inflated.size - session->inflated.len;
+			res = inflate(z, Z_SYNC_FLUSH);
+			session->inflated.len = session->inflated.size - z->avail_out;
+			if (res != Z_OK && res != Z_BUF_ERROR && res != Z_STREAM_END) {
+				ast_log(LOG_WARNING, "WebSocket decompression failed: %d\n", res);
+				return -1;
+			}
+		} while (z->avail_in || !z->avail_out);
+	}
+
+	ast_mutex_lock(&session->write_lock);
+	session->stats.inflate_in += payload_len;
+	session->stats.inflate_out += session->inflated.len;
+	ast_mutex_unlock(&session->write_lock);
+	return 0;
+}
+#endif
+
+/*!
+ * \brief Append a frame to the session's queue of frames to write
+ *
+ * \note The session's write_lock must be held.
+ */
+static int websocket_queue_frame(struct ast_websocket *session, enum ast_websocket_opcode opcode,
+	char *payload, uint64_t payload_size)
 {
 	size_t header_size = 2; /* The minimum size of a websocket frame is 2 bytes */
 	char *frame;
 	uint64_t length;
-	uint64_t frame_size;
+	int rsv = 0;
 
-	ast_debug(3, "Writing websocket %s frame, length %" PRIu64 "\n",
-			websocket_opcode2str(opcode), payload_size);
+#ifdef HAVE_ZLIB
+	if (session->deflater && payload_size >= DEFLATE_MIN_SIZE
+		&& (opcode == AST_WEBSOCKET_OPCODE_TEXT || opcode == AST_WEBSOCKET_OPCODE_BINARY)) {
+		if (websocket_deflate(session, payload, payload_size)) {
+			return -1;
+		}
+		payload = session->deflated.data;
+		payload_size = session->deflated.len;
+		rsv = WS_RSV1;
+	}
+#endif
 
 	if (payload_size < 126) {
 		length = payload_size;
@@ -398,12 +585,13 @@ int AST_OPTIONAL_API_NAME(ast_websocket_write)(struct ast_websocket *session, en
 		header_size += 4;
 	}
 
-	frame_size = header_size + payload_size;
-
-	frame = ast_alloca(frame_size + 1);
-	memset(frame, 0, frame_size + 1);
+	if (websocket_buf_reserve(&session->out, header_size + payload_size)) {
+		return -1;
+	}
+	frame = session->out.data + session->out.len;
+	memset(frame, 0, header_size);
 
-	frame[0] = opcode | 0x80;
+	frame[0] = opcode | rsv | 0x80;
 	frame[1] = length;
 
 	/* Use the additional available bytes to store the length */
@@ -417,25 +605,100 @@ int AST_OPTIONAL_API_NAME(ast_websocket_write)(struct ast_websocket *session, en
 
 	websocket_mask_payload(session, frame, &frame[header_size], payload_size);
 
-	ao2_lock(session);
-	if (session->closing) {
+	session->out.len += header_size + payload_size;
+	++session->stats.frames_sent;
+	return 0;
+}
+
+/*!
+ * \brief Write the frames queued on a session
+ *
+ * \note The session's write_lock must be held.  It is released while
+ *       writing if the session coalesces frames, so frames written
+ *       meanwhile queue up and are sent by this writer on its next pass.
+ */
+static int websocket_flush(struct ast_websocket *session)
+{
+	struct websocket_buf pending;
+	int res = 0;
+
+	session->flushing = 1;
+	while (!res && session->out.len) {
+		/* Take the queued frames, leaving the spare buffer to queue behind them */
+		pending = session->out;
+		session->out = session->spare;
+		session->out.len = 0;
+		memset(&session->spare, 0, sizeof(session->spare));
+		++session->stats.writes;
+
+		if (session->coalesce) {
+			ast_mutex_unlock(&session->write_lock);
+		}
+
+		ao2_lock(session);
+		if (session->closing) {
+			res = -1;
+		} else {
+			ast_iostream_set_timeout_sequence(session->stream, ast_tvnow(), session->timeout);
+			if (ast_iostream_write(session->stream, pending.data, pending.len) != pending.len) {
+				res = -2;
+			} else {
+				ast_iostream_set_timeout_disable(session->stream);
+			}
+		}
 		ao2_unlock(session);
+
+		if (session->coalesce) {
+			ast_mutex_lock(&session->write_lock);
+		}
+
+		pending.len = 0;
+		session->spare = pending;
+	}
+	if (res) {
+		/* The queued frames can no longer be sent */
+		session->out.len = 0;
+	}
+	session->flushing = 0;
+
+	return res;
+}
+
+/*! \brief Write function for websocket traffic */
+int AST_OPTIONAL_API_NAME(ast_websocket_write)(struct ast_websocket *session, enum ast_websocket_opcode opcode, char *payload, uint64_t payload_size)
+{
+	int res;
+
+	ast_debug(3, "Writing websocket %s frame, length %" PRIu64 "\n",
+			websocket_opcode2str(opcode), payload_size);
+
+	ast_mutex_lock(&session->write_lock);
+	if (session->closing) {
+		ast_mutex_unlock(&session->write_lock);
 		return -1;
 	}
 
-	ast_iostream_set_timeout_sequence(session->stream, ast_tvnow(), session->timeout);
-	if (ast_iostream_write(session->stream, frame, frame_size) != frame_size) {
-		ao2_unlock(session);
+	if (websocket_queue_frame(session, opcode, payload, payload_size)) {
+		ast_mutex_unlock(&session->write_lock);
+		return -1;
+	}
+
+	if (session->flushing) {
+		/* The writer on the socket sends this frame after its own */
+		ast_mutex_unlock(&session->write_lock);
+		return 0;
+	}
+
+	res = websocket_flush(session);
+	ast_mutex_unlock(&session->write_lock);
+
+	if (res == -2) {
 		/* 1011 - server terminating connection due to not being able to fulfill the request */
 		ast_debug(1, "Closing WS with 1011 because we can't fulfill a write request\n");
 		ast_websocket_close(session, 1011);
-		return -1;
 	}
 
-	ast_iostream_set_timeout_disable(session->stream);
-	ao2_unlock(session);
-
-	return 0;
+	return res ? -1 : 0;
 }
 
 void AST_OPTIONAL_API_NAME(ast_websocket_reconstruct_enable)(struct ast_websocket *session, size_t bytes)
@@ -502,6 +765,14 @@ const char * AST_OPTIONAL_API_NAME(ast_websocket_session_id)(struct ast_websocke
 	return session->session_id;
 }
 
+int AST_OPTIONAL_API_NAME(ast_websocket_get_stats)(struct ast_websocket *session, struct ast_websocket_stats *stats)
+{
+	ast_mutex_lock(&session->write_lock);
+	*stats = session->stats;
+	ast_mutex_unlock(&session->write_lock);
+
+	return 0;
+}
 
 /* MAINTENANCE WARNING on ast_websocket_read()!
  *
@@ -671,6 +942,28 @@ int AST_OPTIONAL_API_NAME(ast_websocket_read)(struct ast_websocket *session, cha
 			}
 		}
 
+#ifdef HAVE_ZLIB
+		/* Only the first frame of a compressed message is marked */
+		if (session->inflater && (session->buf[0] & WS_RSV1)
+			&& (*opcode == AST_WEBSOCKET_OPCODE_TEXT || *opcode == AST_WEBSOCKET_OPCODE_BINARY)) {
+			session->inflating = 1;
+		}
+		if (session->inflating && (*opcode == AST_WEBSOCKET_OPCODE_TEXT
+			|| *opcode == AST_WEBSOCKET_OPCODE_BINARY || *opcode == AST_WEBSOCKET_OPCODE_CONTINUATION)) {
+			if (websocket_inflate(session, *payload, *payload_len, fin)) {
+				*payload_len = 0;
+				/* 1007 - the message data is not consistent with its type */
+				ast_websocket_close(session, 1007);
+				return -1;
+			}
+			if (fin) {
+				session->inflating = 0;
+			}
+			*payload = session->inflated.data;
+			*payload_len = session->inflated.len;
+		}
+#endif
+
 		/* Per the RFC for PING we need to send back an opcode with the application data as received */
 		if (*opcode == AST_WEBSOCKET_OPCODE_PING) {
 			if (ast_websocket_write(session, AST_WEBSOCKET_OPCODE_PONG, *payload, *payload_len)) {
@@ -774,6 +1067,100 @@ static char *websocket_combine_key(const char *key, char *res, int res_size)
 	return res;
 }
 
+/*!
+ * \brief Pick the first permessage-deflate offer of a Sec-WebSocket-Extensions header we can accept
+ *
+ * \param offers The header value
+ * \param[out] window_bits Window size the server compresses with
+ * \param[out] no_context Whether the client asked for each message to be compressed on its own
+ *
+ * \retval 0 if an offer was accepted
+ * \retval -1 if none was
+ */
+static int websocket_deflate_negotiate(const char *offers, int *window_bits, int *no_context)
+{
+	char *offer_list = ast_strdupa(offers);
+	char *offer;
+
+	while ((offer = strsep(&offer_list, ","))) {
+		char *param;
+		int acceptable = 1;
+
+		param = ast_strip(strsep(&offer, ";"));
+		if (strcasecmp(param, "permessage-deflate")) {
+			continue;
+		}
+
+		*window_bits = 15;
+		*no_context = 0;
+		while (acceptable && (param = strsep(&offer, ";"))) {
+			char *value = param;
+
+			param = ast_strip(strsep(&value, "="));
+			if (value) {
+				value = ast_strip_quoted(ast_strip(value), "\"", "\"");
+			}
+
+			if (!strcasecmp(param, "server_no_context_takeover") && !value) {
+				*no_context = 1;
+			} else if (!strcasecmp(param, "client_no_context_takeover") && !value) {
+				/* One inflater copes with or without the client's context */
+			} else if (!strcasecmp(param, "client_max_window_bits")) {
+				/* Inflating with the largest window handles any smaller one */
+			} else if (!strcasecmp(param, "server_max_window_bits") && value
+				&& sscanf(value, "%30d", window_bits) == 1
+				/* zlib cannot produce a raw deflate stream with a 256 byte window */
+				&& *window_bits >= 9 && *window_bits <= 15) {
+			} else {
+				acceptable = 0;
+			}
+		}
+		if (acceptable) {
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*!
+ * \brief Set up permessage-deflate on a session
+ *
+ * \retval 0 on success
+ * \retval -1 on failure, the session continues uncompressed
+ */
+static int websocket_deflate_init(struct ast_websocket *session, int window_bits, int no_context)
+{
+#ifdef HAVE_ZLIB
+	session->deflater = ast_calloc(1, sizeof(*session->deflater));
+	session->inflater = ast_calloc(1, sizeof(*session->inflater));
+	if (!session->deflater || !session->inflater) {
+		goto failure;
+	}
+
+	/* Negative window bits for a raw deflate stream without zlib header */
+	if (deflateInit2(session->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits,
+		8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		goto failure;
+	}
+	if (inflateInit2(session->inflater, -15) != Z_OK) {
+		deflateEnd(session->deflater);
+		goto failure;
+	}
+
+	session->deflate_no_context = no_context;
+	session->stats.deflate = 1;
+	return 0;
+
+failure:
+	ast_free(session->deflater);
+	session->deflater = NULL;
+	ast_free(session->inflater);
+	session->inflater = NULL;
+#endif
+	return -1;
+}
+
 static void websocket_bad_request(struct ast_tcptls_session_instance *ser)
 {
 	struct ast_str *http_header = ast_str_create(64);
@@ -793,6 +1180,8 @@ int AST_OPTIONAL_API_NAME(ast_websocket_uri_cb)(struct ast_tcptls_session_instan
 	const char *upgrade = NULL, *key = NULL, *key1 = NULL, *key2 = NULL, *protos = NULL;
 	char *requested_protocols = NULL, *protocol = NULL;
 	int version = 0, flags = 1;
+	int window_bits = 15, no_context = 0, deflate = 0;
+	char extensions[128] = "";
 	struct ast_websocket_protocol *protocol_handler = NULL;
 	struct ast_websocket *session;
 	struct ast_websocket_server *server;
@@ -893,6 +1282,7 @@ int AST_OPTIONAL_API_NAME(ast_websocket_uri_cb)(struct ast_tcptls_session_instan
 			return 0;
 		}
 		session->timeout = AST_DEFAULT_WEBSOCKET_WRITE_TIMEOUT;
+		ast_mutex_init(&session->write_lock);
 
 		/* Generate the session id */
 		if (!ast_uuid_generate_str(session->session_id, sizeof(session->session_id))) {
@@ -912,6 +1302,32 @@ int AST_OPTIONAL_API_NAME(ast_websocket_uri_cb)(struct ast_tcptls_session_instan
 			return 0;
 		}
 
+#ifdef HAVE_ZLIB
+		if (protocol_handler->deflate) {
+			for (v = headers; v && !deflate; v = v->next) {
+				if (!strcasecmp(v->name, "Sec-WebSocket-Extensions")
+					&& !websocket_deflate_negotiate(v->value, &window_bits, &no_context)
+					&& !websocket_deflate_init(session, window_bits, no_context)) {
+					deflate = 1;
+				}
+			}
+		}
+		if (deflate) {
+			int len;
+
+			len = snprintf(extensions, sizeof(extensions),
+				"Sec-WebSocket-Extensions: permessage-deflate%s",
+				no_context ? "; server_no_context_takeover" : "");
+			if (window_bits < 15) {
+				len += snprintf(extensions + len, sizeof(extensions) - len,
+					"; server_max_window_bits=%d", window_bits);
+			}
+			snprintf(extensions + len, sizeof(extensions) - len, "\r\n");
+		}
+#endif
+		session->coalesce = protocol_handler->coalesce;
+		session->stats.coalesce = protocol_handler->coalesce;
+
 		/* RFC 6455, Section 4.1:
 		 *
 		 * 6. If the response includes a |Sec-WebSocket-Protocol| header
@@ -927,18 +1343,22 @@ int AST_OPTIONAL_API_NAME(ast_websocket_uri_cb)(struct ast_tcptls_session_instan
 				"Upgrade: %s\r\n"
 				"Connection: Upgrade\r\n"
 				"Sec-WebSocket-Accept: %s\r\n"
-				"Sec-WebSocket-Protocol: %s\r\n\r\n",
+				"Sec-WebSocket-Protocol: %s\r\n"
+				"%s\r\n",
 				upgrade,
 				websocket_combine_key(key, base64, sizeof(base64)),
-				protocol);
+				protocol,
+				extensions);
 		} else {
 			ast_iostream_printf(ser->stream,
 				"HTTP/1.1 101 Switching Protocols\r\n"
 				"Upgrade: %s\r\n"
 				"Connection: Upgrade\r\n"
-				"Sec-WebSocket-Accept: %s\r\n\r\n",
+				"Sec-WebSocket-Accept: %s\r\n"
+				"%s\r\n",
 				upgrade,
-				websocket_combine_key(key, base64, sizeof(base64)));
+				websocket_combine_key(key, base64, sizeof(base64)),
+				extensions);
 		}
 	} else {
 
@@ -1232,6 +1652,7 @@ static struct ast_websocket * websocket_client_create(
 		*result = WS_ALLOCATE_ERROR;
 		return NULL;
 	}
+	ast_mutex_init(&ws->write_lock);
 
 	if (!(ws->client = ao2_alloc(
 		      sizeof(*ws->client), websocket_client_destroy))) {
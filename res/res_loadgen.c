@@ -0,0 +1,473 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ *
+ * \brief Synthetic call load generator
+ *
+ * \details
+ * Originates calls at a fixed rate to a dial string, typically a Local
+ * channel into a test context or a PJSIP endpoint that loops back to this
+ * system.  Each answered call plays a tone for the hold time while the
+ * frames coming back are timed, then hangs up.  Nothing outside of
+ * Asterisk is needed, so a single box can be driven to its capacity.
+ *
+ * Call setup time and frame delivery jitter are recorded in core
+ * histograms, which res_prometheus exports along with the others.
+ */
+
+/*** MODULEINFO
+	<support_level>extended</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include <sys/resource.h>
+
+#include "asterisk/channel.h"
+#include "asterisk/cli.h"
+#include "asterisk/config.h"
+#include "asterisk/dial.h"
+#include "asterisk/frame.h"
+#include "asterisk/histogram.h"
+#include "asterisk/indications.h"
+#include "asterisk/lock.h"
+#include "asterisk/module.h"
+#include "asterisk/utils.h"
+
+/*! \brief How long to wait for a call to be answered, in milliseconds */
+#define LOADGEN_DIAL_TIMEOUT 10000
+
+/*! \brief Default time an answered call is held, in seconds */
+#define LOADGEN_DEFAULT_HOLD 10
+
+/*! \brief Maximum calls per second */
+#define LOADGEN_MAX_RATE 1000
+
+/*! \brief Tone played on every call so there is media to time */
+#define LOADGEN_TONE "!440+480/2000,!0/4000"
+
+/*! \brief The current run, protected by loadgen_lock */
+static struct {
+	/*! Thread originating the calls */
+	pthread_t thread;
+	/*! What to dial, as Tech/Device */
+	char dialstring[256];
+	/*! Calls per second */
+	unsigned int rate;
+	/*! Length of the run, in seconds */
+	unsigned int duration;
+	/*! How long each answered call is held, in seconds */
+	unsigned int hold;
+	/*! Set while calls are still being originated */
+	int running;
+	/*! Set when the run has been asked to stop */
+	int stop;
+	/*! When the run started */
+	struct timeval start;
+	/*! Process resource usage when the run started */
+	struct rusage usage;
+	/*! Calls originated */
+	unsigned int originated;
+	/*! Calls answered */
+	unsigned int answered;
+	/*! Calls that were not answered or could not be created */
+	unsigned int failed;
+	/*! Calls held and hung up */
+	unsigned int completed;
+	/*! Call threads still running */
+	unsigned int active;
+} loadgen = {
+	.thread = AST_PTHREADT_NULL,
+};
+
+AST_MUTEX_DEFINE_STATIC(loadgen_lock);
+static ast_cond_t loadgen_cond;
+
+static struct ast_histogram *setup_time;
+static struct ast_histogram *frame_jitter;
+
+/*!
+ * \brief Time the frames received on a call
+ *
+ * Jitter is how far each audio frame arrived from when it was due,
+ * judged from the arrival of the previous frame and its length.
+ */
+static void loadgen_hold(struct ast_channel *chan, unsigned int hold)
+{
+	struct timeval end = ast_tvadd(ast_tvnow(), ast_samp2tv(hold, 1));
+	struct timeval last = { 0, };
+	int64_t expected = 0;
+
+	if (ast_playtones_start(chan, 0, LOADGEN_TONE, 0)) {
+		ast_log(LOG_WARNING, "Unable to play tone on '%s'\n", ast_channel_name(chan));
+	}
+
+	while (!loadgen.stop) {
+		struct ast_frame *frame;
+		struct timeval now = ast_tvnow();
+		int64_t remaining = ast_tvdiff_ms(end, now);
+		int res;
+
+		if (remaining <= 0) {
+			break;
+		}
+
+		res = ast_waitfor(chan, MIN(remaining, 1000));
+		if (res < 0) {
+			break;
+		} else if (!res) {
+			continue;
+		}
+
+		frame = ast_read(chan);
+		if (!frame) {
+			break;
+		}
+
+		if (frame->frametype == AST_FRAME_VOICE && frame->samples) {
+			now = ast_tvnow();
+			if (!ast_tvzero(last)) {
+				ast_histogram_record(frame_jitter,
+					llabs(ast_tvdiff_us(now, last) - expected));
+			}
+			last = now;
+			expected = (int64_t) frame->samples * 1000000
+				/ ast_format_get_sample_rate(frame->subclass.format);
+		}
+		ast_frfree(frame);
+	}
+
+	ast_playtones_stop(chan);
+}
+
+static void *loadgen_call(void *data)
+{
+	char dialstring[sizeof(loadgen.dialstring)];
+	struct ast_channel *chan = NULL;
+	struct ast_dial *dial;
+	unsigned int hold;
+	char *device;
+
+	ast_mutex_lock(&loadgen_lock);
+	ast_copy_string(dialstring, loadgen.dialstring, sizeof(dialstring));
+	hold = loadgen.hold;
+	ast_mutex_unlock(&loadgen_lock);
+
+	device = strchr(dialstring, '/');
+	*device++ = '\0';
+
+	dial = ast_dial_create();
+	if (dial) {
+		struct timeval start;
+
+		ast_dial_set_global_timeout(dial, LOADGEN_DIAL_TIMEOUT);
+		start = ast_tvnow();
+		if (!ast_dial_append(dial, dialstring, device, NULL)
+			&& ast_dial_run(dial, NULL, 0) == AST_DIAL_RESULT_ANSWERED) {
+			chan = ast_dial_answered_steal(dial);
+			ast_histogram_record_since(setup_time, start);
+		}
+		ast_dial_destroy(dial);
+	}
+
+	if (chan) {
+		ast_mutex_lock(&loadgen_lock);
+		++loadgen.answered;
+		ast_mutex_unlock(&loadgen_lock);
+
+		loadgen_hold(chan, hold);
+		ast_hangup(chan);
+	}
+
+	ast_mutex_lock(&loadgen_lock);
+	if (chan) {
+		++loadgen.completed;
+	} else {
+		++loadgen.failed;
+	}
+	--loadgen.active;
+	ast_cond_broadcast(&loadgen_cond);
+	ast_mutex_unlock(&loadgen_lock);
+
+	return NULL;
+}
+
+/*! \brief Originate calls at the configured rate until the run ends */
+static void *loadgen_run(void *data)
+{
+	struct timeval end;
+	struct timeval next;
+
+	ast_mutex_lock(&loadgen_lock);
+	next = loadgen.start;
+	end = ast_tvadd(loadgen.start, ast_samp2tv(loadgen.duration, 1));
+
+	while (!loadgen.stop && ast_tvcmp(next, end) < 0) {
+		pthread_t thread;
+
+		if (ast_tvcmp(next, ast_tvnow()) > 0) {
+			struct timespec ts = {
+				.tv_sec = next.tv_sec,
+				.tv_nsec = next.tv_usec * 1000,
+			};
+
+			ast_cond_timedwait(&loadgen_cond, &loadgen_lock, &ts);
+			continue;
+		}
+
+		++loadgen.originated;
+		if (ast_pthread_create_detached(&thread, NULL, loadgen_call, NULL)) {
+			++loadgen.failed;
+		} else {
+			++loadgen.active;
+		}
+		next = ast_tvadd(next, ast_samp2tv(1, loadgen.rate));
+	}
+	loadgen.running = 0;
+	ast_mutex_unlock(&loadgen_lock);
+
+	return NULL;
+}
+
+/*!
+ * \brief Stop the current run and wait for its calls to end
+ * \note Call with loadgen_lock held.
+ */
+static void loadgen_stop(void)
+{
+	pthread_t thread = loadgen.thread;
+
+	if (thread == AST_PTHREADT_NULL) {
+		return;
+	}
+
+	if (loadgen.stop) {
+		/* Someone else is already stopping it. */
+		while (loadgen.thread != AST_PTHREADT_NULL) {
+			ast_cond_wait(&loadgen_cond, &loadgen_lock);
+		}
+		return;
+	}
+
+	loadgen.stop = 1;
+	ast_cond_broadcast(&loadgen_cond);
+	ast_mutex_unlock(&loadgen_lock);
+	pthread_join(thread, NULL);
+	ast_mutex_lock(&loadgen_lock);
+
+	while (loadgen.active) {
+		ast_cond_wait(&loadgen_cond, &loadgen_lock);
+	}
+	loadgen.thread = AST_PTHREADT_NULL;
+	loadgen.stop = 0;
+	ast_cond_broadcast(&loadgen_cond);
+}
+
+static char *handle_loadgen_start(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	unsigned int rate;
+	unsigned int duration;
+	unsigned int hold = LOADGEN_DEFAULT_HOLD;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "loadgen start";
+		e->usage =
+			"Usage: loadgen start <dialstring> <rate> <duration> [<hold>]\n"
+			"       Originate <rate> calls per second to <dialstring>, given as\n"
+			"       Tech/Device, for <duration> seconds.  Each answered call plays\n"
+			"       a tone for <hold> seconds, default 10, then hangs up.  Use a\n"
+			"       Local channel into a context that answers and echoes, or a\n"
+			"       PJSIP endpoint that loops back to this system.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 5 && a->argc != 6) {
+		return CLI_SHOWUSAGE;
+	}
+
+	if (!strchr(a->argv[2], '/')
+		|| ast_parse_arg(a->argv[3], PARSE_UINT32 | PARSE_IN_RANGE, &rate, 1, LOADGEN_MAX_RATE)
+		|| ast_parse_arg(a->argv[4], PARSE_UINT32 | PARSE_IN_RANGE, &duration, 1, 86400)
+		|| (a->argc == 6
+			&& ast_parse_arg(a->argv[5], PARSE_UINT32 | PARSE_IN_RANGE, &hold, 0, 86400))) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_mutex_lock(&loadgen_lock);
+	if (loadgen.thread != AST_PTHREADT_NULL) {
+		if (loadgen.stop || loadgen.running || loadgen.active) {
+			ast_mutex_unlock(&loadgen_lock);
+			ast_cli(a->fd, "A load run is already in progress\n");
+			return CLI_FAILURE;
+		}
+		/* The previous run has finished, reap it. */
+		loadgen_stop();
+	}
+
+	ast_copy_string(loadgen.dialstring, a->argv[2], sizeof(loadgen.dialstring));
+	loadgen.rate = rate;
+	loadgen.duration = duration;
+	loadgen.hold = hold;
+	loadgen.originated = 0;
+	loadgen.answered = 0;
+	loadgen.failed = 0;
+	loadgen.completed = 0;
+	loadgen.running = 1;
+	loadgen.start = ast_tvnow();
+	getrusage(RUSAGE_SELF, &loadgen.usage);
+
+	if (ast_pthread_create(&loadgen.thread, NULL, loadgen_run, NULL)) {
+		loadgen.thread = AST_PTHREADT_NULL;
+		loadgen.running = 0;
+		ast_mutex_unlock(&loadgen_lock);
+		ast_cli(a->fd, "Unable to start the load run\n");
+		return CLI_FAILURE;
+	}
+	ast_mutex_unlock(&loadgen_lock);
+
+	ast_cli(a->fd, "Originating %u calls per second to %s for %u seconds\n",
+		rate, a->argv[2], duration);
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_loadgen_stop(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "loadgen stop";
+		e->usage =
+			"Usage: loadgen stop\n"
+			"       Stop the current load run and hang up its calls.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 2) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_mutex_lock(&loadgen_lock);
+	loadgen_stop();
+	ast_mutex_unlock(&loadgen_lock);
+
+	return CLI_SUCCESS;
+}
+
+static char *handle_loadgen_show(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	struct rusage usage;
+	int64_t elapsed;
+	int64_t cpu;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "loadgen show stats";
+		e->usage =
+			"Usage: loadgen show stats\n"
+			"       Show the progress of the current or last load run.  CPU per\n"
+			"       call is the CPU time of the whole process since the run\n"
+			"       started, divided by the calls answered.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	ast_mutex_lock(&loadgen_lock);
+	if (ast_tvzero(loadgen.start)) {
+		ast_mutex_unlock(&loadgen_lock);
+		ast_cli(a->fd, "No load run has been started\n");
+		return CLI_SUCCESS;
+	}
+
+	elapsed = ast_tvdiff_ms(ast_tvnow(), loadgen.start);
+	cpu = ast_tvdiff_us(usage.ru_utime, loadgen.usage.ru_utime)
+		+ ast_tvdiff_us(usage.ru_stime, loadgen.usage.ru_stime);
+
+	ast_cli(a->fd, "Dial string: %s\n", loadgen.dialstring);
+	ast_cli(a->fd, "State:       %s\n",
+		loadgen.running || loadgen.active ? "Running" : "Finished");
+	ast_cli(a->fd, "Rate:        %u/s for %us, held %us\n",
+		loadgen.rate, loadgen.duration, loadgen.hold);
+	ast_cli(a->fd, "Elapsed:     %" PRId64 ".%03" PRId64 "s\n", elapsed / 1000, elapsed % 1000);
+	ast_cli(a->fd, "Originated:  %u\n", loadgen.originated);
+	ast_cli(a->fd, "Answered:    %u\n", loadgen.answered);
+	ast_cli(a->fd, "Failed:      %u\n", loadgen.failed);
+	ast_cli(a->fd, "Completed:   %u\n", loadgen.completed);
+	ast_cli(a->fd, "Active:      %u\n", loadgen.active);
+	ast_cli(a->fd, "CPU:         %" PRId64 ".%03" PRId64 "s", cpu / 1000000, cpu / 1000 % 1000);
+	if (loadgen.answered) {
+		ast_cli(a->fd, ", %" PRId64 "us per call", cpu / loadgen.answered);
+	}
+	ast_cli(a->fd, "\n");
+	ast_mutex_unlock(&loadgen_lock);
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_loadgen[] = {
+	AST_CLI_DEFINE(handle_loadgen_start, "Start originating synthetic calls"),
+	AST_CLI_DEFINE(handle_loadgen_stop, "Stop originating synthetic calls"),
+	AST_CLI_DEFINE(handle_loadgen_show, "Show synthetic call statistics"),
+};
+
+static int unload_module(void)
+{
+	ast_cli_unregister_multiple(cli_loadgen, ARRAY_LEN(cli_loadgen));
+
+	ast_mutex_lock(&loadgen_lock);
+	loadgen_stop();
+	ast_mutex_unlock(&loadgen_lock);
+
+	ao2_cleanup(setup_time);
+	setup_time = NULL;
+	ao2_cleanup(frame_jitter);
+	frame_jitter = NULL;
+	ast_cond_destroy(&loadgen_cond);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	ast_cond_init(&loadgen_cond, NULL);
+
+	setup_time = ast_histogram_get("loadgen_call_setup",
+		"Time from originating a synthetic call until it is answered", NULL, NULL);
+	frame_jitter = ast_histogram_get("loadgen_frame_jitter",
+		"Deviation of synthetic call audio frames from their expected arrival", NULL, NULL);
+
+	if (ast_cli_register_multiple(cli_loadgen, ARRAY_LEN(cli_loadgen))) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD_EXTENDED(ASTERISK_GPL_KEY, "Synthetic Call Load Generator");
@@ -0,0 +1,399 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Direct routes for out-of-call messages
+ *
+ * This module routes out-of-call messages straight to a message
+ * technology from a table of routes, without running the dialplan on a
+ * message channel.
+ */
+
+/*! \li \ref res_message_routes.c uses the configuration file \ref message_routes.conf
+ * \addtogroup configuration_file Configuration Files
+ */
+
+/*!
+ * \page message_routes.conf message_routes.conf
+ * \verbinclude message_routes.conf.sample
+ */
+
+/*** MODULEINFO
+	<support_level>extended</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/module.h"
+#include "asterisk/config.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/message.h"
+#include "asterisk/pbx.h"
+#include "asterisk/strings.h"
+#include "asterisk/vector.h"
+
+/*! Configuration file used for this module */
+static const char config_file[] = "message_routes.conf";
+
+/*! Number of buckets for the routes of a context */
+#define ROUTE_BUCKETS 127
+
+/*! Number of buckets for the contexts */
+#define CONTEXT_BUCKETS 17
+
+/*! \brief A route of the messages to an extension */
+struct message_route {
+	/*! Where the messages are sent, may contain ${EXTEN} */
+	char *destination;
+	/*! The from of the messages if set, may contain ${EXTEN} */
+	char *from;
+	/*! The extension or extension pattern routed */
+	char exten[0];
+};
+
+/*! \brief The routes of a message context */
+struct message_route_context {
+	/*! Routes of single extensions, by extension */
+	struct ao2_container *extens;
+	/*! Routes of extension patterns, in the order they are tried */
+	AST_VECTOR(, struct message_route *) patterns;
+	/*! Name of the context */
+	char name[0];
+};
+
+/*! \brief The route table, a container of contexts, replaced on reload */
+static AO2_GLOBAL_OBJ_STATIC(message_routes);
+
+AO2_STRING_FIELD_HASH_FN(message_route, exten);
+AO2_STRING_FIELD_CMP_FN(message_route, exten);
+AO2_STRING_FIELD_HASH_FN(message_route_context, name);
+AO2_STRING_FIELD_CMP_FN(message_route_context, name);
+
+static void message_route_destroy(void *obj)
+{
+	struct message_route *route = obj;
+
+	ast_free(route->destination);
+	ast_free(route->from);
+}
+
+static void message_route_context_destroy(void *obj)
+{
+	struct message_route_context *context = obj;
+
+	ao2_cleanup(context->extens);
+	AST_VECTOR_CALLBACK_VOID(&context->patterns, ao2_ref, -1);
+	AST_VECTOR_FREE(&context->patterns);
+}
+
+static struct message_route_context *message_route_context_alloc(const char *name)
+{
+	struct message_route_context *context;
+
+	context = ao2_alloc_options(sizeof(*context) + strlen(name) + 1,
+		message_route_context_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!context) {
+		return NULL;
+	}
+	strcpy(context->name, name); /* Safe */
+
+	if (AST_VECTOR_INIT(&context->patterns, 0)) {
+		ao2_ref(context, -1);
+		return NULL;
+	}
+
+	context->extens = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, ROUTE_BUCKETS,
+		message_route_hash_fn, NULL, message_route_cmp_fn);
+	if (!context->extens) {
+		ao2_ref(context, -1);
+		return NULL;
+	}
+
+	return context;
+}
+
+/*!
+ * \internal
+ * \brief Build a route from an "exten => destination[,from]" line
+ */
+static struct message_route *message_route_alloc(const char *exten, const char *value)
+{
+	struct message_route *route;
+	char *parse = ast_strdupa(value);
+	char *destination;
+	char *from;
+
+	destination = ast_strip(strsep(&parse, ","));
+	from = parse ? ast_strip(parse) : NULL;
+	if (ast_strlen_zero(destination) || !strchr(destination, ':')) {
+		ast_log(LOG_WARNING, "Route of '%s' needs a destination of the form tech:uri\n", exten);
+		return NULL;
+	}
+
+	route = ao2_alloc_options(sizeof(*route) + strlen(exten) + 1,
+		message_route_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!route) {
+		return NULL;
+	}
+	strcpy(route->exten, exten); /* Safe */
+
+	route->destination = ast_strdup(destination);
+	if (!ast_strlen_zero(from)) {
+		route->from = ast_strdup(from);
+	}
+	if (!route->destination || (!ast_strlen_zero(from) && !route->from)) {
+		ao2_ref(route, -1);
+		return NULL;
+	}
+
+	return route;
+}
+
+/*!
+ * \internal
+ * \brief Find the route of a message
+ *
+ * \return A reference to the route, or NULL if the message has none
+ */
+static struct message_route *message_route_find(const struct ast_msg *msg)
+{
+	struct ao2_container *routes;
+	struct message_route_context *context;
+	struct message_route *route;
+	const char *exten = S_OR(ast_msg_get_exten(msg), "s");
+	int i;
+
+	if (ast_strlen_zero(ast_msg_get_context(msg))) {
+		return NULL;
+	}
+
+	routes = ao2_global_obj_ref(message_routes);
+	if (!routes) {
+		return NULL;
+	}
+
+	context = ao2_find(routes, ast_msg_get_context(msg), OBJ_SEARCH_KEY);
+	ao2_ref(routes, -1);
+	if (!context) {
+		return NULL;
+	}
+
+	route = ao2_find(context->extens, exten, OBJ_SEARCH_KEY);
+	for (i = 0; !route && i < AST_VECTOR_SIZE(&context->patterns); ++i) {
+		struct message_route *pattern = AST_VECTOR_GET(&context->patterns, i);
+
+		if (ast_extension_match(pattern->exten, exten)) {
+			route = ao2_bump(pattern);
+		}
+	}
+	ao2_ref(context, -1);
+
+	return route;
+}
+
+/*!
+ * \internal
+ * \brief Replace ${EXTEN} in a route string with the extension of the message
+ */
+static char *message_route_substitute(const char *template, const char *exten)
+{
+	static const char token[] = "${EXTEN}";
+	struct ast_str *buf;
+	const char *pos;
+	char *res;
+
+	buf = ast_str_create(128);
+	if (!buf) {
+		return NULL;
+	}
+
+	while ((pos = strstr(template, token))) {
+		ast_str_append_substr(&buf, 0, template, pos - template);
+		ast_str_append(&buf, 0, "%s", exten);
+		template = pos + strlen(token);
+	}
+	ast_str_append(&buf, 0, "%s", template);
+
+	res = ast_strdup(ast_str_buffer(buf));
+	ast_free(buf);
+
+	return res;
+}
+
+static int message_routes_handle_msg(struct ast_msg *msg)
+{
+	struct message_route *route;
+	const char *exten = S_OR(ast_msg_get_exten(msg), "s");
+	char *destination;
+	char *from = NULL;
+	int res = -1;
+
+	route = message_route_find(msg);
+	if (!route) {
+		return -1;
+	}
+
+	destination = message_route_substitute(route->destination, exten);
+	if (route->from) {
+		from = message_route_substitute(route->from, exten);
+	}
+
+	if (destination && (!route->from || from)) {
+		ast_debug(3, "Routing message to '%s@%s' directly to '%s'\n",
+			exten, ast_msg_get_context(msg), destination);
+
+		/* ast_msg_send() takes the reference */
+		res = ast_msg_send(ast_msg_ref(msg), destination, from);
+		if (res) {
+			ast_log(LOG_WARNING, "Could not send message to '%s@%s' to '%s'\n",
+				exten, ast_msg_get_context(msg), destination);
+		}
+	}
+
+	ast_free(destination);
+	ast_free(from);
+	ao2_ref(route, -1);
+
+	return res;
+}
+
+static int message_routes_has_destination(const struct ast_msg *msg)
+{
+	struct message_route *route;
+
+	route = message_route_find(msg);
+	ao2_cleanup(route);
+
+	return route != NULL;
+}
+
+static struct ast_msg_handler message_routes_handler = {
+	.name = "routes",
+	.handle_msg = message_routes_handle_msg,
+	.has_destination = message_routes_has_destination,
+};
+
+/*!
+ * \internal
+ * \brief Build the route table from the configuration file
+ *
+ * \retval 0 on success or if the file did not change
+ * \retval -1 on failure, the current route table is kept
+ */
+static int load_config(int reload)
+{
+	struct ast_config *cfg;
+	struct ast_flags config_flags = { reload ? CONFIG_FLAG_FILEUNCHANGED : 0 };
+	struct ao2_container *routes;
+	const char *category = NULL;
+	int total = 0;
+
+	cfg = ast_config_load(config_file, config_flags);
+	if (cfg == CONFIG_STATUS_FILEUNCHANGED) {
+		return 0;
+	}
+	if (cfg == CONFIG_STATUS_FILEINVALID) {
+		ast_log(LOG_ERROR, "Config file '%s' is invalid, keeping the current routes\n", config_file);
+		return -1;
+	}
+
+	routes = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, CONTEXT_BUCKETS,
+		message_route_context_hash_fn, NULL, message_route_context_cmp_fn);
+	if (!routes) {
+		ast_config_destroy(cfg);
+		return -1;
+	}
+
+	while (cfg && (category = ast_category_browse(cfg, category))) {
+		struct message_route_context *context;
+		struct ast_variable *var;
+
+		context = message_route_context_alloc(category);
+		if (!context) {
+			break;
+		}
+
+		for (var = ast_variable_browse(cfg, category); var; var = var->next) {
+			struct message_route *route;
+
+			route = message_route_alloc(var->name, var->value);
+			if (!route) {
+				continue;
+			}
+
+			if (var->name[0] == '_') {
+				if (AST_VECTOR_APPEND(&context->patterns, route)) {
+					ao2_ref(route, -1);
+					continue;
+				}
+			} else {
+				ao2_link(context->extens, route);
+				ao2_ref(route, -1);
+			}
+			++total;
+		}
+
+		ao2_link(routes, context);
+		ao2_ref(context, -1);
+	}
+
+	if (cfg) {
+		ast_config_destroy(cfg);
+	}
+
+	ao2_global_obj_replace_unref(message_routes, routes);
+	ao2_ref(routes, -1);
+
+	ast_verb(3, "Loaded %d direct message routes\n", total);
+
+	return 0;
+}
+
+static int reload_module(void)
+{
+	return load_config(1);
+}
+
+static int unload_module(void)
+{
+	ast_msg_handler_unregister(&message_routes_handler);
+	ao2_global_obj_release(message_routes);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	if (load_config(0)) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	if (ast_msg_handler_register(&message_routes_handler)) {
+		ao2_global_obj_release(message_routes);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_LOAD_ORDER, "Direct Message Routes",
+	.support_level = AST_MODULE_SUPPORT_EXTENDED,
+	.load = load_module,
+	.unload = unload_module,
+	.reload = reload_module,
+	.load_pri = AST_MODPRI_DEFAULT,
+);
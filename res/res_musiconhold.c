@@ -152,6 +152,7 @@ struct moh_files_state {
 #define MOH_CACHERTCLASSES	(1 << 5)	/*!< Should we use a separate instance of MOH for each user or not */
 #define MOH_ANNOUNCEMENT	(1 << 6)	/*!< Do we play announcement files between songs on this channel? */
 #define MOH_PREFERCHANNELCLASS	(1 << 7)	/*!< Should queue moh override channel moh */
+#define MOH_BROADCAST		(1 << 8)	/*!< Do all channels on a files class share one timeline? */
 
 /* Custom astobj2 flag */
 #define MOH_NOTDELETED          (1 << 30)       /*!< Find only records that aren't deleted? */
@@ -164,6 +165,18 @@ enum kill_methods {
 	KILL_METHOD_PROCESS
 };
 
+/*! \brief A codec the timeline of a broadcast class is encoded to */
+struct moh_broadcast_output {
+	/*! The format member channels are written in */
+	struct ast_format *format;
+	/*! The format of the file the translation path was built from */
+	struct ast_format *source;
+	/*! Translation path from the file format, NULL if none is needed */
+	struct ast_trans_pvt *trans;
+	/*! Number of member channels fed from this output */
+	unsigned int users;
+};
+
 struct mohclass {
 	char name[MAX_MUSICCLASS];
 	char dir[256];
@@ -191,6 +204,14 @@ struct mohclass {
 	/*! Created on the fly, from RT engine */
 	unsigned int realtime:1;
 	unsigned int delete:1;
+	/*! Set to ask the broadcast thread to exit */
+	int broadcast_stop;
+	/*! Set once the broadcast thread is running */
+	unsigned int broadcasting:1;
+	/*! Set if the class could not be broadcast */
+	unsigned int broadcast_failed:1;
+	/*! Codecs the broadcast timeline is encoded to, indexed by mohdata output */
+	AST_VECTOR(, struct moh_broadcast_output) outputs;
 	AST_LIST_HEAD_NOLOCK(, mohdata) members;
 	AST_LIST_ENTRY(mohclass) list;
 };
@@ -200,6 +221,12 @@ struct mohdata {
 	struct ast_format *origwfmt;
 	struct mohclass *parent;
 	struct ast_frame f;
+	/*! Index of the class output a broadcast member is fed from */
+	int output;
+	/*! Number of samples in the queued broadcast frames */
+	int queued;
+	/*! Frames queued for a broadcast member by the class thread */
+	AST_LIST_HEAD_NOLOCK(, ast_frame) frames;
 	AST_LIST_ENTRY(mohdata) list;
 };
 
@@ -579,6 +606,7 @@ static struct ast_generator moh_file_stream = {
 	.generate = moh_files_generator,
 	.digit    = moh_handle_digit,
 	.write_format_change = moh_files_write_format_change,
+	.shareable = 1,
 };
 
 static int spawn_mp3(struct mohclass *class)
@@ -1087,6 +1115,410 @@ static struct ast_generator mohgen = {
 	.release  = moh_release,
 	.generate = moh_generate,
 	.digit    = moh_handle_digit,
+	.shareable = 1,
+};
+
+/*! Length of the timeline slice the broadcast thread reads per tick */
+#define MOH_BROADCAST_MS		20
+/*! Most audio queued for one broadcast member before the oldest is dropped */
+#define MOH_BROADCAST_QUEUE_MS	200
+/*! How long to wait before retrying once no file of a broadcast class opens */
+#define MOH_BROADCAST_RETRY_MS	1000
+
+struct moh_broadcast_lookup {
+	const char *base;
+	size_t base_len;
+	char ext[32];
+};
+
+static int moh_broadcast_on_file(const char *directory, const char *filename, void *obj)
+{
+	struct moh_broadcast_lookup *lookup = obj;
+	const char *ext;
+
+	if (strncmp(filename, lookup->base, lookup->base_len) || filename[lookup->base_len] != '.') {
+		return 0;
+	}
+
+	ext = filename + lookup->base_len + 1;
+	if (!ast_get_format_for_file_ext(ext)) {
+		return 0;
+	}
+
+	ast_copy_string(lookup->ext, ext, sizeof(lookup->ext));
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Open a file of a class without a channel to pick the format for
+ *
+ * \param name Absolute path of the file without an extension
+ *
+ * \return The stream of the first format found for the file, or NULL
+ */
+static struct ast_filestream *moh_broadcast_open(const char *name)
+{
+	struct moh_broadcast_lookup lookup = { 0, };
+	char *dir = ast_strdupa(name);
+	char *base = strrchr(dir, '/');
+
+	if (!base) {
+		return NULL;
+	}
+	*base++ = '\0';
+
+	lookup.base = base;
+	lookup.base_len = strlen(base);
+	ast_file_read_dir(S_OR(dir, "/"), moh_broadcast_on_file, &lookup);
+	if (ast_strlen_zero(lookup.ext)) {
+		return NULL;
+	}
+
+	return ast_readfile(name, lookup.ext, NULL, O_RDONLY, 0, 0);
+}
+
+static struct ast_filestream *moh_broadcast_next(struct mohclass *class, int *pos)
+{
+	struct ast_filestream *fs = NULL;
+	struct ast_vector_string *files;
+	size_t file_count;
+	int tries;
+
+	ao2_lock(class);
+	files = ao2_bump(class->files);
+	ao2_unlock(class);
+
+	file_count = AST_VECTOR_SIZE(files);
+	if (!file_count) {
+		ao2_ref(files, -1);
+		return NULL;
+	}
+
+	if (ast_test_flag(class, MOH_SORTMODE) == MOH_RANDOMIZE) {
+		*pos = ast_random() % file_count;
+	} else {
+		*pos = (*pos + 1) % file_count;
+	}
+
+	for (tries = 0; tries < file_count; ++tries) {
+		if ((fs = moh_broadcast_open(AST_VECTOR_GET(files, *pos)))) {
+			ast_debug(1, "Broadcasting file %d '%s' on class '%s'\n", *pos,
+				AST_VECTOR_GET(files, *pos), class->name);
+			break;
+		}
+
+		ast_log(LOG_WARNING, "Unable to open file '%s' for class '%s'\n",
+			AST_VECTOR_GET(files, *pos), class->name);
+		*pos = (*pos + 1) % file_count;
+	}
+
+	ao2_ref(files, -1);
+	return fs;
+}
+
+static void moh_broadcast_queue(struct mohdata *moh, struct ast_frame *f, int max_samples)
+{
+	AST_LIST_INSERT_TAIL(&moh->frames, f, frame_list);
+	moh->queued += f->samples;
+
+	/* A member that stopped pulling frames must not hold on to the whole timeline */
+	while (moh->queued > max_samples && (f = AST_LIST_REMOVE_HEAD(&moh->frames, frame_list))) {
+		moh->queued -= f->samples;
+		ast_frfree(f);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Encode a frame of the timeline once per output and hand it to the members
+ *
+ * \note The class must be locked.
+ */
+static void moh_broadcast_fanout(struct mohclass *class, struct ast_frame *f)
+{
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&class->outputs); ++i) {
+		struct moh_broadcast_output *output = AST_VECTOR_GET_ADDR(&class->outputs, i);
+		struct ast_frame *out;
+		struct ast_frame *cur;
+		int max_samples;
+
+		if (!output->users) {
+			continue;
+		}
+
+		if (ast_format_cmp(output->format, f->subclass.format) == AST_FORMAT_CMP_EQUAL) {
+			out = f;
+		} else {
+			if (!output->source || ast_format_cmp(output->source, f->subclass.format) != AST_FORMAT_CMP_EQUAL) {
+				if (output->trans) {
+					ast_translator_free_path(output->trans);
+				}
+				ao2_replace(output->source, f->subclass.format);
+				output->trans = ast_translator_build_path(output->format, f->subclass.format);
+				if (!output->trans) {
+					ast_log(LOG_WARNING, "Unable to translate '%s' to '%s' for class '%s'\n",
+						ast_format_get_name(f->subclass.format),
+						ast_format_get_name(output->format), class->name);
+				}
+			}
+			if (!output->trans || !(out = ast_translate(output->trans, f, 0))) {
+				continue;
+			}
+		}
+
+		max_samples = ast_format_get_sample_rate(output->format) * MOH_BROADCAST_QUEUE_MS / 1000;
+		for (cur = out; cur; cur = AST_LIST_NEXT(cur, frame_list)) {
+			struct ast_frame *shared = ast_frshare(cur);
+			struct mohdata *moh;
+
+			if (!shared) {
+				break;
+			}
+
+			AST_LIST_TRAVERSE(&class->members, moh, list) {
+				struct ast_frame *copy;
+
+				if (moh->output != i || !(copy = ast_frshare(shared))) {
+					continue;
+				}
+				moh_broadcast_queue(moh, copy, max_samples);
+			}
+			ast_frfree(shared);
+		}
+
+		if (out != f) {
+			ast_frfree(out);
+		}
+	}
+}
+
+static void *moh_broadcast_thread(void *data)
+{
+	struct mohclass *class = data;
+	struct pollfd pfd = { .fd = ast_timer_fd(class->timer), .events = POLLIN | POLLPRI, };
+	struct ast_filestream *fs = NULL;
+	int pos = -1;
+	int due = 0;
+
+	if (ast_test_flag(class, MOH_RANDOMIZE)) {
+		ao2_lock(class);
+		if (AST_VECTOR_SIZE(class->files)) {
+			pos = ast_random() % AST_VECTOR_SIZE(class->files) - 1;
+		}
+		ao2_unlock(class);
+	}
+
+	while (!class->broadcast_stop) {
+		int idle;
+
+		/* Wake up now and then so a stop request is noticed even if the timer stalls */
+		if (ast_poll(&pfd, 1, 5 * MOH_BROADCAST_MS) <= 0) {
+			continue;
+		}
+		if (ast_timer_ack(class->timer, 1) < 0) {
+			ast_log(LOG_ERROR, "Failed to acknowledge timer for class '%s'\n", class->name);
+			break;
+		}
+
+		ao2_lock(class);
+		idle = AST_LIST_EMPTY(&class->members);
+		ao2_unlock(class);
+
+		/* Nobody is listening so the timeline does not need to advance */
+		if (idle) {
+			due = 0;
+			continue;
+		}
+
+		due += MOH_BROADCAST_MS;
+		while (due > 0) {
+			struct ast_frame *f = fs ? ast_readframe(fs) : NULL;
+
+			if (!f) {
+				if (fs) {
+					ast_closestream(fs);
+				}
+				if (!(fs = moh_broadcast_next(class, &pos))) {
+					due = -MOH_BROADCAST_RETRY_MS;
+				}
+				continue;
+			}
+
+			if (f->frametype == AST_FRAME_VOICE && f->samples) {
+				due -= f->samples * 1000 / ast_format_get_sample_rate(f->subclass.format);
+				ao2_lock(class);
+				moh_broadcast_fanout(class, f);
+				ao2_unlock(class);
+			}
+			ast_frfree(f);
+		}
+	}
+
+	if (fs) {
+		ast_closestream(fs);
+	}
+
+	return NULL;
+}
+
+static void moh_broadcast_release(struct ast_channel *chan, void *data)
+{
+	struct mohdata *moh = data;
+	struct mohclass *class = moh->parent;
+	struct moh_broadcast_output *output;
+	struct ast_format *oldwfmt;
+	struct ast_frame *f;
+
+	ao2_lock(class);
+	AST_LIST_REMOVE(&class->members, moh, list);
+	output = AST_VECTOR_GET_ADDR(&class->outputs, moh->output);
+	if (!--output->users && output->trans) {
+		/* Do not let the next listener inherit a stale encoder state */
+		ast_translator_free_path(output->trans);
+		output->trans = NULL;
+		ao2_replace(output->source, NULL);
+	}
+	ao2_unlock(class);
+
+	while ((f = AST_LIST_REMOVE_HEAD(&moh->frames, frame_list))) {
+		ast_frfree(f);
+	}
+
+	oldwfmt = moh->origwfmt;
+
+	moh->parent = class = mohclass_unref(class, "unreffing moh->parent upon deactivation of generator");
+
+	ast_free(moh);
+
+	if (chan) {
+		struct moh_files_state *state;
+
+		state = ast_channel_music_state(chan);
+		if (state && state->class) {
+			state->class = mohclass_unref(state->class, "Unreffing channel's music class upon deactivation of generator");
+		}
+		if (oldwfmt && ast_set_write_format(chan, oldwfmt)) {
+			ast_log(LOG_WARNING, "Unable to restore channel '%s' to format %s\n",
+					ast_channel_name(chan), ast_format_get_name(oldwfmt));
+		}
+
+		moh_post_stop(chan);
+	}
+
+	ao2_cleanup(oldwfmt);
+}
+
+static void *moh_broadcast_alloc(struct ast_channel *chan, void *params)
+{
+	struct mohdata *moh;
+	struct mohclass *class = params;
+	struct moh_files_state *state;
+	struct ast_format *format;
+	int i;
+
+	/* Initiating music_state for current channel. Channel should know name of moh class */
+	state = ast_channel_music_state(chan);
+	if (!state && (state = ast_calloc(1, sizeof(*state)))) {
+		ast_channel_music_state_set(chan, state);
+		ast_module_ref(ast_module_info->self);
+	} else {
+		if (!state) {
+			return NULL;
+		}
+		if (state->class) {
+			mohclass_unref(state->class, "Uh Oh. Restarting MOH with an active class");
+			ast_log(LOG_WARNING, "Uh Oh. Restarting MOH with an active class\n");
+		}
+		ao2_cleanup(state->origwfmt);
+		ao2_cleanup(state->mohwfmt);
+		memset(state, 0, sizeof(*state));
+	}
+
+	if (!(moh = ast_calloc(1, sizeof(*moh)))) {
+		return NULL;
+	}
+	moh->pipe[0] = moh->pipe[1] = -1;
+
+	/* Writing in the native format lets the channel pass the shared frames straight through */
+	format = ast_channel_rawwriteformat(chan);
+	moh->origwfmt = ao2_bump(ast_channel_writeformat(chan));
+	if (ast_set_write_format(chan, format)) {
+		ast_log(LOG_WARNING, "Unable to set channel '%s' to format '%s'\n", ast_channel_name(chan),
+			ast_format_get_name(format));
+		ao2_cleanup(moh->origwfmt);
+		ast_free(moh);
+		return NULL;
+	}
+
+	ao2_lock(class);
+	for (i = 0; i < AST_VECTOR_SIZE(&class->outputs); ++i) {
+		if (ast_format_cmp(AST_VECTOR_GET_ADDR(&class->outputs, i)->format, format) == AST_FORMAT_CMP_EQUAL) {
+			break;
+		}
+	}
+	if (i == AST_VECTOR_SIZE(&class->outputs)) {
+		struct moh_broadcast_output output = { .format = ao2_bump(format), };
+
+		if (AST_VECTOR_APPEND(&class->outputs, output)) {
+			ao2_unlock(class);
+			ao2_ref(output.format, -1);
+			if (moh->origwfmt && ast_set_write_format(chan, moh->origwfmt)) {
+				ast_log(LOG_WARNING, "Unable to restore channel '%s' to format %s\n",
+					ast_channel_name(chan), ast_format_get_name(moh->origwfmt));
+			}
+			ao2_cleanup(moh->origwfmt);
+			ast_free(moh);
+			return NULL;
+		}
+	}
+	AST_VECTOR_GET_ADDR(&class->outputs, i)->users++;
+	moh->output = i;
+	moh->parent = mohclass_ref(class, "Reffing music class for mohdata parent");
+	AST_LIST_INSERT_HEAD(&class->members, moh, list);
+	ao2_unlock(class);
+
+	state->class = mohclass_ref(class, "Placing reference into state container");
+	moh_post_start(chan, class->name);
+
+	return moh;
+}
+
+static int moh_broadcast_generate(struct ast_channel *chan, void *data, int len, int samples)
+{
+	struct mohdata *moh = data;
+	AST_LIST_HEAD_NOLOCK(, ast_frame) frames = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
+	struct ast_frame *f;
+	int res = 0;
+
+	ao2_lock(moh->parent);
+	while (samples > 0 && (f = AST_LIST_REMOVE_HEAD(&moh->frames, frame_list))) {
+		moh->queued -= f->samples;
+		samples -= f->samples;
+		AST_LIST_INSERT_TAIL(&frames, f, frame_list);
+	}
+	ao2_unlock(moh->parent);
+
+	/* Write with the class unlocked, ast_write() may block on the channel */
+	while ((f = AST_LIST_REMOVE_HEAD(&frames, frame_list))) {
+		if (!res && ast_write(chan, f) < 0) {
+			ast_log(LOG_WARNING, "Failed to write frame to '%s': %s\n", ast_channel_name(chan), strerror(errno));
+			res = -1;
+		}
+		ast_frfree(f);
+	}
+
+	return res;
+}
+
+static struct ast_generator moh_broadcast_gen = {
+	.alloc    = moh_broadcast_alloc,
+	.release  = moh_broadcast_release,
+	.generate = moh_broadcast_generate,
+	.digit    = moh_handle_digit,
+	.shareable = 1,
 };
 
 static void moh_file_vector_destructor(void *obj)
@@ -1170,6 +1602,8 @@ static void moh_parse_options(struct ast_variable *var, struct mohclass *mohclas
 			} else if (!strcasecmp(var->value, "randstart")) {
 				ast_set_flag(mohclass, MOH_RANDSTART);
 			}
+		} else if (!strcasecmp(var->name, "broadcast")) {
+			ast_set2_flag(mohclass, ast_true(var->value), MOH_BROADCAST);
 		} else if (!strcasecmp(var->name, "format") && !ast_strlen_zero(var->value)) {
 			ao2_cleanup(mohclass->format);
 			mohclass->format = ast_format_cache_get(var->value);
@@ -1333,6 +1767,81 @@ static int init_files_class(struct mohclass *class)
 	return 0;
 }
 
+/*!
+ * \internal
+ * \brief Start the thread that plays a broadcast class for all of its channels
+ *
+ * A class that cannot be broadcast is still played, just with a
+ * file stream per channel.
+ */
+static void init_broadcast_class(struct mohclass *class)
+{
+	int i;
+
+	ao2_lock(class);
+	for (i = 0; i < AST_VECTOR_SIZE(class->files); ++i) {
+		if (strstr(AST_VECTOR_GET(class->files, i), "://")) {
+			break;
+		}
+	}
+	ao2_unlock(class);
+
+	class->broadcast_failed = 1;
+
+	if (i < AST_VECTOR_SIZE(class->files)) {
+		ast_log(LOG_WARNING, "Class '%s' has remote playlist entries and cannot be broadcast\n", class->name);
+		return;
+	}
+
+	if (!(class->timer = ast_timer_open())) {
+		ast_log(LOG_WARNING, "Unable to create timer: %s\n", strerror(errno));
+		return;
+	}
+	if (ast_timer_set_rate(class->timer, 1000 / MOH_BROADCAST_MS)) {
+		ast_log(LOG_WARNING, "Unable to set %dms frame rate: %s\n", MOH_BROADCAST_MS, strerror(errno));
+		ast_timer_close(class->timer);
+		class->timer = NULL;
+		return;
+	}
+
+	if (ast_pthread_create_background(&class->thread, NULL, moh_broadcast_thread, class)) {
+		ast_log(LOG_WARNING, "Unable to create moh thread...\n");
+		ast_timer_close(class->timer);
+		class->timer = NULL;
+		return;
+	}
+
+	class->broadcast_failed = 0;
+	class->broadcasting = 1;
+}
+
+/*!
+ * \internal
+ * \brief Whether the channels of a class can be fed from its broadcast thread
+ *
+ * \param shared Set to start the thread of a class without the broadcast
+ *        option on the first shared start.
+ */
+static int moh_class_broadcast(struct mohclass *class, int shared)
+{
+	int res;
+
+	if (!ast_test_flag(class, MOH_BROADCAST)
+		&& (!shared || (class->realtime && !ast_test_flag(global_flags, MOH_CACHERTCLASSES)))) {
+		/* An uncached realtime class lives only as long as its channel */
+		return 0;
+	}
+
+	ao2_lock(class);
+	if (shared && !class->broadcasting && !class->broadcast_failed) {
+		init_broadcast_class(class);
+	}
+	res = class->broadcasting;
+	ao2_unlock(class);
+
+	return res;
+}
+
 static void moh_rescan_files(void) {
 	struct ao2_iterator i;
 	struct mohclass *c;
@@ -1436,6 +1945,9 @@ static int _moh_register(struct mohclass *moh, int reload, int unref, const char
 			}
 			return -1;
 		}
+		if (ast_test_flag(moh, MOH_BROADCAST)) {
+			init_broadcast_class(moh);
+		}
 	} else if (!strcasecmp(moh->mode, "playlist")) {
 		size_t file_count;
 
@@ -1449,6 +1961,9 @@ static int _moh_register(struct mohclass *moh, int reload, int unref, const char
 			}
 			return -1;
 		}
+		if (ast_test_flag(moh, MOH_BROADCAST)) {
+			init_broadcast_class(moh);
+		}
 	} else if (!strcasecmp(moh->mode, "mp3") || !strcasecmp(moh->mode, "mp3nb") ||
 			!strcasecmp(moh->mode, "quietmp3") || !strcasecmp(moh->mode, "quietmp3nb") ||
 			!strcasecmp(moh->mode, "httpmp3") || !strcasecmp(moh->mode, "custom")) {
@@ -1648,7 +2163,7 @@ static struct ast_variable *load_realtime_musiconhold(const char *name)
 	return var;
 }
 
-static int local_ast_moh_start(struct ast_channel *chan, const char *mclass, const char *interpclass)
+static int moh_start(struct ast_channel *chan, const char *mclass, const char *interpclass, int shared)
 {
 	struct mohclass *mohclass = NULL;
 	struct moh_files_state *state = ast_channel_music_state(chan);
@@ -1857,7 +2372,9 @@ static int local_ast_moh_start(struct ast_channel *chan, const char *mclass, con
 		file_count = AST_VECTOR_SIZE(mohclass->files);
 		ao2_unlock(mohclass);
 
-		if (file_count) {
+		if (file_count && moh_class_broadcast(mohclass, shared)) {
+			res = ast_activate_generator(chan, &moh_broadcast_gen, mohclass);
+		} else if (file_count) {
 			res = ast_activate_generator(chan, &moh_file_stream, mohclass);
 		} else {
 			res = ast_activate_generator(chan, &mohgen, mohclass);
@@ -1875,6 +2392,16 @@ static int local_ast_moh_start(struct ast_channel *chan, const char *mclass, con
 	return res;
 }
 
+static int local_ast_moh_start(struct ast_channel *chan, const char *mclass, const char *interpclass)
+{
+	return moh_start(chan, mclass, interpclass, 0);
+}
+
+static int local_ast_moh_start_shared(struct ast_channel *chan, const char *mclass, const char *interpclass)
+{
+	return moh_start(chan, mclass, interpclass, 1);
+}
+
 static void local_ast_moh_stop(struct ast_channel *chan)
 {
 	ast_deactivate_generator(chan);
@@ -1890,6 +2417,15 @@ static void local_ast_moh_stop(struct ast_channel *chan)
 	ast_channel_unlock(chan);
 }
 
+static void moh_broadcast_output_cleanup(struct moh_broadcast_output output)
+{
+	if (output.trans) {
+		ast_translator_free_path(output.trans);
+	}
+	ao2_cleanup(output.source);
+	ao2_cleanup(output.format);
+}
+
 static void moh_class_destructor(void *obj)
 {
 	struct mohclass *class = obj;
@@ -1898,11 +2434,20 @@ static void moh_class_destructor(void *obj)
 
 	ast_debug(1, "Destroying MOH class '%s'\n", class->name);
 
+	/* The broadcast thread reads files, so let it close them rather than cancel it */
+	if (class->broadcasting && class->thread != AST_PTHREADT_NULL && class->thread != 0) {
+		class->broadcast_stop = 1;
+		pthread_join(class->thread, NULL);
+		class->thread = AST_PTHREADT_NULL;
+	}
+
 	ao2_lock(class);
 	while ((member = AST_LIST_REMOVE_HEAD(&class->members, list))) {
 		ast_free(member);
 	}
 	ao2_cleanup(class->files);
+	AST_VECTOR_RESET(&class->outputs, moh_broadcast_output_cleanup);
+	AST_VECTOR_FREE(&class->outputs);
 	ao2_unlock(class);
 
 	/* Kill the thread first, so it cannot restart the child process while the
@@ -2172,6 +2717,9 @@ static char *handle_cli_moh_show_classes(struct ast_cli_entry *e, int cmd, struc
 			ast_cli(a->fd, "\tKill Method: %s\n",
 				class->kill_method == KILL_METHOD_PROCESS ? "process" : "process_group");
 		}
+		if (ast_test_flag(class, MOH_BROADCAST)) {
+			ast_cli(a->fd, "\tBroadcast: %s\n", class->timer ? "yes" : "no (unavailable)");
+		}
 		if (strcasecmp(class->mode, "files")) {
 			ast_cli(a->fd, "\tFormat: %s\n", ast_format_get_name(class->format));
 		}
@@ -2228,8 +2776,8 @@ static int load_module(void)
 		ast_log(LOG_WARNING, "No music on hold classes configured, "
 				"disabling music on hold.\n");
 	} else {
-		ast_install_music_functions(local_ast_moh_start, local_ast_moh_stop,
-				local_ast_moh_cleanup);
+		ast_install_music_functions(local_ast_moh_start, local_ast_moh_start_shared,
+				local_ast_moh_stop, local_ast_moh_cleanup);
 	}
 
 	res = ast_register_application_xml(play_moh, play_moh_exec);
@@ -2246,8 +2794,8 @@ static int load_module(void)
 static int reload(void)
 {
 	if (load_moh_classes(1)) {
-		ast_install_music_functions(local_ast_moh_start, local_ast_moh_stop,
-				local_ast_moh_cleanup);
+		ast_install_music_functions(local_ast_moh_start, local_ast_moh_start_shared,
+				local_ast_moh_stop, local_ast_moh_cleanup);
 	}
 
 	return AST_MODULE_LOAD_SUCCESS;
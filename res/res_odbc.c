@@ -60,6 +60,10 @@
 #include "asterisk/app.h"
 #include "asterisk/strings.h"
 #include "asterisk/threadstorage.h"
+#include "asterisk/threadpool.h"
+
+/*! \brief The most threads running ast_odbc_execute_async() callbacks at once */
+#define ODBC_ASYNC_MAX_THREADS 16
 
 struct odbc_class
 {
@@ -100,8 +104,46 @@ struct odbc_class
 	char *sql_text;
 	/*! Slow query limit (in milliseconds) */
 	unsigned int slowquerylimit;
+	/*! The most prepared statements kept per connection */
+	unsigned int stmtcache;
+	/*! The number of prepared statements reused */
+	int stmt_cache_hits;
+	/*! The number of prepared statements which had to be prepared */
+	int stmt_cache_misses;
+	/*! The number of connections requested */
+	unsigned int requests;
+	/*! The number of requests given a connection from the pool */
+	unsigned int pool_hits;
+	/*! The number of requests which waited for a connection to be released */
+	unsigned int requests_waited;
+	/*! The total time (in milliseconds) requests waited for a connection */
+	int64_t wait_total;
+	/*! The longest time (in milliseconds) a request waited for a connection */
+	long longest_wait;
+};
+
+/*! \brief A prepared statement kept on a connection for reuse */
+struct odbc_stmt {
+	/*! The statement handle */
+	SQLHSTMT stmt;
+	/*! Whether the statement has been handed out and not released */
+	unsigned int in_use:1;
+	AST_LIST_ENTRY(odbc_stmt) list;
+	/*! The SQL the statement was prepared with */
+	char sql[0];
 };
 
+/*! \brief A callback queued by ast_odbc_execute_async() */
+struct odbc_async_task {
+	ast_odbc_async_cb callback;
+	void *data;
+	/*! The name of the class to request a connection from */
+	char name[0];
+};
+
+/*! \brief Thread pool running ast_odbc_execute_async() callbacks */
+static struct ast_threadpool *async_pool;
+
 static struct ao2_container *class_container;
 
 static AST_RWLIST_HEAD_STATIC(odbc_tables, odbc_cache_tables);
@@ -431,7 +473,7 @@ SQLHSTMT ast_odbc_prepare_and_execute(struct odbc_obj *obj, SQLHSTMT (*prepare_c
 		}
 
 		ast_log(LOG_WARNING, "SQL Execute error %d!\n", res);
-		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+		ast_odbc_release_stmt(obj, stmt);
 		stmt = NULL;
 	} else if (obj->parent->logging) {
 		long execution_time = ast_tvdiff_ms(ast_tvnow(), start);
@@ -475,6 +517,137 @@ int ast_odbc_prepare(struct odbc_obj *obj, SQLHSTMT *stmt, const char *sql)
 	return SQLPrepare(stmt, (unsigned char *)sql, SQL_NTS);
 }
 
+/*! \brief Return a kept statement to the connection for reuse */
+static void odbc_stmt_reset(struct odbc_stmt *cached)
+{
+	SQLFreeStmt(cached->stmt, SQL_CLOSE);
+	SQLFreeStmt(cached->stmt, SQL_UNBIND);
+	SQLFreeStmt(cached->stmt, SQL_RESET_PARAMS);
+	cached->in_use = 0;
+}
+
+/*! \brief Free every statement kept on a connection */
+static void odbc_stmt_free_all(struct odbc_obj *obj)
+{
+	struct odbc_stmt *cached;
+
+	while ((cached = AST_LIST_REMOVE_HEAD(&obj->stmts, list))) {
+		SQLFreeHandle(SQL_HANDLE_STMT, cached->stmt);
+		ast_free(cached);
+	}
+	obj->stmt_count = 0;
+}
+
+/*! \brief Keep a newly prepared statement on a connection, evicting the least recently used ones */
+static void odbc_stmt_keep(struct odbc_obj *obj, SQLHSTMT stmt, const char *sql)
+{
+	struct odbc_stmt *cached;
+	struct odbc_stmt *idle;
+
+	if (!obj->parent->stmtcache) {
+		return;
+	}
+
+	while (obj->stmt_count >= obj->parent->stmtcache) {
+		idle = NULL;
+		AST_LIST_TRAVERSE(&obj->stmts, cached, list) {
+			if (!cached->in_use) {
+				idle = cached;
+			}
+		}
+		if (!idle) {
+			/* Everything kept is in use, so this one is simply freed upon release */
+			return;
+		}
+
+		AST_LIST_REMOVE(&obj->stmts, idle, list);
+		SQLFreeHandle(SQL_HANDLE_STMT, idle->stmt);
+		ast_free(idle);
+		obj->stmt_count--;
+	}
+
+	cached = ast_calloc(1, sizeof(*cached) + strlen(sql) + 1);
+	if (!cached) {
+		return;
+	}
+
+	cached->stmt = stmt;
+	cached->in_use = 1;
+	strcpy(cached->sql, sql); /* SAFE */
+	AST_LIST_INSERT_HEAD(&obj->stmts, cached, list);
+	obj->stmt_count++;
+}
+
+SQLHSTMT ast_odbc_prepare_cached(struct odbc_obj *obj, const char *sql)
+{
+	struct odbc_stmt *cached;
+	SQLHSTMT stmt;
+	int res;
+
+	AST_LIST_TRAVERSE_SAFE_BEGIN(&obj->stmts, cached, list) {
+		if (!cached->in_use && !strcmp(cached->sql, sql)) {
+			AST_LIST_REMOVE_CURRENT(list);
+			break;
+		}
+	}
+	AST_LIST_TRAVERSE_SAFE_END;
+
+	if (cached) {
+		AST_LIST_INSERT_HEAD(&obj->stmts, cached, list);
+		cached->in_use = 1;
+		ast_atomic_fetchadd_int(&obj->parent->stmt_cache_hits, +1);
+
+		if (obj->parent->logging) {
+			ast_free(obj->sql_text);
+			obj->sql_text = ast_strdup(sql);
+		}
+
+		return cached->stmt;
+	}
+
+	if (obj->parent->stmtcache) {
+		ast_atomic_fetchadd_int(&obj->parent->stmt_cache_misses, +1);
+	}
+
+	res = SQLAllocHandle(SQL_HANDLE_STMT, obj->con, &stmt);
+	if (!SQL_SUCCEEDED(res)) {
+		ast_log(LOG_WARNING, "SQL Alloc Handle failed!\n");
+		return NULL;
+	}
+
+	res = ast_odbc_prepare(obj, stmt, sql);
+	if (!SQL_SUCCEEDED(res)) {
+		if (res == SQL_ERROR) {
+			ast_odbc_print_errors(SQL_HANDLE_STMT, stmt, "SQL Prepare");
+		}
+		ast_log(LOG_WARNING, "SQL Prepare failed! [%s]\n", sql);
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+		return NULL;
+	}
+
+	odbc_stmt_keep(obj, stmt, sql);
+
+	return stmt;
+}
+
+void ast_odbc_release_stmt(struct odbc_obj *obj, SQLHSTMT stmt)
+{
+	struct odbc_stmt *cached;
+
+	if (!stmt) {
+		return;
+	}
+
+	AST_LIST_TRAVERSE(&obj->stmts, cached, list) {
+		if (cached->stmt == stmt) {
+			odbc_stmt_reset(cached);
+			return;
+		}
+	}
+
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
 SQLRETURN ast_odbc_execute_sql(struct odbc_obj *obj, SQLHSTMT *stmt, const char *sql)
 {
 	if (obj->parent->logging) {
@@ -568,7 +741,7 @@ static int load_odbc_config(void)
 	struct ast_variable *v;
 	char *cat;
 	const char *dsn, *username, *password, *sanitysql;
-	int enabled, bse, conntimeout, forcecommit, isolation, maxconnections, logging, slowquerylimit;
+	int enabled, bse, conntimeout, forcecommit, isolation, maxconnections, logging, slowquerylimit, stmtcache;
 	struct timeval ncache = { 0, 0 };
 	int preconnect = 0, res = 0;
 	struct ast_flags config_flags = { 0 };
@@ -598,6 +771,7 @@ static int load_odbc_config(void)
 			maxconnections = 1;
 			logging = 0;
 			slowquerylimit = 5000;
+			stmtcache = 16;
 			for (v = ast_variable_browse(config, cat); v; v = v->next) {
 				if (!strcasecmp(v->name, "pooling") ||
 						!strncasecmp(v->name, "share", 5) ||
@@ -653,6 +827,11 @@ static int load_odbc_config(void)
 						ast_log(LOG_WARNING, "slow_query_limit must be a positive integer\n");
 						slowquerylimit = 5000;
 					}
+				} else if (!strcasecmp(v->name, "stmt_cache")) {
+					if (sscanf(v->value, "%30d", &stmtcache) != 1 || stmtcache < 0) {
+						ast_log(LOG_WARNING, "stmt_cache must be a non-negative integer\n");
+						stmtcache = 16;
+					}
 				}
 			}
 
@@ -681,6 +860,7 @@ static int load_odbc_config(void)
 				new->maxconnections = maxconnections;
 				new->logging = logging;
 				new->slowquerylimit = slowquerylimit;
+				new->stmtcache = stmtcache;
 
 				if (cat)
 					ast_copy_string(new->name, cat, sizeof(new->name));
@@ -767,6 +947,16 @@ static char *handle_cli_odbc_show(struct ast_cli_entry *e, int cmd, struct ast_c
 			}
 
 			ast_cli(a->fd, "    Number of active connections: %zd (out of %d)\n", class->connection_cnt, class->maxconnections);
+			ast_mutex_lock(&class->lock);
+			ast_cli(a->fd, "    Connection requests: %u (%u from the pool, %u waited)\n",
+				class->requests, class->pool_hits, class->requests_waited);
+			if (class->requests_waited) {
+				ast_cli(a->fd, "    Connection wait: %" PRId64 " milliseconds on average, longest %ld milliseconds\n",
+					class->wait_total / class->requests_waited, class->longest_wait);
+			}
+			ast_mutex_unlock(&class->lock);
+			ast_cli(a->fd, "    Statement cache: %u per connection, %d hits, %d misses\n",
+				class->stmtcache, class->stmt_cache_hits, class->stmt_cache_misses);
 			ast_cli(a->fd, "    Logging: %s\n", class->logging ? "Enabled" : "Disabled");
 			if (class->logging) {
 				ast_cli(a->fd, "    Number of prepares executed: %d\n", class->prepares_executed);
@@ -790,6 +980,11 @@ static struct ast_cli_entry cli_odbc[] = {
 	AST_CLI_DEFINE(handle_cli_odbc_show, "List ODBC DSN(s)")
 };
 
+/*! \brief Pre-connect callback, the connection is built by requesting it */
+static void odbc_preconnect_cb(struct odbc_obj *obj, void *data)
+{
+}
+
 static void odbc_register_class(struct odbc_class *class, int preconnect)
 {
 	struct odbc_obj *obj;
@@ -801,18 +996,64 @@ static void odbc_register_class(struct odbc_class *class, int preconnect)
 		return;
 	}
 
-	/* Request and release builds a connection */
+	/* Requesting and releasing a connection builds it, which is done on the
+	 * thread pool so classes connect in parallel without holding up the caller.
+	 */
+	if (!ast_odbc_execute_async(class->name, odbc_preconnect_cb, NULL)) {
+		return;
+	}
+
 	obj = ast_odbc_request_obj(class->name, 0);
 	if (obj) {
 		ast_odbc_release_obj(obj);
 	}
+}
+
+/*! \brief Thread pool task invoking an ast_odbc_execute_async() callback */
+static int odbc_async_task(void *data)
+{
+	struct odbc_async_task *task = data;
+	struct odbc_obj *obj;
+
+	obj = ast_odbc_request_obj(task->name, 0);
+	task->callback(obj, task->data);
+	if (obj) {
+		ast_odbc_release_obj(obj);
+	}
+	ast_free(task);
+
+	return 0;
+}
+
+int ast_odbc_execute_async(const char *name, ast_odbc_async_cb callback, void *data)
+{
+	struct odbc_async_task *task;
+
+	if (!async_pool || !callback) {
+		return -1;
+	}
+
+	task = ast_malloc(sizeof(*task) + strlen(name) + 1);
+	if (!task) {
+		return -1;
+	}
+
+	task->callback = callback;
+	task->data = data;
+	strcpy(task->name, name); /* SAFE */
+
+	if (ast_threadpool_push(async_pool, odbc_async_task, task)) {
+		ast_free(task);
+		return -1;
+	}
 
-	return;
+	return 0;
 }
 
 void ast_odbc_release_obj(struct odbc_obj *obj)
 {
 	struct odbc_class *class = obj->parent;
+	struct odbc_stmt *cached;
 
 	ast_debug(2, "Releasing ODBC handle %p into pool\n", obj);
 
@@ -831,6 +1072,13 @@ void ast_odbc_release_obj(struct odbc_obj *obj)
 	ast_free(obj->sql_text);
 	obj->sql_text = NULL;
 
+	/* Statements the user did not release are done with as well */
+	AST_LIST_TRAVERSE(&obj->stmts, cached, list) {
+		if (cached->in_use) {
+			odbc_stmt_reset(cached);
+		}
+	}
+
 	ast_mutex_lock(&class->lock);
 	AST_LIST_INSERT_HEAD(&class->connections, obj, list);
 	ast_cond_signal(&class->cond);
@@ -918,6 +1166,7 @@ struct odbc_obj *_ast_odbc_request_obj2(const char *name, struct ast_flags flags
 {
 	struct odbc_obj *obj = NULL;
 	struct odbc_class *class;
+	struct timeval wait_start = { 0, };
 
 	if (!(class = ao2_callback(class_container, 0, aoro2_class_cb, (char *) name))) {
 		ast_debug(1, "Class '%s' not found!\n", name);
@@ -925,6 +1174,7 @@ struct odbc_obj *_ast_odbc_request_obj2(const char *name, struct ast_flags flags
 	}
 
 	ast_mutex_lock(&class->lock);
+	class->requests++;
 
 	while (!obj) {
 		obj = AST_LIST_REMOVE_HEAD(&class->connections, list);
@@ -956,6 +1206,9 @@ struct odbc_obj *_ast_odbc_request_obj2(const char *name, struct ast_flags flags
 				 * wait for another thread to give up the connection they
 				 * own.
 				 */
+				if (ast_tvzero(wait_start)) {
+					wait_start = ast_tvnow();
+				}
 				ast_cond_wait(&class->cond, &class->lock);
 			}
 		} else if (connection_dead(obj, class)) {
@@ -971,10 +1224,21 @@ struct odbc_obj *_ast_odbc_request_obj2(const char *name, struct ast_flags flags
 			/* We successfully grabbed a connection from the pool and all is well!
 			 */
 			obj->parent = ao2_bump(class);
+			class->pool_hits++;
 			ast_debug(2, "Reusing ODBC handle %p from class '%s'\n", obj, name);
 		}
 	}
 
+	if (!ast_tvzero(wait_start)) {
+		long waited = ast_tvdiff_ms(ast_tvnow(), wait_start);
+
+		class->requests_waited++;
+		class->wait_total += waited;
+		if (waited > class->longest_wait) {
+			class->longest_wait = waited;
+		}
+	}
+
 	ast_mutex_unlock(&class->lock);
 	ao2_ref(class, -1);
 
@@ -1005,6 +1269,9 @@ static odbc_status odbc_obj_disconnect(struct odbc_obj *obj)
 		return ODBC_SUCCESS;
 	}
 
+	/* Statements are only valid on the connection they were prepared on */
+	odbc_stmt_free_all(obj);
+
 	con = obj->con;
 	obj->con = NULL;
 	res = SQLDisconnect(con);
@@ -1114,6 +1381,8 @@ static int reload(void)
 
 static int unload_module(void)
 {
+	ast_threadpool_shutdown(async_pool);
+	async_pool = NULL;
 	ao2_cleanup(class_container);
 	ast_cli_unregister_multiple(cli_odbc, ARRAY_LEN(cli_odbc));
 
@@ -1122,11 +1391,25 @@ static int unload_module(void)
 
 static int load_module(void)
 {
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 60,
+		.auto_increment = 1,
+		.initial_size = 0,
+		.max_size = ODBC_ASYNC_MAX_THREADS,
+	};
+
 	class_container = ao2_container_alloc_list(AO2_ALLOC_OPT_LOCK_MUTEX, 0, NULL, ao2_match_by_addr);
 	if (!class_container) {
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	async_pool = ast_threadpool_create("odbc", NULL, &options);
+	if (!async_pool) {
+		ao2_ref(class_container, -1);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	if (load_odbc_config() == -1) {
 		return AST_MODULE_LOAD_DECLINE;
 	}
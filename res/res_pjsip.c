@@ -2129,6 +2129,29 @@
 					<synopsis>Maximum number of threads in the res_pjsip threadpool.
 					A value of 0 indicates no maximum.</synopsis>
 				</configOption>
+				<configOption name="threadpool_work_stealing" default="no">
+					<synopsis>Give each res_pjsip threadpool thread its own task queue and let idle threads steal work.</synopsis>
+					<description><para>
+						By default every thread in the threadpool takes tasks from a single
+						shared queue.  When enabled, each thread has its own queue and threads
+						that run out of tasks take them from other threads, which reduces
+						contention on systems with many CPU cores.
+					</para></description>
+				</configOption>
+				<configOption name="monitor_threads" default="1">
+					<synopsis>Number of threads receiving SIP messages from the transports.</synopsis>
+					<description><para>
+						By default a single thread reads, parses and distributes every
+						incoming SIP message.  Setting this to a higher value starts that
+						many threads polling the transports, so messages arriving on
+						different transports or TCP/TLS connections are handled in parallel.
+						Messages arriving on the same socket are still handled one at a
+						time and in order, so request ordering within a dialog is kept.
+						Endpoint identification and all further processing continue to
+						run on the res_pjsip threadpool.  The value may range from 1 to 32
+						and is only read when res_pjsip is loaded.
+					</para></description>
+				</configOption>
 				<configOption name="disable_tcp_switch" default="yes">
 					<synopsis>Disable automatic switching from UDP to TCP transports.</synopsis>
 					<description><para>
@@ -2189,6 +2212,39 @@
 				<configOption name="contact_expiration_check_interval" default="30">
 					<synopsis>The interval (in seconds) to check for expired contacts.</synopsis>
 				</configOption>
+				<configOption name="contact_refresh_write_delay" default="0">
+					<synopsis>The maximum time (in seconds) a contact refresh may be held in memory before it is stored.</synopsis>
+					<description><para>
+						A REGISTER that only extends the expiration of an existing contact,
+						with the same path, user agent and qualify settings, normally writes
+						the contact to the sorcery backend before the response is sent.
+						When this is set, the registrar keeps the new expiration in memory
+						and a background task writes all pending refreshes every
+						<replaceable>contact_refresh_write_delay</replaceable> seconds.
+						Several refreshes of the same contact in that time result in a
+						single write.
+					</para>
+					<para>
+						A refresh is only held back while the expiration already stored
+						is more than twice this delay away, so other readers of the
+						backend never see a live contact as expired.  New, changed and
+						removed contacts are always stored immediately.  Pending refreshes
+						are written when res_pjsip_registrar is unloaded.  A value of 0
+						disables the feature.
+					</para></description>
+				</configOption>
+				<configOption name="outbound_registration_rate" default="0">
+					<synopsis>The maximum number of outbound REGISTER requests scheduled per second.</synopsis>
+					<description><para>
+						When set, <literal>res_pjsip_outbound_registration</literal> spreads
+						the initial REGISTER, refreshes and retries of all outbound
+						registrations so that no more than this many are sent in any one
+						second.  A request that would exceed the rate is moved to the next
+						second with room.  Refreshes are also sent up to 5% of the
+						expiration early at random, so that registrations that started
+						together drift apart over time.  A value of 0 disables pacing.
+					</para></description>
+				</configOption>
 				<configOption name="disable_multi_domain" default="no">
 					<synopsis>Disable Multi Domain support</synopsis>
 					<description><para>
@@ -2217,6 +2273,33 @@
 					<synopsis>The interval at which unidentified requests are older than
 					twice the unidentified_request_period are pruned.</synopsis>
 				</configOption>
+				<configOption name="flood_request_rate" default="0">
+					<synopsis>The sustained number of requests per second to accept from a single IP address.</synopsis>
+					<description><para>
+					Requests from an IP address beyond this rate are dropped without a response
+					before endpoint identification, authentication or queueing to a worker
+					thread.  An IP address may exceed the rate by up to
+					<literal>flood_request_burst</literal> requests at once.  Set this well above
+					the rate of the busiest legitimate peer, such as a trunk.  A value of 0
+					disables the limit.
+					</para></description>
+				</configOption>
+				<configOption name="flood_request_burst" default="20">
+					<synopsis>The number of requests a single IP address may send at once.</synopsis>
+					<description><para>
+					See <literal>flood_request_rate</literal>.
+					</para></description>
+				</configOption>
+				<configOption name="flood_ban_time" default="0">
+					<synopsis>The number of seconds to drop all messages from a flooding IP address.</synopsis>
+					<description><para>
+					An IP address is banned when it exceeds <literal>flood_request_rate</literal>, or
+					when it sends <literal>unidentified_request_count</literal> unidentified requests
+					within <literal>unidentified_request_period</literal>.  All messages from a banned
+					IP address are dropped before any other processing.  A value of 0 disables
+					banning.
+					</para></description>
+				</configOption>
 				<configOption name="type">
 					<synopsis>Must be of type 'global' UNLESS the object name is 'global'.</synopsis>
 				</configOption>
@@ -2354,7 +2437,9 @@
 						cleared.
 						</para>
 						<enumlist>
-							<enum name="global"><para>(default) Any taskprocessor overload will trigger.</para></enum>
+							<enum name="global"><para>(default) Any taskprocessor overload will trigger,
+							as will the load average or the free memory nearing the <literal>maxload</literal>
+							or <literal>minmemfree</literal> limits of <filename>asterisk.conf</filename>.</para></enum>
 							<enum name="pjsip_only"><para>Only pjsip taskprocessor overloads will trigger.</para></enum>
 							<enum name="none"><para>No overload detection will be performed.</para></enum>
 						</enumlist>
@@ -3545,7 +3630,7 @@ char *ast_sip_rdata_get_header_value(pjsip_rx_data *rdata, const pj_str_t str)
 	pjsip_generic_string_hdr *hdr;
 	pj_str_t hdr_val;
 
-	hdr = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &str, NULL);
+	hdr = ast_sip_rdata_find_header(rdata, &str, NULL);
 	if (!hdr) {
 		return NULL;
 	}
@@ -5271,7 +5356,8 @@ int ast_sip_is_content_type(pjsip_media_type *content_type, char *type, char *su
 
 pj_caching_pool caching_pool;
 pj_pool_t *memory_pool;
-pj_thread_t *monitor_thread;
+static pj_thread_t *monitor_threads[SIP_MAX_MONITOR_THREADS];
+static unsigned int monitor_thread_count;
 static int monitor_continue;
 
 static void *monitor_thread_exec(void *endpt)
@@ -5283,10 +5369,16 @@ static void *monitor_thread_exec(void *endpt)
 	return NULL;
 }
 
-static void stop_monitor_thread(void)
+static void stop_monitor_threads(void)
 {
+	unsigned int i;
+
 	monitor_continue = 0;
-	pj_thread_join(monitor_thread);
+	for (i = 0; i < monitor_thread_count; ++i) {
+		pj_thread_join(monitor_threads[i]);
+		monitor_threads[i] = NULL;
+	}
+	monitor_thread_count = 0;
 }
 
 AST_THREADSTORAGE(pj_thread_storage);
@@ -5321,10 +5413,12 @@ static void sip_thread_start(void)
 int ast_sip_thread_is_servant(void)
 {
 	uint32_t *servant_id;
+	unsigned int i;
 
-	if (monitor_thread &&
-			pthread_self() == *(pthread_t *)pj_thread_get_os_handle(monitor_thread)) {
-		return 1;
+	for (i = 0; i < monitor_thread_count; ++i) {
+		if (pthread_self() == *(pthread_t *)pj_thread_get_os_handle(monitor_threads[i])) {
+			return 1;
+		}
 	}
 
 	servant_id = ast_threadstorage_get(&servant_id_storage, sizeof(*servant_id));
@@ -5707,6 +5801,7 @@ static int unload_pjsip(void *data)
 		ast_res_pjsip_cleanup_options_handling();
 		ast_res_pjsip_cleanup_message_filter();
 		ast_sip_destroy_distributor();
+		ast_sip_destroy_header_cache();
 		ast_sip_destroy_transport_management();
 		ast_res_pjsip_destroy_configuration();
 		ast_sip_destroy_system();
@@ -5715,9 +5810,8 @@ static int unload_pjsip(void *data)
 		ast_sip_destroy_transport_events();
 	}
 
-	if (monitor_thread) {
-		stop_monitor_thread();
-		monitor_thread = NULL;
+	if (monitor_thread_count) {
+		stop_monitor_threads();
 	}
 
 	if (memory_pool) {
@@ -5744,6 +5838,7 @@ static int unload_pjsip(void *data)
 static int load_pjsip(void)
 {
 	const unsigned int flags = 0; /* no port, no brackets */
+	unsigned int thread_count;
 	pj_status_t status;
 
 	/* The third parameter is just copied from
@@ -5780,13 +5875,28 @@ static int load_pjsip(void)
 	pjsip_tsx_layer_init_module(ast_pjsip_endpoint);
 	pjsip_ua_init_module(ast_pjsip_endpoint, NULL);
 
+	thread_count = sip_get_monitor_threads();
+	if (thread_count > 1) {
+		/*
+		 * Only let one monitor thread at a time handle events for a
+		 * given socket so messages on a transport are still distributed
+		 * in the order they were received.  This must be set before
+		 * any transports are created.
+		 */
+		pj_ioqueue_set_default_concurrency(pjsip_endpt_get_ioqueue(ast_pjsip_endpoint), PJ_FALSE);
+	}
+
 	monitor_continue = 1;
-	status = pj_thread_create(memory_pool, "SIP", (pj_thread_proc *) &monitor_thread_exec,
-			NULL, PJ_THREAD_DEFAULT_STACK_SIZE * 2, 0, &monitor_thread);
-	if (status != PJ_SUCCESS) {
-		ast_log(LOG_ERROR, "Failed to start SIP monitor thread. Aborting load\n");
-		goto error;
+	while (monitor_thread_count < thread_count) {
+		status = pj_thread_create(memory_pool, "SIP", (pj_thread_proc *) &monitor_thread_exec,
+				NULL, PJ_THREAD_DEFAULT_STACK_SIZE * 2, 0, &monitor_threads[monitor_thread_count]);
+		if (status != PJ_SUCCESS) {
+			ast_log(LOG_ERROR, "Failed to start SIP monitor thread. Aborting load\n");
+			goto error;
+		}
+		++monitor_thread_count;
 	}
+	ast_debug(1, "Started %u SIP monitor thread(s)\n", monitor_thread_count);
 
 	return AST_MODULE_LOAD_SUCCESS;
 
@@ -5882,6 +5992,11 @@ static int load_module(void)
 		goto error;
 	}
 
+	if (ast_sip_initialize_header_cache()) {
+		ast_log(LOG_ERROR, "Failed to register header cache module. Aborting load\n");
+		goto error;
+	}
+
 	if (ast_sip_initialize_distributor()) {
 		ast_log(LOG_ERROR, "Failed to register distributor module. Aborting load\n");
 		goto error;
@@ -40,11 +40,16 @@
 #define DEFAULT_REALM "asterisk"
 #define DEFAULT_REGCONTEXT ""
 #define DEFAULT_CONTACT_EXPIRATION_CHECK_INTERVAL 30
+#define DEFAULT_CONTACT_REFRESH_WRITE_DELAY 0
+#define DEFAULT_OUTBOUND_REGISTRATION_RATE 0
 #define DEFAULT_DISABLE_MULTI_DOMAIN 0
 #define DEFAULT_VOICEMAIL_EXTENSION ""
 #define DEFAULT_UNIDENTIFIED_REQUEST_COUNT 5
 #define DEFAULT_UNIDENTIFIED_REQUEST_PERIOD 5
 #define DEFAULT_UNIDENTIFIED_REQUEST_PRUNE_INTERVAL 30
+#define DEFAULT_FLOOD_REQUEST_RATE 0
+#define DEFAULT_FLOOD_REQUEST_BURST 20
+#define DEFAULT_FLOOD_BAN_TIME 0
 #define DEFAULT_MWI_TPS_QUEUE_HIGH AST_TASKPROCESSOR_HIGH_WATER_LEVEL
 #define DEFAULT_MWI_TPS_QUEUE_LOW -1
 #define DEFAULT_MWI_DISABLE_INITIAL_UNSOLICITED 0
@@ -90,6 +95,10 @@ struct global_config {
 	unsigned int max_initial_qualify_time;
 	/*! The interval at which to check for expired contacts */
 	unsigned int contact_expiration_check_interval;
+	/*! The number of seconds a contact refresh may wait before being stored */
+	unsigned int contact_refresh_write_delay;
+	/*! The maximum number of outbound REGISTER requests scheduled per second */
+	unsigned int outbound_registration_rate;
 	/*! Nonzero to disable multi domain support */
 	unsigned int disable_multi_domain;
 	/*! The maximum number of unidentified requests per source IP address before a security event is logged */
@@ -98,6 +107,12 @@ struct global_config {
 	unsigned int unidentified_request_period;
 	/*! Interval at which expired unidentifed requests will be pruned */
 	unsigned int unidentified_request_prune_interval;
+	/*! The sustained number of requests per second accepted from a single IP address */
+	unsigned int flood_request_rate;
+	/*! The number of requests a single IP address may send at once */
+	unsigned int flood_request_burst;
+	/*! The number of seconds a flooding IP address is banned for */
+	unsigned int flood_ban_time;
 	struct {
 		/*! Taskprocessor high water alert trigger level */
 		unsigned int tps_queue_high;
@@ -321,6 +336,36 @@ unsigned int ast_sip_get_contact_expiration_check_interval(void)
 	return interval;
 }
 
+unsigned int ast_sip_get_contact_refresh_write_delay(void)
+{
+	unsigned int delay;
+	struct global_config *cfg;
+
+	cfg = get_global_cfg();
+	if (!cfg) {
+		return DEFAULT_CONTACT_REFRESH_WRITE_DELAY;
+	}
+
+	delay = cfg->contact_refresh_write_delay;
+	ao2_ref(cfg, -1);
+	return delay;
+}
+
+unsigned int ast_sip_get_outbound_registration_rate(void)
+{
+	unsigned int rate;
+	struct global_config *cfg;
+
+	cfg = get_global_cfg();
+	if (!cfg) {
+		return DEFAULT_OUTBOUND_REGISTRATION_RATE;
+	}
+
+	rate = cfg->outbound_registration_rate;
+	ao2_ref(cfg, -1);
+	return rate;
+}
+
 unsigned int ast_sip_get_disable_multi_domain(void)
 {
 	unsigned int disable_multi_domain;
@@ -372,6 +417,26 @@ void ast_sip_get_unidentified_request_thresholds(unsigned int *count, unsigned i
 	return;
 }
 
+void ast_sip_get_flood_thresholds(unsigned int *rate, unsigned int *burst,
+	unsigned int *ban_time)
+{
+	struct global_config *cfg;
+
+	cfg = get_global_cfg();
+	if (!cfg) {
+		*rate = DEFAULT_FLOOD_REQUEST_RATE;
+		*burst = DEFAULT_FLOOD_REQUEST_BURST;
+		*ban_time = DEFAULT_FLOOD_BAN_TIME;
+		return;
+	}
+
+	*rate = cfg->flood_request_rate;
+	*burst = cfg->flood_request_burst;
+	*ban_time = cfg->flood_ban_time;
+
+	ao2_ref(cfg, -1);
+}
+
 void ast_sip_get_default_realm(char *realm, size_t size)
 {
 	struct global_config *cfg;
@@ -687,6 +752,12 @@ int ast_sip_initialize_sorcery_global(void)
 	ast_sorcery_object_field_register(sorcery, "global", "contact_expiration_check_interval",
 		__stringify(DEFAULT_CONTACT_EXPIRATION_CHECK_INTERVAL),
 		OPT_UINT_T, 0, FLDSET(struct global_config, contact_expiration_check_interval));
+	ast_sorcery_object_field_register(sorcery, "global", "contact_refresh_write_delay",
+		__stringify(DEFAULT_CONTACT_REFRESH_WRITE_DELAY),
+		OPT_UINT_T, 0, FLDSET(struct global_config, contact_refresh_write_delay));
+	ast_sorcery_object_field_register(sorcery, "global", "outbound_registration_rate",
+		__stringify(DEFAULT_OUTBOUND_REGISTRATION_RATE),
+		OPT_UINT_T, 0, FLDSET(struct global_config, outbound_registration_rate));
 	ast_sorcery_object_field_register(sorcery, "global", "disable_multi_domain",
 		DEFAULT_DISABLE_MULTI_DOMAIN ? "yes" : "no",
 		OPT_BOOL_T, 1, FLDSET(struct global_config, disable_multi_domain));
@@ -699,6 +770,15 @@ int ast_sip_initialize_sorcery_global(void)
 	ast_sorcery_object_field_register(sorcery, "global", "unidentified_request_prune_interval",
 		__stringify(DEFAULT_UNIDENTIFIED_REQUEST_PRUNE_INTERVAL),
 		OPT_UINT_T, 0, FLDSET(struct global_config, unidentified_request_prune_interval));
+	ast_sorcery_object_field_register(sorcery, "global", "flood_request_rate",
+		__stringify(DEFAULT_FLOOD_REQUEST_RATE),
+		OPT_UINT_T, 0, FLDSET(struct global_config, flood_request_rate));
+	ast_sorcery_object_field_register(sorcery, "global", "flood_request_burst",
+		__stringify(DEFAULT_FLOOD_REQUEST_BURST),
+		OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct global_config, flood_request_burst), 1, 100000);
+	ast_sorcery_object_field_register(sorcery, "global", "flood_ban_time",
+		__stringify(DEFAULT_FLOOD_BAN_TIME),
+		OPT_UINT_T, 0, FLDSET(struct global_config, flood_ban_time));
 	ast_sorcery_object_field_register(sorcery, "global", "default_realm", DEFAULT_REALM,
 		OPT_STRINGFIELD_T, 0, STRFLDSET(struct global_config, default_realm));
 	ast_sorcery_object_field_register(sorcery, "global", "mwi_tps_queue_high",
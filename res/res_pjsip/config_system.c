@@ -49,7 +49,11 @@ struct system_config {
 		int idle_timeout;
 		/*! Maxumum number of threads in the threadpool */
 		int max_size;
+		/*! Nonzero to use per thread task queues with work stealing */
+		unsigned int work_stealing;
 	} threadpool;
+	/*! Number of threads polling the SIP transports for events */
+	unsigned int monitor_threads;
 	/*! Nonzero to disable switching from UDP to TCP transport */
 	unsigned int disable_tcp_switch;
 	/*!
@@ -72,6 +76,13 @@ void sip_get_threadpool_options(struct ast_threadpool_options *threadpool_option
 	*threadpool_options = sip_threadpool_options;
 }
 
+static unsigned int sip_monitor_threads = 1;
+
+unsigned int sip_get_monitor_threads(void)
+{
+	return sip_monitor_threads;
+}
+
 static struct ast_sorcery *system_sorcery;
 
 static void *system_alloc(const char *name)
@@ -129,6 +140,8 @@ static int system_apply(const struct ast_sorcery *sorcery, void *obj)
 	sip_threadpool_options.auto_increment = system->threadpool.auto_increment;
 	sip_threadpool_options.idle_timeout = system->threadpool.idle_timeout;
 	sip_threadpool_options.max_size = system->threadpool.max_size;
+	sip_threadpool_options.work_stealing = system->threadpool.work_stealing;
+	sip_monitor_threads = system->monitor_threads;
 
 	pjsip_cfg()->endpt.disable_tcp_switch =
 		system->disable_tcp_switch ? PJ_TRUE : PJ_FALSE;
@@ -207,6 +220,11 @@ int ast_sip_initialize_system(void)
 			OPT_UINT_T, 0, FLDSET(struct system_config, threadpool.idle_timeout));
 	ast_sorcery_object_field_register(system_sorcery, "system", "threadpool_max_size", "50",
 			OPT_UINT_T, 0, FLDSET(struct system_config, threadpool.max_size));
+	ast_sorcery_object_field_register(system_sorcery, "system", "threadpool_work_stealing", "no",
+			OPT_BOOL_T, 1, FLDSET(struct system_config, threadpool.work_stealing));
+	ast_sorcery_object_field_register(system_sorcery, "system", "monitor_threads", "1",
+			OPT_UINT_T, PARSE_IN_RANGE, FLDSET(struct system_config, monitor_threads),
+			1, SIP_MAX_MONITOR_THREADS);
 	ast_sorcery_object_field_register(system_sorcery, "system", "disable_tcp_switch", "yes",
 			OPT_BOOL_T, 1, FLDSET(struct system_config, disable_tcp_switch));
 	ast_sorcery_object_field_register(system_sorcery, "system", "follow_early_media_fork", "yes",
@@ -191,6 +191,23 @@ void ast_sip_initialize_global_headers(void);
  */
 void ast_sip_destroy_global_headers(void);
 
+/*!
+ * \internal
+ * \brief Initialize the received message header index
+ *
+ * \retval 0 on success
+ * \retval other on failure
+ */
+int ast_sip_initialize_header_cache(void);
+
+/*!
+ * \internal
+ * \brief Destroy the received message header index
+ *
+ * \return Nothing
+ */
+void ast_sip_destroy_header_cache(void);
+
 /*!
  * \internal
  * \brief Pre-initialize OPTIONS request handling.
@@ -286,6 +303,15 @@ void ast_res_pjsip_cleanup_message_filter(void);
  */
 void sip_get_threadpool_options(struct ast_threadpool_options *threadpool_options);
 
+/*! Maximum number of threads polling the SIP transports for events */
+#define SIP_MAX_MONITOR_THREADS 32
+
+/*!
+ * \internal
+ * \brief Get the number of SIP monitor threads to start
+ */
+unsigned int sip_get_monitor_threads(void);
+
 /*!
  * \internal
  * \brief Retrieve the name of the default outbound endpoint.
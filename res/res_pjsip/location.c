@@ -683,6 +683,8 @@ static int voicemail_extension_to_str(const void *obj, const intptr_t *args, cha
 
 int ast_sip_for_each_aor(const char *aors, ao2_callback_fn on_aor, void *arg)
 {
+	struct ao2_container *names;
+	struct ao2_container *found;
 	char *copy;
 	char *name;
 	int res;
@@ -691,19 +693,43 @@ int ast_sip_for_each_aor(const char *aors, ao2_callback_fn on_aor, void *arg)
 		return 0;
 	}
 
+	names = ast_str_container_alloc_options(AO2_ALLOC_OPT_LOCK_NOLOCK, 7);
+	if (!names) {
+		return -1;
+	}
+
+	/* Retrieve all of the AORs at once so backends can do so in a single query */
+	copy = ast_strdupa(aors);
+	while ((name = ast_strip(strsep(&copy, ",")))) {
+		if (!ast_strlen_zero(name) && ast_str_container_add(names, name)) {
+			ao2_ref(names, -1);
+			return -1;
+		}
+	}
+
+	found = ast_sorcery_retrieve_by_ids(ast_sip_get_sorcery(), "aor", names);
+	ao2_ref(names, -1);
+	if (!found) {
+		return -1;
+	}
+
+	/* Invoke the callback in the order the AORs are listed */
 	copy = ast_strdupa(aors);
 	while ((name = ast_strip(strsep(&copy, ",")))) {
 		struct ast_sip_aor *aor;
 
-		aor = ast_sip_location_retrieve_aor(name);
+		aor = ast_strlen_zero(name) ? NULL : ao2_find(found, name, OBJ_SEARCH_KEY);
 		if (aor) {
 			res = on_aor(aor, arg, 0);
 			ao2_ref(aor, -1);
 			if (res) {
+				ao2_ref(found, -1);
 				return -1;
 			}
 		}
 	}
+
+	ao2_ref(found, -1);
 	return 0;
 }
 
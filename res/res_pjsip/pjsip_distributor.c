@@ -22,6 +22,7 @@
 
 #include "asterisk/res_pjsip.h"
 #include "asterisk/acl.h"
+#include "asterisk/overload.h"
 #include "include/res_pjsip_private.h"
 #include "asterisk/taskprocessor.h"
 #include "asterisk/threadpool.h"
@@ -30,6 +31,15 @@
 static int distribute(void *data);
 static pj_bool_t distributor(pjsip_rx_data *rdata);
 static pj_status_t record_serializer(pjsip_tx_data *tdata);
+static pj_bool_t flood_filter(pjsip_rx_data *rdata);
+
+static pjsip_module flood_mod = {
+	.name = {"Flood Filter", 12},
+	/* This must run before anything else, including the ACL module and logger */
+	.priority = 0,
+	.on_rx_request = flood_filter,
+	.on_rx_response = flood_filter,
+};
 
 static pjsip_module distributor_mod = {
 	.name = {"Request Distributor", 19},
@@ -59,6 +69,30 @@ struct unidentified_request{
 	char src_name[];
 };
 
+/*! Number of buckets for flood sources (Best if prime number) */
+#define FLOOD_SOURCES_BUCKETS 1021
+
+static struct ao2_container *flood_sources;
+static unsigned int flood_rate;
+static unsigned int flood_burst;
+static unsigned int flood_ban_time;
+
+/*! \brief Token bucket and ban state for a source IP address */
+struct flood_source {
+	/*! When tokens were last added */
+	struct timeval last;
+	/*! When the ban ends, zero if not banned */
+	struct timeval banned_until;
+	/*! Available requests, in thousandths of a request */
+	int64_t tokens;
+	/*! Messages dropped from this source */
+	unsigned int dropped;
+	char src_name[];
+};
+
+AO2_STRING_FIELD_HASH_FN(flood_source, src_name);
+AO2_STRING_FIELD_CMP_FN(flood_source, src_name);
+
 /*! Number of serializers in pool if one not otherwise known.  (Best if prime number) */
 #define DISTRIBUTOR_POOL_SIZE		31
 
@@ -536,7 +570,7 @@ static pj_bool_t distributor(pjsip_rx_data *rdata)
 		return PJ_TRUE;
 	} else {
 		if ((overload_trigger == TASKPROCESSOR_OVERLOAD_TRIGGER_GLOBAL &&
-			ast_taskprocessor_alert_get())
+			ast_overload_level_get() != AST_OVERLOAD_NONE)
 			|| (overload_trigger == TASKPROCESSOR_OVERLOAD_TRIGGER_PJSIP_ONLY &&
 			ast_taskprocessor_get_subsystem_alert("pjsip"))) {
 			/*
@@ -550,11 +584,11 @@ static pj_bool_t distributor(pjsip_rx_data *rdata)
 			switch (rdata->tp_info.transport->key.type) {
 			case PJSIP_TRANSPORT_UDP6:
 			case PJSIP_TRANSPORT_UDP:
-				ast_debug(3, "Taskprocessor overload alert: Ignoring '%s'.\n",
+				ast_debug(3, "Overload alert: Ignoring '%s'.\n",
 					pjsip_rx_data_get_info(rdata));
 				break;
 			default:
-				ast_debug(3, "Taskprocessor overload on non-udp transport. Received:'%s'. "
+				ast_debug(3, "Overload on non-udp transport. Received:'%s'. "
 					"Responding with a 503.\n", pjsip_rx_data_get_info(rdata));
 				pjsip_endpt_respond_stateless(ast_sip_get_pjsip_endpoint(), rdata,
 					PJSIP_SC_SERVICE_UNAVAILABLE, NULL, NULL, NULL);
@@ -573,6 +607,7 @@ static pj_bool_t distributor(pjsip_rx_data *rdata)
 		ao2_cleanup(dist);
 		return PJ_TRUE;
 	}
+	ast_sip_rdata_header_cache_reset(clone);
 
 	if (dist) {
 		ao2_lock(dist);
@@ -657,6 +692,117 @@ struct ast_sip_endpoint *ast_sip_get_artificial_endpoint(void)
 	return artificial_endpoint;
 }
 
+/*!
+ * \internal
+ * \brief Find the flood state of a source IP address, creating it if needed
+ *
+ * \return The flood source with a reference, or NULL on allocation failure.
+ */
+static struct flood_source *flood_source_get(const char *src_name)
+{
+	struct flood_source *source;
+
+	source = ao2_find(flood_sources, src_name, OBJ_SEARCH_KEY);
+	if (source) {
+		return source;
+	}
+
+	ao2_wrlock(flood_sources);
+	source = ao2_find(flood_sources, src_name, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!source) {
+		source = ao2_alloc(sizeof(*source) + strlen(src_name) + 1, NULL);
+		if (source) {
+			strcpy(source->src_name, src_name); /* Safe */
+			source->last = ast_tvnow();
+			source->tokens = (int64_t) flood_burst * 1000;
+			ao2_link_flags(flood_sources, source, OBJ_NOLOCK);
+		}
+	}
+	ao2_unlock(flood_sources);
+
+	return source;
+}
+
+/*!
+ * \internal
+ * \brief Ban a source for flood_ban_time seconds
+ * \note The source must be locked.
+ */
+static void flood_ban(struct flood_source *source, struct timeval now, const char *reason)
+{
+	source->banned_until = ast_tvadd(now, ast_samp2tv(flood_ban_time, 1));
+	ast_log(LOG_NOTICE, "Dropping all SIP messages from '%s' for %u seconds: %s\n",
+		source->src_name, flood_ban_time, reason);
+}
+
+/*!
+ * \internal
+ * \brief Drop messages from banned and flooding source addresses
+ *
+ * Runs on the transport thread before the ACL module, endpoint
+ * identification and the distributor, so a dropped message never
+ * reaches a worker thread and gets no response.
+ */
+static pj_bool_t flood_filter(pjsip_rx_data *rdata)
+{
+	struct flood_source *source;
+	struct timeval now;
+	int is_request = rdata->msg_info.msg->type == PJSIP_REQUEST_MSG;
+	int drop = 0;
+
+	if (!flood_rate && !flood_ban_time) {
+		return PJ_FALSE;
+	}
+
+	if (flood_rate && is_request) {
+		source = flood_source_get(rdata->pkt_info.src_name);
+	} else {
+		/* Only banned sources are of interest for responses */
+		source = ao2_find(flood_sources, rdata->pkt_info.src_name, OBJ_SEARCH_KEY);
+	}
+	if (!source) {
+		return PJ_FALSE;
+	}
+
+	now = ast_tvnow();
+
+	ao2_lock(source);
+	if (!ast_tvzero(source->banned_until)) {
+		if (ast_tvcmp(now, source->banned_until) < 0) {
+			drop = 1;
+		} else {
+			source->banned_until = ast_tv(0, 0);
+			source->tokens = (int64_t) flood_burst * 1000;
+			source->last = now;
+		}
+	}
+
+	if (!drop && flood_rate && is_request) {
+		source->tokens += ast_tvdiff_ms(now, source->last) * flood_rate;
+		if (source->tokens > (int64_t) flood_burst * 1000) {
+			source->tokens = (int64_t) flood_burst * 1000;
+		}
+		source->last = now;
+
+		if (source->tokens >= 1000) {
+			source->tokens -= 1000;
+		} else {
+			drop = 1;
+			if (flood_ban_time) {
+				flood_ban(source, now, "request rate exceeded");
+			}
+		}
+	}
+
+	if (drop) {
+		++source->dropped;
+	}
+	ao2_unlock(source);
+	ao2_ref(source, -1);
+
+	return drop ? PJ_TRUE : PJ_FALSE;
+}
+
 static void log_failed_request(pjsip_rx_data *rdata, char *msg, unsigned int count, unsigned int period)
 {
 	char from_buf[PJSIP_MAX_URL_SIZE];
@@ -691,6 +837,17 @@ static void check_endpoint(pjsip_rx_data *rdata, struct unidentified_request *un
 	if (ms < (unidentified_period * 1000) && unid->count >= unidentified_count) {
 		log_failed_request(rdata, "No matching endpoint found", unid->count, ms);
 		ast_sip_report_invalid_endpoint(name, rdata);
+
+		if (flood_ban_time) {
+			struct flood_source *source = flood_source_get(unid->src_name);
+
+			if (source) {
+				ao2_lock(source);
+				flood_ban(source, ast_tvnow(), "too many unidentified requests");
+				ao2_unlock(source);
+				ao2_ref(source, -1);
+			}
+		}
 	}
 	ao2_unlock(unid);
 }
@@ -1146,13 +1303,36 @@ static int expire_requests(void *object, void *arg, int flags)
 	return 0;
 }
 
+static int expire_flood_sources(void *object, void *arg, int flags)
+{
+	struct flood_source *source = object;
+	const struct timeval *now = arg;
+	int res = 0;
+
+	ao2_lock(source);
+	/*
+	 * Once the ban is over and the bucket would have refilled there is
+	 * nothing to remember about the source.
+	 */
+	if (ast_tvcmp(*now, source->banned_until) >= 0
+		&& (!flood_rate
+			|| ast_tvdiff_ms(*now, source->last) * flood_rate >= (int64_t) flood_burst * 1000)) {
+		res = CMP_MATCH;
+	}
+	ao2_unlock(source);
+
+	return res;
+}
+
 static int prune_task(const void *data)
 {
 	unsigned int maxage;
+	struct timeval now = ast_tvnow();
 
 	ast_sip_get_unidentified_request_thresholds(&unidentified_count, &unidentified_period, &unidentified_prune_interval);
 	maxage = unidentified_period * 2;
 	ao2_callback(unidentified_requests, OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK, expire_requests, &maxage);
+	ao2_callback(flood_sources, OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK, expire_flood_sources, &now);
 
 	return unidentified_prune_interval * 1000;
 }
@@ -1199,6 +1379,7 @@ static void global_loaded(const char *object_type)
 	ao2_cleanup(fake_auth);
 
 	ast_sip_get_unidentified_request_thresholds(&unidentified_count, &unidentified_period, &unidentified_prune_interval);
+	ast_sip_get_flood_thresholds(&flood_rate, &flood_burst, &flood_ban_time);
 
 	overload_trigger = ast_sip_get_taskprocessor_overload_trigger();
 
@@ -1265,6 +1446,13 @@ int ast_sip_initialize_distributor(void)
 		return -1;
 	}
 
+	flood_sources = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+		FLOOD_SOURCES_BUCKETS, flood_source_hash_fn, NULL, flood_source_cmp_fn);
+	if (!flood_sources) {
+		ast_sip_destroy_distributor();
+		return -1;
+	}
+
 	dialog_associations = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
 		DIALOG_ASSOCIATIONS_BUCKETS, dialog_associations_hash, NULL,
 		dialog_associations_cmp);
@@ -1297,6 +1485,10 @@ int ast_sip_initialize_distributor(void)
 		return -1;
 	}
 
+	if (ast_sip_register_service(&flood_mod)) {
+		ast_sip_destroy_distributor();
+		return -1;
+	}
 	if (ast_sip_register_service(&distributor_mod)) {
 		ast_sip_destroy_distributor();
 		return -1;
@@ -1339,6 +1531,7 @@ void ast_sip_destroy_distributor(void)
 	ast_sip_unregister_service(&auth_mod);
 	ast_sip_unregister_service(&endpoint_mod);
 	ast_sip_unregister_service(&distributor_mod);
+	ast_sip_unregister_service(&flood_mod);
 
 	ao2_global_obj_release(artificial_auth);
 	ao2_cleanup(artificial_endpoint);
@@ -1353,4 +1546,5 @@ void ast_sip_destroy_distributor(void)
 
 	ao2_cleanup(dialog_associations);
 	ao2_cleanup(unidentified_requests);
+	ao2_cleanup(flood_sources);
 }
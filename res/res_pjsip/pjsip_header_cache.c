@@ -0,0 +1,273 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*! \file
+ *
+ * \brief Per message index of received SIP headers
+ *
+ * \details
+ * The first lookup on a received message walks its header list once
+ * and files every header by name into a small hash table allocated
+ * from the message pool.  Later lookups by any module handling the
+ * same message are then a bucket walk instead of a scan of the whole
+ * list, and name-addr headers that pjsip keeps as plain strings are
+ * parsed at most once.
+ */
+
+#include "asterisk.h"
+
+#include <pjsip.h>
+#include <pjlib.h>
+
+#include "asterisk/res_pjsip.h"
+#include "include/res_pjsip_private.h"
+
+/*! Number of hash buckets in a message header index */
+#define HEADER_CACHE_BUCKETS 32
+
+static pj_bool_t header_cache_on_rx(pjsip_rx_data *rdata);
+
+/*!
+ * The module exists to own a mod_data slot in each rdata and to clear
+ * it before any other module sees the message.  Transports reuse their
+ * rdata between packets so a stale index must never survive.
+ */
+static pjsip_module header_cache_module = {
+	.name = { "Header Cache", 12 },
+	.id = -1,
+	.priority = PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1,
+	.on_rx_request = header_cache_on_rx,
+	.on_rx_response = header_cache_on_rx,
+};
+
+/*! \brief One occurrence of a header in the message */
+struct header_cache_node {
+	pjsip_hdr *hdr;
+	struct header_cache_node *next;
+};
+
+/*! \brief All occurrences of one header name, in message order */
+struct header_cache_entry {
+	/*! Name the headers were filed under */
+	const pj_str_t *name;
+	struct header_cache_node *first;
+	struct header_cache_node *last;
+	/*! Parsed name-addr view of the first header */
+	pjsip_fromto_hdr *fromto;
+	/*! Set once parsing the name-addr view has been attempted */
+	unsigned int fromto_parsed:1;
+	struct header_cache_entry *next;
+};
+
+/*! \brief Header index of a received message */
+struct header_cache {
+	/*! The message that was indexed */
+	pjsip_msg *msg;
+	struct header_cache_entry *buckets[HEADER_CACHE_BUCKETS];
+};
+
+static pj_bool_t header_cache_on_rx(pjsip_rx_data *rdata)
+{
+	rdata->endpt_info.mod_data[header_cache_module.id] = NULL;
+	return PJ_FALSE;
+}
+
+static unsigned int header_cache_hash(const pj_str_t *name)
+{
+	unsigned int hash = 0;
+	pj_ssize_t i;
+
+	for (i = 0; i < name->slen; ++i) {
+		hash = hash * 31 + tolower((unsigned char) name->ptr[i]);
+	}
+
+	return hash % HEADER_CACHE_BUCKETS;
+}
+
+static struct header_cache_entry *header_cache_entry_find(struct header_cache *cache,
+	const pj_str_t *name)
+{
+	struct header_cache_entry *entry;
+
+	for (entry = cache->buckets[header_cache_hash(name)]; entry; entry = entry->next) {
+		if (!pj_stricmp(entry->name, name)) {
+			break;
+		}
+	}
+
+	return entry;
+}
+
+static int header_cache_add(pj_pool_t *pool, struct header_cache *cache,
+	const pj_str_t *name, pjsip_hdr *hdr)
+{
+	struct header_cache_entry *entry;
+	struct header_cache_node *node;
+
+	entry = header_cache_entry_find(cache, name);
+	if (!entry) {
+		unsigned int bucket = header_cache_hash(name);
+
+		entry = PJ_POOL_ZALLOC_T(pool, struct header_cache_entry);
+		if (!entry) {
+			return -1;
+		}
+		entry->name = name;
+		entry->next = cache->buckets[bucket];
+		cache->buckets[bucket] = entry;
+	}
+
+	node = PJ_POOL_ZALLOC_T(pool, struct header_cache_node);
+	if (!node) {
+		return -1;
+	}
+	node->hdr = hdr;
+	if (entry->last) {
+		entry->last->next = node;
+	} else {
+		entry->first = node;
+	}
+	entry->last = node;
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Get the header index of a received message, building it if needed
+ *
+ * \retval NULL if the index could not be built, callers fall back to scanning
+ */
+static struct header_cache *header_cache_get(pjsip_rx_data *rdata)
+{
+	struct header_cache *cache;
+	pjsip_msg *msg = rdata->msg_info.msg;
+	pjsip_hdr *hdr;
+
+	if (header_cache_module.id < 0 || !msg) {
+		return NULL;
+	}
+
+	cache = rdata->endpt_info.mod_data[header_cache_module.id];
+	if (cache && cache->msg == msg) {
+		return cache;
+	}
+
+	cache = PJ_POOL_ZALLOC_T(rdata->tp_info.pool, struct header_cache);
+	if (!cache) {
+		return NULL;
+	}
+	cache->msg = msg;
+
+	for (hdr = msg->hdr.next; hdr != &msg->hdr; hdr = hdr->next) {
+		/* pjsip matches either the full or the compact form of a name */
+		if (header_cache_add(rdata->tp_info.pool, cache, &hdr->name, hdr)) {
+			return NULL;
+		}
+		if (hdr->sname.slen && pj_stricmp(&hdr->sname, &hdr->name)
+			&& header_cache_add(rdata->tp_info.pool, cache, &hdr->sname, hdr)) {
+			return NULL;
+		}
+	}
+
+	rdata->endpt_info.mod_data[header_cache_module.id] = cache;
+	return cache;
+}
+
+void *ast_sip_rdata_find_header(pjsip_rx_data *rdata, const pj_str_t *name, const void *prev)
+{
+	struct header_cache *cache = header_cache_get(rdata);
+	struct header_cache_entry *entry;
+	struct header_cache_node *node;
+
+	if (!cache) {
+		return pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, name,
+			prev ? ((const pjsip_hdr *) prev)->next : NULL);
+	}
+
+	entry = header_cache_entry_find(cache, name);
+	if (!entry) {
+		return NULL;
+	}
+
+	if (!prev) {
+		return entry->first->hdr;
+	}
+
+	for (node = entry->first; node; node = node->next) {
+		if (node->hdr == prev) {
+			return node->next ? node->next->hdr : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+static pjsip_fromto_hdr *parse_fromto(pjsip_rx_data *rdata, pjsip_generic_string_hdr *hdr)
+{
+	static const pj_str_t from = { "From", 4 };
+	pj_str_t value;
+	int parsed_len;
+
+	pj_strdup_with_null(rdata->tp_info.pool, &value, &hdr->hvalue);
+
+	return pjsip_parse_hdr(rdata->tp_info.pool, &from, value.ptr,
+		pj_strlen(&value), &parsed_len);
+}
+
+pjsip_fromto_hdr *ast_sip_rdata_get_fromto_header(pjsip_rx_data *rdata, const pj_str_t *name)
+{
+	struct header_cache *cache = header_cache_get(rdata);
+	struct header_cache_entry *entry;
+	pjsip_generic_string_hdr *hdr;
+
+	if (!cache) {
+		hdr = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, name, NULL);
+		return hdr && hdr->type == PJSIP_H_OTHER ? parse_fromto(rdata, hdr) : NULL;
+	}
+
+	entry = header_cache_entry_find(cache, name);
+	if (!entry) {
+		return NULL;
+	}
+
+	if (!entry->fromto_parsed) {
+		hdr = (pjsip_generic_string_hdr *) entry->first->hdr;
+		if (hdr->type == PJSIP_H_OTHER) {
+			entry->fromto = parse_fromto(rdata, hdr);
+		}
+		entry->fromto_parsed = 1;
+	}
+
+	return entry->fromto;
+}
+
+void ast_sip_rdata_header_cache_reset(pjsip_rx_data *rdata)
+{
+	if (header_cache_module.id >= 0) {
+		rdata->endpt_info.mod_data[header_cache_module.id] = NULL;
+	}
+}
+
+int ast_sip_initialize_header_cache(void)
+{
+	return ast_sip_register_service(&header_cache_module);
+}
+
+void ast_sip_destroy_header_cache(void)
+{
+	ast_sip_unregister_service(&header_cache_module);
+}
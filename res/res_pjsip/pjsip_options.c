@@ -34,6 +34,7 @@
 #include "include/res_pjsip_private.h"
 #include "asterisk/taskprocessor.h"
 #include "asterisk/threadpool.h"
+#include "asterisk/dlinkedlists.h"
 
 /*
  * This implementation for OPTIONS support is based around the idea
@@ -50,7 +51,10 @@
  * configuration) sends OPTIONS requests out to any contacts
  * associated with it. Contacts themselves are not individually
  * scheduled. Contacts can be added or deleted as appropriate with no
- * requirement to reschedule.
+ * requirement to reschedule. AORs themselves are not scheduled with
+ * the res_pjsip scheduler either. They wait in a shared timing wheel
+ * which dispatches the qualify of due AORs to their serializers in
+ * rate limited batches.
  *
  * The next level object up is the AOR itself. The result of a contact
  * status change is fed into it and the result composited with all
@@ -122,6 +126,12 @@
 /*! \brief These are the number of buckets (per endpoint state compositor) to use to store AOR statuses */
 #define AOR_STATUS_BUCKETS 3
 
+/*! \brief The number of one second slots in the qualify timing wheel */
+#define QUALIFY_WHEEL_SLOTS 512
+
+/*! \brief The minimum number of AORs the qualify timing wheel dispatches per tick */
+#define QUALIFY_WHEEL_MIN_BATCH 100
+
 /*! \brief Maximum wait time to join the below shutdown group */
 #define MAX_UNLOAD_TIMEOUT_TIME		10	/* Seconds */
 
@@ -158,12 +168,34 @@ struct sip_options_endpoint_state_compositor {
 	char name[0];
 };
 
+/*!
+ * \brief Where an AOR is in its qualify cycle
+ */
+enum sip_options_qualify_state {
+	/*! \brief Not waiting to be qualified */
+	QUALIFY_IDLE,
+	/*! \brief Waiting in a slot of the qualify timing wheel */
+	QUALIFY_WHEEL,
+	/*! \brief The qualify has been pushed to the AOR serializer */
+	QUALIFY_DISPATCHED,
+};
+
 /*!
  * \brief Structure which contains an AOR and contacts for qualifying purposes
  */
 struct sip_options_aor {
-	/*! \brief The scheduler task for this AOR */
-	struct ast_sip_sched_task *sched_task;
+	/*! \brief Linkage into a qualify timing wheel slot, protected by the wheel lock */
+	AST_DLLIST_ENTRY(sip_options_aor) wheel_list;
+	/*! \brief The qualify timing wheel slot, protected by the wheel lock */
+	unsigned int wheel_slot;
+	/*! \brief Full turns of the wheel left before qualifying, protected by the wheel lock */
+	unsigned int wheel_rounds;
+	/*! \brief Qualifies per second (in millionths) added to the wheel, protected by the wheel lock */
+	unsigned int wheel_rate;
+	/*! \brief The qualify cycle state, protected by the wheel lock */
+	enum sip_options_qualify_state qualify_state;
+	/*! \brief Non-zero if the AOR is qualified periodically, protected by the wheel lock */
+	unsigned int qualify_scheduled;
 	/*! \brief The serializer for this AOR */
 	struct ast_taskprocessor *serializer;
 	/*! \brief All contacts associated with this AOR */
@@ -212,6 +244,32 @@ static struct ao2_container *sip_options_endpoint_state_compositors;
  */
 static struct ast_taskprocessor *management_serializer;
 
+/*!
+ * \internal
+ * \brief Hashed timing wheel of AORs waiting to be qualified
+ *
+ * \details
+ * A single scheduler task advances the wheel once a second instead of
+ * every AOR having its own scheduler entry.  AORs wait in the slot they
+ * are due in and, if due further away than one turn of the wheel, for
+ * the number of remaining turns.  Each tick dispatches at most twice the
+ * average qualify rate so AORs that fall due at the same time, such as
+ * after a reload, are spread over the following ticks.
+ */
+static struct {
+	/*! \brief The AORs waiting in each slot */
+	AST_DLLIST_HEAD_NOLOCK(, sip_options_aor) slots[QUALIFY_WHEEL_SLOTS];
+	/*! \brief The slot processed by the last tick */
+	unsigned int position;
+	/*! \brief The sum of the qualifies per second (in millionths) of all scheduled AORs */
+	unsigned long rate;
+	/*! \brief The scheduler task which advances the wheel */
+	struct ast_sip_sched_task *tick_task;
+} qualify_wheel;
+
+/*! \brief Lock protecting the qualify timing wheel and the qualify state of AORs */
+AST_MUTEX_DEFINE_STATIC(qualify_wheel_lock);
+
 static pj_status_t send_options_response(pjsip_rx_data *rdata, int code)
 {
 	pjsip_endpoint *endpt = ast_sip_get_pjsip_endpoint();
@@ -664,6 +722,7 @@ static int sip_options_contact_status_notify_task(void *obj)
 	struct ast_sip_contact *contact;
 	struct ast_sip_contact_status *cs_old;
 	struct ast_sip_contact_status *cs_new;
+	int64_t rtt;
 
 	/*
 	 * Determine if this is a late arriving notification, as it is
@@ -695,20 +754,31 @@ static int sip_options_contact_status_notify_task(void *obj)
 		return 0;
 	}
 
-	/* Update the contact specific status information */
-	cs_new = sip_contact_status_copy(cs_old);
-	ao2_ref(cs_old, -1);
-	if (!cs_new) {
-		ao2_ref(contact_callback_data, -1);
-		return 0;
+	rtt = contact_callback_data->status == AVAILABLE
+		? ast_tvdiff_us(ast_tvnow(), contact_callback_data->rtt_start)
+		: 0;
+
+	if (cs_old->status == contact_callback_data->status
+		&& cs_old->last_status == cs_old->status) {
+		/*
+		 * Nothing but the round trip time changed so update it in place
+		 * rather than replacing the contact status with a new copy.
+		 */
+		cs_old->rtt = rtt;
+		cs_new = cs_old;
+	} else {
+		/* Update the contact specific status information */
+		cs_new = sip_contact_status_copy(cs_old);
+		ao2_ref(cs_old, -1);
+		if (!cs_new) {
+			ao2_ref(contact_callback_data, -1);
+			return 0;
+		}
+		cs_new->last_status = cs_new->status;
+		cs_new->status = contact_callback_data->status;
+		cs_new->rtt = rtt;
+		ao2_link(sip_options_contact_statuses, cs_new);
 	}
-	cs_new->last_status = cs_new->status;
-	cs_new->status = contact_callback_data->status;
-	cs_new->rtt =
-		cs_new->status == AVAILABLE
-			? ast_tvdiff_us(ast_tvnow(), contact_callback_data->rtt_start)
-			: 0;
-	ao2_link(sip_options_contact_statuses, cs_new);
 
 	/*
 	 * If the status has changed then notify the endpoint state compositors
@@ -930,8 +1000,176 @@ static int sip_options_qualify_aor(void *obj)
 	ao2_callback(aor_options->contacts, OBJ_NODATA, sip_options_qualify_contact,
 		(struct sip_options_aor *) aor_options);
 
-	/* Always reschedule to the frequency we should go */
-	return aor_options->qualify_frequency * 1000;
+	return 0;
+}
+
+/*!
+ * \brief Put an AOR into the qualify timing wheel
+ * \note The wheel lock must be held and the wheel given a reference to the AOR
+ */
+static void sip_options_wheel_insert(struct sip_options_aor *aor_options, int delay_ms)
+{
+	unsigned int ticks = delay_ms > 1000 ? (delay_ms + 999) / 1000 : 1;
+
+	aor_options->wheel_slot = (qualify_wheel.position + ticks) % QUALIFY_WHEEL_SLOTS;
+	aor_options->wheel_rounds = (ticks - 1) / QUALIFY_WHEEL_SLOTS;
+	aor_options->qualify_state = QUALIFY_WHEEL;
+	AST_DLLIST_INSERT_TAIL(&qualify_wheel.slots[aor_options->wheel_slot], aor_options,
+		wheel_list);
+}
+
+/*!
+ * \brief Start qualifying an AOR periodically
+ *
+ * \param aor_options The AOR
+ * \param delay_ms Time until the first qualify
+ *
+ * \note Run by aor_options->serializer
+ */
+static void sip_options_qualify_schedule(struct sip_options_aor *aor_options, int delay_ms)
+{
+	ast_mutex_lock(&qualify_wheel_lock);
+	if (aor_options->qualify_scheduled) {
+		qualify_wheel.rate -= aor_options->wheel_rate;
+	}
+	aor_options->qualify_scheduled = 1;
+	aor_options->wheel_rate = 1000000 / aor_options->qualify_frequency;
+	qualify_wheel.rate += aor_options->wheel_rate;
+
+	switch (aor_options->qualify_state) {
+	case QUALIFY_IDLE:
+		ao2_ref(aor_options, +1);
+		sip_options_wheel_insert(aor_options, delay_ms);
+		break;
+	case QUALIFY_WHEEL:
+		AST_DLLIST_REMOVE(&qualify_wheel.slots[aor_options->wheel_slot], aor_options,
+			wheel_list);
+		sip_options_wheel_insert(aor_options, delay_ms);
+		break;
+	case QUALIFY_DISPATCHED:
+		/* The qualify is queued behind us and puts the AOR back into the wheel */
+		break;
+	}
+	ast_mutex_unlock(&qualify_wheel_lock);
+}
+
+/*!
+ * \brief Stop qualifying an AOR periodically
+ * \note Run by aor_options->serializer
+ */
+static void sip_options_qualify_unschedule(struct sip_options_aor *aor_options)
+{
+	int removed = 0;
+
+	ast_mutex_lock(&qualify_wheel_lock);
+	if (aor_options->qualify_scheduled) {
+		qualify_wheel.rate -= aor_options->wheel_rate;
+		aor_options->qualify_scheduled = 0;
+	}
+	if (aor_options->qualify_state == QUALIFY_WHEEL) {
+		AST_DLLIST_REMOVE(&qualify_wheel.slots[aor_options->wheel_slot], aor_options,
+			wheel_list);
+		aor_options->qualify_state = QUALIFY_IDLE;
+		removed = 1;
+	}
+	ast_mutex_unlock(&qualify_wheel_lock);
+
+	if (removed) {
+		ao2_ref(aor_options, -1);
+	}
+}
+
+/*!
+ * \brief Task to qualify contacts of an AOR taken from the qualify timing wheel
+ * \note Run by aor_options->serializer
+ */
+static int sip_options_qualify_aor_wheel_task(void *obj)
+{
+	struct sip_options_aor *aor_options = obj;
+	int scheduled;
+
+	ast_mutex_lock(&qualify_wheel_lock);
+	scheduled = aor_options->qualify_scheduled;
+	ast_mutex_unlock(&qualify_wheel_lock);
+
+	if (scheduled) {
+		sip_options_qualify_aor(aor_options);
+	}
+
+	ast_mutex_lock(&qualify_wheel_lock);
+	aor_options->qualify_state = QUALIFY_IDLE;
+	if (aor_options->qualify_scheduled) {
+		/* The wheel keeps our reference */
+		sip_options_wheel_insert(aor_options, aor_options->qualify_frequency * 1000);
+		aor_options = NULL;
+	}
+	ast_mutex_unlock(&qualify_wheel_lock);
+
+	ao2_cleanup(aor_options);
+	return 0;
+}
+
+/*!
+ * \brief Scheduler task which advances the qualify timing wheel by one slot
+ */
+static int sip_options_wheel_tick(void *data)
+{
+	AST_DLLIST_HEAD_NOLOCK(, sip_options_aor) due = { NULL, NULL };
+	struct sip_options_aor *aor_options;
+	unsigned long budget;
+	unsigned int next;
+	unsigned int dispatched = 0;
+
+	ast_mutex_lock(&qualify_wheel_lock);
+	qualify_wheel.position = (qualify_wheel.position + 1) % QUALIFY_WHEEL_SLOTS;
+	next = (qualify_wheel.position + 1) % QUALIFY_WHEEL_SLOTS;
+	budget = MAX(QUALIFY_WHEEL_MIN_BATCH, qualify_wheel.rate / 500000);
+
+	AST_DLLIST_TRAVERSE_SAFE_BEGIN(&qualify_wheel.slots[qualify_wheel.position],
+		aor_options, wheel_list) {
+		if (aor_options->wheel_rounds) {
+			--aor_options->wheel_rounds;
+			continue;
+		}
+
+		AST_DLLIST_REMOVE_CURRENT(wheel_list);
+		if (dispatched == budget) {
+			/* Over budget so carry it over to be first in the next tick */
+			aor_options->wheel_slot = next;
+			AST_DLLIST_INSERT_HEAD(&qualify_wheel.slots[next], aor_options, wheel_list);
+			continue;
+		}
+
+		aor_options->qualify_state = QUALIFY_DISPATCHED;
+		AST_DLLIST_INSERT_TAIL(&due, aor_options, wheel_list);
+		++dispatched;
+	}
+	AST_DLLIST_TRAVERSE_SAFE_END;
+	ast_mutex_unlock(&qualify_wheel_lock);
+
+	while ((aor_options = AST_DLLIST_REMOVE_HEAD(&due, wheel_list))) {
+		/* The task inherits the wheel's reference */
+		if (!ast_sip_push_task(aor_options->serializer, sip_options_qualify_aor_wheel_task,
+			aor_options)) {
+			continue;
+		}
+
+		ast_mutex_lock(&qualify_wheel_lock);
+		aor_options->qualify_state = QUALIFY_IDLE;
+		if (aor_options->qualify_scheduled) {
+			sip_options_wheel_insert(aor_options, 1000);
+			aor_options = NULL;
+		}
+		ast_mutex_unlock(&qualify_wheel_lock);
+		ao2_cleanup(aor_options);
+	}
+
+	if (dispatched) {
+		ast_debug(4, "Qualify timing wheel dispatched %u AORs\n", dispatched);
+	}
+
+	/* Keep ticking */
+	return 1;
 }
 
 /*! \brief Forward declaration of this helpful function */
@@ -1349,26 +1587,16 @@ static void sip_options_apply_aor_configuration(struct sip_options_aor *aor_opti
 	 * 3. There are no contacts but previously there were some
 	 */
 	if (aor_options->qualify_frequency != aor->qualify_frequency
-		|| (!aor_options->sched_task && ao2_container_count(aor_options->contacts))
-		|| (aor_options->sched_task && !ao2_container_count(aor_options->contacts))) {
-		if (aor_options->sched_task) {
-			ast_sip_sched_task_cancel(aor_options->sched_task);
-			ao2_ref(aor_options->sched_task, -1);
-			aor_options->sched_task = NULL;
-		}
+		|| (!aor_options->qualify_scheduled && ao2_container_count(aor_options->contacts))
+		|| (aor_options->qualify_scheduled && !ao2_container_count(aor_options->contacts))) {
+		sip_options_qualify_unschedule(aor_options);
 
 		/* If there is still a qualify frequency then schedule this */
 		aor_options->qualify_frequency = aor->qualify_frequency;
 		if (aor_options->qualify_frequency
 			&& ao2_container_count(aor_options->contacts)) {
-			aor_options->sched_task = ast_sip_schedule_task(aor_options->serializer,
-				sip_options_determine_initial_qualify_time(aor_options->qualify_frequency),
-				sip_options_qualify_aor, ast_taskprocessor_name(aor_options->serializer),
-				aor_options, AST_SIP_SCHED_TASK_VARIABLE | AST_SIP_SCHED_TASK_DATA_AO2);
-			if (!aor_options->sched_task) {
-				ast_log(LOG_ERROR, "Unable to schedule qualify for contacts of AOR '%s'\n",
-					aor_options->name);
-			}
+			sip_options_qualify_schedule(aor_options,
+				sip_options_determine_initial_qualify_time(aor_options->qualify_frequency));
 		}
 	}
 
@@ -1691,11 +1919,7 @@ static int sip_options_aor_remove_task(void *obj)
 
 	sip_options_notify_endpoint_state_compositors(aor_options, REMOVED);
 
-	if (aor_options->sched_task) {
-		ast_sip_sched_task_cancel(aor_options->sched_task);
-		ao2_ref(aor_options->sched_task, -1);
-		aor_options->sched_task = NULL;
-	}
+	sip_options_qualify_unschedule(aor_options);
 
 	return 0;
 }
@@ -2115,20 +2339,7 @@ static int sip_options_contact_add_task(void *obj)
 		 * since they pretty much just registered they should be
 		 * reachable.
 		 */
-		if (task_data->aor_options->sched_task) {
-			ast_sip_sched_task_cancel(task_data->aor_options->sched_task);
-			ao2_ref(task_data->aor_options->sched_task, -1);
-			task_data->aor_options->sched_task = NULL;
-		}
-		task_data->aor_options->sched_task = ast_sip_schedule_task(
-			task_data->aor_options->serializer, 1, sip_options_qualify_aor,
-			ast_taskprocessor_name(task_data->aor_options->serializer),
-			task_data->aor_options,
-			AST_SIP_SCHED_TASK_VARIABLE | AST_SIP_SCHED_TASK_DATA_AO2);
-		if (!task_data->aor_options->sched_task) {
-			ast_log(LOG_ERROR, "Unable to schedule qualify for contacts of AOR '%s'\n",
-				task_data->aor_options->name);
-		}
+		sip_options_qualify_schedule(task_data->aor_options, 1);
 	} else {
 		/*
 		 * If this was the first contact added to a non-qualified AOR then
@@ -2286,11 +2497,7 @@ static int sip_options_contact_delete_task(void *obj)
 		if (!ao2_container_count(task_data->aor_options->contacts)) {
 			ast_debug(3, "Terminating scheduled callback on AOR '%s' as there are no contacts to qualify\n",
 				task_data->aor_options->name);
-			if (task_data->aor_options->sched_task) {
-				ast_sip_sched_task_cancel(task_data->aor_options->sched_task);
-				ao2_ref(task_data->aor_options->sched_task, -1);
-				task_data->aor_options->sched_task = NULL;
-			}
+			sip_options_qualify_unschedule(task_data->aor_options);
 		}
 	} else {
 		task_data->aor_options->available =
@@ -2798,11 +3005,7 @@ static int sip_options_cleanup_aor_task(void *obj)
 	ast_debug(2, "Cleaning up AOR '%s' for shutdown\n", aor_options->name);
 
 	aor_options->qualify_frequency = 0;
-	if (aor_options->sched_task) {
-		ast_sip_sched_task_cancel(aor_options->sched_task);
-		ao2_ref(aor_options->sched_task, -1);
-		aor_options->sched_task = NULL;
-	}
+	sip_options_qualify_unschedule(aor_options);
 	AST_VECTOR_RESET(&aor_options->compositors, ao2_cleanup);
 
 	return 0;
@@ -2849,6 +3052,12 @@ void ast_res_pjsip_cleanup_options_handling(void)
 	ast_sorcery_observer_remove(ast_sip_get_sorcery(), "endpoint",
 		&endpoint_observer_callbacks);
 
+	if (qualify_wheel.tick_task) {
+		ast_sip_sched_task_cancel(qualify_wheel.tick_task);
+		ao2_ref(qualify_wheel.tick_task, -1);
+		qualify_wheel.tick_task = NULL;
+	}
+
 	mgmt_serializer = management_serializer;
 	management_serializer = NULL;
 	if (mgmt_serializer) {
@@ -2953,6 +3162,13 @@ int ast_res_pjsip_init_options_handling(int reload)
 		return -1;
 	}
 
+	qualify_wheel.tick_task = ast_sip_schedule_task(NULL, 1000, sip_options_wheel_tick,
+		"pjsip/options/wheel", NULL, AST_SIP_SCHED_TASK_FIXED);
+	if (!qualify_wheel.tick_task) {
+		ast_res_pjsip_cleanup_options_handling();
+		return -1;
+	}
+
 	mgmt_serializer = ast_sip_create_serializer("pjsip/options/manage");
 	if (!mgmt_serializer) {
 		ast_res_pjsip_cleanup_options_handling();
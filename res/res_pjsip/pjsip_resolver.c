@@ -176,7 +176,7 @@ static int sip_resolve_add(struct sip_resolve *resolve, const char *name, int rr
 	ast_debug(2, "[%p] Added target '%s' with record type '%d', transport '%s', and port '%d'\n",
 		resolve, name, rr_type, pjsip_transport_get_type_desc(transport), target.port);
 
-	return ast_dns_query_set_add(resolve->queries, name, rr_type, rr_class);
+	return ast_dns_query_set_add_cached(resolve->queries, name, rr_type, rr_class);
 }
 
 /*!
@@ -189,21 +189,8 @@ static const unsigned int reason_code_to_cause(const struct ast_party_redirectin
 
 static pjsip_fromto_hdr *get_diversion_header(pjsip_rx_data *rdata)
 {
-	static const pj_str_t from_name = { "From", 4 };
-
-	pjsip_generic_string_hdr *hdr;
-	pj_str_t value;
-	int size;
-
-	if (!(hdr = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &diversion_name, NULL))) {
-		return NULL;
-	}
-
-	pj_strdup_with_null(rdata->tp_info.pool, &value, &hdr->hvalue);
-
 	/* parse as a fromto header */
-	return pjsip_parse_hdr(rdata->tp_info.pool, &from_name, value.ptr,
-			       pj_strlen(&value), &size);
+	return ast_sip_rdata_get_fromto_header(rdata, &diversion_name);
 }
 
 /* Asterisk keeps track of 2 things. The redirected from address and
@@ -219,7 +206,7 @@ static pjsip_fromto_hdr *get_history_info_header(pjsip_rx_data *rdata, const uns
 
 	pjsip_generic_string_hdr *hdr = NULL;
 
-	hdr = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &history_info_name, NULL);
+	hdr = ast_sip_rdata_find_header(rdata, &history_info_name, NULL);
 
 	if (!hdr) {
 		return NULL;
@@ -256,7 +243,7 @@ static pjsip_fromto_hdr *get_history_info_header(pjsip_rx_data *rdata, const uns
 
 		result_hdr = fromto_hdr;
 
-	} while ((hdr = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &history_info_name, hdr->next)));
+	} while ((hdr = ast_sip_rdata_find_header(rdata, &history_info_name, hdr)));
 
 	return result_hdr;
 }
@@ -450,7 +437,6 @@ static int diversion_incoming_request(struct ast_sip_session *session, pjsip_rx_
 static void diversion_incoming_response(struct ast_sip_session *session, pjsip_rx_data *rdata)
 {
 	static const pj_str_t contact_name = { "Contact", 7 };
-	static const pj_str_t contact_name_s = { "m", 1 };
 
 	pjsip_status_line status = rdata->msg_info.msg->line.status;
 	pjsip_fromto_hdr *div_hdr;
@@ -483,7 +469,7 @@ static void diversion_incoming_response(struct ast_sip_session *session, pjsip_r
 
 	if (status.code == 302) {
 		/* With 302, Contact indicates the final destination and possibly Diversion indicates the hop before */
-		contact_hdr = pjsip_msg_find_hdr_by_names(rdata->msg_info.msg, &contact_name, &contact_name_s, NULL);
+		contact_hdr = ast_sip_rdata_find_header(rdata, &contact_name, NULL);
 
 		set_redirecting(session, div_hdr, contact_hdr ?	(pjsip_name_addr*)contact_hdr->uri :
 				(pjsip_name_addr*)PJSIP_MSG_FROM_HDR(rdata->msg_info.msg)->uri);
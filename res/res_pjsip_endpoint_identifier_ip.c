@@ -31,6 +31,7 @@
 #include "asterisk/module.h"
 #include "asterisk/acl.h"
 #include "asterisk/manager.h"
+#include "asterisk/vector.h"
 #include "res_pjsip/include/res_pjsip_private.h"
 
 /*** DOCUMENTATION
@@ -174,6 +175,36 @@ static void *ip_identify_alloc(const char *name)
 	return identify;
 }
 
+/*!
+ * \brief Print the value of a header into a buffer
+ *
+ * \retval NULL if the header could not be printed
+ * \retval The trimmed header value within buf
+ */
+static char *header_value_print(pjsip_hdr *header, char *buf, size_t size)
+{
+	char *pos;
+	int len;
+
+	/* Print header line to buf */
+	len = pjsip_hdr_print_on(header, buf, size - 1);
+	if (len < 0) {
+		/* Buffer not large enough or no header vptr! */
+		ast_assert(0);
+		return NULL;
+	}
+	buf[len] = '\0';
+
+	/* Remove header name from pj_buf and trim blanks. */
+	pos = strchr(buf, ':');
+	if (!pos) {
+		/* No header name?  Bug in PJPROJECT if so. */
+		ast_assert(0);
+		return NULL;
+	}
+	return ast_strip(pos + 1);
+}
+
 /*! \brief Comparator function for matching an object by header */
 static int header_identify_match_check(void *obj, void *arg, int flags)
 {
@@ -195,28 +226,14 @@ static int header_identify_match_check(void *obj, void *arg, int flags)
 		(header = pjsip_msg_find_hdr_by_name(rdata->msg_info.msg, &pj_header_name, header));
 		header = header->next) {
 		char *pos;
-		int len;
 		char buf[PATH_MAX];
 
 		header_present = 1;
 
-		/* Print header line to buf */
-		len = pjsip_hdr_print_on(header, buf, sizeof(buf) - 1);
-		if (len < 0) {
-			/* Buffer not large enough or no header vptr! */
-			ast_assert(0);
-			continue;
-		}
-		buf[len] = '\0';
-
-		/* Remove header name from pj_buf and trim blanks. */
-		pos = strchr(buf, ':');
+		pos = header_value_print(header, buf, sizeof(buf));
 		if (!pos) {
-			/* No header name?  Bug in PJPROJECT if so. */
-			ast_assert(0);
 			continue;
 		}
-		pos = ast_strip(pos + 1);
 
 		/* Does header value match what we are looking for? */
 		if (identify->is_regex) {
@@ -262,25 +279,590 @@ static int ip_identify_match_check(void *obj, void *arg, int flags)
 	}
 }
 
-static struct ast_sip_endpoint *common_identify(ao2_callback_fn *identify_match_cb, void *arg)
+/*! \brief An address prefix of a match, masked to its prefix length */
+struct identify_prefix {
+	/*! Masked address in network byte order, unused bytes are zero */
+	unsigned char addr[16];
+	/*! Source port to match, 0 for any */
+	uint16_t port;
+	/*! The identify the prefix belongs to */
+	struct ip_identify_match *identify;
+};
+
+/*! \brief All prefixes of one length, sorted by address */
+struct identify_prefix_group {
+	unsigned int bits;
+	AST_VECTOR(, struct identify_prefix) prefixes;
+};
+
+/*! \brief Prefix groups of one address family, longest prefix first */
+AST_VECTOR(identify_prefix_table, struct identify_prefix_group);
+
+/*! \brief An exact match_header value */
+struct identify_header {
+	struct ip_identify_match *identify;
+	/*! Lower case header name, a colon, then the value */
+	char key[0];
+};
+
+/*!
+ * \brief Lookup index over every identify object
+ *
+ * The index is immutable once published.  It is thrown away whenever an
+ * identify is created, updated, deleted or reloaded and rebuilt by the
+ * next request that needs it.
+ */
+struct identify_index {
+	/*! Every indexed identify, the index holds a reference to each */
+	AST_VECTOR(, struct ip_identify_match *) identifies;
+	struct identify_prefix_table ipv4;
+	struct identify_prefix_table ipv6;
+	/*! Identifies with a netmask that is not a prefix, checked in turn */
+	AST_VECTOR(, struct ip_identify_match *) unindexed_matches;
+	/*! Exact match_header values */
+	struct ao2_container *headers;
+	/*! Distinct header names used by headers */
+	AST_VECTOR(, const char *) header_names;
+	/*! Identifies with a match_header regex, checked in turn */
+	AST_VECTOR(, struct ip_identify_match *) header_regexes;
+};
+
+/*! \brief The number of buckets for exact match_header values */
+#define IDENTIFY_HEADER_BUCKETS 257
+
+/*! \brief The current index, empty until needed after a change */
+static AO2_GLOBAL_OBJ_STATIC(current_index);
+
+/*! \brief Bumped on every change so a build that raced a change is not published */
+static int index_generation;
+
+/*! \brief Serializes index builds */
+AST_MUTEX_DEFINE_STATIC(index_build_lock);
+
+/*!
+ * \brief Non-zero if identify objects only change through sorcery
+ *
+ * Identifies fetched from realtime can change behind our back so they
+ * are always matched by retrieving and scanning them all.
+ */
+static int index_usable;
+
+static int identify_header_hash(const void *obj, const int flags)
 {
-	RAII_VAR(struct ao2_container *, candidates, NULL, ao2_cleanup);
-	struct ip_identify_match *match;
-	struct ast_sip_endpoint *endpoint;
+	const char *key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		key = obj;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		key = ((const struct identify_header *) obj)->key;
+		break;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+	return ast_str_hash(key);
+}
+
+static int identify_header_cmp(void *obj, void *arg, int flags)
+{
+	const struct identify_header *left = obj;
+	const char *right_key;
+
+	switch (flags & OBJ_SEARCH_MASK) {
+	case OBJ_SEARCH_KEY:
+		right_key = arg;
+		break;
+	case OBJ_SEARCH_OBJECT:
+		right_key = ((const struct identify_header *) arg)->key;
+		break;
+	default:
+		ast_assert(0);
+		return 0;
+	}
+	return strcmp(left->key, right_key) ? 0 : CMP_MATCH;
+}
+
+static void identify_header_destroy(void *obj)
+{
+	struct identify_header *header = obj;
+
+	ao2_cleanup(header->identify);
+}
+
+static void identify_prefix_table_free(struct identify_prefix_table *table)
+{
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(table); ++i) {
+		AST_VECTOR_FREE(&AST_VECTOR_GET_ADDR(table, i)->prefixes);
+	}
+	AST_VECTOR_FREE(table);
+}
+
+static void identify_index_destroy(void *obj)
+{
+	struct identify_index *index = obj;
+
+	ao2_cleanup(index->headers);
+	identify_prefix_table_free(&index->ipv4);
+	identify_prefix_table_free(&index->ipv6);
+	AST_VECTOR_FREE(&index->unindexed_matches);
+	AST_VECTOR_FREE(&index->header_names);
+	AST_VECTOR_FREE(&index->header_regexes);
+	AST_VECTOR_CALLBACK_VOID(&index->identifies, ao2_cleanup);
+	AST_VECTOR_FREE(&index->identifies);
+}
+
+/*!
+ * \brief Copy the raw bytes of an address
+ *
+ * \return The number of address bytes, 0 if not an IP address
+ */
+static int identify_addr_bytes(const struct ast_sockaddr *addr, unsigned char *bytes)
+{
+	memset(bytes, 0, 16);
+
+	if (ast_sockaddr_is_ipv4(addr)) {
+		uint32_t ipv4 = htonl(ast_sockaddr_ipv4(addr));
+
+		memcpy(bytes, &ipv4, 4);
+		return 4;
+	}
+	if (ast_sockaddr_is_ipv6(addr)) {
+		memcpy(bytes, ((const struct sockaddr_in6 *) &addr->ss)->sin6_addr.s6_addr, 16);
+		return 16;
+	}
+	return 0;
+}
+
+/*! \brief Clear all address bits past the prefix length */
+static void identify_addr_mask(unsigned char *bytes, int len, unsigned int bits)
+{
+	int i;
+
+	for (i = 0; i < len; ++i) {
+		if (bits >= 8) {
+			bits -= 8;
+		} else {
+			bytes[i] &= (0xff << (8 - bits)) & 0xff;
+			bits = 0;
+		}
+	}
+}
+
+/*!
+ * \brief Get the prefix length of a netmask
+ *
+ * \retval -1 if the netmask is not a contiguous prefix
+ */
+static int identify_netmask_bits(const unsigned char *mask, int len)
+{
+	int bits = 0;
+	int i;
+
+	for (i = 0; i < len && mask[i] == 0xff; ++i) {
+		bits += 8;
+	}
+	if (i < len) {
+		unsigned char partial = mask[i++];
+
+		while (partial & 0x80) {
+			partial <<= 1;
+			++bits;
+		}
+		if (partial) {
+			return -1;
+		}
+	}
+	for (; i < len; ++i) {
+		if (mask[i]) {
+			return -1;
+		}
+	}
+	return bits;
+}
+
+static int identify_prefix_cmp(const void *a, const void *b)
+{
+	const struct identify_prefix *left = a;
+	const struct identify_prefix *right = b;
+	int res;
+
+	res = memcmp(left->addr, right->addr, sizeof(left->addr));
+	if (res) {
+		return res;
+	}
+	return left->port - right->port;
+}
+
+static int identify_prefix_group_cmp(const void *a, const void *b)
+{
+	const struct identify_prefix_group *left = a;
+	const struct identify_prefix_group *right = b;
+
+	/* Longest prefix first */
+	return right->bits - left->bits;
+}
+
+/*!
+ * \brief Add a single match rule to the prefix tables
+ *
+ * \retval -1 if the rule cannot be indexed
+ */
+static int identify_index_add_ha(struct identify_index *index, struct ip_identify_match *identify,
+	const struct ast_ha *ha)
+{
+	struct identify_prefix_table *table;
+	struct identify_prefix_group *group = NULL;
+	struct identify_prefix prefix = { .identify = identify, };
+	unsigned char mask[16];
+	int len;
+	int bits;
+	int i;
+
+	len = identify_addr_bytes(&ha->netmask, mask);
+	if (!len || identify_addr_bytes(&ha->addr, prefix.addr) != len) {
+		return -1;
+	}
+	bits = identify_netmask_bits(mask, len);
+	if (bits < 0) {
+		return -1;
+	}
+	identify_addr_mask(prefix.addr, len, bits);
+	prefix.port = ast_sockaddr_port(&ha->addr);
+
+	table = len == 4 ? &index->ipv4 : &index->ipv6;
+	for (i = 0; i < AST_VECTOR_SIZE(table); ++i) {
+		if (AST_VECTOR_GET_ADDR(table, i)->bits == bits) {
+			group = AST_VECTOR_GET_ADDR(table, i);
+			break;
+		}
+	}
+	if (!group) {
+		struct identify_prefix_group new_group = { .bits = bits, };
+
+		if (AST_VECTOR_INIT(&new_group.prefixes, 8)) {
+			return -1;
+		}
+		if (AST_VECTOR_APPEND(table, new_group)) {
+			AST_VECTOR_FREE(&new_group.prefixes);
+			return -1;
+		}
+		group = AST_VECTOR_GET_ADDR(table, AST_VECTOR_SIZE(table) - 1);
+	}
+
+	return AST_VECTOR_APPEND(&group->prefixes, prefix);
+}
+
+static int identify_index_add_header(struct identify_index *index, struct ip_identify_match *identify)
+{
+	struct identify_header *header;
+	size_t name_len = strlen(identify->match_header_name);
+	size_t i;
+	int res;
+
+	if (identify->is_regex) {
+		return AST_VECTOR_APPEND(&index->header_regexes, identify);
+	}
+
+	header = ao2_alloc_options(sizeof(*header) + name_len + strlen(identify->match_header_value) + 2,
+		identify_header_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!header) {
+		return -1;
+	}
+	header->identify = ao2_bump(identify);
+	sprintf(header->key, "%s:%s", identify->match_header_name, identify->match_header_value); /* Safe */
+	for (i = 0; i < name_len; ++i) {
+		header->key[i] = tolower(header->key[i]);
+	}
+	res = !ao2_link(index->headers, header);
+	ao2_ref(header, -1);
+	if (res) {
+		return -1;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&index->header_names); ++i) {
+		if (!strcasecmp(AST_VECTOR_GET(&index->header_names, i), identify->match_header_name)) {
+			return 0;
+		}
+	}
+	return AST_VECTOR_APPEND(&index->header_names, identify->match_header_name);
+}
+
+static struct identify_index *identify_index_build(void)
+{
+	struct ao2_container *candidates;
+	struct identify_index *index;
+	struct ip_identify_match *identify;
+	struct ao2_iterator iter;
+	int res = 0;
+	int i;
 
-	/* If no possibilities exist return early to save some time */
 	candidates = ast_sorcery_retrieve_by_fields(ast_sip_get_sorcery(), "identify",
 		AST_RETRIEVE_FLAG_MULTIPLE | AST_RETRIEVE_FLAG_ALL, NULL);
-	if (!candidates || !ao2_container_count(candidates)) {
-		ast_debug(3, "No identify sections to match against\n");
+	if (!candidates) {
 		return NULL;
 	}
 
-	match = ao2_callback(candidates, 0, identify_match_cb, arg);
-	if (!match) {
+	index = ao2_alloc_options(sizeof(*index), identify_index_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!index
+		|| AST_VECTOR_INIT(&index->identifies, ao2_container_count(candidates))
+		|| AST_VECTOR_INIT(&index->ipv4, 4)
+		|| AST_VECTOR_INIT(&index->ipv6, 4)
+		|| AST_VECTOR_INIT(&index->unindexed_matches, 0)
+		|| AST_VECTOR_INIT(&index->header_names, 0)
+		|| AST_VECTOR_INIT(&index->header_regexes, 0)
+		|| !(index->headers = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0,
+			IDENTIFY_HEADER_BUCKETS, identify_header_hash, NULL, identify_header_cmp))) {
+		ao2_cleanup(index);
+		ao2_ref(candidates, -1);
+		return NULL;
+	}
+
+	iter = ao2_iterator_init(candidates, 0);
+	while (!res && (identify = ao2_iterator_next(&iter))) {
+		struct ast_ha *ha;
+
+		/* The index keeps the reference from the iterator */
+		if (AST_VECTOR_APPEND(&index->identifies, identify)) {
+			ao2_ref(identify, -1);
+			res = -1;
+			break;
+		}
+
+		for (ha = identify->matches; ha; ha = ha->next) {
+			if (identify_index_add_ha(index, identify, ha)) {
+				/* Check all of this identify's rules the slow way instead */
+				res = AST_VECTOR_APPEND(&index->unindexed_matches, identify);
+				break;
+			}
+		}
+
+		if (!res && !ast_strlen_zero(identify->match_header)) {
+			res = identify_index_add_header(index, identify);
+		}
+	}
+	ao2_iterator_destroy(&iter);
+	ao2_ref(candidates, -1);
+
+	if (res) {
+		ao2_ref(index, -1);
 		return NULL;
 	}
 
+	for (i = 0; i < AST_VECTOR_SIZE(&index->ipv4); ++i) {
+		AST_VECTOR_SORT(&AST_VECTOR_GET_ADDR(&index->ipv4, i)->prefixes, identify_prefix_cmp);
+	}
+	for (i = 0; i < AST_VECTOR_SIZE(&index->ipv6); ++i) {
+		AST_VECTOR_SORT(&AST_VECTOR_GET_ADDR(&index->ipv6, i)->prefixes, identify_prefix_cmp);
+	}
+	AST_VECTOR_SORT(&index->ipv4, identify_prefix_group_cmp);
+	AST_VECTOR_SORT(&index->ipv6, identify_prefix_group_cmp);
+
+	ast_debug(3, "Built identify index of %zu identifies\n", AST_VECTOR_SIZE(&index->identifies));
+
+	return index;
+}
+
+/*!
+ * \brief Get the current identify index, building it if needed
+ *
+ * \retval NULL if identifies must be matched by scanning them all
+ */
+static struct identify_index *identify_index_get(void)
+{
+	struct identify_index *index;
+	int generation;
+
+	if (!index_usable) {
+		return NULL;
+	}
+
+	index = ao2_global_obj_ref(current_index);
+	if (index) {
+		return index;
+	}
+
+	ast_mutex_lock(&index_build_lock);
+	index = ao2_global_obj_ref(current_index);
+	if (!index) {
+		generation = ast_atomic_fetchadd_int(&index_generation, 0);
+		index = identify_index_build();
+		if (index && generation == ast_atomic_fetchadd_int(&index_generation, 0)) {
+			ao2_global_obj_replace_unref(current_index, index);
+		}
+	}
+	ast_mutex_unlock(&index_build_lock);
+
+	return index;
+}
+
+static void identify_index_invalidate(void)
+{
+	ast_atomic_fetchadd_int(&index_generation, +1);
+	ao2_global_obj_release(current_index);
+}
+
+/*! \brief Only identifies that come solely from configuration files can be indexed */
+static int identify_index_check_usable(void)
+{
+	int count = ast_sorcery_get_wizard_mapping_count(ast_sip_get_sorcery(), "identify");
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		struct ast_sorcery_wizard *wizard;
+
+		if (ast_sorcery_get_wizard_mapping(ast_sip_get_sorcery(), "identify", i, &wizard, NULL)
+			|| strcmp(wizard->name, "config")) {
+			return 0;
+		}
+	}
+
+	return count > 0;
+}
+
+static void identify_changed(const void *obj)
+{
+	identify_index_invalidate();
+}
+
+static void identify_loaded(const char *type)
+{
+	index_usable = identify_index_check_usable();
+	identify_index_invalidate();
+}
+
+static const struct ast_sorcery_observer identify_observer_callbacks = {
+	.created = identify_changed,
+	.updated = identify_changed,
+	.deleted = identify_changed,
+	.loaded = identify_loaded,
+};
+
+/*! \brief Find the identify with the longest prefix matching an address */
+static struct ip_identify_match *identify_index_find_addr(struct identify_index *index,
+	const struct ast_sockaddr *addr)
+{
+	const struct ast_sockaddr *lookup = addr;
+	struct ast_sockaddr mapped;
+	struct identify_prefix_table *table;
+	unsigned char bytes[16];
+	uint16_t port;
+	int len;
+	int i;
+
+	/* IPv4 rules apply to IPv4-mapped addresses, as in ast_apply_ha() */
+	if (ast_sockaddr_is_ipv4_mapped(addr) && ast_sockaddr_ipv4_mapped(addr, &mapped)) {
+		lookup = &mapped;
+	}
+
+	len = identify_addr_bytes(lookup, bytes);
+	port = ast_sockaddr_port(addr);
+	table = len == 4 ? &index->ipv4 : len == 16 ? &index->ipv6 : NULL;
+
+	for (i = 0; table && i < AST_VECTOR_SIZE(table); ++i) {
+		struct identify_prefix_group *group = AST_VECTOR_GET_ADDR(table, i);
+		struct identify_prefix key = { .port = 0, };
+		size_t low = 0;
+		size_t high = AST_VECTOR_SIZE(&group->prefixes);
+
+		memcpy(key.addr, bytes, sizeof(key.addr));
+		identify_addr_mask(key.addr, len, group->bits);
+
+		/* Find the first prefix of this address, port 0 sorts first */
+		while (low < high) {
+			size_t mid = low + (high - low) / 2;
+
+			if (identify_prefix_cmp(AST_VECTOR_GET_ADDR(&group->prefixes, mid), &key) < 0) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+
+		for (; low < AST_VECTOR_SIZE(&group->prefixes); ++low) {
+			struct identify_prefix *prefix = AST_VECTOR_GET_ADDR(&group->prefixes, low);
+
+			if (memcmp(prefix->addr, key.addr, sizeof(key.addr))) {
+				break;
+			}
+			if (!prefix->port || prefix->port == port) {
+				ast_debug(3, "Source address %s matches identify '%s'\n",
+					ast_sockaddr_stringify(addr), ast_sorcery_object_get_id(prefix->identify));
+				return prefix->identify;
+			}
+		}
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&index->unindexed_matches); ++i) {
+		struct ip_identify_match *identify = AST_VECTOR_GET(&index->unindexed_matches, i);
+
+		if (ip_identify_match_check(identify, (void *) addr, 0)) {
+			return identify;
+		}
+	}
+
+	return NULL;
+}
+
+/*! \brief Find the identify matching a header of a message */
+static struct ip_identify_match *identify_index_find_header(struct identify_index *index,
+	pjsip_rx_data *rdata)
+{
+	int i;
+
+	for (i = 0; i < AST_VECTOR_SIZE(&index->header_names); ++i) {
+		const char *name = AST_VECTOR_GET(&index->header_names, i);
+		pj_str_t pj_header_name = pj_str((char *) name);
+		size_t name_len = strlen(name);
+		pjsip_hdr *header;
+
+		for (header = NULL;
+			(header = ast_sip_rdata_find_header(rdata, &pj_header_name, header));) {
+			char buf[PATH_MAX];
+			char key[PATH_MAX + 64];
+			struct identify_header *match;
+			char *pos;
+			size_t j;
+
+			pos = header_value_print(header, buf, sizeof(buf));
+			if (!pos || name_len + strlen(pos) + 2 > sizeof(key)) {
+				continue;
+			}
+			sprintf(key, "%s:%s", name, pos); /* Safe */
+			for (j = 0; j < name_len; ++j) {
+				key[j] = tolower(key[j]);
+			}
+
+			match = ao2_find(index->headers, key, OBJ_SEARCH_KEY);
+			if (match) {
+				struct ip_identify_match *identify = match->identify;
+
+				/* The index still holds a reference to the identify */
+				ao2_ref(match, -1);
+				return identify;
+			}
+		}
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&index->header_regexes); ++i) {
+		struct ip_identify_match *identify = AST_VECTOR_GET(&index->header_regexes, i);
+
+		if (header_identify_match_check(identify, rdata, 0)) {
+			return identify;
+		}
+	}
+
+	return NULL;
+}
+
+/*! \brief Get the endpoint an identify points to */
+static struct ast_sip_endpoint *identify_get_endpoint(struct ip_identify_match *match)
+{
+	struct ast_sip_endpoint *endpoint;
+
 	endpoint = ast_sorcery_retrieve_by_id(ast_sip_get_sorcery(), "endpoint",
 		match->endpoint_name);
 	if (endpoint) {
@@ -291,6 +873,30 @@ static struct ast_sip_endpoint *common_identify(ao2_callback_fn *identify_match_
 			ast_sorcery_object_get_id(match), match->endpoint_name);
 	}
 
+	return endpoint;
+}
+
+static struct ast_sip_endpoint *common_identify(ao2_callback_fn *identify_match_cb, void *arg)
+{
+	RAII_VAR(struct ao2_container *, candidates, NULL, ao2_cleanup);
+	struct ip_identify_match *match;
+	struct ast_sip_endpoint *endpoint;
+
+	/* If no possibilities exist return early to save some time */
+	candidates = ast_sorcery_retrieve_by_fields(ast_sip_get_sorcery(), "identify",
+		AST_RETRIEVE_FLAG_MULTIPLE | AST_RETRIEVE_FLAG_ALL, NULL);
+	if (!candidates || !ao2_container_count(candidates)) {
+		ast_debug(3, "No identify sections to match against\n");
+		return NULL;
+	}
+
+	match = ao2_callback(candidates, 0, identify_match_cb, arg);
+	if (!match) {
+		return NULL;
+	}
+
+	endpoint = identify_get_endpoint(match);
+
 	ao2_ref(match, -1);
 	return endpoint;
 }
@@ -298,11 +904,25 @@ static struct ast_sip_endpoint *common_identify(ao2_callback_fn *identify_match_
 static struct ast_sip_endpoint *ip_identify(pjsip_rx_data *rdata)
 {
 	struct ast_sockaddr addr = { { 0, } };
+	struct identify_index *index;
+	struct ip_identify_match *match;
+	struct ast_sip_endpoint *endpoint = NULL;
 
 	ast_sockaddr_parse(&addr, rdata->pkt_info.src_name, PARSE_PORT_FORBID);
 	ast_sockaddr_set_port(&addr, rdata->pkt_info.src_port);
 
-	return common_identify(ip_identify_match_check, &addr);
+	index = identify_index_get();
+	if (!index) {
+		return common_identify(ip_identify_match_check, &addr);
+	}
+
+	match = identify_index_find_addr(index, &addr);
+	if (match) {
+		endpoint = identify_get_endpoint(match);
+	}
+	ao2_ref(index, -1);
+
+	return endpoint;
 }
 
 static struct ast_sip_endpoint_identifier ip_identifier = {
@@ -311,7 +931,22 @@ static struct ast_sip_endpoint_identifier ip_identifier = {
 
 static struct ast_sip_endpoint *header_identify(pjsip_rx_data *rdata)
 {
-	return common_identify(header_identify_match_check, rdata);
+	struct identify_index *index;
+	struct ip_identify_match *match;
+	struct ast_sip_endpoint *endpoint = NULL;
+
+	index = identify_index_get();
+	if (!index) {
+		return common_identify(header_identify_match_check, rdata);
+	}
+
+	match = identify_index_find_header(index, rdata);
+	if (match) {
+		endpoint = identify_get_endpoint(match);
+	}
+	ao2_ref(index, -1);
+
+	return endpoint;
 }
 
 static struct ast_sip_endpoint_identifier header_identifier = {
@@ -854,6 +1489,9 @@ static int load_module(void)
 	ast_sorcery_object_field_register(ast_sip_get_sorcery(), "identify", "srv_lookups", "yes", OPT_BOOL_T, 1, FLDSET(struct ip_identify_match, srv_lookups));
 	ast_sorcery_load_object(ast_sip_get_sorcery(), "identify");
 
+	index_usable = identify_index_check_usable();
+	ast_sorcery_observer_add(ast_sip_get_sorcery(), "identify", &identify_observer_callbacks);
+
 	ast_sip_register_endpoint_identifier_with_name(&ip_identifier, "ip");
 	ast_sip_register_endpoint_identifier_with_name(&header_identifier, "header");
 	ast_sip_register_endpoint_formatter(&endpoint_identify_formatter);
@@ -891,6 +1529,8 @@ static int unload_module(void)
 	ast_sip_unregister_endpoint_formatter(&endpoint_identify_formatter);
 	ast_sip_unregister_endpoint_identifier(&header_identifier);
 	ast_sip_unregister_endpoint_identifier(&ip_identifier);
+	ast_sorcery_observer_remove(ast_sip_get_sorcery(), "identify", &identify_observer_callbacks);
+	ao2_global_obj_release(current_index);
 
 	return 0;
 }
@@ -83,6 +83,8 @@ struct exten_state_subscription {
 	enum ast_extension_states last_exten_state;
 	/*! The last known presence state */
 	enum ast_presence_state last_presence_state;
+	/*! The newest state change not yet sent, protected by the object lock */
+	struct notify_task_data *pending_notify;
 };
 
 /*!
@@ -171,6 +173,7 @@ static void exten_state_subscription_destructor(void *obj)
 {
 	struct exten_state_subscription *sub = obj;
 
+	ao2_cleanup(sub->pending_notify);
 	ast_free(sub->user_agent);
 	ast_sip_subscription_destroy(sub->sip_sub);
 	ast_taskprocessor_unreference(sub->serializer);
@@ -287,12 +290,22 @@ static struct notify_task_data *alloc_notify_task_data(const char *exten,
 
 static int notify_task(void *obj)
 {
-	RAII_VAR(struct notify_task_data *, task_data, obj, ao2_cleanup);
+	RAII_VAR(struct exten_state_subscription *, exten_state_sub, obj, ao2_cleanup);
+	RAII_VAR(struct notify_task_data *, task_data, NULL, ao2_cleanup);
 	struct ast_sip_body_data data = {
 		.body_type = AST_SIP_EXTEN_STATE_DATA,
-		.body_data = &task_data->exten_state_data,
 	};
 
+	/* Only the newest state change queued since the last NOTIFY is sent */
+	ao2_lock(exten_state_sub);
+	task_data = exten_state_sub->pending_notify;
+	exten_state_sub->pending_notify = NULL;
+	ao2_unlock(exten_state_sub);
+	if (!task_data) {
+		return 0;
+	}
+	data.body_data = &task_data->exten_state_data;
+
 	/* Terminated subscriptions are no longer associated with a valid tree, and sending
 	 * NOTIFY messages on a subscription which has already been terminated won't work.
 	 */
@@ -334,17 +347,42 @@ static int state_changed(const char *context, const char *exten,
 	struct ast_state_cb_info *info, void *data)
 {
 	struct notify_task_data *task_data;
+	struct notify_task_data *superseded;
 	struct exten_state_subscription *exten_state_sub = data;
 
 	if (!(task_data = alloc_notify_task_data(exten, exten_state_sub, info))) {
 		return -1;
 	}
 
+	/*
+	 * If a NOTIFY is already queued for this subscription it has not
+	 * built its body yet, so just hand it the newer state.  A busy
+	 * extension then costs one NOTIFY per drain of the serializer
+	 * instead of one per state change.
+	 */
+	ao2_lock(exten_state_sub);
+	superseded = exten_state_sub->pending_notify;
+	if (superseded) {
+		task_data->terminate |= superseded->terminate;
+	}
+	exten_state_sub->pending_notify = task_data;
+	ao2_unlock(exten_state_sub);
+
+	if (superseded) {
+		ast_debug(3, "Coalesced state change of '%s' into the queued NOTIFY\n", exten);
+		ao2_ref(superseded, -1);
+		return 0;
+	}
+
 	/* safe to push this async since we copy the data from info and
 	   add a ref for the device state info */
-	if (ast_sip_push_task(task_data->exten_state_sub->serializer, notify_task,
-		task_data)) {
-		ao2_cleanup(task_data);
+	ao2_ref(exten_state_sub, +1);
+	if (ast_sip_push_task(exten_state_sub->serializer, notify_task, exten_state_sub)) {
+		ao2_lock(exten_state_sub);
+		ao2_cleanup(exten_state_sub->pending_notify);
+		exten_state_sub->pending_notify = NULL;
+		ao2_unlock(exten_state_sub);
+		ao2_ref(exten_state_sub, -1);
 		return -1;
 	}
 	return 0;
@@ -35,6 +35,8 @@
 #include "asterisk/cli.h"
 #include "asterisk/netsock2.h"
 #include "asterisk/acl.h"
+#include "asterisk/lock.h"
+#include "asterisk/utils.h"
 
 /*! \brief PCAP Header */
 struct pcap_header {
@@ -120,6 +122,67 @@ struct pjsip_logger_session {
 /*! \brief The default logger session */
 static struct pjsip_logger_session *default_logger;
 
+/*! \brief Size of the capture ring used when logging asynchronously */
+#define CAPTURE_RING_SIZE (4 * 1024 * 1024)
+
+/*! \brief Length value marking the unused end of the capture ring */
+#define CAPTURE_RECORD_WRAP SIZE_MAX
+
+/*! \brief Packet as stored in the capture ring, followed by the raw packet bytes */
+struct capture_record {
+	/*! \brief Length of the packet bytes following the record */
+	size_t len;
+	/*! \brief When the packet was handled */
+	struct timeval when;
+	/*! \brief Remote address of the packet */
+	pj_sockaddr addr;
+	/*! \brief Transport type name */
+	char transport[16];
+	/*! \brief Whether the packet was transmitted or received */
+	unsigned int transmitted:1;
+	/*! \brief Whether the packet is a request or a response */
+	unsigned int request:1;
+};
+
+/*!
+ * \brief Ring of captured packets waiting for the capture thread
+ *
+ * Transport threads only copy the raw packet in.  Formatting for verbose
+ * and writing to the pcap file happens on the capture thread.  When the
+ * ring is full packets are dropped and counted rather than blocking the
+ * transport.
+ */
+static struct {
+	/*! \brief Protects the ring */
+	ast_mutex_t lock;
+	/*! \brief Signalled when a packet is added or the thread must stop */
+	ast_cond_t cond;
+	/*! \brief The ring itself, NULL when logging synchronously */
+	char *buf;
+	/*! \brief Offset the next record is written at */
+	size_t head;
+	/*! \brief Offset of the oldest record */
+	size_t tail;
+	/*! \brief Bytes in use, including any unused end skipped by a wrap */
+	size_t used;
+	/*! \brief Packets dropped because the ring was full */
+	unsigned int dropped;
+	/*! \brief Set to stop the capture thread */
+	unsigned int stop:1;
+	/*! \brief The capture thread */
+	pthread_t thread;
+} capture = {
+	.thread = AST_PTHREADT_NULL,
+};
+
+/*! \brief Space a packet of the given length takes up in the capture ring */
+static size_t capture_record_size(size_t len)
+{
+	size_t size = sizeof(struct capture_record) + len;
+
+	return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
 /*! \brief Destructor for logger session */
 static void pjsip_logger_session_destroy(void *obj)
 {
@@ -178,12 +241,11 @@ static inline int pjsip_log_test_addr(const struct pjsip_logger_session *session
 }
 
 static void pjsip_logger_write_to_pcap(struct pjsip_logger_session *session, const char *msg, size_t msg_len,
-	pj_sockaddr *source, pj_sockaddr *destination)
+	pj_sockaddr *source, pj_sockaddr *destination, const struct timeval *when)
 {
-	struct timeval now = ast_tvnow();
 	struct pcap_record_header pcap_record_header = {
-		.ts_sec = now.tv_sec,
-		.ts_usec = now.tv_usec,
+		.ts_sec = when->tv_sec,
+		.ts_usec = when->tv_usec,
 	};
 	struct pcap_ethernet_header pcap_ethernet_header = {
 		.type = 0,
@@ -265,10 +327,222 @@ static void pjsip_logger_write_to_pcap(struct pjsip_logger_session *session, con
 	ao2_unlock(session);
 }
 
-static pj_status_t logging_on_tx_msg(pjsip_tx_data *tdata)
+/*!
+ * \internal
+ * \brief Copy a packet into the capture ring
+ *
+ * \retval 0 if the packet was queued or dropped
+ * \retval -1 if the ring is not in use and the packet must be logged directly
+ */
+static int capture_queue(const struct capture_record *record, const char *data)
+{
+	size_t size = capture_record_size(record->len);
+	size_t offset;
+
+	ast_mutex_lock(&capture.lock);
+	if (!capture.buf) {
+		ast_mutex_unlock(&capture.lock);
+		return -1;
+	}
+
+	if (!capture.used) {
+		capture.head = capture.tail = 0;
+	}
+
+	if (capture.head >= capture.tail && CAPTURE_RING_SIZE - capture.head >= size) {
+		offset = capture.head;
+	} else if (capture.head >= capture.tail && capture.tail > size) {
+		/* Skip the unused end, marking it if a record header fits */
+		if (CAPTURE_RING_SIZE - capture.head >= sizeof(struct capture_record)) {
+			((struct capture_record *) (capture.buf + capture.head))->len = CAPTURE_RECORD_WRAP;
+		}
+		capture.used += CAPTURE_RING_SIZE - capture.head;
+		offset = 0;
+	} else if (capture.head < capture.tail && capture.tail - capture.head > size) {
+		offset = capture.head;
+	} else {
+		++capture.dropped;
+		ast_mutex_unlock(&capture.lock);
+		return 0;
+	}
+
+	memcpy(capture.buf + offset, record, sizeof(*record));
+	memcpy(capture.buf + offset + sizeof(*record), data, record->len);
+	capture.head = offset + size;
+	capture.used += size;
+
+	ast_cond_signal(&capture.cond);
+	ast_mutex_unlock(&capture.lock);
+
+	return 0;
+}
+
+/*! \brief Log one packet to verbose and pcap as configured */
+static void capture_output(const struct capture_record *record, const char *data)
 {
 	char buffer[AST_SOCKADDR_BUFLEN];
 
+	if (default_logger->log_to_verbose) {
+		ast_verbose("<--- %s SIP %s (%d bytes) %s %s:%s --->\n%.*s\n",
+			record->transmitted ? "Transmitting" : "Received",
+			record->request ? "request" : "response",
+			(int) record->len,
+			record->transmitted ? "to" : "from",
+			record->transport,
+			pj_sockaddr_print(&record->addr, buffer, sizeof(buffer), 3),
+			(int) record->len, data);
+	}
+
+	if (default_logger->log_to_pcap) {
+		pj_sockaddr addr;
+
+		pj_sockaddr_cp(&addr, &record->addr);
+		pjsip_logger_write_to_pcap(default_logger, data, record->len,
+			record->transmitted ? NULL : &addr, record->transmitted ? &addr : NULL,
+			&record->when);
+	}
+}
+
+/*! \brief Capture thread, logs packets queued by the transport threads */
+static void *capture_thread(void *data)
+{
+	struct capture_record *record;
+	char *copy = NULL;
+	size_t copy_size = 0;
+	size_t size;
+	unsigned int dropped;
+	int copied;
+
+	ast_mutex_lock(&capture.lock);
+	for (;;) {
+		while (!capture.used && !capture.dropped && !capture.stop) {
+			ast_cond_wait(&capture.cond, &capture.lock);
+		}
+
+		dropped = capture.dropped;
+		capture.dropped = 0;
+		copied = 0;
+
+		if (capture.used) {
+			record = (struct capture_record *) (capture.buf + capture.tail);
+			if (CAPTURE_RING_SIZE - capture.tail < sizeof(*record) || record->len == CAPTURE_RECORD_WRAP) {
+				capture.used -= CAPTURE_RING_SIZE - capture.tail;
+				capture.tail = 0;
+				record = (struct capture_record *) capture.buf;
+			}
+
+			size = capture_record_size(record->len);
+			if (size > copy_size) {
+				char *bigger = ast_realloc(copy, size);
+
+				if (bigger) {
+					copy = bigger;
+					copy_size = size;
+				}
+			}
+			if (size <= copy_size) {
+				memcpy(copy, record, size);
+				copied = 1;
+			} else {
+				++dropped;
+			}
+
+			capture.tail += size;
+			capture.used -= size;
+		} else if (capture.stop) {
+			break;
+		}
+		ast_mutex_unlock(&capture.lock);
+
+		if (dropped) {
+			ast_log(LOG_WARNING, "PJSIP logger dropped %u packets, the capture ring was full\n", dropped);
+		}
+		if (copied) {
+			capture_output((struct capture_record *) copy, copy + sizeof(struct capture_record));
+		}
+
+		ast_mutex_lock(&capture.lock);
+	}
+	ast_mutex_unlock(&capture.lock);
+
+	ast_free(copy);
+
+	return NULL;
+}
+
+/*! \brief Serializes starting and stopping the capture thread */
+AST_MUTEX_DEFINE_STATIC(capture_thread_lock);
+
+/*! \brief Switch between logging on the transport threads and on the capture thread */
+static int capture_set_async(int async)
+{
+	char *buf = NULL;
+
+	SCOPED_MUTEX(thread_lock, &capture_thread_lock);
+
+	if (async) {
+		ast_mutex_lock(&capture.lock);
+		if (capture.buf) {
+			ast_mutex_unlock(&capture.lock);
+			return 0;
+		}
+		ast_mutex_unlock(&capture.lock);
+
+		buf = ast_malloc(CAPTURE_RING_SIZE);
+		if (!buf) {
+			return -1;
+		}
+
+		ast_mutex_lock(&capture.lock);
+		capture.buf = buf;
+		capture.head = capture.tail = capture.used = 0;
+		capture.dropped = 0;
+		capture.stop = 0;
+		ast_mutex_unlock(&capture.lock);
+
+		if (ast_pthread_create_background(&capture.thread, NULL, capture_thread, NULL)) {
+			ast_mutex_lock(&capture.lock);
+			capture.buf = NULL;
+			ast_mutex_unlock(&capture.lock);
+			capture.thread = AST_PTHREADT_NULL;
+			ast_free(buf);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (capture.thread == AST_PTHREADT_NULL) {
+		return 0;
+	}
+
+	/* Stop queueing, let the thread drain what is left and exit */
+	ast_mutex_lock(&capture.lock);
+	capture.stop = 1;
+	ast_cond_signal(&capture.cond);
+	ast_mutex_unlock(&capture.lock);
+
+	pthread_join(capture.thread, NULL);
+	capture.thread = AST_PTHREADT_NULL;
+
+	ast_mutex_lock(&capture.lock);
+	buf = capture.buf;
+	capture.buf = NULL;
+	ast_mutex_unlock(&capture.lock);
+
+	ast_free(buf);
+
+	return 0;
+}
+
+static pj_status_t logging_on_tx_msg(pjsip_tx_data *tdata)
+{
+	struct capture_record record = {
+		.len = tdata->buf.cur - tdata->buf.start,
+		.transmitted = 1,
+		.request = tdata->msg->type == PJSIP_REQUEST_MSG,
+	};
+
 	ao2_rdlock(default_logger);
 	if (!pjsip_log_test_addr(default_logger, tdata->tp_info.dst_name, tdata->tp_info.dst_port)) {
 		ao2_unlock(default_logger);
@@ -276,18 +550,12 @@ static pj_status_t logging_on_tx_msg(pjsip_tx_data *tdata)
 	}
 	ao2_unlock(default_logger);
 
-	if (default_logger->log_to_verbose) {
-		ast_verbose("<--- Transmitting SIP %s (%d bytes) to %s:%s --->\n%.*s\n",
-			tdata->msg->type == PJSIP_REQUEST_MSG ? "request" : "response",
-			(int) (tdata->buf.cur - tdata->buf.start),
-			tdata->tp_info.transport->type_name,
-			pj_sockaddr_print(&tdata->tp_info.dst_addr, buffer, sizeof(buffer), 3),
-			(int) (tdata->buf.end - tdata->buf.start), tdata->buf.start);
-	}
+	record.when = ast_tvnow();
+	pj_sockaddr_cp(&record.addr, &tdata->tp_info.dst_addr);
+	ast_copy_string(record.transport, tdata->tp_info.transport->type_name, sizeof(record.transport));
 
-	if (default_logger->log_to_pcap) {
-		pjsip_logger_write_to_pcap(default_logger, tdata->buf.start, (int) (tdata->buf.cur - tdata->buf.start),
-			NULL, &tdata->tp_info.dst_addr);
+	if (capture_queue(&record, tdata->buf.start)) {
+		capture_output(&record, tdata->buf.start);
 	}
 
 	return PJ_SUCCESS;
@@ -295,7 +563,9 @@ static pj_status_t logging_on_tx_msg(pjsip_tx_data *tdata)
 
 static pj_bool_t logging_on_rx_msg(pjsip_rx_data *rdata)
 {
-	char buffer[AST_SOCKADDR_BUFLEN];
+	struct capture_record record = {
+		.len = rdata->msg_info.len,
+	};
 
 	if (!rdata->msg_info.msg) {
 		return PJ_FALSE;
@@ -308,18 +578,13 @@ static pj_bool_t logging_on_rx_msg(pjsip_rx_data *rdata)
 	}
 	ao2_unlock(default_logger);
 
-	if (default_logger->log_to_verbose) {
-		ast_verbose("<--- Received SIP %s (%d bytes) from %s:%s --->\n%s\n",
-			rdata->msg_info.msg->type == PJSIP_REQUEST_MSG ? "request" : "response",
-			rdata->msg_info.len,
-			rdata->tp_info.transport->type_name,
-			pj_sockaddr_print(&rdata->pkt_info.src_addr, buffer, sizeof(buffer), 3),
-			rdata->pkt_info.packet);
-	}
+	record.request = rdata->msg_info.msg->type == PJSIP_REQUEST_MSG;
+	record.when = ast_tvnow();
+	pj_sockaddr_cp(&record.addr, &rdata->pkt_info.src_addr);
+	ast_copy_string(record.transport, rdata->tp_info.transport->type_name, sizeof(record.transport));
 
-	if (default_logger->log_to_pcap) {
-		pjsip_logger_write_to_pcap(default_logger, rdata->pkt_info.packet, rdata->msg_info.len,
-			&rdata->pkt_info.src_addr, NULL);
+	if (capture_queue(&record, rdata->pkt_info.packet)) {
+		capture_output(&record, rdata->pkt_info.packet);
 	}
 
 	return PJ_FALSE;
@@ -415,6 +680,8 @@ static char *pjsip_disable_logger(int fd)
 
 	ao2_unlock(default_logger);
 
+	capture_set_async(0);
+
 	if (fd >= 0) {
 		ast_cli(fd, "PJSIP Logging disabled\n");
 	}
@@ -433,6 +700,18 @@ static char *pjsip_set_logger_verbose(int fd, const char *arg)
 	return CLI_SUCCESS;
 }
 
+static char *pjsip_set_logger_async(int fd, const char *arg)
+{
+	if (capture_set_async(ast_true(arg))) {
+		ast_cli(fd, "Failed to start the PJSIP logger capture thread\n");
+		return CLI_SUCCESS;
+	}
+
+	ast_cli(fd, "PJSIP asynchronous logging has been %s\n", ast_true(arg) ? "enabled" : "disabled");
+
+	return CLI_SUCCESS;
+}
+
 static char *pjsip_set_logger_pcap(int fd, const char *arg)
 {
 	struct pcap_header pcap_header = {
@@ -472,13 +751,17 @@ static char *pjsip_set_logger(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 	const char *what;
 
 	if (cmd == CLI_INIT) {
-		e->command = "pjsip set logger {on|off|host|add|verbose|pcap}";
+		e->command = "pjsip set logger {on|off|host|add|verbose|pcap|async}";
 		e->usage =
-			"Usage: pjsip set logger {on|off|host <name/subnet>|add <name/subnet>|verbose <on/off>|pcap <filename>}\n"
+			"Usage: pjsip set logger {on|off|host <name/subnet>|add <name/subnet>|verbose <on/off>|pcap <filename>|async <on/off>}\n"
 			"       Enables or disabling logging of SIP packets\n"
 			"       read on ports bound to PJSIP transports either\n"
 			"       globally or enables logging for an individual\n"
-			"       host.\n";
+			"       host.\n"
+			"       With async on, packets are copied into a capture\n"
+			"       ring and logged by a separate thread instead of\n"
+			"       on the transport threads.  Packets arriving while\n"
+			"       the ring is full are dropped and counted.\n";
 		return NULL;
 	} else if (cmd == CLI_GENERATE) {
 		return NULL;
@@ -501,6 +784,8 @@ static char *pjsip_set_logger(struct ast_cli_entry *e, int cmd, struct ast_cli_a
 			return pjsip_set_logger_verbose(a->fd, a->argv[e->args]);
 		} else if (!strcasecmp(what, "pcap")) {
 			return pjsip_set_logger_pcap(a->fd, a->argv[e->args]);
+		} else if (!strcasecmp(what, "async")) {
+			return pjsip_set_logger_async(a->fd, a->argv[e->args]);
 		}
 	}
 
@@ -542,8 +827,13 @@ static const struct ast_sorcery_observer global_observer = {
 
 static int load_module(void)
 {
+	ast_mutex_init(&capture.lock);
+	ast_cond_init(&capture.cond, NULL);
+
 	if (ast_sorcery_observer_add(ast_sip_get_sorcery(), "global", &global_observer)) {
 		ast_log(LOG_WARNING, "Unable to add global observer\n");
+		ast_cond_destroy(&capture.cond);
+		ast_mutex_destroy(&capture.lock);
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
@@ -552,6 +842,8 @@ static int load_module(void)
 		ast_sorcery_observer_remove(
 			ast_sip_get_sorcery(), "global", &global_observer);
 		ast_log(LOG_WARNING, "Unable to create default logger\n");
+		ast_cond_destroy(&capture.cond);
+		ast_mutex_destroy(&capture.lock);
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
@@ -571,6 +863,10 @@ static int unload_module(void)
 	ast_sorcery_observer_remove(
 		ast_sip_get_sorcery(), "global", &global_observer);
 
+	capture_set_async(0);
+	ast_cond_destroy(&capture.cond);
+	ast_mutex_destroy(&capture.lock);
+
 	ao2_cleanup(default_logger);
 	default_logger = NULL;
 
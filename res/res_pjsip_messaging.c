@@ -137,7 +137,17 @@ const pjsip_method pjsip_message_method = {PJSIP_OTHER_METHOD, {"MESSAGE", 7} };
 #define MAX_BODY_SIZE 1024
 #define MAX_USER_SIZE 128
 
-static struct ast_taskprocessor *message_serializer;
+/*! Number of serializers sending out of dialog messages */
+#define MESSAGE_SERIALIZERS 8
+
+/*!
+ * \brief Serializers sending out of dialog messages
+ *
+ * Messages to the same destination always use the same serializer so they
+ * go out in order, while messages to different destinations go out in
+ * parallel.
+ */
+static struct ast_taskprocessor *message_serializers[MESSAGE_SERIALIZERS];
 
 /*!
  * \internal
@@ -1364,7 +1374,8 @@ static int sip_msg_send(const struct ast_msg *msg, const char *destination, cons
 		return -1;
 	}
 
-	res = ast_sip_push_task_wait_serializer(message_serializer, msg_send, mdata);
+	res = ast_sip_push_task_wait_serializer(
+		message_serializers[ast_str_hash(destination) % MESSAGE_SERIALIZERS], msg_send, mdata);
 	ao2_ref(mdata, -1);
 
 	return res;
@@ -1563,8 +1574,20 @@ static pjsip_module messaging_module = {
 	.on_rx_request = module_on_rx_request,
 };
 
+static void message_serializers_destroy(void)
+{
+	int i;
+
+	for (i = 0; i < MESSAGE_SERIALIZERS; ++i) {
+		ast_taskprocessor_unreference(message_serializers[i]);
+		message_serializers[i] = NULL;
+	}
+}
+
 static int load_module(void)
 {
+	int i;
+
 	if (ast_sip_register_service(&messaging_module) != PJ_SUCCESS) {
 		return AST_MODULE_LOAD_DECLINE;
 	}
@@ -1582,11 +1605,17 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
-	message_serializer = ast_sip_create_serializer("pjsip/messaging");
-	if (!message_serializer) {
-		ast_sip_unregister_service(&messaging_module);
-		ast_msg_tech_unregister(&msg_tech);
-		return AST_MODULE_LOAD_DECLINE;
+	for (i = 0; i < MESSAGE_SERIALIZERS; ++i) {
+		char tps_name[AST_TASKPROCESSOR_MAX_NAME + 1];
+
+		snprintf(tps_name, sizeof(tps_name), "pjsip/messaging-%d", i);
+		message_serializers[i] = ast_sip_create_serializer(tps_name);
+		if (!message_serializers[i]) {
+			message_serializers_destroy();
+			ast_sip_unregister_service(&messaging_module);
+			ast_msg_tech_unregister(&msg_tech);
+			return AST_MODULE_LOAD_DECLINE;
+		}
 	}
 
 	ast_sip_session_register_supplement(&messaging_supplement);
@@ -1598,7 +1627,7 @@ static int unload_module(void)
 	ast_sip_session_unregister_supplement(&messaging_supplement);
 	ast_msg_tech_unregister(&msg_tech);
 	ast_sip_unregister_service(&messaging_module);
-	ast_taskprocessor_unreference(message_serializer);
+	message_serializers_destroy();
 	return 0;
 }
 
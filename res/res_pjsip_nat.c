@@ -115,6 +115,7 @@ static void rewrite_uri(pjsip_rx_data *rdata, pjsip_sip_uri *uri, pj_pool_t *poo
 
 static int rewrite_route_set(pjsip_rx_data *rdata, pjsip_dialog *dlg)
 {
+	static const pj_str_t record_route_name = { "Record-Route", 12 };
 	pjsip_rr_hdr *rr = NULL;
 	pjsip_sip_uri *uri;
 	int res = -1;
@@ -130,7 +131,7 @@ static int rewrite_route_set(pjsip_rx_data *rdata, pjsip_dialog *dlg)
 			}
 		}
 	} else if (pjsip_method_cmp(&rdata->msg_info.msg->line.req.method, &pjsip_register_method)) {
-		rr = pjsip_msg_find_hdr(rdata->msg_info.msg, PJSIP_H_RECORD_ROUTE, NULL);
+		rr = ast_sip_rdata_find_header(rdata, &record_route_name, NULL);
 	} else {
 		/**
 		 * Record-Route header has no meaning in REGISTER requests
@@ -178,9 +179,10 @@ static int rewrite_route_set(pjsip_rx_data *rdata, pjsip_dialog *dlg)
 
 static int rewrite_contact(pjsip_rx_data *rdata, pjsip_dialog *dlg)
 {
+	static const pj_str_t contact_name = { "Contact", 7 };
 	pjsip_contact_hdr *contact;
 
-	contact = pjsip_msg_find_hdr(rdata->msg_info.msg, PJSIP_H_CONTACT, NULL);
+	contact = ast_sip_rdata_find_header(rdata, &contact_name, NULL);
 	if (contact && !contact->star && (PJSIP_URI_SCHEME_IS_SIP(contact->uri) || PJSIP_URI_SCHEME_IS_SIPS(contact->uri))) {
 		pjsip_sip_uri *uri = pjsip_uri_get_uri(contact->uri);
 
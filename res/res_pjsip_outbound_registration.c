@@ -247,6 +247,30 @@ AST_THREADSTORAGE(register_callback_invoked);
 /*! \brief Amount of buffer time (in seconds) before expiration that we re-register at */
 #define REREGISTER_BUFFER_TIME 10
 
+/*! \brief Divisor of the expiration giving the most a paced refresh is moved early by */
+#define REREGISTER_JITTER_DIVISOR 20
+
+/*! \brief Number of one second slots tracked when pacing outbound REGISTER requests */
+#define REGISTER_PACING_SLOTS 4096
+
+/*! \brief Number of REGISTER requests scheduled into one second */
+struct register_pacing_slot {
+	/*! The second this slot currently counts for */
+	time_t second;
+	/*! Number of requests scheduled within that second */
+	unsigned int count;
+};
+
+/*!
+ * \brief Ring of per second REGISTER counts shared by all registrations
+ *
+ * A slot is reused for a later second once that second comes around, so
+ * requests scheduled further out than the ring covers are only paced
+ * approximately.
+ */
+static struct register_pacing_slot register_pacing[REGISTER_PACING_SLOTS];
+AST_MUTEX_DEFINE_STATIC(register_pacing_lock);
+
 /*! \brief Size of the buffer for creating a unique string for the line */
 #define LINE_PARAMETER_SIZE 8
 
@@ -717,19 +741,62 @@ static void sip_outbound_registration_timer_cb(pj_timer_heap_t *timer_heap, stru
 	}
 }
 
+/*!
+ * \internal
+ * \brief Place a REGISTER into the first second with room at the configured rate
+ *
+ * \param seconds Number of seconds from now the REGISTER is wanted
+ * \param delay Set to the delay the REGISTER should actually be sent after
+ */
+static void register_pacing_delay(unsigned int seconds, pj_time_val *delay)
+{
+	unsigned int rate = ast_sip_get_outbound_registration_rate();
+	time_t target;
+	unsigned int i;
+
+	delay->sec = seconds;
+	delay->msec = 0;
+
+	if (!rate) {
+		return;
+	}
+
+	target = ast_tvnow().tv_sec + seconds;
+
+	ast_mutex_lock(&register_pacing_lock);
+	for (i = 0; i < REGISTER_PACING_SLOTS; ++i) {
+		struct register_pacing_slot *slot = &register_pacing[(target + i) % REGISTER_PACING_SLOTS];
+
+		if (slot->second != target + i) {
+			slot->second = target + i;
+			slot->count = 0;
+		}
+		if (slot->count < rate) {
+			/* Spread the requests of a second evenly across it */
+			delay->sec = seconds + i;
+			delay->msec = (slot->count * 1000) / rate;
+			++slot->count;
+			break;
+		}
+	}
+	ast_mutex_unlock(&register_pacing_lock);
+}
+
 /*! \brief Helper function which sets up the timer to re-register in a specific amount of time */
 static void schedule_registration(struct sip_outbound_registration_client_state *client_state, unsigned int seconds)
 {
-	pj_time_val delay = { .sec = seconds, };
+	pj_time_val delay;
 	pjsip_regc_info info;
 
 	cancel_registration(client_state);
 
+	register_pacing_delay(seconds, &delay);
+
 	pjsip_regc_get_info(client_state->client, &info);
-	ast_debug(1, "Scheduling outbound registration to server '%.*s' from client '%.*s' in %d seconds\n",
+	ast_debug(1, "Scheduling outbound registration to server '%.*s' from client '%.*s' in %ld.%03ld seconds\n",
 			(int) info.server_uri.slen, info.server_uri.ptr,
 			(int) info.client_uri.slen, info.client_uri.ptr,
-			seconds);
+			(long) delay.sec, (long) delay.msec);
 
 	ao2_ref(client_state, +1);
 	if (pjsip_endpt_schedule_timer(ast_sip_get_pjsip_endpoint(), &client_state->timer, &delay) != PJ_SUCCESS) {
@@ -1125,6 +1192,11 @@ static int handle_registration_response(void *data)
 			update_client_state_status(response->client_state, SIP_REGISTRATION_REGISTERED);
 			response->client_state->retries = 0;
 			next_registration_round = response->expiration - REREGISTER_BUFFER_TIME;
+			if (next_registration_round > 0 && ast_sip_get_outbound_registration_rate()) {
+				/* Keep registrations that started together from refreshing together */
+				next_registration_round -= ast_random()
+					% (next_registration_round / REREGISTER_JITTER_DIVISOR + 1);
+			}
 			if (next_registration_round < 0) {
 				/* Re-register immediately. */
 				next_registration_round = 0;
@@ -1254,7 +1326,9 @@ static void sip_outbound_registration_response_cb(struct pjsip_regc_cbparam *par
 		tsx = pjsip_rdata_get_tsx(param->rdata);
 		response->old_request = tsx->last_tx;
 		pjsip_tx_data_add_ref(response->old_request);
-		pjsip_rx_data_clone(param->rdata, 0, &response->rdata);
+		if (pjsip_rx_data_clone(param->rdata, 0, &response->rdata) == PJ_SUCCESS) {
+			ast_sip_rdata_header_cache_reset(response->rdata);
+		}
 	} else {
 		/* old_request steals the reference */
 		response->old_request = client_state->last_tdata;
@@ -201,6 +201,273 @@ static int registrar_validate_contacts(const pjsip_rx_data *rdata, pj_pool_t *po
 	return 0;
 }
 
+/*! \brief A contact refresh which has not been stored yet */
+struct contact_refresh {
+	/*! The refreshed contact */
+	struct ast_sip_contact *contact;
+	/*! The expiration time of the contact in the sorcery backend */
+	struct timeval stored_expiration;
+	/*! The name of the AOR the contact belongs to */
+	char *aor;
+	/*! The sorcery identifier of the contact */
+	char id[0];
+};
+
+/*! \brief Number of buckets for the pending contact refreshes container */
+#define CONTACT_REFRESH_BUCKETS 1021
+
+/*! \brief Contact refreshes waiting to be stored, keyed by contact id */
+static struct ao2_container *pending_refreshes;
+
+/*! \brief The scheduled task which stores pending contact refreshes */
+static struct ast_sip_sched_task *refresh_write_task;
+
+/*! \brief The number of seconds a contact refresh may wait before being stored */
+static unsigned int refresh_write_delay;
+
+AO2_STRING_FIELD_HASH_FN(contact_refresh, id);
+AO2_STRING_FIELD_CMP_FN(contact_refresh, id);
+
+static void contact_refresh_destroy(void *obj)
+{
+	struct contact_refresh *refresh = obj;
+
+	ao2_cleanup(refresh->contact);
+}
+
+/*!
+ * \internal
+ * \brief Determine if an updated contact differs from the original in expiration only
+ */
+static int contact_refresh_is_plain(const struct ast_sip_contact *contact,
+	const struct ast_sip_contact *update)
+{
+	return contact->qualify_frequency == update->qualify_frequency
+		&& contact->authenticate_qualify == update->authenticate_qualify
+		&& !strcmp(contact->path, update->path)
+		&& !strcmp(contact->user_agent, update->user_agent)
+		&& !strcmp(contact->reg_server, update->reg_server);
+}
+
+/*!
+ * \internal
+ * \brief Hold a plain contact refresh in memory instead of storing it
+ *
+ * \param contact The contact as currently known to the registrar
+ * \param update The refreshed copy of the contact
+ *
+ * \note The AOR lock must be held.
+ *
+ * \retval 0 The refresh will be stored by the refresh write task
+ * \retval -1 The refresh must be stored now
+ */
+static int contact_refresh_defer(struct ast_sip_contact *contact, struct ast_sip_contact *update)
+{
+	const char *id = ast_sorcery_object_get_id(contact);
+	unsigned int delay = refresh_write_delay;
+	struct contact_refresh *refresh;
+	struct timeval stored_expiration;
+
+	if (!delay || !refresh_write_task || !contact_refresh_is_plain(contact, update)) {
+		return -1;
+	}
+
+	ao2_lock(pending_refreshes);
+	refresh = ao2_find(pending_refreshes, id, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	stored_expiration = refresh ? refresh->stored_expiration : contact->expiration_time;
+
+	/*
+	 * Everything else reads contacts straight from sorcery, so only hold
+	 * the refresh back if the stored expiration will still be in the
+	 * future by the time the write task has run.
+	 */
+	if (ast_tvdiff_ms(stored_expiration, ast_tvnow()) <= 2000LL * delay) {
+		ao2_unlock(pending_refreshes);
+		ao2_cleanup(refresh);
+		return -1;
+	}
+
+	if (!refresh) {
+		refresh = ao2_alloc_options(sizeof(*refresh) + strlen(id) + 1 + strlen(contact->aor) + 1,
+			contact_refresh_destroy, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!refresh) {
+			ao2_unlock(pending_refreshes);
+			return -1;
+		}
+		strcpy(refresh->id, id); /* Safe */
+		refresh->aor = refresh->id + strlen(id) + 1;
+		strcpy(refresh->aor, contact->aor); /* Safe */
+		refresh->stored_expiration = stored_expiration;
+		if (!ao2_link_flags(pending_refreshes, refresh, OBJ_NOLOCK)) {
+			ao2_unlock(pending_refreshes);
+			ao2_ref(refresh, -1);
+			return -1;
+		}
+	}
+	ao2_replace(refresh->contact, update);
+	ao2_unlock(pending_refreshes);
+	ao2_ref(refresh, -1);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Forget any pending refresh of a contact
+ */
+static void contact_refresh_remove(const struct ast_sip_contact *contact)
+{
+	if (!pending_refreshes || !ao2_container_count(pending_refreshes)) {
+		return;
+	}
+
+	ao2_find(pending_refreshes, ast_sorcery_object_get_id(contact),
+		OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+}
+
+static int contact_refresh_pending(void *obj, void *arg, int flags)
+{
+	struct contact_refresh *refresh;
+
+	refresh = ao2_find(pending_refreshes, ast_sorcery_object_get_id(obj), OBJ_SEARCH_KEY);
+	if (!refresh) {
+		return 0;
+	}
+	ao2_ref(refresh, -1);
+	return CMP_MATCH;
+}
+
+/*!
+ * \internal
+ * \brief Replace contacts retrieved from sorcery with their pending refreshes
+ *
+ * \note The AOR lock must be held.
+ */
+static void contact_refresh_apply(struct ao2_container *contacts)
+{
+	struct ao2_iterator *stale;
+	struct ast_sip_contact *contact;
+
+	if (!pending_refreshes || !ao2_container_count(pending_refreshes)) {
+		return;
+	}
+
+	stale = ao2_callback(contacts, OBJ_MULTIPLE | OBJ_UNLINK, contact_refresh_pending, NULL);
+	if (!stale) {
+		return;
+	}
+
+	while ((contact = ao2_iterator_next(stale))) {
+		struct contact_refresh *refresh;
+
+		refresh = ao2_find(pending_refreshes, ast_sorcery_object_get_id(contact), OBJ_SEARCH_KEY);
+		ao2_link(contacts, refresh ? refresh->contact : contact);
+		ao2_cleanup(refresh);
+		ao2_ref(contact, -1);
+	}
+	ao2_iterator_destroy(stale);
+}
+
+/*!
+ * \internal
+ * \brief Store every pending contact refresh
+ */
+static void contact_refresh_write_all(void)
+{
+	struct ao2_iterator *refreshes;
+	struct contact_refresh *refresh;
+	int written = 0;
+
+	if (!pending_refreshes || !ao2_container_count(pending_refreshes)) {
+		return;
+	}
+
+	refreshes = ao2_callback(pending_refreshes, OBJ_MULTIPLE, NULL, NULL);
+	if (!refreshes) {
+		return;
+	}
+
+	while ((refresh = ao2_iterator_next(refreshes))) {
+		struct ast_named_lock *lock;
+		struct contact_refresh *current;
+		struct ast_sip_contact *contact = NULL;
+
+		lock = ast_named_lock_get(AST_NAMED_LOCK_TYPE_MUTEX, "aor", refresh->aor);
+		if (!lock) {
+			ao2_ref(refresh, -1);
+			continue;
+		}
+
+		/*
+		 * The contact may have been refreshed again or removed while we
+		 * waited for the AOR lock so only store what is still pending.
+		 */
+		ast_named_lock_lock(lock);
+		ao2_lock(pending_refreshes);
+		current = ao2_find(pending_refreshes, refresh->id, OBJ_SEARCH_KEY | OBJ_NOLOCK | OBJ_UNLINK);
+		if (current) {
+			contact = ao2_bump(current->contact);
+			ao2_ref(current, -1);
+		}
+		ao2_unlock(pending_refreshes);
+
+		if (contact) {
+			if (ast_sip_location_update_contact(contact)) {
+				ast_log(LOG_WARNING, "Failed to store refresh of contact '%s' on AOR '%s'\n",
+					contact->uri, contact->aor);
+			} else {
+				++written;
+			}
+			ao2_ref(contact, -1);
+		}
+		ast_named_lock_unlock(lock);
+		ast_named_lock_put(lock);
+		ao2_ref(refresh, -1);
+	}
+	ao2_iterator_destroy(refreshes);
+
+	ast_debug(3, "Stored %d pending contact refreshes\n", written);
+}
+
+static int contact_refresh_write_task(void *data)
+{
+	contact_refresh_write_all();
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Start, stop or adjust the refresh write task for a new delay
+ *
+ * \note Observer calls are serialized so this is safe without its own lock.
+ */
+static void contact_refresh_set_delay(unsigned int delay)
+{
+	if (delay == refresh_write_delay && (!delay || refresh_write_task)) {
+		return;
+	}
+
+	if (refresh_write_task) {
+		ast_sip_sched_task_cancel(refresh_write_task);
+		ao2_ref(refresh_write_task, -1);
+		refresh_write_task = NULL;
+	}
+	refresh_write_delay = delay;
+
+	/* Anything held back under the old delay is stored now */
+	contact_refresh_write_all();
+
+	if (!delay) {
+		return;
+	}
+
+	refresh_write_task = ast_sip_schedule_task(NULL, delay * 1000, contact_refresh_write_task,
+		"registrar/contact_refresh", NULL, AST_SIP_SCHED_TASK_FIXED);
+	if (!refresh_write_task) {
+		ast_log(LOG_ERROR, "Unable to schedule the contact refresh write task.  Refreshes will be stored immediately.\n");
+	}
+}
+
 enum contact_delete_type {
 	CONTACT_DELETE_ERROR,
 	CONTACT_DELETE_EXISTING,
@@ -435,6 +702,7 @@ static int registrar_contact_delete(enum contact_delete_type type, pjsip_transpo
 		}
 	}
 
+	contact_refresh_remove(contact);
 	ast_sip_location_delete_contact(contact);
 
 	if (aor_size) {
@@ -826,12 +1094,15 @@ static void register_aor_core(pjsip_rx_data *rdata,
 				ast_string_field_set(contact_update, reg_server, ast_config_AST_SYSTEM_NAME);
 			}
 
-			if (ast_sip_location_update_contact(contact_update)) {
-				ast_log(LOG_ERROR, "Failed to update contact '%s' expiration time to %d seconds.\n",
-					contact->uri, expiration);
-				registrar_contact_delete(CONTACT_DELETE_ERROR, rdata->tp_info.transport,
-					contact, aor_name);
-				continue;
+			if (contact_refresh_defer(contact, contact_update)) {
+				if (ast_sip_location_update_contact(contact_update)) {
+					ast_log(LOG_ERROR, "Failed to update contact '%s' expiration time to %d seconds.\n",
+						contact->uri, expiration);
+					registrar_contact_delete(CONTACT_DELETE_ERROR, rdata->tp_info.transport,
+						contact, aor_name);
+					continue;
+				}
+				contact_refresh_remove(contact_update);
 			}
 			ast_debug(3, "Refreshed contact '%s' on AOR '%s' with new expiration of %d seconds\n",
 				contact_uri, aor_name, expiration);
@@ -915,6 +1186,7 @@ static int register_aor(pjsip_rx_data *rdata,
 			rdata, response.code, NULL, NULL, NULL);
 		return PJ_TRUE;
 	}
+	contact_refresh_apply(contacts);
 
 	register_aor_core(rdata, endpoint, aor, aor_name, contacts, &response);
 	ao2_cleanup(contacts);
@@ -1243,6 +1515,8 @@ static int expire_contact(void *obj, void *arg, int flags)
 {
 	struct ast_sip_contact *contact = obj;
 	struct ast_named_lock *lock;
+	struct contact_refresh *refresh;
+	struct timeval expiration_time;
 
 	lock = ast_named_lock_get(AST_NAMED_LOCK_TYPE_MUTEX, "aor", contact->aor);
 	if (!lock) {
@@ -1252,12 +1526,16 @@ static int expire_contact(void *obj, void *arg, int flags)
 	/*
 	 * We need to check the expiration again with the aor lock held
 	 * in case another thread is attempting to renew the contact.
+	 * A renewal may also still be waiting to be stored.
 	 */
-	ao2_lock(lock);
-	if (ast_tvdiff_ms(ast_tvnow(), contact->expiration_time) > 0) {
+	ast_named_lock_lock(lock);
+	refresh = ao2_find(pending_refreshes, ast_sorcery_object_get_id(contact), OBJ_SEARCH_KEY);
+	expiration_time = refresh ? refresh->contact->expiration_time : contact->expiration_time;
+	ao2_cleanup(refresh);
+	if (ast_tvdiff_ms(ast_tvnow(), expiration_time) > 0) {
 		registrar_contact_delete(CONTACT_DELETE_EXPIRE, NULL, contact, contact->aor);
 	}
-	ao2_unlock(lock);
+	ast_named_lock_unlock(lock);
 	ast_named_lock_put(lock);
 
 	return 0;
@@ -1293,6 +1571,8 @@ static void *check_expiration_thread(void *data)
 
 static void expiration_global_loaded(const char *object_type)
 {
+	contact_refresh_set_delay(ast_sip_get_contact_refresh_write_delay());
+
 	check_interval = ast_sip_get_contact_expiration_check_interval();
 
 	/* Observer calls are serialized so this is safe without it's own lock */
@@ -1327,12 +1607,22 @@ static int load_module(void)
 	/* As of pjproject 2.4.5, PJSIP_MAX_URL_SIZE isn't exposed yet but we try anyway. */
 	ast_pjproject_get_buildopt("PJSIP_MAX_URL_SIZE", "%d", &pjsip_max_url_size);
 
+	pending_refreshes = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		CONTACT_REFRESH_BUCKETS, contact_refresh_hash_fn, NULL, contact_refresh_cmp_fn);
+	if (!pending_refreshes) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	if (ast_sip_register_service(&registrar_module)) {
+		ao2_ref(pending_refreshes, -1);
+		pending_refreshes = NULL;
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
 	if (pjsip_endpt_add_capability(ast_sip_get_pjsip_endpoint(), NULL, PJSIP_H_ALLOW, NULL, 1, &STR_REGISTER) != PJ_SUCCESS) {
 		ast_sip_unregister_service(&registrar_module);
+		ao2_ref(pending_refreshes, -1);
+		pending_refreshes = NULL;
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
@@ -1359,10 +1649,17 @@ static int unload_module(void)
 
 	ast_sorcery_observer_remove(ast_sip_get_sorcery(), "global", &expiration_global_observer);
 
+	/* Stops the refresh write task and stores anything still pending */
+	contact_refresh_set_delay(0);
+
 	ast_manager_unregister(AMI_SHOW_REGISTRATIONS);
 	ast_manager_unregister(AMI_SHOW_REGISTRATION_CONTACT_STATUSES);
 	ast_sip_unregister_service(&registrar_module);
 	ast_sip_transport_monitor_unregister_all(register_contact_transport_shutdown_cb, NULL, NULL);
+
+	ao2_cleanup(pending_refreshes);
+	pending_refreshes = NULL;
+
 	return 0;
 }
 
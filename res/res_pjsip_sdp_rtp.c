@@ -65,6 +65,32 @@ static struct ast_sched_context *sched;
 /*! \brief Address for RTP */
 static struct ast_sockaddr address_rtp;
 
+/*! \brief Number of buckets for the fmtp template container */
+#define FMTP_TEMPLATE_BUCKETS 53
+
+/*! \brief Templates kept before the container is flushed */
+#define FMTP_TEMPLATE_MAX 1024
+
+/*!
+ * \brief Rendered fmtp attribute value of a format and payload
+ *
+ * Formats do not change once they are shared so the value generated by
+ * the format attribute module can be reused for as long as the template
+ * holds its reference.  Configured codecs are the same format objects on
+ * every offer, so repeated offers skip the attribute module entirely.
+ */
+struct fmtp_template {
+	/*! The format the value was generated for */
+	struct ast_format *format;
+	/*! The payload the value was generated for */
+	int rtp_code;
+	/*! The fmtp attribute value, empty if the format has none */
+	char value[0];
+};
+
+/*! \brief Cached fmtp templates */
+static struct ao2_container *fmtp_templates;
+
 static const char STR_AUDIO[] = "audio";
 static const char STR_VIDEO[] = "video";
 
@@ -646,28 +672,114 @@ static pjmedia_sdp_attr* generate_rtpmap_attr(struct ast_sip_session *session, p
 	return attr;
 }
 
+static int fmtp_template_hash(const void *obj, const int flags)
+{
+	const struct fmtp_template *template = obj;
+
+	return abs((int) (((uintptr_t) template->format >> 4) ^ template->rtp_code));
+}
+
+static int fmtp_template_cmp(void *obj, void *arg, int flags)
+{
+	const struct fmtp_template *left = obj;
+	const struct fmtp_template *right = arg;
+
+	return left->format == right->format && left->rtp_code == right->rtp_code
+		? CMP_MATCH : 0;
+}
+
+static void fmtp_template_destructor(void *obj)
+{
+	struct fmtp_template *template = obj;
+
+	ao2_cleanup(template->format);
+}
+
+/*! \brief Drop all fmtp templates */
+static void fmtp_templates_flush(void)
+{
+	if (fmtp_templates) {
+		ao2_callback(fmtp_templates, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK, NULL, NULL);
+	}
+}
+
+/*! \brief Endpoints were (re)loaded so the configured formats may have been replaced */
+static void endpoints_loaded(const char *type)
+{
+	fmtp_templates_flush();
+}
+
+static const struct ast_sorcery_observer endpoint_observer_callbacks = {
+	.loaded = endpoints_loaded,
+};
+
+/*! \brief Let the format attribute module generate the fmtp value of a format */
+static char *fmtp_value_generate(struct ast_format *format, int rtp_code, struct ast_str **fmtp0)
+{
+	char *tmp;
+
+	ast_format_generate_sdp_fmtp(format, rtp_code, fmtp0);
+	if (!ast_str_strlen(*fmtp0)) {
+		return NULL;
+	}
+
+	tmp = ast_str_buffer(*fmtp0) + ast_str_strlen(*fmtp0) - 1;
+	/* remove any carriage return line feeds */
+	while (*tmp == '\r' || *tmp == '\n') --tmp;
+	*++tmp = '\0';
+	/* ast...generate gives us everything, just need value */
+	tmp = strchr(ast_str_buffer(*fmtp0), ':');
+	if (tmp && tmp[1] != '\0') {
+		return tmp + 1;
+	}
+	return ast_str_buffer(*fmtp0);
+}
+
 static pjmedia_sdp_attr* generate_fmtp_attr(pj_pool_t *pool, struct ast_format *format, int rtp_code)
 {
 	struct ast_str *fmtp0 = ast_str_alloca(256);
+	struct fmtp_template key = {
+		.format = format,
+		.rtp_code = rtp_code,
+	};
+	struct fmtp_template *template = NULL;
 	pj_str_t fmtp1;
 	pjmedia_sdp_attr *attr = NULL;
-	char *tmp;
+	const char *value;
 
-	ast_format_generate_sdp_fmtp(format, rtp_code, &fmtp0);
-	if (ast_str_strlen(fmtp0)) {
-		tmp = ast_str_buffer(fmtp0) + ast_str_strlen(fmtp0) - 1;
-		/* remove any carriage return line feeds */
-		while (*tmp == '\r' || *tmp == '\n') --tmp;
-		*++tmp = '\0';
-		/* ast...generate gives us everything, just need value */
-		tmp = strchr(ast_str_buffer(fmtp0), ':');
-		if (tmp && tmp[1] != '\0') {
-			fmtp1 = pj_str(tmp + 1);
-		} else {
-			fmtp1 = pj_str(ast_str_buffer(fmtp0));
+	if (fmtp_templates) {
+		template = ao2_find(fmtp_templates, &key, OBJ_SEARCH_OBJECT);
+	}
+
+	if (template) {
+		value = template->value;
+	} else {
+		value = S_OR(fmtp_value_generate(format, rtp_code, &fmtp0), "");
+
+		if (fmtp_templates) {
+			template = ao2_alloc_options(sizeof(*template) + strlen(value) + 1,
+				fmtp_template_destructor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		}
+		if (template) {
+			template->format = ao2_bump(format);
+			template->rtp_code = rtp_code;
+			strcpy(template->value, value); /* Safe */
+
+			ao2_lock(fmtp_templates);
+			if (ao2_container_count(fmtp_templates) >= FMTP_TEMPLATE_MAX) {
+				/* Formats negotiated per call never repeat, so start over rather than grow */
+				ao2_callback(fmtp_templates, OBJ_NODATA | OBJ_MULTIPLE | OBJ_UNLINK | OBJ_NOLOCK,
+					NULL, NULL);
+			}
+			ao2_link_flags(fmtp_templates, template, OBJ_NOLOCK);
+			ao2_unlock(fmtp_templates);
 		}
-		attr = pjmedia_sdp_attr_create(pool, "fmtp", &fmtp1);
 	}
+
+	if (!ast_strlen_zero(value)) {
+		attr = pjmedia_sdp_attr_create(pool, "fmtp", pj_cstr(&fmtp1, value));
+	}
+	ao2_cleanup(template);
 	return attr;
 }
 
@@ -1115,36 +1227,56 @@ static int parse_dtls_attrib(struct ast_sip_session_media *session_media,
 	return 0;
 }
 
+/*! \brief Determine if a crypto attribute offers an AEAD (AES-GCM) suite */
+static int crypto_attr_is_aead(const pjmedia_sdp_attr *attr)
+{
+	static const pj_str_t aead = { " AEAD_AES_", 10 };
+
+	return pj_strstr(&attr->value, &aead) != NULL;
+}
+
 static int setup_sdes_srtp(struct ast_sip_session_media *session_media,
 	const struct pjmedia_sdp_media *stream)
 {
+	int prefer_aead = ast_sdp_crypto_prefer_aead();
+	int pass;
 	int i;
 
-	for (i = 0; i < stream->attr_count; i++) {
-		pjmedia_sdp_attr *attr;
-		RAII_VAR(char *, crypto_str, NULL, ast_free);
+	/*
+	 * When AES-GCM is accelerated the offered AEAD suites are tried first,
+	 * then the remaining suites in the order they were offered.
+	 */
+	for (pass = prefer_aead ? 0 : 1; pass < 2; pass++) {
+		for (i = 0; i < stream->attr_count; i++) {
+			pjmedia_sdp_attr *attr;
+			RAII_VAR(char *, crypto_str, NULL, ast_free);
+
+			/* check the stream for the required crypto attribute */
+			attr = stream->attr[i];
+			if (pj_strcmp2(&attr->name, "crypto")) {
+				continue;
+			}
 
-		/* check the stream for the required crypto attribute */
-		attr = stream->attr[i];
-		if (pj_strcmp2(&attr->name, "crypto")) {
-			continue;
-		}
+			if (prefer_aead && crypto_attr_is_aead(attr) != !pass) {
+				continue;
+			}
 
-		crypto_str = ast_strndup(attr->value.ptr, attr->value.slen);
-		if (!crypto_str) {
-			return -1;
-		}
+			crypto_str = ast_strndup(attr->value.ptr, attr->value.slen);
+			if (!crypto_str) {
+				return -1;
+			}
 
-		if (setup_srtp(session_media)) {
-			return -1;
-		}
+			if (setup_srtp(session_media)) {
+				return -1;
+			}
 
-		if (!ast_sdp_crypto_process(session_media->rtp, session_media->srtp, crypto_str)) {
-			/* found a valid crypto attribute */
-			return 0;
-		}
+			if (!ast_sdp_crypto_process(session_media->rtp, session_media->srtp, crypto_str)) {
+				/* found a valid crypto attribute */
+				return 0;
+			}
 
-		ast_log(LOG_WARNING, "Ignoring crypto offer with unsupported parameters: %s\n", crypto_str);
+			ast_log(LOG_WARNING, "Ignoring crypto offer with unsupported parameters: %s\n", crypto_str);
+		}
 	}
 
 	/* no usable crypto attributes found */
@@ -1267,6 +1399,37 @@ static void process_ssrc_attributes(struct ast_sip_session *session, struct ast_
 		ast_rtp_instance_set_remote_ssrc(session_media->rtp, ssrc);
 		break;
 	}
+
+	/* A simulcast group lists the SSRC of each layer, lowest quality first */
+	for (index = 0; index < remote_stream->attr_count; ++index) {
+		pjmedia_sdp_attr *attr = remote_stream->attr[index];
+		char attr_value[pj_strlen(&attr->value) + 1];
+		unsigned int ssrcs[AST_RTP_MAX_SIMULCAST_LAYERS];
+		unsigned int count = 0;
+		char *group;
+		char *ssrc;
+
+		if (pj_strcmp2(&attr->name, "ssrc-group")) {
+			continue;
+		}
+
+		ast_copy_pj_str(attr_value, &attr->value, sizeof(attr_value));
+		group = attr_value;
+		if (strcmp(strsep(&group, " "), "SIM")) {
+			continue;
+		}
+
+		while (count < ARRAY_LEN(ssrcs) && (ssrc = strsep(&group, " "))) {
+			if (sscanf(ssrc, "%30u", &ssrcs[count]) == 1) {
+				count++;
+			}
+		}
+
+		ast_rtp_instance_set_simulcast_ssrcs(session_media->rtp, ssrcs, count);
+		return;
+	}
+
+	ast_rtp_instance_set_simulcast_ssrcs(session_media->rtp, NULL, 0);
 }
 
 static void add_msid_to_stream(struct ast_sip_session *session,
@@ -2338,11 +2501,15 @@ static int unload_module(void)
 	ast_sip_session_unregister_supplement(&video_info_supplement);
 	ast_sip_session_unregister_sdp_handler(&video_sdp_handler, STR_VIDEO);
 	ast_sip_session_unregister_sdp_handler(&audio_sdp_handler, STR_AUDIO);
+	ast_sorcery_observer_remove(ast_sip_get_sorcery(), "endpoint", &endpoint_observer_callbacks);
 
 	if (sched) {
 		ast_sched_context_destroy(sched);
 	}
 
+	ao2_cleanup(fmtp_templates);
+	fmtp_templates = NULL;
+
 	return 0;
 }
 
@@ -2374,6 +2541,18 @@ static int load_module(void)
 		goto end;
 	}
 
+	fmtp_templates = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		FMTP_TEMPLATE_BUCKETS, fmtp_template_hash, NULL, fmtp_template_cmp);
+	if (!fmtp_templates) {
+		ast_log(LOG_ERROR, "Unable to allocate fmtp template container.\n");
+		goto end;
+	}
+
+	if (ast_sorcery_observer_add(ast_sip_get_sorcery(), "endpoint", &endpoint_observer_callbacks)) {
+		ast_log(LOG_ERROR, "Unable to observe endpoint reloads.\n");
+		goto end;
+	}
+
 	if (ast_sip_session_register_sdp_handler(&audio_sdp_handler, STR_AUDIO)) {
 		ast_log(LOG_ERROR, "Unable to register SDP handler for %s stream type\n", STR_AUDIO);
 		goto end;
@@ -51,6 +51,8 @@
 #include "asterisk/test.h"
 #include "asterisk/stream.h"
 #include "asterisk/vector.h"
+#include "asterisk/trace_ring.h"
+#include "asterisk/histogram.h"
 
 #define SDP_HANDLER_BUCKETS 11
 
@@ -2790,7 +2792,9 @@ static pj_bool_t session_reinvite_on_rx_request(pjsip_rx_data *rdata)
 		return PJ_FALSE;
 	}
 
-	pjsip_rx_data_clone(rdata, 0, &session->deferred_reinvite);
+	if (pjsip_rx_data_clone(rdata, 0, &session->deferred_reinvite) == PJ_SUCCESS) {
+		ast_sip_rdata_header_cache_reset(session->deferred_reinvite);
+	}
 
 	return PJ_TRUE;
 }
@@ -2833,6 +2837,15 @@ void ast_sip_session_send_request_with_cb(struct ast_sip_session *session, pjsip
 	ast_sip_mod_data_set(tdata->pool, tdata->mod_data, session_module.id,
 			     MOD_DATA_ON_RESPONSE, on_response);
 
+	if (tdata->msg->line.req.method.id == PJSIP_INVITE_METHOD
+		&& inv_session->state <= PJSIP_INV_STATE_CALLING) {
+		/* The initial INVITE, or the same again with credentials */
+		session->invite_start = ast_tvnow();
+		session->invite_responses_timed = 0;
+	}
+
+	ast_trace_ring("%s: outgoing %.*s", ast_sip_session_get_name(session),
+		(int) pj_strlen(&tdata->msg->line.req.method.name), pj_strbuf(&tdata->msg->line.req.method.name));
 	handle_outgoing_request(session, tdata);
 	pjsip_inv_send_msg(session->inv_session, tdata);
 
@@ -4099,6 +4112,8 @@ static void handle_new_invite_request(pjsip_rx_data *rdata)
 		SCOPE_EXIT_RTN("Couldn't create session\n");
 	}
 	session->call_direction = AST_SIP_SESSION_INCOMING_CALL;
+	session->invite_start = ast_tv(rdata->pkt_info.timestamp.sec,
+		rdata->pkt_info.timestamp.msec * 1000);
 
 	/*
 	 * The current thread is supposed be the session serializer to prevent
@@ -4401,6 +4416,9 @@ static void handle_incoming_request(struct ast_sip_session *session, pjsip_rx_da
 	struct pjsip_request_line req = rdata->msg_info.msg->line.req;
 	SCOPE_ENTER(3, "%s: Method is %.*s\n", ast_sip_session_get_name(session), (int) pj_strlen(&req.method.name), pj_strbuf(&req.method.name));
 
+	ast_trace_ring("%s: incoming %.*s", ast_sip_session_get_name(session),
+		(int) pj_strlen(&req.method.name), pj_strbuf(&req.method.name));
+
 	AST_LIST_TRAVERSE(&session->supplements, supplement, next) {
 		if (supplement->incoming_request && does_method_match(&req.method.name, supplement->method)) {
 			if (supplement->incoming_request(session, rdata)) {
@@ -4619,6 +4637,9 @@ static void session_inv_on_state_changed(pjsip_inv_session *inv, pjsip_event *e)
 	SCOPE_ENTER(1, "%s Event: %s  Inv State: %s\n", ast_sip_session_get_name(session),
 		pjsip_event_str(e->type), pjsip_inv_state_name(inv->state));
 
+	ast_trace_ring("%s: event %s, invite state %s", ast_sip_session_get_name(session),
+		e ? pjsip_event_str(e->type) : "none", pjsip_inv_state_name(inv->state));
+
 	if (ast_shutdown_final()) {
 		SCOPE_EXIT_RTN("Shutting down\n");
 	}
@@ -4728,6 +4749,55 @@ static int session_end_if_disconnected(int id, pjsip_inv_session *inv)
 	return 1;
 }
 
+/*! \brief Responses to the initial INVITE that are timed */
+static const int invite_response_codes[] = { 100, 180, 200 };
+
+/*! \brief Time to each response to the initial INVITE, received and sent INVITEs */
+static struct ast_histogram *invite_response_time[2][ARRAY_LEN(invite_response_codes)];
+
+/*!
+ * \internal
+ * \brief Time a response to the initial INVITE, if it is one worth timing
+ *
+ * Only the first response with each code counts.  Once a final response
+ * has been seen the INVITE is no longer timed, so re-INVITEs never are.
+ */
+static void invite_response_time_record(struct ast_sip_session *session,
+	pjsip_transaction *tsx, pjsip_event *e)
+{
+	pjsip_msg *msg;
+	int i;
+
+	if (ast_tvzero(session->invite_start)) {
+		return;
+	}
+
+	if (tsx->role == PJSIP_ROLE_UAS && e->body.tsx_state.type == PJSIP_EVENT_TX_MSG) {
+		msg = e->body.tsx_state.src.tdata->msg;
+	} else if (tsx->role == PJSIP_ROLE_UAC && e->body.tsx_state.type == PJSIP_EVENT_RX_MSG) {
+		msg = e->body.tsx_state.src.rdata->msg_info.msg;
+	} else {
+		return;
+	}
+	if (msg->type != PJSIP_RESPONSE_MSG) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_LEN(invite_response_codes); i++) {
+		if (msg->line.status.code == invite_response_codes[i]
+			&& !(session->invite_responses_timed & (1 << i))) {
+			session->invite_responses_timed |= (1 << i);
+			ast_histogram_record_since(invite_response_time[tsx->role == PJSIP_ROLE_UAS ? 0 : 1][i],
+				session->invite_start);
+			break;
+		}
+	}
+
+	if (msg->line.status.code >= 200) {
+		session->invite_start = ast_tv(0, 0);
+	}
+}
+
 static void session_inv_on_tsx_state_changed(pjsip_inv_session *inv, pjsip_transaction *tsx, pjsip_event *e)
 {
 	ast_sip_session_response_cb cb;
@@ -4737,6 +4807,10 @@ static void session_inv_on_tsx_state_changed(pjsip_inv_session *inv, pjsip_trans
 	SCOPE_ENTER(1, "%s TSX State: %s  Inv State: %s\n", ast_sip_session_get_name(session),
 		pjsip_tsx_state_str(tsx->state), pjsip_inv_state_name(inv->state));
 
+	ast_trace_ring("%s: %.*s transaction %s, invite state %s", ast_sip_session_get_name(session),
+		(int) pj_strlen(&tsx->method.name), pj_strbuf(&tsx->method.name),
+		pjsip_tsx_state_str(tsx->state), pjsip_inv_state_name(inv->state));
+
 	if (ast_shutdown_final()) {
 		SCOPE_EXIT_RTN("Shutting down\n");
 	}
@@ -4759,6 +4833,10 @@ static void session_inv_on_tsx_state_changed(pjsip_inv_session *inv, pjsip_trans
 		SCOPE_EXIT_RTN("Disconnected\n");
 	}
 
+	if (tsx->method.id == PJSIP_INVITE_METHOD) {
+		invite_response_time_record(session, tsx, e);
+	}
+
 	switch (e->body.tsx_state.type) {
 	case PJSIP_EVENT_TX_MSG:
 		/* When we create an outgoing request, we do not have access to the transaction that
@@ -5233,6 +5311,124 @@ end:
 	SCOPE_EXIT_RTN_VALUE(local, "%s\n", ast_sip_session_get_name(session));
 }
 
+static int sdp_conn_equal(const pjmedia_sdp_conn *left, const pjmedia_sdp_conn *right)
+{
+	if (!left || !right) {
+		return left == right;
+	}
+
+	return !pj_strcmp(&left->net_type, &right->net_type)
+		&& !pj_strcmp(&left->addr_type, &right->addr_type)
+		&& !pj_strcmp(&left->addr, &right->addr);
+}
+
+static int sdp_attrs_equal(unsigned int left_count, pjmedia_sdp_attr *const *left,
+	unsigned int right_count, pjmedia_sdp_attr *const *right)
+{
+	unsigned int i;
+
+	if (left_count != right_count) {
+		return 0;
+	}
+
+	for (i = 0; i < left_count; ++i) {
+		if (pj_strcmp(&left[i]->name, &right[i]->name)
+			|| pj_strcmp(&left[i]->value, &right[i]->value)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int sdp_media_equal(const pjmedia_sdp_media *left, const pjmedia_sdp_media *right)
+{
+	unsigned int i;
+
+	if (pj_strcmp(&left->desc.media, &right->desc.media)
+		|| left->desc.port != right->desc.port
+		|| left->desc.port_count != right->desc.port_count
+		|| pj_strcmp(&left->desc.transport, &right->desc.transport)
+		|| left->desc.fmt_count != right->desc.fmt_count
+		|| !sdp_conn_equal(left->conn, right->conn)
+		|| !sdp_attrs_equal(left->attr_count, left->attr, right->attr_count, right->attr)) {
+		return 0;
+	}
+
+	for (i = 0; i < left->desc.fmt_count; ++i) {
+		if (pj_strcmp(&left->desc.fmt[i], &right->desc.fmt[i])) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Determine if an offer describes the same media as the active remote SDP
+ *
+ * Offers refreshing a session, like session timer refreshes, only change the
+ * origin line, so everything the SDP handlers and the stream topology depend on
+ * is compared while the origin and lines Asterisk does not read are not.  A
+ * change of stream direction, like hold, is a change.
+ *
+ * \retval 1 if the media is unchanged
+ * \retval 0 if it changed
+ */
+static int sdp_offer_unchanged(const pjmedia_sdp_session *offer, const pjmedia_sdp_session *previous)
+{
+	unsigned int i;
+
+	if (offer->media_count != previous->media_count
+		|| !sdp_conn_equal(offer->conn, previous->conn)
+		|| !sdp_attrs_equal(offer->attr_count, offer->attr, previous->attr_count, previous->attr)) {
+		return 0;
+	}
+
+	for (i = 0; i < offer->media_count; ++i) {
+		if (!sdp_media_equal(offer->media[i], previous->media[i])) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Answer an offer repeating the active remote SDP with the active local SDP
+ *
+ * The media of the session stays as it is, so no SDP handler runs and the
+ * stream topology is left alone, neither now nor when the negotiation completes.
+ *
+ * \return The answer
+ * \retval NULL if the offer has to be negotiated as usual
+ */
+static pjmedia_sdp_session *sdp_answer_unchanged(pjsip_inv_session *inv,
+	struct ast_sip_session *session, const pjmedia_sdp_session *offer)
+{
+	const pjmedia_sdp_session *previous_remote;
+	const pjmedia_sdp_session *previous_local;
+
+	/* Something else is negotiating, like SDP deferral or a queued request */
+	if (session->pending_media_state->topology
+		|| AST_VECTOR_SIZE(&session->pending_media_state->sessions)
+		|| !session->active_media_state->topology
+		|| !inv->neg) {
+		return NULL;
+	}
+
+	if (pjmedia_sdp_neg_get_active_remote(inv->neg, &previous_remote) != PJ_SUCCESS
+		|| pjmedia_sdp_neg_get_active_local(inv->neg, &previous_local) != PJ_SUCCESS
+		|| AST_VECTOR_SIZE(&session->active_media_state->sessions) != offer->media_count
+		|| !sdp_offer_unchanged(offer, previous_remote)) {
+		return NULL;
+	}
+
+	return pjmedia_sdp_session_clone(inv->pool_prov, previous_local);
+}
+
 static void session_inv_on_rx_offer(pjsip_inv_session *inv, const pjmedia_sdp_session *offer)
 {
 	struct ast_sip_session *session = inv->mod_data[session_module.id];
@@ -5244,6 +5440,15 @@ static void session_inv_on_rx_offer(pjsip_inv_session *inv, const pjmedia_sdp_se
 	}
 
 	session = inv->mod_data[session_module.id];
+	session->sdp_unchanged = 0;
+
+	if ((answer = sdp_answer_unchanged(inv, session, offer))) {
+		session->sdp_unchanged = 1;
+		pjsip_inv_set_sdp_answer(inv, answer);
+		SCOPE_EXIT_RTN("%s: Media unchanged, set the active SDP as answer\n",
+			ast_sip_session_get_name(session));
+	}
+
 	if (handle_incoming_sdp(session, offer)) {
 		ast_sip_session_media_state_reset(session->pending_media_state);
 		SCOPE_EXIT_RTN("%s: handle_incoming_sdp failed\n", ast_sip_session_get_name(session));
@@ -5281,6 +5486,8 @@ static void session_inv_on_create_offer(pjsip_inv_session *inv, pjmedia_sdp_sess
 		}
 	}
 
+	session->sdp_unchanged = 0;
+
 	offer = create_local_sdp(inv, session, previous_sdp);
 	if (!offer) {
 		return;
@@ -5389,12 +5596,19 @@ static void session_inv_on_media_update(pjsip_inv_session *inv, pj_status_t stat
 
 	if ((status != PJ_SUCCESS) || (pjmedia_sdp_neg_get_active_local(inv->neg, &local) != PJ_SUCCESS) ||
 		(pjmedia_sdp_neg_get_active_remote(inv->neg, &remote) != PJ_SUCCESS)) {
+		session->sdp_unchanged = 0;
 		ast_channel_hangupcause_set(session->channel, AST_CAUSE_BEARERCAPABILITY_NOTAVAIL);
 		ast_set_hangupsource(session->channel, ast_channel_name(session->channel), 0);
 		ast_queue_hangup(session->channel);
 		SCOPE_EXIT_RTN("%s: Couldn't get active or local or remote negotiator.  Hanging up\n", ast_sip_session_get_name(session));
 	}
 
+	/* The offer repeated the active media and was answered with it, nothing to apply */
+	if (session->sdp_unchanged) {
+		session->sdp_unchanged = 0;
+		SCOPE_EXIT_RTN("%s: Media unchanged\n", ast_sip_session_get_name(session));
+	}
+
 	if (handle_negotiated_sdp(session, local, remote)) {
 		ast_sip_session_media_state_reset(session->pending_media_state);
 		SCOPE_EXIT_RTN("%s: handle_negotiated_sdp failed.  Resetting pending media state\n", ast_sip_session_get_name(session));
@@ -6084,6 +6298,7 @@ AST_TEST_DEFINE(test_resolve_refresh_media_states)
 static int load_module(void)
 {
 	pjsip_endpoint *endpt;
+	int i;
 
 	if (!ast_sip_get_sorcery() || !ast_sip_get_pjsip_endpoint()) {
 		return AST_MODULE_LOAD_DECLINE;
@@ -6108,6 +6323,16 @@ static int load_module(void)
 	ast_sip_register_service(&session_reinvite_module);
 	ast_sip_register_service(&outbound_invite_auth_module);
 
+	for (i = 0; i < ARRAY_LEN(invite_response_codes); i++) {
+		char code[8];
+
+		snprintf(code, sizeof(code), "%d", invite_response_codes[i]);
+		invite_response_time[0][i] = ast_histogram_get("pjsip_inbound_invite_response",
+			"Time from receiving an initial INVITE to sending a response.", "code", code);
+		invite_response_time[1][i] = ast_histogram_get("pjsip_outbound_invite_response",
+			"Time from sending an initial INVITE to receiving a response.", "code", code);
+	}
+
 	ast_module_shutdown_ref(ast_module_info->self);
 #ifdef TEST_FRAMEWORK
 	AST_TEST_REGISTER(test_resolve_refresh_media_states);
@@ -6117,6 +6342,8 @@ static int load_module(void)
 
 static int unload_module(void)
 {
+	int i;
+
 #ifdef TEST_FRAMEWORK
 	AST_TEST_UNREGISTER(test_resolve_refresh_media_states);
 #endif
@@ -6126,6 +6353,12 @@ static int unload_module(void)
 	ast_sorcery_delete(ast_sip_get_sorcery(), nat_hook);
 	ao2_cleanup(nat_hook);
 	ao2_cleanup(sdp_handlers);
+	for (i = 0; i < ARRAY_LEN(invite_response_codes); i++) {
+		ao2_cleanup(invite_response_time[0][i]);
+		invite_response_time[0][i] = NULL;
+		ao2_cleanup(invite_response_time[1][i]);
+		invite_response_time[1][i] = NULL;
+	}
 	return 0;
 }
 
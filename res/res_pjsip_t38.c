@@ -616,6 +616,7 @@ static void t38_attach_framehook(struct ast_sip_session *session)
 		.consume_cb = t38_consume,
 		.chan_fixup_cb = t38_masq,
 		.chan_breakdown_cb = t38_masq,
+		.frame_types = AST_FRAMEHOOK_TYPE(AST_FRAME_CONTROL),
 	};
 
 	/* If the channel's already gone, bail */
@@ -489,6 +489,8 @@ static struct ast_sip_session_supplement websocket_supplement = {
 
 static int load_module(void)
 {
+	struct ast_websocket_protocol *protocol;
+
 	/*
 	 * We only need one transport type name (ws) defined.  Firefox
 	 * and Chrome do not support anything other than secure websockets
@@ -508,7 +510,18 @@ static int load_module(void)
 
 	ast_sip_session_register_supplement(&websocket_supplement);
 
-	if (ast_websocket_add_protocol("sip", websocket_cb)) {
+	protocol = ast_websocket_sub_protocol_alloc("sip");
+	if (!protocol) {
+		ast_sip_session_unregister_supplement(&websocket_supplement);
+		ast_sip_unregister_service(&websocket_module);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+	protocol->session_established = websocket_cb;
+	/* SIP over a WAN link compresses well and writes come from many threads */
+	protocol->deflate = 1;
+	protocol->coalesce = 1;
+	if (ast_websocket_add_protocol2(protocol)) {
+		ao2_ref(protocol, -1);
 		ast_sip_session_unregister_supplement(&websocket_supplement);
 		ast_sip_unregister_service(&websocket_module);
 		return AST_MODULE_LOAD_DECLINE;
@@ -975,7 +975,10 @@ static int load_module(void)
 		|| channel_metrics_init()
 		|| endpoint_metrics_init()
 		|| bridge_metrics_init()
-		|| pjsip_outbound_registration_metrics_init()) {
+		|| cel_metrics_init()
+		|| pjsip_outbound_registration_metrics_init()
+		|| latency_metrics_init()
+		|| taskprocessor_metrics_init()) {
 		goto cleanup;
 	}
 
@@ -39,6 +39,9 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #ifdef HAVE_OPENSSL
 #include <openssl/opensslconf.h>
@@ -84,6 +87,10 @@
 #include "asterisk/uuid.h"
 #include "asterisk/test.h"
 #include "asterisk/data_buffer.h"
+#include "asterisk/app.h"
+#include "asterisk/taskprocessor.h"
+#include "asterisk/threadpool.h"
+#include "asterisk/alertpipe.h"
 #ifdef HAVE_PJPROJECT
 #include "asterisk/res_pjproject.h"
 #include "asterisk/security_events.h"
@@ -185,7 +192,44 @@ enum strict_rtp_mode {
 #define DEFAULT_SRTP_REPLAY_PROTECTION 1
 #define DEFAULT_ICESUPPORT 1
 #define DEFAULT_STUN_SOFTWARE_ATTRIBUTE 1
+#define DEFAULT_ICE_CANDIDATE_CACHE 0
 #define DEFAULT_DTLS_MTU 1200
+#define DEFAULT_KERNEL_RELAY 0
+#define DEFAULT_IO_BATCH 1
+
+#if defined(MSG_WAITFORONE)
+/*! recvmmsg() and sendmmsg() are available */
+#define HAVE_RTP_IO_BATCH
+#endif
+/*! Maximum number of packets moved by one batched system call */
+#define RTP_IO_BATCH_MAX 32
+/*! Largest packet that can be queued in a batch slot other than the first */
+#define RTP_IO_BATCH_SLOT_SIZE 2048
+/*! Room left in a queued slot for the largest SRTP authentication tag and MKI */
+#define RTP_IO_BATCH_SRTP_TRAILER 144
+
+#define DEFAULT_REACTOR_THREADS 0
+#ifdef EPOLLIN
+/*! Sockets can be serviced by dedicated reactor threads */
+#define HAVE_RTP_REACTOR
+#endif
+/*! Maximum number of reactor threads */
+#define RTP_REACTOR_THREADS_MAX 64
+/*! Maximum number of frames a reactor queues for a channel that is not reading them */
+#define RTP_REACTOR_QUEUE_MAX 128
+
+#define DEFAULT_DTLS_OFFLOAD_THREADS 0
+/*! Maximum number of DTLS offload threads */
+#define DTLS_OFFLOAD_THREADS_MAX 64
+/*! Number of ephemeral certificates generated ahead of time while DTLS offload is enabled */
+#define DTLS_CERT_POOL_SIZE 32
+/*! Seconds after which a pre-generated ephemeral certificate is discarded instead of used */
+#define DTLS_CERT_POOL_MAX_AGE 86400
+
+/*! Name of the nftables table holding kernel relayed flows */
+#define KERNEL_RELAY_TABLE "asterisk_rtp_relay"
+/*! Minimum time between attempts to offload the same stream in milliseconds */
+#define KERNEL_RELAY_RETRY_MS 2000
 
 extern struct ast_srtp_res *res_srtp;
 extern struct ast_srtp_policy_res *res_srtp_policy;
@@ -194,6 +238,13 @@ static int dtmftimeout = DEFAULT_DTMF_TIMEOUT;
 
 static int rtpstart = DEFAULT_RTP_START;			/*!< First port for RTP sessions (set in rtp.conf) */
 static int rtpend = DEFAULT_RTP_END;			/*!< Last port for RTP sessions (set in rtp.conf) */
+/*! \brief Protects the RTP port freelist */
+AST_MUTEX_DEFINE_STATIC(rtp_ports_lock);
+static unsigned short *rtp_ports_free;	/*!< Ring of the free even ports in the range, handed out from the head */
+static unsigned int rtp_ports_size;	/*!< Number of even ports in the range */
+static unsigned int rtp_ports_head;	/*!< Next port to hand out */
+static unsigned int rtp_ports_count;	/*!< Number of free ports in the ring */
+static unsigned char rtp_ports_used[(MAXIMUM_RTP_PORT + 1) / 16 + 1]; /*!< Bit per even port one of our instances holds */
 static int rtcpstats;			/*!< Are we debugging RTCP? */
 static int rtcpinterval = RTCP_DEFAULT_INTERVALMS; /*!< Time between rtcp reports in millisecs */
 static struct ast_sockaddr rtpdebugaddr;	/*!< Debug packets to/from this host */
@@ -207,8 +258,21 @@ static int strictrtp = DEFAULT_STRICT_RTP; /*!< Only accept RTP frames from a de
 static int learning_min_sequential = DEFAULT_LEARNING_MIN_SEQUENTIAL; /*!< Number of sequential RTP frames needed from a single source during learning mode to accept new source. */
 static int learning_min_duration = DEFAULT_LEARNING_MIN_DURATION; /*!< Lowest acceptable timeout between the first and the last sequential RTP frame. */
 static int srtp_replay_protection = DEFAULT_SRTP_REPLAY_PROTECTION;
+static int io_batch = DEFAULT_IO_BATCH; /*!< Number of packets to move per system call, 1 disables batching */
+static int kernel_relay = DEFAULT_KERNEL_RELAY; /*!< Offload eligible native bridged streams into the kernel */
+static int kernel_relay_ready; /*!< The nftables relay table has been created */
+/*! Serializer which runs the nft commands for kernel relayed flows */
+static struct ast_taskprocessor *kernel_relay_tps;
+static unsigned int reactor_threads = DEFAULT_REACTOR_THREADS; /*!< Number of reactor threads new instances use, 0 disables them */
 #if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
 static int dtls_mtu = DEFAULT_DTLS_MTU;
+static unsigned int dtls_offload_threads = DEFAULT_DTLS_OFFLOAD_THREADS; /*!< Number of DTLS offload threads, 0 disables offloading */
+/*! Threads running DTLS handshakes and ephemeral certificate generation */
+static struct ast_threadpool *dtls_offload_pool;
+/*! Serializers keeping the handshake packets of each RTP instance in order */
+static struct ast_taskprocessor **dtls_offload_serializers;
+/*! Number of serializers in dtls_offload_serializers */
+static unsigned int dtls_offload_count;
 #endif
 #ifdef HAVE_PJPROJECT
 static int icesupport = DEFAULT_ICESUPPORT;
@@ -220,6 +284,9 @@ static pj_str_t turnusername;
 static pj_str_t turnpassword;
 static struct stasis_subscription *acl_change_sub = NULL;
 static struct ast_sockaddr lo6 = { .len = 0 };
+static int ice_candidate_cache = DEFAULT_ICE_CANDIDATE_CACHE; /*!< Seconds gathered addresses are reused before being refreshed, 0 disables caching */
+/*! Serializer refreshing the cached interface and server reflexive addresses */
+static struct ast_taskprocessor *ice_cache_tps;
 
 /*! ACL for ICE addresses */
 static struct ast_acl_list *ice_acl = NULL;
@@ -312,6 +379,7 @@ struct dtls_details {
 	enum ast_rtp_dtls_setup dtls_setup; /*!< Current setup state */
 	enum ast_rtp_dtls_connection connection; /*!< Whether this is a new or existing connection */
 	int timeout_timer; /*!< Scheduler id for timeout timer */
+	unsigned int offloaded; /*!< Received packets waiting to be processed by a DTLS offload thread */
 };
 #endif
 
@@ -363,6 +431,58 @@ typedef struct {
 	unsigned char is_set;
 } optional_ts;
 
+/*! \brief Packets moved to or from a socket by one system call */
+struct rtp_io_batch {
+	unsigned int size;  /*!< Number of slots */
+	unsigned int count; /*!< Number of filled slots */
+	unsigned int next;  /*!< Next received slot to hand out */
+#ifdef HAVE_RTP_IO_BATCH
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	struct ast_sockaddr *addrs;
+	unsigned char *data; /*!< size slots of RTP_IO_BATCH_SLOT_SIZE bytes each */
+#endif
+};
+
+AST_LIST_HEAD_NOLOCK(frame_list, ast_frame);
+
+/*! \brief A thread servicing the RTP sockets registered with its epoll instance */
+struct rtp_reactor {
+	int epfd;                /*!< epoll instance */
+	pthread_t thread;        /*!< Thread waiting on the epoll instance */
+	ast_mutex_t lock;        /*!< Protects the retired list */
+	AST_LIST_HEAD_NOLOCK(, rtp_reactor_entry) retired; /*!< Entries of destroyed instances */
+};
+
+/*!
+ * \brief Weak proxy through which a reactor reaches the instance owning a socket
+ *
+ * An entry is used as the epoll event data so it is only released by its
+ * reactor thread once no wakeup in progress can reference it any longer.
+ */
+struct rtp_reactor_entry {
+	AO2_WEAKPROXY();
+	struct rtp_reactor *reactor;      /*!< Reactor servicing the socket */
+	int fd;                           /*!< Socket registered with the reactor, or -1 */
+	AST_LIST_ENTRY(rtp_reactor_entry) list;
+};
+
+/*! \brief Keys of a flow installed into the kernel relay */
+struct rtp_kernel_relay_flow {
+	char remote[AST_SOCKADDR_BUFLEN]; /*!< Address the stream is received from */
+	int remote_port;                  /*!< Port the stream is received from */
+	int local_port;                   /*!< Our local port the stream is received on, keys the rewrites */
+};
+
+/*! \brief Kernel relay state of a native bridged RTP stream */
+struct rtp_kernel_relay {
+	unsigned int generation;  /*!< Bumped whenever the core needs the stream again */
+	unsigned int pending:1;   /*!< An install task has been queued */
+	unsigned int installed:1; /*!< The flow is currently present in the kernel */
+	struct rtp_kernel_relay_flow flow; /*!< The installed flow */
+	struct timeval next_attempt; /*!< Do not try again to install before this time */
+};
+
 /*! \brief RTP session description */
 struct ast_rtp {
 	int s;
@@ -375,6 +495,9 @@ struct ast_rtp {
 	char cname[AST_UUID_STR_LEN]; /*!< Our local CNAME */
 	unsigned int themssrc;		/*!< Their SSRC */
 	unsigned int themssrc_valid;	/*!< True if their SSRC is available. */
+	unsigned short pool_port;	/*!< Port taken from the freelist, 0 if the socket was bound another way */
+	unsigned int simulcast_ssrcs[AST_RTP_MAX_SIMULCAST_LAYERS]; /*!< Their SSRC of each simulcast layer, lowest first */
+	unsigned int simulcast_layers;	/*!< Number of simulcast layers they send, 0 if they do not */
 	unsigned int lastts;
 	unsigned int lastividtimestamp;
 	unsigned int lastovidtimestamp;
@@ -442,6 +565,22 @@ struct ast_rtp {
 
 	struct rtp_transport_wide_cc_statistics transport_wide_cc; /*!< Transport-cc statistics information */
 
+	struct rtp_kernel_relay relay; /*!< Kernel offload state while natively bridged */
+
+	struct rtp_io_batch *rx_batch;       /*!< Packets received together but not yet processed */
+	struct rtp_io_batch *tx_batch;       /*!< Relayed packets waiting to be sent together */
+	struct ast_rtp_instance *tx_peer;    /*!< Bridged instance with packets we queued to its tx_batch */
+	unsigned int rxbatches;              /*!< Batched receive calls that returned packets */
+	unsigned int rxbatchcount;           /*!< Packets received through batched receive calls */
+	unsigned int txbatches;              /*!< Batched send calls that sent packets */
+	unsigned int txbatchcount;           /*!< Packets sent through batched send calls */
+
+	struct rtp_reactor_entry *reactor_entry; /*!< Set if a reactor reads our socket */
+	struct frame_list reactor_frames;    /*!< Frames read by the reactor for the channel */
+	unsigned int reactor_queued;         /*!< Number of frames in reactor_frames */
+	unsigned int reactor_error:1;        /*!< The reactor hit a read error */
+	int reactor_alert[2];                /*!< Signaled while reactor_frames is not empty */
+
 #ifdef HAVE_PJPROJECT
 	ast_cond_t cond;            /*!< ICE/TURN condition for signaling */
 
@@ -587,8 +726,6 @@ struct ast_rtp_rtcp_nack_payload {
 	unsigned char buf[0];	/*!< The payload data */
 };
 
-AST_LIST_HEAD_NOLOCK(frame_list, ast_frame);
-
 /* Forward Declarations */
 static int ast_rtp_new(struct ast_rtp_instance *instance, struct ast_sched_context *sched, struct ast_sockaddr *addr, void *data);
 static int ast_rtp_destroy(struct ast_rtp_instance *instance);
@@ -617,6 +754,7 @@ static unsigned int ast_rtp_get_ssrc(struct ast_rtp_instance *instance);
 static const char *ast_rtp_get_cname(struct ast_rtp_instance *instance);
 static void ast_rtp_set_remote_ssrc(struct ast_rtp_instance *instance, unsigned int ssrc);
 static void ast_rtp_set_stream_num(struct ast_rtp_instance *instance, int stream_num);
+static void ast_rtp_set_simulcast_ssrcs(struct ast_rtp_instance *instance, const unsigned int *ssrcs, unsigned int count);
 static int ast_rtp_extension_enable(struct ast_rtp_instance *instance, enum ast_rtp_extension extension);
 static int ast_rtp_bundle(struct ast_rtp_instance *child, struct ast_rtp_instance *parent);
 
@@ -2015,9 +2153,7 @@ error:
 	return -1;
 }
 
-static int create_certificate_ephemeral(struct ast_rtp_instance *instance,
-										const struct ast_rtp_dtls_cfg *dtls_cfg,
-										struct dtls_cert_info *cert_info)
+static int create_cert_info_ephemeral(struct dtls_cert_info *cert_info)
 {
 	/* Make sure these are initialized */
 	cert_info->private_key = NULL;
@@ -2042,6 +2178,107 @@ static int create_certificate_ephemeral(struct ast_rtp_instance *instance,
 	return -1;
 }
 
+/*! \brief An ephemeral certificate generated ahead of time */
+struct dtls_cert_pool_entry {
+	struct dtls_cert_info cert_info;
+	time_t created;
+};
+
+/*! \brief Ephemeral certificates generated ahead of time by the DTLS offload threads */
+static AST_VECTOR(, struct dtls_cert_pool_entry) dtls_cert_pool;
+/*! \brief Set while a refill of dtls_cert_pool is queued or running */
+static int dtls_cert_pool_refilling;
+AST_MUTEX_DEFINE_STATIC(dtls_cert_pool_lock);
+
+static void dtls_cert_pool_entry_free(struct dtls_cert_pool_entry entry)
+{
+	X509_free(entry.cert_info.certificate);
+	EVP_PKEY_free(entry.cert_info.private_key);
+}
+
+static int dtls_cert_pool_refill(void *data)
+{
+	struct dtls_cert_pool_entry entry;
+	int full = 0;
+
+	while (!full) {
+		/* Key generation is the expensive part, keep it outside of the lock */
+		if (create_cert_info_ephemeral(&entry.cert_info)) {
+			break;
+		}
+		entry.created = time(NULL);
+
+		ast_mutex_lock(&dtls_cert_pool_lock);
+		if (AST_VECTOR_SIZE(&dtls_cert_pool) >= DTLS_CERT_POOL_SIZE
+			|| AST_VECTOR_APPEND(&dtls_cert_pool, entry)) {
+			dtls_cert_pool_entry_free(entry);
+		}
+		full = AST_VECTOR_SIZE(&dtls_cert_pool) >= DTLS_CERT_POOL_SIZE;
+		ast_mutex_unlock(&dtls_cert_pool_lock);
+	}
+
+	ast_mutex_lock(&dtls_cert_pool_lock);
+	dtls_cert_pool_refilling = 0;
+	ast_mutex_unlock(&dtls_cert_pool_lock);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Take a pre-generated ephemeral certificate, queueing a refill of the pool
+ *
+ * \retval 0 if cert_info was filled in from the pool
+ * \retval -1 if the pool is empty or DTLS offload is disabled
+ */
+static int dtls_cert_pool_take(struct dtls_cert_info *cert_info)
+{
+	time_t now = time(NULL);
+	int res = -1;
+
+	if (!dtls_offload_pool) {
+		return -1;
+	}
+
+	ast_mutex_lock(&dtls_cert_pool_lock);
+	while (res && AST_VECTOR_SIZE(&dtls_cert_pool)) {
+		struct dtls_cert_pool_entry entry;
+
+		entry = AST_VECTOR_REMOVE_UNORDERED(&dtls_cert_pool, AST_VECTOR_SIZE(&dtls_cert_pool) - 1);
+		/* Certificates are valid for 30 days, never hand out one that has been waiting for long */
+		if (now - entry.created > DTLS_CERT_POOL_MAX_AGE) {
+			dtls_cert_pool_entry_free(entry);
+			continue;
+		}
+		*cert_info = entry.cert_info;
+		res = 0;
+	}
+	if (!dtls_cert_pool_refilling) {
+		dtls_cert_pool_refilling = !ast_threadpool_push(dtls_offload_pool, dtls_cert_pool_refill, NULL);
+	}
+	ast_mutex_unlock(&dtls_cert_pool_lock);
+
+	return res;
+}
+
+/*! \brief Free every pre-generated ephemeral certificate */
+static void dtls_cert_pool_destroy(void)
+{
+	AST_VECTOR_RESET(&dtls_cert_pool, dtls_cert_pool_entry_free);
+	AST_VECTOR_FREE(&dtls_cert_pool);
+}
+
+static int create_certificate_ephemeral(struct ast_rtp_instance *instance,
+										const struct ast_rtp_dtls_cfg *dtls_cfg,
+										struct dtls_cert_info *cert_info)
+{
+	if (!dtls_cert_pool_take(cert_info)) {
+		return 0;
+	}
+
+	return create_cert_info_ephemeral(cert_info);
+}
+
 #else
 
 static int create_certificate_ephemeral(struct ast_rtp_instance *instance,
@@ -2052,6 +2289,10 @@ static int create_certificate_ephemeral(struct ast_rtp_instance *instance,
 	return -1;
 }
 
+static void dtls_cert_pool_destroy(void)
+{
+}
+
 #endif /* !OPENSSL_NO_ECDH */
 
 static int create_certificate_from_file(struct ast_rtp_instance *instance,
@@ -2518,6 +2759,7 @@ static struct ast_rtp_engine asterisk_rtp_engine = {
 	.set_remote_ssrc = ast_rtp_set_remote_ssrc,
 	.set_stream_num = ast_rtp_set_stream_num,
 	.extension_enable = ast_rtp_extension_enable,
+	.set_simulcast_ssrcs = ast_rtp_set_simulcast_ssrcs,
 	.bundle = ast_rtp_bundle,
 #ifdef TEST_FRAMEWORK
 	.test = &ast_rtp_test,
@@ -3080,193 +3322,793 @@ static int rtcp_mux(struct ast_rtp *rtp, const unsigned char *packet)
 	return 0;
 }
 
-/*! \pre instance is locked */
-static int __rtp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa, int rtcp)
+/*! \brief Determine if received packets are waiting to be processed */
+#define RTP_RX_BATCH_PENDING(rtp) ((rtp)->rx_batch && (rtp)->rx_batch->next < (rtp)->rx_batch->count)
+
+/*!
+ * \internal
+ * \brief Allocate a batch of the configured size
+ *
+ * \retval NULL if batching is disabled or unavailable
+ */
+static struct rtp_io_batch *rtp_io_batch_alloc(void)
 {
-	int len;
-	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
-#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
-	char *in = buf;
-#endif
-#ifdef HAVE_PJPROJECT
-	struct ast_sockaddr *loop = rtcp ? &rtp->rtcp_loop : &rtp->rtp_loop;
-#endif
-#ifdef TEST_FRAMEWORK
-	struct ast_rtp_engine_test *test = ast_rtp_instance_get_test(instance);
-#endif
+#ifdef HAVE_RTP_IO_BATCH
+	struct rtp_io_batch *batch;
+	unsigned int size = io_batch;
 
-	if ((len = ast_recvfrom(rtcp ? rtp->rtcp->s : rtp->s, buf, size, flags, sa)) < 0) {
-		return len;
+	if (size < 2) {
+		return NULL;
 	}
 
-#ifdef TEST_FRAMEWORK
-	if (test && test->packets_to_drop > 0) {
-		test->packets_to_drop--;
-		return 0;
+	/* The slots are carved out of the same allocation as the batch */
+	batch = ast_calloc(1, sizeof(*batch) + size * (sizeof(*batch->msgs) + sizeof(*batch->iov)
+		+ sizeof(*batch->addrs) + RTP_IO_BATCH_SLOT_SIZE));
+	if (!batch) {
+		return NULL;
 	}
-#endif
-
-#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
-	/* If this is an SSL packet pass it to OpenSSL for processing. RFC section for first byte value:
-	 * https://tools.ietf.org/html/rfc5764#section-5.1.2 */
-	if ((*in >= 20) && (*in <= 63)) {
-		struct dtls_details *dtls = !rtcp ? &rtp->dtls : &rtp->rtcp->dtls;
-		int res = 0;
+	batch->size = size;
+	batch->msgs = (struct mmsghdr *) (batch + 1);
+	batch->iov = (struct iovec *) (batch->msgs + size);
+	batch->addrs = (struct ast_sockaddr *) (batch->iov + size);
+	batch->data = (unsigned char *) (batch->addrs + size);
 
-		/* If no SSL session actually exists terminate things */
-		if (!dtls->ssl) {
-			ast_log(LOG_ERROR, "Received SSL traffic on RTP instance '%p' without an SSL session\n",
-				instance);
-			return -1;
-		}
+	return batch;
+#else
+	return NULL;
+#endif
+}
 
-		ast_debug_dtls(3, "(%p) DTLS - __rtp_recvfrom rtp=%p - Got SSL packet '%d'\n", instance, rtp, *in);
+#ifdef HAVE_RTP_IO_BATCH
+/*!
+ * \internal
+ * \brief Send every queued packet
+ *
+ * \pre instance is locked
+ */
+static void rtp_tx_batch_flush(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
+{
+	struct rtp_io_batch *batch = rtp->tx_batch;
+	struct ast_srtp *srtp;
+	unsigned int sent = 0;
+	int res;
 
-		/*
-		 * A race condition is prevented between dtls_perform_handshake()
-		 * and this function because both functions have to get the
-		 * instance lock before they can do anything.  The
-		 * dtls_perform_handshake() function needs to start the timer
-		 * before we stop it below.
-		 */
+	if (!batch || !batch->count) {
+		return;
+	}
 
-		/* Before we feed data into OpenSSL ensure that the timeout timer is either stopped or completed */
-		ao2_unlock(instance);
-		dtls_srtp_stop_timeout_timer(instance, rtp, rtcp);
-		ao2_lock(instance);
+	/* Packets are queued in the clear and protected together right before sending */
+	srtp = ast_rtp_instance_get_srtp(instance, 0);
+	if (res_srtp && srtp) {
+		struct ast_srtp_packet packets[batch->count];
+		unsigned int i;
+		unsigned int j;
 
-		/* If we don't yet know if we are active or passive and we receive a packet... we are obviously passive */
-		if (dtls->dtls_setup == AST_RTP_DTLS_SETUP_ACTPASS) {
-			dtls->dtls_setup = AST_RTP_DTLS_SETUP_PASSIVE;
-			SSL_set_accept_state(dtls->ssl);
+		for (i = 0; i < batch->count; i++) {
+			packets[i].srtp = srtp;
+			packets[i].buf = batch->iov[i].iov_base;
+			packets[i].len = batch->iov[i].iov_len;
+			packets[i].size = RTP_IO_BATCH_SLOT_SIZE;
 		}
 
-		BIO_write(dtls->read_bio, buf, len);
-
-		len = SSL_read(dtls->ssl, buf, len);
-
-		if ((len < 0) && (SSL_get_error(dtls->ssl, len) == SSL_ERROR_SSL)) {
-			unsigned long error = ERR_get_error();
-			ast_log(LOG_ERROR, "DTLS failure occurred on RTP instance '%p' due to reason '%s', terminating\n",
-				instance, ERR_reason_error_string(error));
-			return -1;
+		if (res_srtp->protect_batch(packets, batch->count, 0) != batch->count) {
+			ast_debug_rtp(1, "(%p) RTP unable to protect some of %u batched packets\n",
+				instance, batch->count);
 		}
 
-		if (SSL_is_init_finished(dtls->ssl)) {
-			/* Any further connections will be existing since this is now established */
-			dtls->connection = AST_RTP_DTLS_CONNECTION_EXISTING;
-			/* Use the keying material to set up key/salt information */
-			if ((res = dtls_srtp_setup(rtp, instance, rtcp))) {
-				return res;
+		/* Drop the packets that failed, keeping the rest in order */
+		for (i = 0, j = 0; i < batch->count; i++) {
+			if (packets[i].res) {
+				continue;
 			}
-			/* Notify that dtls has been established */
-			res = RTP_DTLS_ESTABLISHED;
-
-			ast_debug_dtls(3, "(%p) DTLS - __rtp_recvfrom rtp=%p - established'\n", instance, rtp);
-		} else {
-			/* Since we've sent additional traffic start the timeout timer for retransmission */
-			dtls_srtp_start_timeout_timer(instance, rtp, rtcp);
+			if (i != j) {
+				batch->msgs[j] = batch->msgs[i];
+				batch->iov[j] = batch->iov[i];
+				batch->msgs[j].msg_hdr.msg_iov = &batch->iov[j];
+			}
+			batch->iov[j].iov_len = packets[i].len;
+			j++;
 		}
-
-		return res;
+		batch->count = j;
 	}
-#endif
-
-#ifdef HAVE_PJPROJECT
-	if (!ast_sockaddr_isnull(loop) && !ast_sockaddr_cmp(loop, sa)) {
-		/* ICE traffic will have been handled in the TURN callback, so skip it but update the address
-		 * so it reflects the actual source and not the loopback
-		 */
-		if (rtcp) {
-			ast_sockaddr_copy(sa, &rtp->rtcp->them);
-		} else {
-			ast_rtp_instance_get_remote_address(instance, sa);
-		}
-	} else if (rtp->ice) {
-		pj_str_t combined = pj_str(ast_sockaddr_stringify(sa));
-		pj_sockaddr address;
-		pj_status_t status;
-		struct ice_wrap *ice;
-
-		pj_thread_register_check();
-
-		pj_sockaddr_parse(pj_AF_UNSPEC(), 0, &combined, &address);
-
-		/* Release the instance lock to avoid deadlock with PJPROJECT group lock */
-		ice = rtp->ice;
-		ao2_ref(ice, +1);
-		ao2_unlock(instance);
-		status = pj_ice_sess_on_rx_pkt(ice->real_ice,
-			rtcp ? AST_RTP_ICE_COMPONENT_RTCP : AST_RTP_ICE_COMPONENT_RTP,
-			rtcp ? TRANSPORT_SOCKET_RTCP : TRANSPORT_SOCKET_RTP, buf, len, &address,
-			pj_sockaddr_get_len(&address));
-		ao2_ref(ice, -1);
-		ao2_lock(instance);
-		if (status != PJ_SUCCESS) {
-			char err_buf[100];
 
-			pj_strerror(status, err_buf, sizeof(err_buf));
-			ast_log(LOG_WARNING, "PJ ICE Rx error status code: %d '%s'.\n",
-				(int)status, err_buf);
-			return -1;
-		}
-		if (!rtp->passthrough) {
-			/* If a unidirectional ICE negotiation occurs then lock on to the source of the
-			 * ICE traffic and use it as the target. This will occur if the remote side only
-			 * wants to receive media but never send to us.
-			 */
-			if (!rtp->ice_active_remote_candidates && !rtp->ice_proposed_remote_candidates) {
-				if (rtcp) {
-					ast_sockaddr_copy(&rtp->rtcp->them, sa);
-				} else {
-					ast_rtp_instance_set_remote_address(instance, sa);
-				}
-			}
-			return 0;
+	while (sent < batch->count) {
+		res = sendmmsg(rtp->s, &batch->msgs[sent], batch->count - sent, 0);
+		if (res <= 0) {
+			ast_debug_rtp(1, "(%p) RTP batched transmission of %u packets failed: %s\n",
+				instance, batch->count - sent, strerror(errno));
+			break;
 		}
-		rtp->passthrough = 0;
+		sent += res;
 	}
-#endif
 
-	return len;
+	if (sent) {
+		rtp->txbatches++;
+		rtp->txbatchcount += sent;
+		ast_rtp_instance_set_last_tx(instance, time(NULL));
+	}
+	batch->count = 0;
 }
 
-/*! \pre instance is locked */
-static int rtcp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa)
+/*!
+ * \internal
+ * \brief Send the packets we queued on a bridged instance
+ *
+ * \pre instance is locked
+ *
+ * \note The instance lock is released while the bridged instance is locked.
+ */
+static void rtp_tx_batch_flush_peer(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
 {
-	return __rtp_recvfrom(instance, buf, size, flags, sa, 1);
-}
+	struct ast_rtp_instance *peer = rtp->tx_peer;
 
-/*! \pre instance is locked */
-static int rtp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa)
-{
-	return __rtp_recvfrom(instance, buf, size, flags, sa, 0);
+	if (!peer) {
+		return;
+	}
+	rtp->tx_peer = NULL;
+
+	ao2_unlock(instance);
+	ao2_lock(peer);
+	rtp_tx_batch_flush(peer, ast_rtp_instance_get_data(peer));
+	ao2_unlock(peer);
+	ao2_lock(instance);
+	ao2_ref(peer, -1);
 }
 
-/*! \pre instance is locked */
-static int __rtp_sendto(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa, int rtcp, int *via_ice, int use_srtp)
+/*!
+ * \internal
+ * \brief Receive the next RTP packet, refilling the batch from the socket when it runs dry
+ *
+ * The first packet of each batch is received directly into \a buf, the rest
+ * into batch slots from where they are copied by later calls.
+ *
+ * \pre instance is locked
+ */
+static int rtp_recvfrom_batched(struct ast_rtp_instance *instance, struct ast_rtp *rtp,
+	void *buf, size_t size, struct ast_sockaddr *sa)
 {
-	int len = size;
-	void *temp = buf;
-	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
-	struct ast_rtp_instance *transport = rtp->bundled ? rtp->bundled : instance;
-	struct ast_rtp *transport_rtp = ast_rtp_instance_get_data(transport);
-	struct ast_srtp *srtp = ast_rtp_instance_get_srtp(transport, rtcp);
+	struct rtp_io_batch *batch = rtp->rx_batch;
+	unsigned int i;
 	int res;
 
-	*via_ice = 0;
+	while (batch->next < batch->count) {
+		i = batch->next++;
+		if ((batch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || batch->msgs[i].msg_len > size) {
+			ast_debug_rtp(1, "(%p) RTP dropping batched packet larger than %d bytes\n",
+				instance, RTP_IO_BATCH_SLOT_SIZE);
+			continue;
+		}
+		memcpy(buf, batch->data + i * RTP_IO_BATCH_SLOT_SIZE, batch->msgs[i].msg_len);
+		ast_sockaddr_copy(sa, &batch->addrs[i]);
+		return batch->msgs[i].msg_len;
+	}
 
-	if (use_srtp && res_srtp && srtp && res_srtp->protect(srtp, &temp, &len, rtcp) < 0) {
-		return -1;
+	batch->count = batch->next = 0;
+	for (i = 0; i < batch->size; i++) {
+		struct ast_sockaddr *addr = i ? &batch->addrs[i] : sa;
+
+		batch->iov[i].iov_base = i ? batch->data + i * RTP_IO_BATCH_SLOT_SIZE : buf;
+		batch->iov[i].iov_len = i ? RTP_IO_BATCH_SLOT_SIZE : size;
+		memset(&batch->msgs[i], 0, sizeof(batch->msgs[i]));
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		batch->msgs[i].msg_hdr.msg_name = &addr->ss;
+		batch->msgs[i].msg_hdr.msg_namelen = sizeof(addr->ss);
 	}
 
-#ifdef HAVE_PJPROJECT
-	if (transport_rtp->ice) {
-		enum ast_rtp_ice_component_type component = rtcp ? AST_RTP_ICE_COMPONENT_RTCP : AST_RTP_ICE_COMPONENT_RTP;
-		pj_status_t status;
-		struct ice_wrap *ice;
+	res = recvmmsg(rtp->s, batch->msgs, batch->size, MSG_DONTWAIT, NULL);
+	if (res <= 0) {
+		return res;
+	}
 
-		/* If RTCP is sharing the same socket then use the same component */
+	for (i = 0; i < res; i++) {
+		struct ast_sockaddr *addr = i ? &batch->addrs[i] : sa;
+
+		addr->len = batch->msgs[i].msg_hdr.msg_namelen;
+	}
+	batch->count = res;
+	batch->next = 1;
+	rtp->rxbatches++;
+	rtp->rxbatchcount += res;
+
+	return batch->msgs[0].msg_len;
+}
+
+/*!
+ * \internal
+ * \brief Queue a relayed RTP packet to be sent along with the rest of the current batch
+ *
+ * \pre instance is locked
+ *
+ * \retval 0 if the packet was queued or dropped
+ * \retval -1 if it must be sent immediately instead
+ */
+static int rtp_sendto_batched(struct ast_rtp_instance *instance, void *buf, int len,
+	struct ast_sockaddr *sa)
+{
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+	struct rtp_io_batch *batch;
+	int hdrlen = 12;
+	unsigned int i;
+
+	/* Leave room for an SRTP authentication tag and MKI, added when flushed */
+	if (rtp->bundled || rtp->s < 0 || len + RTP_IO_BATCH_SRTP_TRAILER > RTP_IO_BATCH_SLOT_SIZE) {
+		return -1;
+	}
+#ifdef HAVE_PJPROJECT
+	if (rtp->ice) {
+		return -1;
+	}
+#endif
+
+	if (!rtp->tx_batch && !(rtp->tx_batch = rtp_io_batch_alloc())) {
+		return -1;
+	}
+	batch = rtp->tx_batch;
+	if (batch->count == batch->size) {
+		rtp_tx_batch_flush(instance, rtp);
+	}
+
+	i = batch->count++;
+	memcpy(batch->data + i * RTP_IO_BATCH_SLOT_SIZE, buf, len);
+	ast_sockaddr_copy(&batch->addrs[i], sa);
+	batch->iov[i].iov_base = batch->data + i * RTP_IO_BATCH_SLOT_SIZE;
+	batch->iov[i].iov_len = len;
+	memset(&batch->msgs[i], 0, sizeof(batch->msgs[i]));
+	batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+	batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i].ss;
+	batch->msgs[i].msg_hdr.msg_namelen = batch->addrs[i].len;
+
+	rtp->txcount++;
+	rtp->txoctetcount += (len - hdrlen);
+
+	return 0;
+}
+#else
+static void rtp_tx_batch_flush(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
+{
+}
+
+static void rtp_tx_batch_flush_peer(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
+{
+}
+
+static int rtp_recvfrom_batched(struct ast_rtp_instance *instance, struct ast_rtp *rtp,
+	void *buf, size_t size, struct ast_sockaddr *sa)
+{
+	return ast_recvfrom(rtp->s, buf, size, 0, sa);
+}
+
+static int rtp_sendto_batched(struct ast_rtp_instance *instance, void *buf, int len,
+	struct ast_sockaddr *sa)
+{
+	return -1;
+}
+#endif
+
+/*!
+ * \internal
+ * \brief Forget any packets held in the batches
+ *
+ * \pre instance is locked
+ */
+static void rtp_io_batch_reset(struct ast_rtp *rtp)
+{
+	if (rtp->rx_batch) {
+		rtp->rx_batch->count = rtp->rx_batch->next = 0;
+	}
+	if (rtp->tx_batch) {
+		rtp->tx_batch->count = 0;
+	}
+}
+
+/*! \brief Reactor threads, started when reactor_threads is set in rtp.conf */
+static struct rtp_reactor *reactors;
+/*! \brief Number of running reactor threads */
+static unsigned int reactor_count;
+/*! \brief Used to spread new instances across the reactors */
+static int reactor_next;
+/*! \brief Set when the reactor threads need to exit */
+static int reactors_stopping;
+
+/*!
+ * \internal
+ * \brief Hand the current RTP socket of an instance to its reactor
+ *
+ * \pre instance is locked
+ */
+static void rtp_reactor_register(struct ast_rtp *rtp)
+{
+#ifdef HAVE_RTP_REACTOR
+	struct rtp_reactor_entry *entry = rtp->reactor_entry;
+	struct epoll_event event = { .events = EPOLLIN, };
+
+	if (!entry || rtp->s < 0 || entry->fd == rtp->s) {
+		return;
+	}
+
+	event.data.ptr = entry;
+	if (epoll_ctl(entry->reactor->epfd, EPOLL_CTL_ADD, rtp->s, &event)) {
+		ast_log(LOG_WARNING, "Unable to add RTP socket to reactor: %s\n", strerror(errno));
+		return;
+	}
+	entry->fd = rtp->s;
+#endif
+}
+
+/*!
+ * \internal
+ * \brief Stop the reactor from servicing the RTP socket of an instance
+ *
+ * \pre instance is locked
+ */
+static void rtp_reactor_unregister(struct ast_rtp *rtp)
+{
+#ifdef HAVE_RTP_REACTOR
+	struct rtp_reactor_entry *entry = rtp->reactor_entry;
+
+	if (!entry || entry->fd < 0) {
+		return;
+	}
+
+	epoll_ctl(entry->reactor->epfd, EPOLL_CTL_DEL, entry->fd, NULL);
+	entry->fd = -1;
+#endif
+}
+
+/*!
+ * \internal
+ * \brief Assign a newly created instance to a reactor if they are in use
+ */
+static void rtp_reactor_attach(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
+{
+	struct rtp_reactor_entry *entry;
+
+	if (!reactor_count || !reactor_threads) {
+		return;
+	}
+
+	entry = ao2_weakproxy_alloc(sizeof(*entry), NULL);
+	if (!entry) {
+		return;
+	}
+	entry->fd = -1;
+	entry->reactor = &reactors[(unsigned int) ast_atomic_fetchadd_int(&reactor_next, 1) % reactor_count];
+
+	if (ast_alertpipe_init(rtp->reactor_alert)) {
+		ao2_ref(entry, -1);
+		return;
+	}
+	if (ao2_weakproxy_set_object(entry, instance, 0)) {
+		ast_alertpipe_close(rtp->reactor_alert);
+		ao2_ref(entry, -1);
+		return;
+	}
+
+	rtp->reactor_entry = entry;
+	rtp_reactor_register(rtp);
+}
+
+/*!
+ * \internal
+ * \brief Release the reactor resources of an instance being destroyed
+ *
+ * \pre instance is locked
+ */
+static void rtp_reactor_detach(struct ast_rtp *rtp)
+{
+	struct rtp_reactor_entry *entry = rtp->reactor_entry;
+	struct rtp_reactor *reactor;
+
+	ast_frfree(AST_LIST_FIRST(&rtp->reactor_frames));
+	AST_LIST_HEAD_INIT_NOLOCK(&rtp->reactor_frames);
+	ast_alertpipe_close(rtp->reactor_alert);
+
+	if (!entry) {
+		return;
+	}
+	rtp_reactor_unregister(rtp);
+	rtp->reactor_entry = NULL;
+
+	/* A wakeup in progress may still reference the entry, the reactor releases it when done */
+	reactor = entry->reactor;
+	ast_mutex_lock(&reactor->lock);
+	AST_LIST_INSERT_TAIL(&reactor->retired, entry, list);
+	ast_mutex_unlock(&reactor->lock);
+}
+
+#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
+/*!
+ * \internal
+ * \brief Feed a received DTLS packet to OpenSSL
+ *
+ * \pre instance is locked
+ *
+ * \retval RTP_DTLS_ESTABLISHED if the handshake completed
+ * \retval 0 if the packet was consumed
+ * \retval -1 if DTLS failed
+ */
+static int dtls_process_packet(struct ast_rtp_instance *instance, struct ast_rtp *rtp,
+	struct dtls_details *dtls, void *buf, int len, int rtcp)
+{
+	int res = 0;
+
+	/*
+	 * A race condition is prevented between dtls_perform_handshake()
+	 * and this function because both functions have to get the
+	 * instance lock before they can do anything.  The
+	 * dtls_perform_handshake() function needs to start the timer
+	 * before we stop it below.
+	 */
+
+	/* Before we feed data into OpenSSL ensure that the timeout timer is either stopped or completed */
+	ao2_unlock(instance);
+	dtls_srtp_stop_timeout_timer(instance, rtp, rtcp);
+	ao2_lock(instance);
+
+	/* If we don't yet know if we are active or passive and we receive a packet... we are obviously passive */
+	if (dtls->dtls_setup == AST_RTP_DTLS_SETUP_ACTPASS) {
+		dtls->dtls_setup = AST_RTP_DTLS_SETUP_PASSIVE;
+		SSL_set_accept_state(dtls->ssl);
+	}
+
+	BIO_write(dtls->read_bio, buf, len);
+
+	len = SSL_read(dtls->ssl, buf, len);
+
+	if ((len < 0) && (SSL_get_error(dtls->ssl, len) == SSL_ERROR_SSL)) {
+		unsigned long error = ERR_get_error();
+		ast_log(LOG_ERROR, "DTLS failure occurred on RTP instance '%p' due to reason '%s', terminating\n",
+			instance, ERR_reason_error_string(error));
+		return -1;
+	}
+
+	if (SSL_is_init_finished(dtls->ssl)) {
+		/* Any further connections will be existing since this is now established */
+		dtls->connection = AST_RTP_DTLS_CONNECTION_EXISTING;
+		/* Use the keying material to set up key/salt information */
+		if ((res = dtls_srtp_setup(rtp, instance, rtcp))) {
+			return res;
+		}
+		/* Notify that dtls has been established */
+		res = RTP_DTLS_ESTABLISHED;
+
+		ast_debug_dtls(3, "(%p) DTLS - __rtp_recvfrom rtp=%p - established'\n", instance, rtp);
+	} else {
+		/* Since we've sent additional traffic start the timeout timer for retransmission */
+		dtls_srtp_start_timeout_timer(instance, rtp, rtcp);
+	}
+
+	return res;
+}
+
+/*! \brief A received DTLS packet waiting for an offload thread */
+struct dtls_offload_task {
+	struct ast_rtp_instance *instance;
+	int rtcp;
+	int len;
+	unsigned char buf[0];
+};
+
+static int dtls_offload_task_exec(void *data)
+{
+	struct dtls_offload_task *task = data;
+	struct ast_rtp_instance *instance = task->instance;
+	struct ast_rtp *rtp;
+	struct dtls_details *dtls = NULL;
+	struct ast_channel *chan;
+	char *channel_id;
+	int res = 0;
+
+	ao2_lock(instance);
+	rtp = ast_rtp_instance_get_data(instance);
+	if (!task->rtcp) {
+		dtls = &rtp->dtls;
+	} else if (rtp->rtcp) {
+		dtls = &rtp->rtcp->dtls;
+	}
+	if (dtls && dtls->offloaded) {
+		dtls->offloaded--;
+	}
+	if (dtls && dtls->ssl) {
+		res = dtls_process_packet(instance, rtp, dtls, task->buf, task->len, task->rtcp);
+	}
+	channel_id = ast_strdupa(ast_rtp_instance_get_channel_id(instance));
+	ao2_unlock(instance);
+
+	/*
+	 * The outcome can no longer be returned from the read, so tell the
+	 * channel directly just as the frame returned from the read would have.
+	 */
+	if (res && !ast_strlen_zero(channel_id) && (chan = ast_channel_get_by_name(channel_id))) {
+		if (res == RTP_DTLS_ESTABLISHED) {
+			ast_queue_control(chan, AST_CONTROL_SRCCHANGE);
+		} else {
+			ast_queue_hangup(chan);
+		}
+		ast_channel_unref(chan);
+	}
+
+	ao2_ref(instance, -1);
+	ast_free(task);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Queue a received DTLS packet to be processed by an offload thread
+ *
+ * Packets of the same instance always go to the same serializer so they
+ * are processed in the order they were received.
+ *
+ * \pre instance is locked
+ *
+ * \retval 0 if the packet was queued
+ * \retval -1 if it must be processed immediately instead
+ */
+static int dtls_offload_packet(struct ast_rtp_instance *instance, struct dtls_details *dtls,
+	const void *buf, int len, int rtcp)
+{
+	struct ast_taskprocessor *serializer;
+	struct dtls_offload_task *task;
+
+	task = ast_malloc(sizeof(*task) + len);
+	if (!task) {
+		return -1;
+	}
+	task->instance = ao2_bump(instance);
+	task->rtcp = rtcp;
+	task->len = len;
+	memcpy(task->buf, buf, len);
+
+	serializer = dtls_offload_serializers[((uintptr_t) instance >> 4) % dtls_offload_count];
+	if (ast_taskprocessor_push(serializer, dtls_offload_task_exec, task)) {
+		ao2_ref(instance, -1);
+		ast_free(task);
+		return -1;
+	}
+	dtls->offloaded++;
+
+	return 0;
+}
+
+/*! \brief Stop the DTLS offload threads and free the pre-generated certificates */
+static void dtls_offload_stop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < dtls_offload_count; i++) {
+		ast_taskprocessor_unreference(dtls_offload_serializers[i]);
+	}
+	ast_free(dtls_offload_serializers);
+	dtls_offload_serializers = NULL;
+	dtls_offload_count = 0;
+
+	ast_threadpool_shutdown(dtls_offload_pool);
+	dtls_offload_pool = NULL;
+
+	dtls_cert_pool_destroy();
+}
+
+/*!
+ * \brief Start the configured number of DTLS offload threads
+ *
+ * \note Offload threads are only started once, a changed thread count takes
+ * effect when the module is loaded again.
+ */
+static void dtls_offload_start(void)
+{
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 60,
+		.auto_increment = 1,
+		.initial_size = 0,
+		.max_size = dtls_offload_threads,
+	};
+	char name[AST_TASKPROCESSOR_MAX_NAME + 1];
+	unsigned int i;
+
+	if (dtls_offload_pool || !dtls_offload_threads) {
+		if (dtls_offload_pool && dtls_offload_count != dtls_offload_threads) {
+			ast_log(LOG_NOTICE, "DTLS offload thread count changes take effect when res_rtp_asterisk is loaded again\n");
+		}
+		return;
+	}
+
+	dtls_offload_pool = ast_threadpool_create("rtp-dtls", NULL, &options);
+	dtls_offload_serializers = ast_calloc(dtls_offload_threads, sizeof(*dtls_offload_serializers));
+	if (!dtls_offload_pool || !dtls_offload_serializers) {
+		goto error;
+	}
+
+	/* One serializer per thread so handshakes of different instances run in parallel */
+	for (i = 0; i < dtls_offload_threads; i++) {
+		ast_taskprocessor_build_name(name, sizeof(name), "rtp-dtls");
+		dtls_offload_serializers[i] = ast_threadpool_serializer(name, dtls_offload_pool);
+		if (!dtls_offload_serializers[i]) {
+			goto error;
+		}
+		dtls_offload_count++;
+	}
+
+	return;
+
+error:
+	ast_log(LOG_ERROR, "Unable to start DTLS offload threads, handshakes will run on the media threads\n");
+	dtls_offload_stop();
+}
+#else
+static void dtls_offload_stop(void)
+{
+}
+
+static void dtls_offload_start(void)
+{
+}
+#endif
+
+/*! \pre instance is locked */
+static int __rtp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa, int rtcp)
+{
+	int len;
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
+	char *in = buf;
+#endif
+#ifdef HAVE_PJPROJECT
+	struct ast_sockaddr *loop = rtcp ? &rtp->rtcp_loop : &rtp->rtp_loop;
+#endif
+#ifdef TEST_FRAMEWORK
+	struct ast_rtp_engine_test *test = ast_rtp_instance_get_test(instance);
+#endif
+
+	if (!rtcp && io_batch > 1 && !rtp->rx_batch) {
+		rtp->rx_batch = rtp_io_batch_alloc();
+	}
+
+	if (!rtcp && rtp->rx_batch) {
+		len = rtp_recvfrom_batched(instance, rtp, buf, size, sa);
+	} else {
+		len = ast_recvfrom(rtcp ? rtp->rtcp->s : rtp->s, buf, size, flags, sa);
+	}
+	if (len < 0) {
+		return len;
+	}
+
+#ifdef TEST_FRAMEWORK
+	if (test && test->packets_to_drop > 0) {
+		test->packets_to_drop--;
+		return 0;
+	}
+#endif
+
+#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
+	/* If this is an SSL packet pass it to OpenSSL for processing. RFC section for first byte value:
+	 * https://tools.ietf.org/html/rfc5764#section-5.1.2 */
+	if ((*in >= 20) && (*in <= 63)) {
+		struct dtls_details *dtls = !rtcp ? &rtp->dtls : &rtp->rtcp->dtls;
+
+		/* If no SSL session actually exists terminate things */
+		if (!dtls->ssl) {
+			ast_log(LOG_ERROR, "Received SSL traffic on RTP instance '%p' without an SSL session\n",
+				instance);
+			return -1;
+		}
+
+		ast_debug_dtls(3, "(%p) DTLS - __rtp_recvfrom rtp=%p - Got SSL packet '%d'\n", instance, rtp, *in);
+
+		/* Handshakes are expensive, hand them to the offload threads when enabled */
+		if (dtls_offload_pool && (dtls->offloaded || !SSL_is_init_finished(dtls->ssl))
+			&& !dtls_offload_packet(instance, dtls, buf, len, rtcp)) {
+			return 0;
+		}
+
+		return dtls_process_packet(instance, rtp, dtls, buf, len, rtcp);
+	}
+#endif
+
+#ifdef HAVE_PJPROJECT
+	if (!ast_sockaddr_isnull(loop) && !ast_sockaddr_cmp(loop, sa)) {
+		/* ICE traffic will have been handled in the TURN callback, so skip it but update the address
+		 * so it reflects the actual source and not the loopback
+		 */
+		if (rtcp) {
+			ast_sockaddr_copy(sa, &rtp->rtcp->them);
+		} else {
+			ast_rtp_instance_get_remote_address(instance, sa);
+		}
+	} else if (rtp->ice) {
+		pj_str_t combined = pj_str(ast_sockaddr_stringify(sa));
+		pj_sockaddr address;
+		pj_status_t status;
+		struct ice_wrap *ice;
+
+		pj_thread_register_check();
+
+		pj_sockaddr_parse(pj_AF_UNSPEC(), 0, &combined, &address);
+
+		/* Release the instance lock to avoid deadlock with PJPROJECT group lock */
+		ice = rtp->ice;
+		ao2_ref(ice, +1);
+		ao2_unlock(instance);
+		status = pj_ice_sess_on_rx_pkt(ice->real_ice,
+			rtcp ? AST_RTP_ICE_COMPONENT_RTCP : AST_RTP_ICE_COMPONENT_RTP,
+			rtcp ? TRANSPORT_SOCKET_RTCP : TRANSPORT_SOCKET_RTP, buf, len, &address,
+			pj_sockaddr_get_len(&address));
+		ao2_ref(ice, -1);
+		ao2_lock(instance);
+		if (status != PJ_SUCCESS) {
+			char err_buf[100];
+
+			pj_strerror(status, err_buf, sizeof(err_buf));
+			ast_log(LOG_WARNING, "PJ ICE Rx error status code: %d '%s'.\n",
+				(int)status, err_buf);
+			return -1;
+		}
+		if (!rtp->passthrough) {
+			/* If a unidirectional ICE negotiation occurs then lock on to the source of the
+			 * ICE traffic and use it as the target. This will occur if the remote side only
+			 * wants to receive media but never send to us.
+			 */
+			if (!rtp->ice_active_remote_candidates && !rtp->ice_proposed_remote_candidates) {
+				if (rtcp) {
+					ast_sockaddr_copy(&rtp->rtcp->them, sa);
+				} else {
+					ast_rtp_instance_set_remote_address(instance, sa);
+				}
+			}
+			return 0;
+		}
+		rtp->passthrough = 0;
+	}
+#endif
+
+	return len;
+}
+
+/*! \pre instance is locked */
+static int rtcp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa)
+{
+	return __rtp_recvfrom(instance, buf, size, flags, sa, 1);
+}
+
+/*! \pre instance is locked */
+static int rtp_recvfrom(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa)
+{
+	return __rtp_recvfrom(instance, buf, size, flags, sa, 0);
+}
+
+/*! \pre instance is locked */
+static int __rtp_sendto(struct ast_rtp_instance *instance, void *buf, size_t size, int flags, struct ast_sockaddr *sa, int rtcp, int *via_ice, int use_srtp)
+{
+	int len = size;
+	void *temp = buf;
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+	struct ast_rtp_instance *transport = rtp->bundled ? rtp->bundled : instance;
+	struct ast_rtp *transport_rtp = ast_rtp_instance_get_data(transport);
+	struct ast_srtp *srtp = ast_rtp_instance_get_srtp(transport, rtcp);
+	int res;
+
+	*via_ice = 0;
+
+	/* Anything we sent ahead of this packet must go out first */
+	if (transport == instance && transport_rtp->tx_batch && transport_rtp->tx_batch->count) {
+		rtp_tx_batch_flush(transport, transport_rtp);
+	}
+
+	if (use_srtp && res_srtp && srtp && res_srtp->protect(srtp, &temp, &len, rtcp) < 0) {
+		return -1;
+	}
+
+#ifdef HAVE_PJPROJECT
+	if (transport_rtp->ice) {
+		enum ast_rtp_ice_component_type component = rtcp ? AST_RTP_ICE_COMPONENT_RTCP : AST_RTP_ICE_COMPONENT_RTP;
+		pj_status_t status;
+		struct ice_wrap *ice;
+
+		/* If RTCP is sharing the same socket then use the same component */
 		if (rtcp && rtp->rtcp->s == rtp->s) {
 			component = AST_RTP_ICE_COMPONENT_RTP;
 		}
@@ -3518,14 +4360,315 @@ static int stun_address_is_blacklisted(const struct ast_sockaddr *addr)
 	return result;
 }
 
+/*! \brief Addresses of the local interfaces usable as ICE host candidates */
+AST_VECTOR(ice_addresses, struct ast_sockaddr);
+
+/*! \brief A server reflexive address learned with STUN for a local address */
+struct ice_srflx_entry {
+	struct ast_sockaddr local; /*!< Address the RTP socket was bound to, the port is ignored */
+	struct sockaddr_in mapped; /*!< Address the STUN server saw the request coming from */
+	int port_preserved;        /*!< The NAT kept the local port, so the mapping applies to any port */
+	time_t updated;            /*!< When the mapping was learned */
+};
+
+/*! \brief Cached addresses of the local interfaces */
+static struct ice_addresses ice_host_cache;
+/*! \brief When ice_host_cache was gathered, 0 if it is empty */
+static time_t ice_host_cache_gathered;
+/*! \brief Cached server reflexive addresses */
+static AST_VECTOR(, struct ice_srflx_entry) ice_srflx_cache;
+/*! \brief Set while a refresh of the caches is queued or running */
+static int ice_cache_refreshing;
+AST_MUTEX_DEFINE_STATIC(ice_cache_lock);
+
+/*!
+ * \internal
+ * \brief Gather the addresses of the local interfaces which may become host candidates
+ *
+ * \retval 0 on success
+ * \retval -1 if the addresses could not be obtained
+ */
+static int ice_interfaces_gather(struct ice_addresses *addrs)
+{
+	struct ifaddrs *ifa, *ia;
+	struct ast_sockaddr tmp;
+
+	if (getifaddrs(&ifa) < 0) {
+		return -1;
+	}
+
+	for (ia = ifa; ia; ia = ia->ifa_next) {
+		/* Interface is either not UP or doesn't have an address assigned,
+		 * eg, a ppp that just completed LCP but no IPCP yet */
+		if (!ia->ifa_addr || (ia->ifa_flags & IFF_UP) == 0) {
+			continue;
+		}
+
+		/* Filter out non-IPvX addresses, eg, link-layer */
+		if (ia->ifa_addr->sa_family != AF_INET && ia->ifa_addr->sa_family != AF_INET6) {
+			continue;
+		}
+
+		ast_sockaddr_from_sockaddr(&tmp, ia->ifa_addr);
+
+		if (ia->ifa_addr->sa_family == AF_INET) {
+			const struct sockaddr_in *sa_in = (struct sockaddr_in*)ia->ifa_addr;
+
+			/* Skip 127.0.0.0/8 (loopback) */
+			/* Don't use IFF_LOOPBACK check since one could assign usable
+			 * publics to the loopback */
+			if ((sa_in->sin_addr.s_addr & htonl(0xFF000000)) == htonl(0x7F000000)) {
+				continue;
+			}
+
+			/* Skip 0.0.0.0/8 based on RFC1122, and from pjproject */
+			if ((sa_in->sin_addr.s_addr & htonl(0xFF000000)) == 0) {
+				continue;
+			}
+		} else { /* ia->ifa_addr->sa_family == AF_INET6 */
+			/* Filter ::1 */
+			if (!ast_sockaddr_cmp_addr(&lo6, &tmp)) {
+				continue;
+			}
+		}
+
+		AST_VECTOR_APPEND(addrs, tmp);
+	}
+	freeifaddrs(ifa);
+
+	return 0;
+}
+
+/*! \brief Replace the cached interface addresses */
+static void ice_host_cache_store(const struct ice_addresses *addrs)
+{
+	int i;
+
+	ast_mutex_lock(&ice_cache_lock);
+	AST_VECTOR_RESET(&ice_host_cache, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	for (i = 0; i < AST_VECTOR_SIZE(addrs); i++) {
+		AST_VECTOR_APPEND(&ice_host_cache, AST_VECTOR_GET(addrs, i));
+	}
+	ice_host_cache_gathered = time(NULL);
+	ast_mutex_unlock(&ice_cache_lock);
+}
+
+/*!
+ * \internal
+ * \brief Learn the server reflexive address of a local address from a socket of our own
+ */
+static void ice_srflx_refresh(const struct ast_sockaddr *local)
+{
+	struct ast_sockaddr bind_addr;
+	struct sockaddr_in answer;
+	int port;
+	int sock;
+	int i;
+
+	if (ast_sockaddr_is_ipv4(local)) {
+		ast_sockaddr_copy(&bind_addr, local);
+		ast_sockaddr_set_port(&bind_addr, 0);
+	} else {
+		ast_sockaddr_parse(&bind_addr, "0.0.0.0", 0);
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0) {
+		return;
+	}
+	if (ast_bind(sock, &bind_addr) || ast_getsockname(sock, &bind_addr)
+		|| ast_stun_request(sock, &stunaddr, NULL, &answer)) {
+		close(sock);
+		return;
+	}
+	close(sock);
+	port = ast_sockaddr_port(&bind_addr);
+
+	ast_mutex_lock(&ice_cache_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&ice_srflx_cache); i++) {
+		struct ice_srflx_entry *entry = AST_VECTOR_GET_ADDR(&ice_srflx_cache, i);
+
+		if (!ast_sockaddr_cmp_addr(&entry->local, local)) {
+			entry->mapped = answer;
+			entry->port_preserved = ntohs(answer.sin_port) == port;
+			entry->updated = time(NULL);
+			break;
+		}
+	}
+	ast_mutex_unlock(&ice_cache_lock);
+}
+
+static int ice_cache_refresh(void *data)
+{
+	struct ice_addresses addrs;
+	int i;
+
+	if (!AST_VECTOR_INIT(&addrs, 8) && !ice_interfaces_gather(&addrs)) {
+		ice_host_cache_store(&addrs);
+	}
+
+	/* Reuse the vector for the local addresses of the server reflexive mappings */
+	AST_VECTOR_RESET(&addrs, AST_VECTOR_ELEM_CLEANUP_NOOP);
+	ast_mutex_lock(&ice_cache_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&ice_srflx_cache); i++) {
+		AST_VECTOR_APPEND(&addrs, AST_VECTOR_GET(&ice_srflx_cache, i).local);
+	}
+	ast_mutex_unlock(&ice_cache_lock);
+
+	/* The STUN requests block, which is why they happen here rather than during call setup */
+	if (stunaddr.sin_addr.s_addr) {
+		for (i = 0; i < AST_VECTOR_SIZE(&addrs); i++) {
+			ice_srflx_refresh(AST_VECTOR_GET_ADDR(&addrs, i));
+		}
+	}
+	AST_VECTOR_FREE(&addrs);
+
+	ast_mutex_lock(&ice_cache_lock);
+	ice_cache_refreshing = 0;
+	ast_mutex_unlock(&ice_cache_lock);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Queue a refresh of the cached addresses unless one is already pending
+ *
+ * \pre ice_cache_lock is held
+ */
+static void ice_cache_refresh_queue(void)
+{
+	if (!ice_cache_refreshing && ice_cache_tps) {
+		ice_cache_refreshing = !ast_taskprocessor_push(ice_cache_tps, ice_cache_refresh, NULL);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Get the addresses of the local interfaces, from the cache when enabled
+ *
+ * A stale cache is still used while a refresh is queued in the background.
+ */
+static int ice_host_addresses(struct ice_addresses *addrs)
+{
+	int i;
+
+	if (!ice_candidate_cache) {
+		return ice_interfaces_gather(addrs);
+	}
+
+	ast_mutex_lock(&ice_cache_lock);
+	if (ice_host_cache_gathered) {
+		for (i = 0; i < AST_VECTOR_SIZE(&ice_host_cache); i++) {
+			AST_VECTOR_APPEND(addrs, AST_VECTOR_GET(&ice_host_cache, i));
+		}
+		if (time(NULL) - ice_host_cache_gathered >= ice_candidate_cache) {
+			ice_cache_refresh_queue();
+		}
+		ast_mutex_unlock(&ice_cache_lock);
+		return 0;
+	}
+	ast_mutex_unlock(&ice_cache_lock);
+
+	if (ice_interfaces_gather(addrs)) {
+		return -1;
+	}
+	ice_host_cache_store(addrs);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Find the cached server reflexive address of a socket
+ *
+ * Only mappings of NATs that preserve the local port can be reused, as
+ * the address then only differs from socket to socket by that port.
+ *
+ * \param local Address the socket is bound to
+ * \param port Port the socket is bound to
+ * \param answer Set to the server reflexive address
+ *
+ * \retval 0 if a cached mapping applies
+ * \retval -1 if a STUN request is needed
+ */
+static int ice_srflx_lookup(const struct ast_sockaddr *local, int port, struct sockaddr_in *answer)
+{
+	int res = -1;
+	int i;
+
+	if (!ice_candidate_cache) {
+		return -1;
+	}
+
+	ast_mutex_lock(&ice_cache_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&ice_srflx_cache); i++) {
+		struct ice_srflx_entry *entry = AST_VECTOR_GET_ADDR(&ice_srflx_cache, i);
+
+		if (ast_sockaddr_cmp_addr(&entry->local, local)) {
+			continue;
+		}
+		if (entry->port_preserved) {
+			*answer = entry->mapped;
+			answer->sin_port = htons(port);
+			res = 0;
+		}
+		if (time(NULL) - entry->updated >= ice_candidate_cache) {
+			ice_cache_refresh_queue();
+		}
+		break;
+	}
+	ast_mutex_unlock(&ice_cache_lock);
+
+	return res;
+}
+
+/*! \brief Remember the server reflexive address learned for a socket */
+static void ice_srflx_store(const struct ast_sockaddr *local, int port, const struct sockaddr_in *answer)
+{
+	struct ice_srflx_entry new_entry = { .mapped = *answer, };
+	int i;
+
+	if (!ice_candidate_cache) {
+		return;
+	}
+
+	ast_sockaddr_copy(&new_entry.local, local);
+	new_entry.port_preserved = ntohs(answer->sin_port) == port;
+	new_entry.updated = time(NULL);
+
+	ast_mutex_lock(&ice_cache_lock);
+	for (i = 0; i < AST_VECTOR_SIZE(&ice_srflx_cache); i++) {
+		if (!ast_sockaddr_cmp_addr(&AST_VECTOR_GET_ADDR(&ice_srflx_cache, i)->local, local)) {
+			AST_VECTOR_REPLACE(&ice_srflx_cache, i, new_entry);
+			break;
+		}
+	}
+	if (i == AST_VECTOR_SIZE(&ice_srflx_cache)) {
+		AST_VECTOR_APPEND(&ice_srflx_cache, new_entry);
+	}
+	ast_mutex_unlock(&ice_cache_lock);
+}
+
+/*! \brief Forget every cached address */
+static void ice_cache_flush(void)
+{
+	ast_mutex_lock(&ice_cache_lock);
+	AST_VECTOR_FREE(&ice_host_cache);
+	AST_VECTOR_FREE(&ice_srflx_cache);
+	ice_host_cache_gathered = 0;
+	ast_mutex_unlock(&ice_cache_lock);
+}
+
 /*! \pre instance is locked */
 static void rtp_add_candidates_to_ice(struct ast_rtp_instance *instance, struct ast_rtp *rtp, struct ast_sockaddr *addr, int port, int component,
 				      int transport)
 {
 	unsigned int count = 0;
-	struct ifaddrs *ifa, *ia;
+	struct ice_addresses addrs;
 	struct ast_sockaddr tmp;
 	pj_sockaddr pjtmp;
+	int i;
 	struct ast_ice_host_candidate *candidate;
 	int af_inet_ok = 0, af_inet6_ok = 0;
 
@@ -3537,7 +4680,8 @@ static void rtp_add_candidates_to_ice(struct ast_rtp_instance *instance, struct
 		af_inet6_ok = 1;
 	}
 
-	if (getifaddrs(&ifa) < 0) {
+	AST_VECTOR_INIT(&addrs, 8);
+	if (ice_host_addresses(&addrs)) {
 		/* If we can't get addresses, we can't load ICE candidates */
 		ast_log(LOG_ERROR, "(%p) ICE Error obtaining list of local addresses: %s\n",
 				instance, strerror(errno));
@@ -3546,48 +4690,13 @@ static void rtp_add_candidates_to_ice(struct ast_rtp_instance *instance, struct
 		/* Iterate through the list of addresses obtained from the system,
 		 * until we've iterated through all of them, or accepted
 		 * PJ_ICE_MAX_CAND candidates */
-		for (ia = ifa; ia && count < PJ_ICE_MAX_CAND; ia = ia->ifa_next) {
-			/* Interface is either not UP or doesn't have an address assigned,
-			 * eg, a ppp that just completed LCP but no IPCP yet */
-			if (!ia->ifa_addr || (ia->ifa_flags & IFF_UP) == 0) {
-				continue;
-			}
+		for (i = 0; i < AST_VECTOR_SIZE(&addrs) && count < PJ_ICE_MAX_CAND; i++) {
+			ast_sockaddr_copy(&tmp, AST_VECTOR_GET_ADDR(&addrs, i));
 
-			/* Filter out non-IPvX addresses, eg, link-layer */
-			if (ia->ifa_addr->sa_family != AF_INET && ia->ifa_addr->sa_family != AF_INET6) {
+			if (ast_sockaddr_is_ipv4(&tmp) ? !af_inet_ok : !af_inet6_ok) {
 				continue;
 			}
 
-			ast_sockaddr_from_sockaddr(&tmp, ia->ifa_addr);
-
-			if (ia->ifa_addr->sa_family == AF_INET) {
-				const struct sockaddr_in *sa_in = (struct sockaddr_in*)ia->ifa_addr;
-				if (!af_inet_ok) {
-					continue;
-				}
-
-				/* Skip 127.0.0.0/8 (loopback) */
-				/* Don't use IFF_LOOPBACK check since one could assign usable
-				 * publics to the loopback */
-				if ((sa_in->sin_addr.s_addr & htonl(0xFF000000)) == htonl(0x7F000000)) {
-					continue;
-				}
-
-				/* Skip 0.0.0.0/8 based on RFC1122, and from pjproject */
-				if ((sa_in->sin_addr.s_addr & htonl(0xFF000000)) == 0) {
-					continue;
-				}
-			} else { /* ia->ifa_addr->sa_family == AF_INET6 */
-				if (!af_inet6_ok) {
-					continue;
-				}
-
-				/* Filter ::1 */
-				if (!ast_sockaddr_cmp_addr(&lo6, &tmp)) {
-					continue;
-				}
-			}
-
 			/* Pull in the host candidates from [ice_host_candidates] */
 			AST_RWLIST_RDLOCK(&host_candidates);
 			AST_LIST_TRAVERSE(&host_candidates, candidate, next) {
@@ -3634,8 +4743,8 @@ static void rtp_add_candidates_to_ice(struct ast_rtp_instance *instance, struct
 					pj_sockaddr_get_len(&pjtmp));
 			++count;
 		}
-		freeifaddrs(ifa);
 	}
+	AST_VECTOR_FREE(&addrs);
 
 	/* If configured to use a STUN server to get our external mapped address do so */
 	if (stunaddr.sin_addr.s_addr && !stun_address_is_blacklisted(addr) &&
@@ -3644,19 +4753,30 @@ static void rtp_add_candidates_to_ice(struct ast_rtp_instance *instance, struct
 		struct sockaddr_in answer;
 		int rsp;
 
-		ast_debug_category(3, AST_DEBUG_CATEGORY_ICE | AST_DEBUG_CATEGORY_STUN,
-			"(%p) ICE request STUN %s %s candidate\n", instance,
-			transport == AST_TRANSPORT_UDP ? "UDP" : "TCP",
-			component == AST_RTP_ICE_COMPONENT_RTP ? "RTP" : "RTCP");
+		if (!ice_srflx_lookup(addr, port, &answer)) {
+			ast_debug_category(3, AST_DEBUG_CATEGORY_ICE | AST_DEBUG_CATEGORY_STUN,
+				"(%p) ICE using cached STUN %s %s candidate\n", instance,
+				transport == AST_TRANSPORT_UDP ? "UDP" : "TCP",
+				component == AST_RTP_ICE_COMPONENT_RTP ? "RTP" : "RTCP");
+			rsp = 0;
+		} else {
+			ast_debug_category(3, AST_DEBUG_CATEGORY_ICE | AST_DEBUG_CATEGORY_STUN,
+				"(%p) ICE request STUN %s %s candidate\n", instance,
+				transport == AST_TRANSPORT_UDP ? "UDP" : "TCP",
+				component == AST_RTP_ICE_COMPONENT_RTP ? "RTP" : "RTCP");
 
-		/*
-		 * The instance should not be locked because we can block
-		 * waiting for a STUN respone.
-		 */
-		ao2_unlock(instance);
-		rsp = ast_stun_request(component == AST_RTP_ICE_COMPONENT_RTCP
-			? rtp->rtcp->s : rtp->s, &stunaddr, NULL, &answer);
-		ao2_lock(instance);
+			/*
+			 * The instance should not be locked because we can block
+			 * waiting for a STUN respone.
+			 */
+			ao2_unlock(instance);
+			rsp = ast_stun_request(component == AST_RTP_ICE_COMPONENT_RTCP
+				? rtp->rtcp->s : rtp->s, &stunaddr, NULL, &answer);
+			ao2_lock(instance);
+			if (!rsp) {
+				ice_srflx_store(addr, port, &answer);
+			}
+		}
 		if (!rsp) {
 			struct ast_rtp_engine_ice_candidate *candidate;
 			pj_sockaddr ext, base;
@@ -3825,6 +4945,131 @@ static int ice_create(struct ast_rtp_instance *instance, struct ast_sockaddr *ad
 }
 #endif
 
+#define RTP_PORT_USED(port) (rtp_ports_used[(port) / 16] & (1 << (((port) / 2) % 8)))
+
+/*!
+ * \internal
+ * \brief Rebuild the RTP port freelist for the configured range
+ *
+ * Ports our instances hold stay out of it. The rest are shuffled so the order
+ * they are handed out in can not be predicted, much as starting from a random
+ * port did.
+ */
+static void rtp_ports_build(void)
+{
+	unsigned short *ports;
+	unsigned int size = 0;
+	unsigned int count = 0;
+	unsigned int i;
+	int port;
+
+	for (port = (rtpstart + 1) & ~1; port <= rtpend; port += 2) {
+		size++;
+	}
+
+	ports = ast_malloc(MAX(size, 1) * sizeof(*ports));
+	if (!ports) {
+		return;
+	}
+
+	ast_mutex_lock(&rtp_ports_lock);
+	for (port = (rtpstart + 1) & ~1; port <= rtpend; port += 2) {
+		if (!RTP_PORT_USED(port)) {
+			ports[count++] = port;
+		}
+	}
+	for (i = count; i > 1; i--) {
+		unsigned int j = ast_random() % i;
+		unsigned short tmp = ports[i - 1];
+
+		ports[i - 1] = ports[j];
+		ports[j] = tmp;
+	}
+
+	ast_free(rtp_ports_free);
+	rtp_ports_free = ports;
+	rtp_ports_size = size;
+	rtp_ports_head = 0;
+	rtp_ports_count = count;
+	ast_mutex_unlock(&rtp_ports_lock);
+}
+
+/*!
+ * \internal
+ * \brief Take the next free port from the freelist
+ *
+ * \retval 0 if there is none
+ */
+static unsigned short rtp_port_take(void)
+{
+	unsigned short port = 0;
+
+	ast_mutex_lock(&rtp_ports_lock);
+	if (rtp_ports_count) {
+		port = rtp_ports_free[rtp_ports_head];
+		rtp_ports_head = (rtp_ports_head + 1) % rtp_ports_size;
+		rtp_ports_count--;
+		rtp_ports_used[port / 16] |= 1 << ((port / 2) % 8);
+	}
+	ast_mutex_unlock(&rtp_ports_lock);
+
+	return port;
+}
+
+/*!
+ * \internal
+ * \brief Put a port taken from the freelist back at its tail
+ *
+ * Going to the tail keeps a port from being reused while packets for its last
+ * call may still be arriving.
+ */
+static void rtp_port_return(unsigned short port)
+{
+	ast_mutex_lock(&rtp_ports_lock);
+	rtp_ports_used[port / 16] &= ~(1 << ((port / 2) % 8));
+	/* The range may have changed since it was taken */
+	if (port >= rtpstart && port <= rtpend && rtp_ports_count < rtp_ports_size) {
+		rtp_ports_free[(rtp_ports_head + rtp_ports_count) % rtp_ports_size] = port;
+		rtp_ports_count++;
+	}
+	ast_mutex_unlock(&rtp_ports_lock);
+}
+
+/*!
+ * \internal
+ * \brief Bind the RTP socket to a port from the freelist
+ *
+ * The ports our own instances hold are never tried, so this normally succeeds
+ * at the first attempt however busy the range is. Ports some other process
+ * holds go back to the tail.
+ *
+ * \retval 0 on success
+ * \retval -1 if no port in the freelist could be bound
+ */
+static int rtp_bind_pool_port(struct ast_rtp *rtp)
+{
+	unsigned int tries;
+	unsigned short port;
+
+	ast_mutex_lock(&rtp_ports_lock);
+	tries = rtp_ports_count;
+	ast_mutex_unlock(&rtp_ports_lock);
+
+	while (tries-- && (port = rtp_port_take())) {
+		ast_sockaddr_set_port(&rtp->bind_address, port);
+		if (!ast_bind(rtp->s, &rtp->bind_address)) {
+			rtp->pool_port = port;
+			return 0;
+		}
+		rtp_port_return(port);
+		if (errno != EADDRINUSE && errno != EACCES) {
+			break;
+		}
+	}
+
+	return -1;
+}
+
 static int rtp_allocate_transport(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
 {
 	int x, startplace;
@@ -3841,6 +5086,18 @@ static int rtp_allocate_transport(struct ast_rtp_instance *instance, struct ast_
 	}
 
 	/* Now actually find a free RTP port to use */
+	if (!rtp_bind_pool_port(rtp)) {
+		x = rtp->pool_port;
+		ast_debug_rtp(1, "(%p) RTP allocated port %d\n", instance, x);
+		ast_rtp_instance_set_local_address(instance, &rtp->bind_address);
+		ast_test_suite_event_notify("RTP_PORT_ALLOCATED", "Port: %d", x);
+		goto bound;
+	}
+
+	/*
+	 * Every port in the freelist is held, though perhaps on another address than
+	 * ours, so fall back to trying each port in turn.
+	 */
 	x = (rtpend == rtpstart) ? rtpstart : (ast_random() % (rtpend - rtpstart)) + rtpstart;
 	x = x & ~1;
 	startplace = x;
@@ -3869,6 +5126,7 @@ static int rtp_allocate_transport(struct ast_rtp_instance *instance, struct ast_
 		}
 	}
 
+bound:
 #ifdef HAVE_PJPROJECT
 	/* Initialize synchronization aspects */
 	ast_cond_init(&rtp->cond, NULL);
@@ -3895,6 +5153,8 @@ static int rtp_allocate_transport(struct ast_rtp_instance *instance, struct ast_
 	rtp->dtls.timeout_timer = -1;
 #endif
 
+	rtp_reactor_register(rtp);
+
 	return 0;
 }
 
@@ -3911,10 +5171,16 @@ static void rtp_deallocate_transport(struct ast_rtp_instance *instance, struct a
 #endif
 
 	/* Close our own socket so we no longer get packets */
+	rtp_reactor_unregister(rtp);
 	if (rtp->s > -1) {
 		close(rtp->s);
 		rtp->s = -1;
 	}
+	if (rtp->pool_port) {
+		rtp_port_return(rtp->pool_port);
+		rtp->pool_port = 0;
+	}
+	rtp_io_batch_reset(rtp);
 
 	/* Destroy RTCP if it was being used */
 	if (rtp->rtcp && rtp->rtcp->s > -1) {
@@ -4008,6 +5274,7 @@ static int ast_rtp_new(struct ast_rtp_instance *instance,
 	rtp->expectedseqno = -1;
 	rtp->sched = sched;
 	ast_sockaddr_copy(&rtp->bind_address, addr);
+	ast_alertpipe_clear(rtp->reactor_alert);
 
 	/* Transport creation operations can grab the RTP data from the instance, so set it */
 	ast_rtp_instance_set_data(instance, rtp);
@@ -4030,6 +5297,9 @@ static int ast_rtp_new(struct ast_rtp_instance *instance,
 	rtp->lasttxformat = ao2_bump(ast_format_none);
 	rtp->stream_num = -1;
 
+	/* Only now is the instance ready to be read by a reactor */
+	rtp_reactor_attach(instance, rtp);
+
 	return 0;
 }
 
@@ -4044,11 +5314,439 @@ static int ast_rtp_new(struct ast_rtp_instance *instance,
  */
 #define SSRC_MAPPING_ELEM_CMP(elem, value) ((elem).instance == (value))
 
+/*!
+ * \internal
+ * \brief Run a set of nft commands against the kernel relay table as one transaction
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int __attribute__((format(printf, 1, 2))) kernel_relay_nft(const char *fmt, ...)
+{
+	struct ast_str *cmd;
+	va_list ap;
+	int res;
+
+	cmd = ast_str_create(256);
+	if (!cmd) {
+		return -1;
+	}
+
+	ast_str_set(&cmd, 0, "nft '");
+	va_start(ap, fmt);
+	ast_str_append_va(&cmd, 0, fmt, ap);
+	va_end(ap);
+	ast_str_append(&cmd, 0, "' >/dev/null 2>&1");
+
+	res = ast_safe_system(ast_str_buffer(cmd));
+	ast_debug_rtp(3, "(kernel relay) '%s' returned %d\n", ast_str_buffer(cmd), res);
+	ast_free(cmd);
+
+	return res ? -1 : 0;
+}
+
+/*! \brief Remove the kernel relay table along with every flow in it */
+static void kernel_relay_table_destroy(void)
+{
+	kernel_relay_nft("delete table ip " KERNEL_RELAY_TABLE);
+	kernel_relay_ready = 0;
+}
+
+/*!
+ * \internal
+ * \brief Create or remove the kernel relay table to match the configuration
+ *
+ * Flows are matched on the address and port the stream is received from and
+ * the local port it is received on. A packet matching an installed flow
+ * has its addresses and ports rewritten to those of the bridged peer and is
+ * routed back out by the kernel without ever reaching Asterisk. The rewrite
+ * maps are keyed by the local port alone, since it is the last field to be
+ * rewritten.
+ *
+ * \note Runs on the kernel relay taskprocessor.
+ */
+static int kernel_relay_configure(void *data)
+{
+	if (!kernel_relay) {
+		if (kernel_relay_ready) {
+			kernel_relay_table_destroy();
+			ast_verb(2, "RTP kernel relay disabled\n");
+		}
+		return 0;
+	}
+
+	if (kernel_relay_ready) {
+		return 0;
+	}
+
+	/* Start from an empty table in case a previous run left one behind */
+	if (kernel_relay_nft(
+			"add table ip " KERNEL_RELAY_TABLE "; "
+			"delete table ip " KERNEL_RELAY_TABLE "; "
+			"add table ip " KERNEL_RELAY_TABLE "; "
+			"add set ip " KERNEL_RELAY_TABLE " flows { type ipv4_addr . inet_service . inet_service; }; "
+			"add map ip " KERNEL_RELAY_TABLE " to_saddr { type inet_service : ipv4_addr; }; "
+			"add map ip " KERNEL_RELAY_TABLE " to_sport { type inet_service : inet_service; }; "
+			"add map ip " KERNEL_RELAY_TABLE " to_daddr { type inet_service : ipv4_addr; }; "
+			"add map ip " KERNEL_RELAY_TABLE " to_dport { type inet_service : inet_service; }; "
+			"add chain ip " KERNEL_RELAY_TABLE " prerouting { type filter hook prerouting priority -300; policy accept; }; "
+			"add rule ip " KERNEL_RELAY_TABLE " prerouting ip saddr . udp sport . udp dport @flows notrack "
+				"ip saddr set udp dport map @to_saddr "
+				"udp sport set udp dport map @to_sport "
+				"ip daddr set udp dport map @to_daddr "
+				"udp dport set udp dport map @to_dport")) {
+		ast_log(LOG_WARNING, "Unable to create nftables table '%s', RTP kernel relay is not available\n",
+			KERNEL_RELAY_TABLE);
+		return 0;
+	}
+
+	kernel_relay_ready = 1;
+	ast_verb(2, "RTP kernel relay enabled using nftables table '%s'\n", KERNEL_RELAY_TABLE);
+
+	return 0;
+}
+
+/*! \brief Queued state needed to install or remove a kernel relayed flow */
+struct rtp_kernel_relay_task {
+	/*! The receiving RTP instance */
+	struct ast_rtp_instance *instance;
+	/*! The RTP instance the stream is relayed out of */
+	struct ast_rtp_instance *bridged;
+	/*! Generation of the receiving instance relay when the task was queued */
+	unsigned int generation;
+	/*! The flow to remove */
+	struct rtp_kernel_relay_flow flow;
+};
+
+static void kernel_relay_task_free(struct rtp_kernel_relay_task *task)
+{
+	ao2_cleanup(task->instance);
+	ao2_cleanup(task->bridged);
+	ast_free(task);
+}
+
+static int kernel_relay_flow_remove(const struct rtp_kernel_relay_flow *flow)
+{
+	/* The flows set gates the rule so it goes first, leaving no half relayed state */
+	return kernel_relay_nft(
+		"delete element ip " KERNEL_RELAY_TABLE " flows { %s . %d . %d }; "
+		"delete element ip " KERNEL_RELAY_TABLE " to_saddr { %d }; "
+		"delete element ip " KERNEL_RELAY_TABLE " to_sport { %d }; "
+		"delete element ip " KERNEL_RELAY_TABLE " to_daddr { %d }; "
+		"delete element ip " KERNEL_RELAY_TABLE " to_dport { %d }",
+		flow->remote, flow->remote_port, flow->local_port,
+		flow->local_port, flow->local_port, flow->local_port, flow->local_port);
+}
+
+/*! \note Runs on the kernel relay taskprocessor. */
+static int kernel_relay_remove_task(void *data)
+{
+	struct rtp_kernel_relay_task *task = data;
+
+	if (kernel_relay_ready && kernel_relay_flow_remove(&task->flow)) {
+		ast_log(LOG_WARNING, "Unable to remove RTP kernel relay for %s:%d\n",
+			task->flow.remote, task->flow.remote_port);
+	}
+	kernel_relay_task_free(task);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Determine if a stream still needs Asterisk to process its packets
+ *
+ * \pre instance is locked
+ *
+ * \retval 1 if packets can bypass the RTP stack for this instance
+ * \retval 0 otherwise
+ */
+static int kernel_relay_eligible(struct ast_rtp_instance *instance, struct ast_rtp *rtp)
+{
+	if (rtp->bundled || AST_VECTOR_SIZE(&rtp->ssrc_mapping) || rtp->red
+		|| rtp->send_buffer || rtp->recv_buffer || rtp->transport_wide_cc.schedid > -1) {
+		return 0;
+	}
+
+#ifdef HAVE_PJPROJECT
+	if (rtp->ice || rtp->turn_rtp) {
+		return 0;
+	}
+#endif
+
+#if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
+	if (rtp->dtls.ssl) {
+		return 0;
+	}
+#endif
+
+	if (ast_rtp_instance_get_srtp(instance, 0)
+		|| (rtp->rtcp && rtp->rtcp->type == AST_RTP_INSTANCE_RTCP_MUX)) {
+		return 0;
+	}
+
+	if (rtp->strict_rtp_state == STRICT_RTP_LEARN || rtp->sending_digit) {
+		return 0;
+	}
+
+	/* Wait until symmetric RTP has learned where the stream really comes from */
+	if (ast_rtp_instance_get_prop(instance, AST_RTP_PROPERTY_NAT)
+		&& ast_test_flag(rtp, FLAG_NAT_ACTIVE) != FLAG_NAT_ACTIVE) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/*!
+ * \internal
+ * \brief Check that packets can be relayed without rewriting their payload type
+ *
+ * \retval 1 if every payload type negotiated on \a codecs is sent with the same number by \a bridged
+ * \retval 0 otherwise
+ */
+static int kernel_relay_codecs_identical(struct ast_rtp_codecs *codecs, struct ast_rtp_codecs *bridged)
+{
+	int payload;
+
+	for (payload = 0; payload < AST_RTP_MAX_PT; payload++) {
+		struct ast_rtp_payload_type *type;
+		int bridged_payload;
+
+		type = ast_rtp_codecs_get_payload(codecs, payload);
+		if (!type) {
+			continue;
+		}
+		bridged_payload = ast_rtp_codecs_payload_code_tx(bridged, type->asterisk_format,
+			type->format, type->rtp_code);
+		ao2_ref(type, -1);
+
+		if (bridged_payload != payload) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*! \note Runs on the kernel relay taskprocessor. */
+static int kernel_relay_install_task(void *data)
+{
+	struct rtp_kernel_relay_task *task = data;
+	struct ast_rtp *rtp;
+	struct ast_rtp *bridged;
+	struct ast_sockaddr remote;
+	struct ast_sockaddr peer_local;
+	struct ast_sockaddr peer_remote;
+	struct rtp_kernel_relay_flow flow = { .local_port = 0, };
+	char peer_local_str[AST_SOCKADDR_BUFLEN];
+	int eligible;
+	int res;
+
+	/* The instances are never locked together so they are checked one at a time */
+	ao2_lock(task->instance);
+	rtp = ast_rtp_instance_get_data(task->instance);
+	rtp->relay.pending = 0;
+	eligible = kernel_relay_ready
+		&& rtp->relay.generation == task->generation
+		&& !rtp->relay.installed
+		&& ast_rtp_instance_get_bridged(task->instance) == task->bridged
+		&& kernel_relay_eligible(task->instance, rtp);
+	if (eligible) {
+		ast_rtp_instance_get_remote_address(task->instance, &remote);
+		ast_rtp_instance_get_local_address(task->instance, &peer_local);
+		flow.local_port = ast_sockaddr_port(&peer_local);
+	}
+	ao2_unlock(task->instance);
+	if (!eligible) {
+		goto done;
+	}
+
+	ao2_lock(task->bridged);
+	bridged = ast_rtp_instance_get_data(task->bridged);
+	eligible = ast_rtp_instance_get_bridged(task->bridged) == task->instance
+		&& !ast_test_flag(bridged, FLAG_NEED_MARKER_BIT | FLAG_REQ_LOCAL_BRIDGE_BIT)
+		&& kernel_relay_eligible(task->bridged, bridged);
+	if (eligible) {
+		ast_rtp_instance_get_remote_address(task->bridged, &peer_remote);
+		ast_rtp_instance_get_local_address(task->bridged, &peer_local);
+	}
+	ao2_unlock(task->bridged);
+	if (!eligible
+		|| !ast_sockaddr_is_ipv4(&remote) || !ast_sockaddr_port(&remote)
+		|| !ast_sockaddr_is_ipv4(&peer_remote) || !ast_sockaddr_port(&peer_remote)) {
+		goto done;
+	}
+
+	/* Relayed packets must leave from the address the peer expects to hear us on */
+	if (ast_sockaddr_is_any(&peer_local) && ast_ouraddrfor(&peer_remote, &peer_local)) {
+		goto done;
+	}
+	if (!ast_sockaddr_is_ipv4(&peer_local)) {
+		goto done;
+	}
+
+	if (!kernel_relay_codecs_identical(ast_rtp_instance_get_codecs(task->instance),
+			ast_rtp_instance_get_codecs(task->bridged))) {
+		ast_debug_rtp(2, "(%p, %p) RTP payload types differ, not relaying in kernel\n",
+			task->instance, task->bridged);
+		goto done;
+	}
+
+	ast_copy_string(flow.remote, ast_sockaddr_stringify_addr(&remote), sizeof(flow.remote));
+	flow.remote_port = ast_sockaddr_port(&remote);
+	ast_copy_string(peer_local_str, ast_sockaddr_stringify_addr(&peer_local), sizeof(peer_local_str));
+
+	/*
+	 * Another instance bound to a different address may share our local
+	 * port, in which case adding the rewrites fails and the stream simply
+	 * stays in Asterisk.
+	 */
+	res = kernel_relay_nft(
+		"add element ip " KERNEL_RELAY_TABLE " to_saddr { %d : %s }; "
+		"add element ip " KERNEL_RELAY_TABLE " to_sport { %d : %d }; "
+		"add element ip " KERNEL_RELAY_TABLE " to_daddr { %d : %s }; "
+		"add element ip " KERNEL_RELAY_TABLE " to_dport { %d : %d }; "
+		"add element ip " KERNEL_RELAY_TABLE " flows { %s . %d . %d }",
+		flow.local_port, peer_local_str,
+		flow.local_port, ast_sockaddr_port(&peer_local),
+		flow.local_port, ast_sockaddr_stringify_addr(&peer_remote),
+		flow.local_port, ast_sockaddr_port(&peer_remote),
+		flow.remote, flow.remote_port, flow.local_port);
+	if (res) {
+		ast_debug_rtp(1, "(%p, %p) RTP unable to install kernel relay for %s:%d\n",
+			task->instance, task->bridged, flow.remote, flow.remote_port);
+		goto done;
+	}
+
+	ao2_lock(task->instance);
+	rtp = ast_rtp_instance_get_data(task->instance);
+	if (rtp->relay.generation == task->generation) {
+		rtp->relay.installed = 1;
+		rtp->relay.flow = flow;
+		res = 1;
+	}
+	ao2_unlock(task->instance);
+
+	if (res) {
+		ast_debug_rtp(1, "(%p, %p) RTP from %s:%d now relayed by the kernel\n",
+			task->instance, task->bridged, flow.remote, flow.remote_port);
+	} else {
+		/* The stream was reclaimed while the flow was being installed */
+		kernel_relay_flow_remove(&flow);
+	}
+
+done:
+	kernel_relay_task_free(task);
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Queue offloading of a stream that is being locally bridged
+ *
+ * \pre instance is locked
+ */
+static void kernel_relay_start(struct ast_rtp_instance *instance, struct ast_rtp *rtp,
+	struct ast_rtp_instance *bridged)
+{
+	struct rtp_kernel_relay_task *task;
+	struct timeval now;
+
+	if (!kernel_relay_ready || rtp->relay.pending || rtp->relay.installed) {
+		return;
+	}
+
+	now = ast_tvnow();
+	if (ast_tvcmp(now, rtp->relay.next_attempt) < 0) {
+		return;
+	}
+	rtp->relay.next_attempt = ast_tvadd(now, ast_samp2tv(KERNEL_RELAY_RETRY_MS, 1000));
+
+	task = ast_calloc(1, sizeof(*task));
+	if (!task) {
+		return;
+	}
+	task->instance = ao2_bump(instance);
+	task->bridged = ao2_bump(bridged);
+	task->generation = rtp->relay.generation;
+
+	rtp->relay.pending = 1;
+	if (ast_taskprocessor_push(kernel_relay_tps, kernel_relay_install_task, task)) {
+		rtp->relay.pending = 0;
+		kernel_relay_task_free(task);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Hand a stream received by this instance back to Asterisk
+ *
+ * \pre instance is locked
+ */
+static void kernel_relay_stop(struct ast_rtp *rtp)
+{
+	struct rtp_kernel_relay_task *task;
+
+	rtp->relay.generation++;
+	if (!rtp->relay.installed) {
+		return;
+	}
+	rtp->relay.installed = 0;
+
+	task = ast_calloc(1, sizeof(*task));
+	if (!task) {
+		return;
+	}
+	task->flow = rtp->relay.flow;
+	if (!kernel_relay_tps || ast_taskprocessor_push(kernel_relay_tps, kernel_relay_remove_task, task)) {
+		ast_log(LOG_WARNING, "Unable to queue removal of RTP kernel relay for %s:%d\n",
+			task->flow.remote, task->flow.remote_port);
+		kernel_relay_task_free(task);
+	}
+}
+
+/*!
+ * \internal
+ * \brief Hand the stream relayed towards this instance back to Asterisk
+ *
+ * \pre instance is locked
+ *
+ * \note The instance lock is released while the bridged instance is locked.
+ */
+static void kernel_relay_stop_peer(struct ast_rtp_instance *instance)
+{
+	struct ast_rtp_instance *bridged;
+
+	if (!kernel_relay_ready) {
+		return;
+	}
+
+	bridged = ast_rtp_instance_get_bridged(instance);
+	if (!bridged) {
+		return;
+	}
+
+	ao2_ref(bridged, +1);
+	ao2_unlock(instance);
+	ao2_lock(bridged);
+	kernel_relay_stop(ast_rtp_instance_get_data(bridged));
+	ao2_unlock(bridged);
+	ao2_lock(instance);
+	ao2_ref(bridged, -1);
+}
+
 /*! \pre instance is locked */
 static int ast_rtp_destroy(struct ast_rtp_instance *instance)
 {
 	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
 
+	kernel_relay_stop(rtp);
+
+	ao2_cleanup(rtp->tx_peer);
+	ast_free(rtp->rx_batch);
+	ast_free(rtp->tx_batch);
+
 	if (rtp->bundled) {
 		struct ast_rtp *bundled_rtp;
 
@@ -4066,6 +5764,8 @@ static int ast_rtp_destroy(struct ast_rtp_instance *instance)
 
 	rtp_deallocate_transport(instance, rtp);
 
+	rtp_reactor_detach(rtp);
+
 	/* Destroy the smoother that was smoothing out audio if present */
 	if (rtp->smoother) {
 		ast_smoother_free(rtp->smoother);
@@ -4162,6 +5862,9 @@ static int ast_rtp_dtmf_begin(struct ast_rtp_instance *instance, char digit)
 		return -1;
 	}
 
+	/* The digit is interleaved with the stream so it can no longer bypass us */
+	kernel_relay_stop_peer(instance);
+
 	/* Grab the payload that they expect the RFC2833 packet to be received in */
 	payload = ast_rtp_codecs_payload_code_tx(ast_rtp_instance_get_codecs(instance), 0, NULL, AST_RTP_DTMF);
 
@@ -5025,6 +6728,7 @@ static int rtp_raw_write(struct ast_rtp_instance *instance, struct ast_frame *fr
 		int abs_send_time_id;
 		int packet_len;
 		unsigned char *rtpheader;
+		struct ast_rtp_rtcp_nack_payload *payload = NULL;
 
 		/* If the abs-send-time extension has been negotiated determine how much space we need */
 		abs_send_time_id = ast_rtp_instance_extmap_get_id(instance, AST_RTP_EXTENSION_ABS_SEND_TIME);
@@ -5035,7 +6739,27 @@ static int rtp_raw_write(struct ast_rtp_instance *instance, struct ast_frame *fr
 		}
 
 		packet_len = frame->datalen + hdrlen;
-		rtpheader = (unsigned char *)(frame->data.ptr - hdrlen);
+
+		/*
+		 * If retransmissions are enabled the packet is stored for future use, so build it
+		 * there and send it from there. The frame is then only read, which means it need
+		 * not have any headroom.
+		 */
+		if (rtp->send_buffer) {
+			payload = ast_malloc(sizeof(*payload) + packet_len);
+		}
+		if (payload) {
+			payload->size = packet_len;
+			rtpheader = payload->buf;
+			memcpy(rtpheader + hdrlen, frame->data.ptr, frame->datalen);
+		} else if (frame->offset < hdrlen) {
+			/* The frame was passed on as is because it was to be stored, but that failed */
+			ast_debug_rtp(1, "(%p) RTP unable to build packet %d without headroom\n",
+				instance, rtp->seqno);
+			goto next_seqno;
+		} else {
+			rtpheader = (unsigned char *)(frame->data.ptr - hdrlen);
+		}
 
 		put_unaligned_uint32(rtpheader, htonl((2 << 30) | (ext << 28) | (codec << 16) | (seqno) | (mark << 23)));
 		put_unaligned_uint32(rtpheader + 4, htonl(rtp->lastts));
@@ -5058,21 +6782,12 @@ static int rtp_raw_write(struct ast_rtp_instance *instance, struct ast_frame *fr
 			put_unaligned_time24(rtpheader + 17, now_msw, now_lsw);
 		}
 
-		/* If retransmissions are enabled, we need to store this packet for future use */
-		if (rtp->send_buffer) {
-			struct ast_rtp_rtcp_nack_payload *payload;
+		res = rtp_sendto(instance, (void *)rtpheader, packet_len, 0, &remote_address, &ice);
 
-			payload = ast_malloc(sizeof(*payload) + packet_len);
-			if (payload) {
-				payload->size = packet_len;
-				memcpy(payload->buf, rtpheader, packet_len);
-				if (ast_data_buffer_put(rtp->send_buffer, rtp->seqno, payload) == -1) {
-					ast_free(payload);
-				}
-			}
+		/* SRTP protects a copy, so what is stored remains in the clear */
+		if (payload && ast_data_buffer_put(rtp->send_buffer, rtp->seqno, payload) == -1) {
+			ast_free(payload);
 		}
-
-		res = rtp_sendto(instance, (void *)rtpheader, packet_len, 0, &remote_address, &ice);
 		if (res < 0) {
 			if (!ast_rtp_instance_get_prop(instance, AST_RTP_PROPERTY_NAT) || (ast_rtp_instance_get_prop(instance, AST_RTP_PROPERTY_NAT) && (ast_test_flag(rtp, FLAG_NAT_ACTIVE) == FLAG_NAT_ACTIVE))) {
 				ast_debug_rtp(1, "(%p) RTP transmission error of packet %d to %s: %s\n",
@@ -5106,6 +6821,7 @@ static int rtp_raw_write(struct ast_rtp_instance *instance, struct ast_frame *fr
 		}
 	}
 
+next_seqno:
 	/* If the sequence number that has been used doesn't match what we expected then this is an out of
 	 * order late packet, so we don't need to increment as we haven't yet gotten the expected frame from
 	 * the core.
@@ -5166,6 +6882,7 @@ static void rtp_write_rtcp_fir(struct ast_rtp_instance *instance, struct ast_rtp
 	int ice;
 	int res;
 	int sr;
+	unsigned int layer;
 	RAII_VAR(struct ast_rtp_rtcp_report *, rtcp_report,
 		ast_rtp_rtcp_report_alloc(rtp->themssrc_valid ? 1 : 0),
 		ao2_cleanup);
@@ -5204,6 +6921,13 @@ static void rtp_write_rtcp_fir(struct ast_rtp_instance *instance, struct ast_rtp
 
 	packet_len += res;
 
+	/* Every simulcast layer gets an FCI entry of its own, so a receiver can switch to any of them */
+	for (layer = 1; layer < rtp->simulcast_layers; layer++) {
+		put_unaligned_uint32(rtcpheader + packet_len + fir_len, htonl(rtp->simulcast_ssrcs[layer])); /* FCI: SSRC */
+		put_unaligned_uint32(rtcpheader + packet_len + fir_len + 4, htonl(rtp->rtcp->firseq << 24)); /* FCI: Sequence number */
+		fir_len += 8;
+	}
+
 	put_unaligned_uint32(rtcpheader + packet_len + 0, htonl((2 << 30) | (4 << 24) | (RTCP_PT_PSFB << 16) | ((fir_len/4)-1)));
 	put_unaligned_uint32(rtcpheader + packet_len + 4, htonl(rtp->ssrc));
 	put_unaligned_uint32(rtcpheader + packet_len + 8, htonl(rtp->themssrc));
@@ -5393,7 +7117,11 @@ static int ast_rtp_write(struct ast_rtp_instance *instance, struct ast_frame *fr
 		int hdrlen = 12;
 		struct ast_frame *f = NULL;
 
-		if (frame->offset < hdrlen) {
+		/*
+		 * The header is written in front of the data unless the packet is built in the
+		 * retransmission buffer, which spares copying shared video payloads twice.
+		 */
+		if (frame->offset < hdrlen && !rtp->send_buffer) {
 			f = ast_frdup(frame);
 		} else {
 			f = frame;
@@ -5865,6 +7593,24 @@ static void update_lost_stats(struct ast_rtp *rtp, unsigned int lost_packets)
 		&rtp->rtcp->reported_stdev_lost, &rtp->rtcp->reported_lost_count);
 }
 
+/*!
+ * \internal
+ * \brief Determine which simulcast layer an SSRC they send belongs to
+ *
+ * \retval 0 for the lowest layer and for anything that is not simulcast
+ */
+static unsigned int rtp_simulcast_layer(struct ast_rtp *rtp, unsigned int ssrc)
+{
+	unsigned int layer;
+
+	for (layer = 1; layer < rtp->simulcast_layers; layer++) {
+		if (rtp->simulcast_ssrcs[layer] == ssrc) {
+			return layer;
+		}
+	}
+	return 0;
+}
+
 /*! \pre instance is locked */
 static struct ast_rtp_instance *__rtp_find_instance_by_ssrc(struct ast_rtp_instance *instance,
 	struct ast_rtp *rtp, unsigned int ssrc, int source)
@@ -5886,6 +7632,20 @@ static struct ast_rtp_instance *__rtp_find_instance_by_ssrc(struct ast_rtp_insta
 		}
 	}
 
+	/* Upper simulcast layers arrive on the instance of the lowest one */
+	if (!source) {
+		for (index = 0; index < AST_VECTOR_SIZE(&rtp->ssrc_mapping); ++index) {
+			struct rtp_ssrc_mapping *mapping = AST_VECTOR_GET_ADDR(&rtp->ssrc_mapping, index);
+
+			if (rtp_simulcast_layer(ast_rtp_instance_get_data(mapping->instance), ssrc)) {
+				return mapping->instance;
+			}
+		}
+		if (rtp_simulcast_layer(rtp, ssrc)) {
+			return instance;
+		}
+	}
+
 	/* Does the SSRC match the bundled parent? */
 	if (rtp->themssrc_valid && rtp->themssrc == ssrc) {
 		return instance;
@@ -5959,16 +7719,52 @@ static const char *rtcp_payload_subtype2str(unsigned int pt, unsigned int subtyp
 	return NULL;
 }
 
+/*!
+ * \internal
+ * \brief Retransmit a packet held in the send buffer
+ *
+ * The packet is queued on the transmit batch when possible so every packet
+ * asked for by one NACK goes out, and is protected, together.
+ *
+ * \pre instance is locked
+ *
+ * \retval -1 if the packet is no longer in the send buffer
+ * \return the length of the packet otherwise
+ */
+static int rtp_retransmit(struct ast_rtp_instance *instance, struct ast_rtp *rtp, unsigned int seqno,
+	int abs_send_time_id, unsigned int now_msw, unsigned int now_lsw, struct ast_sockaddr *remote_address)
+{
+	struct ast_rtp_rtcp_nack_payload *payload;
+	int ice;
+
+	payload = (struct ast_rtp_rtcp_nack_payload *)ast_data_buffer_get(rtp->send_buffer, seqno);
+	if (!payload) {
+		return -1;
+	}
+
+	if (abs_send_time_id != -1) {
+		/* On retransmission we need to update the timestamp within the packet, as it
+		 * is supposed to contain when the packet was actually sent.
+		 */
+		put_unaligned_time24(payload->buf + 17, now_msw, now_lsw);
+	}
+
+	if (!rtp_sendto_batched(instance, payload->buf, payload->size, remote_address)) {
+		return payload->size;
+	}
+
+	return rtp_sendto(instance, payload->buf, payload->size, 0, remote_address, &ice);
+}
+
 /*! \pre instance is locked */
 static int ast_rtp_rtcp_handle_nack(struct ast_rtp_instance *instance, unsigned int *nackdata, unsigned int position,
 	unsigned int length)
 {
 	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
 	int res = 0;
+	int sent;
 	int blp_index;
 	int packet_index;
-	int ice;
-	struct ast_rtp_rtcp_nack_payload *payload;
 	unsigned int current_word;
 	unsigned int pid;	/* Packet ID which refers to seqno of lost packet */
 	unsigned int blp;	/* Bitmask of following lost packets */
@@ -5999,15 +7795,9 @@ static int ast_rtp_rtcp_handle_nack(struct ast_rtp_instance *instance, unsigned
 		current_word = ntohl(nackdata[position + packet_index]);
 		pid = current_word >> 16;
 		/* We know the remote end is missing this packet. Go ahead and send it if we still have it. */
-		payload = (struct ast_rtp_rtcp_nack_payload *)ast_data_buffer_get(rtp->send_buffer, pid);
-		if (payload) {
-			if (abs_send_time_id != -1) {
-				/* On retransmission we need to update the timestamp within the packet, as it
-				 * is supposed to contain when the packet was actually sent.
-				 */
-				put_unaligned_time24(payload->buf + 17, now_msw, now_lsw);
-			}
-			res += rtp_sendto(instance, payload->buf, payload->size, 0, &remote_address, &ice);
+		sent = rtp_retransmit(instance, rtp, pid, abs_send_time_id, now_msw, now_lsw, &remote_address);
+		if (sent != -1) {
+			res += sent;
 		} else {
 			ast_debug_rtcp(1, "(%p) RTCP received NACK request for RTP packet with seqno %d, "
 				"but we don't have it\n", instance, pid);
@@ -6025,12 +7815,11 @@ static int ast_rtp_rtcp_handle_nack(struct ast_rtp_instance *instance, unsigned
 			if (blp & 1) {
 				/* Packet (pid + i)(modulo 2^16) is missing too. */
 				unsigned int seqno = (pid + blp_index) % 65536;
-				payload = (struct ast_rtp_rtcp_nack_payload *)ast_data_buffer_get(rtp->send_buffer, seqno);
-				if (payload) {
-					if (abs_send_time_id != -1) {
-						put_unaligned_time24(payload->buf + 17, now_msw, now_lsw);
-					}
-					res += rtp_sendto(instance, payload->buf, payload->size, 0, &remote_address, &ice);
+
+				sent = rtp_retransmit(instance, rtp, seqno, abs_send_time_id, now_msw, now_lsw,
+					&remote_address);
+				if (sent != -1) {
+					res += sent;
 				} else {
 					ast_debug_rtcp(1, "(%p) RTCP remote end also requested RTP packet with seqno %d, "
 						"but we don't have it\n", instance, seqno);
@@ -6042,6 +7831,9 @@ static int ast_rtp_rtcp_handle_nack(struct ast_rtp_instance *instance, unsigned
 		}
 	}
 
+	/* Send whatever was queued above in one go */
+	rtp_tx_batch_flush(instance, rtp);
+
 	if (packets_not_found) {
 		/* Grow the send buffer based on how many packets were not found in the buffer, but
 		 * enforce a maximum.
@@ -6656,6 +8448,7 @@ static int bridge_p2p_rtp_write(struct ast_rtp_instance *instance,
 	int reconstruct = ntohl(rtpheader[0]);
 	struct ast_sockaddr remote_address = { {0,} };
 	int ice;
+	int deferred = 0;
 	unsigned int timestamp = ntohl(rtpheader[1]);
 
 	/* Get fields from packet */
@@ -6779,8 +8572,18 @@ static int bridge_p2p_rtp_write(struct ast_rtp_instance *instance,
 		bridged->ssrc = ntohl(rtpheader[2]);
 	}
 
-	/* Send the packet back out */
-	res = rtp_sendto(instance1, (void *)rtpheader, len, 0, &remote_address, &ice);
+	/*
+	 * If more packets of the same batch are waiting to be relayed send
+	 * them all together once we are through it.
+	 */
+	if (RTP_RX_BATCH_PENDING(rtp) && (!rtp->tx_peer || rtp->tx_peer == instance1)
+		&& !rtp_sendto_batched(instance1, (void *)rtpheader, len, &remote_address)) {
+		deferred = 1;
+		res = len;
+		ice = 0;
+	} else {
+		res = rtp_sendto(instance1, (void *)rtpheader, len, 0, &remote_address, &ice);
+	}
 	if (res < 0) {
 		if (!ast_rtp_instance_get_prop(instance1, AST_RTP_PROPERTY_NAT) || (ast_rtp_instance_get_prop(instance1, AST_RTP_PROPERTY_NAT) && (ast_test_flag(bridged, FLAG_NAT_ACTIVE) == FLAG_NAT_ACTIVE))) {
 			ast_log(LOG_WARNING,
@@ -6811,6 +8614,9 @@ static int bridge_p2p_rtp_write(struct ast_rtp_instance *instance,
 
 	ao2_unlock(instance1);
 	ao2_lock(instance);
+	if (deferred && !rtp->tx_peer) {
+		rtp->tx_peer = ao2_bump(instance1);
+	}
 	return 0;
 }
 
@@ -7206,6 +9012,7 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 	struct ast_rtp_instance *instance1;
 	int res = length, hdrlen = 12, ssrc, seqno, payloadtype, padding, mark, ext, cc;
 	unsigned int timestamp;
+	unsigned int layer;
 	RAII_VAR(struct ast_rtp_payload_type *, payload, NULL, ao2_cleanup);
 	struct frame_list frames;
 
@@ -7230,6 +9037,7 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 	cc = (seqno & 0xF000000) >> 24;
 	seqno &= 0xffff;
 	timestamp = ntohl(rtpheader[1]);
+	layer = rtp_simulcast_layer(rtp, ssrc);
 
 	AST_LIST_HEAD_INIT_NOLOCK(&frames);
 
@@ -7271,8 +9079,10 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 		return AST_LIST_FIRST(&frames) ? AST_LIST_FIRST(&frames) : &ast_null_frame;
 	}
 
-	/* Only non-bundled instances can change/learn the remote's SSRC implicitly. */
-	if (!bundled) {
+	/* Only non-bundled instances can change/learn the remote's SSRC implicitly. Upper
+	 * simulcast layers are not a change of SSRC.
+	 */
+	if (!bundled && !layer) {
 		/* Force a marker bit and change SSRC if the SSRC changes */
 		if (rtp->themssrc_valid && rtp->themssrc != ssrc) {
 			struct ast_frame *f, srcupdate = {
@@ -7308,10 +9118,13 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 		rtp->themssrc_valid = 1;
 	}
 
-	rtp->rxcount++;
-	rtp->rxoctetcount += (res - hdrlen);
-	if (rtp->rxcount == 1) {
-		rtp->seedrxseqno = seqno;
+	/* Reception statistics, and so RTCP, only cover the lowest simulcast layer */
+	if (!layer) {
+		rtp->rxcount++;
+		rtp->rxoctetcount += (res - hdrlen);
+		if (rtp->rxcount == 1) {
+			rtp->seedrxseqno = seqno;
+		}
 	}
 
 	/* Do not schedule RR if RTCP isn't run */
@@ -7332,6 +9145,10 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 	 * outgoing RTCP reflects it.
 	 */
 	instance1 = ast_rtp_instance_get_bridged(instance);
+	if (instance1) {
+		/* Reactor threads relay without the channel lock, keep the peer around */
+		ao2_ref(instance1, +1);
+	}
 	if (instance1
 		&& !bridge_p2p_rtp_write(instance, instance1, rtpheader, res, hdrlen)) {
 		struct timeval rxtime;
@@ -7345,8 +9162,12 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 			ast_frfree(f);
 		}
 
+		kernel_relay_start(instance, rtp, instance1);
+		ao2_ref(instance1, -1);
+
 		return &ast_null_frame;
 	}
+	ao2_cleanup(instance1);
 
 	payload = ast_rtp_codecs_get_payload(ast_rtp_instance_get_codecs(instance), payloadtype);
 	if (!payload) {
@@ -7417,6 +9238,7 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 	}
 
 	rtp->f.src = "RTP";
+	rtp->f.ingress = ast_tvnow();
 	rtp->f.mallocd = 0;
 	rtp->f.datalen = res - hdrlen;
 	rtp->f.data.ptr = read_area + hdrlen;
@@ -7424,6 +9246,7 @@ static struct ast_frame *ast_rtp_interpret(struct ast_rtp_instance *instance, st
 	ast_set_flag(&rtp->f, AST_FRFLAG_HAS_SEQUENCE_NUMBER);
 	rtp->f.seqno = seqno;
 	rtp->f.stream_num = rtp->stream_num;
+	rtp->f.subclass.layer = layer;
 
 	if ((ast_format_cmp(rtp->f.subclass.format, ast_format_t140) == AST_FORMAT_CMP_EQUAL)
 		&& ((int)seqno - (prev_seqno + 1) > 0)
@@ -7635,7 +9458,7 @@ static int should_drop_packets(struct ast_sockaddr *addr)
 #endif
 
 /*! \pre instance is locked */
-static struct ast_frame *ast_rtp_read(struct ast_rtp_instance *instance, int rtcp)
+static struct ast_frame *rtp_read_packet(struct ast_rtp_instance *instance, int rtcp)
 {
 	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
 	struct ast_srtp *srtp;
@@ -7946,6 +9769,15 @@ static struct ast_frame *ast_rtp_read(struct ast_rtp_instance *instance, int rtc
 
 	bundled = (child || AST_VECTOR_SIZE(&rtp->ssrc_mapping)) ? 1 : 0;
 
+	if (rtp_simulcast_layer(rtp, ssrc)) {
+		/* Upper simulcast layers number their packets on their own, so they are kept out of
+		 * the sequence tracking and retransmission requests done for the lowest layer.
+		 */
+		frame = ast_rtp_interpret(instance, srtp, &addr, read_area, res, seqno, bundled);
+		AST_LIST_INSERT_TAIL(&frames, frame, frame_list);
+		return AST_LIST_FIRST(&frames);
+	}
+
 	prev_seqno = rtp->lastrxseqno;
 	rtp->lastrxseqno = seqno;
 
@@ -8299,6 +10131,248 @@ static struct ast_frame *ast_rtp_read(struct ast_rtp_instance *instance, int rtc
 	return &ast_null_frame;
 }
 
+/*!
+ * \internal
+ * \brief Append frames returned for one packet to the frames of a batch
+ *
+ * The frames are isolated since the next packet reuses the instance frame.
+ *
+ * \return The number of frames appended
+ */
+static unsigned int rtp_frame_list_append(struct frame_list *frames, struct ast_frame *frame)
+{
+	unsigned int count = 0;
+
+	while (frame) {
+		struct ast_frame *next = AST_LIST_NEXT(frame, frame_list);
+
+		if (frame != &ast_null_frame) {
+			AST_LIST_NEXT(frame, frame_list) = NULL;
+			if ((frame = ast_frisolate(frame))) {
+				AST_LIST_INSERT_TAIL(frames, frame, frame_list);
+				count++;
+			}
+		}
+		frame = next;
+	}
+
+	return count;
+}
+
+/*! \pre instance is locked */
+static struct ast_frame *rtp_read_socket(struct ast_rtp_instance *instance, int rtcp)
+{
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+	struct frame_list frames;
+	struct ast_frame *frame;
+
+	frame = rtp_read_packet(instance, rtcp);
+	if (rtcp || !RTP_RX_BATCH_PENDING(rtp)) {
+		rtp_tx_batch_flush_peer(instance, rtp);
+		return frame;
+	}
+
+	/*
+	 * The rest of the batch has already been taken off the socket so it
+	 * will not poll readable for them, process them all now.
+	 */
+	AST_LIST_HEAD_INIT_NOLOCK(&frames);
+	while (frame) {
+		rtp_frame_list_append(&frames, frame);
+		if (!RTP_RX_BATCH_PENDING(rtp)) {
+			break;
+		}
+		frame = rtp_read_packet(instance, 0);
+	}
+	rtp_tx_batch_flush_peer(instance, rtp);
+
+	if (!frame) {
+		/* A read error hangs the channel up, the remaining frames are of no use */
+		ast_frfree(AST_LIST_FIRST(&frames));
+		return NULL;
+	}
+
+	return AST_LIST_FIRST(&frames) ?: &ast_null_frame;
+}
+
+/*! \pre instance is locked */
+static struct ast_frame *ast_rtp_read(struct ast_rtp_instance *instance, int rtcp)
+{
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+	struct ast_frame *frame;
+
+	if (rtcp || !rtp->reactor_entry) {
+		return rtp_read_socket(instance, rtcp);
+	}
+
+	/* Hand over everything the reactor has read since the last call */
+	ast_alertpipe_read(rtp->reactor_alert);
+	if (rtp->reactor_error) {
+		return NULL;
+	}
+	frame = AST_LIST_FIRST(&rtp->reactor_frames);
+	AST_LIST_HEAD_INIT_NOLOCK(&rtp->reactor_frames);
+	rtp->reactor_queued = 0;
+
+	return frame ?: &ast_null_frame;
+}
+
+#ifdef HAVE_RTP_REACTOR
+/*!
+ * \internal
+ * \brief Read the socket of an instance on behalf of its channel
+ */
+static void rtp_reactor_service(struct rtp_reactor_entry *entry)
+{
+	struct ast_rtp_instance *instance;
+	struct ast_rtp *rtp;
+	struct ast_frame *frame;
+	int was_empty;
+
+	instance = ao2_weakproxy_get_object(entry, 0);
+	if (!instance) {
+		return;
+	}
+
+	ao2_lock(instance);
+	rtp = ast_rtp_instance_get_data(instance);
+	if (rtp->reactor_entry != entry || entry->fd < 0 || rtp->reactor_error) {
+		ao2_unlock(instance);
+		ao2_ref(instance, -1);
+		return;
+	}
+
+	was_empty = AST_LIST_EMPTY(&rtp->reactor_frames);
+	frame = rtp_read_socket(instance, 0);
+	if (!frame) {
+		/* Leave it to the channel to hang up, and stop waking up for the socket */
+		rtp->reactor_error = 1;
+		rtp_reactor_unregister(rtp);
+	} else {
+		ast_rtp_instance_set_last_rx(instance, time(NULL));
+		if (rtp->reactor_queued < RTP_REACTOR_QUEUE_MAX) {
+			rtp->reactor_queued += rtp_frame_list_append(&rtp->reactor_frames, frame);
+		} else if (frame != &ast_null_frame) {
+			ast_debug_rtp(1, "(%p) RTP reactor queue is full, dropping frame\n", instance);
+			if (frame != &rtp->f) {
+				ast_frfree(frame);
+			}
+		}
+	}
+
+	/* Natively bridged streams never produce frames, so their channels sleep on */
+	if (was_empty && (rtp->reactor_error || !AST_LIST_EMPTY(&rtp->reactor_frames))) {
+		ast_alertpipe_write(rtp->reactor_alert);
+	}
+
+	ao2_unlock(instance);
+	ao2_ref(instance, -1);
+}
+
+static void *rtp_reactor_thread(void *data)
+{
+	struct rtp_reactor *reactor = data;
+	struct epoll_event events[64];
+	struct rtp_reactor_entry *entry;
+	int count;
+	int i;
+
+	while (!reactors_stopping) {
+		count = epoll_wait(reactor->epfd, events, ARRAY_LEN(events), 1000);
+		for (i = 0; i < count; i++) {
+			rtp_reactor_service(events[i].data.ptr);
+		}
+
+		/* Retired entries can no longer be returned by epoll_wait */
+		ast_mutex_lock(&reactor->lock);
+		while ((entry = AST_LIST_REMOVE_HEAD(&reactor->retired, list))) {
+			ao2_ref(entry, -1);
+		}
+		ast_mutex_unlock(&reactor->lock);
+	}
+
+	return NULL;
+}
+#endif
+
+/*! \brief Stop every reactor thread */
+static void rtp_reactors_stop(void)
+{
+#ifdef HAVE_RTP_REACTOR
+	struct rtp_reactor_entry *entry;
+	unsigned int i;
+
+	if (!reactors) {
+		return;
+	}
+
+	reactors_stopping = 1;
+	for (i = 0; i < reactor_count; i++) {
+		pthread_join(reactors[i].thread, NULL);
+	}
+	for (i = 0; i < reactor_count; i++) {
+		while ((entry = AST_LIST_REMOVE_HEAD(&reactors[i].retired, list))) {
+			ao2_ref(entry, -1);
+		}
+		ast_mutex_destroy(&reactors[i].lock);
+		close(reactors[i].epfd);
+	}
+	ast_free(reactors);
+	reactors = NULL;
+	reactor_count = 0;
+	reactors_stopping = 0;
+#endif
+}
+
+/*!
+ * \brief Start the configured number of reactor threads
+ *
+ * \note Reactors are only started once, a changed thread count takes effect
+ * when the module is loaded again.
+ */
+static void rtp_reactors_start(void)
+{
+#ifdef HAVE_RTP_REACTOR
+	unsigned int i;
+
+	if (reactors || !reactor_threads) {
+		if (reactors && reactor_count != reactor_threads) {
+			ast_log(LOG_NOTICE, "RTP reactor thread count changes take effect when res_rtp_asterisk is loaded again\n");
+		}
+		return;
+	}
+
+	reactors = ast_calloc(reactor_threads, sizeof(*reactors));
+	if (!reactors) {
+		return;
+	}
+
+	for (i = 0; i < reactor_threads; i++) {
+		reactors[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (reactors[i].epfd < 0) {
+			ast_log(LOG_ERROR, "Unable to create RTP reactor: %s\n", strerror(errno));
+			break;
+		}
+		ast_mutex_init(&reactors[i].lock);
+		AST_LIST_HEAD_INIT_NOLOCK(&reactors[i].retired);
+		if (ast_pthread_create_background(&reactors[i].thread, NULL, rtp_reactor_thread, &reactors[i])) {
+			ast_log(LOG_ERROR, "Unable to start RTP reactor thread\n");
+			ast_mutex_destroy(&reactors[i].lock);
+			close(reactors[i].epfd);
+			break;
+		}
+	}
+	reactor_count = i;
+
+	if (!reactor_count) {
+		ast_free(reactors);
+		reactors = NULL;
+		return;
+	}
+	ast_verb(2, "Started %u RTP reactor threads\n", reactor_count);
+#endif
+}
+
 /*! \pre instance is locked */
 static void ast_rtp_prop_set(struct ast_rtp_instance *instance, enum ast_rtp_property property, int value)
 {
@@ -8490,6 +10564,15 @@ static int ast_rtp_fd(struct ast_rtp_instance *instance, int rtcp)
 {
 	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
 
+	/* When a reactor reads the socket the channel waits for the frames it queues */
+	if (rtp->reactor_entry) {
+		if (!rtcp) {
+			return ast_alertpipe_readfd(rtp->reactor_alert);
+		} else if (rtp->rtcp && rtp->rtcp->s == rtp->s) {
+			return -1;
+		}
+	}
+
 	return rtcp ? (rtp->rtcp ? rtp->rtcp->s : -1) : rtp->s;
 }
 
@@ -8500,6 +10583,10 @@ static void ast_rtp_remote_address_set(struct ast_rtp_instance *instance, struct
 	struct ast_sockaddr local;
 	int index;
 
+	/* Both directions of a relayed stream involve our remote address */
+	kernel_relay_stop(rtp);
+	kernel_relay_stop_peer(instance);
+
 	ast_rtp_instance_get_local_address(instance, &local);
 	if (!ast_sockaddr_isnull(addr)) {
 		/* Update the local RTP address with what is being used */
@@ -8645,6 +10732,7 @@ static int ast_rtp_local_bridge(struct ast_rtp_instance *instance0, struct ast_r
 	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance0);
 
 	ao2_lock(instance0);
+	kernel_relay_stop(rtp);
 	ast_set_flag(rtp, FLAG_NEED_MARKER_BIT | FLAG_REQ_LOCAL_BRIDGE_BIT);
 	if (rtp->smoother) {
 		ast_smoother_free(rtp->smoother);
@@ -8680,6 +10768,10 @@ static int ast_rtp_get_stat(struct ast_rtp_instance *instance, struct ast_rtp_in
 	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_RXCOUNT, -1, stats->rxcount, rtp->rxcount);
 	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_TXOCTETCOUNT, -1, stats->txoctetcount, rtp->txoctetcount);
 	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_RXOCTETCOUNT, -1, stats->rxoctetcount, rtp->rxoctetcount);
+	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_RXBATCHES, -1, stats->rxbatches, rtp->rxbatches);
+	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_RXBATCHCOUNT, -1, stats->rxbatchcount, rtp->rxbatchcount);
+	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_TXBATCHES, -1, stats->txbatches, rtp->txbatches);
+	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_TXBATCHCOUNT, -1, stats->txbatchcount, rtp->txbatchcount);
 
 	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_TXPLOSS, AST_RTP_INSTANCE_STAT_COMBINED_LOSS, stats->txploss, rtp->rtcp->reported_lost);
 	AST_RTP_STAT_SET(AST_RTP_INSTANCE_STAT_RXPLOSS, AST_RTP_INSTANCE_STAT_COMBINED_LOSS, stats->rxploss, rtp->rtcp->expected_prior - rtp->rtcp->received_prior);
@@ -8923,6 +11015,23 @@ static void ast_rtp_set_stream_num(struct ast_rtp_instance *instance, int stream
 	rtp->stream_num = stream_num;
 }
 
+/*! \pre instance is locked */
+static void ast_rtp_set_simulcast_ssrcs(struct ast_rtp_instance *instance, const unsigned int *ssrcs, unsigned int count)
+{
+	struct ast_rtp *rtp = ast_rtp_instance_get_data(instance);
+
+	if (count < 2) {
+		rtp->simulcast_layers = 0;
+		return;
+	}
+
+	/* The lowest layer is received as any other stream would be */
+	ast_rtp_set_remote_ssrc(instance, ssrcs[0]);
+
+	memcpy(rtp->simulcast_ssrcs, ssrcs, count * sizeof(*ssrcs));
+	rtp->simulcast_layers = count;
+}
+
 static int ast_rtp_extension_enable(struct ast_rtp_instance *instance, enum ast_rtp_extension extension)
 {
 	switch (extension) {
@@ -9124,6 +11233,9 @@ static char *handle_cli_rtp_settings(struct ast_cli_entry *e, int cmd, struct as
 	ast_cli(a->fd, "----------------\n");
 	ast_cli(a->fd, "  Port start:      %d\n", rtpstart);
 	ast_cli(a->fd, "  Port end:        %d\n", rtpend);
+	ast_mutex_lock(&rtp_ports_lock);
+	ast_cli(a->fd, "  Ports free:      %u of %u\n", rtp_ports_count, rtp_ports_size);
+	ast_mutex_unlock(&rtp_ports_lock);
 #ifdef SO_NO_CHECK
 	ast_cli(a->fd, "  Checksums:       %s\n", AST_CLI_YESNO(nochecksums == 0));
 #endif
@@ -9135,6 +11247,9 @@ static char *handle_cli_rtp_settings(struct ast_cli_entry *e, int cmd, struct as
 	}
 
 	ast_cli(a->fd, "  Replay Protect:  %s\n", AST_CLI_YESNO(srtp_replay_protection));
+	ast_cli(a->fd, "  I/O batch:       %d\n", io_batch);
+	ast_cli(a->fd, "  Kernel relay:    %s\n", kernel_relay ? (kernel_relay_ready ? "Active" : "Unavailable") : "No");
+	ast_cli(a->fd, "  Reactor threads: %u\n", reactor_count);
 #ifdef HAVE_PJPROJECT
 	ast_cli(a->fd, "  ICE support:     %s\n", AST_CLI_YESNO(icesupport));
 #endif
@@ -9372,6 +11487,9 @@ static int rtp_reload(int reload, int by_external_config)
 	learning_min_sequential = DEFAULT_LEARNING_MIN_SEQUENTIAL;
 	learning_min_duration = DEFAULT_LEARNING_MIN_DURATION;
 	srtp_replay_protection = DEFAULT_SRTP_REPLAY_PROTECTION;
+	kernel_relay = DEFAULT_KERNEL_RELAY;
+	io_batch = DEFAULT_IO_BATCH;
+	reactor_threads = DEFAULT_REACTOR_THREADS;
 
 	/** This resource is not "reloaded" so much as unloaded and loaded again.
 	 * In the case of the TURN related variables, the memory referenced by a
@@ -9390,10 +11508,13 @@ static int rtp_reload(int reload, int by_external_config)
 	turnusername = pj_str(NULL);
 	turnpassword = pj_str(NULL);
 	host_candidate_overrides_clear();
+	ice_candidate_cache = DEFAULT_ICE_CANDIDATE_CACHE;
+	ice_cache_flush();
 #endif
 
 #if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP)
 	dtls_mtu = DEFAULT_DTLS_MTU;
+	dtls_offload_threads = DEFAULT_DTLS_OFFLOAD_THREADS;
 #endif
 
 	if ((s = ast_variable_retrieve(cfg, "general", "rtpstart"))) {
@@ -9455,6 +11576,35 @@ static int rtp_reload(int reload, int by_external_config)
 	if ((s = ast_variable_retrieve(cfg, "general", "srtpreplayprotection"))) {
 		srtp_replay_protection = ast_true(s);
 	}
+	if ((s = ast_variable_retrieve(cfg, "general", "io_batch"))) {
+		if ((sscanf(s, "%d", &io_batch) != 1) || io_batch < 1 || io_batch > RTP_IO_BATCH_MAX) {
+			ast_log(LOG_WARNING, "Value for 'io_batch' could not be read or is not between 1 and %d, using default of '%d' instead\n",
+				RTP_IO_BATCH_MAX, DEFAULT_IO_BATCH);
+			io_batch = DEFAULT_IO_BATCH;
+		}
+#ifndef HAVE_RTP_IO_BATCH
+		if (io_batch > 1) {
+			ast_log(LOG_WARNING, "Batched RTP I/O is not supported on this platform, ignoring 'io_batch'\n");
+			io_batch = 1;
+		}
+#endif
+	}
+	if ((s = ast_variable_retrieve(cfg, "general", "kernel_relay"))) {
+		kernel_relay = ast_true(s);
+	}
+	if ((s = ast_variable_retrieve(cfg, "general", "reactor_threads"))) {
+		if ((sscanf(s, "%u", &reactor_threads) != 1) || reactor_threads > RTP_REACTOR_THREADS_MAX) {
+			ast_log(LOG_WARNING, "Value for 'reactor_threads' could not be read or is greater than %d, using default of '%d' instead\n",
+				RTP_REACTOR_THREADS_MAX, DEFAULT_REACTOR_THREADS);
+			reactor_threads = DEFAULT_REACTOR_THREADS;
+		}
+#ifndef HAVE_RTP_REACTOR
+		if (reactor_threads) {
+			ast_log(LOG_WARNING, "RTP reactor threads are not supported on this platform, ignoring 'reactor_threads'\n");
+			reactor_threads = 0;
+		}
+#endif
+	}
 #ifdef HAVE_PJPROJECT
 	if ((s = ast_variable_retrieve(cfg, "general", "icesupport"))) {
 		icesupport = ast_true(s);
@@ -9462,6 +11612,13 @@ static int rtp_reload(int reload, int by_external_config)
 	if ((s = ast_variable_retrieve(cfg, "general", "stun_software_attribute"))) {
 		stun_software_attribute = ast_true(s);
 	}
+	if ((s = ast_variable_retrieve(cfg, "general", "ice_candidate_cache"))) {
+		if ((sscanf(s, "%d", &ice_candidate_cache) != 1) || ice_candidate_cache < 0) {
+			ast_log(LOG_WARNING, "Value for 'ice_candidate_cache' could not be read, using default of '%d' instead\n",
+				DEFAULT_ICE_CANDIDATE_CACHE);
+			ice_candidate_cache = DEFAULT_ICE_CANDIDATE_CACHE;
+		}
+	}
 	if ((s = ast_variable_retrieve(cfg, "general", "stunaddr"))) {
 		stunaddr.sin_port = htons(STANDARD_STUN_PORT);
 		if (ast_parse_arg(s, PARSE_INADDR, &stunaddr)) {
@@ -9576,6 +11733,13 @@ static int rtp_reload(int reload, int by_external_config)
 			dtls_mtu = DEFAULT_DTLS_MTU;
 		}
 	}
+	if ((s = ast_variable_retrieve(cfg, "general", "dtls_offload_threads"))) {
+		if ((sscanf(s, "%u", &dtls_offload_threads) != 1) || dtls_offload_threads > DTLS_OFFLOAD_THREADS_MAX) {
+			ast_log(LOG_WARNING, "Value for 'dtls_offload_threads' could not be read or is greater than %d, using default of '%d' instead\n",
+				DTLS_OFFLOAD_THREADS_MAX, DEFAULT_DTLS_OFFLOAD_THREADS);
+			dtls_offload_threads = DEFAULT_DTLS_OFFLOAD_THREADS;
+		}
+	}
 #endif
 
 	ast_config_destroy(cfg);
@@ -9586,6 +11750,13 @@ static int rtp_reload(int reload, int by_external_config)
 		rtpend = DEFAULT_RTP_END;
 	}
 	ast_verb(2, "RTP Allocating from port range %d -> %d\n", rtpstart, rtpend);
+	rtp_ports_build();
+
+	if (kernel_relay_tps && ast_taskprocessor_push(kernel_relay_tps, kernel_relay_configure, NULL)) {
+		ast_log(LOG_WARNING, "Unable to queue kernel relay configuration\n");
+	}
+	rtp_reactors_start();
+	dtls_offload_start();
 	return 0;
 }
 
@@ -9701,6 +11872,18 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	kernel_relay_tps = ast_taskprocessor_get("rtp/kernel_relay", TPS_REF_DEFAULT);
+	if (!kernel_relay_tps) {
+		ast_log(LOG_WARNING, "Unable to create kernel relay taskprocessor, kernel_relay will not be available\n");
+	}
+
+#ifdef HAVE_PJPROJECT
+	ice_cache_tps = ast_taskprocessor_get("rtp/ice_cache", TPS_REF_DEFAULT);
+	if (!ice_cache_tps) {
+		ast_log(LOG_WARNING, "Unable to create ICE cache taskprocessor, cached addresses will not be refreshed\n");
+	}
+#endif
+
 	rtp_reload(0, 0);
 
 	return AST_MODULE_LOAD_SUCCESS;
@@ -9711,6 +11894,19 @@ static int unload_module(void)
 	ast_rtp_engine_unregister(&asterisk_rtp_engine);
 	ast_cli_unregister_multiple(cli_rtp, ARRAY_LEN(cli_rtp));
 
+	kernel_relay_tps = ast_taskprocessor_unreference(kernel_relay_tps);
+	if (kernel_relay_ready) {
+		kernel_relay_table_destroy();
+	}
+	rtp_reactors_stop();
+	dtls_offload_stop();
+
+	ast_mutex_lock(&rtp_ports_lock);
+	ast_free(rtp_ports_free);
+	rtp_ports_free = NULL;
+	rtp_ports_size = rtp_ports_count = 0;
+	ast_mutex_unlock(&rtp_ports_lock);
+
 #if defined(HAVE_OPENSSL) && (OPENSSL_VERSION_NUMBER >= 0x10001000L) && !defined(OPENSSL_NO_SRTP) && defined(HAVE_OPENSSL_BIO_METHOD)
 	if (dtls_bio_methods) {
 		BIO_meth_free(dtls_bio_methods);
@@ -9719,6 +11915,8 @@ static int unload_module(void)
 
 #ifdef HAVE_PJPROJECT
 	host_candidate_overrides_clear();
+	ice_cache_tps = ast_taskprocessor_unreference(ice_cache_tps);
+	ice_cache_flush();
 	pj_thread_register_check();
 	rtp_terminate_pjproject();
 
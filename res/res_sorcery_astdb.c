@@ -45,6 +45,7 @@ static void sorcery_astdb_retrieve_multiple(const struct ast_sorcery *sorcery, v
 					     const struct ast_variable *fields);
 static void sorcery_astdb_retrieve_regex(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const char *regex);
 static void sorcery_astdb_retrieve_prefix(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const char *prefix, const size_t prefix_len);
+static void sorcery_astdb_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, struct ao2_container *ids);
 static int sorcery_astdb_update(const struct ast_sorcery *sorcery, void *data, void *object);
 static int sorcery_astdb_delete(const struct ast_sorcery *sorcery, void *data, void *object);
 static void sorcery_astdb_close(void *data);
@@ -58,6 +59,7 @@ static struct ast_sorcery_wizard astdb_object_wizard = {
 	.retrieve_multiple = sorcery_astdb_retrieve_multiple,
 	.retrieve_regex = sorcery_astdb_retrieve_regex,
 	.retrieve_prefix = sorcery_astdb_retrieve_prefix,
+	.retrieve_ids = sorcery_astdb_retrieve_ids,
 	.update = sorcery_astdb_update,
 	.delete = sorcery_astdb_delete,
 	.close = sorcery_astdb_close,
@@ -365,6 +367,107 @@ static void sorcery_astdb_retrieve_prefix(const struct ast_sorcery *sorcery, voi
 	}
 }
 
+/*!
+ * \internal
+ * \brief Determine the prefix shared by all of the given ids
+ *
+ * \param ids The ids
+ * \param prefix Set to the start of the shared prefix, valid as long as ids is
+ *
+ * \return The length of the shared prefix
+ */
+static size_t sorcery_astdb_ids_prefix(struct ao2_container *ids, const char **prefix)
+{
+	struct ao2_iterator i;
+	char *id;
+	size_t prefix_len = 0;
+
+	*prefix = NULL;
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref(id, -1)) {
+		if (!*prefix) {
+			*prefix = id;
+			prefix_len = strlen(id);
+		} else {
+			size_t len = 0;
+
+			while (len < prefix_len && id[len] == (*prefix)[len]) {
+				++len;
+			}
+			prefix_len = len;
+		}
+	}
+	ao2_iterator_destroy(&i);
+
+	return prefix_len;
+}
+
+static void sorcery_astdb_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, struct ao2_container *ids)
+{
+	const char *family_prefix = data;
+	size_t family_len = strlen(family_prefix) + strlen(type) + 1; /* +1 for slash delimiter */
+	char family[family_len + 1];
+	RAII_VAR(struct ast_db_entry *, entries, NULL, ast_db_freetree);
+	struct ast_db_entry *entry;
+	struct ao2_iterator i;
+	const char *prefix;
+	size_t prefix_len;
+	char *id;
+
+	/*
+	 * When the ids share a prefix all of them are read from astDB in a single query
+	 * on it, and any other entries are discarded.
+	 */
+	prefix_len = sorcery_astdb_ids_prefix(ids, &prefix);
+	if (ao2_container_count(ids) > 1 && prefix_len) {
+		char tree[prefix_len + 1];
+
+		snprintf(tree, sizeof(tree), "%.*s", (int) prefix_len, prefix);
+		snprintf(family, sizeof(family), "%s/%s", family_prefix, type);
+
+		if (!(entries = ast_db_gettree_by_prefix(family, tree))) {
+			return;
+		}
+
+		for (entry = entries; entry; entry = entry->next) {
+			/* The key in the entry includes the family, so we need to strip it out */
+			const char *key = entry->key + family_len + 2;
+			RAII_VAR(char *, requested, ao2_find(ids, key, OBJ_SEARCH_KEY), ao2_cleanup);
+			RAII_VAR(struct ast_json *, json, NULL, ast_json_unref);
+			struct ast_json_error error;
+			RAII_VAR(void *, object, NULL, ao2_cleanup);
+			RAII_VAR(struct ast_variable *, objset, NULL, ast_variables_destroy);
+
+			if (!requested) {
+				continue;
+			} else if (!(json = ast_json_load_string(entry->data, &error))
+				|| (ast_json_to_ast_variables(json, &objset) != AST_JSON_TO_AST_VARS_CODE_SUCCESS)
+				|| !(objset = sorcery_astdb_filter_objectset(objset, sorcery, type))
+				|| !(object = ast_sorcery_alloc(sorcery, type, key))
+				|| ast_sorcery_objectset_apply(sorcery, object, objset)) {
+				ast_debug(3, "Failed to retrieve object '%s' from astdb\n", key);
+				continue;
+			}
+
+			ao2_link(objects, object);
+		}
+
+		return;
+	}
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref(id, -1)) {
+		void *object = sorcery_astdb_retrieve_id(sorcery, data, type, id);
+
+		if (object) {
+			ao2_link(objects, object);
+			ao2_ref(object, -1);
+		}
+	}
+	ao2_iterator_destroy(&i);
+}
+
 static int sorcery_astdb_update(const struct ast_sorcery *sorcery, void *data, void *object)
 {
 	const char *prefix = data;
@@ -44,8 +44,8 @@ struct sorcery_config {
 	/*! \brief UUID for identifying us when opening a configuration file */
 	char uuid[AST_UUID_STR_LEN];
 
-	/*! \brief Objects retrieved from the configuration file */
-	struct ao2_global_obj objects;
+	/*! \brief Objects retrieved from the configuration file, replaced as a whole on reload */
+	struct ao2_rcu_obj objects;
 
 	/*! \brief Any specific variable criteria for considering a defined category for this object */
 	struct ast_variable *criteria;
@@ -123,8 +123,8 @@ static void sorcery_config_destructor(void *obj)
 {
 	struct sorcery_config *config = obj;
 
-	ao2_global_obj_release(config->objects);
-	ast_rwlock_destroy(&config->objects.lock);
+	ao2_rcu_obj_release(config->objects);
+	ast_mutex_destroy(&config->objects.lock);
 	ast_variables_destroy(config->criteria);
 	ast_free(config->explicit_name);
 }
@@ -170,7 +170,7 @@ static int sorcery_config_fields_cmp(void *obj, void *arg, int flags)
 static void *sorcery_config_retrieve_fields(const struct ast_sorcery *sorcery, void *data, const char *type, const struct ast_variable *fields)
 {
 	struct sorcery_config *config = data;
-	RAII_VAR(struct ao2_container *, objects, ao2_global_obj_ref(config->objects), ao2_cleanup);
+	RAII_VAR(struct ao2_container *, objects, ao2_rcu_obj_ref(config->objects), ao2_cleanup);
 	struct sorcery_config_fields_cmp_params params = {
 		.sorcery = sorcery,
 		.fields = fields,
@@ -188,15 +188,14 @@ static void *sorcery_config_retrieve_fields(const struct ast_sorcery *sorcery, v
 static void *sorcery_config_retrieve_id(const struct ast_sorcery *sorcery, void *data, const char *type, const char *id)
 {
 	struct sorcery_config *config = data;
-	RAII_VAR(struct ao2_container *, objects, ao2_global_obj_ref(config->objects), ao2_cleanup);
 
-	return objects ? ao2_find(objects, id, OBJ_SEARCH_KEY) : NULL;
+	return ao2_rcu_obj_find(config->objects, id, OBJ_SEARCH_KEY);
 }
 
 static void sorcery_config_retrieve_multiple(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const struct ast_variable *fields)
 {
 	struct sorcery_config *config = data;
-	RAII_VAR(struct ao2_container *, config_objects, ao2_global_obj_ref(config->objects), ao2_cleanup);
+	RAII_VAR(struct ao2_container *, config_objects, ao2_rcu_obj_ref(config->objects), ao2_cleanup);
 	struct sorcery_config_fields_cmp_params params = {
 		.sorcery = sorcery,
 		.fields = fields,
@@ -213,7 +212,7 @@ static void sorcery_config_retrieve_multiple(const struct ast_sorcery *sorcery,
 static void sorcery_config_retrieve_regex(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const char *regex)
 {
 	struct sorcery_config *config = data;
-	RAII_VAR(struct ao2_container *, config_objects, ao2_global_obj_ref(config->objects), ao2_cleanup);
+	RAII_VAR(struct ao2_container *, config_objects, ao2_rcu_obj_ref(config->objects), ao2_cleanup);
 	regex_t expression;
 	struct sorcery_config_fields_cmp_params params = {
 		.sorcery = sorcery,
@@ -236,7 +235,7 @@ static void sorcery_config_retrieve_regex(const struct ast_sorcery *sorcery, voi
 static void sorcery_config_retrieve_prefix(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const char *prefix, const size_t prefix_len)
 {
 	struct sorcery_config *config = data;
-	RAII_VAR(struct ao2_container *, config_objects, ao2_global_obj_ref(config->objects), ao2_cleanup);
+	RAII_VAR(struct ao2_container *, config_objects, ao2_rcu_obj_ref(config->objects), ao2_cleanup);
 	struct sorcery_config_fields_cmp_params params = {
 		.sorcery = sorcery,
 		.container = objects,
@@ -443,7 +442,7 @@ static void sorcery_config_internal_load(void *data, const struct ast_sorcery *s
 	}
 
 	config->has_dynamic_contents = has_dynamic_contents;
-	ao2_global_obj_replace_unref(config->objects, objects);
+	ao2_rcu_obj_replace_unref(config->objects, objects);
 	ast_config_destroy(cfg);
 }
 
@@ -477,7 +476,7 @@ static void *sorcery_config_open(const char *data)
 
 	ast_uuid_generate_str(config->uuid, sizeof(config->uuid));
 
-	ast_rwlock_init(&config->objects.lock);
+	ast_mutex_init(&config->objects.lock);
 	strcpy(config->filename, filename);
 
 	while ((option = strsep(&tmp, ","))) {
@@ -141,6 +141,14 @@ struct sorcery_memory_cache {
 	unsigned int full_backend_cache;
 	/*! \brief Heap of cached objects. Oldest object is at the top. */
 	struct ast_heap *object_heap;
+	/*! \brief Whether objects are evicted using CLOCK (second chance) instead of by age */
+	unsigned int clock_eviction;
+	/*! \brief Ring of cached objects swept by the CLOCK hand, maximum_objects in size */
+	struct sorcery_memory_cached_object **clock;
+	/*! \brief Number of slots in the ring that have been used so far */
+	unsigned int clock_used;
+	/*! \brief Position of the CLOCK hand within the ring */
+	unsigned int clock_hand;
 	/*! \brief Scheduler item for expiring oldest object. */
 	int expire_id;
 	/*! \brief scheduler id of stale update task */
@@ -171,6 +179,10 @@ struct sorcery_memory_cached_object {
 	struct timeval created;
 	/*! \brief index required by heap */
 	ssize_t __heap_index;
+	/*! \brief Set when the object is retrieved, cleared when the CLOCK hand passes it */
+	unsigned int referenced;
+	/*! \brief Slot of the object in the CLOCK ring */
+	unsigned int clock_slot;
 	/*! \brief scheduler id of stale update task */
 	int stale_update_sched_id;
 	/*! \brief Cached objectset for field and regex retrieval */
@@ -209,6 +221,8 @@ static void sorcery_memory_cache_retrieve_regex(const struct ast_sorcery *sorcer
 	struct ao2_container *objects, const char *regex);
 static void sorcery_memory_cache_retrieve_prefix(const struct ast_sorcery *sorcery, void *data, const char *type,
 	struct ao2_container *objects, const char *prefix, const size_t prefix_len);
+static void sorcery_memory_cache_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type,
+	struct ao2_container *objects, struct ao2_container *ids);
 static int sorcery_memory_cache_delete(const struct ast_sorcery *sorcery, void *data, void *object);
 static void sorcery_memory_cache_close(void *data);
 
@@ -225,6 +239,7 @@ static struct ast_sorcery_wizard memory_cache_object_wizard = {
 	.retrieve_multiple = sorcery_memory_cache_retrieve_multiple,
 	.retrieve_regex = sorcery_memory_cache_retrieve_regex,
 	.retrieve_prefix = sorcery_memory_cache_retrieve_prefix,
+	.retrieve_ids = sorcery_memory_cache_retrieve_ids,
 	.close = sorcery_memory_cache_close,
 };
 
@@ -427,6 +442,7 @@ static void sorcery_memory_cache_destructor(void *obj)
 	if (cache->object_heap) {
 		ast_heap_destroy(cache->object_heap);
 	}
+	ast_free(cache->clock);
 	ao2_cleanup(cache->objects);
 	ast_free(cache->object_type);
 }
@@ -447,6 +463,119 @@ static void sorcery_memory_cached_object_destructor(void *obj)
 
 static int schedule_cache_expiration(struct sorcery_memory_cache *cache);
 
+/*!
+ * \internal
+ * \brief Determine whether cached objects are kept in the age ordered heap
+ *
+ * The heap is needed for expiring objects, for the shared lifetime of a full
+ * backend cache and for evicting the oldest object. A cache using CLOCK eviction
+ * without any of the others skips it so adding an object is constant time.
+ */
+static int cache_uses_heap(const struct sorcery_memory_cache *cache)
+{
+	return !cache->clock_eviction || cache->object_lifetime_maximum || cache->full_backend_cache;
+}
+
+/*!
+ * \internal
+ * \brief Mark a cached object as recently used for CLOCK eviction
+ *
+ * This only needs the container read lock held by the retrieval. A racing store
+ * of the same value by another reader, or a clear by the hand, is harmless as
+ * the worst outcome is an object getting one more or one less chance.
+ */
+static void cached_object_referenced(struct sorcery_memory_cached_object *cached)
+{
+	if (!cached->referenced) {
+		cached->referenced = 1;
+	}
+}
+
+/*!
+ * \internal
+ * \brief Place an object into a free slot of the CLOCK ring
+ *
+ * \pre cache->objects is write-locked
+ * \pre The cache contains fewer than maximum_objects objects
+ */
+static void clock_insert(struct sorcery_memory_cache *cache, struct sorcery_memory_cached_object *cached)
+{
+	unsigned int slot;
+
+	if (cache->clock_used < cache->maximum_objects) {
+		slot = cache->clock_used++;
+	} else {
+		/* A free slot exists since the cache is not full, and is usually right at the hand */
+		while (cache->clock[cache->clock_hand]) {
+			cache->clock_hand = (cache->clock_hand + 1) % cache->maximum_objects;
+		}
+		slot = cache->clock_hand;
+	}
+
+	cache->clock[slot] = cached;
+	cached->clock_slot = slot;
+	cached->referenced = 0;
+}
+
+/*!
+ * \internal
+ * \brief Remove an object from the CLOCK ring
+ *
+ * \pre cache->objects is write-locked
+ */
+static void clock_remove(struct sorcery_memory_cache *cache, struct sorcery_memory_cached_object *cached)
+{
+	if (cache->clock && cache->clock[cached->clock_slot] == cached) {
+		cache->clock[cached->clock_slot] = NULL;
+	}
+}
+
+/*!
+ * \internal
+ * \brief Evict an object chosen by the CLOCK hand
+ *
+ * The hand sweeps the ring giving each recently used object a second chance, and
+ * evicts the first one not used since the hand last passed it.
+ *
+ * \pre cache->objects is write-locked
+ *
+ * \retval 0 Success
+ * \retval non-zero Failure
+ */
+static int clock_evict(struct sorcery_memory_cache *cache)
+{
+	struct sorcery_memory_cached_object *victim;
+	unsigned int swept;
+
+	/* At most two passes are needed, the first may clear every reference */
+	for (swept = 0; swept < 2 * cache->clock_used; ++swept) {
+		victim = cache->clock[cache->clock_hand];
+		if (victim && !victim->referenced) {
+			break;
+		} else if (victim) {
+			victim->referenced = 0;
+		}
+		cache->clock_hand = (cache->clock_hand + 1) % cache->clock_used;
+		victim = NULL;
+	}
+
+	if (!victim) {
+		return -1;
+	}
+
+	cache->clock[cache->clock_hand] = NULL;
+	if (cache_uses_heap(cache)) {
+		ast_heap_remove(cache->object_heap, victim);
+	}
+	ao2_find(cache->objects, victim, OBJ_SEARCH_OBJECT | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+
+	if (cache_uses_heap(cache)) {
+		schedule_cache_expiration(cache);
+	}
+
+	return 0;
+}
+
 /*!
  * \internal
  * \brief Remove an object from the cache.
@@ -475,6 +604,15 @@ static int remove_from_cache(struct sorcery_memory_cache *cache, const char *id,
 
 	ast_assert(!strcmp(ast_sorcery_object_get_id(hash_object->object), id));
 
+	if (cache->clock_eviction) {
+		clock_remove(cache, hash_object);
+	}
+
+	if (!cache_uses_heap(cache)) {
+		ao2_ref(hash_object, -1);
+		return 0;
+	}
+
 	oldest_object = ast_heap_peek(cache->object_heap, 1);
 	heap_object = ast_heap_remove(cache->object_heap, hash_object);
 
@@ -556,6 +694,12 @@ static void remove_all_from_cache(struct sorcery_memory_cache *cache)
 	while (ast_heap_pop(cache->object_heap)) {
 	}
 
+	if (cache->clock) {
+		memset(cache->clock, 0, sizeof(*cache->clock) * cache->maximum_objects);
+		cache->clock_used = 0;
+		cache->clock_hand = 0;
+	}
+
 	ao2_callback(cache->objects, OBJ_UNLINK | OBJ_NOLOCK | OBJ_NODATA | OBJ_MULTIPLE,
 		NULL, NULL);
 
@@ -734,12 +878,23 @@ static int add_to_cache(struct sorcery_memory_cache *cache,
 		return -1;
 	}
 
+	if (cache->clock_eviction) {
+		clock_insert(cache, cached_object);
+	}
+
+	if (!cache_uses_heap(cache)) {
+		return 0;
+	}
+
 	if (cache->full_backend_cache && (front = ast_heap_peek(cache->object_heap, 1))) {
 		/* For a full backend cache all objects share the same lifetime */
 		cached_object->created = front->created;
 	}
 
 	if (ast_heap_push(cache->object_heap, cached_object)) {
+		if (cache->clock_eviction) {
+			clock_remove(cache, cached_object);
+		}
 		ao2_find(cache->objects, cached_object,
 			OBJ_SEARCH_OBJECT | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
 		return -1;
@@ -821,7 +976,7 @@ static int sorcery_memory_cache_create(const struct ast_sorcery *sorcery, void *
 	ao2_wrlock(cache->objects);
 	remove_from_cache(cache, ast_sorcery_object_get_id(object), 1);
 	if (cache->maximum_objects && ao2_container_count(cache->objects) >= cache->maximum_objects) {
-		if (remove_oldest_from_cache(cache)) {
+		if (cache->clock_eviction ? clock_evict(cache) : remove_oldest_from_cache(cache)) {
 			ast_log(LOG_ERROR, "Unable to make room in cache for sorcery object '%s'.\n",
 				ast_sorcery_object_get_id(object));
 			ao2_unlock(cache->objects);
@@ -1235,6 +1390,7 @@ static void *sorcery_memory_cache_retrieve_id(const struct ast_sorcery *sorcery,
 
 	ast_assert(!strcmp(ast_sorcery_object_get_id(cached->object), id));
 
+	cached_object_referenced(cached);
 	memory_cache_stale_check_object(sorcery, cache, cached);
 
 	object = ao2_bump(cached->object);
@@ -1243,6 +1399,45 @@ static void *sorcery_memory_cache_retrieve_id(const struct ast_sorcery *sorcery,
 	return object;
 }
 
+/*!
+ * \internal
+ * \brief Callback function to retrieve multiple objects from a memory cache using their ids
+ *
+ * \param sorcery The sorcery instance
+ * \param data The sorcery memory cache
+ * \param type The type of the objects to retrieve
+ * \param objects Container to place the objects into
+ * \param ids The ids of the objects
+ */
+static void sorcery_memory_cache_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type,
+	struct ao2_container *objects, struct ao2_container *ids)
+{
+	struct sorcery_memory_cache *cache = data;
+	struct ao2_iterator i;
+	char *id;
+
+	if (is_passthru_update()) {
+		return;
+	}
+
+	memory_cache_full_update(sorcery, type, cache);
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref(id, -1)) {
+		struct sorcery_memory_cached_object *cached = ao2_find(cache->objects, id, OBJ_SEARCH_KEY);
+
+		if (!cached) {
+			continue;
+		}
+
+		cached_object_referenced(cached);
+		memory_cache_stale_check_object(sorcery, cache, cached);
+		ao2_link(objects, cached->object);
+		ao2_ref(cached, -1);
+	}
+	ao2_iterator_destroy(&i);
+}
+
 /*!
  * \internal
  * \brief AO2 callback function for comparing a retrieval request and finding applicable objects
@@ -1553,6 +1748,16 @@ static void *sorcery_memory_cache_open(const char *data)
 			cache->expire_on_reload = ast_true(value);
 		} else if (!strcasecmp(name, "full_backend_cache")) {
 			cache->full_backend_cache = ast_true(value);
+		} else if (!strcasecmp(name, "eviction")) {
+			if (!strcasecmp(S_OR(value, ""), "clock")) {
+				cache->clock_eviction = 1;
+			} else if (!strcasecmp(S_OR(value, ""), "oldest")) {
+				cache->clock_eviction = 0;
+			} else {
+				ast_log(LOG_ERROR, "Unsupported eviction value of '%s' used for memory cache\n",
+					value);
+				return NULL;
+			}
 		} else {
 			ast_log(LOG_ERROR, "Unsupported option '%s' used for memory cache\n", name);
 			return NULL;
@@ -1574,6 +1779,19 @@ static void *sorcery_memory_cache_open(const char *data)
 		return NULL;
 	}
 
+	/* Without a limit nothing is ever evicted, so CLOCK eviction has nothing to do */
+	if (cache->clock_eviction && !cache->maximum_objects) {
+		cache->clock_eviction = 0;
+	}
+
+	if (cache->clock_eviction) {
+		cache->clock = ast_calloc(cache->maximum_objects, sizeof(*cache->clock));
+		if (!cache->clock) {
+			ast_log(LOG_ERROR, "Could not create ring to hold cached objects\n");
+			return NULL;
+		}
+	}
+
 	/* The memory cache is not linked to the caches container until the load callback is invoked.
 	 * Linking occurs there so an intelligent cache name can be constructed using the module of
 	 * the sorcery instance and the specific object type if no cache name was specified as part
@@ -1709,6 +1927,8 @@ static char *sorcery_memory_cache_show(struct ast_cli_entry *e, int cmd, struct
 	ast_cli(a->fd, "Number of objects within cache: %d\n", ao2_container_count(cache->objects));
 	if (cache->maximum_objects) {
 		ast_cli(a->fd, "Maximum allowed objects: %d\n", cache->maximum_objects);
+		ast_cli(a->fd, "Objects are evicted: %s\n",
+			cache->clock_eviction ? "when not recently used (clock)" : "oldest first");
 	} else {
 		ast_cli(a->fd, "There is no limit on the maximum number of objects in the cache\n");
 	}
@@ -2328,7 +2548,8 @@ AST_TEST_DEFINE(open_with_valid_options)
 			"\t* Creates a memory cache with default configuration\n"
 			"\t* Creates a memory cache with a maximum object count of 10 and verifies it\n"
 			"\t* Creates a memory cache with a maximum object lifetime of 60 and verifies it\n"
-			"\t* Creates a memory cache with a stale object lifetime of 90 and verifies it";
+			"\t* Creates a memory cache with a stale object lifetime of 90 and verifies it\n"
+			"\t* Creates a memory cache using clock eviction and verifies it";
 		return AST_TEST_NOT_RUN;
 	case TEST_EXECUTE:
 		break;
@@ -2378,6 +2599,17 @@ AST_TEST_DEFINE(open_with_valid_options)
 		sorcery_memory_cache_close(cache);
 	}
 
+	cache = sorcery_memory_cache_open("maximum_objects=10,eviction=clock");
+	if (!cache) {
+		ast_test_status_update(test, "Failed to create a sorcery memory cache using clock eviction\n");
+		res = AST_TEST_FAIL;
+	} else {
+		if (!cache->clock_eviction) {
+			ast_test_status_update(test, "Created a sorcery memory cache using clock eviction but it evicts by age\n");
+			res = AST_TEST_FAIL;
+		}
+		sorcery_memory_cache_close(cache);
+	}
 
 	return res;
 }
@@ -2399,7 +2631,8 @@ AST_TEST_DEFINE(open_with_invalid_options)
 			"\t* Create a memory cache with a maximum object lifetime of -1\n"
 			"\t* Create a memory cache with a maximum object lifetime of toast\n"
 			"\t* Create a memory cache with a stale object lifetime of -1\n"
-			"\t* Create a memory cache with a stale object lifetime of toast";
+			"\t* Create a memory cache with a stale object lifetime of toast\n"
+			"\t* Create a memory cache with an eviction of toast";
 		return AST_TEST_NOT_RUN;
 	case TEST_EXECUTE:
 		break;
@@ -2454,6 +2687,13 @@ AST_TEST_DEFINE(open_with_invalid_options)
 		res = AST_TEST_FAIL;
 	}
 
+	cache = sorcery_memory_cache_open("maximum_objects=10,eviction=toast");
+	if (cache) {
+		ast_test_status_update(test, "Created a sorcery memory cache with an eviction of toast\n");
+		sorcery_memory_cache_close(cache);
+		res = AST_TEST_FAIL;
+	}
+
 	cache = sorcery_memory_cache_open("tacos");
 	if (cache) {
 		ast_test_status_update(test, "Created a sorcery memory cache with an invalid configuration option 'tacos'\n");
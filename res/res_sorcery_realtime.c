@@ -59,6 +59,8 @@ static void sorcery_realtime_retrieve_multiple(const struct ast_sorcery *sorcery
 static void sorcery_realtime_retrieve_regex(const struct ast_sorcery *sorcery, void *data, const char *type, struct ao2_container *objects, const char *regex);
 static void sorcery_realtime_retrieve_prefix(const struct ast_sorcery *sorcery, void *data, const char *type,
 					     struct ao2_container *objects, const char *prefix, const size_t prefix_len);
+static void sorcery_realtime_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type,
+					  struct ao2_container *objects, struct ao2_container *ids);
 static int sorcery_realtime_update(const struct ast_sorcery *sorcery, void *data, void *object);
 static int sorcery_realtime_delete(const struct ast_sorcery *sorcery, void *data, void *object);
 static void sorcery_realtime_close(void *data);
@@ -72,6 +74,7 @@ static struct ast_sorcery_wizard realtime_object_wizard = {
 	.retrieve_multiple = sorcery_realtime_retrieve_multiple,
 	.retrieve_regex = sorcery_realtime_retrieve_regex,
 	.retrieve_prefix = sorcery_realtime_retrieve_prefix,
+	.retrieve_ids = sorcery_realtime_retrieve_ids,
 	.update = sorcery_realtime_update,
 	.delete = sorcery_realtime_delete,
 	.close = sorcery_realtime_close,
@@ -282,6 +285,102 @@ static void sorcery_realtime_retrieve_prefix(const struct ast_sorcery *sorcery,
 	sorcery_realtime_retrieve_multiple(sorcery, data, type, objects, fields);
 }
 
+/*!
+ * \internal
+ * \brief Determine the prefix shared by all of the given ids
+ *
+ * \param ids The ids
+ * \param prefix Set to the start of the shared prefix, valid as long as ids is
+ *
+ * \return The length of the shared prefix
+ */
+static size_t sorcery_realtime_ids_prefix(struct ao2_container *ids, const char **prefix)
+{
+	struct ao2_iterator i;
+	char *id;
+	size_t prefix_len = 0;
+
+	*prefix = NULL;
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref(id, -1)) {
+		if (!*prefix) {
+			*prefix = id;
+			prefix_len = strlen(id);
+		} else {
+			size_t len = 0;
+
+			while (len < prefix_len && id[len] == (*prefix)[len]) {
+				++len;
+			}
+			prefix_len = len;
+		}
+	}
+	ao2_iterator_destroy(&i);
+
+	return prefix_len;
+}
+
+static void sorcery_realtime_retrieve_ids(const struct ast_sorcery *sorcery, void *data, const char *type,
+					  struct ao2_container *objects, struct ao2_container *ids)
+{
+	struct sorcery_config *config = data;
+	RAII_VAR(struct ast_config *, rows, NULL, ast_config_destroy);
+	RAII_VAR(struct ast_variable *, fields, NULL, ast_variables_destroy);
+	struct ast_category *row = NULL;
+	struct ao2_iterator i;
+	const char *prefix;
+	size_t prefix_len;
+	char *id;
+
+	/*
+	 * The realtime API cannot match a list of values, so when the ids share a prefix
+	 * they are all retrieved with a single query on it and any others are discarded.
+	 */
+	prefix_len = sorcery_realtime_ids_prefix(ids, &prefix);
+	if (ao2_container_count(ids) > 1 && prefix_len) {
+		char field[strlen(UUID_FIELD) + 6], value[prefix_len + 2];
+
+		snprintf(field, sizeof(field), "%s LIKE", UUID_FIELD);
+		snprintf(value, sizeof(value), "%.*s%%", (int) prefix_len, prefix);
+		if (!(fields = ast_variable_new(field, value, ""))
+			|| !(rows = ast_load_realtime_multientry_fields(config->family, fields))) {
+			return;
+		}
+
+		while ((row = ast_category_browse_filtered(rows, NULL, row, NULL))) {
+			struct ast_variable *objectset = ast_category_detach_variables(row);
+			RAII_VAR(struct ast_variable *, row_id, NULL, ast_variables_destroy);
+			RAII_VAR(void *, object, NULL, ao2_cleanup);
+			RAII_VAR(char *, requested, NULL, ao2_cleanup);
+
+			objectset = sorcery_realtime_filter_objectset(objectset, &row_id, sorcery, type);
+
+			if (row_id
+				&& (requested = ao2_find(ids, row_id->value, OBJ_SEARCH_KEY))
+				&& (object = ast_sorcery_alloc(sorcery, type, row_id->value))
+				&& !ast_sorcery_objectset_apply(sorcery, object, objectset)) {
+				ao2_link(objects, object);
+			}
+
+			ast_variables_destroy(objectset);
+		}
+
+		return;
+	}
+
+	i = ao2_iterator_init(ids, 0);
+	for (; (id = ao2_iterator_next(&i)); ao2_ref(id, -1)) {
+		void *object = sorcery_realtime_retrieve_id(sorcery, data, type, id);
+
+		if (object) {
+			ao2_link(objects, object);
+			ao2_ref(object, -1);
+		}
+	}
+	ao2_iterator_destroy(&i);
+}
+
 static int sorcery_realtime_update(const struct ast_sorcery *sorcery, void *data, void *object)
 {
 	struct sorcery_config *config = data;
@@ -37,6 +37,7 @@
 #include "asterisk/term.h"
 #include "asterisk/speech.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/audiohook.h"
 
 static AST_RWLIST_HEAD_STATIC(engines, ast_speech_engine);
 static struct ast_speech_engine *default_engine = NULL;
@@ -131,6 +132,7 @@ void ast_speech_start(struct ast_speech *speech)
 		ast_speech_results_free(speech->results);
 		speech->results = NULL;
 	}
+	ast_speech_partial_results_set(speech, NULL);
 
 	/* If the engine needs to start stuff up, do it */
 	if (speech->engine->start)
@@ -149,6 +151,201 @@ int ast_speech_write(struct ast_speech *speech, void *data, int len)
 	return speech->engine->write(speech, data, len);
 }
 
+/*! \brief Milliseconds of audio collected before it is handed to an engine */
+#define SPEECH_STREAM_BATCH_MS 100
+
+/*! \brief Size of the ring buffer of a stream, two seconds of 8kHz signed linear */
+#define SPEECH_STREAM_RING_SIZE 32000
+
+/*! \brief Audio tap of a channel feeding a speech engine */
+struct ast_speech_stream {
+	/*! The audiohook tapping the read path, first so the callback can find the stream */
+	struct ast_audiohook audiohook;
+	/*! The speech structure fed */
+	struct ast_speech *speech;
+	/*! The channel tapped */
+	struct ast_channel *chan;
+	/*! Protects head and tail */
+	ast_mutex_t lock;
+	/*! Bytes ever written to the ring, by the channel thread */
+	size_t head;
+	/*! Bytes ever handed to the engine, by the streaming thread */
+	size_t tail;
+	/*! Bytes dropped because the engine fell behind */
+	size_t dropped;
+	AST_LIST_ENTRY(ast_speech_stream) list;
+	unsigned char ring[SPEECH_STREAM_RING_SIZE];
+};
+
+/*! \brief Streams being fed, the lock is held while handing audio to engines */
+static AST_LIST_HEAD_STATIC(streams, ast_speech_stream);
+static ast_cond_t streams_cond;
+static pthread_t streams_thread = AST_PTHREADT_NULL;
+
+/*! \brief Copy audio read from a channel into the ring of its stream */
+static int speech_stream_hook(struct ast_audiohook *audiohook, struct ast_channel *chan,
+	struct ast_frame *frame, enum ast_audiohook_direction direction)
+{
+	struct ast_speech_stream *stream = (struct ast_speech_stream *) audiohook;
+	size_t len, offset, chunk;
+
+	if (!frame || direction != AST_AUDIOHOOK_DIRECTION_READ
+		|| frame->frametype != AST_FRAME_VOICE
+		|| stream->speech->state != AST_SPEECH_STATE_READY) {
+		return -1;
+	}
+
+	ast_mutex_lock(&stream->lock);
+	len = MIN(frame->datalen, SPEECH_STREAM_RING_SIZE - (stream->head - stream->tail));
+	stream->dropped += frame->datalen - len;
+	offset = stream->head % SPEECH_STREAM_RING_SIZE;
+	chunk = MIN(len, SPEECH_STREAM_RING_SIZE - offset);
+	memcpy(stream->ring + offset, frame->data.ptr, chunk);
+	memcpy(stream->ring, (unsigned char *) frame->data.ptr + chunk, len - chunk);
+	stream->head += len;
+	ast_mutex_unlock(&stream->lock);
+
+	/* The frame is only looked at */
+	return -1;
+}
+
+/*!
+ * \internal
+ * \brief Hand the audio collected by a stream to its engine
+ *
+ * \note Called with the streams list locked.
+ */
+static void speech_stream_drain(struct ast_speech_stream *stream)
+{
+	struct ast_speech *speech = stream->speech;
+	size_t head, tail;
+
+	ast_mutex_lock(&stream->lock);
+	head = stream->head;
+	tail = stream->tail;
+	ast_mutex_unlock(&stream->lock);
+
+	/* The channel thread only writes past head, so the audio can be passed in place */
+	while (tail != head) {
+		size_t offset = tail % SPEECH_STREAM_RING_SIZE;
+		size_t len = MIN(head - tail, SPEECH_STREAM_RING_SIZE - offset);
+
+		speech->engine->stream_write(speech, stream->ring + offset, len);
+		tail += len;
+	}
+
+	ast_mutex_lock(&stream->lock);
+	stream->tail = tail;
+	ast_mutex_unlock(&stream->lock);
+}
+
+static void *speech_stream_thread(void *data)
+{
+	for (;;) {
+		struct ast_speech_stream *stream;
+
+		AST_LIST_LOCK(&streams);
+		while (AST_LIST_EMPTY(&streams)) {
+			ast_cond_wait(&streams_cond, &streams.lock);
+		}
+		AST_LIST_TRAVERSE(&streams, stream, list) {
+			speech_stream_drain(stream);
+		}
+		AST_LIST_UNLOCK(&streams);
+
+		usleep(SPEECH_STREAM_BATCH_MS * 1000);
+	}
+
+	return NULL;
+}
+
+int ast_speech_stream_start(struct ast_speech *speech, struct ast_channel *chan)
+{
+	struct ast_speech_stream *stream;
+
+	if (speech->stream) {
+		return 0;
+	}
+
+	/* The tap gets 8kHz signed linear audio, which is all it can pass on */
+	if (!speech->engine->stream_write || streams_thread == AST_PTHREADT_NULL
+		|| ast_format_cmp(speech->format, ast_format_slin) != AST_FORMAT_CMP_EQUAL) {
+		return -1;
+	}
+
+	stream = ast_calloc(1, sizeof(*stream));
+	if (!stream) {
+		return -1;
+	}
+	stream->speech = speech;
+	stream->chan = chan;
+	ast_mutex_init(&stream->lock);
+
+	if (ast_audiohook_init(&stream->audiohook, AST_AUDIOHOOK_TYPE_MANIPULATE, "Speech Stream", 0)) {
+		ast_mutex_destroy(&stream->lock);
+		ast_free(stream);
+		return -1;
+	}
+	stream->audiohook.manipulate_callback = speech_stream_hook;
+
+	AST_LIST_LOCK(&streams);
+	AST_LIST_INSERT_TAIL(&streams, stream, list);
+	ast_cond_signal(&streams_cond);
+	AST_LIST_UNLOCK(&streams);
+
+	if (ast_audiohook_attach(chan, &stream->audiohook)) {
+		AST_LIST_LOCK(&streams);
+		AST_LIST_REMOVE(&streams, stream, list);
+		AST_LIST_UNLOCK(&streams);
+		ast_audiohook_destroy(&stream->audiohook);
+		ast_mutex_destroy(&stream->lock);
+		ast_free(stream);
+		return -1;
+	}
+
+	speech->stream = stream;
+
+	return 0;
+}
+
+void ast_speech_stream_stop(struct ast_speech *speech)
+{
+	struct ast_speech_stream *stream = speech->stream;
+
+	if (!stream) {
+		return;
+	}
+	speech->stream = NULL;
+
+	ast_audiohook_remove(stream->chan, &stream->audiohook);
+
+	/* Waits for the streaming thread to be done with the stream */
+	AST_LIST_LOCK(&streams);
+	AST_LIST_REMOVE(&streams, stream, list);
+	AST_LIST_UNLOCK(&streams);
+
+	if (stream->dropped) {
+		ast_debug(1, "Speech engine '%s' fell behind on channel %s, %zu bytes of audio dropped\n",
+			speech->engine->name, ast_channel_name(stream->chan), stream->dropped);
+	}
+
+	ast_audiohook_destroy(&stream->audiohook);
+	ast_mutex_destroy(&stream->lock);
+	ast_free(stream);
+}
+
+void ast_speech_partial_results_set(struct ast_speech *speech, struct ast_speech_result *results)
+{
+	struct ast_speech_result *old;
+
+	ast_mutex_lock(&speech->lock);
+	old = speech->partial_results;
+	speech->partial_results = results;
+	ast_mutex_unlock(&speech->lock);
+
+	ast_speech_results_free(old);
+}
+
 /*! \brief Signal to the engine that DTMF was received */
 int ast_speech_dtmf(struct ast_speech *speech, const char *dtmf)
 {
@@ -241,6 +438,9 @@ int ast_speech_destroy(struct ast_speech *speech)
 {
 	int res = 0;
 
+	/* Make sure the engine is no longer fed audio */
+	ast_speech_stream_stop(speech);
+
 	/* Call our engine so we are destroyed properly */
 	speech->engine->destroy(speech);
 
@@ -250,6 +450,7 @@ int ast_speech_destroy(struct ast_speech *speech)
 	/* If results exist on the speech structure, destroy them */
 	if (speech->results)
 		ast_speech_results_free(speech->results);
+	ast_speech_results_free(speech->partial_results);
 
 	/* If a processing sound is set - free the memory used by it */
 	if (speech->processing_sound)
@@ -357,6 +558,13 @@ static int unload_module(void)
 
 static int load_module(void)
 {
+	ast_cond_init(&streams_cond, NULL);
+	if (ast_pthread_create_background(&streams_thread, NULL, speech_stream_thread, NULL)) {
+		/* Engines are fed frame by frame instead */
+		ast_log(LOG_WARNING, "Failed to start speech streaming thread\n");
+		streams_thread = AST_PTHREADT_NULL;
+	}
+
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
@@ -91,6 +91,8 @@ static int ast_srtp_unprotect(struct ast_srtp *srtp, void *buf, int *len, int rt
 static int ast_srtp_protect(struct ast_srtp *srtp, void **buf, int *len, int rtcp);
 static void ast_srtp_set_cb(struct ast_srtp *srtp, const struct ast_srtp_cb *cb, void *data);
 static int ast_srtp_get_random(unsigned char *key, size_t len);
+static int ast_srtp_unprotect_batch(struct ast_srtp_packet *packets, unsigned int count, int rtcp);
+static int ast_srtp_protect_batch(struct ast_srtp_packet *packets, unsigned int count, int rtcp);
 
 /* Policy functions */
 static struct ast_srtp_policy *ast_srtp_policy_alloc(void);
@@ -108,7 +110,9 @@ static struct ast_srtp_res srtp_res = {
 	.set_cb = ast_srtp_set_cb,
 	.unprotect = ast_srtp_unprotect,
 	.protect = ast_srtp_protect,
-	.get_random = ast_srtp_get_random
+	.get_random = ast_srtp_get_random,
+	.unprotect_batch = ast_srtp_unprotect_batch,
+	.protect_batch = ast_srtp_protect_batch,
 };
 
 static struct ast_srtp_policy_res policy_res = {
@@ -483,9 +487,24 @@ tryagain:
 	return *len;
 }
 
-static int ast_srtp_protect(struct ast_srtp *srtp, void **buf, int *len, int rtcp)
+/*!
+ * \internal
+ * \brief Protect a packet in a buffer with room for the SRTP trailer
+ */
+static int srtp_protect_in_place(struct ast_srtp *srtp, void *buf, int *len, int rtcp)
 {
 	int res;
+
+	if ((res = rtcp ? srtp_protect_rtcp(srtp->session, buf, len) : srtp_protect(srtp->session, buf, len)) != err_status_ok && res != err_status_replay_fail) {
+		ast_log(LOG_WARNING, "SRTP protect: %s\n", srtp_errstr(res));
+		return -1;
+	}
+
+	return *len;
+}
+
+static int ast_srtp_protect(struct ast_srtp *srtp, void **buf, int *len, int rtcp)
+{
 	unsigned char *localbuf;
 
 	if (!srtp->session) {
@@ -502,8 +521,7 @@ static int ast_srtp_protect(struct ast_srtp *srtp, void **buf, int *len, int rtc
 
 	memcpy(localbuf, *buf, *len);
 
-	if ((res = rtcp ? srtp_protect_rtcp(srtp->session, localbuf, len) : srtp_protect(srtp->session, localbuf, len)) != err_status_ok && res != err_status_replay_fail) {
-		ast_log(LOG_WARNING, "SRTP protect: %s\n", srtp_errstr(res));
+	if (srtp_protect_in_place(srtp, localbuf, len, rtcp) < 0) {
 		return -1;
 	}
 
@@ -511,6 +529,54 @@ static int ast_srtp_protect(struct ast_srtp *srtp, void **buf, int *len, int rtc
 	return *len;
 }
 
+static int ast_srtp_unprotect_batch(struct ast_srtp_packet *packets, unsigned int count, int rtcp)
+{
+	unsigned int i;
+	int processed = 0;
+
+	for (i = 0; i < count; i++) {
+		struct ast_srtp_packet *packet = &packets[i];
+
+		packet->res = ast_srtp_unprotect(packet->srtp, packet->buf, &packet->len, rtcp) < 0 ? -1 : 0;
+		if (!packet->res) {
+			processed++;
+		}
+	}
+
+	return processed;
+}
+
+static int ast_srtp_protect_batch(struct ast_srtp_packet *packets, unsigned int count, int rtcp)
+{
+	unsigned int i;
+	int processed = 0;
+
+	/*
+	 * Unlike ast_srtp_protect() the packets are protected where they are,
+	 * saving the copy into the session buffer which the caller would then
+	 * copy out of again.
+	 */
+	for (i = 0; i < count; i++) {
+		struct ast_srtp_packet *packet = &packets[i];
+
+		packet->res = -1;
+		if (!packet->srtp->session) {
+			ast_log(LOG_ERROR, "SRTP protect %s - missing session\n", rtcp ? "rtcp" : "rtp");
+			continue;
+		}
+		if (packet->len + SRTP_MAX_TRAILER_LEN > packet->size) {
+			continue;
+		}
+		if (srtp_protect_in_place(packet->srtp, packet->buf, &packet->len, rtcp) < 0) {
+			continue;
+		}
+		packet->res = 0;
+		processed++;
+	}
+
+	return processed;
+}
+
 static int ast_srtp_create(struct ast_srtp **srtp, struct ast_rtp_instance *rtp, struct ast_srtp_policy *policy)
 {
 	struct ast_srtp *temp;
@@ -1204,12 +1270,24 @@ static const char *res_sdp_srtp_get_attr(struct ast_sdp_srtp *srtp, int dtls_ena
 	return NULL;
 }
 
+static int res_sdp_crypto_prefer_aead(void)
+{
+#if defined(HAVE_SRTP_GCM) && (defined(__x86_64__) || defined(__i386__))
+	/* Without AES-NI, GCM's GHASH in software is no cheaper than HMAC-SHA1 */
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes");
+#else
+	return 0;
+#endif
+}
+
 static struct ast_sdp_crypto_api res_sdp_crypto_api = {
 	.dtor = res_sdp_crypto_dtor,
 	.alloc = res_sdp_crypto_alloc,
 	.build_offer = res_sdp_crypto_build_offer,
 	.parse_offer = res_sdp_crypto_parse_offer,
 	.get_attr = res_sdp_srtp_get_attr,
+	.prefer_aead = res_sdp_crypto_prefer_aead,
 };
 
 static void res_srtp_shutdown(void)
@@ -2198,6 +2198,8 @@ static int unload_module(void)
 
 	messaging_cleanup();
 
+	app_index_cleanup();
+
 	cleanup();
 
 	stasis_app_control_shutdown();
@@ -2364,6 +2366,11 @@ static int load_module(void)
 		return AST_MODULE_LOAD_DECLINE;
 	}
 
+	if (app_index_init()) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	bridge_stasis_init();
 
 	stasis_app_register_event_sources();
@@ -62,6 +62,20 @@
 					<synopsis>Enable/disable the non-standard StatsD Meter type,
 					if disabled falls back to counter and will append a "_meter" suffix to the metric name</synopsis>
 				</configOption>
+				<configOption name="flush_interval" default="0">
+					<synopsis>Interval, in milliseconds, at which metrics are sent in batches</synopsis>
+					<description>
+						<para>When set to 0, every metric is sent to the StatsD server
+						as soon as it is logged, in its own datagram.</para>
+						<para>Otherwise metrics are held and sent every
+						<replaceable>flush_interval</replaceable> milliseconds, packing
+						as many metrics as fit in each datagram. Counters and meters
+						logged with a sample rate of 1 are summed and gauges set to
+						an absolute value only send their last value. Timers, sets,
+						histograms, sampled metrics and relative gauges are sent
+						unchanged.</para>
+					</description>
+				</configOption>
 			</configObject>
 		</configFile>
 	</configInfo>
@@ -72,6 +86,7 @@
 #include "asterisk/config_options.h"
 #include "asterisk/module.h"
 #include "asterisk/netsock2.h"
+#include "asterisk/sched.h"
 
 #define AST_API_MODULE
 #include "asterisk/statsd.h"
@@ -95,6 +110,8 @@ struct conf_global_options {
 	char prefix[MAX_PREFIX + 1];
 	/*! Enabled support for non-standard Meter type by default, falls back to counter if disabled */
 	int meter_support;
+	/*! Milliseconds between sending aggregated metrics, 0 to send every metric immediately */
+	unsigned int flush_interval;
 };
 
 /*! \brief All configuration options for statsd client. */
@@ -106,6 +123,47 @@ struct conf {
 /*! \brief Locking container for safe configuration access. */
 static AO2_GLOBAL_OBJ_STATIC(confs);
 
+/*! \brief Number of shards pending metrics are spread over */
+#define STATSD_SHARDS 16
+
+/*! \brief Largest datagram built when packing pending metrics */
+#define STATSD_MAX_PACKET 1432
+
+/*! \brief Pending unaggregated metrics a shard holds before its producer sends them */
+#define STATSD_MAX_PENDING 65536
+
+/*! \brief A metric summed, or for gauges replaced, until the next flush */
+struct statsd_aggregate {
+	/*! The metric value */
+	intmax_t value;
+	/*! Non-zero if the metric is a gauge */
+	unsigned int gauge:1;
+	/*! Length of the metric name at the start of key */
+	size_t name_len;
+	/*! The metric name and type, separated by '|' */
+	char key[0];
+};
+
+/*! \brief A share of the metrics waiting for the next flush */
+struct statsd_shard {
+	ast_mutex_t lock;
+	/*! Aggregated metrics, protected by lock */
+	struct ao2_container *aggregates;
+	/*! Formatted metrics that cannot be aggregated, one per line */
+	struct ast_str *pending;
+};
+
+static struct statsd_shard shards[STATSD_SHARDS];
+
+/*! Scheduler running the periodic flush */
+static struct ast_sched_context *statsd_sched;
+
+/*! Scheduler id of the periodic flush */
+static int statsd_flush_id = -1;
+
+AO2_STRING_FIELD_HASH_FN(statsd_aggregate, key);
+AO2_STRING_FIELD_CMP_FN(statsd_aggregate, key);
+
 static void conf_server(const struct conf *cfg, struct ast_sockaddr *addr)
 {
 	*addr = cfg->global->statsd_server;
@@ -114,6 +172,226 @@ static void conf_server(const struct conf *cfg, struct ast_sockaddr *addr)
 	}
 }
 
+/*!
+ * \brief Append the prefixed name of a metric
+ *
+ * \param msg String to append to
+ * \param cfg Current configuration
+ * \param metric_name Name of the metric
+ * \param metric_type Type of the metric
+ *
+ * \return The type the metric is sent as
+ */
+static const char *statsd_append_name(struct ast_str **msg, const struct conf *cfg,
+	const char *metric_name, const char *metric_type)
+{
+	if (!ast_strlen_zero(cfg->global->prefix)) {
+		ast_str_append(msg, 0, "%s.", cfg->global->prefix);
+	}
+
+	if (!cfg->global->meter_support && strcmp(metric_type, AST_STATSD_METER)) {
+		ast_str_append(msg, 0, "%s_meter", metric_name);
+		return AST_STATSD_COUNTER;
+	}
+
+	ast_str_append(msg, 0, "%s", metric_name);
+	return metric_type;
+}
+
+/*!
+ * \brief Send newline separated metrics, packing as many as fit in each datagram
+ *
+ * \param cfg Current configuration
+ * \param lines The metrics, each terminated by a newline
+ * \param len Length of lines
+ */
+static void statsd_send_packed(const struct conf *cfg, char *lines, size_t len)
+{
+	struct ast_sockaddr statsd_server;
+	size_t start = 0;
+	size_t end;
+	char *next;
+
+	conf_server(cfg, &statsd_server);
+
+	while (start < len) {
+		/* Take whole lines while they fit, but always at least one */
+		end = start;
+		while (end < len) {
+			next = memchr(lines + end, '\n', len - end);
+			if (!next) {
+				next = lines + len - 1;
+			}
+			if (end != start && next + 1 - lines - start > STATSD_MAX_PACKET) {
+				break;
+			}
+			end = next + 1 - lines;
+		}
+
+		ast_debug(6, "Sending %zu bytes of statistics to StatsD server\n", end - start);
+		/* The final newline is only sent if every metric should have one */
+		ast_sendto(socket_fd, lines + start,
+			end - start - (cfg->global->add_newline ? 0 : 1), 0, &statsd_server);
+		start = end;
+	}
+}
+
+/*! \brief Append an aggregated metric to the flush output and drop it */
+static int statsd_aggregate_format(void *obj, void *arg, int flags)
+{
+	struct statsd_aggregate *aggregate = obj;
+	struct ast_str **out = arg;
+
+	ast_str_append(out, 0, "%.*s:%jd|%s\n", (int) aggregate->name_len, aggregate->key,
+		aggregate->value, aggregate->key + aggregate->name_len + 1);
+
+	return CMP_MATCH;
+}
+
+/*!
+ * \brief Send everything a shard holds
+ *
+ * \pre shard is locked
+ */
+static void statsd_shard_flush(const struct conf *cfg, struct statsd_shard *shard)
+{
+	ao2_callback(shard->aggregates, OBJ_NOLOCK | OBJ_MULTIPLE | OBJ_UNLINK | OBJ_NODATA,
+		statsd_aggregate_format, &shard->pending);
+
+	if (socket_fd != -1 && ast_str_strlen(shard->pending)) {
+		statsd_send_packed(cfg, ast_str_buffer(shard->pending), ast_str_strlen(shard->pending));
+	}
+	ast_str_reset(shard->pending);
+}
+
+/*! \brief Send everything held by every shard */
+static void statsd_flush(void)
+{
+	RAII_VAR(struct conf *, cfg, ao2_global_obj_ref(confs), ao2_cleanup);
+	int i;
+
+	if (!cfg) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_LEN(shards); i++) {
+		if (!shards[i].aggregates) {
+			continue;
+		}
+		ast_mutex_lock(&shards[i].lock);
+		statsd_shard_flush(cfg, &shards[i]);
+		ast_mutex_unlock(&shards[i].lock);
+	}
+}
+
+/*! \brief Scheduler callback for the periodic flush */
+static int statsd_flush_cb(const void *data)
+{
+	RAII_VAR(struct conf *, cfg, ao2_global_obj_ref(confs), ao2_cleanup);
+
+	statsd_flush();
+
+	if (!cfg || !cfg->global->flush_interval) {
+		statsd_flush_id = -1;
+		return 0;
+	}
+
+	return cfg->global->flush_interval;
+}
+
+/*!
+ * \brief Parse an integer metric value that can be aggregated
+ *
+ * \retval 0 on success
+ * \retval -1 if the value is not a plain integer
+ */
+static int statsd_parse_value(const char *value, intmax_t *result)
+{
+	char *end;
+
+	if (ast_strlen_zero(value)) {
+		return -1;
+	}
+
+	errno = 0;
+	*result = strtoimax(value, &end, 10);
+	return errno || *end ? -1 : 0;
+}
+
+/*!
+ * \brief Hold a metric until the next flush
+ *
+ * Counters and meters are summed and gauges set to an absolute value keep
+ * only the last one.  Everything else is formatted and sent as is with the
+ * next flush.
+ */
+static void statsd_aggregate(const struct conf *cfg, const char *metric_name,
+	const char *metric_type, const char *value, double sample_rate)
+{
+	struct statsd_shard *shard;
+	struct statsd_aggregate *aggregate;
+	struct ast_str *key;
+	const char *type;
+	intmax_t number;
+	size_t name_len;
+	int gauge = !strcmp(metric_type, AST_STATSD_GAUGE);
+
+	key = ast_str_create(64);
+	if (!key) {
+		return;
+	}
+
+	type = statsd_append_name(&key, cfg, metric_name, metric_type);
+	name_len = ast_str_strlen(key);
+	shard = &shards[ast_str_hash(metric_name) % ARRAY_LEN(shards)];
+
+	if (sample_rate >= 1.0
+		&& (gauge || !strcmp(type, AST_STATSD_COUNTER) || !strcmp(type, AST_STATSD_METER))
+		/* A signed gauge is relative to the current value, so it has to be sent as is */
+		&& !(gauge && (*value == '+' || *value == '-'))
+		&& !statsd_parse_value(value, &number)) {
+		ast_str_append(&key, 0, "|%s", type);
+
+		ast_mutex_lock(&shard->lock);
+		aggregate = ao2_find(shard->aggregates, ast_str_buffer(key), OBJ_SEARCH_KEY | OBJ_NOLOCK);
+		if (!aggregate) {
+			aggregate = ao2_alloc_options(sizeof(*aggregate) + ast_str_strlen(key) + 1, NULL,
+				AO2_ALLOC_OPT_LOCK_NOLOCK);
+			if (!aggregate) {
+				ast_mutex_unlock(&shard->lock);
+				ast_free(key);
+				return;
+			}
+			strcpy(aggregate->key, ast_str_buffer(key)); /* Safe */
+			aggregate->name_len = name_len;
+			aggregate->gauge = gauge;
+			ao2_link_flags(shard->aggregates, aggregate, OBJ_NOLOCK);
+		}
+		if (aggregate->gauge) {
+			aggregate->value = number;
+		} else {
+			aggregate->value += number;
+		}
+		ao2_ref(aggregate, -1);
+		ast_mutex_unlock(&shard->lock);
+		ast_free(key);
+		return;
+	}
+
+	ast_mutex_lock(&shard->lock);
+	ast_str_append(&shard->pending, 0, "%s:%s|%s", ast_str_buffer(key), value, type);
+	if (sample_rate < 1.0) {
+		ast_str_append(&shard->pending, 0, "|@%.2f", sample_rate);
+	}
+	ast_str_append(&shard->pending, 0, "\n");
+	if (ast_str_strlen(shard->pending) >= STATSD_MAX_PENDING) {
+		/* Don't let a burst grow the shard without bound while waiting for the flush */
+		statsd_shard_flush(cfg, shard);
+	}
+	ast_mutex_unlock(&shard->lock);
+	ast_free(key);
+}
+
 void AST_OPTIONAL_API_NAME(ast_statsd_log_string)(const char *metric_name,
 	const char *metric_type, const char *value, double sample_rate)
 {
@@ -121,6 +399,7 @@ void AST_OPTIONAL_API_NAME(ast_statsd_log_string)(const char *metric_name,
 	struct ast_str *msg;
 	size_t len;
 	struct ast_sockaddr statsd_server;
+	const char *type;
 
 	if (socket_fd == -1) {
 		return;
@@ -136,6 +415,13 @@ void AST_OPTIONAL_API_NAME(ast_statsd_log_string)(const char *metric_name,
 	}
 
 	cfg = ao2_global_obj_ref(confs);
+
+	if (cfg->global->flush_interval) {
+		statsd_aggregate(cfg, metric_name, metric_type, value, sample_rate);
+		ao2_cleanup(cfg);
+		return;
+	}
+
 	conf_server(cfg, &statsd_server);
 
 	msg = ast_str_create(40);
@@ -144,15 +430,8 @@ void AST_OPTIONAL_API_NAME(ast_statsd_log_string)(const char *metric_name,
 		return;
 	}
 
-	if (!ast_strlen_zero(cfg->global->prefix)) {
-		ast_str_append(&msg, 0, "%s.", cfg->global->prefix);
-	}
-
-	if (!cfg->global->meter_support && strcmp(metric_type, AST_STATSD_METER)) {
-		ast_str_append(&msg, 0, "%s_meter:%s|%s", metric_name, value, AST_STATSD_COUNTER);
-	} else {
-		ast_str_append(&msg, 0, "%s:%s|%s", metric_name, value, metric_type);
-	}
+	type = statsd_append_name(&msg, cfg, metric_name, metric_type);
+	ast_str_append(&msg, 0, ":%s|%s", value, type);
 
 	if (sample_rate < 1.0) {
 		ast_str_append(&msg, 0, "|@%.2f", sample_rate);
@@ -326,6 +605,23 @@ static int statsd_init(void)
 	ast_debug(3, "  StatsD server = %s.\n", server);
 	ast_debug(3, "  add newline = %s\n", AST_YESNO(cfg->global->add_newline));
 	ast_debug(3, "  prefix = %s\n", cfg->global->prefix);
+	ast_debug(3, "  flush interval = %u\n", cfg->global->flush_interval);
+
+	if (cfg->global->flush_interval) {
+		if (!statsd_sched) {
+			statsd_sched = ast_sched_context_create();
+			if (!statsd_sched || ast_sched_start_thread(statsd_sched)) {
+				ast_log(LOG_ERROR, "Failed to start the StatsD flush scheduler\n");
+				ast_sched_context_destroy(statsd_sched);
+				statsd_sched = NULL;
+				return -1;
+			}
+		}
+		if (statsd_flush_id == -1) {
+			statsd_flush_id = ast_sched_add_variable(statsd_sched, cfg->global->flush_interval,
+				statsd_flush_cb, NULL, 1);
+		}
+	}
 
 	return 0;
 }
@@ -333,15 +629,61 @@ static int statsd_init(void)
 static void statsd_shutdown(void)
 {
 	ast_debug(3, "Shutting down StatsD client.\n");
+	/* Send whatever is still being held before the socket goes away */
+	statsd_flush();
 	if (socket_fd != -1) {
 		close(socket_fd);
 		socket_fd = -1;
 	}
 }
 
+static void shards_destroy(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(shards); i++) {
+		if (!shards[i].aggregates) {
+			continue;
+		}
+		ao2_ref(shards[i].aggregates, -1);
+		shards[i].aggregates = NULL;
+		ast_free(shards[i].pending);
+		shards[i].pending = NULL;
+		ast_mutex_destroy(&shards[i].lock);
+	}
+}
+
+static int shards_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(shards); i++) {
+		shards[i].pending = ast_str_create(STATSD_MAX_PACKET);
+		shards[i].aggregates = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, 31,
+			statsd_aggregate_hash_fn, NULL, statsd_aggregate_cmp_fn);
+		if (!shards[i].pending || !shards[i].aggregates) {
+			ast_free(shards[i].pending);
+			shards[i].pending = NULL;
+			ao2_cleanup(shards[i].aggregates);
+			shards[i].aggregates = NULL;
+			shards_destroy();
+			return -1;
+		}
+		ast_mutex_init(&shards[i].lock);
+	}
+
+	return 0;
+}
+
 static int unload_module(void)
 {
+	if (statsd_sched) {
+		ast_sched_context_destroy(statsd_sched);
+		statsd_sched = NULL;
+		statsd_flush_id = -1;
+	}
 	statsd_shutdown();
+	shards_destroy();
 	aco_info_destroy(&cfg_info);
 	ao2_global_obj_release(confs);
 	return 0;
@@ -349,7 +691,12 @@ static int unload_module(void)
 
 static int load_module(void)
 {
+	if (shards_init()) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	if (aco_info_init(&cfg_info)) {
+		shards_destroy();
 		aco_info_destroy(&cfg_info);
 		return AST_MODULE_LOAD_DECLINE;
 	}
@@ -374,6 +721,10 @@ static int load_module(void)
 		"yes", OPT_BOOL_T, 1,
 		FLDSET(struct conf_global_options, meter_support));
 
+	aco_option_register(&cfg_info, "flush_interval", ACO_EXACT, global_options,
+		"0", OPT_UINT_T, 0,
+		FLDSET(struct conf_global_options, flush_interval));
+
 	if (aco_process_config(&cfg_info, 0) == ACO_PROCESS_ERROR) {
 		struct conf *cfg;
 
@@ -381,6 +732,7 @@ static int load_module(void)
 		cfg = conf_alloc();
 		if (!cfg) {
 			aco_info_destroy(&cfg_info);
+			shards_destroy();
 			return AST_MODULE_LOAD_DECLINE;
 		}
 
@@ -388,6 +740,7 @@ static int load_module(void)
 			ast_log(LOG_ERROR, "Failed to initialize statsd defaults.\n");
 			ao2_ref(cfg, -1);
 			aco_info_destroy(&cfg_info);
+			shards_destroy();
 			return AST_MODULE_LOAD_DECLINE;
 		}
 
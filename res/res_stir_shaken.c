@@ -38,6 +38,7 @@
 #include "asterisk/global_datastores.h"
 #include "asterisk/app.h"
 #include "asterisk/test.h"
+#include "asterisk/taskprocessor.h"
 
 #include "asterisk/res_stir_shaken.h"
 #include "res_stir_shaken/stir_shaken.h"
@@ -62,7 +63,14 @@
 					<synopsis>File path to a chain of trust</synopsis>
 				</configOption>
 				<configOption name="cache_max_size" default="1000">
-					<synopsis>Maximum size to use for caching public keys</synopsis>
+					<synopsis>Maximum number of public keys and verification results to cache</synopsis>
+					<description><para>
+					Parsed public keys are kept in memory until their certificate expires,
+					honoring the Cache-Control or Expires header it was downloaded with, and
+					are refreshed in the background shortly before then.  The results of
+					verifying an Identity header are kept for <literal>signature_timeout</literal>
+					seconds so repeated INVITEs with the same identity are not verified again.
+					</para></description>
 				</configOption>
 				<configOption name="curl_timeout" default="2">
 					<synopsis>Maximum time to wait to CURL certificates</synopsis>
@@ -157,6 +165,47 @@ static struct ast_sorcery *stir_shaken_sorcery;
  */
 #define EXPIRATION_BUFFER 15
 
+/* Refresh a cached public key in the background once it is this close (in
+ * seconds) to expiring
+ */
+#define PUBLIC_KEY_REFRESH_WINDOW 60
+
+#define PUBLIC_KEY_BUCKETS 53
+#define VERIFIED_IDENTITY_BUCKETS 563
+
+/*! \brief A parsed public key, cached by URL */
+struct public_key {
+	/*! The key, freed with the entry */
+	EVP_PKEY *key;
+	/*! When the certificate expires */
+	struct timeval expires;
+	/*! Non-zero while a background refresh is pending */
+	int refreshing;
+	/*! The public cert URL */
+	char url[];
+};
+
+/*! \brief The outcome of a recent signature verification */
+struct verified_identity {
+	/*! When the result must no longer be used */
+	struct timeval expires;
+	/*! 0 if the signature was valid, -1 if not */
+	int res;
+	/*! SHA1 hash of the Identity header contents */
+	char hash[41];
+};
+
+static struct ao2_container *public_keys;
+static struct ao2_container *verified_identities;
+
+/*! \brief Refreshes public keys before they expire */
+static struct ast_taskprocessor *refresh_tps;
+
+AO2_STRING_FIELD_HASH_FN(public_key, url);
+AO2_STRING_FIELD_CMP_FN(public_key, url);
+AO2_STRING_FIELD_HASH_FN(verified_identity, hash);
+AO2_STRING_FIELD_CMP_FN(verified_identity, hash);
+
 struct ast_stir_shaken_payload {
 	/*! The JWT header */
 	struct ast_json *header;
@@ -202,7 +251,9 @@ char *ast_stir_shaken_payload_get_public_cert_url(const struct ast_stir_shaken_p
 
 unsigned int ast_stir_shaken_get_signature_timeout(void)
 {
-	return ast_stir_shaken_signature_timeout(stir_shaken_general_get());
+	RAII_VAR(struct stir_shaken_general *, cfg, stir_shaken_general_get(), ao2_cleanup);
+
+	return ast_stir_shaken_signature_timeout(cfg);
 }
 
 /*!
@@ -395,16 +446,14 @@ static void set_public_key_expiration(const char *public_cert_url, const struct
 }
 
 /*!
- * \brief Check to see if the public key is expired
+ * \brief Get the expiration of the public key
  *
  * \param public_cert_url The public cert URL
  *
- * \retval 1 if expired
- * \retval 0 if not expired
+ * \return The expiration, zero if not known
  */
-static int public_key_is_expired(const char *public_cert_url)
+static struct timeval public_key_get_expiration(const char *public_cert_url)
 {
-	struct timeval current_time = ast_tvnow();
 	struct timeval expires = { .tv_sec = 0, .tv_usec = 0 };
 	char expiration[32];
 	char hash[41];
@@ -412,15 +461,25 @@ static int public_key_is_expired(const char *public_cert_url)
 	ast_sha1_hash(hash, public_cert_url);
 	ast_db_get(hash, "expiration", expiration, sizeof(expiration));
 
-	if (ast_strlen_zero(expiration)) {
-		return 1;
+	if (ast_strlen_zero(expiration)
+		|| ast_str_to_ulong(expiration, (unsigned long *)&expires.tv_sec)) {
+		expires.tv_sec = 0;
 	}
 
-	if (ast_str_to_ulong(expiration, (unsigned long *)&expires.tv_sec)) {
-		return 1;
-	}
+	return expires;
+}
 
-	return ast_tvcmp(current_time, expires) == -1 ? 0 : 1;
+/*!
+ * \brief Check to see if the public key is expired
+ *
+ * \param public_cert_url The public cert URL
+ *
+ * \retval 1 if expired
+ * \retval 0 if not expired
+ */
+static int public_key_is_expired(const char *public_cert_url)
+{
+	return ast_tvcmp(ast_tvnow(), public_key_get_expiration(public_cert_url)) == -1 ? 0 : 1;
 }
 
 /*!
@@ -473,6 +532,8 @@ static void remove_public_key_from_astdb(const char *public_cert_url)
 	char hash[41];
 	char filepath[MAX_PATH_LEN];
 
+	ao2_find(public_keys, public_cert_url, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA);
+
 	ast_sha1_hash(hash, public_cert_url);
 
 	/* Remove this public key from storage */
@@ -617,41 +678,20 @@ static char *curl_and_check_expiration(const char *public_cert_url, const char *
 	return filename;
 }
 
-struct ast_stir_shaken_payload *ast_stir_shaken_verify(const char *header, const char *payload, const char *signature,
-	const char *algorithm, const char *public_cert_url)
+/*!
+ * \brief Read the public key for public_cert_url, downloading it if needed
+ *
+ * \param public_cert_url The public cert URL
+ *
+ * \retval NULL on failure
+ * \retval The public key on success
+ */
+static EVP_PKEY *public_key_load(const char *public_cert_url)
 {
-	struct ast_stir_shaken_payload *ret_payload;
 	EVP_PKEY *public_key;
 	int curl = 0;
 	RAII_VAR(char *, file_path, NULL, ast_free);
 	RAII_VAR(char *, dir_path, NULL, ast_free);
-	RAII_VAR(char *, combined_str, NULL, ast_free);
-	size_t combined_size;
-
-	if (ast_strlen_zero(header)) {
-		ast_log(LOG_ERROR, "'header' is required for STIR/SHAKEN verification\n");
-		return NULL;
-	}
-
-	if (ast_strlen_zero(payload)) {
-		ast_log(LOG_ERROR, "'payload' is required for STIR/SHAKEN verification\n");
-		return NULL;
-	}
-
-	if (ast_strlen_zero(signature)) {
-		ast_log(LOG_ERROR, "'signature' is required for STIR/SHAKEN verification\n");
-		return NULL;
-	}
-
-	if (ast_strlen_zero(algorithm)) {
-		ast_log(LOG_ERROR, "'algorithm' is required for STIR/SHAKEN verification\n");
-		return NULL;
-	}
-
-	if (ast_strlen_zero(public_cert_url)) {
-		ast_log(LOG_ERROR, "'public_cert_url' is required for STIR/SHAKEN verification\n");
-		return NULL;
-	}
 
 	/* Check to see if we have already downloaded this public cert. The reason we
 	 * store the file path is because:
@@ -731,23 +771,305 @@ struct ast_stir_shaken_payload *ast_stir_shaken_verify(const char *header, const
 		}
 	}
 
+	return public_key;
+}
+
+static int public_key_expired_cb(void *obj, void *arg, int flags)
+{
+	struct public_key *entry = obj;
+	const struct timeval *now = arg;
+
+	return ast_tvcmp(*now, entry->expires) >= 0 ? CMP_MATCH : 0;
+}
+
+static int verified_identity_expired_cb(void *obj, void *arg, int flags)
+{
+	struct verified_identity *entry = obj;
+	const struct timeval *now = arg;
+
+	return ast_tvcmp(*now, entry->expires) >= 0 ? CMP_MATCH : 0;
+}
+
+/*!
+ * \brief Make room for a new entry in a cache limited to cache_max_size
+ *
+ * \param cache The cache
+ * \param expired_cb Callback matching expired entries
+ */
+static void cache_make_room(struct ao2_container *cache, ao2_callback_fn *expired_cb)
+{
+	RAII_VAR(struct stir_shaken_general *, cfg, stir_shaken_general_get(), ao2_cleanup);
+	unsigned int max_size = ast_stir_shaken_cache_max_size(cfg);
+	struct timeval now;
+
+	if (ao2_container_count(cache) < max_size) {
+		return;
+	}
+
+	now = ast_tvnow();
+	ao2_callback(cache, OBJ_MULTIPLE | OBJ_NODATA | OBJ_UNLINK, expired_cb, &now);
+
+	/* Everything is still current, so drop an arbitrary entry */
+	if (ao2_container_count(cache) >= max_size) {
+		ao2_callback(cache, OBJ_NODATA | OBJ_UNLINK, NULL, NULL);
+	}
+}
+
+static void public_key_destructor(void *obj)
+{
+	struct public_key *entry = obj;
+
+	EVP_PKEY_free(entry->key);
+}
+
+/*!
+ * \brief Add a parsed public key to the cache, replacing any existing one
+ *
+ * \note On success the cache entry owns public_key, on failure it is freed.
+ *
+ * \retval NULL on failure
+ * \retval The cache entry with a reference on success
+ */
+static struct public_key *public_key_cache_add(const char *public_cert_url, EVP_PKEY *public_key)
+{
+	struct public_key *entry;
+
+	entry = ao2_alloc_options(sizeof(*entry) + strlen(public_cert_url) + 1,
+		public_key_destructor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		EVP_PKEY_free(public_key);
+		return NULL;
+	}
+
+	entry->key = public_key;
+	entry->expires = public_key_get_expiration(public_cert_url);
+	strcpy(entry->url, public_cert_url); /* Safe */
+
+	cache_make_room(public_keys, public_key_expired_cb);
+
+	ao2_wrlock(public_keys);
+	ao2_find(public_keys, public_cert_url, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+	ao2_link_flags(public_keys, entry, OBJ_NOLOCK);
+	ao2_unlock(public_keys);
+
+	return entry;
+}
+
+/*!
+ * \brief Download a fresh copy of a cached public key
+ *
+ * Runs on the refresh taskprocessor so the key stays cached, and calls
+ * keep being verified, while the certificate is downloaded.
+ */
+static int public_key_refresh(void *data)
+{
+	char *public_cert_url = data;
+	struct public_key *entry;
+	EVP_PKEY *public_key;
+	RAII_VAR(char *, old_path, get_path_to_public_key(public_cert_url), ast_free);
+	RAII_VAR(char *, file_path, NULL, ast_free);
+	RAII_VAR(char *, dir_path, NULL, ast_free);
+
+	if (ast_asprintf(&dir_path, "%s/keys/%s", ast_config_AST_DATA_DIR, STIR_SHAKEN_DIR_NAME) < 0) {
+		goto done;
+	}
+
+	file_path = run_curl(public_cert_url, dir_path);
+	if (!file_path) {
+		goto done;
+	}
+
+	public_key = stir_shaken_read_key(file_path, 0);
+	if (!public_key) {
+		remove(file_path);
+		goto done;
+	}
+
+	add_public_key_to_astdb(public_cert_url, file_path);
+	if (!ast_strlen_zero(old_path) && strcmp(old_path, file_path)) {
+		remove(old_path);
+	}
+
+	ast_debug(3, "Refreshed public cert '%s'\n", public_cert_url);
+	ao2_cleanup(public_key_cache_add(public_cert_url, public_key));
+	ast_free(public_cert_url);
+	return 0;
+
+done:
+	/* Let the next verification try again */
+	entry = ao2_find(public_keys, public_cert_url, OBJ_SEARCH_KEY);
+	if (entry) {
+		entry->refreshing = 0;
+		ao2_ref(entry, -1);
+	}
+	ast_free(public_cert_url);
+	return 0;
+}
+
+/*!
+ * \brief Get the parsed public key for public_cert_url
+ *
+ * A cached key is returned as long as it has not expired.  One close to
+ * expiring is refreshed in the background.  Only when there is no usable
+ * cached key does this read or download the certificate itself.
+ *
+ * \retval NULL on failure
+ * \retval The cache entry with a reference on success
+ */
+static struct public_key *public_key_get(const char *public_cert_url)
+{
+	struct public_key *entry;
+	struct timeval now = ast_tvnow();
+	EVP_PKEY *public_key;
+
+	entry = ao2_find(public_keys, public_cert_url, OBJ_SEARCH_KEY);
+	if (entry && ast_tvcmp(now, entry->expires) < 0) {
+		if (ast_tvdiff_sec(entry->expires, now) < PUBLIC_KEY_REFRESH_WINDOW
+			&& !ast_atomic_fetchadd_int(&entry->refreshing, 1)) {
+			char *url = ast_strdup(public_cert_url);
+
+			if (!url || ast_taskprocessor_push(refresh_tps, public_key_refresh, url)) {
+				ast_free(url);
+				entry->refreshing = 0;
+			}
+		}
+		return entry;
+	}
+	ao2_cleanup(entry);
+
+	public_key = public_key_load(public_cert_url);
+	if (!public_key) {
+		return NULL;
+	}
+
+	return public_key_cache_add(public_cert_url, public_key);
+}
+
+/*!
+ * \brief Look up the result of a recent verification of the same identity
+ *
+ * \param hash The identity hash
+ *
+ * \retval 1 if not cached
+ * \retval 0 if the signature was valid
+ * \retval -1 if the signature was not valid
+ */
+static int verified_identity_get(const char *hash)
+{
+	struct verified_identity *entry;
+	int res = 1;
+
+	entry = ao2_find(verified_identities, hash, OBJ_SEARCH_KEY);
+	if (entry) {
+		if (ast_tvcmp(ast_tvnow(), entry->expires) < 0) {
+			res = entry->res;
+		}
+		ao2_ref(entry, -1);
+	}
+
+	return res;
+}
+
+/*!
+ * \brief Remember the result of verifying an identity
+ *
+ * The result is kept until the signature is too old to be accepted
+ * anyway, or the public key expires, whichever comes first.
+ */
+static void verified_identity_add(const char *hash, int res, struct timeval key_expires)
+{
+	RAII_VAR(struct stir_shaken_general *, cfg, stir_shaken_general_get(), ao2_cleanup);
+	struct verified_identity *entry;
+
+	entry = ao2_alloc_options(sizeof(*entry), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!entry) {
+		return;
+	}
+
+	entry->expires = ast_tvadd(ast_tvnow(), ast_samp2tv(ast_stir_shaken_signature_timeout(cfg), 1));
+	if (ast_tvcmp(key_expires, entry->expires) < 0) {
+		entry->expires = key_expires;
+	}
+	entry->res = res;
+	ast_copy_string(entry->hash, hash, sizeof(entry->hash));
+
+	cache_make_room(verified_identities, verified_identity_expired_cb);
+
+	ao2_wrlock(verified_identities);
+	ao2_find(verified_identities, hash, OBJ_SEARCH_KEY | OBJ_UNLINK | OBJ_NODATA | OBJ_NOLOCK);
+	ao2_link_flags(verified_identities, entry, OBJ_NOLOCK);
+	ao2_unlock(verified_identities);
+	ao2_ref(entry, -1);
+}
+
+struct ast_stir_shaken_payload *ast_stir_shaken_verify(const char *header, const char *payload, const char *signature,
+	const char *algorithm, const char *public_cert_url)
+{
+	struct ast_stir_shaken_payload *ret_payload;
+	struct public_key *public_key;
+	RAII_VAR(char *, combined_str, NULL, ast_free);
+	RAII_VAR(char *, identity, NULL, ast_free);
+	char identity_hash[41];
+	size_t combined_size;
+	int res;
+
+	if (ast_strlen_zero(header)) {
+		ast_log(LOG_ERROR, "'header' is required for STIR/SHAKEN verification\n");
+		return NULL;
+	}
+
+	if (ast_strlen_zero(payload)) {
+		ast_log(LOG_ERROR, "'payload' is required for STIR/SHAKEN verification\n");
+		return NULL;
+	}
+
+	if (ast_strlen_zero(signature)) {
+		ast_log(LOG_ERROR, "'signature' is required for STIR/SHAKEN verification\n");
+		return NULL;
+	}
+
+	if (ast_strlen_zero(algorithm)) {
+		ast_log(LOG_ERROR, "'algorithm' is required for STIR/SHAKEN verification\n");
+		return NULL;
+	}
+
+	if (ast_strlen_zero(public_cert_url)) {
+		ast_log(LOG_ERROR, "'public_cert_url' is required for STIR/SHAKEN verification\n");
+		return NULL;
+	}
+
 	/* Combine the header and payload to get the original signed message: header.payload */
 	combined_size = strlen(header) + strlen(payload) + 2;
 	combined_str = ast_calloc(1, combined_size);
 	if (!combined_str) {
 		ast_log(LOG_ERROR, "Failed to allocate space for message to verify\n");
-		EVP_PKEY_free(public_key);
 		return NULL;
 	}
 	snprintf(combined_str, combined_size, "%s.%s", header, payload);
-	if (stir_shaken_verify_signature(combined_str, signature, public_key)) {
-		ast_log(LOG_ERROR, "Failed to verify signature\n");
-		EVP_PKEY_free(public_key);
+
+	/* The same identity is often verified more than once, such as for
+	 * retransmitted or spiraled INVITEs */
+	if (ast_asprintf(&identity, "%s.%s;info=<%s>", combined_str, signature, public_cert_url) < 0) {
 		return NULL;
 	}
+	ast_sha1_hash(identity_hash, identity);
+
+	res = verified_identity_get(identity_hash);
+	if (res > 0) {
+		public_key = public_key_get(public_cert_url);
+		if (!public_key) {
+			return NULL;
+		}
 
-	/* We don't need the public key anymore */
-	EVP_PKEY_free(public_key);
+		res = stir_shaken_verify_signature(combined_str, signature, public_key->key);
+		verified_identity_add(identity_hash, res, public_key->expires);
+		ao2_ref(public_key, -1);
+	}
+
+	if (res) {
+		ast_log(LOG_ERROR, "Failed to verify signature\n");
+		return NULL;
+	}
 
 	ret_payload = ast_calloc(1, sizeof(*ret_payload));
 	if (!ret_payload) {
@@ -1596,6 +1918,28 @@ AST_TEST_DEFINE(test_stir_shaken_verify)
 		return AST_TEST_FAIL;
 	}
 
+	/* Verify it again, this time from the caches */
+	ast_stir_shaken_payload_free(returned_payload);
+	returned_payload = ast_stir_shaken_verify(header, payload, (const char *)signed_payload->signature,
+		STIR_SHAKEN_ENCRYPTION_ALGORITHM, public_cert_url);
+	if (!returned_payload) {
+		ast_test_status_update(test, "Failed to verify a cached valid signature\n");
+		remove_public_key_from_astdb(public_cert_url);
+		test_stir_shaken_cleanup_cert(caller_id_number);
+		return AST_TEST_FAIL;
+	}
+
+	/* A different payload must not be accepted on the strength of the cached result */
+	ast_stir_shaken_payload_free(returned_payload);
+	returned_payload = ast_stir_shaken_verify(header, "{\"orig\":{\"tn\":\"7654321\"}}",
+		(const char *)signed_payload->signature, STIR_SHAKEN_ENCRYPTION_ALGORITHM, public_cert_url);
+	if (returned_payload) {
+		ast_test_status_update(test, "Verified a signature for a different payload\n");
+		remove_public_key_from_astdb(public_cert_url);
+		test_stir_shaken_cleanup_cert(caller_id_number);
+		return AST_TEST_FAIL;
+	}
+
 	remove_public_key_from_astdb(public_cert_url);
 
 	test_stir_shaken_cleanup_cert(caller_id_number);
@@ -1630,6 +1974,12 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(test_stir_shaken_sign);
 	AST_TEST_UNREGISTER(test_stir_shaken_verify);
 
+	refresh_tps = ast_taskprocessor_unreference(refresh_tps);
+	ao2_cleanup(verified_identities);
+	verified_identities = NULL;
+	ao2_cleanup(public_keys);
+	public_keys = NULL;
+
 	return res;
 }
 
@@ -1637,6 +1987,16 @@ static int load_module(void)
 {
 	int res = 0;
 
+	public_keys = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+		PUBLIC_KEY_BUCKETS, public_key_hash_fn, NULL, public_key_cmp_fn);
+	verified_identities = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+		VERIFIED_IDENTITY_BUCKETS, verified_identity_hash_fn, NULL, verified_identity_cmp_fn);
+	refresh_tps = ast_taskprocessor_get("stir_shaken/refresh", TPS_REF_DEFAULT);
+	if (!public_keys || !verified_identities || !refresh_tps) {
+		unload_module();
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
 	if (!(stir_shaken_sorcery = ast_sorcery_open())) {
 		ast_log(LOG_ERROR, "stir/shaken - failed to open sorcery\n");
 		return AST_MODULE_LOAD_DECLINE;
@@ -20,6 +20,7 @@
 
 #include "asterisk/utils.h"
 #include "asterisk/logger.h"
+#include "asterisk/res_curl.h"
 #include "curl.h"
 #include "general.h"
 #include "stir_shaken.h"
@@ -227,7 +228,7 @@ char *curl_public_key(const char *public_cert_url, const char *path, struct curl
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, public_key_file);
 	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_errbuf);
 
-	if (curl_easy_perform(curl)) {
+	if (ast_curl_perform(curl)) {
 		ast_log(LOG_ERROR, "%s\n", curl_errbuf);
 		curl_easy_cleanup(curl);
 		fclose(public_key_file);
@@ -0,0 +1,595 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ *
+ * \brief Timer wheel timing interface
+ *
+ * Every timer handed out by the other timing modules is a timer of its own
+ * in the kernel, so thousands of generators ticking every 20ms mean
+ * thousands of timers being armed and expiring.  This module keeps one
+ * timerfd per CPU instead.  Each drives a wheel of 1ms slots, and a timer
+ * only has an alert pipe the wheel signals when it is due.
+ *
+ * A timer's first tick is aligned to a multiple of its interval on the
+ * wheel's clock, so every timer of the same rate on a wheel expires in the
+ * same slot and they are all signaled from a single wakeup.
+ */
+
+/*** MODULEINFO
+	<depend>timerfd</depend>
+	<defaultenabled>no</defaultenabled>
+	<support_level>extended</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include <sys/timerfd.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "asterisk/module.h"
+#include "asterisk/timing.h"
+#include "asterisk/logger.h"
+#include "asterisk/utils.h"
+#include "asterisk/lock.h"
+#include "asterisk/linkedlists.h"
+#include "asterisk/alertpipe.h"
+#include "asterisk/cli.h"
+
+static void *timing_funcs_handle;
+
+static void *wheel_timer_open(void);
+static void wheel_timer_close(void *data);
+static int wheel_timer_set_rate(void *data, unsigned int rate);
+static int wheel_timer_ack(void *data, unsigned int quantity);
+static int wheel_timer_enable_continuous(void *data);
+static int wheel_timer_disable_continuous(void *data);
+static enum ast_timer_event wheel_timer_get_event(void *data);
+static unsigned int wheel_timer_get_max_rate(void *data);
+static int wheel_timer_fd(void *data);
+
+static struct ast_timing_interface wheel_timing = {
+	.name = "wheel",
+	.priority = 250,
+	.timer_open = wheel_timer_open,
+	.timer_close = wheel_timer_close,
+	.timer_set_rate = wheel_timer_set_rate,
+	.timer_ack = wheel_timer_ack,
+	.timer_enable_continuous = wheel_timer_enable_continuous,
+	.timer_disable_continuous = wheel_timer_disable_continuous,
+	.timer_get_event = wheel_timer_get_event,
+	.timer_get_max_rate = wheel_timer_get_max_rate,
+	.timer_fd = wheel_timer_fd,
+};
+
+/*! One slot per ms, so this is also the highest rate */
+#define WHEEL_MAX_RATE 1000
+
+/*! Number of 1ms slots, more than the longest interval of a timer ticking once a second */
+#define WHEEL_SLOTS 1024
+
+/*! Most wheels, whatever the number of CPUs */
+#define WHEEL_MAX_THREADS 64
+
+struct wheel_thread;
+
+struct wheel_timer {
+	/*! Alert pipe signaled while ticks are pending or the timer is continuous */
+	int pipe[2];
+	/*! The wheel this timer is on, fixed when opened */
+	struct wheel_thread *wheel;
+	/*! Ticks per second, 0 if stopped */
+	unsigned int rate;
+	/*! Wheel tick of the first expiration since the rate was set */
+	uint64_t start;
+	/*! Number of expirations since the rate was set */
+	uint64_t count;
+	/*! Wheel tick of the next expiration */
+	uint64_t due;
+	/*! Expirations not acknowledged yet */
+	unsigned int pending_ticks;
+	unsigned int continuous:1;
+	unsigned int signaled:1;
+	/*! TRUE while linked into a slot */
+	unsigned int scheduled:1;
+	AST_LIST_ENTRY(wheel_timer) entry;
+};
+
+AST_LIST_HEAD_NOLOCK(wheel_slot, wheel_timer);
+
+/*! \brief One wheel and the thread turning it */
+struct wheel_thread {
+	/*! Protects everything here and every timer on this wheel */
+	ast_mutex_t lock;
+	pthread_t thread;
+	/*! Absolute CLOCK_MONOTONIC timer armed for the next slot with a timer in it */
+	int timerfd;
+	/*! The first tick not processed yet */
+	uint64_t current;
+	/*! The tick timerfd is armed for, 0 if disarmed */
+	uint64_t next_wakeup;
+	/*! Timers scheduled on the wheel */
+	unsigned int scheduled;
+	/*! Timers opened on this wheel */
+	unsigned int timers;
+	/*! Number of wakeups */
+	uint64_t wakeups;
+	/*! Number of timer expirations signaled */
+	uint64_t expirations;
+	unsigned int stop:1;
+	struct wheel_slot slots[WHEEL_SLOTS];
+};
+
+/*! \brief The wheels, one per CPU */
+static struct {
+	struct wheel_thread *threads;
+	unsigned int count;
+	/*! Next wheel a timer is opened on */
+	unsigned int next;
+} wheels;
+
+/*! \brief Current CLOCK_MONOTONIC time in wheel ticks */
+static uint64_t wheel_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*!
+ * \internal
+ * \brief Arm the wheel's timerfd for a tick
+ * \pre wheel is locked
+ */
+static void wheel_arm(struct wheel_thread *wheel, uint64_t tick)
+{
+	struct itimerspec its = { { 0, }, };
+
+	if (tick) {
+		its.it_value.tv_sec = tick / 1000;
+		its.it_value.tv_nsec = (tick % 1000) * 1000000;
+	}
+	if (timerfd_settime(wheel->timerfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+		ast_log(LOG_ERROR, "Failed to arm timer wheel: %s\n", strerror(errno));
+	}
+	wheel->next_wakeup = tick;
+}
+
+/*!
+ * \internal
+ * \pre wheel is locked
+ */
+static void signal_timer(struct wheel_timer *timer)
+{
+	if (timer->signaled) {
+		return;
+	}
+	if (ast_alertpipe_write(timer->pipe) == -1) {
+		ast_log(LOG_ERROR, "Error writing to timing alert pipe: %s\n", strerror(errno));
+	} else {
+		timer->signaled = 1;
+	}
+}
+
+/*!
+ * \internal
+ * \pre wheel is locked
+ */
+static void unsignal_timer(struct wheel_timer *timer)
+{
+	if (!timer->signaled) {
+		return;
+	}
+	if (ast_alertpipe_read(timer->pipe) == AST_ALERT_READ_SUCCESS) {
+		timer->signaled = 0;
+	}
+}
+
+/*!
+ * \internal
+ * \brief Put a timer in the slot of its next expiration
+ * \pre wheel is locked
+ */
+static void schedule_timer(struct wheel_thread *wheel, struct wheel_timer *timer)
+{
+	AST_LIST_INSERT_TAIL(&wheel->slots[timer->due % WHEEL_SLOTS], timer, entry);
+	timer->scheduled = 1;
+	++wheel->scheduled;
+
+	/* Bring the wheel's wakeup forward if this timer is due first */
+	if (!wheel->next_wakeup || timer->due < wheel->next_wakeup) {
+		wheel_arm(wheel, timer->due);
+	}
+}
+
+/*!
+ * \internal
+ * \pre wheel is locked
+ */
+static void unschedule_timer(struct wheel_thread *wheel, struct wheel_timer *timer)
+{
+	if (!timer->scheduled) {
+		return;
+	}
+	AST_LIST_REMOVE(&wheel->slots[timer->due % WHEEL_SLOTS], timer, entry);
+	timer->scheduled = 0;
+	--wheel->scheduled;
+}
+
+/*!
+ * \internal
+ * \brief Signal every timer due up to now and schedule its next expiration
+ * \pre wheel is locked
+ */
+static void wheel_turn(struct wheel_thread *wheel, uint64_t now)
+{
+	uint64_t tick = wheel->current;
+	uint64_t end;
+
+	if (now < tick) {
+		/* Nothing new is due, just a timer brought the wakeup forward */
+		now = tick - 1;
+	} else if (now - tick >= WHEEL_SLOTS) {
+		/* After a stall longer than the wheel every slot is visited once */
+		tick = now - (WHEEL_SLOTS - 1);
+	}
+
+	for (; tick <= now; ++tick) {
+		struct wheel_slot *slot = &wheel->slots[tick % WHEEL_SLOTS];
+		struct wheel_slot due = AST_LIST_HEAD_NOLOCK_INIT_VALUE;
+		struct wheel_timer *timer;
+
+		AST_LIST_TRAVERSE_SAFE_BEGIN(slot, timer, entry) {
+			if (timer->due > now) {
+				continue;
+			}
+			AST_LIST_REMOVE_CURRENT(entry);
+			AST_LIST_INSERT_TAIL(&due, timer, entry);
+		}
+		AST_LIST_TRAVERSE_SAFE_END;
+
+		while ((timer = AST_LIST_REMOVE_HEAD(&due, entry))) {
+			timer->scheduled = 0;
+			--wheel->scheduled;
+			do {
+				++timer->pending_ticks;
+				++timer->count;
+				timer->due = timer->start + timer->count * 1000 / timer->rate;
+			} while (timer->due <= now);
+			signal_timer(timer);
+			++wheel->expirations;
+			AST_LIST_INSERT_TAIL(&wheel->slots[timer->due % WHEEL_SLOTS], timer, entry);
+			timer->scheduled = 1;
+			++wheel->scheduled;
+		}
+	}
+	wheel->current = now + 1;
+
+	/* Every timer is due within WHEEL_SLOTS ticks, so the first used slot is the next wakeup */
+	wheel->next_wakeup = 0;
+	if (!wheel->scheduled) {
+		wheel_arm(wheel, 0);
+		return;
+	}
+	for (tick = wheel->current, end = wheel->current + WHEEL_SLOTS; tick < end; ++tick) {
+		if (!AST_LIST_EMPTY(&wheel->slots[tick % WHEEL_SLOTS])) {
+			wheel_arm(wheel, tick);
+			break;
+		}
+	}
+}
+
+static void *wheel_thread_run(void *data)
+{
+	struct wheel_thread *wheel = data;
+	struct pollfd pfd = { .fd = wheel->timerfd, .events = POLLIN, };
+
+	ast_mutex_lock(&wheel->lock);
+	while (!wheel->stop) {
+		uint64_t expirations;
+
+		ast_mutex_unlock(&wheel->lock);
+		if (poll(&pfd, 1, -1) > 0 && read(wheel->timerfd, &expirations, sizeof(expirations)) < 0
+			&& errno != EAGAIN && errno != EINTR) {
+			ast_log(LOG_ERROR, "Failed to read timer wheel: %s\n", strerror(errno));
+		}
+		ast_mutex_lock(&wheel->lock);
+
+		++wheel->wakeups;
+		wheel_turn(wheel, wheel_now());
+	}
+	ast_mutex_unlock(&wheel->lock);
+
+	return NULL;
+}
+
+static void *wheel_timer_open(void)
+{
+	struct wheel_timer *timer;
+	struct wheel_thread *wheel;
+
+	if (!(timer = ast_calloc(1, sizeof(*timer)))) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if (ast_alertpipe_init(timer->pipe)) {
+		ast_free(timer);
+		return NULL;
+	}
+
+	wheel = &wheels.threads[ast_atomic_fetchadd_int((int *) &wheels.next, 1) % wheels.count];
+	timer->wheel = wheel;
+
+	ast_mutex_lock(&wheel->lock);
+	++wheel->timers;
+	ast_mutex_unlock(&wheel->lock);
+
+	return timer;
+}
+
+static void wheel_timer_close(void *data)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+
+	ast_mutex_lock(&wheel->lock);
+	unschedule_timer(wheel, timer);
+	--wheel->timers;
+	ast_mutex_unlock(&wheel->lock);
+
+	ast_alertpipe_close(timer->pipe);
+	ast_free(timer);
+}
+
+static int wheel_timer_set_rate(void *data, unsigned int rate)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+
+	if (rate > WHEEL_MAX_RATE) {
+		ast_log(LOG_ERROR, "res_timing_wheel only supports timers at a "
+				"max rate of %d / sec\n", WHEEL_MAX_RATE);
+		errno = EINVAL;
+		return -1;
+	}
+
+	ast_mutex_lock(&wheel->lock);
+	unschedule_timer(wheel, timer);
+	timer->rate = rate;
+	timer->count = 0;
+	if (rate) {
+		unsigned int interval = MAX(1000 / rate, 1);
+
+		/* Align to the interval so timers sharing a rate share their slots */
+		timer->start = (MAX(wheel_now(), wheel->current) / interval + 1) * interval;
+		timer->due = timer->start;
+		schedule_timer(wheel, timer);
+	}
+	ast_mutex_unlock(&wheel->lock);
+
+	return 0;
+}
+
+static int wheel_timer_ack(void *data, unsigned int quantity)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+
+	ast_assert(quantity > 0);
+
+	ast_mutex_lock(&wheel->lock);
+	timer->pending_ticks -= MIN(quantity, timer->pending_ticks);
+	if (!timer->pending_ticks && !timer->continuous) {
+		unsignal_timer(timer);
+	}
+	ast_mutex_unlock(&wheel->lock);
+
+	return 0;
+}
+
+static int wheel_timer_enable_continuous(void *data)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+
+	ast_mutex_lock(&wheel->lock);
+	if (!timer->continuous) {
+		timer->continuous = 1;
+		signal_timer(timer);
+	}
+	ast_mutex_unlock(&wheel->lock);
+
+	return 0;
+}
+
+static int wheel_timer_disable_continuous(void *data)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+
+	ast_mutex_lock(&wheel->lock);
+	if (timer->continuous) {
+		timer->continuous = 0;
+		if (!timer->pending_ticks) {
+			unsignal_timer(timer);
+		}
+	}
+	ast_mutex_unlock(&wheel->lock);
+
+	return 0;
+}
+
+static enum ast_timer_event wheel_timer_get_event(void *data)
+{
+	struct wheel_timer *timer = data;
+	struct wheel_thread *wheel = timer->wheel;
+	enum ast_timer_event res;
+
+	ast_mutex_lock(&wheel->lock);
+	res = timer->continuous ? AST_TIMING_EVENT_CONTINUOUS : AST_TIMING_EVENT_EXPIRED;
+	ast_mutex_unlock(&wheel->lock);
+
+	return res;
+}
+
+static unsigned int wheel_timer_get_max_rate(void *data)
+{
+	return WHEEL_MAX_RATE;
+}
+
+static int wheel_timer_fd(void *data)
+{
+	struct wheel_timer *timer = data;
+
+	return ast_alertpipe_readfd(timer->pipe);
+}
+
+static char *handle_cli_timing_wheel_show(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	unsigned int idx;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "timing wheel show";
+		e->usage =
+			"Usage: timing wheel show\n"
+			"       Show the timers on each timer wheel, how often it woke up\n"
+			"       and how many timer expirations it signaled.\n";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	if (a->argc != 3) {
+		return CLI_SHOWUSAGE;
+	}
+
+	ast_cli(a->fd, "%-6s %8s %10s %12s %12s %10s\n",
+		"Wheel", "Timers", "Running", "Wakeups", "Expirations", "Per wakeup");
+	for (idx = 0; idx < wheels.count; ++idx) {
+		struct wheel_thread *wheel = &wheels.threads[idx];
+
+		ast_mutex_lock(&wheel->lock);
+		ast_cli(a->fd, "%-6u %8u %10u %12" PRIu64 " %12" PRIu64 " %10.1f\n",
+			idx, wheel->timers, wheel->scheduled, wheel->wakeups, wheel->expirations,
+			wheel->wakeups ? (double) wheel->expirations / wheel->wakeups : 0.0);
+		ast_mutex_unlock(&wheel->lock);
+	}
+
+	return CLI_SUCCESS;
+}
+
+static struct ast_cli_entry cli_timing_wheel[] = {
+	AST_CLI_DEFINE(handle_cli_timing_wheel_show, "Show timer wheel statistics"),
+};
+
+/*! \brief Stop and free the wheels, the first count of which are running */
+static void wheels_destroy(unsigned int count)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < count; ++idx) {
+		struct wheel_thread *wheel = &wheels.threads[idx];
+
+		ast_mutex_lock(&wheel->lock);
+		wheel->stop = 1;
+		/* Any time in the past fires right away */
+		wheel_arm(wheel, 1);
+		ast_mutex_unlock(&wheel->lock);
+		pthread_join(wheel->thread, NULL);
+	}
+
+	for (idx = 0; idx < wheels.count; ++idx) {
+		struct wheel_thread *wheel = &wheels.threads[idx];
+
+		if (wheel->timerfd > -1) {
+			close(wheel->timerfd);
+		}
+		ast_mutex_destroy(&wheel->lock);
+	}
+
+	ast_free(wheels.threads);
+	wheels.threads = NULL;
+	wheels.count = 0;
+}
+
+static int load_module(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int idx;
+
+	wheels.count = MIN(MAX(cpus, 1), WHEEL_MAX_THREADS);
+	if (!(wheels.threads = ast_calloc(wheels.count, sizeof(*wheels.threads)))) {
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	for (idx = 0; idx < wheels.count; ++idx) {
+		struct wheel_thread *wheel = &wheels.threads[idx];
+
+		ast_mutex_init(&wheel->lock);
+		wheel->current = wheel_now();
+		if ((wheel->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0) {
+			ast_log(LOG_ERROR, "timerfd_create() not supported by the kernel.  Not loading.\n");
+			wheels_destroy(0);
+			return AST_MODULE_LOAD_DECLINE;
+		}
+	}
+
+	for (idx = 0; idx < wheels.count; ++idx) {
+		if (ast_pthread_create_background(&wheels.threads[idx].thread, NULL,
+			wheel_thread_run, &wheels.threads[idx])) {
+			ast_log(LOG_ERROR, "Unable to start timer wheel thread.\n");
+			wheels_destroy(idx);
+			return AST_MODULE_LOAD_DECLINE;
+		}
+	}
+
+	if (!(timing_funcs_handle = ast_register_timing_interface(&wheel_timing))) {
+		wheels_destroy(wheels.count);
+		return AST_MODULE_LOAD_DECLINE;
+	}
+
+	ast_cli_register_multiple(cli_timing_wheel, ARRAY_LEN(cli_timing_wheel));
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+static int unload_module(void)
+{
+	int res;
+
+	if ((res = ast_unregister_timing_interface(timing_funcs_handle))) {
+		return res;
+	}
+
+	ast_cli_unregister_multiple(cli_timing_wheel, ARRAY_LEN(cli_timing_wheel));
+	wheels_destroy(wheels.count);
+
+	return 0;
+}
+
+AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_LOAD_ORDER, "Timer Wheel Timing Interface",
+	.support_level = AST_MODULE_SUPPORT_EXTENDED,
+	.load = load_module,
+	.unload = unload_module,
+	.load_pri = AST_MODPRI_TIMING,
+);
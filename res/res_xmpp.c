@@ -61,6 +61,7 @@
 #include "asterisk/cli.h"
 #include "asterisk/config_options.h"
 #include "asterisk/json.h"
+#include "asterisk/taskprocessor.h"
 
 /*** DOCUMENTATION
 	<application name="JabberSend" language="en_US" module="res_xmpp">
@@ -420,7 +421,7 @@ enum {
 #define CLIENT_BUCKETS 53
 
 /*! \brief Number of buckets for buddies (per client) */
-#define BUDDY_BUCKETS 53
+#define BUDDY_BUCKETS 1567
 
 /*! \brief Number of buckets for resources (per buddy) */
 #define RESOURCE_BUCKETS 53
@@ -566,6 +567,120 @@ static void xmpp_client_destructor(void *obj)
 		xmpp_message_destroy(message);
 	}
 	AST_LIST_HEAD_DESTROY(&client->messages);
+
+	AST_VECTOR_CALLBACK_VOID(&client->devstate_queue, ao2_ref, -1);
+	AST_VECTOR_FREE(&client->devstate_queue);
+	ao2_cleanup(client->devstates);
+	ast_taskprocessor_unreference(client->devstate_serializer);
+}
+
+/*! \brief The device state of a buddy, published in batches */
+struct ast_xmpp_buddy_devstate {
+	/*! The state to publish */
+	enum ast_device_state pending;
+	/*! The state last published, AST_DEVICE_TOTAL if none was */
+	enum ast_device_state published;
+	/*! Whether it is in the queue of the client */
+	unsigned int queued:1;
+	/*! JID of the buddy */
+	char id[0];
+};
+
+AO2_STRING_FIELD_HASH_FN(ast_xmpp_buddy_devstate, id);
+AO2_STRING_FIELD_CMP_FN(ast_xmpp_buddy_devstate, id);
+
+/*! \brief Serializer task publishing the queued device states of a client */
+static int xmpp_client_publish_devstates(void *data)
+{
+	struct ast_xmpp_client *client = data;
+	struct ast_xmpp_devstate_queue queue;
+	int i;
+
+	ao2_lock(client->devstates);
+	queue = client->devstate_queue;
+	AST_VECTOR_INIT(&client->devstate_queue, 0);
+	ao2_unlock(client->devstates);
+
+	for (i = 0; i < AST_VECTOR_SIZE(&queue); i++) {
+		struct ast_xmpp_buddy_devstate *devstate = AST_VECTOR_GET(&queue, i);
+		enum ast_device_state state;
+		int changed;
+
+		/* Presence received since it was queued is published along with it */
+		ao2_lock(client->devstates);
+		state = devstate->pending;
+		changed = state != devstate->published;
+		devstate->published = state;
+		devstate->queued = 0;
+		ao2_unlock(client->devstates);
+
+		if (changed) {
+			ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "XMPP/%s/%s", client->name, devstate->id);
+		}
+		ao2_ref(devstate, -1);
+	}
+	AST_VECTOR_FREE(&queue);
+
+	ao2_ref(client, -1);
+
+	return 0;
+}
+
+/*!
+ * \brief Queue the device state of a buddy to be published
+ *
+ * The states are published in batches by the serializer of the client, so
+ * a flood of presence does not hold up the client thread.  A buddy whose
+ * presence changes several times before the batch goes out is published
+ * once, and not at all if its state ends up unchanged.
+ */
+static void xmpp_client_queue_devstate(struct ast_xmpp_client *client, const char *id,
+	enum ast_device_state state)
+{
+	struct ast_xmpp_buddy_devstate *devstate;
+	int push = 0;
+
+	if (!client->devstate_serializer) {
+		ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "XMPP/%s/%s", client->name, id);
+		return;
+	}
+
+	ao2_lock(client->devstates);
+	devstate = ao2_find(client->devstates, id, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!devstate) {
+		devstate = ao2_alloc_options(sizeof(*devstate) + strlen(id) + 1, NULL,
+			AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!devstate) {
+			ao2_unlock(client->devstates);
+			ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "XMPP/%s/%s", client->name, id);
+			return;
+		}
+		strcpy(devstate->id, id); /* Safe */
+		devstate->published = AST_DEVICE_TOTAL;
+		ao2_link_flags(client->devstates, devstate, OBJ_NOLOCK);
+	}
+
+	devstate->pending = state;
+	if (!devstate->queued) {
+		if (AST_VECTOR_APPEND(&client->devstate_queue, devstate)) {
+			ao2_unlock(client->devstates);
+			ao2_ref(devstate, -1);
+			ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "XMPP/%s/%s", client->name, id);
+			return;
+		}
+		devstate->queued = 1;
+		/* The queue reference is the one ao2_find() or the allocation gave */
+		devstate = NULL;
+		/* A batch is already on its way unless this is the first entry */
+		push = AST_VECTOR_SIZE(&client->devstate_queue) == 1;
+	}
+	ao2_unlock(client->devstates);
+	ao2_cleanup(devstate);
+
+	if (push && ast_taskprocessor_push(client->devstate_serializer, xmpp_client_publish_devstates, ao2_bump(client))) {
+		/* Publish right here instead, this drops the reference */
+		xmpp_client_publish_devstates(client);
+	}
 }
 
 /*! \brief Hashing function for XMPP buddy */
@@ -604,6 +719,7 @@ static void xmpp_client_change_state(struct ast_xmpp_client *client, int state)
 static struct ast_xmpp_client *xmpp_client_alloc(const char *name)
 {
 	struct ast_xmpp_client *client;
+	char tps_name[AST_TASKPROCESSOR_MAX_NAME + 1];
 
 	if (!(client = ao2_alloc(sizeof(*client), xmpp_client_destructor))) {
 		return NULL;
@@ -626,6 +742,23 @@ static struct ast_xmpp_client *xmpp_client_alloc(const char *name)
 		return NULL;
 	}
 
+	client->devstates = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0, BUDDY_BUCKETS,
+		ast_xmpp_buddy_devstate_hash_fn, NULL, ast_xmpp_buddy_devstate_cmp_fn);
+	if (!client->devstates) {
+		ast_log(LOG_ERROR, "Could not initialize device state container for '%s'\n", name);
+		ao2_ref(client, -1);
+		return NULL;
+	}
+
+	if (AST_VECTOR_INIT(&client->devstate_queue, 0)) {
+		ao2_ref(client, -1);
+		return NULL;
+	}
+
+	snprintf(tps_name, sizeof(tps_name), "xmpp:devstate-%s", name);
+	/* Without it the device states are published as presence arrives */
+	client->devstate_serializer = ast_taskprocessor_get(tps_name, TPS_REF_DEFAULT);
+
 	if (ast_string_field_init(client, 512)) {
 		ast_log(LOG_ERROR, "Could not initialize stringfields for '%s'\n", name);
 		ao2_ref(client, -1);
@@ -3386,7 +3519,7 @@ static int xmpp_pak_presence(struct ast_xmpp_client *client, struct ast_xmpp_cli
 
 	ao2_ref(buddy, -1);
 
-	ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "XMPP/%s/%s", client->name, pak->from->partial);
+	xmpp_client_queue_devstate(client, pak->from->partial, state);
 
 	return 0;
 }
@@ -51,8 +51,6 @@ struct stasis_app {
 	struct stasis_topic *topic;
 	/*! Router for handling messages forwarded to \a topic. */
 	struct stasis_message_router *router;
-	/*! Router for handling messages to the bridge all \a topic. */
-	struct stasis_message_router *bridge_router;
 	/*! Optional router for handling endpoint messages in 'all' subscriptions */
 	struct stasis_message_router *endpoint_router;
 	/*! Container of the channel forwards to this app's topic. */
@@ -149,7 +147,7 @@ static struct app_forwards *forwards_create_channel(struct stasis_app *app,
 
 	forwards->forward_type = FORWARD_CHANNEL;
 	forwards->topic_forward = stasis_forward_all(
-		chan ? ast_channel_topic(chan) : ast_channel_topic_all(),
+		ast_channel_own_topic(chan),
 		app->topic);
 
 	if (!forwards->topic_forward) {
@@ -293,7 +291,6 @@ static void app_dtor(void *obj)
 	ast_verb(1, "Destroying Stasis app %s\n", app->name);
 
 	ast_assert(app->router == NULL);
-	ast_assert(app->bridge_router == NULL);
 	ast_assert(app->endpoint_router == NULL);
 
 	/* If we created a context for this application, remove it */
@@ -716,127 +713,254 @@ static void sub_bridge_update_handler(void *data,
 }
 
 
-/*! \brief Helper function for determining if the application is subscribed to a given entity */
-static int bridge_app_subscribed(struct stasis_app *app, const char *uniqueid)
+/*! Apps subscribed to one channel, bridge or endpoint */
+struct app_index_entry {
+	/*! The subscribed apps, each holding a reference */
+	AST_VECTOR(, struct stasis_app *) apps;
+	/*! Unique id of the channel, bridge or endpoint */
+	char id[];
+};
+
+/*! Apps collected for one message from \ref app_index */
+AST_VECTOR(app_index_matches, struct stasis_app *);
+
+#define APP_INDEX_BUCKETS 127
+
+/*!
+ * \brief Subscribed apps by the id of what they are subscribed to
+ *
+ * This mirrors the forwards of every app, so a message that concerns a
+ * few ids goes to the apps subscribed to them without asking each app.
+ */
+static struct ao2_container *app_index;
+
+/*! Router for the bridge messages dispatched through \ref app_index */
+static struct stasis_message_router *app_index_bridge_router;
+
+AO2_STRING_FIELD_HASH_FN(app_index_entry, id)
+AO2_STRING_FIELD_CMP_FN(app_index_entry, id)
+
+static void app_index_entry_dtor(void *obj)
 {
-	struct app_forwards *forwards = NULL;
+	struct app_index_entry *entry = obj;
 
-	forwards = ao2_find(app->forwards, uniqueid, OBJ_SEARCH_KEY);
-	if (!forwards) {
-		return 0;
+	AST_VECTOR_CALLBACK_VOID(&entry->apps, ao2_cleanup);
+	AST_VECTOR_FREE(&entry->apps);
+}
+
+/*! \brief Add an app to the index, with the app's forwards locked */
+static int app_index_add(struct stasis_app *app, const char *id)
+{
+	struct app_index_entry *entry;
+	int res = -1;
+
+	ao2_lock(app_index);
+	entry = ao2_find(app_index, id, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!entry) {
+		entry = ao2_alloc_options(sizeof(*entry) + strlen(id) + 1,
+			app_index_entry_dtor, AO2_ALLOC_OPT_LOCK_NOLOCK);
+		if (!entry || AST_VECTOR_INIT(&entry->apps, 1)) {
+			goto done;
+		}
+		strcpy(entry->id, id); /* SAFE */
+		if (!ao2_link_flags(app_index, entry, OBJ_NOLOCK)) {
+			goto done;
+		}
 	}
 
-	ao2_ref(forwards, -1);
-	return 1;
+	if (!AST_VECTOR_APPEND(&entry->apps, app)) {
+		ao2_ref(app, +1);
+		res = 0;
+	}
+
+done:
+	ao2_unlock(app_index);
+	ao2_cleanup(entry);
+
+	return res;
 }
 
-static void bridge_merge_handler(void *data, struct stasis_subscription *sub,
-	struct stasis_message *message)
+/*! \brief Remove an app from the index, with the app's forwards locked */
+static void app_index_remove(struct stasis_app *app, const char *id)
 {
-	struct stasis_app *app = data;
-	struct ast_bridge_merge_message *merge;
+	struct app_index_entry *entry;
+
+	ao2_lock(app_index);
+	entry = ao2_find(app_index, id, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (entry) {
+		AST_VECTOR_REMOVE_CMP_UNORDERED(&entry->apps, app,
+			AST_VECTOR_ELEM_DEFAULT_CMP, ao2_cleanup);
+		if (!AST_VECTOR_SIZE(&entry->apps)) {
+			ao2_unlink_flags(app_index, entry, OBJ_NOLOCK);
+		}
+		ao2_ref(entry, -1);
+	}
+	ao2_unlock(app_index);
+}
 
-	merge = stasis_message_data(message);
+/*! \brief Collect the apps subscribed to an id, with the index locked */
+static void app_index_collect(struct app_index_matches *matches, const char *id)
+{
+	struct app_index_entry *entry;
+	int i;
 
-	/* Find out if we're subscribed to either bridge */
-	if (bridge_app_subscribed(app, merge->from->uniqueid) ||
-		bridge_app_subscribed(app, merge->to->uniqueid)) {
-		/* Forward the message to the app */
-		stasis_publish(app->topic, message);
+	entry = ao2_find(app_index, id, OBJ_SEARCH_KEY | OBJ_NOLOCK);
+	if (!entry) {
+		return;
+	}
+
+	for (i = 0; i < AST_VECTOR_SIZE(&entry->apps); ++i) {
+		struct stasis_app *app = AST_VECTOR_GET(&entry->apps, i);
+
+		if (AST_VECTOR_GET_CMP(matches, app, AST_VECTOR_ELEM_DEFAULT_CMP)) {
+			continue;
+		}
+		if (!AST_VECTOR_APPEND(matches, app)) {
+			ao2_ref(app, +1);
+		}
 	}
+	ao2_ref(entry, -1);
 }
 
-/*! \brief Callback function for checking if channels in a bridge are subscribed to */
-static int bridge_app_subscribed_involved(struct stasis_app *app, struct ast_bridge_snapshot *snapshot)
+/*! \brief Collect the apps subscribed to a bridge or any channel in it, with the index locked */
+static void app_index_collect_bridge(struct app_index_matches *matches,
+	struct ast_bridge_snapshot *snapshot)
 {
-	int subscribed = 0;
 	struct ao2_iterator iter;
 	char *uniqueid;
 
-	if (bridge_app_subscribed(app, snapshot->uniqueid)) {
-		return 1;
+	if (!snapshot) {
+		return;
 	}
 
+	app_index_collect(matches, snapshot->uniqueid);
+
 	iter = ao2_iterator_init(snapshot->channels, 0);
 	for (; (uniqueid = ao2_iterator_next(&iter)); ao2_ref(uniqueid, -1)) {
-		if (bridge_app_subscribed(app, uniqueid)) {
-			subscribed = 1;
-			ao2_ref(uniqueid, -1);
-			break;
-		}
+		app_index_collect(matches, uniqueid);
 	}
 	ao2_iterator_destroy(&iter);
+}
+
+/*! \brief Forward a message to the collected apps */
+static void app_index_publish(struct app_index_matches *matches,
+	struct stasis_message *message)
+{
+	int i;
 
-	return subscribed;
+	for (i = 0; i < AST_VECTOR_SIZE(matches); ++i) {
+		stasis_publish(AST_VECTOR_GET(matches, i)->topic, message);
+	}
+	AST_VECTOR_CALLBACK_VOID(matches, ao2_ref, -1);
+	AST_VECTOR_FREE(matches);
+}
+
+static void bridge_merge_handler(void *data, struct stasis_subscription *sub,
+	struct stasis_message *message)
+{
+	struct ast_bridge_merge_message *merge = stasis_message_data(message);
+	struct app_index_matches matches;
+
+	AST_VECTOR_INIT(&matches, 0);
+
+	/* Forward the message to the apps subscribed to either bridge */
+	ao2_lock(app_index);
+	app_index_collect(&matches, merge->from->uniqueid);
+	app_index_collect(&matches, merge->to->uniqueid);
+	ao2_unlock(app_index);
+
+	app_index_publish(&matches, message);
 }
 
 static void bridge_blind_transfer_handler(void *data, struct stasis_subscription *sub,
 	struct stasis_message *message)
 {
-	struct stasis_app *app = data;
 	struct ast_blind_transfer_message *transfer_msg = stasis_message_data(message);
-	struct ast_bridge_snapshot *bridge = transfer_msg->bridge;
+	struct app_index_matches matches;
 
-	if (bridge_app_subscribed(app, transfer_msg->transferer->base->uniqueid) ||
-		(bridge && bridge_app_subscribed_involved(app, bridge))) {
-		stasis_publish(app->topic, message);
-	}
+	AST_VECTOR_INIT(&matches, 0);
+
+	ao2_lock(app_index);
+	app_index_collect(&matches, transfer_msg->transferer->base->uniqueid);
+	app_index_collect_bridge(&matches, transfer_msg->bridge);
+	ao2_unlock(app_index);
+
+	app_index_publish(&matches, message);
 }
 
 static void bridge_attended_transfer_handler(void *data, struct stasis_subscription *sub,
 	struct stasis_message *message)
 {
-	struct stasis_app *app = data;
 	struct ast_attended_transfer_message *transfer_msg = stasis_message_data(message);
-	int subscribed = 0;
+	struct app_index_matches matches;
 
-	subscribed = bridge_app_subscribed(app, transfer_msg->to_transferee.channel_snapshot->base->uniqueid);
-	if (!subscribed) {
-		subscribed = bridge_app_subscribed(app, transfer_msg->to_transfer_target.channel_snapshot->base->uniqueid);
-	}
-	if (!subscribed && transfer_msg->to_transferee.bridge_snapshot) {
-		subscribed = bridge_app_subscribed_involved(app, transfer_msg->to_transferee.bridge_snapshot);
-	}
-	if (!subscribed && transfer_msg->to_transfer_target.bridge_snapshot) {
-		subscribed = bridge_app_subscribed_involved(app, transfer_msg->to_transfer_target.bridge_snapshot);
-	}
+	AST_VECTOR_INIT(&matches, 0);
 
-	if (!subscribed) {
-		switch (transfer_msg->dest_type) {
-		case AST_ATTENDED_TRANSFER_DEST_BRIDGE_MERGE:
-			subscribed = bridge_app_subscribed(app, transfer_msg->dest.bridge);
-			break;
-		case AST_ATTENDED_TRANSFER_DEST_LINK:
-			subscribed = bridge_app_subscribed(app, transfer_msg->dest.links[0]->base->uniqueid);
-			if (!subscribed) {
-				subscribed = bridge_app_subscribed(app, transfer_msg->dest.links[1]->base->uniqueid);
-			}
-			break;
+	ao2_lock(app_index);
+	app_index_collect(&matches, transfer_msg->to_transferee.channel_snapshot->base->uniqueid);
+	app_index_collect(&matches, transfer_msg->to_transfer_target.channel_snapshot->base->uniqueid);
+	app_index_collect_bridge(&matches, transfer_msg->to_transferee.bridge_snapshot);
+	app_index_collect_bridge(&matches, transfer_msg->to_transfer_target.bridge_snapshot);
+
+	switch (transfer_msg->dest_type) {
+	case AST_ATTENDED_TRANSFER_DEST_BRIDGE_MERGE:
+		app_index_collect(&matches, transfer_msg->dest.bridge);
+		break;
+	case AST_ATTENDED_TRANSFER_DEST_LINK:
+		app_index_collect(&matches, transfer_msg->dest.links[0]->base->uniqueid);
+		app_index_collect(&matches, transfer_msg->dest.links[1]->base->uniqueid);
+		break;
+	case AST_ATTENDED_TRANSFER_DEST_THREEWAY:
+		app_index_collect_bridge(&matches, transfer_msg->dest.threeway.bridge_snapshot);
+		app_index_collect(&matches, transfer_msg->dest.threeway.channel_snapshot->base->uniqueid);
+		break;
+	default:
 		break;
-		case AST_ATTENDED_TRANSFER_DEST_THREEWAY:
-			subscribed = bridge_app_subscribed_involved(app, transfer_msg->dest.threeway.bridge_snapshot);
-			if (!subscribed) {
-				subscribed = bridge_app_subscribed(app, transfer_msg->dest.threeway.channel_snapshot->base->uniqueid);
-			}
-			break;
-		default:
-			break;
-		}
 	}
+	ao2_unlock(app_index);
 
-	if (subscribed) {
-		stasis_publish(app->topic, message);
-	}
+	app_index_publish(&matches, message);
 }
 
-static void bridge_subscription_change_handler(void *data, struct stasis_subscription *sub,
-	struct stasis_message *message)
+int app_index_init(void)
 {
-	struct stasis_app *app = data;
+	int res = 0;
 
-	if (stasis_subscription_final_message(sub, message)) {
-		ao2_cleanup(app);
+	app_index = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		APP_INDEX_BUCKETS, app_index_entry_hash_fn, NULL, app_index_entry_cmp_fn);
+	if (!app_index) {
+		return -1;
+	}
+
+	app_index_bridge_router = stasis_message_router_create(ast_bridge_topic_all());
+	if (!app_index_bridge_router) {
+		app_index_cleanup();
+		return -1;
+	}
+
+	res |= stasis_message_router_add(app_index_bridge_router,
+		ast_bridge_merge_message_type(), bridge_merge_handler, NULL);
+
+	res |= stasis_message_router_add(app_index_bridge_router,
+		ast_blind_transfer_type(), bridge_blind_transfer_handler, NULL);
+
+	res |= stasis_message_router_add(app_index_bridge_router,
+		ast_attended_transfer_type(), bridge_attended_transfer_handler, NULL);
+
+	if (res) {
+		app_index_cleanup();
+		return -1;
 	}
+
+	return 0;
+}
+
+void app_index_cleanup(void)
+{
+	stasis_message_router_unsubscribe_and_join(app_index_bridge_router);
+	app_index_bridge_router = NULL;
+	ao2_cleanup(app_index);
+	app_index = NULL;
 }
 
 void stasis_app_set_debug(struct stasis_app *app, int debug)
@@ -952,29 +1076,6 @@ struct stasis_app *app_create(const char *name, stasis_app_cb handler, void *dat
 		return NULL;
 	}
 
-	app->bridge_router = stasis_message_router_create(ast_bridge_topic_all());
-	if (!app->bridge_router) {
-		return NULL;
-	}
-
-	res |= stasis_message_router_add(app->bridge_router,
-		ast_bridge_merge_message_type(), bridge_merge_handler, app);
-
-	res |= stasis_message_router_add(app->bridge_router,
-		ast_blind_transfer_type(), bridge_blind_transfer_handler, app);
-
-	res |= stasis_message_router_add(app->bridge_router,
-		ast_attended_transfer_type(), bridge_attended_transfer_handler, app);
-
-	res |= stasis_message_router_add(app->bridge_router,
-		stasis_subscription_change_type(), bridge_subscription_change_handler, app);
-
-	if (res != 0) {
-		return NULL;
-	}
-	/* Bridge router holds a reference */
-	ao2_ref(app, +1);
-
 	app->router = stasis_message_router_create(app->topic);
 	if (!app->router) {
 		return NULL;
@@ -1083,8 +1184,6 @@ void app_shutdown(struct stasis_app *app)
 
 	stasis_message_router_unsubscribe(app->router);
 	app->router = NULL;
-	stasis_message_router_unsubscribe(app->bridge_router);
-	app->bridge_router = NULL;
 	stasis_message_router_unsubscribe(app->endpoint_router);
 	app->endpoint_router = NULL;
 
@@ -1278,6 +1377,28 @@ struct ast_json *app_to_json(const struct stasis_app *app)
 	return json;
 }
 
+/*!
+ * \brief Add new forwards to an app and to the index, with the forwards locked
+ *
+ * \retval 0 on success
+ * \retval -1 on failure, with the forwards cancelled
+ */
+static int forwards_link(struct stasis_app *app, struct app_forwards *forwards)
+{
+	if (!ao2_link_flags(app->forwards, forwards, OBJ_NOLOCK)) {
+		forwards_unsubscribe(forwards);
+		return -1;
+	}
+
+	if (app_index_add(app, forwards->id)) {
+		ao2_unlink_flags(app->forwards, forwards, OBJ_NOLOCK);
+		forwards_unsubscribe(forwards);
+		return -1;
+	}
+
+	return 0;
+}
+
 int app_subscribe_channel(struct stasis_app *app, struct ast_channel *chan)
 {
 	struct app_forwards *forwards;
@@ -1300,8 +1421,6 @@ int app_subscribe_channel(struct stasis_app *app, struct ast_channel *chan)
 		chan ? ast_channel_uniqueid(chan) : CHANNEL_ALL,
 		OBJ_SEARCH_KEY | OBJ_NOLOCK);
 	if (!forwards) {
-		int res;
-
 		/* Forwards not found, create one */
 		forwards = forwards_create_channel(app, chan);
 		if (!forwards) {
@@ -1310,8 +1429,7 @@ int app_subscribe_channel(struct stasis_app *app, struct ast_channel *chan)
 			return -1;
 		}
 
-		res = ao2_link_flags(app->forwards, forwards, OBJ_NOLOCK);
-		if (!res) {
+		if (forwards_link(app, forwards)) {
 			ao2_unlock(app->forwards);
 			ao2_ref(forwards, -1);
 
@@ -1370,6 +1488,7 @@ static int unsubscribe(struct stasis_app *app, const char *kind, const char *id,
 		ao2_find(app->forwards, forwards,
 			OBJ_POINTER | OBJ_NOLOCK | OBJ_UNLINK |
 			OBJ_NODATA);
+		app_index_remove(app, forwards->id);
 
 		if (!strcmp(kind, "endpoint")) {
 			messaging_app_unsubscribe_endpoint(app->name, id);
@@ -1447,8 +1566,6 @@ int app_subscribe_bridge(struct stasis_app *app, struct ast_bridge *bridge)
 		bridge ? bridge->uniqueid : BRIDGE_ALL,
 		OBJ_SEARCH_KEY | OBJ_NOLOCK);
 	if (!forwards) {
-		int res;
-
 		/* Forwards not found, create one */
 		forwards = forwards_create_bridge(app, bridge);
 		if (!forwards) {
@@ -1457,8 +1574,7 @@ int app_subscribe_bridge(struct stasis_app *app, struct ast_bridge *bridge)
 			return -1;
 		}
 
-		res = ao2_link_flags(app->forwards, forwards, OBJ_NOLOCK);
-		if (!res) {
+		if (forwards_link(app, forwards)) {
 			ao2_unlock(app->forwards);
 			ao2_ref(forwards, -1);
 
@@ -1550,8 +1666,6 @@ int app_subscribe_endpoint(struct stasis_app *app, struct ast_endpoint *endpoint
 		endpoint ? ast_endpoint_get_id(endpoint) : ENDPOINT_ALL,
 		OBJ_SEARCH_KEY | OBJ_NOLOCK);
 	if (!forwards) {
-		int res;
-
 		/* Forwards not found, create one */
 		forwards = forwards_create_endpoint(app, endpoint);
 		if (!forwards) {
@@ -1560,8 +1674,7 @@ int app_subscribe_endpoint(struct stasis_app *app, struct ast_endpoint *endpoint
 			return -1;
 		}
 
-		res = ao2_link_flags(app->forwards, forwards, OBJ_NOLOCK);
-		if (!res) {
+		if (forwards_link(app, forwards)) {
 			ao2_unlock(app->forwards);
 			ao2_ref(forwards, -1);
 
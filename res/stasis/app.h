@@ -49,6 +49,19 @@ enum stasis_app_subscription_model {
 	STASIS_APP_SUBSCRIBE_ALL
 };
 
+/*!
+ * \brief Initialize the index of apps by what they are subscribed to.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+int app_index_init(void);
+
+/*!
+ * \brief Tear down the index of apps by what they are subscribed to.
+ */
+void app_index_cleanup(void);
+
 /*!
  * \brief Create a res_stasis application.
  *
@@ -27,8 +27,10 @@
 
 #include "command.h"
 
+#include "asterisk/cli.h"
 #include "asterisk/lock.h"
 #include "asterisk/stasis_app_impl.h"
+#include "asterisk/time.h"
 
 struct stasis_app_command {
 	ast_mutex_t lock;
@@ -36,10 +38,20 @@ struct stasis_app_command {
 	stasis_app_command_cb callback;
 	void *data;
 	command_data_destructor_fn data_destructor;
+	/*! When the command was queued */
+	struct timeval queued;
 	int retval;
 	unsigned int is_done:1;
 };
 
+/*! Upper bounds, in microseconds, of the command latency buckets */
+static const int64_t latency_bounds[] = {
+	100, 1000, 5000, 20000, 50000, 200000, 1000000,
+};
+
+/*! Commands counted in each latency bucket, the last for those beyond every bound */
+static int latency_counts[ARRAY_LEN(latency_bounds) + 1];
+
 static void command_dtor(void *obj)
 {
 	struct stasis_app_command *command = obj;
@@ -57,7 +69,9 @@ struct stasis_app_command *command_create(
 {
 	struct stasis_app_command *command;
 
-	command = ao2_alloc(sizeof(*command), command_dtor);
+	/* The command has its own lock for joining, the ao2 one would go unused */
+	command = ao2_alloc_options(sizeof(*command), command_dtor,
+		AO2_ALLOC_OPT_LOCK_NOLOCK);
 	if (!command) {
 		if (data_destructor) {
 			data_destructor(data);
@@ -70,10 +84,39 @@ struct stasis_app_command *command_create(
 	command->callback = callback;
 	command->data = data;
 	command->data_destructor = data_destructor;
+	command->queued = ast_tvnow();
 
 	return command;
 }
 
+void command_latency_observe(struct stasis_app_command *command)
+{
+	int64_t latency = ast_tvdiff_us(ast_tvnow(), command->queued);
+	int i = 0;
+
+	while (i < ARRAY_LEN(latency_bounds) && latency >= latency_bounds[i]) {
+		++i;
+	}
+	ast_atomic_fetchadd_int(&latency_counts[i], 1);
+}
+
+void stasis_app_command_latency_to_cli(struct ast_cli_args *a)
+{
+	int i;
+
+	ast_cli(a->fd, "Time from queueing a control command to running it:\n");
+	for (i = 0; i < ARRAY_LEN(latency_counts); ++i) {
+		char bound[32];
+
+		if (i < ARRAY_LEN(latency_bounds)) {
+			snprintf(bound, sizeof(bound), "< %" PRId64 " us", latency_bounds[i]);
+		} else {
+			snprintf(bound, sizeof(bound), ">= %" PRId64 " us", latency_bounds[i - 1]);
+		}
+		ast_cli(a->fd, "  %-14s %d\n", bound, latency_counts[i]);
+	}
+}
+
 void command_complete(struct stasis_app_command *command, int retval)
 {
 	ast_mutex_lock(&command->lock);
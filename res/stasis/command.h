@@ -42,6 +42,13 @@ void command_invoke(struct stasis_app_command *command,
 
 int command_join(struct stasis_app_command *command);
 
+/*!
+ * \brief Count the time a command waited in a control's queue
+ *
+ * \param command The command about to be run.
+ */
+void command_latency_observe(struct stasis_app_command *command);
+
 /*!
  * \brief Queue a Stasis() prestart command for a channel
  *
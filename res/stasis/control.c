@@ -48,6 +48,9 @@ AST_LIST_HEAD(app_control_rules, stasis_app_control_rule);
  */
 static int shutting_down;
 
+/*! Most commands taken off a control's queue at once */
+#define CONTROL_DISPATCH_BATCH 16
+
 struct stasis_app_control {
 	ast_cond_t wait_cond;
 	/*! Queue of commands to dispatch on the channel */
@@ -291,8 +294,14 @@ static struct stasis_app_command *exec_command_on_condition(
 		return command;
 	}
 
+	/*
+	 * The channel thread only waits on an empty queue and drains all of
+	 * it once woken, so commands queued behind another ride its wake-up.
+	 */
+	if (!ao2_container_count(control->command_queue)) {
+		ast_cond_signal(&control->wait_cond);
+	}
 	ao2_link_flags(control->command_queue, command, OBJ_NOLOCK);
-	ast_cond_signal(&control->wait_cond);
 	ao2_unlock(control->command_queue);
 
 	return command;
@@ -1495,19 +1504,33 @@ void control_flush_queue(struct stasis_app_control *control)
 int control_dispatch_all(struct stasis_app_control *control,
 	struct ast_channel *chan)
 {
+	struct stasis_app_command *batch[CONTROL_DISPATCH_BATCH];
 	int count = 0;
-	struct ao2_iterator iter;
-	struct stasis_app_command *command;
 
 	ast_assert(control->channel == chan);
 
-	iter = ao2_iterator_init(control->command_queue, AO2_ITERATOR_UNLINK);
-	while ((command = ao2_iterator_next(&iter))) {
-		command_invoke(command, control, chan);
-		ao2_ref(command, -1);
-		++count;
+	/* Called for every frame, so an empty queue is checked without locking it */
+	while (ao2_container_count(control->command_queue)) {
+		struct ao2_iterator iter;
+		int batched = 0;
+		int i;
+
+		ao2_lock(control->command_queue);
+		iter = ao2_iterator_init(control->command_queue,
+			AO2_ITERATOR_UNLINK | AO2_ITERATOR_DONTLOCK);
+		while (batched < ARRAY_LEN(batch) && (batch[batched] = ao2_iterator_next(&iter))) {
+			++batched;
+		}
+		ao2_iterator_destroy(&iter);
+		ao2_unlock(control->command_queue);
+
+		for (i = 0; i < batched; ++i) {
+			command_latency_observe(batch[i]);
+			command_invoke(batch[i], control, chan);
+			ao2_ref(batch[i], -1);
+		}
+		count += batched;
 	}
-	ao2_iterator_destroy(&iter);
 
 	return count;
 }
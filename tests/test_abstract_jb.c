@@ -189,7 +189,7 @@ static struct ast_jb default_jb = {
  * \brief Test nominal construction of a jitter buffer
  *
  * \param type_name The enum type of the jitter buffer to create
- * \param literal_type_name The literal name of the type - "fixed" or "adaptive"
+ * \param literal_type_name The literal name of the type - "fixed", "adaptive" or "ring"
  */
 #define test_create_nominal(type_name, literal_type_name) AST_TEST_DEFINE(TEST_NAME(type_name, create)) {\
 	RAII_VAR(struct ast_jb *, jb, &default_jb, dispose_jitterbuffer); \
@@ -228,7 +228,7 @@ static struct ast_jb default_jb = {
  * \brief Test putting the initial frame into a jitter buffer
  *
  * \param type_name The enum type of the jitter buffer to create
- * \param literal_type_name The literal name of the type - "fixed" or "adaptive"
+ * \param literal_type_name The literal name of the type - "fixed", "adaptive" or "ring"
  */
 #define test_put_first(type_name, literal_type_name) AST_TEST_DEFINE(TEST_NAME(type_name,  put_first)) {\
 	RAII_VAR(struct ast_jb *, jb, &default_jb, dispose_jitterbuffer); \
@@ -287,7 +287,7 @@ static struct ast_jb default_jb = {
  * \brief Test putting a voice frames into a jitter buffer
  *
  * \param type_name The enum type of the jitter buffer to create
- * \param literal_type_name The literal name of the type - "fixed" or "adaptive"
+ * \param literal_type_name The literal name of the type - "fixed", "adaptive" or "ring"
  */
 #define test_put(type_name, literal_type_name) AST_TEST_DEFINE(TEST_NAME(type_name, put)) {\
 	RAII_VAR(struct ast_jb *, jb, &default_jb, dispose_jitterbuffer); \
@@ -352,7 +352,7 @@ static struct ast_jb default_jb = {
  * \brief Test overflowing the limits of a jitter buffer
  *
  * \param type_name The enum type of the jitter buffer to create
- * \param literal_type_name The literal name of the type - "fixed" or "adaptive"
+ * \param literal_type_name The literal name of the type - "fixed", "adaptive" or "ring"
  * \param overflow_limit The number of frames at which we expect the buffer to overflow
  */
 #define test_put_overflow(type_name, literal_type_name, overflow_limit) AST_TEST_DEFINE(TEST_NAME(type_name, put_overflow)) {\
@@ -420,7 +420,7 @@ static struct ast_jb default_jb = {
  * \brief Test putting voice frames into a jitter buffer out of order
  *
  * \param type_name The enum type of the jitter buffer to create
- * \param literal_type_name The literal name of the type - "fixed" or "adaptive"
+ * \param literal_type_name The literal name of the type - "fixed", "adaptive" or "ring"
  * \param synch_limit The synchronization limit for this particular type of jitter buffer
  */
 #define test_put_out_of_order(type_name, literal_type_name, synch_limit) AST_TEST_DEFINE(TEST_NAME(type_name, put_out_of_order)) {\
@@ -511,6 +511,16 @@ test_put_overflow(AST_JB_FIXED, "fixed", 12)
 
 test_put_out_of_order(AST_JB_FIXED, "fixed", DEFAULT_CONFIG_RESYNC_THRESHOLD)
 
+test_create_nominal(AST_JB_RING, "ring")
+
+test_put_first(AST_JB_RING, "ring")
+
+test_put(AST_JB_RING, "ring")
+
+test_put_overflow(AST_JB_RING, "ring", 10)
+
+test_put_out_of_order(AST_JB_RING, "ring", DEFAULT_FRAME_MS * 2)
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_ADAPTIVE, create));
@@ -525,6 +535,12 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_FIXED, put_overflow));
 	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_FIXED, put_out_of_order));
 
+	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_RING, create));
+	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_RING, put_first));
+	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_RING, put));
+	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_RING, put_overflow));
+	AST_TEST_UNREGISTER(TEST_NAME(AST_JB_RING, put_out_of_order));
+
 	return 0;
 }
 
@@ -542,6 +558,12 @@ static int load_module(void)
 	AST_TEST_REGISTER(TEST_NAME(AST_JB_FIXED, put_overflow));
 	AST_TEST_REGISTER(TEST_NAME(AST_JB_FIXED, put_out_of_order));
 
+	AST_TEST_REGISTER(TEST_NAME(AST_JB_RING, create));
+	AST_TEST_REGISTER(TEST_NAME(AST_JB_RING, put_first));
+	AST_TEST_REGISTER(TEST_NAME(AST_JB_RING, put));
+	AST_TEST_REGISTER(TEST_NAME(AST_JB_RING, put_overflow));
+	AST_TEST_REGISTER(TEST_NAME(AST_JB_RING, put_out_of_order));
+
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
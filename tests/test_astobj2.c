@@ -953,6 +953,182 @@ cleanup:
 	return res;
 }
 
+static AO2_RCU_OBJ_STATIC(astobj2_rcu_holder);
+
+/*! Number of objects in each RCU published container version. */
+#define RCU_OBJS		100
+/*! Number of RCU container versions published during the test. */
+#define RCU_VERSIONS	200
+
+struct rcu_reader {
+	/*! Set to stop the reader. */
+	int stop;
+	/*! Number of lookups that did not find the expected object. */
+	int errors;
+	/*! Number of lookups done. */
+	int lookups;
+};
+
+/*! Readers may release the last reference so the count is updated atomically. */
+static void rcu_obj_destructor(void *v_obj)
+{
+	struct test_obj *obj = v_obj;
+
+	ast_atomic_fetchadd_int(obj->destructor_count, -1);
+}
+
+/*!
+ * \internal
+ * \brief Build a container version to publish in the RCU holder.
+ *
+ * \param generation Version number stored in the objects.
+ * \param destructor_count Live object counter.
+ *
+ * \retval container on success.
+ * \retval NULL on error.
+ */
+static struct ao2_container *rcu_version_build(int generation, int *destructor_count)
+{
+	struct ao2_container *c;
+	int i;
+
+	c = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_NOLOCK, 0, 17,
+		test_hash_cb, NULL, test_cmp_cb);
+	if (!c) {
+		return NULL;
+	}
+	for (i = 0; i < RCU_OBJS; ++i) {
+		struct test_obj *obj;
+
+		obj = ao2_alloc(sizeof(*obj), rcu_obj_destructor);
+		if (!obj) {
+			ao2_ref(c, -1);
+			return NULL;
+		}
+		obj->destructor_count = destructor_count;
+		obj->i = i;
+		obj->dup_number = generation;
+		ast_atomic_fetchadd_int(destructor_count, 1);
+		ao2_link(c, obj);
+		ao2_ref(obj, -1);
+	}
+	return c;
+}
+
+static void *rcu_reader_thread(void *data)
+{
+	struct rcu_reader *reader = data;
+	int key = 0;
+
+	while (!ast_atomic_fetchadd_int(&reader->stop, 0)) {
+		struct test_obj *obj;
+
+		obj = ao2_rcu_obj_find(astobj2_rcu_holder, &key, OBJ_SEARCH_KEY);
+		if (!obj || obj->i != key) {
+			++reader->errors;
+		}
+		ao2_cleanup(obj);
+		++reader->lookups;
+		key = (key + 1) % RCU_OBJS;
+	}
+	return NULL;
+}
+
+AST_TEST_DEFINE(astobj2_test_rcu)
+{
+	int res = AST_TEST_PASS;
+	int destructor_count = 0;
+	struct rcu_reader readers[2] = {{0,},};
+	pthread_t threads[ARRAY_LEN(readers)];
+	struct ao2_container *c;
+	struct test_obj *obj;
+	int generation;
+	int key;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "astobj2_test_rcu";
+		info->category = "/main/astobj2/";
+		info->summary = "Test RCU ao2 holder";
+		info->description =
+			"Publishes many container versions in an RCU ao2 holder while\n"
+			"other threads look up objects in it without locking.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	c = rcu_version_build(0, &destructor_count);
+	if (!c) {
+		ast_test_status_update(test, "Could not build container version.\n");
+		return AST_TEST_FAIL;
+	}
+	if (ao2_t_rcu_obj_replace_unref(astobj2_rcu_holder, c, "Publish first version")) {
+		ast_test_status_update(test, "RCU holder was not empty.\n");
+		res = AST_TEST_FAIL;
+	}
+	ao2_ref(c, -1);
+
+	for (i = 0; i < ARRAY_LEN(readers); ++i) {
+		ast_pthread_create(&threads[i], NULL, rcu_reader_thread, &readers[i]);
+	}
+
+	for (generation = 1; generation <= RCU_VERSIONS; ++generation) {
+		c = rcu_version_build(generation, &destructor_count);
+		if (!c) {
+			ast_test_status_update(test, "Could not build container version.\n");
+			res = AST_TEST_FAIL;
+			break;
+		}
+		if (!ao2_t_rcu_obj_replace_unref(astobj2_rcu_holder, c, "Publish new version")) {
+			ast_test_status_update(test, "RCU holder was unexpectedly empty.\n");
+			res = AST_TEST_FAIL;
+		}
+		ao2_ref(c, -1);
+	}
+
+	for (i = 0; i < ARRAY_LEN(readers); ++i) {
+		ast_atomic_fetchadd_int(&readers[i].stop, 1);
+		pthread_join(threads[i], NULL);
+		if (readers[i].errors) {
+			ast_test_status_update(test, "Reader %d failed %d of %d lookups.\n",
+				i, readers[i].errors, readers[i].lookups);
+			res = AST_TEST_FAIL;
+		}
+	}
+
+	/* Only the current version's objects may remain. */
+	if (ast_atomic_fetchadd_int(&destructor_count, 0) != RCU_OBJS) {
+		ast_test_status_update(test, "Expected %d live objects, found %d.\n",
+			RCU_OBJS, destructor_count);
+		res = AST_TEST_FAIL;
+	}
+
+	key = RCU_OBJS / 2;
+	obj = ao2_rcu_obj_find(astobj2_rcu_holder, &key, OBJ_SEARCH_KEY);
+	if (!obj || obj->dup_number != RCU_VERSIONS) {
+		ast_test_status_update(test, "Lookup did not find the latest version.\n");
+		res = AST_TEST_FAIL;
+	}
+	ao2_cleanup(obj);
+
+	c = ao2_t_rcu_obj_ref(astobj2_rcu_holder, "Get the current version");
+	if (!c || ao2_container_count(c) != RCU_OBJS) {
+		ast_test_status_update(test, "Current version not as expected.\n");
+		res = AST_TEST_FAIL;
+	}
+	ao2_cleanup(c);
+
+	ao2_t_rcu_obj_release(astobj2_rcu_holder, "Test cleanup holder");
+	if (destructor_count) {
+		ast_test_status_update(test, "%d objects were not destroyed.\n", destructor_count);
+		res = AST_TEST_FAIL;
+	}
+
+	return res;
+}
+
 /*!
  * \internal
  * \brief Make a nonsorted container for astobj2 testing.
@@ -1922,6 +2098,82 @@ AST_TEST_DEFINE(astobj2_test_4)
 	return res;
 }
 
+static int pool_destructor_count;
+
+static void pool_obj_destructor(void *obj)
+{
+	++pool_destructor_count;
+}
+
+AST_TEST_DEFINE(astobj2_test_pool)
+{
+	static const size_t sizes[] = { 1, 40, 100, 500, 1000, 4000 };
+	static const unsigned int lock_opts[] = {
+		AO2_ALLOC_OPT_LOCK_MUTEX,
+		AO2_ALLOC_OPT_LOCK_RWLOCK,
+		AO2_ALLOC_OPT_LOCK_NOLOCK,
+	};
+	char *objs[ARRAY_LEN(sizes) * ARRAY_LEN(lock_opts)];
+	int res = AST_TEST_PASS;
+	int round;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "astobj2_test_pool";
+		info->category = "/main/astobj2/";
+		info->summary = "Test pooled object allocation";
+		info->description =
+			"Allocates and releases objects of various sizes and lock types "
+			"with AO2_ALLOC_OPT_POOL, checking they are zeroed, lockable and destroyed.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	pool_destructor_count = 0;
+
+	/* The second round gets recycled blocks */
+	for (round = 0; round < 2 && res == AST_TEST_PASS; ++round) {
+		for (i = 0; i < ARRAY_LEN(objs); ++i) {
+			size_t size = sizes[i % ARRAY_LEN(sizes)];
+			size_t pos;
+
+			objs[i] = ao2_alloc_options(size, pool_obj_destructor,
+				lock_opts[i / ARRAY_LEN(sizes)] | AO2_ALLOC_OPT_POOL);
+			if (!objs[i]) {
+				ast_test_status_update(test, "Failed to allocate a pooled object of %zu bytes\n", size);
+				res = AST_TEST_FAIL;
+				break;
+			}
+
+			for (pos = 0; pos < size; ++pos) {
+				if (objs[i][pos]) {
+					ast_test_status_update(test, "Pooled object of %zu bytes is not zeroed\n", size);
+					res = AST_TEST_FAIL;
+					break;
+				}
+			}
+
+			ao2_lock(objs[i]);
+			memset(objs[i], 0xa5, size);
+			ao2_unlock(objs[i]);
+		}
+
+		for (--i; i >= 0; --i) {
+			ao2_ref(objs[i], -1);
+		}
+	}
+
+	if (res == AST_TEST_PASS && pool_destructor_count != 2 * ARRAY_LEN(objs)) {
+		ast_test_status_update(test, "Expected %d destructor calls, got %d\n",
+			(int) (2 * ARRAY_LEN(objs)), pool_destructor_count);
+		res = AST_TEST_FAIL;
+	}
+
+	return res;
+}
+
 static enum ast_test_result_state test_performance(struct ast_test *test,
 	enum test_container_type type, unsigned int copt)
 {
@@ -2056,7 +2308,9 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(astobj2_test_1);
 	AST_TEST_UNREGISTER(astobj2_test_2);
 	AST_TEST_UNREGISTER(astobj2_test_3);
+	AST_TEST_UNREGISTER(astobj2_test_rcu);
 	AST_TEST_UNREGISTER(astobj2_test_4);
+	AST_TEST_UNREGISTER(astobj2_test_pool);
 	AST_TEST_UNREGISTER(astobj2_test_perf);
 	return 0;
 }
@@ -2066,7 +2320,9 @@ static int load_module(void)
 	AST_TEST_REGISTER(astobj2_test_1);
 	AST_TEST_REGISTER(astobj2_test_2);
 	AST_TEST_REGISTER(astobj2_test_3);
+	AST_TEST_REGISTER(astobj2_test_rcu);
 	AST_TEST_REGISTER(astobj2_test_4);
+	AST_TEST_REGISTER(astobj2_test_pool);
 	AST_TEST_REGISTER(astobj2_test_perf);
 	return AST_MODULE_LOAD_SUCCESS;
 }
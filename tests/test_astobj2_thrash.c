@@ -54,6 +54,20 @@
 #define COUNT_SLEEP_US 500
 #define MAX_TEST_SECONDS 60
 
+/*! Number of threads running lookups in the benchmark. */
+#define BENCH_THREADS 8
+/*! Number of operations run by each benchmark thread. */
+#define BENCH_OPERATIONS 100000
+/*! One in this many benchmark operations also replaces the entry. */
+#define BENCH_WRITE_RATIO 10
+
+/*! Number of threads relinking entries from traversal callbacks. */
+#define RELINK_THREADS 4
+/*! Number of entries in the relink test container. */
+#define RELINK_ENTRIES 1000
+/*! Number of relinks done by each relink thread. */
+#define RELINK_OPERATIONS 20000
+
 struct hash_test {
 	/*! Unit under test */
 	struct ao2_container *to_be_thrashed;
@@ -205,11 +219,25 @@ static void *hash_test_count(void *d)
 	const struct hash_test *data = d;
 	int count = 0;
 	int last_count = 0;
+	int use_iterator = 0;
 
 	while (count < data->max_grow) {
 		last_count = count;
 		count = 0;
-		ao2_callback(data->to_be_thrashed, OBJ_MULTIPLE, increment_count, &count);
+		if (use_iterator) {
+			struct ao2_iterator iter;
+			char *obj;
+
+			iter = ao2_iterator_init(data->to_be_thrashed, 0);
+			while ((obj = ao2_iterator_next(&iter))) {
+				increment_count(obj, &count, 0);
+				ao2_ref(obj, -1);
+			}
+			ao2_iterator_destroy(&iter);
+		} else {
+			ao2_callback(data->to_be_thrashed, OBJ_MULTIPLE, increment_count, &count);
+		}
+		use_iterator = !use_iterator;
 
 		if (last_count == count) {
 			/* Allow other threads to run. */
@@ -244,7 +272,16 @@ static int compare_strings(void *lhs, void *rhs, int flags)
 	}
 }
 
-AST_TEST_DEFINE(hash_test)
+/*!
+ * \brief Thrash a container from several threads checking its consistency.
+ *
+ * \param test Test being run.
+ * \param container Empty container to thrash.  The reference is consumed.
+ *
+ * \return Test result.
+ */
+static enum ast_test_result_state thrash_container(struct ast_test *test,
+	struct ao2_container *container)
 {
 	enum ast_test_result_state res = AST_TEST_PASS;
 	struct hash_test data = {};
@@ -252,23 +289,10 @@ AST_TEST_DEFINE(hash_test)
 	void *thread_results;
 	int i;
 
-	switch (cmd) {
-	case TEST_INIT:
-		info->name = "thrash";
-		info->category = "/main/astobj2/";
-		info->summary = "Testing astobj2 container concurrency";
-		info->description = "Test astobj2 container concurrency correctness.";
-		return AST_TEST_NOT_RUN;
-	case TEST_EXECUTE:
-		break;
-	}
-
-	ast_test_status_update(test, "Executing hash concurrency test...\n");
 	data.preload = MAX_HASH_ENTRIES / 2;
 	data.max_grow = MAX_HASH_ENTRIES - data.preload;
 	data.deadline = ast_tvadd(ast_tvnow(), ast_tv(MAX_TEST_SECONDS, 0));
-	data.to_be_thrashed = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
-		HASH_BUCKETS, hash_string, NULL, compare_strings);
+	data.to_be_thrashed = container;
 
 	if (data.to_be_thrashed == NULL) {
 		ast_test_status_update(test, "Allocation failed\n");
@@ -344,15 +368,325 @@ AST_TEST_DEFINE(hash_test)
 	return res;
 }
 
+AST_TEST_DEFINE(hash_test)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "thrash";
+		info->category = "/main/astobj2/";
+		info->summary = "Testing astobj2 container concurrency";
+		info->description = "Test astobj2 container concurrency correctness.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_test_status_update(test, "Executing hash concurrency test...\n");
+	return thrash_container(test, ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+		HASH_BUCKETS, hash_string, NULL, compare_strings));
+}
+
+AST_TEST_DEFINE(striped_test)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "thrash_striped";
+		info->category = "/main/astobj2/";
+		info->summary = "Testing striped astobj2 container concurrency";
+		info->description =
+			"Test concurrency correctness of a hash container created with\n"
+			"AO2_CONTAINER_ALLOC_OPT_STRIPED.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_test_status_update(test, "Executing striped hash concurrency test...\n");
+	return thrash_container(test, ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK,
+		AO2_CONTAINER_ALLOC_OPT_STRIPED, HASH_BUCKETS, hash_string, NULL, compare_strings));
+}
+
+/*!
+ * \brief Unlink and link again an object from a traversal callback.
+ *
+ * \details
+ * The traversal still holds the stripe lock so the container is
+ * changed with OBJ_NOLOCK.
+ */
+static int relink_cb(void *obj, void *arg, void *data, int flags)
+{
+	struct ao2_container *container = data;
+
+	if (arg && strcasecmp(obj, arg)) {
+		return 0;
+	}
+
+	ao2_ref(obj, +1);
+	ao2_unlink_flags(container, obj, OBJ_NOLOCK);
+	ao2_link_flags(container, obj, OBJ_NOLOCK);
+	ao2_ref(obj, -1);
+	return CMP_STOP;
+}
+
+/*! Relink entries from keyed and whole container traversals. */
+static void *relink_thread(void *d)
+{
+	struct ao2_container *container = d;
+	unsigned int seed = (unsigned int) (uintptr_t) &seed;
+	int i;
+
+	for (i = 0; i < RELINK_OPERATIONS; ++i) {
+		char *obj;
+
+		if (!(i % 2)) {
+			ao2_callback_data(container, OBJ_NODATA, relink_cb, NULL, container);
+			continue;
+		}
+
+		obj = ht_new(rand_r(&seed) % RELINK_ENTRIES);
+		if (obj == NULL) {
+			return "Allocation failed";
+		}
+		ao2_callback_data(container, OBJ_SEARCH_OBJECT | OBJ_NODATA, relink_cb,
+			obj, container);
+		ao2_ref(obj, -1);
+	}
+
+	return NULL;
+}
+
+AST_TEST_DEFINE(striped_relink_test)
+{
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct ao2_container *container;
+	pthread_t threads[RELINK_THREADS];
+	void *thread_results;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "thrash_striped_relink";
+		info->category = "/main/astobj2/";
+		info->summary = "Test changing a striped container from its callbacks";
+		info->description =
+			"Several threads unlink and link entries with OBJ_NOLOCK from the\n"
+			"callbacks of keyed and whole container traversals of a container\n"
+			"created with AO2_CONTAINER_ALLOC_OPT_STRIPED.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	container = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK,
+		AO2_CONTAINER_ALLOC_OPT_STRIPED, HASH_BUCKETS, hash_string, NULL, compare_strings);
+	if (!container) {
+		ast_test_status_update(test, "Allocation failed\n");
+		return AST_TEST_FAIL;
+	}
+
+	for (i = 0; i < RELINK_ENTRIES; ++i) {
+		char *ht = ht_new(i);
+
+		if (ht == NULL) {
+			ast_test_status_update(test, "Allocation failed\n");
+			ao2_ref(container, -1);
+			return AST_TEST_FAIL;
+		}
+		ao2_link(container, ht);
+		ao2_ref(ht, -1);
+	}
+
+	for (i = 0; i < RELINK_THREADS; ++i) {
+		ast_pthread_create(&threads[i], NULL, relink_thread, container);
+	}
+	for (i = 0; i < RELINK_THREADS; ++i) {
+		pthread_join(threads[i], &thread_results);
+		if (thread_results != NULL) {
+			ast_test_status_update(test, "Relink thread failed: %s\n",
+				(char *)thread_results);
+			res = AST_TEST_FAIL;
+		}
+	}
+
+	if (ao2_container_count(container) != RELINK_ENTRIES) {
+		ast_test_status_update(test,
+			"Invalid ao2 container size. Expected: %d, Actual: %d\n",
+			RELINK_ENTRIES, ao2_container_count(container));
+		res = AST_TEST_FAIL;
+	}
+
+	ao2_ref(container, -1);
+
+	/* check for object leaks */
+	if (ast_atomic_fetchadd_int(&alloc_count, 0) != 0) {
+		ast_test_status_update(test, "Leaked %d objects!\n",
+			ast_atomic_fetchadd_int(&alloc_count, 0));
+		res = AST_TEST_FAIL;
+	}
+
+	return res;
+}
+
+struct bench_data {
+	/*! Container being benchmarked */
+	struct ao2_container *container;
+	/*! Number of keys preloaded into the container */
+	int keys;
+};
+
+/*! Mostly lookup entries while occasionally replacing one. */
+static void *bench_thread(void *d)
+{
+	struct bench_data *data = d;
+	unsigned int seed = (unsigned int) (uintptr_t) &seed;
+	int i;
+
+	for (i = 0; i < BENCH_OPERATIONS; ++i) {
+		char *obj;
+		char *from_ao2;
+
+		obj = ht_new(rand_r(&seed) % data->keys);
+		if (obj == NULL) {
+			return "Allocation failed";
+		}
+		if (!(i % BENCH_WRITE_RATIO)) {
+			/*
+			 * Link a duplicate and unlink one of the two to exercise keyed
+			 * writes while the key stays visible to the other threads.
+			 */
+			ao2_link(data->container, obj);
+			ao2_find(data->container, obj, OBJ_SEARCH_OBJECT | OBJ_UNLINK | OBJ_NODATA);
+		}
+		from_ao2 = ao2_find(data->container, obj, OBJ_SEARCH_OBJECT);
+		ao2_ref(obj, -1);
+		if (from_ao2 == NULL) {
+			return "Key unexpectedly missing";
+		}
+		ao2_ref(from_ao2, -1);
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Time concurrent keyed operations on a container.
+ *
+ * \param test Test being run.
+ * \param name Name of the container type for reporting.
+ * \param container Empty container to benchmark.  The reference is consumed.
+ *
+ * \return Test result.
+ */
+static enum ast_test_result_state bench_container(struct ast_test *test,
+	const char *name, struct ao2_container *container)
+{
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct bench_data data = { .container = container, .keys = MAX_HASH_ENTRIES, };
+	pthread_t threads[BENCH_THREADS];
+	void *thread_results;
+	struct timeval start;
+	int i;
+
+	if (!container) {
+		ast_test_status_update(test, "Allocation failed\n");
+		return AST_TEST_FAIL;
+	}
+
+	for (i = 0; i < data.keys; ++i) {
+		char *ht = ht_new(i);
+
+		if (ht == NULL) {
+			ast_test_status_update(test, "Allocation failed\n");
+			ao2_ref(container, -1);
+			return AST_TEST_FAIL;
+		}
+		ao2_link(container, ht);
+		ao2_ref(ht, -1);
+	}
+
+	start = ast_tvnow();
+	for (i = 0; i < BENCH_THREADS; ++i) {
+		ast_pthread_create(&threads[i], NULL, bench_thread, &data);
+	}
+	for (i = 0; i < BENCH_THREADS; ++i) {
+		pthread_join(threads[i], &thread_results);
+		if (thread_results != NULL) {
+			ast_test_status_update(test, "%s benchmark thread failed: %s\n",
+				name, (char *)thread_results);
+			res = AST_TEST_FAIL;
+		}
+	}
+	ast_test_status_update(test, "%s: %d threads x %d operations in %" PRId64 " ms\n",
+		name, BENCH_THREADS, BENCH_OPERATIONS, ast_tvdiff_ms(ast_tvnow(), start));
+
+	if (ao2_container_count(container) != data.keys) {
+		ast_test_status_update(test,
+			"Invalid %s container size. Expected: %d, Actual: %d\n",
+			name, data.keys, ao2_container_count(container));
+		res = AST_TEST_FAIL;
+	}
+
+	ao2_ref(container, -1);
+
+	return res;
+}
+
+AST_TEST_DEFINE(striped_benchmark)
+{
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "thrash_benchmark";
+		info->category = "/main/astobj2/";
+		info->summary = "Compare astobj2 container locking under contention";
+		info->description =
+			"Times several threads doing keyed lookups and replacements on mutex,\n"
+			"rwlock and striped hash containers.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (bench_container(test, "mutex", ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_MUTEX, 0,
+			HASH_BUCKETS, hash_string, NULL, compare_strings)) != AST_TEST_PASS) {
+		res = AST_TEST_FAIL;
+	}
+	if (bench_container(test, "rwlock", ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+			HASH_BUCKETS, hash_string, NULL, compare_strings)) != AST_TEST_PASS) {
+		res = AST_TEST_FAIL;
+	}
+	if (bench_container(test, "striped", ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK,
+			AO2_CONTAINER_ALLOC_OPT_STRIPED, HASH_BUCKETS, hash_string, NULL,
+			compare_strings)) != AST_TEST_PASS) {
+		res = AST_TEST_FAIL;
+	}
+
+	/* check for object leaks */
+	if (ast_atomic_fetchadd_int(&alloc_count, 0) != 0) {
+		ast_test_status_update(test, "Leaked %d objects!\n",
+			ast_atomic_fetchadd_int(&alloc_count, 0));
+		res = AST_TEST_FAIL;
+	}
+
+	return res;
+}
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(hash_test);
+	AST_TEST_UNREGISTER(striped_test);
+	AST_TEST_UNREGISTER(striped_relink_test);
+	AST_TEST_UNREGISTER(striped_benchmark);
 	return 0;
 }
 
 static int load_module(void)
 {
 	AST_TEST_REGISTER(hash_test);
+	AST_TEST_REGISTER(striped_test);
+	AST_TEST_REGISTER(striped_relink_test);
+	AST_TEST_REGISTER(striped_benchmark);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
@@ -0,0 +1,135 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Autoservice tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/channel.h"
+#include "asterisk/frame.h"
+
+/*! \brief Number of channels put into autoservice at once */
+#define TEST_CHANNELS 64
+
+AST_TEST_DEFINE(deferred_frames)
+{
+	struct ast_channel *chans[TEST_CHANNELS] = { NULL, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "deferred_frames";
+		info->category = "/main/autoservice/";
+		info->summary = "Frames read in autoservice are handed back";
+		info->description =
+			"Puts many channels into autoservice, some of them twice, queues\n"
+			"a text frame on each and checks every channel gets its frame\n"
+			"back once autoservice is stopped for the last time.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < TEST_CHANNELS; i++) {
+		chans[i] = ast_channel_alloc(1, AST_STATE_UP, NULL, NULL, NULL, NULL, NULL, NULL,
+			NULL, 0, "TestAutoservice/%d", i);
+		if (!chans[i]) {
+			ast_test_status_update(test, "Could not create channel %d\n", i);
+			res = AST_TEST_FAIL;
+			goto done;
+		}
+		ast_channel_unlock(chans[i]);
+
+		if (ast_autoservice_start(chans[i]) || (i % 2 && ast_autoservice_start(chans[i]))) {
+			ast_test_status_update(test, "Could not start autoservice on channel %d\n", i);
+			res = AST_TEST_FAIL;
+			goto done;
+		}
+	}
+
+	for (i = 0; i < TEST_CHANNELS; i++) {
+		char text[16];
+		struct ast_frame frame = {
+			.frametype = AST_FRAME_TEXT,
+			.data.ptr = text,
+		};
+
+		frame.datalen = snprintf(text, sizeof(text), "%d", i) + 1;
+		ast_queue_frame(chans[i], &frame);
+	}
+
+	/* Let autoservice read the frames */
+	usleep(200000);
+
+	for (i = 0; i < TEST_CHANNELS; i++) {
+		struct ast_frame *f;
+		char text[16];
+
+		snprintf(text, sizeof(text), "%d", i);
+		if (i % 2) {
+			ast_autoservice_stop(chans[i]);
+		}
+		ast_autoservice_stop(chans[i]);
+
+		f = ast_waitfor(chans[i], 1000) > 0 ? ast_read(chans[i]) : NULL;
+		if (!f || f->frametype != AST_FRAME_TEXT || strcmp(f->data.ptr, text)) {
+			ast_test_status_update(test, "Channel %d did not get its frame back\n", i);
+			res = AST_TEST_FAIL;
+		}
+		if (f) {
+			ast_frfree(f);
+		}
+	}
+
+done:
+	for (i = 0; i < TEST_CHANNELS; i++) {
+		if (chans[i]) {
+			ast_autoservice_stop(chans[i]);
+			ast_hangup(chans[i]);
+		}
+	}
+
+	return res;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(deferred_frames);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(deferred_frames);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Autoservice tests");
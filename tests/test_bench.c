@@ -0,0 +1,674 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Baseline benchmarks of core hot paths
+ *
+ * Run with 'test execute category /bench/' and compare the output of
+ * 'test generate results json' between builds.
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/astobj2.h"
+#include "asterisk/frame.h"
+#include "asterisk/format_cache.h"
+#include "asterisk/lock.h"
+#include "asterisk/module.h"
+#include "asterisk/pbx.h"
+#include "asterisk/stasis.h"
+#include "asterisk/taskprocessor.h"
+#include "asterisk/test.h"
+#include "asterisk/translate.h"
+#include "asterisk/utils.h"
+
+#define CATEGORY "/bench/main/"
+
+/*! Number of objects in the benchmarked containers */
+#define BENCH_OBJECTS 10000
+
+/*! Number of extensions in the benchmarked context */
+#define BENCH_EXTENSIONS 1000
+
+struct bench_obj {
+	int key;
+};
+
+static int bench_obj_hash(const void *obj, const int flags)
+{
+	const int *key = (flags & OBJ_SEARCH_KEY) ? obj : &((const struct bench_obj *) obj)->key;
+
+	return *key;
+}
+
+static int bench_obj_sort(const void *left, const void *right, const int flags)
+{
+	const struct bench_obj *l = left;
+	int r = (flags & OBJ_SEARCH_KEY) ? *(const int *) right : ((const struct bench_obj *) right)->key;
+
+	return l->key < r ? -1 : l->key > r ? 1 : 0;
+}
+
+static int bench_obj_cmp(void *obj, void *arg, int flags)
+{
+	return !bench_obj_sort(obj, arg, flags) ? CMP_MATCH : 0;
+}
+
+static int bench_ao2_alloc(void *data, unsigned int iterations)
+{
+	unsigned int options = *(unsigned int *) data;
+
+	while (iterations--) {
+		struct bench_obj *obj = ao2_alloc_options(sizeof(*obj), NULL, options);
+
+		if (!obj) {
+			return -1;
+		}
+		ao2_ref(obj, -1);
+	}
+
+	return 0;
+}
+
+static int bench_ao2_find(void *data, unsigned int iterations)
+{
+	struct ao2_container *container = data;
+	unsigned int i;
+
+	for (i = 0; i < iterations; ++i) {
+		int key = i % BENCH_OBJECTS;
+		struct bench_obj *obj = ao2_find(container, &key, OBJ_SEARCH_KEY);
+
+		if (!obj) {
+			return -1;
+		}
+		ao2_ref(obj, -1);
+	}
+
+	return 0;
+}
+
+static int bench_ao2_link_unlink(void *data, unsigned int iterations)
+{
+	struct ao2_container *container = data;
+	struct bench_obj *obj;
+
+	obj = ao2_alloc_options(sizeof(*obj), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!obj) {
+		return -1;
+	}
+	obj->key = BENCH_OBJECTS + 1;
+
+	while (iterations--) {
+		if (!ao2_link(container, obj)) {
+			ao2_ref(obj, -1);
+			return -1;
+		}
+		ao2_unlink(container, obj);
+	}
+	ao2_ref(obj, -1);
+
+	return 0;
+}
+
+static int bench_container_fill(struct ao2_container *container)
+{
+	int i;
+
+	for (i = 0; i < BENCH_OBJECTS; ++i) {
+		struct bench_obj *obj = ao2_alloc_options(sizeof(*obj), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+
+		if (!obj) {
+			return -1;
+		}
+		obj->key = i;
+		if (!ao2_link(container, obj)) {
+			ao2_ref(obj, -1);
+			return -1;
+		}
+		ao2_ref(obj, -1);
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(bench_astobj2)
+{
+	static const unsigned int alloc_options[] = {
+		AO2_ALLOC_OPT_LOCK_MUTEX,
+		AO2_ALLOC_OPT_LOCK_NOLOCK,
+		AO2_ALLOC_OPT_LOCK_NOLOCK | AO2_ALLOC_OPT_POOL,
+	};
+	static const char * const alloc_names[] = {
+		"alloc/release mutex",
+		"alloc/release nolock",
+		"alloc/release pooled",
+	};
+	struct ao2_container *hash;
+	struct ao2_container *rbtree;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "astobj2";
+		info->category = CATEGORY;
+		info->summary = "Benchmark ao2 objects and containers";
+		info->description =
+			"Times object allocation and release with each lock type and "
+			"key lookups, links and unlinks in hash and rbtree containers.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < ARRAY_LEN(alloc_options); ++i) {
+		if (ast_test_bench(test, alloc_names[i], 0, bench_ao2_alloc, (void *) &alloc_options[i])) {
+			return AST_TEST_FAIL;
+		}
+	}
+
+	hash = ao2_container_alloc_hash(AO2_ALLOC_OPT_LOCK_RWLOCK, 0, 1021,
+		bench_obj_hash, bench_obj_sort, bench_obj_cmp);
+	rbtree = ao2_container_alloc_rbtree(AO2_ALLOC_OPT_LOCK_RWLOCK, 0,
+		bench_obj_sort, bench_obj_cmp);
+	if (!hash || !rbtree || bench_container_fill(hash) || bench_container_fill(rbtree)) {
+		ast_test_status_update(test, "Failed to create containers\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (ast_test_bench(test, "hash find", 0, bench_ao2_find, hash)
+		|| ast_test_bench(test, "hash link/unlink", 0, bench_ao2_link_unlink, hash)
+		|| ast_test_bench(test, "rbtree find", 0, bench_ao2_find, rbtree)
+		|| ast_test_bench(test, "rbtree link/unlink", 0, bench_ao2_link_unlink, rbtree)) {
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	ao2_cleanup(hash);
+	ao2_cleanup(rbtree);
+
+	return res;
+}
+
+/*! \brief Tracks tasks queued by a benchmark until they have all run */
+struct bench_drain {
+	ast_mutex_t lock;
+	ast_cond_t cond;
+	int done;
+};
+
+static int bench_drain_task(void *data)
+{
+	struct bench_drain *drain = data;
+
+	ast_mutex_lock(&drain->lock);
+	drain->done = 1;
+	ast_cond_signal(&drain->cond);
+	ast_mutex_unlock(&drain->lock);
+
+	return 0;
+}
+
+/*! \brief Wait until everything queued to a taskprocessor before this has run */
+static int bench_drain_wait(struct ast_taskprocessor *tps)
+{
+	struct bench_drain drain = { .done = 0, };
+
+	ast_mutex_init(&drain.lock);
+	ast_cond_init(&drain.cond, NULL);
+
+	if (ast_taskprocessor_push(tps, bench_drain_task, &drain)) {
+		ast_mutex_destroy(&drain.lock);
+		ast_cond_destroy(&drain.cond);
+		return -1;
+	}
+
+	ast_mutex_lock(&drain.lock);
+	while (!drain.done) {
+		ast_cond_wait(&drain.cond, &drain.lock);
+	}
+	ast_mutex_unlock(&drain.lock);
+
+	ast_mutex_destroy(&drain.lock);
+	ast_cond_destroy(&drain.cond);
+
+	return 0;
+}
+
+static int bench_noop_task(void *data)
+{
+	return 0;
+}
+
+static int bench_taskprocessor_push(void *data, unsigned int iterations)
+{
+	struct ast_taskprocessor *tps = data;
+
+	while (iterations--) {
+		if (ast_taskprocessor_push(tps, bench_noop_task, NULL)) {
+			return -1;
+		}
+	}
+
+	return bench_drain_wait(tps);
+}
+
+AST_TEST_DEFINE(bench_taskprocessor)
+{
+	struct ast_taskprocessor *tps;
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "taskprocessor";
+		info->category = CATEGORY;
+		info->summary = "Benchmark taskprocessor task pushes";
+		info->description =
+			"Times pushing tasks to a taskprocessor and running them.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	tps = ast_taskprocessor_get("test_bench", TPS_REF_DEFAULT);
+	if (!tps) {
+		ast_test_status_update(test, "Failed to create taskprocessor\n");
+		return AST_TEST_FAIL;
+	}
+	/* Batches queue far more tasks than the default alert level */
+	ast_taskprocessor_alert_set_levels(tps, -1, INT_MAX);
+
+	if (ast_test_bench(test, "push", 0, bench_taskprocessor_push, tps)) {
+		res = AST_TEST_FAIL;
+	}
+
+	ast_taskprocessor_unreference(tps);
+
+	return res;
+}
+
+struct bench_stasis {
+	struct stasis_topic *topic;
+	struct stasis_subscription *sub;
+	struct stasis_message_type *type;
+};
+
+static void bench_stasis_cb(void *data, struct stasis_subscription *sub, struct stasis_message *message)
+{
+}
+
+static int bench_stasis_publish(void *data, unsigned int iterations)
+{
+	struct bench_stasis *bench = data;
+	struct stasis_message *message;
+	struct bench_obj *payload;
+
+	payload = ao2_alloc_options(sizeof(*payload), NULL, AO2_ALLOC_OPT_LOCK_NOLOCK);
+	if (!payload) {
+		return -1;
+	}
+
+	while (iterations--) {
+		message = stasis_message_create(bench->type, payload);
+		if (!message) {
+			ao2_ref(payload, -1);
+			return -1;
+		}
+		stasis_publish(bench->topic, message);
+		ao2_ref(message, -1);
+	}
+
+	/* Mailboxes are in order, so this returns once the rest are delivered */
+	message = stasis_message_create(bench->type, payload);
+	ao2_ref(payload, -1);
+	if (!message) {
+		return -1;
+	}
+	stasis_publish_sync(bench->sub, message);
+	ao2_ref(message, -1);
+
+	return 0;
+}
+
+AST_TEST_DEFINE(bench_stasis)
+{
+	struct bench_stasis bench = { NULL, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "stasis";
+		info->category = CATEGORY;
+		info->summary = "Benchmark stasis message publication";
+		info->description =
+			"Times creating messages and publishing them to a topic with one "
+			"subscriber, including their delivery.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (stasis_message_type_create("TestBenchType", NULL, &bench.type) != STASIS_MESSAGE_TYPE_SUCCESS) {
+		ast_test_status_update(test, "Failed to create message type\n");
+		return AST_TEST_FAIL;
+	}
+
+	bench.topic = stasis_topic_create("test_bench");
+	if (bench.topic) {
+		bench.sub = stasis_subscribe(bench.topic, bench_stasis_cb, NULL);
+	}
+	if (!bench.sub) {
+		ast_test_status_update(test, "Failed to subscribe\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	stasis_subscription_set_congestion_limits(bench.sub, -1, INT_MAX);
+
+	if (ast_test_bench(test, "publish", 0, bench_stasis_publish, &bench)) {
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	stasis_unsubscribe_and_join(bench.sub);
+	ao2_cleanup(bench.topic);
+	ao2_cleanup(bench.type);
+
+	return res;
+}
+
+static int bench_frame_dup(void *data, unsigned int iterations)
+{
+	struct ast_frame *frame = data;
+
+	while (iterations--) {
+		struct ast_frame *dup = ast_frdup(frame);
+
+		if (!dup) {
+			return -1;
+		}
+		ast_frfree(dup);
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(bench_frame)
+{
+	short samples[160] = { 0, };
+	struct ast_frame frame = {
+		.frametype = AST_FRAME_VOICE,
+		.datalen = sizeof(samples),
+		.samples = ARRAY_LEN(samples),
+		.data.ptr = samples,
+		.src = "test_bench",
+	};
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame";
+		info->category = CATEGORY;
+		info->summary = "Benchmark frame allocation";
+		info->description =
+			"Times duplicating and freeing a 20ms signed linear voice frame.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	frame.subclass.format = ast_format_slin;
+
+	if (ast_test_bench(test, "dup/free", 0, bench_frame_dup, &frame)) {
+		return AST_TEST_FAIL;
+	}
+
+	return AST_TEST_PASS;
+}
+
+struct bench_translate {
+	struct ast_trans_pvt *path;
+	struct ast_frame *frame;
+};
+
+static int bench_translate_frame(void *data, unsigned int iterations)
+{
+	struct bench_translate *bench = data;
+
+	while (iterations--) {
+		struct ast_frame *out = ast_translate(bench->path, bench->frame, 0);
+
+		if (out) {
+			ast_frfree(out);
+		}
+	}
+
+	return 0;
+}
+
+/*! \brief Make a 20ms frame of a tone in the given format */
+static struct ast_frame *bench_tone_frame(struct ast_format *format)
+{
+	short samples[160];
+	struct ast_frame slin = {
+		.frametype = AST_FRAME_VOICE,
+		.datalen = sizeof(samples),
+		.samples = ARRAY_LEN(samples),
+		.data.ptr = samples,
+		.src = "test_bench",
+	};
+	struct ast_trans_pvt *path;
+	struct ast_frame *encoded;
+	struct ast_frame *frame;
+	int i;
+
+	/* A 1kHz tone, eight samples per cycle */
+	for (i = 0; i < ARRAY_LEN(samples); ++i) {
+		static const short cycle[] = { 0, 5793, 8192, 5793, 0, -5793, -8192, -5793 };
+
+		samples[i] = cycle[i % ARRAY_LEN(cycle)];
+	}
+	slin.subclass.format = ast_format_slin;
+
+	if (format == ast_format_slin) {
+		return ast_frdup(&slin);
+	}
+
+	path = ast_translator_build_path(format, ast_format_slin);
+	if (!path) {
+		return NULL;
+	}
+	encoded = ast_translate(path, &slin, 0);
+	frame = encoded ? ast_frdup(encoded) : NULL;
+	if (encoded) {
+		ast_frfree(encoded);
+	}
+	ast_translator_free_path(path);
+
+	return frame;
+}
+
+AST_TEST_DEFINE(bench_translate)
+{
+	struct ast_format *formats[] = {
+		ast_format_slin,
+		ast_format_ulaw,
+		ast_format_alaw,
+		ast_format_gsm,
+		ast_format_g722,
+		ast_format_g726,
+		ast_format_adpcm,
+	};
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int src;
+	int dst;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "translate";
+		info->category = CATEGORY;
+		info->summary = "Benchmark translation between codec pairs";
+		info->description =
+			"Times translating a 20ms frame between each pair of the built in "
+			"codecs that have a translation path.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (src = 0; src < ARRAY_LEN(formats); ++src) {
+		struct ast_frame *frame = bench_tone_frame(formats[src]);
+
+		if (!frame) {
+			ast_test_status_update(test, "No translation to %s, skipping it\n",
+				ast_format_get_name(formats[src]));
+			continue;
+		}
+
+		for (dst = 0; dst < ARRAY_LEN(formats); ++dst) {
+			struct bench_translate bench = { .frame = frame, };
+			char name[64];
+
+			if (src == dst) {
+				continue;
+			}
+			bench.path = ast_translator_build_path(formats[dst], formats[src]);
+			if (!bench.path) {
+				continue;
+			}
+
+			snprintf(name, sizeof(name), "%s to %s",
+				ast_format_get_name(formats[src]), ast_format_get_name(formats[dst]));
+			if (ast_test_bench(test, name, 0, bench_translate_frame, &bench)) {
+				res = AST_TEST_FAIL;
+			}
+			ast_translator_free_path(bench.path);
+		}
+
+		ast_frfree(frame);
+	}
+
+	return res;
+}
+
+static const char bench_registrar[] = "test_bench";
+static const char bench_context[] = "test_bench_context";
+static const char bench_include[] = "test_bench_include";
+
+static int bench_dialplan_lookup(void *data, unsigned int iterations)
+{
+	unsigned int i;
+
+	for (i = 0; i < iterations; ++i) {
+		char exten[AST_MAX_EXTENSION];
+
+		snprintf(exten, sizeof(exten), "555%04u", i % BENCH_EXTENSIONS);
+		if (!ast_exists_extension(NULL, bench_context, exten, 1, NULL)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(bench_dialplan)
+{
+	enum ast_test_result_state res = AST_TEST_PASS;
+	char exten[AST_MAX_EXTENSION];
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "dialplan";
+		info->category = CATEGORY;
+		info->summary = "Benchmark dialplan extension lookups";
+		info->description =
+			"Times looking up extensions reached through an include past "
+			"a set of patterns.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!ast_context_find_or_create(NULL, NULL, bench_context, bench_registrar)
+		|| !ast_context_find_or_create(NULL, NULL, bench_include, bench_registrar)
+		|| ast_context_add_include(bench_context, bench_include, bench_registrar)) {
+		ast_test_status_update(test, "Failed to create contexts\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	for (i = 0; i < 100; ++i) {
+		snprintf(exten, sizeof(exten), "_NXX%02dXXX", i);
+		if (ast_add_extension(bench_context, 0, exten, 1, NULL, NULL, "Noop", NULL, NULL, bench_registrar)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	for (i = 0; i < BENCH_EXTENSIONS; ++i) {
+		snprintf(exten, sizeof(exten), "555%04d", i);
+		if (ast_add_extension(bench_include, 0, exten, 1, NULL, NULL, "Noop", NULL, NULL, bench_registrar)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	if (res != AST_TEST_PASS) {
+		ast_test_status_update(test, "Failed to add extensions\n");
+		goto cleanup;
+	}
+
+	if (ast_test_bench(test, "lookup", 0, bench_dialplan_lookup, NULL)) {
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	ast_context_destroy(NULL, bench_registrar);
+
+	return res;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(bench_astobj2);
+	AST_TEST_UNREGISTER(bench_taskprocessor);
+	AST_TEST_UNREGISTER(bench_stasis);
+	AST_TEST_UNREGISTER(bench_frame);
+	AST_TEST_UNREGISTER(bench_translate);
+	AST_TEST_UNREGISTER(bench_dialplan);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(bench_astobj2);
+	AST_TEST_REGISTER(bench_taskprocessor);
+	AST_TEST_REGISTER(bench_stasis);
+	AST_TEST_REGISTER(bench_frame);
+	AST_TEST_REGISTER(bench_translate);
+	AST_TEST_REGISTER(bench_dialplan);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Core Benchmarks");
@@ -45,6 +45,7 @@
 #include "asterisk/stasis_channels.h"
 #include "asterisk/stasis_bridges.h"
 #include "asterisk/format_cache.h"
+#include "asterisk/pbx.h"
 
 #define EPSILON 0.001
 
@@ -2515,6 +2516,117 @@ AST_TEST_DEFINE(test_cdr_fork_cdr)
 	return result;
 }
 
+AST_TEST_DEFINE(test_cdr_template)
+{
+	static const char * const formats[] = {
+		"${CSV_QUOTE(${CDR(clid)})},${CSV_QUOTE(${CDR(src)})},${CSV_QUOTE(${CDR(dst)})},${CSV_QUOTE(${CDR(dcontext)})},${CSV_QUOTE(${CDR(channel)})},${CSV_QUOTE(${CDR(dstchannel)})},${CSV_QUOTE(${CDR(lastapp)})},${CSV_QUOTE(${CDR(lastdata)})},${CSV_QUOTE(${CDR(start)})},${CSV_QUOTE(${CDR(answer)})},${CSV_QUOTE(${CDR(end)})},${CSV_QUOTE(${CDR(duration)})},${CSV_QUOTE(${CDR(billsec)})},${CSV_QUOTE(${CDR(disposition)})},${CSV_QUOTE(${CDR(amaflags)})},${CSV_QUOTE(${CDR(accountcode)})},${CSV_QUOTE(${CDR(uniqueid)})},${CSV_QUOTE(${CDR(userfield)})},${CDR(sequence)}",
+		"${CDR(start,u)};${CDR(answer,u)};${CDR(end,u)};${CDR(disposition,u)};${CDR(amaflags,u)}",
+		"${CDR(duration,f)}|${CDR(billsec,f)}|${CDR(billsec)}",
+		"${CDR(test_variable)}: literal text",
+	};
+	static const char * const unsupported[] = {
+		"${EPOCH}",
+		"$[1]",
+		"${CDR(${x})}",
+	};
+	RAII_VAR(struct ast_channel *, dummy, NULL, ast_channel_cleanup);
+	RAII_VAR(struct ast_str *, expected, NULL, ast_free);
+	RAII_VAR(struct ast_str *, actual, NULL, ast_free);
+	struct ast_cdr cdr = {
+		.clid = "\"Alice \"\"A\"\"\" <100>",
+		.src = "100",
+		.dst = "200",
+		.dcontext = "default",
+		.channel = CHANNEL_TECH_NAME "/Alice",
+		.dstchannel = CHANNEL_TECH_NAME "/Bob",
+		.lastapp = "Dial",
+		.lastdata = "\"quoted\",data",
+		.duration = 42,
+		.billsec = 30,
+		.amaflags = AST_AMA_DOCUMENTATION,
+		.disposition = AST_CDR_ANSWERED,
+		.accountcode = "100",
+		.uniqueid = "1234.5",
+		.userfield = "field",
+		.sequence = 7,
+	};
+	struct ast_var_t *variable;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = __func__;
+		info->category = TEST_CATEGORY;
+		info->summary = "Test compiled CDR templates";
+		info->description =
+			"Checks that a compiled template formats a CDR the same way as\n"
+			"substituting the template on a channel carrying the CDR, and that\n"
+			"templates it cannot handle are refused.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!ast_custom_function_find("CDR") || !ast_custom_function_find("CSV_QUOTE")) {
+		ast_test_status_update(test, "The CDR and CSV_QUOTE functions are required\n");
+		return AST_TEST_NOT_RUN;
+	}
+
+	cdr.start = ast_tvnow();
+	cdr.start.tv_sec -= 42;
+	cdr.answer = cdr.start;
+	cdr.answer.tv_sec += 12;
+	cdr.answer.tv_usec = 250000;
+	cdr.end = ast_tvnow();
+
+	variable = ast_var_assign("test_variable", "value");
+	ast_test_validate(test, variable != NULL);
+	AST_LIST_INSERT_HEAD(&cdr.varshead, variable, entries);
+
+	dummy = ast_dummy_channel_alloc();
+	expected = ast_str_create(256);
+	actual = ast_str_create(256);
+	if (!dummy || !expected || !actual) {
+		ast_var_delete(variable);
+		return AST_TEST_FAIL;
+	}
+	ast_channel_cdr_set(dummy, ast_cdr_dup(&cdr));
+	ast_var_delete(variable);
+
+	for (i = 0; i < ARRAY_LEN(formats); ++i) {
+		struct ast_cdr_template *tpl = ast_cdr_template_compile(formats[i]);
+
+		if (!tpl) {
+			ast_test_status_update(test, "Template %d was not compiled\n", i);
+			return AST_TEST_FAIL;
+		}
+
+		ast_str_substitute_variables(&expected, 0, dummy, formats[i]);
+		ast_str_reset(actual);
+		ast_cdr_template_apply(tpl, ast_channel_cdr(dummy), &actual);
+		ast_cdr_template_free(tpl);
+
+		if (strcmp(ast_str_buffer(expected), ast_str_buffer(actual))) {
+			ast_test_status_update(test, "Template %d gave '%s', expected '%s'\n",
+				i, ast_str_buffer(actual), ast_str_buffer(expected));
+			return AST_TEST_FAIL;
+		}
+	}
+
+	for (i = 0; i < ARRAY_LEN(unsupported); ++i) {
+		struct ast_cdr_template *tpl = ast_cdr_template_compile(unsupported[i]);
+
+		if (tpl) {
+			ast_test_status_update(test, "Template '%s' should not have been compiled\n",
+				unsupported[i]);
+			ast_cdr_template_free(tpl);
+			return AST_TEST_FAIL;
+		}
+	}
+
+	return AST_TEST_PASS;
+}
+
 /*!
  * \internal
  * \brief Callback function called before each test executes
@@ -2574,6 +2686,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(test_cdr_fields);
 	AST_TEST_UNREGISTER(test_cdr_no_reset_cdr);
 	AST_TEST_UNREGISTER(test_cdr_fork_cdr);
+	AST_TEST_UNREGISTER(test_cdr_template);
 
 	ast_cdr_unregister(MOCK_CDR_BACKEND);
 	ast_channel_unregister(&test_cdr_chan_tech);
@@ -2615,6 +2728,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(test_cdr_fields);
 	AST_TEST_REGISTER(test_cdr_no_reset_cdr);
 	AST_TEST_REGISTER(test_cdr_fork_cdr);
+	AST_TEST_REGISTER(test_cdr_template);
 
 	ast_test_register_init(TEST_CATEGORY, test_cdr_init_cb);
 	ast_test_register_cleanup(TEST_CATEGORY, test_cdr_cleanup_cb);
@@ -34,6 +34,10 @@
 #include "asterisk/module.h"
 #include "asterisk/test.h"
 #include "asterisk/channel.h"
+#include "asterisk/pbx.h"
+#include "asterisk/time.h"
+#include "asterisk/format_cache.h"
+#include "asterisk/stasis_channels.h"
 
 AST_TEST_DEFINE(set_fd_grow)
 {
@@ -102,10 +106,387 @@ done:
 	return res;
 }
 
+/*! Enough variables to make the channel variable list use its hash buckets */
+#define VARIABLES_COUNT 150
+
+AST_TEST_DEFINE(variables_index)
+{
+	struct ast_channel *mock_channel;
+	struct ast_channel *child = NULL;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct ast_var_t *var;
+	struct timeval start;
+	char name[32];
+	char value[32];
+	const char *found;
+	int lookups;
+	int count;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "variables_index";
+		info->category = "/main/channel/";
+		info->summary = "channel variable name index test";
+		info->description =
+			"Test that channel variable lookups through the name index agree with\n"
+			"the variable list while variables are set, pushed, inherited and\n"
+			"removed, including when the list is modified directly.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	mock_channel = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, "TestChannel");
+	ast_test_validate_cleanup(test, mock_channel, res, done);
+
+	for (i = 0; i < VARIABLES_COUNT; i++) {
+		snprintf(name, sizeof(name), "%sVAR%d", i % 3 == 1 ? "_" : i % 3 == 2 ? "__" : "", i);
+		snprintf(value, sizeof(value), "value%d", i);
+		pbx_builtin_setvar_helper(mock_channel, name, value);
+	}
+
+	/* Set variables are inserted at the head of the list. */
+	i = VARIABLES_COUNT;
+	AST_LIST_TRAVERSE(ast_channel_varshead(mock_channel), var, entries) {
+		snprintf(name, sizeof(name), "VAR%d", --i);
+		ast_test_validate_cleanup(test, !strcmp(ast_var_name(var), name), res, done);
+	}
+	ast_test_validate_cleanup(test, i == 0, res, done);
+
+	for (i = 0; i < VARIABLES_COUNT; i++) {
+		snprintf(name, sizeof(name), "VAR%d", i);
+		snprintf(value, sizeof(value), "value%d", i);
+		found = pbx_builtin_getvar_helper(mock_channel, name);
+		ast_test_validate_cleanup(test, found && !strcmp(found, value), res, done);
+	}
+	ast_test_validate_cleanup(test, !pbx_builtin_getvar_helper(mock_channel, "VAR"), res, done);
+
+	/* Replacing a variable must not leave the old value behind. */
+	pbx_builtin_setvar_helper(mock_channel, "_VAR3", "replaced");
+	found = pbx_builtin_getvar_helper(mock_channel, "VAR3");
+	ast_test_validate_cleanup(test, found && !strcmp(found, "replaced"), res, done);
+	count = 0;
+	AST_LIST_TRAVERSE(ast_channel_varshead(mock_channel), var, entries) {
+		count += !strcmp(ast_var_name(var), "VAR3");
+	}
+	ast_test_validate_cleanup(test, count == 1, res, done);
+
+	/* Pushed values shadow the older value until removed. */
+	pbx_builtin_pushvar_helper(mock_channel, "VAR4", "pushed");
+	found = pbx_builtin_getvar_helper(mock_channel, "VAR4");
+	ast_test_validate_cleanup(test, found && !strcmp(found, "pushed"), res, done);
+	pbx_builtin_setvar_helper(mock_channel, "VAR4", NULL);
+	found = pbx_builtin_getvar_helper(mock_channel, "VAR4");
+	ast_test_validate_cleanup(test, found && !strcmp(found, "value4"), res, done);
+	pbx_builtin_setvar_helper(mock_channel, "VAR4", NULL);
+	ast_test_validate_cleanup(test, !pbx_builtin_getvar_helper(mock_channel, "VAR4"), res, done);
+
+	/* Code that still manipulates the list directly must stay visible. */
+	var = ast_var_assign("DIRECT", "direct");
+	ast_test_validate_cleanup(test, var, res, done);
+	AST_LIST_INSERT_HEAD(ast_channel_varshead(mock_channel), var, entries);
+	found = pbx_builtin_getvar_helper(mock_channel, "DIRECT");
+	ast_test_validate_cleanup(test, found && !strcmp(found, "direct"), res, done);
+	AST_LIST_REMOVE(ast_channel_varshead(mock_channel), var, entries);
+	ast_var_delete(var);
+	ast_test_validate_cleanup(test, !pbx_builtin_getvar_helper(mock_channel, "DIRECT"), res, done);
+
+	child = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, "TestChild");
+	ast_test_validate_cleanup(test, child, res, done);
+	ast_channel_inherit_variables(mock_channel, child);
+	for (i = 0; i < VARIABLES_COUNT; i++) {
+		snprintf(name, sizeof(name), "VAR%d", i);
+		snprintf(value, sizeof(value), "value%d", i);
+		found = pbx_builtin_getvar_helper(child, name);
+		if (i == 3) {
+			ast_test_validate_cleanup(test, found && !strcmp(found, "replaced"), res, done);
+		} else if (i % 3 && i != 4) {
+			ast_test_validate_cleanup(test, found && !strcmp(found, value), res, done);
+		} else {
+			ast_test_validate_cleanup(test, !found, res, done);
+		}
+	}
+
+	start = ast_tvnow();
+	for (lookups = 0; ast_tvdiff_ms(ast_tvnow(), start) < 100; lookups++) {
+		snprintf(name, sizeof(name), "VAR%d", lookups % VARIABLES_COUNT);
+		pbx_builtin_getvar_helper(mock_channel, name);
+	}
+	ast_test_status_update(test, "%d lookups in %" PRIi64 "ms with %d variables\n",
+		lookups, ast_tvdiff_ms(ast_tvnow(), start), VARIABLES_COUNT);
+
+done:
+	if (child) {
+		ast_hangup(child);
+	}
+	ast_hangup(mock_channel);
+
+	return res;
+}
+
+/*! \brief Count the channels of an iterator and destroy it */
+static int iterator_count(struct ast_channel_iterator *iter)
+{
+	struct ast_channel *chan;
+	int count = 0;
+
+	if (!iter) {
+		return -1;
+	}
+	while ((chan = ast_channel_iterator_next(iter))) {
+		count++;
+		ast_channel_unref(chan);
+	}
+	ast_channel_iterator_destroy(iter);
+
+	return count;
+}
+
+/*! \brief Check a lookup found the expected channel, or none */
+static int lookup_is(struct ast_channel *found, struct ast_channel *expected)
+{
+	if (found) {
+		ast_channel_unref(found);
+	}
+
+	return found == expected;
+}
+
+AST_TEST_DEFINE(lookup_indexes)
+{
+	struct ast_assigned_ids ids[] = {
+		{ .uniqueid = "test-lookup-indexes-1", },
+		{ .uniqueid = "test-lookup-indexes-2", },
+		{ .uniqueid = "test-lookup-indexes-3", },
+	};
+	static const char *names[] = {
+		"TestIndex/alpha-1",
+		"TestIndex/alpha-2",
+		"TestIndex/beta-1",
+	};
+	struct ast_channel *chans[ARRAY_LEN(names)] = { NULL, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "lookup_indexes";
+		info->category = "/main/channel/";
+		info->summary = "Channel lookups by name, prefix and uniqueid";
+		info->description =
+			"Creates channels and finds them by full name, by name prefix and\n"
+			"by uniqueid, before and after one of them is renamed.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < ARRAY_LEN(names); i++) {
+		chans[i] = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, &ids[i],
+			NULL, 0, "%s", names[i]);
+		ast_test_validate_cleanup(test, chans[i], res, done);
+		ast_channel_unlock(chans[i]);
+	}
+
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("TestIndex/alpha-2"), chans[1]), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("testindex/BETA-1"), chans[2]), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("TestIndex/alpha"), NULL), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name_prefix("TestIndex/beta", 14), chans[2]), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("test-lookup-indexes-1"), chans[0]), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name_prefix("test-lookup-indexes-3", 21), chans[2]), res, done);
+	ast_test_validate_cleanup(test, iterator_count(ast_channel_iterator_by_name_new("TestIndex/alpha", 15)) == 2, res, done);
+	ast_test_validate_cleanup(test, iterator_count(ast_channel_iterator_by_name_new("TestIndex/", 10)) == 3, res, done);
+	ast_test_validate_cleanup(test, iterator_count(ast_channel_iterator_by_name_new("TestIndex/alpha-1", 0)) == 1, res, done);
+
+	ast_change_name(chans[0], "TestIndex/gamma-1");
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("TestIndex/alpha-1"), NULL), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("TestIndex/gamma-1"), chans[0]), res, done);
+	ast_test_validate_cleanup(test, lookup_is(ast_channel_get_by_name("test-lookup-indexes-1"), chans[0]), res, done);
+	ast_test_validate_cleanup(test, iterator_count(ast_channel_iterator_by_name_new("TestIndex/alpha", 15)) == 1, res, done);
+
+done:
+	for (i = 0; i < ARRAY_LEN(chans); i++) {
+		if (chans[i]) {
+			ast_hangup(chans[i]);
+		}
+	}
+	ast_test_validate(test, lookup_is(ast_channel_get_by_name("test-lookup-indexes-2"), NULL));
+
+	return res;
+}
+
+/*! \brief Wait on the channels and check which one, and which fd of it, is ready */
+static int waitfor_is(struct ast_channel **chans, int n, struct ast_channel *expected, int fdno)
+{
+	struct ast_channel *winner;
+	int ms = expected ? 1000 : 0;
+
+	winner = ast_waitfor_n(chans, n, &ms);
+	return winner == expected && (!winner || ast_channel_fdno(winner) == fdno);
+}
+
+/*! \brief Make a pipe readable and then empty it again */
+static int pipe_fill(int fd)
+{
+	return write(fd, "x", 1) == 1;
+}
+
+static int pipe_drain(int fd)
+{
+	char buf;
+
+	return read(fd, &buf, 1) == 1;
+}
+
+AST_TEST_DEFINE(waitfor_fds)
+{
+	struct ast_channel *chans[2] = { NULL, };
+	int pipes[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 }, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "waitfor_fds";
+		info->category = "/main/channel/";
+		info->summary = "Waiting on channels reports the fd that became ready";
+		info->description =
+			"Waits on two channels a number of times, changing the fds of one\n"
+			"of them in between, and checks the right channel and fd win.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < ARRAY_LEN(pipes); i++) {
+		ast_test_validate_cleanup(test, !pipe(pipes[i]), res, done);
+	}
+
+	for (i = 0; i < ARRAY_LEN(chans); i++) {
+		chans[i] = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, NULL,
+			NULL, 0, "TestWaitfor/%d", i);
+		ast_test_validate_cleanup(test, chans[i], res, done);
+		ast_channel_set_fd(chans[i], 1, pipes[i][0]);
+		ast_channel_unlock(chans[i]);
+	}
+
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, NULL, 0), res, done);
+
+	/* The same channels twice in a row, the second wait reuses the first's fds */
+	ast_test_validate_cleanup(test, pipe_fill(pipes[1][1]), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, chans[1], 1), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, chans[1], 1), res, done);
+	ast_test_validate_cleanup(test, pipe_drain(pipes[1][0]), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, NULL, 0), res, done);
+
+	/* A new fd on a channel must be waited on, the replaced one no longer */
+	ast_channel_lock(chans[0]);
+	ast_channel_set_fd(chans[0], 1, -1);
+	ast_channel_set_fd(chans[0], 2, pipes[2][0]);
+	ast_channel_unlock(chans[0]);
+	ast_test_validate_cleanup(test, pipe_fill(pipes[0][1]), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, NULL, 0), res, done);
+	ast_test_validate_cleanup(test, pipe_fill(pipes[2][1]), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 2, chans[0], 2), res, done);
+
+	/* A different set of channels */
+	ast_test_validate_cleanup(test, waitfor_is(&chans[1], 1, NULL, 0), res, done);
+	ast_test_validate_cleanup(test, waitfor_is(chans, 1, chans[0], 2), res, done);
+
+done:
+	for (i = 0; i < ARRAY_LEN(chans); i++) {
+		if (chans[i]) {
+			ast_hangup(chans[i]);
+		}
+	}
+	for (i = 0; i < ARRAY_LEN(pipes); i++) {
+		if (pipes[i][0] > -1) {
+			close(pipes[i][0]);
+			close(pipes[i][1]);
+		}
+	}
+
+	return res;
+}
+
+AST_TEST_DEFINE(alloc_hangup)
+{
+	struct ast_channel *chan;
+	struct ast_format_cap *cap = NULL;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct stasis_topic *topic;
+	struct timeval start;
+	int cause;
+	int count;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "alloc_hangup";
+		info->category = "/main/channel/";
+		info->summary = "Channels get a topic of their own on demand";
+		info->description =
+			"Checks a new channel publishes to the all channels topic until its\n"
+			"own topic is asked for, then reports how many channels and Local\n"
+			"channel pairs can be allocated and hung up in 100ms.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	chan = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, "TestAlloc");
+	ast_test_validate_cleanup(test, chan, res, done);
+	ast_channel_unlock(chan);
+	ast_test_validate_cleanup(test, ast_channel_topic(chan) == ast_channel_topic_all(), res, done);
+	topic = ast_channel_own_topic(chan);
+	ast_test_validate_cleanup(test, topic && topic != ast_channel_topic_all(), res, done);
+	ast_test_validate_cleanup(test, ast_channel_topic(chan) == topic, res, done);
+	ast_test_validate_cleanup(test, ast_channel_own_topic(chan) == topic, res, done);
+	ast_hangup(chan);
+	chan = NULL;
+
+	start = ast_tvnow();
+	for (count = 0; ast_tvdiff_ms(ast_tvnow(), start) < 100; count++) {
+		chan = ast_channel_alloc(0, AST_STATE_DOWN, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0,
+			"TestAlloc/%d", count);
+		ast_test_validate_cleanup(test, chan, res, done);
+		ast_channel_unlock(chan);
+		ast_hangup(chan);
+	chan = NULL;
+	}
+	ast_test_status_update(test, "%d channels allocated and hung up in %" PRIi64 "ms\n",
+		count, ast_tvdiff_ms(ast_tvnow(), start));
+
+	cap = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+	ast_test_validate_cleanup(test, cap && !ast_format_cap_append(cap, ast_format_slin, 0), res, done);
+
+	start = ast_tvnow();
+	for (count = 0; ast_tvdiff_ms(ast_tvnow(), start) < 100; count++) {
+		chan = ast_request("Local", cap, NULL, NULL, "s@default/n", &cause);
+		ast_test_validate_cleanup(test, chan, res, done);
+		ast_hangup(chan);
+	chan = NULL;
+	}
+	ast_test_status_update(test, "%d Local channel pairs requested and hung up in %" PRIi64 "ms\n",
+		count, ast_tvdiff_ms(ast_tvnow(), start));
+
+done:
+	if (chan) {
+		ast_hangup(chan);
+	}
+	ao2_cleanup(cap);
+
+	return res;
+}
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(set_fd_grow);
 	AST_TEST_UNREGISTER(add_fd);
+	AST_TEST_UNREGISTER(variables_index);
+	AST_TEST_UNREGISTER(lookup_indexes);
+	AST_TEST_UNREGISTER(waitfor_fds);
+	AST_TEST_UNREGISTER(alloc_hangup);
 	return 0;
 }
 
@@ -113,6 +494,10 @@ static int load_module(void)
 {
 	AST_TEST_REGISTER(set_fd_grow);
 	AST_TEST_REGISTER(add_fd);
+	AST_TEST_REGISTER(variables_index);
+	AST_TEST_REGISTER(lookup_indexes);
+	AST_TEST_REGISTER(waitfor_fds);
+	AST_TEST_REGISTER(alloc_hangup);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
@@ -1044,6 +1044,238 @@ out:
 	return res;
 }
 
+/*!
+ * \internal
+ * \brief Write the config files used by the parse cache test.
+ *
+ * \param include_value Value of the variable set in the included file.
+ *
+ * \retval 0 on success.
+ * \retval -1 on error.
+ */
+static int write_parse_cache_files(const char *include_value)
+{
+	char filename[PATH_MAX];
+	FILE *config_file;
+
+	snprintf(filename, sizeof(filename), "%s/%s",
+			ast_config_AST_CONFIG_DIR, CONFIG_FILE);
+	config_file = fopen(filename, "w");
+	if (!config_file) {
+		return -1;
+	}
+	fprintf(config_file,
+		"[defaults](!)\n"
+		"context = default\n"
+		"allow = ulaw\n"
+		"[alice](defaults)\n"
+		"allow = alaw\n"
+		"#include " CONFIG_INCLUDE_FILE "\n"
+		"[alice](+)\n"
+		"mailbox => 100\n");
+	fclose(config_file);
+
+	snprintf(filename, sizeof(filename), "%s/%s",
+			ast_config_AST_CONFIG_DIR, CONFIG_INCLUDE_FILE);
+	config_file = fopen(filename, "w");
+	if (!config_file) {
+		return -1;
+	}
+	fprintf(config_file,
+		"[bob](defaults)\n"
+		"callerid = %s\n", include_value);
+	fclose(config_file);
+
+	return 0;
+}
+
+/*!
+ * \internal
+ * \brief Check two configs have the same categories, templates and variables.
+ *
+ * \retval 0 if they match.
+ * \retval -1 if they do not.
+ */
+static int compare_parse_cache_configs(struct ast_test *test, struct ast_config *left,
+	struct ast_config *right)
+{
+	struct ast_category *left_cat = NULL;
+	struct ast_category *right_cat = NULL;
+
+	for (;;) {
+		struct ast_variable *left_var;
+		struct ast_variable *right_var;
+		struct ast_str *left_templates;
+		struct ast_str *right_templates;
+		int templates_match;
+
+		left_cat = ast_category_browse_filtered(left, NULL, left_cat, "TEMPLATES=include");
+		right_cat = ast_category_browse_filtered(right, NULL, right_cat, "TEMPLATES=include");
+		if (!left_cat || !right_cat) {
+			break;
+		}
+
+		if (strcmp(ast_category_get_name(left_cat), ast_category_get_name(right_cat))
+			|| ast_category_is_template(left_cat) != ast_category_is_template(right_cat)) {
+			ast_test_status_update(test, "Category '%s' does not match '%s'\n",
+				ast_category_get_name(left_cat), ast_category_get_name(right_cat));
+			return -1;
+		}
+
+		left_templates = ast_category_get_templates(left_cat);
+		right_templates = ast_category_get_templates(right_cat);
+		templates_match = !left_templates == !right_templates
+			&& (!left_templates
+				|| !strcmp(ast_str_buffer(left_templates), ast_str_buffer(right_templates)));
+		ast_free(left_templates);
+		ast_free(right_templates);
+		if (!templates_match) {
+			ast_test_status_update(test, "Templates of category '%s' do not match\n",
+				ast_category_get_name(left_cat));
+			return -1;
+		}
+
+		left_var = ast_category_first(left_cat);
+		right_var = ast_category_first(right_cat);
+		for (; left_var && right_var; left_var = left_var->next, right_var = right_var->next) {
+			if (strcmp(left_var->name, right_var->name)
+				|| strcmp(left_var->value, right_var->value)
+				|| strcmp(left_var->file, right_var->file)
+				|| left_var->lineno != right_var->lineno
+				|| left_var->object != right_var->object
+				|| left_var->inherited != right_var->inherited) {
+				ast_test_status_update(test, "Variable '%s' of category '%s' does not match\n",
+					left_var->name, ast_category_get_name(left_cat));
+				return -1;
+			}
+		}
+		if (left_var || right_var) {
+			ast_test_status_update(test, "Category '%s' has a different number of variables\n",
+				ast_category_get_name(left_cat));
+			return -1;
+		}
+	}
+
+	if (left_cat || right_cat) {
+		ast_test_status_update(test, "Configs have a different number of categories\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(config_parse_cache)
+{
+	enum ast_test_result_state res = AST_TEST_FAIL;
+	struct ast_flags config_flags = { 0 };
+	struct ast_flags reload_flags = { CONFIG_FLAG_FILEUNCHANGED };
+	struct ast_config *first = NULL;
+	struct ast_config *cfg = NULL;
+	char filename[PATH_MAX];
+	const char *value;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "config_parse_cache";
+		info->category = "/main/config/";
+		info->summary = "Test sharing parsed config files between modules";
+		info->description =
+			"Loads the same config file on behalf of several modules and\n"
+			"checks every one of them gets the same config, that unchanged\n"
+			"files are still reported as unchanged and that a change to an\n"
+			"included file is picked up.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (write_parse_cache_files("Bob <200>")) {
+		ast_test_status_update(test, "Could not write config files\n");
+		goto out;
+	}
+
+	first = ast_config_load2(CONFIG_FILE, "parse_cache_0", config_flags);
+	if (!first) {
+		ast_test_status_update(test, "Could not load config\n");
+		goto out;
+	}
+
+	/* The second load keeps the parse result, the ones after it get a copy */
+	for (i = 1; i < 4; i++) {
+		char who_asked[32];
+
+		snprintf(who_asked, sizeof(who_asked), "parse_cache_%d", i);
+		cfg = ast_config_load2(CONFIG_FILE, who_asked, config_flags);
+		if (!cfg || compare_parse_cache_configs(test, first, cfg)) {
+			ast_test_status_update(test, "Load %d does not match the first load\n", i);
+			goto out;
+		}
+		ast_config_destroy(cfg);
+		cfg = NULL;
+	}
+
+	value = ast_variable_retrieve(first, "alice", "mailbox");
+	if (strcmp(S_OR(value, ""), "100")) {
+		ast_test_status_update(test, "Category addition after the include is missing\n");
+		goto out;
+	}
+
+	for (i = 0; i < 4; i++) {
+		char who_asked[32];
+
+		snprintf(who_asked, sizeof(who_asked), "parse_cache_%d", i);
+		cfg = ast_config_load2(CONFIG_FILE, who_asked, reload_flags);
+		if (cfg != CONFIG_STATUS_FILEUNCHANGED) {
+			ast_test_status_update(test, "Unchanged config was not reported unchanged for %s\n", who_asked);
+			goto out;
+		}
+		cfg = NULL;
+	}
+
+	/* Change the size of the included file so the change is seen even within the same second */
+	if (write_parse_cache_files("Robert <2000>")) {
+		ast_test_status_update(test, "Could not rewrite config files\n");
+		goto out;
+	}
+
+	cfg = ast_config_load2(CONFIG_FILE, "parse_cache_1", reload_flags);
+	if (!cfg || cfg == CONFIG_STATUS_FILEUNCHANGED || cfg == CONFIG_STATUS_FILEINVALID) {
+		ast_test_status_update(test, "Changed include was not reloaded\n");
+		cfg = NULL;
+		goto out;
+	}
+	value = ast_variable_retrieve(cfg, "bob", "callerid");
+	if (strcmp(S_OR(value, ""), "Robert <2000>")) {
+		ast_test_status_update(test, "Changed include has the old value '%s'\n", S_OR(value, ""));
+		goto out;
+	}
+	ast_config_destroy(cfg);
+
+	ast_config_destroy(first);
+	first = ast_config_load2(CONFIG_FILE, "parse_cache_2", config_flags);
+	cfg = ast_config_load2(CONFIG_FILE, "parse_cache_3", config_flags);
+	if (!first || !cfg || compare_parse_cache_configs(test, first, cfg)) {
+		ast_test_status_update(test, "Loads after the change do not match\n");
+		goto out;
+	}
+	value = ast_variable_retrieve(cfg, "bob", "callerid");
+	if (strcmp(S_OR(value, ""), "Robert <2000>")) {
+		ast_test_status_update(test, "Copied config has the old value '%s'\n", S_OR(value, ""));
+		goto out;
+	}
+
+	res = AST_TEST_PASS;
+
+out:
+	ast_config_destroy(first);
+	ast_config_destroy(cfg);
+	delete_config_file();
+	snprintf(filename, sizeof(filename), "%s/%s", ast_config_AST_CONFIG_DIR, CONFIG_INCLUDE_FILE);
+	unlink(filename);
+	return res;
+}
+
 enum {
 	EXPECT_FAIL = 0,
 	EXPECT_SUCCEED,
@@ -1901,6 +2133,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(config_template_ops);
 	AST_TEST_UNREGISTER(copy_config);
 	AST_TEST_UNREGISTER(config_hook);
+	AST_TEST_UNREGISTER(config_parse_cache);
 	AST_TEST_UNREGISTER(ast_parse_arg_test);
 	AST_TEST_UNREGISTER(config_options_test);
 	AST_TEST_UNREGISTER(config_dialplan_function);
@@ -1916,6 +2149,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(config_template_ops);
 	AST_TEST_REGISTER(copy_config);
 	AST_TEST_REGISTER(config_hook);
+	AST_TEST_REGISTER(config_parse_cache);
 	AST_TEST_REGISTER(ast_parse_arg_test);
 	AST_TEST_REGISTER(config_options_test);
 	AST_TEST_REGISTER(config_dialplan_function);
@@ -35,6 +35,7 @@
 #include "asterisk/module.h"
 #include "asterisk/codec.h"
 #include "asterisk/format.h"
+#include "asterisk/format_cache.h"
 
 #define TEST_CATEGORY "/main/core_format/"
 
@@ -1016,6 +1017,78 @@ AST_TEST_DEFINE(format_parse_and_generate_sdp_fmtp)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(format_interned_parse_and_joint)
+{
+	RAII_VAR(struct ast_codec *, codec, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, format, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, first, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, second, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, other, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, joint, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, joint_again, NULL, ao2_cleanup);
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = __PRETTY_FUNCTION__;
+		info->category = TEST_CATEGORY;
+		info->summary = "Interned format fmtp and joint caching unit test";
+		info->description =
+			"Test that parsing the same fmtp line on an interned format and joining\n"
+			"the results reuses the first result instead of calling the interface again";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	codec = ast_codec_get("test_core_format_codec", AST_MEDIA_TYPE_AUDIO, 8000);
+	if (!codec) {
+		ast_test_status_update(test, "Could not retrieve test_core_format_codec codec\n");
+		return AST_TEST_FAIL;
+	}
+
+	format = ast_format_create(codec);
+	if (!format) {
+		ast_test_status_update(test, "Could not create format using test_core_format_codec codec\n");
+		return AST_TEST_FAIL;
+	}
+	ast_format_set_interned(format);
+
+	first = ast_format_parse_sdp_fmtp(format, "one=1000;two=256");
+	second = ast_format_parse_sdp_fmtp(format, "one=1000;two=256");
+	other = ast_format_parse_sdp_fmtp(format, "one=8;two=16");
+	if (!first || !second || !other) {
+		ast_test_status_update(test, "Failed to parse SDP on an interned format\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (first != second || first == other || !ast_format_is_interned(first)) {
+		ast_test_status_update(test, "Parsing the same line twice did not return the interned result\n");
+		res = AST_TEST_FAIL;
+	}
+	if (test_callbacks_called.format_parse_sdp_fmtp != 2) {
+		ast_test_status_update(test, "Expected 2 parses, got %d\n", test_callbacks_called.format_parse_sdp_fmtp);
+		res = AST_TEST_FAIL;
+	}
+
+	joint = ast_format_joint(first, other);
+	joint_again = ast_format_joint(second, other);
+	if (!joint || joint != joint_again) {
+		ast_test_status_update(test, "Joining interned formats twice did not return the interned result\n");
+		res = AST_TEST_FAIL;
+	}
+	if (test_callbacks_called.format_get_joint != 1) {
+		ast_test_status_update(test, "Expected 1 joint computation, got %d\n", test_callbacks_called.format_get_joint);
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	/* The cache refers to formats of this module's codec, do not leave them behind */
+	ast_format_cache_attributes_flush();
+
+	return res;
+}
+
 static int test_core_format_init(struct ast_test_info *info, struct ast_test *test)
 {
 	memset(&test_callbacks_called, 0, sizeof(test_callbacks_called));
@@ -1040,6 +1113,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(format_attribute_get_without_interface);
 	AST_TEST_UNREGISTER(format_parse_sdp_fmtp_without_interface);
 	AST_TEST_UNREGISTER(format_parse_and_generate_sdp_fmtp);
+	AST_TEST_UNREGISTER(format_interned_parse_and_joint);
 
 	return 0;
 }
@@ -1072,6 +1146,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(format_attribute_get_without_interface);
 	AST_TEST_REGISTER(format_parse_sdp_fmtp_without_interface);
 	AST_TEST_REGISTER(format_parse_and_generate_sdp_fmtp);
+	AST_TEST_REGISTER(format_interned_parse_and_joint);
 
 	ast_test_register_init(TEST_CATEGORY, &test_core_format_init);
 
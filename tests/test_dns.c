@@ -644,6 +644,8 @@ AST_TEST_DEFINE(resolver_add_record_off_nominal)
 static struct resolver_data {
 	/*! True if the resolver's resolve() method has been called */
 	int resolve_called;
+	/*! The number of times the resolver's resolve() method has been called */
+	int resolve_count;
 	/*! True if the resolver's cancel() method has been called */
 	int canceled;
 	/*! True if resolution successfully completed. This is mutually exclusive with \ref canceled */
@@ -717,6 +719,7 @@ static int test_resolve(struct ast_dns_query *query)
 	pthread_t resolver_thread;
 
 	test_resolver_data.resolve_called = 1;
+	ast_atomic_fetchadd_int(&test_resolver_data.resolve_count, +1);
 	return ast_pthread_create_detached(&resolver_thread, NULL, resolution_thread, ao2_bump(query));
 }
 
@@ -746,6 +749,7 @@ static int test_cancel(struct ast_dns_query *query)
 static void resolver_data_init(void)
 {
 	test_resolver_data.resolve_called = 0;
+	test_resolver_data.resolve_count = 0;
 	test_resolver_data.canceled = 0;
 	test_resolver_data.resolution_complete = 0;
 
@@ -1296,6 +1300,125 @@ cleanup:
 	return res;
 }
 
+/*!
+ * \brief Wait for an async query to complete
+ *
+ * \retval 0 The query completed
+ * \retval -1 The query timed out
+ */
+static int async_wait(struct async_resolution_data *async_data)
+{
+	struct timespec timeout;
+
+	timeout = ast_tsnow();
+	timeout.tv_sec += 10;
+	ast_mutex_lock(&async_data->lock);
+	while (!async_data->complete) {
+		if (ast_cond_timedwait(&async_data->cond, &async_data->lock, &timeout) == ETIMEDOUT) {
+			break;
+		}
+	}
+	ast_mutex_unlock(&async_data->lock);
+
+	return async_data->complete ? 0 : -1;
+}
+
+AST_TEST_DEFINE(resolver_resolve_cached)
+{
+	RAII_VAR(struct async_resolution_data *, async_data1, NULL, ao2_cleanup);
+	RAII_VAR(struct async_resolution_data *, async_data2, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_dns_query_active *, active1, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_dns_query_active *, active2, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_dns_result *, result, NULL, ast_dns_result_free);
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "resolver_resolve_cached";
+		info->category = "/main/dns/";
+		info->summary = "Test DNS resolution through the DNS result cache";
+		info->description =
+			"This test performs two asynchronous DNS resolutions of the same domain through\n"
+			"the DNS result cache at the same time, followed by a synchronous resolution of\n"
+			"it. The goal of this test is to ensure that the concurrent queries result in a\n"
+			"single call into the resolver, that both receive records, and that the later\n"
+			"query is answered from the cache without calling into the resolver.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (ast_dns_resolver_register(&test_resolver)) {
+		ast_test_status_update(test, "Unable to register test resolver\n");
+		return AST_TEST_FAIL;
+	}
+
+	resolver_data_init();
+	ast_dns_cache_flush();
+
+	async_data1 = async_data_alloc();
+	async_data2 = async_data_alloc();
+	if (!async_data1 || !async_data2) {
+		ast_test_status_update(test, "Failed to allocate asynchronous data\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	active1 = ast_dns_resolve_async_cached("asterisk.org", T_A, C_IN, async_callback, async_data1);
+	active2 = ast_dns_resolve_async_cached("ASTERISK.org", T_A, C_IN, async_callback, async_data2);
+	if (!active1 || !active2) {
+		ast_test_status_update(test, "Asynchronous resolution of address failed\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (test_resolver_data.resolve_count != 1) {
+		ast_test_status_update(test, "Concurrent queries called the resolver's resolve() method %d times\n",
+			test_resolver_data.resolve_count);
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (async_wait(async_data1) || async_wait(async_data2)) {
+		ast_test_status_update(test, "Asynchronous resolution timed out\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (!ast_dns_query_get_result(active1->query)
+		|| !ast_dns_result_get_records(ast_dns_query_get_result(active1->query))
+		|| !ast_dns_query_get_result(active2->query)
+		|| !ast_dns_result_get_records(ast_dns_query_get_result(active2->query))) {
+		ast_test_status_update(test, "Asynchronous resolution yielded no records\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (ast_dns_resolve_cached("asterisk.org", T_A, C_IN, &result)) {
+		ast_test_status_update(test, "Resolution of address failed\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (test_resolver_data.resolve_count != 1) {
+		ast_test_status_update(test, "Cached result was not used\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (!ast_dns_result_get_records(result)) {
+		ast_test_status_update(test, "Cached result had no records\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+cleanup:
+	ast_dns_cache_flush();
+	ast_dns_resolver_unregister(&test_resolver);
+	resolver_data_cleanup();
+	return res;
+}
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(resolver_register_unregister);
@@ -1311,6 +1434,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(resolver_resolve_async);
 	AST_TEST_UNREGISTER(resolver_resolve_async_off_nominal);
 	AST_TEST_UNREGISTER(resolver_resolve_async_cancel);
+	AST_TEST_UNREGISTER(resolver_resolve_cached);
 
 	return 0;
 }
@@ -1330,6 +1454,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(resolver_resolve_async);
 	AST_TEST_REGISTER(resolver_resolve_async_off_nominal);
 	AST_TEST_REGISTER(resolver_resolve_async_cancel);
+	AST_TEST_REGISTER(resolver_resolve_cached);
 
 	return AST_MODULE_LOAD_SUCCESS;
 }
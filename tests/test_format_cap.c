@@ -1067,6 +1067,98 @@ AST_TEST_DEFINE(format_cap_iscompatible)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(format_cap_compare_after_remove)
+{
+	RAII_VAR(struct ast_format_cap *, caps1, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format_cap *, caps2, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_codec *, ulaw, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, ulaw_format, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_codec *, alaw, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_format *, alaw_format, NULL, ao2_cleanup);
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "format_cap_compare_after_remove";
+		info->category = "/main/format_cap/";
+		info->summary = "format capabilities comparison unit test";
+		info->description =
+			"Test that comparing capabilities structures follows formats being added and removed";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	caps1 = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+	caps2 = ast_format_cap_alloc(AST_FORMAT_CAP_FLAG_DEFAULT);
+	if (!caps1 || !caps2) {
+		ast_test_status_update(test, "Could not allocate an empty format capabilities structure\n");
+		return AST_TEST_FAIL;
+	}
+
+	ulaw = ast_codec_get("ulaw", AST_MEDIA_TYPE_AUDIO, 8000);
+	alaw = ast_codec_get("alaw", AST_MEDIA_TYPE_AUDIO, 8000);
+	if (!ulaw || !alaw) {
+		ast_test_status_update(test, "Could not retrieve built-in ulaw and alaw codecs\n");
+		return AST_TEST_FAIL;
+	}
+
+	ulaw_format = ast_format_create(ulaw);
+	alaw_format = ast_format_create(alaw);
+	if (!ulaw_format || !alaw_format) {
+		ast_test_status_update(test, "Could not create ulaw and alaw formats using built-in codecs\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_format_cap_append(caps1, ulaw_format, 0) || ast_format_cap_append(caps1, alaw_format, 0)) {
+		ast_test_status_update(test, "Could not add ulaw and alaw formats to first capabilities\n");
+		return AST_TEST_FAIL;
+	} else if (ast_format_cap_append(caps2, alaw_format, 0) || ast_format_cap_append(caps2, ulaw_format, 0)) {
+		ast_test_status_update(test, "Could not add alaw and ulaw formats to second capabilities\n");
+		return AST_TEST_FAIL;
+	} else if (!ast_format_cap_identical(caps1, caps2)) {
+		ast_test_status_update(test, "Capabilities with the same formats in a different order are not identical\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_format_cap_remove(caps1, ulaw_format)) {
+		ast_test_status_update(test, "Could not remove ulaw format from first capabilities\n");
+		return AST_TEST_FAIL;
+	} else if (ast_format_cap_identical(caps1, caps2)) {
+		ast_test_status_update(test, "Capabilities with different formats are identical\n");
+		return AST_TEST_FAIL;
+	} else if (!ast_format_cap_iscompatible(caps1, caps2)) {
+		ast_test_status_update(test, "Capabilities sharing alaw are not compatible\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_format_cap_remove(caps2, alaw_format)) {
+		ast_test_status_update(test, "Could not remove alaw format from second capabilities\n");
+		return AST_TEST_FAIL;
+	} else if (ast_format_cap_iscompatible(caps1, caps2)) {
+		ast_test_status_update(test, "Capabilities with no format in common are compatible\n");
+		return AST_TEST_FAIL;
+	}
+
+	ast_format_cap_remove_by_type(caps1, AST_MEDIA_TYPE_AUDIO);
+	if (ast_format_cap_has_type(caps1, AST_MEDIA_TYPE_AUDIO)) {
+		ast_test_status_update(test, "Capabilities have audio after removing all audio formats\n");
+		return AST_TEST_FAIL;
+	} else if (!ast_format_cap_has_type(caps2, AST_MEDIA_TYPE_AUDIO)) {
+		ast_test_status_update(test, "Capabilities with ulaw have no audio\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_format_cap_append(caps1, ulaw_format, 0)) {
+		ast_test_status_update(test, "Could not add ulaw format back to first capabilities\n");
+		return AST_TEST_FAIL;
+	} else if (!ast_format_cap_identical(caps1, caps2)) {
+		ast_test_status_update(test, "Capabilities with only ulaw are not identical\n");
+		return AST_TEST_FAIL;
+	}
+
+	return AST_TEST_PASS;
+}
+
 AST_TEST_DEFINE(format_cap_get_names)
 {
 	RAII_VAR(struct ast_format_cap *, empty_caps, NULL, ao2_cleanup);
@@ -1442,6 +1534,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(format_cap_iscompatible_format);
 	AST_TEST_UNREGISTER(format_cap_get_compatible);
 	AST_TEST_UNREGISTER(format_cap_iscompatible);
+	AST_TEST_UNREGISTER(format_cap_compare_after_remove);
 	AST_TEST_UNREGISTER(format_cap_best_by_type);
 	AST_TEST_UNREGISTER(format_cap_replace_from_cap);
 	return 0;
@@ -1467,6 +1560,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(format_cap_iscompatible_format);
 	AST_TEST_REGISTER(format_cap_get_compatible);
 	AST_TEST_REGISTER(format_cap_iscompatible);
+	AST_TEST_REGISTER(format_cap_compare_after_remove);
 	AST_TEST_REGISTER(format_cap_best_by_type);
 	AST_TEST_REGISTER(format_cap_replace_from_cap);
 	ast_codec_register(&test_law);
@@ -0,0 +1,438 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Frame allocation tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/frame.h"
+#include "asterisk/format_cache.h"
+#include "asterisk/options.h"
+#include "asterisk/utils.h"
+
+/*! Number of frames handed between threads */
+#define TEST_FRAMES 64
+
+/*! Payload sizes covering every slab size class and the heap */
+static const int test_datalens[] = { 0, 1, 160, 161, 320, 640, 1280, 1920, 1921, 8000 };
+
+/*! The frame slab only exists in builds with the frame cache enabled */
+static int slab_enabled(void)
+{
+#if defined(LOW_MEMORY) || defined(MALLOC_DEBUG)
+	return 0;
+#else
+	return ast_opt_cache_media_frames;
+#endif
+}
+
+static void fill_frame(struct ast_frame *fr, unsigned char *buf, int datalen, int seed)
+{
+	int i;
+
+	for (i = 0; i < datalen; i++) {
+		buf[i] = (unsigned char) (seed + i);
+	}
+
+	memset(fr, 0, sizeof(*fr));
+	fr->frametype = AST_FRAME_VOICE;
+	fr->subclass.format = ast_format_slin;
+	fr->datalen = datalen;
+	fr->samples = datalen / 2;
+	fr->data.ptr = buf;
+	fr->src = "test_frame";
+}
+
+static int check_frame(struct ast_test *test, struct ast_frame *fr, int datalen, int seed)
+{
+	unsigned char *data = fr->data.ptr;
+	int i;
+
+	if (fr->datalen != datalen || strcmp(fr->src, "test_frame")) {
+		ast_test_status_update(test, "Frame has datalen %d src '%s', expected %d 'test_frame'\n",
+			fr->datalen, fr->src, datalen);
+		return -1;
+	}
+	for (i = 0; i < datalen; i++) {
+		if (data[i] != (unsigned char) (seed + i)) {
+			ast_test_status_update(test, "Frame of %d bytes corrupt at byte %d\n", datalen, i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(frame_dup_reuse)
+{
+	unsigned char buf[8000];
+	struct ast_frame fr;
+	struct ast_frame *dup;
+	void *first;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame_dup_reuse";
+		info->category = "/main/frame/";
+		info->summary = "Duplicated frames are intact and their memory is reused";
+		info->description =
+			"Duplicates frames of a range of sizes, checks their contents and\n"
+			"that freeing and duplicating again on the same thread hands back\n"
+			"the same memory when the frame slab is in use.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < ARRAY_LEN(test_datalens); i++) {
+		fill_frame(&fr, buf, test_datalens[i], i);
+		dup = ast_frdup(&fr);
+		ast_test_validate(test, dup != NULL);
+		if (check_frame(test, dup, test_datalens[i], i)) {
+			ast_frfree(dup);
+			return AST_TEST_FAIL;
+		}
+		first = dup;
+		ast_frfree(dup);
+
+		dup = ast_frdup(&fr);
+		ast_test_validate(test, dup != NULL);
+		if (check_frame(test, dup, test_datalens[i], i)) {
+			ast_frfree(dup);
+			return AST_TEST_FAIL;
+		}
+		if (slab_enabled() && test_datalens[i] <= 1920 && dup != first) {
+			ast_test_status_update(test, "Frame of %d bytes was not reused\n", test_datalens[i]);
+			ast_frfree(dup);
+			return AST_TEST_FAIL;
+		}
+		ast_frfree(dup);
+	}
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(frame_isolate)
+{
+	unsigned char buf[1280];
+	struct ast_frame fr;
+	struct ast_frame *hdr;
+	struct ast_frame *out;
+	struct ast_frame *copy;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame_isolate";
+		info->category = "/main/frame/";
+		info->summary = "Isolating partially allocated frames";
+		info->description =
+			"Isolates frames whose header, or only whose data, needs copying\n"
+			"and checks the result is intact and can be freed.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	/* Heap header with static data, the data gets duplicated in place */
+	fill_frame(&fr, buf, sizeof(buf), 7);
+	hdr = ast_calloc(1, sizeof(*hdr));
+	ast_test_validate(test, hdr != NULL);
+	*hdr = fr;
+	hdr->subclass.format = ao2_bump(ast_format_slin);
+	hdr->mallocd = AST_MALLOCD_HDR;
+	out = ast_frisolate(hdr);
+	ast_test_validate(test, out == hdr);
+	ast_test_validate(test, out->data.ptr != buf);
+	ast_test_validate(test, (out->mallocd & (AST_MALLOCD_DATA | AST_MALLOCD_SRC))
+		== (AST_MALLOCD_DATA | AST_MALLOCD_SRC));
+	if (check_frame(test, out, sizeof(buf), 7)) {
+		ast_frfree(out);
+		return AST_TEST_FAIL;
+	}
+
+	/* Static header with allocated data, the data gets stolen by the new header */
+	copy = ast_malloc(sizeof(*copy));
+	if (!copy) {
+		ast_frfree(out);
+		return AST_TEST_FAIL;
+	}
+	*copy = *out;
+	copy->mallocd &= ~AST_MALLOCD_HDR;
+	ast_free(out);
+	out = ast_frisolate(copy);
+	if (!out || out == copy || copy->data.ptr || (copy->mallocd & AST_MALLOCD_DATA)) {
+		ast_test_status_update(test, "Isolated frame did not take over the data buffer\n");
+		ast_frfree(copy);
+		ast_free(copy);
+		if (out && out != copy) {
+			ast_frfree(out);
+		}
+		return AST_TEST_FAIL;
+	}
+	/* The static header still holds its own format reference */
+	ao2_cleanup(copy->subclass.format);
+	ast_free(copy);
+	if (check_frame(test, out, sizeof(buf), 7)) {
+		ast_frfree(out);
+		return AST_TEST_FAIL;
+	}
+	ast_frfree(out);
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(frame_share)
+{
+	unsigned char buf[320];
+	struct ast_frame fr;
+	struct ast_frame *shared;
+	struct ast_frame *copies[3];
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame_share";
+		info->category = "/main/frame/";
+		info->summary = "Frames sharing one payload";
+		info->description =
+			"Shares a frame several times, checks every copy refers to the same\n"
+			"read only payload, that the payload outlives the frame it was shared\n"
+			"from and that unsharing gives a private, writable copy.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	fill_frame(&fr, buf, sizeof(buf), 11);
+	shared = ast_frshare(&fr);
+	ast_test_validate(test, shared != NULL);
+	ast_test_validate(test, (shared->mallocd & AST_MALLOCD_SHARED) && shared->offset == 0);
+	ast_test_validate(test, shared->data.ptr != buf);
+
+	for (i = 0; i < ARRAY_LEN(copies); i++) {
+		copies[i] = ast_frshare(shared);
+		if (!copies[i] || copies[i]->data.ptr != shared->data.ptr || copies[i]->src != shared->src) {
+			ast_test_status_update(test, "Shared frame %d does not refer to the original payload\n", i);
+			ast_frfree(shared);
+			while (i >= 0) {
+				ast_frfree(copies[i--]);
+			}
+			return AST_TEST_FAIL;
+		}
+	}
+	ast_frfree(shared);
+
+	for (i = 0; i < ARRAY_LEN(copies); i++) {
+		if (check_frame(test, copies[i], sizeof(buf), 11)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+
+	if (res == AST_TEST_PASS && ast_frunshare(copies[0])) {
+		res = AST_TEST_FAIL;
+	} else if (res == AST_TEST_PASS) {
+		if ((copies[0]->mallocd & AST_MALLOCD_SHARED) || copies[0]->offset != AST_FRIENDLY_OFFSET
+			|| copies[0]->data.ptr == copies[1]->data.ptr) {
+			ast_test_status_update(test, "Unshared frame still refers to the shared payload\n");
+			res = AST_TEST_FAIL;
+		} else {
+			/* Writing to the private copy must not show through the others */
+			memset(copies[0]->data.ptr, 0, copies[0]->datalen);
+			if (check_frame(test, copies[1], sizeof(buf), 11)) {
+				res = AST_TEST_FAIL;
+			}
+		}
+	}
+
+	for (i = 0; i < ARRAY_LEN(copies); i++) {
+		ast_frfree(copies[i]);
+	}
+
+	return res;
+}
+
+AST_TEST_DEFINE(frame_ingress)
+{
+	unsigned char buf[320];
+	struct ast_frame fr;
+	struct ast_frame *dup;
+	struct ast_frame *shared;
+	struct ast_frame *isolated;
+	struct timeval ingress = { 1234, 5678 };
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame_ingress";
+		info->category = "/main/frame/";
+		info->summary = "Frame ingress time survives copying";
+		info->description =
+			"Checks that duplicating, sharing and isolating a frame keep the\n"
+			"time its media entered Asterisk.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	fill_frame(&fr, buf, sizeof(buf), 3);
+	fr.ingress = ingress;
+
+	dup = ast_frdup(&fr);
+	shared = ast_frshare(&fr);
+	isolated = ast_frisolate(&fr);
+	if (!dup || !shared || !isolated) {
+		ast_test_status_update(test, "Failed to copy the frame\n");
+		res = AST_TEST_FAIL;
+	} else if (!ast_tveq(dup->ingress, ingress) || !ast_tveq(shared->ingress, ingress)
+		|| !ast_tveq(isolated->ingress, ingress)) {
+		ast_test_status_update(test, "Copied frame lost its ingress time\n");
+		res = AST_TEST_FAIL;
+	}
+
+	ast_frfree(dup);
+	ast_frfree(shared);
+	if (isolated != &fr) {
+		ast_frfree(isolated);
+	}
+
+	return res;
+}
+
+static void *free_frames(void *data)
+{
+	struct ast_frame **frames = data;
+	int i;
+
+	for (i = 0; i < TEST_FRAMES; i++) {
+		ast_frfree(frames[i]);
+	}
+
+	return NULL;
+}
+
+AST_TEST_DEFINE(frame_cross_thread_free)
+{
+	unsigned char buf[320];
+	struct ast_frame fr;
+	struct ast_frame *frames[TEST_FRAMES];
+	struct ast_frame *dups[TEST_FRAMES];
+	pthread_t thread;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int reused = 0;
+	int i;
+	int j;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "frame_cross_thread_free";
+		info->category = "/main/frame/";
+		info->summary = "Frames freed by another thread return to their owner";
+		info->description =
+			"Duplicates frames on one thread, frees them on another and checks\n"
+			"the allocating thread gets the memory back when the frame slab is\n"
+			"in use.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	fill_frame(&fr, buf, sizeof(buf), 3);
+	for (i = 0; i < TEST_FRAMES; i++) {
+		if (!(frames[i] = ast_frdup(&fr))) {
+			while (i--) {
+				ast_frfree(frames[i]);
+			}
+			return AST_TEST_FAIL;
+		}
+	}
+
+	if (ast_pthread_create(&thread, NULL, free_frames, frames)) {
+		for (i = 0; i < TEST_FRAMES; i++) {
+			ast_frfree(frames[i]);
+		}
+		return AST_TEST_FAIL;
+	}
+	pthread_join(thread, NULL);
+
+	/*
+	 * Enough allocations to run through anything already cached by this
+	 * thread and into the frames returned by the other one.
+	 */
+	for (i = 0; i < TEST_FRAMES; i++) {
+		if (!(dups[i] = ast_frdup(&fr))) {
+			break;
+		}
+		for (j = 0; j < TEST_FRAMES; j++) {
+			if (dups[i] == frames[j]) {
+				reused = 1;
+			}
+		}
+		if (check_frame(test, dups[i], sizeof(buf), 3)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	while (i--) {
+		ast_frfree(dups[i]);
+	}
+	if (res != AST_TEST_PASS) {
+		return res;
+	}
+
+	if (slab_enabled() && !reused) {
+		ast_test_status_update(test, "Frames freed by another thread were not reused\n");
+		return AST_TEST_FAIL;
+	}
+
+	return AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(frame_dup_reuse);
+	AST_TEST_UNREGISTER(frame_isolate);
+	AST_TEST_UNREGISTER(frame_share);
+	AST_TEST_UNREGISTER(frame_ingress);
+	AST_TEST_UNREGISTER(frame_cross_thread_free);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(frame_dup_reuse);
+	AST_TEST_REGISTER(frame_isolate);
+	AST_TEST_REGISTER(frame_share);
+	AST_TEST_REGISTER(frame_ingress);
+	AST_TEST_REGISTER(frame_cross_thread_free);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Frame allocation tests");
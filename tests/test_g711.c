@@ -0,0 +1,146 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief G.711 decoding kernel tests
+ *
+ * Every kernel implementation supported by the running CPU is checked
+ * bit-for-bit against the AST_MULAW() and AST_ALAW() lookup tables.
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/utils.h"
+#include "asterisk/ulaw.h"
+#include "asterisk/alaw.h"
+#include "asterisk/g711.h"
+
+/*! Large enough for a 20ms 48kHz frame plus an odd tail */
+#define TEST_SAMPLES 967
+
+static int compare_buffers(struct ast_test *test, const char *name, const char *law,
+	unsigned int samples, const unsigned char *src, const short *actual)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		short expected = !strcmp(law, "ulaw") ? AST_MULAW(src[i]) : AST_ALAW(src[i]);
+
+		if (expected != actual[i]) {
+			ast_test_status_update(test, "%s %s: code 0x%02x at %u of %u is %d, expected %d\n",
+				name, law, src[i], i, samples, actual[i], expected);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(kernels_match_tables)
+{
+	unsigned char src[TEST_SAMPLES];
+	short actual[TEST_SAMPLES];
+	int impl;
+	int tested = 0;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "kernels_match_tables";
+		info->category = "/main/g711/";
+		info->summary = "Compare G.711 decoding kernels against the lookup tables";
+		info->description =
+			"Decodes every mu-law and A-law code, and random input of varying\n"
+			"lengths, with every implementation supported by this CPU and checks\n"
+			"the output is identical to the lookup tables.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_test_status_update(test, "Active implementation is '%s'\n",
+		ast_g711_active_ops()->name);
+
+	for (impl = AST_G711_SCALAR; impl < AST_G711_IMPL_MAX; impl++) {
+		const struct ast_g711_ops *ops = ast_g711_get_ops(impl);
+		unsigned int samples;
+		unsigned int i;
+
+		if (!ops) {
+			continue;
+		}
+		ast_test_status_update(test, "Testing '%s'\n", ops->name);
+		tested++;
+
+		/* Every code in every lane position */
+		for (i = 0; i < TEST_SAMPLES; i++) {
+			src[i] = i;
+		}
+		ops->ulaw_decode(actual, src, TEST_SAMPLES);
+		if (compare_buffers(test, ops->name, "ulaw", TEST_SAMPLES, src, actual)) {
+			return AST_TEST_FAIL;
+		}
+		ops->alaw_decode(actual, src, TEST_SAMPLES);
+		if (compare_buffers(test, ops->name, "alaw", TEST_SAMPLES, src, actual)) {
+			return AST_TEST_FAIL;
+		}
+
+		/* Cover every possible tail length along with full frames */
+		for (samples = 0; samples <= TEST_SAMPLES; samples += (samples < 40 ? 1 : 37)) {
+			for (i = 0; i < samples; i++) {
+				src[i] = ast_random();
+			}
+
+			ops->ulaw_decode(actual, src, samples);
+			if (compare_buffers(test, ops->name, "ulaw", samples, src, actual)) {
+				return AST_TEST_FAIL;
+			}
+			ops->alaw_decode(actual, src, samples);
+			if (compare_buffers(test, ops->name, "alaw", samples, src, actual)) {
+				return AST_TEST_FAIL;
+			}
+		}
+	}
+
+	ast_test_validate(test, tested > 0);
+
+	return AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(kernels_match_tables);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(kernels_match_tables);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "G.711 decoding kernel tests");
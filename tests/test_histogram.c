@@ -0,0 +1,249 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Latency histogram tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/utils.h"
+#include "asterisk/histogram.h"
+
+#define TEST_FAMILY "test_histogram"
+
+/*! \brief Where snapshots of the test histograms are copied to */
+struct test_snapshots {
+	struct ast_histogram_snapshot first;
+	struct ast_histogram_snapshot second;
+	int seen;
+};
+
+static void test_snapshot_cb(const struct ast_histogram_snapshot *snapshot,
+	int first, void *data)
+{
+	struct test_snapshots *snapshots = data;
+
+	if (strcmp(snapshot->name, TEST_FAMILY)) {
+		return;
+	}
+
+	if (!strcmp(snapshot->value, "first")) {
+		snapshots->first = *snapshot;
+	} else if (!strcmp(snapshot->value, "second")) {
+		snapshots->second = *snapshot;
+	}
+	snapshots->seen++;
+}
+
+/*!
+ * \brief Find the bucket a sample is counted in
+ *
+ * Histograms are never emptied, so this compares snapshots taken before
+ * and after the sample is recorded.
+ *
+ * \return The bucket, or -1 if not exactly one bucket gained a sample
+ *         or the sum did not grow by the sample.
+ */
+static int sample_bucket(struct ast_histogram *histogram, long long sample)
+{
+	struct test_snapshots before = { .seen = 0, };
+	struct test_snapshots after = { .seen = 0, };
+	int bucket = -1;
+	int i;
+
+	ast_histogram_foreach(test_snapshot_cb, &before);
+	ast_histogram_record(histogram, sample);
+	ast_histogram_foreach(test_snapshot_cb, &after);
+
+	if (after.first.sum - before.first.sum != (sample > 0 ? sample : 0)) {
+		return -1;
+	}
+
+	for (i = 0; i <= AST_HISTOGRAM_BUCKETS; i++) {
+		unsigned long long added = after.first.buckets[i] - before.first.buckets[i];
+
+		if (added > 1 || (added && bucket != -1)) {
+			return -1;
+		}
+		if (added) {
+			bucket = i;
+		}
+	}
+
+	return bucket;
+}
+
+AST_TEST_DEFINE(buckets)
+{
+	struct ast_histogram *histogram;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "buckets";
+		info->category = "/main/histogram/";
+		info->summary = "Samples land in the bucket whose bound covers them";
+		info->description =
+			"Records each bucket bound, and each bound plus one, and checks\n"
+			"the bucket each sample was counted in.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 1; i < AST_HISTOGRAM_BUCKETS; i++) {
+		if (ast_histogram_bucket_bound(i) <= ast_histogram_bucket_bound(i - 1)) {
+			ast_test_status_update(test, "Bound of bucket %d is not above the one before it\n", i);
+			return AST_TEST_FAIL;
+		}
+	}
+	if (ast_histogram_bucket_bound(AST_HISTOGRAM_BUCKETS - 1) != 1ULL << 25) {
+		ast_test_status_update(test, "The last bound is %llu\n",
+			ast_histogram_bucket_bound(AST_HISTOGRAM_BUCKETS - 1));
+		return AST_TEST_FAIL;
+	}
+
+	histogram = ast_histogram_get(TEST_FAMILY, "Test histogram", "value", "first");
+	if (!histogram) {
+		ast_test_status_update(test, "Could not create a histogram\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (sample_bucket(histogram, -5) != 0 || sample_bucket(histogram, 0) != 0) {
+		ast_test_status_update(test, "Samples of 0 and below are not counted in bucket 0\n");
+		res = AST_TEST_FAIL;
+	}
+
+	for (i = 0; i < AST_HISTOGRAM_BUCKETS; i++) {
+		long long bound = ast_histogram_bucket_bound(i);
+		int bucket;
+
+		bucket = sample_bucket(histogram, bound);
+		if (bucket != i) {
+			ast_test_status_update(test, "Sample %lld counted in bucket %d, expected %d\n",
+				bound, bucket, i);
+			res = AST_TEST_FAIL;
+		}
+		bucket = sample_bucket(histogram, bound + 1);
+		if (bucket != i + 1) {
+			ast_test_status_update(test, "Sample %lld counted in bucket %d, expected %d\n",
+				bound + 1, bucket, i + 1);
+			res = AST_TEST_FAIL;
+		}
+	}
+
+	ao2_ref(histogram, -1);
+
+	return res;
+}
+
+AST_TEST_DEFINE(foreach)
+{
+	struct ast_histogram *first;
+	struct ast_histogram *second;
+	struct ast_histogram *again;
+	struct test_snapshots before = { .seen = 0, };
+	struct test_snapshots after = { .seen = 0, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "foreach";
+		info->category = "/main/histogram/";
+		info->summary = "Histograms are shared by name and label value";
+		info->description =
+			"Looks up two histograms of one family, one of them twice, adds\n"
+			"samples and checks the snapshots account for each of them.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	first = ast_histogram_get(TEST_FAMILY, "Test histogram", "value", "first");
+	second = ast_histogram_get(TEST_FAMILY, "Test histogram", "value", "second");
+	again = ast_histogram_get(TEST_FAMILY, "Test histogram", "value", "first");
+	if (!first || !second || !again) {
+		ast_test_status_update(test, "Could not create the histograms\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (first != again) {
+		ast_test_status_update(test, "The same name and value gave two histograms\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	ast_histogram_foreach(test_snapshot_cb, &before);
+
+	ast_histogram_record(first, 10);
+	ast_histogram_record(again, 2000);
+	ast_histogram_record(second, 1ULL << 30);
+
+	ast_histogram_foreach(test_snapshot_cb, &after);
+
+	if (after.seen != 2) {
+		ast_test_status_update(test, "Saw %d test histograms, expected 2\n", after.seen);
+		res = AST_TEST_FAIL;
+	}
+	if (after.first.count - before.first.count != 2
+		|| after.first.sum - before.first.sum != 2010) {
+		ast_test_status_update(test, "The first histogram did not get both samples\n");
+		res = AST_TEST_FAIL;
+	}
+	if (after.second.count - before.second.count != 1
+		|| after.second.buckets[AST_HISTOGRAM_BUCKETS] - before.second.buckets[AST_HISTOGRAM_BUCKETS] != 1) {
+		ast_test_status_update(test, "The second histogram did not count its sample above every bound\n");
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	ao2_cleanup(first);
+	ao2_cleanup(second);
+	ao2_cleanup(again);
+
+	return res;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(buckets);
+	AST_TEST_UNREGISTER(foreach);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(buckets);
+	AST_TEST_REGISTER(foreach);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Latency histogram tests");
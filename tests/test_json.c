@@ -1705,6 +1705,147 @@ AST_TEST_DEFINE(json_test_cep)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(json_test_dump_msgpack)
+{
+	RAII_VAR(struct ast_json *, uut, NULL, ast_json_unref);
+	RAII_VAR(char *, encoded, NULL, ast_json_free);
+	size_t len;
+	static const unsigned char expected[] = {
+		0x9d,
+		0x01,
+		0xff,
+		0xcc, 0xc8,
+		0xd1, 0xff, 0x38,
+		0xce, 0x00, 0x01, 0x11, 0x70,
+		0xd3, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xa3, 'a', 'b', 'c',
+		0xc3, 0xc2, 0xc0,
+		0xcb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x81, 0xa1, 'k', 0xa1, 'v',
+		0xd9, 0x28,
+	};
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "dump_msgpack";
+		info->category = CATEGORY;
+		info->summary = "Testing MessagePack encoding.";
+		info->description = "Test JSON abstraction library.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	uut = ast_json_pack("[i, i, i, i, i, I, s, b, b, n, f, {s: s}, s]",
+		1, -1, 200, -200, 70000, (ast_json_int_t) -(1LL << 40), "abc", 1, 0,
+		1.5, "k", "v", "0123456789012345678901234567890123456789");
+	ast_test_validate(test, NULL != uut);
+
+	encoded = ast_json_dump_msgpack(uut, &len);
+	ast_test_validate(test, NULL != encoded);
+	ast_test_validate(test, sizeof(expected) + 40 == len);
+	ast_test_validate(test, 0 == memcmp(expected, encoded, sizeof(expected)));
+	ast_test_validate(test, 0 == memcmp("0123456789", encoded + sizeof(expected), 10));
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(json_test_writer)
+{
+	RAII_VAR(struct ast_json *, expected, NULL, ast_json_unref);
+	RAII_VAR(struct ast_json *, uut, NULL, ast_json_unref);
+	RAII_VAR(struct ast_json *, embedded, NULL, ast_json_unref);
+	RAII_VAR(struct ast_str *, str, NULL, ast_free);
+	struct ast_json_writer writer;
+	struct timeval tv = { 1360251154, 314 };
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "writer";
+		info->category = CATEGORY;
+		info->summary = "Testing the streaming JSON writer.";
+		info->description = "Test JSON abstraction library.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	str = ast_str_create(16);
+	ast_test_validate(test, NULL != str);
+	embedded = ast_json_pack("{s: [i, s]}", "k", 1, "v");
+	ast_test_validate(test, NULL != embedded);
+
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_object_start(&writer);
+	ast_json_writer_key(&writer, "string");
+	ast_json_writer_string(&writer, "quote\" backslash\\ newline\n bell\a");
+	ast_json_writer_key(&writer, "null string");
+	ast_json_writer_string(&writer, NULL);
+	ast_json_writer_key(&writer, "numbers");
+	ast_json_writer_array_start(&writer);
+	ast_json_writer_integer(&writer, -(1LL << 40));
+	ast_json_writer_real(&writer, 1.5);
+	ast_json_writer_real(&writer, 2);
+	ast_json_writer_array_end(&writer);
+	ast_json_writer_key(&writer, "literals");
+	ast_json_writer_array_start(&writer);
+	ast_json_writer_boolean(&writer, 1);
+	ast_json_writer_boolean(&writer, 0);
+	ast_json_writer_null(&writer);
+	ast_json_writer_array_end(&writer);
+	ast_json_writer_key(&writer, "empty");
+	ast_json_writer_object_start(&writer);
+	ast_json_writer_object_end(&writer);
+	ast_json_writer_key(&writer, "time");
+	ast_json_writer_timeval(&writer, tv, "America/Chicago");
+	ast_json_writer_key(&writer, "embedded");
+	ast_json_writer_json(&writer, embedded);
+	ast_json_writer_object_end(&writer);
+	ast_test_validate(test, 0 == ast_json_writer_finish(&writer));
+
+	expected = ast_json_pack("{s: s, s: n, s: [I, f, f], s: [b, b, n], s: {}, s: o, s: O}",
+		"string", "quote\" backslash\\ newline\n bell\a",
+		"null string",
+		"numbers", (ast_json_int_t) -(1LL << 40), 1.5, 2.0,
+		"literals", 1, 0,
+		"empty",
+		"time", ast_json_timeval(tv, "America/Chicago"),
+		"embedded", embedded);
+	ast_test_validate(test, NULL != expected);
+	uut = ast_json_load_str(str, NULL);
+	ast_test_validate(test, NULL != uut);
+	ast_test_validate(test, ast_json_equal(expected, uut));
+	ast_test_validate(test, NULL != strstr(ast_str_buffer(str), " bell\\u0007\""));
+
+	/* Misuse is remembered until finished */
+	ast_str_reset(str);
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_object_start(&writer);
+	ast_json_writer_integer(&writer, 1);
+	ast_json_writer_object_end(&writer);
+	ast_test_validate(test, -1 == ast_json_writer_finish(&writer));
+
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_array_start(&writer);
+	ast_json_writer_object_end(&writer);
+	ast_test_validate(test, -1 == ast_json_writer_finish(&writer));
+
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_array_start(&writer);
+	ast_test_validate(test, -1 == ast_json_writer_finish(&writer));
+
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_string(&writer, "\xff");
+	ast_test_validate(test, -1 == ast_json_writer_finish(&writer));
+
+	ast_json_writer_init(&writer, &str);
+	ast_json_writer_integer(&writer, 1);
+	ast_json_writer_integer(&writer, 2);
+	ast_test_validate(test, -1 == ast_json_writer_finish(&writer));
+
+	return AST_TEST_PASS;
+}
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(json_test_false);
@@ -1758,6 +1899,8 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(json_test_name_number);
 	AST_TEST_UNREGISTER(json_test_timeval);
 	AST_TEST_UNREGISTER(json_test_cep);
+	AST_TEST_UNREGISTER(json_test_dump_msgpack);
+	AST_TEST_UNREGISTER(json_test_writer);
 	return 0;
 }
 
@@ -1814,6 +1957,8 @@ static int load_module(void)
 	AST_TEST_REGISTER(json_test_name_number);
 	AST_TEST_REGISTER(json_test_timeval);
 	AST_TEST_REGISTER(json_test_cep);
+	AST_TEST_REGISTER(json_test_dump_msgpack);
+	AST_TEST_REGISTER(json_test_writer);
 
 	ast_test_register_init(CATEGORY, json_test_init);
 	ast_test_register_cleanup(CATEGORY, json_test_cleanup);
@@ -0,0 +1,202 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Lock contention profiler tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/utils.h"
+#include "asterisk/module.h"
+#include "asterisk/astobj2.h"
+#include "asterisk/lock.h"
+
+/*! \brief How long the contended lock is held, in milliseconds */
+#define HOLD_TIME 20
+
+AST_MUTEX_DEFINE_STATIC(contended_mutex);
+
+/*! \brief The lock a contender waits for */
+struct contender {
+	/*! The mutex to lock, or NULL */
+	ast_mutex_t *mutex;
+	/*! The ao2 object to lock, or NULL */
+	void *obj;
+	/*! Set just before the contender locks */
+	int started;
+};
+
+static void *mutex_contender(void *data)
+{
+	struct contender *contender = data;
+
+	ast_atomic_fetch_add(&contender->started, 1, __ATOMIC_SEQ_CST);
+	ast_mutex_lock(contender->mutex);
+	ast_mutex_unlock(contender->mutex);
+
+	return NULL;
+}
+
+static void *ao2_contender(void *data)
+{
+	struct contender *contender = data;
+
+	ast_atomic_fetch_add(&contender->started, 1, __ATOMIC_SEQ_CST);
+	ao2_lock(contender->obj);
+	ao2_unlock(contender->obj);
+
+	return NULL;
+}
+
+/*! \brief The waits recorded at the contender's acquisition site */
+struct contender_site {
+	const char *func;
+	struct ast_lock_contention contention;
+	int found;
+};
+
+static void contender_site_cb(const struct ast_lock_contention *contention, void *data)
+{
+	struct contender_site *site = data;
+
+	if (strstr(contention->file, "test_lock_contention.c") && !strcmp(contention->func, site->func)) {
+		site->contention = *contention;
+		site->found++;
+	}
+}
+
+/*!
+ * \brief Hold a lock while a contender waits for it
+ */
+static enum ast_test_result_state contend(struct ast_test *test, void *(*start_routine)(void *),
+	struct contender *contender, const char *func, const char *type)
+{
+	struct contender_site site = { .func = func, };
+	pthread_t thread;
+
+	if (contender->mutex) {
+		ast_mutex_lock(contender->mutex);
+	} else {
+		ao2_lock(contender->obj);
+	}
+
+	if (ast_pthread_create(&thread, NULL, start_routine, contender)) {
+		ast_test_status_update(test, "Could not start the contender\n");
+		if (contender->mutex) {
+			ast_mutex_unlock(contender->mutex);
+		} else {
+			ao2_unlock(contender->obj);
+		}
+		return AST_TEST_FAIL;
+	}
+
+	while (!ast_atomic_fetch_add(&contender->started, 0, __ATOMIC_SEQ_CST)) {
+		usleep(1000);
+	}
+	usleep(HOLD_TIME * 1000);
+
+	if (contender->mutex) {
+		ast_mutex_unlock(contender->mutex);
+	} else {
+		ao2_unlock(contender->obj);
+	}
+	pthread_join(thread, NULL);
+
+	ast_lock_contention_foreach(contender_site_cb, &site);
+	if (site.found != 1) {
+		ast_test_status_update(test, "Found %d sites for %s, expected 1\n", site.found, func);
+		return AST_TEST_FAIL;
+	}
+	if (site.contention.waits < 1 || site.contention.max < (HOLD_TIME / 2) * 1000
+		|| site.contention.total < site.contention.max) {
+		ast_test_status_update(test, "%s waited %lu times, %llu microseconds at most and %llu in total\n",
+			func, site.contention.waits, site.contention.max, site.contention.total);
+		return AST_TEST_FAIL;
+	}
+	if (strcmp(site.contention.type, type)) {
+		ast_test_status_update(test, "%s waited for a %s, expected a %s\n", func,
+			site.contention.type, type);
+		return AST_TEST_FAIL;
+	}
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(contention)
+{
+	struct contender mutex = { .mutex = &contended_mutex, };
+	struct contender obj = { .obj = NULL, };
+	enum ast_test_result_state res;
+	unsigned int rate = ast_lock_contention_get();
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "contention";
+		info->category = "/main/lock/";
+		info->summary = "Waits for busy locks are recorded by acquisition site";
+		info->description =
+			"Holds a mutex and then the lock of an ao2 object while another\n"
+			"thread waits for it, and checks the profiler recorded the wait\n"
+			"at the site the other thread locked it.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	obj.obj = ao2_alloc(1, NULL);
+	if (!obj.obj) {
+		return AST_TEST_FAIL;
+	}
+
+	/* Time every wait while the test runs */
+	ast_lock_contention_set(1);
+
+	res = contend(test, mutex_contender, &mutex, "mutex_contender", "mutex");
+	if (res == AST_TEST_PASS) {
+		res = contend(test, ao2_contender, &obj, "ao2_contender", "mutex");
+	}
+
+	ast_lock_contention_set(rate);
+	ao2_ref(obj.obj, -1);
+
+	return res;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(contention);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(contention);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Lock contention profiler tests");
@@ -32,6 +32,8 @@
 
 #include "asterisk.h"
 
+#include <fcntl.h>
+
 #include "asterisk/file.h"
 #include "asterisk/channel.h"
 #include "asterisk/pbx.h"
@@ -39,6 +41,7 @@
 #include "asterisk/lock.h"
 #include "asterisk/app.h"
 #include "asterisk/cli.h"
+#include "asterisk/utils.h"
 
 struct test {
 	const char *name;
@@ -254,10 +257,111 @@ error:
 	return CLI_SUCCESS;
 }
 
+static char *handle_cli_empty_test(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
+{
+	char confpath[] = "/tmp/asterisk_logger_empty.XXXXXX";
+	char marker[64];
+	char buf[4096];
+	struct ast_str *output = NULL;
+	struct timeval start;
+	int pipefd[2] = { -1, -1 };
+	int saved_stdout = -1;
+	int found = 0;
+	int fd;
+
+	switch (cmd) {
+	case CLI_INIT:
+		e->command = "logger test empty";
+		e->usage = ""
+			"Usage: logger test empty\n"
+			"       Reloads the logger with an empty [logfiles] section, checks\n"
+			"       that messages are still written to stdout, then reloads\n"
+			"       the logger with logger.conf again.\n"
+			"";
+		return NULL;
+	case CLI_GENERATE:
+		return NULL;
+	}
+
+	fd = mkstemp(confpath);
+	if (fd < 0) {
+		ast_cli(a->fd, "Test: Failed, could not create temporary config file '%s'.\n", confpath);
+		return CLI_SUCCESS;
+	}
+	if (write(fd, "[general]\n[logfiles]\n", 21) != 21) {
+		ast_cli(a->fd, "Test: Failed, could not write temporary config file '%s'.\n", confpath);
+		goto error;
+	}
+
+	output = ast_str_create(sizeof(buf));
+	if (!output || pipe(pipefd)) {
+		ast_cli(a->fd, "Test: Failed, could not capture stdout.\n");
+		goto error;
+	}
+	ast_fd_set_flags(pipefd[0], O_NONBLOCK);
+
+	/* Without log channels messages go to stdout, so capture it */
+	fflush(stdout);
+	saved_stdout = dup(STDOUT_FILENO);
+	if (saved_stdout < 0 || dup2(pipefd[1], STDOUT_FILENO) < 0) {
+		ast_cli(a->fd, "Test: Failed, could not capture stdout.\n");
+		goto error;
+	}
+
+	ast_str_set(&output, 0, "logger reload %s", confpath);
+	ast_cli_command(a->fd, ast_str_buffer(output));
+
+	snprintf(marker, sizeof(marker), "logger test empty %ld", (long) ast_random());
+	ast_log(LOG_NOTICE, "%s\n", marker);
+
+	/* The logger thread writes it, so wait a little for it */
+	ast_str_reset(output);
+	start = ast_tvnow();
+	while (!found && ast_tvdiff_ms(ast_tvnow(), start) < 2000) {
+		ssize_t res;
+
+		fflush(stdout);
+		while ((res = read(pipefd[0], buf, sizeof(buf) - 1)) > 0) {
+			buf[res] = '\0';
+			if (ast_str_strlen(output) > 65536) {
+				ast_str_reset(output);
+			}
+			ast_str_append(&output, 0, "%s", buf);
+		}
+		found = strstr(ast_str_buffer(output), marker) != NULL;
+		if (!found) {
+			usleep(10000);
+		}
+	}
+
+	fflush(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+
+	ast_cli(a->fd, "Test: Message %s without log channels.\n", found ? "written" : "NOT written");
+	ast_cli(a->fd, "Test %s\n", found ? "PASS" : "FAIL");
+
+	ast_cli_command(a->fd, "logger reload");
+
+error:
+	if (saved_stdout >= 0) {
+		close(saved_stdout);
+	}
+	if (pipefd[0] >= 0) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+	}
+	ast_free(output);
+	close(fd);
+	unlink(confpath);
+
+	return CLI_SUCCESS;
+}
+
 static struct ast_cli_entry cli_logger[] = {
 	AST_CLI_DEFINE(handle_cli_dynamic_level_test, "Test the dynamic logger level implementation"),
 	AST_CLI_DEFINE(handle_cli_performance_test, "Test the logger performance"),
 	AST_CLI_DEFINE(handle_cli_queue_test, "Test the logger queue"),
+	AST_CLI_DEFINE(handle_cli_empty_test, "Test logging without log channels"),
 };
 
 static int unload_module(void)
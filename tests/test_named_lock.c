@@ -135,9 +135,41 @@ fail:
 	return res;
 }
 
+AST_TEST_DEFINE(named_lock_reuse)
+{
+	struct ast_named_lock *lock;
+	struct ast_named_lock *again;
+
+	switch(cmd) {
+	case TEST_INIT:
+		info->name = "named_lock_reuse";
+		info->category = "/main/lock/";
+		info->summary = "Named Lock reuse test";
+		info->description =
+			"Tests that a recently used named lock is kept for the next user";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	lock = ast_named_lock_get(AST_NAMED_LOCK_TYPE_MUTEX, "lock_test", "reuse");
+	ast_test_validate(test, lock != NULL);
+	ast_test_validate(test, ast_named_lock_lock(lock) == 0);
+	ast_named_lock_unlock(lock);
+	ast_named_lock_put(lock);
+
+	/* Nobody holds the lock now but it must not have been freed */
+	again = ast_named_lock_get(AST_NAMED_LOCK_TYPE_MUTEX, "lock_test", "reuse");
+	ast_test_validate(test, again != NULL);
+	ast_named_lock_put(again);
+	ast_test_validate(test, again == lock);
+
+	return AST_TEST_PASS;
+}
 
 static int unload_module(void)
 {
+	AST_TEST_UNREGISTER(named_lock_reuse);
 	AST_TEST_UNREGISTER(named_lock_test);
 	return 0;
 }
@@ -145,6 +177,7 @@ static int unload_module(void)
 static int load_module(void)
 {
 	AST_TEST_REGISTER(named_lock_test);
+	AST_TEST_REGISTER(named_lock_reuse);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
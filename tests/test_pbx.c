@@ -35,7 +35,10 @@
 
 #include "asterisk/module.h"
 #include "asterisk/pbx.h"
+#include "asterisk/devicestate.h"
+#include "asterisk/lock.h"
 #include "asterisk/test.h"
+#include "asterisk/time.h"
 
 #include <signal.h>
 
@@ -323,6 +326,357 @@ cleanup:
 	return res;
 }
 
+/*! \brief Number of DID extensions in the match cache benchmark */
+#define BENCH_DIDS 1000
+
+/*! \brief Number of DIDs receiving calls in the match cache benchmark */
+#define BENCH_HOT_DIDS 500
+
+/*! \brief Number of lookups timed with the trie matcher in the match cache benchmark */
+#define BENCH_LOOKUPS 200000
+
+static int check_match(struct ast_test *test, const char *context, const char *exten, const char *expected)
+{
+	struct pbx_find_info pfi = { { 0 }, };
+	struct ast_exten *found;
+
+	found = pbx_find_extension(NULL, NULL, &pfi, context, exten, 1, NULL, "", E_MATCH);
+	if (!found) {
+		ast_test_status_update(test, "Cannot find extension %s in context %s\n", exten, context);
+		return -1;
+	}
+	if (strcmp(ast_get_extension_name(found), expected)) {
+		ast_test_status_update(test, "Expected %s to match extension %s but got %s\n",
+			exten, expected, ast_get_extension_name(found));
+		return -1;
+	}
+	return 0;
+}
+
+AST_TEST_DEFINE(match_cache_benchmark)
+{
+	static const char registrar[] = "test_pbx_bench";
+	static const char BENCH_OUTER[] = "test_bench_outer";
+	static const char BENCH_MIDDLE[] = "test_bench_middle";
+	static const char BENCH_DIDS_CONTEXT[] = "test_bench_dids";
+	static const char *mode_names[] = { "linear", "trie", "trie+cache" };
+	/* The linear matcher is far too slow to do as many lookups */
+	static const int mode_lookups[] = { BENCH_LOOKUPS / 20, BENCH_LOOKUPS, BENCH_LOOKUPS };
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int old_patternmatchnew;
+	int old_matchcache;
+	char exten[AST_MAX_EXTENSION];
+	int mode;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "match_cache_benchmark";
+		info->category = "/main/pbx/";
+		info->summary = "Benchmark and verify the extension match cache";
+		info->description = "Builds a context that reaches a large number of DIDs through\n"
+			"a chain of includes. Every DID is looked up with the linear matcher,\n"
+			"the trie matcher and the trie matcher with the match cache and the\n"
+			"lookups per second of each are reported. The cache must return the\n"
+			"same matches and must notice extensions being added and removed.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	old_patternmatchnew = pbx_set_extenpatternmatchnew(0);
+	old_matchcache = pbx_set_extenmatchcache(0);
+
+	if (!ast_context_find_or_create(NULL, NULL, BENCH_OUTER, registrar)
+		|| !ast_context_find_or_create(NULL, NULL, BENCH_MIDDLE, registrar)
+		|| !ast_context_find_or_create(NULL, NULL, BENCH_DIDS_CONTEXT, registrar)) {
+		ast_test_status_update(test, "Failed to create contexts\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (ast_context_add_include(BENCH_OUTER, BENCH_MIDDLE, registrar)
+		|| ast_context_add_include(BENCH_MIDDLE, BENCH_DIDS_CONTEXT, registrar)) {
+		ast_test_status_update(test, "Failed to include contexts\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	/* A few internal extensions and patterns the DIDs have to get past */
+	for (i = 0; i < 100; ++i) {
+		snprintf(exten, sizeof(exten), "%d", 1000 + i);
+		if (ast_add_extension(BENCH_OUTER, 0, exten, 1, NULL, NULL, "Noop", NULL, NULL, registrar)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	/* Routing patterns that every lookup has to be tried against */
+	for (i = 0; i < 100; ++i) {
+		snprintf(exten, sizeof(exten), "_NXX%02dXXX", i);
+		if (ast_add_extension(BENCH_MIDDLE, 0, exten, 1, NULL, NULL, "Noop", NULL, NULL, registrar)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	if (ast_add_extension(BENCH_OUTER, 0, "_9NXXNXXXXXX", 1, NULL, NULL, "Noop", NULL, NULL, registrar)
+		|| ast_add_extension(BENCH_MIDDLE, 0, "_011.", 1, NULL, NULL, "Noop", NULL, NULL, registrar)
+		|| ast_add_extension(BENCH_DIDS_CONTEXT, 0, "_555XXXX", 1, NULL, NULL, "Noop", NULL, NULL, registrar)) {
+		res = AST_TEST_FAIL;
+	}
+	for (i = 0; i < BENCH_DIDS; ++i) {
+		snprintf(exten, sizeof(exten), "555%04d", i);
+		if (ast_add_extension(BENCH_DIDS_CONTEXT, 0, exten, 1, NULL, NULL, "Noop", NULL, NULL, registrar)) {
+			res = AST_TEST_FAIL;
+		}
+	}
+	if (res != AST_TEST_PASS) {
+		ast_test_status_update(test, "Failed to add extensions\n");
+		goto cleanup;
+	}
+
+	for (mode = 0; mode < ARRAY_LEN(mode_names); ++mode) {
+		struct timeval start;
+		int64_t elapsed;
+
+		pbx_set_extenpatternmatchnew(mode > 0);
+		pbx_set_extenmatchcache(mode > 1);
+
+		for (i = 0; i < BENCH_DIDS; ++i) {
+			snprintf(exten, sizeof(exten), "555%04d", i);
+			if (check_match(test, BENCH_OUTER, exten, exten)) {
+				res = AST_TEST_FAIL;
+				goto cleanup;
+			}
+		}
+
+		start = ast_tvnow();
+		for (i = 0; i < mode_lookups[mode]; ++i) {
+			snprintf(exten, sizeof(exten), "555%04d", i % BENCH_HOT_DIDS);
+			if (!ast_exists_extension(NULL, BENCH_OUTER, exten, 1, NULL)) {
+				ast_test_status_update(test, "Lookup of %s failed with the %s matcher\n",
+					exten, mode_names[mode]);
+				res = AST_TEST_FAIL;
+				goto cleanup;
+			}
+		}
+		elapsed = MAX(ast_tvdiff_us(ast_tvnow(), start), 1);
+		ast_test_status_update(test, "%s matcher: %d lookups in %" PRId64 " us, %" PRId64 " lookups/sec\n",
+			mode_names[mode], mode_lookups[mode], elapsed, (int64_t) mode_lookups[mode] * 1000000 / elapsed);
+	}
+
+	/* The cache is still enabled, make sure it follows dialplan changes. */
+	if (check_match(test, BENCH_OUTER, "5559999", "_555XXXX")) {
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (ast_add_extension(BENCH_DIDS_CONTEXT, 0, "5559999", 1, NULL, NULL, "Noop", NULL, NULL, registrar)) {
+		ast_test_status_update(test, "Failed to add extension 5559999\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (check_match(test, BENCH_OUTER, "5559999", "5559999")) {
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (ast_context_remove_extension(BENCH_DIDS_CONTEXT, "5559999", 0, registrar)) {
+		ast_test_status_update(test, "Failed to remove extension 5559999\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (check_match(test, BENCH_OUTER, "5559999", "_555XXXX")) {
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+cleanup:
+	ast_context_destroy(NULL, registrar);
+	pbx_set_extenmatchcache(old_matchcache);
+	pbx_set_extenpatternmatchnew(old_patternmatchnew);
+
+	return res;
+}
+
+/*! \brief Devices of the hint used by the hint notification test */
+#define HINT_TEST_DEVICES 30
+
+/*! \brief States the hint test provider reports, indexed by device */
+static enum ast_device_state hint_test_states[HINT_TEST_DEVICES];
+
+/*! \brief Device state notifications received by the hint test watcher */
+static struct {
+	ast_mutex_t lock;
+	ast_cond_t cond;
+	int count;
+	enum ast_extension_states state;
+} hint_test_watcher;
+
+static enum ast_device_state hint_test_provider(const char *data)
+{
+	int device = atoi(data);
+
+	return device >= 0 && device < HINT_TEST_DEVICES ? hint_test_states[device] : AST_DEVICE_INVALID;
+}
+
+static int hint_test_watcher_cb(const char *context, const char *exten, struct ast_state_cb_info *info, void *data)
+{
+	if (info->reason != AST_HINT_UPDATE_DEVICE) {
+		return 0;
+	}
+
+	ast_mutex_lock(&hint_test_watcher.lock);
+	hint_test_watcher.count++;
+	hint_test_watcher.state = info->exten_state;
+	ast_cond_signal(&hint_test_watcher.cond);
+	ast_mutex_unlock(&hint_test_watcher.lock);
+
+	return 0;
+}
+
+static void hint_test_set_state(int device, enum ast_device_state state)
+{
+	hint_test_states[device] = state;
+	ast_devstate_changed(state, AST_DEVSTATE_CACHABLE, "HintTest:%d", device);
+}
+
+/*! \brief Wait for the watcher to be told about the given state */
+static int hint_test_wait_for(enum ast_extension_states state)
+{
+	struct timeval deadline = ast_tvadd(ast_tvnow(), ast_samp2tv(5, 1));
+	struct timespec end = { .tv_sec = deadline.tv_sec, .tv_nsec = deadline.tv_usec * 1000 };
+	int res = 0;
+
+	ast_mutex_lock(&hint_test_watcher.lock);
+	while (hint_test_watcher.state != state && !res) {
+		res = ast_cond_timedwait(&hint_test_watcher.cond, &hint_test_watcher.lock, &end);
+	}
+	res = hint_test_watcher.state == state ? 0 : -1;
+	ast_mutex_unlock(&hint_test_watcher.lock);
+
+	return res;
+}
+
+AST_TEST_DEFINE(hint_notify_coalescing)
+{
+	static const char registrar[] = "test_pbx_hint";
+	static const char context[] = "test_pbx_hint";
+	struct ast_str *devices = ast_str_alloca(HINT_TEST_DEVICES * 16);
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int old_window;
+	int watcher_id = -1;
+	int count;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "hint_notify_coalescing";
+		info->category = "/main/pbx/";
+		info->summary = "Verify hint state tracking and notification coalescing";
+		info->description = "Watches a hint shared by many devices while their states change.\n"
+			"The state the watcher is told about must match a full evaluation of\n"
+			"the hint, and with a hintnotifywindow a burst of changes must result\n"
+			"in a single notification of the final state.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_mutex_init(&hint_test_watcher.lock);
+	ast_cond_init(&hint_test_watcher.cond, NULL);
+	hint_test_watcher.count = 0;
+	hint_test_watcher.state = AST_EXTENSION_NOT_INUSE;
+	old_window = pbx_set_hintnotifywindow(0);
+
+	for (i = 0; i < HINT_TEST_DEVICES; i++) {
+		hint_test_states[i] = AST_DEVICE_NOT_INUSE;
+		ast_str_append(&devices, 0, "%sHintTest:%d", i ? "&" : "", i);
+	}
+
+	if (ast_devstate_prov_add("HintTest", hint_test_provider)) {
+		ast_test_status_update(test, "Failed to add the device state provider\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (!ast_context_find_or_create(NULL, NULL, context, registrar)
+		|| ast_add_extension(context, 0, "100", PRIORITY_HINT, NULL, NULL,
+			ast_str_buffer(devices), NULL, NULL, registrar)) {
+		ast_test_status_update(test, "Failed to add the hint\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	watcher_id = ast_extension_state_add(context, "100", hint_test_watcher_cb, NULL);
+	if (watcher_id < 0) {
+		ast_test_status_update(test, "Failed to watch the hint\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	/* Changes are applied to the hint one device at a time */
+	hint_test_set_state(7, AST_DEVICE_INUSE);
+	if (hint_test_wait_for(AST_EXTENSION_INUSE)) {
+		ast_test_status_update(test, "Watcher was not told the hint is in use\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	hint_test_set_state(12, AST_DEVICE_RINGING);
+	if (hint_test_wait_for(AST_EXTENSION_INUSE | AST_EXTENSION_RINGING)) {
+		ast_test_status_update(test, "Watcher was not told the hint is in use and ringing\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	hint_test_set_state(7, AST_DEVICE_NOT_INUSE);
+	if (hint_test_wait_for(AST_EXTENSION_RINGING)) {
+		ast_test_status_update(test, "Watcher was not told the hint is ringing\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (ast_extension_state(NULL, context, "100") != AST_EXTENSION_RINGING) {
+		ast_test_status_update(test, "Full evaluation of the hint disagrees with the watcher\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	/* A burst of changes within the window results in one notification */
+	pbx_set_hintnotifywindow(500);
+	ast_mutex_lock(&hint_test_watcher.lock);
+	hint_test_watcher.count = 0;
+	ast_mutex_unlock(&hint_test_watcher.lock);
+
+	hint_test_set_state(12, AST_DEVICE_NOT_INUSE);
+	for (i = 0; i < HINT_TEST_DEVICES; i += 3) {
+		hint_test_set_state(i, AST_DEVICE_INUSE);
+	}
+	if (hint_test_wait_for(AST_EXTENSION_INUSE)) {
+		ast_test_status_update(test, "Watcher was not told the hint is in use after the burst\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	usleep(600000);
+
+	ast_mutex_lock(&hint_test_watcher.lock);
+	count = hint_test_watcher.count;
+	ast_mutex_unlock(&hint_test_watcher.lock);
+	ast_test_status_update(test, "%d device changes resulted in %d notification%s\n",
+		1 + (HINT_TEST_DEVICES + 2) / 3, count, ESS(count));
+	if (count != 1) {
+		res = AST_TEST_FAIL;
+	}
+	if (ast_extension_state(NULL, context, "100") != AST_EXTENSION_INUSE) {
+		ast_test_status_update(test, "Full evaluation of the hint disagrees with the watcher\n");
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	if (watcher_id >= 0) {
+		ast_extension_state_del(watcher_id, NULL);
+	}
+	ast_context_destroy(NULL, registrar);
+	ast_devstate_prov_del("HintTest");
+	pbx_set_hintnotifywindow(old_window);
+	ast_cond_destroy(&hint_test_watcher.cond);
+	ast_mutex_destroy(&hint_test_watcher.lock);
+
+	return res;
+}
+
 AST_TEST_DEFINE(segv)
 {
 	switch (cmd) {
@@ -388,6 +742,8 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(call_backtrace);
 	AST_TEST_UNREGISTER(call_assert);
 	AST_TEST_UNREGISTER(segv);
+	AST_TEST_UNREGISTER(match_cache_benchmark);
+	AST_TEST_UNREGISTER(hint_notify_coalescing);
 	AST_TEST_UNREGISTER(pattern_match_test);
 	return 0;
 }
@@ -395,6 +751,8 @@ static int unload_module(void)
 static int load_module(void)
 {
 	AST_TEST_REGISTER(pattern_match_test);
+	AST_TEST_REGISTER(match_cache_benchmark);
+	AST_TEST_REGISTER(hint_notify_coalescing);
 	AST_TEST_REGISTER(segv);
 	AST_TEST_REGISTER(call_assert);
 	AST_TEST_REGISTER(call_backtrace);
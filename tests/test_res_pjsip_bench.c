@@ -0,0 +1,157 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief res_pjsip benchmarks
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<depend>pjproject</depend>
+	<depend>res_pjsip</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include <pjsip.h>
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/res_pjsip.h"
+#include "asterisk/utils.h"
+
+#define CATEGORY "/bench/res/res_pjsip/"
+
+/*! \brief A typical INVITE with an SDP offer */
+static const char bench_invite[] =
+	"INVITE sip:1000@192.0.2.10:5060 SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 192.0.2.20:5060;rport;branch=z9hG4bKPj4a1c2e3f-6b7d-4e8f-9a0b-1c2d3e4f5a6b\r\n"
+	"From: \"Alice\" <sip:alice@192.0.2.20>;tag=8c5b6a4e-2d1f-4a3b-9c8d-7e6f5a4b3c2d\r\n"
+	"To: <sip:1000@192.0.2.10>\r\n"
+	"Contact: <sip:alice@192.0.2.20:5060;ob>\r\n"
+	"Call-ID: 0b1c2d3e-4f5a-6b7c-8d9e-0f1a2b3c4d5e\r\n"
+	"CSeq: 10423 INVITE\r\n"
+	"Allow: PRACK, INVITE, ACK, BYE, CANCEL, UPDATE, INFO, SUBSCRIBE, NOTIFY, REFER, MESSAGE, OPTIONS\r\n"
+	"Supported: replaces, 100rel, timer, norefersub\r\n"
+	"Session-Expires: 1800\r\n"
+	"Min-SE: 90\r\n"
+	"Max-Forwards: 70\r\n"
+	"User-Agent: Benchmark UA 1.0\r\n"
+	"Content-Type: application/sdp\r\n"
+	"Content-Length:   221\r\n"
+	"\r\n"
+	"v=0\r\n"
+	"o=- 3823456789 3823456789 IN IP4 192.0.2.20\r\n"
+	"s=-\r\n"
+	"c=IN IP4 192.0.2.20\r\n"
+	"t=0 0\r\n"
+	"m=audio 4000 RTP/AVP 0 8 101\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:101 telephone-event/8000\r\n"
+	"a=fmtp:101 0-16\r\n"
+	"a=sendrecv\r\n";
+
+struct bench_parse {
+	struct ast_test *test;
+	pj_pool_t *pool;
+	int res;
+};
+
+static int bench_parse_msg(void *data, unsigned int iterations)
+{
+	struct bench_parse *bench = data;
+	char buf[sizeof(bench_invite)];
+
+	while (iterations--) {
+		pjsip_msg *msg;
+
+		/* The parser wants a writable, terminated buffer */
+		memcpy(buf, bench_invite, sizeof(buf));
+		msg = pjsip_parse_msg(bench->pool, buf, sizeof(buf) - 1, NULL);
+		pj_pool_reset(bench->pool);
+		if (!msg) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int bench_parse_task(void *data)
+{
+	struct bench_parse *bench = data;
+
+	bench->res = ast_test_bench(bench->test, "parse INVITE", 0, bench_parse_msg, bench);
+
+	return 0;
+}
+
+AST_TEST_DEFINE(bench_parse)
+{
+	struct bench_parse bench = { .test = test, };
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "parse";
+		info->category = CATEGORY;
+		info->summary = "Benchmark SIP message parsing";
+		info->description =
+			"Times parsing an INVITE carrying an SDP offer.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	bench.pool = pjsip_endpt_create_pool(ast_sip_get_pjsip_endpoint(), "Test Bench", 4000, 4000);
+	if (!bench.pool) {
+		ast_test_status_update(test, "Failed to create pool\n");
+		return AST_TEST_FAIL;
+	}
+
+	/* The parser needs a thread known to pjlib */
+	if (ast_sip_push_task_wait_servant(NULL, bench_parse_task, &bench)) {
+		bench.res = -1;
+	}
+
+	pjsip_endpt_release_pool(ast_sip_get_pjsip_endpoint(), bench.pool);
+
+	return bench.res ? AST_TEST_FAIL : AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(bench_parse);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(bench_parse);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_DEFAULT, "res_pjsip Benchmarks",
+	.support_level = AST_MODULE_SUPPORT_CORE,
+	.load = load_module,
+	.unload = unload_module,
+	.requires = "res_pjsip",
+);
@@ -523,6 +523,147 @@ AST_TEST_DEFINE(fir_nominal)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(read_in_batches)
+{
+	RAII_VAR(struct ast_rtp_instance *, instance1, NULL, ast_rtp_instance_destroy);
+	RAII_VAR(struct ast_rtp_instance *, instance2, NULL, ast_rtp_instance_destroy);
+	RAII_VAR(struct ast_sched_context *, test_sched, NULL, ast_sched_context_destroy_wrapper);
+	struct ast_rtp_instance_stats stats = { 0, };
+	int expected = -1;
+	int count = 0;
+	int index;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "read_in_batches";
+		info->category = "/res/res_rtp/";
+		info->summary = "batched read unit test";
+		info->description =
+			"Tests that every packet waiting on the socket is read in "
+			"order, whether or not it was received as part of a batch "
+			"as configured by io_batch in rtp.conf";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	test_sched = ast_sched_context_create();
+
+	if ((test_init_rtp_instances(&instance1, &instance2, test_sched, TEST_TYPE_NONE)) < 0) {
+		ast_log(LOG_ERROR, "Failed to initialize test!\n");
+		return AST_TEST_FAIL;
+	}
+
+	/* Get through strict RTP learning first */
+	test_write_and_read_frames(instance1, instance2, 1000, 10);
+
+	test_write_frames(instance1, 1010, 10);
+	for (index = 0; index < 10 && count < 10; index++) {
+		struct ast_frame *frames = ast_rtp_instance_read(instance2, 0);
+		struct ast_frame *frame;
+
+		for (frame = frames; frame; frame = AST_LIST_NEXT(frame, frame_list)) {
+			if (frame->frametype != AST_FRAME_VOICE) {
+				continue;
+			}
+			if (expected != -1 && frame->seqno != expected) {
+				ast_test_status_update(test, "Read packet %d while expecting %d\n",
+					frame->seqno, expected);
+				ast_frfree(frames);
+				return AST_TEST_FAIL;
+			}
+			expected = (frame->seqno + 1) & 0xffff;
+			count++;
+		}
+		ast_frfree(frames);
+	}
+
+	ast_test_validate(test, count == 10, "Only read %d of 10 packets", count);
+
+	ast_test_validate(test, !ast_rtp_instance_get_stats(instance2, &stats, AST_RTP_INSTANCE_STAT_ALL));
+	ast_test_status_update(test, "%u batched reads returned %u packets\n", stats.rxbatches, stats.rxbatchcount);
+	ast_test_validate(test, stats.rxbatchcount >= stats.rxbatches);
+
+	return AST_TEST_PASS;
+}
+
+#define PORT_TEST_INSTANCES 64
+
+AST_TEST_DEFINE(port_allocation)
+{
+	RAII_VAR(struct ast_sched_context *, test_sched, NULL, ast_sched_context_destroy_wrapper);
+	struct ast_rtp_instance *instances[PORT_TEST_INSTANCES] = { NULL, };
+	int ports[PORT_TEST_INSTANCES];
+	struct ast_sockaddr addr;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int index;
+	int other;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "port_allocation";
+		info->category = "/res/res_rtp/";
+		info->summary = "RTP port allocation unit test";
+		info->description =
+			"Tests that instances allocated together are each given a "
+			"different even port, and that the ports of destroyed "
+			"instances can be allocated again";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	test_sched = ast_sched_context_create();
+	ast_sockaddr_parse(&addr, "127.0.0.1", 0);
+
+	for (index = 0; index < PORT_TEST_INSTANCES; index++) {
+		struct ast_sockaddr local;
+
+		instances[index] = ast_rtp_instance_new("asterisk", test_sched, &addr, NULL);
+		if (!instances[index]) {
+			ast_test_status_update(test, "Failed to allocate instance %d\n", index);
+			res = AST_TEST_FAIL;
+			goto cleanup;
+		}
+		ast_rtp_instance_get_local_address(instances[index], &local);
+		ports[index] = ast_sockaddr_port(&local);
+
+		if (ports[index] & 1) {
+			ast_test_status_update(test, "Instance %d was given odd port %d\n", index, ports[index]);
+			res = AST_TEST_FAIL;
+			goto cleanup;
+		}
+		for (other = 0; other < index; other++) {
+			if (ports[other] == ports[index]) {
+				ast_test_status_update(test, "Instances %d and %d were both given port %d\n",
+					other, index, ports[index]);
+				res = AST_TEST_FAIL;
+				goto cleanup;
+			}
+		}
+	}
+
+	/* Release half of them and make sure their replacements can be bound */
+	for (index = 0; index < PORT_TEST_INSTANCES; index += 2) {
+		ast_rtp_instance_destroy(instances[index]);
+		instances[index] = ast_rtp_instance_new("asterisk", test_sched, &addr, NULL);
+		if (!instances[index]) {
+			ast_test_status_update(test, "Failed to allocate a replacement for instance %d\n", index);
+			res = AST_TEST_FAIL;
+			goto cleanup;
+		}
+	}
+
+cleanup:
+	for (index = 0; index < PORT_TEST_INSTANCES; index++) {
+		if (instances[index]) {
+			ast_rtp_instance_destroy(instances[index]);
+		}
+	}
+
+	return res;
+}
+
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(nack_no_packet_loss);
@@ -532,6 +673,8 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(remb_nominal);
 	AST_TEST_UNREGISTER(sr_rr_nominal);
 	AST_TEST_UNREGISTER(fir_nominal);
+	AST_TEST_UNREGISTER(read_in_batches);
+	AST_TEST_UNREGISTER(port_allocation);
 	return 0;
 }
 
@@ -544,6 +687,8 @@ static int load_module(void)
 	AST_TEST_REGISTER(remb_nominal);
 	AST_TEST_REGISTER(sr_rr_nominal);
 	AST_TEST_REGISTER(fir_nominal);
+	AST_TEST_REGISTER(read_in_batches);
+	AST_TEST_REGISTER(port_allocation);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
@@ -0,0 +1,271 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief SRTP Unit Tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<depend>res_srtp</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/module.h"
+#include "asterisk/test.h"
+#include "asterisk/time.h"
+#include "asterisk/unaligned.h"
+#include "asterisk/rtp_engine.h"
+#include "asterisk/sdp_srtp.h"
+
+extern struct ast_srtp_res *res_srtp;
+extern struct ast_srtp_policy_res *res_srtp_policy;
+
+/*! \brief Packets protected and unprotected per suite */
+#define BENCH_PACKETS 200000
+
+/*! \brief Packets per batched call, matching the RTP I/O batch limit */
+#define BENCH_BATCH 32
+
+/*! \brief An RTP header followed by 20 ms of G.711 */
+#define BENCH_PACKET_LEN (12 + 160)
+
+/*! \brief Room for a packet plus its SRTP trailer */
+#define BENCH_SLOT_SIZE 512
+
+static const struct {
+	enum ast_srtp_suite suite;
+	const char *name;
+} bench_suites[] = {
+	{ AST_AES_CM_128_HMAC_SHA1_80, "AES_CM_128_HMAC_SHA1_80" },
+	{ AST_AES_CM_128_HMAC_SHA1_32, "AES_CM_128_HMAC_SHA1_32" },
+#ifdef HAVE_SRTP_256
+	{ AST_AES_CM_256_HMAC_SHA1_80, "AES_256_CM_HMAC_SHA1_80" },
+#endif
+#ifdef HAVE_SRTP_GCM
+	{ AST_AES_GCM_128, "AEAD_AES_128_GCM" },
+	{ AST_AES_GCM_256, "AEAD_AES_256_GCM" },
+#endif
+};
+
+/*!
+ * \internal
+ * \brief Create a session using the given suite and a fixed key
+ */
+static struct ast_srtp *bench_session(enum ast_srtp_suite suite, int inbound)
+{
+	/* Long enough for the master key and salt of every suite */
+	unsigned char key[46];
+	struct ast_srtp_policy *policy;
+	struct ast_srtp *srtp = NULL;
+	int i;
+
+	for (i = 0; i < sizeof(key); i++) {
+		key[i] = i * 7 + 1;
+	}
+
+	policy = res_srtp_policy->alloc();
+	if (!policy) {
+		return NULL;
+	}
+
+	if (!res_srtp_policy->set_master_key(policy, key, sizeof(key), NULL, 0)
+		&& !res_srtp_policy->set_suite(policy, suite)) {
+		res_srtp_policy->set_ssrc(policy, 0, inbound);
+		if (res_srtp->create(&srtp, NULL, policy)) {
+			srtp = NULL;
+		}
+	}
+	res_srtp_policy->destroy(policy);
+
+	return srtp;
+}
+
+/*!
+ * \internal
+ * \brief Write the plain RTP packet with the given sequence number
+ */
+static void bench_packet(unsigned char *buf, unsigned int seq)
+{
+	buf[0] = 0x80;
+	buf[1] = 0;
+	buf[2] = seq >> 8;
+	buf[3] = seq;
+	put_unaligned_uint32(buf + 4, htonl(seq * 160));
+	put_unaligned_uint32(buf + 8, htonl(0x12345678));
+	memset(buf + 12, seq, BENCH_PACKET_LEN - 12);
+}
+
+/*!
+ * \internal
+ * \brief Benchmark one suite, verifying every packet survives the round trip
+ */
+static int bench_suite(struct ast_test *test, enum ast_srtp_suite suite, const char *name)
+{
+	unsigned char plain[BENCH_PACKET_LEN];
+	unsigned char (*slots)[BENCH_SLOT_SIZE];
+	struct ast_srtp_packet packets[BENCH_BATCH];
+	struct ast_srtp *tx;
+	struct ast_srtp *rx;
+	struct ast_srtp *tx_single;
+	struct timeval start;
+	int64_t single_us;
+	int64_t protect_us = 0;
+	int64_t unprotect_us = 0;
+	unsigned int seq;
+	int res = -1;
+	int i;
+
+	tx = bench_session(suite, 0);
+	rx = bench_session(suite, 1);
+	tx_single = bench_session(suite, 0);
+	slots = ast_malloc(BENCH_BATCH * BENCH_SLOT_SIZE);
+	if (!tx || !rx || !tx_single || !slots) {
+		ast_test_status_update(test, "Could not create %s sessions\n", name);
+		goto cleanup;
+	}
+
+	/* One packet per call, copied into the session buffer as ast_srtp_protect() does */
+	start = ast_tvnow();
+	for (seq = 0; seq < BENCH_PACKETS; seq++) {
+		void *buf = plain;
+		int len = BENCH_PACKET_LEN;
+
+		bench_packet(plain, seq);
+		if (res_srtp->protect(tx_single, &buf, &len, 0) < 0) {
+			ast_test_status_update(test, "%s protect of packet %u failed\n", name, seq);
+			goto cleanup;
+		}
+	}
+	single_us = ast_tvdiff_us(ast_tvnow(), start);
+
+	/* Batches protected in place and unprotected by the receiving session */
+	for (seq = 0; seq < BENCH_PACKETS; seq += BENCH_BATCH) {
+		for (i = 0; i < BENCH_BATCH; i++) {
+			bench_packet(slots[i], seq + i);
+			packets[i].srtp = tx;
+			packets[i].buf = slots[i];
+			packets[i].len = BENCH_PACKET_LEN;
+			packets[i].size = BENCH_SLOT_SIZE;
+		}
+
+		start = ast_tvnow();
+		if (res_srtp->protect_batch(packets, BENCH_BATCH, 0) != BENCH_BATCH) {
+			ast_test_status_update(test, "%s batched protect at packet %u failed\n", name, seq);
+			goto cleanup;
+		}
+		protect_us += ast_tvdiff_us(ast_tvnow(), start);
+
+		for (i = 0; i < BENCH_BATCH; i++) {
+			packets[i].srtp = rx;
+		}
+
+		start = ast_tvnow();
+		if (res_srtp->unprotect_batch(packets, BENCH_BATCH, 0) != BENCH_BATCH) {
+			ast_test_status_update(test, "%s batched unprotect at packet %u failed\n", name, seq);
+			goto cleanup;
+		}
+		unprotect_us += ast_tvdiff_us(ast_tvnow(), start);
+
+		for (i = 0; i < BENCH_BATCH; i++) {
+			bench_packet(plain, seq + i);
+			if (packets[i].len != BENCH_PACKET_LEN || memcmp(slots[i], plain, BENCH_PACKET_LEN)) {
+				ast_test_status_update(test, "%s packet %u did not survive the round trip\n",
+					name, seq + i);
+				goto cleanup;
+			}
+		}
+	}
+
+	ast_test_status_update(test, "%-24s protect %8" PRId64 " pkt/s, batched protect %8" PRId64
+		" pkt/s, batched unprotect %8" PRId64 " pkt/s\n", name,
+		(int64_t) BENCH_PACKETS * 1000000 / MAX(single_us, 1),
+		(int64_t) seq * 1000000 / MAX(protect_us, 1),
+		(int64_t) seq * 1000000 / MAX(unprotect_us, 1));
+	res = 0;
+
+cleanup:
+	if (tx) {
+		res_srtp->destroy(tx);
+	}
+	if (rx) {
+		res_srtp->destroy(rx);
+	}
+	if (tx_single) {
+		res_srtp->destroy(tx_single);
+	}
+	ast_free(slots);
+
+	return res;
+}
+
+AST_TEST_DEFINE(srtp_batch_benchmark)
+{
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "srtp_batch_benchmark";
+		info->category = "/res/res_srtp/";
+		info->summary = "Benchmark SRTP protect and unprotect per crypto suite";
+		info->description =
+			"Protects and unprotects G.711 sized packets on a single thread\n"
+			"with every crypto suite supported by libsrtp, one packet per\n"
+			"call and in batches, reporting packets per second per core.\n"
+			"Fails if a packet does not survive the round trip unchanged.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!ast_rtp_engine_srtp_is_registered()) {
+		ast_test_status_update(test, "SRTP is not available\n");
+		return AST_TEST_FAIL;
+	}
+
+	ast_test_status_update(test, "AEAD suites are %spreferred on this system\n",
+		ast_sdp_crypto_prefer_aead() ? "" : "not ");
+
+	for (i = 0; i < ARRAY_LEN(bench_suites); i++) {
+		if (bench_suite(test, bench_suites[i].suite, bench_suites[i].name)) {
+			return AST_TEST_FAIL;
+		}
+	}
+
+	return AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(srtp_batch_benchmark);
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(srtp_batch_benchmark);
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO(ASTERISK_GPL_KEY, AST_MODFLAG_DEFAULT, "SRTP test module",
+	.support_level = AST_MODULE_SUPPORT_CORE,
+	.load = load_module,
+	.unload = unload_module,
+	.requires = "res_srtp",
+);
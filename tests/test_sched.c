@@ -104,26 +104,12 @@ static int sched_order_8_cb(const void *data)
 	return 0;
 }
 
-AST_TEST_DEFINE(sched_test_order)
+static enum ast_test_result_state sched_order_test(struct ast_test *test, struct ast_sched_context *con)
 {
-	struct ast_sched_context *con;
 	enum ast_test_result_state res = AST_TEST_FAIL;
 	int id1, id2, id3, wait;
 
-	switch (cmd) {
-	case TEST_INIT:
-		info->name = "sched_test_order";
-		info->category = "/main/sched/";
-		info->summary = "Test ordering of events in the scheduler API";
-		info->description =
-			"This test ensures that events are properly ordered by the "
-			"time they are scheduled to execute in the scheduler API.";
-		return AST_TEST_NOT_RUN;
-	case TEST_EXECUTE:
-		break;
-	}
-
-	if (!(con = ast_sched_context_create())) {
+	if (!con) {
 		ast_test_status_update(test,
 				"Test failed - could not create scheduler context\n");
 		return AST_TEST_FAIL;
@@ -262,6 +248,160 @@ return_cleanup:
 	return res;
 }
 
+AST_TEST_DEFINE(sched_test_order)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "sched_test_order";
+		info->category = "/main/sched/";
+		info->summary = "Test ordering of events in the scheduler API";
+		info->description =
+			"This test ensures that events are properly ordered by the "
+			"time they are scheduled to execute in the scheduler API.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	return sched_order_test(test, ast_sched_context_create());
+}
+
+AST_TEST_DEFINE(sched_test_wheel_order)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "sched_test_wheel_order";
+		info->category = "/main/sched/";
+		info->summary = "Test ordering of events in a timer wheel scheduler";
+		info->description =
+			"This test ensures that events are properly ordered by the "
+			"time they are scheduled to execute in a scheduler context "
+			"using a timer wheel.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	return sched_order_test(test, ast_sched_context_create_wheel());
+}
+
+#define WHEEL_TASKS 1000
+#define WHEEL_SPAN 300 /* ms */
+
+struct wheel_task {
+	struct timeval due;
+	int id;
+	int runs;
+	int early;
+};
+
+static int sched_wheel_cb(const void *data)
+{
+	struct wheel_task *task = (struct wheel_task *) data;
+
+	++task->runs;
+	/* A timer wheel never runs an event before it is due */
+	if (ast_tvcmp(ast_tvnow(), task->due) < 0) {
+		task->early = 1;
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(sched_test_wheel_expire)
+{
+	struct ast_sched_context *con;
+	enum ast_test_result_state res = AST_TEST_FAIL;
+	struct wheel_task *tasks;
+	struct timeval start;
+	int far_id;
+	int wait;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "sched_test_wheel_expire";
+		info->category = "/main/sched/";
+		info->summary = "Test events expiring in a timer wheel scheduler";
+		info->description =
+			"This test adds events at random times to a scheduler context "
+			"using a timer wheel, deletes half of them, and ensures that "
+			"the rest run exactly once and not before they are due.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!(tasks = ast_calloc(WHEEL_TASKS, sizeof(*tasks)))) {
+		return AST_TEST_FAIL;
+	}
+
+	if (!(con = ast_sched_context_create_wheel())) {
+		ast_test_status_update(test,
+				"Test failed - could not create scheduler context\n");
+		ast_free(tasks);
+		return AST_TEST_FAIL;
+	}
+
+	/* An event past the lowest levels of the wheel must not be waited on for too long */
+	far_id = ast_sched_add(con, 100000, sched_cb, NULL);
+	ast_test_validate_cleanup(test, -1 < far_id, res, return_cleanup);
+	wait = ast_sched_wait(con);
+	if (wait < 0 || wait > 100000) {
+		ast_test_status_update(test,
+				"ast_sched_wait() should have returned <= 100000, returned '%d'\n",
+				wait);
+		goto return_cleanup;
+	}
+
+	for (i = 0; i < WHEEL_TASKS; ++i) {
+		int when = ast_random() % WHEEL_SPAN;
+
+		tasks[i].due = ast_tvadd(ast_tvnow(), ast_samp2tv(when, 1000));
+		tasks[i].id = ast_sched_add(con, when, sched_wheel_cb, &tasks[i]);
+		ast_test_validate_cleanup(test, -1 < tasks[i].id, res, return_cleanup);
+	}
+
+	for (i = 0; i < WHEEL_TASKS; i += 2) {
+		ast_test_validate_cleanup(test, !ast_sched_del(con, tasks[i].id), res, return_cleanup);
+	}
+
+	start = ast_tvnow();
+	while (ast_tvdiff_ms(ast_tvnow(), start) < WHEEL_SPAN + 100) {
+		wait = ast_sched_wait(con);
+		if (wait > 10) {
+			wait = 10;
+		}
+		usleep(wait * 1000);
+		ast_sched_runq(con);
+	}
+
+	for (i = 0; i < WHEEL_TASKS; ++i) {
+		int expected = i % 2;
+
+		if (tasks[i].runs != expected) {
+			ast_test_status_update(test, "Event %d ran %d times, expected %d\n",
+				i, tasks[i].runs, expected);
+			goto return_cleanup;
+		}
+		if (tasks[i].early) {
+			ast_test_status_update(test, "Event %d ran before it was due\n", i);
+			goto return_cleanup;
+		}
+	}
+
+	ast_test_validate_cleanup(test, !ast_sched_del(con, far_id), res, return_cleanup);
+	ast_test_validate_cleanup(test, -1 == ast_sched_wait(con), res, return_cleanup);
+
+	res = AST_TEST_PASS;
+
+return_cleanup:
+	ast_sched_context_destroy(con);
+	ast_free(tasks);
+
+	return res;
+}
+
 static char *handle_cli_sched_bench(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
 	struct ast_sched_context *con;
@@ -273,14 +413,17 @@ static char *handle_cli_sched_bench(struct ast_cli_entry *e, int cmd, struct ast
 	case CLI_INIT:
 		e->command = "sched benchmark";
 		e->usage = ""
-			"Usage: sched benchmark <num>\n"
+			"Usage: sched benchmark <num> [heap|wheel]\n"
+			"       Time adding, deleting and running <num> entries using a\n"
+			"       scheduler context kept in a heap (the default) or a\n"
+			"       timer wheel.\n"
 			"";
 		return NULL;
 	case CLI_GENERATE:
 		return NULL;
 	}
 
-	if (a->argc != e->args + 1) {
+	if (a->argc != e->args + 1 && a->argc != e->args + 2) {
 		return CLI_SHOWUSAGE;
 	}
 
@@ -288,7 +431,15 @@ static char *handle_cli_sched_bench(struct ast_cli_entry *e, int cmd, struct ast
 		return CLI_SHOWUSAGE;
 	}
 
-	if (!(con = ast_sched_context_create())) {
+	if (a->argc == e->args + 2 && !strcasecmp(a->argv[e->args + 1], "wheel")) {
+		con = ast_sched_context_create_wheel();
+	} else if (a->argc == e->args + 2 && strcasecmp(a->argv[e->args + 1], "heap")) {
+		return CLI_SHOWUSAGE;
+	} else {
+		con = ast_sched_context_create();
+	}
+
+	if (!con) {
 		ast_cli(a->fd, "Test failed - could not create scheduler context\n");
 		return CLI_FAILURE;
 	}
@@ -327,6 +478,52 @@ static char *handle_cli_sched_bench(struct ast_cli_entry *e, int cmd, struct ast
 
 	ast_cli(a->fd, "Test complete - %" PRIi64 " us\n", ast_tvdiff_us(ast_tvnow(), start));
 
+	for (i = 0; i < num; i++) {
+		long when = labs(ast_random()) % 60000;
+		if ((sched_ids[i] = ast_sched_add(con, when, sched_cb, NULL)) == -1) {
+			ast_cli(a->fd, "Test failed - sched_add returned -1\n");
+			goto return_cleanup;
+		}
+	}
+
+	ast_cli(a->fd, "Testing ast_sched_replace() performance - timing how long it takes "
+			"to reschedule %u entries, like retransmission timers do\n", num);
+
+	start = ast_tvnow();
+
+	for (i = 0; i < num; i++) {
+		long when = 500 + labs(ast_random()) % 4000;
+		if ((sched_ids[i] = ast_sched_replace(sched_ids[i], con, when, sched_cb, NULL)) == -1) {
+			ast_cli(a->fd, "Test failed - sched_replace returned -1\n");
+			goto return_cleanup;
+		}
+	}
+
+	ast_cli(a->fd, "Test complete - %" PRIi64 " us\n", ast_tvdiff_us(ast_tvnow(), start));
+
+	for (i = 0; i < num; i++) {
+		AST_SCHED_DEL(con, sched_ids[i]);
+	}
+
+	ast_cli(a->fd, "Testing ast_sched_runq() performance - timing how long it takes "
+			"to run %u entries expiring within 100 milliseconds\n", num);
+
+	for (i = 0; i < num; i++) {
+		long when = labs(ast_random()) % 100;
+		if ((sched_ids[i] = ast_sched_add(con, when, sched_cb, NULL)) == -1) {
+			ast_cli(a->fd, "Test failed - sched_add returned -1\n");
+			goto return_cleanup;
+		}
+	}
+
+	usleep(110 * 1000);
+	start = ast_tvnow();
+
+	i = ast_sched_runq(con);
+
+	ast_cli(a->fd, "Test complete - %" PRIi64 " us, %u entries run\n",
+		ast_tvdiff_us(ast_tvnow(), start), i);
+
 return_cleanup:
 	ast_sched_context_destroy(con);
 	if (sched_ids) {
@@ -343,6 +540,8 @@ static struct ast_cli_entry cli_sched[] = {
 static int unload_module(void)
 {
 	AST_TEST_UNREGISTER(sched_test_order);
+	AST_TEST_UNREGISTER(sched_test_wheel_order);
+	AST_TEST_UNREGISTER(sched_test_wheel_expire);
 	ast_cli_unregister_multiple(cli_sched, ARRAY_LEN(cli_sched));
 	return 0;
 }
@@ -350,6 +549,8 @@ static int unload_module(void)
 static int load_module(void)
 {
 	AST_TEST_REGISTER(sched_test_order);
+	AST_TEST_REGISTER(sched_test_wheel_order);
+	AST_TEST_REGISTER(sched_test_wheel_expire);
 	ast_cli_register_multiple(cli_sched, ARRAY_LEN(cli_sched));
 	return AST_MODULE_LOAD_SUCCESS;
 }
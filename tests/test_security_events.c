@@ -51,6 +51,7 @@ static void evt_gen_chal_resp_failed(void);
 static void evt_gen_inval_password(void);
 static void evt_gen_chal_sent(void);
 static void evt_gen_inval_transport(void);
+static void evt_gen_suppressed(void);
 
 typedef void (*evt_generator)(void);
 static const evt_generator evt_generators[AST_SECURITY_EVENT_NUM_TYPES] = {
@@ -69,6 +70,7 @@ static const evt_generator evt_generators[AST_SECURITY_EVENT_NUM_TYPES] = {
 	[AST_SECURITY_EVENT_INVAL_PASSWORD]          = evt_gen_inval_password,
 	[AST_SECURITY_EVENT_CHAL_SENT]               = evt_gen_chal_sent,
 	[AST_SECURITY_EVENT_INVAL_TRANSPORT]         = evt_gen_inval_transport,
+	[AST_SECURITY_EVENT_SUPPRESSED]              = evt_gen_suppressed,
 };
 
 static void evt_gen_failed_acl(void)
@@ -641,6 +643,32 @@ static void evt_gen_inval_transport(void)
 	ast_security_event_report(AST_SEC_EVT(&inval_transport));
 }
 
+static void evt_gen_suppressed(void)
+{
+	struct ast_sockaddr addr_remote = { {0,} };
+
+	struct ast_security_event_suppressed suppressed = {
+		.common.event_type = AST_SECURITY_EVENT_SUPPRESSED,
+		.common.version    = AST_SECURITY_EVENT_SUPPRESSED_VERSION,
+		.common.service    = "TEST",
+		.common.module     = AST_MODULE,
+		.common.remote_addr = {
+			.addr = &addr_remote,
+			.transport  = AST_TRANSPORT_UDP,
+		},
+		.suppressed_event  = "InvalidPassword",
+		.count             = 42,
+	};
+
+	char remoteaddr[53];
+
+	ast_copy_string(remoteaddr, "10.200.103.44:1039", sizeof(remoteaddr));
+
+	ast_sockaddr_parse(&addr_remote, remoteaddr, 0);
+
+	ast_security_event_report(AST_SEC_EVT(&suppressed));
+}
+
 static void gen_events(struct ast_cli_args *a)
 {
 	unsigned int i;
@@ -0,0 +1,242 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Signed linear mixing kernel tests
+ *
+ * Every kernel implementation supported by the running CPU is checked
+ * bit-for-bit against the scalar ast_slinear_saturated_* helpers.
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/utils.h"
+#include "asterisk/slinear_mix.h"
+
+/*! Large enough for a 20ms 48kHz frame plus an odd tail */
+#define TEST_SAMPLES 967
+
+/*! Sample values that exercise saturation in every direction */
+static const short edge_values[] = {
+	0, 1, -1, 2, -2, 255, -256, 16383, -16384, 16384, -16385, 32766, -32767, 32767, -32768,
+};
+
+static void fill_buffer(short *buf, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		if (i % 3 == 0) {
+			buf[i] = edge_values[ast_random() % ARRAY_LEN(edge_values)];
+		} else {
+			buf[i] = (short) (ast_random() & 0xffff);
+		}
+	}
+}
+
+static int compare_buffers(struct ast_test *test, const char *name, const char *op,
+	unsigned int samples, const short *expected, const short *actual)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		if (expected[i] != actual[i]) {
+			ast_test_status_update(test, "%s %s: sample %u of %u is %d, expected %d\n",
+				name, op, i, samples, actual[i], expected[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+AST_TEST_DEFINE(kernels_match_scalar)
+{
+	const struct ast_slinear_mix_ops *scalar;
+	short dst[TEST_SAMPLES];
+	short src[TEST_SAMPLES];
+	short expected[TEST_SAMPLES];
+	short actual[TEST_SAMPLES];
+	int impl;
+	int tested = 0;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "kernels_match_scalar";
+		info->category = "/main/slinear_mix/";
+		info->summary = "Compare vector mixing kernels against the scalar path";
+		info->description =
+			"Runs the add, subtract, multiply and divide kernels of every\n"
+			"implementation supported by this CPU over random and saturating\n"
+			"input of varying lengths and checks the output is identical to the\n"
+			"scalar helpers.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	scalar = ast_slinear_mix_get_ops(AST_SLINEAR_MIX_SCALAR);
+	ast_test_validate(test, scalar != NULL);
+	ast_test_status_update(test, "Active implementation is '%s'\n",
+		ast_slinear_mix_active_ops()->name);
+
+	for (impl = AST_SLINEAR_MIX_SCALAR + 1; impl < AST_SLINEAR_MIX_IMPL_MAX; impl++) {
+		const struct ast_slinear_mix_ops *ops = ast_slinear_mix_get_ops(impl);
+		unsigned int samples;
+
+		if (!ops) {
+			continue;
+		}
+		ast_test_status_update(test, "Testing '%s'\n", ops->name);
+		tested++;
+
+		/* Cover every possible tail length along with full frames */
+		for (samples = 0; samples <= TEST_SAMPLES; samples += (samples < 40 ? 1 : 37)) {
+			short factor;
+
+			fill_buffer(dst, samples);
+			fill_buffer(src, samples);
+
+			memcpy(expected, dst, sizeof(dst));
+			memcpy(actual, dst, sizeof(dst));
+			scalar->add(expected, src, samples);
+			ops->add(actual, src, samples);
+			if (compare_buffers(test, ops->name, "add", samples, expected, actual)) {
+				return AST_TEST_FAIL;
+			}
+
+			memcpy(expected, dst, sizeof(dst));
+			memcpy(actual, dst, sizeof(dst));
+			scalar->subtract(expected, src, samples);
+			ops->subtract(actual, src, samples);
+			if (compare_buffers(test, ops->name, "subtract", samples, expected, actual)) {
+				return AST_TEST_FAIL;
+			}
+
+			for (factor = 1; factor <= 16; factor++) {
+				memcpy(expected, dst, sizeof(dst));
+				memcpy(actual, dst, sizeof(dst));
+				scalar->multiply(expected, samples, factor);
+				ops->multiply(actual, samples, factor);
+				if (compare_buffers(test, ops->name, "multiply", samples, expected, actual)) {
+					return AST_TEST_FAIL;
+				}
+
+				memcpy(expected, dst, sizeof(dst));
+				memcpy(actual, dst, sizeof(dst));
+				scalar->divide(expected, samples, factor);
+				ops->divide(actual, samples, factor);
+				if (compare_buffers(test, ops->name, "divide", samples, expected, actual)) {
+					return AST_TEST_FAIL;
+				}
+			}
+
+			/* Extreme factors */
+			memcpy(expected, dst, sizeof(dst));
+			memcpy(actual, dst, sizeof(dst));
+			scalar->multiply(expected, samples, 32767);
+			ops->multiply(actual, samples, 32767);
+			if (compare_buffers(test, ops->name, "multiply", samples, expected, actual)) {
+				return AST_TEST_FAIL;
+			}
+
+			memcpy(expected, dst, sizeof(dst));
+			memcpy(actual, dst, sizeof(dst));
+			scalar->divide(expected, samples, 32767);
+			ops->divide(actual, samples, 32767);
+			if (compare_buffers(test, ops->name, "divide", samples, expected, actual)) {
+				return AST_TEST_FAIL;
+			}
+		}
+	}
+
+	if (!tested) {
+		ast_test_status_update(test, "No vector implementations available, nothing to compare\n");
+	}
+
+	return AST_TEST_PASS;
+}
+
+AST_TEST_DEFINE(adjust_volume)
+{
+	short expected[TEST_SAMPLES];
+	short actual[TEST_SAMPLES];
+	int adjustment;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "adjust_volume";
+		info->category = "/main/slinear_mix/";
+		info->summary = "Volume adjustment matches ast_frame_adjust_volume semantics";
+		info->description =
+			"Adjusts the volume of a buffer by a range of positive and negative\n"
+			"amounts and compares against the scalar multiply and divide helpers.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (adjustment = -10; adjustment <= 10; adjustment++) {
+		short value = abs(adjustment);
+		unsigned int i;
+
+		fill_buffer(expected, TEST_SAMPLES);
+		memcpy(actual, expected, sizeof(actual));
+
+		for (i = 0; i < TEST_SAMPLES; i++) {
+			if (adjustment > 0) {
+				ast_slinear_saturated_multiply(&expected[i], &value);
+			} else if (adjustment < 0) {
+				ast_slinear_saturated_divide(&expected[i], &value);
+			}
+		}
+		ast_slinear_mix_adjust_volume(actual, TEST_SAMPLES, adjustment);
+
+		if (compare_buffers(test, "active", "adjust_volume", TEST_SAMPLES, expected, actual)) {
+			return AST_TEST_FAIL;
+		}
+	}
+
+	return AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(kernels_match_scalar);
+	AST_TEST_UNREGISTER(adjust_volume);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(kernels_match_scalar);
+	AST_TEST_REGISTER(adjust_volume);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Signed linear mixing kernel tests");
@@ -1805,6 +1805,80 @@ AST_TEST_DEFINE(object_retrieve_id)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(object_retrieve_ids)
+{
+	RAII_VAR(struct ast_sorcery *, sorcery, NULL, ast_sorcery_unref);
+	RAII_VAR(struct ao2_container *, ids, NULL, ao2_cleanup);
+	RAII_VAR(struct ao2_container *, objects, NULL, ao2_cleanup);
+	RAII_VAR(struct test_sorcery_object *, obj, NULL, ao2_cleanup);
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "object_retrieve_ids";
+		info->category = "/main/sorcery/";
+		info->summary = "sorcery multiple object retrieval using ids unit test";
+		info->description =
+			"Test multiple object retrieval using a set of ids in sorcery";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!(sorcery = alloc_and_initialize_sorcery())) {
+		ast_test_status_update(test, "Failed to open sorcery structure\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (!(obj = ast_sorcery_alloc(sorcery, "test", "blah"))) {
+		ast_test_status_update(test, "Failed to allocate a known object type\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_sorcery_create(sorcery, obj)) {
+		ast_test_status_update(test, "Failed to create object using in-memory wizard\n");
+		return AST_TEST_FAIL;
+	}
+
+	ao2_cleanup(obj);
+
+	if (!(obj = ast_sorcery_alloc(sorcery, "test", "blah2"))) {
+		ast_test_status_update(test, "Failed to allocate second instance of a known object type\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (ast_sorcery_create(sorcery, obj)) {
+		ast_test_status_update(test, "Failed to create second object using in-memory wizard\n");
+		return AST_TEST_FAIL;
+	}
+
+	ao2_cleanup(obj);
+	obj = NULL;
+
+	if (!(ids = ast_str_container_alloc(7))
+		|| ast_str_container_add(ids, "blah")
+		|| ast_str_container_add(ids, "blah2")
+		|| ast_str_container_add(ids, "blah3")) {
+		ast_test_status_update(test, "Failed to create container of ids\n");
+		return AST_TEST_FAIL;
+	}
+
+	if (!(objects = ast_sorcery_retrieve_by_ids(sorcery, "test", ids))) {
+		ast_test_status_update(test, "Failed to retrieve a container of objects\n");
+		return AST_TEST_FAIL;
+	} else if (ao2_container_count(objects) != 2) {
+		ast_test_status_update(test, "Received a container with %d objects in it instead of 2\n",
+			ao2_container_count(objects));
+		return AST_TEST_FAIL;
+	}
+
+	if (!(obj = ao2_find(objects, "blah2", OBJ_SEARCH_KEY))) {
+		ast_test_status_update(test, "Retrieved objects do not include 'blah2'\n");
+		return AST_TEST_FAIL;
+	}
+
+	return AST_TEST_PASS;
+}
+
 AST_TEST_DEFINE(object_retrieve_field)
 {
 	RAII_VAR(struct ast_sorcery *, sorcery, NULL, ast_sorcery_unref);
@@ -3657,6 +3731,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(changeset_create_unchanged);
 	AST_TEST_UNREGISTER(object_create);
 	AST_TEST_UNREGISTER(object_retrieve_id);
+	AST_TEST_UNREGISTER(object_retrieve_ids);
 	AST_TEST_UNREGISTER(object_retrieve_field);
 	AST_TEST_UNREGISTER(object_retrieve_multiple_all);
 	AST_TEST_UNREGISTER(object_retrieve_multiple_field);
@@ -3715,6 +3790,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(changeset_create_unchanged);
 	AST_TEST_REGISTER(object_create);
 	AST_TEST_REGISTER(object_retrieve_id);
+	AST_TEST_REGISTER(object_retrieve_ids);
 	AST_TEST_REGISTER(object_retrieve_field);
 	AST_TEST_REGISTER(object_retrieve_multiple_all);
 	AST_TEST_REGISTER(object_retrieve_multiple_field);
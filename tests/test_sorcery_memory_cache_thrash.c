@@ -59,6 +59,10 @@ struct sorcery_memory_cache_thrash_thread {
 	unsigned int stop;
 	/*! \brief Average time spent executing sorcery operation in this thread */
 	unsigned int average_execution_time;
+	/*! \brief Number of sorcery operations executed by this thread */
+	unsigned int operations;
+	/*! \brief If non-zero nine out of ten retrievals are for one of this many objects */
+	unsigned int hot_objects;
 };
 
 /*! \brief Structure for memory cache thrasing */
@@ -73,6 +77,10 @@ struct sorcery_memory_cache_thrash {
 	unsigned int retrieve_threads;
 	/*! \brief The average execution time of sorcery retrieve operations */
 	unsigned int average_retrieve_execution_time;
+	/*! \brief The total number of sorcery update operations */
+	unsigned int update_operations;
+	/*! \brief The total number of sorcery retrieve operations */
+	unsigned int retrieve_operations;
 	/*! \brief Threads which are updating or reading from the cache */
 	AST_VECTOR(, struct sorcery_memory_cache_thrash_thread *) threads;
 };
@@ -166,12 +174,14 @@ static void sorcery_memory_cache_thrash_destroy(void *obj)
  * \param update_threads The number of threads which should be constantly updating sorcery
  * \param retrieve_threads The number of threads which should be constantly retrieving from sorcery
  * \param unique_objects The number of unique objects that can exist
+ * \param hot_objects If non-zero nine out of ten retrievals are for one of this many objects
  *
  * \retval non-NULL success
  * \retval NULL failure
  */
 static struct sorcery_memory_cache_thrash *sorcery_memory_cache_thrash_create(const char *cache_configuration,
-	unsigned int update_threads, unsigned int retrieve_threads, unsigned int unique_objects)
+	unsigned int update_threads, unsigned int retrieve_threads, unsigned int unique_objects,
+	unsigned int hot_objects)
 {
 	struct sorcery_memory_cache_thrash *thrash;
 	struct sorcery_memory_cache_thrash_thread *thread;
@@ -214,6 +224,7 @@ static struct sorcery_memory_cache_thrash *sorcery_memory_cache_thrash_create(co
 
 		thread->thread = AST_PTHREADT_NULL;
 		thread->unique_objects = unique_objects;
+		thread->hot_objects = MIN(hot_objects, unique_objects);
 
 		/* This purposely holds no ref as the main thrash structure does */
 		thread->sorcery = thrash->sorcery;
@@ -252,6 +263,7 @@ static void *sorcery_memory_cache_thrash_update(void *data)
 		start = ast_tvnow();
 		ast_sorcery_update(thread->sorcery, object);
 		thread->average_execution_time = (thread->average_execution_time + ast_tvdiff_ms(ast_tvnow(), start)) / 2;
+		++thread->operations;
 		ao2_ref(object, -1);
 	}
 
@@ -273,12 +285,17 @@ static void *sorcery_memory_cache_thrash_retrieve(void *data)
 	void *object;
 
 	while (!thread->stop) {
-		object_id = ast_random() % thread->unique_objects;
+		if (thread->hot_objects && (ast_random() % 10)) {
+			object_id = ast_random() % thread->hot_objects;
+		} else {
+			object_id = ast_random() % thread->unique_objects;
+		}
 		snprintf(object_id_str, sizeof(object_id_str), "%u", object_id);
 
 		start = ast_tvnow();
 		object = ast_sorcery_retrieve_by_id(thread->sorcery, "test", object_id_str);
 		thread->average_execution_time = (thread->average_execution_time + ast_tvdiff_ms(ast_tvnow(), start)) / 2;
+		++thread->operations;
 		ast_assert(object != NULL);
 
 		ao2_ref(object, -1);
@@ -320,8 +337,10 @@ static void sorcery_memory_cache_thrash_stop(struct sorcery_memory_cache_thrash
 
 		if (idx < thrash->update_threads) {
 			thrash->average_update_execution_time += thread->average_execution_time;
+			thrash->update_operations += thread->operations;
 		} else {
 			thrash->average_retrieve_execution_time += thread->average_execution_time;
+			thrash->retrieve_operations += thread->operations;
 		}
 	}
 
@@ -368,7 +387,7 @@ static int sorcery_memory_cache_thrash_start(struct sorcery_memory_cache_thrash
 static char *sorcery_memory_cache_cli_thrash(struct ast_cli_entry *e, int cmd, struct ast_cli_args *a)
 {
 	struct sorcery_memory_cache_thrash *thrash;
-	unsigned int thrash_time, unique_objects, retrieve_threads, update_threads;
+	unsigned int thrash_time, thrash_duration, unique_objects, retrieve_threads, update_threads;
 
 	switch (cmd) {
 	case CLI_INIT:
@@ -399,7 +418,7 @@ static char *sorcery_memory_cache_cli_thrash(struct ast_cli_entry *e, int cmd, s
 		return CLI_FAILURE;
 	}
 
-	thrash = sorcery_memory_cache_thrash_create(a->argv[4], update_threads, retrieve_threads, unique_objects);
+	thrash = sorcery_memory_cache_thrash_create(a->argv[4], update_threads, retrieve_threads, unique_objects, 0);
 	if (!thrash) {
 		ast_cli(a->fd, "Could not create a sorcery memory cache thrash test using the provided arguments\n");
 		return CLI_FAILURE;
@@ -412,6 +431,7 @@ static char *sorcery_memory_cache_cli_thrash(struct ast_cli_entry *e, int cmd, s
 	ast_cli(a->fd, "Number of retrieve threads: %u\n", retrieve_threads);
 	ast_cli(a->fd, "Number of update threads: %u\n", update_threads);
 
+	thrash_duration = thrash_time;
 	sorcery_memory_cache_thrash_start(thrash);
 	while ((thrash_time = sleep(thrash_time)));
 	sorcery_memory_cache_thrash_stop(thrash);
@@ -420,6 +440,8 @@ static char *sorcery_memory_cache_cli_thrash(struct ast_cli_entry *e, int cmd, s
 
 	ast_cli(a->fd, "Average retrieve execution time (in milliseconds): %u\n", thrash->average_retrieve_execution_time);
 	ast_cli(a->fd, "Average update execution time (in milliseconds): %u\n", thrash->average_update_execution_time);
+	ast_cli(a->fd, "Retrieve operations per second: %u\n", thrash->retrieve_operations / MAX(thrash_duration, 1));
+	ast_cli(a->fd, "Update operations per second: %u\n", thrash->update_operations / MAX(thrash_duration, 1));
 
 	ao2_ref(thrash, -1);
 
@@ -440,17 +462,20 @@ static struct ast_cli_entry cli_memory_cache_thrash[] = {
  * \param unique_objects The number of unique objects
  * \param retrieve_threads The number of threads constantly doing a retrieve
  * \param update_threads The number of threads constantly doing an update
+ * \param hot_objects If non-zero nine out of ten retrievals are for one of this many objects
  *
  * \retval AST_TEST_PASS success
  * \retval AST_TEST_FAIL failure
  */
-static enum ast_test_result_state nominal_thrash(struct ast_test *test, const char *cache_configuration,
+static enum ast_test_result_state thrash_and_report(struct ast_test *test, const char *cache_configuration,
 	unsigned int thrash_time, unsigned int unique_objects, unsigned int retrieve_threads,
-	unsigned int update_threads)
+	unsigned int update_threads, unsigned int hot_objects)
 {
 	struct sorcery_memory_cache_thrash *thrash;
+	unsigned int thrash_duration = thrash_time;
 
-	thrash = sorcery_memory_cache_thrash_create(cache_configuration, update_threads, retrieve_threads, unique_objects);
+	thrash = sorcery_memory_cache_thrash_create(cache_configuration, update_threads, retrieve_threads,
+		unique_objects, hot_objects);
 	if (!thrash) {
 		return AST_TEST_FAIL;
 	}
@@ -459,11 +484,23 @@ static enum ast_test_result_state nominal_thrash(struct ast_test *test, const ch
 	while ((thrash_time = sleep(thrash_time)));
 	sorcery_memory_cache_thrash_stop(thrash);
 
+	ast_test_status_update(test, "Cache '%s': %u retrieve ops/sec, %u update ops/sec\n",
+		cache_configuration, thrash->retrieve_operations / MAX(thrash_duration, 1),
+		thrash->update_operations / MAX(thrash_duration, 1));
+
 	ao2_ref(thrash, -1);
 
 	return AST_TEST_PASS;
 }
 
+static enum ast_test_result_state nominal_thrash(struct ast_test *test, const char *cache_configuration,
+	unsigned int thrash_time, unsigned int unique_objects, unsigned int retrieve_threads,
+	unsigned int update_threads)
+{
+	return thrash_and_report(test, cache_configuration, thrash_time, unique_objects, retrieve_threads,
+		update_threads, 0);
+}
+
 AST_TEST_DEFINE(low_unique_object_count_immediately_stale)
 {
 	switch (cmd) {
@@ -600,6 +637,32 @@ AST_TEST_DEFINE(high_object_count_without_expiration)
 	return nominal_thrash(test, "default", TEST_THRASH_TIME, 5000, TEST_THRASH_RETRIEVERS, 0);
 }
 
+AST_TEST_DEFINE(reader_heavy_eviction)
+{
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "reader_heavy_eviction";
+		info->category = "/res/res_sorcery_memory_cache/thrash/";
+		info->summary = "Thrash caches using each eviction mode with mostly retrievals";
+		info->description = "This test creates a cache with a maximum number of objects for\n"
+			"each eviction mode. Retrieve threads mostly ask for a small set of hot objects\n"
+			"while a single update thread churns the cache. The number of operations per\n"
+			"second is reported for each mode. This test confirms that eviction does not\n"
+			"cause a problem under reader heavy load.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (thrash_and_report(test, "maximum_objects=100,eviction=oldest", TEST_THRASH_TIME, 1000,
+		TEST_THRASH_RETRIEVERS, 1, 50) != AST_TEST_PASS) {
+		return AST_TEST_FAIL;
+	}
+
+	return thrash_and_report(test, "maximum_objects=100,eviction=clock", TEST_THRASH_TIME, 1000,
+		TEST_THRASH_RETRIEVERS, 1, 50);
+}
+
 static int unload_module(void)
 {
 	ast_cli_unregister_multiple(cli_memory_cache_thrash, ARRAY_LEN(cli_memory_cache_thrash));
@@ -610,6 +673,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(unique_objects_exceeding_maximum_with_expire_and_stale);
 	AST_TEST_UNREGISTER(conflicting_expire_and_stale);
 	AST_TEST_UNREGISTER(high_object_count_without_expiration);
+	AST_TEST_UNREGISTER(reader_heavy_eviction);
 
 	return 0;
 }
@@ -624,6 +688,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(unique_objects_exceeding_maximum_with_expire_and_stale);
 	AST_TEST_REGISTER(conflicting_expire_and_stale);
 	AST_TEST_REGISTER(high_object_count_without_expiration);
+	AST_TEST_REGISTER(reader_heavy_eviction);
 
 	return AST_MODULE_LOAD_SUCCESS;
 }
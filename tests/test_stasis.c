@@ -515,6 +515,71 @@ AST_TEST_DEFINE(publish_sync)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(publish_batched)
+{
+	RAII_VAR(struct stasis_topic *, topic, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_subscription *, uut, NULL, stasis_unsubscribe);
+	RAII_VAR(struct stasis_message_type *, test_message_type, NULL, ao2_cleanup);
+	RAII_VAR(struct consumer *, consumer, NULL, ao2_cleanup);
+	char *test_data[11];
+	struct stasis_message *test_message;
+	int actual_len;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = __func__;
+		info->category = test_category;
+		info->summary = "Test batched delivery to a subscription";
+		info->description = "Test that messages published to a subscription "
+			"delivering batches arrive in order and are ordered with "
+			"synchronous publishing";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	topic = stasis_topic_create("TestTopic");
+	ast_test_validate(test, NULL != topic);
+
+	consumer = consumer_create(1);
+	ast_test_validate(test, NULL != consumer);
+
+	uut = stasis_subscribe(topic, consumer_exec, consumer);
+	ast_test_validate(test, NULL != uut);
+	ao2_ref(consumer, +1);
+	ast_test_validate(test, 0 == stasis_subscription_set_batch_size(uut, 4));
+
+	ast_test_validate(test, stasis_message_type_create("TestMessage", NULL, &test_message_type) == STASIS_MESSAGE_TYPE_SUCCESS);
+
+	for (i = 0; i < ARRAY_LEN(test_data); ++i) {
+		test_data[i] = ao2_alloc(1, NULL);
+		ast_test_validate(test, NULL != test_data[i]);
+		test_message = stasis_message_create(test_message_type, test_data[i]);
+		ao2_ref(test_data[i], -1);
+		ast_test_validate(test, NULL != test_message);
+
+		/* The last message must not overtake the batches queued before it */
+		if (i == ARRAY_LEN(test_data) - 1) {
+			stasis_publish_sync(uut, test_message);
+		} else {
+			stasis_publish(topic, test_message);
+		}
+		ao2_ref(test_message, -1);
+	}
+
+	ao2_lock(consumer);
+	actual_len = consumer->messages_rxed_len;
+	ao2_unlock(consumer);
+	ast_test_validate(test, ARRAY_LEN(test_data) == actual_len);
+
+	for (i = 0; i < ARRAY_LEN(test_data); ++i) {
+		ast_test_validate(test, test_data[i] == stasis_message_data(consumer->messages_rxed[i]));
+	}
+
+	return AST_TEST_PASS;
+}
+
 AST_TEST_DEFINE(publish_pool)
 {
 	RAII_VAR(struct stasis_topic *, topic, NULL, ao2_cleanup);
@@ -1598,6 +1663,95 @@ AST_TEST_DEFINE(router)
 	return AST_TEST_PASS;
 }
 
+AST_TEST_DEFINE(router_remove)
+{
+	RAII_VAR(struct stasis_topic *, topic, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message_router *, uut, NULL, stasis_message_router_unsubscribe_and_join);
+	RAII_VAR(char *, test_data, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message_type *, test_message_type1, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message_type *, test_message_type2, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message_type *, test_message_type3, NULL, ao2_cleanup);
+	RAII_VAR(struct consumer *, consumer1, NULL, ao2_cleanup);
+	RAII_VAR(struct consumer *, consumer2, NULL, ao2_cleanup);
+	RAII_VAR(struct consumer *, consumer3, NULL, ao2_cleanup);
+	RAII_VAR(struct consumer *, consumer4, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message *, test_message1, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message *, test_message2, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message *, test_message3, NULL, ao2_cleanup);
+	int actual_len, ret;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = __func__;
+		info->category = test_category;
+		info->summary = "Test message routing after a route is removed";
+		info->description = "Test that the remaining routes still get their messages\n"
+			"and the messages of a removed route go to the default route";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	topic = stasis_topic_create("TestTopic");
+	ast_test_validate(test, NULL != topic);
+
+	consumer1 = consumer_create(1);
+	ast_test_validate(test, NULL != consumer1);
+	consumer2 = consumer_create(1);
+	ast_test_validate(test, NULL != consumer2);
+	consumer3 = consumer_create(1);
+	ast_test_validate(test, NULL != consumer3);
+	consumer4 = consumer_create(1);
+	ast_test_validate(test, NULL != consumer4);
+
+	ast_test_validate(test, stasis_message_type_create("TestMessage1", NULL, &test_message_type1) == STASIS_MESSAGE_TYPE_SUCCESS);
+	ast_test_validate(test, stasis_message_type_create("TestMessage2", NULL, &test_message_type2) == STASIS_MESSAGE_TYPE_SUCCESS);
+	ast_test_validate(test, stasis_message_type_create("TestMessage3", NULL, &test_message_type3) == STASIS_MESSAGE_TYPE_SUCCESS);
+
+	uut = stasis_message_router_create(topic);
+	ast_test_validate(test, NULL != uut);
+
+	ret = stasis_message_router_add(uut, test_message_type1, consumer_exec, consumer1);
+	ast_test_validate(test, 0 == ret);
+	ret = stasis_message_router_add(uut, test_message_type2, consumer_exec, consumer2);
+	ast_test_validate(test, 0 == ret);
+	ret = stasis_message_router_add(uut, test_message_type3, consumer_exec, consumer3);
+	ast_test_validate(test, 0 == ret);
+	ret = stasis_message_router_set_default(uut, consumer_exec, consumer4);
+	ast_test_validate(test, 0 == ret);
+	ao2_ref(consumer4, +1);
+
+	/* The last route takes the place of the first one */
+	stasis_message_router_remove(uut, test_message_type1);
+
+	test_data = ao2_alloc(1, NULL);
+	ast_test_validate(test, NULL != test_data);
+	test_message1 = stasis_message_create(test_message_type1, test_data);
+	ast_test_validate(test, NULL != test_message1);
+	test_message2 = stasis_message_create(test_message_type2, test_data);
+	ast_test_validate(test, NULL != test_message2);
+	test_message3 = stasis_message_create(test_message_type3, test_data);
+	ast_test_validate(test, NULL != test_message3);
+
+	stasis_publish(topic, test_message1);
+	stasis_publish(topic, test_message2);
+	stasis_publish(topic, test_message3);
+
+	actual_len = consumer_wait_for(consumer2, 1);
+	ast_test_validate(test, 1 == actual_len);
+	ast_test_validate(test, test_message2 == consumer2->messages_rxed[0]);
+	actual_len = consumer_wait_for(consumer3, 1);
+	ast_test_validate(test, 1 == actual_len);
+	ast_test_validate(test, test_message3 == consumer3->messages_rxed[0]);
+	actual_len = consumer_wait_for(consumer4, 1);
+	ast_test_validate(test, 1 == actual_len);
+	ast_test_validate(test, test_message1 == consumer4->messages_rxed[0]);
+	actual_len = consumer_should_stay(consumer1, 0);
+	ast_test_validate(test, 0 == actual_len);
+
+	return AST_TEST_PASS;
+}
+
 AST_TEST_DEFINE(router_pool)
 {
 	RAII_VAR(struct stasis_topic *, topic, NULL, ao2_cleanup);
@@ -1959,6 +2113,85 @@ AST_TEST_DEFINE(to_ami)
 	return AST_TEST_PASS;
 }
 
+/*! \brief Number of times the counting formatters ran */
+static int renderings;
+
+static struct ast_json *counting_json(struct stasis_message *message, const struct stasis_message_sanitizer *sanitize)
+{
+	ast_atomic_fetchadd_int(&renderings, +1);
+	return ast_json_pack("{s: s}", "text", (const char *) stasis_message_data(message));
+}
+
+static struct ast_manager_event_blob *counting_ami(struct stasis_message *message)
+{
+	ast_atomic_fetchadd_int(&renderings, +1);
+	return fake_ami(message);
+}
+
+AST_TEST_DEFINE(cached_renderings)
+{
+	RAII_VAR(struct stasis_message_type *, type, NULL, ao2_cleanup);
+	RAII_VAR(struct stasis_message *, uut, NULL, ao2_cleanup);
+	RAII_VAR(char *, data, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_json *, json1, NULL, ast_json_unref);
+	RAII_VAR(struct ast_json *, json2, NULL, ast_json_unref);
+	RAII_VAR(struct ast_json *, sanitized, NULL, ast_json_unref);
+	RAII_VAR(struct ast_manager_event_blob *, ami1, NULL, ao2_cleanup);
+	RAII_VAR(struct ast_manager_event_blob *, ami2, NULL, ao2_cleanup);
+	static struct stasis_message_vtable counting_vtable = {
+		.to_json = counting_json,
+		.to_ami = counting_ami,
+	};
+	static struct stasis_message_sanitizer sanitizer = {};
+	const char *expected_text = "SomeData";
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = __func__;
+		info->category = test_category;
+		info->summary = "Test that message renderings are shared";
+		info->description = "Test that converting a message to JSON or AMI "
+			"more than once only formats it once per sanitizer, and that "
+			"every caller can modify the JSON it gets back";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_test_validate(test, stasis_message_type_create("SomeMessage", &counting_vtable, &type) == STASIS_MESSAGE_TYPE_SUCCESS);
+
+	data = ao2_alloc(strlen(expected_text) + 1, NULL);
+	ast_test_validate(test, NULL != data);
+	strcpy(data, expected_text);
+	uut = stasis_message_create(type, data);
+	ast_test_validate(test, NULL != uut);
+	renderings = 0;
+
+	json1 = stasis_message_to_json(uut, NULL);
+	json2 = stasis_message_to_json(uut, NULL);
+	ast_test_validate(test, NULL != json1 && NULL != json2);
+	ast_test_validate(test, 1 == renderings);
+	ast_test_validate(test, json1 != json2);
+	ast_test_validate(test, ast_json_equal(json1, json2));
+
+	/* Changes to one copy must not show up in any other */
+	ast_test_validate(test, 0 == ast_json_object_set(json1, "extra", ast_json_true()));
+	ast_test_validate(test, NULL == ast_json_object_get(json2, "extra"));
+
+	sanitized = stasis_message_to_json(uut, &sanitizer);
+	ast_test_validate(test, NULL != sanitized);
+	ast_test_validate(test, 2 == renderings);
+	ast_test_validate(test, NULL == ast_json_object_get(sanitized, "extra"));
+
+	ami1 = stasis_message_to_ami(uut);
+	ami2 = stasis_message_to_ami(uut);
+	ast_test_validate(test, NULL != ami1);
+	ast_test_validate(test, ami1 == ami2);
+	ast_test_validate(test, 3 == renderings);
+
+	return AST_TEST_PASS;
+}
+
 static void noop(void *data, struct stasis_subscription *sub,
 	struct stasis_message *message)
 {
@@ -2441,6 +2674,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(subscription_pool_messages);
 	AST_TEST_UNREGISTER(publish);
 	AST_TEST_UNREGISTER(publish_sync);
+	AST_TEST_UNREGISTER(publish_batched);
 	AST_TEST_UNREGISTER(publish_pool);
 	AST_TEST_UNREGISTER(unsubscribe_stops_messages);
 	AST_TEST_UNREGISTER(forward);
@@ -2449,6 +2683,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(cache_dump);
 	AST_TEST_UNREGISTER(cache_eid_aggregate);
 	AST_TEST_UNREGISTER(router);
+	AST_TEST_UNREGISTER(router_remove);
 	AST_TEST_UNREGISTER(router_pool);
 	AST_TEST_UNREGISTER(router_cache_updates);
 	AST_TEST_UNREGISTER(interleaving);
@@ -2457,6 +2692,7 @@ static int unload_module(void)
 	AST_TEST_UNREGISTER(to_json);
 	AST_TEST_UNREGISTER(no_to_ami);
 	AST_TEST_UNREGISTER(to_ami);
+	AST_TEST_UNREGISTER(cached_renderings);
 	AST_TEST_UNREGISTER(dtor_order);
 	AST_TEST_UNREGISTER(caching_dtor_order);
 	AST_TEST_UNREGISTER(type_filters);
@@ -2473,6 +2709,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(subscription_pool_messages);
 	AST_TEST_REGISTER(publish);
 	AST_TEST_REGISTER(publish_sync);
+	AST_TEST_REGISTER(publish_batched);
 	AST_TEST_REGISTER(publish_pool);
 	AST_TEST_REGISTER(unsubscribe_stops_messages);
 	AST_TEST_REGISTER(forward);
@@ -2481,6 +2718,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(cache_dump);
 	AST_TEST_REGISTER(cache_eid_aggregate);
 	AST_TEST_REGISTER(router);
+	AST_TEST_REGISTER(router_remove);
 	AST_TEST_REGISTER(router_pool);
 	AST_TEST_REGISTER(router_cache_updates);
 	AST_TEST_REGISTER(interleaving);
@@ -2489,6 +2727,7 @@ static int load_module(void)
 	AST_TEST_REGISTER(to_json);
 	AST_TEST_REGISTER(no_to_ami);
 	AST_TEST_REGISTER(to_ami);
+	AST_TEST_REGISTER(cached_renderings);
 	AST_TEST_REGISTER(dtor_order);
 	AST_TEST_REGISTER(caching_dtor_order);
 	AST_TEST_REGISTER(type_filters);
@@ -513,8 +513,112 @@ error:
 	return res;
 }
 
+AST_TEST_DEFINE(string_field_compact_test)
+{
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct test_struct *inst = NULL;
+	char long_string[200];
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "string_field_compact_test";
+		info->category = "/main/utils/";
+		info->summary = "Test stringfield compaction";
+		info->description =
+			"This tests that compacting string fields preserves their values "
+			"and releases the space left behind by earlier values";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	inst = ast_calloc_with_stringfields(1, struct test_struct, 32);
+	if (!inst) {
+		ast_test_status_update(test, "Unable to allocate structure!\n");
+		return AST_TEST_FAIL;
+	}
+	ast_string_field_init_extended(inst, string2);
+
+	memset(long_string, 'x', sizeof(long_string) - 1);
+	long_string[sizeof(long_string) - 1] = '\0';
+
+	/* Outgrow the embedded pool a few times, then settle on short values */
+	for (i = 0; i < 4; i++) {
+		ast_string_field_build(inst, string1, "%s%d", long_string, i);
+		ast_string_field_build(inst, string2, "%d%s", i, long_string);
+	}
+	ast_string_field_set(inst, string1, "foo");
+	ast_string_field_set(inst, string2, "bar");
+
+	if (inst->__field_mgr.embedded_pool == inst->__field_mgr_pool) {
+		ast_test_status_update(test, "Structure should have added pools!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	if (ast_string_field_compact(inst)) {
+		ast_test_status_update(test, "Compacting short fields failed!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	if (inst->__field_mgr.embedded_pool != inst->__field_mgr_pool
+		|| inst->__field_mgr_pool->prev) {
+		ast_test_status_update(test, "Short fields should have been compacted into the embedded pool!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	if (strcmp(inst->string1, "foo") || strcmp(inst->string2, "bar")) {
+		ast_test_status_update(test, "Compacted fields have the wrong values '%s' and '%s'!\n",
+			inst->string1, inst->string2);
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	/* The fields must still be usable after compaction */
+	ast_string_field_set(inst, string1, long_string);
+	for (i = 0; i < 4; i++) {
+		ast_string_field_build(inst, string2, "%d%s", i, long_string);
+	}
+
+	if (ast_string_field_compact(inst)) {
+		ast_test_status_update(test, "Compacting long fields failed!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	if (inst->__field_mgr.embedded_pool == inst->__field_mgr_pool
+		|| inst->__field_mgr_pool->prev != inst->__field_mgr.embedded_pool) {
+		ast_test_status_update(test, "Long fields should have been compacted into a single new pool!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	if (strcmp(inst->string1, long_string) || strncmp(inst->string2, "3", 1)
+		|| strcmp(inst->string2 + 1, long_string)) {
+		ast_test_status_update(test, "Compacted long fields have the wrong values!\n");
+		res = AST_TEST_FAIL;
+		goto error;
+	}
+
+	ast_string_field_set(inst, string1, "baz");
+	if (strcmp(inst->string1, "baz")) {
+		ast_test_status_update(test, "Setting a field after compaction failed!\n");
+		res = AST_TEST_FAIL;
+	}
+
+error:
+	ast_string_field_free_memory(inst);
+	ast_free(inst);
+
+	return res;
+}
+
 static int unload_module(void)
 {
+	AST_TEST_UNREGISTER(string_field_compact_test);
 	AST_TEST_UNREGISTER(string_field_aggregate_test);
 	AST_TEST_UNREGISTER(string_field_test);
 	return 0;
@@ -524,6 +628,7 @@ static int load_module(void)
 {
 	AST_TEST_REGISTER(string_field_test);
 	AST_TEST_REGISTER(string_field_aggregate_test);
+	AST_TEST_REGISTER(string_field_compact_test);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
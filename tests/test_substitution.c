@@ -335,8 +335,152 @@ AST_TEST_DEFINE(test_substitution)
 	return res;
 }
 
+static enum ast_test_result_state test_template_result(struct ast_test *test,
+		struct ast_channel *c, const char *expression)
+{
+	struct pbx_substitute_template *templ;
+	char expected[4096];
+	char actual[4096];
+	size_t expected_used;
+	size_t actual_used;
+	int count;
+	int okay = 1;
+
+	templ = pbx_substitute_template_compile(expression);
+	if (!templ) {
+		ast_test_status_update(test, "Failed to compile '%s'\n", expression);
+		return AST_TEST_FAIL;
+	}
+
+	/* Check every output size that truncates the result as well as the full one */
+	pbx_substitute_variables_helper_full(c, ast_channel_varshead(c), expression,
+		expected, sizeof(expected) - 1, &expected_used);
+	for (count = 1; okay && count <= expected_used + 1; ++count) {
+		pbx_substitute_variables_helper_full(c, ast_channel_varshead(c), expression,
+			expected, count, &expected_used);
+		pbx_substitute_template_helper_full(c, ast_channel_varshead(c), templ,
+			actual, count, &actual_used);
+		if (strcmp(expected, actual) || expected_used != actual_used) {
+			ast_test_status_update(test, "'%s' expanded to '%s' (%zu) instead of '%s' (%zu) with count %d\n",
+				expression, actual, actual_used, expected, expected_used, count);
+			okay = 0;
+		}
+	}
+	ast_test_status_update(test, "Tested template '%s' ('%s') . . . . . %s\n",
+		expression, expected, okay ? "passed" : "FAILED");
+
+	ao2_ref(templ, -1);
+
+	return okay ? AST_TEST_PASS : AST_TEST_FAIL;
+}
+
+AST_TEST_DEFINE(test_substitution_template)
+{
+	static const char * const expressions[] = {
+		"",
+		"no substitutions",
+		"$",
+		"cost: $5 or $$10",
+		"${foo}${foo}",
+		"A${foo}A${foo}A",
+		"A${${bar}}A",
+		"A${${baz}o:1:1}A",
+		"A${${baz}o:-2:-1}A",
+		"${foo:1}/${foo:-1}",
+		"${LEN(${foo}${foo})}",
+		"${LISTFILTER(list1,&,cd)}",
+		"${CUT(list1,&,2-3)}",
+		"${this_does_not_exist}x${THIS_DOES_NOT_EXIST(either)}",
+		"$[1 + 2]",
+		"$[${foo} * 2]",
+		"$[${foo} > 100]x$[ ${LEN(${bar})} = 3 ]",
+		"$[${foo} + $[1 + 1]]",
+		"${IF($[${foo} > 5]?yes:no)}",
+		"${foo}{literal}[brackets]",
+		"Dial(PJSIP/${bar}&PJSIP/${baz}o,${foo},tT)",
+		"unterminated ${foo",
+		"unterminated $[1 + 2",
+	};
+	static const char * const bench_expressions[] = {
+		"PJSIP/${foo}@${bar},30,tT",
+		"PJSIP/${foo}@${bar},${IF($[${foo} > 5]?30:60)},tT",
+	};
+	enum ast_test_result_state res = AST_TEST_PASS;
+	struct pbx_substitute_template *templ;
+	struct ast_channel *c;
+	char workspace[4096];
+	struct timeval start;
+	int64_t parsed_us;
+	int64_t compiled_us;
+	int i;
+	int j;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "test_substitution_template";
+		info->category = "/main/pbx/";
+		info->summary = "Test parsed substitution templates";
+		info->description =
+			"Expands a variety of templates both directly and through a parsed\n"
+			"template and ensures the results are identical, including when the\n"
+			"output is truncated. Also reports how long repeated expansion of a\n"
+			"typical application argument takes both ways.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	c = ast_channel_alloc(0, 0, "", "", "", "", "", NULL, NULL, 0, "Test/substitution");
+	if (!c) {
+		return AST_TEST_FAIL;
+	}
+	ast_channel_unlock(c);
+
+	pbx_builtin_setvar_helper(c, "foo", "123");
+	pbx_builtin_setvar_helper(c, "bar", "foo");
+	pbx_builtin_setvar_helper(c, "baz", "fo");
+	pbx_builtin_setvar_helper(c, "list1", "ab&cd&ef");
+
+	for (i = 0; i < ARRAY_LEN(expressions); i++) {
+		if (test_template_result(test, c, expressions[i]) == AST_TEST_FAIL) {
+			res = AST_TEST_FAIL;
+		}
+	}
+
+	for (j = 0; j < ARRAY_LEN(bench_expressions); j++) {
+		templ = pbx_substitute_template_compile(bench_expressions[j]);
+		if (!templ) {
+			res = AST_TEST_FAIL;
+			break;
+		}
+
+		start = ast_tvnow();
+		for (i = 0; i < 10000; i++) {
+			pbx_substitute_variables_helper(c, bench_expressions[j], workspace, sizeof(workspace) - 1);
+		}
+		parsed_us = ast_tvdiff_us(ast_tvnow(), start);
+
+		start = ast_tvnow();
+		for (i = 0; i < 10000; i++) {
+			pbx_substitute_template_helper_full(c, ast_channel_varshead(c), templ,
+				workspace, sizeof(workspace) - 1, NULL);
+		}
+		compiled_us = ast_tvdiff_us(ast_tvnow(), start);
+
+		ast_test_status_update(test, "10000 expansions of '%s': %" PRId64 " us parsing each time, %" PRId64 " us from a template\n",
+			bench_expressions[j], parsed_us, compiled_us);
+
+		ao2_ref(templ, -1);
+	}
+
+	ast_hangup(c);
+
+	return res;
+}
+
 static int unload_module(void)
 {
+	AST_TEST_UNREGISTER(test_substitution_template);
 	AST_TEST_UNREGISTER(test_substitution);
 	return 0;
 }
@@ -344,6 +488,7 @@ static int unload_module(void)
 static int load_module(void)
 {
 	AST_TEST_REGISTER(test_substitution);
+	AST_TEST_REGISTER(test_substitution_template);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
@@ -963,6 +963,379 @@ AST_TEST_DEFINE(serializer_pool)
 	return AST_TEST_PASS;
 }
 
+/*! Tasks pushed per benchmark run, divisible by every producer count */
+#define BENCH_TASKS 96000
+
+/*! Producer thread counts measured by the push benchmark */
+static const int bench_producers[] = { 1, 8, 32 };
+
+/*!
+ * \brief A single benchmark task
+ */
+struct bench_task {
+	/*! The producer that pushed the task */
+	int producer;
+	/*! Sequence number of the task within its producer */
+	int seq;
+};
+
+/*!
+ * \brief State shared by the producers and tasks of one benchmark run
+ */
+struct bench_data {
+	/*! The taskprocessor under test */
+	struct ast_taskprocessor *tps;
+	/*! Lock protecting the conditions and counters */
+	ast_mutex_t lock;
+	/*! Signalled when the producers may start and when all tasks are done */
+	ast_cond_t cond;
+	/*! Non-zero once the producers may start pushing */
+	int go;
+	/*! Number of tasks each producer pushes */
+	int tasks_per_producer;
+	/*! Number of producers that failed to push a task */
+	int push_failures;
+	/*! Number of tasks executed, only touched from the taskprocessor thread until done */
+	int tasks_completed;
+	/*! Non-zero if a producer's tasks executed out of order */
+	int out_of_order;
+	/*! Last sequence number executed for each producer */
+	int *last_seq;
+	/*! All of the tasks, grouped by producer */
+	struct bench_task *tasks;
+};
+
+/*!
+ * \brief Producer argument, identifies which slice of tasks to push
+ */
+struct bench_producer {
+	struct bench_data *data;
+	int producer;
+};
+
+static struct bench_data *bench;
+
+static int bench_task_exec(void *obj)
+{
+	struct bench_task *task = obj;
+
+	/* Tasks are serialized so only the completion signal needs the lock */
+	if (bench->last_seq[task->producer] + 1 != task->seq) {
+		bench->out_of_order = 1;
+	}
+	bench->last_seq[task->producer] = task->seq;
+
+	if (++bench->tasks_completed == BENCH_TASKS) {
+		SCOPED_MUTEX(lock, &bench->lock);
+		ast_cond_signal(&bench->cond);
+	}
+	return 0;
+}
+
+static void *bench_producer_thread(void *obj)
+{
+	struct bench_producer *producer = obj;
+	struct bench_data *data = producer->data;
+	struct bench_task *tasks = &data->tasks[producer->producer * data->tasks_per_producer];
+	int i;
+
+	ast_mutex_lock(&data->lock);
+	while (!data->go) {
+		ast_cond_wait(&data->cond, &data->lock);
+	}
+	ast_mutex_unlock(&data->lock);
+
+	for (i = 0; i < data->tasks_per_producer; i++) {
+		if (ast_taskprocessor_push(data->tps, bench_task_exec, &tasks[i])) {
+			ast_mutex_lock(&data->lock);
+			++data->push_failures;
+			ast_mutex_unlock(&data->lock);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Time pushing and executing BENCH_TASKS tasks from several producers
+ *
+ * \retval -1 on failure
+ * \return elapsed time in milliseconds
+ */
+static int64_t bench_run(struct ast_test *test, enum ast_tps_options options, int num_producers)
+{
+	char name[AST_TASKPROCESSOR_MAX_NAME + 1];
+	struct bench_data data = { 0, };
+	struct bench_producer *producers;
+	pthread_t *threads;
+	struct timeval start;
+	struct timespec end;
+	int64_t elapsed = -1;
+	int started;
+	int i;
+
+	producers = ast_calloc(num_producers, sizeof(*producers));
+	threads = ast_calloc(num_producers, sizeof(*threads));
+	data.last_seq = ast_calloc(num_producers, sizeof(*data.last_seq));
+	data.tasks = ast_calloc(BENCH_TASKS, sizeof(*data.tasks));
+	if (!producers || !threads || !data.last_seq || !data.tasks) {
+		goto cleanup;
+	}
+
+	data.tasks_per_producer = BENCH_TASKS / num_producers;
+	for (i = 0; i < BENCH_TASKS; i++) {
+		data.tasks[i].producer = i / data.tasks_per_producer;
+		data.tasks[i].seq = i % data.tasks_per_producer;
+	}
+	for (i = 0; i < num_producers; i++) {
+		data.last_seq[i] = -1;
+	}
+
+	snprintf(name, sizeof(name), "test_bench/%s-%d",
+		options & TPS_QUEUE_LOCKFREE ? "lockfree" : "locked", num_producers);
+	data.tps = ast_taskprocessor_get(name, options);
+	if (!data.tps) {
+		ast_test_status_update(test, "Unable to create taskprocessor '%s'\n", name);
+		goto cleanup;
+	}
+
+	ast_mutex_init(&data.lock);
+	ast_cond_init(&data.cond, NULL);
+	bench = &data;
+
+	for (started = 0; started < num_producers; started++) {
+		producers[started].data = &data;
+		producers[started].producer = started;
+		if (ast_pthread_create(&threads[started], NULL, bench_producer_thread, &producers[started])) {
+			ast_test_status_update(test, "Unable to create producer thread\n");
+			break;
+		}
+	}
+
+	ast_mutex_lock(&data.lock);
+	start = ast_tvnow();
+	data.go = 1;
+	ast_cond_broadcast(&data.cond);
+	ast_mutex_unlock(&data.lock);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if (started == num_producers && !data.push_failures) {
+		end.tv_sec = start.tv_sec + 60;
+		end.tv_nsec = start.tv_usec * 1000;
+
+		ast_mutex_lock(&data.lock);
+		while (data.tasks_completed < BENCH_TASKS) {
+			if (ast_cond_timedwait(&data.cond, &data.lock, &end) == ETIMEDOUT) {
+				break;
+			}
+		}
+		ast_mutex_unlock(&data.lock);
+
+		if (data.tasks_completed != BENCH_TASKS) {
+			ast_test_status_update(test, "%s: only %d of %d tasks executed\n",
+				name, data.tasks_completed, BENCH_TASKS);
+		} else if (data.out_of_order) {
+			ast_test_status_update(test, "%s: tasks from a producer executed out of order\n", name);
+		} else {
+			elapsed = ast_tvdiff_ms(ast_tvnow(), start);
+		}
+	} else if (data.push_failures) {
+		ast_test_status_update(test, "%s: %d producers failed to push\n", name, data.push_failures);
+	}
+
+	/* Waits for any tasks still queued on failure before the data goes away */
+	ast_taskprocessor_unreference(data.tps);
+	bench = NULL;
+	ast_cond_destroy(&data.cond);
+	ast_mutex_destroy(&data.lock);
+
+cleanup:
+	ast_free(data.tasks);
+	ast_free(data.last_seq);
+	ast_free(threads);
+	ast_free(producers);
+	return elapsed;
+}
+
+/*!
+ * \brief Compare push throughput of the locked and lock-free queues
+ *
+ * Each run pushes the same number of tasks split evenly across the
+ * producers and measures the time until the last one has executed.
+ */
+AST_TEST_DEFINE(taskprocessor_push_benchmark)
+{
+	static const enum ast_tps_options modes[] = { TPS_REF_DEFAULT, TPS_QUEUE_LOCKFREE };
+	int mode;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "taskprocessor_push_benchmark";
+		info->category = "/main/taskprocessor/";
+		info->summary = "Benchmark the locked and lock-free task queues";
+		info->description =
+			"Pushes tasks from 1, 8 and 32 producer threads onto a default\n"
+			"taskprocessor using the locked queue and then the lock-free\n"
+			"queue, reporting tasks per second.  Fails if any task is lost\n"
+			"or a producer's tasks execute out of order.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	for (i = 0; i < ARRAY_LEN(bench_producers); i++) {
+		for (mode = 0; mode < ARRAY_LEN(modes); mode++) {
+			int64_t elapsed = bench_run(test, modes[mode], bench_producers[i]);
+
+			if (elapsed < 0) {
+				return AST_TEST_FAIL;
+			}
+			ast_test_status_update(test, "%-8s queue, %2d producers: %d tasks in %" PRId64 " ms, %" PRId64 " tasks/sec\n",
+				modes[mode] & TPS_QUEUE_LOCKFREE ? "lockfree" : "locked", bench_producers[i],
+				BENCH_TASKS, elapsed, (int64_t) BENCH_TASKS * 1000 / MAX(elapsed, 1));
+		}
+	}
+
+	return AST_TEST_PASS;
+}
+
+/*! \brief Statistics of the test taskprocessor, copied by timing_stats_cb() */
+struct timing_stats {
+	const char *name;
+	struct ast_taskprocessor_stats stats;
+	int found;
+};
+
+static void timing_stats_cb(const struct ast_taskprocessor_stats *stats, void *data)
+{
+	struct timing_stats *timing = data;
+
+	if (!strcmp(stats->name, timing->name)) {
+		timing->stats = *stats;
+		timing->found = 1;
+	}
+}
+
+/*! \brief Sum of the tasks of every task function, copied by timing_callback_stats_cb() */
+struct timing_callback_stats {
+	unsigned long processed;
+	unsigned long long max_execution;
+};
+
+static void timing_callback_stats_cb(const struct ast_taskprocessor_callback_stats *stats, void *data)
+{
+	struct timing_callback_stats *timing = data;
+
+	timing->processed += stats->processed;
+	timing->max_execution = MAX(timing->max_execution, stats->execution.max);
+}
+
+/*!
+ * \brief Wait for the statistics of a task to be counted
+ *
+ * The statistics are updated after the task signals it is complete.
+ */
+static int timing_stats_wait(struct timing_stats *timing, unsigned long processed)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		timing->found = 0;
+		ast_taskprocessor_stats_foreach(timing_stats_cb, timing);
+		if (timing->found && timing->stats.processed >= processed) {
+			return 0;
+		}
+		usleep(10000);
+	}
+
+	return -1;
+}
+
+AST_TEST_DEFINE(taskprocessor_timing)
+{
+	RAII_VAR(struct ast_taskprocessor *, tps, NULL, ast_taskprocessor_unreference);
+	RAII_VAR(struct task_data *, task_data, NULL, ao2_cleanup);
+	struct timing_stats timing = { .name = "test_timing", };
+	struct timing_callback_stats callbacks = { 0, };
+	enum ast_test_result_state res = AST_TEST_PASS;
+	unsigned long counted = 0;
+	int i;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "taskprocessor_timing";
+		info->category = "/main/taskprocessor/";
+		info->summary = "Test of taskprocessor wait and execution times";
+		info->description =
+			"Executes a task that sleeps for 20 milliseconds, and ensures its\n"
+			"execution time is counted for the taskprocessor and for its task\n"
+			"function.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	tps = ast_taskprocessor_get(timing.name, TPS_REF_DEFAULT);
+	task_data = task_data_create();
+	if (!tps || !task_data) {
+		ast_test_status_update(test, "Unable to create the test taskprocessor\n");
+		return AST_TEST_FAIL;
+	}
+	task_data->wait_time = 20;
+
+	ast_taskprocessor_callback_stats_enable(1);
+
+	if (ast_taskprocessor_push(tps, task, task_data)) {
+		ast_test_status_update(test, "Failed to queue task\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+	if (task_wait(task_data) || timing_stats_wait(&timing, 1)) {
+		ast_test_status_update(test, "Queued task was not counted\n");
+		res = AST_TEST_FAIL;
+		goto cleanup;
+	}
+
+	if (timing.stats.processed != 1 || timing.stats.queued != 0) {
+		ast_test_status_update(test, "Processed %lu tasks with %ld queued, expected 1 and 0\n",
+			timing.stats.processed, timing.stats.queued);
+		res = AST_TEST_FAIL;
+	}
+	if (timing.stats.execution.total < 20000
+		|| timing.stats.execution.max != timing.stats.execution.total) {
+		ast_test_status_update(test, "Task took %llu microseconds, longest %llu\n",
+			timing.stats.execution.total, timing.stats.execution.max);
+		res = AST_TEST_FAIL;
+	}
+	if (timing.stats.execution.buckets[4] != 1) {
+		ast_test_status_update(test, "Task was not counted between 10 and 100 milliseconds\n");
+		res = AST_TEST_FAIL;
+	}
+	for (i = 0; i < AST_TASKPROCESSOR_TIME_BUCKETS; i++) {
+		counted += timing.stats.wait.buckets[i];
+	}
+	if (counted != 1 || timing.stats.wait.max != timing.stats.wait.total) {
+		ast_test_status_update(test, "Wait of %lu tasks was counted, expected 1\n", counted);
+		res = AST_TEST_FAIL;
+	}
+
+	ast_taskprocessor_callback_stats_foreach(timing_callback_stats_cb, &callbacks);
+	if (!callbacks.processed || callbacks.max_execution < 20000) {
+		ast_test_status_update(test, "The task function was not counted\n");
+		res = AST_TEST_FAIL;
+	}
+
+cleanup:
+	ast_taskprocessor_callback_stats_enable(0);
+
+	return res;
+}
+
 static int unload_module(void)
 {
 	ast_test_unregister(default_taskprocessor);
@@ -972,6 +1345,8 @@ static int unload_module(void)
 	ast_test_unregister(taskprocessor_shutdown);
 	ast_test_unregister(taskprocessor_push_local);
 	ast_test_unregister(serializer_pool);
+	ast_test_unregister(taskprocessor_push_benchmark);
+	ast_test_unregister(taskprocessor_timing);
 	return 0;
 }
 
@@ -984,6 +1359,8 @@ static int load_module(void)
 	ast_test_register(taskprocessor_shutdown);
 	ast_test_register(taskprocessor_push_local);
 	ast_test_register(serializer_pool);
+	ast_test_register(taskprocessor_push_benchmark);
+	ast_test_register(taskprocessor_timing);
 	return AST_MODULE_LOAD_SUCCESS;
 }
 
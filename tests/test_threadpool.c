@@ -1511,6 +1511,257 @@ end:
 	return res;
 }
 
+AST_TEST_DEFINE(threadpool_work_stealing_distribution)
+{
+	struct ast_threadpool *pool = NULL;
+	struct ast_threadpool_listener *listener = NULL;
+	struct complex_task_data *ctd1 = NULL;
+	struct complex_task_data *ctd2 = NULL;
+	enum ast_test_result_state res = AST_TEST_FAIL;
+	struct test_listener_data *tld = NULL;
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 0,
+		.auto_increment = 0,
+		.initial_size = 0,
+		.max_size = 0,
+		.work_stealing = 1,
+	};
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "work_stealing_distribution";
+		info->category = "/main/threadpool/";
+		info->summary = "Test task distribution and notifications with work stealing";
+		info->description =
+			"Push two tasks into a work stealing threadpool with no threads, then\n"
+			"add two threads. Ensure that each task is handled by a separate thread\n"
+			"and the listener is notified just as with the shared queue.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	tld = test_alloc();
+	if (!tld) {
+		return AST_TEST_FAIL;
+	}
+
+	listener = ast_threadpool_listener_alloc(&test_callbacks, tld);
+	if (!listener) {
+		goto end;
+	}
+
+	pool = ast_threadpool_create(info->name, listener, &options);
+	if (!pool) {
+		goto end;
+	}
+
+	ctd1 = complex_task_data_alloc();
+	ctd2 = complex_task_data_alloc();
+	if (!ctd1 || !ctd2) {
+		goto end;
+	}
+
+	if (ast_threadpool_push(pool, complex_task, ctd1)) {
+		goto end;
+	}
+
+	if (ast_threadpool_push(pool, complex_task, ctd2)) {
+		goto end;
+	}
+
+	if (ast_threadpool_queue_size(pool) != 2) {
+		ast_test_status_update(test, "Expected 2 queued tasks, got %ld\n",
+			ast_threadpool_queue_size(pool));
+		res = AST_TEST_FAIL;
+		goto end;
+	}
+
+	ast_threadpool_set_size(pool, 2);
+
+	res = wait_until_thread_state(test, tld, 2, 0);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+
+	if (!wait_for_complex_start(ctd1) || !wait_for_complex_start(ctd2)) {
+		ast_test_status_update(test, "Tasks were not run by separate threads\n");
+		res = AST_TEST_FAIL;
+		goto end;
+	}
+
+	res = listener_check(test, listener, 1, 0, 2, 2, 0, 0);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+
+	poke_worker(ctd1);
+	poke_worker(ctd2);
+
+	res = wait_for_complex_completion(ctd1);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+	res = wait_for_complex_completion(ctd2);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+
+	res = wait_until_thread_state(test, tld, 0, 2);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+
+	res = wait_for_empty_notice(test, tld);
+	if (res == AST_TEST_FAIL) {
+		goto end;
+	}
+
+	res = listener_check(test, listener, 1, 0, 2, 0, 2, 1);
+
+end:
+	ast_threadpool_shutdown(pool);
+	ao2_cleanup(listener);
+	complex_task_data_free(ctd1);
+	complex_task_data_free(ctd2);
+	ast_free(tld);
+	return res;
+}
+
+struct steal_task_data {
+	struct ast_threadpool *pool;
+	struct complex_task_data *children[2];
+	int children_started;
+	int done;
+	ast_mutex_t lock;
+	ast_cond_t cond;
+};
+
+/*!
+ * \brief Push child tasks and block until other workers have picked them up
+ *
+ * Tasks pushed from a worker are queued to that worker, so the children can
+ * only start while this task is blocked if another worker steals them.
+ */
+static int steal_parent_task(void *data)
+{
+	struct steal_task_data *std = data;
+	int started = 1;
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(std->children); ++i) {
+		if (ast_threadpool_push(std->pool, complex_task, std->children[i])) {
+			started = 0;
+		}
+	}
+
+	for (i = 0; i < ARRAY_LEN(std->children); ++i) {
+		if (!started || !wait_for_complex_start(std->children[i])) {
+			started = 0;
+		}
+		poke_worker(std->children[i]);
+	}
+
+	ast_mutex_lock(&std->lock);
+	std->children_started = started;
+	std->done = 1;
+	ast_cond_signal(&std->cond);
+	ast_mutex_unlock(&std->lock);
+
+	return 0;
+}
+
+AST_TEST_DEFINE(threadpool_work_stealing)
+{
+	struct ast_threadpool *pool = NULL;
+	struct steal_task_data std = { 0, };
+	enum ast_test_result_state res = AST_TEST_FAIL;
+	struct timeval start;
+	struct timespec end;
+	int i;
+	struct ast_threadpool_options options = {
+		.version = AST_THREADPOOL_OPTIONS_VERSION,
+		.idle_timeout = 0,
+		.auto_increment = 0,
+		.initial_size = 3,
+		.max_size = 0,
+		.work_stealing = 1,
+	};
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "work_stealing";
+		info->category = "/main/threadpool/";
+		info->summary = "Test that idle threads steal tasks from busy ones";
+		info->description =
+			"Run a task that pushes two more tasks onto its own thread's queue\n"
+			"and then blocks until they start. Ensure the other threads steal\n"
+			"and run them.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_mutex_init(&std.lock);
+	ast_cond_init(&std.cond, NULL);
+
+	for (i = 0; i < ARRAY_LEN(std.children); ++i) {
+		std.children[i] = complex_task_data_alloc();
+		if (!std.children[i]) {
+			goto end;
+		}
+	}
+
+	pool = ast_threadpool_create(info->name, NULL, &options);
+	if (!pool) {
+		goto end;
+	}
+	std.pool = pool;
+
+	if (ast_threadpool_push(pool, steal_parent_task, &std)) {
+		goto end;
+	}
+
+	start = ast_tvnow();
+	end.tv_sec = start.tv_sec + 10;
+	end.tv_nsec = start.tv_usec * 1000;
+
+	ast_mutex_lock(&std.lock);
+	while (!std.done) {
+		if (ast_cond_timedwait(&std.cond, &std.lock, &end) == ETIMEDOUT) {
+			break;
+		}
+	}
+	ast_mutex_unlock(&std.lock);
+
+	if (!std.done) {
+		ast_test_status_update(test, "Parent task did not finish\n");
+		goto end;
+	}
+	if (!std.children_started) {
+		ast_test_status_update(test, "Child tasks were not stolen by idle threads\n");
+		goto end;
+	}
+
+	res = AST_TEST_PASS;
+	for (i = 0; i < ARRAY_LEN(std.children); ++i) {
+		if (wait_for_complex_completion(std.children[i]) == AST_TEST_FAIL) {
+			ast_test_status_update(test, "Child task %d did not complete\n", i);
+			res = AST_TEST_FAIL;
+		}
+	}
+
+end:
+	ast_threadpool_shutdown(pool);
+	for (i = 0; i < ARRAY_LEN(std.children); ++i) {
+		complex_task_data_free(std.children[i]);
+	}
+	ast_mutex_destroy(&std.lock);
+	ast_cond_destroy(&std.cond);
+	return res;
+}
+
 AST_TEST_DEFINE(threadpool_more_destruction)
 {
 	struct ast_threadpool *pool = NULL;
@@ -1813,6 +2064,8 @@ static int unload_module(void)
 	ast_test_unregister(threadpool_max_size);
 	ast_test_unregister(threadpool_reactivation);
 	ast_test_unregister(threadpool_task_distribution);
+	ast_test_unregister(threadpool_work_stealing_distribution);
+	ast_test_unregister(threadpool_work_stealing);
 	ast_test_unregister(threadpool_more_destruction);
 	ast_test_unregister(threadpool_serializer);
 	ast_test_unregister(threadpool_serializer_dupe);
@@ -1834,6 +2087,8 @@ static int load_module(void)
 	ast_test_register(threadpool_max_size);
 	ast_test_register(threadpool_reactivation);
 	ast_test_register(threadpool_task_distribution);
+	ast_test_register(threadpool_work_stealing_distribution);
+	ast_test_register(threadpool_work_stealing);
 	ast_test_register(threadpool_more_destruction);
 	ast_test_register(threadpool_serializer);
 	ast_test_register(threadpool_serializer_dupe);
@@ -0,0 +1,216 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Binary trace ring tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/strings.h"
+#include "asterisk/utils.h"
+#include "asterisk/trace_ring.h"
+
+/*!
+ * \internal
+ * \brief Check the newest record of this thread decodes to what snprintf gives
+ */
+static int check_newest(struct ast_test *test, const char *expected)
+{
+	struct ast_str *buf = ast_trace_ring_get(ast_get_tid(), 1);
+	const char *line;
+	size_t len;
+	int res = 0;
+
+	if (!buf) {
+		ast_test_status_update(test, "Could not decode the trace ring\n");
+		return -1;
+	}
+
+	/* Skip the timestamp, thread, location and function */
+	line = ast_str_buffer(buf);
+	len = strlen(line);
+	if (len < strlen(expected) + 1
+		|| strncmp(line + len - strlen(expected) - 1, expected, strlen(expected))) {
+		ast_test_status_update(test, "Decoded '%s', expected it to end with '%s'\n",
+			line, expected);
+		res = -1;
+	}
+	ast_free(buf);
+
+	return res;
+}
+
+#define CHECK_RECORD(test, res, ...) \
+	do { \
+		char expected[256]; \
+		snprintf(expected, sizeof(expected), __VA_ARGS__); \
+		ast_trace_ring(__VA_ARGS__); \
+		if (check_newest(test, expected)) { \
+			res = AST_TEST_FAIL; \
+		} \
+	} while (0)
+
+AST_TEST_DEFINE(decode)
+{
+	int was_enabled = ast_trace_ring_enabled;
+	enum ast_test_result_state res = AST_TEST_PASS;
+	const char *name = "PJSIP/alice-00000001";
+	char changing[] = "before";
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "decode";
+		info->category = "/main/trace_ring/";
+		info->summary = "Trace records decode to what printf gives";
+		info->description =
+			"Takes records with every supported conversion and checks each\n"
+			"decodes to the same text snprintf produces.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_trace_ring_enable(1);
+
+	CHECK_RECORD(test, res, "no arguments");
+	CHECK_RECORD(test, res, "%d %i %u %x %X %o", -42, 7, 4000000000U, 0xbeef, 0xbeef, 8);
+	CHECK_RECORD(test, res, "%ld %lu %lld %llu", -1L, 2UL, -3LL, 18446744073709551615ULL);
+	CHECK_RECORD(test, res, "%zu %zd %hhd %hu", (size_t) 12, (ssize_t) -5, 300, 70000);
+	CHECK_RECORD(test, res, "[%5d] [%-5d] [%05d] [%+d]", 3, 3, 3, 3);
+	CHECK_RECORD(test, res, "[%*d] [%-*.*f]", 6, 1, 9, 2, 3.14159);
+	CHECK_RECORD(test, res, "%.3f %e %g", 2.5, 1234.5, 0.0001);
+	CHECK_RECORD(test, res, "%c%c 100%%", 'o', 'k');
+	CHECK_RECORD(test, res, "%s: %.*s and %.5s", name, 5, "PJSIP/bob", "truncated");
+	CHECK_RECORD(test, res, "[%10s] [%-10s]", "right", "left");
+
+	/* Strings are copied when the record is taken */
+	ast_trace_ring("%s", changing);
+	strcpy(changing, "after");
+	if (check_newest(test, "before")) {
+		res = AST_TEST_FAIL;
+	}
+
+	/* Past the argument limit the rest of the format is shown as is */
+	ast_trace_ring("%d %d %d %d %d %d %d %d %d %s", 1, 2, 3, 4, 5, 6, 7, 8, 9, "ten");
+	if (check_newest(test, "1 2 3 4 5 6 7 8 %d %s")) {
+		res = AST_TEST_FAIL;
+	}
+
+	ast_trace_ring_enable(was_enabled);
+
+	return res;
+}
+
+AST_TEST_DEFINE(wrap)
+{
+	int was_enabled = ast_trace_ring_enabled;
+	struct ast_str *buf;
+	const char *line;
+	unsigned int lines = 0;
+	unsigned int i;
+	char expected[64];
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "wrap";
+		info->category = "/main/trace_ring/";
+		info->summary = "A full trace ring keeps the newest records";
+		info->description =
+			"Takes more records than fit in a ring and checks only the\n"
+			"newest are decoded, in order, and that clearing drops them.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	ast_trace_ring_enable(1);
+	ast_trace_ring_clear();
+
+	for (i = 0; i < AST_TRACE_RING_SIZE + 100; i++) {
+		ast_trace_ring("record %u", i);
+	}
+
+	buf = ast_trace_ring_get(ast_get_tid(), 0);
+	ast_trace_ring_enable(was_enabled);
+	if (!buf) {
+		ast_test_status_update(test, "Could not decode the trace ring\n");
+		return AST_TEST_FAIL;
+	}
+
+	for (line = ast_str_buffer(buf); (line = strchr(line, '\n')); line++) {
+		lines++;
+	}
+	if (lines != AST_TRACE_RING_SIZE - 1) {
+		ast_test_status_update(test, "Decoded %u records, expected %d\n", lines, AST_TRACE_RING_SIZE - 1);
+		ast_free(buf);
+		return AST_TEST_FAIL;
+	}
+
+	snprintf(expected, sizeof(expected), ": record 101\n");
+	line = strchr(ast_str_buffer(buf), '\n');
+	if (!line || strncmp(line - strlen(expected) + 1, expected, strlen(expected))) {
+		ast_test_status_update(test, "Oldest record is not 'record 101'\n");
+		ast_free(buf);
+		return AST_TEST_FAIL;
+	}
+	snprintf(expected, sizeof(expected), ": record %d\n", AST_TRACE_RING_SIZE + 99);
+	if (!ast_ends_with(ast_str_buffer(buf), expected)) {
+		ast_test_status_update(test, "Newest record is not 'record %d'\n", AST_TRACE_RING_SIZE + 99);
+		ast_free(buf);
+		return AST_TEST_FAIL;
+	}
+	ast_free(buf);
+
+	ast_trace_ring_clear();
+	buf = ast_trace_ring_get(ast_get_tid(), 0);
+	if (!buf || ast_str_strlen(buf)) {
+		ast_test_status_update(test, "Records remain after clearing\n");
+		ast_free(buf);
+		return AST_TEST_FAIL;
+	}
+	ast_free(buf);
+
+	return AST_TEST_PASS;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(decode);
+	AST_TEST_UNREGISTER(wrap);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(decode);
+	AST_TEST_REGISTER(wrap);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Binary trace ring tests");
@@ -0,0 +1,175 @@
+/*
+ * Asterisk -- An open source telephony toolkit.
+ *
+ * Copyright (C) 2026, Sangoma Technologies Corporation
+ *
+ * See http://www.asterisk.org for more information about
+ * the Asterisk project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ * the project provides a web site, mailing lists and IRC
+ * channels for your use.
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ */
+
+/*!
+ * \file
+ * \brief Translation core tests
+ *
+ * \ingroup tests
+ */
+
+/*** MODULEINFO
+	<depend>TEST_FRAMEWORK</depend>
+	<support_level>core</support_level>
+ ***/
+
+#include "asterisk.h"
+
+#include "asterisk/test.h"
+#include "asterisk/module.h"
+#include "asterisk/utils.h"
+#include "asterisk/frame.h"
+#include "asterisk/format_cache.h"
+#include "asterisk/translate.h"
+
+/*! Number of paths translated at once, more than one batch callback takes */
+#define TEST_PATHS 40
+/*! Samples in each frame, 20ms at 8kHz */
+#define TEST_SAMPLES 160
+
+static void free_paths(struct ast_trans_pvt **paths, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		if (paths[i]) {
+			ast_translator_free_path(paths[i]);
+		}
+	}
+}
+
+/*!
+ * \internal
+ * \brief Check a batch over mixed formats against translating each path alone
+ */
+static enum ast_test_result_state check_batch(struct ast_test *test, struct ast_format *src)
+{
+	struct ast_format *dsts[] = { ast_format_ulaw, ast_format_alaw, ast_format_gsm };
+	struct ast_trans_pvt *batch_paths[TEST_PATHS] = { NULL, };
+	struct ast_trans_pvt *single_paths[TEST_PATHS] = { NULL, };
+	struct ast_frame frames[TEST_PATHS];
+	struct ast_frame *in[TEST_PATHS];
+	struct ast_frame *out[TEST_PATHS];
+	int16_t data[TEST_PATHS][TEST_SAMPLES];
+	enum ast_test_result_state res = AST_TEST_PASS;
+	int batched = 0;
+	int translated;
+	int i;
+	int j;
+
+	for (i = 0; i < TEST_PATHS; ++i) {
+		/* Mostly one format, a few breaking up the runs */
+		struct ast_format *dst = dsts[i % 7 == 6 ? 1 + i % 2 : 0];
+
+		batch_paths[i] = ast_translator_build_path(dst, src);
+		single_paths[i] = ast_translator_build_path(dst, src);
+		if (!batch_paths[i] || !single_paths[i]) {
+			ast_test_status_update(test, "Unable to build path from %s to %s\n",
+				ast_format_get_name(src), ast_format_get_name(dst));
+			res = AST_TEST_NOT_RUN;
+			goto cleanup;
+		}
+		batched += ast_translator_can_batch(batch_paths[i]);
+
+		for (j = 0; j < TEST_SAMPLES; ++j) {
+			data[i][j] = ast_random();
+		}
+		memset(&frames[i], 0, sizeof(frames[i]));
+		frames[i].frametype = AST_FRAME_VOICE;
+		frames[i].subclass.format = src;
+		frames[i].data.ptr = data[i];
+		frames[i].datalen = sizeof(data[i]);
+		frames[i].samples = TEST_SAMPLES;
+		frames[i].src = "test_translate";
+		in[i] = &frames[i];
+	}
+
+	ast_test_status_update(test, "%d of %d paths from %s can be batched\n",
+		batched, TEST_PATHS, ast_format_get_name(src));
+
+	translated = ast_translate_batch(batch_paths, in, out, TEST_PATHS);
+	if (translated != TEST_PATHS) {
+		ast_test_status_update(test, "Only %d of %d frames were translated\n",
+			translated, TEST_PATHS);
+		res = AST_TEST_FAIL;
+	}
+
+	for (i = 0; i < TEST_PATHS; ++i) {
+		struct ast_frame *expected = ast_translate(single_paths[i], &frames[i], 0);
+
+		if (!out[i] || !expected || out[i]->datalen != expected->datalen
+			|| out[i]->samples != expected->samples
+			|| ast_format_cmp(out[i]->subclass.format, expected->subclass.format) != AST_FORMAT_CMP_EQUAL
+			|| memcmp(out[i]->data.ptr, expected->data.ptr, expected->datalen)) {
+			ast_test_status_update(test, "Batched frame %d differs from translating it alone\n", i);
+			res = AST_TEST_FAIL;
+		}
+		ast_frfree(expected);
+		ast_frfree(out[i]);
+	}
+
+cleanup:
+	free_paths(batch_paths, TEST_PATHS);
+	free_paths(single_paths, TEST_PATHS);
+
+	return res;
+}
+
+AST_TEST_DEFINE(batch_matches_single)
+{
+	enum ast_test_result_state res;
+
+	switch (cmd) {
+	case TEST_INIT:
+		info->name = "batch_matches_single";
+		info->category = "/main/translate/";
+		info->summary = "Compare batched translation against translating each path alone";
+		info->description =
+			"Encodes one frame on each of a number of paths with a mix of\n"
+			"destination formats using ast_translate_batch() and checks each\n"
+			"result matches what ast_translate() gives on an identical path.";
+		return AST_TEST_NOT_RUN;
+	case TEST_EXECUTE:
+		break;
+	}
+
+	if (!ast_translate_path_steps(ast_format_ulaw, ast_format_slin)
+		|| !ast_translate_path_steps(ast_format_alaw, ast_format_slin)
+		|| !ast_translate_path_steps(ast_format_gsm, ast_format_slin)) {
+		ast_test_status_update(test, "The ulaw, alaw and gsm codecs are required\n");
+		return AST_TEST_NOT_RUN;
+	}
+
+	res = check_batch(test, ast_format_slin);
+
+	return res;
+}
+
+static int unload_module(void)
+{
+	AST_TEST_UNREGISTER(batch_matches_single);
+
+	return 0;
+}
+
+static int load_module(void)
+{
+	AST_TEST_REGISTER(batch_matches_single);
+
+	return AST_MODULE_LOAD_SUCCESS;
+}
+
+AST_MODULE_INFO_STANDARD(ASTERISK_GPL_KEY, "Translation core tests");